@@ -0,0 +1,293 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "bench_event_generator.h"
+
+#include <libscap/scap.h>
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+struct program
+{
+	const char* comm;
+	const char* exepath;
+	std::vector<std::string> args;
+};
+
+// The programs run by the processes after the first one, which is init
+const std::vector<program> s_programs = {
+	{"sshd", "/usr/sbin/sshd", {"-D"}},
+	{"bash", "/usr/bin/bash", {}},
+	{"containerd-shim", "/usr/bin/containerd-shim-runc-v2", {"-namespace", "k8s.io"}},
+	{"nginx", "/usr/sbin/nginx", {"-g", "daemon off;"}},
+	{"python3", "/usr/bin/python3.11", {"/opt/app/server.py"}},
+	{"java", "/usr/lib/jvm/java-17-openjdk/bin/java", {"-jar", "/opt/app/app.jar"}},
+	{"node", "/usr/local/bin/node", {"/srv/index.js"}},
+	{"postgres", "/usr/lib/postgresql/16/bin/postgres", {"-D", "/var/lib/postgresql/data"}},
+	{"curl", "/usr/bin/curl", {"-s", "https://example.com"}},
+	{"cat", "/usr/bin/cat", {"/etc/os-release"}},
+};
+
+// The paths of the files opened by the processes, where "%d" is replaced
+// with a number to make them distinct
+const std::vector<std::string> s_paths = {
+	"/etc/passwd",
+	"/etc/shadow",
+	"/etc/hosts",
+	"/etc/resolv.conf",
+	"/etc/ssl/certs/ca-certificates.crt",
+	"/etc/nginx/conf.d/site_%d.conf",
+	"/usr/lib/x86_64-linux-gnu/libplugin_%d.so",
+	"/proc/%d/status",
+	"/var/log/app/app_%d.log",
+	"/tmp/tmp.%d",
+	"/home/user/.cache/file_%d",
+	"/root/.ssh/authorized_keys",
+};
+
+const std::vector<uint16_t> s_ports = {80, 443, 53, 5432, 6379, 8080};
+
+std::string expand(const std::string& path, uint64_t n)
+{
+	auto pos = path.find("%d");
+	if(pos == std::string::npos)
+	{
+		return path;
+	}
+	return path.substr(0, pos) + std::to_string(n) + path.substr(pos + 2);
+}
+
+std::string ipv4(uint32_t addr)
+{
+	char buf[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+	return buf;
+}
+
+// The arguments of a process as a buffer of null-terminated strings
+std::string args_buf(const std::vector<std::string>& args)
+{
+	std::string res;
+	for(const auto& a : args)
+	{
+		res += a;
+		res.push_back('\0');
+	}
+	return res;
+}
+
+} // namespace
+
+bench_event_generator::bench_event_generator(sinsp& inspector, const config& cfg):
+	m_inspector(inspector),
+	m_config(cfg),
+	m_rng(cfg.seed)
+{
+	if(m_config.num_processes == 0 || m_config.num_files_per_process == 0
+		|| m_config.num_sockets_per_process == 0 || m_config.num_events == 0)
+	{
+		throw std::invalid_argument("the events need at least one process, file, socket and event");
+	}
+	add_processes();
+
+	std::discrete_distribution<int> kinds(m_config.mix.begin(), m_config.mix.end());
+	std::string data(4096, 'x');
+	for(uint32_t i = 0; i < m_config.num_events; i++)
+	{
+		auto& p = m_processes[m_rng() % m_processes.size()];
+		switch(kinds(m_rng))
+		{
+		case OPEN:
+		{
+			auto fd = p.files[m_rng() % p.files.size()];
+			auto fdinfo = p.tinfo->get_fd(fd);
+			add_event(p, fd, PPME_SYSCALL_OPENAT_2_X,
+				fd, // fd
+				(int64_t) PPM_AT_FDCWD, // dirfd
+				fdinfo->m_name.c_str(), // name
+				(uint32_t) fdinfo->m_openflags, // flags
+				(uint32_t) 0644, // mode
+				(uint32_t) 2049, // dev
+				(uint64_t) (1000 + fd)); // ino
+			break;
+		}
+		case CONNECT:
+		{
+			auto fd = p.sockets[m_rng() % p.sockets.size()];
+			const auto& f = p.tinfo->get_fd(fd)->m_sockinfo.m_ipv4info.m_fields;
+			// family, source address and port, destination address and port
+			uint8_t tuple[13];
+			tuple[0] = PPM_AF_INET;
+			memcpy(tuple + 1, &f.m_sip, 4);
+			memcpy(tuple + 5, &f.m_sport, 2);
+			memcpy(tuple + 7, &f.m_dip, 4);
+			memcpy(tuple + 11, &f.m_dport, 2);
+			add_event(p, fd, PPME_SOCKET_CONNECT_X,
+				(int64_t) 0, // res
+				scap_const_sized_buffer{tuple, sizeof(tuple)}, // tuple
+				fd); // fd
+			break;
+		}
+		case READ:
+		{
+			auto fd = p.files[m_rng() % p.files.size()];
+			auto len = 1 + m_rng() % data.size();
+			add_event(p, fd, PPME_SYSCALL_READ_X,
+				(int64_t) len, // res
+				scap_const_sized_buffer{data.data(), len}); // data
+			break;
+		}
+		case CLOSE:
+		{
+			auto fd = p.files[m_rng() % p.files.size()];
+			add_event(p, fd, PPME_SYSCALL_CLOSE_X,
+				(int64_t) 0); // res
+			break;
+		}
+		case EXECVE:
+		{
+			// with the parameters of the older versions of the event,
+			// the ones after them only refine what's in the thread table
+			auto args = args_buf(p.tinfo->m_args);
+			add_event(p, -1, PPME_SYSCALL_EXECVE_19_X,
+				(int64_t) 0, // res
+				p.tinfo->m_exepath.c_str(), // exe
+				scap_const_sized_buffer{args.data(), args.size()}, // args
+				p.tinfo->m_tid, // tid
+				p.tinfo->m_pid, // pid
+				p.tinfo->m_ptid, // ptid
+				"/", // cwd
+				(uint64_t) 1024, // fdlimit
+				(uint64_t) 0, // pgft_maj
+				(uint64_t) 0, // pgft_min
+				(uint32_t) 20000, // vm_size
+				(uint32_t) 8000, // vm_rss
+				(uint32_t) 0, // vm_swap
+				p.tinfo->m_comm.c_str()); // comm
+			break;
+		}
+		}
+	}
+}
+
+sinsp_evt* bench_event_generator::next()
+{
+	auto evt = m_events[m_next].evt.get();
+	m_next = (m_next + 1) % m_events.size();
+	m_ts += 1000;
+	reinterpret_cast<scap_evt*>(evt->get_scap_evt())->ts = m_ts;
+	return evt;
+}
+
+// A tree whose root is init, where each process is the child of one of the
+// processes added before it
+void bench_event_generator::add_processes()
+{
+	for(uint32_t i = 0; i < m_config.num_processes; i++)
+	{
+		int64_t pid = i == 0 ? 1 : 1000 + i;
+		auto tinfo = m_inspector.build_threadinfo();
+		tinfo->m_tid = pid;
+		tinfo->m_pid = pid;
+		if(i == 0)
+		{
+			tinfo->m_ptid = 0;
+			tinfo->m_comm = "systemd";
+			tinfo->m_exe = "/sbin/init";
+			tinfo->m_exepath = "/usr/lib/systemd/systemd";
+		}
+		else
+		{
+			const auto& prog = s_programs[(i - 1) % s_programs.size()];
+			tinfo->m_ptid = m_processes[m_rng() % m_processes.size()].tinfo->m_pid;
+			tinfo->m_comm = prog.comm;
+			tinfo->m_exe = prog.exepath;
+			tinfo->m_exepath = prog.exepath;
+			tinfo->m_args = prog.args;
+		}
+		tinfo->m_uid = i % 3 == 0 ? 0 : 1000;
+		tinfo->m_gid = tinfo->m_uid;
+
+		process p;
+		p.tinfo = tinfo.get();
+		m_inspector.m_thread_manager->add_thread(std::move(tinfo), false);
+		add_fds(p);
+		m_processes.push_back(std::move(p));
+	}
+}
+
+void bench_event_generator::add_fds(process& p)
+{
+	int64_t fd = 3;
+	for(uint32_t i = 0; i < m_config.num_files_per_process; i++, fd++)
+	{
+		auto fdinfo = m_inspector.build_fdinfo();
+		fdinfo->m_type = SCAP_FD_FILE_V2;
+		fdinfo->m_name = expand(s_paths[m_rng() % s_paths.size()], m_rng() % 100);
+		fdinfo->m_openflags = m_rng() % 4 == 0 ? PPM_O_RDWR : PPM_O_RDONLY;
+		p.tinfo->add_fd(fd, std::move(fdinfo));
+		p.files.push_back(fd);
+	}
+
+	for(uint32_t i = 0; i < m_config.num_sockets_per_process; i++, fd++)
+	{
+		auto fdinfo = m_inspector.build_fdinfo();
+		fdinfo->m_type = SCAP_FD_IPV4_SOCK;
+		auto& f = fdinfo->m_sockinfo.m_ipv4info.m_fields;
+		f.m_sip = htonl(0x0a000000 | (p.tinfo->m_pid & 0xffff));
+		f.m_sport = 32768 + m_rng() % 28000;
+		f.m_dip = htonl(0xac100000 | (m_rng() % 0xffff));
+		f.m_dport = s_ports[m_rng() % s_ports.size()];
+		f.m_l4proto = f.m_dport == 53 ? SCAP_L4_UDP : SCAP_L4_TCP;
+		fdinfo->m_name = ipv4(f.m_sip) + ":" + std::to_string(f.m_sport) + "->"
+			+ ipv4(f.m_dip) + ":" + std::to_string(f.m_dport);
+		p.tinfo->add_fd(fd, std::move(fdinfo));
+		p.sockets.push_back(fd);
+	}
+}
+
+template<typename... Args>
+void bench_event_generator::add_event(const process& p, int64_t fd, ppm_event_code type, Args... args)
+{
+	char err[SCAP_LASTERR_SIZE];
+	size_t size = 0;
+	// the first call only computes the size of the event
+	scap_event_encode_params(scap_sized_buffer{nullptr, 0}, &size, err, type, sizeof...(args), args...);
+
+	auto& e = m_events.emplace_back();
+	e.data.resize(size);
+	if(scap_event_encode_params(scap_sized_buffer{e.data.data(), size}, &size, err, type, sizeof...(args), args...) != SCAP_SUCCESS)
+	{
+		throw std::runtime_error(std::string("could not generate an event: ") + err);
+	}
+	auto hdr = reinterpret_cast<scap_evt*>(e.data.data());
+	hdr->tid = p.tinfo->m_tid;
+
+	e.evt = std::make_unique<sinsp_evt>(&m_inspector);
+	e.evt->init(e.data.data(), 0);
+	e.evt->set_num(m_events.size());
+	e.evt->set_tinfo(p.tinfo);
+	if(fd >= 0)
+	{
+		e.evt->set_fd_info(p.tinfo->get_fd(fd));
+	}
+}
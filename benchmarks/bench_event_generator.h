@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/sinsp.h>
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Generates syscall events with realistic field values, so that the
+// benchmarks don't need a driver nor capture files. The processes of a
+// process tree are added to the thread table of the inspector, along with
+// the files and the sockets they opened, and their events refer to them
+// as if they were parsed by the inspector.
+class bench_event_generator
+{
+public:
+	enum kind
+	{
+		OPEN = 0,
+		CONNECT,
+		READ,
+		CLOSE,
+		EXECVE,
+		NUM_KINDS,
+	};
+
+	struct config
+	{
+		// the relative weight of each kind of event
+		std::array<uint32_t, NUM_KINDS> mix = {30, 5, 50, 14, 1};
+		uint32_t num_processes = 64;
+		uint32_t num_files_per_process = 16;
+		uint32_t num_sockets_per_process = 4;
+		// the events generated upfront, which are then cycled through
+		uint32_t num_events = 10000;
+		uint64_t seed = 42;
+	};
+
+	bench_event_generator(sinsp& inspector, const config& cfg);
+
+	// Returns the next event, which stays valid as long as this
+	// generator, with a timestamp later than the previous one
+	sinsp_evt* next();
+
+	inline size_t size() const
+	{
+		return m_events.size();
+	}
+
+private:
+	struct event
+	{
+		std::vector<uint8_t> data;
+		std::unique_ptr<sinsp_evt> evt;
+	};
+
+	struct process
+	{
+		sinsp_threadinfo* tinfo;
+		std::vector<int64_t> files;
+		std::vector<int64_t> sockets;
+	};
+
+	void add_processes();
+	void add_fds(process& p);
+	template<typename... Args>
+	void add_event(const process& p, int64_t fd, ppm_event_code type, Args... args);
+
+	sinsp& m_inspector;
+	config m_config;
+	std::mt19937_64 m_rng;
+	std::vector<process> m_processes;
+	std::deque<event> m_events;
+	size_t m_next = 0;
+	uint64_t m_ts = 0;
+};
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "bench_falco_engine.h"
+
+#include <stdexcept>
+
+bench_falco_engine::bench_falco_engine()
+{
+	m_filter_factory = std::make_shared<sinsp_filter_factory>(&m_inspector, m_filterlist);
+	m_formatter_factory = std::make_shared<sinsp_evt_formatter_factory>(&m_inspector, m_filterlist);
+	m_engine = std::make_shared<falco_engine>();
+	m_source_idx = m_engine->add_source(falco_common::syscall_source, m_filter_factory, m_formatter_factory);
+}
+
+void bench_falco_engine::load_rules(const std::string& rules_content, const std::string& rules_filename)
+{
+	auto res = m_engine->load_rules(rules_content, rules_filename);
+	if (!res->successful())
+	{
+		falco::load_result::rules_contents_t rc = {{rules_filename, rules_content}};
+		throw std::runtime_error("could not load the rules: " + res->as_string(false, rc));
+	}
+	m_engine->enable_rule("", true);
+}
+
+sinsp_evt* bench_falco_engine::new_event(ppm_event_code type)
+{
+	auto& e = m_events.emplace_back();
+	e.data.resize(sizeof(scap_evt));
+	auto hdr = reinterpret_cast<scap_evt*>(e.data.data());
+	hdr->ts = 1000000000 * m_events.size();
+	hdr->tid = 1;
+	hdr->len = sizeof(scap_evt);
+	hdr->type = type;
+	hdr->nparams = 0;
+	e.evt = std::make_unique<sinsp_evt>(&m_inspector);
+	e.evt->init(e.data.data(), 0);
+	e.evt->set_num(m_events.size());
+	return e.evt.get();
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "falco_engine.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The counterpart of the test_falco_engine fixture of the unit tests: an
+// engine with the syscall source, and the synthetic events to feed it
+class bench_falco_engine
+{
+public:
+	bench_falco_engine();
+
+	// Loads the rules and enables them all, throwing on failure
+	void load_rules(const std::string& rules_content, const std::string& rules_filename = "bench_rules.yaml");
+
+	// Returns a new event of the given type, with no parameters and no
+	// thread, which stays valid as long as this helper
+	sinsp_evt* new_event(ppm_event_code type);
+
+	std::size_t m_source_idx = 0;
+	sinsp m_inspector;
+	sinsp_filter_check_list m_filterlist;
+	std::shared_ptr<sinsp_filter_factory> m_filter_factory;
+	std::shared_ptr<sinsp_evt_formatter_factory> m_formatter_factory;
+	std::shared_ptr<falco_engine> m_engine;
+
+private:
+	struct event
+	{
+		std::vector<uint8_t> data;
+		std::unique_ptr<sinsp_evt> evt;
+	};
+
+	std::deque<event> m_events;
+};
@@ -0,0 +1,367 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "../bench_falco_engine.h"
+#include "alloc_tracker.h"
+#include "rules_arena.h"
+#include "rule_loader_collector.h"
+#include "rule_loader_compiler.h"
+#include "rule_loader_reader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#ifdef __linux__
+#include <malloc.h>
+#endif
+
+#ifdef FALCO_ALLOC_TRACKING
+// the allocations are already tracked, see alloc_tracker.h
+static int64_t heap_live_bytes()
+{
+	return falco::alloc_tracker::live_bytes();
+}
+
+static int64_t heap_peak_bytes()
+{
+	return falco::alloc_tracker::peak_bytes();
+}
+
+static void reset_heap_peak()
+{
+	falco::alloc_tracker::reset_peak();
+}
+#elif defined(FALCO_RULES_ARENA)
+// new and delete already come from rules_arena.cpp, so only the chunks
+// of the arenas are reported, which only grow while loading the rules
+static int64_t heap_live_bytes()
+{
+	std::map<std::string, uint64_t> metrics;
+	falco::rules_arena::get_metrics(metrics);
+	return metrics["bytes"];
+}
+
+static int64_t heap_peak_bytes()
+{
+	return heap_live_bytes();
+}
+
+static void reset_heap_peak()
+{
+}
+#else
+// The heap memory allocated with new, and its peak since the last reset,
+// to report the peak allocations of each loading phase
+static std::atomic<int64_t> s_allocated{0};
+static std::atomic<int64_t> s_peak{0};
+
+void* operator new(std::size_t n)
+{
+	void* p = std::malloc(n);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+#ifdef __linux__
+	int64_t size = malloc_usable_size(p);
+	auto allocated = s_allocated.fetch_add(size, std::memory_order_relaxed) + size;
+	auto peak = s_peak.load(std::memory_order_relaxed);
+	while (allocated > peak && !s_peak.compare_exchange_weak(peak, allocated, std::memory_order_relaxed));
+#endif
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+#ifdef __linux__
+	if (p != nullptr)
+	{
+		s_allocated.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+	}
+#endif
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+static int64_t heap_live_bytes()
+{
+	return s_allocated.load(std::memory_order_relaxed);
+}
+
+static int64_t heap_peak_bytes()
+{
+	return s_peak.load(std::memory_order_relaxed);
+}
+
+static void reset_heap_peak()
+{
+	s_peak.store(heap_live_bytes(), std::memory_order_relaxed);
+}
+#endif
+
+namespace
+{
+
+using clock = std::chrono::steady_clock;
+
+// The time and the peak allocations of a loading phase, summed across
+// the iterations of a benchmark
+struct phase
+{
+	clock::duration time{0};
+	int64_t peak_bytes = 0;
+	int64_t start_bytes = 0;
+
+	void start()
+	{
+		start_bytes = heap_live_bytes();
+		reset_heap_peak();
+	}
+
+	void stop()
+	{
+		peak_bytes += heap_peak_bytes() - start_bytes;
+	}
+};
+
+// The time spent defining what the reader parsed, which is part of reading
+class timing_collector : public rule_loader::collector
+{
+public:
+	clock::duration time{0};
+
+	void define(rule_loader::configuration& cfg, rule_loader::engine_version_info& info) override { timed([&]{ collector::define(cfg, info); }); }
+	void define(rule_loader::configuration& cfg, rule_loader::plugin_version_info& info) override { timed([&]{ collector::define(cfg, info); }); }
+	void define(rule_loader::configuration& cfg, rule_loader::list_info& info) override { timed([&]{ collector::define(cfg, info); }); }
+	void define(rule_loader::configuration& cfg, rule_loader::macro_info& info) override { timed([&]{ collector::define(cfg, info); }); }
+	void define(rule_loader::configuration& cfg, rule_loader::rule_info& info) override { timed([&]{ collector::define(cfg, info); }); }
+	void append(rule_loader::configuration& cfg, rule_loader::list_info& info) override { timed([&]{ collector::append(cfg, info); }); }
+	void append(rule_loader::configuration& cfg, rule_loader::macro_info& info) override { timed([&]{ collector::append(cfg, info); }); }
+	void append(rule_loader::configuration& cfg, rule_loader::rule_update_info& info) override { timed([&]{ collector::append(cfg, info); }); }
+	void enable(rule_loader::configuration& cfg, rule_loader::rule_info& info) override { timed([&]{ collector::enable(cfg, info); }); }
+	void selective_replace(rule_loader::configuration& cfg, rule_loader::rule_update_info& info) override { timed([&]{ collector::selective_replace(cfg, info); }); }
+
+private:
+	template<typename F> void timed(F f)
+	{
+		auto start = clock::now();
+		f();
+		time += clock::now() - start;
+	}
+};
+
+class timing_reader : public rule_loader::reader
+{
+public:
+	phase* m_read = nullptr;
+
+	bool read(rule_loader::configuration& cfg, rule_loader::collector& col) override
+	{
+		m_read->start();
+		auto start = clock::now();
+		auto res = reader::read(cfg, col);
+		m_read->time += clock::now() - start;
+		m_read->stop();
+		return res;
+	}
+};
+
+// Adding the compiled rules to the rulesets starts when compiling ends
+class timing_compiler : public rule_loader::compiler
+{
+public:
+	phase* m_compile = nullptr;
+	phase* m_add = nullptr;
+	mutable clock::time_point m_add_start;
+
+	void compile(rule_loader::configuration& cfg, const rule_loader::collector& col, rule_loader::compile_output& out) const override
+	{
+		m_compile->start();
+		auto start = clock::now();
+		compiler::compile(cfg, col, out);
+		m_compile->time += clock::now() - start;
+		m_compile->stop();
+		m_add->start();
+		m_add_start = clock::now();
+	}
+};
+
+// Loads the rules on a new engine at every iteration, and reports the
+// average time and peak allocations of reading the rules (parsing the YAML
+// and collecting the definitions, whose time is also reported on its
+// own), compiling them, adding them to the rulesets and completing the
+// loading, which creates the formatters of their outputs
+void run(benchmark::State& state, const std::string& rules_content)
+{
+	phase read, compile, add, complete;
+	clock::duration collect{0};
+	std::unique_ptr<bench_falco_engine> e;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		e = std::make_unique<bench_falco_engine>();
+		auto reader = std::make_shared<timing_reader>();
+		auto collector = std::make_shared<timing_collector>();
+		auto compiler = std::make_shared<timing_compiler>();
+		reader->m_read = &read;
+		compiler->m_compile = &compile;
+		compiler->m_add = &add;
+		e->m_engine->set_rule_reader(reader);
+		e->m_engine->set_rule_collector(collector);
+		e->m_engine->set_rule_compiler(compiler);
+		state.ResumeTiming();
+
+		e->load_rules(rules_content);
+		add.time += clock::now() - compiler->m_add_start;
+		add.stop();
+
+		complete.start();
+		auto start = clock::now();
+		e->m_engine->complete_rule_loading();
+		complete.time += clock::now() - start;
+		complete.stop();
+		collect += collector->time;
+	}
+	state.PauseTiming();
+	e.reset();
+	state.ResumeTiming();
+
+	auto avg_ms = [](clock::duration d)
+	{
+		return benchmark::Counter(std::chrono::duration<double, std::milli>(d).count(), benchmark::Counter::kAvgIterations);
+	};
+	auto avg_bytes = [](int64_t b)
+	{
+		return benchmark::Counter(b, benchmark::Counter::kAvgIterations, benchmark::Counter::OneK::kIs1024);
+	};
+	state.counters["read_ms"] = avg_ms(read.time);
+	state.counters["collect_ms"] = avg_ms(collect);
+	state.counters["compile_ms"] = avg_ms(compile.time);
+	state.counters["add_ms"] = avg_ms(add.time);
+	state.counters["complete_ms"] = avg_ms(complete.time);
+	state.counters["read_peak_bytes"] = avg_bytes(read.peak_bytes);
+	state.counters["compile_peak_bytes"] = avg_bytes(compile.peak_bytes);
+	state.counters["add_peak_bytes"] = avg_bytes(add.peak_bytes);
+	state.counters["complete_peak_bytes"] = avg_bytes(complete.peak_bytes);
+}
+
+// The rules shipped with Falco
+void BM_load_rules_stock(benchmark::State& state)
+{
+	std::ifstream f(FALCO_BENCH_RULES_FILE);
+	if (!f.is_open())
+	{
+		state.SkipWithError("could not read " FALCO_BENCH_RULES_FILE);
+		return;
+	}
+	std::stringstream ss;
+	ss << f.rdbuf();
+	run(state, ss.str());
+}
+
+// Many rules, each with its own list and macro
+void BM_load_rules_many(benchmark::State& state)
+{
+	std::string rules;
+	for (int64_t i = 0; i < state.range(0); i++)
+	{
+		auto n = std::to_string(i);
+		rules += "- list: list_" + n + "\n"
+			"  items: [bin_" + n + "_a, bin_" + n + "_b]\n"
+			"- macro: macro_" + n + "\n"
+			"  condition: evt.type in (open, openat) and proc.name in (list_" + n + ")\n"
+			"- rule: rule_" + n + "\n"
+			"  desc: rule " + n + "\n"
+			"  condition: macro_" + n + " and fd.name startswith /etc/" + n + "\n"
+			"  output: rule " + n + " (proc.name=%proc.name fd.name=%fd.name)\n"
+			"  priority: WARNING\n";
+	}
+	run(state, rules);
+}
+
+// A few rules using huge lists
+void BM_load_rules_huge_lists(benchmark::State& state)
+{
+	std::string rules;
+	for (int64_t l = 0; l < 10; l++)
+	{
+		auto n = std::to_string(l);
+		rules += "- list: list_" + n + "\n  items: [";
+		for (int64_t i = 0; i < state.range(0); i++)
+		{
+			rules += (i > 0 ? ", " : "") + std::string("/usr/bin/bin_") + n + "_" + std::to_string(i);
+		}
+		rules += "]\n"
+			"- rule: rule_" + n + "\n"
+			"  desc: rule " + n + "\n"
+			"  condition: evt.type = execve and proc.exepath in (list_" + n + ")\n"
+			"  output: rule " + n + " (proc.exepath=%proc.exepath)\n"
+			"  priority: WARNING\n";
+	}
+	run(state, rules);
+}
+
+// Rules using the last macro of a chain of macros, each using the previous one
+void BM_load_rules_deep_macros(benchmark::State& state)
+{
+	std::string rules = "- macro: macro_0\n  condition: evt.type = openat\n";
+	for (int64_t i = 1; i < state.range(0); i++)
+	{
+		auto n = std::to_string(i);
+		rules += "- macro: macro_" + n + "\n"
+			"  condition: macro_" + std::to_string(i - 1) + " and proc.name != bin_" + n + "\n";
+	}
+	auto last = "macro_" + std::to_string(state.range(0) - 1);
+	for (int64_t i = 0; i < 100; i++)
+	{
+		auto n = std::to_string(i);
+		rules += "- rule: rule_" + n + "\n"
+			"  desc: rule " + n + "\n"
+			"  condition: " + last + " and fd.num = " + n + "\n"
+			"  output: rule " + n + " (proc.name=%proc.name)\n"
+			"  priority: WARNING\n";
+	}
+	run(state, rules);
+}
+
+} // namespace
+
+BENCHMARK(BM_load_rules_stock)->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_load_rules_many)
+	->ArgNames({"rules"})
+	->Arg(100)->Arg(1000)->Arg(5000)
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_load_rules_huge_lists)
+	->ArgNames({"items"})
+	->Arg(1000)->Arg(10000)->Arg(50000)
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_load_rules_deep_macros)
+	->ArgNames({"depth"})
+	->Arg(10)->Arg(50)->Arg(200)
+	->Unit(benchmark::kMillisecond);
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "../bench_event_generator.h"
+#include "../bench_falco_engine.h"
+#include "alloc_tracker.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+struct syscall_event
+{
+	ppm_event_code code;
+	std::string name;
+};
+
+// the event types selected by the rules
+const std::vector<syscall_event> s_rules_events = {
+	{PPME_SYSCALL_OPENAT_2_X, "openat"},
+	{PPME_SOCKET_CONNECT_X, "connect"},
+	{PPME_SYSCALL_EXECVE_19_X, "execve"},
+	{PPME_SYSCALL_CLONE_20_X, "clone"},
+	{PPME_SYSCALL_MKDIRAT_X, "mkdirat"},
+	{PPME_SYSCALL_UNLINKAT_2_X, "unlinkat"},
+	{PPME_SYSCALL_SETUID_X, "setuid"},
+	{PPME_SYSCALL_PTRACE_X, "ptrace"},
+};
+
+// the event types that no rule selects
+const std::vector<syscall_event> s_other_events = {
+	{PPME_SYSCALL_READ_X, "read"},
+	{PPME_SYSCALL_WRITE_X, "write"},
+	{PPME_SYSCALL_CLOSE_X, "close"},
+	{PPME_SYSCALL_FSTAT_X, "fstat"},
+	{PPME_SYSCALL_LSEEK_X, "lseek"},
+	{PPME_SYSCALL_MMAP_X, "mmap"},
+	{PPME_SYSCALL_BRK_4_X, "brk"},
+	{PPME_SYSCALL_FUTEX_X, "futex"},
+};
+
+// The rules are spread across the first num_types event types selected by
+// the rules, and their conditions hold for all the events of their types
+std::string rules(int64_t num_rules, int64_t num_types)
+{
+	std::string res;
+	for (int64_t i = 0; i < num_rules; i++)
+	{
+		auto n = std::to_string(i);
+		res += "- rule: rule_" + n + "\n"
+			"  desc: rule " + n + "\n"
+			"  condition: evt.type = " + s_rules_events[i % num_types].name + " and evt.num > 0\n"
+			"  output: rule " + n + " (evt.num=%evt.num)\n"
+			"  priority: WARNING\n";
+	}
+	return res;
+}
+
+// A sequence of events, match_pct percent of which are of the event types
+// selected by the rules
+std::vector<sinsp_evt*> events(bench_falco_engine& e, int64_t match_pct, int64_t num_types)
+{
+	std::vector<sinsp_evt*> res;
+	for (int64_t i = 0; i < 1000; i++)
+	{
+		if (i % 100 < match_pct)
+		{
+			res.push_back(e.new_event(s_rules_events[i % num_types].code));
+		}
+		else
+		{
+			res.push_back(e.new_event(s_other_events[i % s_other_events.size()].code));
+		}
+	}
+	return res;
+}
+
+// In the builds counting the allocations, reports the ones of the engine
+// per event since it had made num_allocs of them
+void allocs_counter(benchmark::State& state, uint64_t num_allocs)
+{
+	if (falco::alloc_tracker::enabled())
+	{
+		num_allocs = falco::alloc_tracker::num_allocs(falco::alloc_tracker::ENGINE) - num_allocs;
+		state.counters["allocs_per_evt"] = benchmark::Counter(num_allocs, benchmark::Counter::kAvgIterations);
+	}
+}
+
+void run(benchmark::State& state, int64_t num_rules, int64_t match_pct, int64_t num_types, falco_common::rule_matching strategy)
+{
+	bench_falco_engine e;
+	e.load_rules(rules(num_rules, num_types));
+	auto evts = events(e, match_pct, num_types);
+
+	std::vector<falco_engine::rule_match> matches;
+	uint64_t num_matches = 0;
+	size_t i = 0;
+	uint64_t num_allocs = falco::alloc_tracker::num_allocs(falco::alloc_tracker::ENGINE);
+	for (auto _ : state)
+	{
+		e.m_engine->process_event(e.m_source_idx, evts[i], strategy, matches);
+		num_matches += matches.size();
+		i = (i + 1) % evts.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["matches_per_evt"] = benchmark::Counter(num_matches, benchmark::Counter::kAvgIterations);
+	allocs_counter(state, num_allocs);
+}
+
+// Per-event cost by number of rules, share of events of the types
+// selected by the rules, and rule matching strategy
+void BM_process_event(benchmark::State& state)
+{
+	run(state, state.range(0), state.range(1), s_rules_events.size(),
+		state.range(2) ? falco_common::rule_matching::ALL : falco_common::rule_matching::FIRST);
+}
+
+// Per-event cost by number of event types the same rules are spread across,
+// with all the events of those types
+void BM_process_event_types(benchmark::State& state)
+{
+	run(state, 256, 100, state.range(0), falco_common::rule_matching::FIRST);
+}
+
+// Per-event cost of the rules shipped with Falco, with synthetic events of
+// realistic processes, files and connections, in the proportions of the
+// mix of the generator, with about 1% or 10% of executions
+void BM_process_event_synthetic(benchmark::State& state)
+{
+	std::ifstream f(FALCO_BENCH_RULES_FILE);
+	if (!f.is_open())
+	{
+		state.SkipWithError("could not read " FALCO_BENCH_RULES_FILE);
+		return;
+	}
+	std::stringstream ss;
+	ss << f.rdbuf();
+
+	bench_falco_engine e;
+	try
+	{
+		e.load_rules(ss.str(), FALCO_BENCH_RULES_FILE);
+	}
+	catch (const std::exception& ex)
+	{
+		state.SkipWithError(ex.what());
+		return;
+	}
+
+	bench_event_generator::config cfg;
+	cfg.mix[bench_event_generator::EXECVE] = state.range(0);
+	bench_event_generator gen(e.m_inspector, cfg);
+
+	std::vector<falco_engine::rule_match> matches;
+	uint64_t num_matches = 0;
+	uint64_t num_allocs = falco::alloc_tracker::num_allocs(falco::alloc_tracker::ENGINE);
+	for (auto _ : state)
+	{
+		e.m_engine->process_event(e.m_source_idx, gen.next(), falco_common::rule_matching::ALL, matches);
+		num_matches += matches.size();
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["matches_per_evt"] = benchmark::Counter(num_matches, benchmark::Counter::kAvgIterations);
+	allocs_counter(state, num_allocs);
+}
+
+} // namespace
+
+BENCHMARK(BM_process_event)
+	->ArgNames({"rules", "match_pct", "all"})
+	->ArgsProduct({{1, 10, 100, 1000}, {0, 10, 100}, {0, 1}});
+
+BENCHMARK(BM_process_event_types)
+	->ArgNames({"types"})
+	->RangeMultiplier(2)
+	->Range(1, 8);
+
+BENCHMARK(BM_process_event_synthetic)
+	->ArgNames({"exec_pct"})
+	->Arg(1)->Arg(10);
@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <benchmark/benchmark.h>
+
+#include <falco/grpc_context.h>
+#include <falco/grpc_queue.h>
+#include <falco/grpc_server.h>
+#include <falco/outputs_grpc.h>
+
+#include <grpcpp/grpcpp.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// How the clients read the alerts: streaming them one at a time with sub,
+// polling them with get, or streaming them in batches with sub_batch
+enum client_kind
+{
+	CLIENT_SUB = 0,
+	CLIENT_GET = 1,
+	CLIENT_SUB_BATCH = 2,
+};
+
+// how often the lag of the clients and the memory of the queue are sampled
+constexpr std::chrono::milliseconds s_sampling_interval{10};
+
+// how long a polling client waits after a get returning no alerts
+constexpr std::chrono::milliseconds s_poll_interval{1};
+
+uint64_t epoch_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint64_t cpu_time_us()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+		+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+uint64_t max_rss_kb()
+{
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+// A client of the outputs service, reading the alerts on its own thread
+// until it's stopped. Each one has its own session, which is its name in
+// the lag metrics of the queue.
+class bench_client
+{
+public:
+	bench_client(const std::shared_ptr<::grpc::Channel>& channel, client_kind kind, const std::string& name):
+		m_stub(falco::outputs::service::NewStub(channel)),
+		m_kind(kind),
+		m_name(name)
+	{
+		m_thread = std::thread([this] { run(); });
+	}
+
+	~bench_client()
+	{
+		stop();
+	}
+
+	void stop()
+	{
+		m_stop = true;
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			if(m_ctx != nullptr)
+			{
+				m_ctx->TryCancel();
+			}
+		}
+		if(m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	inline const std::string& name() const
+	{
+		return m_name;
+	}
+
+	inline uint64_t received() const
+	{
+		return m_received.load(std::memory_order_relaxed);
+	}
+
+private:
+	// the context of the current call, to cancel it when stopping
+	std::unique_ptr<::grpc::ClientContext> new_context()
+	{
+		auto ctx = std::make_unique<::grpc::ClientContext>();
+		ctx->AddMetadata(falco::grpc::meta_session, m_name);
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_ctx = ctx.get();
+		return ctx;
+	}
+
+	void release_context()
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_ctx = nullptr;
+	}
+
+	void run()
+	{
+		falco::outputs::request req;
+		while(!m_stop)
+		{
+			auto ctx = new_context();
+			uint64_t n = 0;
+			switch(m_kind)
+			{
+			case CLIENT_SUB:
+			{
+				auto stream = m_stub->sub(ctx.get());
+				falco::outputs::response res;
+				if(stream->Write(req))
+				{
+					while(stream->Read(&res))
+					{
+						m_received.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				break;
+			}
+			case CLIENT_GET:
+			{
+				auto reader = m_stub->get(ctx.get(), req);
+				falco::outputs::response res;
+				while(reader->Read(&res))
+				{
+					n++;
+					m_received.fetch_add(1, std::memory_order_relaxed);
+				}
+				reader->Finish();
+				break;
+			}
+			case CLIENT_SUB_BATCH:
+			{
+				auto stream = m_stub->sub_batch(ctx.get());
+				falco::outputs::batch res;
+				if(stream->Write(req))
+				{
+					while(stream->Read(&res))
+					{
+						m_received.fetch_add(res.responses_size(), std::memory_order_relaxed);
+					}
+				}
+				break;
+			}
+			}
+			release_context();
+			if(m_kind == CLIENT_GET && n == 0 && !m_stop)
+			{
+				std::this_thread::sleep_for(s_poll_interval);
+			}
+		}
+	}
+
+	std::unique_ptr<falco::outputs::service::Stub> m_stub;
+	client_kind m_kind;
+	std::string m_name;
+	std::atomic<bool> m_stop{false};
+	std::atomic<uint64_t> m_received{0};
+	std::mutex m_mtx;
+	::grpc::ClientContext* m_ctx = nullptr;
+	std::thread m_thread;
+};
+
+// Samples the lag of each client and the memory held by the queue while
+// the alerts are pushed
+class bench_sampler
+{
+public:
+	explicit bench_sampler(const std::vector<std::string>& clients):
+		m_clients(clients)
+	{
+		std::map<std::string, uint64_t> metrics;
+		falco::grpc::queue::get().get_metrics(metrics);
+		m_initial_memory_bytes = metrics["queue_memory_bytes"];
+		m_max_memory_bytes = m_initial_memory_bytes;
+		m_thread = std::thread([this] { run(); });
+	}
+
+	~bench_sampler()
+	{
+		stop();
+	}
+
+	void stop()
+	{
+		m_stop = true;
+		if(m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	uint64_t max_lag() const
+	{
+		return m_max_lag;
+	}
+
+	double avg_lag() const
+	{
+		return m_num_samples > 0 ? (double) m_sum_lag / m_num_samples : 0;
+	}
+
+	uint64_t memory_growth_bytes() const
+	{
+		return m_max_memory_bytes - m_initial_memory_bytes;
+	}
+
+private:
+	void run()
+	{
+		std::map<std::string, uint64_t> metrics;
+		while(!m_stop)
+		{
+			std::this_thread::sleep_for(s_sampling_interval);
+			metrics.clear();
+			falco::grpc::queue::get().get_metrics(metrics);
+			for(const auto& c : m_clients)
+			{
+				auto lag = metrics["subscriber_lag." + c];
+				m_max_lag = std::max(m_max_lag, lag);
+				m_sum_lag += lag;
+				m_num_samples++;
+			}
+			m_max_memory_bytes = std::max(m_max_memory_bytes, metrics["queue_memory_bytes"]);
+		}
+	}
+
+	std::vector<std::string> m_clients;
+	std::atomic<bool> m_stop{false};
+	std::thread m_thread;
+	uint64_t m_max_lag = 0;
+	uint64_t m_sum_lag = 0;
+	uint64_t m_num_samples = 0;
+	uint64_t m_initial_memory_bytes = 0;
+	uint64_t m_max_memory_bytes = 0;
+};
+
+// Shared by the producer threads of a benchmark, which all start and stop
+// together, and set up and torn down by the first one
+std::unique_ptr<falco::grpc::server> s_server;
+std::thread s_server_thread;
+std::unique_ptr<falco::outputs::abstract_output> s_output;
+std::vector<std::unique_ptr<bench_client>> s_clients;
+std::unique_ptr<bench_sampler> s_sampler;
+std::map<std::string, uint64_t> s_initial_metrics;
+uint64_t s_initial_cpu_us = 0;
+uint64_t s_initial_rss_kb = 0;
+
+std::string server_address()
+{
+	return "unix:///tmp/falco_grpc_bench_" + std::to_string(getpid()) + ".sock";
+}
+
+void setup(benchmark::State& state)
+{
+	auto kind = (client_kind) state.range(0);
+	auto num_clients = state.range(1);
+
+	// the alerts retained by the previous benchmark are discarded
+	auto& q = falco::grpc::queue::get();
+	q.set_capacity(state.range(3));
+
+	s_output = std::make_unique<falco::outputs::output_grpc>();
+	std::string err;
+	if(!s_output->init(falco::outputs::config{"grpc", {}}, false, "bench-host", false, err))
+	{
+		throw std::runtime_error("could not init the gRPC output: " + err);
+	}
+
+	auto addr = server_address();
+	s_server = std::make_unique<falco::grpc::server>();
+	s_server->init(addr, state.range(2), "", "", "", "error");
+	s_server_thread = std::thread([] { s_server->run(); });
+
+	auto channel = ::grpc::CreateChannel(addr, ::grpc::InsecureChannelCredentials());
+	if(!channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(10)))
+	{
+		throw std::runtime_error("could not connect to the gRPC server at " + addr);
+	}
+
+	std::vector<std::string> names;
+	for(int64_t i = 0; i < num_clients; i++)
+	{
+		names.push_back("bench-client-" + std::to_string(i));
+		s_clients.push_back(std::make_unique<bench_client>(channel, kind, names.back()));
+	}
+
+	// the streaming clients are subscribed before the first alert
+	if(kind != CLIENT_GET)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		std::map<std::string, uint64_t> metrics;
+		while(metrics["subscribers"] < (uint64_t) num_clients && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			metrics.clear();
+			q.get_metrics(metrics);
+		}
+	}
+
+	s_initial_metrics.clear();
+	q.get_metrics(s_initial_metrics);
+	s_sampler = std::make_unique<bench_sampler>(names);
+	s_initial_cpu_us = cpu_time_us();
+	s_initial_rss_kb = max_rss_kb();
+}
+
+// Reports, over the whole benchmark, the alerts received per second by
+// all the clients, the ones they lost or that were dropped by the queue,
+// the maximum and average lag of the clients, the CPU time of the whole
+// process (server, producers and clients) per delivered alert, and how
+// much the memory held by the queue and the peak RSS grew
+void teardown(benchmark::State& state)
+{
+	uint64_t cpu_us = cpu_time_us() - s_initial_cpu_us;
+	uint64_t delivered = 0;
+	for(const auto& c : s_clients)
+	{
+		delivered += c->received();
+	}
+	if(s_sampler)
+	{
+		s_sampler->stop();
+	}
+	std::map<std::string, uint64_t> metrics;
+	falco::grpc::queue::get().get_metrics(metrics);
+
+	for(auto& c : s_clients)
+	{
+		c->stop();
+	}
+	s_clients.clear();
+	if(s_server_thread.joinable())
+	{
+		s_server->shutdown();
+		s_server_thread.join();
+	}
+	s_server.reset();
+	s_output.reset();
+	unlink(server_address().substr(std::string("unix://").size()).c_str());
+
+	if(s_sampler)
+	{
+		state.counters["lag_max"] = s_sampler->max_lag();
+		state.counters["lag_avg"] = s_sampler->avg_lag();
+		state.counters["queue_memory_growth_bytes"] = s_sampler->memory_growth_bytes();
+		s_sampler.reset();
+	}
+	state.counters["delivered_per_sec"] = benchmark::Counter(delivered, benchmark::Counter::kIsRate);
+	state.counters["lost_per_sec"] = benchmark::Counter(
+		(metrics["alerts_lost"] - s_initial_metrics["alerts_lost"]) + (metrics["queue_drops"] - s_initial_metrics["queue_drops"]),
+		benchmark::Counter::kIsRate);
+	state.counters["cpu_us_per_alert"] = delivered > 0 ? (double) cpu_us / delivered : 0;
+	state.counters["max_rss_growth_kb"] = max_rss_kb() - s_initial_rss_kb;
+}
+
+// The producers push the alerts through the gRPC output, encoding them as
+// protobuf as the outputs pipeline does, as fast as they can. The
+// arguments are how the clients read them, the number of clients, the
+// threadiness of the server and the capacity of the queue.
+void BM_grpc_outputs(benchmark::State& state)
+{
+	if(state.thread_index() == 0)
+	{
+		setup(state);
+	}
+
+	falco::outputs::message msg;
+	msg.priority = falco_common::PRIORITY_WARNING;
+	msg.msg = "File opened (evt.num=1 evt.type=openat proc.name=bench fd.name=/etc/shadow)";
+	msg.rule = falco::interned_string("bench rule");
+	msg.source = falco::interned_string(falco_common::syscall_source);
+	msg.tags = falco::interned_tags{"bench", "grpc"};
+	falco::assign_field_values(msg.fields, std::map<std::string, std::string>{
+		{"evt.type", "openat"}, {"proc.name", "bench"}, {"fd.name", "/etc/shadow"}});
+	uint64_t n = 0;
+	for(auto _ : state)
+	{
+		msg.ts = epoch_ns();
+		msg.encoded.clear();
+		s_output->output(&msg);
+		n++;
+	}
+	state.SetItemsProcessed(n);
+
+	// all the producers are done by now
+	if(state.thread_index() == 0)
+	{
+		teardown(state);
+	}
+}
+
+void args(benchmark::internal::Benchmark* b)
+{
+	b->ArgNames({"client", "clients", "threadiness", "capacity"});
+	for(auto kind : {CLIENT_SUB, CLIENT_GET, CLIENT_SUB_BATCH})
+	{
+		for(auto clients : {1, 4, 16})
+		{
+			for(auto threadiness : {1, 4})
+			{
+				b->Args({kind, clients, threadiness, 10000});
+			}
+		}
+	}
+	b->ThreadRange(1, 2);
+	b->UseRealTime();
+}
+
+} // namespace
+
+BENCHMARK(BM_grpc_outputs)->Apply(args);
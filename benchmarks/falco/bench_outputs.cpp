@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "../bench_falco_engine.h"
+#include <falco/falco_outputs.h>
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// The fake outputs, which take no time, a fixed time or a jittery time to
+// write each alert, sleeping like an output waiting for its destination
+enum sink_kind
+{
+	SINK_NULL = 0,
+	SINK_FIXED = 1,
+	SINK_JITTER = 2,
+};
+
+const char* s_sink_names[] = {"bench_null", "bench_fixed", "bench_jitter"};
+
+// how long the fixed and jittery outputs take on average
+constexpr std::chrono::microseconds s_sink_latency{20};
+
+std::atomic<uint64_t> s_num_delivered{0};
+std::atomic<uint64_t> s_delivered_bytes{0};
+
+class bench_output : public falco::outputs::abstract_output
+{
+public:
+	explicit bench_output(sink_kind kind): m_kind(kind), m_rng(std::random_device{}()) {}
+
+	void output(const falco::outputs::message* msg) override
+	{
+		switch(m_kind)
+		{
+		case SINK_NULL:
+			break;
+		case SINK_FIXED:
+			std::this_thread::sleep_for(s_sink_latency);
+			break;
+		case SINK_JITTER:
+		{
+			// mostly around the average, with a stall once in a while
+			std::uniform_int_distribution<int64_t> d(0, 2 * s_sink_latency.count());
+			auto latency = std::chrono::microseconds(d(m_rng));
+			if(m_rng() % 1000 == 0)
+			{
+				latency *= 100;
+			}
+			std::this_thread::sleep_for(latency);
+			break;
+		}
+		}
+		s_delivered_bytes.fetch_add(msg->msg.size(), std::memory_order_relaxed);
+		s_num_delivered.fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+	sink_kind m_kind;
+	std::minstd_rand m_rng;
+};
+
+void register_sinks()
+{
+	static std::once_flag once;
+	std::call_once(once, []
+	{
+		for(auto kind : {SINK_NULL, SINK_FIXED, SINK_JITTER})
+		{
+			falco_outputs::register_output(s_sink_names[kind], [kind]
+			{
+				return std::make_unique<bench_output>(kind);
+			});
+		}
+	});
+}
+
+uint64_t epoch_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Shared by the producer threads of a benchmark, which all start and stop
+// together, and set up and torn down by the first one
+std::unique_ptr<bench_falco_engine> s_engine;
+std::unique_ptr<falco_outputs> s_outputs;
+std::vector<sinsp_evt*> s_events;
+uint64_t s_num_allocs = 0;
+
+// the allocations of the formats and of the outputs since the start
+uint64_t num_allocs()
+{
+	return falco::alloc_tracker::num_allocs(falco::alloc_tracker::FORMATS)
+		+ falco::alloc_tracker::num_allocs(falco::alloc_tracker::OUTPUTS);
+}
+
+void setup(const benchmark::State& state)
+{
+	register_sinks();
+	s_num_delivered = 0;
+	s_delivered_bytes = 0;
+	s_engine = std::make_unique<bench_falco_engine>();
+	for(int i = 0; i < state.threads(); i++)
+	{
+		s_events.push_back(s_engine->new_event(PPME_SYSCALL_OPEN_X));
+	}
+
+	falco::outputs::config oc;
+	oc.name = s_sink_names[state.range(0)];
+	falco::outputs::drain_config drain;
+	// the alerts still queued at the end don't count as delivered
+	drain.timeout_ms = 0;
+	s_outputs = std::make_unique<falco_outputs>(
+		s_engine->m_engine,
+		std::vector<falco::outputs::config>{oc},
+		state.range(1) != 0, // json_output
+		true, // json_include_output_property
+		true, // json_include_tags_property
+		2000, // timeout
+		false, // buffered
+		state.range(2), // outputs_queue_capacity
+		0, // outputs_queue_priority_reserve
+		0, // outputs_queue_max_bytes
+		falco::outputs::spill_config{},
+		drain,
+		false, // deferred_formatting
+		falco::outputs::aggregation_config{},
+		false, // time_format_iso_8601
+		"bench-host");
+	s_num_allocs = num_allocs();
+}
+
+// Reports, over the whole benchmark, the alerts output per second, the
+// ones dropped because the queues were full, and the percentiles of the
+// stages of their latency: waiting in the outputs queue, waiting in the
+// queue of the output, and being output
+void teardown(benchmark::State& state)
+{
+	auto queue = s_outputs->get_outputs_queue_metrics();
+	auto metrics = s_outputs->get_outputs_metrics();
+	uint64_t drops = s_outputs->get_outputs_queue_num_drops();
+	for(const auto& d : s_outputs->get_output_queues_num_drops())
+	{
+		drops += d.second;
+	}
+	std::string name = s_sink_names[state.range(0)];
+	auto detection = s_outputs->get_outputs_detection_latencies()[name];
+	uint64_t delivered = s_num_delivered.load();
+	uint64_t bytes = s_delivered_bytes.load();
+	uint64_t allocs = num_allocs() - s_num_allocs;
+	s_outputs.reset();
+	s_events.clear();
+	s_engine.reset();
+
+	state.counters["delivered_per_sec"] = benchmark::Counter(delivered, benchmark::Counter::kIsRate);
+	state.counters["drops_per_sec"] = benchmark::Counter(drops, benchmark::Counter::kIsRate);
+	state.counters["avg_alert_bytes"] = delivered > 0 ? (double) bytes / delivered : 0;
+	for(const auto& p : {"p50", "p99"})
+	{
+		state.counters[std::string("queue_us_") + p] = queue[std::string("latency_us_") + p];
+		state.counters[std::string("output_queue_us_") + p] = metrics[name + ".queue_latency_us_" + p];
+		state.counters[std::string("output_us_") + p] = metrics[name + ".output_latency_us_" + p];
+	}
+	if(falco::alloc_tracker::enabled() && delivered > 0)
+	{
+		state.counters["allocs_per_alert"] = (double) allocs / delivered;
+	}
+	if(detection != nullptr && detection->count() > 0)
+	{
+		state.counters["detection_us_p99"] = detection->percentile_us(99);
+	}
+}
+
+// The producers format alerts of events with handle_event, or send
+// generic messages with handle_msg, as fast as they can. The arguments
+// are the kind of output, whether the alerts are JSON and the capacity
+// of the queues.
+template<bool events>
+void BM_outputs(benchmark::State& state)
+{
+	if(state.thread_index() == 0)
+	{
+		setup(state);
+	}
+
+	const falco::interned_string rule("bench rule");
+	const falco::interned_string source(falco_common::syscall_source);
+	const falco::interned_tags tags{"bench", "outputs"};
+	const std::string format = "File opened (evt.num=%evt.num evt.type=%evt.type proc.name=%proc.name fd.name=%fd.name)";
+	nlohmann::json fields = {{"evt.num", 1}, {"proc.name", "bench"}};
+	uint64_t n = 0;
+	for(auto _ : state)
+	{
+		if constexpr(events)
+		{
+			auto evt = s_events[state.thread_index()];
+			// for the detection latency to only count the outputs
+			reinterpret_cast<scap_evt*>(evt->get_scap_evt())->ts = epoch_ns();
+			s_outputs->handle_event(evt, rule, source, falco_common::PRIORITY_WARNING, format, tags);
+		}
+		else
+		{
+			s_outputs->handle_msg(epoch_ns(), falco_common::PRIORITY_WARNING, "File opened", rule, fields);
+		}
+		n++;
+	}
+	state.SetItemsProcessed(n);
+
+	// all the producers are done by now
+	if(state.thread_index() == 0)
+	{
+		teardown(state);
+	}
+}
+
+void args(benchmark::internal::Benchmark* b)
+{
+	b->ArgNames({"sink", "json", "capacity"});
+	for(auto sink : {SINK_NULL, SINK_FIXED, SINK_JITTER})
+	{
+		for(auto json : {0, 1})
+		{
+			b->Args({sink, json, 1024});
+			b->Args({sink, json, 1000000});
+		}
+	}
+	b->ThreadRange(1, 4);
+	b->UseRealTime();
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_outputs, true)->Name("BM_outputs_handle_event")->Apply(args);
+BENCHMARK_TEMPLATE(BM_outputs, false)->Name("BM_outputs_handle_msg")->Apply(args);
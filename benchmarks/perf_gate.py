@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+#
+# Copyright (C) 2024 The Falco Authors.
+#
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Runs the Falco benchmarks and compares their results with a baseline,
+# failing when the per-event cost of the engine, the rules loading time,
+# the outputs throughput or the replay throughput regress beyond the
+# configured thresholds.
+#
+#   perf_gate.py run -b <build dir> [-c capture.scap]... -o results.json
+#   perf_gate.py compare baseline.json results.json [-t thresholds.json]
+#
+# The results are stored as JSON, with the samples of each metric (one per
+# repetition) so that runs can be compared statistically:
+#
+#   {
+#     "schema_version": 1,
+#     "context": {"date": ..., "host": ..., "num_cpus": ..., "falco_version": ...},
+#     "metrics": {
+#       "<suite>/<benchmark>": {"unit": "ns", "better": "lower", "samples": [...]}
+#     }
+#   }
+#
+# where the suite is engine, rules, outputs, grpc or replay. A metric regresses
+# when its median got worse by more than the threshold of its suite, in
+# percent, and the difference is significant according to a one-sided
+# Mann-Whitney U test, which doesn't assume the samples are normal. With
+# fewer than 3 samples on either side, only the threshold applies.
+
+import argparse
+import datetime
+import itertools
+import json
+import math
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+
+SCHEMA_VERSION = 1
+
+DEFAULT_THRESHOLDS = {
+    "alpha": 0.05,
+    "suites": {
+        "engine": 5.0,
+        "rules": 10.0,
+        "outputs": 15.0,
+        "grpc": 15.0,
+        "replay": 10.0,
+    },
+    # per metric, e.g. {"engine/BM_process_event/rules:1000/match_pct:100/all:1": 8.0}
+    "metrics": {},
+}
+
+# The Google Benchmark binaries, and the measure of each of their benchmarks
+BINARIES = {
+    "engine": ("falco_engine_bench", "time"),
+    "rules": ("falco_rules_bench", "time"),
+    "outputs": ("falco_outputs_bench", "delivered_per_sec"),
+    "grpc": ("falco_grpc_outputs_bench", "delivered_per_sec"),
+}
+
+TIME_UNITS_NS = {"ns": 1, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def run_google_benchmark(binary, measure, repetitions, benchmark_filter, cpu):
+    with tempfile.NamedTemporaryFile(suffix=".json") as out:
+        cmd = [binary,
+               "--benchmark_repetitions=%d" % repetitions,
+               "--benchmark_enable_random_interleaving=true",
+               "--benchmark_out=%s" % out.name,
+               "--benchmark_out_format=json"]
+        if benchmark_filter:
+            cmd.append("--benchmark_filter=%s" % benchmark_filter)
+        if cpu is not None:
+            cmd = ["taskset", "-c", cpu] + cmd
+        subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+        report = json.load(open(out.name))
+
+    metrics = {}
+    for b in report["benchmarks"]:
+        if b.get("run_type") != "iteration" or b.get("error_occurred"):
+            continue
+        if measure == "time":
+            m = metrics.setdefault(b["run_name"], {"unit": "ns", "better": "lower", "samples": []})
+            m["samples"].append(b["real_time"] * TIME_UNITS_NS[b["time_unit"]])
+        elif measure in b:
+            m = metrics.setdefault(b["run_name"], {"unit": measure, "better": "higher", "samples": []})
+            m["samples"].append(b[measure])
+    return metrics
+
+
+def run_replay(falco, config, rules, capture, repetitions, cpu):
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), "replay_bench.sh")
+    cmd = [script, "-f", falco]
+    if config:
+        cmd += ["-c", config]
+    for r in rules:
+        cmd += ["-r", r]
+    cmd.append(capture)
+    if cpu is not None:
+        cmd = ["taskset", "-c", cpu] + cmd
+
+    name = os.path.basename(capture)
+    if rules:
+        name += "/" + "+".join(os.path.basename(r) for r in rules)
+    m = {"unit": "evts_per_sec", "better": "higher", "samples": []}
+    version = None
+    for _ in range(repetitions):
+        out = subprocess.run(cmd, check=True, stdout=subprocess.PIPE, text=True).stdout
+        report = json.loads(out.strip().splitlines()[-1])
+        m["samples"].append(report["evts_per_sec"])
+        version = report.get("falco_version", version)
+    return name, m, version
+
+
+def cmd_run(args):
+    results = {
+        "schema_version": SCHEMA_VERSION,
+        "context": {
+            "date": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+            "host": platform.node(),
+            "machine": platform.machine(),
+            "num_cpus": os.cpu_count(),
+            "cpu": args.cpu,
+        },
+        "metrics": {},
+    }
+
+    for suite, (binary, measure) in BINARIES.items():
+        if args.suites and suite not in args.suites:
+            continue
+        path = os.path.join(args.build_dir, "benchmarks", binary)
+        if not os.path.exists(path):
+            print("skipping the %s suite, %s is not built" % (suite, path), file=sys.stderr)
+            continue
+        for name, m in run_google_benchmark(path, measure, args.repetitions, args.filter, args.cpu).items():
+            results["metrics"][suite + "/" + name] = m
+
+    if args.captures and (not args.suites or "replay" in args.suites):
+        falco = args.falco or os.path.join(args.build_dir, "userspace", "falco", "falco")
+        for capture in args.captures:
+            name, m, version = run_replay(falco, args.config, args.rules, capture, args.replay_repetitions, args.cpu)
+            results["metrics"]["replay/" + name] = m
+            if version:
+                results["context"]["falco_version"] = version
+
+    with open(args.output, "w") as f:
+        json.dump(results, f, indent=2)
+    print("%d metrics written to %s" % (len(results["metrics"]), args.output))
+    return 0
+
+
+def mann_whitney_p(worse, better):
+    """
+    One-sided p-value of the Mann-Whitney U test for the samples of worse
+    being stochastically greater than the ones of better: exact for small
+    samples, normal approximation otherwise
+    """
+    n1, n2 = len(worse), len(better)
+
+    def u_stat(xs, ys):
+        return sum(1.0 if x > y else 0.5 if x == y else 0.0 for x in xs for y in ys)
+
+    u = u_stat(worse, better)
+    pooled = worse + better
+    if math.comb(n1 + n2, n1) <= 20000:
+        count = 0
+        total = 0
+        for idx in itertools.combinations(range(n1 + n2), n1):
+            chosen = set(idx)
+            xs = [pooled[i] for i in idx]
+            ys = [pooled[i] for i in range(n1 + n2) if i not in chosen]
+            total += 1
+            if u_stat(xs, ys) >= u:
+                count += 1
+        return count / total
+
+    mean = n1 * n2 / 2.0
+    sd = math.sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0)
+    z = (u - mean - 0.5) / sd
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+
+def load(path):
+    with open(path) as f:
+        res = json.load(f)
+    if res.get("schema_version") != SCHEMA_VERSION:
+        raise ValueError("%s: unsupported schema version %s" % (path, res.get("schema_version")))
+    return res
+
+
+def cmd_compare(args):
+    baseline = load(args.baseline)
+    current = load(args.results)
+    thresholds = json.loads(json.dumps(DEFAULT_THRESHOLDS))
+    if args.thresholds:
+        with open(args.thresholds) as f:
+            custom = json.load(f)
+        thresholds["alpha"] = custom.get("alpha", thresholds["alpha"])
+        thresholds["suites"].update(custom.get("suites", {}))
+        thresholds["metrics"].update(custom.get("metrics", {}))
+
+    regressions = 0
+    rows = []
+    for name in sorted(set(baseline["metrics"]) | set(current["metrics"])):
+        if name not in baseline["metrics"] or name not in current["metrics"]:
+            rows.append((name, "", "", "", "only in " + ("results" if name in current["metrics"] else "baseline")))
+            continue
+        b = baseline["metrics"][name]
+        c = current["metrics"][name]
+        b_med = statistics.median(b["samples"])
+        c_med = statistics.median(c["samples"])
+        if b_med == 0:
+            continue
+        change = (c_med - b_med) / b_med * 100.0
+        worse = -change if b["better"] == "higher" else change
+        threshold = thresholds["metrics"].get(name, thresholds["suites"].get(name.split("/")[0], 10.0))
+
+        status = "ok"
+        if worse > threshold:
+            significant = True
+            p = None
+            if len(b["samples"]) >= 3 and len(c["samples"]) >= 3:
+                if b["better"] == "lower":
+                    p = mann_whitney_p(c["samples"], b["samples"])
+                else:
+                    p = mann_whitney_p(b["samples"], c["samples"])
+                significant = p < thresholds["alpha"]
+            if significant:
+                status = "REGRESSION"
+                regressions += 1
+            else:
+                status = "noise (p=%.3f)" % p
+        elif worse < -threshold:
+            status = "improvement"
+        rows.append((name, "%.4g" % b_med, "%.4g" % c_med, "%+.1f%%" % change, status))
+
+    width = max([len(r[0]) for r in rows] + [6])
+    print("%-*s %12s %12s %9s  %s" % (width, "metric", "baseline", "current", "change", "status"))
+    for r in rows:
+        print("%-*s %12s %12s %9s  %s" % (width, r[0], r[1], r[2], r[3], r[4]))
+    print("%d regressions" % regressions)
+    return 1 if regressions > 0 else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Falco performance regression gate")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    run = sub.add_parser("run", help="run the benchmarks and store their results")
+    run.add_argument("-b", "--build-dir", required=True, help="the build directory of Falco")
+    run.add_argument("-o", "--output", required=True, help="the results file to write")
+    run.add_argument("-s", "--suites", nargs="*", choices=list(BINARIES) + ["replay"], help="the suites to run (default: all)")
+    run.add_argument("-n", "--repetitions", type=int, default=5, help="the repetitions of each benchmark (default: 5)")
+    run.add_argument("--filter", help="only run the benchmarks matching this regex")
+    run.add_argument("--cpu", help="pin the benchmarks to these CPUs, as for taskset -c, for more stable results")
+    run.add_argument("-c", "--captures", nargs="*", default=[], help="the capture files to replay")
+    run.add_argument("-r", "--rules", action="append", default=[], help="the rules of the replays, can be passed multiple times")
+    run.add_argument("--config", help="the Falco configuration of the replays")
+    run.add_argument("--falco", help="the Falco binary of the replays (default: the one of the build directory)")
+    run.add_argument("--replay-repetitions", type=int, default=3, help="the repetitions of each replay (default: 3)")
+    run.set_defaults(func=cmd_run)
+
+    compare = sub.add_parser("compare", help="compare results with a baseline, failing on regressions")
+    compare.add_argument("baseline", help="the baseline results")
+    compare.add_argument("results", help="the results to check")
+    compare.add_argument("-t", "--thresholds", help="the thresholds, in percent, by suite or metric, and the significance level")
+    compare.set_defaults(func=cmd_compare)
+
+    args = parser.parse_args()
+    try:
+        return args.func(args)
+    except (OSError, ValueError, KeyError, subprocess.CalledProcessError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,109 @@
+#!/usr/bin/env bash
+# SPDX-License-Identifier: Apache-2.0
+#
+# Copyright (C) 2024 The Falco Authors.
+#
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Replays capture files through the whole Falco pipeline, from the inspector
+# to the outputs, and prints the replay report of each one as a JSON line:
+# events and alerts per second, CPU time, time by processing stage, detection
+# latency percentiles by output, peak RSS and the profile of each rule.
+
+set -euo pipefail
+
+usage() {
+	cat <<EOF
+Usage: $0 [-f <falco>] [-c <config>] [-r <rules>]... [-o null|file|http] <capture.scap>...
+
+  -f  Falco binary to benchmark (default: falco in PATH)
+  -c  Falco configuration file (default: the default of Falco)
+  -r  rules file or directory, can be passed multiple times (default: the ones of the configuration)
+  -o  where the alerts are sent: nowhere (null, the default), to a file,
+      or to a local HTTP server answering every request at once (http)
+EOF
+	exit 1
+}
+
+falco="falco"
+config_args=()
+rules_args=()
+outputs="null"
+while getopts "f:c:r:o:h" opt; do
+	case "${opt}" in
+		f) falco="${OPTARG}" ;;
+		c) config_args=(-c "${OPTARG}") ;;
+		r) rules_args+=(-r "${OPTARG}") ;;
+		o) outputs="${OPTARG}" ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+if [ $# -eq 0 ]; then
+	usage
+fi
+
+workdir="$(mktemp -d)"
+server_pid=""
+cleanup() {
+	if [ -n "${server_pid}" ]; then
+		kill "${server_pid}" 2>/dev/null || true
+	fi
+	rm -rf "${workdir}"
+}
+trap cleanup EXIT
+
+output_args=(-o stdout_output.enabled=false -o syslog_output.enabled=false
+	-o file_output.enabled=false -o http_output.enabled=false -o program_output.enabled=false
+	-o grpc_output.enabled=false)
+case "${outputs}" in
+	null) ;;
+	file)
+		output_args+=(-o file_output.enabled=true -o file_output.filename="${workdir}/alerts.txt")
+		;;
+	http)
+		python3 - "${workdir}/port" <<'EOF' &
+import sys
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+class handler(BaseHTTPRequestHandler):
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, *args):
+        pass
+
+server = HTTPServer(("127.0.0.1", 0), handler)
+with open(sys.argv[1], "w") as f:
+    f.write(str(server.server_port))
+server.serve_forever()
+EOF
+		server_pid=$!
+		while [ ! -s "${workdir}/port" ]; do
+			sleep 0.1
+		done
+		output_args+=(-o http_output.enabled=true -o http_output.url="http://127.0.0.1:$(cat "${workdir}/port")/")
+		;;
+	*) usage ;;
+esac
+
+for capture in "$@"; do
+	"${falco}" "${config_args[@]}" "${rules_args[@]}" "${output_args[@]}" \
+		-o engine.kind=replay -o engine.replay.capture_file="${capture}" -o engine.replay.report=true \
+		-o json_output=true -o log_stderr=false -o log_syslog=false -o watch_config_files=false \
+		| grep '"evts_per_sec"'
+done
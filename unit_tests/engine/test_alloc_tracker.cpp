@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/alloc_tracker.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace falco::alloc_tracker;
+
+TEST(AllocTracker, scopes)
+{
+	if (!enabled())
+	{
+		// nothing is counted
+		{
+			scope s(ENGINE);
+			auto p = std::make_unique<int>(1);
+		}
+		EXPECT_EQ(num_allocs(ENGINE), 0u);
+		EXPECT_EQ(live_bytes(), 0);
+		return;
+	}
+
+	auto engine = num_allocs(ENGINE);
+	auto formats = num_allocs(FORMATS);
+	{
+		scope s(ENGINE);
+		auto p = std::make_unique<int>(1);
+		{
+			// the innermost scope wins
+			scope f(FORMATS);
+			auto q = std::make_unique<int>(2);
+		}
+		auto r = std::make_unique<int>(3);
+	}
+	EXPECT_EQ(num_allocs(ENGINE) - engine, 2u);
+	EXPECT_EQ(num_allocs(FORMATS) - formats, 1u);
+
+	// the scopes of a thread don't apply to the other ones
+	std::atomic<bool> go{false};
+	std::thread t([&]
+	{
+		while (!go)
+		{
+			std::this_thread::yield();
+		}
+		auto p = std::make_unique<int>(1);
+	});
+	engine = num_allocs(ENGINE);
+	{
+		scope s(ENGINE);
+		go = true;
+		t.join();
+	}
+	EXPECT_EQ(num_allocs(ENGINE) - engine, 0u);
+}
+
+TEST(AllocTracker, peak)
+{
+	if (!enabled())
+	{
+		GTEST_SKIP() << "the allocations are not counted in this build";
+	}
+
+	reset_peak();
+	auto start = live_bytes();
+	{
+		auto p = std::make_unique<char[]>(1 << 20);
+	}
+	EXPECT_EQ(live_bytes(), start);
+	EXPECT_GE(peak_bytes() - start, 1 << 20);
+}
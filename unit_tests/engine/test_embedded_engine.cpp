@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include <embedded_engine.h>
+#include <falco_engine_version.h>
+#include "../test_events.h"
+
+static const std::string rules_content = R"END(
+- rule: open_file
+  desc: a file is opened
+  condition: evt.type = open
+  output: "opened %fd.name"
+  priority: WARNING
+  tags: [files]
+)END";
+
+TEST(EmbeddedEngine, load_and_evaluate)
+{
+	sinsp inspector;
+	sinsp_filter_check_list filterchecks;
+	auto filter_factory = std::make_shared<sinsp_filter_factory>(&inspector, filterchecks);
+	auto formatter_factory = std::make_shared<sinsp_evt_formatter_factory>(&inspector, filterchecks);
+
+	falco::embedded_engine engine;
+	ASSERT_EQ(falco::embedded_engine::engine_version(), FALCO_ENGINE_VERSION);
+	auto source = engine.add_source("syscall", filter_factory, formatter_factory);
+
+	std::string err, warnings;
+	ASSERT_TRUE(engine.load_rules(rules_content, "rules.yaml", err, warnings)) << err;
+	ASSERT_TRUE(err.empty());
+
+	std::vector<falco::embedded_engine::match> matches;
+	ASSERT_EQ(engine.evaluate(source, nullptr, 0, matches), 0);
+	ASSERT_EQ(engine.evaluate(source + 1, nullptr, 0, matches), 0);
+	ASSERT_TRUE(matches.empty());
+}
+
+TEST(EmbeddedEngine, load_error)
+{
+	sinsp inspector;
+	sinsp_filter_check_list filterchecks;
+	auto filter_factory = std::make_shared<sinsp_filter_factory>(&inspector, filterchecks);
+	auto formatter_factory = std::make_shared<sinsp_evt_formatter_factory>(&inspector, filterchecks);
+
+	falco::embedded_engine engine;
+	engine.add_source("syscall", filter_factory, formatter_factory);
+
+	std::string err, warnings;
+	ASSERT_FALSE(engine.load_rules("- rule: broken\n  condition: evt.type = open\n", "rules.yaml", err, warnings));
+	ASSERT_FALSE(err.empty());
+}
+
+TEST(EmbeddedEngine, evaluate_events)
+{
+	sinsp inspector;
+	sinsp_filter_check_list filterchecks;
+	auto filter_factory = std::make_shared<sinsp_filter_factory>(&inspector, filterchecks);
+	auto formatter_factory = std::make_shared<sinsp_evt_formatter_factory>(&inspector, filterchecks);
+
+	falco::embedded_engine engine;
+	auto source = engine.add_source("syscall", filter_factory, formatter_factory);
+
+	std::string err, warnings;
+	ASSERT_TRUE(engine.load_rules(R"END(
+- rule: open_etc
+  desc: a file of /etc is opened
+  condition: evt.type = openat and fd.name startswith /etc
+  output: "opened %fd.name"
+  priority: WARNING
+  tags: [files]
+
+- rule: less_open
+  desc: less opens a file
+  condition: evt.type = openat and proc.name = less
+  output: "%proc.name opened %fd.name"
+  priority: NOTICE
+)END", "rules.yaml", err, warnings)) << err;
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto less = events.add_process("less");
+	std::vector<sinsp_evt*> evts = {
+		events.open(cat, "/etc/passwd"),
+		events.open(cat, "/tmp/file"),
+		events.close(cat),
+		events.open(less, "/etc/shadow"),
+		events.open(less, "/tmp/file"),
+	};
+
+	std::vector<falco::embedded_engine::match> matches;
+	ASSERT_EQ(engine.evaluate(source, evts.data(), evts.size(), matches), 4);
+	ASSERT_EQ(matches.size(), 4);
+
+	ASSERT_EQ(matches[0].event, 0);
+	ASSERT_EQ(matches[0].rule, "open_etc");
+	ASSERT_EQ(matches[0].source, "syscall");
+	ASSERT_EQ(matches[0].priority, falco_common::PRIORITY_WARNING);
+	ASSERT_EQ(matches[0].tags, std::set<std::string>({"files"}));
+	ASSERT_EQ(matches[0].output, "opened /etc/passwd");
+
+	ASSERT_EQ(matches[1].event, 3);
+	ASSERT_EQ(matches[1].rule, "open_etc");
+	ASSERT_EQ(matches[1].output, "opened /etc/shadow");
+	ASSERT_EQ(matches[2].event, 3);
+	ASSERT_EQ(matches[2].rule, "less_open");
+	ASSERT_EQ(matches[2].output, "less opened /etc/shadow");
+
+	ASSERT_EQ(matches[3].event, 4);
+	ASSERT_EQ(matches[3].rule, "less_open");
+	ASSERT_EQ(matches[3].priority, falco_common::PRIORITY_NOTICE);
+	ASSERT_EQ(matches[3].output, "less opened /tmp/file");
+
+	/* the matches of the next batches are appended, with the indexes
+	of their events in their own batch */
+	engine.enable_rules("open_*", false);
+	ASSERT_EQ(engine.evaluate(source, evts.data() + 3, 2, matches), 2);
+	ASSERT_EQ(matches.size(), 6);
+	ASSERT_EQ(matches[4].event, 0);
+	ASSERT_EQ(matches[4].rule, "less_open");
+	ASSERT_EQ(matches[5].event, 1);
+	ASSERT_EQ(matches[5].rule, "less_open");
+}
@@ -15,7 +15,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <atomic>
+#include <map>
 #include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -24,6 +27,7 @@ limitations under the License.
 #include <filter.h>
 
 #include "../test_falco_engine.h"
+#include "../test_events.h"
 
 static std::string single_rule = R"END(
 - rule: test rule
@@ -284,3 +288,198 @@ TEST_F(test_falco_engine, enable_rule_name_wildcard)
 	EXPECT_EQ(3, m_engine->num_rules_for_ruleset(ruleset_4));
 }
 
+
+static std::string lazy_rules = R"END(
+- rule: enabled rule
+  desc: An enabled rule
+  condition: evt.type=execve and proc.name=a
+  output: An enabled rule matched (evt.type=%evt.type)
+  priority: INFO
+  source: syscall
+
+- rule: lazy rule
+  desc: A disabled rule
+  condition: evt.type=open and proc.name=b
+  output: A disabled rule matched (evt.type=%evt.type)
+  priority: INFO
+  source: syscall
+  enabled: false
+  exceptions:
+    - name: proc_names
+      fields: [proc.pname]
+      values: [[c]]
+)END";
+
+TEST_F(test_falco_engine, disabled_rule_compiled_lazily)
+{
+	ASSERT_TRUE(load_rules(lazy_rules, "lazy_rules.yaml"));
+	EXPECT_NE(m_engine->get_rules().at("enabled rule")->filter, nullptr);
+	EXPECT_EQ(m_engine->get_rules().at("lazy rule")->filter, nullptr);
+	EXPECT_EQ(m_engine->get_rules().at("lazy rule")->num_exceptions, (size_t) 1);
+
+	// the filter is compiled once enabled
+	m_engine->enable_rule_exact("lazy rule", true, ruleset_1);
+	EXPECT_EQ(1, m_engine->num_rules_for_ruleset(ruleset_1));
+	m_engine->enable_rule_exact("lazy rule", true, default_ruleset);
+	EXPECT_EQ(2, m_engine->num_rules_for_ruleset(default_ruleset));
+}
+
+TEST_F(test_falco_engine, disabled_rule_enabled_while_running)
+{
+	std::string rules = R"END(
+- rule: enabled rule
+  desc: An enabled rule
+  condition: evt.type=openat and proc.name=a
+  output: An enabled rule matched (evt.type=%evt.type)
+  priority: INFO
+
+- rule: lazy rule
+  desc: A disabled rule
+  condition: evt.type=openat and proc.name=b and fd.name startswith /etc
+  output: A disabled rule matched (evt.type=%evt.type)
+  priority: INFO
+  enabled: false
+)END";
+
+	std::atomic<size_t> num_created{0};
+	m_engine->set_filter_factory_creator(0, [this, &num_created]()
+	{
+		num_created++;
+		return std::make_shared<sinsp_filter_factory>(&m_inspector, m_filterlist);
+	});
+
+	// not through load_rules(), which enables all the rules in another ruleset
+	m_load_result = m_engine->load_rules(rules, "lazy_rules.yaml");
+	ASSERT_TRUE(m_load_result->successful());
+	m_engine->complete_rule_loading();
+	size_t num_loaded = num_created;
+
+	test_events events(m_inspector);
+	auto b = events.add_process("b");
+	auto evt = events.open(b, "/etc/passwd");
+
+	// the rule is compiled on this thread while the events are processed
+	// on another, which sees it either not yet enabled or enabled
+	std::atomic<bool> enabled{false};
+	size_t num_inconsistent = 0;
+	std::thread runner([&]
+	{
+		std::vector<falco_engine::rule_match> matches;
+		bool matched = false;
+		while(!matched)
+		{
+			bool was_enabled = enabled;
+			matched = m_engine->process_event(0, evt, falco_common::rule_matching::ALL, matches);
+			num_inconsistent += !matched && was_enabled ? 1 : 0;
+			num_inconsistent += matched && (matches.size() != 1 || matches[0].rule->name != "lazy rule") ? 1 : 0;
+		}
+	});
+	m_engine->enable_rule_exact("lazy rule", true);
+	enabled = true;
+	runner.join();
+	EXPECT_EQ(num_inconsistent, 0);
+	EXPECT_EQ(2, num_rules_for_ruleset());
+
+	// the rule was compiled with a filter factory of its own
+	EXPECT_EQ(num_created, num_loaded + 1);
+}
+
+TEST_F(test_falco_engine, disabled_rule_validated)
+{
+	std::string rules = R"END(
+- rule: lazy rule
+  desc: A disabled rule
+  condition: evt.type=open and proc.nonexistent=b
+  output: A disabled rule matched (evt.type=%evt.type)
+  priority: INFO
+  enabled: false
+)END";
+
+	ASSERT_FALSE(load_rules(rules, "lazy_rules.yaml"));
+	ASSERT_TRUE(check_error_message("nonexistent"));
+}
+
+TEST_F(test_falco_engine, rule_enabled_hint)
+{
+	m_engine->set_rule_enabled_hint([](const std::string& name, const std::set<std::string>& tags, bool enabled)
+	{
+		return enabled && name != "enabled rule";
+	});
+	ASSERT_TRUE(load_rules(lazy_rules, "lazy_rules.yaml"));
+	EXPECT_EQ(m_engine->get_rules().at("enabled rule")->filter, nullptr);
+	EXPECT_EQ(m_engine->get_rules().at("lazy rule")->filter, nullptr);
+
+	// the hint doesn't change which rules are enabled
+	EXPECT_EQ(1, m_engine->num_rules_for_ruleset(default_ruleset));
+}
+
+TEST_F(test_falco_engine, process_event_multi)
+{
+	std::string rules_content = R"END(
+- rule: cat_open
+  desc: cat opens a file
+  condition: evt.type = openat and proc.name = cat
+  output: file=%fd.name
+  priority: WARNING
+  tags: [cat]
+
+- rule: etc_open
+  desc: a file of /etc is opened
+  condition: evt.type = openat and fd.name startswith /etc
+  output: file=%fd.name
+  priority: WARNING
+  tags: [etc]
+)END";
+
+	ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+	auto cat_only = m_engine->find_ruleset_id("cat_only");
+	auto etc_only = m_engine->find_ruleset_id("etc_only");
+	m_engine->enable_rule_by_tag(std::set<std::string>{"cat"}, true, cat_only);
+	m_engine->enable_rule_by_tag(std::set<std::string>{"etc"}, true, etc_only);
+	m_engine->complete_rule_loading();
+
+	test_events events(m_inspector);
+	auto cat = events.add_process("cat");
+	auto less = events.add_process("less");
+	std::vector<sinsp_evt*> evts = {
+		events.open(cat, "/etc/passwd"),
+		events.open(cat, "/tmp/file"),
+		events.open(less, "/etc/shadow"),
+		events.open(less, "/tmp/file"),
+	};
+
+	// the matches are the ones of each ruleset in the mask
+	uint64_t both = (1ULL << cat_only) | (1ULL << etc_only);
+	std::vector<falco_engine::multi_rule_match> matches;
+	std::vector<falco_engine::rule_match> single;
+	for(auto mask : {(uint64_t)0, 1ULL << cat_only, 1ULL << etc_only, both})
+	{
+		for(auto* evt : evts)
+		{
+			std::map<std::string, uint64_t> expected;
+			for(auto id : {cat_only, etc_only})
+			{
+				if((mask & (1ULL << id)) && m_engine->process_event(0, evt, id, falco_common::rule_matching::ALL, single))
+				{
+					for(const auto& m : single)
+					{
+						expected[m.rule->name] |= 1ULL << id;
+					}
+				}
+			}
+
+			ASSERT_EQ(m_engine->process_event_multi(0, evt, mask, matches), !expected.empty());
+			std::map<std::string, uint64_t> actual;
+			for(const auto& m : matches)
+			{
+				ASSERT_EQ(m.evt, evt);
+				actual[m.rule->name] = m.rulesets;
+			}
+			ASSERT_EQ(actual, expected) << "mask " << mask << ", event " << evt->get_num();
+		}
+	}
+
+	ASSERT_TRUE(m_engine->process_event_multi(0, evts[0], both, matches));
+	ASSERT_EQ(matches.size(), 2);
+	ASSERT_FALSE(m_engine->process_event_multi(0, evts[3], both, matches));
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/event_sampler.h>
+
+#include <vector>
+
+TEST(EventSampler, keeps_all_by_default)
+{
+	falco::event_sampler s;
+	EXPECT_FALSE(s.enabled());
+	uint64_t counter = 0;
+	for(int i = 0; i < 1000; i++)
+	{
+		EXPECT_TRUE(s.keep(counter));
+	}
+
+	s.set_keep_ratio(1);
+	EXPECT_FALSE(s.enabled());
+	s.set_keep_ratio(0);
+	EXPECT_TRUE(s.enabled());
+	EXPECT_FALSE(s.keep(counter));
+}
+
+TEST(EventSampler, keeps_the_ratio)
+{
+	falco::event_sampler s;
+	s.set_keep_ratio(0.25);
+	EXPECT_TRUE(s.enabled());
+
+	uint64_t counter = 0;
+	int kept = 0;
+	for(int i = 0; i < 100000; i++)
+	{
+		kept += s.keep(counter) ? 1 : 0;
+	}
+	EXPECT_EQ(counter, 100000u);
+	EXPECT_NEAR(kept, 25000, 1000);
+}
+
+TEST(EventSampler, deterministic)
+{
+	auto decisions = [](uint64_t seed)
+	{
+		falco::event_sampler s;
+		s.set_keep_ratio(0.5);
+		s.set_seed(seed);
+		uint64_t counter = 0;
+		std::vector<bool> res;
+		for(int i = 0; i < 256; i++)
+		{
+			res.push_back(s.keep(counter));
+		}
+		return res;
+	};
+
+	EXPECT_EQ(decisions(42), decisions(42));
+	EXPECT_NE(decisions(42), decisions(43));
+}
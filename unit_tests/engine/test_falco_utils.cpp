@@ -101,3 +101,65 @@ TEST(FalcoUtils, matches_wildcard)
 	ASSERT_FALSE(falco::utils::matches_wildcard("*hello*world", "come on hello this world yes"));
 	ASSERT_FALSE(falco::utils::matches_wildcard("*hello*world*", "come on hello this yes"));
 }
+
+TEST(FalcoUtils, append_json_string)
+{
+	std::string out = "x:";
+	falco::utils::append_json_string(out, "plain");
+	ASSERT_EQ(out, "x:\"plain\"");
+
+	out.clear();
+	falco::utils::append_json_string(out, "");
+	ASSERT_EQ(out, "\"\"");
+
+	out.clear();
+	falco::utils::append_json_string(out, "a\"b\\c\nd\te\r\b\f");
+	ASSERT_EQ(out, "\"a\\\"b\\\\c\\nd\\te\\r\\b\\f\"");
+
+	out.clear();
+	falco::utils::append_json_string(out, std::string("\x01\x1f", 2));
+	ASSERT_EQ(out, "\"\\u0001\\u001f\"");
+
+	out.clear();
+	falco::utils::append_json_string(out, "caf\xc3\xa9 /x");
+	ASSERT_EQ(out, "\"caf\xc3\xa9 /x\"");
+}
+
+TEST(FalcoUtils, append_iso8601_utc)
+{
+	std::string out = "t=";
+	falco::utils::append_iso8601_utc(out, 1700000000123456789);
+	ASSERT_EQ(out, "t=2023-11-14T22:13:20.123456789Z");
+
+	// the cached second is reused, and only the fraction changes
+	out.clear();
+	falco::utils::append_iso8601_utc(out, 1700000000000000042);
+	ASSERT_EQ(out, "2023-11-14T22:13:20.000000042Z");
+
+	out.clear();
+	falco::utils::append_iso8601_utc(out, 1700000001123456789, 6);
+	ASSERT_EQ(out, "2023-11-14T22:13:21.123456Z");
+
+	out.clear();
+	falco::utils::append_iso8601_utc(out, 0, 0);
+	ASSERT_EQ(out, "1970-01-01T00:00:00Z");
+
+	ASSERT_STREQ(falco::utils::iso8601_utc_seconds(1700000000), "2023-11-14T22:13:20");
+}
+
+TEST(FalcoUtils, parse_cpu_list)
+{
+	std::vector<uint32_t> cpus;
+	ASSERT_TRUE(falco::utils::parse_cpu_list("3", cpus));
+	ASSERT_EQ(cpus, std::vector<uint32_t>({3}));
+	ASSERT_TRUE(falco::utils::parse_cpu_list("0-2,8, 5-6,1", cpus));
+	ASSERT_EQ(cpus, std::vector<uint32_t>({0, 1, 2, 5, 6, 8}));
+
+	ASSERT_FALSE(falco::utils::parse_cpu_list("", cpus));
+	ASSERT_FALSE(falco::utils::parse_cpu_list("a", cpus));
+	ASSERT_FALSE(falco::utils::parse_cpu_list("1x", cpus));
+	ASSERT_FALSE(falco::utils::parse_cpu_list("3-1", cpus));
+	ASSERT_FALSE(falco::utils::parse_cpu_list("-1", cpus));
+	ASSERT_FALSE(falco::utils::parse_cpu_list("1-", cpus));
+	ASSERT_FALSE(falco::utils::parse_cpu_list("0-4294967295", cpus));
+}
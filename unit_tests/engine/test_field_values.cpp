@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <engine/falco_common.h>
+#include <engine/field_values.h>
+
+TEST(FieldValues, assign_from_map_reuses_storage)
+{
+	falco::field_values fields;
+	falco::assign_field_values(fields, std::map<std::string, std::string>{
+		{"proc.name", "a rather long process name"},
+		{"fd.name", "/etc/passwd"},
+	});
+	ASSERT_EQ(fields.size(), 2);
+	EXPECT_EQ(fields[0].first, "fd.name");
+	EXPECT_EQ(fields[1].first, "proc.name");
+	EXPECT_EQ(fields[1].second.type, falco::field_value::FV_STRING);
+	EXPECT_EQ(fields[1].second.str, "a rather long process name");
+
+	// the same fields, as for alerts of the same rule
+	auto data = fields[1].second.str.data();
+	falco::assign_field_values(fields, std::map<std::string, std::string>{
+		{"proc.name", "bash"},
+		{"fd.name", "/tmp"},
+	});
+	ASSERT_EQ(fields.size(), 2);
+	EXPECT_EQ(fields[0].second.str, "/tmp");
+	EXPECT_EQ(fields[1].second.str, "bash");
+	EXPECT_EQ(fields[1].second.str.data(), data);
+
+	falco::assign_field_values(fields, std::map<std::string, std::string>{
+		{"proc.name", "sh"},
+	});
+	ASSERT_EQ(fields.size(), 1);
+	EXPECT_EQ(fields[0].first, "proc.name");
+	EXPECT_EQ(fields[0].second.str, "sh");
+}
+
+TEST(FieldValues, assign_from_json)
+{
+	auto j = nlohmann::json::parse(R"({"b": true, "d": 0.5, "i": -3, "n": null, "s": "x\"y", "u": 18446744073709551615})");
+	falco::field_values fields;
+	falco::assign_field_values(fields, j);
+	ASSERT_EQ(fields.size(), 6);
+	EXPECT_EQ(fields[0].second.type, falco::field_value::FV_BOOL);
+	EXPECT_EQ(fields[1].second.type, falco::field_value::FV_DOUBLE);
+	EXPECT_EQ(fields[2].second.type, falco::field_value::FV_INT);
+	EXPECT_EQ(fields[3].second.type, falco::field_value::FV_NULL);
+	EXPECT_EQ(fields[4].second.type, falco::field_value::FV_STRING);
+	EXPECT_EQ(fields[5].second.type, falco::field_value::FV_UINT);
+
+	std::string text;
+	for(const auto& f : fields)
+	{
+		f.second.append_text(text);
+		text += ' ';
+	}
+	EXPECT_EQ(text, "true 0.5 -3 null x\"y 18446744073709551615 ");
+
+	std::string json;
+	falco::append_json(json, fields);
+	EXPECT_EQ(nlohmann::json::parse(json), j);
+
+	EXPECT_THROW(falco::assign_field_values(fields, nlohmann::json::array()), falco_exception);
+	EXPECT_THROW(falco::assign_field_values(fields, nlohmann::json::parse(R"({"a": [1]})")), falco_exception);
+}
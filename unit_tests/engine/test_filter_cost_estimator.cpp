@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <engine/filter_cost_estimator.h>
+
+static filter_cost estimate(const std::string& cond)
+{
+	auto ast = libsinsp::filter::parser(cond).parse();
+	filter_cost cost;
+	filter_cost_estimator().run(ast.get(), cost);
+	return cost;
+}
+
+TEST(CostEstimator, plain_checks)
+{
+	auto cost = estimate("evt.type = open and proc.name = cat and not fd.name exists");
+	ASSERT_EQ(cost.predicates, 3);
+	ASSERT_EQ(cost.list_values, 0);
+	ASSERT_TRUE(cost.expensive_operators.empty());
+	ASSERT_TRUE(cost.expensive_fields.empty());
+	ASSERT_EQ(cost.cost, 3);
+}
+
+TEST(CostEstimator, lists)
+{
+	auto cost = estimate("proc.name in (cat, ls, ps) or fd.name pmatch (/etc, /usr)");
+	ASSERT_EQ(cost.predicates, 2);
+	ASSERT_EQ(cost.list_values, 5);
+	ASSERT_EQ(cost.largest_list, 3);
+	ASSERT_EQ(cost.expensive_operators, std::set<std::string>({"pmatch"}));
+	ASSERT_EQ(cost.cost, 1 + 4);
+
+	std::string values;
+	for(int i = 0; i < 250; i++)
+	{
+		values += (i == 0 ? "" : ", ") + std::to_string(i);
+	}
+	cost = estimate("proc.pid in (" + values + ")");
+	ASSERT_EQ(cost.largest_list, 250);
+	ASSERT_EQ(cost.cost, 1 + 2);
+}
+
+TEST(CostEstimator, expensive_operators_and_fields)
+{
+	auto cost = estimate("fd.name glob '/etc/*' and proc.cmdline icontains curl and proc.aname[2] = bash and proc.apid = 1");
+	ASSERT_EQ(cost.predicates, 4);
+	ASSERT_EQ(cost.expensive_operators, std::set<std::string>({"glob", "icontains"}));
+	ASSERT_EQ(cost.expensive_fields, std::set<std::string>({"proc.aname", "proc.apid"}));
+	ASSERT_EQ(cost.cost, 8 + 4 + (5 + 1) + (5 + 1));
+}
+
+TEST(CostEstimator, accumulate_and_reset)
+{
+	auto ast = libsinsp::filter::parser("proc.name = cat").parse();
+	filter_cost cost;
+	filter_cost_estimator estimator;
+	estimator.run(ast.get(), cost);
+	estimator.run(ast.get(), cost);
+	ASSERT_EQ(cost.predicates, 2);
+	ASSERT_EQ(cost.cost, 2);
+	cost.reset();
+	ASSERT_EQ(cost.predicates, 0);
+	ASSERT_EQ(cost.cost, 0);
+}
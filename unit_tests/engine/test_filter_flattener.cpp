@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/filter_flattener.h>
+
+static std::string flattened(const std::string& condition)
+{
+	std::shared_ptr<libsinsp::filter::ast::expr> ast = libsinsp::filter::parser(condition).parse();
+	filter_flattener().run(ast);
+	return libsinsp::filter::ast::as_string(ast.get());
+}
+
+static std::string parsed(const std::string& condition)
+{
+	auto ast = libsinsp::filter::parser(condition).parse();
+	return libsinsp::filter::ast::as_string(ast.get());
+}
+
+TEST(Flattener, flatten_nested_expressions)
+{
+	ASSERT_EQ(flattened("a.f = 1 and (b.f = 2 and (c.f = 3 and d.f = 4))"), parsed("a.f = 1 and b.f = 2 and c.f = 3 and d.f = 4"));
+	ASSERT_EQ(flattened("(a.f = 1 or b.f = 2) or c.f = 3"), parsed("a.f = 1 or b.f = 2 or c.f = 3"));
+	ASSERT_EQ(flattened("a.f = 1 and (b.f = 2 or (c.f = 3 or d.f = 4))"), parsed("a.f = 1 and (b.f = 2 or c.f = 3 or d.f = 4)"));
+	ASSERT_EQ(flattened("not not a.f = 1"), parsed("a.f = 1"));
+	ASSERT_EQ(flattened("not (not (a.f = 1 and (b.f = 2 and c.f = 3)))"), parsed("a.f = 1 and b.f = 2 and c.f = 3"));
+}
+
+TEST(Flattener, remove_duplicates)
+{
+	ASSERT_EQ(flattened("a.f = 1 and (b.f = 2 and a.f = 1)"), parsed("a.f = 1 and b.f = 2"));
+	ASSERT_EQ(flattened("a.f = 1 or a.f = 1"), parsed("a.f = 1"));
+	ASSERT_EQ(flattened("a.f = 1 and (a.f = 1 or b.f = 2)"), parsed("a.f = 1 and (a.f = 1 or b.f = 2)"));
+}
+
+TEST(Flattener, keep_simple_expressions)
+{
+	ASSERT_EQ(flattened("a.f = 1"), parsed("a.f = 1"));
+	ASSERT_EQ(flattened("not a.f = 1"), parsed("not a.f = 1"));
+	ASSERT_EQ(flattened("a.f = 1 and (b.f = 2 or c.f = 3)"), parsed("a.f = 1 and (b.f = 2 or c.f = 3)"));
+}
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/filter_list_resolver.h>
+
+namespace filter_ast = libsinsp::filter::ast;
+
+static std::shared_ptr<filter_ast::expr> parse(const std::string& s)
+{
+	libsinsp::filter::parser parser(s);
+	return parser.parse();
+}
+
+TEST(ListResolver, should_resolve_lists_in_list_expressions)
+{
+	filter_list_resolver resolver;
+	resolver.set_list("shells", {"bash", "sh", "my shell"});
+	resolver.set_list("unused", {"a"});
+
+	auto filter = parse("evt.type = execve and not proc.name in (zsh, shells, fish) or proc.pname pmatch (shells)");
+	auto expected = parse("evt.type = execve and not proc.name in (zsh, bash, sh, \"my shell\", fish) or proc.pname pmatch (bash, sh, \"my shell\")");
+
+	ASSERT_TRUE(resolver.run(filter));
+	ASSERT_EQ(resolver.get_resolved_lists().size(), 1);
+	ASSERT_EQ(resolver.get_resolved_lists().count("shells"), 1);
+	ASSERT_TRUE(filter->is_equal(expected.get()));
+
+	// second run
+	ASSERT_FALSE(resolver.run(filter));
+	ASSERT_TRUE(resolver.get_resolved_lists().empty());
+	ASSERT_TRUE(filter->is_equal(expected.get()));
+}
+
+TEST(ListResolver, should_resolve_single_item_lists_in_checks)
+{
+	filter_list_resolver resolver;
+	resolver.set_list("my_shell", {"bash"});
+	resolver.set_list("shells", {"bash", "sh"});
+
+	auto filter = parse("proc.name = my_shell or proc.name = zsh");
+	auto expected = parse("proc.name = bash or proc.name = zsh");
+
+	ASSERT_TRUE(resolver.run(filter));
+	ASSERT_EQ(resolver.get_resolved_lists().size(), 1);
+	ASSERT_EQ(resolver.get_resolved_lists().count("my_shell"), 1);
+	ASSERT_TRUE(resolver.get_errors().empty());
+	ASSERT_TRUE(filter->is_equal(expected.get()));
+}
+
+TEST(ListResolver, should_fail_on_multi_item_lists_in_checks)
+{
+	filter_list_resolver resolver;
+	resolver.set_list("shells", {"bash", "sh"});
+	resolver.set_list("empty", {});
+
+	auto filter = parse("proc.name = zsh or proc.name = shells");
+	auto expected = parse("proc.name = zsh or proc.name = shells");
+
+	ASSERT_FALSE(resolver.run(filter));
+	ASSERT_TRUE(resolver.get_resolved_lists().empty());
+	ASSERT_EQ(resolver.get_errors().size(), 1);
+	ASSERT_NE(resolver.get_errors()[0].first.find("shells"), std::string::npos);
+	ASSERT_TRUE(filter->is_equal(expected.get()));
+
+	filter = parse("proc.name != empty");
+	ASSERT_FALSE(resolver.run(filter));
+	ASSERT_EQ(resolver.get_errors().size(), 1);
+	ASSERT_NE(resolver.get_errors()[0].first.find("empty"), std::string::npos);
+
+	// errors are reset on each run
+	filter = parse("proc.name = zsh");
+	ASSERT_FALSE(resolver.run(filter));
+	ASSERT_TRUE(resolver.get_errors().empty());
+}
+
+TEST(ListResolver, should_resolve_empty_and_quoted_lists)
+{
+	filter_list_resolver resolver;
+	resolver.set_list("empty", {});
+	resolver.set_list("quoted", {"'/usr/bin/a b'", "\"c\""});
+
+	auto filter = parse("proc.name in (empty) and fd.name in (foo, quoted)");
+	auto expected = parse("proc.name in () and fd.name in (foo, '/usr/bin/a b', c)");
+
+	ASSERT_TRUE(resolver.run(filter));
+	ASSERT_EQ(resolver.get_resolved_lists().size(), 2);
+	ASSERT_TRUE(filter->is_equal(expected.get()));
+}
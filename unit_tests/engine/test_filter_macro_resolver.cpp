@@ -279,3 +279,33 @@ TEST(MacroResolver, should_clone_macro_AST)
 	macro->left = filter_ast::field_expr::create("another.field", "");
 	ASSERT_FALSE(filter->is_equal(macro.get()));
 }
+
+TEST(MacroResolver, should_not_visit_expanded_macros_again)
+{
+	filter_ast::pos_info macro_pos(12, 85, 27);
+
+	// a reference left in an expanded macro is not resolved again
+	std::vector<std::unique_ptr<filter_ast::expr>> macro_a_and;
+	macro_a_and.push_back(filter_ast::unary_check_expr::create(filter_ast::field_expr::create("test.field", ""), "exists"));
+	macro_a_and.push_back(filter_ast::identifier_expr::create(MACRO_B_NAME, macro_pos));
+	std::shared_ptr<filter_ast::expr> macro_a = filter_ast::and_expr::create(macro_a_and);
+	std::shared_ptr<filter_ast::expr> macro_b = filter_ast::unary_check_expr::create(filter_ast::field_expr::create("another.field", ""), "exists");
+
+	std::shared_ptr<filter_ast::expr> filter = filter_ast::not_expr::create(filter_ast::identifier_expr::create(MACRO_A_NAME, macro_pos));
+	std::shared_ptr<filter_ast::expr> expected = filter_ast::not_expr::create(clone(macro_a.get()));
+
+	filter_macro_resolver resolver;
+	resolver.set_expanded_macro(MACRO_A_NAME, macro_a);
+	resolver.set_macro(MACRO_B_NAME, macro_b);
+
+	ASSERT_TRUE(resolver.run(filter));
+	ASSERT_EQ(resolver.get_resolved_macros().size(), 1);
+	ASSERT_STREQ(resolver.get_resolved_macros().begin()->first.c_str(), MACRO_A_NAME);
+	ASSERT_EQ(resolver.get_resolved_macros().begin()->second, macro_pos);
+	ASSERT_TRUE(resolver.get_unknown_macros().empty());
+	ASSERT_TRUE(filter->is_equal(expected.get()));
+
+	// the macro is cloned, not moved
+	ASSERT_NE(filter.get(), macro_a.get());
+	ASSERT_TRUE(static_cast<filter_ast::not_expr*>(filter.get())->child->is_equal(macro_a.get()));
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/filter_or_merger.h>
+
+static std::string merged(const std::string& condition)
+{
+	std::shared_ptr<libsinsp::filter::ast::expr> ast = libsinsp::filter::parser(condition).parse();
+	filter_or_merger().run(ast);
+	return libsinsp::filter::ast::as_string(ast.get());
+}
+
+static std::string parsed(const std::string& condition)
+{
+	auto ast = libsinsp::filter::parser(condition).parse();
+	return libsinsp::filter::ast::as_string(ast.get());
+}
+
+TEST(OrMerger, merge_equality_checks)
+{
+	ASSERT_EQ(merged("proc.name = a or proc.name = b"), parsed("proc.name in (a, b)"));
+	ASSERT_EQ(merged("proc.name = a or proc.name in (b, a) or fd.num = 1"), parsed("proc.name in (a, b) or fd.num = 1"));
+	ASSERT_EQ(merged("evt.type = open and (proc.name = a or proc.name = b)"), parsed("evt.type = open and proc.name in (a, b)"));
+	ASSERT_EQ(merged("not (proc.name = a or fd.num = 1 or proc.name = b)"), parsed("not (proc.name in (a, b) or fd.num = 1)"));
+	ASSERT_EQ(merged("proc.aname[2] = a or proc.aname[3] = b"), parsed("proc.aname[2] = a or proc.aname[3] = b"));
+}
+
+TEST(OrMerger, keep_other_checks)
+{
+	ASSERT_EQ(merged("proc.name = a"), parsed("proc.name = a"));
+	ASSERT_EQ(merged("proc.name = a and proc.name = b"), parsed("proc.name = a and proc.name = b"));
+	ASSERT_EQ(merged("proc.name != a or proc.name != b"), parsed("proc.name != a or proc.name != b"));
+	ASSERT_EQ(merged("fd.name startswith /a or fd.name startswith /b"), parsed("fd.name startswith /a or fd.name startswith /b"));
+}
+
+TEST(OrMerger, merge_regex_checks)
+{
+	ASSERT_EQ(merged("proc.name regex a.* or proc.name regex b.*"), parsed("proc.name regex \"(?:a.*)|(?:b.*)\""));
+	ASSERT_EQ(merged("proc.name regex a or fd.num = 1 or proc.name regex b or proc.name = c"), parsed("proc.name regex \"(?:a)|(?:b)\" or fd.num = 1 or proc.name = c"));
+	ASSERT_EQ(merged("proc.name regex a or proc.name regex a"), parsed("proc.name regex a"));
+	ASSERT_EQ(merged("proc.name regex a or fd.name regex b"), parsed("proc.name regex a or fd.name regex b"));
+	ASSERT_EQ(merged("proc.name regex a and proc.name regex b"), parsed("proc.name regex a and proc.name regex b"));
+
+	// invalid patterns are left as they are, to be reported as usual
+	ASSERT_EQ(merged("proc.name regex \"a)|(b\" or proc.name regex c"), parsed("proc.name regex \"a)|(b\" or proc.name regex c"));
+}
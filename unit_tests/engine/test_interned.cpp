@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <sstream>
+
+#include <engine/interned.h>
+
+TEST(Interned, equal_values_share_storage)
+{
+	falco::interned_string a = "some rule";
+	falco::interned_string b = std::string("some rule");
+	falco::interned_string c = "other rule";
+
+	EXPECT_EQ(&a.get(), &b.get());
+	EXPECT_NE(&a.get(), &c.get());
+	EXPECT_EQ(a, b);
+	EXPECT_NE(a, c);
+
+	falco::interned_tags t1 = {"a", "b"};
+	falco::interned_tags t2 = std::set<std::string>({"b", "a"});
+	EXPECT_EQ(&t1.get(), &t2.get());
+	EXPECT_EQ(t1, std::set<std::string>({"a", "b"}));
+}
+
+TEST(Interned, default_is_empty)
+{
+	falco::interned_string s;
+	falco::interned_tags t;
+	EXPECT_TRUE(s.empty());
+	EXPECT_TRUE(t.empty());
+	EXPECT_EQ(s, "");
+	EXPECT_EQ(s, falco::interned_string(""));
+}
+
+TEST(Interned, string_operations)
+{
+	falco::interned_string s = "rule";
+	EXPECT_EQ("my " + s, "my rule");
+	EXPECT_EQ(s + " name", "rule name");
+	EXPECT_EQ(std::string("my ") + s, "my rule");
+	EXPECT_EQ(s.size(), 4u);
+	EXPECT_STREQ(s.c_str(), "rule");
+
+	std::stringstream ss;
+	ss << s;
+	EXPECT_EQ(ss.str(), "rule");
+}
+
+TEST(Interned, to_json)
+{
+	nlohmann::json j;
+	j["name"] = falco::interned_string("rule");
+	j["tags"] = falco::interned_tags({"a", "b"});
+	EXPECT_EQ(j.dump(), R"({"name":"rule","tags":["a","b"]})");
+}
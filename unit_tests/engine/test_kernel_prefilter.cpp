@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include "../test_falco_engine.h"
+
+static std::string prefilter_rules = R"END(
+- macro: successful
+  condition: evt.res = SUCCESS
+
+- rule: open etc
+  desc: open etc
+  condition: evt.type = open and successful and fd.name startswith /etc
+  output: open etc
+  priority: INFO
+
+- rule: connect
+  desc: connect
+  condition: evt.type = connect and evt.dir = < and evt.rawres >= 0
+  output: connect
+  priority: INFO
+
+- rule: any open
+  desc: any open
+  condition: evt.type = open and (evt.res = SUCCESS or fd.name startswith /tmp)
+  output: any open
+  priority: INFO
+)END";
+
+TEST_F(test_falco_engine, kernel_prefilter_drop_failed_exit)
+{
+	ASSERT_TRUE(load_rules(prefilter_rules, "prefilter_rules.yaml")) << m_load_result_string;
+
+	// a success required only in a disjunction doesn't count
+	auto p = m_engine->kernel_prefilter_for_ruleset(falco_common::syscall_source);
+	EXPECT_FALSE(p.drop_failed_exit);
+	EXPECT_EQ(p.unfiltered_rules, std::vector<std::string>({"any open"}));
+
+	m_engine->enable_rule_exact("any open", false);
+	p = m_engine->kernel_prefilter_for_ruleset(falco_common::syscall_source);
+	EXPECT_TRUE(p.drop_failed_exit);
+	EXPECT_TRUE(p.unfiltered_rules.empty());
+
+	m_engine->enable_rule_exact("connect", false);
+	m_engine->enable_rule_exact("any open", true);
+	p = m_engine->kernel_prefilter_for_ruleset(falco_common::syscall_source);
+	EXPECT_FALSE(p.drop_failed_exit);
+}
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/logger.h>
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+
+// Logs to stderr only, with no limit, and restores the logger when done
+class logger_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_stderr = falco_logger::log_stderr;
+		m_syslog = falco_logger::log_syslog;
+		falco_logger::log_stderr = true;
+		falco_logger::log_syslog = false;
+		falco_logger::set_repeated_rate_limit(0);
+	}
+
+	void TearDown() override
+	{
+		falco_logger::stop_async();
+		falco_logger::set_repeated_rate_limit(0);
+		falco_logger::log_stderr = m_stderr;
+		falco_logger::log_syslog = m_syslog;
+	}
+
+	static size_t count(const std::string& text, const std::string& what)
+	{
+		size_t n = 0;
+		for(size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+		{
+			n++;
+		}
+		return n;
+	}
+
+private:
+	bool m_stderr = false;
+	bool m_syslog = false;
+};
+
+} // namespace
+
+TEST_F(logger_test, repeated_rate_limit)
+{
+	falco_logger::set_repeated_rate_limit(2);
+	auto suppressed = falco_logger::get_num_suppressed();
+	testing::internal::CaptureStderr();
+	for(int i = 0; i < 5; i++)
+	{
+		falco_logger::log(falco_logger::level::ERR, "repeated message\n");
+	}
+	falco_logger::log(falco_logger::level::ERR, "other message\n");
+	auto out = testing::internal::GetCapturedStderr();
+
+	// the limit is per second, so the test can only straddle two of them
+	auto written = count(out, "repeated message");
+	ASSERT_GE(written, 2u);
+	ASSERT_LE(written, 4u);
+	ASSERT_EQ(falco_logger::get_num_suppressed() - suppressed, 5 - written);
+	ASSERT_EQ(count(out, "other message"), 1u);
+}
+
+TEST_F(logger_test, async)
+{
+	auto dropped = falco_logger::get_num_dropped();
+	falco_logger::start_async(4);
+	testing::internal::CaptureStderr();
+	for(int i = 0; i < 100; i++)
+	{
+		falco_logger::log(falco_logger::level::ERR, "async message " + std::to_string(i) + "\n");
+	}
+	// the queued logs are all written when stopping
+	falco_logger::stop_async();
+	auto out = testing::internal::GetCapturedStderr();
+
+	auto written = count(out, "async message");
+	ASSERT_GT(written, 0u);
+	ASSERT_EQ(written + falco_logger::get_num_dropped() - dropped, 100u);
+	ASSERT_NE(out.find("async message 0\n"), std::string::npos);
+
+	// once stopped, the logs are written at once
+	testing::internal::CaptureStderr();
+	falco_logger::log(falco_logger::level::ERR, "sync message\n");
+	ASSERT_EQ(count(testing::internal::GetCapturedStderr(), "sync message"), 1u);
+}
+
+TEST_F(logger_test, disabled_level)
+{
+	auto level = falco_logger::current_level;
+	falco_logger::current_level = falco_logger::level::INFO;
+	bool built = false;
+	auto msg = [&built]()
+	{
+		built = true;
+		return std::string("lazy message\n");
+	};
+
+	// the messages of the disabled levels are not built
+	FALCO_LOG(falco_logger::level::DEBUG, msg());
+	ASSERT_FALSE(built);
+
+	testing::internal::CaptureStderr();
+	FALCO_LOG(falco_logger::level::INFO, msg());
+	auto out = testing::internal::GetCapturedStderr();
+	ASSERT_TRUE(built);
+	ASSERT_EQ(count(out, "lazy message"), 1u);
+	falco_logger::current_level = level;
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/network_matcher.h>
+#include <libsinsp/sinsp.h>
+
+#include <arpa/inet.h>
+
+static bool match_port(const network_matcher& m, uint16_t port)
+{
+	return m.match((const uint8_t*) &port, sizeof(port));
+}
+
+static bool match_v4(const network_matcher& m, uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	uint8_t addr[4] = {a, b, c, d};
+	return m.match(addr, sizeof(addr));
+}
+
+static bool match_v6(const network_matcher& m, const std::string& s)
+{
+	uint8_t addr[16];
+	EXPECT_EQ(inet_pton(AF_INET6, s.c_str(), addr), 1);
+	return m.match(addr, sizeof(addr));
+}
+
+TEST(NetworkMatcher, ports)
+{
+	auto m = network_matcher::create(PT_PORT, "in", {"443", "80", "8080"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_port(*m, 80));
+	EXPECT_TRUE(match_port(*m, 443));
+	EXPECT_TRUE(match_port(*m, 8080));
+	EXPECT_FALSE(match_port(*m, 81));
+	EXPECT_FALSE(match_port(*m, 0));
+
+	m = network_matcher::create(PT_PORT, "=", {"22"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_port(*m, 22));
+	EXPECT_FALSE(match_port(*m, 23));
+
+	// more ports than the packed ones
+	std::vector<std::string> values;
+	for(size_t i = 0; i <= network_matcher::max_packed_ports; i++)
+	{
+		values.push_back(std::to_string(1000 + 2 * i));
+	}
+	m = network_matcher::create(PT_PORT, "in", values);
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_port(*m, 1000));
+	EXPECT_TRUE(match_port(*m, 1000 + 2 * network_matcher::max_packed_ports));
+	EXPECT_FALSE(match_port(*m, 1001));
+	EXPECT_FALSE(match_port(*m, 999));
+}
+
+TEST(NetworkMatcher, port_ranges)
+{
+	auto m = network_matcher::create(PT_PORT, ">=", {"1024"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_port(*m, 1024));
+	EXPECT_TRUE(match_port(*m, 65535));
+	EXPECT_FALSE(match_port(*m, 1023));
+
+	m = network_matcher::create(PT_PORT, "<", {"1024"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_port(*m, 0));
+	EXPECT_TRUE(match_port(*m, 1023));
+	EXPECT_FALSE(match_port(*m, 1024));
+
+	m = network_matcher::create(PT_PORT, ">", {"65535"});
+	EXPECT_EQ(m, nullptr);
+}
+
+TEST(NetworkMatcher, unsupported)
+{
+	EXPECT_EQ(network_matcher::create(PT_PORT, "in", {"80", "http"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_PORT, "=", {"65536"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_PORT, "!=", {"80"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_PORT, "in", {}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_IPV4ADDR, "in", {"10.0.0.0/8"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_IPV4ADDR, "=", {"::1"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_IPNET, "in", {"10.0.0.1"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_IPNET, "in", {"10.0.0.0/33"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_IPNET, "startswith", {"10.0.0.0/8"}), nullptr);
+	EXPECT_EQ(network_matcher::create(PT_CHARBUF, "=", {"80"}), nullptr);
+}
+
+TEST(NetworkMatcher, addresses)
+{
+	auto m = network_matcher::create(PT_IPADDR, "in", {"10.0.0.1", "192.168.1.1", "2001:db8::1"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_v4(*m, 10, 0, 0, 1));
+	EXPECT_TRUE(match_v4(*m, 192, 168, 1, 1));
+	EXPECT_FALSE(match_v4(*m, 10, 0, 0, 2));
+	EXPECT_TRUE(match_v6(*m, "2001:db8::1"));
+	EXPECT_FALSE(match_v6(*m, "2001:db8::2"));
+}
+
+TEST(NetworkMatcher, networks)
+{
+	auto m = network_matcher::create(PT_IPNET, "in",
+		{"10.0.0.0/8", "10.1.0.0/16", "192.168.0.0/16", "0.0.0.0/32", "2001:db8::/32", "fe80::/10"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_v4(*m, 10, 0, 0, 0));
+	EXPECT_TRUE(match_v4(*m, 10, 255, 255, 255));
+	EXPECT_TRUE(match_v4(*m, 192, 168, 3, 4));
+	EXPECT_TRUE(match_v4(*m, 0, 0, 0, 0));
+	EXPECT_FALSE(match_v4(*m, 0, 0, 0, 1));
+	EXPECT_FALSE(match_v4(*m, 11, 0, 0, 0));
+	EXPECT_FALSE(match_v4(*m, 192, 169, 0, 0));
+	EXPECT_TRUE(match_v6(*m, "2001:db8:ffff::1"));
+	EXPECT_TRUE(match_v6(*m, "febf::1"));
+	EXPECT_FALSE(match_v6(*m, "2001:db9::1"));
+	EXPECT_FALSE(match_v6(*m, "fec0::1"));
+
+	m = network_matcher::create(PT_IPNET, "=", {"0.0.0.0/0"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_v4(*m, 255, 255, 255, 255));
+	EXPECT_FALSE(match_v6(*m, "::1"));
+
+	m = network_matcher::create(PT_IPV6NET, "=", {"2001:db8::1/128"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_v6(*m, "2001:db8::1"));
+	EXPECT_FALSE(match_v6(*m, "2001:db8::"));
+}
+
+TEST(NetworkMatcher, undecided)
+{
+	// IPv4-mapped addresses and values of unexpected lengths are left
+	// to the filter
+	auto m = network_matcher::create(PT_IPNET, "in", {"10.0.0.0/8"});
+	ASSERT_NE(m, nullptr);
+	EXPECT_TRUE(match_v6(*m, "::ffff:11.0.0.1"));
+	uint8_t addr[2] = {0, 0};
+	EXPECT_TRUE(m->match(addr, sizeof(addr)));
+}
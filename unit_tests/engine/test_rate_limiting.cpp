@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/rate_limiting.h>
+
+#include <thread>
+#include <vector>
+
+static constexpr uint64_t s_sec = 1000000000;
+
+TEST(TokenBucket, claims_and_refills)
+{
+	uint64_t now = 1700000000 * s_sec;
+	falco::token_bucket b(2, 3);
+
+	// the bucket starts full
+	EXPECT_EQ(b.get_tokens(now), 3);
+	EXPECT_TRUE(b.claim(now));
+	EXPECT_TRUE(b.claim(2, now));
+	EXPECT_FALSE(b.claim(now));
+	EXPECT_EQ(b.get_tokens(now), 0);
+
+	// two tokens per second
+	EXPECT_FALSE(b.claim(now + s_sec / 4));
+	EXPECT_TRUE(b.claim(now + s_sec / 2));
+	EXPECT_FALSE(b.claim(now + s_sec / 2));
+	EXPECT_DOUBLE_EQ(b.get_tokens(now + s_sec), 1);
+
+	// never more than max_burst tokens
+	now += 100 * s_sec;
+	EXPECT_EQ(b.get_tokens(now), 3);
+	EXPECT_FALSE(b.claim(4, now));
+	EXPECT_TRUE(b.claim(3, now));
+	EXPECT_FALSE(b.claim(now));
+
+	// times going backwards grant nothing
+	EXPECT_FALSE(b.claim(now - 10 * s_sec));
+}
+
+TEST(TokenBucket, fractional_rate)
+{
+	uint64_t now = 1700000000 * s_sec;
+	falco::token_bucket b(1.0 / 30, 1);
+	EXPECT_TRUE(b.claim(now));
+	EXPECT_FALSE(b.claim(now + 29 * s_sec));
+	EXPECT_TRUE(b.claim(now + 30 * s_sec));
+}
+
+TEST(TokenBucket, concurrent_claims)
+{
+	uint64_t now = 1700000000 * s_sec;
+	falco::token_bucket b(1, 1000);
+
+	std::atomic<uint64_t> granted{0};
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 8; t++)
+	{
+		threads.emplace_back([&]()
+		{
+			for(int i = 0; i < 10000; i++)
+			{
+				if(b.claim(now))
+				{
+					granted++;
+				}
+			}
+		});
+	}
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+	EXPECT_EQ(granted.load(), 1000);
+}
+
+TEST(RateCounter, sliding_window)
+{
+	uint64_t now = 1700000000 * s_sec;
+	falco::rate_counter c(10 * s_sec, 10);
+	EXPECT_EQ(c.window_ns(), 10 * s_sec);
+	EXPECT_EQ(c.count(now), 0);
+
+	for(uint64_t i = 0; i < 10; i++)
+	{
+		c.add(i + 1, now + i * s_sec);
+	}
+	EXPECT_EQ(c.count(now + 9 * s_sec), 55);
+	EXPECT_DOUBLE_EQ(c.rate(now + 9 * s_sec), 5.5);
+
+	// the oldest slots leave the window one at a time
+	EXPECT_EQ(c.count(now + 10 * s_sec), 54);
+	EXPECT_EQ(c.count(now + 11 * s_sec), 52);
+	EXPECT_EQ(c.count(now + 100 * s_sec), 0);
+
+	// stale slots are reused
+	c.add(now + 12 * s_sec);
+	EXPECT_EQ(c.count(now + 12 * s_sec), 50);
+
+	// callers late by a whole window do not reset the newer slots
+	c.add(now + 2 * s_sec);
+	EXPECT_EQ(c.count(now + 12 * s_sec), 50);
+}
+
+TEST(RateCounter, concurrent_adds)
+{
+	uint64_t now = 1700000000 * s_sec;
+	falco::rate_counter c(s_sec);
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 8; t++)
+	{
+		threads.emplace_back([&]()
+		{
+			for(int i = 0; i < 10000; i++)
+			{
+				c.add(now);
+			}
+		});
+	}
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+	EXPECT_EQ(c.count(now), 80000);
+}
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <engine/rule_exceptions.h>
+
+// fd.num is not a string field
+static bool is_hashable_field(const std::string& field)
+{
+	return field != "fd.num";
+}
+
+struct split_result
+{
+	std::string base;
+	std::vector<rule_exceptions::definition> definitions;
+	std::vector<std::string> others;
+};
+
+static bool split(const std::string& cond, size_t num_exceptions, split_result& res)
+{
+	auto ast = libsinsp::filter::parser(cond).parse();
+	std::unique_ptr<libsinsp::filter::ast::expr> base;
+	std::vector<std::unique_ptr<libsinsp::filter::ast::expr>> others;
+	res = {};
+	if(!rule_exceptions::split(ast.get(), num_exceptions, is_hashable_field, base, res.definitions, others))
+	{
+		return false;
+	}
+	res.base = libsinsp::filter::ast::as_string(base.get());
+	for(const auto& o : others)
+	{
+		res.others.push_back(libsinsp::filter::ast::as_string(o.get()));
+	}
+	return true;
+}
+
+static std::string parsed(const std::string& condition)
+{
+	auto ast = libsinsp::filter::parser(condition).parse();
+	return libsinsp::filter::ast::as_string(ast.get());
+}
+
+TEST(RuleExceptions, split_tuples)
+{
+	split_result res;
+	ASSERT_TRUE(split("(evt.type = open and fd.name startswith /etc) and not ((proc.name = cat and fd.name = /etc/a) or (proc.name in (vi, vim) and fd.name in (/etc/b, /etc/c)))", 1, res));
+	ASSERT_EQ(res.base, parsed("evt.type = open and fd.name startswith /etc"));
+	ASSERT_TRUE(res.others.empty());
+	ASSERT_EQ(res.definitions.size(), 1);
+	std::vector<std::string> fields = {"proc.name", "fd.name"};
+	std::vector<std::vector<std::string>> tuples = {
+		{"cat", "/etc/a"},
+		{"vi", "/etc/b"},
+		{"vi", "/etc/c"},
+		{"vim", "/etc/b"},
+		{"vim", "/etc/c"},
+	};
+	ASSERT_EQ(res.definitions[0].fields, fields);
+	ASSERT_EQ(res.definitions[0].tuples, tuples);
+
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and proc.aname[2] = sh) and not (proc.name = a and fd.name = b)", 2, res));
+	ASSERT_EQ(res.base, parsed("evt.type = open"));
+	ASSERT_EQ(res.definitions.size(), 2);
+	fields = {"proc.name", "proc.aname[2]"};
+	ASSERT_EQ(res.definitions[0].fields, fields);
+}
+
+TEST(RuleExceptions, split_other_exceptions)
+{
+	split_result res;
+
+	// single fields
+	ASSERT_TRUE(split("(evt.type = open) and not proc.name in (cat, vi)", 1, res));
+	ASSERT_EQ(res.base, parsed("evt.type = open"));
+	ASSERT_TRUE(res.definitions.empty());
+	ASSERT_EQ(res.others, std::vector<std::string>{parsed("not proc.name in (cat, vi)")});
+
+	// other comparators, fields, or values
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and fd.name startswith /etc)", 1, res));
+	ASSERT_EQ(res.others.size(), 1);
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and fd.num = 3)", 1, res));
+	ASSERT_EQ(res.others.size(), 1);
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and fd.name = val(proc.exepath))", 1, res));
+	ASSERT_EQ(res.others.size(), 1);
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and tolower(fd.name) = /etc/a)", 1, res));
+	ASSERT_EQ(res.others.size(), 1);
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and proc.name = vi)", 1, res));
+	ASSERT_EQ(res.others.size(), 1);
+
+	// alternatives on different fields
+	ASSERT_TRUE(split("(evt.type = open) and not ((proc.name = cat and fd.name = /etc/a) or (proc.name = cat and fd.directory = /etc))", 1, res));
+	ASSERT_EQ(res.others.size(), 1);
+
+	// both kinds
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name = cat and fd.name = /etc/a) and not (proc.name = vi and fd.name contains ssh)", 2, res));
+	ASSERT_EQ(res.base, parsed("evt.type = open"));
+	ASSERT_EQ(res.definitions.size(), 1);
+	ASSERT_EQ(res.others, std::vector<std::string>{parsed("not (proc.name = vi and fd.name contains ssh)")});
+}
+
+TEST(RuleExceptions, split_base_condition)
+{
+	split_result res;
+
+	// only the appended exceptions are split
+	ASSERT_TRUE(split("(evt.type = open and not proc.name = cat) and not fd.name = /etc/a", 1, res));
+	ASSERT_EQ(res.base, parsed("evt.type = open and not proc.name = cat"));
+	ASSERT_EQ(res.others.size(), 1);
+
+	// no exceptions, or no base condition
+	ASSERT_FALSE(split("evt.type = open and not proc.name = cat", 0, res));
+	ASSERT_FALSE(split("not (proc.name = cat and fd.name = /etc/a)", 1, res));
+	ASSERT_FALSE(split("(evt.type = open) and not proc.name = cat", 2, res));
+}
+
+TEST(RuleExceptions, max_tuples)
+{
+	std::string values;
+	for(size_t i = 0; i < 200; i++)
+	{
+		values += (i == 0 ? "" : ", ") + std::to_string(i);
+	}
+	split_result res;
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name in (" + values + ") and fd.name in (a, b))", 1, res));
+	ASSERT_EQ(res.definitions[0].tuples.size(), 400);
+	ASSERT_TRUE(split("(evt.type = open) and not (proc.name in (" + values + ") and fd.name in (" + values + "))", 1, res));
+	ASSERT_TRUE(res.definitions.empty());
+	ASSERT_EQ(res.others.size(), 1);
+}
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <engine/formats.h>
+
+#include "../test_falco_engine.h"
+#include "../test_events.h"
+
+static std::string formatter_rules = R"END(
+- rule: shell spawned
+  desc: A shell was spawned
+  condition: evt.type = execve and proc.name = bash
+  output: A shell was spawned (proc.name=%proc.name)
+  priority: WARNING
+
+- rule: file opened
+  desc: A file was opened
+  condition: evt.type = open and fd.name startswith "/etc"
+  output: A file was opened (fd.name=%fd.name)
+  priority: INFO
+)END";
+
+TEST_F(test_falco_engine, rule_formatters_compiled_on_loading_complete)
+{
+	ASSERT_TRUE(load_rules(formatter_rules, "formatter_rules.yaml")) << m_load_result_string;
+	for(const auto& r : m_engine->get_rules())
+	{
+		EXPECT_EQ(m_engine->get_rule_formatter(r.id), nullptr);
+	}
+
+	m_engine->complete_rule_loading();
+	for(const auto& r : m_engine->get_rules())
+	{
+		EXPECT_NE(m_engine->get_rule_formatter(r.id), nullptr);
+	}
+	EXPECT_EQ(m_engine->get_rule_formatter(m_engine->get_rules().size()), nullptr);
+
+	// loading the rules again drops the formatters until loading completes
+	ASSERT_TRUE(load_rules(formatter_rules, "formatter_rules.yaml")) << m_load_result_string;
+	EXPECT_EQ(m_engine->get_rule_formatter(0), nullptr);
+}
+
+TEST_F(test_falco_engine, rule_formatters_custom_format)
+{
+	std::map<std::string, std::string> formats;
+	m_engine->set_rule_output_format([&formats](const falco_rule& r)
+	{
+		auto fmt = "*%evt.time: " + falco_common::format_priority(r.priority) + " " + r.output;
+		formats[r.name] = fmt;
+		return fmt;
+	});
+
+	ASSERT_TRUE(load_rules(formatter_rules, "formatter_rules.yaml")) << m_load_result_string;
+	m_engine->complete_rule_loading();
+
+	ASSERT_EQ(formats.size(), 2);
+	EXPECT_EQ(formats["shell spawned"], "*%evt.time: Warning A shell was spawned (proc.name=%proc.name)");
+	EXPECT_EQ(formats["file opened"], "*%evt.time: Informational A file was opened (fd.name=%fd.name)");
+	for(const auto& r : m_engine->get_rules())
+	{
+		EXPECT_NE(m_engine->get_rule_formatter(r.id), nullptr);
+	}
+}
+
+TEST_F(test_falco_engine, format_fields)
+{
+	falco_formats formats(m_engine, true, true);
+	std::map<std::string, std::string> values = {
+		{"evt.time", "12:00:00.000000000"},
+		{"proc.name", "bash"},
+		{"proc.name2", "unused"},
+		{"proc.pname", "sshd \"x\""},
+	};
+	falco::field_values fields;
+	falco::assign_field_values(fields, values);
+	std::string format = "*%evt.time: Warning Shell (proc.name=%proc.name parent=%proc.pname 100%)";
+
+	std::string text;
+	formats.format_fields(text, 0, "shell spawned", "syscall", "Warning", format, fields, {"a", "b"}, "host", false);
+	EXPECT_EQ(text, "12:00:00.000000000: Warning Shell (proc.name=bash parent=sshd \"x\" 100%)");
+
+	std::string line = "previous content";
+	formats.format_fields(line, 0, "shell spawned", "syscall", "Warning", format, fields, {"a", "b"}, "host", true);
+	auto json = nlohmann::json::parse(line);
+	EXPECT_EQ(json["output"], text);
+	EXPECT_EQ(json["rule"], "shell spawned");
+	EXPECT_EQ(json["priority"], "Warning");
+	EXPECT_EQ(json["source"], "syscall");
+	EXPECT_EQ(json["hostname"], "host");
+	EXPECT_EQ(json["time"], "1970-01-01T00:00:00.000000000Z");
+	EXPECT_EQ(json["tags"], nlohmann::json::array({"a", "b"}));
+	EXPECT_EQ(json["output_fields"], nlohmann::json(values));
+}
+
+TEST_F(test_falco_engine, formatters_per_thread)
+{
+	ASSERT_TRUE(load_rules(formatter_rules, "formatter_rules.yaml"));
+
+	// the formatters are reused within a thread, but not across threads
+	auto formatter = m_engine->get_formatter("syscall", "%proc.name");
+	ASSERT_NE(formatter, nullptr);
+	ASSERT_EQ(m_engine->get_formatter("syscall", "%proc.name"), formatter);
+
+	std::shared_ptr<sinsp_evt_formatter> other[2];
+	std::thread t([this, &other]()
+	{
+		other[0] = m_engine->get_formatter("syscall", "%proc.name");
+		other[1] = m_engine->get_formatter("syscall", "%proc.name");
+	});
+	t.join();
+	ASSERT_NE(other[0], nullptr);
+	ASSERT_EQ(other[0], other[1]);
+	ASSERT_NE(other[0], formatter);
+	ASSERT_EQ(m_engine->get_formatter("syscall", "%proc.name"), formatter);
+}
+
+TEST_F(test_falco_engine, rule_field_values_per_event)
+{
+	ASSERT_TRUE(load_rules(formatter_rules, "formatter_rules.yaml")) << m_load_result_string;
+	m_engine->complete_rule_loading();
+	auto rule_id = m_engine->get_rules().at("file opened")->id;
+
+	test_events events(m_inspector);
+	auto cat = events.add_process("cat");
+	auto passwd = events.open(cat, "/etc/passwd");
+	auto shadow = events.open(cat, "/etc/shadow");
+	auto fd_name = [](const falco::field_values& values)
+	{
+		std::string res;
+		for(const auto& v : values)
+		{
+			if(*v.first == "fd.name")
+			{
+				v.second.append_text(res);
+			}
+		}
+		return res;
+	};
+
+	// the values are extracted again for another event, even if it has
+	// the same number as the previous one
+	EXPECT_EQ(fd_name(m_engine->get_rule_field_values(passwd, rule_id)), "/etc/passwd");
+	EXPECT_EQ(fd_name(m_engine->get_rule_field_values(passwd, rule_id)), "/etc/passwd");
+	shadow->set_num(passwd->get_num());
+	EXPECT_EQ(fd_name(m_engine->get_rule_field_values(shadow, rule_id)), "/etc/shadow");
+	EXPECT_EQ(fd_name(m_engine->get_rule_field_values(passwd, rule_id)), "/etc/passwd");
+}
@@ -2,6 +2,9 @@
 
 #include "../test_falco_engine.h"
 
+#include <atomic>
+#include <sstream>
+
 std::string s_sample_ruleset = "sample-ruleset";
 std::string s_sample_source = falco_common::syscall_source;
 
@@ -933,6 +936,40 @@ TEST_F(test_falco_engine, list_name_invalid)
   ASSERT_TRUE(check_warning_message("List has an invalid name. List names should match a regular expression"));
 }
 
+TEST_F(test_falco_engine, list_multi_item_in_check)
+{
+    std::string rules_content = R"END(
+- list: shell_binaries
+  items: [bash, sh]
+
+- rule: test_rule
+  desc: test rule description
+  condition: evt.type = execve and proc.name = shell_binaries
+  output: user=%user.name command=%proc.cmdline
+  priority: INFO
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("List 'shell_binaries' has 2 items and can't be used as a single value in filter."));
+}
+
+TEST_F(test_falco_engine, list_single_item_in_check)
+{
+    std::string rules_content = R"END(
+- list: my_shell
+  items: [bash]
+
+- rule: test_rule
+  desc: test rule description
+  condition: evt.type = execve and proc.name = my_shell
+  output: user=%user.name command=%proc.cmdline
+  priority: INFO
+)END";
+
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml"));
+  EXPECT_EQ(num_rules_for_ruleset(), 1);
+}
+
 // The appended exception has a purposely miswritten field (value),
 // simulating a typo or an incorrect usage.
 TEST_F(test_falco_engine, exceptions_append_no_values)
@@ -1178,3 +1215,429 @@ TEST_F(test_falco_engine, exceptions_fields_transformer_space_quoted)
   ASSERT_FALSE(has_warnings());
   EXPECT_EQ(get_compiled_rule_condition("test_rule"), "(evt.type = open and not tolower(proc.name) = test)");
 }
+
+TEST_F(test_falco_engine, parallel_compile_deterministic_warnings)
+{
+  std::string rules_content = R"END(
+- rule: no_evttype_rule
+  desc: test rule
+  condition: proc.name = foo
+  output: user=%user.name
+  priority: INFO
+
+- rule: unknown_output_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%not.a.field
+  priority: INFO
+  skip-if-unknown-filter: true
+
+- rule: unknown_field_rule
+  desc: test rule
+  condition: evt.type = open and not.a.field = foo
+  output: user=%user.name
+  priority: INFO
+  skip-if-unknown-filter: true
+
+- rule: valid_rule
+  desc: test rule
+  condition: evt.type = open and (proc.name = foo or proc.name = bar)
+  output: user=%user.name
+  priority: INFO
+)END";
+
+  // each compiling thread uses its own filter factory
+  std::atomic<size_t> num_factories{0};
+  m_engine->set_filter_factory_creator(0, [this, &num_factories]()
+  {
+    num_factories++;
+    return std::make_shared<sinsp_filter_factory>(&m_inspector, m_filterlist);
+  });
+  m_engine->get_rule_compiler()->set_compile_threads(4);
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  EXPECT_GE(num_factories, 1u);
+  EXPECT_LE(num_factories, 3u);
+
+  // warnings are reported in the order in which rules are defined
+  auto warnings = m_load_result_json["warnings"];
+  ASSERT_EQ(warnings.size(), 3);
+  EXPECT_EQ(warnings[0]["code"], falco::load_result::warning_code_str(falco::load_result::LOAD_NO_EVTTYPE));
+  EXPECT_EQ(warnings[1]["code"], falco::load_result::warning_code_str(falco::load_result::LOAD_UNKNOWN_FILTER));
+  EXPECT_EQ(warnings[2]["code"], falco::load_result::warning_code_str(falco::load_result::LOAD_UNKNOWN_FILTER));
+
+  EXPECT_EQ(m_engine->get_rules().size(), 2);
+  EXPECT_NE(m_engine->get_rules().at("no_evttype_rule"), nullptr);
+  EXPECT_NE(m_engine->get_rules().at("valid_rule"), nullptr);
+  EXPECT_EQ(get_compiled_rule_condition("valid_rule"), "(evt.type = open and (proc.name = foo or proc.name = bar))");
+}
+
+TEST_F(test_falco_engine, compile_without_warnings)
+{
+  std::string rules_content = R"END(
+- macro: unused_macro
+  condition: proc.name = foo
+
+- list: unused_list
+  items: [foo]
+
+- rule: no_evttype_rule
+  desc: test rule
+  condition: proc.name = foo
+  output: user=%user.name
+  priority: INFO
+)END";
+
+  m_engine->get_rule_compiler()->set_warnings_enabled(false);
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  ASSERT_FALSE(has_warnings());
+  EXPECT_NE(m_engine->get_rules().at("no_evttype_rule"), nullptr);
+
+  // the errors are still reported
+  std::string bad_rules_content = R"END(
+- rule: bad_rule
+  desc: test rule
+  condition: evt.type = open and missing_macro
+  output: user=%user.name
+  priority: INFO
+)END";
+
+  ASSERT_FALSE(load_rules(bad_rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("Undefined macro 'missing_macro' used in filter."));
+
+  m_engine->get_rule_compiler()->set_warnings_enabled(true);
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  EXPECT_EQ(m_load_result_json["warnings"].size(), 3);
+}
+
+TEST_F(test_falco_engine, rule_rate_limit)
+{
+  std::string rules_content = R"END(
+- rule: limited_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  rate_limit:
+    rate: 0.5
+
+- rule: bursty_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  rate_limit:
+    rate: 2
+    max_burst: 20
+
+- rule: unlimited_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+
+- rule: unlimited_rule
+  rate_limit:
+    rate: 3
+  override:
+    rate_limit: replace
+)END";
+
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+
+  auto limited = m_engine->get_rules().at("limited_rule");
+  ASSERT_TRUE(limited->rate_limit.has_value());
+  EXPECT_EQ(limited->rate_limit->rate, 0.5);
+  EXPECT_EQ(limited->rate_limit->max_burst, 1);
+
+  auto bursty = m_engine->get_rules().at("bursty_rule");
+  ASSERT_TRUE(bursty->rate_limit.has_value());
+  EXPECT_EQ(bursty->rate_limit->rate, 2);
+  EXPECT_EQ(bursty->rate_limit->max_burst, 20);
+
+  auto replaced = m_engine->get_rules().at("unlimited_rule");
+  ASSERT_TRUE(replaced->rate_limit.has_value());
+  EXPECT_EQ(replaced->rate_limit->rate, 3);
+  EXPECT_EQ(replaced->rate_limit->max_burst, 3);
+}
+
+TEST_F(test_falco_engine, rule_rate_limit_invalid)
+{
+  std::string rules_content = R"END(
+- rule: limited_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  rate_limit:
+    rate: -1
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("Rate limit rate must be a non-negative number"));
+
+  rules_content = R"END(
+- rule: limited_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  rate_limit: 10
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("Value is not a map"));
+}
+
+TEST_F(test_falco_engine, rule_threshold_and_sequence)
+{
+  std::string rules_content = R"END(
+- rule: failed_connects
+  desc: test rule
+  condition: evt.type = connect
+  output: user=%user.name
+  priority: INFO
+  threshold:
+    count: 50
+    window: 10s
+    by: [proc.pid]
+
+- rule: shell_spawned
+  desc: test rule
+  condition: evt.type = execve
+  output: user=%user.name
+  priority: INFO
+
+- rule: shell_then_connect
+  desc: test rule
+  condition: evt.type = connect
+  output: user=%user.name
+  priority: INFO
+  sequence:
+    after: shell_spawned
+    within: 5s
+    by: [container.id, proc.pid]
+
+- rule: shell_spawned
+  threshold:
+    count: 2
+    window: 1m
+  override:
+    threshold: replace
+)END";
+
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+
+  auto threshold = m_engine->get_rules().at("failed_connects");
+  ASSERT_TRUE(threshold->threshold.has_value());
+  EXPECT_FALSE(threshold->sequence.has_value());
+  EXPECT_EQ(threshold->threshold->count, 50);
+  EXPECT_EQ(threshold->threshold->window_ns, 10000000000ULL);
+  EXPECT_EQ(threshold->threshold->by, std::vector<std::string>{"proc.pid"});
+
+  auto sequence = m_engine->get_rules().at("shell_then_connect");
+  ASSERT_TRUE(sequence->sequence.has_value());
+  EXPECT_EQ(sequence->sequence->after, "shell_spawned");
+  EXPECT_EQ(sequence->sequence->window_ns, 5000000000ULL);
+  EXPECT_EQ(sequence->sequence->by, (std::vector<std::string>{"container.id", "proc.pid"}));
+
+  auto replaced = m_engine->get_rules().at("shell_spawned");
+  ASSERT_TRUE(replaced->threshold.has_value());
+  EXPECT_EQ(replaced->threshold->count, 2);
+  EXPECT_EQ(replaced->threshold->window_ns, 60000000000ULL);
+  EXPECT_TRUE(replaced->threshold->by.empty());
+}
+
+TEST_F(test_falco_engine, rule_threshold_and_sequence_invalid)
+{
+  std::string rules_content = R"END(
+- rule: threshold_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  threshold:
+    count: 0
+    window: 10s
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("Threshold count must be at least 1"));
+
+  rules_content = R"END(
+- rule: threshold_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  threshold:
+    count: 10
+    window: forever
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("Invalid duration for 'window'"));
+
+  rules_content = R"END(
+- rule: sequence_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  sequence:
+    after: missing_rule
+    within: 5s
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+  ASSERT_TRUE(check_error_message("Sequence refers to undefined rule 'missing_rule'"));
+
+  rules_content = R"END(
+- rule: threshold_rule
+  desc: test rule
+  condition: evt.type = open
+  output: user=%user.name
+  priority: INFO
+  threshold:
+    count: 10
+    window: 10s
+    by: [not.a.field]
+)END";
+
+  ASSERT_FALSE(load_rules(rules_content, "rules.yaml"));
+}
+
+TEST_F(test_falco_engine, describe_rule_streamed)
+{
+  std::string rules_content = R"END(
+- required_engine_version: 0.10.0
+
+- list: shell_binaries
+  items: [bash, sh, zsh]
+
+- macro: spawned_process
+  condition: evt.type = execve and evt.dir = <
+
+- macro: shell_procs
+  condition: proc.name in (shell_binaries)
+
+- rule: shell_rule
+  desc: test rule
+  condition: spawned_process and shell_procs
+  output: shell=%proc.name user=%user.name
+  priority: INFO
+  tags: [shell]
+
+- rule: open_rule
+  desc: test rule
+  condition: evt.type = open and fd.name startswith /etc
+  output: file=%fd.name
+  priority: WARNING
+)END";
+
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+
+  // the stream is the same as the whole description, on any number of threads
+  auto expected = m_engine->describe_rule(nullptr, {});
+  for(size_t threads : {1, 4})
+  {
+    m_engine->get_rule_compiler()->set_compile_threads(threads);
+    std::stringstream ss;
+    m_engine->describe_rule(ss, nullptr, {});
+    EXPECT_EQ(ss.str(), expected.dump());
+    EXPECT_EQ(m_engine->describe_rule(nullptr, {}), expected);
+  }
+  ASSERT_EQ(expected["rules"].size(), 2);
+  ASSERT_EQ(expected["macros"].size(), 2);
+  ASSERT_EQ(expected["lists"].size(), 1);
+  EXPECT_EQ(expected["rules"][0]["details"]["macros"].size(), 2);
+
+  std::string rule_name = "open_rule";
+  std::stringstream ss;
+  m_engine->describe_rule(ss, &rule_name, {});
+  EXPECT_EQ(ss.str(), m_engine->describe_rule(&rule_name, {}).dump());
+}
+
+TEST_F(test_falco_engine, filter_cache)
+{
+  std::string rules_content = R"END(
+- rule: rule_A
+  desc: test rule
+  condition: evt.type = open and fd.name startswith /etc
+  output: file=%fd.name
+  priority: WARNING
+
+- rule: rule_B
+  desc: test rule
+  condition: evt.type = open and fd.name startswith /etc
+  output: name=%fd.name
+  priority: WARNING
+
+- rule: rule_C
+  desc: test rule
+  condition: evt.type = open and fd.name startswith /tmp
+  output: file=%fd.name
+  priority: WARNING
+)END";
+
+  auto filter = [this](const std::string& name)
+  {
+    return m_engine->get_rules().at(name)->filter;
+  };
+
+  // the rules with the same condition share their filter
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  auto filter_A = filter("rule_A");
+  auto filter_C = filter("rule_C");
+  ASSERT_NE(filter_A, nullptr);
+  ASSERT_EQ(filter("rule_B"), filter_A);
+  ASSERT_NE(filter_C, filter_A);
+
+  // the filters are reused by the next loading
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  ASSERT_EQ(filter("rule_A"), filter_A);
+  ASSERT_EQ(filter("rule_C"), filter_C);
+
+  // the filters not used by a loading are dropped
+  std::string rules_without_C = rules_content.substr(0, rules_content.find("- rule: rule_C"));
+  ASSERT_TRUE(load_rules(rules_without_C, "rules.yaml")) << m_load_result_string;
+  ASSERT_EQ(filter("rule_A"), filter_A);
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  ASSERT_EQ(filter("rule_A"), filter_A);
+  ASSERT_NE(filter("rule_C"), filter_C);
+
+  // and so are all of them once the loading state is released
+  ASSERT_GT(m_engine->get_rule_compiler()->memory_usage(), 0);
+  m_engine->get_rule_compiler()->clear_cache();
+  ASSERT_EQ(m_engine->get_rule_compiler()->memory_usage(), 0);
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  ASSERT_NE(filter("rule_A"), filter_A);
+}
+
+TEST_F(test_falco_engine, filter_cache_by_source)
+{
+  auto other_factory = std::make_shared<sinsp_filter_factory>(&m_inspector, m_filterlist);
+  m_engine->add_source("other", other_factory, m_formatter_factory);
+
+  std::string rules_content = R"END(
+- rule: rule_A
+  desc: test rule
+  condition: evt.type = open and fd.name startswith /etc
+  output: file=%fd.name
+  priority: WARNING
+
+- rule: rule_B
+  desc: test rule
+  condition: evt.type = open and fd.name startswith /etc
+  output: file=%fd.name
+  priority: WARNING
+  source: other
+)END";
+
+  // the same condition is compiled for each source, with its factory
+  ASSERT_TRUE(load_rules(rules_content, "rules.yaml")) << m_load_result_string;
+  auto filter_A = m_engine->get_rules().at("rule_A")->filter;
+  auto filter_B = m_engine->get_rules().at("rule_B")->filter;
+  ASSERT_NE(filter_A, nullptr);
+  ASSERT_NE(filter_B, nullptr);
+  ASSERT_NE(filter_A, filter_B);
+}
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/rule_state.h>
+
+static constexpr uint64_t s_sec = 1000000000;
+
+TEST(RuleState, threshold)
+{
+	falco::rule_state state(1024 * 1024);
+	uint64_t now = 1700000000 * s_sec;
+
+	// three matches within 10 seconds, counted separately by key
+	EXPECT_FALSE(state.add_threshold("a", now, 10 * s_sec, 3));
+	EXPECT_FALSE(state.add_threshold("a", now + 1 * s_sec, 10 * s_sec, 3));
+	EXPECT_FALSE(state.add_threshold("b", now + 1 * s_sec, 10 * s_sec, 3));
+	EXPECT_TRUE(state.add_threshold("a", now + 2 * s_sec, 10 * s_sec, 3));
+
+	// the counter starts over after an alert
+	EXPECT_FALSE(state.add_threshold("a", now + 3 * s_sec, 10 * s_sec, 3));
+
+	// matches far apart never reach the threshold
+	for(uint64_t i = 1; i <= 10; i++)
+	{
+		EXPECT_FALSE(state.add_threshold("c", now + i * 60 * s_sec, 10 * s_sec, 2));
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	state.get_metrics(metrics);
+	EXPECT_EQ(metrics["keys"], 3);
+	EXPECT_EQ(metrics["threshold_alerts"], 1);
+	EXPECT_EQ(metrics["threshold_suppressed"], 14);
+	EXPECT_EQ(metrics["evicted"], 0);
+}
+
+TEST(RuleState, threshold_sliding_window)
+{
+	falco::rule_state state(1024 * 1024);
+	uint64_t window = 10 * s_sec;
+
+	// four matches at the end of a window and two right at the start of
+	// the next one are within 10 seconds of each other, which is estimated
+	// as slightly less than six matches
+	for(uint64_t i = 0; i < 4; i++)
+	{
+		EXPECT_FALSE(state.add_threshold("a", 9 * s_sec, window, 5));
+	}
+	EXPECT_FALSE(state.add_threshold("a", 10 * s_sec + 1, window, 5));
+	EXPECT_TRUE(state.add_threshold("a", 10 * s_sec + 2, window, 5));
+
+	// the previous window only counts for the part still in the window
+	for(uint64_t i = 0; i < 4; i++)
+	{
+		EXPECT_FALSE(state.add_threshold("b", 1 * s_sec, window, 6));
+	}
+	EXPECT_FALSE(state.add_threshold("b", 19 * s_sec, window, 6));
+	EXPECT_FALSE(state.add_threshold("b", 19 * s_sec, window, 6));
+}
+
+TEST(RuleState, sequence)
+{
+	falco::rule_state state(1024 * 1024);
+	uint64_t now = 1700000000 * s_sec;
+
+	// nothing to complete without a first step
+	EXPECT_FALSE(state.complete_sequence("a", now, 5 * s_sec));
+
+	state.start_sequence("a", now);
+	EXPECT_TRUE(state.complete_sequence("a", now + 4 * s_sec, 5 * s_sec));
+	// the first step is consumed
+	EXPECT_FALSE(state.complete_sequence("a", now + 4 * s_sec, 5 * s_sec));
+
+	// too late, or for another key
+	state.start_sequence("a", now);
+	EXPECT_FALSE(state.complete_sequence("b", now + 1 * s_sec, 5 * s_sec));
+	EXPECT_FALSE(state.complete_sequence("a", now + 6 * s_sec, 5 * s_sec));
+
+	// a later first step replaces the previous one
+	state.start_sequence("a", now);
+	state.start_sequence("a", now + 10 * s_sec);
+	EXPECT_TRUE(state.complete_sequence("a", now + 12 * s_sec, 5 * s_sec));
+
+	std::map<std::string, uint64_t> metrics;
+	state.get_metrics(metrics);
+	EXPECT_EQ(metrics["keys"], 0);
+	EXPECT_EQ(metrics["memory_bytes"], 0);
+	EXPECT_EQ(metrics["sequence_starts"], 4);
+	EXPECT_EQ(metrics["sequence_alerts"], 2);
+	EXPECT_EQ(metrics["sequence_unmatched"], 4);
+}
+
+TEST(RuleState, eviction)
+{
+	// a budget for a few keys only
+	falco::rule_state state(1024);
+	for(uint64_t i = 0; i < 100; i++)
+	{
+		state.start_sequence("key" + std::to_string(i), i);
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	state.get_metrics(metrics);
+	ASSERT_GT(metrics["keys"], 0);
+	ASSERT_LT(metrics["keys"], 100);
+	EXPECT_LE(metrics["memory_bytes"], 1024);
+	EXPECT_EQ(metrics["keys"] + metrics["evicted"], 100);
+
+	// the keys used least recently are the ones forgotten
+	EXPECT_TRUE(state.complete_sequence("key99", 100, s_sec));
+	EXPECT_FALSE(state.complete_sequence("key0", 100, s_sec));
+
+	// a key that is used again is kept
+	state.start_sequence("keep", 0);
+	for(uint64_t i = 0; i < 100; i++)
+	{
+		state.add_threshold("keep", i, s_sec, 1000);
+		state.add_threshold("other" + std::to_string(i), i, s_sec, 1000);
+	}
+	EXPECT_TRUE(state.complete_sequence("keep", 100, s_sec));
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <engine/rules_arena.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace falco::rules_arena;
+
+static uint64_t metric(const std::string& name)
+{
+	std::map<std::string, uint64_t> metrics;
+	get_metrics(metrics);
+	return metrics.at(name);
+}
+
+TEST(RulesArena, scopes)
+{
+	if (!enabled())
+	{
+		// everything comes from the heap
+		auto a = create();
+		EXPECT_EQ(a, nullptr);
+		{
+			scope s(a.get());
+			auto p = std::make_unique<int>(1);
+		}
+		EXPECT_EQ(current(), nullptr);
+		EXPECT_EQ(metric("chunks"), 0u);
+		return;
+	}
+
+	auto chunks = metric("chunks");
+	auto released = metric("released_chunks");
+	std::unique_ptr<std::vector<std::string>> v;
+	{
+		auto a = create();
+		scope s(a.get());
+		EXPECT_EQ(current(), a.get());
+		v = std::make_unique<std::vector<std::string>>();
+		for (int i = 0; i < 10000; i++)
+		{
+			v->push_back(std::string(64, 'a'));
+		}
+
+		// the threads allocate from the arena of their own scopes
+		std::thread t([&]
+		{
+			EXPECT_EQ(current(), nullptr);
+			scope s(a.get());
+			v->push_back(std::string(64, 'b'));
+		});
+		t.join();
+		EXPECT_GT(metric("chunks"), chunks);
+	}
+	EXPECT_EQ(current(), nullptr);
+
+	// the chunks outlive their arena until the objects are deleted
+	EXPECT_GT(metric("chunks"), chunks);
+	EXPECT_EQ(v->back(), std::string(64, 'b'));
+	v.reset();
+	EXPECT_EQ(metric("chunks"), chunks);
+	EXPECT_GT(metric("released_chunks"), released);
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../test_falco_engine.h"
+
+static std::string cached_rules = R"END(
+- macro: spawned_process
+  condition: evt.type = execve and evt.dir = <
+
+- list: shells
+  items: [bash, sh, zsh]
+
+- rule: shell spawned
+  desc: A shell was spawned
+  condition: spawned_process and (proc.name in (shells) or proc.name = fish)
+  output: A shell was spawned (proc.name=%proc.name)
+  priority: WARNING
+  tags: [process, shell]
+
+- rule: disabled rule
+  desc: A disabled rule
+  condition: evt.type = open and fd.name startswith "/etc"
+  output: A file was opened (fd.name=%fd.name)
+  priority: INFO
+  enabled: false
+  tags: [filesystem]
+)END";
+
+static std::string other_rules = R"END(
+- rule: other rule
+  desc: Another rule
+  condition: evt.type = connect
+  output: A connection was made
+  priority: INFO
+)END";
+
+TEST_F(test_falco_engine, rules_cache_roundtrip)
+{
+	ASSERT_TRUE(load_rules(cached_rules, "cached_rules.yaml")) << m_load_result_string;
+
+	std::stringstream cache;
+	m_engine->write_rules_cache(cache, "key");
+
+	ASSERT_TRUE(load_rules(other_rules, "other_rules.yaml")) << m_load_result_string;
+	EXPECT_EQ(m_engine->get_rules().size(), 1);
+
+	// a cache written for another key is ignored
+	std::stringstream wrong_key(cache.str());
+	EXPECT_FALSE(m_engine->load_rules_cache(wrong_key, "other key"));
+	EXPECT_EQ(m_engine->get_rules().size(), 1);
+
+	// and so is a corrupted one
+	std::stringstream corrupted(cache.str().substr(0, cache.str().size() / 2));
+	EXPECT_FALSE(m_engine->load_rules_cache(corrupted, "key"));
+	EXPECT_EQ(m_engine->get_rules().size(), 1);
+
+	std::stringstream valid(cache.str());
+	ASSERT_TRUE(m_engine->load_rules_cache(valid, "key"));
+	ASSERT_EQ(m_engine->get_rules().size(), 2);
+
+	auto rule = m_engine->get_rules().at("shell spawned");
+	ASSERT_NE(rule, nullptr);
+	EXPECT_EQ(rule->id, 0);
+	EXPECT_EQ(rule->priority, falco_common::PRIORITY_WARNING);
+	EXPECT_EQ(rule->output, "A shell was spawned (proc.name=%proc.name)");
+	EXPECT_EQ(rule->tags, std::set<std::string>({"process", "shell"}));
+	EXPECT_NE(rule->filter, nullptr);
+
+	// the enabled flag of the rules files is preserved
+	EXPECT_EQ(num_rules_for_ruleset(), 1);
+	m_engine->enable_rule_by_tag(std::set<std::string>{"filesystem"}, true);
+	EXPECT_EQ(num_rules_for_ruleset(), 2);
+
+	// the event types of the restored rules are still known
+	auto codes = m_engine->event_codes_for_ruleset(falco_common::syscall_source);
+	EXPECT_TRUE(codes.contains(PPME_SYSCALL_EXECVE_19_X));
+	EXPECT_TRUE(codes.contains(PPME_SYSCALL_OPEN_X));
+	EXPECT_FALSE(codes.contains(PPME_SOCKET_CONNECT_X));
+}
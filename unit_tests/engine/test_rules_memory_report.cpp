@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../test_falco_engine.h"
+
+static std::string report_rules = R"END(
+- macro: spawned_process
+  condition: evt.type = execve and evt.dir = <
+
+- list: shells
+  items: [bash, sh, zsh]
+
+- rule: shell spawned
+  desc: A shell was spawned
+  condition: spawned_process and proc.name in (shells)
+  output: A shell was spawned (proc.name=%proc.name)
+  priority: WARNING
+  exceptions:
+    - name: allowed_parents
+      fields: [proc.pname]
+      values:
+        - [sshd]
+
+- rule: file opened
+  desc: A file was opened
+  condition: evt.type = open and fd.name startswith "/etc"
+  output: A file was opened (fd.name=%fd.name)
+  priority: INFO
+)END";
+
+TEST_F(test_falco_engine, rules_memory_report)
+{
+	ASSERT_TRUE(load_rules(report_rules, "report_rules.yaml")) << m_load_result_string;
+	m_engine->complete_rule_loading();
+
+	auto report = m_engine->rules_memory_report();
+	EXPECT_GT(report["collector"]["lists"].get<size_t>(), 0);
+	EXPECT_GT(report["collector"]["macros"].get<size_t>(), 0);
+	EXPECT_GT(report["collector"]["rules"].get<size_t>(), 0);
+	EXPECT_GT(report["collector"]["contexts"].get<size_t>(), 0);
+	EXPECT_GT(report["compile_output"]["total"].get<size_t>(), 0);
+	EXPECT_GT(report["engine_rules"].get<size_t>(), 0);
+	EXPECT_GT(report["rulesets"][falco_common::syscall_source].get<size_t>(), 0);
+	EXPECT_FALSE(report["loading_state_released"].get<bool>());
+
+	// the conditions and filters are shared between all the copies of
+	// the rules, so they are counted once
+	EXPECT_EQ(report["conditions"]["count"].get<size_t>(), 2);
+	EXPECT_GT(report["conditions"]["bytes"].get<size_t>(), 0);
+	EXPECT_EQ(report["filters"]["count"].get<size_t>(), 2);
+	EXPECT_GE(report["filters"]["checks"].get<size_t>(), 6);
+}
+
+TEST_F(test_falco_engine, release_rule_loading_state)
+{
+	ASSERT_TRUE(load_rules(report_rules, "report_rules.yaml")) << m_load_result_string;
+	m_engine->complete_rule_loading();
+	auto before = m_engine->rules_memory_report();
+
+	m_engine->release_rule_loading_state();
+	auto after = m_engine->rules_memory_report();
+	EXPECT_TRUE(after["loading_state_released"].get<bool>());
+	EXPECT_EQ(after["collector"]["contexts"].get<size_t>(), 0);
+	EXPECT_EQ(after["compile_output"]["total"].get<size_t>(), 0);
+	EXPECT_EQ(after["compiler_cache"].get<size_t>(), 0);
+	EXPECT_LT(after["total"].get<size_t>(), before["total"].get<size_t>());
+	EXPECT_EQ(after["engine_rules"], before["engine_rules"]);
+	EXPECT_EQ(after["rulesets"], before["rulesets"]);
+
+	// the rules are still there, but can't be described anymore
+	EXPECT_EQ(m_engine->get_rules().size(), 2);
+	EXPECT_EQ(num_rules_for_ruleset(), 2);
+	EXPECT_THROW(m_engine->describe_rule(nullptr, {}), falco_exception);
+	std::stringstream cache;
+	EXPECT_THROW(m_engine->write_rules_cache(cache, "key"), falco_exception);
+
+	// loading rules again works as usual
+	ASSERT_TRUE(load_rules(report_rules, "report_rules.yaml")) << m_load_result_string;
+	EXPECT_FALSE(m_engine->rules_memory_report()["loading_state_released"].get<bool>());
+	EXPECT_NO_THROW(m_engine->describe_rule(nullptr, {}));
+}
+
+TEST_F(test_falco_engine, formatters_memory_usage)
+{
+	size_t empty = m_engine->formatters_memory_usage(falco_common::syscall_source);
+	ASSERT_TRUE(load_rules(report_rules, "report_rules.yaml")) << m_load_result_string;
+	m_engine->complete_rule_loading();
+	size_t compiled = m_engine->formatters_memory_usage(falco_common::syscall_source);
+	EXPECT_GE(compiled, empty + 2 * sizeof(std::string));
+	EXPECT_EQ(m_engine->formatters_memory_usage("unknown"), 0);
+
+	// the formatters created on demand are accounted for as well
+	m_engine->get_formatter(falco_common::syscall_source, "%proc.name %fd.name");
+	EXPECT_GT(m_engine->formatters_memory_usage(falco_common::syscall_source), compiled);
+}
@@ -17,6 +17,13 @@ limitations under the License.
 
 #include <gtest/gtest.h>
 #include <engine/evttype_index_ruleset.h>
+#include "../test_events.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <thread>
 
 #define RULESET_0 0
 #define RULESET_1 1
@@ -202,3 +209,890 @@ TEST(Ruleset, enable_disable_rules_using_tags)
 	ASSERT_EQ(r->enabled_count(RULESET_1), 0);
 	ASSERT_EQ(r->enabled_count(RULESET_2), 0);
 }
+
+TEST(Ruleset, shared_predicates)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+
+	auto ast_A = libsinsp::filter::parser("evt.type=open and (proc.name=cat and fd.name=/etc/passwd)").parse();
+	auto ast_B = libsinsp::filter::parser("evt.type=open and proc.name=cat or fd.name=/etc/shadow").parse();
+	auto ast_C = libsinsp::filter::parser("proc.name=cat and evt.type=open").parse();
+
+	std::vector<const libsinsp::filter::ast::expr*> conjuncts;
+	shared_filter_predicates::conjuncts(ast_A.get(), conjuncts);
+	ASSERT_EQ(conjuncts.size(), 3);
+
+	conjuncts.clear();
+	shared_filter_predicates::conjuncts(ast_B.get(), conjuncts);
+	ASSERT_EQ(conjuncts.size(), 1);
+
+	shared_filter_predicates predicates(f);
+	conjuncts.clear();
+	shared_filter_predicates::conjuncts(ast_A.get(), conjuncts);
+	shared_filter_predicates::conjuncts(ast_C.get(), conjuncts);
+	std::vector<size_t> indexes;
+	for(const auto* c : conjuncts)
+	{
+		indexes.push_back(predicates.add(c));
+	}
+	ASSERT_EQ(predicates.size(), 3);
+	ASSERT_EQ(indexes[3], indexes[1]);
+	ASSERT_EQ(indexes[4], indexes[0]);
+
+	predicates.clear();
+	ASSERT_EQ(predicates.size(), 0);
+}
+
+// Returns the names of the rules of the ruleset matching an event
+static std::vector<std::string> matching_rules(filter_ruleset& r, sinsp_evt* evt)
+{
+	std::vector<const falco_rule*> matches;
+	r.run(evt, matches, RULESET_0);
+	std::vector<std::string> res;
+	for(const auto* m : matches)
+	{
+		res.push_back(m->name);
+	}
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+TEST(Ruleset, shared_predicates_match_as_unshared)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto shared = create_ruleset(f);
+	auto unshared = create_ruleset(f);
+
+	const std::vector<std::string> conditions = {
+		"evt.type=openat and proc.name=cat and fd.name startswith /etc",
+		"evt.type=openat and proc.name=cat and fd.name=/etc/shadow",
+		"evt.type in (openat, close) and proc.name=less",
+		"proc.name=cat and evt.type=close",
+	};
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		auto filter = create_filter(f, ast.get());
+		shared->add(rule, filter, ast);
+		unshared->add(rule, filter, ast);
+	}
+	shared->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	unshared->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	/* only the rules of this ruleset share their predicates */
+	shared->on_loading_complete();
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto less = events.add_process("less");
+	std::vector<sinsp_evt*> evts = {
+		events.open(cat, "/etc/passwd"),
+		events.open(cat, "/etc/shadow"),
+		events.open(cat, "/tmp/file"),
+		events.open(less, "/etc/shadow"),
+		events.close(cat),
+		events.close(less),
+	};
+
+	size_t num_matches = 0;
+	for(auto* evt : evts)
+	{
+		auto expected = matching_rules(*unshared, evt);
+		ASSERT_EQ(matching_rules(*shared, evt), expected) << evt->get_num();
+		num_matches += expected.size();
+	}
+	ASSERT_EQ(num_matches, 6);
+
+	/* the results of the previous event are not reused for another
+	event with the same number */
+	auto evt = events.open(less, "/tmp/file");
+	evt->set_num(evts[1]->get_num());
+	ASSERT_EQ(matching_rules(*shared, evts[1]), std::vector<std::string>({"rule_0", "rule_1"}));
+	ASSERT_EQ(matching_rules(*shared, evt), std::vector<std::string>({"rule_2"}));
+}
+
+TEST(Ruleset, enabled_codes_follow_enable_disable)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	auto ast_open = libsinsp::filter::parser("evt.type=open").parse();
+	auto ast_read = libsinsp::filter::parser("evt.type in (open, read)").parse();
+
+	falco_rule rule_A = {};
+	rule_A.name = "rule_A";
+	rule_A.source = falco_common::syscall_source;
+
+	falco_rule rule_B = {};
+	rule_B.name = "rule_B";
+	rule_B.source = falco_common::syscall_source;
+
+	r->add(rule_A, create_filter(f, ast_open.get()), ast_open);
+	r->add(rule_B, create_filter(f, ast_read.get()), ast_read);
+
+	r->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	ASSERT_TRUE(r->enabled_sc_codes(RULESET_0).contains(PPM_SC_OPEN));
+	ASSERT_TRUE(r->enabled_sc_codes(RULESET_0).contains(PPM_SC_READ));
+
+	/* open is still enabled by rule_A */
+	r->disable(rule_B.name, filter_ruleset::match_type::exact, RULESET_0);
+	ASSERT_TRUE(r->enabled_sc_codes(RULESET_0).contains(PPM_SC_OPEN));
+	ASSERT_FALSE(r->enabled_sc_codes(RULESET_0).contains(PPM_SC_READ));
+
+	r->disable(rule_A.name, filter_ruleset::match_type::exact, RULESET_0);
+	ASSERT_TRUE(r->enabled_sc_codes(RULESET_0).empty());
+	ASSERT_TRUE(r->enabled_event_codes(RULESET_0).empty());
+}
+
+TEST(Ruleset, proc_name_prefilter)
+{
+	auto resolve = [](const std::string& condition)
+	{
+		evttype_index_wrapper wrap;
+		auto ast = libsinsp::filter::parser(condition).parse();
+		evttype_index_ruleset::resolve_proc_name_prefilter(wrap, ast.get());
+		return wrap;
+	};
+
+	auto wrap = resolve("evt.type=execve and proc.name=cat");
+	ASSERT_TRUE(wrap.m_proc_name_prefilter);
+	ASSERT_EQ(wrap.m_proc_names, std::unordered_set<std::string>({"cat"}));
+	ASSERT_TRUE(wrap.m_proc_name_prefixes.empty());
+
+	wrap = resolve("evt.type=execve and (fd.num=1 and proc.name in (cat, less))");
+	ASSERT_TRUE(wrap.m_proc_name_prefilter);
+	ASSERT_EQ(wrap.m_proc_names, std::unordered_set<std::string>({"cat", "less"}));
+
+	wrap = resolve("proc.name startswith runc and evt.type=execve");
+	ASSERT_TRUE(wrap.m_proc_name_prefilter);
+	ASSERT_TRUE(wrap.m_proc_names.empty());
+	ASSERT_EQ(wrap.m_proc_name_prefixes, std::vector<std::string>({"runc"}));
+
+	/* only the first constraint is kept */
+	wrap = resolve("proc.name=cat and proc.name startswith c");
+	ASSERT_EQ(wrap.m_proc_names, std::unordered_set<std::string>({"cat"}));
+	ASSERT_TRUE(wrap.m_proc_name_prefixes.empty());
+
+	/* the constraints that don't have to hold for the rule to match */
+	ASSERT_FALSE(resolve("evt.type=execve or proc.name=cat").m_proc_name_prefilter);
+	ASSERT_FALSE(resolve("evt.type=execve and not proc.name=cat").m_proc_name_prefilter);
+	ASSERT_FALSE(resolve("evt.type=execve and proc.name!=cat").m_proc_name_prefilter);
+	ASSERT_FALSE(resolve("evt.type=execve and proc.name contains cat").m_proc_name_prefilter);
+	ASSERT_FALSE(resolve("evt.type=execve and proc.aname[2]=cat").m_proc_name_prefilter);
+	ASSERT_FALSE(resolve("evt.type=execve and proc.pname=cat").m_proc_name_prefilter);
+}
+
+TEST(Ruleset, network_prefilters_match_as_filters)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	const std::vector<std::string> conditions = {
+		"evt.type=write and fd.sport=443",
+		"evt.type=write and fd.sport in (80, 8080) and proc.name=curl",
+		"evt.type=write and fd.sport >= 1024",
+		"evt.type=write and fd.snet in (10.0.0.0/8, 192.168.0.0/16)",
+		"evt.type=write and fd.sip=10.1.2.3 and fd.sport=443",
+		"evt.type=write and fd.sport!=22",
+	};
+	std::vector<std::shared_ptr<sinsp_filter>> filters;
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		filters.push_back(create_filter(f, ast.get()));
+		r->add(rule, filters.back(), ast);
+	}
+	r->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	r->on_loading_complete();
+
+	test_events events(inspector);
+	auto curl = events.add_process("curl");
+	auto ssh = events.add_process("ssh");
+	std::vector<sinsp_evt*> evts = {
+		events.send(curl, "172.17.0.2", 40000, "10.1.2.3", 443),
+		events.send(curl, "172.17.0.2", 40001, "192.168.1.1", 8080),
+		events.send(ssh, "172.17.0.2", 40002, "8.8.8.8", 22),
+		events.send(ssh, "172.17.0.2", 40003, "10.1.2.4", 443),
+		events.send(curl, "172.17.0.2", 40004, "1.1.1.1", 5000),
+		events.open(curl, "/etc/passwd"),
+	};
+
+	/* the rules skipped by their prefilters are the ones whose filter
+	doesn't match */
+	auto expected_rules = [&](sinsp_evt* evt)
+	{
+		std::vector<std::string> res;
+		for(size_t i = 0; i < filters.size(); i++)
+		{
+			if(filters[i]->run(evt))
+			{
+				res.push_back("rule_" + std::to_string(i));
+			}
+		}
+		std::sort(res.begin(), res.end());
+		return res;
+	};
+	size_t num_matches = 0;
+	for(auto* evt : evts)
+	{
+		auto expected = expected_rules(evt);
+		ASSERT_EQ(matching_rules(*r, evt), expected) << evt->get_num();
+		num_matches += expected.size();
+	}
+	ASSERT_GT(num_matches, 0);
+
+	/* the values of the previous event are not reused for another event
+	with the same number */
+	auto evt = events.send(ssh, "172.17.0.2", 40005, "10.1.2.3", 22);
+	evt->set_num(evts[0]->get_num());
+	ASSERT_EQ(matching_rules(*r, evts[0]), expected_rules(evts[0]));
+	ASSERT_EQ(matching_rules(*r, evt), expected_rules(evt));
+	ASSERT_NE(expected_rules(evt), expected_rules(evts[0]));
+}
+
+TEST(Ruleset, plugin_event_field)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	evttype_index_ruleset r(f);
+
+	auto resolve = [&r](const std::string& condition)
+	{
+		evttype_index_wrapper wrap;
+		auto ast = libsinsp::filter::parser(condition).parse();
+		r.resolve_plugin_event_field(wrap, ast.get());
+		return wrap;
+	};
+
+	auto wrap = resolve("evt.type=pluginevent and proc.name=cat");
+	ASSERT_EQ(wrap.m_plugin_event_field, "proc.name");
+	ASSERT_EQ(wrap.m_plugin_event_values, std::set<std::string>({"cat"}));
+
+	wrap = resolve("fd.name in (/etc/passwd, /etc/shadow) and proc.name=cat");
+	ASSERT_EQ(wrap.m_plugin_event_field, "fd.name");
+	ASSERT_EQ(wrap.m_plugin_event_values, std::set<std::string>({"/etc/passwd", "/etc/shadow"}));
+
+	/* the constraints that don't have to hold, or that are not on the
+	value of a single string field */
+	ASSERT_TRUE(resolve("evt.type=pluginevent or proc.name=cat").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("not proc.name=cat").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("proc.name!=cat").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("proc.name startswith cat").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("proc.aname[2]=cat").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("proc.pid=1").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("evt.source=syscall").m_plugin_event_field.empty());
+	ASSERT_TRUE(resolve("unknown.field=cat").m_plugin_event_field.empty());
+
+	/* the fields resolved are extracted as strings */
+	test_events events(inspector);
+	auto evt = events.open(events.add_process("cat"), "/etc/passwd");
+	std::string value;
+	ASSERT_TRUE(r.extract_plugin_event_field(evt, "proc.name", value));
+	ASSERT_EQ(value, "cat");
+	ASSERT_TRUE(r.extract_plugin_event_field(evt, "fd.name", value));
+	ASSERT_EQ(value, "/etc/passwd");
+	ASSERT_FALSE(r.extract_plugin_event_field(evt, "proc.exe", value));
+}
+
+TEST(Ruleset, keyed_event_types_keep_rule_order)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	/* the rules that can match any async event come first and last */
+	const std::vector<std::string> conditions = {
+		"proc.name=cat",
+		"evt.asynctype=container and proc.name=cat",
+		"evt.asynctype in (container, meta) and proc.name=cat",
+		"proc.name startswith c",
+	};
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+	r->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	r->on_loading_complete();
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+
+	const falco_rule* match = nullptr;
+	std::vector<const falco_rule*> matches;
+	auto names = [&matches]()
+	{
+		std::vector<std::string> res;
+		for(const auto* m : matches)
+		{
+			res.push_back(m->name);
+		}
+		return res;
+	};
+
+	auto evt = events.async(cat, "container");
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_0");
+	ASSERT_TRUE(r->run(evt, matches, RULESET_0));
+	ASSERT_EQ(names(), std::vector<std::string>({"rule_0", "rule_1", "rule_2", "rule_3"}));
+
+	evt = events.async(cat, "meta");
+	matches.clear();
+	ASSERT_TRUE(r->run(evt, matches, RULESET_0));
+	ASSERT_EQ(names(), std::vector<std::string>({"rule_0", "rule_2", "rule_3"}));
+
+	/* once the first rule is disabled, the first match is still the
+	first of the remaining rules */
+	r->disable("rule_0", filter_ruleset::match_type::exact, RULESET_0);
+	evt = events.async(cat, "container");
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_1");
+	evt = events.async(cat, "other");
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_3");
+}
+
+TEST(Ruleset, async_event_names)
+{
+	auto resolve = [](const std::string& condition, std::set<std::string>& names)
+	{
+		names.clear();
+		auto ast = libsinsp::filter::parser(condition).parse();
+		return evttype_index_ruleset::resolve_async_event_names(ast.get(), names);
+	};
+
+	std::set<std::string> names;
+	ASSERT_TRUE(resolve("evt.asynctype=container", names));
+	ASSERT_EQ(names, std::set<std::string>({"container"}));
+
+	ASSERT_TRUE(resolve("evt.type in (open, container)", names));
+	ASSERT_EQ(names, std::set<std::string>({"open", "container"}));
+
+	/* one constrained conjunct is enough */
+	ASSERT_TRUE(resolve("proc.name=cat and (evt.asynctype=container and fd.num=1)", names));
+	ASSERT_EQ(names, std::set<std::string>({"container"}));
+
+	/* all the alternatives must be constrained */
+	ASSERT_TRUE(resolve("evt.asynctype=container or (evt.type=meta and proc.name=cat)", names));
+	ASSERT_EQ(names, std::set<std::string>({"container", "meta"}));
+	ASSERT_FALSE(resolve("evt.asynctype=container or proc.name=cat", names));
+	ASSERT_TRUE(names.empty());
+
+	/* the conditions that can match async events of any name */
+	ASSERT_FALSE(resolve("proc.name=cat", names));
+	ASSERT_FALSE(resolve("not evt.asynctype=container", names));
+	ASSERT_FALSE(resolve("evt.asynctype!=container", names));
+	ASSERT_FALSE(resolve("evt.asynctype startswith cont", names));
+	ASSERT_FALSE(resolve("evt.asynctype exists and proc.name=cat", names));
+	ASSERT_TRUE(names.empty());
+}
+
+TEST(Ruleset, async_event_names_any)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	/* the names of the first rule can't be resolved, so it is tried on
+	all the async events */
+	const std::vector<std::string> conditions = {
+		"not evt.asynctype=container and proc.name=cat",
+		"evt.asynctype=container and proc.name=cat",
+	};
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+	r->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	r->on_loading_complete();
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	ASSERT_EQ(matching_rules(*r, events.async(cat, "container")), std::vector<std::string>({"rule_1"}));
+	ASSERT_EQ(matching_rules(*r, events.async(cat, "meta")), std::vector<std::string>({"rule_0"}));
+	ASSERT_TRUE(matching_rules(*r, events.async(events.add_process("less"), "meta")).empty());
+}
+
+// Orders the rules from the last defined to the first one
+class reversed_ruleset : public evttype_index_ruleset
+{
+public:
+	using evttype_index_ruleset::evttype_index_ruleset;
+
+	bool ordering_score(const evttype_index_wrapper& wrap, double& score) override
+	{
+		score = -(double)wrap.m_rule.id;
+		return true;
+	}
+};
+
+TEST(Ruleset, adaptive_ordering)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = std::make_shared<reversed_ruleset>(f);
+
+	const std::vector<std::string> conditions = {
+		"evt.type=openat and proc.name=cat",
+		"evt.type=openat and fd.name startswith /etc",
+		"evt.type in (openat, close) and proc.name=cat",
+		"proc.name=cat",
+	};
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.id = i;
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+	r->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	r->on_loading_complete();
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto evt = events.open(cat, "/etc/passwd");
+	auto all = std::vector<std::string>({"rule_0", "rule_1", "rule_2", "rule_3"});
+
+	const falco_rule* match = nullptr;
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_0");
+	ASSERT_EQ(matching_rules(*r, evt), all);
+
+	/* only the first match changes */
+	r->update_rule_ordering();
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_3");
+	ASSERT_EQ(matching_rules(*r, evt), all);
+
+	/* the ordering of the event types whose rules change is dropped
+	until it is computed again */
+	r->disable("rule_3", filter_ruleset::match_type::exact, RULESET_0);
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_0");
+	r->update_rule_ordering();
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->name, "rule_2");
+	ASSERT_EQ(matching_rules(*r, evt), std::vector<std::string>({"rule_0", "rule_1", "rule_2"}));
+
+	/* the events that match no rule still don't */
+	auto other = events.open(events.add_process("less"), "/tmp/file");
+	ASSERT_FALSE(r->run(other, match, RULESET_0));
+	ASSERT_TRUE(matching_rules(*r, other).empty());
+}
+
+TEST(Ruleset, run_multi)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	const std::vector<std::string> conditions = {
+		"evt.type=openat and proc.name=cat",
+		"evt.type=openat and fd.name startswith /etc",
+		"evt.type=close",
+		"proc.name=cat",
+	};
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.id = i;
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+
+	/* rule_1 is only enabled in RULESET_1, and rule_2 in no ruleset */
+	r->enable("rule_0", filter_ruleset::match_type::exact, RULESET_0);
+	r->enable("rule_3", filter_ruleset::match_type::exact, RULESET_0);
+	r->enable("rule_0", filter_ruleset::match_type::exact, RULESET_1);
+	r->enable("rule_1", filter_ruleset::match_type::exact, RULESET_1);
+	r->enable("rule_3", filter_ruleset::match_type::exact, RULESET_2);
+	r->on_loading_complete();
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto less = events.add_process("less");
+	std::vector<sinsp_evt*> evts = {
+		events.open(cat, "/etc/passwd"),
+		events.open(cat, "/tmp/file"),
+		events.open(less, "/etc/shadow"),
+		events.open(less, "/tmp/file"),
+		events.close(cat),
+		events.close(less),
+	};
+
+	/* the matches are the ones of each ruleset in the mask */
+	std::vector<filter_ruleset::multi_match> matches;
+	for(uint64_t mask = 0; mask < 8; mask++)
+	{
+		for(auto* evt : evts)
+		{
+			std::map<std::string, uint64_t> expected;
+			for(uint16_t id = RULESET_0; id <= RULESET_2; id++)
+			{
+				std::vector<const falco_rule*> single;
+				if((mask & (1 << id)) && r->run(evt, single, id))
+				{
+					for(const auto* m : single)
+					{
+						expected[m->name] |= 1 << id;
+					}
+				}
+			}
+
+			ASSERT_EQ(r->run_multi(evt, mask, matches), !expected.empty());
+			std::map<std::string, uint64_t> actual;
+			for(const auto& m : matches)
+			{
+				/* each rule is reported once */
+				ASSERT_EQ(actual.count(m.rule->name), 0);
+				actual[m.rule->name] = m.rulesets;
+			}
+			ASSERT_EQ(actual, expected) << "mask " << mask << ", event " << evt->get_num();
+		}
+	}
+
+	/* the rulesets out of the mask are not reported */
+	ASSERT_TRUE(r->run_multi(evts[0], 1 << RULESET_1, matches));
+	ASSERT_EQ(matches.size(), 2);
+	for(const auto& m : matches)
+	{
+		ASSERT_EQ(m.rulesets, 1 << RULESET_1);
+	}
+	ASSERT_FALSE(r->run_multi(evts[0], 1 << 3, matches));
+	ASSERT_TRUE(matches.empty());
+}
+
+// Returns the names of the rules of the ruleset matching an event, in the
+// order in which they are reported
+static std::vector<std::string> ordered_matching_rules(filter_ruleset& r, sinsp_evt* evt, uint16_t ruleset_id = RULESET_0)
+{
+	std::vector<const falco_rule*> matches;
+	r.run(evt, matches, ruleset_id);
+	std::vector<std::string> res;
+	for(const auto* m : matches)
+	{
+		res.push_back(m->name);
+	}
+	return res;
+}
+
+TEST(Ruleset, rules_enabled_one_at_a_time)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	/* every third rule only matches close events */
+	const size_t num_rules = 300;
+	for(size_t i = 0; i < num_rules; i++)
+	{
+		falco_rule rule = {};
+		rule.id = i;
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(i % 3 == 0 ? "evt.type=close" : "evt.type=openat and proc.name=cat").parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+
+	/* the rules are evaluated in the order in which they are enabled */
+	std::vector<std::string> expected_open, expected_close;
+	for(size_t i = num_rules; i-- > 0;)
+	{
+		auto name = "rule_" + std::to_string(i);
+		r->enable(name, filter_ruleset::match_type::exact, RULESET_0);
+		(i % 3 == 0 ? expected_close : expected_open).push_back(name);
+	}
+	ASSERT_EQ(r->enabled_count(RULESET_0), num_rules);
+	ASSERT_EQ(r->enabled_count(RULESET_1), 0);
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto open = events.open(cat, "/etc/passwd");
+	auto close = events.close(cat);
+	ASSERT_EQ(ordered_matching_rules(*r, open), expected_open);
+	ASSERT_EQ(ordered_matching_rules(*r, close), expected_close);
+
+	/* disabling the rules one at a time keeps the order of the others */
+	for(size_t i = 0; i < num_rules; i += 2)
+	{
+		r->disable("rule_" + std::to_string(i), filter_ruleset::match_type::exact, RULESET_0);
+	}
+	ASSERT_EQ(r->enabled_count(RULESET_0), num_rules / 2);
+	auto is_odd = [](const std::string& name)
+	{
+		return std::stoul(name.substr(name.find('_') + 1)) % 2 == 1;
+	};
+	std::vector<std::string> odd_open, odd_close;
+	std::copy_if(expected_open.begin(), expected_open.end(), std::back_inserter(odd_open), is_odd);
+	std::copy_if(expected_close.begin(), expected_close.end(), std::back_inserter(odd_close), is_odd);
+	ASSERT_EQ(ordered_matching_rules(*r, open), odd_open);
+	ASSERT_EQ(ordered_matching_rules(*r, close), odd_close);
+
+	/* a rule enabled again goes after the others */
+	r->disable("rule_299", filter_ruleset::match_type::exact, RULESET_0);
+	r->enable("rule_299", filter_ruleset::match_type::exact, RULESET_0);
+	odd_open.erase(odd_open.begin());
+	odd_open.push_back("rule_299");
+	ASSERT_EQ(ordered_matching_rules(*r, open), odd_open);
+
+	const falco_rule* match = nullptr;
+	ASSERT_TRUE(r->run(open, match, RULESET_0));
+	ASSERT_EQ(match->name, odd_open.front());
+}
+
+TEST(Ruleset, matches_point_to_the_added_rules)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	falco_rule rule = {};
+	rule.id = 7;
+	rule.name = "rule_A";
+	rule.source = falco_common::syscall_source;
+	rule.priority = falco_common::PRIORITY_CRITICAL;
+	rule.tags = {"tag_A", "tag_B"};
+	auto ast = libsinsp::filter::parser("evt.type=openat").parse();
+	r->add(rule, create_filter(f, ast.get()), ast);
+	r->enable("rule_A", filter_ruleset::match_type::exact, RULESET_0);
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto evt = events.open(cat, "/etc/passwd");
+
+	const falco_rule* match = nullptr;
+	ASSERT_TRUE(r->run(evt, match, RULESET_0));
+	ASSERT_EQ(match->id, rule.id);
+	ASSERT_EQ(match->name, rule.name);
+	ASSERT_EQ(match->priority, rule.priority);
+	ASSERT_EQ(match->tags, rule.tags);
+
+	/* the matches point to the same rule, whatever the way they are
+	reported and the changes to the enabled rules */
+	std::vector<const falco_rule*> matches;
+	ASSERT_TRUE(r->run(events.open(cat, "/etc/shadow"), matches, RULESET_0));
+	ASSERT_EQ(matches, std::vector<const falco_rule*>({match}));
+	r->disable("rule_A", filter_ruleset::match_type::exact, RULESET_0);
+	ASSERT_FALSE(r->run(evt, matches, RULESET_0));
+	r->enable("rule_A", filter_ruleset::match_type::exact, RULESET_1);
+	const falco_rule* other = nullptr;
+	ASSERT_TRUE(r->run(evt, other, RULESET_1));
+	ASSERT_EQ(other, match);
+}
+
+TEST(Ruleset, run_batch)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	const std::vector<std::string> conditions = {
+		"evt.type=openat and proc.name=cat",
+		"evt.type=openat and fd.name startswith /etc",
+		"evt.type=close",
+		"proc.name=cat",
+	};
+	for(size_t i = 0; i < conditions.size(); i++)
+	{
+		falco_rule rule = {};
+		rule.id = i;
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser(conditions[i]).parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+	r->enable("rule_", filter_ruleset::match_type::substring, RULESET_0);
+	r->on_loading_complete();
+
+	/* the event types are interleaved, as the batch groups them */
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto less = events.add_process("less");
+	std::vector<sinsp_evt*> evts = {
+		events.open(cat, "/etc/passwd"),
+		events.close(less),
+		events.open(less, "/tmp/file"),
+		events.close(cat),
+		events.open(less, "/etc/shadow"),
+		events.open(cat, "/tmp/file"),
+	};
+
+	std::vector<bool> matched;
+	std::vector<filter_ruleset::batch_match> matches;
+	for(auto strategy : {falco_common::rule_matching::FIRST, falco_common::rule_matching::ALL})
+	{
+		/* the matches are the ones of each event on its own, in the
+		order of the events */
+		std::vector<std::pair<size_t, std::string>> expected;
+		size_t expected_matched = 0;
+		for(size_t i = 0; i < evts.size(); i++)
+		{
+			std::vector<std::string> names;
+			const falco_rule* match = nullptr;
+			if(strategy == falco_common::rule_matching::FIRST && r->run(evts[i], match, RULESET_0))
+			{
+				names.push_back(match->name);
+			}
+			else if(strategy == falco_common::rule_matching::ALL)
+			{
+				names = ordered_matching_rules(*r, evts[i]);
+			}
+			for(const auto& n : names)
+			{
+				expected.emplace_back(i, n);
+			}
+			expected_matched += names.empty() ? 0 : 1;
+		}
+
+		ASSERT_EQ(r->run_batch(evts.data(), evts.size(), strategy, matched, matches, RULESET_0), expected_matched);
+		ASSERT_EQ(matched.size(), evts.size());
+		std::vector<std::pair<size_t, std::string>> actual;
+		for(const auto& m : matches)
+		{
+			ASSERT_TRUE(matched[m.evt_idx]);
+			actual.emplace_back(m.evt_idx, m.rule->name);
+		}
+		ASSERT_EQ(actual, expected);
+		ASSERT_EQ((size_t)std::count(matched.begin(), matched.end(), true), expected_matched);
+	}
+
+	/* the events of the other rulesets match nothing */
+	ASSERT_EQ(r->run_batch(evts.data(), evts.size(), falco_common::rule_matching::ALL, matched, matches, RULESET_1), 0);
+	ASSERT_EQ(std::count(matched.begin(), matched.end(), true), 0);
+	ASSERT_TRUE(matches.empty());
+}
+
+TEST(Ruleset, enable_disable_while_running)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	for(size_t i = 0; i < 3; i++)
+	{
+		falco_rule rule = {};
+		rule.id = i;
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		rule.tags = std::set<std::string>{i == 0 ? "always" : "toggled"};
+		auto ast = libsinsp::filter::parser("evt.type=openat and proc.name=cat").parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+	r->enable("rule_0", filter_ruleset::match_type::exact, RULESET_0);
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto evt = events.open(cat, "/etc/passwd");
+
+	/* the rules of a tag are enabled and disabled at once, so that the
+	events see either all or none of them */
+	std::atomic<bool> done = false;
+	std::thread toggler([&]
+	{
+		for(int i = 0; i < 1000; i++)
+		{
+			r->enable_tags({"toggled"}, RULESET_0);
+			r->disable_tags({"toggled"}, RULESET_0);
+		}
+		done = true;
+	});
+
+	const std::vector<std::string> without = {"rule_0"};
+	const std::vector<std::string> with = {"rule_0", "rule_1", "rule_2"};
+	size_t num_inconsistent = 0;
+	while(!done)
+	{
+		auto names = ordered_matching_rules(*r, evt);
+		num_inconsistent += names == without || names == with ? 0 : 1;
+	}
+	toggler.join();
+	ASSERT_EQ(num_inconsistent, 0);
+
+	ASSERT_EQ(ordered_matching_rules(*r, evt), without);
+	ASSERT_EQ(r->enabled_count(RULESET_0), 1);
+}
+
+TEST(Ruleset, batched_changes)
+{
+	sinsp inspector;
+
+	sinsp_filter_check_list filterlist;
+	auto f = create_factory(&inspector, filterlist);
+	auto r = create_ruleset(f);
+
+	for(size_t i = 0; i < 3; i++)
+	{
+		falco_rule rule = {};
+		rule.id = i;
+		rule.name = "rule_" + std::to_string(i);
+		rule.source = falco_common::syscall_source;
+		auto ast = libsinsp::filter::parser("evt.type=openat").parse();
+		r->add(rule, create_filter(f, ast.get()), ast);
+	}
+	r->enable("rule_0", filter_ruleset::match_type::exact, RULESET_0);
+
+	test_events events(inspector);
+	auto cat = events.add_process("cat");
+	auto evt = events.open(cat, "/etc/passwd");
+
+	/* the changes of a batch are only seen once committed */
+	r->begin_changes();
+	r->enable("rule_1", filter_ruleset::match_type::exact, RULESET_0);
+	r->enable("rule_2", filter_ruleset::match_type::exact, RULESET_0);
+	r->disable("rule_0", filter_ruleset::match_type::exact, RULESET_0);
+	ASSERT_EQ(ordered_matching_rules(*r, evt), std::vector<std::string>({"rule_0"}));
+	ASSERT_EQ(r->enabled_count(RULESET_0), 1);
+	r->commit_changes();
+	ASSERT_EQ(ordered_matching_rules(*r, evt), std::vector<std::string>({"rule_1", "rule_2"}));
+	ASSERT_EQ(r->enabled_count(RULESET_0), 2);
+
+	/* outside of a batch, each change is seen right away */
+	r->enable("rule_0", filter_ruleset::match_type::exact, RULESET_0);
+	ASSERT_EQ(ordered_matching_rules(*r, evt), std::vector<std::string>({"rule_1", "rule_2", "rule_0"}));
+}
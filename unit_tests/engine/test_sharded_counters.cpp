@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <engine/sharded_counters.h>
+
+#include <thread>
+#include <vector>
+
+TEST(ShardedCounters, add_and_resize)
+{
+	falco::sharded_counters c;
+	EXPECT_TRUE(c.empty());
+
+	c.resize(3);
+	EXPECT_EQ(c.size(), 3);
+	c.add(0);
+	c.add(2, 5);
+	EXPECT_EQ(c[0], 1);
+	EXPECT_EQ(c[1], 0);
+	EXPECT_EQ(c[2], 5);
+
+	// growing keeps the values, including past the first cache line
+	for (size_t i = 3; i < 100; i++)
+	{
+		c.resize(i + 1);
+		c.add(i, i);
+	}
+	EXPECT_EQ(c[0], 1);
+	EXPECT_EQ(c[2], 5);
+	EXPECT_EQ(c[99], 99);
+
+	// shrinking drops the values of the removed counters
+	c.resize(2);
+	c.resize(3);
+	EXPECT_EQ(c[0], 1);
+	EXPECT_EQ(c[2], 0);
+
+	c.clear();
+	EXPECT_TRUE(c.empty());
+}
+
+TEST(ShardedCounters, concurrent_adds)
+{
+	falco::sharded_counters c(10);
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < 2 * falco::sharded_counters::num_shards; t++)
+	{
+		threads.emplace_back([&c, t]()
+		{
+			for (int i = 0; i < 10000; i++)
+			{
+				c.add(t % c.size());
+			}
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < c.size(); i++)
+	{
+		total += c[i];
+	}
+	EXPECT_EQ(total, 2 * falco::sharded_counters::num_shards * 10000);
+	EXPECT_EQ(c[0], 2 * 10000);
+}
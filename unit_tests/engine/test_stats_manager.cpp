@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <engine/stats_manager.h>
+#include <engine/falco_rule.h>
+
+#include <thread>
+#include <vector>
+
+TEST(StatsManager, rule_profiling)
+{
+	stats_manager stats;
+	falco_rule rule;
+	rule.id = 1;
+	rule.name = "test rule";
+	stats.on_rule_loaded(rule);
+
+	EXPECT_FALSE(stats.is_rule_profiling_enabled());
+	stats.set_rule_profiling(true, 0);
+	EXPECT_TRUE(stats.is_rule_profiling_enabled());
+	EXPECT_EQ(stats.get_rule_profiling_sampling_period(), 1);
+
+	stats.on_rule_evaluated(1, true);
+	stats.on_rule_evaluated(1, false);
+	stats.on_rule_evaluated(1, false);
+	stats.on_rule_evaluated(1, false);
+	stats.on_rule_evaluation_sampled(1, 100);
+	stats.on_rule_evaluation_sampled(1, 300);
+
+	// unknown rules are ignored
+	stats.on_rule_evaluated(10, true);
+	stats.on_rule_evaluation_sampled(10, 100);
+
+	const auto& profile = *stats.get_profile_by_rule_id()[1];
+	EXPECT_EQ(profile.evaluations.load(), 4);
+	EXPECT_EQ(profile.matches.load(), 1);
+	EXPECT_EQ(profile.sampled_evaluations.load(), 2);
+	EXPECT_EQ(profile.estimated_time_ns(), 800);
+	EXPECT_EQ(profile.time_percentile_ns(50), 128);
+	EXPECT_EQ(profile.time_percentile_ns(99), 512);
+
+	stats.clear();
+	EXPECT_TRUE(stats.get_profile_by_rule_id().empty());
+	EXPECT_TRUE(stats.is_rule_profiling_enabled());
+}
+
+TEST(StatsManager, rate_limited)
+{
+	stats_manager stats;
+	falco_rule rule;
+	rule.id = 2;
+	rule.name = "test rule";
+	stats.on_rule_loaded(rule);
+
+	stats.on_event(rule);
+	stats.on_event(rule);
+	stats.on_rate_limited(rule);
+	EXPECT_EQ(stats.get_total(), 2);
+	EXPECT_EQ(stats.get_rate_limited_total(), 1);
+	EXPECT_EQ(stats.get_rate_limited_by_rule_id()[2], 1);
+
+	falco_rule unknown;
+	unknown.id = 10;
+	EXPECT_THROW(stats.on_rate_limited(unknown), falco_exception);
+
+	stats.clear();
+	EXPECT_EQ(stats.get_rate_limited_total(), 0);
+	EXPECT_TRUE(stats.get_rate_limited_by_rule_id().empty());
+}
+
+TEST(StatsManager, exception_hits)
+{
+	stats_manager stats;
+	falco_rule rule;
+	rule.id = 1;
+	rule.name = "test rule";
+	stats.on_rule_loaded(rule);
+
+	stats.on_exception_hit(rule);
+	stats.on_exception_hit(rule);
+	EXPECT_EQ(stats.get_total(), 0);
+	EXPECT_EQ(stats.get_exception_hits_total(), 2);
+	EXPECT_EQ(stats.get_exception_hits_by_rule_id()[1], 2);
+
+	// unknown rules are ignored
+	falco_rule unknown;
+	unknown.id = 10;
+	stats.on_exception_hit(unknown);
+	EXPECT_EQ(stats.get_exception_hits_total(), 2);
+
+	stats.clear();
+	EXPECT_EQ(stats.get_exception_hits_total(), 0);
+	EXPECT_TRUE(stats.get_exception_hits_by_rule_id().empty());
+}
+
+TEST(StatsManager, format_profile)
+{
+	stats_manager stats;
+	indexed_vector<falco_rule> rules;
+	for (const auto& name : {"cheap rule", "expensive rule", "unused rule"})
+	{
+		falco_rule rule;
+		rule.name = name;
+		rule.source = "syscall";
+		rule.id = rules.insert(rule, rule.name);
+		rules.at(rule.id)->id = rule.id;
+		stats.on_rule_loaded(rule);
+	}
+
+	// the evaluations are counted even with profiling disabled
+	nlohmann::json out;
+	stats.on_rule_evaluated(0, false);
+	stats.format_profile(rules, out);
+	EXPECT_TRUE(out.is_array());
+	EXPECT_TRUE(out.empty());
+
+	stats.set_rule_profiling(true, 1);
+	stats.on_rule_evaluated(0, true);
+	stats.on_rule_evaluation_sampled(0, 100);
+	stats.on_rule_evaluated(1, false);
+	stats.on_rule_evaluated(1, false);
+	stats.on_rule_evaluation_sampled(1, 200);
+	stats.on_rule_evaluation_sampled(1, 100);
+	stats.format_profile(rules, out);
+
+	ASSERT_EQ(out.size(), 2);
+	EXPECT_EQ(out[0]["name"], "expensive rule");
+	EXPECT_EQ(out[0]["source"], "syscall");
+	EXPECT_EQ(out[0]["evaluations"], 2);
+	EXPECT_EQ(out[0]["matches"], 0);
+	EXPECT_EQ(out[0]["time_ns"], 300);
+	EXPECT_EQ(out[0]["avg_time_ns"], 150);
+	EXPECT_DOUBLE_EQ(out[0]["time_perc"].get<double>(), 60.0);
+	EXPECT_EQ(out[1]["name"], "cheap rule");
+	EXPECT_EQ(out[1]["evaluations"], 2);
+	EXPECT_EQ(out[1]["matches"], 1);
+	EXPECT_EQ(out[1]["time_ns"], 200);
+	EXPECT_EQ(out[1]["time_p99_ns"], 128);
+	EXPECT_DOUBLE_EQ(out[1]["time_perc"].get<double>(), 40.0);
+}
+
+TEST(StatsManager, concurrent_matches)
+{
+	stats_manager stats;
+	std::vector<falco_rule> rules(4);
+	for (size_t i = 0; i < rules.size(); i++)
+	{
+		rules[i].id = i;
+		rules[i].priority = (falco_common::priority_type) i;
+		stats.on_rule_loaded(rules[i]);
+	}
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < 8; t++)
+	{
+		threads.emplace_back([&stats, &rules, t]()
+		{
+			for (int i = 0; i < 10000; i++)
+			{
+				stats.on_event(rules[t % rules.size()]);
+			}
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+
+	EXPECT_EQ(stats.get_total(), 80000);
+	for (size_t i = 0; i < rules.size(); i++)
+	{
+		EXPECT_EQ(stats.get_by_rule_id()[i], 20000);
+		EXPECT_EQ(stats.get_by_priority()[i], 20000);
+	}
+}
+
+TEST(StatsManager, slowest_evaluations)
+{
+	stats_manager stats;
+	indexed_vector<falco_rule> rules;
+	for (const auto& name : {"steady rule", "spiky rule"})
+	{
+		falco_rule rule;
+		rule.name = name;
+		rule.source = "syscall";
+		rule.id = rules.insert(rule, rule.name);
+		rules.at(rule.id)->id = rule.id;
+		stats.on_rule_loaded(rule);
+	}
+	stats.set_rule_profiling(true, 1);
+
+	// only the slowest evaluations are kept, with their event
+	for (uint64_t i = 1; i <= 100; i++)
+	{
+		stats.on_rule_evaluation_sampled(0, 1000 + i, 10, i);
+		stats.on_rule_evaluation_sampled(1, i == 50 ? 5000000 : 100, 20, i);
+	}
+
+	const auto& steady = *stats.get_profile_by_rule_id()[0];
+	auto slowest = steady.slowest();
+	ASSERT_EQ(slowest.size(), stats_manager::rule_profile::num_slowest);
+	for (size_t i = 0; i < slowest.size(); i++)
+	{
+		EXPECT_EQ(slowest[i].time_ns, 1100 - i);
+		EXPECT_EQ(slowest[i].evt_type, 10);
+		EXPECT_EQ(slowest[i].evt_ts, 100 - i);
+	}
+	EXPECT_EQ(steady.max_time_ns(), 1100);
+
+	const auto& spiky = *stats.get_profile_by_rule_id()[1];
+	EXPECT_EQ(spiky.max_time_ns(), 5000000);
+	EXPECT_EQ(spiky.slowest()[0].evt_ts, 50);
+
+	nlohmann::json out;
+	stats.format_slowest(rules, 3, out);
+	ASSERT_EQ(out.size(), 3);
+	EXPECT_EQ(out[0]["name"], "spiky rule");
+	EXPECT_EQ(out[0]["time_ns"], 5000000);
+	EXPECT_EQ(out[0]["evt_type"], 20);
+	EXPECT_EQ(out[0]["evt_ts"], 50);
+	EXPECT_EQ(out[1]["name"], "steady rule");
+	EXPECT_EQ(out[1]["time_ns"], 1100);
+	EXPECT_EQ(out[2]["time_ns"], 1099);
+
+	stats.format_slowest(rules, 0, out);
+	EXPECT_EQ(out.size(), 2 * stats_manager::rule_profile::num_slowest);
+
+	stats.set_rule_profiling(false, 1);
+	stats.format_slowest(rules, 0, out);
+	EXPECT_TRUE(out.empty());
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "indexed_vector.h"
+#include "falco_source.h"
+#include "rule_loader_reader.h"
+#include "rule_loader_streaming_reader.h"
+#include "rule_loader_collector.h"
+
+static nlohmann::json read_rules(rule_loader::reader& reader, const std::string& content, size_t& num_rules)
+{
+	indexed_vector<falco_source> sources;
+	rule_loader::configuration cfg(content, sources, "rules.yaml");
+	rule_loader::collector collector;
+	reader.read(cfg, collector);
+	num_rules = collector.rules().size();
+	return cfg.res->as_json({{"rules.yaml", content}});
+}
+
+TEST(StreamingReader, split_items)
+{
+	std::vector<rule_loader::streaming_reader::item_range> items;
+
+	std::string content = "# comment\n- list: a\n  items: [b]\n\n- macro: c\n  condition: d\n---\n  - rule: e\n";
+	ASSERT_TRUE(rule_loader::streaming_reader::split_items(content, items));
+	ASSERT_EQ(items.size(), 3);
+	EXPECT_EQ(content.substr(items[0].begin, items[0].end - items[0].begin), "- list: a\n  items: [b]\n\n");
+	EXPECT_EQ(items[0].line, 1);
+	EXPECT_EQ(content.substr(items[1].begin, items[1].end - items[1].begin), "- macro: c\n  condition: d\n");
+	EXPECT_EQ(items[1].line, 4);
+	EXPECT_EQ(content.substr(items[2].begin, items[2].end - items[2].begin), "  - rule: e\n");
+	EXPECT_EQ(items[2].line, 7);
+
+	// content that can't be split
+	EXPECT_FALSE(rule_loader::streaming_reader::split_items("[{list: a, items: [b]}]", items));
+	EXPECT_FALSE(rule_loader::streaming_reader::split_items("list: a\n", items));
+	EXPECT_FALSE(rule_loader::streaming_reader::split_items("- list: &a a\n  items: [b]\n", items));
+	EXPECT_FALSE(rule_loader::streaming_reader::split_items("%YAML 1.2\n---\n- list: a\n", items));
+	EXPECT_FALSE(rule_loader::streaming_reader::split_items("  - list: a\n- list: b\n", items));
+}
+
+TEST(StreamingReader, same_results_as_default_reader)
+{
+	std::vector<std::string> contents = {
+		// valid content
+		"- list: a\n  items: [b]\n\n- macro: c\n  condition: evt.type = open\n\n- rule: d\n  desc: d\n  condition: c\n  output: d\n  priority: INFO\n",
+		// validation error in a later item
+		"- list: a\n  items: [b]\n\n- rule: d\n  desc: d\n  condition: evt.type = open\n  output: d\n  priority: INFO\n\n- rule: e\n  desc: e\n  condition: evt.type = open\n  priority: INFO\n",
+		// YAML error in a later item
+		"- list: a\n  items: [b]\n\n- macro: c\n  condition: \"evt.type = open\n",
+		// unknown top level items
+		"- list: a\n  items: [b]\n- unknown: a\n",
+		// content read by the default reader
+		"[{list: a, items: [b]}, {unknown: a}]",
+	};
+
+	for (const auto& content : contents)
+	{
+		rule_loader::reader reader;
+		rule_loader::streaming_reader streaming_reader;
+		size_t num_rules, streaming_num_rules;
+		auto expected = read_rules(reader, content, num_rules);
+		auto actual = read_rules(streaming_reader, content, streaming_num_rules);
+		EXPECT_EQ(expected, actual) << content;
+		EXPECT_EQ(num_rules, streaming_num_rules) << content;
+	}
+}
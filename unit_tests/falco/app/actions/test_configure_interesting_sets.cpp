@@ -100,6 +100,39 @@ TEST_F(test_falco_engine, engine_codes_syscalls_set)
 		"connect", "accept", "accept4", "umount2", "open", "ptrace", "mmap", "execve", "read"}));
 }
 
+TEST_F(test_falco_engine, engine_codes_syscalls_by_rule)
+{
+	std::string rules = R"(
+- rule: network
+  desc: network
+  condition: evt.type in (connect, accept)
+  output: network
+  priority: INFO
+- rule: files
+  desc: files
+  condition: evt.type in (open, connect) and fd.name startswith /etc
+  output: files
+  priority: INFO
+- rule: disabled
+  desc: disabled
+  condition: evt.type = ptrace
+  output: disabled
+  priority: INFO
+  enabled: false
+)";
+	load_rules(rules, "dummy_ruleset.yaml");
+
+	auto by_rule = m_engine->sc_codes_by_rule_for_ruleset(s_sample_source);
+	ASSERT_EQ(by_rule.size(), 2);
+	ASSERT_NAMES_EQ(libsinsp::events::sc_set_to_event_names(by_rule["network"]), strset_t({"connect", "accept"}));
+	ASSERT_NAMES_EQ(libsinsp::events::sc_set_to_event_names(by_rule["files"]), strset_t({"open", "connect"}));
+
+	m_engine->enable_rule("files", false);
+	by_rule = m_engine->sc_codes_by_rule_for_ruleset(s_sample_source);
+	ASSERT_EQ(by_rule.size(), 1);
+	ASSERT_EQ(by_rule.count("network"), 1);
+}
+
 TEST_F(test_falco_engine, preconditions_postconditions)
 {
 	load_rules(ruleset_from_filters(s_sample_filters), "dummy_ruleset.yaml");
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/app/actions/helpers.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Plugins that record the order in which they are inited, by init config,
+// and the largest number of them inited at once
+namespace
+{
+std::mutex s_inited_mtx;
+std::vector<std::string> s_inited;
+std::atomic<int> s_initing{0};
+std::atomic<int> s_max_initing{0};
+int s_state;
+
+const char* plugin_get_required_api_version()
+{
+	return PLUGIN_API_VERSION_STR;
+}
+
+const char* plugin_get_version()
+{
+	return "0.1.0";
+}
+
+const char* plugin_get_description()
+{
+	return "test plugin";
+}
+
+const char* plugin_get_contact()
+{
+	return "test";
+}
+
+const char* plugin_get_last_error(ss_plugin_t*)
+{
+	return "";
+}
+
+ss_plugin_t* plugin_init(const ss_plugin_init_input* in, ss_plugin_rc* rc)
+{
+	auto initing = ++s_initing;
+	auto max = s_max_initing.load();
+	while(initing > max && !s_max_initing.compare_exchange_weak(max, initing))
+	{
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	{
+		std::lock_guard<std::mutex> lk(s_inited_mtx);
+		s_inited.push_back(in->config);
+	}
+	s_initing--;
+	*rc = SS_PLUGIN_SUCCESS;
+	return reinterpret_cast<ss_plugin_t*>(&s_state);
+}
+
+void plugin_destroy(ss_plugin_t*)
+{
+}
+
+const char* plugin_get_extract_event_sources()
+{
+	return R"(["syscall"])";
+}
+
+ss_plugin_rc plugin_extract_fields(ss_plugin_t*, const ss_plugin_event_input*, const ss_plugin_field_extract_input*)
+{
+	return SS_PLUGIN_SUCCESS;
+}
+
+plugin_api test_plugin_api(const char* (*get_name)(), const char* (*get_fields)())
+{
+	plugin_api api{};
+	api.get_required_api_version = plugin_get_required_api_version;
+	api.get_version = plugin_get_version;
+	api.get_name = get_name;
+	api.get_description = plugin_get_description;
+	api.get_contact = plugin_get_contact;
+	api.get_last_error = plugin_get_last_error;
+	api.init = plugin_init;
+	api.destroy = plugin_destroy;
+	api.get_fields = get_fields;
+	api.get_extract_event_sources = plugin_get_extract_event_sources;
+	api.extract_fields = plugin_extract_fields;
+	return api;
+}
+
+class init_plugins_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		s_inited.clear();
+		s_initing = 0;
+		s_max_initing = 0;
+		m_api_a = test_plugin_api(
+			[]() { return "test_a"; },
+			[]() { return R"([{"type": "string", "name": "test_a.f", "desc": "f"}])"; });
+		m_api_b = test_plugin_api(
+			[]() { return "test_b"; },
+			[]() { return R"([{"type": "string", "name": "test_b.f", "desc": "f"}])"; });
+	}
+
+	static falco_configuration::plugin_config config(const std::string& init_config)
+	{
+		falco_configuration::plugin_config c;
+		c.m_name = init_config;
+		c.m_library_path = "lib" + init_config + ".so";
+		c.m_init_config = init_config;
+		return c;
+	}
+
+	plugin_api m_api_a;
+	plugin_api m_api_b;
+};
+} // namespace
+
+TEST_F(init_plugins_test, one_inspector_inits_serially_in_order)
+{
+	// as in capture mode, where all the sources share an inspector
+	sinsp inspector;
+	auto a = inspector.register_plugin(&m_api_a);
+	auto b = inspector.register_plugin(&m_api_b);
+	auto config_a = config("a");
+	auto config_b = config("b");
+	std::vector<falco::app::actions::plugin_init> inits = {
+		{&inspector, "syscall", b, &config_b},
+		{&inspector, "other", a, &config_a},
+	};
+
+	std::string err;
+	ASSERT_TRUE(falco::app::actions::init_plugins(inits, err)) << err;
+	std::vector<std::string> expected = {"b", "a"};
+	EXPECT_EQ(s_inited, expected);
+	EXPECT_EQ(s_max_initing, 1);
+	EXPECT_GT(inits[0].duration.count(), 0);
+	EXPECT_GT(inits[1].duration.count(), 0);
+}
+
+TEST_F(init_plugins_test, each_inspector_inits_in_order)
+{
+	// as in live mode, where each source has its own inspector
+	sinsp inspector1;
+	sinsp inspector2;
+	auto a1 = inspector1.register_plugin(&m_api_a);
+	auto b1 = inspector1.register_plugin(&m_api_b);
+	auto a2 = inspector2.register_plugin(&m_api_a);
+	auto b2 = inspector2.register_plugin(&m_api_b);
+	auto config_a1 = config("a1");
+	auto config_b1 = config("b1");
+	auto config_a2 = config("a2");
+	auto config_b2 = config("b2");
+	std::vector<falco::app::actions::plugin_init> inits = {
+		{&inspector1, "syscall", a1, &config_a1},
+		{&inspector2, "other", b2, &config_b2},
+		{&inspector1, "syscall", b1, &config_b1},
+		{&inspector2, "other", a2, &config_a2},
+	};
+
+	std::string err;
+	ASSERT_TRUE(falco::app::actions::init_plugins(inits, err)) << err;
+	ASSERT_EQ(s_inited.size(), 4u);
+	auto pos = [](const std::string& name)
+	{
+		return std::find(s_inited.begin(), s_inited.end(), name) - s_inited.begin();
+	};
+	EXPECT_LT(pos("a1"), pos("b1"));
+	EXPECT_LT(pos("b2"), pos("a2"));
+	EXPECT_LE(s_max_initing, 2);
+}
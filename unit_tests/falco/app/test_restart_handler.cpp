@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/app/restart_handler.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+class restart_handler_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_dir = std::filesystem::temp_directory_path() / ("falco_restart_" + std::to_string(getpid()));
+		std::filesystem::remove_all(m_dir);
+		std::filesystem::create_directories(m_dir / "rules.d");
+		m_file = (m_dir / "falco.yaml").string();
+		write(m_file, "a: 1\n");
+	}
+
+	void TearDown() override
+	{
+		m_handler.reset();
+		std::filesystem::remove_all(m_dir);
+	}
+
+	static void write(const std::string& path, const std::string& contents)
+	{
+		std::ofstream out(path, std::ios::trunc);
+		out << contents;
+	}
+
+	// Starts watching the file, loaded with the given contents, and the
+	// folder. The dry runs fail, so that no restart is ever triggered.
+	void start(const std::string& contents)
+	{
+		falco::app::restart_handler::watch_sums_t sums = {
+			{m_file, falco::file_sha256sums::of_contents(contents)}};
+		m_handler = std::make_unique<falco::app::restart_handler>(
+			[this]()
+			{
+				m_num_checks++;
+				return false;
+			},
+			falco::app::restart_handler::watch_list_t{m_file},
+			falco::app::restart_handler::watch_list_t{(m_dir / "rules.d").string()},
+			sums);
+		std::string err;
+		ASSERT_TRUE(m_handler->start(err)) << err;
+	}
+
+	// Waits for a dry run, which follows a change after the debouncing
+	// timeout, or for 2 seconds
+	bool wait_check()
+	{
+		for(int i = 0; i < 200 && m_num_checks == 0; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return m_num_checks > 0;
+	}
+
+	std::filesystem::path m_dir;
+	std::string m_file;
+	std::atomic<int> m_num_checks{0};
+	std::unique_ptr<falco::app::restart_handler> m_handler;
+};
+
+TEST_F(restart_handler_test, touched_file_does_not_restart)
+{
+	start("a: 1\n");
+
+	// as touch does, and as a rewrite with the same contents
+	::close(::open(m_file.c_str(), O_WRONLY));
+	write(m_file, "a: 1\n");
+	EXPECT_FALSE(wait_check());
+}
+
+TEST_F(restart_handler_test, changed_file_restarts)
+{
+	start("a: 1\n");
+
+	write(m_file, "a: 2\n");
+	EXPECT_TRUE(wait_check());
+}
+
+TEST_F(restart_handler_test, file_changed_since_loaded_restarts)
+{
+	// the file doesn't have the contents it was loaded with anymore
+	start("a: 0\n");
+
+	::close(::open(m_file.c_str(), O_WRONLY));
+	EXPECT_TRUE(wait_check());
+}
+
+TEST_F(restart_handler_test, changed_folder_restarts)
+{
+	start("a: 1\n");
+
+	write((m_dir / "rules.d" / "rules.yaml").string(), "");
+	EXPECT_TRUE(wait_check());
+}
+
+TEST_F(restart_handler_test, forced_restart)
+{
+	start("a: 1\n");
+
+	m_handler->trigger();
+	EXPECT_TRUE(wait_check());
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/alert_aggregator.h>
+
+#include <mutex>
+#include <vector>
+
+using namespace falco::outputs;
+
+static alert_aggregator::group make_group(const std::string& rule)
+{
+	alert_aggregator::group g;
+	g.rule = rule;
+	return g;
+}
+
+TEST(AlertAggregator, suppress_and_summarize_on_stop)
+{
+	std::vector<alert_aggregator::group> summaries;
+	alert_aggregator agg(std::chrono::hours(1), 10, [&](alert_aggregator::group& g) { summaries.push_back(g); });
+
+	// nothing is suppressed until a group is opened
+	ASSERT_FALSE(agg.suppress("a", 1));
+	agg.open("a", make_group("rule a"));
+	ASSERT_FALSE(agg.suppress("b", 2));
+	agg.open("b", make_group("rule b"));
+
+	ASSERT_TRUE(agg.suppress("a", 3));
+	ASSERT_TRUE(agg.suppress("a", 4));
+	ASSERT_TRUE(agg.suppress("a", 5));
+	ASSERT_FALSE(agg.suppress("c", 6));
+	EXPECT_EQ(agg.num_suppressed(), 3);
+
+	// only the groups with suppressed alerts are summarized
+	agg.stop();
+	ASSERT_EQ(summaries.size(), 1);
+	EXPECT_EQ(summaries[0].rule, "rule a");
+	EXPECT_EQ(summaries[0].count, 3);
+	EXPECT_EQ(summaries[0].first_ts, 3);
+	EXPECT_EQ(summaries[0].last_ts, 5);
+}
+
+TEST(AlertAggregator, window_expiration)
+{
+	std::mutex mtx;
+	std::vector<alert_aggregator::group> summaries;
+	alert_aggregator agg(std::chrono::milliseconds(20), 10, [&](alert_aggregator::group& g)
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		summaries.push_back(g);
+	});
+
+	agg.open("a", make_group("rule a"));
+	ASSERT_TRUE(agg.suppress("a", 1));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	// the window is over, so the alert opens a new group
+	ASSERT_FALSE(agg.suppress("a", 2));
+	agg.open("a", make_group("rule a"));
+	ASSERT_TRUE(agg.suppress("a", 3));
+
+	agg.stop();
+	ASSERT_EQ(summaries.size(), 2);
+	EXPECT_EQ(summaries[0].count, 1);
+	EXPECT_EQ(summaries[0].first_ts, 1);
+	EXPECT_EQ(summaries[1].count, 1);
+	EXPECT_EQ(summaries[1].first_ts, 3);
+}
+
+TEST(AlertAggregator, max_groups)
+{
+	alert_aggregator agg(std::chrono::hours(1), 1, [](alert_aggregator::group&) {});
+
+	agg.open("a", make_group("rule a"));
+	agg.open("b", make_group("rule b"));
+	ASSERT_TRUE(agg.suppress("a", 1));
+	ASSERT_FALSE(agg.suppress("b", 2));
+}
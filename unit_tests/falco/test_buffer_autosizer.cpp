@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/buffer_autosizer.h>
+
+TEST(buffer_autosizer, recommendation)
+{
+	falco::buffer_autosizer a(4, 6, 0.001, 2);
+	EXPECT_EQ(a.preset(), 4);
+	EXPECT_EQ(a.recommended_preset(), 4);
+
+	// intervals without drops, or below the rate, don't count
+	EXPECT_FALSE(a.update(1000, 0));
+	EXPECT_FALSE(a.update(10000, 1));
+	EXPECT_FALSE(a.update(0, 0));
+	EXPECT_EQ(a.drop_intervals(), 0);
+
+	// the intervals with drops needn't be consecutive
+	EXPECT_FALSE(a.update(1000, 10));
+	EXPECT_FALSE(a.update(1000, 0));
+	EXPECT_TRUE(a.update(1000, 10));
+	EXPECT_EQ(a.recommended_preset(), 5);
+	EXPECT_FALSE(a.update(1000, 10));
+	EXPECT_TRUE(a.update(1000, 10));
+	EXPECT_EQ(a.recommended_preset(), 6);
+
+	// never past the max
+	EXPECT_FALSE(a.update(1000, 10));
+	EXPECT_FALSE(a.update(1000, 10));
+	EXPECT_EQ(a.recommended_preset(), 6);
+	EXPECT_EQ(a.preset(), 4);
+
+	std::map<std::string, uint64_t> metrics;
+	a.get_metrics(metrics);
+	EXPECT_EQ(metrics["buf_size.preset"], 4u);
+	EXPECT_EQ(metrics["buf_size.recommended_preset"], 6u);
+	EXPECT_EQ(metrics["buf_size.drop_intervals"], 6u);
+}
+
+TEST(buffer_autosizer, preset_bytes)
+{
+	EXPECT_EQ(falco::buffer_autosizer::preset_bytes(1), 1u << 20);
+	EXPECT_EQ(falco::buffer_autosizer::preset_bytes(4), 1u << 23);
+	EXPECT_EQ(falco::buffer_autosizer::preset_bytes(10), 1u << 29);
+
+	// the max is never below the starting preset
+	falco::buffer_autosizer a(8, 4, 0, 1);
+	EXPECT_FALSE(a.update(10, 1));
+	EXPECT_EQ(a.recommended_preset(), 8);
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/capture_files.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdlib.h>
+
+TEST(capture_files, list)
+{
+	char dirname[] = "/tmp/falco_test_capture_files_XXXXXX";
+	ASSERT_NE(mkdtemp(dirname), nullptr);
+	std::string dir = dirname;
+	std::filesystem::create_directory(dir + "/sub");
+	for(const auto& name : {"b.scap", "a.scap", "notes.txt", "sub/c.scap"})
+	{
+		std::ofstream(dir + "/" + name) << "x";
+	}
+
+	std::vector<std::string> files;
+	std::string err;
+	ASSERT_TRUE(falco::capture_files::list({dir + "/notes.txt", dir}, files, err)) << err;
+	std::vector<std::string> expected = {dir + "/notes.txt", dir + "/a.scap", dir + "/b.scap"};
+	ASSERT_EQ(files, expected);
+
+	files.clear();
+	ASSERT_FALSE(falco::capture_files::list({dir + "/missing.scap"}, files, err));
+	ASSERT_FALSE(err.empty());
+
+	std::filesystem::remove_all(dir);
+}
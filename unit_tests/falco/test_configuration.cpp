@@ -839,3 +839,760 @@ TEST(Configuration, configuration_webserver_ip)
         EXPECT_ANY_THROW(falco_config.init_from_content("", cmdline_config_options));
     }
 }
+
+TEST(Configuration, configuration_outputs_queue_priority_reserve)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_outputs_queue_priority_reserve, 25);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("outputs_queue:\n  capacity: 100\n  priority_reserve: 50\n", {}));
+    EXPECT_EQ(falco_config.m_outputs_queue_capacity, 100);
+    EXPECT_EQ(falco_config.m_outputs_queue_priority_reserve, 50);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("outputs_queue:\n  priority_reserve: 101\n", {}));
+}
+
+TEST(Configuration, configuration_outputs_queue_max_bytes)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_outputs_queue_max_bytes, 0);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("outputs_queue:\n  max_bytes: 16777216\n", {}));
+    EXPECT_EQ(falco_config.m_outputs_queue_max_bytes, 16777216);
+}
+
+TEST(Configuration, configuration_outputs_queue_spill)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_outputs_queue_spill.enabled);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+outputs_queue:
+  spill:
+    enabled: true
+    path: /tmp/spill
+    max_size: 1048576
+    segment_size: 65536
+)", {}));
+    EXPECT_TRUE(falco_config.m_outputs_queue_spill.enabled);
+    EXPECT_EQ(falco_config.m_outputs_queue_spill.path, "/tmp/spill");
+    EXPECT_EQ(falco_config.m_outputs_queue_spill.max_size, 1048576);
+    EXPECT_EQ(falco_config.m_outputs_queue_spill.segment_size, 65536);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("outputs_queue:\n  spill:\n    max_size: 4096\n    segment_size: 8192\n", {}));
+}
+
+TEST(Configuration, configuration_outputs_queue_drain)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_outputs_queue_drain.timeout_ms, 5000);
+    EXPECT_EQ(falco_config.m_outputs_queue_drain.max_alerts, 0);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+outputs_queue:
+  drain:
+    timeout_ms: 10000
+    max_alerts: 1000
+)", {}));
+    EXPECT_EQ(falco_config.m_outputs_queue_drain.timeout_ms, 10000);
+    EXPECT_EQ(falco_config.m_outputs_queue_drain.max_alerts, 1000);
+}
+
+TEST(Configuration, configuration_outputs_route)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("stdout_output:\n  enabled: true\n", {}));
+    ASSERT_EQ(falco_config.m_outputs.size(), 1);
+    EXPECT_TRUE(falco_config.m_outputs[0].route.accepts_all());
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+stdout_output:
+  enabled: true
+  route:
+    min_priority: warning
+    sources: [syscall]
+    tags: [network]
+    exclude_tags: [noisy]
+    rules: ["Outbound *"]
+)", {}));
+    ASSERT_EQ(falco_config.m_outputs.size(), 1);
+    const auto& route = falco_config.m_outputs[0].route;
+    EXPECT_FALSE(route.accepts_all());
+    EXPECT_EQ(route.min_priority, falco_common::PRIORITY_WARNING);
+
+    std::set<std::string> tags = {"network", "mitre"};
+    EXPECT_TRUE(route.accepts(falco_common::PRIORITY_ERROR, "syscall", tags, "Outbound Connection"));
+    EXPECT_FALSE(route.accepts(falco_common::PRIORITY_NOTICE, "syscall", tags, "Outbound Connection"));
+    EXPECT_FALSE(route.accepts(falco_common::PRIORITY_ERROR, "k8s_audit", tags, "Outbound Connection"));
+    EXPECT_FALSE(route.accepts(falco_common::PRIORITY_ERROR, "syscall", {"mitre"}, "Outbound Connection"));
+    EXPECT_FALSE(route.accepts(falco_common::PRIORITY_ERROR, "syscall", {"network", "noisy"}, "Outbound Connection"));
+    EXPECT_FALSE(route.accepts(falco_common::PRIORITY_ERROR, "syscall", tags, "Inbound Connection"));
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("stdout_output:\n  enabled: true\n  route:\n    min_priority: loud\n", {}));
+}
+
+TEST(Configuration, configuration_grpc_threads)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_grpc_contexts_per_thread, 10);
+    EXPECT_TRUE(falco_config.m_grpc_cpus.empty());
+    EXPECT_FALSE(falco_config.m_grpc_rules_api);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+grpc:
+  contexts_per_thread: 4
+  cpus: "2-3,6"
+  rules_api: true
+)", {}));
+    EXPECT_EQ(falco_config.m_grpc_contexts_per_thread, 4);
+    EXPECT_EQ(falco_config.m_grpc_cpus, std::vector<uint32_t>({2, 3, 6}));
+    EXPECT_TRUE(falco_config.m_grpc_rules_api);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("grpc:\n  contexts_per_thread: 0\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("grpc:\n  cpus: \"1-x\"\n", {}));
+}
+
+TEST(Configuration, configuration_plugin_sources_threads)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_plugin_sources_threads, 0);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("plugin_sources_threads: 2\n", {}));
+    EXPECT_EQ(falco_config.m_plugin_sources_threads, 2);
+}
+
+TEST(Configuration, configuration_plugin_event_batch_size)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_plugin_event_batch_size, 64);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("plugin_event_batch_size: 0\n", {}));
+    EXPECT_EQ(falco_config.m_plugin_event_batch_size, 0);
+}
+
+TEST(Configuration, configuration_rules_bundle)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_TRUE(falco_config.m_rules_bundle_path.empty());
+
+    EXPECT_NO_THROW(falco_config.init_from_content("rules_bundle:\n  path: /etc/falco/rules.bundle\n", {}));
+    EXPECT_EQ(falco_config.m_rules_bundle_path, "/etc/falco/rules.bundle");
+
+    // a new bundle is loaded on restarts as the rules files are
+    falco_configuration next;
+    EXPECT_NO_THROW(next.init_from_content("rules_bundle:\n  path: /etc/falco/other.bundle\n", {}));
+    EXPECT_TRUE(falco_config.is_hot_reloadable_to(next));
+}
+
+TEST(Configuration, configuration_replay_capture_files)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("engine:\n  kind: replay\n  replay:\n    capture_file: a.scap\n", {}));
+    EXPECT_EQ(falco_config.m_replay.m_capture_file, "a.scap");
+    EXPECT_TRUE(falco_config.m_replay.m_capture_files.empty());
+    EXPECT_EQ(falco_config.m_replay.m_workers, 1);
+    EXPECT_TRUE(falco_config.m_replay.m_lossless);
+
+    std::string config = R"(
+engine:
+  kind: replay
+  replay:
+    capture_files: [/captures, b.scap]
+    workers: 8
+    lossless: false
+)";
+    EXPECT_NO_THROW(falco_config.init_from_content(config, {}));
+    EXPECT_TRUE(falco_config.m_replay.m_capture_file.empty());
+    std::vector<std::string> expected = {"/captures", "b.scap"};
+    EXPECT_EQ(falco_config.m_replay.m_capture_files, expected);
+    EXPECT_EQ(falco_config.m_replay.m_workers, 8);
+    EXPECT_FALSE(falco_config.m_replay.m_lossless);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("engine:\n  kind: replay\n", {}));
+}
+
+TEST(Configuration, configuration_idle_backoff)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_idle_backoff_enabled);
+    EXPECT_EQ(falco_config.m_idle_backoff.m_spin_timeouts, 16);
+    EXPECT_EQ(falco_config.m_idle_backoff.m_yield_timeouts, 16);
+    EXPECT_EQ(falco_config.m_idle_backoff.m_max_sleep_us, 1000);
+    EXPECT_TRUE(falco_config.m_idle_backoff_sources.empty());
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+idle_backoff:
+  enabled: true
+  spin_timeouts: 4
+  max_sleep_us: 500
+  sources:
+    - source: k8saudit
+      max_sleep_us: 20000
+)", {}));
+    EXPECT_TRUE(falco_config.m_idle_backoff_enabled);
+    EXPECT_EQ(falco_config.m_idle_backoff.m_spin_timeouts, 4);
+    EXPECT_EQ(falco_config.m_idle_backoff.m_yield_timeouts, 16);
+    EXPECT_EQ(falco_config.m_idle_backoff.m_max_sleep_us, 500);
+    ASSERT_EQ(falco_config.m_idle_backoff_sources.size(), 1);
+    EXPECT_EQ(falco_config.m_idle_backoff_sources[0].m_source, "k8saudit");
+    EXPECT_EQ(falco_config.m_idle_backoff_sources[0].m_spin_timeouts, 4);
+    EXPECT_EQ(falco_config.m_idle_backoff_sources[0].m_max_sleep_us, 20000);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("idle_backoff:\n  sources:\n    - max_sleep_us: 10\n", {}));
+}
+
+TEST(Configuration, configuration_flight_recorder)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_flight_recorder.m_enabled);
+    EXPECT_TRUE(falco_config.m_flight_recorder.m_sources.empty());
+    EXPECT_EQ(falco_config.m_flight_recorder.m_max_memory, 64 * 1024 * 1024);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_before_ms, 10000);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_after_ms, 5000);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_min_priority, falco_common::PRIORITY_CRITICAL);
+    EXPECT_TRUE(falco_config.m_flight_recorder.m_tags.empty());
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+flight_recorder:
+  enabled: true
+  sources: [syscall]
+  max_memory: 1048576
+  before_ms: 2000
+  min_priority: error
+  tags: [forensics]
+  path: /tmp/captures
+)", {}));
+    EXPECT_TRUE(falco_config.m_flight_recorder.m_enabled);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_sources, std::set<std::string>({"syscall"}));
+    EXPECT_EQ(falco_config.m_flight_recorder.m_max_memory, 1048576);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_before_ms, 2000);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_after_ms, 5000);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_min_priority, falco_common::PRIORITY_ERROR);
+    EXPECT_EQ(falco_config.m_flight_recorder.m_tags, std::set<std::string>({"forensics"}));
+    EXPECT_EQ(falco_config.m_flight_recorder.m_path, "/tmp/captures");
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("flight_recorder:\n  min_priority: loud\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("flight_recorder:\n  enabled: true\n  path: \"\"\n", {}));
+}
+
+TEST(Configuration, configuration_thread_affinity)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    for(const auto& cpus : falco_config.m_thread_affinity)
+    {
+        EXPECT_TRUE(cpus.empty());
+    }
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+thread_affinity:
+  event_sources: "0-3"
+  outputs: "4,6"
+)", {}));
+    EXPECT_EQ(falco_config.m_thread_affinity[falco::thread_affinity::EVENT_SOURCES], std::vector<uint32_t>({0, 1, 2, 3}));
+    EXPECT_EQ(falco_config.m_thread_affinity[falco::thread_affinity::OUTPUTS], std::vector<uint32_t>({4, 6}));
+    EXPECT_TRUE(falco_config.m_thread_affinity[falco::thread_affinity::STATS].empty());
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("thread_affinity:\n  stats: \"a-b\"\n", {}));
+}
+
+TEST(Configuration, configuration_load_shedding)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_load_shedding.m_enabled);
+    EXPECT_EQ(falco_config.m_load_shedding.m_raise_drop_rate, 0.01);
+    EXPECT_EQ(falco_config.m_load_shedding.m_lower_drop_rate, 0.001);
+    EXPECT_EQ(falco_config.m_load_shedding.m_lower_after_intervals, 5);
+    EXPECT_TRUE(falco_config.m_load_shedding.m_classes.empty());
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+load_shedding:
+  enabled: true
+  raise_drop_rate: 0.05
+  classes:
+    - events: [read, write]
+    - events: [open]
+)", {}));
+    EXPECT_TRUE(falco_config.m_load_shedding.m_enabled);
+    EXPECT_EQ(falco_config.m_load_shedding.m_raise_drop_rate, 0.05);
+    ASSERT_EQ(falco_config.m_load_shedding.m_classes.size(), 2);
+    EXPECT_EQ(falco_config.m_load_shedding.m_classes[0], std::vector<std::string>({"read", "write"}));
+    EXPECT_EQ(falco_config.m_load_shedding.m_classes[1], std::vector<std::string>({"open"}));
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("load_shedding:\n  classes:\n    - events: []\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("load_shedding:\n  raise_drop_rate: 0.001\n  lower_drop_rate: 0.01\n", {}));
+}
+
+TEST(Configuration, configuration_gvisor_shards)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("engine:\n  kind: gvisor\n  gvisor:\n    config: /etc/falco/gvisor.json\n", {}));
+    EXPECT_TRUE(falco_config.m_gvisor.m_shards.empty());
+    EXPECT_EQ(falco_config.m_gvisor.m_max_sandboxes, 1024);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+engine:
+  kind: gvisor
+  gvisor:
+    config: /etc/falco/gvisor.json
+    shards: [/etc/falco/gvisor-1.json, /etc/falco/gvisor-2.json]
+    max_sandboxes: 64
+)", {}));
+    EXPECT_EQ(falco_config.m_gvisor.m_shards, std::vector<std::string>({"/etc/falco/gvisor-1.json", "/etc/falco/gvisor-2.json"}));
+    EXPECT_EQ(falco_config.m_gvisor.m_max_sandboxes, 64);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("engine:\n  kind: gvisor\n  gvisor:\n    config: /a.json\n    shards: [/a.json]\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("engine:\n  kind: gvisor\n  gvisor:\n    config: /a.json\n    shards: [/b.json, /b.json]\n", {}));
+}
+
+TEST(Configuration, configuration_container_budgets)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    const auto& c = falco_config.m_container_budgets;
+    EXPECT_FALSE(c.m_enabled);
+    EXPECT_EQ(c.m_max_evts_rate, 0);
+    EXPECT_EQ(c.m_max_alerts_rate, 0);
+    EXPECT_EQ(c.m_sampling_ratio, 10);
+    EXPECT_EQ(c.m_sampled_events.size(), 10);
+    EXPECT_EQ(c.m_keep_priority, falco_common::PRIORITY_CRITICAL);
+    EXPECT_EQ(c.m_max_containers, 4096);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+container_budgets:
+  enabled: true
+  max_evts_rate: 50000
+  max_alerts_rate: 20
+  sampling_ratio: 5
+  sampled_events: [read, write]
+  keep_priority: error
+  max_containers: 100
+)", {}));
+    EXPECT_TRUE(c.m_enabled);
+    EXPECT_EQ(c.m_max_evts_rate, 50000);
+    EXPECT_EQ(c.m_max_alerts_rate, 20);
+    EXPECT_EQ(c.m_sampling_ratio, 5);
+    EXPECT_EQ(c.m_sampled_events, std::vector<std::string>({"read", "write"}));
+    EXPECT_EQ(c.m_keep_priority, falco_common::PRIORITY_ERROR);
+    EXPECT_EQ(c.m_max_containers, 100);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("container_budgets:\n  sampling_ratio: 0\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("container_budgets:\n  keep_priority: loud\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("container_budgets:\n  max_containers: 0\n", {}));
+}
+
+TEST(Configuration, configuration_thread_table_autosize)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    const auto& c = falco_config.m_falco_libs_thread_table_autosize;
+    EXPECT_FALSE(c.m_enabled);
+    EXPECT_EQ(c.m_min_size, 4096);
+    EXPECT_EQ(c.m_max_memory, 1024 * 1024 * 1024);
+    EXPECT_EQ(c.m_thread_bytes, 4096);
+    EXPECT_EQ(c.m_headroom, 4);
+    EXPECT_EQ(c.m_interval_s, 30);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+falco_libs:
+  thread_table_autosize:
+    enabled: true
+    min_size: 1024
+    max_memory_mb: 64
+    headroom: 2.5
+)", {}));
+    EXPECT_TRUE(c.m_enabled);
+    EXPECT_EQ(c.m_min_size, 1024);
+    EXPECT_EQ(c.m_max_memory, 64 * 1024 * 1024);
+    EXPECT_EQ(c.m_headroom, 2.5);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("falco_libs:\n  thread_table_autosize:\n    headroom: 0.5\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("falco_libs:\n  thread_table_autosize:\n    thread_bytes: 0\n", {}));
+}
+
+TEST(Configuration, configuration_syscall_buf_size_autosize)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_buf_size_autosize.m_enabled);
+    EXPECT_EQ(falco_config.m_buf_size_autosize.m_drop_rate, 0.001);
+    EXPECT_EQ(falco_config.m_buf_size_autosize.m_drop_intervals, 10);
+    EXPECT_EQ(falco_config.m_buf_size_autosize.m_max_preset, 8);
+    EXPECT_FALSE(falco_config.m_buf_size_autosize.m_apply_on_restart);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+syscall_buf_size_autosize:
+  enabled: true
+  drop_intervals: 3
+  max_preset: 6
+  apply_on_restart: true
+)", {}));
+    EXPECT_TRUE(falco_config.m_buf_size_autosize.m_enabled);
+    EXPECT_EQ(falco_config.m_buf_size_autosize.m_drop_intervals, 3);
+    EXPECT_EQ(falco_config.m_buf_size_autosize.m_max_preset, 6);
+    EXPECT_TRUE(falco_config.m_buf_size_autosize.m_apply_on_restart);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("syscall_buf_size_autosize:\n  max_preset: 11\n", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("syscall_buf_size_autosize:\n  drop_intervals: 0\n", {}));
+}
+
+TEST(Configuration, configuration_syscall_event_drops_throttle)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_syscall_evt_drop_actions.count(syscall_evt_drop_action::THROTTLE), 0);
+    EXPECT_TRUE(falco_config.m_syscall_evt_drop_throttle.m_syscalls.empty());
+    EXPECT_EQ(falco_config.m_syscall_evt_drop_throttle.m_after_intervals, 3);
+    EXPECT_EQ(falco_config.m_syscall_evt_drop_throttle.m_restore_after_intervals, 30);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+syscall_event_drops:
+  actions:
+    - log
+    - throttle
+  throttle:
+    syscalls: [read, write]
+    restore_after_intervals: 10
+)", {}));
+    EXPECT_EQ(falco_config.m_syscall_evt_drop_actions.count(syscall_evt_drop_action::THROTTLE), 1);
+    EXPECT_EQ(falco_config.m_syscall_evt_drop_throttle.m_syscalls, std::vector<std::string>({"read", "write"}));
+    EXPECT_EQ(falco_config.m_syscall_evt_drop_throttle.m_restore_after_intervals, 10);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("syscall_event_drops:\n  actions: [throttle]\n", {}));
+}
+
+TEST(Configuration, configuration_base_syscalls_live_update)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_base_syscalls_live_update);
+    EXPECT_FALSE(falco_config.m_base_syscalls_kernel_prefilter);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+base_syscalls:
+  custom_set: []
+  repair: true
+  live_update: true
+  kernel_prefilter: true
+)", {}));
+    EXPECT_TRUE(falco_config.m_base_syscalls_repair);
+    EXPECT_TRUE(falco_config.m_base_syscalls_live_update);
+    EXPECT_TRUE(falco_config.m_base_syscalls_kernel_prefilter);
+}
+
+TEST(Configuration, configuration_metrics_syscall_cost)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_metrics_syscall_cost_enabled);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("metrics:\n  enabled: true\n  syscall_cost_enabled: true\n", {}));
+    EXPECT_TRUE(falco_config.m_metrics_syscall_cost_enabled);
+}
+
+TEST(Configuration, configuration_syscall_event_timeouts_max_stall)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_syscall_evt_timeout_max_stall_ms, 10000);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+syscall_event_timeouts:
+  max_stall_ms: 2500
+)", {}));
+    EXPECT_EQ(falco_config.m_syscall_evt_timeout_max_stall_ms, 2500);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content(R"(
+syscall_event_timeouts:
+  max_stall_ms: 0
+)", {}));
+}
+
+TEST(Configuration, configuration_webserver_prometheus_metrics_cache)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_webserver_config.m_prometheus_metrics_cache_ms, 1000);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+webserver:
+  prometheus_metrics_enabled: true
+  prometheus_metrics_cache_ms: 0
+)", {}));
+    EXPECT_EQ(falco_config.m_webserver_config.m_prometheus_metrics_cache_ms, 0);
+}
+
+TEST(Configuration, configuration_webserver_probes_listen_port)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_webserver_config.m_probes_listen_port, 0);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+webserver:
+  probes_listen_port: 8766
+)", {}));
+    EXPECT_EQ(falco_config.m_webserver_config.m_probes_listen_port, 8766);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content(R"(
+webserver:
+  listen_port: 8766
+  probes_listen_port: 8766
+)", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content(R"(
+webserver:
+  probes_listen_port: 70000
+)", {}));
+}
+
+TEST(Configuration, configuration_metrics_rules_series)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_metrics_rules_series_max, 0);
+    EXPECT_TRUE(falco_config.m_metrics_rules_series_allowlist.empty());
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+metrics:
+  enabled: true
+  rules_series_max: 20
+  rules_series_allowlist: [Terminal shell in container, Read sensitive file untrusted]
+)", {}));
+    EXPECT_EQ(falco_config.m_metrics_rules_series_max, 20);
+    EXPECT_EQ(falco_config.m_metrics_rules_series_allowlist.size(), 2);
+    EXPECT_EQ(falco_config.m_metrics_rules_series_allowlist.count("Terminal shell in container"), 1);
+}
+
+TEST(Configuration, configuration_otlp_exporter)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_otlp.m_enabled);
+    EXPECT_EQ(falco_config.m_otlp.m_endpoint, "http://localhost:4318");
+    EXPECT_TRUE(falco_config.m_otlp.m_metrics_enabled);
+    EXPECT_EQ(falco_config.m_otlp.m_traces_sampling_ratio, 0);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+otlp_exporter:
+  enabled: true
+  endpoint: https://collector:4318
+  headers: ["Authorization: Bearer token"]
+  timeout_ms: 1000
+  metrics_enabled: false
+  traces_sampling_ratio: 0.01
+)", {}));
+    EXPECT_TRUE(falco_config.m_otlp.m_enabled);
+    EXPECT_EQ(falco_config.m_otlp.m_endpoint, "https://collector:4318");
+    ASSERT_EQ(falco_config.m_otlp.m_headers.size(), 1);
+    EXPECT_EQ(falco_config.m_otlp.m_headers[0], "Authorization: Bearer token");
+    EXPECT_EQ(falco_config.m_otlp.m_timeout_ms, 1000);
+    EXPECT_FALSE(falco_config.m_otlp.m_metrics_enabled);
+    EXPECT_DOUBLE_EQ(falco_config.m_otlp.m_traces_sampling_ratio, 0.01);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content(R"(
+otlp_exporter:
+  traces_sampling_ratio: 2
+)", {}));
+
+    EXPECT_ANY_THROW(falco_config.init_from_content(R"(
+otlp_exporter:
+  headers: [Authorization]
+)", {}));
+}
+
+TEST(Configuration, configuration_metrics_ticker)
+{
+    falco_configuration falco_config;
+
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_FALSE(falco_config.m_metrics_ticker_thread);
+
+    EXPECT_NO_THROW(falco_config.init_from_content(R"(
+metrics:
+  enabled: true
+  interval: 20ms
+  ticker: thread
+)", {}));
+    EXPECT_TRUE(falco_config.m_metrics_ticker_thread);
+    EXPECT_EQ(falco_config.m_metrics_interval, 20);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content(R"(
+metrics:
+  ticker: timerfd
+)", {}));
+}
+
+TEST(Configuration, configuration_hot_reload)
+{
+    const std::string base = R"(
+engine:
+  kind: modern_ebpf
+rules_files:
+  - /etc/falco/falco_rules.yaml
+json_output: false
+)";
+    falco_configuration falco_config;
+    EXPECT_NO_THROW(falco_config.init_from_content(base, {}));
+    EXPECT_TRUE(falco_config.m_hot_reload_keep_inspectors);
+
+    // the rules and the outputs can change while keeping the inspectors
+    falco_configuration next;
+    EXPECT_NO_THROW(next.init_from_content(R"(
+engine:
+  kind: modern_ebpf
+rules_files:
+  - /etc/falco/falco_rules.yaml
+  - /etc/falco/falco_rules.local.yaml
+json_output: true
+priority: warning
+)", {}));
+    EXPECT_TRUE(falco_config.is_hot_reloadable_to(next));
+
+    EXPECT_NO_THROW(next.init_from_content(base + "falco_libs:\n  thread_table_size: 1024\n", {}));
+    EXPECT_TRUE(falco_config.is_hot_reloadable_to(next));
+
+    // any other change requires reopening them
+    EXPECT_NO_THROW(next.init_from_content(base, {"engine.kind=kmod"}));
+    EXPECT_FALSE(falco_config.is_hot_reloadable_to(next));
+    EXPECT_NO_THROW(next.init_from_content(base + "webserver:\n  enabled: true\n", {}));
+    EXPECT_FALSE(falco_config.is_hot_reloadable_to(next));
+
+    EXPECT_NO_THROW(falco_config.init_from_content("hot_reload_keep_inspectors: false", {}));
+    EXPECT_FALSE(falco_config.m_hot_reload_keep_inspectors);
+}
+
+TEST(Configuration, configuration_log_queue)
+{
+    falco_configuration falco_config;
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_log_queue_capacity, 4096);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("log_queue_capacity: 0\nlog_repeated_rate_limit: 0", {}));
+    EXPECT_EQ(falco_config.m_log_queue_capacity, 0);
+}
+
+TEST(Configuration, configuration_reload_changed_files)
+{
+    std::ofstream outfile("main.yaml");
+    outfile << "base_value: ${ENV_VAR_RELOAD}\n";
+    outfile.close();
+
+    std::vector<std::string> cmdline_config_options;
+    std::vector<std::string> loaded_conf_files;
+    SET_ENV_VAR("ENV_VAR_RELOAD", "foo");
+    falco_configuration falco_config;
+    ASSERT_NO_THROW(falco_config.init_from_file("main.yaml", loaded_conf_files, cmdline_config_options));
+    ASSERT_EQ(falco_config.config.get_scalar<std::string>("base_value", ""), "foo");
+
+    // the parsed files are reused, but the variables are resolved again
+    SET_ENV_VAR("ENV_VAR_RELOAD", "bar");
+    falco_configuration same_file;
+    ASSERT_NO_THROW(same_file.init_from_file("main.yaml", loaded_conf_files, cmdline_config_options));
+    ASSERT_EQ(same_file.config.get_scalar<std::string>("base_value", ""), "bar");
+
+    // and modifying a loaded config doesn't affect the next ones
+    same_file.config.set_scalar("base_value", "baz");
+    ASSERT_NO_THROW(falco_config.init_from_file("main.yaml", loaded_conf_files, cmdline_config_options));
+    ASSERT_EQ(falco_config.config.get_scalar<std::string>("base_value", ""), "bar");
+
+    outfile.open("main.yaml");
+    outfile << "base_value: changed\n";
+    outfile.close();
+    falco_configuration changed_file;
+    ASSERT_NO_THROW(changed_file.init_from_file("main.yaml", loaded_conf_files, cmdline_config_options));
+    ASSERT_EQ(changed_file.config.get_scalar<std::string>("base_value", ""), "changed");
+
+    std::filesystem::remove("main.yaml");
+    ASSERT_ANY_THROW(changed_file.init_from_file("main.yaml", loaded_conf_files, cmdline_config_options));
+}
+
+TEST(Configuration, configuration_http_output_endpoints)
+{
+    auto http_output = [](const falco_configuration& c)
+    {
+        for(const auto& o : c.m_outputs)
+        {
+            if(o.name == "http")
+            {
+                return o;
+            }
+        }
+        return falco::outputs::config();
+    };
+
+    falco_configuration falco_config;
+    EXPECT_NO_THROW(falco_config.init_from_content("http_output:\n  enabled: true\n  url: http://a", {}));
+    auto o = http_output(falco_config);
+    EXPECT_EQ(o.options["url"], "http://a");
+    EXPECT_EQ(o.options["urls"], "");
+    EXPECT_EQ(o.options["http2"], "false");
+    EXPECT_EQ(o.options["max_connections"], "0");
+    EXPECT_EQ(o.options["unhealthy_after_failures"], "3");
+    EXPECT_EQ(o.options["unhealthy_interval_ms"], "5000");
+
+    // the url can be left out when other endpoints are given
+    EXPECT_NO_THROW(falco_config.init_from_content("http_output:\n  enabled: true\n  urls: [http://b, http://c]\n  http2: true\n  max_connections: 2", {}));
+    o = http_output(falco_config);
+    EXPECT_EQ(o.options["url"], "");
+    EXPECT_EQ(o.options["urls"], "http://b,http://c");
+    EXPECT_EQ(o.options["http2"], "true");
+    EXPECT_EQ(o.options["max_connections"], "2");
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("http_output:\n  enabled: true\n  urls: []", {}));
+    EXPECT_ANY_THROW(falco_config.init_from_content("http_output:\n  enabled: true\n  urls: [\"http://b,http://c\"]", {}));
+}
+
+TEST(Configuration, configuration_metrics_output_file_options)
+{
+    falco_configuration falco_config;
+    EXPECT_NO_THROW(falco_config.init_from_content("", {}));
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_buffer_size, 65536);
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_flush_interval_ms, 1000);
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_rotate_max_size, 0);
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_rotate_max_files, 5);
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_max_backlog_bytes, 4194304);
+
+    EXPECT_NO_THROW(falco_config.init_from_content("metrics:\n  output_file_options:\n    flush_interval_ms: 0\n    rotate:\n      max_size: 1048576\n      max_files: 2", {}));
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_flush_interval_ms, 0);
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_rotate_max_size, 1048576);
+    EXPECT_EQ(falco_config.m_metrics_output_file_options.m_rotate_max_files, 2);
+
+    EXPECT_ANY_THROW(falco_config.init_from_content("metrics:\n  output_file_options:\n    max_backlog_bytes: 0", {}));
+}
@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/container_budgets.h>
+
+static constexpr uint64_t s_sec = 1000000000;
+
+static falco::container_budgets::config make_config()
+{
+	falco::container_budgets::config c;
+	c.m_max_evts_rate = 10;
+	c.m_max_alerts_rate = 2;
+	c.m_sampling_ratio = 4;
+	// only type 1 is sampled
+	c.m_sampled_evt_types = {false, true};
+	c.m_keep_priority = falco_common::PRIORITY_CRITICAL;
+	c.m_max_containers = 4;
+	return c;
+}
+
+TEST(container_budgets, containers)
+{
+	falco::container_budgets cb(make_config());
+	int extractions = 0;
+	auto extract = [&](const std::string& id)
+	{
+		return [&extractions, id]()
+		{
+			extractions++;
+			return id;
+		};
+	};
+
+	auto c1 = cb.container(1, 100, extract("c1"));
+	ASSERT_NE(c1, nullptr);
+	EXPECT_EQ(c1->id, "c1");
+	EXPECT_EQ(extractions, 1);
+
+	// the container of a known thread isn't extracted again, unless the
+	// tid was reused by another thread
+	EXPECT_EQ(cb.container(1, 100, extract("other")), c1);
+	EXPECT_EQ(extractions, 1);
+	EXPECT_NE(cb.container(1, 200, extract("c2")), c1);
+	EXPECT_EQ(extractions, 2);
+
+	// the threads of the same container share it
+	EXPECT_EQ(cb.container(2, 100, extract("c1")), c1);
+
+	// the host is not a container
+	EXPECT_EQ(cb.container(3, 100, extract("")), nullptr);
+	EXPECT_EQ(cb.container(4, 100, extract("host")), nullptr);
+
+	// the containers beyond the maximum are not tracked
+	EXPECT_NE(cb.container(5, 100, extract("c3")), nullptr);
+	EXPECT_NE(cb.container(6, 100, extract("c4")), nullptr);
+	EXPECT_EQ(cb.container(7, 100, extract("c5")), nullptr);
+
+	std::map<std::string, uint64_t> metrics;
+	cb.get_metrics(metrics);
+	EXPECT_EQ(metrics["container_budgets.containers"], 4);
+}
+
+TEST(container_budgets, sampling)
+{
+	falco::container_budgets cb(make_config());
+	auto c = cb.container(1, 0, []() { return std::string("noisy"); });
+	ASSERT_NE(c, nullptr);
+
+	// the events within the budget are never skipped, nor the ones of
+	// the host
+	uint64_t ts = 10 * s_sec;
+	for (int i = 0; i < 10; i++)
+	{
+		EXPECT_FALSE(cb.sample(c, 1, ts));
+		EXPECT_FALSE(cb.sample(nullptr, 1, ts));
+	}
+
+	// over it, one event out of sampling_ratio of the sampled types is
+	// evaluated, and the others are never skipped
+	int skipped = 0;
+	for (int i = 0; i < 40; i++)
+	{
+		skipped += cb.sample(c, 1, ts);
+		EXPECT_FALSE(cb.sample(c, 0, ts));
+		EXPECT_FALSE(cb.sample(c, 1000, ts));
+	}
+	EXPECT_EQ(skipped, 30);
+
+	// the container stays throttled for the next window, even when quiet
+	EXPECT_TRUE(cb.sample(c, 1, ts + s_sec) || cb.sample(c, 1, ts + s_sec));
+	std::map<std::string, uint64_t> metrics;
+	cb.get_metrics(metrics);
+	EXPECT_EQ(metrics["container_budgets.throttled_containers"], 1);
+	EXPECT_EQ(metrics["container_budgets.throttled.noisy"], 30);
+	EXPECT_GE(metrics["container_budgets.skipped_evts"], 31);
+
+	// and not anymore after a window within the budget
+	EXPECT_FALSE(cb.sample(c, 1, ts + 2 * s_sec));
+	EXPECT_FALSE(cb.sample(c, 1, ts + 2 * s_sec));
+	metrics.clear();
+	cb.get_metrics(metrics);
+	EXPECT_EQ(metrics["container_budgets.throttled_containers"], 1);
+	EXPECT_EQ(metrics.count("container_budgets.throttled.noisy"), 1);
+	EXPECT_FALSE(cb.sample(c, 1, ts + 3 * s_sec));
+	metrics.clear();
+	cb.get_metrics(metrics);
+	EXPECT_EQ(metrics["container_budgets.throttled_containers"], 0);
+	EXPECT_EQ(metrics.count("container_budgets.throttled.noisy"), 0);
+}
+
+TEST(container_budgets, aggregation)
+{
+	falco::container_budgets cb(make_config());
+	auto c = cb.container(1, 0, []() { return std::string("noisy"); });
+	ASSERT_NE(c, nullptr);
+
+	uint64_t ts = 10 * s_sec;
+	cb.sample(c, 0, ts);
+	EXPECT_FALSE(cb.aggregate(c, falco_common::PRIORITY_WARNING, "r1", ts));
+	EXPECT_FALSE(cb.aggregate(c, falco_common::PRIORITY_WARNING, "r1", ts));
+	EXPECT_FALSE(cb.aggregate(nullptr, falco_common::PRIORITY_WARNING, "r1", ts));
+
+	// over the budget, the alerts below keep_priority are aggregated
+	EXPECT_TRUE(cb.aggregate(c, falco_common::PRIORITY_WARNING, "r1", ts + 1));
+	EXPECT_TRUE(cb.aggregate(c, falco_common::PRIORITY_ERROR, "r2", ts + 2));
+	EXPECT_TRUE(cb.aggregate(c, falco_common::PRIORITY_WARNING, "r1", ts + 3));
+	EXPECT_FALSE(cb.aggregate(c, falco_common::PRIORITY_CRITICAL, "r3", ts + 4));
+	EXPECT_FALSE(cb.has_summaries());
+
+	// the summary is available once the window ended
+	cb.sample(c, 0, ts + s_sec);
+	ASSERT_TRUE(cb.has_summaries());
+	std::vector<falco::container_budgets::summary> summaries;
+	cb.take_summaries(summaries);
+	EXPECT_FALSE(cb.has_summaries());
+	ASSERT_EQ(summaries.size(), 1);
+	const auto& s = summaries[0];
+	EXPECT_EQ(s.container_id, "noisy");
+	EXPECT_EQ(s.count, 3);
+	EXPECT_EQ(s.first_ts, ts + 1);
+	EXPECT_EQ(s.last_ts, ts + 3);
+	EXPECT_EQ(s.priority, falco_common::PRIORITY_ERROR);
+	EXPECT_EQ(s.rules.at("r1"), 2);
+	EXPECT_EQ(s.rules.at("r2"), 1);
+
+	// the container stays over its budget for the next window
+	EXPECT_TRUE(cb.aggregate(c, falco_common::PRIORITY_WARNING, "r1", ts + s_sec));
+	std::map<std::string, uint64_t> metrics;
+	cb.get_metrics(metrics);
+	EXPECT_EQ(metrics["container_budgets.aggregated_alerts"], 4);
+}
+
+TEST(container_budgets, no_budget)
+{
+	auto c = make_config();
+	c.m_max_evts_rate = 0;
+	c.m_max_alerts_rate = 0;
+	falco::container_budgets cb(c);
+	auto e = cb.container(1, 0, []() { return std::string("noisy"); });
+	for (int i = 0; i < 100; i++)
+	{
+		EXPECT_FALSE(cb.sample(e, 1, s_sec));
+		EXPECT_FALSE(cb.aggregate(e, falco_common::PRIORITY_DEBUG, "r", s_sec));
+	}
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/drop_trends.h>
+
+TEST(drop_trends, window)
+{
+	falco::drop_trends t({"a", "b"}, 3);
+	auto rates = t.get_rates();
+	ASSERT_EQ(rates.size(), 2);
+	EXPECT_EQ(rates[0].category, "a");
+	EXPECT_EQ(rates[1].category, "b");
+	EXPECT_EQ(rates[0].last, 0);
+	EXPECT_EQ(rates[0].total, 0);
+
+	t.record({5, 1});
+	t.record({2, 0});
+	rates = t.get_rates();
+	EXPECT_EQ(rates[0].last, 2);
+	EXPECT_EQ(rates[0].max, 5);
+	EXPECT_EQ(rates[0].total, 7);
+	EXPECT_EQ(rates[1].last, 0);
+	EXPECT_EQ(rates[1].max, 1);
+	EXPECT_EQ(rates[1].total, 1);
+
+	// the oldest intervals fall out of the window
+	t.record({1, 0});
+	t.record({3, 0});
+	rates = t.get_rates();
+	EXPECT_EQ(rates[0].last, 3);
+	EXPECT_EQ(rates[0].max, 3);
+	EXPECT_EQ(rates[0].total, 6);
+	EXPECT_EQ(rates[1].total, 0);
+
+	// missing values count as zero
+	t.record({});
+	rates = t.get_rates();
+	EXPECT_EQ(rates[0].last, 0);
+	EXPECT_EQ(rates[0].total, 4);
+}
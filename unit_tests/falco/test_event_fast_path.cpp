@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/event_fast_path.h>
+
+#include "../test_falco_engine.h"
+
+static std::string execve_rule = R"END(
+- rule: test rule
+  desc: A test rule
+  condition: evt.type=execve
+  output: A test rule matched (evt.type=%evt.type)
+  priority: INFO
+  source: syscall
+)END";
+
+TEST_F(test_falco_engine, event_fast_path_skips_types_without_rules)
+{
+	ASSERT_TRUE(load_rules(execve_rule, "execve_rule.yaml")) << m_load_result_string;
+
+	falco::event_fast_path fp(falco_common::syscall_source);
+	fp.refresh(*m_engine);
+	EXPECT_FALSE(fp.skips(PPME_SYSCALL_EXECVE_19_E));
+	EXPECT_FALSE(fp.skips(PPME_SYSCALL_EXECVE_19_X));
+	EXPECT_TRUE(fp.skips(PPME_SYSCALL_CLOSE_E));
+	EXPECT_TRUE(fp.skips(PPME_SYSCALL_CLOSE_X));
+
+	std::map<std::string, uint64_t> metrics;
+	fp.get_metrics(metrics);
+	EXPECT_EQ(metrics["fast_path_evts"], 2u);
+}
+
+TEST_F(test_falco_engine, event_fast_path_follows_enabled_rules)
+{
+	ASSERT_TRUE(load_rules(execve_rule, "execve_rule.yaml")) << m_load_result_string;
+
+	falco::event_fast_path fp(falco_common::syscall_source);
+	fp.refresh(*m_engine);
+	EXPECT_FALSE(fp.skips(PPME_SYSCALL_EXECVE_19_E));
+
+	m_engine->enable_rule("test rule", false);
+	fp.refresh(*m_engine);
+	EXPECT_TRUE(fp.skips(PPME_SYSCALL_EXECVE_19_E));
+
+	m_engine->enable_rule("test rule", true);
+	fp.refresh(*m_engine);
+	EXPECT_FALSE(fp.skips(PPME_SYSCALL_EXECVE_19_E));
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/event_stages.h>
+
+TEST(event_stages, sampling)
+{
+	falco::event_stages s;
+	int sampled = 0;
+	for(uint32_t i = 0; i < 10 * falco::event_stages::sampling_period; i++)
+	{
+		sampled += s.sample() ? 1 : 0;
+	}
+	EXPECT_EQ(sampled, 10);
+}
+
+TEST(event_stages, metrics)
+{
+	falco::event_stages s;
+	EXPECT_EQ(s.num_timed(), 0);
+	EXPECT_EQ(s.max_evts_rate(falco::event_stages::RULES), 0);
+
+	using namespace std::chrono;
+	s.record({microseconds(1), microseconds(2), nanoseconds(0), microseconds(4), nanoseconds(0)});
+	s.record({microseconds(1), microseconds(2), nanoseconds(0), microseconds(6), nanoseconds(0)});
+
+	EXPECT_EQ(s.num_timed(), 2);
+	EXPECT_EQ(s.time_ns(falco::event_stages::READ), 2000 * falco::event_stages::sampling_period);
+	EXPECT_EQ(s.time_ns(falco::event_stages::RULES), 10000 * falco::event_stages::sampling_period);
+	EXPECT_EQ(s.time_ns(falco::event_stages::STATS), 4000 * falco::event_stages::sampling_period);
+	EXPECT_EQ(s.max_evts_rate(falco::event_stages::READ), 1000000);
+	EXPECT_EQ(s.max_evts_rate(falco::event_stages::STATS), 500000);
+	EXPECT_EQ(s.max_evts_rate(falco::event_stages::DROPS), UINT64_MAX);
+	EXPECT_EQ(s.max_evts_rate(falco::event_stages::RULES), 200000);
+	EXPECT_EQ(s.max_evts_rate(falco::event_stages::OUTPUTS), UINT64_MAX);
+
+	std::map<std::string, uint64_t> metrics;
+	s.get_metrics(metrics);
+	EXPECT_EQ(metrics["rules.time_ns"], 10000 * falco::event_stages::sampling_period);
+	EXPECT_EQ(metrics["rules.max_evts_rate_sec"], 200000);
+	EXPECT_EQ(metrics.count("read.time_ns"), 1);
+	EXPECT_EQ(metrics.count("outputs.max_evts_rate_sec"), 1);
+	EXPECT_EQ(metrics["stats.time_ns"], 4000 * falco::event_stages::sampling_period);
+	EXPECT_EQ(metrics.count("drops.time_ns"), 1);
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <falco/event_types.h>
+
+using namespace std::chrono;
+
+TEST(event_types, counts_by_name)
+{
+	// types 1 and 2 share a name, and type 3 is not counted
+	falco::event_types et({"open", "read", "read", "", "close"});
+	for(int i = 0; i < 10; i++)
+	{
+		et.count(1);
+		et.count(2);
+	}
+	for(int i = 0; i < 5; i++)
+	{
+		et.count(4);
+	}
+	et.count(0);
+	et.count(3);
+	et.count(1000);
+
+	auto stats = et.get_stats();
+	ASSERT_EQ(stats.size(), 3u);
+	EXPECT_EQ(stats[0].name, "read");
+	EXPECT_EQ(stats[0].events, 20u);
+	EXPECT_EQ(stats[1].name, "close");
+	EXPECT_EQ(stats[1].events, 5u);
+	EXPECT_EQ(stats[2].name, "open");
+	EXPECT_EQ(stats[2].events, 1u);
+
+	stats = et.get_stats(2);
+	ASSERT_EQ(stats.size(), 2u);
+	EXPECT_EQ(stats[1].name, "close");
+
+	std::map<std::string, uint64_t> metrics;
+	et.get_metrics(metrics);
+	EXPECT_EQ(metrics.size(), 6u);
+	EXPECT_EQ(metrics["read.num_evts"], 20u);
+	EXPECT_EQ(metrics["read.rules_time_ns"], 0u);
+}
+
+TEST(event_types, extrapolates_rules_time)
+{
+	falco::event_types et({"open", "read"});
+	for(int i = 0; i < 100; i++)
+	{
+		et.count(0);
+	}
+	for(int i = 0; i < 1000; i++)
+	{
+		et.count(1);
+	}
+	et.record(0, microseconds(10));
+	et.record(0, microseconds(30));
+	et.record(1, nanoseconds(100));
+	et.record(1000, seconds(1));
+
+	auto stats = et.get_stats();
+	ASSERT_EQ(stats.size(), 2u);
+	EXPECT_EQ(stats[0].name, "read");
+	EXPECT_EQ(stats[0].rules_time_ns, 100000u);
+	EXPECT_EQ(stats[1].name, "open");
+	EXPECT_EQ(stats[1].rules_time_ns, 2000000u);
+}
+
+TEST(event_types, sampling)
+{
+	falco::event_types et({"open"});
+	int sampled = 0;
+	for(uint32_t i = 0; i < falco::event_types::sampling_period * 3; i++)
+	{
+		sampled += et.sample() ? 1 : 0;
+	}
+	EXPECT_EQ(sampled, 3);
+}
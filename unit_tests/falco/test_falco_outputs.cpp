@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/falco_outputs.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// An output slower than the alerts are sent, which records the ones it
+// writes
+static std::mutex s_delivered_mtx;
+static std::vector<std::string> s_delivered;
+
+class slow_output : public falco::outputs::abstract_output
+{
+public:
+	void output(const falco::outputs::message* msg) override
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+		std::lock_guard<std::mutex> lk(s_delivered_mtx);
+		s_delivered.push_back(msg->msg);
+	}
+};
+
+TEST(falco_outputs, lossless_delivers_all_alerts)
+{
+	falco_outputs::register_output("test_slow", []
+	{
+		return std::make_unique<slow_output>();
+	});
+	s_delivered.clear();
+
+	auto engine = std::make_shared<falco_engine>();
+	falco::outputs::config oc;
+	oc.name = "test_slow";
+	falco::outputs::drain_config drain;
+	// the alerts still queued when stopping are delivered all the same
+	drain.timeout_ms = 0;
+	auto outputs = std::make_unique<falco_outputs>(
+		engine,
+		std::vector<falco::outputs::config>{oc},
+		false, // json_output
+		true, // json_include_output_property
+		true, // json_include_tags_property
+		2000, // timeout
+		false, // buffered
+		4, // outputs_queue_capacity
+		0, // outputs_queue_priority_reserve
+		0, // outputs_queue_max_bytes
+		falco::outputs::spill_config{},
+		drain,
+		false, // deferred_formatting
+		falco::outputs::aggregation_config{},
+		false, // time_format_iso_8601
+		"host");
+	outputs->set_lossless(true);
+
+	constexpr size_t num_alerts = 500;
+	for(size_t i = 0; i < num_alerts; i++)
+	{
+		falco::outputs::message msg;
+		msg.ts = i;
+		msg.priority = falco_common::PRIORITY_WARNING;
+		msg.msg = "alert " + std::to_string(i);
+		outputs->handle_alert(msg);
+	}
+
+	// the queues are full most of the time, and the waits for room in
+	// them are accounted instead of dropping alerts
+	auto waits = outputs->get_backpressure_wait_ns();
+	EXPECT_GT(waits["queue"] + waits["test_slow"], 0u);
+	EXPECT_EQ(outputs->get_outputs_queue_num_drops(), 0u);
+	EXPECT_EQ(outputs->get_output_queues_num_drops()["test_slow"], 0u);
+	outputs.reset();
+
+	ASSERT_EQ(s_delivered.size(), num_alerts);
+	for(size_t i = 0; i < num_alerts; i++)
+	{
+		EXPECT_EQ(s_delivered[i], "alert " + std::to_string(i));
+	}
+}
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/fd_writer.h>
+#include <engine/falco_common.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static std::string read_all(int fd)
+{
+	std::string res;
+	char buf[4096];
+	ssize_t n;
+	while((n = read(fd, buf, sizeof(buf))) > 0)
+	{
+		res.append(buf, n);
+	}
+	return res;
+}
+
+// Decompresses the gzip members, or what can be decompressed of a member
+// not ended yet
+static std::string gunzip(const std::string& data)
+{
+	std::string res;
+	z_stream zs = {};
+	// 32 detects the gzip header
+	inflateInit2(&zs, 15 + 32);
+	zs.next_in = (Bytef*) data.data();
+	zs.avail_in = data.size();
+	char buf[4096];
+	while(zs.avail_in > 0)
+	{
+		zs.next_out = (Bytef*) buf;
+		zs.avail_out = sizeof(buf);
+		int ret = inflate(&zs, Z_NO_FLUSH);
+		res.append(buf, sizeof(buf) - zs.avail_out);
+		if(ret == Z_STREAM_END)
+		{
+			inflateReset(&zs);
+		}
+		else if(ret != Z_OK)
+		{
+			break;
+		}
+	}
+	inflateEnd(&zs);
+	return res;
+}
+
+class fd_writer_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_EQ(pipe(m_fds), 0);
+		fcntl(m_fds[0], F_SETFL, O_NONBLOCK);
+	}
+
+	void TearDown() override
+	{
+		close(m_fds[0]);
+		if(m_fds[1] >= 0)
+		{
+			close(m_fds[1]);
+		}
+	}
+
+	int m_fds[2] = {-1, -1};
+};
+
+TEST_F(fd_writer_test, unbuffered)
+{
+	falco::outputs::fd_writer w;
+	w.set_fd(m_fds[1]);
+	w.write_line("first");
+	w.write_line("second");
+	EXPECT_EQ(w.buffered(), 0);
+	EXPECT_EQ(read_all(m_fds[0]), "first\nsecond\n");
+
+	std::map<std::string, uint64_t> metrics;
+	w.get_metrics(metrics);
+	EXPECT_EQ(metrics["bytes_written"], 13);
+	EXPECT_EQ(metrics["writes"], 2);
+}
+
+TEST_F(fd_writer_test, coalesces_lines)
+{
+	falco::outputs::fd_writer w(16);
+	w.set_fd(m_fds[1]);
+	w.write_line("aaa");
+	w.write_line("bbb");
+	EXPECT_EQ(w.buffered(), 8);
+	EXPECT_EQ(read_all(m_fds[0]), "");
+
+	// the line that doesn't fit is written along with the buffer
+	w.write_line("a line too long for the buffer");
+	EXPECT_EQ(w.buffered(), 0);
+	w.write_line("ccc");
+	w.flush();
+	EXPECT_EQ(read_all(m_fds[0]), "aaa\nbbb\na line too long for the buffer\nccc\n");
+
+	std::map<std::string, uint64_t> metrics;
+	w.get_metrics(metrics);
+	EXPECT_EQ(metrics["writes"], 2);
+}
+
+TEST_F(fd_writer_test, write_errors)
+{
+	falco::outputs::fd_writer w(16);
+	w.set_fd(m_fds[1]);
+	w.write_line("aaa");
+	close(m_fds[1]);
+	m_fds[1] = -1;
+
+	// the buffered data is discarded
+	EXPECT_THROW(w.flush(), falco_exception);
+	EXPECT_EQ(w.buffered(), 0);
+	EXPECT_NO_THROW(w.flush());
+}
+
+TEST_F(fd_writer_test, delimited_records)
+{
+	falco::outputs::fd_writer w(8);
+	w.set_fd(m_fds[1]);
+	w.write_delimited("abc");
+	EXPECT_EQ(w.buffered(), 4);
+
+	// the record that doesn't fit is written with its prefix
+	std::string large(200, 'x');
+	w.write_delimited(large);
+	EXPECT_EQ(w.buffered(), 0);
+	EXPECT_EQ(read_all(m_fds[0]), std::string("\x03" "abc" "\xc8\x01", 6) + large);
+}
+
+TEST_F(fd_writer_test, gzip)
+{
+	falco::outputs::fd_writer w(64);
+	w.set_fd(m_fds[1]);
+	EXPECT_FALSE(w.enable_gzip(10));
+	ASSERT_TRUE(w.enable_gzip(6));
+	EXPECT_TRUE(w.compressed());
+
+	// the lines are compressed once the buffer is full, and are readable
+	// once flushed
+	std::string lines;
+	for(int i = 0; i < 20; i++)
+	{
+		std::string line = "alert number " + std::to_string(i);
+		w.write_line(line);
+		lines += line + "\n";
+	}
+	w.flush();
+	std::string compressed = read_all(m_fds[0]);
+	EXPECT_LT(compressed.size(), lines.size());
+	EXPECT_EQ(gunzip(compressed), lines);
+
+	// finishing ends the member, and the next lines start a new one
+	w.finish();
+	compressed += read_all(m_fds[0]);
+	w.write_line("after");
+	w.finish();
+	compressed += read_all(m_fds[0]);
+	EXPECT_EQ(gunzip(compressed), lines + "after\n");
+
+	std::map<std::string, uint64_t> metrics;
+	w.get_metrics(metrics);
+	EXPECT_EQ(metrics["bytes_uncompressed"], lines.size() + 6);
+	EXPECT_EQ(metrics["bytes_written"], compressed.size());
+	EXPECT_EQ(w.bytes_written(), compressed.size());
+
+	// nothing is written when there is nothing to end
+	w.finish();
+	EXPECT_EQ(read_all(m_fds[0]), "");
+}
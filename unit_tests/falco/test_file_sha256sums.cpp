@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/file_sha256sums.h>
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+static const std::string s_abc_sha256 = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+TEST(file_sha256sums, of_contents)
+{
+	auto sum = falco::file_sha256sums::of_contents("abc");
+	ASSERT_EQ(falco::file_sha256sums::value(sum), s_abc_sha256);
+	ASSERT_EQ(falco::file_sha256sums::value({}), falco::file_sha256sums::pending);
+}
+
+TEST(file_sha256sums, of_file)
+{
+	char filename[] = "/tmp/falco_test_sha256sums_XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(write(fd, "abc", 3), 3);
+	close(fd);
+
+	auto sum = falco::file_sha256sums::of_file(filename);
+	sum.wait();
+	ASSERT_EQ(falco::file_sha256sums::value(sum), s_abc_sha256);
+
+	// an unchanged file gets the sum already computed
+	sum = falco::file_sha256sums::of_file(filename);
+	ASSERT_EQ(falco::file_sha256sums::value(sum), s_abc_sha256);
+
+	// a changed file is hashed again
+	std::ofstream(filename, std::ios::app) << "d";
+	sum = falco::file_sha256sums::of_file(filename);
+	sum.wait();
+	ASSERT_NE(falco::file_sha256sums::value(sum), s_abc_sha256);
+
+	std::remove(filename);
+	sum = falco::file_sha256sums::of_file(filename);
+	ASSERT_EQ(falco::file_sha256sums::value(sum), "");
+}
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/flight_recorder.h>
+
+#include <cstring>
+
+namespace
+{
+
+// The events written to each path, as their first byte
+struct captures
+{
+	std::mutex mtx;
+	std::map<std::string, std::vector<uint8_t>> events;
+	std::map<std::string, bool> closed;
+};
+
+class test_sink : public falco::flight_recorder::sink
+{
+public:
+	test_sink(captures& c, const std::string& path): m_captures(c), m_path(path) {}
+
+	~test_sink() override
+	{
+		std::lock_guard<std::mutex> lock(m_captures.mtx);
+		m_captures.closed[m_path] = true;
+	}
+
+	void write(const uint8_t* evt, uint32_t, uint16_t) override
+	{
+		std::lock_guard<std::mutex> lock(m_captures.mtx);
+		m_captures.events[m_path].push_back(evt[0]);
+	}
+
+private:
+	captures& m_captures;
+	std::string m_path;
+};
+
+constexpr uint64_t ms = 1000000;
+
+void record(falco::flight_recorder& r, uint64_t ts, uint8_t id, uint32_t len = 100)
+{
+	std::vector<uint8_t> evt(len, 0);
+	evt[0] = id;
+	r.record(ts, 0, evt.data(), len);
+}
+
+falco::flight_recorder::open_func opener(captures& c)
+{
+	return [&c](const std::string& path) { return std::make_unique<test_sink>(c, path); };
+}
+
+} // namespace
+
+TEST(flight_recorder, triggers)
+{
+	falco::flight_recorder::config c;
+	c.m_min_priority = falco_common::PRIORITY_ERROR;
+	c.m_tags = {"forensics"};
+	falco::flight_recorder r("syscall", c);
+
+	EXPECT_TRUE(r.triggers(falco_common::PRIORITY_CRITICAL, {}));
+	EXPECT_TRUE(r.triggers(falco_common::PRIORITY_ERROR, {}));
+	EXPECT_FALSE(r.triggers(falco_common::PRIORITY_WARNING, {"network"}));
+	EXPECT_TRUE(r.triggers(falco_common::PRIORITY_DEBUG, {"network", "forensics"}));
+}
+
+TEST(flight_recorder, windows)
+{
+	captures caps;
+	falco::flight_recorder::config c;
+	c.m_before_ms = 10;
+	c.m_after_ms = 5;
+	c.m_path = "/tmp";
+	std::string err;
+	{
+		falco::flight_recorder r("syscall", c);
+		for(uint8_t i = 0; i < 20; i++)
+		{
+			record(r, i * ms, i);
+		}
+		// the alert is raised by the last recorded event
+		EXPECT_TRUE(r.trigger(19 * ms, "rule", opener(caps), err));
+		EXPECT_TRUE(err.empty());
+		// coalesced into the dump being collected
+		EXPECT_FALSE(r.trigger(19 * ms, "rule", opener(caps), err));
+		for(uint8_t i = 20; i < 30; i++)
+		{
+			record(r, i * ms, i);
+		}
+
+		std::map<std::string, uint64_t> metrics;
+		r.get_metrics(metrics);
+		EXPECT_EQ(metrics["flight_recorder.ring_events"], 30);
+		EXPECT_EQ(metrics["flight_recorder.ring_bytes"], r.chunk_size());
+		EXPECT_EQ(metrics["flight_recorder.dumps_coalesced"], 1);
+	}
+
+	std::string path = "/tmp/falco_syscall_" + std::to_string(19 * ms) + ".scap";
+	ASSERT_EQ(caps.events.size(), 1);
+	EXPECT_TRUE(caps.closed[path]);
+	std::vector<uint8_t> expected;
+	for(uint8_t i = 9; i <= 24; i++)
+	{
+		expected.push_back(i);
+	}
+	EXPECT_EQ(caps.events[path], expected);
+}
+
+TEST(flight_recorder, eviction)
+{
+	captures caps;
+	falco::flight_recorder::config c;
+	c.m_max_memory = 0;
+	c.m_before_ms = 1000000;
+	c.m_after_ms = 0;
+	std::string err;
+	falco::flight_recorder r("syscall", c);
+	// with the smallest chunks, two of them
+	ASSERT_EQ(r.chunk_size(), 64 * 1024);
+
+	// events larger than a chunk are not recorded
+	record(r, 0, 0, 64 * 1024);
+
+	// 3 chunks worth of events, 16 + 1008 bytes each
+	uint32_t per_chunk = 64;
+	for(uint32_t i = 0; i < 3 * per_chunk; i++)
+	{
+		record(r, i + 1, i % 256, 1008);
+	}
+	std::map<std::string, uint64_t> metrics;
+	r.get_metrics(metrics);
+	EXPECT_EQ(metrics["flight_recorder.ring_bytes"], 2 * r.chunk_size());
+	EXPECT_EQ(metrics["flight_recorder.ring_events"], 2 * per_chunk);
+}
+
+TEST(flight_recorder, flush_and_failures)
+{
+	captures caps;
+	falco::flight_recorder::config c;
+	c.m_after_ms = 5;
+	std::string err;
+	falco::flight_recorder r("k8saudit", c);
+
+	record(r, 1 * ms, 1);
+	EXPECT_FALSE(r.trigger(1 * ms, "rule", [](const std::string&) -> std::unique_ptr<falco::flight_recorder::sink>
+	{
+		throw std::runtime_error("no space left");
+	}, err));
+	EXPECT_NE(err.find("no space left"), std::string::npos);
+
+	err.clear();
+	EXPECT_TRUE(r.trigger(1 * ms, "rule", opener(caps), err));
+	// the source stays idle past the window
+	r.flush(3 * ms);
+	EXPECT_FALSE(r.trigger(3 * ms, "rule", opener(caps), err));
+	r.flush(7 * ms);
+	EXPECT_TRUE(r.trigger(7 * ms, "rule", opener(caps), err));
+
+	std::map<std::string, uint64_t> metrics;
+	r.get_metrics(metrics);
+	EXPECT_EQ(metrics["flight_recorder.dumps_failed"], 1);
+	EXPECT_EQ(metrics["flight_recorder.dumps_coalesced"], 1);
+}
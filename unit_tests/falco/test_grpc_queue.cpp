@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <falco/grpc_queue.h>
+
+static void push_alerts(falco::grpc::queue& q, int from, int to)
+{
+	for(int i = from; i < to; i++)
+	{
+		falco::outputs::response res;
+		res.set_rule("rule_" + std::to_string(i));
+		q.push(res);
+	}
+}
+
+static std::vector<std::string> read_all(falco::grpc::queue& q, falco::grpc::cursor& c)
+{
+	std::vector<std::string> rules;
+	falco::outputs::response res;
+	while(q.try_pop(c, res))
+	{
+		rules.push_back(res.rule());
+	}
+	return rules;
+}
+
+TEST(grpc_queue, subscribers_receive_all_alerts)
+{
+	falco::grpc::queue q(16);
+	falco::grpc::cursor a, b;
+	q.subscribe(a);
+	q.subscribe(b);
+
+	push_alerts(q, 0, 4);
+	EXPECT_EQ(read_all(q, a), std::vector<std::string>({"rule_0", "rule_1", "rule_2", "rule_3"}));
+	push_alerts(q, 4, 6);
+	EXPECT_EQ(read_all(q, a), std::vector<std::string>({"rule_4", "rule_5"}));
+	EXPECT_EQ(read_all(q, b).size(), 6);
+	EXPECT_FALSE(a.lossy);
+	EXPECT_FALSE(b.lossy);
+}
+
+TEST(grpc_queue, lagging_subscriber_is_lossy)
+{
+	falco::grpc::queue q(4);
+	falco::grpc::cursor fast, slow;
+	q.subscribe(fast);
+	q.subscribe(slow);
+
+	for(int i = 0; i < 10; i++)
+	{
+		push_alerts(q, i, i + 1);
+		EXPECT_EQ(read_all(q, fast).size(), 1);
+	}
+	EXPECT_FALSE(fast.lossy);
+
+	EXPECT_EQ(read_all(q, slow), std::vector<std::string>({"rule_6", "rule_7", "rule_8", "rule_9"}));
+	EXPECT_TRUE(slow.lossy);
+	EXPECT_EQ(slow.lost, 6);
+
+	std::map<std::string, uint64_t> metrics;
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["subscriptions_lossy"], 1);
+	EXPECT_EQ(metrics["alerts_lost"], 6);
+}
+
+TEST(grpc_queue, new_subscriber_starts_at_horizon)
+{
+	falco::grpc::queue q(16);
+
+	// the first subscriber receives the alerts retained before it
+	push_alerts(q, 0, 3);
+	falco::grpc::cursor first;
+	EXPECT_EQ(read_all(q, first).size(), 3);
+	q.unsubscribe(first);
+
+	push_alerts(q, 3, 5);
+	falco::grpc::cursor second;
+	EXPECT_EQ(read_all(q, second), std::vector<std::string>({"rule_3", "rule_4"}));
+	EXPECT_FALSE(second.lossy);
+}
+
+TEST(grpc_queue, session_resumes)
+{
+	falco::grpc::queue q(16);
+	falco::grpc::cursor a, b;
+	q.subscribe(a, "a");
+	q.subscribe(b, "b");
+	push_alerts(q, 0, 2);
+	EXPECT_EQ(read_all(q, a).size(), 2);
+	EXPECT_EQ(read_all(q, b).size(), 2);
+	q.unsubscribe(a);
+	q.unsubscribe(b);
+
+	push_alerts(q, 2, 4);
+	q.subscribe(a, "a");
+	EXPECT_EQ(read_all(q, a), std::vector<std::string>({"rule_2", "rule_3"}));
+	q.unsubscribe(a);
+
+	// the other session isn't affected by the alerts read by the first one
+	q.subscribe(b, "b");
+	EXPECT_EQ(read_all(q, b), std::vector<std::string>({"rule_2", "rule_3"}));
+}
+
+TEST(grpc_queue, capacity_change_discards_alerts)
+{
+	falco::grpc::queue q(16);
+	falco::grpc::cursor c;
+	q.subscribe(c);
+	push_alerts(q, 0, 3);
+	q.set_capacity(8);
+	EXPECT_TRUE(read_all(q, c).empty());
+	EXPECT_TRUE(c.lossy);
+	EXPECT_EQ(c.lost, 3);
+
+	push_alerts(q, 3, 4);
+	EXPECT_EQ(read_all(q, c), std::vector<std::string>({"rule_3"}));
+}
+
+TEST(grpc_queue, drop_oldest_without_subscribers)
+{
+	falco::grpc::queue q(4);
+	push_alerts(q, 0, 6);
+
+	std::map<std::string, uint64_t> metrics;
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["queue_depth"], 4);
+	EXPECT_EQ(metrics["queue_capacity"], 4);
+	EXPECT_EQ(metrics["queue_drops"], 2);
+
+	falco::grpc::cursor c;
+	EXPECT_EQ(read_all(q, c), std::vector<std::string>({"rule_2", "rule_3", "rule_4", "rule_5"}));
+	EXPECT_FALSE(c.lossy);
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["queue_depth"], 0);
+}
+
+TEST(grpc_queue, memory_usage)
+{
+	falco::grpc::queue q(4);
+	std::map<std::string, uint64_t> metrics;
+	q.get_metrics(metrics);
+	uint64_t empty = metrics["queue_memory_bytes"];
+	EXPECT_EQ(empty, 4 * sizeof(falco::outputs::response));
+
+	// only the retained alerts are accounted for
+	falco::outputs::response res;
+	res.set_rule("rule_0");
+	push_alerts(q, 0, 6);
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["queue_memory_bytes"], empty + 4 * res.ByteSizeLong());
+
+	q.set_capacity(8);
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["queue_memory_bytes"], 8 * sizeof(falco::outputs::response));
+}
+
+TEST(grpc_queue, drop_newest)
+{
+	falco::grpc::queue q(4, falco::grpc::queue::overflow_policy::DROP_NEWEST);
+	falco::grpc::cursor fast, slow;
+	q.subscribe(fast);
+	q.subscribe(slow);
+
+	push_alerts(q, 0, 6);
+	EXPECT_EQ(read_all(q, fast), std::vector<std::string>({"rule_0", "rule_1", "rule_2", "rule_3"}));
+
+	// the slow subscriber holds back the others
+	push_alerts(q, 6, 7);
+	EXPECT_TRUE(read_all(q, fast).empty());
+	EXPECT_EQ(read_all(q, slow), std::vector<std::string>({"rule_0", "rule_1", "rule_2", "rule_3"}));
+	EXPECT_FALSE(slow.lossy);
+
+	std::map<std::string, uint64_t> metrics;
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["queue_drops"], 3);
+	EXPECT_EQ(metrics["queue_depth"], 0);
+
+	// until it disconnects or catches up
+	q.unsubscribe(slow);
+	push_alerts(q, 7, 8);
+	EXPECT_EQ(read_all(q, fast), std::vector<std::string>({"rule_7"}));
+}
+
+TEST(grpc_queue, parse_overflow_policy)
+{
+	falco::grpc::queue::overflow_policy p;
+	EXPECT_TRUE(falco::grpc::queue::parse_overflow_policy("drop_oldest", p));
+	EXPECT_EQ(p, falco::grpc::queue::overflow_policy::DROP_OLDEST);
+	EXPECT_TRUE(falco::grpc::queue::parse_overflow_policy("drop_newest", p));
+	EXPECT_EQ(p, falco::grpc::queue::overflow_policy::DROP_NEWEST);
+	EXPECT_FALSE(falco::grpc::queue::parse_overflow_policy("block", p));
+}
+
+TEST(grpc_queue, filter)
+{
+	falco::outputs::response res;
+	res.set_priority(falco::schema::priority::ERROR);
+	res.set_source("syscall");
+	res.set_rule("Terminal shell in container");
+	res.add_tags("container");
+	res.add_tags("shell");
+
+	falco::outputs::filter f;
+	EXPECT_TRUE(falco::grpc::matches(f, res));
+
+	f.set_priority(falco::schema::priority::WARNING);
+	EXPECT_TRUE(falco::grpc::matches(f, res));
+	f.set_priority(falco::schema::priority::ERROR);
+	EXPECT_TRUE(falco::grpc::matches(f, res));
+	f.set_priority(falco::schema::priority::CRITICAL);
+	EXPECT_FALSE(falco::grpc::matches(f, res));
+	f.clear_priority();
+
+	f.add_sources("k8s_audit");
+	EXPECT_FALSE(falco::grpc::matches(f, res));
+	f.add_sources("syscall");
+	EXPECT_TRUE(falco::grpc::matches(f, res));
+
+	f.add_tags("network");
+	EXPECT_FALSE(falco::grpc::matches(f, res));
+	f.add_tags("shell");
+	EXPECT_TRUE(falco::grpc::matches(f, res));
+
+	f.add_rules("Other rule");
+	EXPECT_FALSE(falco::grpc::matches(f, res));
+	f.add_rules("Terminal shell in container");
+	EXPECT_TRUE(falco::grpc::matches(f, res));
+}
+
+TEST(grpc_queue, filtered_subscription)
+{
+	falco::grpc::queue q(16);
+	falco::grpc::cursor all, narrow;
+	q.subscribe(all);
+	q.subscribe(narrow);
+	push_alerts(q, 0, 5);
+
+	falco::outputs::filter f;
+	f.add_rules("rule_1");
+	f.add_rules("rule_3");
+
+	std::vector<std::string> rules;
+	falco::outputs::response res;
+	while(q.try_pop(narrow, res, &f))
+	{
+		rules.push_back(res.rule());
+	}
+	EXPECT_EQ(rules, std::vector<std::string>({"rule_1", "rule_3"}));
+	EXPECT_EQ(read_all(q, all).size(), 5);
+
+	// the skipped alerts count as read by the filtered subscription
+	std::map<std::string, uint64_t> metrics;
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["queue_depth"], 0);
+}
+
+TEST(grpc_queue, waiters_notified_on_push)
+{
+	struct counter : public falco::grpc::waiter
+	{
+		int notified = 0;
+		void notify() override { notified++; }
+	};
+
+	falco::grpc::queue q(16);
+	falco::grpc::cursor c;
+	q.subscribe(c);
+	counter w;
+
+	EXPECT_TRUE(q.wait(c, &w));
+	push_alerts(q, 0, 1);
+	EXPECT_EQ(w.notified, 1);
+
+	// notified only once per wait, and not when alerts are available
+	push_alerts(q, 1, 2);
+	EXPECT_EQ(w.notified, 1);
+	EXPECT_FALSE(q.wait(c, &w));
+	EXPECT_EQ(read_all(q, c).size(), 2);
+
+	EXPECT_TRUE(q.wait(c, &w));
+	q.cancel_wait(&w);
+	push_alerts(q, 2, 3);
+	EXPECT_EQ(w.notified, 1);
+
+	EXPECT_FALSE(q.wait(c, &w));
+	read_all(q, c);
+	EXPECT_TRUE(q.wait(c, &w));
+	q.notify_all();
+	EXPECT_EQ(w.notified, 2);
+}
+
+TEST(grpc_queue, subscriber_lag)
+{
+	falco::grpc::queue q(8);
+	falco::grpc::cursor fast, slow;
+	push_alerts(q, 0, 2);
+	EXPECT_EQ(q.max_lag(), 0);
+
+	// both start with the alerts retained before they subscribed
+	q.subscribe(fast);
+	q.subscribe(slow, "slow");
+	push_alerts(q, 2, 5);
+	read_all(q, fast);
+	EXPECT_EQ(q.max_lag(), 5);
+
+	std::map<std::string, uint64_t> metrics;
+	q.get_metrics(metrics);
+	EXPECT_EQ(metrics["subscribers"], 2);
+	EXPECT_EQ(metrics["subscriber_lag_max"], 5);
+	EXPECT_EQ(metrics["subscriber_lag.slow"], 5);
+	EXPECT_EQ(metrics["subscriber_lag." + fast.client], 0);
+
+	// the lag is bounded by the alerts retained
+	push_alerts(q, 5, 12);
+	EXPECT_EQ(q.max_lag(), 8);
+
+	q.unsubscribe(slow);
+	EXPECT_EQ(q.max_lag(), 7);
+	read_all(q, fast);
+	EXPECT_EQ(q.max_lag(), 0);
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/gvisor_sandboxes.h>
+
+TEST(gvisor_sandboxes, count)
+{
+	falco::gvisor_sandboxes gs(1, 2);
+	int extractions = 0;
+	auto extract = [&](const std::string& id)
+	{
+		return [&extractions, id]()
+		{
+			extractions++;
+			return id;
+		};
+	};
+
+	gs.count(1, 100, extract("a"));
+	gs.count(1, 100, extract("other"));
+	gs.count(2, 100, extract("a"));
+	EXPECT_EQ(extractions, 2);
+
+	// a reused tid is attributed again
+	gs.count(1, 200, extract("b"));
+	EXPECT_EQ(extractions, 3);
+
+	// the sandboxes beyond the maximum, and the threads outside of them,
+	// are not tracked
+	gs.count(3, 100, extract("c"));
+	gs.count(4, 100, extract(""));
+
+	std::map<std::string, uint64_t> metrics;
+	gs.get_metrics(metrics);
+	EXPECT_EQ(metrics["gvisor.shard_evts.1"], 6);
+	EXPECT_EQ(metrics["gvisor.sandbox_evts.a"], 3);
+	EXPECT_EQ(metrics["gvisor.sandbox_evts.b"], 1);
+	EXPECT_EQ(metrics.count("gvisor.sandbox_evts.c"), 0);
+	EXPECT_EQ(metrics["gvisor.untracked_evts"], 2);
+	EXPECT_EQ(metrics["gvisor.sandboxes"], 2);
+
+	// the totals are summed over the shards
+	falco::gvisor_sandboxes other(2, 2);
+	other.count(1, 100, extract("d"));
+	other.get_metrics(metrics);
+	EXPECT_EQ(metrics["gvisor.shard_evts.2"], 1);
+	EXPECT_EQ(metrics["gvisor.sandboxes"], 3);
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/idle_backoff.h>
+
+using action = falco::idle_backoff::action;
+using namespace std::chrono;
+
+TEST(idle_backoff, sequence)
+{
+	falco::idle_backoff b(2, 1, microseconds(5));
+	microseconds sleep{0};
+
+	EXPECT_EQ(b.on_timeout(sleep), action::SPIN);
+	EXPECT_EQ(b.on_timeout(sleep), action::SPIN);
+	EXPECT_EQ(b.on_timeout(sleep), action::YIELD);
+	EXPECT_EQ(b.on_timeout(sleep), action::SLEEP);
+	EXPECT_EQ(sleep, microseconds(1));
+	EXPECT_EQ(b.on_timeout(sleep), action::SLEEP);
+	EXPECT_EQ(sleep, microseconds(2));
+	EXPECT_EQ(b.on_timeout(sleep), action::SLEEP);
+	EXPECT_EQ(sleep, microseconds(4));
+	EXPECT_EQ(b.on_timeout(sleep), action::SLEEP);
+	EXPECT_EQ(sleep, microseconds(5));
+	for(int i = 0; i < 100; i++)
+	{
+		b.on_timeout(sleep);
+	}
+	EXPECT_EQ(sleep, microseconds(5));
+
+	// an event starts the sequence over
+	b.on_event();
+	EXPECT_EQ(b.on_timeout(sleep), action::SPIN);
+
+	std::map<std::string, uint64_t> metrics;
+	b.get_metrics(metrics);
+	EXPECT_EQ(metrics["idle.timeouts"], 108);
+	EXPECT_EQ(metrics["idle.yields"], 1);
+	EXPECT_EQ(metrics["idle.sleeps"], 104);
+	EXPECT_EQ(metrics["idle.sleep_time_ns"], (1 + 2 + 4 + 5 * 101) * 1000);
+}
+
+TEST(idle_backoff, no_sleep)
+{
+	falco::idle_backoff b(0, 0, microseconds(0));
+	microseconds sleep{0};
+	for(int i = 0; i < 10; i++)
+	{
+		EXPECT_EQ(b.on_timeout(sleep), action::YIELD);
+	}
+	b.wait();
+
+	std::map<std::string, uint64_t> metrics;
+	b.get_metrics(metrics);
+	EXPECT_EQ(metrics["idle.yields"], 11);
+	EXPECT_EQ(metrics["idle.sleeps"], 0);
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/latency_histogram.h>
+
+#include <thread>
+#include <vector>
+
+TEST(latency_histogram, empty)
+{
+	falco::outputs::latency_histogram h;
+	EXPECT_EQ(h.count(), 0);
+	EXPECT_EQ(h.max_us(), 0);
+	EXPECT_EQ(h.percentile_us(99), 0);
+}
+
+TEST(latency_histogram, percentiles)
+{
+	falco::outputs::latency_histogram h;
+	for(int i = 0; i < 90; i++)
+	{
+		h.record(100);
+	}
+	for(int i = 0; i < 9; i++)
+	{
+		h.record(3000);
+	}
+	h.record(std::chrono::milliseconds(50));
+
+	EXPECT_EQ(h.count(), 100);
+	EXPECT_EQ(h.total_us(), 90 * 100 + 9 * 3000 + 50000);
+	EXPECT_EQ(h.max_us(), 50000);
+
+	// the upper bounds are the powers of two above the samples
+	EXPECT_EQ(h.percentile_us(50), 128);
+	EXPECT_EQ(h.percentile_us(90), 128);
+	EXPECT_EQ(h.percentile_us(99), 4096);
+	EXPECT_EQ(h.percentile_us(100), 65536);
+
+	std::map<std::string, uint64_t> metrics;
+	h.get_metrics("output_latency", metrics);
+	EXPECT_EQ(metrics["output_latency_count"], 100);
+	EXPECT_EQ(metrics["output_latency_us_max"], 50000);
+	EXPECT_EQ(metrics["output_latency_us_p50"], 128);
+	EXPECT_EQ(metrics["output_latency_us_p99"], 4096);
+	EXPECT_EQ(metrics.size(), 6);
+}
+
+TEST(latency_histogram, bounds)
+{
+	falco::outputs::latency_histogram h;
+	h.record((uint64_t) 0);
+	EXPECT_EQ(h.percentile_us(100), 1);
+
+	// samples beyond the last bucket are accounted in it
+	h.record(UINT64_MAX / 2);
+	EXPECT_EQ(h.percentile_us(100), uint64_t(1) << (falco::outputs::latency_histogram::num_buckets - 1));
+	EXPECT_EQ(h.max_us(), UINT64_MAX / 2);
+}
+
+TEST(latency_histogram, buckets)
+{
+	falco::outputs::latency_histogram h;
+	h.record((uint64_t) 0);
+	h.record(1);
+	h.record(1000);
+	h.record(1023);
+	h.record(1024);
+
+	EXPECT_EQ(h.bucket(0), 1);
+	EXPECT_EQ(h.bucket(1), 1);
+	EXPECT_EQ(h.bucket(10), 2);
+	EXPECT_EQ(h.bucket(11), 1);
+	uint64_t total = 0;
+	for(size_t i = 0; i < falco::outputs::latency_histogram::num_buckets; i++)
+	{
+		total += h.bucket(i);
+	}
+	EXPECT_EQ(total, h.count());
+}
+
+TEST(latency_histogram, concurrent)
+{
+	falco::outputs::latency_histogram h;
+	std::vector<std::thread> threads;
+	for(uint64_t t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&h, t]
+		{
+			for(uint64_t i = 0; i < 10000; i++)
+			{
+				h.record(t * 10000 + i);
+			}
+		});
+	}
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+	EXPECT_EQ(h.count(), 40000);
+	EXPECT_EQ(h.max_us(), 39999);
+	EXPECT_EQ(h.total_us(), 39999ULL * 40000 / 2);
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/load_shedder.h>
+
+TEST(load_shedder, levels)
+{
+	// type 1 is shed first, then type 2, and type 0 and 3 never
+	falco::load_shedder ls({0, 1, 2, 0}, 0.01, 0.001, 2);
+	EXPECT_EQ(ls.max_level(), 2);
+	EXPECT_EQ(ls.level(), 0);
+	EXPECT_FALSE(ls.should_shed(1));
+
+	EXPECT_TRUE(ls.update(1000, 100));
+	EXPECT_EQ(ls.level(), 1);
+	EXPECT_FALSE(ls.should_shed(0));
+	EXPECT_TRUE(ls.should_shed(1));
+	EXPECT_FALSE(ls.should_shed(2));
+	EXPECT_FALSE(ls.should_shed(3));
+	EXPECT_FALSE(ls.should_shed(1000));
+
+	EXPECT_TRUE(ls.update(1000, 100));
+	EXPECT_EQ(ls.level(), 2);
+	EXPECT_TRUE(ls.should_shed(1));
+	EXPECT_TRUE(ls.should_shed(2));
+	EXPECT_FALSE(ls.should_shed(3));
+
+	// the level never goes past the last class
+	EXPECT_FALSE(ls.update(1000, 100));
+	EXPECT_EQ(ls.level(), 2);
+
+	// between the thresholds the level holds
+	EXPECT_FALSE(ls.update(1000, 5));
+	EXPECT_EQ(ls.level(), 2);
+
+	// it's lowered after enough calm intervals, that start over if the
+	// drop rate isn't low enough
+	EXPECT_FALSE(ls.update(1000, 0));
+	EXPECT_FALSE(ls.update(1000, 5));
+	EXPECT_FALSE(ls.update(1000, 0));
+	EXPECT_TRUE(ls.update(1000, 0));
+	EXPECT_EQ(ls.level(), 1);
+	EXPECT_FALSE(ls.update(0, 0));
+	EXPECT_TRUE(ls.update(0, 0));
+	EXPECT_EQ(ls.level(), 0);
+	EXPECT_FALSE(ls.should_shed(1));
+
+	std::map<std::string, uint64_t> metrics;
+	ls.get_metrics(metrics);
+	EXPECT_EQ(metrics["shed.level"], 0);
+	EXPECT_EQ(metrics["shed.events"], 3);
+	EXPECT_EQ(metrics["shed.level_changes"], 4);
+}
+
+TEST(load_shedder, no_classes)
+{
+	falco::load_shedder ls({}, 0.01, 0.001, 1);
+	EXPECT_EQ(ls.max_level(), 0);
+	EXPECT_FALSE(ls.update(1000, 1000));
+	EXPECT_FALSE(ls.should_shed(0));
+}
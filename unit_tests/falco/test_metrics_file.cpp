@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/metrics_file.h>
+#include <engine/falco_common.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+static std::string read_file(const std::string& path)
+{
+	std::ifstream f(path);
+	std::stringstream ss;
+	ss << f.rdbuf();
+	return ss.str();
+}
+
+class metrics_file_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_path = (std::filesystem::temp_directory_path() / "falco_test_metrics_file.jsonl").string();
+		cleanup();
+	}
+
+	void TearDown() override
+	{
+		cleanup();
+	}
+
+	void cleanup()
+	{
+		std::filesystem::remove(m_path);
+		std::filesystem::remove(m_path + ".1");
+		std::filesystem::remove(m_path + ".2");
+	}
+
+	std::string m_path;
+};
+
+TEST_F(metrics_file_test, writes_lines)
+{
+	{
+		falco::metrics_file::config c;
+		falco::metrics_file f(m_path, c);
+		f.write("{\"sample\":1}");
+		f.write("{\"sample\":2}");
+	}
+
+	// the pending lines are written as the file is closed, after the
+	// ones already in it
+	EXPECT_EQ(read_file(m_path), "{\"sample\":1}\n{\"sample\":2}\n");
+	{
+		falco::metrics_file::config c;
+		c.m_flush_interval = std::chrono::milliseconds(0);
+		falco::metrics_file f(m_path, c);
+		f.write("{\"sample\":3}");
+
+		std::map<std::string, uint64_t> metrics;
+		f.get_metrics(metrics);
+		EXPECT_EQ(metrics["dropped_lines"], 0);
+		EXPECT_EQ(metrics["write_errors"], 0);
+	}
+	EXPECT_EQ(read_file(m_path), "{\"sample\":1}\n{\"sample\":2}\n{\"sample\":3}\n");
+}
+
+TEST_F(metrics_file_test, rotates)
+{
+	{
+		falco::metrics_file::config c;
+		c.m_flush_interval = std::chrono::milliseconds(0);
+		c.m_rotate_max_size = 10;
+		c.m_rotate_max_files = 1;
+		falco::metrics_file f(m_path, c);
+		f.write("0123456789");
+	}
+	EXPECT_EQ(read_file(m_path), "");
+	EXPECT_EQ(read_file(m_path + ".1"), "0123456789\n");
+	EXPECT_FALSE(std::filesystem::exists(m_path + ".2"));
+}
+
+TEST_F(metrics_file_test, open_errors)
+{
+	falco::metrics_file::config c;
+	EXPECT_THROW(falco::metrics_file("/nonexistent/dir/metrics.jsonl", c), falco_exception);
+}
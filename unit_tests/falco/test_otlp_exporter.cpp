@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/otlp_exporter.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace falco;
+
+namespace
+{
+
+// Accepts one connection and answers its requests with no content,
+// recording their request lines and bodies
+class http_server
+{
+public:
+	http_server()
+	{
+		m_fd = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(m_fd, (sockaddr*) &addr, sizeof(addr));
+		socklen_t len = sizeof(addr);
+		getsockname(m_fd, (sockaddr*) &addr, &len);
+		m_port = ntohs(addr.sin_port);
+		listen(m_fd, 1);
+		m_thread = std::thread([this] { serve(); });
+	}
+
+	~http_server()
+	{
+		shutdown(m_fd, SHUT_RDWR);
+		close(m_fd);
+		if(m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+	std::string endpoint() const
+	{
+		return "http://127.0.0.1:" + std::to_string(m_port);
+	}
+
+	void wait()
+	{
+		m_thread.join();
+	}
+
+	std::vector<std::pair<std::string, std::string>> requests;
+
+private:
+	void serve()
+	{
+		int c = accept(m_fd, nullptr, nullptr);
+		if(c < 0)
+		{
+			return;
+		}
+		std::string buf;
+		char tmp[4096];
+		ssize_t n;
+		while((n = recv(c, tmp, sizeof(tmp), 0)) > 0)
+		{
+			buf.append(tmp, n);
+			size_t end;
+			while((end = buf.find("\r\n\r\n")) != std::string::npos)
+			{
+				auto head = buf.substr(0, end);
+				size_t pos = head.find("Content-Length: ");
+				size_t body_len = pos == std::string::npos ? 0 : std::stoul(head.substr(pos + 16));
+				if(buf.size() < end + 4 + body_len)
+				{
+					break;
+				}
+				requests.emplace_back(head.substr(0, head.find("\r\n")), buf.substr(end + 4, body_len));
+				buf.erase(0, end + 4 + body_len);
+				std::string res = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+				send(c, res.data(), res.size(), 0);
+			}
+		}
+		close(c);
+	}
+
+	int m_fd = -1;
+	uint16_t m_port = 0;
+	std::thread m_thread;
+};
+
+} // namespace
+
+TEST(otlp_exporter, metrics_request)
+{
+	nlohmann::json resource = {{"attributes", nlohmann::json::array()}};
+	nlohmann::json fields = {
+		{"evt.source", "syscall"},
+		{"falco.num_evts", 42},
+		{"falco.cpu_usage_perc", 1.5},
+		{"falco.delta", -3}
+	};
+	auto req = nlohmann::json::parse(otlp_exporter::metrics_request(resource, 1000, "syscall", fields));
+
+	const auto& scope = req["resourceMetrics"][0]["scopeMetrics"][0];
+	ASSERT_EQ(scope["scope"]["name"], "falco");
+	std::map<std::string, nlohmann::json> points;
+	for(const auto& m : scope["metrics"])
+	{
+		points[m["name"]] = m["gauge"]["dataPoints"][0];
+	}
+
+	// the strings are not metrics
+	ASSERT_EQ(points.size(), 3u);
+	ASSERT_EQ(points["falco.num_evts"]["asInt"], "42");
+	ASSERT_EQ(points["falco.num_evts"]["timeUnixNano"], "1000");
+	ASSERT_EQ(points["falco.num_evts"]["attributes"][0]["key"], "source");
+	ASSERT_EQ(points["falco.num_evts"]["attributes"][0]["value"]["stringValue"], "syscall");
+	ASSERT_EQ(points["falco.cpu_usage_perc"]["asDouble"], 1.5);
+	ASSERT_EQ(points["falco.delta"]["asInt"], "-3");
+}
+
+TEST(otlp_exporter, traces_request)
+{
+	nlohmann::json resource = {{"attributes", nlohmann::json::array()}};
+	std::vector<otlp_exporter::span> spans(2);
+	spans[0].trace = {1, 2};
+	spans[0].span_id = 0xab;
+	spans[0].name = "root";
+	spans[0].start_ts = 10;
+	spans[0].end_ts = 20;
+	spans[0].attributes = {{"falco.rule", "r"}};
+	spans[1].trace = {1, 2};
+	spans[1].span_id = 0xcd;
+	spans[1].parent_span_id = 0xab;
+	spans[1].name = "child";
+
+	auto req = nlohmann::json::parse(otlp_exporter::traces_request(resource, spans));
+	const auto& jspans = req["resourceSpans"][0]["scopeSpans"][0]["spans"];
+	ASSERT_EQ(jspans.size(), 2u);
+	ASSERT_EQ(jspans[0]["traceId"], "00000000000000010000000000000002");
+	ASSERT_EQ(jspans[0]["spanId"], "00000000000000ab");
+	ASSERT_FALSE(jspans[0].contains("parentSpanId"));
+	ASSERT_EQ(jspans[0]["startTimeUnixNano"], "10");
+	ASSERT_EQ(jspans[0]["endTimeUnixNano"], "20");
+	ASSERT_EQ(jspans[0]["attributes"][0]["key"], "falco.rule");
+	ASSERT_EQ(jspans[1]["parentSpanId"], "00000000000000ab");
+}
+
+TEST(otlp_exporter, sampling)
+{
+	falco_configuration::otlp_config config;
+	config.m_endpoint = "http://127.0.0.1:1";
+	config.m_traces_sampling_ratio = 0.25;
+	otlp_exporter e;
+	std::string err;
+	ASSERT_TRUE(e.init(config, "host", err)) << err;
+	ASSERT_TRUE(e.traces_enabled());
+
+	uint32_t sampled = 0;
+	for(int i = 0; i < 100; i++)
+	{
+		otlp_exporter::trace_id trace;
+		uint64_t span_id = 0;
+		if(e.sample_alert(trace, span_id))
+		{
+			sampled++;
+			ASSERT_NE(span_id, 0u);
+		}
+	}
+	ASSERT_EQ(sampled, 25u);
+}
+
+TEST(otlp_exporter, export)
+{
+	http_server server;
+	falco_configuration::otlp_config config;
+	config.m_endpoint = server.endpoint() + "/";
+	config.m_traces_sampling_ratio = 1;
+	config.m_timeout_ms = 2000;
+
+	auto e = std::make_unique<otlp_exporter>();
+	std::string err;
+	ASSERT_TRUE(e->init(config, "host", err)) << err;
+	e->export_metrics(1000, "syscall", {{"falco.num_evts", 1}});
+
+	otlp_exporter::span s;
+	ASSERT_TRUE(e->sample_alert(s.trace, s.span_id));
+	s.name = "falco.rule_match";
+	e->export_span(std::move(s));
+
+	// the spans are sent when stopping, and the connection is closed
+	// once the exporter is gone
+	e->stop();
+	std::map<std::string, uint64_t> metrics;
+	e->get_metrics(metrics);
+	e.reset();
+	server.wait();
+
+	ASSERT_EQ(server.requests.size(), 2u);
+	ASSERT_EQ(server.requests[0].first, "POST /v1/metrics HTTP/1.1");
+	ASSERT_EQ(server.requests[1].first, "POST /v1/traces HTTP/1.1");
+	auto req = nlohmann::json::parse(server.requests[1].second);
+	const auto& attrs = req["resourceSpans"][0]["resource"]["attributes"];
+	ASSERT_EQ(attrs[0]["value"]["stringValue"], "falco");
+	ASSERT_EQ(attrs[2]["value"]["stringValue"], "host");
+
+	ASSERT_EQ(metrics["requests"], 2u);
+	ASSERT_EQ(metrics["spans"], 1u);
+	ASSERT_EQ(metrics["failed_requests"], 0u);
+}
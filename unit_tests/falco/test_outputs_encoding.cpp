@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_encoding.h>
+
+#include <map>
+#include <thread>
+#include <vector>
+
+// A minimal decoder of the protobuf wire format, enough for the varint
+// and length-delimited fields of falco.outputs.response
+struct decoded_field
+{
+	uint64_t varint = 0;
+	std::string bytes;
+};
+
+static uint64_t get_varint(const std::string& s, size_t& pos)
+{
+	uint64_t v = 0;
+	for(int shift = 0; pos < s.size(); shift += 7)
+	{
+		uint8_t b = s[pos++];
+		v |= (uint64_t) (b & 0x7f) << shift;
+		if((b & 0x80) == 0)
+		{
+			return v;
+		}
+	}
+	ADD_FAILURE() << "truncated varint";
+	return v;
+}
+
+static std::multimap<uint32_t, decoded_field> decode(const std::string& s)
+{
+	std::multimap<uint32_t, decoded_field> res;
+	size_t pos = 0;
+	while(pos < s.size())
+	{
+		uint64_t tag = get_varint(s, pos);
+		decoded_field f;
+		if((tag & 7) == 0)
+		{
+			f.varint = get_varint(s, pos);
+		}
+		else if((tag & 7) == 2)
+		{
+			uint64_t len = get_varint(s, pos);
+			EXPECT_LE(pos + len, s.size());
+			f.bytes = s.substr(pos, len);
+			pos += len;
+		}
+		else
+		{
+			ADD_FAILURE() << "unexpected wire type " << (tag & 7);
+			break;
+		}
+		res.emplace(tag >> 3, f);
+	}
+	return res;
+}
+
+static falco::outputs::message make_message()
+{
+	falco::outputs::message msg;
+	msg.ts = 1700000000123456789ULL;
+	msg.priority = falco_common::PRIORITY_WARNING;
+	msg.msg = "cat opened a file";
+	msg.rule = std::string("open file");
+	msg.source = std::string("syscall");
+	falco::assign_field_values(msg.fields, std::map<std::string, std::string>{{"proc.name", "cat"}, {"fd.name", "/etc/shadow"}});
+	msg.tags = std::set<std::string>{"a", "b"};
+	return msg;
+}
+
+TEST(outputs_encoding, parse_encoding)
+{
+	falco::outputs::encoding enc = falco::outputs::encoding::PROTOBUF;
+	EXPECT_TRUE(falco::outputs::parse_encoding("", enc));
+	EXPECT_EQ(enc, falco::outputs::encoding::TEXT);
+	EXPECT_TRUE(falco::outputs::parse_encoding("protobuf", enc));
+	EXPECT_EQ(enc, falco::outputs::encoding::PROTOBUF);
+	EXPECT_TRUE(falco::outputs::parse_encoding("text", enc));
+	EXPECT_EQ(enc, falco::outputs::encoding::TEXT);
+	EXPECT_FALSE(falco::outputs::parse_encoding("msgpack", enc));
+}
+
+TEST(outputs_encoding, response)
+{
+	auto msg = make_message();
+	std::string out;
+	falco::outputs::encode_protobuf(msg, "host1", out);
+	auto fields = decode(out);
+
+	ASSERT_EQ(fields.count(1), 1);
+	auto time = decode(fields.find(1)->second.bytes);
+	EXPECT_EQ(time.find(1)->second.varint, 1700000000);
+	EXPECT_EQ(time.find(2)->second.varint, 123456789);
+
+	EXPECT_EQ(fields.find(2)->second.varint, (uint64_t) falco_common::PRIORITY_WARNING);
+	// the deprecated source enum has the default value for syscall
+	EXPECT_EQ(fields.count(3), 0);
+	EXPECT_EQ(fields.find(4)->second.bytes, "open file");
+	EXPECT_EQ(fields.find(5)->second.bytes, "cat opened a file");
+	EXPECT_EQ(fields.find(7)->second.bytes, "host1");
+	EXPECT_EQ(fields.find(9)->second.bytes, "syscall");
+
+	std::map<std::string, std::string> output_fields;
+	auto range = fields.equal_range(6);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		auto entry = decode(it->second.bytes);
+		output_fields[entry.find(1)->second.bytes] = entry.find(2)->second.bytes;
+	}
+	EXPECT_EQ(output_fields, (std::map<std::string, std::string>{{"proc.name", "cat"}, {"fd.name", "/etc/shadow"}}));
+
+	std::set<std::string> tags;
+	range = fields.equal_range(8);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		tags.insert(it->second.bytes);
+	}
+	EXPECT_EQ(tags, (std::set<std::string>{"a", "b"}));
+}
+
+TEST(outputs_encoding, plugin_source)
+{
+	auto msg = make_message();
+	msg.source = std::string("k8saudit");
+	msg.ts = 0;
+	std::string out;
+	falco::outputs::encode_protobuf(msg, "", out);
+	auto fields = decode(out);
+	EXPECT_EQ(fields.count(1), 0);
+	EXPECT_EQ(fields.find(3)->second.varint, 3);
+	EXPECT_EQ(fields.count(7), 0);
+	EXPECT_EQ(fields.find(9)->second.bytes, "k8saudit");
+}
+
+TEST(outputs_encoding, encoded_once)
+{
+	auto msg = make_message();
+	std::string expected;
+	falco::outputs::encode_protobuf(msg, "host1", expected);
+
+	// the outputs asking for the same encoding share the same bytes
+	std::vector<const std::string*> res(8);
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < res.size(); i++)
+	{
+		threads.emplace_back([&, i]{ res[i] = &msg.encoded.get(falco::outputs::encoding::PROTOBUF, msg, "host1"); });
+	}
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+	for(const auto* r : res)
+	{
+		EXPECT_EQ(r, res[0]);
+	}
+	EXPECT_EQ(*res[0], expected);
+
+	EXPECT_EQ(&msg.encoded.get(falco::outputs::encoding::TEXT, msg, "host1"), &msg.msg);
+}
+
+TEST(outputs_encoding, cleared_on_change)
+{
+	auto msg = make_message();
+	auto before = msg.encoded.get(falco::outputs::encoding::PROTOBUF, msg, "host1");
+
+	// copies don't share the encoding of the original message
+	auto copy = msg;
+	copy.msg = "another alert";
+	EXPECT_NE(copy.encoded.get(falco::outputs::encoding::PROTOBUF, copy, "host1"), before);
+
+	// the cached encoding is kept until the message is cleared
+	msg.msg = "another alert";
+	EXPECT_EQ(msg.encoded.get(falco::outputs::encoding::PROTOBUF, msg, "host1"), before);
+	msg.encoded.clear();
+	EXPECT_EQ(msg.encoded.get(falco::outputs::encoding::PROTOBUF, msg, "host1"),
+		copy.encoded.get(falco::outputs::encoding::PROTOBUF, copy, "host1"));
+}
+
+TEST(outputs_encoding, length_prefix)
+{
+	for(size_t len : {0, 1, 127, 128, 300, 16383, 16384, 1 << 21})
+	{
+		std::string prefix;
+		falco::outputs::append_length_prefix(prefix, len);
+		EXPECT_EQ(prefix.size(), falco::outputs::length_prefix_size(len));
+		size_t pos = 0;
+		EXPECT_EQ(get_varint(prefix, pos), len);
+		EXPECT_EQ(pos, prefix.size());
+	}
+}
+
+TEST(outputs_encoding, projection)
+{
+	auto msg = make_message();
+	falco::outputs::message out;
+	falco::outputs::project(msg, {"proc.name", "output"}, false, "host1", out);
+	EXPECT_EQ(out.ts, msg.ts);
+	EXPECT_EQ(out.rule, msg.rule);
+	EXPECT_EQ(out.msg, "cat opened a file");
+	EXPECT_TRUE(out.tags->empty());
+	ASSERT_EQ(out.fields.size(), 1);
+	EXPECT_EQ(out.fields[0].first, std::string("proc.name"));
+
+	auto fields = decode(out.encoded.get(falco::outputs::encoding::PROTOBUF, out, "host1"));
+	EXPECT_EQ(fields.count(6), 1);
+	EXPECT_EQ(fields.count(8), 0);
+
+	falco::outputs::project(msg, {"fd.name", "tags"}, false, "host1", out);
+	EXPECT_EQ(out.msg, "");
+	EXPECT_EQ(*out.tags, (std::set<std::string>{"a", "b"}));
+	ASSERT_EQ(out.fields.size(), 1);
+	EXPECT_EQ(out.fields[0].first, std::string("fd.name"));
+}
+
+TEST(outputs_encoding, json_projection)
+{
+	auto msg = make_message();
+	falco::outputs::message out;
+	falco::outputs::project(msg, {"proc.name"}, true, "host1", out);
+	EXPECT_EQ(out.msg, "{\"hostname\":\"host1\",\"priority\":\"Warning\",\"rule\":\"open file\","
+		"\"source\":\"syscall\",\"time\":\"2023-11-14T22:13:20.123456789Z\", "
+		"\"output_fields\": {\"proc.name\":\"cat\"}}");
+
+	falco::outputs::project(msg, {"tags"}, true, "host1", out);
+	EXPECT_NE(out.msg.find("\"tags\":[\"a\",\"b\"]"), std::string::npos);
+	EXPECT_NE(out.msg.find("\"output_fields\": {}"), std::string::npos);
+}
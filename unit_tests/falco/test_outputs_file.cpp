@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_file.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+class output_file_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_dir = std::filesystem::temp_directory_path() / ("falco_file_" + std::to_string(getpid()));
+		std::filesystem::remove_all(m_dir);
+		std::filesystem::create_directories(m_dir);
+		m_path = (m_dir / "events.txt").string();
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove_all(m_dir);
+	}
+
+	std::unique_ptr<output_file> make_output(std::map<std::string, std::string> options)
+	{
+		config oc;
+		oc.name = "file";
+		oc.options = std::move(options);
+		oc.options["filename"] = m_path;
+		auto o = std::make_unique<output_file>();
+		std::string err;
+		EXPECT_TRUE(o->init(oc, false, "host", false, err)) << err;
+		return o;
+	}
+
+	// Outputs a line as if it was the only queued alert
+	static void output(output_file& o, const std::string& line)
+	{
+		message msg;
+		msg.ts = 1;
+		msg.priority = falco_common::PRIORITY_WARNING;
+		msg.msg = line;
+		o.output(&msg);
+		o.idle();
+	}
+
+	static std::string read_file(const std::string& path)
+	{
+		std::ifstream in(path);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		return ss.str();
+	}
+
+	std::filesystem::path m_dir;
+	std::string m_path;
+};
+
+TEST_F(output_file_test, rotates_at_size_threshold)
+{
+	auto o = make_output({{"rotate_max_size", "20"}});
+
+	// 11 bytes are below the threshold, 22 reach it
+	output(*o, "0123456789");
+	EXPECT_EQ(read_file(m_path), "0123456789\n");
+	EXPECT_FALSE(std::filesystem::exists(m_path + ".1"));
+
+	output(*o, "abcdefghij");
+	EXPECT_EQ(read_file(m_path + ".1"), "0123456789\nabcdefghij\n");
+	EXPECT_EQ(read_file(m_path), "");
+
+	output(*o, "klmnopqrst");
+	EXPECT_EQ(read_file(m_path), "klmnopqrst\n");
+	EXPECT_EQ(read_file(m_path + ".1"), "0123456789\nabcdefghij\n");
+	EXPECT_FALSE(std::filesystem::exists(m_path + ".2"));
+}
+
+TEST_F(output_file_test, keeps_max_files)
+{
+	auto o = make_output({{"rotate_max_size", "1"}, {"rotate_max_files", "2"}});
+
+	// each line fills a file, and only the last two are kept
+	for(const auto& line : {"a", "b", "c", "d", "e"})
+	{
+		output(*o, line);
+	}
+	EXPECT_EQ(read_file(m_path), "");
+	EXPECT_EQ(read_file(m_path + ".1"), "e\n");
+	EXPECT_EQ(read_file(m_path + ".2"), "d\n");
+	EXPECT_FALSE(std::filesystem::exists(m_path + ".3"));
+}
+
+TEST_F(output_file_test, no_kept_files)
+{
+	auto o = make_output({{"rotate_max_size", "1"}, {"rotate_max_files", "0"}});
+
+	output(*o, "a");
+	output(*o, "b");
+	EXPECT_EQ(read_file(m_path), "");
+	EXPECT_FALSE(std::filesystem::exists(m_path + ".1"));
+}
+
+TEST_F(output_file_test, flushes_on_reopen_and_close)
+{
+	auto o = make_output({{"buffer_size", "4096"}, {"fsync", "true"}});
+
+	// the alerts stay in the buffer, which is not full, until the file
+	// is reopened or closed
+	output(*o, "first");
+	EXPECT_EQ(read_file(m_path), "");
+	o->reopen();
+	EXPECT_EQ(read_file(m_path), "first\n");
+
+	output(*o, "second");
+	EXPECT_EQ(read_file(m_path), "first\n");
+	o->cleanup();
+	EXPECT_EQ(read_file(m_path), "first\nsecond\n");
+
+	output(*o, "third");
+	EXPECT_EQ(read_file(m_path), "first\nsecond\n");
+	o.reset();
+	EXPECT_EQ(read_file(m_path), "first\nsecond\nthird\n");
+}
+
+TEST_F(output_file_test, flushes_full_buffer)
+{
+	auto o = make_output({{"buffer_size", "16"}});
+
+	// the second alert doesn't fit, so it's written with the buffer
+	output(*o, "0123456789");
+	EXPECT_EQ(read_file(m_path), "");
+	output(*o, "abcdefghij");
+	EXPECT_EQ(read_file(m_path), "0123456789\nabcdefghij\n");
+}
@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_http.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+namespace
+{
+
+// Records the bodies of the requests it receives, and answers them with
+// the given status codes in turn, then with 200
+class http_server
+{
+public:
+	explicit http_server(std::deque<int> codes = {}): m_codes(std::move(codes))
+	{
+		m_fd = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(m_fd, (sockaddr*) &addr, sizeof(addr));
+		socklen_t len = sizeof(addr);
+		getsockname(m_fd, (sockaddr*) &addr, &len);
+		m_port = ntohs(addr.sin_port);
+		listen(m_fd, 8);
+		m_thread = std::thread([this] { accept_loop(); });
+	}
+
+	~http_server()
+	{
+		shutdown(m_fd, SHUT_RDWR);
+		close(m_fd);
+		m_thread.join();
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			for(int c : m_clients)
+			{
+				shutdown(c, SHUT_RDWR);
+			}
+		}
+		for(auto& t : m_client_threads)
+		{
+			t.join();
+		}
+	}
+
+	std::string url() const
+	{
+		return "http://127.0.0.1:" + std::to_string(m_port) + "/";
+	}
+
+	// Waits until n requests are received, or for 5 seconds
+	std::vector<std::string> wait_requests(size_t n)
+	{
+		std::unique_lock<std::mutex> lk(m_mtx);
+		m_cv.wait_for(lk, std::chrono::seconds(5), [&]{ return m_requests.size() >= n; });
+		return m_requests;
+	}
+
+	std::vector<std::string> requests()
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		return m_requests;
+	}
+
+private:
+	void accept_loop()
+	{
+		int c;
+		while((c = accept(m_fd, nullptr, nullptr)) >= 0)
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_clients.push_back(c);
+			m_client_threads.emplace_back([this, c] { serve(c); });
+		}
+	}
+
+	void serve(int c)
+	{
+		std::string buf;
+		char tmp[4096];
+		ssize_t n;
+		while((n = recv(c, tmp, sizeof(tmp), 0)) > 0)
+		{
+			buf.append(tmp, n);
+			size_t end;
+			while((end = buf.find("\r\n\r\n")) != std::string::npos)
+			{
+				auto head = buf.substr(0, end);
+				size_t pos = head.find("Content-Length: ");
+				size_t body_len = pos == std::string::npos ? 0 : std::stoul(head.substr(pos + 16));
+				if(buf.size() < end + 4 + body_len)
+				{
+					break;
+				}
+				int code = 200;
+				{
+					std::lock_guard<std::mutex> lk(m_mtx);
+					m_requests.push_back(buf.substr(end + 4, body_len));
+					if(!m_codes.empty())
+					{
+						code = m_codes.front();
+						m_codes.pop_front();
+					}
+				}
+				m_cv.notify_all();
+				buf.erase(0, end + 4 + body_len);
+				std::string res = "HTTP/1.1 " + std::to_string(code) + " Status\r\nContent-Length: 0\r\n\r\n";
+				send(c, res.data(), res.size(), MSG_NOSIGNAL);
+			}
+		}
+		close(c);
+	}
+
+	int m_fd = -1;
+	uint16_t m_port = 0;
+	std::thread m_thread;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::deque<int> m_codes;
+	std::vector<std::string> m_requests;
+	std::vector<int> m_clients;
+	std::vector<std::thread> m_client_threads;
+};
+
+std::unique_ptr<output_http> make_output(std::map<std::string, std::string> options)
+{
+	config oc;
+	oc.name = "http";
+	oc.options = std::move(options);
+	oc.options["echo"] = "false";
+	auto o = std::make_unique<output_http>();
+	std::string err;
+	EXPECT_TRUE(o->init(oc, false, "host", false, err)) << err;
+	return o;
+}
+
+void output(output_http& o, const std::string& line)
+{
+	message msg;
+	msg.ts = 1;
+	msg.priority = falco_common::PRIORITY_WARNING;
+	msg.msg = line;
+	o.output(&msg);
+}
+
+} // namespace
+
+TEST(output_http, batches_by_number_of_alerts)
+{
+	http_server server;
+	auto o = make_output({{"url", server.url()}, {"batch_max_alerts", "2"}, {"batch_linger_ms", "60000"}});
+
+	// the full batches are sent right away, the last one once flushed
+	for(const auto& line : {"a", "b", "c", "d", "e"})
+	{
+		output(*o, line);
+	}
+	std::vector<std::string> expected = {"a\nb", "c\nd"};
+	EXPECT_EQ(server.wait_requests(2), expected);
+	o->cleanup();
+	expected.push_back("e");
+	EXPECT_EQ(server.requests(), expected);
+}
+
+TEST(output_http, batches_by_size)
+{
+	http_server server;
+	auto o = make_output({{"url", server.url()}, {"batch_max_alerts", "100"},
+		{"batch_max_bytes", "10"}, {"batch_linger_ms", "60000"}});
+
+	// a batch is full once it reaches the size, even if it exceeds it
+	for(const auto& line : {"12345", "67890", "abc", "0123456789", "d"})
+	{
+		output(*o, line);
+	}
+	std::vector<std::string> expected = {"12345\n67890", "abc\n0123456789"};
+	EXPECT_EQ(server.wait_requests(2), expected);
+	o->cleanup();
+	expected.push_back("d");
+	EXPECT_EQ(server.requests(), expected);
+}
+
+TEST(output_http, batches_by_time)
+{
+	http_server server;
+	auto o = make_output({{"url", server.url()}, {"batch_max_alerts", "100"}, {"batch_linger_ms", "100"}});
+
+	// the batch is sent once it lingered, without being full or flushed
+	auto start = std::chrono::steady_clock::now();
+	output(*o, "a");
+	output(*o, "b");
+	std::vector<std::string> expected = {"a\nb"};
+	EXPECT_EQ(server.wait_requests(1), expected);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+}
+
+TEST(output_http, sends_batches_in_order)
+{
+	http_server server;
+	auto o = make_output({{"url", server.url()}});
+
+	std::vector<std::string> expected;
+	for(int i = 0; i < 20; i++)
+	{
+		expected.push_back(std::to_string(i));
+		output(*o, expected.back());
+	}
+	o->cleanup();
+	EXPECT_EQ(server.requests(), expected);
+}
+
+TEST(output_http, retries_failed_batch_first)
+{
+	http_server server({500, 503});
+	auto o = make_output({{"url", server.url()}, {"max_retries", "2"}, {"retry_backoff_ms", "0"}});
+
+	// the failed batch is retried before the next ones are sent
+	output(*o, "a");
+	output(*o, "b");
+	output(*o, "c");
+	o->cleanup();
+	std::vector<std::string> expected = {"a", "a", "a", "b", "c"};
+	EXPECT_EQ(server.requests(), expected);
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["failures"], 2u);
+	EXPECT_EQ(metrics["retries"], 2u);
+	EXPECT_EQ(metrics["alerts"], 3u);
+	EXPECT_EQ(metrics["alerts_dropped"], 0u);
+}
+
+TEST(output_http, drops_batch_after_max_retries)
+{
+	http_server server({500, 500});
+	auto o = make_output({{"url", server.url()}, {"max_retries", "1"}, {"retry_backoff_ms", "0"}});
+
+	output(*o, "a");
+	output(*o, "b");
+	o->cleanup();
+	std::vector<std::string> expected = {"a", "a", "b"};
+	EXPECT_EQ(server.requests(), expected);
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["retries"], 1u);
+	EXPECT_EQ(metrics["alerts"], 1u);
+	EXPECT_EQ(metrics["alerts_dropped"], 1u);
+}
+
+TEST(output_http, does_not_retry_client_errors)
+{
+	http_server server({400});
+	auto o = make_output({{"url", server.url()}, {"max_retries", "2"}, {"retry_backoff_ms", "0"}});
+
+	output(*o, "a");
+	output(*o, "b");
+	o->cleanup();
+	std::vector<std::string> expected = {"a", "b"};
+	EXPECT_EQ(server.requests(), expected);
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["retries"], 0u);
+	EXPECT_EQ(metrics["alerts_dropped"], 1u);
+}
+
+TEST(output_http, retries_on_another_endpoint)
+{
+	http_server failing({500});
+	http_server server;
+	auto o = make_output({{"urls", failing.url() + "," + server.url()},
+		{"max_retries", "1"}, {"retry_backoff_ms", "60000"}});
+
+	// the retry doesn't wait for the backoff when another endpoint is up
+	output(*o, "a");
+	o->cleanup();
+	std::vector<std::string> expected = {"a"};
+	EXPECT_EQ(failing.requests(), expected);
+	EXPECT_EQ(server.requests(), expected);
+}
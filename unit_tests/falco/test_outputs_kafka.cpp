@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_kafka.h>
+
+#include <zlib.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+namespace
+{
+
+uint64_t get_be(const std::string& s, size_t& pos, size_t n)
+{
+	uint64_t v = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		v = (v << 8) | (unsigned char) s[pos++];
+	}
+	return v;
+}
+
+int64_t get_varlong(const std::string& s, size_t& pos)
+{
+	uint64_t u = 0;
+	for(int shift = 0; ; shift += 7)
+	{
+		unsigned char c = s[pos++];
+		u |= (uint64_t) (c & 0x7f) << shift;
+		if(!(c & 0x80))
+		{
+			break;
+		}
+	}
+	return (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+}
+
+std::string gunzip(const std::string& in)
+{
+	z_stream zs = {};
+	inflateInit2(&zs, 15 + 16);
+	std::string out(1024 * 1024, '\0');
+	zs.next_in = (Bytef*) in.data();
+	zs.avail_in = in.size();
+	zs.next_out = (Bytef*) &out[0];
+	zs.avail_out = out.size();
+	inflate(&zs, Z_FINISH);
+	out.resize(zs.total_out);
+	inflateEnd(&zs);
+	return out;
+}
+
+// Decodes a record batch, checking its checksum, and returns the values
+// of its records
+std::vector<std::string> decode_record_batch(const std::string& b)
+{
+	std::vector<std::string> values;
+	size_t pos = 8;
+	uint32_t len = get_be(b, pos, 4);
+	EXPECT_EQ(len, b.size() - 12);
+	pos += 4;
+	EXPECT_EQ(get_be(b, pos, 1), 2);
+	uint32_t crc = get_be(b, pos, 4);
+	EXPECT_EQ(crc, kafka::crc32c(b.data() + pos, b.size() - pos));
+	uint16_t attributes = get_be(b, pos, 2);
+	uint32_t last_offset_delta = get_be(b, pos, 4);
+	pos += 8 + 8 + 8 + 2 + 4;
+	uint32_t count = get_be(b, pos, 4);
+	EXPECT_EQ(last_offset_delta, count - 1);
+
+	std::string records = b.substr(pos);
+	if(attributes & 7)
+	{
+		EXPECT_EQ(attributes & 7, 1);
+		records = gunzip(records);
+	}
+	pos = 0;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		get_varlong(records, pos); // length
+		pos++; // attributes
+		get_varlong(records, pos); // timestamp delta
+		EXPECT_EQ(get_varlong(records, pos), (int64_t) i);
+		EXPECT_EQ(get_varlong(records, pos), -1);
+		int64_t value_len = get_varlong(records, pos);
+		values.push_back(records.substr(pos, value_len));
+		pos += value_len;
+		EXPECT_EQ(get_varlong(records, pos), 0);
+	}
+	EXPECT_EQ(pos, records.size());
+	return values;
+}
+
+// A broker of a single-node cluster with a single-partition topic, which
+// rejects the first produce requests with the given errors
+class fake_broker
+{
+public:
+	explicit fake_broker(std::vector<int16_t> errors = {}): m_errors(errors)
+	{
+		m_fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in sin = {};
+		sin.sin_family = AF_INET;
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(m_fd, (struct sockaddr*) &sin, sizeof(sin));
+		socklen_t len = sizeof(sin);
+		getsockname(m_fd, (struct sockaddr*) &sin, &len);
+		m_port = ntohs(sin.sin_port);
+		listen(m_fd, 16);
+		m_thread = std::thread(&fake_broker::run, this);
+	}
+
+	~fake_broker()
+	{
+		m_stop = true;
+		m_thread.join();
+		close(m_fd);
+	}
+
+	std::string address() const
+	{
+		return "127.0.0.1:" + std::to_string(m_port);
+	}
+
+	std::vector<std::string> values()
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		return m_values;
+	}
+
+	int metadata_requests()
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		return m_metadata_requests;
+	}
+
+private:
+	static void put(std::string& out, uint64_t v, size_t n)
+	{
+		for(size_t i = n; i > 0; i--)
+		{
+			out.push_back((char) (v >> (8 * (i - 1))));
+		}
+	}
+
+	static void put_string(std::string& out, const std::string& s)
+	{
+		put(out, s.size(), 2);
+		out.append(s);
+	}
+
+	std::string handle(const std::string& req)
+	{
+		size_t pos = 0;
+		int16_t api_key = get_be(req, pos, 2);
+		get_be(req, pos, 2);
+		uint32_t correlation_id = get_be(req, pos, 4);
+		size_t client_id_len = get_be(req, pos, 2);
+		pos += client_id_len;
+
+		std::string resp;
+		put(resp, correlation_id, 4);
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(api_key == 3)
+		{
+			m_metadata_requests++;
+			put(resp, 0, 4); // throttle time
+			put(resp, 1, 4); // brokers
+			put(resp, 1, 4);
+			put_string(resp, "127.0.0.1");
+			put(resp, m_port, 4);
+			put(resp, 0xffff, 2); // rack
+			put(resp, 0xffff, 2); // cluster id
+			put(resp, 1, 4); // controller
+			put(resp, 1, 4); // topics
+			put(resp, 0, 2);
+			put_string(resp, "falco");
+			put(resp, 0, 1);
+			put(resp, 1, 4); // partitions
+			put(resp, 0, 2);
+			put(resp, 0, 4);
+			put(resp, 1, 4); // leader
+			put(resp, 1, 4);
+			put(resp, 1, 4);
+			put(resp, 1, 4);
+			put(resp, 1, 4);
+			return resp;
+		}
+
+		EXPECT_EQ(api_key, 0);
+		EXPECT_EQ(get_be(req, pos, 2), 0xffff); // transactional id
+		EXPECT_EQ(get_be(req, pos, 2), 0xffff); // acks
+		pos += 4; // timeout
+		EXPECT_EQ(get_be(req, pos, 4), 1);
+		size_t topic_len = get_be(req, pos, 2);
+		EXPECT_EQ(req.substr(pos, topic_len), "falco");
+		pos += topic_len;
+		EXPECT_EQ(get_be(req, pos, 4), 1);
+		EXPECT_EQ(get_be(req, pos, 4), 0);
+		uint32_t len = get_be(req, pos, 4);
+		EXPECT_EQ(pos + len, req.size());
+
+		int16_t error = 0;
+		if(!m_errors.empty())
+		{
+			error = m_errors.front();
+			m_errors.erase(m_errors.begin());
+		}
+		else
+		{
+			for(auto& v : decode_record_batch(req.substr(pos, len)))
+			{
+				m_values.push_back(v);
+			}
+		}
+		put(resp, 1, 4);
+		put_string(resp, "falco");
+		put(resp, 1, 4);
+		put(resp, 0, 4);
+		put(resp, error, 2);
+		put(resp, 0, 8);
+		put(resp, 0xffffffffffffffff, 8);
+		put(resp, 0, 4); // throttle time
+		return resp;
+	}
+
+	void run()
+	{
+		std::vector<int> conns;
+		std::vector<std::string> bufs;
+		while(!m_stop)
+		{
+			std::vector<struct pollfd> fds = {{m_fd, POLLIN, 0}};
+			for(int c : conns)
+			{
+				fds.push_back({c, POLLIN, 0});
+			}
+			if(poll(fds.data(), fds.size(), 20) <= 0)
+			{
+				continue;
+			}
+			if(fds[0].revents & POLLIN)
+			{
+				conns.push_back(accept(m_fd, nullptr, nullptr));
+				bufs.emplace_back();
+			}
+			for(size_t i = 0; i + 1 < fds.size(); i++)
+			{
+				if(!(fds[i + 1].revents & (POLLIN | POLLHUP)))
+				{
+					continue;
+				}
+				char buf[65536];
+				ssize_t n = recv(conns[i], buf, sizeof(buf), 0);
+				if(n <= 0)
+				{
+					close(conns[i]);
+					conns[i] = -1;
+					continue;
+				}
+				auto& in = bufs[i];
+				in.append(buf, n);
+				size_t pos = 0;
+				while(in.size() >= 4 && in.size() - 4 >= (pos = 0, get_be(in, pos, 4)))
+				{
+					pos = 0;
+					size_t len = get_be(in, pos, 4);
+					std::string resp = handle(in.substr(4, len));
+					in.erase(0, 4 + len);
+					std::string frame;
+					put(frame, resp.size(), 4);
+					frame += resp;
+					send(conns[i], frame.data(), frame.size(), MSG_NOSIGNAL);
+				}
+			}
+			for(size_t i = conns.size(); i > 0; i--)
+			{
+				if(conns[i - 1] < 0)
+				{
+					conns.erase(conns.begin() + i - 1);
+					bufs.erase(bufs.begin() + i - 1);
+				}
+			}
+		}
+		for(int c : conns)
+		{
+			close(c);
+		}
+	}
+
+	int m_fd = -1;
+	int m_port = 0;
+	std::atomic<bool> m_stop{false};
+	std::thread m_thread;
+	std::mutex m_mtx;
+	std::vector<int16_t> m_errors;
+	std::vector<std::string> m_values;
+	int m_metadata_requests = 0;
+};
+
+config make_config(const fake_broker& broker)
+{
+	config oc;
+	oc.name = "kafka";
+	oc.options["brokers"] = broker.address();
+	oc.options["topic"] = "falco";
+	oc.options["batch_max_alerts"] = "4";
+	oc.options["batch_linger_ms"] = "1000";
+	oc.options["max_in_flight"] = "1";
+	oc.options["retry_backoff_ms"] = "1";
+	return oc;
+}
+
+void send_alerts(output_kafka& out, int num)
+{
+	for(int i = 0; i < num; i++)
+	{
+		message msg;
+		msg.ts = 1700000000000000000 + i * 1000000;
+		msg.msg = "alert " + std::to_string(i);
+		out.output(&msg);
+	}
+	out.cleanup();
+}
+
+} // namespace
+
+TEST(OutputsKafka, crc32c)
+{
+	EXPECT_EQ(kafka::crc32c("123456789", 9), 0xe3069283);
+	EXPECT_EQ(kafka::crc32c("", 0), 0);
+}
+
+TEST(OutputsKafka, record_batch)
+{
+	std::string records;
+	kafka::append_record(records, 0, 0, "first");
+	kafka::append_record(records, 5, 1, std::string(300, 'x'));
+
+	for(bool gzip : {false, true})
+	{
+		std::string batch;
+		ASSERT_TRUE(kafka::append_record_batch(batch, records, 2, 1000, 1005, gzip));
+		auto values = decode_record_batch(batch);
+		ASSERT_EQ(values.size(), 2);
+		EXPECT_EQ(values[0], "first");
+		EXPECT_EQ(values[1], std::string(300, 'x'));
+	}
+}
+
+TEST(OutputsKafka, invalid_options)
+{
+	config oc;
+	oc.name = "kafka";
+	std::string err;
+	EXPECT_FALSE(output_kafka().init(oc, false, "host", false, err));
+
+	oc.options["brokers"] = "localhost:9092";
+	EXPECT_FALSE(output_kafka().init(oc, false, "host", false, err));
+
+	oc.options["topic"] = "falco";
+	oc.options["acks"] = "2";
+	EXPECT_FALSE(output_kafka().init(oc, false, "host", false, err));
+
+	oc.options["acks"] = "all";
+	oc.options["compression"] = "zstd";
+	EXPECT_FALSE(output_kafka().init(oc, false, "host", false, err));
+}
+
+TEST(OutputsKafka, produce)
+{
+	fake_broker broker;
+	auto oc = make_config(broker);
+	oc.options["compression"] = "gzip";
+	output_kafka out;
+	std::string err;
+	ASSERT_TRUE(out.init(oc, false, "host", false, err)) << err;
+	send_alerts(out, 10);
+
+	auto values = broker.values();
+	ASSERT_EQ(values.size(), 10);
+	for(int i = 0; i < 10; i++)
+	{
+		EXPECT_EQ(values[i], "alert " + std::to_string(i));
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	out.get_metrics(metrics);
+	EXPECT_EQ(metrics["batches"], 3);
+	EXPECT_EQ(metrics["alerts"], 10);
+	EXPECT_EQ(metrics["failures"], 0);
+	EXPECT_EQ(metrics["alerts_dropped"], 0);
+	EXPECT_EQ(metrics["metadata_refreshes"], 1);
+}
+
+TEST(OutputsKafka, retries)
+{
+	// the leader has moved, then replicas are missing, then the batch is
+	// too large, which isn't retried
+	fake_broker broker({6, 19, 10});
+	output_kafka out;
+	std::string err;
+	ASSERT_TRUE(out.init(make_config(broker), false, "host", false, err)) << err;
+	send_alerts(out, 8);
+
+	auto values = broker.values();
+	ASSERT_EQ(values.size(), 4);
+	for(int i = 0; i < 4; i++)
+	{
+		EXPECT_EQ(values[i], "alert " + std::to_string(i + 4));
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	out.get_metrics(metrics);
+	EXPECT_EQ(metrics["alerts"], 4);
+	EXPECT_EQ(metrics["failures"], 3);
+	EXPECT_EQ(metrics["retries"], 2);
+	EXPECT_EQ(metrics["alerts_dropped"], 4);
+	// the metadata isn't refreshed more than once per second
+	EXPECT_EQ(broker.metadata_requests(), 1);
+}
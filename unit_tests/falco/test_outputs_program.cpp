@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_program.h>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+class output_program_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_path = (std::filesystem::temp_directory_path() / ("falco_program_" + std::to_string(getpid()))).string();
+		std::filesystem::remove(m_path);
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove(m_path);
+	}
+
+	std::unique_ptr<output_program> make_output(const std::string& program, std::map<std::string, std::string> options)
+	{
+		config oc;
+		oc.name = "program";
+		oc.options = std::move(options);
+		oc.options["program"] = program;
+		oc.options["keep_alive"] = "true";
+		auto o = std::make_unique<output_program>();
+		std::string err;
+		EXPECT_TRUE(o->init(oc, false, "host", false, err)) << err;
+		return o;
+	}
+
+	static void output(output_program& o, const std::string& line)
+	{
+		message msg;
+		msg.ts = 1;
+		msg.priority = falco_common::PRIORITY_WARNING;
+		msg.msg = line;
+		o.output(&msg);
+	}
+
+	std::vector<std::string> read_lines()
+	{
+		std::vector<std::string> res;
+		std::ifstream f(m_path);
+		std::string line;
+		while(std::getline(f, line))
+		{
+			res.push_back(line);
+		}
+		return res;
+	}
+
+	// the program has written its input once the output is destroyed, as
+	// the writer thread waits for it to exit
+	void finish(std::unique_ptr<output_program>& o)
+	{
+		o->cleanup();
+		o.reset();
+	}
+
+	std::string m_path;
+};
+
+TEST_F(output_program_test, keeps_the_alerts_in_order)
+{
+	auto o = make_output("cat >> " + m_path, {{"buffer_size", "256"}});
+	for(int i = 0; i < 1000; i++)
+	{
+		output(*o, "alert " + std::to_string(i));
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["alerts_dropped"], 0u);
+	finish(o);
+
+	auto lines = read_lines();
+	ASSERT_EQ(lines.size(), 1000u);
+	for(int i = 0; i < 1000; i++)
+	{
+		EXPECT_EQ(lines[i], "alert " + std::to_string(i));
+	}
+}
+
+TEST_F(output_program_test, drops_when_full)
+{
+	// the program doesn't read its input for a while, after which the
+	// pipe and the ring are full
+	auto o = make_output("sleep 1; cat >> " + m_path, {{"buffer_size", "4096"}, {"full_buffer_policy", "drop"}});
+	std::string payload(1000, 'x');
+	for(int i = 0; i < 200; i++)
+	{
+		output(*o, std::to_string(i) + " " + payload);
+	}
+
+	// the alerts larger than the ring are always dropped
+	output(*o, std::string(5000, 'y'));
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	auto dropped = metrics["alerts_dropped"];
+	EXPECT_GT(dropped, 1u);
+	finish(o);
+
+	// the alerts written are whole, and in order
+	auto lines = read_lines();
+	EXPECT_EQ(lines.size() + dropped, 201u);
+	int last = -1;
+	for(const auto& line : lines)
+	{
+		auto sep = line.find(' ');
+		ASSERT_NE(sep, std::string::npos);
+		int i = std::stoi(line.substr(0, sep));
+		EXPECT_GT(i, last);
+		last = i;
+		EXPECT_EQ(line.substr(sep + 1), payload);
+	}
+}
+
+TEST_F(output_program_test, reopen)
+{
+	// each instance of the program writes a line when it starts
+	auto o = make_output("echo start >> " + m_path + "; cat >> " + m_path, {});
+	output(*o, "alert 0");
+	o->cleanup();
+
+	o->reopen();
+	output(*o, "alert 1");
+	output(*o, "alert 2");
+	finish(o);
+
+	std::vector<std::string> expected = {"start", "alert 0", "start", "alert 1", "alert 2"};
+	EXPECT_EQ(read_lines(), expected);
+}
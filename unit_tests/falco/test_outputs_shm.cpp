@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_shm.h>
+
+#include <filesystem>
+
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+class output_shm_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_path = (std::filesystem::temp_directory_path() / ("falco_shm_" + std::to_string(getpid()))).string();
+		std::filesystem::remove(m_path);
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove(m_path);
+	}
+
+	std::unique_ptr<output_shm> make_output(uint64_t capacity)
+	{
+		config oc;
+		oc.name = "shm";
+		oc.options["path"] = m_path;
+		oc.options["capacity"] = std::to_string(capacity);
+		oc.options["mode"] = "0600";
+		auto o = std::make_unique<output_shm>();
+		std::string err;
+		EXPECT_TRUE(o->init(oc, false, "host", false, err)) << err;
+		return o;
+	}
+
+	static void output(output_shm& o, const std::string& line)
+	{
+		message msg;
+		msg.ts = 1;
+		msg.priority = falco_common::PRIORITY_WARNING;
+		msg.msg = line;
+		o.output(&msg);
+	}
+
+	std::string m_path;
+};
+
+TEST_F(output_shm_test, read_alerts)
+{
+	auto o = make_output(1000);
+	shm_ring::reader r;
+	std::string err;
+	ASSERT_TRUE(r.open(m_path, err)) << err;
+	EXPECT_EQ(r.hdr()->capacity, 64 * 1024);
+	EXPECT_EQ(r.hdr()->encoding, 0);
+
+	std::string out;
+	uint64_t seq = 0;
+	EXPECT_EQ(r.next(out, seq), shm_ring::reader::result::EMPTY);
+
+	// enough alerts to wrap around the data area a few times
+	for(uint64_t i = 1; i <= 1000; i++)
+	{
+		output(*o, "alert " + std::to_string(i) + std::string(i % 200, 'x'));
+		ASSERT_EQ(r.next(out, seq), shm_ring::reader::result::ALERT);
+		EXPECT_EQ(seq, i);
+		EXPECT_EQ(out, "alert " + std::to_string(i) + std::string(i % 200, 'x'));
+	}
+	EXPECT_EQ(r.next(out, seq), shm_ring::reader::result::EMPTY);
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["alerts"], 1000);
+	EXPECT_EQ(metrics["alerts_dropped"], 0);
+	EXPECT_GT(metrics["wraps"], 0);
+
+	o.reset();
+	EXPECT_EQ(r.next(out, seq), shm_ring::reader::result::CLOSED);
+}
+
+TEST_F(output_shm_test, lapped_reader)
+{
+	auto o = make_output(0);
+	shm_ring::reader r;
+	std::string err;
+	ASSERT_TRUE(r.open(m_path, err)) << err;
+
+	// the reader falls behind by more than the data area
+	std::string line(1000, 'a');
+	for(int i = 0; i < 100; i++)
+	{
+		output(*o, line);
+	}
+	std::string out;
+	uint64_t seq = 0;
+	EXPECT_EQ(r.next(out, seq), shm_ring::reader::result::LAPPED);
+	EXPECT_EQ(r.next(out, seq), shm_ring::reader::result::EMPTY);
+	output(*o, "next");
+	EXPECT_EQ(r.next(out, seq), shm_ring::reader::result::ALERT);
+	EXPECT_EQ(seq, 101);
+	EXPECT_EQ(out, "next");
+}
+
+TEST_F(output_shm_test, too_large)
+{
+	auto o = make_output(0);
+	output(*o, std::string(64 * 1024, 'a'));
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["alerts"], 0);
+	EXPECT_EQ(metrics["alerts_dropped"], 1);
+}
+
+TEST_F(output_shm_test, not_a_ring)
+{
+	FILE* f = fopen(m_path.c_str(), "w");
+	ASSERT_NE(f, nullptr);
+	fputs(std::string(8192, 'x').c_str(), f);
+	fclose(f);
+
+	shm_ring::reader r;
+	std::string err;
+	EXPECT_FALSE(r.open(m_path, err));
+	EXPECT_FALSE(err.empty());
+}
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_spill.h>
+
+#include <filesystem>
+
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+class spill_buffer_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_dir = (std::filesystem::temp_directory_path() / ("falco_spill_" + std::to_string(getpid()))).string();
+		std::filesystem::remove_all(m_dir);
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove_all(m_dir);
+	}
+
+	static message make_message(uint64_t ts)
+	{
+		message msg;
+		msg.ts = ts;
+		msg.priority = falco_common::PRIORITY_WARNING;
+		msg.msg = "alert " + std::to_string(ts);
+		msg.rule = "test rule";
+		msg.source = "syscall";
+		msg.tags = std::set<std::string>{"a", "b"};
+		falco::assign_field_values(msg.fields, nlohmann::json::parse(R"({"proc.name": "bash", "evt.num": 12, "ok": true})"));
+		return msg;
+	}
+
+	std::string m_dir;
+};
+
+TEST_F(spill_buffer_test, serialization)
+{
+	auto msg = make_message(42);
+	std::string buf;
+	serialize_message(msg, buf);
+
+	message out;
+	ASSERT_TRUE(deserialize_message(buf.data(), buf.size(), out));
+	EXPECT_EQ(out.ts, 42);
+	EXPECT_EQ(out.priority, falco_common::PRIORITY_WARNING);
+	EXPECT_EQ(out.msg, "alert 42");
+	EXPECT_EQ(out.rule, "test rule");
+	EXPECT_EQ(out.source, "syscall");
+	EXPECT_EQ(out.tags, msg.tags);
+	ASSERT_EQ(out.fields.size(), 3);
+	std::string json;
+	falco::append_json(json, out.fields);
+	EXPECT_EQ(nlohmann::json::parse(json), nlohmann::json::parse(R"({"proc.name": "bash", "evt.num": 12, "ok": true})"));
+
+	EXPECT_FALSE(deserialize_message(buf.data(), buf.size() - 1, out));
+}
+
+TEST_F(spill_buffer_test, spills_in_order_when_queue_is_full)
+{
+	spill_buffer spill(m_dir, 1024 * 1024, 4096);
+	bool queue_full = false;
+	auto try_queue = [&] { return !queue_full; };
+
+	EXPECT_EQ(spill.push(make_message(1), try_queue), spill_buffer::QUEUED);
+	queue_full = true;
+	EXPECT_EQ(spill.push(make_message(2), try_queue), spill_buffer::SPILLED);
+
+	// alerts keep being spilled until the spilled ones are read
+	queue_full = false;
+	for(uint64_t i = 3; i <= 100; i++)
+	{
+		EXPECT_EQ(spill.push(make_message(i), try_queue), spill_buffer::SPILLED);
+	}
+	EXPECT_EQ(spill.num_pending(), 99);
+
+	message msg;
+	for(uint64_t i = 2; i <= 100; i++)
+	{
+		ASSERT_TRUE(spill.pop(msg));
+		EXPECT_EQ(msg.ts, i);
+	}
+	EXPECT_FALSE(spill.pop(msg));
+	EXPECT_EQ(spill.num_pending(), 0);
+	EXPECT_EQ(spill.num_spilled(), 99);
+	EXPECT_EQ(spill.push(make_message(101), try_queue), spill_buffer::QUEUED);
+
+	// fully read segments are removed, except the one being written
+	EXPECT_EQ(std::distance(std::filesystem::directory_iterator(m_dir), std::filesystem::directory_iterator()), 1);
+}
+
+TEST_F(spill_buffer_test, survives_restarts)
+{
+	message msg;
+	{
+		spill_buffer spill(m_dir, 1024 * 1024, 4096);
+		for(uint64_t i = 1; i <= 50; i++)
+		{
+			spill.spill(make_message(i));
+		}
+		for(uint64_t i = 1; i <= 10; i++)
+		{
+			ASSERT_TRUE(spill.pop(msg));
+		}
+	}
+
+	spill_buffer spill(m_dir, 1024 * 1024, 4096);
+	EXPECT_EQ(spill.num_pending(), 40);
+	spill.spill(make_message(51));
+	for(uint64_t i = 11; i <= 51; i++)
+	{
+		ASSERT_TRUE(spill.pop(msg));
+		EXPECT_EQ(msg.ts, i);
+	}
+	EXPECT_FALSE(spill.pop(msg));
+}
+
+TEST_F(spill_buffer_test, size_cap)
+{
+	spill_buffer spill(m_dir, 8192, 4096);
+	uint64_t spilled = 0;
+	for(uint64_t i = 0; i < 1000; i++)
+	{
+		if(spill.spill(make_message(i)) == spill_buffer::SPILLED)
+		{
+			spilled++;
+		}
+	}
+	EXPECT_GT(spilled, 0);
+	EXPECT_LT(spilled, 1000);
+	EXPECT_EQ(spill.num_drops(), 1000 - spilled);
+
+	// space is available again once the alerts are read
+	message msg;
+	while(spill.pop(msg))
+	{
+	}
+	EXPECT_EQ(spill.spill(make_message(0)), spill_buffer::SPILLED);
+
+	EXPECT_THROW(spill_buffer(m_dir, 16, 16), falco_exception);
+}
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_syslog.h>
+
+#include <filesystem>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+static message make_message(const std::string& text)
+{
+	message msg;
+	msg.ts = 1700000000123456789;
+	msg.priority = falco_common::PRIORITY_WARNING;
+	msg.msg = text;
+	return msg;
+}
+
+static std::string recv_all(int fd, size_t len)
+{
+	std::string out;
+	char buf[4096];
+	while(out.size() < len)
+	{
+		struct pollfd pfd = {fd, POLLIN, 0};
+		if(poll(&pfd, 1, 5000) <= 0)
+		{
+			break;
+		}
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if(n <= 0)
+		{
+			break;
+		}
+		out.append(buf, n);
+	}
+	return out;
+}
+
+TEST(OutputsSyslog, format_rfc5424)
+{
+	std::string out;
+	output_syslog::format_rfc5424(out, make_message("an alert"), "host", 42, false);
+	EXPECT_EQ(out, "<12>1 2023-11-14T22:13:20.123456Z host falco 42 - - an alert");
+
+	output_syslog::format_rfc5424(out, make_message("an alert"), "", 42, true);
+	EXPECT_EQ(out, "57 <12>1 2023-11-14T22:13:20.123456Z - falco 42 - - an alert");
+}
+
+TEST(OutputsSyslog, invalid_options)
+{
+	config oc;
+	oc.name = "syslog";
+	std::string err;
+
+	oc.options["mode"] = "fast";
+	EXPECT_FALSE(output_syslog().init(oc, false, "host", false, err));
+
+	oc.options["mode"] = "socket";
+	oc.options["address"] = "http://localhost:80";
+	EXPECT_FALSE(output_syslog().init(oc, false, "host", false, err));
+
+	oc.options["address"] = "udp://localhost";
+	EXPECT_FALSE(output_syslog().init(oc, false, "host", false, err));
+}
+
+TEST(OutputsSyslog, unix_datagram)
+{
+	auto path = (std::filesystem::temp_directory_path() / ("falco_syslog_" + std::to_string(getpid()))).string();
+	unlink(path.c_str());
+	int srv = socket(AF_UNIX, SOCK_DGRAM, 0);
+	ASSERT_GE(srv, 0);
+	struct sockaddr_un sun = {};
+	sun.sun_family = AF_UNIX;
+	strncpy(sun.sun_path, path.c_str(), sizeof(sun.sun_path) - 1);
+	ASSERT_EQ(bind(srv, (struct sockaddr*) &sun, sizeof(sun)), 0);
+
+	config oc;
+	oc.name = "syslog";
+	oc.options["mode"] = "socket";
+	oc.options["address"] = "unix://" + path;
+	std::string err;
+	output_syslog out;
+	ASSERT_TRUE(out.init(oc, false, "host", false, err)) << err;
+	for(int i = 0; i < 10; i++)
+	{
+		auto msg = make_message("alert " + std::to_string(i));
+		out.output(&msg);
+	}
+	out.cleanup();
+
+	// each alert is a datagram of its own
+	std::string expected;
+	for(int i = 0; i < 10; i++)
+	{
+		output_syslog::format_rfc5424(expected, make_message("alert " + std::to_string(i)), "host", getpid(), false);
+		EXPECT_EQ(recv_all(srv, 1), expected);
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	out.get_metrics(metrics);
+	EXPECT_EQ(metrics["sent"], 10);
+	EXPECT_EQ(metrics["alerts_dropped"], 0);
+	EXPECT_GE(metrics["batches"], 1);
+	EXPECT_LE(metrics["batches"], 10);
+
+	close(srv);
+	unlink(path.c_str());
+}
+
+TEST(OutputsSyslog, tcp_reconnects)
+{
+	int srv = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_GE(srv, 0);
+	struct sockaddr_in sin = {};
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(bind(srv, (struct sockaddr*) &sin, sizeof(sin)), 0);
+	socklen_t len = sizeof(sin);
+	ASSERT_EQ(getsockname(srv, (struct sockaddr*) &sin, &len), 0);
+	ASSERT_EQ(listen(srv, 4), 0);
+
+	config oc;
+	oc.name = "syslog";
+	oc.options["mode"] = "socket";
+	oc.options["address"] = "tcp://127.0.0.1:" + std::to_string(ntohs(sin.sin_port));
+	std::string err;
+	output_syslog out;
+	ASSERT_TRUE(out.init(oc, false, "", false, err)) << err;
+
+	std::string expected, frame;
+	for(int i = 0; i < 5; i++)
+	{
+		auto msg = make_message("alert " + std::to_string(i));
+		output_syslog::format_rfc5424(frame, msg, "", getpid(), true);
+		expected += frame;
+		out.output(&msg);
+	}
+	out.cleanup();
+	int conn = accept(srv, nullptr, nullptr);
+	ASSERT_GE(conn, 0);
+	EXPECT_EQ(recv_all(conn, expected.size()), expected);
+
+	// alerts are sent on a new connection after a reopen
+	out.reopen();
+	auto msg = make_message("after reopen");
+	output_syslog::format_rfc5424(frame, msg, "", getpid(), true);
+	out.output(&msg);
+	out.cleanup();
+	int conn2 = accept(srv, nullptr, nullptr);
+	ASSERT_GE(conn2, 0);
+	EXPECT_EQ(recv_all(conn2, frame.size()), frame);
+
+	std::map<std::string, uint64_t> metrics;
+	out.get_metrics(metrics);
+	EXPECT_EQ(metrics["sent"], 6);
+	EXPECT_EQ(metrics["reconnects"], 1);
+
+	close(conn);
+	close(conn2);
+	close(srv);
+}
+
+TEST(OutputsSyslog, drops_when_full)
+{
+	config oc;
+	oc.name = "syslog";
+	oc.options["mode"] = "socket";
+	// nothing listens there, so the alerts stay queued
+	oc.options["address"] = "unix:///nonexistent/falco_syslog";
+	oc.options["buffer_size"] = "200";
+	std::string err;
+	output_syslog out;
+	ASSERT_TRUE(out.init(oc, false, "host", false, err)) << err;
+
+	for(int i = 0; i < 10; i++)
+	{
+		auto msg = make_message("alert " + std::to_string(i));
+		out.output(&msg);
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	out.get_metrics(metrics);
+	EXPECT_GT(metrics["alerts_dropped"], 0);
+	EXPECT_EQ(metrics["sent"], 0);
+}
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/outputs_unix_socket.h>
+
+#include <filesystem>
+#include <sstream>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+class output_unix_socket_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_path = (std::filesystem::temp_directory_path() / ("falco_uds_" + std::to_string(getpid()))).string();
+		std::filesystem::remove(m_path);
+	}
+
+	void TearDown() override
+	{
+		if(m_listener >= 0)
+		{
+			close(m_listener);
+		}
+		std::filesystem::remove(m_path);
+	}
+
+	void listen_on(int type)
+	{
+		m_listener = socket(AF_UNIX, type, 0);
+		ASSERT_GE(m_listener, 0);
+		sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+		ASSERT_EQ(bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+		ASSERT_EQ(listen(m_listener, 1), 0);
+	}
+
+	int accept_client()
+	{
+		struct pollfd pfd = {m_listener, POLLIN, 0};
+		if(poll(&pfd, 1, 5000) != 1)
+		{
+			return -1;
+		}
+		return accept(m_listener, nullptr, nullptr);
+	}
+
+	std::unique_ptr<output_unix_socket> make_output(std::map<std::string, std::string> options)
+	{
+		config oc;
+		oc.name = "unix_socket";
+		oc.options = std::move(options);
+		oc.options["path"] = "unix://" + m_path;
+		oc.options["reconnect_backoff_ms"] = "10";
+		auto o = std::make_unique<output_unix_socket>();
+		std::string err;
+		EXPECT_TRUE(o->init(oc, false, "host", false, err)) << err;
+		return o;
+	}
+
+	static void output(output_unix_socket& o, const std::string& line)
+	{
+		message msg;
+		msg.ts = 1;
+		msg.priority = falco_common::PRIORITY_WARNING;
+		msg.msg = line;
+		o.output(&msg);
+	}
+
+	// Reads from fd until n bytes are received or it times out
+	static std::string read_bytes(int fd, size_t n)
+	{
+		std::string res;
+		char buf[4096];
+		while(res.size() < n)
+		{
+			struct pollfd pfd = {fd, POLLIN, 0};
+			if(poll(&pfd, 1, 5000) != 1)
+			{
+				break;
+			}
+			auto r = read(fd, buf, std::min(sizeof(buf), n - res.size()));
+			if(r <= 0)
+			{
+				break;
+			}
+			res.append(buf, r);
+		}
+		return res;
+	}
+
+	std::string m_path;
+	int m_listener = -1;
+};
+
+TEST_F(output_unix_socket_test, stream_newline)
+{
+	listen_on(SOCK_STREAM);
+	auto o = make_output({});
+	output(*o, "first");
+	output(*o, "second");
+
+	int fd = accept_client();
+	ASSERT_GE(fd, 0);
+	EXPECT_EQ(read_bytes(fd, 13), "first\nsecond\n");
+	o->cleanup();
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["bytes_written"], 13);
+	EXPECT_EQ(metrics["connects"], 1);
+	close(fd);
+}
+
+TEST_F(output_unix_socket_test, stream_length_prefixed)
+{
+	listen_on(SOCK_STREAM);
+	auto o = make_output({{"framing", "length_prefixed"}});
+	output(*o, "abc");
+	output(*o, std::string(200, 'x'));
+
+	int fd = accept_client();
+	ASSERT_GE(fd, 0);
+	// 200 is 0xc8 0x01 as a varint
+	EXPECT_EQ(read_bytes(fd, 4 + 202), std::string("\x03" "abc" "\xc8\x01", 6) + std::string(200, 'x'));
+	close(fd);
+}
+
+TEST_F(output_unix_socket_test, seqpacket)
+{
+	listen_on(SOCK_SEQPACKET);
+	auto o = make_output({{"socket_type", "seqpacket"}, {"buffer_size", "16"}});
+	int fd = -1;
+	// the alerts wrap around the ring, but are still sent as a whole
+	for(int i = 0; i < 10; i++)
+	{
+		output(*o, "alert " + std::to_string(i));
+		if(fd < 0)
+		{
+			fd = accept_client();
+			ASSERT_GE(fd, 0);
+		}
+		char buf[64];
+		struct pollfd pfd = {fd, POLLIN, 0};
+		ASSERT_EQ(poll(&pfd, 1, 5000), 1);
+		auto n = recv(fd, buf, sizeof(buf), 0);
+		EXPECT_EQ(std::string(buf, n), "alert " + std::to_string(i));
+	}
+	close(fd);
+}
+
+TEST_F(output_unix_socket_test, reconnect)
+{
+	listen_on(SOCK_STREAM);
+	auto o = make_output({});
+	output(*o, "first");
+	int fd = accept_client();
+	ASSERT_GE(fd, 0);
+	EXPECT_EQ(read_bytes(fd, 6), "first\n");
+	close(fd);
+
+	// the first writes after the listener went away may still succeed
+	for(int i = 0; i < 100; i++)
+	{
+		std::map<std::string, uint64_t> metrics;
+		o->get_metrics(metrics);
+		if(metrics["disconnects"] > 0)
+		{
+			break;
+		}
+		output(*o, "lost");
+		usleep(1000);
+	}
+	output(*o, "again");
+	fd = accept_client();
+	ASSERT_GE(fd, 0);
+	// the alerts that were still buffered come first
+	std::string received;
+	while(received.size() < 6 || received.substr(received.size() - 6) != "again\n")
+	{
+		auto more = read_bytes(fd, 1);
+		ASSERT_FALSE(more.empty()) << received;
+		received += more;
+	}
+	std::istringstream lines(received);
+	for(std::string line; std::getline(lines, line);)
+	{
+		EXPECT_TRUE(line == "lost" || line == "again") << line;
+	}
+	close(fd);
+}
+
+TEST_F(output_unix_socket_test, drop_when_full)
+{
+	auto o = make_output({{"full_buffer_policy", "drop"}, {"buffer_size", "10"}});
+	output(*o, "12345");
+	output(*o, "67890");
+	output(*o, std::string(20, 'x'));
+
+	std::map<std::string, uint64_t> metrics;
+	o->get_metrics(metrics);
+	EXPECT_EQ(metrics["alerts_dropped"], 2);
+	EXPECT_EQ(metrics["bytes_dropped"], 6 + 21);
+}
+
+TEST_F(output_unix_socket_test, invalid_options)
+{
+	config oc;
+	oc.name = "unix_socket";
+	oc.options["path"] = m_path;
+	oc.options["socket_type"] = "dgram";
+	output_unix_socket o;
+	std::string err;
+	EXPECT_FALSE(o.init(oc, false, "host", false, err));
+	EXPECT_FALSE(err.empty());
+}
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/plugin_field_batch.h>
+
+#include "../test_events.h"
+
+#include <string>
+#include <vector>
+
+// A plugin extracting the string fields test.a, test.b and test.c from the
+// syscall events, whose values are the field name followed by the event
+// number. It counts its calls, and reuses its buffers at each of them as
+// plugins are allowed to.
+namespace
+{
+struct test_plugin
+{
+	uint64_t calls = 0;
+	uint64_t last_num_fields = 0;
+	std::vector<std::string> bufs;
+	std::vector<const char*> strs;
+};
+
+test_plugin s_plugin;
+
+const char* plugin_get_required_api_version()
+{
+	return PLUGIN_API_VERSION_STR;
+}
+
+const char* plugin_get_version()
+{
+	return "0.1.0";
+}
+
+const char* plugin_get_name()
+{
+	return "test_fields";
+}
+
+const char* plugin_get_description()
+{
+	return "test plugin";
+}
+
+const char* plugin_get_contact()
+{
+	return "test";
+}
+
+const char* plugin_get_last_error(ss_plugin_t*)
+{
+	return "";
+}
+
+ss_plugin_t* plugin_init(const ss_plugin_init_input*, ss_plugin_rc* rc)
+{
+	*rc = SS_PLUGIN_SUCCESS;
+	return reinterpret_cast<ss_plugin_t*>(&s_plugin);
+}
+
+void plugin_destroy(ss_plugin_t*)
+{
+}
+
+const char* plugin_get_fields()
+{
+	return R"([
+		{"type": "string", "name": "test.a", "desc": "a"},
+		{"type": "string", "name": "test.b", "desc": "b"},
+		{"type": "string", "name": "test.c", "desc": "c"}
+	])";
+}
+
+const char* plugin_get_extract_event_sources()
+{
+	return R"(["syscall"])";
+}
+
+uint16_t* plugin_get_extract_event_types(uint32_t* num_types, ss_plugin_t*)
+{
+	static uint16_t types[] = {PPME_SYSCALL_OPENAT_2_X};
+	*num_types = sizeof(types) / sizeof(types[0]);
+	return types;
+}
+
+ss_plugin_rc plugin_extract_fields(ss_plugin_t* s, const ss_plugin_event_input* evt, const ss_plugin_field_extract_input* in)
+{
+	auto p = reinterpret_cast<test_plugin*>(s);
+	p->calls++;
+	p->last_num_fields = in->num_fields;
+
+	// the values of the previous call are overwritten
+	for(auto& b : p->bufs)
+	{
+		b.assign(b.size(), 'x');
+	}
+	p->bufs.resize(in->num_fields);
+	p->strs.resize(in->num_fields);
+	for(uint32_t i = 0; i < in->num_fields; i++)
+	{
+		p->bufs[i] = std::string(in->fields[i].field) + "-" + std::to_string(evt->evtnum);
+		p->strs[i] = p->bufs[i].c_str();
+		in->fields[i].res.str = &p->strs[i];
+		in->fields[i].res_len = 1;
+	}
+	return SS_PLUGIN_SUCCESS;
+}
+
+plugin_api test_plugin_api()
+{
+	plugin_api api{};
+	api.get_required_api_version = plugin_get_required_api_version;
+	api.get_version = plugin_get_version;
+	api.get_name = plugin_get_name;
+	api.get_description = plugin_get_description;
+	api.get_contact = plugin_get_contact;
+	api.get_last_error = plugin_get_last_error;
+	api.init = plugin_init;
+	api.destroy = plugin_destroy;
+	api.get_fields = plugin_get_fields;
+	api.get_extract_event_sources = plugin_get_extract_event_sources;
+	api.get_extract_event_types = plugin_get_extract_event_types;
+	api.extract_fields = plugin_extract_fields;
+	return api;
+}
+
+class plugin_field_batch_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		s_plugin = test_plugin();
+		m_api = test_plugin_api();
+		m_plugin = m_inspector.register_plugin(&m_api);
+		std::string err;
+		ASSERT_TRUE(m_plugin->init("", err)) << err;
+		m_check = falco::batched_plugin_filtercheck::create(m_plugin);
+	}
+
+	std::unique_ptr<sinsp_filter_check> field(const std::string& name, bool for_filtering)
+	{
+		auto c = m_check->allocate_new();
+		EXPECT_GT(c->parse_field_name(name, true, for_filtering), 0);
+		return c;
+	}
+
+	sinsp_evt* event(test_events& events, int64_t tid)
+	{
+		auto evt = events.open(tid, "/tmp/test");
+		evt->set_source_idx(0);
+		evt->set_source_name("syscall");
+		return evt;
+	}
+
+	static std::string value(sinsp_filter_check* c, sinsp_evt* evt)
+	{
+		std::vector<extract_value_t> values;
+		if(!c->extract(evt, values) || values.size() != 1)
+		{
+			return "<none>";
+		}
+		return (const char*) values[0].ptr;
+	}
+
+	sinsp m_inspector;
+	plugin_api m_api;
+	std::shared_ptr<sinsp_plugin> m_plugin;
+	std::unique_ptr<sinsp_filter_check> m_check;
+};
+} // namespace
+
+TEST_F(plugin_field_batch_test, extracts_the_filtering_fields_in_use_at_once)
+{
+	auto a = field("test.a", true);
+	auto b = field("test.b", true);
+	auto c = field("test.c", false);
+	test_events events(m_inspector);
+	auto tid = events.add_process("cat");
+
+	// the fields are extracted on their own the first time they are needed
+	auto evt = event(events, tid);
+	EXPECT_EQ(value(a.get(), evt), "test.a-1");
+	EXPECT_EQ(value(b.get(), evt), "test.b-1");
+	EXPECT_EQ(value(a.get(), evt), "test.a-1");
+	EXPECT_EQ(s_plugin.calls, 2u);
+	EXPECT_EQ(s_plugin.last_num_fields, 1u);
+
+	// then the filtering fields that were needed are extracted at once,
+	// and the output fields still on their own
+	evt = event(events, tid);
+	EXPECT_EQ(value(b.get(), evt), "test.b-2");
+	EXPECT_EQ(s_plugin.calls, 3u);
+	EXPECT_EQ(s_plugin.last_num_fields, 2u);
+	EXPECT_EQ(value(a.get(), evt), "test.a-2");
+	EXPECT_EQ(s_plugin.calls, 3u);
+	EXPECT_EQ(value(c.get(), evt), "test.c-2");
+	EXPECT_EQ(s_plugin.calls, 4u);
+	EXPECT_EQ(s_plugin.last_num_fields, 1u);
+
+	evt = event(events, tid);
+	EXPECT_EQ(value(a.get(), evt), "test.a-3");
+	EXPECT_EQ(s_plugin.calls, 5u);
+	EXPECT_EQ(s_plugin.last_num_fields, 2u);
+}
+
+TEST_F(plugin_field_batch_test, drops_the_fields_no_longer_needed)
+{
+	auto a = field("test.a", true);
+	auto b = field("test.b", true);
+	test_events events(m_inspector);
+	auto tid = events.add_process("cat");
+
+	auto evt = event(events, tid);
+	EXPECT_EQ(value(a.get(), evt), "test.a-1");
+	EXPECT_EQ(value(b.get(), evt), "test.b-1");
+
+	// as if the rules using test.b were disabled
+	for(uint64_t i = 2; i <= falco::plugin_field_batch::unused_batches + 2; i++)
+	{
+		evt->set_num(i);
+		EXPECT_EQ(value(a.get(), evt), "test.a-" + std::to_string(i));
+	}
+	EXPECT_EQ(s_plugin.last_num_fields, 1u);
+
+	// and enabled again
+	evt->set_num(evt->get_num() + 1);
+	EXPECT_EQ(value(b.get(), evt), "test.b-" + std::to_string(evt->get_num()));
+	evt->set_num(evt->get_num() + 1);
+	EXPECT_EQ(value(a.get(), evt), "test.a-" + std::to_string(evt->get_num()));
+	EXPECT_EQ(s_plugin.last_num_fields, 2u);
+}
+
+TEST_F(plugin_field_batch_test, keeps_copies_of_the_values)
+{
+	auto a = field("test.a", true);
+	auto b = field("test.b", true);
+	auto c = field("test.c", false);
+	test_events events(m_inspector);
+	auto tid = events.add_process("cat");
+
+	auto evt = event(events, tid);
+	value(a.get(), evt);
+	value(b.get(), evt);
+	evt = event(events, tid);
+	std::vector<extract_value_t> values;
+	ASSERT_TRUE(a->extract(evt, values, false));
+	auto a_ptr = values[0].ptr;
+
+	// the plugin overwrites its buffers at the next call, while the values
+	// of the batch stay valid until the next event
+	EXPECT_EQ(value(c.get(), evt), "test.c-2");
+	EXPECT_EQ(std::string((const char*) a_ptr), "test.a-2");
+	EXPECT_EQ(value(b.get(), evt), "test.b-2");
+	EXPECT_EQ(s_plugin.calls, 4u);
+}
+
+TEST_F(plugin_field_batch_test, skips_incompatible_events)
+{
+	auto a = field("test.a", true);
+	test_events events(m_inspector);
+	auto tid = events.add_process("cat");
+
+	auto evt = event(events, tid);
+	evt->set_source_idx(1);
+	evt->set_source_name("other");
+	EXPECT_EQ(value(a.get(), evt), "<none>");
+
+	// the plugin doesn't extract from the close events
+	evt = events.close(tid);
+	evt->set_source_idx(0);
+	evt->set_source_name("syscall");
+	EXPECT_EQ(value(a.get(), evt), "<none>");
+	EXPECT_EQ(s_plugin.calls, 0u);
+}
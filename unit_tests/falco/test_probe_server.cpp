@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <falco/probe_server.h>
+
+#include <atomic>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace falco;
+
+// sends the request to the server, and returns the whole response
+static std::string request(uint16_t port, const std::string& req)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+	std::string res;
+	if(connect(fd, (sockaddr*) &addr, sizeof(addr)) == 0
+		&& send(fd, req.data(), req.size(), MSG_NOSIGNAL) == (ssize_t) req.size())
+	{
+		char buf[256];
+		ssize_t n;
+		while((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+		{
+			res.append(buf, n);
+		}
+	}
+	close(fd);
+	return res;
+}
+
+static std::string get(uint16_t port, const std::string& path)
+{
+	return request(port, "GET " + path + " HTTP/1.1\r\nHost: localhost\r\nUser-Agent: kube-probe/1.30\r\n\r\n");
+}
+
+TEST(ProbeServer, probes)
+{
+	std::atomic<bool> ready{false};
+	probe_server server("/healthz", "/readyz", [&ready] { return ready.load(); });
+	server.start("127.0.0.1", 0);
+	ASSERT_NE(server.port(), 0);
+
+	auto res = get(server.port(), "/healthz");
+	EXPECT_EQ(res.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << res;
+	EXPECT_NE(res.find("Content-Length: 16\r\n"), std::string::npos) << res;
+	EXPECT_EQ(res.substr(res.size() - 16), "{\"status\": \"ok\"}");
+
+	res = get(server.port(), "/readyz");
+	EXPECT_EQ(res.rfind("HTTP/1.1 503 ", 0), 0u) << res;
+	EXPECT_NE(res.find("{\"status\": \"starting\"}"), std::string::npos) << res;
+	ready = true;
+	res = get(server.port(), "/readyz?verbose");
+	EXPECT_EQ(res.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << res;
+
+	EXPECT_EQ(get(server.port(), "/metrics").rfind("HTTP/1.1 404 ", 0), 0u);
+	EXPECT_EQ(request(server.port(), "POST /healthz HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 400 ", 0), 0u);
+
+	// an incomplete request gets no response once it times out
+	EXPECT_EQ(request(server.port(), "GET /healthz HTTP/1.1\r\n"), "");
+	EXPECT_EQ(get(server.port(), "/healthz").rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+
+	server.stop();
+	EXPECT_EQ(get(server.port(), "/healthz"), "");
+}
+
+TEST(ProbeServer, invalid_address)
+{
+	probe_server server("/healthz", "/readyz", [] { return true; });
+	EXPECT_ANY_THROW(server.start("not an address", 0));
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <falco/profiler.h>
+#include <engine/current_rule.h>
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+using namespace std::chrono;
+
+static void burn_cpu(std::atomic<bool>& stop)
+{
+	falco::profiler::set_thread_label("source:test");
+	volatile double x = 0;
+	while(!stop.load())
+	{
+		if(falco::current_rule::tracking())
+		{
+			falco::current_rule::set("Some; rule");
+		}
+		for(int i = 0; i < 100000; i++)
+		{
+			x = x + i * 0.5;
+		}
+		falco::current_rule::set(nullptr);
+	}
+}
+
+TEST(profiler, samples_annotated_stacks)
+{
+	std::atomic<bool> stop{false};
+	std::thread t(burn_cpu, std::ref(stop));
+
+	falco::profiler p(499, seconds(30), "/tmp");
+	std::string folded;
+	std::string err;
+	ASSERT_TRUE(p.run(seconds(1), folded, err)) << err;
+	stop.store(true);
+	t.join();
+
+	// the separators in the rule name are replaced
+	EXPECT_NE(folded.find("source:test;rule:Some: rule;"), std::string::npos) << folded;
+	EXPECT_FALSE(falco::current_rule::tracking());
+
+	uint64_t samples = 0;
+	size_t pos = 0;
+	while(pos < folded.size())
+	{
+		auto end = folded.find('\n', pos);
+		ASSERT_NE(end, std::string::npos);
+		auto line = folded.substr(pos, end - pos);
+		samples += std::stoull(line.substr(line.rfind(' ') + 1));
+		pos = end + 1;
+	}
+	EXPECT_GT(samples, 0u);
+}
+
+TEST(profiler, runs_one_session_at_a_time)
+{
+	auto dir = std::filesystem::temp_directory_path() / "falco_test_profiler";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+
+	{
+		falco::profiler p(99, seconds(30), dir.string());
+		std::string err;
+		ASSERT_TRUE(p.start(err)) << err;
+		std::this_thread::sleep_for(milliseconds(50));
+
+		std::string folded;
+		EXPECT_FALSE(p.run(seconds(1), folded, err));
+		EXPECT_EQ(err, "a profiling session is already running");
+		EXPECT_FALSE(p.start(err));
+
+		// the background session is interrupted, and written when the
+		// profiler waits for it
+		p.stop();
+	}
+
+	size_t files = 0;
+	for(const auto& e : std::filesystem::directory_iterator(dir))
+	{
+		EXPECT_EQ(e.path().extension(), ".folded");
+		files++;
+	}
+	EXPECT_EQ(files, 1u);
+	std::filesystem::remove_all(dir);
+}
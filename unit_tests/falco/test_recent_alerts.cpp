@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/recent_alerts.h>
+
+#include <vector>
+
+using namespace falco::outputs;
+
+static void add(recent_alerts& store, uint64_t ts, const std::string& rule,
+	falco_common::priority_type priority, const std::string& container_id)
+{
+	message msg;
+	msg.ts = ts;
+	msg.priority = priority;
+	msg.rule = rule;
+	msg.source = "syscall";
+	msg.msg = rule + " fired";
+	if(!container_id.empty())
+	{
+		falco::assign_field_values(msg.fields, std::map<std::string, std::string>{
+			{"container.id", container_id}, {"proc.name", "bash"}});
+	}
+	store.add(msg);
+}
+
+static std::vector<uint64_t> times(const std::vector<recent_alerts::alert>& alerts)
+{
+	std::vector<uint64_t> res;
+	for(const auto& a : alerts)
+	{
+		res.push_back(a.ts);
+	}
+	return res;
+}
+
+class RecentAlerts : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		add(m_store, 10, "shell", falco_common::PRIORITY_NOTICE, "c1");
+		add(m_store, 20, "write", falco_common::PRIORITY_ERROR, "c2");
+		add(m_store, 30, "shell", falco_common::PRIORITY_WARNING, "c2");
+		add(m_store, 40, "net", falco_common::PRIORITY_CRITICAL, "");
+		add(m_store, 50, "shell", falco_common::PRIORITY_NOTICE, "c1");
+	}
+
+	recent_alerts m_store{1024 * 1024};
+	std::vector<recent_alerts::alert> m_alerts;
+};
+
+TEST_F(RecentAlerts, filters)
+{
+	recent_alerts::query q;
+	EXPECT_FALSE(m_store.find(q, m_alerts));
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{50, 40, 30, 20, 10}));
+
+	q.rule = "shell";
+	m_store.find(q, m_alerts);
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{50, 30, 10}));
+
+	q.container_id = "c2";
+	m_store.find(q, m_alerts);
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{30}));
+	EXPECT_EQ(m_alerts[0].output, "shell fired");
+
+	q = {};
+	q.container_id = "c1";
+	m_store.find(q, m_alerts);
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{50, 10}));
+
+	q = {};
+	q.min_priority = falco_common::PRIORITY_WARNING;
+	m_store.find(q, m_alerts);
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{40, 30, 20}));
+
+	q.since = 25;
+	q.until = 40;
+	m_store.find(q, m_alerts);
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{40, 30}));
+
+	q = {};
+	q.rule = "unknown";
+	m_store.find(q, m_alerts);
+	EXPECT_TRUE(m_alerts.empty());
+}
+
+TEST_F(RecentAlerts, limit)
+{
+	recent_alerts::query q;
+	q.limit = 2;
+	EXPECT_TRUE(m_store.find(q, m_alerts));
+	EXPECT_EQ(times(m_alerts), (std::vector<uint64_t>{50, 40}));
+
+	q.rule = "shell";
+	q.limit = 3;
+	EXPECT_FALSE(m_store.find(q, m_alerts));
+	EXPECT_EQ(m_alerts.size(), 3);
+}
+
+TEST(RecentAlertsEviction, oldest_first)
+{
+	// a budget for a few alerts only
+	recent_alerts store(2048);
+	for(uint64_t i = 1; i <= 100; i++)
+	{
+		add(store, i, i % 2 ? "odd" : "even", falco_common::PRIORITY_WARNING, "c" + std::to_string(i % 3));
+	}
+
+	std::map<std::string, uint64_t> metrics;
+	store.get_metrics(metrics);
+	ASSERT_GT(metrics["alerts"], 0);
+	ASSERT_LT(metrics["alerts"], 100);
+	EXPECT_LE(metrics["memory_bytes"], 2048);
+	EXPECT_EQ(metrics["alerts"] + metrics["evicted"], 100);
+
+	// the newest alerts are kept, and the indexes only hold those
+	std::vector<recent_alerts::alert> alerts;
+	store.find({}, alerts);
+	ASSERT_EQ(alerts.size(), metrics["alerts"]);
+	EXPECT_EQ(alerts.front().ts, 100);
+	EXPECT_EQ(alerts.back().ts, 100 - alerts.size() + 1);
+
+	recent_alerts::query q;
+	q.rule = "even";
+	q.container_id = "c1";
+	store.find(q, alerts);
+	for(const auto& a : alerts)
+	{
+		EXPECT_EQ(a.ts % 2, 0);
+		EXPECT_EQ(a.ts % 3, 1);
+	}
+
+	q = {};
+	q.min_priority = falco_common::PRIORITY_WARNING;
+	store.find(q, alerts);
+	EXPECT_EQ(alerts.size(), metrics["alerts"]);
+}
+
+TEST(RecentAlertsOrder, out_of_order)
+{
+	// the alerts of different sources can come slightly out of order
+	recent_alerts store(1024 * 1024);
+	add(store, 100, "a", falco_common::PRIORITY_WARNING, "");
+	add(store, 90, "b", falco_common::PRIORITY_WARNING, "");
+	add(store, 110, "c", falco_common::PRIORITY_WARNING, "");
+
+	recent_alerts::query q;
+	q.since = 95;
+	std::vector<recent_alerts::alert> alerts;
+	store.find(q, alerts);
+	EXPECT_EQ(times(alerts), (std::vector<uint64_t>{110, 100}));
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+#include <falco/source_monitor.h>
+
+using namespace std::chrono;
+
+TEST(source_monitor, notifies_stalls_once)
+{
+	std::vector<std::string> stalled;
+	falco::source_monitor m(milliseconds(10), milliseconds(100),
+		[&stalled](const std::string& src, milliseconds stall, const falco::source_monitor::heartbeat& hb)
+		{
+			stalled.push_back(src + ":" + std::to_string(stall.count()) + ":" + std::to_string(hb.last_evt_ts()));
+		});
+	auto hb = std::make_shared<falco::source_monitor::heartbeat>();
+	m.add("syscall", hb, true);
+
+	// the source isn't monitored before its first heartbeat
+	auto t0 = steady_clock::now();
+	m.check(t0);
+	m.check(t0 + milliseconds(40));
+	hb->beat(10, 1234);
+	m.check(t0 + milliseconds(50));
+	m.check(t0 + milliseconds(150));
+	EXPECT_TRUE(stalled.empty());
+
+	m.check(t0 + milliseconds(151));
+	ASSERT_EQ(stalled.size(), 1);
+	EXPECT_EQ(stalled[0], "syscall:101:1234");
+	m.check(t0 + milliseconds(500));
+	EXPECT_EQ(stalled.size(), 1);
+
+	std::map<std::string, uint64_t> metrics;
+	hb->get_metrics(metrics);
+	EXPECT_EQ(metrics["stall.current_ms"], 450);
+	EXPECT_EQ(metrics["stall.max_ms"], 450);
+	EXPECT_EQ(metrics["stall.stalls"], 1);
+
+	// a new event resets the stall, and the next one is notified again
+	hb->beat(11, 0);
+	m.check(t0 + milliseconds(510));
+	hb->get_metrics(metrics);
+	EXPECT_EQ(metrics["stall.current_ms"], 0);
+	EXPECT_EQ(metrics["stall.max_ms"], 450);
+	m.check(t0 + milliseconds(700));
+	ASSERT_EQ(stalled.size(), 2);
+	EXPECT_EQ(stalled[1], "syscall:190:1234");
+}
+
+TEST(source_monitor, only_notifies_when_requested)
+{
+	int notified = 0;
+	falco::source_monitor m(milliseconds(10), milliseconds(100),
+		[&notified](const std::string&, milliseconds, const falco::source_monitor::heartbeat&) { notified++; });
+	auto hb = std::make_shared<falco::source_monitor::heartbeat>();
+	m.add("plugin", hb, false);
+	hb->beat(0, 0);
+
+	auto t0 = steady_clock::now();
+	m.check(t0);
+	m.check(t0 + milliseconds(200));
+	EXPECT_EQ(notified, 0);
+
+	std::map<std::string, uint64_t> metrics;
+	hb->get_metrics(metrics);
+	EXPECT_EQ(metrics["stall.current_ms"], 200);
+	EXPECT_EQ(metrics["stall.stalls"], 1);
+}
+
+TEST(source_monitor, thread)
+{
+	std::atomic<int> notified{0};
+	falco::source_monitor m(milliseconds(5), milliseconds(20),
+		[&notified](const std::string&, milliseconds, const falco::source_monitor::heartbeat&) { notified++; });
+	auto hb = std::make_shared<falco::source_monitor::heartbeat>();
+	m.add("syscall", hb, true);
+	hb->beat(1, 0);
+	m.start();
+	for(int i = 0; i < 200 && notified.load() == 0; i++)
+	{
+		std::this_thread::sleep_for(milliseconds(5));
+	}
+	m.stop();
+	EXPECT_EQ(notified.load(), 1);
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/startup_report.h>
+
+using namespace std::chrono_literals;
+
+TEST(startup_report, ready)
+{
+	falco::startup_report r;
+	ASSERT_FALSE(r.ready());
+
+	// the events processed before all the sources are open count
+	r.expect_sources(2);
+	r.source_opened("syscall", 20ms);
+	r.event_processed();
+	ASSERT_FALSE(r.ready());
+	r.source_opened("k8saudit", 5ms);
+	ASSERT_TRUE(r.ready());
+
+	falco::startup_report r2;
+	r2.expect_sources(1);
+	r2.source_opened("syscall", 1ms);
+	ASSERT_FALSE(r2.ready());
+	r2.event_processed();
+	ASSERT_TRUE(r2.ready());
+}
+
+TEST(startup_report, report)
+{
+	falco::startup_report r;
+	auto j = r.as_json();
+	ASSERT_EQ(j["ready"], false);
+	ASSERT_TRUE(j["steps"].empty());
+	ASSERT_FALSE(j.contains("startup_ms"));
+	ASSERT_FALSE(j.contains("first_event_ms"));
+
+	r.add_step("load_config", 3ms);
+	r.add_step("load_rules_files", 1500ms);
+	r.set_started(1510ms);
+	r.expect_sources(1);
+	r.source_opened("syscall", 250ms);
+	r.event_processed();
+
+	j = r.as_json();
+	ASSERT_EQ(j["ready"], true);
+	ASSERT_EQ(j["steps"].size(), 2u);
+	ASSERT_EQ(j["steps"][1]["name"], "load_rules_files");
+	ASSERT_EQ(j["steps"][1]["duration_ms"], 1500u);
+	ASSERT_EQ(j["startup_ms"], 1510u);
+	ASSERT_EQ(j["sources"][0]["name"], "syscall");
+	ASSERT_EQ(j["sources"][0]["open_ms"], 250u);
+	ASSERT_TRUE(j.contains("first_event_ms"));
+	ASSERT_TRUE(j.contains("ready_ms"));
+
+	std::map<std::string, uint64_t> metrics;
+	r.get_metrics(metrics);
+	ASSERT_EQ(metrics["startup_step_ms.load_config"], 3u);
+	ASSERT_EQ(metrics["startup_ms"], 1510u);
+	ASSERT_EQ(metrics["startup_source_open_ms.syscall"], 250u);
+	ASSERT_EQ(metrics.count("startup_first_event_ms"), 1u);
+	ASSERT_EQ(metrics.count("startup_ready_ms"), 1u);
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/syscall_cost.h>
+
+TEST(syscall_cost, attribution)
+{
+	// type 1 is needed by both rules, type 2 by "b" only, and types 0
+	// and 3 by none of them
+	falco::syscall_cost sc({{"a", {1}}, {"b", {1, 2, 2, 100}}}, 4);
+	for(int i = 0; i < 10; i++)
+	{
+		sc.count(1);
+	}
+	for(int i = 0; i < 5; i++)
+	{
+		sc.count(2);
+	}
+	sc.count(0);
+	sc.count(3);
+	sc.count(1000);
+
+	auto costs = sc.get_costs();
+	ASSERT_EQ(costs.size(), 2);
+	EXPECT_EQ(costs[0].rule, "a");
+	EXPECT_EQ(costs[0].evt_types, 1);
+	EXPECT_EQ(costs[0].events, 10);
+	EXPECT_EQ(costs[0].attributed_events, 5);
+	EXPECT_EQ(costs[0].exclusive_events, 0);
+
+	// the duplicate and out of range types are ignored
+	EXPECT_EQ(costs[1].rule, "b");
+	EXPECT_EQ(costs[1].evt_types, 2);
+	EXPECT_EQ(costs[1].events, 15);
+	EXPECT_EQ(costs[1].attributed_events, 10);
+	EXPECT_EQ(costs[1].exclusive_events, 5);
+
+	EXPECT_EQ(sc.state_events(), 2);
+}
+
+TEST(syscall_cost, no_rules)
+{
+	falco::syscall_cost sc({}, 2);
+	sc.count(0);
+	sc.count(1);
+	EXPECT_TRUE(sc.get_costs().empty());
+	EXPECT_EQ(sc.state_events(), 2);
+}
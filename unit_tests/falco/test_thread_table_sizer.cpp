@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/thread_table_sizer.h>
+
+using namespace std::chrono;
+
+static falco::thread_table_sizer::config autosize_config()
+{
+	falco::thread_table_sizer::config c;
+	c.m_autosize = true;
+	c.m_min_size = 100;
+	c.m_max_size = 10000;
+	c.m_headroom = 2;
+	c.m_interval = seconds(10);
+	return c;
+}
+
+TEST(thread_table_sizer, fixed_size)
+{
+	falco::thread_table_sizer::config c;
+	c.m_size = 5000;
+	falco::thread_table_sizer t(c);
+	EXPECT_EQ(t.start(100), 5000u);
+
+	falco::thread_table_sizer::counters counters;
+	counters.threads = 4999;
+	counters.full_drops = 10;
+	EXPECT_EQ(t.update(steady_clock::now(), counters), 0u);
+	EXPECT_EQ(t.update(steady_clock::now() + hours(1), counters), 0u);
+	EXPECT_EQ(t.size(), 5000u);
+
+	std::map<std::string, uint64_t> metrics;
+	t.get_metrics(metrics);
+	EXPECT_EQ(metrics["thread_table.max_threads"], 5000u);
+	EXPECT_EQ(metrics["thread_table.threads"], 4999u);
+	EXPECT_EQ(metrics["thread_table.full_drops"], 10u);
+	EXPECT_EQ(metrics["thread_table.resizes"], 0u);
+}
+
+TEST(thread_table_sizer, starts_from_host_threads)
+{
+	falco::thread_table_sizer t(autosize_config());
+	EXPECT_EQ(t.start(500), 1000u);
+	EXPECT_EQ(t.start(1), 100u);
+	EXPECT_EQ(t.start(1000000), 10000u);
+}
+
+TEST(thread_table_sizer, grows_and_shrinks)
+{
+	falco::thread_table_sizer t(autosize_config());
+	ASSERT_EQ(t.start(500), 1000u);
+
+	// the first update starts the first interval
+	auto now = steady_clock::now();
+	falco::thread_table_sizer::counters c;
+	c.threads = 950;
+	EXPECT_EQ(t.update(now, c), 0u);
+	EXPECT_EQ(t.update(now + seconds(5), c), 0u);
+
+	// almost full
+	now += seconds(10);
+	EXPECT_EQ(t.update(now, c), 2000u);
+
+	// threads not added as the table was full, even if not full anymore
+	now += seconds(10);
+	c.threads = 1000;
+	c.full_drops = 3;
+	EXPECT_EQ(t.update(now, c), 4000u);
+	now += seconds(10);
+	c.full_drops = 4;
+	EXPECT_EQ(t.update(now, c), 8000u);
+
+	// capped by the memory budget
+	now += seconds(10);
+	c.full_drops = 5;
+	EXPECT_EQ(t.update(now, c), 10000u);
+	now += seconds(10);
+	c.full_drops = 6;
+	EXPECT_EQ(t.update(now, c), 0u);
+
+	// mostly empty
+	now += seconds(10);
+	c.threads = 200;
+	EXPECT_EQ(t.update(now, c), 400u);
+	now += seconds(10);
+	EXPECT_EQ(t.update(now, c), 0u);
+	EXPECT_EQ(t.size(), 400u);
+
+	std::map<std::string, uint64_t> metrics;
+	t.get_metrics(metrics);
+	EXPECT_EQ(metrics["thread_table.resizes"], 5u);
+	EXPECT_EQ(metrics["thread_table.full_drops"], 6u);
+}
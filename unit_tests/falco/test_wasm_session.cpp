@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <falco/wasm_session.h>
+
+#include <unistd.h>
+
+static std::string capture_path()
+{
+	return "/tmp/falco_test_wasm_session_" + std::to_string(getpid()) + ".scap";
+}
+
+TEST(wasm_session, load_rules)
+{
+	falco::wasm_session session(capture_path());
+	std::string err;
+	EXPECT_TRUE(session.load_rules(R"END(
+- rule: open_file
+  desc: a file is opened
+  condition: evt.type = open
+  output: "opened %fd.name"
+  priority: WARNING
+)END", "rules.yaml", err)) << err;
+	EXPECT_FALSE(session.load_rules("- rule: broken\n  condition: evt.type = open\n", "rules.yaml", err));
+	EXPECT_FALSE(err.empty());
+}
+
+TEST(wasm_session, invalid_capture)
+{
+	falco::wasm_session session(capture_path());
+	std::string out, err;
+	const uint8_t garbage[] = {1, 2, 3, 4, 5, 6, 7, 8};
+	EXPECT_FALSE(session.evaluate(garbage, sizeof(garbage), out, err));
+	EXPECT_FALSE(err.empty());
+	EXPECT_TRUE(out.empty());
+
+	// the session can still be used afterwards
+	err.clear();
+	EXPECT_FALSE(session.evaluate(garbage, sizeof(garbage), out, err));
+	EXPECT_FALSE(err.empty());
+}
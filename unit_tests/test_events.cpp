@@ -0,0 +1,112 @@
+#include "test_events.h"
+
+#include <libscap/scap.h>
+
+#include <stdexcept>
+
+#include <arpa/inet.h>
+
+test_events::test_events(sinsp& inspector): m_inspector(inspector)
+{
+}
+
+int64_t test_events::add_process(const std::string& comm)
+{
+	int64_t tid = 1000 + m_processes.size();
+	auto tinfo = m_inspector.build_threadinfo();
+	tinfo->m_tid = tid;
+	tinfo->m_pid = tid;
+	tinfo->m_ptid = 1;
+	tinfo->m_comm = comm;
+	tinfo->m_exe = "/usr/bin/" + comm;
+	tinfo->m_exepath = tinfo->m_exe;
+
+	process p;
+	p.tinfo = tinfo.get();
+	m_inspector.m_thread_manager->add_thread(std::move(tinfo), false);
+	m_processes[tid] = p;
+	return tid;
+}
+
+sinsp_evt* test_events::open(int64_t tid, const std::string& path)
+{
+	auto& p = m_processes.at(tid);
+	int64_t fd = p.next_fd++;
+	auto fdinfo = m_inspector.build_fdinfo();
+	fdinfo->m_type = SCAP_FD_FILE_V2;
+	fdinfo->m_name = path;
+	fdinfo->m_openflags = PPM_O_RDONLY;
+	p.tinfo->add_fd(fd, std::move(fdinfo));
+	return add_event(p, fd, PPME_SYSCALL_OPENAT_2_X,
+		fd, // fd
+		(int64_t) PPM_AT_FDCWD, // dirfd
+		path.c_str(), // name
+		(uint32_t) PPM_O_RDONLY, // flags
+		(uint32_t) 0644, // mode
+		(uint32_t) 2049, // dev
+		(uint64_t) (1000 + fd)); // ino
+}
+
+sinsp_evt* test_events::close(int64_t tid)
+{
+	return add_event(m_processes.at(tid), -1, PPME_SYSCALL_CLOSE_X,
+		(int64_t) 0); // res
+}
+
+sinsp_evt* test_events::send(int64_t tid, const std::string& cip, uint16_t cport,
+	const std::string& sip, uint16_t sport)
+{
+	auto& p = m_processes.at(tid);
+	int64_t fd = p.next_fd++;
+	auto fdinfo = m_inspector.build_fdinfo();
+	fdinfo->m_type = SCAP_FD_IPV4_SOCK;
+	fdinfo->set_role_client();
+	auto& fields = fdinfo->m_sockinfo.m_ipv4info.m_fields;
+	inet_pton(AF_INET, cip.c_str(), &fields.m_sip);
+	fields.m_sport = cport;
+	inet_pton(AF_INET, sip.c_str(), &fields.m_dip);
+	fields.m_dport = sport;
+	fields.m_l4proto = SCAP_L4_TCP;
+	fdinfo->m_name = cip + ":" + std::to_string(cport) + "->" + sip + ":" + std::to_string(sport);
+	p.tinfo->add_fd(fd, std::move(fdinfo));
+	return add_event(p, fd, PPME_SYSCALL_WRITE_X,
+		(int64_t) 4, // res
+		scap_const_sized_buffer{"ping", 4}); // data
+}
+
+sinsp_evt* test_events::async(int64_t tid, const std::string& name)
+{
+	return add_event(m_processes.at(tid), -1, PPME_ASYNCEVENT_E,
+		(uint32_t) 0, // plugin_id
+		name.c_str(), // name
+		scap_const_sized_buffer{nullptr, 0}); // data
+}
+
+template<typename... Args>
+sinsp_evt* test_events::add_event(process& p, int64_t fd, ppm_event_code type, Args... args)
+{
+	char err[SCAP_LASTERR_SIZE];
+	size_t size = 0;
+	// the first call only computes the size of the event
+	scap_event_encode_params(scap_sized_buffer{nullptr, 0}, &size, err, type, sizeof...(args), args...);
+
+	auto& e = m_events.emplace_back();
+	e.data.resize(size);
+	if(scap_event_encode_params(scap_sized_buffer{e.data.data(), size}, &size, err, type, sizeof...(args), args...) != SCAP_SUCCESS)
+	{
+		throw std::runtime_error(std::string("could not build an event: ") + err);
+	}
+	auto hdr = reinterpret_cast<scap_evt*>(e.data.data());
+	hdr->tid = p.tinfo->m_tid;
+	hdr->ts = 1000 * m_events.size();
+
+	e.evt = std::make_unique<sinsp_evt>(&m_inspector);
+	e.evt->init(e.data.data(), 0);
+	e.evt->set_num(m_events.size());
+	e.evt->set_tinfo(p.tinfo);
+	if(fd >= 0)
+	{
+		e.evt->set_fd_info(p.tinfo->get_fd(fd));
+	}
+	return e.evt.get();
+}
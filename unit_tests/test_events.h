@@ -0,0 +1,59 @@
+#pragma once
+
+#include <libsinsp/sinsp.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Builds syscall events for the tests that need to evaluate rules. The
+// processes are added to the thread table of the inspector, along with the
+// files they open, and their events refer to them as if they were parsed
+// by the inspector. The events stay valid as long as this object, and are
+// numbered and timestamped in the order they are built.
+class test_events
+{
+public:
+	explicit test_events(sinsp& inspector);
+
+	// Adds a process with the given name, and returns its tid
+	int64_t add_process(const std::string& comm);
+
+	// Returns an openat exit event of the given process, opening the
+	// given path as a new file descriptor
+	sinsp_evt* open(int64_t tid, const std::string& path);
+
+	// Returns a close exit event of the given process
+	sinsp_evt* close(int64_t tid);
+
+	// Returns a write exit event of the given process, on a new TCP
+	// socket connected from the given IPv4 client address and port to
+	// the given server address and port
+	sinsp_evt* send(int64_t tid, const std::string& cip, uint16_t cport,
+		const std::string& sip, uint16_t sport);
+
+	// Returns an async event with the given name, about the given process
+	sinsp_evt* async(int64_t tid, const std::string& name);
+
+private:
+	struct event
+	{
+		std::vector<uint8_t> data;
+		std::unique_ptr<sinsp_evt> evt;
+	};
+
+	struct process
+	{
+		sinsp_threadinfo* tinfo;
+		int64_t next_fd = 3;
+	};
+
+	template<typename... Args>
+	sinsp_evt* add_event(process& p, int64_t fd, ppm_event_code type, Args... args);
+
+	sinsp& m_inspector;
+	std::unordered_map<int64_t, process> m_processes;
+	std::deque<event> m_events;
+};
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "alloc_tracker.h"
+
+#ifdef FALCO_ALLOC_TRACKING
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#endif
+
+namespace falco::alloc_tracker
+{
+
+const char* name(subsystem s)
+{
+	switch(s)
+	{
+	case ENGINE:
+		return "engine";
+	case FORMATS:
+		return "formats";
+	case OUTPUTS:
+		return "outputs";
+	case STATS:
+		return "stats";
+	default:
+		return "other";
+	}
+}
+
+#ifdef FALCO_ALLOC_TRACKING
+
+// each subsystem has its own cache line, as they are usually updated
+// by different threads
+struct alignas(64) counters
+{
+	std::atomic<uint64_t> num{0};
+	std::atomic<uint64_t> bytes{0};
+};
+
+static counters s_counters[NUM_SUBSYSTEMS];
+static std::atomic<int64_t> s_live_bytes{0};
+static std::atomic<int64_t> s_peak_bytes{0};
+static thread_local subsystem s_current = OTHER;
+
+subsystem current()
+{
+	return s_current;
+}
+
+void set_current(subsystem s)
+{
+	s_current = s;
+}
+
+static inline void on_alloc(void* p)
+{
+	int64_t size = malloc_usable_size(p);
+	auto& c = s_counters[s_current];
+	c.num.fetch_add(1, std::memory_order_relaxed);
+	c.bytes.fetch_add(size, std::memory_order_relaxed);
+	auto live = s_live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+	auto peak = s_peak_bytes.load(std::memory_order_relaxed);
+	while(live > peak && !s_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+}
+
+static inline void on_free(void* p)
+{
+	if(p != nullptr)
+	{
+		s_live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+	}
+}
+
+uint64_t num_allocs(subsystem s)
+{
+	return s_counters[s].num.load(std::memory_order_relaxed);
+}
+
+uint64_t allocated_bytes(subsystem s)
+{
+	return s_counters[s].bytes.load(std::memory_order_relaxed);
+}
+
+int64_t live_bytes()
+{
+	return s_live_bytes.load(std::memory_order_relaxed);
+}
+
+int64_t peak_bytes()
+{
+	return s_peak_bytes.load(std::memory_order_relaxed);
+}
+
+void reset_peak()
+{
+	s_peak_bytes.store(s_live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t num_allocs(subsystem)
+{
+	return 0;
+}
+
+uint64_t allocated_bytes(subsystem)
+{
+	return 0;
+}
+
+int64_t live_bytes()
+{
+	return 0;
+}
+
+int64_t peak_bytes()
+{
+	return 0;
+}
+
+void reset_peak()
+{
+}
+
+#endif
+
+void get_metrics(std::map<std::string, uint64_t>& metrics)
+{
+	for(int s = OTHER; s < NUM_SUBSYSTEMS; s++)
+	{
+		std::string prefix = name(subsystem(s));
+		metrics[prefix + ".num"] = num_allocs(subsystem(s));
+		metrics[prefix + ".bytes"] = allocated_bytes(subsystem(s));
+	}
+}
+
+} // namespace falco::alloc_tracker
+
+#ifdef FALCO_ALLOC_TRACKING
+
+static inline void* tracked_alloc(std::size_t n)
+{
+	void* p = std::malloc(n == 0 ? 1 : n);
+	if(p != nullptr)
+	{
+		falco::alloc_tracker::on_alloc(p);
+	}
+	return p;
+}
+
+void* operator new(std::size_t n)
+{
+	void* p = tracked_alloc(n);
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t n)
+{
+	return operator new(n);
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+	return tracked_alloc(n);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept
+{
+	return tracked_alloc(n);
+}
+
+void operator delete(void* p) noexcept
+{
+	falco::alloc_tracker::on_free(p);
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+#endif
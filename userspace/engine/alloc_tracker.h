@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Counts the heap allocations of the event hot path by subsystem, in the
+// builds with the FALCO_ALLOC_TRACKING option, which replace the global
+// operator new and delete with counting ones. The allocations are
+// attributed to the subsystem of the innermost scope open in the
+// allocating thread. In the other builds, scopes cost nothing and there
+// are no counts.
+namespace falco::alloc_tracker
+{
+
+enum subsystem
+{
+	OTHER = 0,
+	ENGINE,
+	FORMATS,
+	OUTPUTS,
+	STATS,
+	NUM_SUBSYSTEMS,
+};
+
+/*!
+	\brief Returns whether the allocations are counted in this build
+*/
+constexpr bool enabled()
+{
+#ifdef FALCO_ALLOC_TRACKING
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef FALCO_ALLOC_TRACKING
+subsystem current();
+void set_current(subsystem s);
+#endif
+
+/*!
+	\brief Attributes the allocations of the current thread to a
+	subsystem until it's destroyed
+*/
+class scope
+{
+public:
+#ifdef FALCO_ALLOC_TRACKING
+	explicit scope(subsystem s): m_prev(current())
+	{
+		set_current(s);
+	}
+
+	~scope()
+	{
+		set_current(m_prev);
+	}
+#else
+	explicit scope(subsystem) {}
+#endif
+
+	scope(const scope&) = delete;
+	scope& operator = (const scope&) = delete;
+
+#ifdef FALCO_ALLOC_TRACKING
+private:
+	subsystem m_prev;
+#endif
+};
+
+/*!
+	\brief Returns the name of a subsystem, e.g. "engine"
+*/
+const char* name(subsystem s);
+
+/*!
+	\brief Returns the number of allocations of a subsystem since Falco
+	started, which is always 0 in the builds that don't count them
+*/
+uint64_t num_allocs(subsystem s);
+
+/*!
+	\brief Returns the bytes allocated by a subsystem since Falco started
+*/
+uint64_t allocated_bytes(subsystem s);
+
+/*!
+	\brief Returns the bytes currently allocated by all the subsystems
+*/
+int64_t live_bytes();
+
+/*!
+	\brief Returns the most bytes allocated at once since the last reset
+*/
+int64_t peak_bytes();
+
+/*!
+	\brief Restarts measuring the peak from the current allocations
+*/
+void reset_peak();
+
+/*!
+	\brief Adds the allocations and the bytes allocated by each subsystem
+	to the given map, as <subsystem>.num and <subsystem>.bytes
+*/
+void get_metrics(std::map<std::string, uint64_t>& metrics);
+
+} // namespace falco::alloc_tracker
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+
+// Tracks the rule whose condition each thread is evaluating, so that a
+// sampling profiler can attribute its samples to the rules. This is off
+// by default and costs a relaxed load per event then, and when on, two
+// stores per evaluated rule.
+namespace falco::current_rule
+{
+
+extern std::atomic<bool> g_tracking;
+extern thread_local const char* t_name;
+
+/*!
+	\brief Starts or stops tracking the rules being evaluated
+*/
+void set_tracking(bool enabled);
+
+inline bool tracking()
+{
+	return g_tracking.load(std::memory_order_relaxed);
+}
+
+/*!
+	\brief Sets the name of the rule evaluated by the current thread, or
+	nullptr if none, which must stay valid for the lifetime of the process,
+	as the interned rule names do
+*/
+inline void set(const char* name)
+{
+	t_name = name;
+}
+
+/*!
+	\brief Returns the name of the rule evaluated by the current thread, or
+	nullptr if none, which is safe to invoke from a signal handler
+*/
+inline const char* get()
+{
+	return t_name;
+}
+
+} // namespace falco::current_rule
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "embedded_engine.h"
+#include "falco_engine.h"
+#include "falco_engine_version.h"
+
+#include <unordered_map>
+
+using namespace falco;
+
+// The state of a source, which is only used by the thread evaluating its
+// events, so that different sources can be evaluated concurrently
+struct source_state
+{
+	std::shared_ptr<sinsp_evt_formatter_factory> formatter_factory;
+	// the matches of the last batch, reused across batches
+	std::vector<falco_engine::rule_match> matches;
+	// the formatters of the outputs with no formatter compiled by the
+	// engine, by output
+	std::unordered_map<std::string, std::shared_ptr<sinsp_evt_formatter>> formatters;
+};
+
+struct embedded_engine::impl
+{
+	falco_engine engine;
+	std::vector<source_state> sources;
+};
+
+embedded_engine::embedded_engine(): m_impl(std::make_unique<impl>())
+{
+}
+
+embedded_engine::~embedded_engine() = default;
+
+std::string embedded_engine::engine_version()
+{
+	return FALCO_ENGINE_VERSION;
+}
+
+size_t embedded_engine::add_source(const std::string& name,
+	std::shared_ptr<sinsp_filter_factory> filter_factory,
+	std::shared_ptr<sinsp_evt_formatter_factory> formatter_factory)
+{
+	auto idx = m_impl->engine.add_source(name, filter_factory, formatter_factory);
+	m_impl->sources.resize(std::max(m_impl->sources.size(), idx + 1));
+	m_impl->sources[idx].formatter_factory = formatter_factory;
+	return idx;
+}
+
+bool embedded_engine::load_rules(const std::string& content, const std::string& name,
+	std::string& err, std::string& warnings)
+{
+	err.clear();
+	warnings.clear();
+	falco::load_result::rules_contents_t rc = {{name, content}};
+	auto res = m_impl->engine.load_rules(content, name);
+	if(!res->successful())
+	{
+		err = res->as_string(true, rc);
+		return false;
+	}
+	if(res->has_warnings())
+	{
+		warnings = res->as_string(true, rc);
+	}
+
+	// the formatters of the rule outputs are compiled once loaded
+	m_impl->engine.complete_rule_loading();
+	return true;
+}
+
+void embedded_engine::enable_rules(const std::string& pattern, bool enabled)
+{
+	m_impl->engine.enable_rule_wildcard(pattern, enabled);
+}
+
+size_t embedded_engine::evaluate(size_t source, sinsp_evt* const* evts, size_t num_evts,
+	std::vector<match>& matches)
+{
+	if(source >= m_impl->sources.size())
+	{
+		return 0;
+	}
+	auto& state = m_impl->sources[source];
+	auto& found = state.matches;
+	if(!m_impl->engine.process_events(source, evts, num_evts, falco_common::rule_matching::ALL, found))
+	{
+		return 0;
+	}
+
+	// the matches are ordered by event, as the events of the batch
+	size_t event = 0;
+	for(const auto& f : found)
+	{
+		while(evts[event] != f.evt)
+		{
+			event++;
+		}
+		match m;
+		m.event = event;
+		m.rule = f.rule->name.get();
+		m.source = f.rule->source.get();
+		m.priority = f.rule->priority;
+		m.tags = f.rule->tags.get();
+		auto formatter = m_impl->engine.get_rule_formatter(f.rule->id);
+		if(formatter == nullptr)
+		{
+			auto& cached = state.formatters[f.rule->output.get()];
+			if(cached == nullptr)
+			{
+				cached = state.formatter_factory->create_formatter(f.rule->output.get());
+			}
+			formatter = cached;
+		}
+		formatter->tostring(f.evt, m.output);
+		matches.push_back(std::move(m));
+	}
+	return found.size();
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "falco_common.h"
+
+#include <libsinsp/event.h>
+#include <libsinsp/filter.h>
+#include <libsinsp/eventformatter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief A stable interface to evaluate Falco rules from other programs,
+	on top of falco_engine, whose interface changes along with Falco. Only
+	the types of this header, of falco_common.h, and of libsinsp are part
+	of it, and its version is api_version, which only changes along with
+	breaking changes.
+
+	Ownership: the engine shares the ownership of the filter and formatter
+	factories of its sources. The events are owned by the caller, and must
+	stay valid, along with the state of the inspector that produced them,
+	until evaluate() returns. The matches are copies, which don't refer to
+	the engine nor to the events.
+
+	Threading: the sources are added and the rules are loaded from a single
+	thread while no events are being evaluated. Then, each source can be
+	evaluated by a single thread at a time, and different sources can be
+	evaluated concurrently. The rules can be enabled and disabled from a
+	single thread while events are being evaluated.
+*/
+class embedded_engine
+{
+public:
+	static constexpr uint32_t api_version = 1;
+
+	/*!
+		\brief A rule matching one of the events of a batch
+	*/
+	struct match
+	{
+		// the index of the event in the batch
+		size_t event = 0;
+		std::string rule;
+		std::string source;
+		falco_common::priority_type priority = falco_common::PRIORITY_DEBUG;
+		std::set<std::string> tags;
+		// the output of the rule, formatted for the event
+		std::string output;
+	};
+
+	embedded_engine();
+	~embedded_engine();
+
+	embedded_engine(const embedded_engine&) = delete;
+	embedded_engine& operator = (const embedded_engine&) = delete;
+
+	/*!
+		\brief Returns the version of the engine, which tells the rules
+		it can load along with their required_engine_version
+	*/
+	static std::string engine_version();
+
+	/*!
+		\brief Adds an event source, whose events are evaluated with the
+		fields of the given factories, and returns its index. The sources
+		must be added before loading the rules.
+	*/
+	size_t add_source(const std::string& name,
+		std::shared_ptr<sinsp_filter_factory> filter_factory,
+		std::shared_ptr<sinsp_evt_formatter_factory> formatter_factory);
+
+	/*!
+		\brief Loads the rules of the given YAML content on top of the
+		ones already loaded, with name identifying the content in the
+		messages. Returns false and sets err to the errors if the rules
+		can't be loaded. The warnings, if any, are set in warnings.
+		The rules are enabled or not as defined in the content.
+	*/
+	bool load_rules(const std::string& content, const std::string& name,
+		std::string& err, std::string& warnings);
+
+	/*!
+		\brief Enables or disables the rules whose names match the given
+		pattern, which can contain '*' wildcards
+	*/
+	void enable_rules(const std::string& pattern, bool enabled);
+
+	/*!
+		\brief Evaluates a batch of events of the source with the given
+		index, and appends the matching rules to matches, ordered by
+		event. Each event matches all the enabled rules it satisfies.
+		Returns the number of matches appended.
+	*/
+	size_t evaluate(size_t source, sinsp_evt* const* evts, size_t num_evts,
+		std::vector<match>& matches);
+
+private:
+	struct impl;
+	std::unique_ptr<impl> m_impl;
+};
+
+} // namespace falco
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace falco
+{
+
+/*!
+	\brief Decides which events to keep when only a ratio of them is
+	evaluated. The decisions are deterministic: the n-th decision of a
+	sequence only depends on the seed and on n, which are mixed with the
+	splitmix64 finalizer, so that replaying the same events with the same
+	seed samples the same ones. Each caller keeps the counter of its own
+	sequence, e.g. one per event source, so that the sampler itself is
+	never written while evaluating events.
+*/
+class event_sampler
+{
+public:
+	/*!
+		\brief Sets the ratio of the events to keep, where any value of
+		1 or more keeps all of them
+	*/
+	inline void set_keep_ratio(double ratio)
+	{
+		m_enabled = ratio < 1;
+		m_threshold = ratio <= 0 ? 0 : (uint64_t) (ratio * 18446744073709551616.0);
+	}
+
+	inline void set_seed(uint64_t seed)
+	{
+		m_seed = seed;
+	}
+
+	/*!
+		\brief Returns false if all the events are kept
+	*/
+	inline bool enabled() const
+	{
+		return m_enabled;
+	}
+
+	/*!
+		\brief Returns true if the next event of the sequence of the given
+		counter is kept, and advances the counter
+	*/
+	inline bool keep(uint64_t& counter) const
+	{
+		return !m_enabled || mix(m_seed + ++counter) < m_threshold;
+	}
+
+private:
+	static inline uint64_t mix(uint64_t x)
+	{
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+
+	bool m_enabled = false;
+	uint64_t m_threshold = 0;
+	uint64_t m_seed = 0;
+};
+
+} // namespace falco
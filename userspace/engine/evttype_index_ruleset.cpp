@@ -18,12 +18,121 @@ limitations under the License.
 #include "evttype_index_ruleset.h"
 
 #include "logger.h"
+#include "rule_loader_compiler.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+void evttype_index_ruleset::resolve_proc_name_prefilter(evttype_index_wrapper& wrap, const libsinsp::filter::ast::expr* condition)
+{
+	using namespace libsinsp::filter;
+
+	std::vector<const ast::expr*> conjuncts;
+	shared_filter_predicates::conjuncts(condition, conjuncts);
+	for(const auto* c : conjuncts)
+	{
+		auto check = dynamic_cast<const ast::binary_check_expr*>(c);
+		if(!check)
+		{
+			continue;
+		}
+		auto field = dynamic_cast<const ast::field_expr*>(check->left.get());
+		if(!field || field->field != "proc.name" || !field->arg.empty())
+		{
+			continue;
+		}
+
+		auto value = dynamic_cast<const ast::value_expr*>(check->right.get());
+		auto list = dynamic_cast<const ast::list_expr*>(check->right.get());
+		if(check->op == "=" && value)
+		{
+			wrap.m_proc_names.insert(value->value);
+		}
+		else if(check->op == "in" && list)
+		{
+			wrap.m_proc_names.insert(list->values.begin(), list->values.end());
+		}
+		else if(check->op == "startswith" && value)
+		{
+			wrap.m_proc_name_prefixes.push_back(value->value);
+		}
+		else
+		{
+			continue;
+		}
+
+		// one constraint is enough to skip the rule
+		wrap.m_proc_name_prefilter = true;
+		return;
+	}
+}
+
+bool evttype_index_ruleset::resolve_async_event_names(const libsinsp::filter::ast::expr* condition, std::set<std::string>& names)
+{
+	using namespace libsinsp::filter;
+
+	if(auto or_expr = dynamic_cast<const ast::or_expr*>(condition))
+	{
+		// all the alternatives must be constrained
+		std::set<std::string> res;
+		for(const auto& c : or_expr->children)
+		{
+			if(!resolve_async_event_names(c.get(), res))
+			{
+				return false;
+			}
+		}
+		names.insert(res.begin(), res.end());
+		return true;
+	}
+
+	if(dynamic_cast<const ast::and_expr*>(condition))
+	{
+		// one constrained conjunct is enough
+		std::vector<const ast::expr*> conjuncts;
+		shared_filter_predicates::conjuncts(condition, conjuncts);
+		for(const auto* c : conjuncts)
+		{
+			if(resolve_async_event_names(c, names))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	auto check = dynamic_cast<const ast::binary_check_expr*>(condition);
+	if(!check)
+	{
+		return false;
+	}
+	auto field = dynamic_cast<const ast::field_expr*>(check->left.get());
+	if(!field || (field->field != "evt.type" && field->field != "evt.asynctype") || !field->arg.empty())
+	{
+		return false;
+	}
+
+	auto value = dynamic_cast<const ast::value_expr*>(check->right.get());
+	auto list = dynamic_cast<const ast::list_expr*>(check->right.get());
+	if(check->op == "=" && value)
+	{
+		names.insert(value->value);
+		return true;
+	}
+	if(check->op == "in" && list && !list->values.empty())
+	{
+		names.insert(list->values.begin(), list->values.end());
+		return true;
+	}
+	return false;
+}
 
 evttype_index_ruleset::evttype_index_ruleset(
 	std::shared_ptr<sinsp_filter_factory> f):
-	m_filter_factory(f)
+	m_filter_factory(f),
+	m_predicates(f)
 {
 }
 
@@ -41,6 +150,14 @@ void evttype_index_ruleset::add(
 		auto wrap = std::make_shared<evttype_index_wrapper>();
 		wrap->m_rule = rule;
 		wrap->m_filter = filter;
+		wrap->m_condition = condition;
+		// the exceptions are only split from the filter of the rule
+		if(rule.exceptions && filter && filter == rule.filter)
+		{
+			wrap->m_exceptions = rule.exceptions;
+			wrap->m_filter = rule.exceptions->filter();
+			wrap->m_condition = rule.exceptions->condition();
+		}
 		if(rule.source == falco_common::syscall_source)
 		{
 			wrap->m_sc_codes = libsinsp::filter::ast::ppm_sc_codes(condition.get());
@@ -52,6 +169,19 @@ void evttype_index_ruleset::add(
 			wrap->m_event_codes = {ppm_event_code::PPME_PLUGINEVENT_E};
 		}
 		wrap->m_event_codes.insert(ppm_event_code::PPME_ASYNCEVENT_E);
+		if(condition)
+		{
+			resolve_async_event_names(condition.get(), wrap->m_async_event_names);
+		}
+		if(condition && rule.source != falco_common::syscall_source)
+		{
+			resolve_plugin_event_field(*wrap, condition.get());
+		}
+		if(condition && rule.source == falco_common::syscall_source)
+		{
+			resolve_proc_name_prefilter(*wrap, condition.get());
+			resolve_network_prefilters(*wrap, condition.get());
+		}
 
 		add_wrapper(wrap);
 	}
@@ -61,51 +191,508 @@ void evttype_index_ruleset::add(
 	}
 }
 
+void evttype_index_ruleset::prepare_filter(evttype_index_wrapper &wrap)
+{
+	if(wrap.m_filter || !wrap.m_condition)
+	{
+		return;
+	}
+
+	// the condition of a rule compiled lazily is validated when loaded,
+	// so this is not expected to fail
+	std::shared_ptr<sinsp_filter> filter;
+	std::shared_ptr<rule_exceptions> exceptions;
+	try
+	{
+		if(!m_lazy_filter_factory)
+		{
+			auto& new_filter_factory = get_engine_state().new_filter_factory;
+			if(new_filter_factory)
+			{
+				m_lazy_filter_factory = new_filter_factory(wrap.m_rule.source);
+			}
+			if(!m_lazy_filter_factory)
+			{
+				m_lazy_filter_factory = m_filter_factory;
+			}
+		}
+		rule_loader::compiler::compile_evaluation_filter(m_lazy_filter_factory,
+			wrap.m_condition, wrap.m_rule.num_exceptions, filter, exceptions);
+	}
+	catch (const sinsp_exception& e)
+	{
+		throw falco_exception("Can't compile rule " + wrap.m_rule.name + ": " + e.what());
+	}
+
+	if(exceptions)
+	{
+		wrap.m_exceptions = exceptions;
+		wrap.m_filter = exceptions->filter();
+		wrap.m_condition = exceptions->condition();
+	}
+	else
+	{
+		wrap.m_filter = filter;
+	}
+}
+
+void evttype_index_ruleset::clear()
+{
+	indexable_ruleset<evttype_index_wrapper>::clear();
+	m_predicates.clear();
+	m_plugin_event_checks.clear();
+	m_network_fields.clear();
+	m_network_evt = nullptr;
+}
+
+void evttype_index_ruleset::resolve_plugin_event_field(evttype_index_wrapper& wrap, const libsinsp::filter::ast::expr* condition)
+{
+	using namespace libsinsp::filter;
+
+	std::vector<const ast::expr*> conjuncts;
+	shared_filter_predicates::conjuncts(condition, conjuncts);
+	for(const auto* c : conjuncts)
+	{
+		auto check = dynamic_cast<const ast::binary_check_expr*>(c);
+		if(!check)
+		{
+			continue;
+		}
+		auto field = dynamic_cast<const ast::field_expr*>(check->left.get());
+		auto value = dynamic_cast<const ast::value_expr*>(check->right.get());
+		auto list = dynamic_cast<const ast::list_expr*>(check->right.get());
+		if(!field || !field->arg.empty() || field->field.rfind("evt.", 0) == 0
+		   || !((check->op == "=" && value) || (check->op == "in" && list && !list->values.empty())))
+		{
+			continue;
+		}
+
+		// only the fields extracting a single string, which is compared
+		// with the values as is
+		auto it = m_plugin_event_checks.find(field->field);
+		if(it == m_plugin_event_checks.end())
+		{
+			auto chk = m_filter_factory->new_filtercheck(field->field.c_str());
+			if(!chk || chk->parse_field_name(field->field.c_str(), true, true) < 0)
+			{
+				continue;
+			}
+			auto info = chk->get_field_info();
+			if(info == nullptr || info->m_type != PT_CHARBUF || (info->m_flags & EPF_IS_LIST))
+			{
+				continue;
+			}
+			it = m_plugin_event_checks.emplace(field->field, std::move(chk)).first;
+		}
+
+		wrap.m_plugin_event_field = field->field;
+		if(value)
+		{
+			wrap.m_plugin_event_values.insert(value->value);
+		}
+		else
+		{
+			wrap.m_plugin_event_values.insert(list->values.begin(), list->values.end());
+		}
+		return;
+	}
+}
+
+void evttype_index_ruleset::resolve_network_prefilters(evttype_index_wrapper& wrap, const libsinsp::filter::ast::expr* condition)
+{
+	using namespace libsinsp::filter;
+
+	std::vector<const ast::expr*> conjuncts;
+	shared_filter_predicates::conjuncts(condition, conjuncts);
+	for(const auto* c : conjuncts)
+	{
+		auto check = dynamic_cast<const ast::binary_check_expr*>(c);
+		if(!check)
+		{
+			continue;
+		}
+		auto field = dynamic_cast<const ast::field_expr*>(check->left.get());
+		if(!field || !field->arg.empty() || field->field.rfind("fd.", 0) != 0)
+		{
+			continue;
+		}
+		std::vector<std::string> values;
+		if(auto value = dynamic_cast<const ast::value_expr*>(check->right.get()))
+		{
+			values.push_back(value->value);
+		}
+		else if(auto list = dynamic_cast<const ast::list_expr*>(check->right.get()))
+		{
+			values = list->values;
+		}
+		else
+		{
+			continue;
+		}
+
+		// only the fields extracting a single value, as the ones
+		// matching either of the endpoints, such as fd.port, are
+		// compared in a custom way
+		size_t idx = 0;
+		while(idx < m_network_fields.size() && m_network_fields[idx].name != field->field)
+		{
+			idx++;
+		}
+		if(idx == m_network_fields.size())
+		{
+			auto chk = m_filter_factory->new_filtercheck(field->field.c_str());
+			if(!chk || chk->parse_field_name(field->field.c_str(), true, true) < 0)
+			{
+				continue;
+			}
+			auto info = chk->get_field_info();
+			if(info == nullptr || (info->m_flags & (EPF_IS_LIST | EPF_FILTER_ONLY)))
+			{
+				continue;
+			}
+			network_field f;
+			f.name = field->field;
+			f.check = std::move(chk);
+			m_network_fields.push_back(std::move(f));
+		}
+
+		auto matcher = network_matcher::create(m_network_fields[idx].check->get_field_info()->m_type, check->op, values);
+		if(matcher)
+		{
+			wrap.m_network_prefilters.emplace_back(idx, std::move(matcher));
+		}
+	}
+}
+
+bool evttype_index_ruleset::run_network_prefilters(evttype_index_wrapper* wrap, sinsp_evt *evt)
+{
+	// the event number alone doesn't tell events apart, as the one of an
+	// event can be reused by another one with the same number
+	if(evt != m_network_evt || evt->get_num() != m_network_evtnum)
+	{
+		m_network_evt = evt;
+		m_network_evtnum = evt->get_num();
+		m_network_generation++;
+	}
+	for(const auto& p : wrap->m_network_prefilters)
+	{
+		auto& f = m_network_fields[p.first];
+		if(f.generation != m_network_generation)
+		{
+			f.generation = m_network_generation;
+			f.len = 0;
+			m_network_extracted.clear();
+			if(f.check->extract(evt, m_network_extracted, false) && m_network_extracted.size() == 1
+			   && m_network_extracted[0].len <= sizeof(f.value))
+			{
+				f.len = m_network_extracted[0].len;
+				memcpy(f.value, m_network_extracted[0].ptr, f.len);
+			}
+		}
+
+		// without a value we can't tell, so the filter has to decide
+		if(f.len != 0 && !p.second->match(f.value, f.len))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool evttype_index_ruleset::extract_plugin_event_field(sinsp_evt *evt, const std::string &field, std::string &value)
+{
+	auto it = m_plugin_event_checks.find(field);
+	if(it == m_plugin_event_checks.end())
+	{
+		return false;
+	}
+
+	value.clear();
+	m_plugin_event_extracted.clear();
+	if(it->second->extract(evt, m_plugin_event_extracted, false) && m_plugin_event_extracted.size() == 1)
+	{
+		auto v = (const char*) m_plugin_event_extracted[0].ptr;
+		value.assign(v, strnlen(v, m_plugin_event_extracted[0].len));
+	}
+	return true;
+}
+
 void evttype_index_ruleset::on_loading_complete()
 {
+	commit_changes();
+	share_predicates();
 	print_enabled_rules_falco_logger();
 }
 
-bool evttype_index_ruleset::run_wrappers(sinsp_evt *evt, filter_wrapper_list &wrappers, uint16_t ruleset_id, falco_rule &match)
+size_t evttype_index_ruleset::memory_usage() const
+{
+	return indexable_ruleset::memory_usage() + m_predicates.memory_usage();
+}
+
+void evttype_index_ruleset::share_predicates()
 {
-	for(auto &wrap : wrappers)
+	std::set<evttype_index_wrapper*> wrappers;
+	iterate([&wrappers](const std::shared_ptr<evttype_index_wrapper>& wrap)
 	{
-		if(wrap->m_filter->run(evt))
+		wrappers.insert(wrap.get());
+	});
+
+	// count how many enabled rules use each predicate
+	std::unordered_map<std::string, size_t> usages;
+	std::vector<const libsinsp::filter::ast::expr*> conjuncts;
+	for(auto* wrap : wrappers)
+	{
+		wrap->m_predicates.clear();
+		if(!wrap->m_condition)
+		{
+			continue;
+		}
+		conjuncts.clear();
+		shared_filter_predicates::conjuncts(wrap->m_condition.get(), conjuncts);
+		std::set<std::string> unique;
+		for(const auto* c : conjuncts)
+		{
+			unique.insert(libsinsp::filter::ast::as_string(c));
+		}
+		for(const auto& u : unique)
+		{
+			usages[u]++;
+		}
+	}
+
+	// rules with no predicate in common with other rules keep using
+	// their own filter, so that they don't pay for the memoization
+	m_predicates.clear();
+	for(auto* wrap : wrappers)
+	{
+		if(!wrap->m_condition)
+		{
+			continue;
+		}
+		conjuncts.clear();
+		shared_filter_predicates::conjuncts(wrap->m_condition.get(), conjuncts);
+		bool shared = std::any_of(conjuncts.begin(), conjuncts.end(),
+			[&usages](const libsinsp::filter::ast::expr* c)
+			{
+				return usages[libsinsp::filter::ast::as_string(c)] > 1;
+			});
+		if(!shared)
+		{
+			continue;
+		}
+
+		try
+		{
+			std::vector<size_t> predicates;
+			for(const auto* c : conjuncts)
+			{
+				predicates.push_back(m_predicates.add(c));
+			}
+			wrap->m_predicates = std::move(predicates);
+		}
+		catch (const sinsp_exception& e)
 		{
-			match = wrap->m_rule;
+			// should not happen, as each predicate is a part of a
+			// condition that already compiled successfully, but we
+			// can safely keep using the rule's own filter
+			FALCO_LOG(falco_logger::level::DEBUG,
+				"Can't share predicates of rule " + wrap->m_rule.name + ": " + e.what() + "\n");
+		}
+	}
+}
+
+bool evttype_index_ruleset::run_prefilter(evttype_index_wrapper* wrap, sinsp_evt *evt)
+{
+	// the thread info is looked up each time, as the event may not be
+	// the one of the last call even with the same number, and its thread
+	// may have been removed since. This is cached by the event anyway.
+	auto tinfo = evt->get_thread_info();
+
+	// without thread info we can't tell, so the filter has to decide
+	if(!tinfo)
+	{
+		return true;
+	}
+
+	const auto& name = tinfo->m_comm;
+	if(wrap->m_proc_names.find(name) != wrap->m_proc_names.end())
+	{
+		return true;
+	}
+	for(const auto& prefix : wrap->m_proc_name_prefixes)
+	{
+		if(name.compare(0, prefix.size(), prefix) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool evttype_index_ruleset::run_wrapper_profiled(stats_manager& stats, evttype_index_wrapper* wrap, sinsp_evt *evt)
+{
+	bool matched;
+	if(++m_profiling_tick >= stats.get_rule_profiling_sampling_period())
+	{
+		m_profiling_tick = 0;
+		auto start = std::chrono::steady_clock::now();
+		matched = run_filter(wrap, evt);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		stats.on_rule_evaluation_sampled(wrap->m_rule.id,
+			std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+			evt->get_type(), evt->get_ts());
+	}
+	else
+	{
+		matched = run_filter(wrap, evt);
+	}
+	stats.on_rule_evaluated(wrap->m_rule.id, matched);
+	return matched;
+}
+
+bool evttype_index_ruleset::run_wrappers(sinsp_evt *evt, const filter_wrapper_table &wrappers, uint16_t ruleset_id, const falco_rule *&match)
+{
+	auto stats = profiling_stats();
+	bool tracking = falco::current_rule::tracking();
+	for(auto *wrap : wrappers)
+	{
+		if(tracking) [[unlikely]]
+		{
+			falco::current_rule::set(wrap->m_rule.name.c_str());
+		}
+		if(stats ? run_wrapper_profiled(*stats, wrap, evt) : run_filter(wrap, evt))
+		{
+			if(tracking) [[unlikely]]
+			{
+				falco::current_rule::set(nullptr);
+			}
+			match = &wrap->m_rule;
 			return true;
 		}
 	}
 
+	if(tracking) [[unlikely]]
+	{
+		falco::current_rule::set(nullptr);
+	}
 	return false;
 }
 
-bool evttype_index_ruleset::run_wrappers(sinsp_evt *evt, filter_wrapper_list &wrappers, uint16_t ruleset_id, std::vector<falco_rule> &matches)
+bool evttype_index_ruleset::run_wrappers(sinsp_evt *evt, const filter_wrapper_table &wrappers, uint16_t ruleset_id, std::vector<const falco_rule *> &matches)
 {
 	bool match_found = false;
+	auto stats = profiling_stats();
+	bool tracking = falco::current_rule::tracking();
 
-	for(auto &wrap : wrappers)
+	for(auto *wrap : wrappers)
 	{
-		if(wrap->m_filter->run(evt))
+		if(tracking) [[unlikely]]
+		{
+			falco::current_rule::set(wrap->m_rule.name.c_str());
+		}
+		if(stats ? run_wrapper_profiled(*stats, wrap, evt) : run_filter(wrap, evt))
 		{
-			matches.push_back(wrap->m_rule);
+			matches.push_back(&wrap->m_rule);
 			match_found = true;
 		}
 	}
 
+	if(tracking) [[unlikely]]
+	{
+		falco::current_rule::set(nullptr);
+	}
 	return match_found;
 }
 
+bool evttype_index_ruleset::run_wrapper(sinsp_evt *evt, evttype_index_wrapper *wrap, const falco_rule *&match)
+{
+	auto stats = profiling_stats();
+	bool tracking = falco::current_rule::tracking();
+	if(tracking) [[unlikely]]
+	{
+		falco::current_rule::set(wrap->m_rule.name.c_str());
+	}
+	bool res = stats ? run_wrapper_profiled(*stats, wrap, evt) : run_filter(wrap, evt);
+	if(tracking) [[unlikely]]
+	{
+		falco::current_rule::set(nullptr);
+	}
+	if(res)
+	{
+		match = &wrap->m_rule;
+	}
+	return res;
+}
+
+bool evttype_index_ruleset::ordering_score(const evttype_index_wrapper &wrap, double &score)
+{
+	// The score relies on the rule evaluation profiles of the engine
+	auto stats = get_engine_state().rule_stats;
+	if(!stats || wrap.m_rule.id >= stats->get_profile_by_rule_id().size())
+	{
+		return false;
+	}
+
+	const auto &profile = *stats->get_profile_by_rule_id()[wrap.m_rule.id];
+	auto samples = profile.sampled_evaluations.load(std::memory_order_relaxed);
+	if(samples == 0)
+	{
+		return false;
+	}
+
+	// Estimated cost spent per each match, with the match rate being
+	// estimated with Laplace smoothing so that rules that never matched
+	// yet are not considered infinitely expensive
+	auto evaluations = profile.evaluations.load(std::memory_order_relaxed);
+	auto matches = profile.matches.load(std::memory_order_relaxed);
+	double cost = (double)profile.sampled_time_ns.load(std::memory_order_relaxed) / (double)samples;
+	double match_rate = ((double)matches + 1.0) / ((double)evaluations + 2.0);
+	score = cost / match_rate;
+	return true;
+}
+
+// the matchers are owned by the wrapper, but memory::of() only counts
+// the shared pointers
+static size_t network_prefilters_memory_usage(const evttype_index_wrapper &wrap)
+{
+	size_t res = wrap.m_network_prefilters.capacity() * sizeof(wrap.m_network_prefilters[0]);
+	for(const auto& p : wrap.m_network_prefilters)
+	{
+		res += p.second->memory_usage();
+	}
+	return res;
+}
+
+size_t evttype_index_ruleset::wrapper_memory_usage(const evttype_index_wrapper &wrap) const
+{
+	// the name, source, output, and tags of rules are interned and so
+	// they are not owned by the wrapper
+	return falco::utils::memory::of(wrap.m_rule.description)
+		+ falco::utils::memory::of(wrap.m_rule.exception_fields)
+		+ falco::utils::memory::of(wrap.m_predicates)
+		+ falco::utils::memory::of(wrap.m_proc_names)
+		+ falco::utils::memory::of(wrap.m_proc_name_prefixes)
+		+ falco::utils::memory::of(wrap.m_async_event_names)
+		+ falco::utils::memory::of(wrap.m_plugin_event_field)
+		+ falco::utils::memory::of(wrap.m_plugin_event_values)
+		+ network_prefilters_memory_usage(wrap);
+}
+
 void evttype_index_ruleset::print_enabled_rules_falco_logger()
 {
-	falco_logger::log(falco_logger::level::DEBUG, "Enabled rules:\n");
+	if(!falco_logger::is_enabled(falco_logger::level::DEBUG))
+	{
+		return;
+	}
+
+	FALCO_LOG(falco_logger::level::DEBUG, "Enabled rules:\n");
 
 	auto logger = [](std::shared_ptr<evttype_index_wrapper> wrap)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, std::string("   ") + wrap->name() + "\n");
+		FALCO_LOG(falco_logger::level::DEBUG, std::string("   ") + wrap->name() + "\n");
 	};
 
 	uint64_t num_filters = iterate(logger);
 
-	falco_logger::log(falco_logger::level::DEBUG, "(" + std::to_string(num_filters) + ") enabled rules in total\n");
+	FALCO_LOG(falco_logger::level::DEBUG, "(" + std::to_string(num_filters) + ") enabled rules in total\n");
 }
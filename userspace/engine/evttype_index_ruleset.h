@@ -18,9 +18,14 @@ limitations under the License.
 #pragma once
 
 #include "indexable_ruleset.h"
+#include "network_matcher.h"
+#include "rule_exceptions.h"
+#include "shared_filter_predicates.h"
 
 #include <string>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 /*!
@@ -34,11 +39,48 @@ struct evttype_index_wrapper
 	const std::set<std::string> &tags() { return m_rule.tags; }
 	const libsinsp::events::set<ppm_sc_code> &sc_codes() { return m_sc_codes; }
 	const libsinsp::events::set<ppm_event_code> &event_codes() { return m_event_codes; }
+	const std::set<std::string> &async_event_names() { return m_async_event_names; }
+	const std::string &plugin_event_field() { return m_plugin_event_field; }
+	const std::set<std::string> &plugin_event_values() { return m_plugin_event_values; }
 
 	falco_rule m_rule;
 	libsinsp::events::set<ppm_sc_code> m_sc_codes;
 	libsinsp::events::set<ppm_event_code> m_event_codes;
+	// The names of the async events that the condition can match, if it
+	// requires evt.type or evt.asynctype to be one of them, or empty if
+	// it can match all of them
+	std::set<std::string> m_async_event_names;
+
+	// Set for the rules of plugin sources if the condition requires a
+	// string field of the plugin events, such as ct.name or ka.verb, to
+	// be equal to one of the values in order to match
+	std::string m_plugin_event_field;
+	std::set<std::string> m_plugin_event_values;
 	std::shared_ptr<sinsp_filter> m_filter;
+	std::shared_ptr<libsinsp::filter::ast::expr> m_condition;
+
+	// If set, m_filter and m_condition are the base condition of the
+	// rule, without these exceptions, which are checked once they match
+	std::shared_ptr<rule_exceptions> m_exceptions;
+
+	// If non-empty, the indexes of the shared predicates whose
+	// conjunction is equivalent to m_filter
+	std::vector<size_t> m_predicates;
+
+	// Set if the condition requires proc.name to be equal to one of
+	// m_proc_names, or to start with one of m_proc_name_prefixes, in
+	// order to match. Used to skip the rule without evaluating its
+	// filter when that's not the case.
+	bool m_proc_name_prefilter = false;
+	std::unordered_set<std::string> m_proc_names;
+	std::vector<std::string> m_proc_name_prefixes;
+
+	// The matchers of the top-level conjuncts of the condition comparing
+	// a port, IP address, or network field with constant values, along
+	// with the index of their field in the network fields of the ruleset.
+	// Used to skip the rule without evaluating its filter when one of
+	// them doesn't match.
+	std::vector<std::pair<size_t, std::shared_ptr<network_matcher>>> m_network_prefilters;
 };
 
 class evttype_index_ruleset : public indexable_ruleset<evttype_index_wrapper>
@@ -53,18 +95,134 @@ public:
 		std::shared_ptr<sinsp_filter> filter,
 		std::shared_ptr<libsinsp::filter::ast::expr> condition) override;
 
+	void clear() override;
+
 	void on_loading_complete() override;
 
+	size_t memory_usage() const override;
+
 	// From indexable_ruleset
-	bool run_wrappers(sinsp_evt *evt, filter_wrapper_list &wrappers, uint16_t ruleset_id, falco_rule &match) override;
-	bool run_wrappers(sinsp_evt *evt, filter_wrapper_list &wrappers, uint16_t ruleset_id, std::vector<falco_rule> &matches) override;
+	bool run_wrappers(sinsp_evt *evt, const filter_wrapper_table &wrappers, uint16_t ruleset_id, const falco_rule *&match) override;
+	bool run_wrappers(sinsp_evt *evt, const filter_wrapper_table &wrappers, uint16_t ruleset_id, std::vector<const falco_rule *> &matches) override;
+	bool run_wrapper(sinsp_evt *evt, evttype_index_wrapper *wrap, const falco_rule *&match) override;
+	bool extract_plugin_event_field(sinsp_evt *evt, const std::string &field, std::string &value) override;
+	bool ordering_score(const evttype_index_wrapper &wrap, double &score) override;
+	void prepare_filter(evttype_index_wrapper &wrap) override;
+	size_t wrapper_memory_usage(const evttype_index_wrapper &wrap) const override;
 
 	// Print each enabled rule when running Falco with falco logger
 	// log_level=debug; invoked within on_loading_complete()
 	void print_enabled_rules_falco_logger();
 
+	// Fills names with the async event names that a condition can match,
+	// if it constrains evt.type or evt.asynctype to a set of names, in
+	// which case it returns true. Async events have their name as type,
+	// so a condition such as evt.type=open can't match any of them.
+	static bool resolve_async_event_names(const libsinsp::filter::ast::expr* condition, std::set<std::string>& names);
+
+	// Fills the proc.name prefilter of a wrapper, if its condition requires
+	// proc.name to be equal to or start with given values at the top level
+	static void resolve_proc_name_prefilter(evttype_index_wrapper& wrap, const libsinsp::filter::ast::expr* condition);
+
+	// Fills the plugin event field of a wrapper, if its condition
+	// requires a string field to be equal to given values at the top
+	// level. The field can then be extracted by extract_plugin_event_field().
+	void resolve_plugin_event_field(evttype_index_wrapper& wrap, const libsinsp::filter::ast::expr* condition);
+
 private:
+	// Returns the engine's rule statistics if rule profiling is
+	// enabled, and nullptr otherwise
+	inline stats_manager* profiling_stats()
+	{
+		auto stats = get_engine_state().rule_stats;
+		return (stats && stats->is_rule_profiling_enabled()) ? stats : nullptr;
+	}
+
+	// Decomposes the conditions of the enabled rules in predicates, and
+	// makes the rules sharing at least one of them use m_predicates
+	void share_predicates();
+
+	// Returns false if the event can't match the proc.name constraint
+	// of the wrapper, if any
+	bool run_prefilter(evttype_index_wrapper* wrap, sinsp_evt *evt);
+
+	// Fills the network prefilters of a wrapper, see network_matcher
+	void resolve_network_prefilters(evttype_index_wrapper& wrap, const libsinsp::filter::ast::expr* condition);
+
+	// Returns false if the event can't match one of the network
+	// prefilters of the wrapper
+	bool run_network_prefilters(evttype_index_wrapper* wrap, sinsp_evt *evt);
+
+	// Runs the filter of a wrapper, using the shared predicates if
+	// possible, and then its exceptions if it matched
+	inline bool run_filter(evttype_index_wrapper* wrap, sinsp_evt *evt)
+	{
+		if(wrap->m_proc_name_prefilter && !run_prefilter(wrap, evt))
+		{
+			return false;
+		}
+		if(!wrap->m_network_prefilters.empty() && !run_network_prefilters(wrap, evt))
+		{
+			return false;
+		}
+		bool matched = wrap->m_predicates.empty()
+			? wrap->m_filter->run(evt)
+			: m_predicates.run(evt, wrap->m_predicates);
+		if(matched && wrap->m_exceptions && wrap->m_exceptions->match(evt))
+		{
+			auto stats = get_engine_state().rule_stats;
+			if(stats)
+			{
+				stats->on_exception_hit(wrap->m_rule);
+			}
+			return false;
+		}
+		return matched;
+	}
+
+	// Runs the filter of a wrapper and records its evaluation cost
+	bool run_wrapper_profiled(stats_manager& stats, evttype_index_wrapper* wrap, sinsp_evt *evt);
+
 	std::shared_ptr<sinsp_filter_factory> m_filter_factory;
+
+	// The filter factory compiling the rules enabled after loading, on
+	// whichever thread enables them and under m_rulesets_mtx, created
+	// the first time one is through the engine state so that it's not
+	// shared with the event thread, see prepare_filter()
+	std::shared_ptr<sinsp_filter_factory> m_lazy_filter_factory;
+
+	// Predicates shared across the conditions of the enabled rules
+	shared_filter_predicates m_predicates;
+
+	// The fields by which the filters of plugin events are indexed, see
+	// extract_plugin_event_field()
+	std::unordered_map<std::string, std::unique_ptr<sinsp_filter_check>> m_plugin_event_checks;
+	std::vector<extract_value_t> m_plugin_event_extracted;
+
+	// The fields compared by the network prefilters, whose values are
+	// extracted once per event and shared by all the rules, along with
+	// the generation of which each value is memoized
+	struct network_field
+	{
+		std::string name;
+		std::unique_ptr<sinsp_filter_check> check;
+		uint64_t generation = 0;
+		// the length of the value, or 0 if it has none
+		uint32_t len = 0;
+		uint8_t value[16];
+	};
+	std::vector<network_field> m_network_fields;
+	std::vector<extract_value_t> m_network_extracted;
+
+	// The last event run through the network prefilters, and its number,
+	// which identify the event being processed, along with a generation
+	// incremented each time it changes
+	const sinsp_evt* m_network_evt = nullptr;
+	uint64_t m_network_evtnum = 0;
+	uint64_t m_network_generation = 0;
+
+	// Counts evaluations to sample their duration when profiling
+	uint32_t m_profiling_tick = 0;
 };
 
 class evttype_index_ruleset_factory: public filter_ruleset_factory
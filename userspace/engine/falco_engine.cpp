@@ -21,13 +21,17 @@ limitations under the License.
 #else
 #include <stdlib.h>
 #include <io.h>
-#define srandom srand
-#define random rand
 #endif
 #include <string>
 #include <fstream>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -39,9 +43,14 @@ limitations under the License.
 
 #include "falco_engine.h"
 #include "falco_utils.h"
+#include "alloc_tracker.h"
 #include "falco_engine_version.h"
 
 #include "formats.h"
+#include "filter_cost_estimator.h"
+#include "rule_exceptions.h"
+#include "memory_usage.h"
+#include "shared_filter_predicates.h"
 
 #include "evttype_index_ruleset.h"
 
@@ -50,19 +59,19 @@ const std::string falco_engine::s_default_ruleset = "falco-default-ruleset";
 using namespace falco;
 
 falco_engine::falco_engine(bool seed_rng)
-	: m_syscall_source(NULL),
-	  m_syscall_source_idx(SIZE_MAX),
-	  m_rule_reader(std::make_shared<rule_loader::reader>()),
+	: m_rule_reader(std::make_shared<rule_loader::reader>()),
 	  m_rule_collector(std::make_shared<rule_loader::collector>()),
 	  m_rule_compiler(std::make_shared<rule_loader::compiler>()),
 	  m_next_ruleset_id(0),
 	  m_min_priority(falco_common::PRIORITY_DEBUG),
+	  m_rule_loading_state_released(false),
+	  m_rule_state_max_memory(16 * 1024 * 1024),
 	  m_sampling_ratio(1), m_sampling_multiplier(0),
 	  m_replace_container_info(false)
 {
 	if(seed_rng)
 	{
-		srandom((unsigned) getpid());
+		m_sampler.set_seed((uint64_t) getpid());
 	}
 
 	m_default_ruleset_id = find_ruleset_id(s_default_ruleset);
@@ -196,10 +205,21 @@ std::unique_ptr<load_result> falco_engine::load_rules(const std::string &rules_c
 	rule_loader::configuration cfg(rules_content, m_sources, name);
 	cfg.output_extra = m_extra;
 	cfg.replace_output_container_info = m_replace_container_info;
+	cfg.is_enabled_once_loaded = [this](const rule_loader::rule_info& r)
+	{
+		return is_enabled_once_loaded(r.name, r.tags, r.priority, r.enabled);
+	};
 
 	// read rules YAML file and collect its definitions
+	m_rule_loading_state_released = false;
 	if(m_rule_reader->read(cfg, *m_rule_collector))
 	{
+		// the compiled rules and the rulesets built from them are
+		// allocated together, apart from the definitions, so that the
+		// next load releases whole chunks of memory
+		m_rules_arena = falco::rules_arena::create();
+		falco::rules_arena::scope arena_scope(m_rules_arena.get());
+
 		// compile the definitions (resolve macro/list refs, exceptions, ...)
 		m_last_compile_output = m_rule_compiler->new_compile_output();
 		m_rule_compiler->compile(cfg, *m_rule_collector, *m_last_compile_output);
@@ -209,63 +229,249 @@ std::unique_ptr<load_result> falco_engine::load_rules(const std::string &rules_c
 			return std::move(cfg.res);
 		}
 
-		// clear the rules known by the engine and each ruleset
-		m_rules.clear();
-		for (auto &src : m_sources)
-		// add rules to each ruleset
-		{
-			src.ruleset = create_ruleset(src.ruleset_factory);
-			src.ruleset->add_compile_output(*m_last_compile_output,
-							m_min_priority,
-							src.name);
-		}
-
-		// add rules to the engine and the rulesets
-		for (const auto& rule : m_last_compile_output->rules)
+		add_compiled_rules([this](const falco_rule& rule)
 		{
 			auto info = m_rule_collector->rules().at(rule.name);
 			if (!info)
 			{
 				// this is just defensive, it should never happen
-				throw falco_exception("can't find internal rule info at name: " + name);
+				throw falco_exception("can't find internal rule info at name: " + rule.name);
+			}
+			return info->enabled;
+		});
+	}
+
+	return std::move(cfg.res);
+}
+
+void falco_engine::add_compiled_rules(const std::function<bool(const falco_rule&)>& is_enabled)
+{
+	// clear the rules known by the engine and each ruleset
+	m_rules.clear();
+	m_rule_outputs.clear();
+	for (auto &src : m_sources)
+	// add rules to each ruleset
+	{
+		src.ruleset = create_ruleset(src.ruleset_factory);
+		src.ruleset->add_compile_output(*m_last_compile_output,
+						m_min_priority,
+						src.name);
+	}
+
+	// add rules to the engine and the rulesets, enabling them in a single
+	// batch of changes per ruleset
+	for (const auto &src : m_sources)
+	{
+		src.ruleset->begin_changes();
+	}
+	for (const auto& rule : m_last_compile_output->rules)
+	{
+		auto source = find_source(rule.source);
+		auto rule_id = m_rules.insert(rule, rule.name);
+		if (rule_id != rule.id)
+		{
+			throw falco_exception("Incompatible ID for rule: " + rule.name +
+					      " | compiled ID: " + std::to_string(rule.id) +
+					      " | stats_mgr ID: " + std::to_string(rule_id));
+		}
+
+		// By default rules are enabled/disabled for the default ruleset
+		// skip the rule if below the minimum priority
+		if (rule.priority > m_min_priority)
+		{
+			continue;
+		}
+		if(is_enabled(rule))
+		{
+			source->ruleset->enable(rule.name, filter_ruleset::match_type::exact, m_default_ruleset_id);
+		}
+		else
+		{
+			source->ruleset->disable(rule.name, filter_ruleset::match_type::exact, m_default_ruleset_id);
+		}
+	}
+	for (const auto &src : m_sources)
+	{
+		src.ruleset->commit_changes();
+	}
+
+	m_rule_stats_manager.clear();
+	for (const auto &r : m_rules)
+	{
+		m_rule_stats_manager.on_rule_loaded(r);
+	}
+	update_rate_limiters();
+	update_rule_windows();
+	rules_changed();
+}
+
+std::string falco_engine::rules_cache_key(const std::string& key) const
+{
+	// the cached rules depend on the engine version and on all the engine
+	// settings that are applied while compiling rules
+	std::string res = key;
+	res += "|engine=" + std::string(FALCO_ENGINE_VERSION) + ":" + FALCO_ENGINE_CHECKSUM;
+	res += "|extra=" + m_extra + ":" + std::to_string(m_replace_container_info);
+	for(const auto& src : m_sources)
+	{
+		res += "|source=" + src.name;
+	}
+	return res;
+}
+
+void falco_engine::write_rules_cache(std::ostream& os, const std::string& key) const
+{
+	if(m_rule_loading_state_released)
+	{
+		throw falco_exception("can't write the rules cache after releasing the rule loading state");
+	}
+	if(m_last_compile_output == nullptr)
+	{
+		throw falco_exception("rules must be loaded before writing the rules cache");
+	}
+
+	nlohmann::json rules = nlohmann::json::array();
+	for(const auto& rule : m_last_compile_output->rules)
+	{
+		auto info = m_rule_collector->rules().at(rule.name);
+		nlohmann::json r;
+		r["name"] = rule.name;
+		r["source"] = rule.source;
+		r["description"] = rule.description;
+		r["output"] = rule.output;
+		r["priority"] = (int) rule.priority;
+		r["tags"] = rule.tags;
+		r["exception_fields"] = rule.exception_fields;
+		r["condition"] = libsinsp::filter::ast::as_string(rule.condition.get());
+		r["num_exceptions"] = rule.num_exceptions;
+		r["enabled"] = info ? info->enabled : true;
+		if(rule.rate_limit.has_value())
+		{
+			r["rate_limit"] = {{"rate", rule.rate_limit->rate}, {"max_burst", rule.rate_limit->max_burst}};
+		}
+		if(rule.threshold.has_value())
+		{
+			r["threshold"] = {{"count", rule.threshold->count}, {"window_ns", rule.threshold->window_ns}, {"by", rule.threshold->by}};
+		}
+		if(rule.sequence.has_value())
+		{
+			r["sequence"] = {{"after", rule.sequence->after}, {"window_ns", rule.sequence->window_ns}, {"by", rule.sequence->by}};
+		}
+		rules.push_back(std::move(r));
+	}
+
+	nlohmann::json cache;
+	cache["key"] = rules_cache_key(key);
+	cache["rules"] = std::move(rules);
+	os << cache.dump();
+}
+
+bool falco_engine::load_rules_cache(std::istream& is, const std::string& key)
+{
+	auto arena = falco::rules_arena::create();
+	std::unique_ptr<rule_loader::compile_output> out;
+	std::vector<bool> enabled;
+	try
+	{
+		auto cache = nlohmann::json::parse(is);
+		if(!cache.is_object() || cache.value("key", "") != rules_cache_key(key))
+		{
+			return false;
+		}
+
+		// the parsed cache is not allocated along with the rules
+		falco::rules_arena::scope arena_scope(arena.get());
+		out = m_rule_compiler->new_compile_output();
+
+		for(const auto& r : cache.at("rules"))
+		{
+			falco_rule rule;
+			rule.name = r.at("name").get<std::string>();
+			rule.source = r.at("source").get<std::string>();
+			rule.description = r.at("description").get<std::string>();
+			rule.output = r.at("output").get<std::string>();
+			rule.priority = (falco_common::priority_type) r.at("priority").get<int>();
+			rule.tags = r.at("tags").get<std::set<std::string>>();
+			rule.exception_fields = r.at("exception_fields").get<std::set<std::string>>();
+			if(r.contains("rate_limit"))
+			{
+				falco_rate_limit limit;
+				limit.rate = r.at("rate_limit").at("rate").get<double>();
+				limit.max_burst = r.at("rate_limit").at("max_burst").get<double>();
+				rule.rate_limit = limit;
+			}
+			if(r.contains("threshold"))
+			{
+				falco_rule_threshold threshold;
+				threshold.count = r.at("threshold").at("count").get<uint64_t>();
+				threshold.window_ns = r.at("threshold").at("window_ns").get<uint64_t>();
+				threshold.by = r.at("threshold").at("by").get<std::vector<std::string>>();
+				rule.threshold = threshold;
+			}
+			if(r.contains("sequence"))
+			{
+				falco_rule_sequence sequence;
+				sequence.after = r.at("sequence").at("after").get<std::string>();
+				sequence.window_ns = r.at("sequence").at("window_ns").get<uint64_t>();
+				sequence.by = r.at("sequence").at("by").get<std::vector<std::string>>();
+				rule.sequence = sequence;
 			}
 
-			auto source = find_source(rule.source);
-			auto rule_id = m_rules.insert(rule, rule.name);
-			if (rule_id != rule.id)
+			auto source = m_sources.at(rule.source);
+			if(!source)
 			{
-				throw falco_exception("Incompatible ID for rule: " + rule.name +
-						      " | compiled ID: " + std::to_string(rule.id) +
-						      " | stats_mgr ID: " + std::to_string(rule_id));
+				return false;
 			}
 
-			// By default rules are enabled/disabled for the default ruleset
-			// skip the rule if below the minimum priority
-			if (rule.priority > m_min_priority)
+			// the condition is stored with all the macros and lists
+			// already resolved, so it only needs to be parsed again.
+			// We refuse any condition that doesn't survive a round trip.
+			auto condition = r.at("condition").get<std::string>();
+			libsinsp::filter::parser p(condition);
+			p.set_max_depth(1000);
+			rule.condition = p.parse();
+			if(libsinsp::filter::ast::as_string(rule.condition.get()) != condition)
 			{
-				continue;
+				return false;
 			}
-			if(info->enabled)
+
+			// the cached conditions are already validated, so the rules
+			// not enabled once loaded are compiled lazily
+			rule.num_exceptions = r.value("num_exceptions", (size_t) 0);
+			bool rule_enabled = r.at("enabled").get<bool>();
+			if(is_enabled_once_loaded(rule.name, rule.tags, rule.priority, rule_enabled))
 			{
-				source->ruleset->enable(rule.name, filter_ruleset::match_type::exact, m_default_ruleset_id);
+				rule_loader::compiler::compile_evaluation_filter(source->filter_factory,
+					rule.condition, rule.num_exceptions, rule.filter, rule.exceptions);
 			}
-			else
+
+			if(out->rules.at(rule.name) != nullptr)
 			{
-				source->ruleset->disable(rule.name, filter_ruleset::match_type::exact, m_default_ruleset_id);
+				return false;
 			}
+			rule.id = out->rules.size();
+			out->rules.insert(rule, rule.name);
+			enabled.push_back(rule_enabled);
 		}
 	}
-
-	if (cfg.res->successful())
+	catch(const std::exception& e)
 	{
-		m_rule_stats_manager.clear();
-		for (const auto &r : m_rules)
-		{
-			m_rule_stats_manager.on_rule_loaded(r);
-		}
+		// any kind of corrupted or outdated cache is simply ignored
+		return false;
 	}
 
-	return std::move(cfg.res);
+	// the rules now come from the cache, so the definitions
+	// collected from previously loaded rules files are stale
+	m_rule_collector->clear();
+	m_last_compile_output = std::move(out);
+	m_rule_loading_state_released = false;
+	m_rules_arena = arena;
+	falco::rules_arena::scope arena_scope(m_rules_arena.get());
+	add_compiled_rules([this, &enabled](const falco_rule& rule)
+	{
+		return enabled.at(rule.id);
+	});
+	return true;
 }
 
 void falco_engine::enable_rule(const std::string &substring, bool enabled, const std::string &ruleset)
@@ -288,6 +494,7 @@ void falco_engine::enable_rule(const std::string &substring, bool enabled, const
 			it.ruleset->disable(substring, filter_ruleset::match_type::substring, ruleset_id);
 		}
 	}
+	rules_changed();
 }
 
 void falco_engine::enable_rule_exact(const std::string &rule_name, bool enabled, const std::string &ruleset)
@@ -310,6 +517,7 @@ void falco_engine::enable_rule_exact(const std::string &rule_name, bool enabled,
 			it.ruleset->disable(rule_name, filter_ruleset::match_type::exact, ruleset_id);
 		}
 	}
+	rules_changed();
 }
 
 void falco_engine::enable_rule_wildcard(const std::string &rule_name, bool enabled, const std::string &ruleset)
@@ -332,6 +540,7 @@ void falco_engine::enable_rule_wildcard(const std::string &rule_name, bool enabl
 			it.ruleset->disable(rule_name, filter_ruleset::match_type::wildcard, ruleset_id);
 		}
 	}
+	rules_changed();
 }
 
 void falco_engine::enable_rule_by_tag(const std::set<std::string> &tags, bool enabled, const std::string &ruleset)
@@ -354,6 +563,7 @@ void falco_engine::enable_rule_by_tag(const std::set<std::string> &tags, bool en
 			it.ruleset->disable_tags(tags, ruleset_id);
 		}
 	}
+	rules_changed();
 }
 
 void falco_engine::set_min_priority(falco_common::priority_type priority)
@@ -361,6 +571,22 @@ void falco_engine::set_min_priority(falco_common::priority_type priority)
 	m_min_priority = priority;
 }
 
+void falco_engine::set_rule_enabled_hint(rule_enabled_hint hint)
+{
+	m_rule_enabled_hint = hint;
+}
+
+bool falco_engine::is_enabled_once_loaded(const std::string& name, const std::set<std::string>& tags,
+	falco_common::priority_type priority, bool enabled) const
+{
+	// the rules below the minimum priority are never added to rulesets
+	if(priority > m_min_priority)
+	{
+		return false;
+	}
+	return m_rule_enabled_hint ? m_rule_enabled_hint(name, tags, enabled) : enabled;
+}
+
 uint16_t falco_engine::find_ruleset_id(const std::string &ruleset)
 {
 	auto it = m_known_rulesets.lower_bound(ruleset);
@@ -393,31 +619,222 @@ libsinsp::events::set<ppm_sc_code> falco_engine::sc_codes_for_ruleset(const std:
 	return find_source(source)->ruleset->enabled_sc_codes(find_ruleset_id(ruleset));
 }
 
+std::map<std::string, libsinsp::events::set<ppm_sc_code>> falco_engine::sc_codes_by_rule_for_ruleset(const std::string &source, const std::string &ruleset)
+{
+	return find_source(source)->ruleset->enabled_sc_codes_by_rule(find_ruleset_id(ruleset));
+}
+
+// Returns true if the condition matches only events of successful
+// syscalls, as one of its top-level "and" operands requires it
+static bool requires_successful_result(const libsinsp::filter::ast::expr* condition)
+{
+	using namespace libsinsp::filter;
+
+	std::vector<const ast::expr*> conjuncts;
+	shared_filter_predicates::conjuncts(condition, conjuncts);
+	for(const auto* c : conjuncts)
+	{
+		auto check = dynamic_cast<const ast::binary_check_expr*>(c);
+		auto field = check ? dynamic_cast<const ast::field_expr*>(check->left.get()) : nullptr;
+		auto value = check ? dynamic_cast<const ast::value_expr*>(check->right.get()) : nullptr;
+		if(!field || !value || !field->arg.empty())
+		{
+			continue;
+		}
+		if((field->field == "evt.res" && check->op == "=" && value->value == "SUCCESS")
+			|| (field->field == "evt.failed" && check->op == "=" && (value->value == "false" || value->value == "False"))
+			|| (field->field == "evt.rawres" && check->op == ">=" && value->value == "0"))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+falco_engine::kernel_prefilter falco_engine::kernel_prefilter_for_ruleset(const std::string &source, const std::string &ruleset)
+{
+	kernel_prefilter res;
+	for(const auto& r : sc_codes_by_rule_for_ruleset(source, ruleset))
+	{
+		auto rule = m_rules.at(r.first);
+		if(rule == nullptr || !rule->condition || !requires_successful_result(rule->condition.get()))
+		{
+			res.unfiltered_rules.push_back(r.first);
+		}
+	}
+	res.drop_failed_exit = res.unfiltered_rules.empty()
+		&& (source.empty() || source == falco_common::syscall_source);
+	return res;
+}
+
 libsinsp::events::set<ppm_event_code> falco_engine::event_codes_for_ruleset(const std::string &source, const std::string &ruleset)
 {
 	return find_source(source)->ruleset->enabled_event_codes(find_ruleset_id(ruleset));
 }
 
+uint64_t falco_engine::rules_generation() const
+{
+	return m_rules_generation.load(std::memory_order_acquire);
+}
+
+void falco_engine::rules_changed()
+{
+	m_rules_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
 std::shared_ptr<sinsp_evt_formatter> falco_engine::create_formatter(const std::string &source,
 								    const std::string &output) const
 {
 	return find_source(source)->formatter_factory->create_formatter(output);
 }
 
+std::shared_ptr<sinsp_evt_formatter> falco_engine::get_formatter(const std::string &source,
+								 const std::string &output) const
+{
+	auto src = find_source(source);
+	auto& cache = src->thread_formatters_cache();
+	auto it = cache.formatters.find(output);
+	if(it != cache.formatters.end())
+	{
+		return it->second;
+	}
+
+	auto formatter = src->formatter_factory->create_formatter(output);
+	cache.formatters[output] = formatter;
+	return formatter;
+}
+
+const std::map<std::string, std::string>& falco_engine::get_field_values(sinsp_evt *evt,
+									 const std::string &source,
+									 const std::string &output) const
+{
+	auto src = find_source(source);
+	auto& cache = src->thread_formatters_cache();
+	if(cache.evt != evt || cache.evtnum != evt->get_num())
+	{
+		cache.evt = evt;
+		cache.evtnum = evt->get_num();
+		cache.field_values.clear();
+	}
+
+	auto it = cache.field_values.find(output);
+	if(it != cache.field_values.end())
+	{
+		return it->second;
+	}
+
+	std::map<std::string, std::string> values;
+	if(!get_formatter(source, output)->get_field_values(evt, values))
+	{
+		throw falco_exception("Could not extract all field values from event");
+	}
+	return cache.field_values[output] = std::move(values);
+}
+
+void falco_engine::set_rule_output_format(std::function<std::string(const falco_rule&)> func)
+{
+	m_rule_output_format = func;
+}
+
+std::shared_ptr<sinsp_evt_formatter> falco_engine::get_rule_formatter(std::size_t rule_id) const
+{
+	if(rule_id < m_rule_outputs.size())
+	{
+		return m_rule_outputs[rule_id].formatter;
+	}
+	return nullptr;
+}
+
+const falco::field_values& falco_engine::get_rule_field_values(sinsp_evt *evt,
+							       std::size_t rule_id) const
+{
+	// the event number alone doesn't tell events apart, as the one of an
+	// event can be reused by another one with the same number
+	const auto& out = m_rule_outputs.at(rule_id);
+	if(out.field_values_evt != evt || out.field_values_evtnum != evt->get_num())
+	{
+		out.extracted.clear();
+		if(!out.formatter->get_field_values(evt, out.extracted))
+		{
+			throw falco_exception("Could not extract all field values from event");
+		}
+		falco::assign_field_values(out.field_values, out.extracted);
+		out.field_values_evt = evt;
+		out.field_values_evtnum = evt->get_num();
+	}
+	return out.field_values;
+}
+
+const std::string& falco_engine::get_rule_output_format(std::size_t rule_id) const
+{
+	return m_rule_outputs.at(rule_id).format;
+}
+
 std::unique_ptr<std::vector<falco_engine::rule_result>> falco_engine::process_event(std::size_t source_idx,
 	sinsp_evt *ev, uint16_t ruleset_id, falco_common::rule_matching strategy)
+{
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::ENGINE);
+	std::vector<rule_match> matches;
+	if (!process_event(source_idx, ev, ruleset_id, strategy, matches))
+	{
+		return nullptr;
+	}
+
+	auto res = std::make_unique<std::vector<falco_engine::rule_result>>();
+	for(const auto& m : matches)
+	{
+		rule_result rule_result;
+		rule_result.evt = m.evt;
+		rule_result.rule = m.rule->name;
+		rule_result.source = m.rule->source;
+		rule_result.format = m.rule->output;
+		rule_result.priority_num = m.rule->priority;
+		rule_result.tags = m.rule->tags;
+		rule_result.exception_fields = m.rule->exception_fields;
+		res->push_back(rule_result);
+	}
+
+	return res;
+}
+
+std::unique_ptr<std::vector<falco_engine::rule_result>> falco_engine::process_event(std::size_t source_idx,
+	sinsp_evt *ev, falco_common::rule_matching strategy)
+{
+	return process_event(source_idx, ev, m_default_ruleset_id, strategy);
+}
+
+bool falco_engine::process_event(std::size_t source_idx,
+	sinsp_evt *ev, uint16_t ruleset_id, falco_common::rule_matching strategy,
+	std::vector<rule_match>& matches)
 {
 	// note: there are no thread-safety guarantees on the filter_ruleset::run()
 	// method, but the thread-safety assumptions of falco_engine::process_event()
 	// imply that concurrent invokers use different and non-switchable values of
 	// source_idx, which means that at any time each filter_ruleset will only
 	// be accessed by a single thread.
+	return process_event(source_handle(find_source(source_idx)), ev, ruleset_id, strategy, matches);
+}
 
-	const falco_source *source = find_source(source_idx);
+bool falco_engine::process_event(std::size_t source_idx,
+	sinsp_evt *ev, falco_common::rule_matching strategy,
+	std::vector<rule_match>& matches)
+{
+	return process_event(source_idx, ev, m_default_ruleset_id, strategy, matches);
+}
 
-	if(should_drop_evt() || !source)
+bool falco_engine::process_event(const source_handle& handle,
+	sinsp_evt *ev, uint16_t ruleset_id, falco_common::rule_matching strategy,
+	std::vector<rule_match>& matches)
+{
+	// note: see process_event() for the thread-safety assumptions
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::ENGINE);
+
+	matches.clear();
+
+	const falco_source *source = handle.m_source;
+	if(!source || should_drop_evt(*source, ev))
 	{
-		return nullptr;
+		return false;
 	}
 
 	switch (strategy)
@@ -429,7 +846,7 @@ std::unique_ptr<std::vector<falco_engine::rule_result>> falco_engine::process_ev
 		}
 		if (!source->ruleset->run(ev, source->m_rules, ruleset_id))
 		{
-			return nullptr;
+			return false;
 		}
 		break;
 	case falco_common::rule_matching::FIRST:
@@ -439,33 +856,129 @@ std::unique_ptr<std::vector<falco_engine::rule_result>> falco_engine::process_ev
 		}
 		if (!source->ruleset->run(ev, source->m_rules[0], ruleset_id))
 		{
-			return nullptr;
+			return false;
 		}
 		break;
 	}
 
-	auto res = std::make_unique<std::vector<falco_engine::rule_result>>();
-	for(const auto& rule : source->m_rules)
+	for(const auto* rule : source->m_rules)
 	{
-		rule_result rule_result;
-		rule_result.evt = ev;
-		rule_result.rule = rule.name;
-		rule_result.source = rule.source;
-		rule_result.format = rule.output;
-		rule_result.priority_num = rule.priority;
-		rule_result.tags = rule.tags;
-		rule_result.exception_fields = rule.exception_fields;
-		m_rule_stats_manager.on_event(rule);
-		res->push_back(rule_result);
+		const falco_rule* r = m_rules.at(rule->id);
+		if (r == nullptr)
+		{
+			throw falco_exception("Unknown rule id " + std::to_string(rule->id) + " for rule: " + rule->name);
+		}
+		m_rule_stats_manager.on_event(*r);
+		if(is_window_pending(*r, *source, ev) || is_rate_limited(*r, ev))
+		{
+			continue;
+		}
+		matches.push_back({ev, r});
 	}
 
-	return res;
+	return !matches.empty();
 }
 
-std::unique_ptr<std::vector<falco_engine::rule_result>> falco_engine::process_event(std::size_t source_idx,
-	sinsp_evt *ev, falco_common::rule_matching strategy)
+bool falco_engine::process_event(const source_handle& source,
+	sinsp_evt *ev, falco_common::rule_matching strategy,
+	std::vector<rule_match>& matches)
 {
-	return process_event(source_idx, ev, m_default_ruleset_id, strategy);
+	return process_event(source, ev, m_default_ruleset_id, strategy, matches);
+}
+
+bool falco_engine::process_event_multi(std::size_t source_idx,
+	sinsp_evt *ev, uint64_t ruleset_mask,
+	std::vector<multi_rule_match>& matches)
+{
+	// note: see process_event() for the thread-safety assumptions
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::ENGINE);
+	matches.clear();
+
+	const falco_source *source = find_source(source_idx);
+	if(!source || should_drop_evt(*source, ev))
+	{
+		return false;
+	}
+
+	if(!source->ruleset->run_multi(ev, ruleset_mask, source->m_multi_matches))
+	{
+		return false;
+	}
+
+	for(const auto& m : source->m_multi_matches)
+	{
+		const falco_rule* r = m_rules.at(m.rule->id);
+		if (r == nullptr)
+		{
+			throw falco_exception("Unknown rule id " + std::to_string(m.rule->id) + " for rule: " + m.rule->name);
+		}
+		m_rule_stats_manager.on_event(*r);
+		if(is_window_pending(*r, *source, ev) || is_rate_limited(*r, ev))
+		{
+			continue;
+		}
+		matches.push_back({ev, r, m.rulesets});
+	}
+
+	return !matches.empty();
+}
+
+bool falco_engine::process_events(std::size_t source_idx,
+	sinsp_evt *const *evts, std::size_t num_evts, uint16_t ruleset_id,
+	falco_common::rule_matching strategy,
+	std::vector<rule_match>& matches)
+{
+	// note: see process_event() for the thread-safety assumptions
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::ENGINE);
+	matches.clear();
+
+	const falco_source *source = find_source(source_idx);
+	if(!source)
+	{
+		return false;
+	}
+
+	source->m_batch_evts.clear();
+	for(std::size_t i = 0; i < num_evts; i++)
+	{
+		if(!should_drop_evt(*source, evts[i]))
+		{
+			source->m_batch_evts.push_back(evts[i]);
+		}
+	}
+
+	if(source->m_batch_evts.empty() || source->ruleset->run_batch(
+		source->m_batch_evts.data(), source->m_batch_evts.size(), strategy,
+		source->m_batch_matched, source->m_batch_matches, ruleset_id) == 0)
+	{
+		return false;
+	}
+
+	for(const auto& m : source->m_batch_matches)
+	{
+		const falco_rule* r = m_rules.at(m.rule->id);
+		if (r == nullptr)
+		{
+			throw falco_exception("Unknown rule id " + std::to_string(m.rule->id) + " for rule: " + m.rule->name);
+		}
+		m_rule_stats_manager.on_event(*r);
+		auto* ev = source->m_batch_evts[m.evt_idx];
+		if(is_window_pending(*r, *source, ev) || is_rate_limited(*r, ev))
+		{
+			continue;
+		}
+		matches.push_back({ev, r});
+	}
+
+	return !matches.empty();
+}
+
+bool falco_engine::process_events(std::size_t source_idx,
+	sinsp_evt *const *evts, std::size_t num_evts,
+	falco_common::rule_matching strategy,
+	std::vector<rule_match>& matches)
+{
+	return process_events(source_idx, evts, num_evts, m_default_ruleset_id, strategy, matches);
 }
 
 std::size_t falco_engine::add_source(const std::string &source,
@@ -473,15 +986,13 @@ std::size_t falco_engine::add_source(const std::string &source,
 				     std::shared_ptr<sinsp_evt_formatter_factory> formatter_factory)
 {
 	// evttype_index_ruleset is the default ruleset implementation
-	size_t idx = add_source(source, filter_factory, formatter_factory,
-	                        std::make_shared<evttype_index_ruleset_factory>(filter_factory));
-
-	if(source == falco_common::syscall_source)
-	{
-		m_syscall_source_idx = idx;
-	}
+	return add_source(source, filter_factory, formatter_factory,
+	                  std::make_shared<evttype_index_ruleset_factory>(filter_factory));
+}
 
-	return idx;
+falco_engine::source_handle falco_engine::get_source_handle(std::size_t source_idx)
+{
+	return source_handle(find_source(source_idx));
 }
 
 std::size_t falco_engine::add_source(const std::string &source,
@@ -495,6 +1006,7 @@ std::size_t falco_engine::add_source(const std::string &source,
 	src.formatter_factory = formatter_factory;
 	src.ruleset_factory = ruleset_factory;
 	src.ruleset = create_ruleset(src.ruleset_factory);
+	src.sampled = m_sampling_sources.empty() || m_sampling_sources.count(source) > 0;
 	return m_sources.insert(src, source);
 }
 
@@ -508,22 +1020,217 @@ template <typename T> inline nlohmann::json sequence_to_json_array(const T& seq)
 	return ret;
 }
 
+// Receives the description of the rules, in the order of the keys of a
+// JSON object as sorted by nlohmann::json
+struct falco_engine::describe_sink
+{
+	virtual ~describe_sink() = default;
+	virtual void value(const std::string& key, nlohmann::json&& value) = 0;
+	virtual void begin_array(const std::string& key) = 0;
+	virtual void item(nlohmann::json&& item) = 0;
+	virtual void end_array() = 0;
+};
+
+namespace
+{
+// Builds the whole description as a single JSON object
+struct json_describe_sink : public falco_engine::describe_sink
+{
+	void value(const std::string& key, nlohmann::json&& value) override
+	{
+		out[key] = std::move(value);
+	}
+	void begin_array(const std::string& key) override
+	{
+		array = &(out[key] = nlohmann::json::array());
+	}
+	void item(nlohmann::json&& item) override
+	{
+		array->push_back(std::move(item));
+	}
+	void end_array() override
+	{
+		array = nullptr;
+	}
+
+	nlohmann::json out;
+	nlohmann::json* array = nullptr;
+};
+
+// Writes the description as it goes, the same as the dump() of the whole
+// JSON object, so that no more than a few items are held in memory
+struct stream_describe_sink : public falco_engine::describe_sink
+{
+	explicit stream_describe_sink(std::ostream& os): os(os) {}
+
+	void key(const std::string& key)
+	{
+		os << (first_key ? "{" : ",") << nlohmann::json(key).dump() << ":";
+		first_key = false;
+	}
+	void value(const std::string& k, nlohmann::json&& value) override
+	{
+		key(k);
+		os << value.dump();
+	}
+	void begin_array(const std::string& k) override
+	{
+		key(k);
+		os << "[";
+		first_item = true;
+	}
+	void item(nlohmann::json&& item) override
+	{
+		os << (first_item ? "" : ",") << item.dump();
+		first_item = false;
+	}
+	void end_array() override
+	{
+		os << "]";
+	}
+	void end()
+	{
+		os << (first_key ? "{}" : "}");
+	}
+
+	std::ostream& os;
+	bool first_key = true;
+	bool first_item = true;
+};
+}
+
 nlohmann::json falco_engine::describe_rule(std::string *rule_name, const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const
+{
+	json_describe_sink sink;
+	describe_rule(sink, rule_name, plugins);
+	return std::move(sink.out);
+}
+
+void falco_engine::describe_rule(std::ostream& os, std::string *rule_name, const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const
+{
+	stream_describe_sink sink(os);
+	describe_rule(sink, rule_name, plugins);
+	sink.end();
+}
+
+void falco_engine::describe_items(
+	size_t count,
+	const filter_details& known,
+	const std::function<void(size_t, describe_details&, nlohmann::json&)>& describe,
+	describe_sink& sink) const
+{
+	// the items are described in parallel by batches, so that the output
+	// keeps their order while holding only a batch in memory
+	size_t num_threads = std::max<size_t>(1, std::min(m_rule_compiler->get_compile_threads(), count));
+	std::vector<describe_details> details(num_threads, describe_details{known, known});
+
+	size_t batch_size = num_threads * 64;
+	std::vector<nlohmann::json> batch;
+	for(size_t begin = 0; begin < count; begin += batch_size)
+	{
+		size_t n = std::min(batch_size, count - begin);
+		batch.assign(n, nlohmann::json());
+
+		std::atomic<size_t> next{0};
+		std::vector<std::exception_ptr> errors(num_threads);
+		auto worker = [&](size_t t)
+		{
+			try
+			{
+				for(size_t i = next++; i < n; i = next++)
+				{
+					describe(begin + i, details[t], batch[i]);
+				}
+			}
+			catch(...)
+			{
+				errors[t] = std::current_exception();
+				next = n;
+			}
+		};
+		std::vector<std::thread> workers;
+		for(size_t t = 1; t < num_threads && t < n; t++)
+		{
+			workers.emplace_back(worker, t);
+		}
+		worker(0);
+		for(auto& w : workers)
+		{
+			w.join();
+		}
+		for(const auto& e : errors)
+		{
+			if(e)
+			{
+				std::rethrow_exception(e);
+			}
+		}
+
+		for(auto& item : batch)
+		{
+			sink.item(std::move(item));
+		}
+	}
+}
+
+void falco_engine::describe_rule(describe_sink& sink, std::string *rule_name, const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const
 {
 	// use previously-loaded collector definitions and the compiled
 	// output of rules, macros, and lists.
+	if (m_rule_loading_state_released)
+	{
+		throw falco_exception("can't describe rules after releasing the rule loading state");
+	}
 	if (m_last_compile_output == nullptr)
 	{
 		throw falco_exception("rules must be loaded before describing them");
 	}
 
-	// use collected and compiled info to print a json output
-	nlohmann::json output;
+	// the names of the macros and lists, which every item is resolved
+	// against, are only collected once
+	filter_details known;
+	for(const auto &m : m_rule_collector->macros())
+	{
+		known.known_macros.insert(m.name);
+	}
+	for(const auto &l : m_rule_collector->lists())
+	{
+		known.known_lists.insert(l.name);
+	}
+
+	// the fields of the outputs are collected beforehand, as the
+	// formatter factories can't be used from multiple threads
+	auto output_fields = [this](const falco_rule& r)
+	{
+		std::vector<std::string> fields;
+		create_formatter(r.source, r.output)->get_field_names(fields);
+		return fields;
+	};
+
+	// the keys are written in alphabetical order
 	if(!rule_name)
 	{
+		const auto& lists = m_last_compile_output->lists;
+		sink.begin_array("lists");
+		describe_items(lists.size(), known, [&](size_t i, describe_details&, nlohmann::json& out)
+		{
+			const auto& list = *lists.at(i);
+			get_json_details(out, list, *m_rule_collector->lists().at(list.name));
+		}, sink);
+		sink.end_array();
+
+		const auto& macros = m_last_compile_output->macros;
+		sink.begin_array("macros");
+		describe_items(macros.size(), known, [&](size_t i, describe_details& d, nlohmann::json& out)
+		{
+			const auto& macro = *macros.at(i);
+			get_json_details(out, macro, *m_rule_collector->macros().at(macro.name), d);
+		}, sink);
+		sink.end_array();
+
 		// Store required engine version
 		auto required_engine_version = m_rule_collector->required_engine_version();
-		output["required_engine_version"] = required_engine_version.version.as_string();
+		sink.value("required_engine_version", required_engine_version.version.as_string());
 
 		// Store required plugin versions
 		nlohmann::json plugin_versions = nlohmann::json::array();
@@ -546,40 +1253,22 @@ nlohmann::json falco_engine::describe_rule(std::string *rule_name, const std::ve
 
 			plugin_versions.push_back(std::move(r));
 		}
-		output["required_plugin_versions"] = std::move(plugin_versions);
-
-		// Store information about rules
-		nlohmann::json rules_array = nlohmann::json::array();
-		for(const auto& rule : m_last_compile_output->rules)
-		{
-			auto info = m_rule_collector->rules().at(rule.name);
-			nlohmann::json details;
-			get_json_details(details, rule, *info, plugins);
-			rules_array.push_back(std::move(details));
-		}
-		output["rules"] = std::move(rules_array);
+		sink.value("required_plugin_versions", std::move(plugin_versions));
 
-		// Store information about macros
-		nlohmann::json macros_array = nlohmann::json::array();
-		for(const auto &macro : m_last_compile_output->macros)
+		const auto& rules = m_last_compile_output->rules;
+		std::vector<std::vector<std::string>> rules_output_fields;
+		rules_output_fields.reserve(rules.size());
+		for(const auto& rule : rules)
 		{
-			auto info = m_rule_collector->macros().at(macro.name);
-			nlohmann::json details;
-			get_json_details(details, macro, *info, plugins);
-			macros_array.push_back(std::move(details));
+			rules_output_fields.push_back(output_fields(rule));
 		}
-		output["macros"] = std::move(macros_array);
-
-		// Store information about lists
-		nlohmann::json lists_array = nlohmann::json::array();
-		for(const auto &list : m_last_compile_output->lists)
+		sink.begin_array("rules");
+		describe_items(rules.size(), known, [&](size_t i, describe_details& d, nlohmann::json& out)
 		{
-			auto info = m_rule_collector->lists().at(list.name);
-			nlohmann::json details;
-			get_json_details(details, list, *info, plugins);
-			lists_array.push_back(std::move(details));
-		}
-		output["lists"] = std::move(lists_array);
+			const auto& rule = *rules.at(i);
+			get_json_details(out, rule, *m_rule_collector->rules().at(rule.name), rules_output_fields[i], plugins, d);
+		}, sink);
+		sink.end_array();
 	}
 	else
 	{
@@ -591,21 +1280,23 @@ nlohmann::json falco_engine::describe_rule(std::string *rule_name, const std::ve
 		}
 		auto rule = m_rules.at(ri->name);
 
-		nlohmann::json details;
-		get_json_details(details, *rule, *ri, plugins);
-		nlohmann::json rules_array = nlohmann::json::array();
-		rules_array.push_back(std::move(details));
-		output["rules"] = std::move(rules_array);
+		auto fields = output_fields(*rule);
+		sink.begin_array("rules");
+		describe_items(1, known, [&](size_t, describe_details& d, nlohmann::json& out)
+		{
+			get_json_details(out, *rule, *ri, fields, plugins, d);
+		}, sink);
+		sink.end_array();
 	}
-
-	return output;
 }
 
 void falco_engine::get_json_details(
 	nlohmann::json &out,
 	const falco_rule &r,
 	const rule_loader::rule_info &info,
-	const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const
+	const std::vector<std::string>& out_fields,
+	const std::vector<std::shared_ptr<sinsp_plugin>>& plugins,
+	describe_details& d) const
 {
 	nlohmann::json rule_info;
 
@@ -625,19 +1316,10 @@ void falco_engine::get_json_details(
 	auto ast = libsinsp::filter::parser(info.cond).parse();
 
 	// get details related to the condition's filter
-	filter_details details;
-	filter_details compiled_details;
-	nlohmann::json json_details;
-	for(const auto &m : m_rule_collector->macros())
-	{
-		details.known_macros.insert(m.name);
-		compiled_details.known_macros.insert(m.name);
-	}
-	for(const auto &l : m_rule_collector->lists())
-	{
-		details.known_lists.insert(l.name);
-		compiled_details.known_lists.insert(l.name);
-	}
+	auto& details = d.details;
+	auto& compiled_details = d.compiled_details;
+	details.reset();
+	compiled_details.reset();
 	filter_details_resolver().run(ast.get(), details);
 	filter_details_resolver().run(r.condition.get(), compiled_details);
 
@@ -647,9 +1329,6 @@ void falco_engine::get_json_details(
 	out["details"]["condition_fields"] = sequence_to_json_array(compiled_details.fields);
 
 	// Get fields from output string
-	auto fmt = create_formatter(r.source, r.output);
-	std::vector<std::string> out_fields;
-	fmt->get_field_names(out_fields);
 	out["details"]["output_fields"] = sequence_to_json_array(out_fields);
 
 	// Get fields from exceptions
@@ -713,7 +1392,7 @@ void falco_engine::get_json_details(
 	nlohmann::json& out,
 	const falco_macro& macro,
 	const rule_loader::macro_info& info,
-	const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const
+	describe_details& d) const
 {
 	nlohmann::json macro_info;
 
@@ -726,19 +1405,10 @@ void falco_engine::get_json_details(
 	auto ast = libsinsp::filter::parser(info.cond).parse();
 
 	// get details related to the condition's filter
-	filter_details details;
-	filter_details compiled_details;
-	nlohmann::json json_details;
-	for(const auto &m : m_rule_collector->macros())
-	{
-		details.known_macros.insert(m.name);
-		compiled_details.known_macros.insert(m.name);
-	}
-	for(const auto &l : m_rule_collector->lists())
-	{
-		details.known_lists.insert(l.name);
-		compiled_details.known_lists.insert(l.name);
-	}
+	auto& details = d.details;
+	auto& compiled_details = d.compiled_details;
+	details.reset();
+	compiled_details.reset();
 	filter_details_resolver().run(ast.get(), details);
 	filter_details_resolver().run(macro.condition.get(), compiled_details);
 
@@ -768,8 +1438,7 @@ void falco_engine::get_json_details(
 void falco_engine::get_json_details(
 	nlohmann::json& out,
 	const falco_list& l,
-	const rule_loader::list_info& info,
-	const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const
+	const rule_loader::list_info& info) const
 {
 	nlohmann::json list_info;
 	list_info["name"] = l.name;
@@ -912,6 +1581,204 @@ void falco_engine::print_stats() const
 	fprintf(stdout, "%s", out.c_str());
 }
 
+nlohmann::json falco_engine::rules_profile_report() const
+{
+	nlohmann::json out;
+	m_rule_stats_manager.format_profile(m_rules, out);
+	return out;
+}
+
+nlohmann::json falco_engine::rules_slowest_evaluations_report(size_t max) const
+{
+	nlohmann::json out;
+	m_rule_stats_manager.format_slowest(m_rules, max, out);
+	for(auto &e : out)
+	{
+		auto names = libsinsp::events::event_set_to_names({(ppm_event_code) e["evt_type"].get<uint16_t>()}, false);
+		if(!names.empty())
+		{
+			e["evt_type"] = *names.begin();
+		}
+	}
+	return out;
+}
+
+void falco_engine::set_rule_profiling(bool enabled, uint32_t sampling_period)
+{
+	m_rule_stats_manager.set_rule_profiling(enabled, sampling_period);
+}
+
+void falco_engine::set_rate_limit(falco_common::priority_type priority, const falco_rate_limit& limit)
+{
+	m_priority_rate_limits[priority] = limit;
+	update_rate_limiters();
+}
+
+void falco_engine::set_rate_limit(const std::string& rule, const falco_rate_limit& limit)
+{
+	m_rule_rate_limits[rule] = limit;
+	update_rate_limiters();
+}
+
+void falco_engine::update_rate_limiters()
+{
+	m_rate_limiters.clear();
+	m_rate_limiters.resize(m_rules.size());
+	for(const auto& r : m_rules)
+	{
+		std::optional<falco_rate_limit> limit = r.rate_limit;
+		if(!limit.has_value())
+		{
+			auto rit = m_rule_rate_limits.find(r.name);
+			if(rit != m_rule_rate_limits.end())
+			{
+				limit = rit->second;
+			}
+			else
+			{
+				auto pit = m_priority_rate_limits.find(r.priority);
+				if(pit != m_priority_rate_limits.end())
+				{
+					limit = pit->second;
+				}
+			}
+		}
+
+		if(limit.has_value() && limit->rate > 0)
+		{
+			m_rate_limiters[r.id] = std::make_unique<rate_limiter>();
+			m_rate_limiters[r.id]->limit = *limit;
+			m_rate_limiters[r.id]->bucket.init(limit->rate, limit->max_burst);
+		}
+	}
+}
+
+inline bool falco_engine::is_rate_limited(const falco_rule& rule, sinsp_evt* evt)
+{
+	auto* l = rule.id < m_rate_limiters.size() ? m_rate_limiters[rule.id].get() : nullptr;
+	if(l == nullptr)
+	{
+		return false;
+	}
+
+	// the buckets follow the event time, so that the limits behave
+	// the same when reading events from capture files
+	if(l->bucket.claim(evt->get_ts()))
+	{
+		return false;
+	}
+	m_rule_stats_manager.on_rate_limited(rule);
+	return true;
+}
+
+void falco_engine::set_rule_state_max_memory(uint64_t max_memory)
+{
+	m_rule_state_max_memory = max_memory;
+}
+
+void falco_engine::get_rule_state_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	for(const auto& src : m_sources)
+	{
+		if(src.m_rule_state)
+		{
+			src.m_rule_state->get_metrics(metrics);
+		}
+	}
+}
+
+void falco_engine::update_rule_windows()
+{
+	m_rule_windows.clear();
+	m_rule_windows.resize(m_rules.size());
+	for(auto &src : m_sources)
+	{
+		src.m_rule_state = std::make_unique<falco::rule_state>(m_rule_state_max_memory);
+	}
+
+	for(const auto& r : m_rules)
+	{
+		const auto* by = r.threshold.has_value() ? &r.threshold->by
+			: r.sequence.has_value() ? &r.sequence->by : nullptr;
+		if(by == nullptr)
+		{
+			continue;
+		}
+		if(!by->empty())
+		{
+			// the values are separated by a control character, which
+			// is not expected in the values themselves
+			std::string fmt;
+			for(const auto& f : *by)
+			{
+				fmt += (fmt.empty() ? "%" : "\x1f%") + f;
+			}
+			m_rule_windows[r.id].key = create_formatter(r.source, fmt);
+		}
+		if(r.sequence.has_value())
+		{
+			auto after = m_rules.at(r.sequence->after);
+			if(after == nullptr)
+			{
+				throw falco_exception("Unknown rule " + r.sequence->after + " for sequence of rule: " + r.name);
+			}
+			m_rule_windows[after->id].followers.push_back(r.id);
+		}
+	}
+}
+
+inline const std::string& falco_engine::rule_window_key(std::size_t rule_id, const falco_source& source, sinsp_evt* evt) const
+{
+	auto& key = source.m_rule_state_key;
+	key = std::to_string(rule_id);
+	const auto& formatter = m_rule_windows[rule_id].key;
+	if(formatter != nullptr)
+	{
+		formatter->tostring_withformat(evt, source.m_rule_state_values, sinsp_evt_formatter::OF_NORMAL);
+		key += '\x1f';
+		key += source.m_rule_state_values;
+	}
+	return key;
+}
+
+inline bool falco_engine::is_window_pending(const falco_rule& rule, const falco_source& source, sinsp_evt* evt)
+{
+	if(rule.id >= m_rule_windows.size() || source.m_rule_state == nullptr)
+	{
+		return false;
+	}
+
+	// the windows follow the event time, like the rate limits
+	for(auto follower : m_rule_windows[rule.id].followers)
+	{
+		source.m_rule_state->start_sequence(rule_window_key(follower, source, evt), evt->get_ts());
+	}
+	if(rule.threshold.has_value())
+	{
+		return !source.m_rule_state->add_threshold(rule_window_key(rule.id, source, evt),
+			evt->get_ts(), rule.threshold->window_ns, rule.threshold->count);
+	}
+	if(rule.sequence.has_value())
+	{
+		return !source.m_rule_state->complete_sequence(rule_window_key(rule.id, source, evt),
+			evt->get_ts(), rule.sequence->window_ns);
+	}
+	return false;
+}
+
+void falco_engine::update_rule_ordering()
+{
+	if(!m_rule_stats_manager.is_rule_profiling_enabled())
+	{
+		return;
+	}
+
+	for(auto &src : m_sources)
+	{
+		src.ruleset->update_rule_ordering();
+	}
+}
+
 const stats_manager& falco_engine::get_rule_stats_manager() const
 {
     return m_rule_stats_manager;
@@ -932,6 +1799,17 @@ std::shared_ptr<sinsp_filter_factory> falco_engine::filter_factory_for_source(st
 	return find_source(source_idx)->filter_factory;
 }
 
+void falco_engine::set_filter_factory_creator(std::size_t source_idx,
+	falco_source::filter_factory_creator creator)
+{
+	auto src = m_sources.at(source_idx);
+	if(!src)
+	{
+		throw falco_exception("Unknown event source index " + std::to_string(source_idx));
+	}
+	src->new_filter_factory = std::move(creator);
+}
+
 std::shared_ptr<sinsp_evt_formatter_factory> falco_engine::formatter_factory_for_source(const std::string& source)
 {
 	return find_source(source)->formatter_factory;
@@ -1062,24 +1940,372 @@ void falco_engine::fill_engine_state_funcs(filter_ruleset::engine_state_funcs &e
 
 		return true;
 	};
+
+	engine_state.rule_stats = &m_rule_stats_manager;
+
+	engine_state.new_filter_factory = [this](const std::string &source_name) -> std::shared_ptr<sinsp_filter_factory>
+	{
+		const falco_source *src = m_sources.at(source_name);
+		if(src == nullptr || !src->new_filter_factory)
+		{
+			return nullptr;
+		}
+
+		return src->new_filter_factory();
+	};
 };
 
 void falco_engine::complete_rule_loading() const
 {
+	falco::rules_arena::scope arena_scope(m_rules_arena.get());
 	for (const auto &src : m_sources)
 	{
 		src.ruleset->on_loading_complete();
 	}
+
+	m_rule_outputs.clear();
+	m_rule_outputs.resize(m_rules.size());
+	for (const auto &rule : m_rules)
+	{
+		auto& out = m_rule_outputs[rule.id];
+		out.format = m_rule_output_format ? m_rule_output_format(rule) : rule.output.get();
+		out.formatter = create_formatter(rule.source, out.format);
+	}
+}
+
+void falco_engine::release_rule_loading_state()
+{
+	m_rule_collector->clear();
+	m_last_compile_output.reset();
+	m_rule_compiler->clear_cache();
+	m_rule_loading_state_released = true;
+}
+
+static size_t exception_entry_memory_usage(const rule_loader::rule_exception_info::entry& e)
+{
+	size_t res = falco::utils::memory::of(e.item);
+	res += e.items.capacity() * sizeof(e);
+	for(const auto& i : e.items)
+	{
+		res += exception_entry_memory_usage(i);
+	}
+	return res;
+}
+
+static size_t rule_memory_usage(const falco_rule& r)
+{
+	// the name, source, output, and tags of rules are interned, and
+	// the conditions and filters are shared and accounted separately
+	return falco::utils::memory::of(r.description)
+		+ falco::utils::memory::of(r.exception_fields);
+}
+
+nlohmann::json falco_engine::rules_memory_report() const
+{
+	using falco::utils::memory::of;
+
+	// definitions collected by the rule loader, with their YAML contexts
+	// accounted separately as each of them holds the whole chain of
+	// locations from the rules file down to the item
+	size_t contexts = 0;
+	size_t lists = m_rule_collector->lists().memory_usage();
+	for(const auto &l : m_rule_collector->lists())
+	{
+		contexts += l.ctx.memory_usage();
+		lists += of(l.name) + of(l.items);
+	}
+	size_t macros = m_rule_collector->macros().memory_usage();
+	for(const auto &m : m_rule_collector->macros())
+	{
+		contexts += m.ctx.memory_usage() + m.cond_ctx.memory_usage();
+		macros += of(m.name) + of(m.cond);
+	}
+	size_t rules = m_rule_collector->rules().memory_usage();
+	for(const auto &r : m_rule_collector->rules())
+	{
+		contexts += r.ctx.memory_usage() + r.cond_ctx.memory_usage() + r.output_ctx.memory_usage();
+		rules += of(r.name) + of(r.cond) + of(r.source) + of(r.desc) + of(r.output) + of(r.tags);
+		rules += r.exceptions.capacity() * sizeof(rule_loader::rule_exception_info);
+		for(const auto &e : r.exceptions)
+		{
+			contexts += e.ctx.memory_usage();
+			rules += of(e.name);
+			rules += exception_entry_memory_usage(e.fields);
+			rules += exception_entry_memory_usage(e.comps);
+			rules += e.values.capacity() * sizeof(rule_loader::rule_exception_info::entry);
+			for(const auto &v : e.values)
+			{
+				rules += exception_entry_memory_usage(v);
+			}
+		}
+	}
+	nlohmann::json collector;
+	collector["lists"] = lists;
+	collector["macros"] = macros;
+	collector["rules"] = rules;
+	collector["contexts"] = contexts;
+	collector["total"] = lists + macros + rules + contexts;
+
+	// output of the last compilation, whose rules share their
+	// conditions and filters with the rules of the engine
+	size_t compiled_lists = 0;
+	size_t compiled_macros = 0;
+	size_t compiled_rules = 0;
+	std::vector<const falco_rule*> all_rules;
+	if(m_last_compile_output)
+	{
+		compiled_lists = m_last_compile_output->lists.memory_usage();
+		for(const auto &l : m_last_compile_output->lists)
+		{
+			compiled_lists += of(l.name) + of(l.items);
+		}
+		compiled_macros = m_last_compile_output->macros.memory_usage();
+		for(const auto &m : m_last_compile_output->macros)
+		{
+			compiled_macros += of(m.name) + of(m.condition.get());
+		}
+		compiled_rules = m_last_compile_output->rules.memory_usage();
+		for(const auto &r : m_last_compile_output->rules)
+		{
+			compiled_rules += rule_memory_usage(r);
+			all_rules.push_back(&r);
+		}
+	}
+	nlohmann::json compile_output;
+	compile_output["lists"] = compiled_lists;
+	compile_output["macros"] = compiled_macros;
+	compile_output["rules"] = compiled_rules;
+	compile_output["total"] = compiled_lists + compiled_macros + compiled_rules;
+
+	size_t engine_rules = m_rules.memory_usage();
+	for(const auto &r : m_rules)
+	{
+		engine_rules += rule_memory_usage(r);
+		all_rules.push_back(&r);
+	}
+
+	// each condition and filter is counted once, no matter how many
+	// copies of the rules refer to it
+	size_t conditions = 0;
+	size_t num_conditions = 0;
+	size_t num_filters = 0;
+	size_t num_checks = 0;
+	std::unordered_set<const void*> seen;
+	for(const auto *r : all_rules)
+	{
+		if(r->condition && seen.insert(r->condition.get()).second)
+		{
+			num_conditions++;
+			conditions += of(r->condition.get());
+		}
+		if(r->filter && seen.insert(r->filter.get()).second)
+		{
+			num_filters++;
+			num_checks += falco::utils::memory::num_checks(r->condition.get());
+		}
+		if(r->exceptions && seen.insert(r->exceptions.get()).second)
+		{
+			conditions += r->exceptions->memory_usage();
+		}
+	}
+
+	nlohmann::json rulesets;
+	size_t rulesets_total = 0;
+	for(const auto &src : m_sources)
+	{
+		size_t usage = src.ruleset ? src.ruleset->memory_usage() : 0;
+		rulesets[src.name] = usage;
+		rulesets_total += usage;
+	}
+	rulesets["total"] = rulesets_total;
+
+	size_t compiler_cache = m_rule_compiler->memory_usage();
+
+	nlohmann::json out;
+	out["collector"] = std::move(collector);
+	out["compile_output"] = std::move(compile_output);
+	out["compiler_cache"] = compiler_cache;
+	out["engine_rules"] = engine_rules;
+	out["conditions"]["count"] = num_conditions;
+	out["conditions"]["bytes"] = conditions;
+	out["filters"]["count"] = num_filters;
+	out["filters"]["checks"] = num_checks;
+	out["rulesets"] = std::move(rulesets);
+	out["total"] = lists + macros + rules + contexts
+		+ compiled_lists + compiled_macros + compiled_rules
+		+ compiler_cache + engine_rules + conditions + rulesets_total;
+	out["loading_state_released"] = m_rule_loading_state_released;
+	return out;
+}
+
+// The syscalls happening the most on a busy host, on which evaluating a
+// rule costs the most overall
+static const std::unordered_set<std::string> s_high_volume_evt_names = {
+	"read", "write", "readv", "writev", "pread", "pwrite", "preadv", "pwritev",
+	"recvfrom", "sendto", "recvmsg", "sendmsg", "recvmmsg", "sendmmsg",
+	"close", "futex", "mmap", "munmap", "poll", "ppoll", "epoll_wait", "select",
+	"lseek", "fstat", "switch",
+};
+
+// A rule is likely to be hot when it's evaluated on many event types, as
+// it can't be indexed by them, or when a single evaluation costs as much
+// as this many plain field comparisons
+static const size_t s_hot_rule_evt_names = 100;
+static const uint64_t s_hot_rule_cost = 50;
+
+nlohmann::json falco_engine::rules_cost_report() const
+{
+	std::vector<nlohmann::json> rules;
+	size_t num_hot = 0;
+	filter_cost_estimator estimator;
+	for(const auto &r : m_rules)
+	{
+		if(!r.condition)
+		{
+			continue;
+		}
+
+		filter_cost cost;
+		estimator.run(r.condition.get(), cost);
+
+		nlohmann::json reasons = nlohmann::json::array();
+		nlohmann::json rule;
+		rule["name"] = r.name;
+		rule["source"] = r.source;
+		rule["predicates"] = cost.predicates;
+		rule["list_values"] = cost.list_values;
+		rule["largest_list"] = cost.largest_list;
+		rule["expensive_operators"] = sequence_to_json_array(cost.expensive_operators);
+		rule["expensive_fields"] = sequence_to_json_array(cost.expensive_fields);
+		rule["transformers"] = sequence_to_json_array(cost.transformers);
+		rule["cost"] = cost.cost;
+
+		// the rules of the other sources are evaluated on all the
+		// events of their source, which have a single type
+		if(r.source == falco_common::syscall_source)
+		{
+			auto evtcodes = libsinsp::filter::ast::ppm_event_codes(r.condition.get());
+			auto evtnames = libsinsp::events::event_set_to_names(evtcodes, false);
+			rule["event_types"] = evtnames.size();
+			if(evtnames.size() > s_hot_rule_evt_names)
+			{
+				reasons.push_back("evaluated on " + std::to_string(evtnames.size()) + " event types");
+			}
+			else
+			{
+				std::set<std::string> hot_names;
+				for(const auto &n : evtnames)
+				{
+					if(s_high_volume_evt_names.find(n) != s_high_volume_evt_names.end())
+					{
+						hot_names.insert(n);
+					}
+				}
+				if(!hot_names.empty())
+				{
+					std::string names;
+					for(const auto &n : hot_names)
+					{
+						names += (names.empty() ? "" : ", ") + n;
+					}
+					reasons.push_back("evaluated on high-volume event types: " + names);
+				}
+			}
+		}
+		if(cost.cost >= s_hot_rule_cost)
+		{
+			reasons.push_back("estimated cost of " + std::to_string(cost.cost) + " comparisons per evaluation");
+		}
+
+		rule["hot"] = !reasons.empty();
+		rule["hot_reasons"] = std::move(reasons);
+		num_hot += rule["hot"].get<bool>() ? 1 : 0;
+		rules.emplace_back(std::move(rule));
+	}
+
+	// the hot rules come first, then the most expensive ones
+	std::stable_sort(rules.begin(), rules.end(), [](const nlohmann::json& a, const nlohmann::json& b)
+	{
+		if(a["hot"] != b["hot"])
+		{
+			return a["hot"].get<bool>();
+		}
+		return a["cost"].get<uint64_t>() > b["cost"].get<uint64_t>();
+	});
+
+	nlohmann::json out;
+	out["num_rules"] = rules.size();
+	out["num_hot_rules"] = num_hot;
+	out["rules"] = std::move(rules);
+	return out;
+}
+
+size_t falco_engine::formatters_memory_usage(const std::string& source) const
+{
+	using falco::utils::memory::of;
+
+	auto src = find_source(source);
+	if(src == nullptr)
+	{
+		return 0;
+	}
+	// the caches of the other threads are updated without the lock
+	const auto &cache = src->thread_formatters_cache();
+	size_t res = of(cache.formatters) + of(cache.field_values);
+	for(const auto &r : m_rules)
+	{
+		if(r.id >= m_rule_outputs.size() || r.source != source)
+		{
+			continue;
+		}
+		const auto &out = m_rule_outputs[r.id];
+		res += sizeof(out) + of(out.format) + of(out.extracted);
+		res += out.field_values.capacity() * sizeof(falco::field_values::value_type);
+		for(const auto &f : out.field_values)
+		{
+			res += of(f.second.str);
+		}
+	}
+	return res;
 }
 
 void falco_engine::set_sampling_ratio(uint32_t sampling_ratio)
 {
 	m_sampling_ratio = sampling_ratio;
+	update_sampler();
 }
 
 void falco_engine::set_sampling_multiplier(double sampling_multiplier)
 {
 	m_sampling_multiplier = sampling_multiplier;
+	update_sampler();
+}
+
+void falco_engine::set_sampling_seed(uint64_t seed)
+{
+	m_sampler.set_seed(seed);
+}
+
+void falco_engine::set_sampling_scope(const std::unordered_set<std::string>& sources,
+	const libsinsp::events::set<ppm_event_code>& event_types)
+{
+	m_sampling_sources = sources;
+	m_sampling_event_types = event_types;
+	m_sampling_all_event_types = event_types.empty();
+	for(auto& src : m_sources)
+	{
+		src.sampled = sources.empty() || sources.count(src.name) > 0;
+	}
+}
+
+void falco_engine::update_sampler()
+{
+	if(m_sampling_multiplier == 0 || m_sampling_ratio <= 1)
+	{
+		m_sampler.set_keep_ratio(1);
+		return;
+	}
+	m_sampler.set_keep_ratio(1.0 / (m_sampling_multiplier * m_sampling_ratio));
 }
 
 void falco_engine::set_extra(const std::string &extra, bool replace_container_info)
@@ -1088,18 +2314,17 @@ void falco_engine::set_extra(const std::string &extra, bool replace_container_in
 	m_replace_container_info = replace_container_info;
 }
 
-inline bool falco_engine::should_drop_evt() const
+inline bool falco_engine::should_drop_evt(const falco_source& source, sinsp_evt* evt) const
 {
-	if(m_sampling_multiplier == 0)
+	if(!m_sampler.enabled() || !source.sampled)
 	{
 		return false;
 	}
 
-	if(m_sampling_ratio == 1)
+	if(!m_sampling_all_event_types && !m_sampling_event_types.contains((ppm_event_code) evt->get_type()))
 	{
 		return false;
 	}
 
-	double coin = (random() * (1.0/RAND_MAX));
-	return (coin >= (1.0/(m_sampling_multiplier * m_sampling_ratio)));
+	return !m_sampler.keep(source.m_sampling_counter);
 }
@@ -18,9 +18,12 @@ limitations under the License.
 #pragma once
 
 #include <atomic>
+#include <functional>
+#include <iosfwd>
 #include <string>
 #include <memory>
 #include <set>
+#include <unordered_set>
 
 #include <nlohmann/json.hpp>
 
@@ -31,9 +34,13 @@ limitations under the License.
 #include "rule_loader_compiler.h"
 #include "stats_manager.h"
 #include "falco_common.h"
+#include "field_values.h"
 #include "falco_source.h"
 #include "falco_load_result.h"
+#include "rate_limiting.h"
+#include "event_sampler.h"
 #include "filter_details_resolver.h"
+#include "rules_arena.h"
 
 //
 // This class acts as the primary interface between a program and the
@@ -82,6 +89,28 @@ public:
 	//
 	std::unique_ptr<falco::load_result> load_rules(const std::string &rules_content, const std::string &name);
 
+	//
+	// Write the rules currently loaded in the engine to a persistent
+	// cache, so that they can later be restored with load_rules_cache()
+	// without reading and compiling the rules files again. The key must
+	// identify the contents of all the loaded rules files (e.g. their
+	// sha256 sums) and anything else affecting how they are loaded, such
+	// as the loaded plugins and their versions. The engine version and
+	// settings are added to the key automatically.
+	// Throws falco_exception if no rules were loaded.
+	//
+	void write_rules_cache(std::ostream& os, const std::string& key) const;
+
+	//
+	// Load the rules from a cache written with write_rules_cache(),
+	// replacing all the rules of the engine. Returns false and leaves
+	// the engine untouched if the cache can't be read or has not been
+	// written for the given key, in which case the rules must be loaded
+	// with load_rules(). Since no rules file is read, the rules restored
+	// from a cache can't be described with describe_rule().
+	//
+	bool load_rules_cache(std::istream& is, const std::string& key);
+
 	//
 	// Enable/Disable any rules matching the provided substring.
 	// If the substring is "", all rules are enabled/disabled.
@@ -91,6 +120,14 @@ public:
 	// for different sets of rules being active at once.
 	// The rules are matched against the rulesets of all the defined sources.
 	//
+	// With the default ruleset implementation, this and the other
+	// enable_rule*() methods can be invoked from a single thread while
+	// other threads are invoking process_event(): each change is applied
+	// atomically, and the events being processed keep seeing the rules that
+	// were enabled before. Note that this does not change the set of
+	// syscalls and event types collected by the inspectors, which is up
+	// to the caller (e.g. recomputing it with sc_codes_for_ruleset()).
+	//
 	void enable_rule(const std::string &substring, bool enabled, const std::string &ruleset = s_default_ruleset);
 
 	// Same as above but providing a ruleset id instead
@@ -126,9 +163,33 @@ public:
 	//
 	void complete_rule_loading() const;
 
+	//
+	// Release the state kept by the rule loader to describe the loaded
+	// rules and to load more rules on top of them, such as the collected
+	// definitions, their YAML contexts, and the output of the last
+	// compilation. This should be called after complete_rule_loading(),
+	// and does not affect the functional behavior of process_event().
+	// Afterwards, describe_rule() and write_rules_cache() throw a
+	// falco_exception, and any rules loaded with load_rules() do not see
+	// the definitions of the rules loaded before.
+	//
+	void release_rule_loading_state();
+
 	// Only load rules having this priority or more severe.
 	void set_min_priority(falco_common::priority_type priority);
 
+	// Tells which of the rules loaded next are enabled once done loading
+	// them, given their name, tags, and whether they're defined as
+	// enabled, e.g. once the rules selection of the application is
+	// applied. The filters of the other rules, and of the rules below the
+	// minimum priority, are only validated, and compiled the first time
+	// the rules are enabled, so that they don't take up startup time and
+	// memory. Rules can still be enabled and disabled as usual, this is
+	// only a hint. By default, the rules enabled once loaded are the ones
+	// defined as enabled.
+	using rule_enabled_hint = std::function<bool(const std::string& name, const std::set<std::string>& tags, bool enabled)>;
+	void set_rule_enabled_hint(rule_enabled_hint hint);
+
 	//
 	// Return the ruleset id corresponding to this ruleset name,
 	// creating a new one if necessary. If you provide any ruleset
@@ -141,7 +202,7 @@ public:
 	// Return the number of falco rules enabled for the provided ruleset
 	// across all sources.
 	//
-	uint64_t num_rules_for_ruleset(const std::string &ruleset);
+	uint64_t num_rules_for_ruleset(const std::string &ruleset = s_default_ruleset);
 
 	//
 	// Print details on the given rule. If rule is NULL, print
@@ -149,6 +210,49 @@ public:
 	//
 	nlohmann::json describe_rule(std::string *rule_name, const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const;
 
+	//
+	// Same as describe_rule(), but writes the JSON to the given stream
+	// item by item instead of building it in memory. The details of the
+	// items are computed on as many threads as the rules are compiled with.
+	//
+	void describe_rule(std::ostream& os, std::string *rule_name, const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const;
+
+	// The receiver of the items of a description, as they're described
+	struct describe_sink;
+
+	//
+	// Return an estimate of the memory used by the loaded rules, broken
+	// down by the state holding them: the definitions collected by the
+	// rule loader and their YAML contexts, the output of the last
+	// compilation, the compiler's filter cache, the rules of the engine,
+	// their conditions and filters, and the ruleset of each source.
+	// The compiled filters are opaque, so they are reported by count
+	// and by number of field checks.
+	//
+	nlohmann::json rules_memory_report() const;
+
+	//
+	// Return an estimate of the evaluation cost of each loaded rule,
+	// without running it on any event: the predicates of its condition
+	// once macros, lists and exceptions are expanded, the values of its
+	// lists, its expensive operators and fields, and the event types it
+	// is evaluated on. The rules likely to be hot, as they are evaluated
+	// on all or high-volume event types or are expensive to evaluate,
+	// are flagged along with the reasons why, and are sorted first.
+	//
+	nlohmann::json rules_cost_report() const;
+
+	//
+	// Return an estimate of the memory held by the caches of the alert
+	// formatters of the given source: the formats of its rules and the
+	// field values they last extracted, along with the formatters
+	// created by get_formatter() for the calling thread and their values.
+	// The formatters are opaque, so only their entries are accounted for.
+	// The caches are updated while processing events, so this must be
+	// called from the thread processing the events of the source.
+	//
+	size_t formatters_memory_usage(const std::string& source) const;
+
 	//
 	// Return const /ref to rules stored in the Falco engine.
 	//
@@ -159,11 +263,77 @@ public:
 	//
 	void print_stats() const;
 
+	//
+	// Returns the evaluation profile of each rule evaluated at least
+	// once, sorted by decreasing estimated evaluation time, as a JSON
+	// array. This is empty unless rule profiling is enabled.
+	//
+	nlohmann::json rules_profile_report() const;
+
+	//
+	// Returns the slowest sampled evaluations of all the rules, slowest
+	// first, up to max entries if max is not 0, as a JSON array. Each
+	// entry has the rule name and source, the evaluation time, and the
+	// type name and timestamp of the evaluated event, so that the rules
+	// causing latency spikes can be found even when their average cost
+	// is low. This is empty unless rule profiling is enabled.
+	//
+	nlohmann::json rules_slowest_evaluations_report(size_t max) const;
+
 	//
 	// Return const /ref to stats_manager to access current rules stats (how many events matched each rule so far).
 	//
 	const stats_manager& get_rule_stats_manager() const;
 
+	//
+	// Enable/Disable the collection of per-rule evaluation costs
+	// (number of evaluations, matches, and sampled evaluation time).
+	// When enabled, the evaluation time of a rule is measured once every
+	// sampling_period evaluations. The collected data is available through
+	// get_rule_stats_manager().
+	//
+	void set_rule_profiling(bool enabled, uint32_t sampling_period);
+
+	//
+	// Set the rate limit of the alerts of all the rules with the given
+	// priority, or of the rule with the given name, which takes precedence.
+	// The rate limits defined in the rules files take precedence over both.
+	// A limit with a rate of 0 removes any limit. The alerts exceeding the
+	// limit of a rule are not returned by process_event(), and they're
+	// accounted in the rule stats manager. This applies to both the rules
+	// already loaded and the ones loaded later, and must not be invoked
+	// while events are being processed.
+	//
+	void set_rate_limit(falco_common::priority_type priority, const falco_rate_limit& limit);
+	void set_rate_limit(const std::string& rule, const falco_rate_limit& limit);
+
+	//
+	// Set the memory budget of the state of the threshold and sequence
+	// rules of each source, beyond which the keys used least recently
+	// are forgotten. The state is reset each time rules are loaded, and
+	// this applies from then on.
+	//
+	void set_rule_state_max_memory(uint64_t max_memory);
+
+	//
+	// Get the metrics of the state of the threshold and sequence rules,
+	// summed over all the sources. This is safe to call from a different
+	// thread than the ones invoking process_event().
+	//
+	void get_rule_state_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+	//
+	// Reorder the rules of each source, based on the evaluation cost
+	// and match rate collected through rule profiling, so that the rules
+	// that are cheap and likely to match are evaluated first when
+	// using the "first" rule matching strategy. Note that this may change
+	// which rule is reported when an event matches multiple rules.
+	// This is safe to call from a different thread than the ones
+	// invoking process_event(), and does nothing if rule profiling
+	// is not enabled.
+	//
+	void update_rule_ordering();
+
 	//
 	// Set the sampling ratio, which can affect which events are
 	// matched against the set of rules.
@@ -176,6 +346,22 @@ public:
 	//
 	void set_sampling_multiplier(double sampling_multiplier);
 
+	//
+	// Set the seed of the sampling. The events of each source are
+	// sampled deterministically given the seed, so that processing
+	// the same events with the same seed samples the same ones. The
+	// seed is random unless the engine was created without seeding.
+	//
+	void set_sampling_seed(uint64_t seed);
+
+	//
+	// Restrict the sampling to the events of the given sources and
+	// types, where an empty set stands for all of them. The other
+	// events are always matched against the set of rules.
+	//
+	void set_sampling_scope(const std::unordered_set<std::string>& sources,
+		const libsinsp::events::set<ppm_event_code>& event_types);
+
 	//
 	// You can optionally add "extra" formatting fields to the end
 	// of all output expressions. You can also choose to replace
@@ -190,12 +376,53 @@ public:
 	// rules.
 	struct rule_result {
 		sinsp_evt *evt;
-		std::string rule;
-		std::string source;
+		falco::interned_string rule;
+		falco::interned_string source;
 		falco_common::priority_type priority_num;
-		std::string format;
+		falco::interned_string format;
 		std::set<std::string> exception_fields;
-		std::set<std::string> tags;
+		falco::interned_tags tags;
+	};
+
+	// Lightweight representation of the result of matching an
+	// event against a set of rules. Instead of copying the rule
+	// details, it points to the immutable rule stored in the
+	// engine (see get_rules()), which stays valid until the next
+	// invocation of load_rules().
+	struct rule_match {
+		sinsp_evt *evt;
+		const falco_rule *rule;
+	};
+
+	//
+	// A rule matching an event in one or more rulesets, as returned
+	// by process_event_multi(). The rulesets are a bitmask in which bit
+	// i stands for the ruleset with id i.
+	//
+	struct multi_rule_match {
+		sinsp_evt *evt;
+		const falco_rule *rule;
+		uint64_t rulesets;
+	};
+
+	//
+	// An event source resolved once, so that processing its events
+	// doesn't look it up every time (see get_source_handle()). A
+	// handle stays valid until the next invocation of add_source().
+	//
+	class source_handle {
+	public:
+		source_handle() = default;
+
+		inline explicit operator bool() const
+		{
+			return m_source != nullptr;
+		}
+
+	private:
+		friend class falco_engine;
+		explicit source_handle(const falco_source* source): m_source(source) {}
+		const falco_source* m_source = nullptr;
 	};
 
 	//
@@ -222,6 +449,14 @@ public:
 	// event source is not thread-safe of its own, so invoking this method
 	// concurrently with the same source_idx would inherently cause data races
 	// and lead to undefined behavior.
+	// This is also why the events of a source can't be spread across
+	// multiple evaluation threads, even with a ruleset (and compiled
+	// filters) for each thread: the conditions read the state of the
+	// inspector that produced the event, such as its thread and fd tables,
+	// which only matches the event until the inspector parses the next one,
+	// and neither the lookups into that state nor the per-event caches of
+	// sinsp_evt are thread-safe. Spreading a source across cores would first
+	// require the inspector to share or snapshot its state per thread.
 	std::unique_ptr<std::vector<rule_result>> process_event(std::size_t source_idx,
 		sinsp_evt *ev, uint16_t ruleset_id, falco_common::rule_matching strategy);
 
@@ -233,6 +468,97 @@ public:
 	std::unique_ptr<std::vector<rule_result>> process_event(std::size_t source_idx,
 		sinsp_evt *ev, falco_common::rule_matching strategy);
 
+	//
+	// Same as process_event() above, but instead of allocating a new
+	// result for every matching event, fills the caller-owned matches
+	// vector, which gets cleared first. Reusing the same vector across
+	// invocations avoids any heap allocation on the hot path.
+	// Returns true if at least one rule matched the event.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_event(std::size_t source_idx,
+		sinsp_evt *ev, uint16_t ruleset_id, falco_common::rule_matching strategy,
+		std::vector<rule_match>& matches);
+
+	//
+	// Wrapper assuming the default ruleset.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_event(std::size_t source_idx,
+		sinsp_evt *ev, falco_common::rule_matching strategy,
+		std::vector<rule_match>& matches);
+
+	//
+	// Same as process_event() above, but with a source previously
+	// resolved with get_source_handle(), which is the cheapest way to
+	// process the events of the same source one after the other.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_event(const source_handle& source,
+		sinsp_evt *ev, uint16_t ruleset_id, falco_common::rule_matching strategy,
+		std::vector<rule_match>& matches);
+
+	//
+	// Wrapper assuming the default ruleset.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_event(const source_handle& source,
+		sinsp_evt *ev, falco_common::rule_matching strategy,
+		std::vector<rule_match>& matches);
+
+	//
+	// Same as process_event() above, but finds all the matches of the
+	// event in multiple rulesets at once, given as a bitmask of ruleset
+	// ids (see find_ruleset_id()), which must be lower than 64. Each rule
+	// is evaluated once regardless of the number of rulesets enabling it,
+	// which is cheaper than one process_event() per ruleset when serving
+	// different policies out of the same rules. Each matching rule is
+	// reported once, with the rulesets in which it matched, and is
+	// subject to the rate limits only once.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_event_multi(std::size_t source_idx,
+		sinsp_evt *ev, uint64_t ruleset_mask,
+		std::vector<multi_rule_match>& matches);
+
+	//
+	// Same as process_event() above, but processes a batch of events
+	// of a given source at once, which allows the ruleset to amortize
+	// the evaluation costs across events. The events (and the related
+	// state, such as the thread and fd info) must stay valid until this
+	// method returns. The matches vector is cleared first, and is then
+	// filled-out with the matching rules ordered by event.
+	// Returns true if at least one rule matched one of the events.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_events(std::size_t source_idx,
+		sinsp_evt *const *evts, std::size_t num_evts, uint16_t ruleset_id,
+		falco_common::rule_matching strategy,
+		std::vector<rule_match>& matches);
+
+	//
+	// Wrapper assuming the default ruleset.
+	//
+	// This inherits the same thread-safety guarantees.
+	//
+	bool process_events(std::size_t source_idx,
+		sinsp_evt *const *evts, std::size_t num_evts,
+		falco_common::rule_matching strategy,
+		std::vector<rule_match>& matches);
+
+	//
+	// Returns the handle of the source with the given index, as
+	// returned by add_source(), to be passed to process_event().
+	// Throws a falco_exception if the source doesn't exist.
+	//
+	source_handle get_source_handle(std::size_t source_idx);
+
 	//
 	// Configure the engine to support events with the provided
 	// source, with the provided filter factory and formatter factory.
@@ -262,6 +588,16 @@ public:
 	std::shared_ptr<sinsp_filter_factory> filter_factory_for_source(const std::string& source);
 	std::shared_ptr<sinsp_filter_factory> filter_factory_for_source(std::size_t source_idx);
 
+	//
+	// Set the function creating new filter factories for the given
+	// source, equivalent to the one it was added with. The conditions of
+	// the rules of the sources having one can be compiled by several
+	// threads, each using its own filter factory.
+	// Throws a falco_exception if the source doesn't exist.
+	//
+	void set_filter_factory_creator(std::size_t source_idx,
+			       falco_source::filter_factory_creator creator);
+
 	//
 	// Given a source, return a formatter factory that can create
 	// formatters for an event.
@@ -299,6 +635,34 @@ public:
 				  const std::string &source,
 				  const std::string &ruleset = s_default_ruleset);
 	
+	//
+	// Given an event source and ruleset, return the set of ppm_sc_codes
+	// for which each of the enabled rules can run and match events,
+	// indexed by rule name.
+	//
+	std::map<std::string, libsinsp::events::set<ppm_sc_code>> sc_codes_by_rule_for_ruleset(
+				  const std::string &source,
+				  const std::string &ruleset = s_default_ruleset);
+
+	//
+	// The filtering that the kernel drivers can apply on behalf of the
+	// rules enabled in a ruleset without changing what they match,
+	// i.e. the predicates that all of them require at the top level of
+	// their conditions and that a driver can evaluate. For now, this is
+	// only whether failed syscalls can be dropped before their exit
+	// event reaches userspace, as every rule requires a successful result
+	// (evt.res = SUCCESS, evt.failed = false, evt.rawres >= 0).
+	//
+	struct kernel_prefilter
+	{
+		bool drop_failed_exit = false;
+		// the enabled rules not requiring a successful result
+		std::vector<std::string> unfiltered_rules;
+	};
+	kernel_prefilter kernel_prefilter_for_ruleset(
+				  const std::string &source,
+				  const std::string &ruleset = s_default_ruleset);
+
 	//
 	// Given an event source and ruleset, return the set of ppm_event_codes
 	// for which this ruleset can run and match events.
@@ -307,6 +671,14 @@ public:
 				  const std::string &source,
 				  const std::string &ruleset = s_default_ruleset);
 
+	//
+	// Return a number that changes every time the rules are loaded,
+	// enabled or disabled, so that the callers caching the results of
+	// event_codes_for_ruleset() can tell when to compute them again.
+	// It can be called from any thread.
+	//
+	uint64_t rules_generation() const;
+
 	//
 	// Given a source and output string, return an
 	// sinsp_evt_formatter that can format output strings for an
@@ -315,6 +687,64 @@ public:
 	std::shared_ptr<sinsp_evt_formatter> create_formatter(const std::string &source,
 							      const std::string &output) const;
 
+	//
+	// Same as create_formatter, but reuses the formatter previously
+	// created by the calling thread for the same source and output
+	// string, if any. This can be invoked from any thread, and each
+	// thread gets formatters of its own.
+	//
+	std::shared_ptr<sinsp_evt_formatter> get_formatter(const std::string &source,
+							   const std::string &output) const;
+
+	//
+	// Returns the values of the fields of the given output string
+	// extracted from an event. The values are cached, so that they are
+	// extracted only once for the same event and output string, and
+	// stay valid until the calling thread requests values for another
+	// event of the same source. Throws a falco_exception if not all
+	// fields can be extracted. This can be invoked from any thread, and
+	// the values are cached per thread.
+	//
+	const std::map<std::string, std::string>& get_field_values(sinsp_evt *evt,
+								   const std::string &source,
+								   const std::string &output) const;
+
+	//
+	// Set the function returning the format used for the alerts of a
+	// rule, which can be used to decorate the output of the rule (e.g.
+	// to prepend the event time and the rule priority). When not set,
+	// the output of the rule is used as-is. complete_rule_loading()
+	// compiles one formatter per rule with this format, so that alerts
+	// don't need to look up or compile formatters.
+	//
+	void set_rule_output_format(std::function<std::string(const falco_rule&)> func);
+
+	//
+	// Return the formatter compiled by complete_rule_loading() for the
+	// alerts of the rule with the given id, or nullptr if there is none
+	// (e.g. rules have been loaded since the last complete_rule_loading()).
+	// The formatter stays valid until the next invocation of load_rules().
+	//
+	std::shared_ptr<sinsp_evt_formatter> get_rule_formatter(std::size_t rule_id) const;
+
+	//
+	// Same as get_field_values(), but for the formatter returned by
+	// get_rule_formatter() for the given rule, which must not be nullptr.
+	// The values are cached per rule, and stay valid until the values are
+	// requested for another event and the same rule. This must only be
+	// invoked by the thread processing the events of the rule's source.
+	//
+	const falco::field_values& get_rule_field_values(sinsp_evt *evt,
+							 std::size_t rule_id) const;
+
+	//
+	// Return the format used to compile the formatter returned by
+	// get_rule_formatter() for the given rule, which must exist.
+	// Unlike the other rule output methods, this can be invoked from
+	// any thread while events are being processed.
+	//
+	const std::string& get_rule_output_format(std::size_t rule_id) const;
+
 	// The rule loader definition is aliased as it is exactly what we need
 	typedef rule_loader::plugin_version_info::requirement plugin_version_requirement;
 
@@ -337,6 +767,20 @@ private:
 	// Functions to retrieve state from this engine
 	void fill_engine_state_funcs(filter_ruleset::engine_state_funcs& engine_state);
 
+	// Add the rules of the last compile output to the engine and to
+	// a new ruleset for each source, enabling them in the default
+	// ruleset as decided by the given predicate
+	void add_compiled_rules(const std::function<bool(const falco_rule&)>& is_enabled);
+
+	// Returns whether a rule is enabled once loaded, and so compiled
+	// right away, see set_rule_enabled_hint()
+	bool is_enabled_once_loaded(const std::string& name, const std::set<std::string>& tags,
+		falco_common::priority_type priority, bool enabled) const;
+
+	// Returns the key of the rules cache, given the one provided
+	// by the user of the engine
+	std::string rules_cache_key(const std::string& key) const;
+
 	filter_ruleset::engine_state_funcs m_engine_state;
 
 	// Throws falco_exception if the file can not be read
@@ -344,33 +788,14 @@ private:
 
 	indexed_vector<falco_source> m_sources;
 
-	inline const falco_source* find_source(std::size_t index)
+	inline const falco_source* find_source(std::size_t index) const
 	{
-		const falco_source *source;
-
-		if(index == m_syscall_source_idx)
-		{
-			if(m_syscall_source == NULL)
-			{
-				m_syscall_source = m_sources.at(m_syscall_source_idx);
-				if(!m_syscall_source)
-				{
-					throw falco_exception("Unknown event source index " + std::to_string(index));
-				}
-			}
-
-			source = m_syscall_source;
-		}
-		else
+		auto ret = m_sources.at(index);
+		if(!ret)
 		{
-			source = m_sources.at(index);
-			if(!source)
-			{
-				throw falco_exception("Unknown event source index " + std::to_string(index));
-			}
+			throw falco_exception("Unknown event source index " + std::to_string(index));
 		}
-
-		return source;
+		return ret;
 	}
 
 	inline const falco_source* find_source(const std::string& name) const
@@ -383,35 +808,44 @@ private:
 		return ret;
 	}
 
-	// To allow the engine to be extremely fast for syscalls (can
-	// be > 1M events/sec), we save the syscall source/source_idx
-	// separately and check it explicitly in process_event()
-	const falco_source* m_syscall_source;
-	std::atomic<size_t> m_syscall_source_idx;
-
 	//
 	// Determine whether the given event should be matched at all
 	// against the set of rules, given the current sampling
-	// ratio/multiplier.
+	// ratio/multiplier and scope.
 	//
-	inline bool should_drop_evt() const;
+	inline bool should_drop_evt(const falco_source& source, sinsp_evt* evt) const;
+
+	// The filter details of the item being described by a thread, which
+	// start with the names of all the macros and lists
+	struct describe_details
+	{
+		filter_details details;
+		filter_details compiled_details;
+	};
+	void describe_rule(describe_sink& sink, std::string *rule_name, const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const;
+	void describe_items(
+		size_t count,
+		const filter_details& known,
+		const std::function<void(size_t, describe_details&, nlohmann::json&)>& describe,
+		describe_sink& sink) const;
 
 	// Retrieve json details from rules, macros, lists
 	void get_json_details(
 		nlohmann::json& out,
 		const falco_rule& r,
 		const rule_loader::rule_info& info,
-		const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const;
+		const std::vector<std::string>& out_fields,
+		const std::vector<std::shared_ptr<sinsp_plugin>>& plugins,
+		describe_details& d) const;
 	void get_json_details(
 		nlohmann::json& out,
 		const falco_macro& m,
 		const rule_loader::macro_info& info,
-		const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const;
+		describe_details& d) const;
 	void get_json_details(
 		nlohmann::json& out,
 		const falco_list& l,
-		const rule_loader::list_info& info,
-		const std::vector<std::shared_ptr<sinsp_plugin>>& plugins) const;
+		const rule_loader::list_info& info) const;
 	void get_json_evt_types(
 		nlohmann::json& out,
 		const std::string& source,
@@ -432,8 +866,64 @@ private:
 	uint16_t m_next_ruleset_id;
 	std::map<std::string, uint16_t> m_known_rulesets;
 	falco_common::priority_type m_min_priority;
+	rule_enabled_hint m_rule_enabled_hint;
 
 	std::unique_ptr<rule_loader::compile_output> m_last_compile_output;
+	bool m_rule_loading_state_released;
+
+	// The arena of the rules of the last load, see rules_arena.h
+	std::shared_ptr<falco::rules_arena::arena> m_rules_arena;
+
+	// The alert formatters of each rule by rule id, compiled by
+	// complete_rule_loading(), and the field values they extracted
+	// from the last event they have been used with, along with that
+	// event and its number. The values are only cached by
+	// get_rule_field_values(), hence mutable, which is only invoked for
+	// the rules of a source by the thread processing its events.
+	struct rule_output
+	{
+		std::string format;
+		std::shared_ptr<sinsp_evt_formatter> formatter;
+		mutable const sinsp_evt* field_values_evt = nullptr;
+		mutable uint64_t field_values_evtnum = UINT64_MAX;
+		mutable std::map<std::string, std::string> extracted;
+		mutable falco::field_values field_values;
+	};
+	std::function<std::string(const falco_rule&)> m_rule_output_format;
+	mutable std::vector<rule_output> m_rule_outputs;
+
+	// The rate limits configured in the engine, and the token bucket of
+	// each rule by rule id, or nullptr for the rules without a limit
+	struct rate_limiter
+	{
+		falco_rate_limit limit;
+		falco::token_bucket bucket;
+	};
+	std::map<falco_common::priority_type, falco_rate_limit> m_priority_rate_limits;
+	std::map<std::string, falco_rate_limit> m_rule_rate_limits;
+	std::vector<std::unique_ptr<rate_limiter>> m_rate_limiters;
+	void update_rate_limiters();
+	inline bool is_rate_limited(const falco_rule& rule, sinsp_evt* evt);
+
+	// The threshold and sequence rules by rule id, whose windows are kept
+	// in the state of the source of each rule
+	struct rule_window
+	{
+		// the values of the fields the windows of the rule are keyed
+		// by, or nullptr if there is a single window
+		std::shared_ptr<sinsp_evt_formatter> key;
+		// the ids of the sequence rules this rule is the first step of
+		std::vector<std::size_t> followers;
+	};
+	uint64_t m_rule_state_max_memory;
+	std::vector<rule_window> m_rule_windows;
+
+	// Incremented every time the rules of any source change, see rules_generation()
+	std::atomic<uint64_t> m_rules_generation{0};
+	void rules_changed();
+	void update_rule_windows();
+	inline const std::string& rule_window_key(std::size_t rule_id, const falco_source& source, sinsp_evt* evt) const;
+	inline bool is_window_pending(const falco_rule& rule, const falco_source& source, sinsp_evt* evt);
 
 	//
 	// Here's how the sampling ratio and multiplier influence
@@ -455,8 +945,17 @@ private:
 	// ratio in m_sampling_ratio.
 	//
 
+	// The sampler keeps 1/(multiplier * ratio) of the events, and its
+	// decisions follow a sequence of its own for each source. When the
+	// scope has event types, the other events are not sampled.
+	//
 	uint32_t m_sampling_ratio;
 	double m_sampling_multiplier;
+	falco::event_sampler m_sampler;
+	std::unordered_set<std::string> m_sampling_sources;
+	libsinsp::events::set<ppm_event_code> m_sampling_event_types;
+	bool m_sampling_all_event_types = true;
+	void update_sampler();
 
 	static const std::string s_default_ruleset;
 	uint32_t m_default_ruleset_id;
@@ -17,12 +17,18 @@ limitations under the License.
 
 #pragma once
 
+#include <memory>
+#include <optional>
 #include <set>
 #include <string>
+#include <vector>
 #include "falco_common.h"
+#include "interned.h"
 
 #include <libsinsp/filter/ast.h>
 
+class rule_exceptions;
+
 /*!
 	\brief Represents a list in the Falco Engine.
 	The rule ID must be unique across all the lists loaded in the engine.
@@ -61,6 +67,56 @@ struct falco_macro
 	std::shared_ptr<libsinsp::filter::ast::expr> condition;
 };
 
+/*!
+	\brief The rate limit of the alerts of a rule, enforced with a token
+	bucket that refills at rate tokens per second up to max_burst tokens,
+	with each alert consuming one token. A rate of 0 means no limit.
+*/
+struct falco_rate_limit
+{
+	double rate = 0;
+	double max_burst = 1;
+
+	inline bool operator == (const falco_rate_limit& o) const
+	{
+		return rate == o.rate && max_burst == o.max_burst;
+	}
+};
+
+/*!
+	\brief The threshold of a rule, which only alerts once it matched count
+	times within a sliding window of window_ns, counted separately for
+	each combination of the values of the by fields
+*/
+struct falco_rule_threshold
+{
+	uint64_t count = 0;
+	uint64_t window_ns = 0;
+	std::vector<std::string> by;
+
+	inline bool operator == (const falco_rule_threshold& o) const
+	{
+		return count == o.count && window_ns == o.window_ns && by == o.by;
+	}
+};
+
+/*!
+	\brief The sequence of a rule, which only alerts when it matches within
+	window_ns after the rule named after matched with the same values of
+	the by fields
+*/
+struct falco_rule_sequence
+{
+	std::string after;
+	uint64_t window_ns = 0;
+	std::vector<std::string> by;
+
+	inline bool operator == (const falco_rule_sequence& o) const
+	{
+		return after == o.after && window_ns == o.window_ns && by == o.by;
+	}
+};
+
 /*!
 	\brief Represents a rule in the Falco Engine.
 	The rule ID must be unique across all the rules loaded in the engine.
@@ -75,13 +131,36 @@ struct falco_rule
 	~falco_rule() = default;
 
 	std::size_t id;
-	std::string source;
-	std::string name;
+	falco::interned_string source;
+	falco::interned_string name;
 	std::string description;
-	std::string output;
-	std::set<std::string> tags;
+	falco::interned_string output;
+	falco::interned_tags tags;
 	std::set<std::string> exception_fields;
 	falco_common::priority_type priority;
 	std::shared_ptr<libsinsp::filter::ast::expr> condition;
+
+	// the filter compiled from the condition, or nullptr if the rule is
+	// compiled lazily, as it's not enabled once loaded. Its condition is
+	// still validated, and rulesets compile its filter, along with its
+	// exceptions, the first time it's enabled, see
+	// rule_loader::compiler::compile_evaluation_filter()
 	std::shared_ptr<sinsp_filter> filter;
+
+	// the exceptions of the condition compiled separately, along with
+	// the filter of its base condition, or nullptr if there are none.
+	// Rulesets may evaluate them in place of filter, which is always
+	// equivalent to the whole condition.
+	std::shared_ptr<rule_exceptions> exceptions;
+
+	// the number of exceptions appended to the condition
+	size_t num_exceptions = 0;
+
+	// the limit defined by the rule itself, which takes precedence
+	// over the ones configured in the engine
+	std::optional<falco_rate_limit> rate_limit;
+
+	// the window the rule alerts on, if any, in place of each match
+	std::optional<falco_rule_threshold> threshold;
+	std::optional<falco_rule_sequence> sequence;
 };
@@ -17,8 +17,15 @@ limitations under the License.
 
 #pragma once
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include "filter_ruleset.h"
+#include "rule_state.h"
 
 /*!
 	\brief Represents a given data source used by the engine.
@@ -27,6 +34,8 @@ limitations under the License.
 */
 struct falco_source
 {
+	typedef std::function<std::shared_ptr<sinsp_filter_factory>()> filter_factory_creator;
+
 	falco_source() = default;
 	falco_source(falco_source&&) = default;
 	falco_source& operator = (falco_source&&) = default;
@@ -35,14 +44,18 @@ struct falco_source
 		ruleset(s.ruleset),
 		ruleset_factory(s.ruleset_factory),
 		filter_factory(s.filter_factory),
-		formatter_factory(s.formatter_factory) { };
+		new_filter_factory(s.new_filter_factory),
+		formatter_factory(s.formatter_factory),
+		sampled(s.sampled) { };
 	falco_source& operator = (const falco_source& s)
 	{
 		name = s.name;
 		ruleset = s.ruleset;
 		ruleset_factory = s.ruleset_factory;
 		filter_factory = s.filter_factory;
+		new_filter_factory = s.new_filter_factory;
 		formatter_factory = s.formatter_factory;
+		sampled = s.sampled;
 		return *this;
 	};
 
@@ -50,11 +63,66 @@ struct falco_source
 	std::shared_ptr<filter_ruleset> ruleset;
 	std::shared_ptr<filter_ruleset_factory> ruleset_factory;
 	std::shared_ptr<sinsp_filter_factory> filter_factory;
+
+	// Creates another filter factory equivalent to filter_factory, if
+	// set. The conditions of the rules are only compiled by several
+	// threads for the sources having one, each thread using its own.
+	filter_factory_creator new_filter_factory;
+
 	std::shared_ptr<sinsp_evt_formatter_factory> formatter_factory;
 
+	// Whether the events of the source are subject to the sampling of
+	// the engine, and the number of sampling decisions taken so far
+	bool sampled = true;
+	mutable uint64_t m_sampling_counter = 0;
+
 	// Used by the filter_ruleset interface. Filled in when a rule
-	// matches an event.
-	mutable std::vector<falco_rule> m_rules;
+	// matches an event. The pointed rules are owned by the ruleset.
+	mutable std::vector<const falco_rule*> m_rules;
+
+	// Used by falco_engine::process_event_multi()
+	mutable std::vector<filter_ruleset::multi_match> m_multi_matches;
+
+	// Used by falco_engine::process_events() to batch events
+	mutable std::vector<sinsp_evt*> m_batch_evts;
+	mutable std::vector<bool> m_batch_matched;
+	mutable std::vector<filter_ruleset::batch_match> m_batch_matches;
+
+	// The caches of falco_engine::get_formatter() and get_field_values()
+	// for a thread, which are kept per thread as the formatters can't be
+	// used by several threads at once
+	struct formatters_cache
+	{
+		// Output formatters created so far, by output format. Used to
+		// avoid compiling the same format again each time a rule
+		// matches an event.
+		std::unordered_map<std::string, std::shared_ptr<sinsp_evt_formatter>> formatters;
+
+		// Field values extracted from the event evt with number
+		// evtnum, by output format. Reset each time values are
+		// requested for a different event.
+		const sinsp_evt* evt = nullptr;
+		uint64_t evtnum = UINT64_MAX;
+		std::unordered_map<std::string, std::map<std::string, std::string>> field_values;
+	};
+
+	// Returns the caches of the calling thread, which stay valid as long
+	// as the source. Their entries are only used by that thread, and the
+	// lock only guards the map of the threads.
+	inline formatters_cache& thread_formatters_cache() const
+	{
+		std::lock_guard<std::mutex> lk(*m_formatters_caches_mtx);
+		return m_formatters_caches[std::this_thread::get_id()];
+	}
+
+	mutable std::unique_ptr<std::mutex> m_formatters_caches_mtx = std::make_unique<std::mutex>();
+	mutable std::unordered_map<std::thread::id, formatters_cache> m_formatters_caches;
+
+	// The state of the threshold and sequence rules of this source, which
+	// is not copied along with it, and the key of the last window looked up
+	mutable std::unique_ptr<falco::rule_state> m_rule_state;
+	mutable std::string m_rule_state_key;
+	mutable std::string m_rule_state_values;
 
 	inline bool is_valid_lhs_field(const std::string& field) const
 	{
@@ -25,8 +25,11 @@ limitations under the License.
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
 #include <openssl/sha.h>
 #endif
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <ctime>
 #include <iomanip>
 #include <thread>
 
@@ -120,6 +123,19 @@ uint64_t parse_prometheus_interval(std::string interval_str)
 }
 
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+static std::string sha256_hex(SHA256_CTX& sha256_context)
+{
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	SHA256_Final(digest, &sha256_context);
+
+	std::stringstream ss;
+	for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i)
+	{
+		ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned>(digest[i]);
+	}
+	return ss.str();
+}
+
 std::string calculate_file_sha256sum(const std::string& filename)
 {
 	std::ifstream file(filename, std::ios::binary);
@@ -139,15 +155,15 @@ std::string calculate_file_sha256sum(const std::string& filename)
 	}
 	SHA256_Update(&sha256_context, buffer, file.gcount());
 
-	unsigned char digest[SHA256_DIGEST_LENGTH];
-	SHA256_Final(digest, &sha256_context);
+	return sha256_hex(sha256_context);
+}
 
-	std::stringstream ss;
-	for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i)
-	{
-		ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned>(digest[i]);
-	}
-	return ss.str();
+std::string calculate_sha256sum(const std::string& data)
+{
+	SHA256_CTX sha256_context;
+	SHA256_Init(&sha256_context);
+	SHA256_Update(&sha256_context, data.data(), data.size());
+	return sha256_hex(sha256_context);
 }
 #endif
 
@@ -209,6 +225,46 @@ void readfile(const std::string& filename, std::string& data)
 	return;
 }
 
+// the CPU numbers are bounded to reject the lists that are obviously wrong
+// before expanding them
+static const uint32_t s_max_cpus = 1 << 16;
+
+bool parse_cpu_list(const std::string& list, std::vector<uint32_t>& cpus)
+{
+	cpus.clear();
+	std::stringstream ss(list);
+	std::string range;
+	while(std::getline(ss, range, ','))
+	{
+		uint32_t first = 0;
+		uint32_t last = 0;
+		char dash = 0;
+		char extra = 0;
+		int n = sscanf(range.c_str(), " %u %c %u %c", &first, &dash, &last, &extra);
+		if(n == 1)
+		{
+			last = first;
+		}
+		else if(n != 3 || dash != '-' || last < first)
+		{
+			return false;
+		}
+		if(range.find_first_not_of(" -0123456789") != std::string::npos
+			|| range.find_first_not_of(" ") == range.find('-')
+			|| last >= s_max_cpus)
+		{
+			return false;
+		}
+		for(uint32_t cpu = first; cpu <= last; cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return !cpus.empty();
+}
+
 bool matches_wildcard(const std::string &pattern, const std::string &s)
 {
 	std::string::size_type star_pos = pattern.find("*");
@@ -251,6 +307,75 @@ bool matches_wildcard(const std::string &pattern, const std::string &s)
 	}
 }
 
+void append_json_string(std::string& out, const std::string& s)
+{
+	static const char* hex = "0123456789abcdef";
+	out += '"';
+	for(char c : s)
+	{
+		switch(c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20)
+			{
+				out += "\\u00";
+				out += hex[(c >> 4) & 0xf];
+				out += hex[c & 0xf];
+			}
+			else
+			{
+				out += c;
+			}
+		}
+	}
+	out += '"';
+}
+
+const char* iso8601_utc_seconds(int64_t secs)
+{
+	thread_local int64_t s_secs = INT64_MIN;
+	thread_local char s_buf[sizeof("YYYY-MM-DDTHH:MM:SS")] = {};
+	if(secs != s_secs)
+	{
+		time_t t = (time_t) secs;
+		struct tm tm = {};
+#ifdef _WIN32
+		gmtime_s(&tm, &t);
+#else
+		gmtime_r(&t, &tm);
+#endif
+		strftime(s_buf, sizeof(s_buf), "%FT%T", &tm);
+		s_secs = secs;
+	}
+	return s_buf;
+}
+
+void append_iso8601_utc(std::string& out, uint64_t ts, uint32_t frac_digits)
+{
+	out += iso8601_utc_seconds((int64_t) (ts / 1000000000));
+	if(frac_digits > 0)
+	{
+		frac_digits = std::min<uint32_t>(frac_digits, 9);
+		char frac[10];
+		uint32_t ns = ts % 1000000000;
+		for(int i = 8; i >= 0; i--)
+		{
+			frac[i] = '0' + ns % 10;
+			ns /= 10;
+		}
+		out += '.';
+		out.append(frac, frac_digits);
+	}
+	out += 'Z';
+}
+
 namespace network
 {
 bool is_unix_scheme(const std::string& url)
@@ -22,6 +22,7 @@ limitations under the License.
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace falco::utils
 {
@@ -29,6 +30,8 @@ uint64_t parse_prometheus_interval(std::string interval_str);
 
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
 std::string calculate_file_sha256sum(const std::string& filename);
+
+std::string calculate_sha256sum(const std::string& data);
 #endif
 
 std::string sanitize_metric_name(const std::string& name);
@@ -39,8 +42,27 @@ void readfile(const std::string& filename, std::string& data);
 
 uint32_t hardware_concurrency();
 
+// Parses a list of CPUs in the format of the Linux cpusets, e.g. "0-3,8",
+// into the sorted and unique CPU numbers. Returns false if it's malformed.
+bool parse_cpu_list(const std::string& list, std::vector<uint32_t>& cpus);
+
 bool matches_wildcard(const std::string &pattern, const std::string &s);
 
+// Appends s to out as a quoted JSON string, escaping the characters that
+// JSON requires to be escaped. Non-ASCII characters are left untouched.
+void append_json_string(std::string& out, const std::string& s);
+
+// Returns the UTC date and time of secs since the epoch as ISO 8601, e.g.
+// "2024-01-02T03:04:05". The last rendering of each thread is cached, so
+// that rendering the times of the same second again is free. The result
+// stays valid until the next call in the same thread.
+const char* iso8601_utc_seconds(int64_t secs);
+
+// Appends the UTC time of ts, in nanoseconds since the epoch, as ISO 8601
+// with the given number of fractional digits (at most 9) followed by "Z",
+// e.g. "2024-01-02T03:04:05.123456789Z"
+void append_iso8601_utc(std::string& out, uint64_t ts, uint32_t frac_digits = 9);
+
 namespace network
 {
 static const std::string UNIX_SCHEME("unix://");
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "field_values.h"
+#include "falco_common.h"
+#include "falco_utils.h"
+
+#include <charconv>
+
+template<typename T>
+static inline void append_number(std::string& out, T v)
+{
+	char buf[24];
+	auto res = std::to_chars(buf, buf + sizeof(buf), v);
+	out.append(buf, res.ptr - buf);
+}
+
+// reuses the interned name of the slot when it's already the right one,
+// which is the common case for lists recycled for the same rule
+static inline falco::field_value& assign_slot(falco::field_values& dst, size_t i, const std::string& name)
+{
+	if(i == dst.size())
+	{
+		dst.emplace_back(name, falco::field_value());
+	}
+	else if(dst[i].first != name)
+	{
+		dst[i].first = name;
+	}
+	return dst[i].second;
+}
+
+void falco::field_value::append_text(std::string& out) const
+{
+	switch(type)
+	{
+	case FV_STRING:
+		out += str;
+		break;
+	case FV_INT:
+		append_number(out, i);
+		break;
+	case FV_UINT:
+		append_number(out, u);
+		break;
+	case FV_DOUBLE:
+		// keep the exact representation used by nlohmann::json
+		out += nlohmann::json(d).dump();
+		break;
+	case FV_BOOL:
+		out += b ? "true" : "false";
+		break;
+	case FV_NULL:
+		out += "null";
+		break;
+	}
+}
+
+void falco::field_value::append_json(std::string& out) const
+{
+	if(type == FV_STRING)
+	{
+		falco::utils::append_json_string(out, str);
+		return;
+	}
+	append_text(out);
+}
+
+void falco::assign_field_values(field_values& dst, const std::map<std::string, std::string>& src)
+{
+	size_t i = 0;
+	for(const auto& f : src)
+	{
+		auto& v = assign_slot(dst, i++, f.first);
+		v.type = field_value::FV_STRING;
+		v.str = f.second;
+	}
+	dst.resize(i);
+}
+
+void falco::assign_field_values(field_values& dst, const nlohmann::json& src)
+{
+	if(!src.is_object())
+	{
+		throw falco_exception("output fields must be key-value maps");
+	}
+
+	size_t i = 0;
+	for(const auto& f : src.items())
+	{
+		const auto& j = f.value();
+		if(!j.is_primitive())
+		{
+			throw falco_exception("output fields must be key-value maps");
+		}
+
+		auto& v = assign_slot(dst, i++, f.key());
+		v.str.clear();
+		switch(j.type())
+		{
+		case nlohmann::json::value_t::string:
+			v.type = field_value::FV_STRING;
+			v.str = j.get_ref<const std::string&>();
+			break;
+		case nlohmann::json::value_t::number_integer:
+			v.type = field_value::FV_INT;
+			v.i = j.get<int64_t>();
+			break;
+		case nlohmann::json::value_t::number_unsigned:
+			v.type = field_value::FV_UINT;
+			v.u = j.get<uint64_t>();
+			break;
+		case nlohmann::json::value_t::number_float:
+			v.type = field_value::FV_DOUBLE;
+			v.d = j.get<double>();
+			break;
+		case nlohmann::json::value_t::boolean:
+			v.type = field_value::FV_BOOL;
+			v.b = j.get<bool>();
+			break;
+		default:
+			v.type = field_value::FV_NULL;
+			break;
+		}
+	}
+	dst.resize(i);
+}
+
+void falco::append_json(std::string& out, const field_values& fields)
+{
+	out += '{';
+	bool first = true;
+	for(const auto& f : fields)
+	{
+		if(!first)
+		{
+			out += ',';
+		}
+		first = false;
+		falco::utils::append_json_string(out, f.first);
+		out += ':';
+		f.second.append_json(out);
+	}
+	out += '}';
+}
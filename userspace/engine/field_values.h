@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "interned.h"
+
+namespace falco
+{
+
+/*!
+	\brief The value of an output field. The fields extracted from
+	events are always strings, whereas the ones of the internal messages
+	can also be numbers, booleans, or null.
+*/
+struct field_value
+{
+	enum value_type : uint8_t
+	{
+		FV_STRING = 0,
+		FV_INT = 1,
+		FV_UINT = 2,
+		FV_DOUBLE = 3,
+		FV_BOOL = 4,
+		FV_NULL = 5,
+	};
+
+	value_type type = FV_STRING;
+	std::string str;
+	union
+	{
+		int64_t i;
+		uint64_t u;
+		double d;
+		bool b;
+	};
+
+	field_value(): u(0) { }
+
+	/*!
+		\brief Appends the value to out as plain text, with strings
+		as-is and the other values as their JSON representation
+	*/
+	void append_text(std::string& out) const;
+
+	/*!
+		\brief Appends the value to out as JSON
+	*/
+	void append_json(std::string& out) const;
+};
+
+/*!
+	\brief The output fields of an alert, as (field name, value) pairs.
+	The field names come from the rule outputs and the internal messages,
+	so there's a small and bounded set of them, and they're interned.
+	Assigning to a list that already holds the same fields reuses the
+	storage of their values, which is what makes recycled lists cheap.
+*/
+using field_values = std::vector<std::pair<interned_string, field_value>>;
+
+/*!
+	\brief Replaces the contents of dst with the string values in src,
+	reusing the storage and the interned names already in dst
+*/
+void assign_field_values(field_values& dst, const std::map<std::string, std::string>& src);
+
+/*!
+	\brief Replaces the contents of dst with the values of a JSON object,
+	throwing a falco_exception if it's not an object of primitive values
+*/
+void assign_field_values(field_values& dst, const nlohmann::json& src);
+
+/*!
+	\brief Appends the fields to out as a JSON object
+*/
+void append_json(std::string& out, const field_values& fields);
+
+} // namespace falco
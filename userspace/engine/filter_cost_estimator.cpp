@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "filter_cost_estimator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace libsinsp::filter;
+
+// The cost of the operators slower than a plain comparison, relative to
+// it: the ones scanning strings or matching patterns
+static const std::unordered_map<std::string, uint64_t> s_operator_costs = {
+	{"contains", 2},
+	{"bcontains", 2},
+	{"endswith", 2},
+	{"icontains", 4},
+	{"pmatch", 4},
+	{"glob", 8},
+	{"regex", 20},
+};
+
+// The fields looking up the ancestors of the process, up to the whole
+// process tree when they have no index
+static const std::unordered_set<std::string> s_expensive_fields = {
+	"proc.aname",
+	"proc.apid",
+	"proc.aexe",
+	"proc.aexepath",
+	"proc.acmdline",
+};
+
+static const uint64_t s_expensive_field_cost = 5;
+static const uint64_t s_transformer_cost = 2;
+
+// the values of a list are hashed, so only the largest lists add
+// significantly to the comparisons
+static const uint64_t s_list_values_per_cost = 100;
+
+void filter_cost::reset()
+{
+	predicates = 0;
+	list_values = 0;
+	largest_list = 0;
+	expensive_operators.clear();
+	expensive_fields.clear();
+	transformers.clear();
+	cost = 0;
+}
+
+void filter_cost_estimator::run(ast::expr* filter, filter_cost& cost)
+{
+	visitor v(cost);
+	filter->accept(&v);
+}
+
+void filter_cost_estimator::visitor::visit(ast::and_expr* e)
+{
+	for(size_t i = 0; i < e->children.size(); i++)
+	{
+		e->children[i]->accept(this);
+	}
+}
+
+void filter_cost_estimator::visitor::visit(ast::or_expr* e)
+{
+	for(size_t i = 0; i < e->children.size(); i++)
+	{
+		e->children[i]->accept(this);
+	}
+}
+
+void filter_cost_estimator::visitor::visit(ast::not_expr* e)
+{
+	e->child->accept(this);
+}
+
+void filter_cost_estimator::visitor::visit(ast::list_expr* e)
+{
+	if(m_expect_list)
+	{
+		uint64_t size = e->values.size();
+		m_cost.list_values += size;
+		m_cost.largest_list = std::max(m_cost.largest_list, size);
+		m_cost.cost += size / s_list_values_per_cost;
+	}
+}
+
+void filter_cost_estimator::visitor::visit(ast::binary_check_expr* e)
+{
+	m_last_node_field_name.clear();
+	m_expect_list = false;
+	e->left->accept(this);
+	if (m_last_node_field_name.empty())
+	{
+		throw std::runtime_error("can't find field info in binary check expression");
+	}
+
+	m_cost.predicates++;
+	auto op = s_operator_costs.find(e->op);
+	if(op != s_operator_costs.end())
+	{
+		m_cost.expensive_operators.insert(e->op);
+		m_cost.cost += op->second;
+	}
+	else
+	{
+		m_cost.cost++;
+	}
+
+	m_expect_list = true;
+	e->right->accept(this);
+	m_expect_list = false;
+}
+
+void filter_cost_estimator::visitor::visit(ast::unary_check_expr* e)
+{
+	m_last_node_field_name.clear();
+	e->left->accept(this);
+	if (m_last_node_field_name.empty())
+	{
+		throw std::runtime_error("can't find field info in unary check expression");
+	}
+	m_cost.predicates++;
+	m_cost.cost++;
+}
+
+void filter_cost_estimator::visitor::visit(ast::identifier_expr*)
+{
+}
+
+void filter_cost_estimator::visitor::visit(ast::value_expr*)
+{
+}
+
+void filter_cost_estimator::visitor::visit(ast::field_expr* e)
+{
+	m_last_node_field_name = e->field;
+	if(s_expensive_fields.find(e->field) != s_expensive_fields.end())
+	{
+		m_cost.expensive_fields.insert(e->field);
+		m_cost.cost += s_expensive_field_cost;
+	}
+}
+
+void filter_cost_estimator::visitor::visit(ast::field_transformer_expr* e)
+{
+	m_cost.transformers.insert(e->transformer);
+	m_cost.cost += s_transformer_cost;
+	e->value->accept(this);
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/filter/parser.h>
+#include <cstdint>
+#include <set>
+#include <string>
+
+struct filter_cost
+{
+	// the field checks of the filter
+	uint64_t predicates = 0;
+	// the values of the lists compared with a field, e.g. with "in"
+	uint64_t list_values = 0;
+	uint64_t largest_list = 0;
+	// the operators matching patterns or substrings, e.g. "glob"
+	std::set<std::string> expensive_operators;
+	// the fields walking the process tree, e.g. "proc.aname"
+	std::set<std::string> expensive_fields;
+	std::set<std::string> transformers;
+	// the estimated cost of evaluating the whole filter, in units of
+	// one plain field comparison, as if no check short-circuited it
+	uint64_t cost = 0;
+
+	void reset();
+};
+
+/*!
+	\brief Helper class for estimating the cost of evaluating rules'
+	filters, without running them on any event.
+*/
+class filter_cost_estimator
+{
+public:
+	/*!
+		\brief Visits a filter AST and estimates its evaluation cost.
+		The filter is expected to have its macros and lists already
+		expanded, as the conditions of the compiled rules do.
+		\param filter The filter AST to be processed.
+		\param cost The estimate, which is added to the one already in it.
+	*/
+	void run(libsinsp::filter::ast::expr* filter, filter_cost& cost);
+
+private:
+	struct visitor : public libsinsp::filter::ast::expr_visitor
+	{
+		explicit visitor(filter_cost& cost) :
+			m_cost(cost),
+			m_expect_list(false),
+			m_last_node_field_name() {}
+		visitor(visitor&&) = default;
+		visitor(const visitor&) = delete;
+
+		void visit(libsinsp::filter::ast::and_expr* e) override;
+		void visit(libsinsp::filter::ast::or_expr* e) override;
+		void visit(libsinsp::filter::ast::not_expr* e) override;
+		void visit(libsinsp::filter::ast::identifier_expr* e) override;
+		void visit(libsinsp::filter::ast::value_expr* e) override;
+		void visit(libsinsp::filter::ast::list_expr* e) override;
+		void visit(libsinsp::filter::ast::unary_check_expr* e) override;
+		void visit(libsinsp::filter::ast::binary_check_expr* e) override;
+		void visit(libsinsp::filter::ast::field_expr* e) override;
+		void visit(libsinsp::filter::ast::field_transformer_expr* e) override;
+
+		filter_cost& m_cost;
+		bool m_expect_list;
+		std::string m_last_node_field_name;
+	};
+};
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "filter_flattener.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace libsinsp::filter;
+
+bool filter_flattener::run(std::shared_ptr<ast::expr>& filter) const
+{
+	if(!filter)
+	{
+		return false;
+	}
+
+	std::unique_ptr<ast::expr> e = ast::clone(filter.get());
+	if(!flatten(e))
+	{
+		return false;
+	}
+
+	filter = std::move(e);
+	return true;
+}
+
+template<typename T>
+bool filter_flattener::flatten_children(std::unique_ptr<ast::expr>& e, T* n) const
+{
+	bool changed = false;
+	std::vector<std::unique_ptr<ast::expr>> children;
+	std::unordered_set<std::string> unique;
+	for(auto& c : n->children)
+	{
+		changed |= flatten(c);
+
+		// operands of nested expressions of the same kind are moved up,
+		// they have already been flattened and deduplicated
+		std::vector<std::unique_ptr<ast::expr>> moved;
+		auto nested = dynamic_cast<T*>(c.get());
+		if(nested)
+		{
+			moved = std::move(nested->children);
+			changed = true;
+		}
+		else
+		{
+			moved.push_back(std::move(c));
+		}
+
+		for(auto& m : moved)
+		{
+			if(!unique.insert(ast::as_string(m.get())).second)
+			{
+				changed = true;
+				continue;
+			}
+			children.push_back(std::move(m));
+		}
+	}
+	n->children = std::move(children);
+
+	if(n->children.size() == 1)
+	{
+		e = std::move(n->children[0]);
+		return true;
+	}
+	return changed;
+}
+
+bool filter_flattener::flatten(std::unique_ptr<ast::expr>& e) const
+{
+	if(auto n = dynamic_cast<ast::not_expr*>(e.get()))
+	{
+		bool changed = flatten(n->child);
+		auto nested = dynamic_cast<ast::not_expr*>(n->child.get());
+		if(nested)
+		{
+			e = std::move(nested->child);
+			return true;
+		}
+		return changed;
+	}
+
+	if(auto n = dynamic_cast<ast::and_expr*>(e.get()))
+	{
+		return flatten_children(e, n);
+	}
+
+	if(auto n = dynamic_cast<ast::or_expr*>(e.get()))
+	{
+		return flatten_children(e, n);
+	}
+
+	return false;
+}
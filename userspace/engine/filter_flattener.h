@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/filter/parser.h>
+#include <memory>
+
+/*!
+	\brief Simplifies the shape of filter ASTs, which after macro expansion
+	tend to be deeply nested, so that they compile into filters with less
+	nodes to be evaluated. This flattens "and" expressions nested inside
+	"and" expressions (and the same for "or"), removes duplicate operands
+	of the same "and"/"or" expression, removes double negations, and
+	replaces "and"/"or" expressions having a single operand with the
+	operand itself. All transformations are semantically equivalent.
+*/
+class filter_flattener
+{
+public:
+	/*!
+		\brief Visits a filter AST and simplifies it.
+		\param filter The filter AST to be processed. The AST is not
+		modified, but if it can be simplified the pointer is replaced
+		with a new simplified AST.
+		\return true if the AST has been simplified
+	*/
+	bool run(std::shared_ptr<libsinsp::filter::ast::expr>& filter) const;
+
+private:
+	bool flatten(std::unique_ptr<libsinsp::filter::ast::expr>& e) const;
+
+	template<typename T>
+	bool flatten_children(std::unique_ptr<libsinsp::filter::ast::expr>& e, T* n) const;
+};
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "filter_list_resolver.h"
+
+using namespace libsinsp::filter;
+
+bool filter_list_resolver::run(std::shared_ptr<libsinsp::filter::ast::expr>& filter)
+{
+	m_resolved_lists.clear();
+	m_errors.clear();
+	if(filter && !m_lists.empty())
+	{
+		resolve(filter.get());
+	}
+	return !m_resolved_lists.empty();
+}
+
+void filter_list_resolver::set_list(const std::string& name, const std::vector<std::string>& items)
+{
+	// todo(jasondellaluce): this breaks string escaping in lists
+	std::string values;
+	for (const auto& item : items)
+	{
+		values += values.empty() ? "" : ", ";
+		if (item.find(" ") != std::string::npos && item[0] != '"' && item[0] != '\'')
+		{
+			values += '"' + item + '"';
+		}
+		else
+		{
+			values += item;
+		}
+	}
+
+	// the items are parsed with the same rules of the values of a list
+	// expression, so that quoted items are unquoted, and so on
+	std::vector<std::string> parsed;
+	try
+	{
+		parser p("evt.type in (" + values + ")");
+		auto e = p.parse();
+		auto check = dynamic_cast<ast::binary_check_expr*>(e.get());
+		auto list = check ? dynamic_cast<ast::list_expr*>(check->right.get()) : nullptr;
+		if (list)
+		{
+			parsed = std::move(list->values);
+		}
+		else
+		{
+			parsed = items;
+		}
+	}
+	catch (const sinsp_exception& e)
+	{
+		// the items can't be part of a valid list expression,
+		// so we just keep them as they are
+		parsed = items;
+	}
+	m_lists[name] = std::move(parsed);
+}
+
+const std::unordered_set<std::string>& filter_list_resolver::get_resolved_lists() const
+{
+	return m_resolved_lists;
+}
+
+const std::vector<filter_list_resolver::value_info>& filter_list_resolver::get_errors() const
+{
+	return m_errors;
+}
+
+void filter_list_resolver::resolve(ast::expr* e)
+{
+	if (auto n = dynamic_cast<ast::not_expr*>(e))
+	{
+		resolve(n->child.get());
+		return;
+	}
+	if (auto a = dynamic_cast<ast::and_expr*>(e))
+	{
+		for (auto& c : a->children)
+		{
+			resolve(c.get());
+		}
+		return;
+	}
+	if (auto o = dynamic_cast<ast::or_expr*>(e))
+	{
+		for (auto& c : o->children)
+		{
+			resolve(c.get());
+		}
+		return;
+	}
+
+	auto check = dynamic_cast<ast::binary_check_expr*>(e);
+	if (!check)
+	{
+		return;
+	}
+
+	if (auto list = dynamic_cast<ast::list_expr*>(check->right.get()))
+	{
+		// the name of a list is replaced with all its items
+		std::vector<std::string> values;
+		bool resolved = false;
+		for (const auto& v : list->values)
+		{
+			auto l = m_lists.find(v);
+			if (l == m_lists.end())
+			{
+				values.push_back(v);
+				continue;
+			}
+			values.insert(values.end(), l->second.begin(), l->second.end());
+			m_resolved_lists.insert(l->first);
+			resolved = true;
+		}
+		if (resolved)
+		{
+			list->values = std::move(values);
+		}
+		return;
+	}
+
+	if (auto value = dynamic_cast<ast::value_expr*>(check->right.get()))
+	{
+		auto l = m_lists.find(value->value);
+		if (l == m_lists.end())
+		{
+			return;
+		}
+		if (l->second.size() != 1)
+		{
+			m_errors.push_back({"List '" + l->first + "' has " + std::to_string(l->second.size())
+				+ " items and can't be used as a single value in filter.", value->get_pos()});
+			return;
+		}
+		value->value = l->second[0];
+		m_resolved_lists.insert(l->first);
+	}
+}
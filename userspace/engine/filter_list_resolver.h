@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/filter/parser.h>
+#include <string>
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+/*!
+	\brief Helper class for substituting list references in parsed filters.
+	A list is referenced by using its name as a value of a list expression,
+	such as "proc.name in (shell_binaries, zsh)", in which case the name is
+	replaced with all the items of the list, or as the value of a check if
+	the list has a single item, such as "proc.name = my_shell". Using the
+	name of a list with any other number of items as the value of a check is an
+	error, as the check can't compare with all of them.
+*/
+class filter_list_resolver
+{
+	public:
+		/*!
+			\brief Visits a filter AST and substitutes list references
+			according with all the definitions added through set_list().
+			\param filter The filter AST to be processed. The substitutions
+			are applied in place.
+			\return true if at least one of the defined lists is resolved
+		*/
+		bool run(std::shared_ptr<libsinsp::filter::ast::expr>& filter);
+
+		/*!
+			\brief Defines a new list to be substituted in filters. If called
+			multiple times for the same list name, the previous definition
+			gets overridden. The items are parsed once, as they would be if
+			they were written inside a list expression of a filter, with the
+			items containing spaces being quoted if they are not already.
+			\param name The name of the list.
+			\param items The items of the list.
+		*/
+		void set_list(const std::string& name, const std::vector<std::string>& items);
+
+		/*!
+			\brief Returns a set containing the names of all the lists
+			substituted during the last invocation of run(). Should be
+			non-empty if the last invocation of run() returned true.
+		*/
+		const std::unordered_set<std::string>& get_resolved_lists() const;
+
+		/*!
+			\brief used in get_errors
+		*/
+		typedef std::pair<std::string,libsinsp::filter::ast::pos_info> value_info;
+
+		/*!
+			\brief Returns a list of errors occurred during the last
+			invocation of run(), along with their position in the
+			filter. Should be non-empty if the filter references lists
+			that can't be substituted.
+		*/
+		const std::vector<value_info>& get_errors() const;
+
+		/*!
+			\brief Clears the resolver by resetting all state related to
+			known lists and everything related to the previous resolution run.
+		*/
+		inline void clear()
+		{
+			m_resolved_lists.clear();
+			m_errors.clear();
+			m_lists.clear();
+		}
+
+	private:
+		void resolve(libsinsp::filter::ast::expr* e);
+
+		std::unordered_set<std::string> m_resolved_lists;
+		std::vector<value_info> m_errors;
+		std::unordered_map<std::string, std::vector<std::string>> m_lists;
+};
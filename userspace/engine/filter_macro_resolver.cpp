@@ -40,7 +40,14 @@ void filter_macro_resolver::set_macro(
 		const std::string& name,
 		const std::shared_ptr<libsinsp::filter::ast::expr>& macro)
 {
-	m_macros[name] = macro;
+	m_macros[name] = {macro, false};
+}
+
+void filter_macro_resolver::set_expanded_macro(
+		const std::string& name,
+		const std::shared_ptr<libsinsp::filter::ast::expr>& macro)
+{
+	m_macros[name] = {macro, true};
 }
 
 const std::vector<filter_macro_resolver::value_info>& filter_macro_resolver::get_unknown_macros() const
@@ -127,8 +134,15 @@ void filter_macro_resolver::visitor::visit(ast::field_transformer_expr* e)
 void filter_macro_resolver::visitor::visit(ast::identifier_expr* e)
 {
 	const auto& macro = m_macros.find(e->identifier);
-	if (macro != m_macros.end() && macro->second) // skip null-ptr macros
+	if (macro != m_macros.end() && macro->second.ast) // skip null-ptr macros
 	{
+		if (macro->second.expanded)
+		{
+			m_node_substitute = ast::clone(macro->second.ast.get());
+			m_resolved_macros.push_back({e->identifier, e->get_pos()});
+			return;
+		}
+
 		// note: checks for loop detection
 		const auto& prevref = std::find(m_macros_path.begin(), m_macros_path.end(), macro->first);
 		if (prevref != m_macros_path.end())
@@ -142,7 +156,7 @@ void filter_macro_resolver::visitor::visit(ast::identifier_expr* e)
 
 		m_macros_path.push_back(macro->first);
 		m_node_substitute = nullptr;
-		auto new_node = ast::clone(macro->second.get());
+		auto new_node = ast::clone(macro->second.ast.get());
 		new_node->accept(this);
 		// new_node might already have set a non-NULL m_node_substitute.
 		// if not, the right substituted is the newly-cloned node.
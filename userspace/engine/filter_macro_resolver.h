@@ -54,6 +54,21 @@ class filter_macro_resolver
 			const std::string& name,
 			const std::shared_ptr<libsinsp::filter::ast::expr>& macro);
 
+		/*!
+			\brief Defines a new macro to be substituted in filters, like
+			set_macro(), for a macro whose AST is already fully expanded and
+			contains no references to other macros. The references to such a
+			macro are replaced with a clone of its AST, which is not visited
+			again, and only the macro itself is reported among the resolved
+			ones. This avoids expanding the same macros over and over when
+			resolving many filters.
+			\param name The name of the macro.
+			\param macro The expanded AST of the macro.
+		*/
+		void set_expanded_macro(
+			const std::string& name,
+			const std::shared_ptr<libsinsp::filter::ast::expr>& macro);
+
 		/*!
 		    \brief used in get_{resolved,unknown}_macros and get_errors
 			to represent an identifier/string value along with an AST position.
@@ -94,10 +109,13 @@ class filter_macro_resolver
 		}
 
 	private:
-		typedef std::unordered_map<
-			std::string,
-			std::shared_ptr<libsinsp::filter::ast::expr>
-		> macro_defs;
+		struct macro_def
+		{
+			std::shared_ptr<libsinsp::filter::ast::expr> ast;
+			bool expanded = false;
+		};
+
+		typedef std::unordered_map<std::string, macro_def> macro_defs;
 
 		struct visitor : public libsinsp::filter::ast::expr_visitor
 		{
@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "filter_or_merger.h"
+
+#include <re2/re2.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+using namespace libsinsp::filter;
+
+// Returns the field of an equality check, or of a regex check, setting
+// regex accordingly, or nullptr if the node is not a plain field compared
+// against one or more constant values
+static const ast::field_expr* mergeable_check_field(const ast::expr* e, bool& regex)
+{
+	auto check = dynamic_cast<const ast::binary_check_expr*>(e);
+	if(!check)
+	{
+		return nullptr;
+	}
+
+	regex = false;
+	if(check->op == "=" || check->op == "==")
+	{
+		if(!dynamic_cast<const ast::value_expr*>(check->right.get()))
+		{
+			return nullptr;
+		}
+	}
+	else if(check->op == "in")
+	{
+		if(!dynamic_cast<const ast::list_expr*>(check->right.get()))
+		{
+			return nullptr;
+		}
+	}
+	else if(check->op == "regex")
+	{
+		if(!dynamic_cast<const ast::value_expr*>(check->right.get()))
+		{
+			return nullptr;
+		}
+		regex = true;
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	return dynamic_cast<const ast::field_expr*>(check->left.get());
+}
+
+// Returns the alternation of the given patterns, or an empty string if
+// one of them or the alternation doesn't compile, in which case the
+// checks are left as they are so that the errors are reported as usual
+static std::string merge_patterns(const std::vector<std::string>& patterns)
+{
+	std::string res;
+	for(const auto& p : patterns)
+	{
+		if(!re2::RE2(p, re2::RE2::Quiet).ok())
+		{
+			return "";
+		}
+		// the flags set within a pattern only apply to its own group
+		res += (res.empty() ? "(?:" : "|(?:") + p + ")";
+	}
+	if(!re2::RE2(res, re2::RE2::Quiet).ok())
+	{
+		return "";
+	}
+	return res;
+}
+
+static void append_check_values(const ast::expr* e, std::vector<std::string>& values, std::unordered_set<std::string>& unique)
+{
+	auto check = static_cast<const ast::binary_check_expr*>(e);
+	auto value = dynamic_cast<const ast::value_expr*>(check->right.get());
+	if(value)
+	{
+		if(unique.insert(value->value).second)
+		{
+			values.push_back(value->value);
+		}
+		return;
+	}
+
+	for(const auto& v : static_cast<const ast::list_expr*>(check->right.get())->values)
+	{
+		if(unique.insert(v).second)
+		{
+			values.push_back(v);
+		}
+	}
+}
+
+bool filter_or_merger::run(std::shared_ptr<ast::expr>& filter) const
+{
+	if(!filter)
+	{
+		return false;
+	}
+
+	// the root is temporarily owned by a unique_ptr, like all other nodes,
+	// so that it can be replaced while merging
+	std::unique_ptr<ast::expr> e = ast::clone(filter.get());
+	if(!merge(e))
+	{
+		return false;
+	}
+
+	filter = std::move(e);
+	return true;
+}
+
+bool filter_or_merger::merge(std::unique_ptr<ast::expr>& e) const
+{
+	bool changed = false;
+
+	if(auto n = dynamic_cast<ast::not_expr*>(e.get()))
+	{
+		return merge(n->child);
+	}
+
+	if(auto a = dynamic_cast<ast::and_expr*>(e.get()))
+	{
+		for(auto& c : a->children)
+		{
+			changed |= merge(c);
+		}
+		return changed;
+	}
+
+	auto o = dynamic_cast<ast::or_expr*>(e.get());
+	if(!o)
+	{
+		return false;
+	}
+
+	for(auto& c : o->children)
+	{
+		changed |= merge(c);
+	}
+
+	// group the equality checks and the regex checks by field, keeping
+	// the position of the first check of each group so that the
+	// evaluation order of the other children is preserved
+	std::map<std::tuple<bool, std::string, std::string>, std::vector<size_t>> groups;
+	for(size_t i = 0; i < o->children.size(); i++)
+	{
+		bool regex = false;
+		auto field = mergeable_check_field(o->children[i].get(), regex);
+		if(field)
+		{
+			groups[{regex, field->field, field->arg}].push_back(i);
+		}
+	}
+
+	bool merged = false;
+	std::vector<bool> removed(o->children.size(), false);
+	for(const auto& g : groups)
+	{
+		if(g.second.size() < 2)
+		{
+			continue;
+		}
+
+		std::vector<std::string> values;
+		std::unordered_set<std::string> unique;
+		for(auto i : g.second)
+		{
+			append_check_values(o->children[i].get(), values, unique);
+		}
+
+		const auto& [regex, field, arg] = g.first;
+		std::unique_ptr<ast::expr> check;
+		if(!regex)
+		{
+			check = ast::binary_check_expr::create(
+				ast::field_expr::create(field, arg),
+				"in",
+				ast::list_expr::create(values));
+		}
+		else if(values.size() == 1)
+		{
+			// the same pattern repeated
+			check = ast::clone(o->children[g.second[0]].get());
+		}
+		else
+		{
+			// the patterns are matched in a single pass
+			auto pattern = merge_patterns(values);
+			if(pattern.empty())
+			{
+				continue;
+			}
+			check = ast::binary_check_expr::create(
+				ast::field_expr::create(field, arg),
+				"regex",
+				ast::value_expr::create(pattern));
+		}
+
+		size_t first = g.second[0];
+		for(size_t i = 1; i < g.second.size(); i++)
+		{
+			removed[g.second[i]] = true;
+		}
+		o->children[first] = std::move(check);
+		merged = true;
+	}
+
+	if(!merged)
+	{
+		return changed;
+	}
+
+	std::vector<std::unique_ptr<ast::expr>> children;
+	for(size_t i = 0; i < o->children.size(); i++)
+	{
+		if(!removed[i])
+		{
+			children.push_back(std::move(o->children[i]));
+		}
+	}
+
+	if(children.size() == 1)
+	{
+		e = std::move(children[0]);
+	}
+	else
+	{
+		o->children = std::move(children);
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/filter/parser.h>
+#include <memory>
+
+/*!
+	\brief Rewrites filter ASTs so that the equality checks on a same
+	field that are or-ed together are merged into a single "in" check.
+	For example, "proc.name = a or proc.name in (b, c) or fd.num = 1"
+	becomes "proc.name in (a, b, c) or fd.num = 1". This is semantically
+	equivalent, but "in" checks are evaluated with a set lookup instead
+	of comparing each value one by one, which makes a difference on the
+	large lists of values that rules commonly expand into. Likewise, the
+	regex checks on a same field that are or-ed together are merged into
+	a single check on the alternation of their patterns, e.g.
+	"proc.name regex a or proc.name regex b" becomes
+	"proc.name regex \"(?:a)|(?:b)\"", which RE2 matches in a single pass
+	over the value instead of one pass per pattern.
+*/
+class filter_or_merger
+{
+public:
+	/*!
+		\brief Visits a filter AST and merges the or-ed equality checks,
+		and the or-ed regex checks, on a same field.
+		\param filter The filter AST to be processed. The AST is not
+		modified, but if at least one merge is performed the pointer is
+		replaced with a new AST containing the merged checks.
+		\return true if at least one merge has been performed
+	*/
+	bool run(std::shared_ptr<libsinsp::filter::ast::expr>& filter) const;
+
+private:
+	bool merge(std::unique_ptr<libsinsp::filter::ast::expr>& e) const;
+};
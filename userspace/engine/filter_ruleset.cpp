@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "filter_ruleset.h"
 
+#include <algorithm>
+
 void filter_ruleset::set_engine_state(const filter_ruleset::engine_state_funcs& engine_state)
 {
 	m_engine_state = engine_state;
@@ -26,3 +28,133 @@ filter_ruleset::engine_state_funcs& filter_ruleset::get_engine_state()
 {
 	return m_engine_state;
 }
+
+void filter_ruleset::begin_changes()
+{
+}
+
+void filter_ruleset::commit_changes()
+{
+}
+
+void filter_ruleset::update_rule_ordering()
+{
+}
+
+size_t filter_ruleset::memory_usage() const
+{
+	return 0;
+}
+
+std::map<std::string, libsinsp::events::set<ppm_sc_code>> filter_ruleset::enabled_sc_codes_by_rule(uint16_t ruleset)
+{
+	return {};
+}
+
+bool filter_ruleset::run(sinsp_evt *evt, const falco_rule *& match, uint16_t ruleset_id)
+{
+	m_compat_matches.resize(1);
+	if(!run(evt, m_compat_matches[0], ruleset_id))
+	{
+		return false;
+	}
+	match = &m_compat_matches[0];
+	return true;
+}
+
+bool filter_ruleset::run(sinsp_evt *evt, std::vector<const falco_rule *>& matches, uint16_t ruleset_id)
+{
+	m_compat_matches.clear();
+	if(!run(evt, m_compat_matches, ruleset_id))
+	{
+		return false;
+	}
+	for(const auto &m : m_compat_matches)
+	{
+		matches.push_back(&m);
+	}
+	return true;
+}
+
+size_t filter_ruleset::run_batch(
+	sinsp_evt *const *evts,
+	size_t num_evts,
+	falco_common::rule_matching strategy,
+	std::vector<bool> &matched,
+	std::vector<batch_match> &matches,
+	uint16_t ruleset_id)
+{
+	// rules are copied in a single vector, so pointers to them can only
+	// be taken once all events have been processed
+	m_compat_batch_rules.clear();
+	m_compat_batch_idxs.clear();
+	matched.assign(num_evts, false);
+	matches.clear();
+
+	size_t num_matched = 0;
+	for(size_t i = 0; i < num_evts; i++)
+	{
+		size_t prev_size = m_compat_batch_rules.size();
+		if(strategy == falco_common::rule_matching::FIRST)
+		{
+			m_compat_batch_rules.emplace_back();
+			if(!run(evts[i], m_compat_batch_rules.back(), ruleset_id))
+			{
+				m_compat_batch_rules.pop_back();
+			}
+		}
+		else
+		{
+			run(evts[i], m_compat_batch_rules, ruleset_id);
+		}
+
+		if(m_compat_batch_rules.size() > prev_size)
+		{
+			matched[i] = true;
+			num_matched++;
+			m_compat_batch_idxs.resize(m_compat_batch_rules.size(), i);
+		}
+	}
+
+	for(size_t i = 0; i < m_compat_batch_rules.size(); i++)
+	{
+		matches.push_back({m_compat_batch_idxs[i], &m_compat_batch_rules[i]});
+	}
+	return num_matched;
+}
+
+bool filter_ruleset::run_multi(sinsp_evt *evt, uint64_t ruleset_mask, std::vector<multi_match> &matches)
+{
+	// rules are copied in a single vector, so pointers to them can only
+	// be taken once all rulesets have been run
+	m_compat_multi_rules.clear();
+	m_compat_multi_bits.clear();
+	matches.clear();
+	for(uint16_t id = 0; id < max_multi_rulesets; id++)
+	{
+		uint64_t bit = (uint64_t)1 << id;
+		if((ruleset_mask & bit) != 0)
+		{
+			run(evt, m_compat_multi_rules, id);
+			m_compat_multi_bits.resize(m_compat_multi_rules.size(), bit);
+		}
+	}
+
+	// the same rule is usually enabled in most of the rulesets, so the
+	// matches are merged by rule
+	for(size_t i = 0; i < m_compat_multi_rules.size(); i++)
+	{
+		const auto &rule = m_compat_multi_rules[i];
+		auto it = std::find_if(matches.begin(), matches.end(),
+			[&rule](const multi_match &m) { return m.rule->id == rule.id; });
+		if(it != matches.end())
+		{
+			it->rulesets |= m_compat_multi_bits[i];
+		}
+		else
+		{
+			matches.push_back({&rule, m_compat_multi_bits[i]});
+		}
+	}
+	return !matches.empty();
+}
@@ -19,11 +19,14 @@ limitations under the License.
 
 #include "falco_rule.h"
 #include "rule_loader_compile_output.h"
+#include "stats_manager.h"
 #include <libsinsp/filter/ast.h>
 #include <libsinsp/filter.h>
 #include <libsinsp/event.h>
 #include <libsinsp/events/sinsp_events.h>
 
+#include <map>
+
 /*!
 	\brief Manages a set of rulesets. A ruleset is a set of
 	enabled rules that is able to process events and find matches for those rules.
@@ -39,6 +42,20 @@ public:
 		using ruleset_retriever_func_t = std::function<bool(const std::string &, std::shared_ptr<filter_ruleset> &ruleset)>;
 
 		ruleset_retriever_func_t get_ruleset;
+
+		// The rule statistics of the engine, that rulesets can
+		// use to record per-rule evaluation costs when rule
+		// profiling is enabled.
+		stats_manager *rule_stats = nullptr;
+
+		// Creates another filter factory for the given source, or
+		// returns nullptr if the source has no filter factory creator
+		// (see falco_source::new_filter_factory). Rulesets use it to
+		// compile the rules enabled after loading without sharing the
+		// filter factory of the event thread.
+		using filter_factory_creator_func_t = std::function<std::shared_ptr<sinsp_filter_factory>(const std::string &source)>;
+
+		filter_factory_creator_func_t new_filter_factory;
 	};
 
 	enum class match_type {
@@ -59,7 +76,10 @@ public:
 		the filter_ruleset object to parse the ast to obtain event types
 		or do other analysis/indexing of the condition.
 		\param rule The rule to be added
-		\param the filter representing the rule's filtering condition.
+		\param the filter representing the rule's filtering condition,
+		or nullptr if the rule is compiled lazily, in which case the
+		ruleset compiles it the first time the rule is enabled, see
+		falco_rule::filter.
 		\param condition The AST representing the rule's filtering condition
 	*/
 	virtual void add(
@@ -108,6 +128,41 @@ public:
 	*/
 	virtual void on_loading_complete() = 0;
 
+	/*!
+		\brief Starts a batch of changes: the rules enabled and disabled
+		with enable()/disable()/enable_tags()/disable_tags() from now on
+		are applied all at once by commit_changes(), and not seen by
+		run() until then. Outside of a batch, each change is applied by
+		the invocation making it. The default implementation does nothing.
+	*/
+	virtual void begin_changes();
+
+	/*!
+		\brief Applies the changes of the batch started by begin_changes(),
+		if any, and ends it. The default implementation does nothing.
+	*/
+	virtual void commit_changes();
+
+	/*!
+		\brief Reorders the rules enabled in each ruleset based on their
+		observed evaluation cost and match rate, so that the rules that are
+		cheap and likely to match are evaluated first. The new ordering
+		is only applied to the run() variants returning the first match,
+		whereas the run() variants returning all matches keep evaluating
+		rules in the order in which they are defined.
+		The default implementation does nothing. Unlike the other methods,
+		this can be called concurrently with run().
+	*/
+	virtual void update_rule_ordering();
+
+	/*!
+		\brief Returns an estimate of the memory used by the ruleset to
+		store and index its rules, in bytes. This does not include the
+		memory of the compiled filters and conditions, which are shared
+		with the engine. The default implementation returns 0.
+	*/
+	virtual size_t memory_usage() const;
+
 	/*!
 		\brief Processes an event and tries to find a match in a given ruleset.
 		\return true if a match is found, false otherwise
@@ -134,6 +189,119 @@ public:
 		std::vector<falco_rule>& matches,
 		uint16_t ruleset_id) = 0;
 
+	/*!
+		\brief Processes an event and tries to find a match in a given ruleset.
+		Differently from the run() variants above, the matching rule
+		is not copied and is referenced through a pointer instead.
+		The default implementation relies on the copying variant, so
+		rulesets are encouraged to override it for better performance.
+		\return true if a match is found, false otherwise
+		\param evt The event to be processed
+		\param match If true is returned, this is filled-out with a pointer
+		to the first rule that matched the event. The pointed rule is owned
+		by the ruleset and is valid until the next invocation of
+		any run() variant, add(), or clear().
+		\param ruleset_id The id of the ruleset to be used
+	*/
+	virtual bool run(
+		sinsp_evt *evt,
+		const falco_rule *& match,
+		uint16_t ruleset_id);
+
+	/*!
+		\brief Processes an event and tries to find a match in a given ruleset.
+		Differently from the run() variants above, the matching rules
+		are not copied and are referenced through pointers instead.
+		The default implementation relies on the copying variant, so
+		rulesets are encouraged to override it for better performance.
+		\return true if a match is found, false otherwise
+		\param evt The event to be processed
+		\param matches If true is returned, this is filled-out with pointers
+		to all the rules that matched the event. The pointed rules are owned
+		by the ruleset and are valid until the next invocation of
+		any run() variant, add(), or clear().
+		\param ruleset_id The id of the ruleset to be used
+	*/
+	virtual bool run(
+		sinsp_evt *evt,
+		std::vector<const falco_rule *>& matches,
+		uint16_t ruleset_id);
+
+	/*!
+		\brief A rule matching one of the events of a batch, see run_batch()
+	*/
+	struct batch_match
+	{
+		size_t evt_idx;
+		const falco_rule *rule;
+	};
+
+	/*!
+		\brief Processes a batch of events and tries to find matches for each
+		of them in a given ruleset. This is equivalent to invoking the
+		non-copying run() variants for each event, but rulesets can evaluate
+		the events in any order (for example, grouping them by type) to
+		amortize the evaluation costs. The events and their related state
+		must stay valid until this method returns.
+		The default implementation relies on the copying run() variants.
+		\return the number of events for which at least a match is found
+		\param evts The events to be processed
+		\param num_evts The number of events to be processed
+		\param strategy Whether to find only the first matching rule
+		of each event or all of them
+		\param matched Filled-out with one flag per event, set to true if
+		at least a rule matched the event with the same index
+		\param matches Filled-out with the matching rules, ordered by event
+		index first, and rule evaluation order second. The pointed rules
+		are owned by the ruleset and are valid until the next invocation of
+		any run() variant, add(), or clear().
+		\param ruleset_id The id of the ruleset to be used
+	*/
+	virtual size_t run_batch(
+		sinsp_evt *const *evts,
+		size_t num_evts,
+		falco_common::rule_matching strategy,
+		std::vector<bool> &matched,
+		std::vector<batch_match> &matches,
+		uint16_t ruleset_id);
+
+	/*!
+		\brief The maximum number of rulesets that can be evaluated at once
+		by run_multi(), whose ids are the bits of a 64-bit mask
+	*/
+	static constexpr uint16_t max_multi_rulesets = 64;
+
+	/*!
+		\brief A rule matching an event in one or more rulesets, see run_multi()
+	*/
+	struct multi_match
+	{
+		const falco_rule *rule;
+		uint64_t rulesets;
+	};
+
+	/*!
+		\brief Processes an event and finds all its matches in multiple
+		rulesets at once. The result is equivalent to invoking the
+		run() variant returning all the matches once per each ruleset,
+		but rulesets can evaluate each rule only once regardless of the
+		number of rulesets in which it's enabled. The default
+		implementation runs the rulesets one after the other.
+		\return true if a match is found in at least one ruleset
+		\param evt The event to be processed
+		\param ruleset_mask The rulesets to be used, as a bitmask in which
+		bit i stands for the ruleset with id i. Rulesets with ids greater
+		than or equal to max_multi_rulesets can't be used.
+		\param matches Cleared and filled-out with the matching rules, each
+		reported once along with the bitmask of the rulesets in which it
+		matched. The pointed rules are owned by the ruleset and are valid
+		until the next invocation of any run() variant, add(), or clear().
+	*/
+	virtual bool run_multi(
+		sinsp_evt *evt,
+		uint64_t ruleset_mask,
+		std::vector<multi_match> &matches);
+
 	/*!
 		\brief Returns the number of rules enabled in a given ruleset
 		\param ruleset_id The id of the ruleset to be used
@@ -160,6 +328,15 @@ public:
 	virtual libsinsp::events::set<ppm_sc_code> enabled_sc_codes(
 		uint16_t ruleset) = 0;
 	
+	/*!
+		\brief Returns the ppm_sc_codes matching each of the rules
+		enabled in a given ruleset, indexed by rule name. The default
+		implementation returns no rules.
+		\param ruleset_id The id of the ruleset to be used
+	*/
+	virtual std::map<std::string, libsinsp::events::set<ppm_sc_code>> enabled_sc_codes_by_rule(
+		uint16_t ruleset);
+
 	/*!
 		\brief Returns the all the ppm_event_codes matching the rules
 		enabled in a given ruleset.
@@ -236,6 +413,17 @@ public:
 
 private:
 	engine_state_funcs m_engine_state;
+
+	// Used by the default implementations of the non-copying run() variants
+	std::vector<falco_rule> m_compat_matches;
+
+	// Used by the default implementation of run_batch()
+	std::vector<falco_rule> m_compat_batch_rules;
+	std::vector<size_t> m_compat_batch_idxs;
+
+	// Used by the default implementation of run_multi()
+	std::vector<falco_rule> m_compat_multi_rules;
+	std::vector<uint64_t> m_compat_multi_bits;
 };
 
 /*!
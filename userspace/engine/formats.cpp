@@ -15,10 +15,60 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-#include <json/json.h>
-
 #include "formats.h"
+#include "alloc_tracker.h"
 #include "falco_engine.h"
+#include "falco_utils.h"
+
+// Writes the JSON object of an alert into out, with its keys sorted as
+// Json::FastWriter used to do, grafting the already serialized output
+// fields object into it as-is
+static void write_json_alert(std::string &out, uint64_t ts, const std::string &rule, const std::string &source,
+			     const std::string &level, const std::string *line, const std::set<std::string> *tags,
+			     const std::string &hostname, const char *output_fields, size_t output_fields_len)
+{
+	out.clear();
+	out += "{\"hostname\":";
+	falco::utils::append_json_string(out, hostname);
+
+	if(line)
+	{
+		out += ",\"output\":";
+		falco::utils::append_json_string(out, *line);
+	}
+
+	out += ",\"priority\":";
+	falco::utils::append_json_string(out, level);
+	out += ",\"rule\":";
+	falco::utils::append_json_string(out, rule);
+	out += ",\"source\":";
+	falco::utils::append_json_string(out, source);
+
+	if(tags)
+	{
+		out += ",\"tags\":[";
+		bool first = true;
+		for (const auto &tag : *tags)
+		{
+			if(!first)
+			{
+				out += ',';
+			}
+			first = false;
+			falco::utils::append_json_string(out, tag);
+		}
+		out += ']';
+	}
+
+	// the time-as-nanoseconds as a more json-friendly ISO8601
+	out += ",\"time\":\"";
+	falco::utils::append_iso8601_utc(out, ts);
+	out += '"';
+
+	out += ", \"output_fields\": ";
+	out.append(output_fields, output_fields_len);
+	out += '}';
+}
 
 falco_formats::falco_formats(std::shared_ptr<const falco_engine> engine,
 			     bool json_include_output_property,
@@ -37,113 +87,117 @@ std::string falco_formats::format_event(sinsp_evt *evt, const std::string &rule,
 				   const std::string &level, const std::string &format, const std::set<std::string> &tags,
 				   const std::string &hostname) const
 {
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::FORMATS);
 	std::string line;
+	auto formatter = m_falco_engine->get_formatter(source, format);
+	format_event(line, evt, rule, source, level, *formatter, tags, hostname);
+	return line;
+}
+
+void falco_formats::format_event(std::string &out, sinsp_evt *evt, const std::string &rule, const std::string &source,
+				 const std::string &level, sinsp_evt_formatter &formatter, const std::set<std::string> &tags,
+				 const std::string &hostname) const
+{
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::FORMATS);
+	if(formatter.get_output_format() != sinsp_evt_formatter::OF_JSON)
+	{
+		out.clear();
+		formatter.tostring_withformat(evt, out, sinsp_evt_formatter::OF_NORMAL);
+		return;
+	}
 
-	std::shared_ptr<sinsp_evt_formatter> formatter;
+	// reused across alerts, so that rendering doesn't need to grow
+	// new buffers every time
+	thread_local std::string line;
+	thread_local std::string json_line;
 
-	formatter = m_falco_engine->create_formatter(source, format);
+	// Format the event into a json object with all fields resolved
+	json_line.clear();
+	formatter.tostring(evt, json_line);
 
-	// Format the original output string, regardless of output format
-	formatter->tostring_withformat(evt, line, sinsp_evt_formatter::OF_NORMAL);
+	// The formatted string might have a leading newline. If it does, remove it.
+	size_t json_start = (!json_line.empty() && json_line[0] == '\n') ? 1 : 0;
 
-	if(formatter->get_output_format() == sinsp_evt_formatter::OF_JSON)
+	// For JSON output, the formatter returned a json-as-text
+	// object containing all the fields in the original format
+	// message as well as the event time in ns. Use this to build
+	// a more detailed object containing the event time, rule,
+	// severity, full output, and fields.
+	if(m_json_include_output_property)
 	{
-		std::string json_line;
-
-		// Format the event into a json object with all fields resolved
-		formatter->tostring(evt, json_line);
+		// This is the filled-in output line, which is only
+		// rendered when it's part of the alert.
+		line.clear();
+		formatter.tostring_withformat(evt, line, sinsp_evt_formatter::OF_NORMAL);
+	}
 
-		// The formatted string might have a leading newline. If it does, remove it.
-		if(json_line[0] == '\n')
-		{
-			json_line.erase(0, 1);
-		}
+	write_json_alert(out, evt->get_ts(), rule, source, level,
+			 m_json_include_output_property ? &line : nullptr,
+			 m_json_include_tags_property ? &tags : nullptr,
+			 hostname, json_line.data() + json_start, json_line.size() - json_start);
+}
 
-		// For JSON output, the formatter returned a json-as-text
-		// object containing all the fields in the original format
-		// message as well as the event time in ns. Use this to build
-		// a more detailed object containing the event time, rule,
-		// severity, full output, and fields.
-		Json::Value event;
-		Json::Value rule_tags;
-		Json::FastWriter writer;
-		std::string full_line;
-		unsigned int rule_tags_idx = 0;
-
-		// Convert the time-as-nanoseconds to a more json-friendly ISO8601.
-		time_t evttime = evt->get_ts() / 1000000000;
-		char time_sec[20]; // sizeof "YYYY-MM-DDTHH:MM:SS"
-		char time_ns[12];  // sizeof ".sssssssssZ"
-		std::string iso8601evttime;
-
-		strftime(time_sec, sizeof(time_sec), "%FT%T", gmtime(&evttime));
-		snprintf(time_ns, sizeof(time_ns), ".%09luZ", evt->get_ts() % 1000000000);
-		iso8601evttime = time_sec;
-		iso8601evttime += time_ns;
-		event["time"] = iso8601evttime;
-		event["rule"] = rule;
-		event["priority"] = level;
-		event["source"] = source;
-		event["hostname"] = hostname;
-
-		if(m_json_include_output_property)
+void falco_formats::format_fields(std::string &out, uint64_t ts, const std::string &rule, const std::string &source,
+				  const std::string &level, const std::string &format, const falco::field_values &fields,
+				  const std::set<std::string> &tags, const std::string &hostname, bool json) const
+{
+	// the text line goes straight into out, unless it's part of a JSON alert
+	thread_local std::string json_text;
+	auto &line = json ? json_text : out;
+	line.clear();
+
+	// Substitute each %field token with its value, matching the longest
+	// extracted field name at each token, as the extracted values are
+	// keyed by the field names as they appear in the format. The leading
+	// '*' is not part of the output.
+	size_t i = (!format.empty() && format[0] == '*') ? 1 : 0;
+	while(i < format.size())
+	{
+		if(format[i] != '%')
 		{
-			// This is the filled-in output line.
-			event["output"] = line;
+			line += format[i++];
+			continue;
 		}
 
-		if(m_json_include_tags_property)
+		const std::string *name = nullptr;
+		const falco::field_value *value = nullptr;
+		for(const auto &f : fields)
 		{
-			if (tags.size() == 0)
+			if((!name || f.first.size() > name->size())
+			   && format.compare(i + 1, f.first.size(), f.first.get()) == 0)
 			{
-				// This sets an empty array
-				rule_tags = Json::arrayValue;
+				name = &f.first.get();
+				value = &f.second;
 			}
-			else
-			{
-				for (const auto &tag : tags)
-				{
-					rule_tags[rule_tags_idx++] = tag;
-				}
-			}
-			event["tags"] = rule_tags;
 		}
 
-		full_line = writer.write(event);
-
-		// Json::FastWriter may add a trailing newline. If it
-		// does, remove it.
-		if(full_line[full_line.length() - 1] == '\n')
+		if(!name)
 		{
-			full_line.resize(full_line.length() - 1);
+			line += format[i++];
+			continue;
 		}
+		value->append_text(line);
+		i += 1 + name->size();
+	}
 
-		// Cheat-graft the output from the formatter into this
-		// string. Avoids an unnecessary json parse just to
-		// merge the formatted fields at the object level.
-		full_line.pop_back();
-		full_line.append(", \"output_fields\": ");
-		full_line.append(json_line);
-		full_line.append("}");
-		line = full_line;
+	if(!json)
+	{
+		return;
 	}
 
-	return line;
+	thread_local std::string output_fields;
+	output_fields.clear();
+	falco::append_json(output_fields, fields);
+
+	write_json_alert(out, ts, rule, source, level,
+			 m_json_include_output_property ? &line : nullptr,
+			 m_json_include_tags_property ? &tags : nullptr,
+			 hostname, output_fields.data(), output_fields.size());
 }
 
 std::map<std::string, std::string> falco_formats::get_field_values(sinsp_evt *evt, const std::string &source,
 						    const std::string &format) const
 {
-	std::shared_ptr<sinsp_evt_formatter> formatter;
-
-	formatter = m_falco_engine->create_formatter(source, format);
-
-	std::map<std::string, std::string> ret;
-
-	if (! formatter->get_field_values(evt, ret))
-	{
-		throw falco_exception("Could not extract all field values from event");
-	}
-
-	return ret;
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::FORMATS);
+	return m_falco_engine->get_field_values(evt, source, format);
 }
@@ -33,6 +33,20 @@ public:
 				 const std::string &level, const std::string &format, const std::set<std::string> &tags,
 				 const std::string &hostname) const;
 
+	// Same as above, but with a formatter already compiled for the format,
+	// and writing the alert into out so that its buffer can be reused
+	void format_event(std::string &out, sinsp_evt *evt, const std::string &rule, const std::string &source,
+			  const std::string &level, sinsp_evt_formatter &formatter, const std::set<std::string> &tags,
+			  const std::string &hostname) const;
+
+	// Formats an alert from the values of the fields of a format, as
+	// previously extracted from the event by get_field_values() for the
+	// same format, so that no event is needed. Field width specifiers
+	// are not supported.
+	void format_fields(std::string &out, uint64_t ts, const std::string &rule, const std::string &source,
+			   const std::string &level, const std::string &format, const falco::field_values &fields,
+			   const std::set<std::string> &tags, const std::string &hostname, bool json) const;
+
 	std::map<std::string, std::string> get_field_values(sinsp_evt *evt, const std::string &source,
 					     const std::string &format) const ;
 
@@ -27,20 +27,43 @@ limitations under the License.
 
 #include "falco_utils.h"
 #include "filter_ruleset.h"
+#include "memory_usage.h"
 
 #include <libsinsp/sinsp.h>
 #include <libsinsp/filter.h>
 #include <libsinsp/event.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 // A filter_wrapper should implement these methods:
 //   const std::string &filter_wrapper::name();
 //   const std::set<std::string> &filter_wrapper::tags();
 //   const libsinsp::events::set<ppm_sc_code> &filter_wrapper::sc_codes();
 //   const libsinsp::events::set<ppm_event_code> &filter_wrapper::event_codes();
+//   const std::set<std::string> &filter_wrapper::async_event_names();
+//   const std::string &filter_wrapper::plugin_event_field();
+//   const std::set<std::string> &filter_wrapper::plugin_event_values();
+//
+// The async event names are the names of the async events that a filter
+// can match, if its event codes include PPME_ASYNCEVENT_E. An empty set
+// means that the filter can match async events of any name. Likewise, if
+// its event codes include PPME_PLUGINEVENT_E, a filter can only match the
+// plugin events for which the plugin event field has one of the plugin
+// event values, or any of them if the field is empty.
 
 template<class filter_wrapper>
 class indexable_ruleset : public filter_ruleset
@@ -52,21 +75,35 @@ public:
 	// Required to implement filter_ruleset
 	void clear() override
 	{
-		for(size_t i = 0; i < m_rulesets.size(); i++)
+		std::lock_guard<std::mutex> lock(m_rulesets_mtx);
+		std::shared_ptr<const ruleset_filters_vec> cur = m_staged;
+		if(!cur)
 		{
-			m_rulesets[i] = std::make_shared<ruleset_filters>(i);
+			cur = std::atomic_load(&m_rulesets);
 		}
+		m_staged.reset();
+		m_staged_copies.clear();
+		auto next = std::make_shared<ruleset_filters_vec>();
+		for(size_t i = 0; cur && i < cur->size(); i++)
+		{
+			next->emplace_back(std::make_shared<ruleset_filters>(i));
+		}
+		publish_rulesets(next);
 		m_filters.clear();
+		m_added.clear();
+		m_added_by_name.clear();
+		m_added_by_tag.clear();
 	}
 
 	uint64_t enabled_count(uint16_t ruleset_id) override
 	{
-		while(m_rulesets.size() < (size_t)ruleset_id + 1)
+		auto rs = rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
 		{
-			m_rulesets.emplace_back(std::make_shared<ruleset_filters>(m_rulesets.size()));
+			return 0;
 		}
 
-		return m_rulesets[ruleset_id]->num_filters();
+		return (*rs)[ruleset_id]->num_filters();
 	}
 
 	void enabled_evttypes(
@@ -83,21 +120,39 @@ public:
 	libsinsp::events::set<ppm_sc_code> enabled_sc_codes(
 		uint16_t ruleset_id) override
 	{
-		if(m_rulesets.size() < (size_t)ruleset_id + 1)
+		auto rs = rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
 		{
 			return {};
 		}
-		return m_rulesets[ruleset_id]->sc_codes();
+		return (*rs)[ruleset_id]->sc_codes();
+	}
+
+	std::map<std::string, libsinsp::events::set<ppm_sc_code>> enabled_sc_codes_by_rule(
+		uint16_t ruleset_id) override
+	{
+		std::map<std::string, libsinsp::events::set<ppm_sc_code>> res;
+		auto rs = rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
+		{
+			return res;
+		}
+		for(const auto &wrap : (*rs)[ruleset_id]->get_filters())
+		{
+			res[wrap->name()] = wrap->sc_codes();
+		}
+		return res;
 	}
 
 	libsinsp::events::set<ppm_event_code> enabled_event_codes(
 		uint16_t ruleset_id) override
 	{
-		if(m_rulesets.size() < (size_t)ruleset_id + 1)
+		auto rs = rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
 		{
 			return {};
 		}
-		return m_rulesets[ruleset_id]->event_codes();
+		return (*rs)[ruleset_id]->event_codes();
 	}
 
 	void enable(
@@ -132,34 +187,258 @@ public:
 
 	// Note that subclasses do *not* implement run. Instead, they
 	// implement run_wrappers.
+	bool run(sinsp_evt *evt, const falco_rule *&match, uint16_t ruleset_id) override
+	{
+		auto rs = run_rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
+		{
+			return false;
+		}
+
+		return (*rs)[ruleset_id]->run(*this, evt, match);
+	}
+
+	bool run(sinsp_evt *evt, std::vector<const falco_rule *> &matches, uint16_t ruleset_id) override
+	{
+		auto rs = run_rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
+		{
+			return false;
+		}
+
+		return (*rs)[ruleset_id]->run(*this, evt, matches);
+	}
+
+	size_t run_batch(
+		sinsp_evt *const *evts,
+		size_t num_evts,
+		falco_common::rule_matching strategy,
+		std::vector<bool> &matched,
+		std::vector<batch_match> &matches,
+		uint16_t ruleset_id) override
+	{
+		matched.assign(num_evts, false);
+		matches.clear();
+		auto rs = run_rulesets();
+		if(!rs || rs->size() < (size_t)ruleset_id + 1)
+		{
+			return 0;
+		}
+
+		// Events are evaluated grouped by type, so that each group
+		// runs through the same filters in a tight loop
+		m_batch_order.resize(num_evts);
+		std::iota(m_batch_order.begin(), m_batch_order.end(), 0);
+		std::stable_sort(m_batch_order.begin(), m_batch_order.end(),
+			[evts](size_t a, size_t b)
+			{
+				return evts[a]->get_type() < evts[b]->get_type();
+			});
+
+		size_t num_matched = 0;
+		auto &ruleset = *(*rs)[ruleset_id];
+		for(auto i : m_batch_order)
+		{
+			bool found = false;
+			if(strategy == falco_common::rule_matching::FIRST)
+			{
+				const falco_rule *match = nullptr;
+				if(ruleset.run(*this, evts[i], match))
+				{
+					matches.push_back({i, match});
+					found = true;
+				}
+			}
+			else
+			{
+				m_compat_matches.clear();
+				if(ruleset.run(*this, evts[i], m_compat_matches))
+				{
+					for(const auto *m : m_compat_matches)
+					{
+						matches.push_back({i, m});
+					}
+					found = true;
+				}
+			}
+
+			if(found)
+			{
+				matched[i] = true;
+				num_matched++;
+			}
+		}
+
+		// Report the matches in the order of the events
+		std::stable_sort(matches.begin(), matches.end(),
+			[](const batch_match &a, const batch_match &b)
+			{
+				return a.evt_idx < b.evt_idx;
+			});
+
+		return num_matched;
+	}
+
+	// Each filter enabled in any of the given rulesets is evaluated only
+	// once, and its match is attributed to all of them at once through
+	// the ruleset bitmask it has in the multi-ruleset index
+	bool run_multi(sinsp_evt *evt, uint64_t ruleset_mask, std::vector<multi_match> &matches) override
+	{
+		matches.clear();
+		auto idx = get_multi_index();
+		if(!idx)
+		{
+			return false;
+		}
+
+		uint64_t matched = 0;
+		uint16_t etype = evt->get_type();
+		if(etype < idx->by_event_type.size())
+		{
+			matched = idx->by_event_type[etype].run(*this, evt, ruleset_mask, matches);
+		}
+
+		// As for run(), the filters that are not specific to an event
+		// type are only tried in the rulesets that didn't match yet
+		if((ruleset_mask & ~matched) != 0)
+		{
+			idx->all_event_types.run(*this, evt, ruleset_mask & ~matched, matches);
+		}
+
+		return !matches.empty();
+	}
+
+	void begin_changes() override
+	{
+		std::lock_guard<std::mutex> lock(m_rulesets_mtx);
+		m_batching = true;
+	}
+
+	void commit_changes() override
+	{
+		std::lock_guard<std::mutex> lock(m_rulesets_mtx);
+		m_batching = false;
+		publish_staged();
+	}
+
+	// The orderings are computed on copies of the rulesets, published
+	// along with their filters, so that run() finds them in the snapshot
+	// it reads once per event. The changes of a batch in progress are
+	// left staged, and get their ordering the next time.
+	void update_rule_ordering() override
+	{
+		std::lock_guard<std::mutex> lock(m_rulesets_mtx);
+		auto cur = std::atomic_load(&m_rulesets);
+		if(!cur)
+		{
+			return;
+		}
+		auto next = std::make_shared<ruleset_filters_vec>(*cur);
+		for(auto &ruleset_ptr : *next)
+		{
+			if(ruleset_ptr)
+			{
+				auto ruleset = std::make_shared<ruleset_filters>(*ruleset_ptr);
+				ruleset->update_ordering(*this);
+				ruleset_ptr = ruleset;
+			}
+		}
+		publish_rulesets(next);
+	}
+
+	size_t memory_usage() const override
+	{
+		size_t res = falco::utils::memory::of(m_filters);
+		res += falco::utils::memory::of(m_added);
+		res += falco::utils::memory::of(m_added_by_name);
+		res += falco::utils::memory::of(m_added_by_tag);
+		for(const auto &wrap : m_filters)
+		{
+			res += sizeof(filter_wrapper) + wrapper_memory_usage(*wrap);
+		}
+
+		auto rs = rulesets();
+		if(rs)
+		{
+			res += falco::utils::memory::of(*rs);
+			for(const auto &ruleset_ptr : *rs)
+			{
+				if(ruleset_ptr)
+				{
+					res += sizeof(ruleset_filters) + ruleset_ptr->memory_usage();
+				}
+			}
+		}
+
+		auto idx = std::atomic_load(&m_multi_index);
+		if(idx)
+		{
+			res += sizeof(*idx) + idx->memory_usage();
+		}
+
+		res += falco::utils::memory::of(m_compat_matches);
+		res += falco::utils::memory::of(m_batch_order);
+		res += falco::utils::memory::of(m_single_wrapper);
+		res += falco::utils::memory::of(m_keyed_tables);
+		res += falco::utils::memory::of(m_keyed_merged);
+		return res;
+	}
+
+	// The copying variants of run() are kept for compatibility, and
+	// are implemented on top of the non-copying ones.
 	bool run(sinsp_evt *evt, falco_rule &match, uint16_t ruleset_id) override
 	{
-		if(m_rulesets.size() < (size_t)ruleset_id + 1)
+		const falco_rule *m = nullptr;
+		if(!run(evt, m, ruleset_id))
 		{
 			return false;
 		}
 
-		return m_rulesets[ruleset_id]->run(*this, evt, match);
+		match = *m;
+		return true;
 	}
 
 	bool run(sinsp_evt *evt, std::vector<falco_rule> &matches, uint16_t ruleset_id) override
 	{
-		if(m_rulesets.size() < (size_t)ruleset_id + 1)
+		m_compat_matches.clear();
+		if(!run(evt, m_compat_matches, ruleset_id))
 		{
 			return false;
 		}
 
-		return m_rulesets[ruleset_id]->run(*this, evt, matches);
+		for(const auto *m : m_compat_matches)
+		{
+			matches.push_back(*m);
+		}
+		return true;
 	}
 
 	typedef std::list<std::shared_ptr<filter_wrapper>>
 		filter_wrapper_list;
 
+	// A compacted, read-only copy of a filter_wrapper_list. The
+	// lists are only used when enabling/disabling filters, and each
+	// change is reflected in a contiguous array of raw pointers
+	// that is walked on the hot path. The pointed wrappers are
+	// owned by m_filters, which outlives all the tables.
+	typedef std::vector<filter_wrapper *>
+		filter_wrapper_table;
+
 	// Subclasses should call add_wrapper (most likely from
 	// filter_ruleset::add or ::add_compile_output) to add filters.
 	void add_wrapper(std::shared_ptr<filter_wrapper> wrap)
 	{
-		m_filters.insert(wrap);
+		if(!m_filters.insert(wrap).second)
+		{
+			return;
+		}
+		size_t idx = m_added.size();
+		m_added.push_back(wrap);
+		m_added_by_name[wrap->name()].push_back(idx);
+		for(const auto &tag : wrap->tags())
+		{
+			m_added_by_tag[tag].push_back(idx);
+		}
 	}
 
 	// If a subclass needs to iterate over all filters, they can
@@ -170,8 +449,10 @@ public:
 	{
 		uint64_t num_filters = 0;
 
-		for(const auto &ruleset_ptr : m_rulesets)
+		auto rs = rulesets();
+		for(size_t i = 0; rs && i < rs->size(); i++)
 		{
+			const auto &ruleset_ptr = (*rs)[i];
 			if(ruleset_ptr)
 			{
 				for(const auto &wrap : ruleset_ptr->get_filters())
@@ -188,8 +469,59 @@ public:
 	// A subclass must implement these methods. They are analogous
 	// to run() but take care of selecting filters that match a
 	// ruleset and possibly an event type.
-	virtual bool run_wrappers(sinsp_evt *evt, filter_wrapper_list &wrappers, uint16_t ruleset_id, std::vector<falco_rule> &matches) = 0;
-	virtual bool run_wrappers(sinsp_evt *evt, filter_wrapper_list &wrappers, uint16_t ruleset_id, falco_rule &match) = 0;
+	// Matching rules are reported as pointers that must stay valid
+	// until the next invocation of run_wrappers().
+	virtual bool run_wrappers(sinsp_evt *evt, const filter_wrapper_table &wrappers, uint16_t ruleset_id, std::vector<const falco_rule *> &matches) = 0;
+	virtual bool run_wrappers(sinsp_evt *evt, const filter_wrapper_table &wrappers, uint16_t ruleset_id, const falco_rule *&match) = 0;
+
+	// A subclass can implement this method to evaluate a single filter
+	// without going through a table, which is what run_multi() does.
+	// The default implementation relies on run_wrappers().
+	virtual bool run_wrapper(sinsp_evt *evt, filter_wrapper *wrap, const falco_rule *&match)
+	{
+		m_single_wrapper.assign(1, wrap);
+		return run_wrappers(evt, m_single_wrapper, 0, match);
+	}
+
+	// A subclass must implement this method if it supports the rules
+	// compiled lazily (see falco_rule::filter). It's invoked each time a
+	// filter is enabled in a ruleset, before it's evaluated, and should
+	// compile it if that's not done yet. The filters that aren't enabled
+	// in any ruleset are never evaluated, so they can be compiled without
+	// synchronizing with the evaluation of the rulesets. It's invoked
+	// under m_rulesets_mtx, by whichever thread enables the filter.
+	virtual void prepare_filter(filter_wrapper &wrap)
+	{
+	}
+
+	// A subclass can implement this method to index the filters of the
+	// plugin events by the value of the field they require (see
+	// plugin_event_field()). It should set value to the value of the
+	// field in the event, or to an empty string if it has none, and
+	// return true. If it returns false, all the filters requiring the
+	// field are run, which is what the default implementation does.
+	virtual bool extract_plugin_event_field(sinsp_evt *evt, const std::string &field, std::string &value)
+	{
+		return false;
+	}
+
+	// A subclass can implement this method to enable the adaptive
+	// ordering of filters (see update_rule_ordering()). It should set
+	// score to the expected cost of evaluating the filter per each
+	// match it produces (lower is better) and return true, or return
+	// false if no data is available yet for the given filter.
+	virtual bool ordering_score(const filter_wrapper &wrap, double &score)
+	{
+		return false;
+	}
+
+	// A subclass can implement this method to account for the memory
+	// owned by its filter wrappers in memory_usage(), not counting the
+	// size of the wrapper itself.
+	virtual size_t wrapper_memory_usage(const filter_wrapper &wrap) const
+	{
+		return 0;
+	}
 
 private:
 	// Helper used by enable()/disable()
@@ -199,47 +531,61 @@ private:
 		bool enabled,
 		uint16_t ruleset_id)
 	{
-		while(m_rulesets.size() < (size_t)ruleset_id + 1)
+		// Only the names are looked up, and the filters are selected in
+		// the order in which they were added
+		std::vector<size_t> selected;
+		bool all = pattern.empty() && match != match_type::wildcard;
+		switch(match)
 		{
-			m_rulesets.emplace_back(std::make_shared<ruleset_filters>(m_rulesets.size()));
-		}
-
-		for(const auto &wrap : m_filters)
+		case match_type::exact:
 		{
-			bool matches;
-			std::string::size_type pos;
-
-			switch(match)
+			auto it = m_added_by_name.find(pattern);
+			if(!all && it != m_added_by_name.end())
 			{
-			case match_type::exact:
-				pos = wrap->name().find(pattern);
-
-				matches = (pattern == "" || (pos == 0 &&
-							     pattern.size() == wrap->name().size()));
-				break;
-			case match_type::substring:
-				matches = (pattern == "" || (wrap->name().find(pattern) != std::string::npos));
-				break;
-			case match_type::wildcard:
-				matches = falco::utils::matches_wildcard(pattern, wrap->name());
-				break;
-			default:
-				// should never happen
-				matches = false;
+				selected = it->second;
 			}
-
-			if(matches)
+			break;
+		}
+		case match_type::substring:
+			for(const auto &n : m_added_by_name)
 			{
-				if(enabled)
+				if(!all && n.first.find(pattern) != std::string::npos)
 				{
-					m_rulesets[ruleset_id]->add_filter(wrap);
+					selected.insert(selected.end(), n.second.begin(), n.second.end());
 				}
-				else
+			}
+			break;
+		case match_type::wildcard:
+		{
+			// the names are sorted, so only the ones starting with the
+			// literal prefix of the pattern can match it
+			auto prefix = pattern.substr(0, pattern.find('*'));
+			for(auto it = m_added_by_name.lower_bound(prefix);
+			    it != m_added_by_name.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+			    ++it)
+			{
+				if(falco::utils::matches_wildcard(pattern, it->first))
 				{
-					m_rulesets[ruleset_id]->remove_filter(wrap);
+					selected.insert(selected.end(), it->second.begin(), it->second.end());
 				}
 			}
+			break;
 		}
+		default:
+			// should never happen
+			break;
+		}
+
+		if(all)
+		{
+			selected.resize(m_added.size());
+			std::iota(selected.begin(), selected.end(), 0);
+		}
+		std::sort(selected.begin(), selected.end());
+		update_ruleset(ruleset_id, [&](ruleset_filters &ruleset)
+		{
+			enable_disable_selected(ruleset, selected, enabled);
+		});
 	}
 
 	// Helper used by enable_tags()/disable_tags()
@@ -248,31 +594,23 @@ private:
 		bool enabled,
 		uint16_t ruleset_id)
 	{
-		while(m_rulesets.size() < (size_t)ruleset_id + 1)
+		std::vector<size_t> selected;
+		for(const auto &tag : tags)
 		{
-			m_rulesets.emplace_back(std::make_shared<ruleset_filters>(m_rulesets.size()));
-		}
-
-		for(const auto &wrap : m_filters)
-		{
-			std::set<std::string> intersect;
-
-			set_intersection(tags.begin(), tags.end(),
-					 wrap->tags().begin(), wrap->tags().end(),
-					 inserter(intersect, intersect.begin()));
-
-			if(!intersect.empty())
+			auto it = m_added_by_tag.find(tag);
+			if(it != m_added_by_tag.end())
 			{
-				if(enabled)
-				{
-					m_rulesets[ruleset_id]->add_filter(wrap);
-				}
-				else
-				{
-					m_rulesets[ruleset_id]->remove_filter(wrap);
-				}
+				selected.insert(selected.end(), it->second.begin(), it->second.end());
 			}
 		}
+
+		// filters with more than one of the tags are selected once
+		std::sort(selected.begin(), selected.end());
+		selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+		update_ruleset(ruleset_id, [&](ruleset_filters &ruleset)
+		{
+			enable_disable_selected(ruleset, selected, enabled);
+		});
 	}
 
 	// A group of filters all having the same ruleset
@@ -282,14 +620,46 @@ private:
 		ruleset_filters(uint16_t ruleset_id):
 			m_ruleset_id(ruleset_id) {}
 
+		// Copies the enabled filters along with their adaptive
+		// ordering, which commit() drops for the event types whose
+		// filters change until update_ordering() computes it again
+		ruleset_filters(const ruleset_filters &o):
+			m_ruleset_id(o.m_ruleset_id),
+			m_filter_by_event_type(o.m_filter_by_event_type),
+			m_filter_all_event_types(o.m_filter_all_event_types),
+			m_table_by_event_type(o.m_table_by_event_type),
+			m_table_all_event_types(o.m_table_all_event_types),
+			m_ordered_by_event_type(o.m_ordered_by_event_type),
+			m_ordered_all_event_types(o.m_ordered_all_event_types),
+			m_async_by_name(o.m_async_by_name),
+			m_async_any_name(o.m_async_any_name),
+			m_async_order(o.m_async_order),
+			m_plugin_by_field(o.m_plugin_by_field),
+			m_plugin_any_field(o.m_plugin_any_field),
+			m_plugin_order(o.m_plugin_order),
+			m_sc_codes(o.m_sc_codes),
+			m_event_codes(o.m_event_codes),
+			m_sc_code_refs(o.m_sc_code_refs),
+			m_event_code_refs(o.m_event_code_refs),
+			m_filters(o.m_filters) {}
+
 		virtual ~ruleset_filters(){};
 
+		// Adding and removing filters only updates the lists, the tables
+		// used by run() are rebuilt by commit() once all the changes
+		// are done
 		void add_filter(std::shared_ptr<filter_wrapper> wrap)
 		{
+			if(!m_filters.insert(wrap).second)
+			{
+				return;
+			}
+
 			if(wrap->event_codes().empty())
 			{
 				// Should run for all event types
-				add_wrapper_to_list(m_filter_all_event_types, wrap);
+				m_filter_all_event_types.push_back(wrap);
+				m_dirty_all_event_types = true;
 			}
 			else
 			{
@@ -298,20 +668,29 @@ private:
 					if(m_filter_by_event_type.size() <= etype)
 					{
 						m_filter_by_event_type.resize(etype + 1);
+						m_table_by_event_type.resize(etype + 1);
+						m_ordered_by_event_type.resize(etype + 1);
 					}
 
-					add_wrapper_to_list(m_filter_by_event_type[etype], wrap);
+					m_filter_by_event_type[etype].push_back(wrap);
+					m_dirty_event_types.push_back(etype);
 				}
 			}
 
-			m_filters.insert(wrap);
+			update_codes(*wrap, 1);
 		}
 
 		void remove_filter(std::shared_ptr<filter_wrapper> wrap)
 		{
+			if(m_filters.erase(wrap) == 0)
+			{
+				return;
+			}
+
 			if(wrap->event_codes().empty())
 			{
 				remove_wrapper_from_list(m_filter_all_event_types, wrap);
+				m_dirty_all_event_types = true;
 			}
 			else
 			{
@@ -320,11 +699,43 @@ private:
 					if(etype < m_filter_by_event_type.size())
 					{
 						remove_wrapper_from_list(m_filter_by_event_type[etype], wrap);
+						m_dirty_event_types.push_back(etype);
 					}
 				}
 			}
 
-			m_filters.erase(wrap);
+			update_codes(*wrap, -1);
+		}
+
+		// Rebuilds the tables of the event types whose filters changed
+		// since the last invocation
+		void commit()
+		{
+			if(m_dirty_all_event_types)
+			{
+				compact_list(m_filter_all_event_types, m_table_all_event_types);
+				m_ordered_all_event_types.clear();
+				m_dirty_all_event_types = false;
+			}
+
+			std::sort(m_dirty_event_types.begin(), m_dirty_event_types.end());
+			m_dirty_event_types.erase(std::unique(m_dirty_event_types.begin(), m_dirty_event_types.end()),
+						  m_dirty_event_types.end());
+			for(auto etype : m_dirty_event_types)
+			{
+				compact_list(m_filter_by_event_type[etype], m_table_by_event_type[etype]);
+				m_ordered_by_event_type[etype].clear();
+				if(etype == ppm_event_code::PPME_ASYNCEVENT_E)
+				{
+					index_async_events();
+				}
+				else if(etype == ppm_event_code::PPME_PLUGINEVENT_E)
+				{
+					index_plugin_events();
+				}
+			}
+			m_dirty_event_types.clear();
+			m_dirty_event_types.shrink_to_fit();
 		}
 
 		uint64_t num_filters()
@@ -337,23 +748,69 @@ private:
 			return m_filters;
 		}
 
+		inline const std::vector<filter_wrapper_table> &tables_by_event_type() const
+		{
+			return m_table_by_event_type;
+		}
+
+		inline const filter_wrapper_table &table_all_event_types() const
+		{
+			return m_table_all_event_types;
+		}
+
+		// Estimate of the memory used to index the filters, not
+		// counting the filters themselves
+		size_t memory_usage() const
+		{
+			size_t res = falco::utils::memory::of(m_filter_by_event_type);
+			res += falco::utils::memory::of(m_filter_all_event_types);
+			res += falco::utils::memory::of(m_table_by_event_type);
+			res += falco::utils::memory::of(m_table_all_event_types);
+			res += falco::utils::memory::of(m_ordered_by_event_type);
+			res += falco::utils::memory::of(m_async_by_name);
+			res += falco::utils::memory::of(m_async_any_name);
+			res += m_plugin_by_field.capacity() * sizeof(plugin_field_index);
+			for(const auto &i : m_plugin_by_field)
+			{
+				res += i.memory_usage();
+			}
+			res += falco::utils::memory::of(m_plugin_any_field);
+			res += falco::utils::memory::of(m_async_order);
+			res += falco::utils::memory::of(m_plugin_order);
+			res += falco::utils::memory::of(m_sc_code_refs);
+			res += falco::utils::memory::of(m_event_code_refs);
+			res += falco::utils::memory::of(m_ordered_all_event_types);
+			return res + falco::utils::memory::of(m_filters);
+		}
+
 		// Evaluate an event against the ruleset and return the first rule
-		// that matched.
-		bool run(indexable_ruleset &ruleset, sinsp_evt *evt, falco_rule &match)
+		// that matched. If update_ordering() has been invoked, the
+		// filters are evaluated in their adaptive order.
+		bool run(indexable_ruleset &ruleset, sinsp_evt *evt, const falco_rule *&match)
 		{
-			if(evt->get_type() < m_filter_by_event_type.size() &&
-			   m_filter_by_event_type[evt->get_type()].size() > 0)
+			uint16_t etype = evt->get_type();
+			if(etype == ppm_event_code::PPME_ASYNCEVENT_E || etype == ppm_event_code::PPME_PLUGINEVENT_E)
 			{
-				if(ruleset.run_wrappers(evt, m_filter_by_event_type[evt->get_type()], m_ruleset_id, match))
+				if(run_keyed(ruleset, evt, etype, match))
+				{
+					return true;
+				}
+			}
+			else if(etype < m_table_by_event_type.size() &&
+			   !m_table_by_event_type[etype].empty())
+			{
+				const auto &ordered = m_ordered_by_event_type[etype];
+				if(ruleset.run_wrappers(evt, ordered.empty() ? m_table_by_event_type[etype] : ordered, m_ruleset_id, match))
 				{
 					return true;
 				}
 			}
 
 			// Finally, try filters that are not specific to an event type.
-			if(m_filter_all_event_types.size() > 0)
+			if(!m_table_all_event_types.empty())
 			{
-				if(ruleset.run_wrappers(evt, m_filter_all_event_types, m_ruleset_id, match))
+				const auto &ordered = m_ordered_all_event_types;
+				if(ruleset.run_wrappers(evt, ordered.empty() ? m_table_all_event_types : ordered, m_ruleset_id, match))
 				{
 					return true;
 				}
@@ -362,23 +819,44 @@ private:
 			return false;
 		}
 
+		// Computes a new ordering of the filters for each event type,
+		// which is used by run() once this is published. This is only
+		// invoked on unpublished copies, like add_filter() and
+		// remove_filter().
+		void update_ordering(indexable_ruleset &ruleset)
+		{
+			for(size_t etype = 0; etype < m_table_by_event_type.size(); etype++)
+			{
+				compute_ordering(ruleset, m_table_by_event_type[etype], m_ordered_by_event_type[etype]);
+			}
+			compute_ordering(ruleset, m_table_all_event_types, m_ordered_all_event_types);
+		}
+
 		//  Evaluate an event against the ruleset and return all the
 		//  matching rules.
-		bool run(indexable_ruleset &ruleset, sinsp_evt *evt, std::vector<falco_rule> &matches)
+		bool run(indexable_ruleset &ruleset, sinsp_evt *evt, std::vector<const falco_rule *> &matches)
 		{
-			if(evt->get_type() < m_filter_by_event_type.size() &&
-			   m_filter_by_event_type[evt->get_type()].size() > 0)
+			uint16_t etype = evt->get_type();
+			if(etype == ppm_event_code::PPME_ASYNCEVENT_E || etype == ppm_event_code::PPME_PLUGINEVENT_E)
 			{
-				if(ruleset.run_wrappers(evt, m_filter_by_event_type[evt->get_type()], m_ruleset_id, matches))
+				if(run_keyed(ruleset, evt, etype, matches))
+				{
+					return true;
+				}
+			}
+			else if(etype < m_table_by_event_type.size() &&
+			   !m_table_by_event_type[etype].empty())
+			{
+				if(ruleset.run_wrappers(evt, m_table_by_event_type[etype], m_ruleset_id, matches))
 				{
 					return true;
 				}
 			}
 
 			// Finally, try filters that are not specific to an event type.
-			if(m_filter_all_event_types.size() > 0)
+			if(!m_table_all_event_types.empty())
 			{
-				if(ruleset.run_wrappers(evt, m_filter_all_event_types, m_ruleset_id, matches))
+				if(ruleset.run_wrappers(evt, m_table_all_event_types, m_ruleset_id, matches))
 				{
 					return true;
 				}
@@ -387,40 +865,219 @@ private:
 			return false;
 		}
 
-		libsinsp::events::set<ppm_sc_code> sc_codes()
+		inline const libsinsp::events::set<ppm_sc_code> &sc_codes() const
 		{
-			libsinsp::events::set<ppm_sc_code> res;
-			for(const auto &wrap : m_filters)
+			return m_sc_codes;
+		}
+
+		inline const libsinsp::events::set<ppm_event_code> &event_codes() const
+		{
+			return m_event_codes;
+		}
+
+	private:
+		// Updates the union of the codes of the enabled filters, by
+		// counting how many filters have each code
+		void update_codes(filter_wrapper &wrap, int delta)
+		{
+			for(auto code : wrap.sc_codes())
 			{
-				res.insert(wrap->sc_codes().begin(), wrap->sc_codes().end());
+				update_code(m_sc_code_refs, m_sc_codes, code, delta);
+			}
+			for(auto code : wrap.event_codes())
+			{
+				update_code(m_event_code_refs, m_event_codes, code, delta);
 			}
-			return res;
 		}
-		libsinsp::events::set<ppm_event_code> event_codes()
+
+		template<typename T>
+		static void update_code(std::vector<uint32_t> &refs, libsinsp::events::set<T> &codes, T code, int delta)
 		{
-			libsinsp::events::set<ppm_event_code> res;
-			for(const auto &wrap : m_filters)
+			if(refs.size() <= (size_t)code)
 			{
-				res.insert(wrap->event_codes().begin(), wrap->event_codes().end());
+				refs.resize(code + 1, 0);
+			}
+			if(delta > 0 && refs[code]++ == 0)
+			{
+				codes.insert(code);
+			}
+			else if(delta < 0 && --refs[code] == 0)
+			{
+				codes.remove(code);
 			}
-			return res;
 		}
 
-	private:
-		void add_wrapper_to_list(filter_wrapper_list &wrappers, std::shared_ptr<filter_wrapper> wrap)
+		// Rebuilds the index of the filters of the async events by name
+		// from the filters of their event type, preserving their order
+		void index_async_events()
 		{
-			// This is O(n) but it's also uncommon
-			// (when loading rules only).
-			auto pos = std::find(wrappers.begin(),
-					     wrappers.end(),
-					     wrap);
+			m_async_by_name.clear();
+			m_async_any_name.clear();
+			m_async_order.clear();
+			uint16_t etype = ppm_event_code::PPME_ASYNCEVENT_E;
+			if(etype >= m_table_by_event_type.size())
+			{
+				return;
+			}
+
+			for(auto *wrap : m_table_by_event_type[etype])
+			{
+				m_async_order.emplace(wrap, m_async_order.size());
+				if(wrap->async_event_names().empty())
+				{
+					m_async_any_name.push_back(wrap);
+					continue;
+				}
+				for(const auto &name : wrap->async_event_names())
+				{
+					auto it = std::find_if(m_async_by_name.begin(), m_async_by_name.end(),
+						[&name](const std::pair<std::string, filter_wrapper_table> &a)
+						{
+							return a.first == name;
+						});
+					if(it == m_async_by_name.end())
+					{
+						m_async_by_name.emplace_back(name, filter_wrapper_table{});
+						it = std::prev(m_async_by_name.end());
+					}
+					it->second.push_back(wrap);
+				}
+			}
+		}
+
+		// Rebuilds the index of the filters of the plugin events by the
+		// field they require, and then by its values, preserving their order
+		void index_plugin_events()
+		{
+			m_plugin_by_field.clear();
+			m_plugin_any_field.clear();
+			m_plugin_order.clear();
+			uint16_t etype = ppm_event_code::PPME_PLUGINEVENT_E;
+			if(etype >= m_table_by_event_type.size())
+			{
+				return;
+			}
 
-			if(pos == wrappers.end())
+			for(auto *wrap : m_table_by_event_type[etype])
 			{
-				wrappers.push_back(wrap);
+				m_plugin_order.emplace(wrap, m_plugin_order.size());
+				const auto &field = wrap->plugin_event_field();
+				if(field.empty())
+				{
+					m_plugin_any_field.push_back(wrap);
+					continue;
+				}
+				auto it = std::find_if(m_plugin_by_field.begin(), m_plugin_by_field.end(),
+					[&field](const plugin_field_index &i)
+					{
+						return i.field == field;
+					});
+				if(it == m_plugin_by_field.end())
+				{
+					m_plugin_by_field.emplace_back();
+					it = std::prev(m_plugin_by_field.end());
+					it->field = field;
+				}
+				it->all.push_back(wrap);
+				for(const auto &value : wrap->plugin_event_values())
+				{
+					it->by_value[value].push_back(wrap);
+				}
 			}
 		}
 
+		// Runs the filters of an async or plugin event type that can
+		// match the event, which are the ones indexed by its name or by
+		// the value of their fields, and the ones that can match any
+		// event of the type. They are run in the order of the table of
+		// the event type, as if they were not indexed, so that the first
+		// match and the order of the matches don't change.
+		template<typename M>
+		bool run_keyed(indexable_ruleset &ruleset, sinsp_evt *evt, uint16_t etype, M &match)
+		{
+			auto &tables = ruleset.m_keyed_tables;
+			tables.clear();
+			auto add_table = [&tables](const filter_wrapper_table *table)
+			{
+				if(table && !table->empty())
+				{
+					tables.push_back(table);
+				}
+			};
+
+			const std::unordered_map<const filter_wrapper *, size_t> *order;
+			if(etype == ppm_event_code::PPME_ASYNCEVENT_E)
+			{
+				add_table(async_table_by_name(evt));
+				add_table(&m_async_any_name);
+				order = &m_async_order;
+			}
+			else
+			{
+				for(const auto &i : m_plugin_by_field)
+				{
+					// the filters requiring the field are all run if
+					// the ruleset can't extract it
+					const filter_wrapper_table *table = &i.all;
+					auto &value = ruleset.m_plugin_event_value;
+					if(ruleset.extract_plugin_event_field(evt, i.field, value))
+					{
+						auto it = i.by_value.find(value);
+						table = it != i.by_value.end() ? &it->second : nullptr;
+					}
+					add_table(table);
+				}
+				add_table(&m_plugin_any_field);
+				order = &m_plugin_order;
+			}
+
+			if(tables.empty())
+			{
+				return false;
+			}
+			if(tables.size() == 1)
+			{
+				return ruleset.run_wrappers(evt, *tables[0], m_ruleset_id, match);
+			}
+
+			// each filter is in one table at most, and each table is
+			// in order already
+			auto &merged = ruleset.m_keyed_merged;
+			merged.clear();
+			for(const auto *table : tables)
+			{
+				merged.insert(merged.end(), table->begin(), table->end());
+			}
+			std::sort(merged.begin(), merged.end(),
+				[order](const filter_wrapper *a, const filter_wrapper *b)
+				{
+					return order->at(a) < order->at(b);
+				});
+			return ruleset.run_wrappers(evt, merged, m_ruleset_id, match);
+		}
+
+		// Returns the filters that can only match the async events with
+		// the name of the given one, or nullptr if there are none
+		const filter_wrapper_table *async_table_by_name(sinsp_evt *evt) const
+		{
+			if(m_async_by_name.empty())
+			{
+				return nullptr;
+			}
+
+			// the name is the second parameter of async events
+			auto param = evt->get_param(1);
+			std::string_view name(param->m_val, strnlen(param->m_val, param->m_len));
+			for(const auto &a : m_async_by_name)
+			{
+				if(a.first == name)
+				{
+					return &a.second;
+				}
+			}
+			return nullptr;
+		}
+
 		void remove_wrapper_from_list(filter_wrapper_list &wrappers, std::shared_ptr<filter_wrapper> wrap)
 		{
 			// This is O(n) but it's also uncommon
@@ -433,6 +1090,50 @@ private:
 				wrappers.erase(pos);
 			}
 		}
+
+		void compact_list(const filter_wrapper_list &wrappers, filter_wrapper_table &table)
+		{
+			table.clear();
+			table.reserve(wrappers.size());
+			for(const auto &wrap : wrappers)
+			{
+				table.push_back(wrap.get());
+			}
+			table.shrink_to_fit();
+		}
+
+		void compute_ordering(indexable_ruleset &ruleset,
+				      const filter_wrapper_table &table,
+				      filter_wrapper_table &ordered)
+		{
+			ordered.clear();
+			if(table.size() < 2)
+			{
+				return;
+			}
+
+			// Filters with no data yet are evaluated last. Ties are
+			// broken by the definition order, so that the ordering is
+			// deterministic for a given set of observations.
+			std::vector<std::pair<double, size_t>> scores(table.size());
+			for(size_t i = 0; i < table.size(); i++)
+			{
+				double score;
+				if(!ruleset.ordering_score(*table[i], score))
+				{
+					score = std::numeric_limits<double>::infinity();
+				}
+				scores[i] = {score, i};
+			}
+			std::sort(scores.begin(), scores.end());
+
+			ordered.reserve(table.size());
+			for(const auto &s : scores)
+			{
+				ordered.push_back(table[s.second]);
+			}
+		}
+
 		uint16_t m_ruleset_id;
 
 		// Vector indexes from event type to a set of filters. There can
@@ -442,13 +1143,357 @@ private:
 
 		filter_wrapper_list m_filter_all_event_types;
 
+		// Compacted copies of the lists above, kept in sync by
+		// add_filter()/remove_filter() and used by run().
+		std::vector<filter_wrapper_table> m_table_by_event_type;
+
+		filter_wrapper_table m_table_all_event_types;
+
+		// Adaptive orderings of the tables above, computed by
+		// update_ordering() and used by the run() variant returning
+		// the first match. An empty table means that the definition
+		// order is used.
+		std::vector<filter_wrapper_table> m_ordered_by_event_type;
+
+		filter_wrapper_table m_ordered_all_event_types;
+
+		// The filters of async events, split between the ones that can
+		// only match the async events with a given name, looked up
+		// linearly as there are only a few distinct names, and the ones
+		// that can match any of them. Kept in sync by add_filter() and
+		// remove_filter(), and used by run() in place of the table of
+		// the async event type.
+		std::vector<std::pair<std::string, filter_wrapper_table>> m_async_by_name;
+
+		filter_wrapper_table m_async_any_name;
+
+		// The position of each filter in the table of the async event
+		// type, by which the filters of the tables above are merged
+		std::unordered_map<const filter_wrapper *, size_t> m_async_order;
+
+		// The filters of plugin events that require a field to have one
+		// of a set of values, by field, and the ones that don't. Kept in
+		// sync by add_filter() and remove_filter(), and used by run() in
+		// place of the table of the plugin event type.
+		struct plugin_field_index
+		{
+			std::string field;
+			std::unordered_map<std::string, filter_wrapper_table> by_value;
+			filter_wrapper_table all;
+
+			size_t memory_usage() const
+			{
+				return falco::utils::memory::of(field) + falco::utils::memory::of(by_value) + falco::utils::memory::of(all);
+			}
+		};
+
+		std::vector<plugin_field_index> m_plugin_by_field;
+
+		filter_wrapper_table m_plugin_any_field;
+
+		// The position of each filter in the table of the plugin event
+		// type, by which the filters of the tables above are merged
+		std::unordered_map<const filter_wrapper *, size_t> m_plugin_order;
+
+		// The union of the codes of the enabled filters, along with the
+		// number of filters having each code. Used to make sc_codes()
+		// and event_codes() fast.
+		libsinsp::events::set<ppm_sc_code> m_sc_codes;
+		libsinsp::events::set<ppm_event_code> m_event_codes;
+		std::vector<uint32_t> m_sc_code_refs;
+		std::vector<uint32_t> m_event_code_refs;
+
+		// The event types whose lists changed since the last commit()
+		std::vector<uint16_t> m_dirty_event_types;
+		bool m_dirty_all_event_types = false;
+
 		// All filters added. Used to make num_filters() fast.
 		std::set<std::shared_ptr<filter_wrapper>> m_filters;
 	};
 
-	// Vector indexes from ruleset id to set of rules.
-	std::vector<std::shared_ptr<ruleset_filters>> m_rulesets;
+	typedef std::vector<std::shared_ptr<ruleset_filters>> ruleset_filters_vec;
+
+	// Returns the current snapshot of the enabled filters
+	inline std::shared_ptr<const ruleset_filters_vec> rulesets() const
+	{
+		return std::atomic_load(&m_rulesets);
+	}
+
+	// Returns the snapshot used by run(), run_batch() and run_multi(),
+	// which is only loaded again once a new one is published. Those are
+	// invoked by a single thread at a time, so checking the generation
+	// is all an event costs, and the snapshot kept by that thread stays
+	// alive until it runs an event through the next one.
+	inline const ruleset_filters_vec *run_rulesets()
+	{
+		auto generation = m_generation.load(std::memory_order_acquire);
+		if(generation != m_run_generation) [[unlikely]]
+		{
+			m_run_rulesets = std::atomic_load(&m_rulesets);
+			m_run_generation = generation;
+		}
+		return m_run_rulesets.get();
+	}
+
+	inline void publish_rulesets(std::shared_ptr<const ruleset_filters_vec> rulesets)
+	{
+		std::atomic_store(&m_rulesets, rulesets);
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+
+	// Applies func to the filters of the given ruleset in the staged
+	// snapshot, which is a copy of the current one made by the first
+	// change since the last publication, and publishes it unless a batch
+	// of changes is in progress. The following changes of a batch, such
+	// as the ones enabling the rules one at a time while loading, modify
+	// the same copy, and the tables are only rebuilt once all of them
+	// are done, when the staged snapshot is published by commit_changes().
+	void update_ruleset(uint16_t ruleset_id, const std::function<void(ruleset_filters &)> &func)
+	{
+		std::lock_guard<std::mutex> lock(m_rulesets_mtx);
+		if(!m_staged)
+		{
+			auto cur = std::atomic_load(&m_rulesets);
+			m_staged = cur ? std::make_shared<ruleset_filters_vec>(*cur)
+					: std::make_shared<ruleset_filters_vec>();
+			m_staged_copies.assign(m_staged->size(), false);
+		}
+		while(m_staged->size() < (size_t)ruleset_id + 1)
+		{
+			m_staged->emplace_back(std::make_shared<ruleset_filters>(m_staged->size()));
+			m_staged_copies.push_back(true);
+		}
+
+		// the rulesets of the published snapshot are never modified
+		auto &ruleset = (*m_staged)[ruleset_id];
+		if(!m_staged_copies[ruleset_id])
+		{
+			ruleset = std::make_shared<ruleset_filters>(*ruleset);
+			m_staged_copies[ruleset_id] = true;
+		}
+		func(*ruleset);
+		if(!m_batching)
+		{
+			publish_staged();
+		}
+	}
+
+	// Rebuilds the tables of the rulesets changed in the staged snapshot,
+	// if any, and publishes it. Must be called with m_rulesets_mtx held.
+	void publish_staged()
+	{
+		if(!m_staged)
+		{
+			return;
+		}
+		for(size_t i = 0; i < m_staged->size(); i++)
+		{
+			if(m_staged_copies[i])
+			{
+				(*m_staged)[i]->commit();
+			}
+		}
+		publish_rulesets(m_staged);
+		m_staged.reset();
+		m_staged_copies.clear();
+	}
+
+	// Enables or disables the added filters with the given indexes
+	void enable_disable_selected(ruleset_filters &ruleset, const std::vector<size_t> &selected, bool enabled)
+	{
+		for(auto idx : selected)
+		{
+			if(enabled)
+			{
+				prepare_filter(*m_added[idx]);
+				ruleset.add_filter(m_added[idx]);
+			}
+			else
+			{
+				ruleset.remove_filter(m_added[idx]);
+			}
+		}
+	}
+
+	// The union of the filters of the same type enabled in multiple
+	// rulesets, each with the bitmask of the rulesets enabling it, in
+	// the order in which they appear in the rulesets
+	struct multi_table
+	{
+		filter_wrapper_table wrappers;
+		std::vector<uint64_t> rulesets;
+
+		// Evaluates the filters enabled in at least one of the given
+		// rulesets and returns the bitmask of the rulesets that matched
+		uint64_t run(indexable_ruleset &ruleset, sinsp_evt *evt, uint64_t ruleset_mask, std::vector<multi_match> &matches) const
+		{
+			uint64_t matched = 0;
+			for(size_t i = 0; i < wrappers.size(); i++)
+			{
+				uint64_t mask = rulesets[i] & ruleset_mask;
+				if(mask == 0)
+				{
+					continue;
+				}
+
+				const falco_rule *match = nullptr;
+				if(ruleset.run_wrapper(evt, wrappers[i], match))
+				{
+					matches.push_back({match, mask});
+					matched |= mask;
+				}
+			}
+			return matched;
+		}
+
+		size_t memory_usage() const
+		{
+			return falco::utils::memory::of(wrappers) + falco::utils::memory::of(rulesets);
+		}
+	};
+
+	// Used by run_multi(), and built from a snapshot of the rulesets the
+	// first time it's needed. The snapshot is retained by the index, so
+	// that its filters stay valid as long as the index is used.
+	struct multi_index
+	{
+		std::shared_ptr<const ruleset_filters_vec> rulesets;
+		std::vector<multi_table> by_event_type;
+		multi_table all_event_types;
+
+		size_t memory_usage() const
+		{
+			size_t res = by_event_type.capacity() * sizeof(multi_table) + all_event_types.memory_usage();
+			for(const auto &t : by_event_type)
+			{
+				res += t.memory_usage();
+			}
+			return res;
+		}
+	};
+
+	// Returns the multi-ruleset index of the current snapshot of the
+	// rulesets, building it if the snapshot changed since the last time.
+	// Rulesets with ids that don't fit in the bitmask are left out.
+	const multi_index *get_multi_index()
+	{
+		auto rs = run_rulesets();
+		if(!rs)
+		{
+			return nullptr;
+		}
+		if(m_run_multi_index && m_run_multi_index->rulesets.get() == rs)
+		{
+			return m_run_multi_index.get();
+		}
+
+		auto next = std::make_shared<multi_index>();
+		next->rulesets = m_run_rulesets;
+		std::vector<std::unordered_map<filter_wrapper *, size_t>> pos_by_event_type;
+		std::unordered_map<filter_wrapper *, size_t> pos_all_event_types;
+		for(size_t id = 0; id < rs->size() && id < max_multi_rulesets; id++)
+		{
+			const auto &ruleset_ptr = (*rs)[id];
+			if(!ruleset_ptr)
+			{
+				continue;
+			}
+
+			uint64_t bit = (uint64_t)1 << id;
+			const auto &tables = ruleset_ptr->tables_by_event_type();
+			if(next->by_event_type.size() < tables.size())
+			{
+				next->by_event_type.resize(tables.size());
+				pos_by_event_type.resize(tables.size());
+			}
+			for(size_t etype = 0; etype < tables.size(); etype++)
+			{
+				add_to_multi_table(next->by_event_type[etype], pos_by_event_type[etype], tables[etype], bit);
+			}
+			add_to_multi_table(next->all_event_types, pos_all_event_types, ruleset_ptr->table_all_event_types(), bit);
+		}
+
+		m_run_multi_index = next;
+		std::atomic_store(&m_multi_index, m_run_multi_index);
+		return next.get();
+	}
+
+	static void add_to_multi_table(multi_table &table, std::unordered_map<filter_wrapper *, size_t> &pos,
+				       const filter_wrapper_table &wrappers, uint64_t bit)
+	{
+		for(auto *wrap : wrappers)
+		{
+			auto it = pos.find(wrap);
+			if(it != pos.end())
+			{
+				table.rulesets[it->second] |= bit;
+				continue;
+			}
+			pos[wrap] = table.wrappers.size();
+			table.wrappers.push_back(wrap);
+			table.rulesets.push_back(bit);
+		}
+	}
+
+	// Vector indexes from ruleset id to set of rules. Each snapshot is
+	// immutable once published, and is always accessed with rulesets(),
+	// run_rulesets() and publish_rulesets(). Enabling or disabling rules
+	// stages a new snapshot, published by the thread making the changes
+	// once they are done, and updating their adaptive ordering publishes
+	// one, so that it can be done while other threads are running events
+	// through the previous snapshot. Each snapshot holds references to
+	// its filters, so old snapshots and their filters are released only
+	// once the last reader is done.
+	std::shared_ptr<const ruleset_filters_vec> m_rulesets;
+
+	// The snapshot with the changes not published yet, if any, which of
+	// its rulesets are copies with changes, and whether a batch of changes
+	// is in progress, see update_ruleset()
+	std::shared_ptr<ruleset_filters_vec> m_staged;
+	std::vector<bool> m_staged_copies;
+	bool m_batching = false;
+
+	// Serializes the snapshot updates
+	std::mutex m_rulesets_mtx;
+
+	// The number of snapshots published so far, and the snapshot used by
+	// the thread running events along with its generation, see
+	// run_rulesets()
+	std::atomic<uint64_t> m_generation{0};
+	uint64_t m_run_generation = UINT64_MAX;
+	std::shared_ptr<const ruleset_filters_vec> m_run_rulesets;
 
 	// All filters added. The set of enabled filters is held in m_rulesets
 	std::set<std::shared_ptr<filter_wrapper>> m_filters;
+
+	// The filters added, in order, and their indexes by name and by tag.
+	// Used to enable and disable filters without matching all of them.
+	// The names are sorted, so that the ones with a given prefix are
+	// next to each other.
+	std::vector<std::shared_ptr<filter_wrapper>> m_added;
+	std::map<std::string, std::vector<size_t>> m_added_by_name;
+	std::unordered_map<std::string, std::vector<size_t>> m_added_by_tag;
+
+	// Used by the copying variant of run() and by run_batch()
+	std::vector<const falco_rule *> m_compat_matches;
+
+	// Used by run_batch()
+	std::vector<size_t> m_batch_order;
+
+	// Used by run_multi(), see get_multi_index(). The index is published
+	// for memory_usage() as well.
+	std::shared_ptr<const multi_index> m_run_multi_index;
+	std::shared_ptr<const multi_index> m_multi_index;
+
+	// Used by the default implementation of run_wrapper()
+	filter_wrapper_table m_single_wrapper;
+
+	// Used by run() to look up the filters of plugin events, see
+	// extract_plugin_event_field()
+	std::string m_plugin_event_value;
+
+	// Used by run() to merge the filters of async and plugin events
+	// that can match an event, see ruleset_filters::run_keyed()
+	std::vector<const filter_wrapper_table *> m_keyed_tables;
+	filter_wrapper_table m_keyed_merged;
 };
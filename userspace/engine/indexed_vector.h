@@ -21,6 +21,8 @@ limitations under the License.
 #include <vector>
 #include <unordered_map>
 
+#include "memory_usage.h"
+
 /*!
 	\brief Simple wrapper of std::vector that allows random access
 	through both numeric and string indexes with O(1) complexity
@@ -53,12 +55,12 @@ public:
 	}
 
 	/*!
-		\brief Removes all the elements
+		\brief Removes all the elements and releases their storage
 	*/
 	virtual inline void clear()
 	{
-		m_entries.clear();
-		m_index.clear();
+		std::vector<T>().swap(m_entries);
+		std::unordered_map<std::string, size_t>().swap(m_index);
 	}
 
 	/*!
@@ -115,6 +117,16 @@ public:
 		return nullptr;
 	}
 
+	/*!
+		\brief Returns an estimate of the memory used by the storage of
+		the vector and by its string index, not counting the memory owned by
+		each of the elements
+	*/
+	virtual inline size_t memory_usage() const
+	{
+		return m_entries.capacity() * sizeof(T) + falco::utils::memory::of(m_index);
+	}
+
 	virtual inline typename std::vector<T>::iterator begin()
 	{
 		return m_entries.begin();
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <initializer_list>
+
+namespace falco
+{
+
+/*!
+	\brief A handle to an immutable value of type T stored in a
+	process-wide pool. Equal values share the same storage, so copying,
+	assigning, and comparing handles for equality costs as much as doing
+	the same with a pointer. Values added to the pool are never released,
+	which makes this suitable for data with a small and bounded set of
+	distinct values, such as rule names, sources, outputs, and tags.
+	Creating a handle from a value is thread-safe, and so is reading
+	through any handle.
+*/
+template<typename T>
+class interned
+{
+public:
+	using value_type = T;
+
+	interned(): m_value(empty_value()) { }
+	interned(const T& v): m_value(intern(v)) { }
+	interned(std::initializer_list<typename T::value_type> l): m_value(intern(T(l))) { }
+
+	template<typename U, typename = std::enable_if_t<
+		std::is_constructible<T, U&&>::value
+		&& !std::is_same<std::decay_t<U>, T>::value
+		&& !std::is_same<std::decay_t<U>, interned>::value>>
+	interned(U&& v): m_value(intern(T(std::forward<U>(v)))) { }
+
+	interned(interned&&) = default;
+	interned& operator = (interned&&) = default;
+	interned(const interned&) = default;
+	interned& operator = (const interned&) = default;
+	~interned() = default;
+
+	inline const T& get() const { return *m_value; }
+	inline operator const T&() const { return *m_value; }
+	inline const T* operator -> () const { return m_value; }
+	inline const T& operator * () const { return *m_value; }
+
+	inline bool empty() const { return m_value->empty(); }
+	inline size_t size() const { return m_value->size(); }
+	inline const char* c_str() const { return m_value->c_str(); }
+
+	// equal values are always stored once, so the pointers are enough
+	friend inline bool operator == (const interned& a, const interned& b) { return a.m_value == b.m_value; }
+	friend inline bool operator != (const interned& a, const interned& b) { return a.m_value != b.m_value; }
+	friend inline bool operator == (const interned& a, const T& b) { return *a.m_value == b; }
+	friend inline bool operator == (const T& a, const interned& b) { return a == *b.m_value; }
+	friend inline bool operator != (const interned& a, const T& b) { return *a.m_value != b; }
+	friend inline bool operator != (const T& a, const interned& b) { return a != *b.m_value; }
+	friend inline bool operator == (const interned& a, const char* b) { return *a.m_value == b; }
+	friend inline bool operator == (const char* a, const interned& b) { return a == *b.m_value; }
+	friend inline bool operator != (const interned& a, const char* b) { return *a.m_value != b; }
+	friend inline bool operator != (const char* a, const interned& b) { return a != *b.m_value; }
+	friend inline bool operator < (const interned& a, const interned& b) { return *a.m_value < *b.m_value; }
+
+	friend inline T operator + (const interned& a, const T& b) { return *a.m_value + b; }
+	friend inline T operator + (const T& a, const interned& b) { return a + *b.m_value; }
+	friend inline T operator + (const interned& a, const char* b) { return *a.m_value + b; }
+	friend inline T operator + (const char* a, const interned& b) { return a + *b.m_value; }
+
+	// found by nlohmann::json through ADL
+	template<typename J>
+	friend inline void to_json(J& j, const interned& v) { j = v.get(); }
+
+private:
+	static const T* intern(const T& v)
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex());
+		return &*pool().insert(v).first;
+	}
+
+	static const T* empty_value()
+	{
+		static const T* v = intern(T{});
+		return v;
+	}
+
+	// both are intentionally leaked, so that handles stay valid
+	// even when used by static objects at exit time
+	static std::set<T>& pool()
+	{
+		static auto* p = new std::set<T>();
+		return *p;
+	}
+
+	static std::mutex& pool_mutex()
+	{
+		static auto* m = new std::mutex();
+		return *m;
+	}
+
+	const T* m_value;
+};
+
+inline std::ostream& operator << (std::ostream& os, const interned<std::string>& s)
+{
+	return os << s.get();
+}
+
+using interned_string = interned<std::string>;
+using interned_tags = interned<std::set<std::string>>;
+
+} // namespace falco
@@ -15,10 +15,20 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <atomic>
+#include <chrono>
 #include <ctime>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include "logger.h"
 
 #include "falco_common.h"
+#include "falco_utils.h"
+
+#ifndef __EMSCRIPTEN__
+#include "tbb/concurrent_queue.h"
+#endif
 
 falco_logger::level falco_logger::current_level = falco_logger::level::INFO;
 bool falco_logger::time_format_iso_8601 = false;
@@ -134,16 +144,56 @@ void falco_logger::set_sinsp_logging(bool enable, const std::string& severity, c
 bool falco_logger::log_stderr = true;
 bool falco_logger::log_syslog = true;
 
-void falco_logger::log(falco_logger::level priority, const std::string&& msg)
+static std::atomic<uint64_t> s_num_dropped{0};
+static std::atomic<uint64_t> s_num_suppressed{0};
+static std::atomic<uint32_t> s_repeated_rate_limit{0};
+
+// The repeats of the messages are counted in one-second windows, in a slot
+// chosen by the hash of the message. The rare messages sharing a slot also
+// share their limit.
+struct repeat_slot
 {
+	std::atomic<uint64_t> window{0};
+	std::atomic<uint32_t> count{0};
+	std::atomic<uint64_t> suppressed{0};
+};
 
-	if(priority > falco_logger::current_level)
+static constexpr size_t s_num_repeat_slots = 256;
+static repeat_slot s_repeat_slots[s_num_repeat_slots];
+
+// Returns false if the message is over the limit of its repeats, and
+// otherwise tells in it how many repeats were suppressed before, if any
+static bool claim_repeat(std::string& msg, uint32_t limit)
+{
+	auto& slot = s_repeat_slots[std::hash<std::string>{}(msg) % s_num_repeat_slots];
+	uint64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	uint64_t window = slot.window.load(std::memory_order_relaxed);
+	if(window != now && slot.window.compare_exchange_strong(window, now, std::memory_order_relaxed))
 	{
-		return;
+		slot.count.store(0, std::memory_order_relaxed);
+	}
+	if(slot.count.fetch_add(1, std::memory_order_relaxed) >= limit)
+	{
+		slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+		s_num_suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
 	}
 
-	std::string copy = msg;
+	uint64_t suppressed = slot.suppressed.exchange(0, std::memory_order_relaxed);
+	if(suppressed > 0)
+	{
+		if(!msg.empty() && msg.back() == '\n')
+		{
+			msg.pop_back();
+		}
+		msg += " (" + std::to_string(suppressed) + " repeated messages suppressed)";
+	}
+	return true;
+}
 
+static void write_log(falco_logger::level priority, std::time_t result, std::string& copy)
+{
 #ifndef _WIN32
 	if (falco_logger::log_syslog)
 	{
@@ -165,16 +215,9 @@ void falco_logger::log(falco_logger::level priority, const std::string&& msg)
 			copy.push_back('\n');
 		}
 
-		std::time_t result = std::time(nullptr);
 		if(falco_logger::time_format_iso_8601)
 		{
-			char buf[sizeof "YYYY-MM-DDTHH:MM:SS-0000"];
-			const struct tm *gtm = std::gmtime(&result);
-			if(gtm != NULL &&
-			   (strftime(buf, sizeof(buf), "%FT%T%z", gtm) != 0))
-			{
-				fprintf(stderr, "%s: %s", buf, copy.c_str());
-			}
+			fprintf(stderr, "%s+0000: %s", falco::utils::iso8601_utc_seconds(result), copy.c_str());
 		}
 		else
 		{
@@ -194,3 +237,135 @@ void falco_logger::log(falco_logger::level priority, const std::string&& msg)
 		}
 	}
 }
+
+#ifndef __EMSCRIPTEN__
+// The logs waiting to be written by the writer thread. This is never
+// freed, so that exiting without stopping the thread is harmless.
+struct async_writer
+{
+	struct entry
+	{
+		falco_logger::level priority = falco_logger::level::INFO;
+		std::time_t time = 0;
+		std::string msg;
+		bool stop = false;
+	};
+
+	tbb::concurrent_bounded_queue<entry> queue;
+	std::thread thread;
+};
+
+static std::mutex s_async_mtx;
+static std::atomic<bool> s_async{false};
+static async_writer* s_async_writer = nullptr;
+
+// note: must be called with s_async_mtx held
+static void stop_async_writer()
+{
+	if(!s_async.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+	s_async.store(false, std::memory_order_release);
+	async_writer::entry e;
+	e.stop = true;
+	s_async_writer->queue.push(std::move(e));
+	s_async_writer->thread.join();
+}
+#endif
+
+void falco_logger::start_async(size_t queue_capacity)
+{
+#ifndef __EMSCRIPTEN__
+	std::lock_guard<std::mutex> lk(s_async_mtx);
+	if(s_async.load(std::memory_order_relaxed))
+	{
+		if((size_t)s_async_writer->queue.capacity() == queue_capacity)
+		{
+			return;
+		}
+		stop_async_writer();
+	}
+	if(queue_capacity == 0)
+	{
+		return;
+	}
+	if(s_async_writer == nullptr)
+	{
+		s_async_writer = new async_writer();
+	}
+	s_async_writer->queue.set_capacity(queue_capacity);
+	s_async_writer->thread = std::thread([]
+	{
+		async_writer::entry e;
+		while(true)
+		{
+			s_async_writer->queue.pop(e);
+			if(e.stop)
+			{
+				return;
+			}
+			write_log(e.priority, e.time, e.msg);
+		}
+	});
+	s_async.store(true, std::memory_order_release);
+#endif
+}
+
+void falco_logger::stop_async()
+{
+#ifndef __EMSCRIPTEN__
+	std::lock_guard<std::mutex> lk(s_async_mtx);
+	stop_async_writer();
+#endif
+}
+
+void falco_logger::set_repeated_rate_limit(uint32_t per_sec)
+{
+	s_repeated_rate_limit.store(per_sec, std::memory_order_relaxed);
+}
+
+uint64_t falco_logger::get_num_dropped()
+{
+	return s_num_dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t falco_logger::get_num_suppressed()
+{
+	return s_num_suppressed.load(std::memory_order_relaxed);
+}
+
+void falco_logger::log(falco_logger::level priority, const std::string&& msg)
+{
+
+	if(priority > falco_logger::current_level)
+	{
+		return;
+	}
+
+	std::string copy = msg;
+
+	uint32_t limit = s_repeated_rate_limit.load(std::memory_order_relaxed);
+	if(limit > 0 && !claim_repeat(copy, limit))
+	{
+		return;
+	}
+
+	std::time_t result = std::time(nullptr);
+#ifndef __EMSCRIPTEN__
+	if(s_async.load(std::memory_order_acquire))
+	{
+		async_writer::entry e;
+		e.priority = priority;
+		e.time = result;
+		e.msg = std::move(copy);
+		if(!s_async_writer->queue.try_push(std::move(e)))
+		{
+			s_num_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		return;
+	}
+#endif
+
+	write_log(priority, result, copy);
+}
@@ -22,6 +22,8 @@ limitations under the License.
 #include <syslog.h>
 #endif
 
+#include <cstdint>
+
 class falco_logger
 {
  public:
@@ -47,8 +49,66 @@ class falco_logger
 
 	static void log(falco_logger::level priority, const std::string&& msg);
 
+	/*!
+		\brief Returns true if the logs of the given level are written
+	*/
+	static inline bool is_enabled(falco_logger::level priority)
+	{
+		return priority <= current_level;
+	}
+
+	/*!
+		\brief Starts writing the logs from a dedicated thread, so that a
+		slow syslog or stderr never blocks the threads logging. The logs
+		wait in a queue of the given capacity, and the ones not fitting
+		in it are dropped and counted. If the logs are already written
+		in background with another capacity, the queued ones are written
+		before changing it. A capacity of 0 writes the logs at once.
+	*/
+	static void start_async(size_t queue_capacity);
+
+	/*!
+		\brief Writes the logs still queued and stops the thread writing
+		them, so that the logs that follow are written at once
+	*/
+	static void stop_async();
+
+	/*!
+		\brief Sets how many times the same message can be logged per
+		second, or 0 for no limit. The repeats over the limit are
+		suppressed and counted, and the next time the message is logged it
+		tells how many repeats were suppressed.
+	*/
+	static void set_repeated_rate_limit(uint32_t per_sec);
+
+	/*!
+		\brief Returns the number of logs dropped because the queue was
+		full, since Falco started
+	*/
+	static uint64_t get_num_dropped();
+
+	/*!
+		\brief Returns the number of repeated logs suppressed by the rate
+		limit, since Falco started
+	*/
+	static uint64_t get_num_suppressed();
+
 	static level current_level;
 	static bool log_stderr;
 	static bool log_syslog;
 	static bool time_format_iso_8601;
 };
+
+/*!
+	\brief Logs a message only if its level is enabled, so that the message
+	is not even built otherwise. Prefer it to falco_logger::log whenever the
+	message is built from other values.
+*/
+#define FALCO_LOG(priority, ...) \
+	do \
+	{ \
+		if(falco_logger::is_enabled(priority)) \
+		{ \
+			falco_logger::log(priority, __VA_ARGS__); \
+		} \
+	} while(0)
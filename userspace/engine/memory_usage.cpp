@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "memory_usage.h"
+
+using namespace libsinsp::filter;
+
+namespace
+{
+
+struct ast_memory_visitor : public ast::expr_visitor
+{
+	size_t m_bytes = 0;
+	size_t m_checks = 0;
+
+	template<typename T>
+	inline void add_node(T*)
+	{
+		m_bytes += sizeof(T);
+	}
+
+	void visit(ast::and_expr* e) override
+	{
+		add_node(e);
+		m_bytes += e->children.capacity() * sizeof(e->children[0]);
+		for(auto& c : e->children)
+		{
+			c->accept(this);
+		}
+	}
+
+	void visit(ast::or_expr* e) override
+	{
+		add_node(e);
+		m_bytes += e->children.capacity() * sizeof(e->children[0]);
+		for(auto& c : e->children)
+		{
+			c->accept(this);
+		}
+	}
+
+	void visit(ast::not_expr* e) override
+	{
+		add_node(e);
+		e->child->accept(this);
+	}
+
+	void visit(ast::identifier_expr* e) override
+	{
+		add_node(e);
+		m_bytes += falco::utils::memory::of(e->identifier);
+	}
+
+	void visit(ast::value_expr* e) override
+	{
+		add_node(e);
+		m_bytes += falco::utils::memory::of(e->value);
+	}
+
+	void visit(ast::list_expr* e) override
+	{
+		add_node(e);
+		m_bytes += falco::utils::memory::of(e->values);
+	}
+
+	void visit(ast::unary_check_expr* e) override
+	{
+		add_node(e);
+		m_checks++;
+		m_bytes += falco::utils::memory::of(e->op);
+		e->left->accept(this);
+	}
+
+	void visit(ast::binary_check_expr* e) override
+	{
+		add_node(e);
+		m_checks++;
+		m_bytes += falco::utils::memory::of(e->op);
+		e->left->accept(this);
+		e->right->accept(this);
+	}
+
+	void visit(ast::field_expr* e) override
+	{
+		add_node(e);
+		m_bytes += falco::utils::memory::of(e->field);
+		m_bytes += falco::utils::memory::of(e->arg);
+	}
+
+	void visit(ast::field_transformer_expr* e) override
+	{
+		add_node(e);
+		m_bytes += falco::utils::memory::of(e->transformer);
+		e->value->accept(this);
+	}
+};
+
+} // namespace
+
+size_t falco::utils::memory::of(ast::expr* e)
+{
+	if(!e)
+	{
+		return 0;
+	}
+	ast_memory_visitor v;
+	e->accept(&v);
+	return v.m_bytes;
+}
+
+size_t falco::utils::memory::num_checks(ast::expr* e)
+{
+	if(!e)
+	{
+		return 0;
+	}
+	ast_memory_visitor v;
+	e->accept(&v);
+	return v.m_checks;
+}
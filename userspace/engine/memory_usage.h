@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/filter/ast.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Helpers for estimating the heap memory owned by common data structures.
+// Each of them returns the bytes allocated on behalf of an object, not
+// counting the size of the object itself, which is accounted for by the
+// owner of the object (e.g. as part of the storage of a container). The
+// node overheads of the node-based containers mirror the ones of the
+// common standard library implementations, so the results are estimates.
+// Pointed objects are not accounted for, as they are either owned by
+// someone else or shared between multiple owners.
+namespace falco::utils::memory
+{
+
+constexpr size_t tree_node_overhead = 4 * sizeof(void*);
+constexpr size_t list_node_overhead = 2 * sizeof(void*);
+constexpr size_t hash_node_overhead = 2 * sizeof(void*);
+
+template<typename T>
+inline std::enable_if_t<std::is_trivially_copyable<T>::value, size_t> of(const T&)
+{
+	return 0;
+}
+
+inline size_t of(const std::string& s)
+{
+	// short strings are stored inline
+	static const size_t inline_capacity = std::string().capacity();
+	return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+template<typename T>
+inline size_t of(const std::shared_ptr<T>&)
+{
+	return 0;
+}
+
+template<typename A, typename B> size_t of(const std::pair<A, B>& p);
+template<typename T> size_t of(const std::vector<T>& v);
+template<typename T> size_t of(const std::list<T>& l);
+template<typename T> size_t of(const std::set<T>& s);
+template<typename K, typename V> size_t of(const std::map<K, V>& m);
+template<typename T> size_t of(const std::unordered_set<T>& s);
+template<typename K, typename V> size_t of(const std::unordered_map<K, V>& m);
+
+template<typename A, typename B>
+size_t of(const std::pair<A, B>& p)
+{
+	return of(p.first) + of(p.second);
+}
+
+template<typename T>
+size_t of(const std::vector<T>& v)
+{
+	size_t res = v.capacity() * sizeof(T);
+	for(const auto& e : v)
+	{
+		res += of(e);
+	}
+	return res;
+}
+
+template<typename T>
+size_t of(const std::list<T>& l)
+{
+	size_t res = l.size() * (sizeof(T) + list_node_overhead);
+	for(const auto& e : l)
+	{
+		res += of(e);
+	}
+	return res;
+}
+
+template<typename T>
+size_t of(const std::set<T>& s)
+{
+	size_t res = s.size() * (sizeof(T) + tree_node_overhead);
+	for(const auto& e : s)
+	{
+		res += of(e);
+	}
+	return res;
+}
+
+template<typename K, typename V>
+size_t of(const std::map<K, V>& m)
+{
+	size_t res = m.size() * (sizeof(std::pair<const K, V>) + tree_node_overhead);
+	for(const auto& e : m)
+	{
+		res += of(e.first) + of(e.second);
+	}
+	return res;
+}
+
+template<typename T>
+size_t of(const std::unordered_set<T>& s)
+{
+	size_t res = s.bucket_count() * sizeof(void*);
+	res += s.size() * (sizeof(T) + hash_node_overhead);
+	for(const auto& e : s)
+	{
+		res += of(e);
+	}
+	return res;
+}
+
+template<typename K, typename V>
+size_t of(const std::unordered_map<K, V>& m)
+{
+	size_t res = m.bucket_count() * sizeof(void*);
+	res += m.size() * (sizeof(std::pair<const K, V>) + hash_node_overhead);
+	for(const auto& e : m)
+	{
+		res += of(e.first) + of(e.second);
+	}
+	return res;
+}
+
+/*!
+	\brief Returns the memory allocated for the nodes of a filter AST,
+	including the root node itself, or 0 if the AST is null.
+*/
+size_t of(libsinsp::filter::ast::expr* e);
+
+/*!
+	\brief Returns the number of field checks of a filter AST, which
+	is the number of filterchecks created when compiling it.
+*/
+size_t num_checks(libsinsp::filter::ast::expr* e);
+
+} // namespace falco::utils::memory
@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "network_matcher.h"
+
+#include <libsinsp/sinsp.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+// Parses a port number, with no sign nor trailing characters
+static bool parse_port(const std::string& s, uint32_t& port)
+{
+	if(s.empty() || s.size() > 5 || !std::all_of(s.begin(), s.end(), ::isdigit))
+	{
+		return false;
+	}
+	port = std::stoul(s);
+	return port <= UINT16_MAX;
+}
+
+static uint32_t read_v4(const uint8_t* data)
+{
+	return ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16)
+		| ((uint32_t) data[2] << 8) | (uint32_t) data[3];
+}
+
+static uint64_t read_u64(const uint8_t* data)
+{
+	uint64_t res = 0;
+	for(size_t i = 0; i < 8; i++)
+	{
+		res = (res << 8) | data[i];
+	}
+	return res;
+}
+
+// Parses an IPv4 or IPv6 address into the first 4 or 16 bytes of addr,
+// in network order, and sets len to its length
+static bool parse_address(const std::string& s, uint8_t* addr, uint32_t& len)
+{
+	if(inet_pton(AF_INET, s.c_str(), addr) == 1)
+	{
+		len = 4;
+		return true;
+	}
+	if(inet_pton(AF_INET6, s.c_str(), addr) == 1)
+	{
+		len = 16;
+		return true;
+	}
+	return false;
+}
+
+static bool is_v4_mapped(const uint8_t* data)
+{
+	static const uint8_t prefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+	return memcmp(data, prefix, sizeof(prefix)) == 0;
+}
+
+std::unique_ptr<network_matcher> network_matcher::create(uint32_t type,
+	const std::string& op, const std::vector<std::string>& values)
+{
+	auto res = std::unique_ptr<network_matcher>(new network_matcher());
+	bool ok = false;
+	switch(type)
+	{
+	case PT_PORT:
+		ok = res->add_ports(op, values);
+		break;
+	case PT_IPV4ADDR:
+	case PT_IPV6ADDR:
+	case PT_IPADDR:
+		ok = (op == "=" || op == "in") && res->add_addresses(type, values, false);
+		break;
+	case PT_IPV4NET:
+	case PT_IPV6NET:
+	case PT_IPNET:
+		ok = (op == "=" || op == "in") && res->add_addresses(type, values, true);
+		break;
+	default:
+		break;
+	}
+	if(!ok)
+	{
+		return nullptr;
+	}
+	return res;
+}
+
+bool network_matcher::add_ports(const std::string& op, const std::vector<std::string>& values)
+{
+	m_ports = true;
+	if(values.empty() || (op != "in" && values.size() != 1))
+	{
+		return false;
+	}
+
+	std::vector<uint32_t> ports;
+	for(const auto& v : values)
+	{
+		uint32_t port = 0;
+		if(!parse_port(v, port))
+		{
+			return false;
+		}
+		ports.push_back(port);
+	}
+
+	if(op == "=" || op == "in")
+	{
+		for(auto p : ports)
+		{
+			m_v4.emplace_back(p, p);
+		}
+	}
+	else if(op == "<" && ports[0] > 0)
+	{
+		m_v4.emplace_back(0, ports[0] - 1);
+	}
+	else if(op == "<=")
+	{
+		m_v4.emplace_back(0, ports[0]);
+	}
+	else if(op == ">" && ports[0] < UINT16_MAX)
+	{
+		m_v4.emplace_back(ports[0] + 1, UINT16_MAX);
+	}
+	else if(op == ">=")
+	{
+		m_v4.emplace_back(ports[0], UINT16_MAX);
+	}
+	else
+	{
+		return false;
+	}
+
+	merge(m_v4);
+	bool singles = std::all_of(m_v4.begin(), m_v4.end(),
+		[](const std::pair<uint32_t, uint32_t>& i) { return i.first == i.second; });
+	if(singles && m_v4.size() <= max_packed_ports)
+	{
+		for(const auto& i : m_v4)
+		{
+			m_packed_ports.push_back(i.first);
+		}
+		m_v4.clear();
+	}
+	return true;
+}
+
+bool network_matcher::add_addresses(uint32_t type, const std::vector<std::string>& values, bool networks)
+{
+	if(values.empty())
+	{
+		return false;
+	}
+
+	for(const auto& v : values)
+	{
+		std::string addr = v;
+		uint32_t prefix = UINT32_MAX;
+		auto slash = v.find('/');
+		if(networks)
+		{
+			// the prefix length is required, as it is by libsinsp
+			if(slash == std::string::npos || slash + 1 == v.size() || v.size() - slash > 4
+			   || !std::all_of(v.begin() + slash + 1, v.end(), ::isdigit))
+			{
+				return false;
+			}
+			addr = v.substr(0, slash);
+			prefix = std::stoul(v.substr(slash + 1));
+		}
+		else if(slash != std::string::npos)
+		{
+			return false;
+		}
+
+		uint8_t buf[16];
+		uint32_t len = 0;
+		if(!parse_address(addr, buf, len)
+		   || (len == 4 && (type == PT_IPV6ADDR || type == PT_IPV6NET))
+		   || (len == 16 && (type == PT_IPV4ADDR || type == PT_IPV4NET)))
+		{
+			return false;
+		}
+
+		if(len == 4)
+		{
+			if(!networks)
+			{
+				prefix = 32;
+			}
+			else if(prefix > 32)
+			{
+				return false;
+			}
+			uint32_t mask = prefix == 0 ? 0 : UINT32_MAX << (32 - prefix);
+			uint32_t start = read_v4(buf) & mask;
+			m_v4.emplace_back(start, start | ~mask);
+		}
+		else
+		{
+			if(!networks)
+			{
+				prefix = 128;
+			}
+			else if(prefix > 128)
+			{
+				return false;
+			}
+			uint64_t hi_mask = prefix == 0 ? 0 : (prefix >= 64 ? UINT64_MAX : UINT64_MAX << (64 - prefix));
+			uint64_t lo_mask = prefix <= 64 ? 0 : (prefix == 128 ? UINT64_MAX : UINT64_MAX << (128 - prefix));
+			ipv6 start = {read_u64(buf) & hi_mask, read_u64(buf + 8) & lo_mask};
+			m_v6.emplace_back(start, ipv6{start.first | ~hi_mask, start.second | ~lo_mask});
+		}
+	}
+
+	merge(m_v4);
+	merge(m_v6);
+	return true;
+}
+
+template<typename T>
+void network_matcher::merge(intervals<T>& v)
+{
+	std::sort(v.begin(), v.end());
+	size_t n = 0;
+	for(size_t i = 0; i < v.size(); i++)
+	{
+		if(n > 0 && v[i].first <= v[n - 1].second)
+		{
+			v[n - 1].second = std::max(v[n - 1].second, v[i].second);
+			continue;
+		}
+		v[n++] = v[i];
+	}
+	v.resize(n);
+	v.shrink_to_fit();
+}
+
+template<typename T>
+bool network_matcher::contains(const intervals<T>& v, const T& x)
+{
+	// the last interval starting at or before x
+	auto it = std::upper_bound(v.begin(), v.end(), x,
+		[](const T& x, const std::pair<T, T>& i) { return x < i.first; });
+	return it != v.begin() && x <= std::prev(it)->second;
+}
+
+bool network_matcher::match(const uint8_t* data, uint32_t len) const
+{
+	if(m_ports)
+	{
+		if(len != sizeof(uint16_t))
+		{
+			return true;
+		}
+		uint16_t port;
+		memcpy(&port, data, sizeof(port));
+		if(m_packed_ports.empty())
+		{
+			return contains<uint32_t>(m_v4, port);
+		}
+
+		// no early exit, so that the loop is vectorized
+		bool found = false;
+		for(auto p : m_packed_ports)
+		{
+			found |= p == port;
+		}
+		return found;
+	}
+
+	if(len == 4)
+	{
+		return contains(m_v4, read_v4(data));
+	}
+	if(len == 16)
+	{
+		return is_v4_mapped(data) || contains(m_v6, ipv6{read_u64(data), read_u64(data + 8)});
+	}
+	return true;
+}
+
+size_t network_matcher::memory_usage() const
+{
+	return sizeof(*this)
+		+ m_packed_ports.capacity() * sizeof(uint16_t)
+		+ m_v4.capacity() * sizeof(m_v4[0])
+		+ m_v6.capacity() * sizeof(m_v6[0]);
+}
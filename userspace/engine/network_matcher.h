@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*!
+	\brief A comparison of a port, IP address, or network field with
+	constant values, such as "fd.sport in (80, 443)", "fd.sport >= 1024",
+	"fd.sip = 10.0.0.1" or "fd.snet in (10.0.0.0/8, 192.168.0.0/16)",
+	specialized for the type of the field. The values are stored as sorted
+	and merged intervals of ports or addresses, which are searched with a
+	binary search, and a few single ports are stored packed and compared
+	all at once without branching, which compilers vectorize. Unlike the
+	generic comparisons of libsinsp, whose cost grows with the number of
+	CIDRs and ranges, the cost of a match is logarithmic at most.
+*/
+class network_matcher
+{
+public:
+	/*!
+		\brief The most single ports compared as a packed array, beyond
+		which they're searched as intervals
+	*/
+	static constexpr size_t max_packed_ports = 32;
+
+	/*!
+		\brief Returns a matcher equivalent to comparing a field of the
+		given ppm_param_type with the given operator and values, or nullptr
+		if the comparison can't be specialized
+	*/
+	static std::unique_ptr<network_matcher> create(uint32_t type,
+		const std::string& op, const std::vector<std::string>& values);
+
+	/*!
+		\brief Returns whether an extracted value, as laid out by libsinsp,
+		satisfies the comparison. Values this matcher can't tell about,
+		such as IPv4-mapped IPv6 addresses, are reported as matching, so
+		that the comparison is left to the filter.
+	*/
+	bool match(const uint8_t* data, uint32_t len) const;
+
+	/*!
+		\brief Returns the number of bytes used by the matcher
+	*/
+	size_t memory_usage() const;
+
+private:
+	using ipv6 = std::pair<uint64_t, uint64_t>;
+
+	template<typename T>
+	using intervals = std::vector<std::pair<T, T>>;
+
+	template<typename T>
+	static void merge(intervals<T>& v);
+
+	template<typename T>
+	static bool contains(const intervals<T>& v, const T& x);
+
+	bool add_ports(const std::string& op, const std::vector<std::string>& values);
+	bool add_addresses(uint32_t type, const std::vector<std::string>& values, bool networks);
+
+	bool m_ports = false;
+
+	// the single ports, if all the values are a few single ports
+	std::vector<uint16_t> m_packed_ports;
+
+	// the intervals of ports or IPv4 addresses, and of IPv6 addresses,
+	// in host order and with their bounds included
+	intervals<uint32_t> m_v4;
+	intervals<ipv6> m_v6;
+};
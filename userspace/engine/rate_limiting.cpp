@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "rate_limiting.h"
+
+using namespace falco;
+
+// Keeps the sum of any time, the burst, and the cost of a claim within
+// 64 bits for times up to 2^62 ns (year 2116)
+static constexpr uint64_t s_max_burst_ns = uint64_t(1) << 61;
+
+void token_bucket::init(double rate, double max_burst)
+{
+	// a rate of zero or less is treated as one token every 2^61 ns
+	// (73 years), which never refills in practice
+	double interval = rate > 0 ? 1e9 / rate : double(s_max_burst_ns);
+	m_interval_ns = std::max<uint64_t>(1, (uint64_t) std::min(std::llround(interval), (long long) s_max_burst_ns));
+	double burst = std::max(0.0, std::floor(max_burst));
+	m_max_claim = (uint64_t) std::min(burst, double(s_max_burst_ns / m_interval_ns));
+	m_burst_ns = m_max_claim * m_interval_ns;
+	m_full_at.store(0, std::memory_order_relaxed);
+}
+
+double token_bucket::get_tokens(uint64_t now) const
+{
+	uint64_t full_at = m_full_at.load(std::memory_order_relaxed);
+	if(full_at <= now)
+	{
+		return double(m_max_claim);
+	}
+	uint64_t missing = full_at - now;
+	return missing >= m_burst_ns ? 0 : double(m_burst_ns - missing) / double(m_interval_ns);
+}
+
+static inline uint64_t slot_value(uint32_t seq, uint64_t count)
+{
+	return (uint64_t(seq) << 32) | std::min<uint64_t>(count, UINT32_MAX);
+}
+
+rate_counter::rate_counter(uint64_t window_ns, uint32_t num_slots):
+	m_slot_ns(std::max<uint64_t>(1, window_ns / std::max<uint32_t>(1, num_slots))),
+	m_num_slots(std::max<uint32_t>(1, num_slots)),
+	m_slots(new std::atomic<uint64_t>[m_num_slots])
+{
+	for(uint32_t i = 0; i < m_num_slots; i++)
+	{
+		m_slots[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void rate_counter::add(uint64_t n, uint64_t now)
+{
+	uint64_t slot = now / m_slot_ns;
+	uint32_t seq = (uint32_t) slot;
+	auto& s = m_slots[slot % m_num_slots];
+	uint64_t cur = s.load(std::memory_order_relaxed);
+	uint64_t next;
+	do
+	{
+		// an empty slot, or one holding an older sequence number, restarts
+		// from zero, while one holding a newer one is left untouched by
+		// the callers that are late by a whole window
+		int32_t age = int32_t(seq - uint32_t(cur >> 32));
+		if((cur & UINT32_MAX) == 0 || age > 0)
+		{
+			next = slot_value(seq, n);
+		}
+		else if(age == 0)
+		{
+			next = slot_value(seq, (cur & UINT32_MAX) + n);
+		}
+		else
+		{
+			return;
+		}
+	}
+	while(!s.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+}
+
+uint64_t rate_counter::count(uint64_t now) const
+{
+	uint32_t seq = (uint32_t) (now / m_slot_ns);
+	uint64_t res = 0;
+	for(uint32_t i = 0; i < m_num_slots; i++)
+	{
+		uint64_t v = m_slots[i].load(std::memory_order_relaxed);
+		uint32_t age = seq - uint32_t(v >> 32);
+		if(age < m_num_slots)
+		{
+			res += v & UINT32_MAX;
+		}
+	}
+	return res;
+}
+
+double rate_counter::rate(uint64_t now) const
+{
+	return double(count(now)) * 1e9 / double(window_ns());
+}
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace falco
+{
+
+/*!
+	\brief A token bucket that gains rate tokens per second up to
+	max_burst tokens, and that starts full. Claiming tokens is lock-free
+	and can be done from any number of threads at once: the whole state
+	is the time at which the bucket will be full again, updated with a
+	single compare-and-swap (this is known as the generic cell rate
+	algorithm). The times are in nanoseconds and are provided by the
+	caller, so that the bucket can follow either the clock or the time of
+	the events. Times going backwards are tolerated, and never grant
+	more tokens than max_burst.
+*/
+class token_bucket
+{
+public:
+	token_bucket() = default;
+	token_bucket(double rate, double max_burst)
+	{
+		init(rate, max_burst);
+	}
+
+	token_bucket(const token_bucket&) = delete;
+	token_bucket& operator = (const token_bucket&) = delete;
+
+	/*!
+		\brief Sets the rate and the maximum number of tokens, and fills
+		the bucket. This is not thread-safe and must happen before the
+		bucket is shared.
+	*/
+	void init(double rate, double max_burst);
+
+	/*!
+		\brief Takes n tokens at the given time if they are all available
+		and returns true, or takes none and returns false
+	*/
+	inline bool claim(uint64_t n, uint64_t now)
+	{
+		if(n > m_max_claim)
+		{
+			return false;
+		}
+		uint64_t cost = n * m_interval_ns;
+		uint64_t full_at = m_full_at.load(std::memory_order_relaxed);
+		uint64_t next;
+		do
+		{
+			next = (full_at > now ? full_at : now) + cost;
+			if(next - now > m_burst_ns)
+			{
+				return false;
+			}
+		}
+		while(!m_full_at.compare_exchange_weak(full_at, next, std::memory_order_relaxed));
+		return true;
+	}
+
+	inline bool claim(uint64_t now)
+	{
+		return claim(1, now);
+	}
+
+	/*!
+		\brief Returns the number of tokens available at the given time
+	*/
+	double get_tokens(uint64_t now) const;
+
+private:
+	uint64_t m_interval_ns = 1;
+	uint64_t m_burst_ns = 0;
+	uint64_t m_max_claim = 0;
+	std::atomic<uint64_t> m_full_at{0};
+};
+
+/*!
+	\brief Counts the occurrences of something over a sliding window of
+	time, split in a fixed number of slots. The window covers the current
+	slot and the previous ones, so the count is exact to within one slot.
+	Adding and reading are lock-free and can be done from any thread: each
+	slot is a single 64 bit word holding the slot's sequence number and its
+	count, which saturates at UINT32_MAX. As for the token bucket, the
+	times are in nanoseconds and are provided by the caller.
+*/
+class rate_counter
+{
+public:
+	rate_counter(uint64_t window_ns, uint32_t num_slots = 10);
+
+	rate_counter(const rate_counter&) = delete;
+	rate_counter& operator = (const rate_counter&) = delete;
+
+	void add(uint64_t n, uint64_t now);
+
+	inline void add(uint64_t now)
+	{
+		add(1, now);
+	}
+
+	/*!
+		\brief Returns the count over the window ending at the given time
+	*/
+	uint64_t count(uint64_t now) const;
+
+	/*!
+		\brief Returns the count over the window ending at the given time,
+		per second
+	*/
+	double rate(uint64_t now) const;
+
+	inline uint64_t window_ns() const
+	{
+		return m_slot_ns * m_num_slots;
+	}
+
+private:
+	uint64_t m_slot_ns;
+	uint32_t m_num_slots;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_slots;
+};
+
+} // namespace falco
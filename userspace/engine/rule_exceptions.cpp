@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "rule_exceptions.h"
+#include "filter_flattener.h"
+#include "filter_or_merger.h"
+#include "memory_usage.h"
+#include "shared_filter_predicates.h"
+
+#include <cstring>
+
+using namespace libsinsp::filter;
+
+// Returns the field of an equality check, with its argument if any, and
+// sets values to the values it's compared with. Returns an empty string if
+// the node is not a plain field compared against constant values.
+static std::string equality_check(const ast::expr* e, std::vector<std::string>& values)
+{
+	auto check = dynamic_cast<const ast::binary_check_expr*>(e);
+	if(!check)
+	{
+		return "";
+	}
+
+	auto field = dynamic_cast<const ast::field_expr*>(check->left.get());
+	if(!field)
+	{
+		return "";
+	}
+
+	values.clear();
+	if(check->op == "=" || check->op == "==")
+	{
+		auto value = dynamic_cast<const ast::value_expr*>(check->right.get());
+		if(!value)
+		{
+			return "";
+		}
+		values.push_back(value->value);
+	}
+	else if(check->op == "in")
+	{
+		auto list = dynamic_cast<const ast::list_expr*>(check->right.get());
+		if(!list)
+		{
+			return "";
+		}
+		values = list->values;
+	}
+	else
+	{
+		return "";
+	}
+
+	return field->arg.empty() ? field->field : field->field + "[" + field->arg + "]";
+}
+
+// Fills def if the exception is the negation of a disjunction of
+// conjunctions of equality checks on the same two or more hashable fields
+static bool to_definition(
+	const ast::expr* conjunct,
+	const std::function<bool(const std::string&)>& is_hashable_field,
+	rule_exceptions::definition& def)
+{
+	auto n = dynamic_cast<const ast::not_expr*>(conjunct);
+	if(!n)
+	{
+		return false;
+	}
+
+	std::vector<const ast::expr*> alternatives;
+	if(auto o = dynamic_cast<const ast::or_expr*>(n->child.get()))
+	{
+		for(const auto& c : o->children)
+		{
+			alternatives.push_back(c.get());
+		}
+	}
+	else
+	{
+		alternatives.push_back(n->child.get());
+	}
+
+	std::vector<const ast::expr*> checks;
+	std::vector<std::string> fields;
+	std::vector<std::vector<std::string>> values;
+	for(const auto* alt : alternatives)
+	{
+		checks.clear();
+		shared_filter_predicates::conjuncts(alt, checks);
+		fields.resize(checks.size());
+		values.resize(checks.size());
+		for(size_t i = 0; i < checks.size(); i++)
+		{
+			fields[i] = equality_check(checks[i], values[i]);
+			if(fields[i].empty())
+			{
+				return false;
+			}
+		}
+
+		if(def.fields.empty())
+		{
+			std::unordered_set<std::string> unique(fields.begin(), fields.end());
+			if(fields.size() < 2 || unique.size() != fields.size())
+			{
+				return false;
+			}
+			for(const auto& f : fields)
+			{
+				if(!is_hashable_field(f))
+				{
+					return false;
+				}
+			}
+			def.fields = fields;
+		}
+		else if(fields != def.fields)
+		{
+			return false;
+		}
+
+		// the alternative matches each combination of the values of
+		// its checks
+		size_t num = 1;
+		for(const auto& v : values)
+		{
+			num *= v.size();
+			if(num > rule_exceptions::max_tuples)
+			{
+				return false;
+			}
+		}
+		if(def.tuples.size() + num > rule_exceptions::max_tuples)
+		{
+			return false;
+		}
+		std::vector<size_t> idx(values.size(), 0);
+		for(size_t t = 0; t < num; t++)
+		{
+			auto& tuple = def.tuples.emplace_back();
+			for(size_t i = 0; i < values.size(); i++)
+			{
+				tuple.push_back(values[i][idx[i]]);
+			}
+			for(size_t i = values.size(); i-- > 0; )
+			{
+				if(++idx[i] < values[i].size())
+				{
+					break;
+				}
+				idx[i] = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool rule_exceptions::split(
+	const ast::expr* condition,
+	size_t num_exceptions,
+	const std::function<bool(const std::string&)>& is_hashable_field,
+	std::unique_ptr<ast::expr>& base,
+	std::vector<definition>& definitions,
+	std::vector<std::unique_ptr<ast::expr>>& others)
+{
+	// the compiler wraps the base condition in parentheses, so that it's
+	// a single operand even if it's an "and" expression itself
+	auto a = dynamic_cast<const ast::and_expr*>(condition);
+	if(num_exceptions == 0 || !a || a->children.size() <= num_exceptions)
+	{
+		return false;
+	}
+
+	size_t num_base = a->children.size() - num_exceptions;
+	if(num_base == 1)
+	{
+		base = ast::clone(a->children[0].get());
+	}
+	else
+	{
+		std::vector<std::unique_ptr<ast::expr>> children;
+		for(size_t i = 0; i < num_base; i++)
+		{
+			children.push_back(ast::clone(a->children[i].get()));
+		}
+		base = ast::and_expr::create(children);
+	}
+
+	for(size_t i = num_base; i < a->children.size(); i++)
+	{
+		definition def;
+		if(to_definition(a->children[i].get(), is_hashable_field, def))
+		{
+			definitions.push_back(std::move(def));
+		}
+		else
+		{
+			others.push_back(ast::clone(a->children[i].get()));
+		}
+	}
+	return true;
+}
+
+// Compiles an optimized copy of a condition
+static std::shared_ptr<sinsp_filter> compile(
+	std::shared_ptr<sinsp_filter_factory> factory,
+	const std::shared_ptr<ast::expr>& condition)
+{
+	std::shared_ptr<ast::expr> optimized = condition;
+	filter_flattener().run(optimized);
+	filter_or_merger().run(optimized);
+	return sinsp_filter_compiler(factory, optimized.get()).compile();
+}
+
+std::shared_ptr<rule_exceptions> rule_exceptions::create(
+	std::shared_ptr<sinsp_filter_factory> factory,
+	const ast::expr* condition,
+	size_t num_exceptions)
+{
+	// the fields extracting a single string, which is compared with
+	// the values as is
+	auto is_hashable_field = [&factory](const std::string& field)
+	{
+		auto chk = factory->new_filtercheck(field.c_str());
+		if(!chk || chk->parse_field_name(field.c_str(), false, true) < 0)
+		{
+			return false;
+		}
+		auto info = chk->get_field_info();
+		return info != nullptr
+			&& (info->m_type == PT_CHARBUF || info->m_type == PT_FSPATH)
+			&& !(info->m_flags & EPF_IS_LIST);
+	};
+
+	std::unique_ptr<ast::expr> base;
+	std::vector<definition> definitions;
+	std::vector<std::unique_ptr<ast::expr>> others;
+	if(!condition || !split(condition, num_exceptions, is_hashable_field, base, definitions, others))
+	{
+		return nullptr;
+	}
+
+	auto res = std::make_shared<rule_exceptions>();
+	res->m_size = num_exceptions;
+	res->m_condition = std::move(base);
+	res->m_filter = compile(factory, res->m_condition);
+	if(!others.empty())
+	{
+		// each exception is a negation, so an event matches one of
+		// them if it doesn't match their conjunction
+		res->m_others = compile(factory, ast::not_expr::create(ast::and_expr::create(others)));
+	}
+	for(const auto& def : definitions)
+	{
+		auto& t = res->m_tables.emplace_back();
+		for(const auto& f : def.fields)
+		{
+			auto chk = factory->new_filtercheck(f.c_str());
+			chk->parse_field_name(f.c_str(), true, true);
+			t.fields.push_back(std::move(chk));
+		}
+		t.keys.reserve(def.tuples.size());
+		std::string key;
+		for(const auto& tuple : def.tuples)
+		{
+			key.clear();
+			for(const auto& v : tuple)
+			{
+				append_key(key, v.c_str(), strlen(v.c_str()));
+			}
+			t.keys.insert(key);
+		}
+	}
+	return res;
+}
+
+size_t rule_exceptions::memory_usage() const
+{
+	size_t res = m_tables.capacity() * sizeof(table);
+	for(const auto& t : m_tables)
+	{
+		res += falco::utils::memory::of(t.keys);
+	}
+	return res;
+}
+
+bool rule_exceptions::match(sinsp_evt* evt)
+{
+	for(auto& t : m_tables)
+	{
+		// an exception can't match if one of its fields can't be
+		// extracted, as each of its alternatives checks all of them
+		bool extracted = true;
+		m_key.clear();
+		for(auto& f : t.fields)
+		{
+			m_values.clear();
+			if(!f->extract(evt, m_values, false) || m_values.size() != 1)
+			{
+				extracted = false;
+				break;
+			}
+			auto value = (const char*) m_values[0].ptr;
+			append_key(m_key, value, strnlen(value, m_values[0].len));
+		}
+		if(extracted && t.keys.find(m_key) != t.keys.end())
+		{
+			return true;
+		}
+	}
+	return m_others && m_others->run(evt);
+}
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+
+#include <libsinsp/sinsp.h>
+#include <libsinsp/filter/ast.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/*!
+	\brief The exceptions of a rule, compiled separately from its base
+	condition so that they're only evaluated on the events matching it.
+	Rule exceptions are appended to the condition as "and not (...)"
+	conjuncts, e.g. "not ((f1 = a and f2 = b) or (f1 = c and f2 in (d, e)))",
+	whose evaluation cost grows with their number of values. When all the
+	fields of such a conjunct on two or more fields are string fields
+	compared with "=" or "in", its values are stored as the tuples (a, b),
+	(c, d) and (c, e) in a hash set, and the exception matches the events
+	whose tuple of extracted values is in the set. The other exceptions
+	are compiled into a filter.
+	This class is not thread-safe.
+*/
+class rule_exceptions
+{
+public:
+	/*!
+		\brief An exception checked with a hash lookup
+	*/
+	struct definition
+	{
+		// the fields of the tuples, with their argument if any
+		std::vector<std::string> fields;
+		std::vector<std::vector<std::string>> tuples;
+	};
+
+	/*!
+		\brief The most tuples an exception can expand into, beyond
+		which it's compiled into the filter of the exceptions
+	*/
+	static constexpr size_t max_tuples = 10000;
+
+	rule_exceptions() = default;
+	virtual ~rule_exceptions() = default;
+	rule_exceptions(rule_exceptions&&) = default;
+	rule_exceptions& operator = (rule_exceptions&&) = default;
+	rule_exceptions(const rule_exceptions&) = delete;
+	rule_exceptions& operator = (const rule_exceptions&) = delete;
+
+	/*!
+		\brief Splits a condition in its base condition and its
+		exceptions, which are its last num_exceptions top-level "and"
+		operands, as appended by the rule compiler.
+		\param condition The condition, which is not modified
+		\param num_exceptions The number of exceptions of the condition
+		\param is_hashable_field Returns true if a field, with its
+		argument if any, extracts a single string compared as is
+		\param base Set to the base condition
+		\param definitions Filled with the exceptions checked with a
+		hash lookup
+		\param others Filled with the other exceptions
+		\return true if the condition has num_exceptions exceptions and
+		a base condition
+	*/
+	static bool split(
+		const libsinsp::filter::ast::expr* condition,
+		size_t num_exceptions,
+		const std::function<bool(const std::string&)>& is_hashable_field,
+		std::unique_ptr<libsinsp::filter::ast::expr>& base,
+		std::vector<definition>& definitions,
+		std::vector<std::unique_ptr<libsinsp::filter::ast::expr>>& others);
+
+	/*!
+		\brief Returns the exceptions of a condition, along with the
+		filter compiled from an optimized copy of its base condition, or
+		nullptr if it has no exceptions.
+		Throws a sinsp_exception if a filter can't be compiled.
+	*/
+	static std::shared_ptr<rule_exceptions> create(
+		std::shared_ptr<sinsp_filter_factory> factory,
+		const libsinsp::filter::ast::expr* condition,
+		size_t num_exceptions);
+
+	/*!
+		\brief Returns the filter of the base condition
+	*/
+	inline const std::shared_ptr<sinsp_filter>& filter() const
+	{
+		return m_filter;
+	}
+
+	/*!
+		\brief Returns the base condition, as written in the condition
+	*/
+	inline const std::shared_ptr<libsinsp::filter::ast::expr>& condition() const
+	{
+		return m_condition;
+	}
+
+	/*!
+		\brief Returns the number of exceptions
+	*/
+	inline size_t size() const
+	{
+		return m_size;
+	}
+
+	/*!
+		\brief Returns the number of exceptions checked with a hash lookup
+	*/
+	inline size_t num_hashed() const
+	{
+		return m_tables.size();
+	}
+
+	/*!
+		\brief Returns an estimate of the memory used by the hash sets,
+		not counting the memory of the filters
+	*/
+	size_t memory_usage() const;
+
+	/*!
+		\brief Returns true if the event matches one of the exceptions,
+		in which case the condition doesn't match it. The hashed
+		exceptions are checked first.
+	*/
+	bool match(sinsp_evt* evt);
+
+private:
+	struct table
+	{
+		std::vector<std::unique_ptr<sinsp_filter_check>> fields;
+		std::unordered_set<std::string> keys;
+	};
+
+	// Appends the key of a tuple of values to out
+	static inline void append_key(std::string& out, const char* value, size_t len)
+	{
+		out.append(value, len);
+		out.push_back('\0');
+	}
+
+	std::shared_ptr<libsinsp::filter::ast::expr> m_condition;
+	std::shared_ptr<sinsp_filter> m_filter;
+	std::vector<table> m_tables;
+	size_t m_size = 0;
+
+	// matches the events matching one of the exceptions that are
+	// not hashed, if any
+	std::shared_ptr<sinsp_filter> m_others;
+
+	// reused across events to avoid allocations
+	std::vector<extract_value_t> m_values;
+	std::string m_key;
+};
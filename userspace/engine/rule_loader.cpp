@@ -18,6 +18,7 @@ limitations under the License.
 #include <string>
 
 #include "rule_loader.h"
+#include "memory_usage.h"
 
 
 static const std::string item_type_strings[] = {
@@ -59,17 +60,35 @@ rule_loader::context::context(const std::string& name)
 	m_locs.push_back(loc);
 }
 
+rule_loader::context::context(const std::string& name, const position& mark_offset)
+	: context(name)
+{
+	m_mark_offset = mark_offset;
+}
+
 rule_loader::context::context(const YAML::Node &item,
 			      const item_type item_type,
 			      const std::string& item_name,
 			      const context& parent)
 {
-	init(parent.name(), position(item.Mark()), item_type, item_name, parent);
+	init(parent.name(), parent.yaml_position(item.Mark()), item_type, item_name, parent);
 }
 
 rule_loader::context::context(const YAML::Mark &mark, const context& parent)
 {
-	init(parent.name(), position(mark), item_type::VALUE_FOR, "", parent);
+	init(parent.name(), parent.yaml_position(mark), item_type::VALUE_FOR, "", parent);
+}
+
+rule_loader::context::position rule_loader::context::yaml_position(const YAML::Mark& mark) const
+{
+	position pos(mark);
+	if(!mark.is_null())
+	{
+		// the offset is at the start of a line, so columns don't change
+		pos.pos += m_mark_offset.pos;
+		pos.line += m_mark_offset.line;
+	}
+	return pos;
 }
 
 rule_loader::context::context(const libsinsp::filter::ast::pos_info& pos,
@@ -114,6 +133,17 @@ const std::string& rule_loader::context::name() const
 	return m_locs.front().name;
 }
 
+size_t rule_loader::context::memory_usage() const
+{
+	size_t res = m_locs.capacity() * sizeof(location);
+	for(const auto& loc : m_locs)
+	{
+		res += falco::utils::memory::of(loc.name);
+		res += falco::utils::memory::of(loc.item_name);
+	}
+	return res + falco::utils::memory::of(alt_content);
+}
+
 void rule_loader::context::init(const std::string& name,
 				const position& pos,
 				const item_type item_type,
@@ -122,6 +152,7 @@ void rule_loader::context::init(const std::string& name,
 {
 	// Copy parent locations
 	m_locs = parent.m_locs;
+	m_mark_offset = parent.m_mark_offset;
 
 	// Add current item to back
 	location loc = {name, pos, item_type, item_name};
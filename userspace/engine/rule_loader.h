@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <optional>
@@ -114,6 +115,13 @@ namespace rule_loader
 		};
 
 		explicit context(const std::string& name);
+
+		// Build a root context for rules content whose YAML nodes
+		// are parsed starting from the given position of the content,
+		// instead of from its beginning. The position must be at the
+		// start of a line. The marks of the YAML nodes of this context and
+		// its children are translated into positions of the whole content.
+		context(const std::string& name, const position& mark_offset);
 		context(const YAML::Node& item,
 			item_type item_type,
 			const std::string& item_name,
@@ -156,6 +164,9 @@ namespace rule_loader
 		std::string as_string();
 		nlohmann::json as_json();
 
+		// Return an estimate of the heap memory owned by this context
+		size_t memory_usage() const;
+
 	private:
 		void init(const std::string& name,
 			  const position& pos,
@@ -171,6 +182,11 @@ namespace rule_loader
 		// creating snippets. Used for contexts involving
 		// condition expressions.
 		std::string alt_content;
+
+		// Position of the content from which YAML nodes are parsed
+		position m_mark_offset;
+
+		position yaml_position(const YAML::Mark& mark) const;
 	};
 
 	struct warning
@@ -264,6 +280,8 @@ namespace rule_loader
 	/*!
 		\brief Contains the info required to load rule definitions
 	*/
+	struct rule_info;
+
 	struct configuration
 	{
 		explicit configuration(
@@ -281,6 +299,12 @@ namespace rule_loader
 		std::string output_extra;
 		bool replace_output_container_info = false;
 
+		// tells whether a rule is enabled once loaded, in which case its
+		// filter is compiled right away. The filters of the other rules
+		// are compiled lazily, see falco_rule::filter. If not set, all
+		// the filters are compiled right away.
+		std::function<bool(const rule_info&)> is_enabled_once_loaded;
+
 		// outputs
 		std::unique_ptr<result> res;
 	};
@@ -451,6 +475,9 @@ namespace rule_loader
 		bool enabled;
 		bool warn_evttypes;
 		bool skip_if_unknown_filter;
+		std::optional<falco_rate_limit> rate_limit;
+		std::optional<falco_rule_threshold> threshold;
+		std::optional<falco_rule_sequence> sequence;
 	};
 
 	/*!
@@ -470,7 +497,8 @@ namespace rule_loader
 		{
 			return cond.has_value() || output.has_value() || desc.has_value() || tags.has_value() ||
 				   exceptions.has_value() || priority.has_value() || enabled.has_value() ||
-				   warn_evttypes.has_value() || skip_if_unknown_filter.has_value();
+				   warn_evttypes.has_value() || skip_if_unknown_filter.has_value() ||
+				   rate_limit.has_value() || threshold.has_value() || sequence.has_value();
 		}
 
 		context ctx;
@@ -485,5 +513,8 @@ namespace rule_loader
 		std::optional<bool> enabled;
 		std::optional<bool> warn_evttypes;
 		std::optional<bool> skip_if_unknown_filter;
+		std::optional<falco_rate_limit> rate_limit;
+		std::optional<falco_rule_threshold> threshold;
+		std::optional<falco_rule_sequence> sequence;
 	};
 };
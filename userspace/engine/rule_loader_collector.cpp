@@ -385,6 +385,27 @@ void rule_loader::collector::selective_replace(configuration& cfg, rule_update_i
 		prev->skip_if_unknown_filter = *info.skip_if_unknown_filter;
 	}
 
+	if (info.rate_limit.has_value())
+	{
+		prev->rate_limit = info.rate_limit;
+	}
+
+	// a rule alerts on either a threshold or a sequence, so replacing one
+	// drops the other
+	THROW(info.threshold.has_value() && info.sequence.has_value(),
+	       "A rule can't have both a threshold and a sequence", info.ctx);
+	if (info.threshold.has_value())
+	{
+		prev->threshold = info.threshold;
+		prev->sequence.reset();
+	}
+
+	if (info.sequence.has_value())
+	{
+		prev->sequence = info.sequence;
+		prev->threshold.reset();
+	}
+
 	replace_info(prev, info, m_cur_index++);
 }
 
@@ -15,13 +15,24 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <string>
 #include <memory>
 #include <set>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "rule_loader_compiler.h"
 #include "filter_warning_resolver.h"
+#include "filter_flattener.h"
+#include "filter_list_resolver.h"
+#include "filter_or_merger.h"
+#include "memory_usage.h"
+#include "rule_exceptions.h"
+#include "rules_arena.h"
 
 #define MAX_VISIBILITY		((uint32_t) -1)
 
@@ -73,7 +84,8 @@ static bool is_format_valid(const falco_source& source, std::string fmt, std::st
 static void build_rule_exception_infos(
 	const std::vector<rule_loader::rule_exception_info>& exceptions,
 	std::set<std::string>& exception_fields,
-	std::string& condition)
+	std::string& condition,
+	size_t& num_exceptions)
 {
 	std::string tmp;
 	condition = "(" + condition + ")";
@@ -150,7 +162,11 @@ static void build_rule_exception_infos(
 				icond = "";
 			}
 		}
-		condition += icond.empty() ? "" : " and not " + icond;
+		if(!icond.empty())
+		{
+			condition += " and not " + icond;
+			num_exceptions++;
+		}
 	}
 }
 
@@ -176,98 +192,58 @@ static inline rule_loader::macro_info* macro_info_from_name(
 	return ret;
 }
 
-// todo(jasondellaluce): this breaks string escaping in lists
-static bool resolve_list(std::string& cnd, const falco_list& list)
+// Keeps the macros defined in a resolver in line with the ones visible
+// from a given visibility, which are the ones defined before it. Since the
+// visible macros are always a prefix of all the macros in definition order,
+// moving from a visibility to another only (un)defines the macros in between,
+// instead of defining all of them again each time.
+class visible_macros
 {
-	static std::string blanks = " \t\n\r";
-	static std::string delims = blanks + "(),=";
-	std::string tmp;
-	std::string new_cnd;
-	size_t start, end;
-	bool used = false;
-	start = cnd.find(list.name);
-	while (start != std::string::npos)
-	{
-		// the characters surrounding the name must
-		// be delims of beginning/end of string
-		end = start + list.name.length();
-		if ((start == 0 || delims.find(cnd[start - 1]) != std::string::npos)
-			&& (end >= cnd.length() || delims.find(cnd[end]) != std::string::npos))
-		{
-			// shift pointers to consume all whitespaces
-			while (start > 0
-				&& blanks.find(cnd[start - 1]) != std::string::npos)
-			{
-				start--;
-			}
-			while (end < cnd.length()
-				&& blanks.find(cnd[end]) != std::string::npos)
-			{
-				end++;
-			}
-			// create substitution string by concatenating all values
-			std::string sub = "";
-			for (const auto &v : list.items)
-			{
-				if (!sub.empty())
-				{
-					sub += ", ";
-				}
-				tmp = v;
-				quote_item(tmp);
-				sub += tmp;
-			}
-			// if substituted list is empty, we need to
-			// remove a comma from the left or the right
-			if (sub.empty())
-			{
-				if (start > 0 && cnd[start - 1] == ',')
-				{
-					start--;
-				}
-				else if (end < cnd.length() && cnd[end] == ',')
-				{
-					end++;
-				}
-			}
-			// compose new string with substitution
-			new_cnd = "";
-			if (start > 0)
-			{
-				new_cnd += cnd.substr(0, start) + " ";
-			}
-			new_cnd += sub + " ";
-			if (end <= cnd.length())
-			{
-				new_cnd += cnd.substr(end);
-			}
-			cnd = new_cnd;
-			start += sub.length() + 1;
-			used = true;
+public:
+	visible_macros(
+		filter_macro_resolver& resolver,
+		const indexed_vector<rule_loader::macro_info>& infos,
+		const indexed_vector<falco_macro>& macros)
+			: m_resolver(resolver), m_infos(infos), m_macros(macros) { }
+
+	void set_visibility(size_t visibility)
+	{
+		while (m_count < m_infos.size() && m_infos.at(m_count)->index < visibility)
+		{
+			auto info = m_infos.at(m_count++);
+			m_resolver.set_macro(info->name, m_macros.at(info->name)->condition);
+		}
+		while (m_count > 0 && m_infos.at(m_count - 1)->index >= visibility)
+		{
+			auto info = m_infos.at(--m_count);
+			m_resolver.set_macro(info->name, nullptr);
+		}
+	}
+
+	// Updates the definition of a macro, if visible
+	void update(const falco_macro& m)
+	{
+		// note: macros have the same position of their infos
+		if (m.id < m_count)
+		{
+			m_resolver.set_macro(m.name, m.condition);
 		}
-		start = cnd.find(list.name, start + 1);
 	}
-	return used;
-}
+
+private:
+	filter_macro_resolver& m_resolver;
+	const indexed_vector<rule_loader::macro_info>& m_infos;
+	const indexed_vector<falco_macro>& m_macros;
+	size_t m_count = 0;
+};
 
 static inline void resolve_macros(
 	filter_macro_resolver& macro_resolver,
-	const indexed_vector<rule_loader::macro_info>& infos,
 	indexed_vector<falco_macro>& macros,
 	std::shared_ptr<ast::expr>& ast,
 	const std::string& condition,
-	uint32_t visibility,
 	const rule_loader::context &ctx)
 {
-	macro_resolver.clear();
-	for (const auto &m : infos)
-	{
-		if (m.index < visibility)
-		{
-			auto macro = macros.at(m.name);
-			macro_resolver.set_macro(m.name, macro->condition);
-		}
-	}
 	macro_resolver.run(ast);
 
 	// Note: only complaining about the first error or unknown macro
@@ -293,23 +269,17 @@ static inline void resolve_macros(
 
 // note: there is no visibility order between filter conditions and lists
 static std::shared_ptr<ast::expr> parse_condition(
-	std::string condition,
+	const std::string& condition,
+	filter_list_resolver& list_resolver,
 	indexed_vector<falco_list>& lists,
 	const rule_loader::context &ctx)
 {
-	for (auto &l : lists)
-	{
-		if (resolve_list(condition, l))
-		{
-			l.used = true;
-		}
-	}
+	std::shared_ptr<ast::expr> res_ptr;
 	libsinsp::filter::parser p(condition);
 	p.set_max_depth(1000);
 	try
 	{
-		std::shared_ptr<ast::expr> res_ptr(p.parse());
-		return res_ptr;
+		res_ptr = p.parse();
 	}
 	catch (const sinsp_exception& e)
 	{
@@ -320,6 +290,28 @@ static std::shared_ptr<ast::expr> parse_condition(
 			e.what(),
 			parsectx);
 	}
+
+	// lists are expanded in the parsed condition
+	if (list_resolver.run(res_ptr))
+	{
+		for (const auto &name : list_resolver.get_resolved_lists())
+		{
+			lists.at(name)->used = true;
+		}
+	}
+
+	// Note: only complaining about the first error
+	const auto& errors_lists = list_resolver.get_errors();
+	if (!errors_lists.empty())
+	{
+		rule_loader::context listctx(errors_lists.begin()->second, condition, ctx);
+
+		throw rule_loader::rule_load_exception(
+			falco::load_result::LOAD_ERR_COMPILE_CONDITION,
+			errors_lists.begin()->first,
+			listctx);
+	}
+	return res_ptr;
 }
 
 static void apply_output_substitutions(
@@ -379,6 +371,7 @@ void rule_loader::compiler::compile_list_infos(
 void rule_loader::compiler::compile_macros_infos(
 		configuration& cfg,
 		const collector& col,
+		filter_list_resolver& list_resolver,
 		indexed_vector<falco_list>& lists,
 		indexed_vector<falco_macro>& out) const
 {
@@ -386,17 +379,20 @@ void rule_loader::compiler::compile_macros_infos(
 	{
 		falco_macro entry;
 		entry.name = m.name;
-		entry.condition = parse_condition(m.cond, lists, m.cond_ctx);
+		entry.condition = parse_condition(m.cond, list_resolver, lists, m.cond_ctx);
 		entry.used = false;
 		auto macro_id = out.insert(entry, m.name);
 		out.at(macro_id)->id = macro_id;
 	}
 
 	filter_macro_resolver macro_resolver;
+	visible_macros visible(macro_resolver, col.macros(), out);
 	for (auto &m : out)
 	{
 		const auto* info = macro_info_from_name(col, m.name);
-		resolve_macros(macro_resolver, col.macros(), out, m.condition, info->cond, info->visibility, info->ctx);
+		visible.set_visibility(info->visibility);
+		resolve_macros(macro_resolver, out, m.condition, info->cond, info->ctx);
+		visible.update(m);
 	}
 }
 
@@ -407,81 +403,417 @@ static bool err_is_unknown_type_or_field(const std::string& err)
 		|| err.find("unknown event type") != std::string::npos;
 }
 
-bool rule_loader::compiler::compile_condition(
-	configuration& cfg,
+// The state of compiling the condition of a single rule. Once the condition
+// is resolved, its filter is compiled independently from the ones of the
+// other rules, which can happen on any thread.
+struct rule_loader::compiler::condition_job
+{
+	// the source of the condition, if any, its filter factory, and the
+	// function creating other ones for the compiling threads, if any
+	std::string source;
+	std::shared_ptr<sinsp_filter_factory> filter_factory;
+	const falco_source::filter_factory_creator* new_filter_factory = nullptr;
+	std::shared_ptr<libsinsp::filter::ast::expr> ast;
+	std::shared_ptr<sinsp_filter> filter;
+	// the number of exceptions appended to the condition of a rule
+	size_t num_exceptions = 0;
+	std::shared_ptr<rule_exceptions> exceptions;
+	std::string cache_key;
+	bool cached = false;
+	// whether the filter is only validated, see falco_rule::filter
+	bool lazy = false;
+
+	// outcome of compile_filter()
+	bool failed = false;
+	std::string err;
+	libsinsp::filter::ast::pos_info err_pos;
+	std::vector<std::pair<std::string, libsinsp::filter::ast::pos_info>> compile_warnings;
+	std::exception_ptr exception;
+};
+
+static void add_warnings(rule_loader::configuration& cfg, std::vector<rule_loader::warning>& warnings)
+{
+	for (const auto& w : warnings)
+	{
+		cfg.res->add_warning(w.wc, w.msg, w.ctx);
+	}
+	warnings.clear();
+}
+
+void rule_loader::compiler::resolve_condition(
 	filter_macro_resolver& macro_resolver,
+	filter_list_resolver& list_resolver,
 	indexed_vector<falco_list>& lists,
-	const indexed_vector<rule_loader::macro_info>& macros,
 	const std::string& condition,
-	std::shared_ptr<sinsp_filter_factory> filter_factory,
 	const rule_loader::context& cond_ctx,
 	const rule_loader::context& parent_ctx,
-	bool allow_unknown_fields,
 	indexed_vector<falco_macro>& macros_out,
-	std::shared_ptr<libsinsp::filter::ast::expr>& ast_out,
-	std::shared_ptr<sinsp_filter>& filter_out) const
+	std::vector<rule_loader::warning>& warnings,
+	condition_job& job) const
 {
 	std::set<falco::load_result::load_result::warning_code> warn_codes;
 	filter_warning_resolver warn_resolver;
-	ast_out = parse_condition(condition, lists, cond_ctx);
-	resolve_macros(macro_resolver, macros, macros_out, ast_out, condition, MAX_VISIBILITY, parent_ctx);
+	job.ast = parse_condition(condition, list_resolver, lists, cond_ctx);
+	resolve_macros(macro_resolver, macros_out, job.ast, condition, parent_ctx);
 
 	// check for warnings in the filtering condition
-	if(warn_resolver.run(ast_out.get(), warn_codes))
+	if(m_warnings_enabled && warn_resolver.run(job.ast.get(), warn_codes))
 	{
 		for(const auto& w : warn_codes)
 		{
-			cfg.res->add_warning(w, "", parent_ctx);
+			warnings.emplace_back(w, "", parent_ctx);
 		}
 	}
 
+	// reuse the filter compiled for the same expanded condition of the
+	// same source, if any, unless the source has another filter factory
+	// since then
+	job.cache_key = job.source
+		+ ":" + std::to_string(job.num_exceptions)
+		+ ":" + libsinsp::filter::ast::as_string(job.ast.get());
+	auto cached = m_filter_cache.find(job.cache_key);
+	if(cached != m_filter_cache.end() && cached->second.filter_factory == job.filter_factory)
+	{
+		cached->second.generation = m_generation;
+		job.filter = cached->second.filter;
+		job.exceptions = cached->second.exceptions;
+		job.cached = true;
+	}
+}
+
+void rule_loader::compiler::compile_filter(
+	condition_job& job,
+	const std::shared_ptr<sinsp_filter_factory>& filter_factory)
+{
+	if(job.cached)
+	{
+		return;
+	}
+
 	// validate the rule's condition: we compile it into a sinsp filter
-	// on-the-fly and we throw an exception with details on failure
-	sinsp_filter_compiler compiler(filter_factory, ast_out.get());
+	// on-the-fly and record the details on failure
+	sinsp_filter_compiler compiler(filter_factory, job.ast.get());
 	try
 	{
-		filter_out = compiler.compile();
+		job.filter = compiler.compile();
 	}
 	catch(const sinsp_exception& e)
+	{
+		job.failed = true;
+		job.err = e.what();
+		job.err_pos = compiler.get_pos();
+		return;
+	}
+	for (const auto &w : compiler.get_warnings())
+	{
+		job.compile_warnings.emplace_back(w.msg, w.pos);
+	}
+
+	if(job.lazy)
+	{
+		job.filter = nullptr;
+		return;
+	}
+
+	try
+	{
+		compile_evaluation_filter(filter_factory, job.ast, job.num_exceptions, job.filter, job.exceptions);
+	}
+	catch(...)
+	{
+		job.exception = std::current_exception();
+	}
+}
+
+void rule_loader::compiler::compile_evaluation_filter(
+	std::shared_ptr<sinsp_filter_factory> filter_factory,
+	std::shared_ptr<libsinsp::filter::ast::expr> condition,
+	size_t num_exceptions,
+	std::shared_ptr<sinsp_filter>& filter,
+	std::shared_ptr<rule_exceptions>& exceptions)
+{
+	// the filter to be evaluated is compiled from an optimized copy of
+	// the condition if possible. The AST is kept as written, as it's
+	// used for describing the rule.
+	std::shared_ptr<libsinsp::filter::ast::expr> optimized_ast = condition;
+	bool optimized = filter_flattener().run(optimized_ast);
+	optimized = filter_or_merger().run(optimized_ast) || optimized;
+	if(optimized || !filter)
+	{
+		filter = sinsp_filter_compiler(filter_factory, optimized_ast.get()).compile();
+	}
+
+	// rulesets may rather evaluate the exceptions separately, only
+	// on the events matching the base condition
+	exceptions = rule_exceptions::create(filter_factory, condition.get(), num_exceptions);
+}
+
+bool rule_loader::compiler::finish_condition(
+	condition_job& job,
+	const std::string& condition,
+	const rule_loader::context& cond_ctx,
+	bool allow_unknown_fields,
+	std::vector<rule_loader::warning>& warnings) const
+{
+	if(job.cached)
+	{
+		return true;
+	}
+
+	if(job.failed)
 	{
 		// skip the rule silently if skip_if_unknown_filter is true and
 		// we encountered some specific kind of errors
-		std::string err = e.what();
-		rule_loader::context ctx(compiler.get_pos(), condition, cond_ctx);
-		if(err_is_unknown_type_or_field(err) && allow_unknown_fields)
+		rule_loader::context ctx(job.err_pos, condition, cond_ctx);
+		if(err_is_unknown_type_or_field(job.err) && allow_unknown_fields)
 		{
-			cfg.res->add_warning(
+			warnings.emplace_back(
 				falco::load_result::load_result::LOAD_UNKNOWN_FILTER,
-				err,
+				job.err,
 				ctx);
 			return false;
 		}
 		throw rule_loader::rule_load_exception(
 			falco::load_result::load_result::LOAD_ERR_COMPILE_CONDITION,
-			err,
+			job.err,
 			ctx);
 	}
-	for (const auto &w : compiler.get_warnings())
+	if(m_warnings_enabled)
 	{
-		rule_loader::context ctx(w.pos, condition, cond_ctx);
-		cfg.res->add_warning(
-			falco::load_result::load_result::LOAD_COMPILE_CONDITION,
-			w.msg,
-			ctx);
+		for (const auto &w : job.compile_warnings)
+		{
+			rule_loader::context ctx(w.second, condition, cond_ctx);
+			warnings.emplace_back(
+				falco::load_result::load_result::LOAD_COMPILE_CONDITION,
+				w.first,
+				ctx);
+		}
+	}
+	if(job.exception)
+	{
+		std::rethrow_exception(job.exception);
+	}
+
+	// only conditions compiled with no warnings are cached, so that
+	// the warnings are always reported, and only along with their filter
+	if(job.compile_warnings.empty() && !job.lazy)
+	{
+		m_filter_cache[job.cache_key] = {job.filter_factory, job.filter, job.exceptions, m_generation};
 	}
 
 	return true;
 }
 
+bool rule_loader::compiler::compile_condition(
+	configuration& cfg,
+	filter_macro_resolver& macro_resolver,
+	indexed_vector<falco_list>& lists,
+	const indexed_vector<rule_loader::macro_info>& macros,
+	const std::string& condition,
+	std::shared_ptr<sinsp_filter_factory> filter_factory,
+	const rule_loader::context& cond_ctx,
+	const rule_loader::context& parent_ctx,
+	bool allow_unknown_fields,
+	indexed_vector<falco_macro>& macros_out,
+	std::shared_ptr<libsinsp::filter::ast::expr>& ast_out,
+	std::shared_ptr<sinsp_filter>& filter_out) const
+{
+	filter_list_resolver list_resolver;
+	for (const auto &l : lists)
+	{
+		list_resolver.set_list(l.name, l.items);
+	}
+
+	macro_resolver.clear();
+	visible_macros visible(macro_resolver, macros, macros_out);
+	visible.set_visibility(MAX_VISIBILITY);
+
+	std::vector<rule_loader::warning> warnings;
+	condition_job job;
+	job.filter_factory = filter_factory;
+	bool ok;
+	try
+	{
+		resolve_condition(macro_resolver, list_resolver, lists, condition, cond_ctx, parent_ctx, macros_out, warnings, job);
+		compile_filter(job, job.filter_factory);
+		ok = finish_condition(job, condition, cond_ctx, allow_unknown_fields, warnings);
+	}
+	catch(...)
+	{
+		add_warnings(cfg, warnings);
+		throw;
+	}
+	add_warnings(cfg, warnings);
+	ast_out = job.ast;
+	filter_out = job.filter;
+	return ok;
+}
+
+void rule_loader::compiler::set_compile_threads(size_t threads)
+{
+	m_compile_threads = threads;
+}
+
+size_t rule_loader::compiler::get_compile_threads() const
+{
+	return m_compile_threads;
+}
+
+void rule_loader::compiler::set_warnings_enabled(bool enabled)
+{
+	m_warnings_enabled = enabled;
+}
+
+bool rule_loader::compiler::get_warnings_enabled() const
+{
+	return m_warnings_enabled;
+}
+
+size_t rule_loader::compiler::memory_usage() const
+{
+	if(m_filter_cache.empty())
+	{
+		return 0;
+	}
+	size_t res = m_filter_cache.bucket_count() * sizeof(void*);
+	for(const auto& c : m_filter_cache)
+	{
+		res += sizeof(c) + falco::utils::memory::hash_node_overhead;
+		res += falco::utils::memory::of(c.first);
+	}
+	return res;
+}
+
+void rule_loader::compiler::clear_cache()
+{
+	// swapping also releases the buckets
+	decltype(m_filter_cache)().swap(m_filter_cache);
+}
+
+// The state of compiling a single rule
+struct rule_loader::compiler::rule_job
+{
+	const rule_info* info = nullptr;
+	falco_rule rule;
+	std::string condition;
+	condition_job cond;
+	bool skip = false;
+	std::vector<rule_loader::warning> warnings;
+	std::exception_ptr error;
+};
+
+void rule_loader::compiler::prepare_rule(
+	configuration& cfg,
+	filter_macro_resolver& macro_resolver,
+	filter_list_resolver& list_resolver,
+	indexed_vector<falco_list>& lists,
+	indexed_vector<falco_macro>& macros_out,
+	rule_job& job) const
+{
+	std::string err;
+	const auto& r = *job.info;
+
+	// note: this should not be nullptr if the source is not unknown
+	auto source = cfg.sources.at(r.source);
+	THROW(!source,
+	      std::string("Unknown source at compile-time") + r.source,
+	      r.ctx);
+
+	// build filter AST by parsing the condition, building exceptions,
+	// and resolving lists and macros
+	job.condition = r.cond;
+	if (!r.exceptions.empty())
+	{
+		build_rule_exception_infos(
+			r.exceptions, job.rule.exception_fields, job.condition,
+			job.cond.num_exceptions);
+	}
+
+	// build rule output message
+	std::string output = r.output;
+
+	// plugins sources do not have any container info and so we won't apply -pk, -pc, etc.
+	// on the other hand, when using plugins you might want to append custom output based on the plugin
+	// TODO: this is not flexible enough (esp. if you mix plugin with syscalls),
+	// it would be better to add configuration options to control the output.
+	if (!cfg.replace_output_container_info || r.source == falco_common::syscall_source)
+	{
+		apply_output_substitutions(cfg, output);
+	}
+
+	// validate the rule's output
+	if(!is_format_valid(*source, output, err))
+	{
+		// skip the rule silently if skip_if_unknown_filter is true and
+		// we encountered some specific kind of errors
+		if (err_is_unknown_type_or_field(err) && r.skip_if_unknown_filter)
+		{
+			job.warnings.emplace_back(
+				falco::load_result::load_result::LOAD_UNKNOWN_FILTER,
+				err,
+				r.output_ctx);
+			job.skip = true;
+			return;
+		}
+		throw rule_load_exception(
+			falco::load_result::load_result::LOAD_ERR_COMPILE_OUTPUT,
+			err,
+			r.output_ctx);
+	}
+	job.rule.output = output;
+
+	// validate the fields the windows of the rule are keyed by
+	const auto& by = r.threshold.has_value() ? r.threshold->by
+		: r.sequence.has_value() ? r.sequence->by : std::vector<std::string>{};
+	for (const auto& field : by)
+	{
+		if(!is_format_valid(*source, "%" + field, err))
+		{
+			throw rule_load_exception(
+				falco::load_result::load_result::LOAD_ERR_COMPILE_OUTPUT,
+				err,
+				r.ctx);
+		}
+	}
+
+	job.cond.source = r.source;
+	job.cond.filter_factory = source->filter_factory;
+	if(source->new_filter_factory)
+	{
+		job.cond.new_filter_factory = &source->new_filter_factory;
+	}
+	job.cond.lazy = cfg.is_enabled_once_loaded && !cfg.is_enabled_once_loaded(r);
+	resolve_condition(macro_resolver,
+			  list_resolver,
+			  lists,
+			  job.condition,
+			  r.cond_ctx,
+			  r.ctx,
+			  macros_out,
+			  job.warnings,
+			  job.cond);
+}
+
 void rule_loader::compiler::compile_rule_infos(
 	configuration& cfg,
 	const collector& col,
+	filter_list_resolver& list_resolver,
 	indexed_vector<falco_list>& lists,
 	indexed_vector<falco_macro>& macros,
 	indexed_vector<falco_rule>& out) const
 {
-	std::string err, condition;
+	// everything touching the lists, the macros, and the sources is done
+	// serially, in the order in which rules are defined. We stop at the
+	// first rule failing, as no rule after it would be compiled anyways.
+	std::vector<rule_job> jobs;
+
+	// all macros are visible to rules, and are fully expanded at this
+	// point, so they are defined once and never visited again
 	filter_macro_resolver macro_resolver;
+	for (const auto &m : macros)
+	{
+		macro_resolver.set_expanded_macro(m.name, m.condition);
+	}
 	for(const auto& r : col.rules())
 	{
 		// skip the rule if it has an unknown source
@@ -490,72 +822,119 @@ void rule_loader::compiler::compile_rule_infos(
 			continue;
 		}
 
-		// note: this should not be nullptr if the source is not unknown
-		auto source = cfg.sources.at(r.source);
-		THROW(!source,
-		      std::string("Unknown source at compile-time") + r.source,
-		      r.ctx);
-
-		// build filter AST by parsing the condition, building exceptions,
-		// and resolving lists and macros
-		falco_rule rule;
-
-		condition = r.cond;
-		if (!r.exceptions.empty())
+		jobs.emplace_back();
+		auto& job = jobs.back();
+		job.info = &r;
+		try
 		{
-			build_rule_exception_infos(
-				r.exceptions, rule.exception_fields, condition);
+			prepare_rule(cfg, macro_resolver, list_resolver, lists, macros, job);
 		}
-
-		// build rule output message
-		rule.output = r.output;
-
-		// plugins sources do not have any container info and so we won't apply -pk, -pc, etc.
-		// on the other hand, when using plugins you might want to append custom output based on the plugin
-		// TODO: this is not flexible enough (esp. if you mix plugin with syscalls),
-		// it would be better to add configuration options to control the output.
-		if (!cfg.replace_output_container_info || r.source == falco_common::syscall_source)
+		catch(rule_load_exception&)
 		{
-			apply_output_substitutions(cfg, rule.output);
+			job.error = std::current_exception();
+			break;
 		}
+	}
 
-		// validate the rule's output
-		if(!is_format_valid(*cfg.sources.at(r.source), rule.output, err))
+	// the filters are compiled in parallel, as they are independent, with
+	// the ones of the sources that can't create more filter factories
+	// compiled by the loading thread only
+	std::vector<condition_job*> to_compile;
+	std::vector<condition_job*> to_compile_serially;
+	for(auto& job : jobs)
+	{
+		if(!job.error && !job.skip && !job.cond.cached)
+		{
+			auto& queue = job.cond.new_filter_factory ? to_compile : to_compile_serially;
+			queue.push_back(&job.cond);
+		}
+	}
+	for(auto job : to_compile_serially)
+	{
+		compile_filter(*job, job->filter_factory);
+	}
+	size_t num_threads = std::min(m_compile_threads, to_compile.size());
+	if(num_threads <= 1)
+	{
+		for(auto job : to_compile)
 		{
-			// skip the rule silently if skip_if_unknown_filter is true and
-			// we encountered some specific kind of errors
-			if (err_is_unknown_type_or_field(err) && r.skip_if_unknown_filter)
+			compile_filter(*job, job->filter_factory);
+		}
+	}
+	else
+	{
+		// the workers allocate from the arena of the loading thread, if
+		// any, and each creates its own filter factory for each source
+		std::atomic<size_t> next{0};
+		auto arena = falco::rules_arena::current();
+		auto worker = [&next, &to_compile, arena]()
+		{
+			falco::rules_arena::scope arena_scope(arena);
+			std::unordered_map<const sinsp_filter_factory*, std::shared_ptr<sinsp_filter_factory>> factories;
+			for(size_t i = next++; i < to_compile.size(); i = next++)
 			{
-				cfg.res->add_warning(
-					falco::load_result::load_result::LOAD_UNKNOWN_FILTER,
-					err,
-					r.output_ctx);
-				continue;
+				auto job = to_compile[i];
+				auto& factory = factories[job->filter_factory.get()];
+				try
+				{
+					if(!factory)
+					{
+						factory = (*job->new_filter_factory)();
+					}
+				}
+				catch(...)
+				{
+					job->exception = std::current_exception();
+					continue;
+				}
+				compile_filter(*job, factory);
 			}
-			throw rule_load_exception(
-				falco::load_result::load_result::LOAD_ERR_COMPILE_OUTPUT,
-				err,
-				r.output_ctx);
+		};
+		std::vector<std::thread> workers;
+		for(size_t i = 1; i < num_threads; i++)
+		{
+			workers.emplace_back(worker);
+		}
+		worker();
+		for(auto& t : workers)
+		{
+			t.join();
 		}
+	}
 
-		if (!compile_condition(cfg,
-				  macro_resolver,
-				  lists,
-				  col.macros(),
-				  condition,
-				  cfg.sources.at(r.source)->filter_factory,
-				  r.cond_ctx,
-				  r.ctx,
-				  r.skip_if_unknown_filter,
-				  macros,
-				  rule.condition,
-				  rule.filter))
+	// results are then collected in definition order, so that warnings and
+	// errors are the same regardless of the number of threads
+	for(auto& job : jobs)
+	{
+		const auto& r = *job.info;
+		bool ok = false;
+		try
+		{
+			if(job.error)
+			{
+				std::rethrow_exception(job.error);
+			}
+			ok = !job.skip && finish_condition(job.cond, job.condition, r.cond_ctx, r.skip_if_unknown_filter, job.warnings);
+		}
+		catch(...)
+		{
+			add_warnings(cfg, job.warnings);
+			throw;
+		}
+		add_warnings(cfg, job.warnings);
+		if(!ok)
 		{
 			continue;
 		}
 
+		falco_rule& rule = job.rule;
+		rule.condition = job.cond.ast;
+		rule.filter = job.cond.filter;
+		rule.exceptions = job.cond.exceptions;
+		rule.num_exceptions = job.cond.num_exceptions;
+
 		// populate set of event types and emit an special warning
-		if(r.source == falco_common::syscall_source)
+		if(m_warnings_enabled && r.source == falco_common::syscall_source)
 		{
 			auto evttypes = libsinsp::filter::ast::ppm_event_codes(rule.condition.get());
 			if ((evttypes.empty() || evttypes.size() > 100) && r.warn_evttypes)
@@ -573,9 +952,30 @@ void rule_loader::compiler::compile_rule_infos(
 		rule.description = r.desc;
 		rule.priority = r.priority;
 		rule.tags = r.tags;
+		rule.rate_limit = r.rate_limit;
+		rule.threshold = r.threshold;
+		rule.sequence = r.sequence;
 		auto rule_id = out.insert(rule, rule.name);
 		out.at(rule_id)->id = rule_id;
 	}
+
+	// the first step of a sequence must be a rule of the same source,
+	// which is only known once all the rules are compiled
+	for(auto& job : jobs)
+	{
+		const auto& r = *job.info;
+		if(!r.sequence.has_value() || out.at(r.name) == nullptr)
+		{
+			continue;
+		}
+		auto after = out.at(r.sequence->after);
+		THROW(after == nullptr,
+		       "Sequence refers to undefined rule '" + r.sequence->after + "'",
+		       r.ctx);
+		THROW(after->source != r.source,
+		       "Sequence refers to rule '" + r.sequence->after + "' of a different source",
+		       r.ctx);
+	}
 }
 
 std::unique_ptr<rule_loader::compile_output> rule_loader::compiler::new_compile_output()
@@ -589,11 +989,20 @@ void rule_loader::compiler::compile(
 		compile_output& out) const
 {
 	// expand all lists, macros, and rules
+	m_generation++;
 	try
 	{
 		compile_list_infos(cfg, col, out.lists);
-		compile_macros_infos(cfg, col, out.lists, out.macros);
-		compile_rule_infos(cfg, col, out.lists, out.macros, out.rules);
+
+		// the items of each list are parsed only once and then
+		// shared by all the macros and rules referencing it
+		filter_list_resolver list_resolver;
+		for (const auto &l : out.lists)
+		{
+			list_resolver.set_list(l.name, l.items);
+		}
+		compile_macros_infos(cfg, col, list_resolver, out.lists, out.macros);
+		compile_rule_infos(cfg, col, list_resolver, out.lists, out.macros, out.rules);
 	}
 	catch(rule_load_exception &e)
 	{
@@ -601,7 +1010,24 @@ void rule_loader::compiler::compile(
 		return;
 	}
 
+	// drop the cached filters of conditions that are not used anymore
+	for(auto it = m_filter_cache.begin(); it != m_filter_cache.end(); )
+	{
+		if(it->second.generation != m_generation)
+		{
+			it = m_filter_cache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
 	// print info on any dangling lists or macros that were not used anywhere
+	if (!m_warnings_enabled)
+	{
+		return;
+	}
 	for (const auto &m : out.macros)
 	{
 		if (!m.used)
@@ -20,10 +20,14 @@ limitations under the License.
 #include "rule_loader.h"
 #include "rule_loader_compile_output.h"
 #include "rule_loader_collector.h"
+#include "filter_list_resolver.h"
 #include "filter_macro_resolver.h"
 #include "indexed_vector.h"
 #include "falco_rule.h"
 
+#include <unordered_map>
+#include <vector>
+
 namespace rule_loader
 {
 
@@ -51,6 +55,61 @@ public:
 		configuration& cfg,
 		const collector& col,
 		compile_output& out) const;
+
+	/*!
+		\brief Sets the number of threads used to compile the filters
+		of the rules. With more than one thread, the filters are compiled
+		in parallel, and the resulting warnings and errors are the same
+		as when compiling them serially. Each thread uses its own filter
+		factory for a source, created with the creator the source was
+		given (see falco_source::new_filter_factory), and the filters of
+		the sources without one are always compiled by the loading thread.
+		The filterchecks of the factories created this way must be safe to
+		parse from multiple threads. Defaults to 1.
+	*/
+	virtual void set_compile_threads(size_t threads);
+	virtual size_t get_compile_threads() const;
+
+	/*!
+		\brief Sets whether the warnings about the lists, the macros, and
+		the rules are looked for when compiling. With warnings disabled,
+		the conditions are not linted and no warning of the compiler
+		itself is reported, while the errors are reported as usual. This
+		is meant for loading rules already validated elsewhere.
+		Defaults to true.
+	*/
+	virtual void set_warnings_enabled(bool enabled);
+	virtual bool get_warnings_enabled() const;
+
+	/*!
+		\brief Returns an estimate of the memory used to cache the filters
+		compiled by previous invocations of compile(), in bytes. This does
+		not include the filters themselves, which are shared with the
+		compiled rules.
+	*/
+	virtual size_t memory_usage() const;
+
+	/*!
+		\brief Releases the filters cached by previous invocations of
+		compile(), so that the next invocation compiles all of them again.
+	*/
+	virtual void clear_cache();
+
+	/*!
+		\brief Compiles the filter evaluated for a validated condition,
+		which is optimized first, and the exceptions of the condition if
+		they can be evaluated separately. If filter is set, it's the one
+		the condition was validated with, and it's kept if the condition
+		can't be optimized. This is how the rules compiled lazily are
+		compiled once enabled, see falco_rule::filter.
+		\throws sinsp_exception if the condition can't be compiled
+	*/
+	static void compile_evaluation_filter(
+		std::shared_ptr<sinsp_filter_factory> filter_factory,
+		std::shared_ptr<libsinsp::filter::ast::expr> condition,
+		size_t num_exceptions,
+		std::shared_ptr<sinsp_filter>& filter,
+		std::shared_ptr<rule_exceptions>& exceptions);
 protected:
 	 /*!
                 \brief Compile a single condition expression,
@@ -83,15 +142,85 @@ private:
 	void compile_macros_infos(
 		configuration& cfg,
 		const collector& col,
+		filter_list_resolver& list_resolver,
 		indexed_vector<falco_list>& lists,
 		indexed_vector<falco_macro>& out) const;
 
 	void compile_rule_infos(
 		configuration& cfg,
 		const collector& col,
+		filter_list_resolver& list_resolver,
 		indexed_vector<falco_list>& lists,
 		indexed_vector<falco_macro>& macros,
 		indexed_vector<falco_rule>& out) const;
+
+	struct condition_job;
+	struct rule_job;
+
+	// Parses a condition and resolves its lists and macros. This also
+	// looks up for a filter previously compiled for the same condition.
+	void resolve_condition(
+		filter_macro_resolver& macro_resolver,
+		filter_list_resolver& list_resolver,
+		indexed_vector<falco_list>& lists,
+		const std::string& condition,
+		const rule_loader::context& cond_ctx,
+		const rule_loader::context& parent_ctx,
+		indexed_vector<falco_macro>& macros_out,
+		std::vector<rule_loader::warning>& warnings,
+		condition_job& job) const;
+
+	// Compiles the filter of a resolved condition with the given filter
+	// factory. This only depends on the job and on the factory and never
+	// throws, so it can be invoked from any thread owning the factory.
+	static void compile_filter(
+		condition_job& job,
+		const std::shared_ptr<sinsp_filter_factory>& filter_factory);
+
+	// Reports the outcome of compile_filter(), returning false if the
+	// condition should be skipped
+	bool finish_condition(
+		condition_job& job,
+		const std::string& condition,
+		const rule_loader::context& cond_ctx,
+		bool allow_unknown_fields,
+		std::vector<rule_loader::warning>& warnings) const;
+
+	// Validates the output of a rule and resolves its condition
+	void prepare_rule(
+		configuration& cfg,
+		filter_macro_resolver& macro_resolver,
+		filter_list_resolver& list_resolver,
+		indexed_vector<falco_list>& lists,
+		indexed_vector<falco_macro>& macros_out,
+		rule_job& job) const;
+
+	// A filter compiled by a previous invocation of compile_condition(),
+	// along with the filter factory that compiled it. Holding the factory
+	// guarantees that a source given another one is not mistaken for the
+	// same, even if the new factory is allocated at the same address.
+	struct cached_filter
+	{
+		std::shared_ptr<sinsp_filter_factory> filter_factory;
+		std::shared_ptr<sinsp_filter> filter;
+		std::shared_ptr<rule_exceptions> exceptions;
+		uint64_t generation;
+	};
+
+	// Filters compiled so far, keyed by source and by the condition with
+	// all macros and lists expanded. Since rules are compiled again each
+	// time a rules file is loaded, this avoids recompiling the conditions
+	// that did not change since the previous compile(). Entries not used
+	// by the last compile() are removed.
+	// The rules with the same condition share the same filter, and so do
+	// their successive versions. This is safe because a filter keeps no
+	// state across evaluations, and the ones of a source are only
+	// evaluated by the thread processing its events, one at a time.
+	mutable std::unordered_map<std::string, cached_filter> m_filter_cache;
+	mutable uint64_t m_generation = 0;
+
+	size_t m_compile_threads = 1;
+	bool m_warnings_enabled = true;
 };
 
 }; // namespace rule_loader
@@ -15,6 +15,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <set>
@@ -23,6 +24,7 @@ limitations under the License.
 #include "rule_loader_reader.h"
 #include "falco_engine_version.h"
 #include "rule_loading_messages.h"
+#include "falco_utils.h"
 #include <libsinsp/logger.h>
 
 #include <re2/re2.h>
@@ -153,6 +155,89 @@ static void decode_tags(const YAML::Node& item, std::optional<std::set<T>>& out,
 	out = decoded;
 }
 
+static void decode_rate_limit(const YAML::Node& item, std::optional<falco_rate_limit>& out,
+		       const rule_loader::context& ctx)
+{
+	const YAML::Node& val = item["rate_limit"];
+	if(!val.IsDefined())
+	{
+		return;
+	}
+
+	rule_loader::context valctx(val, rule_loader::context::VALUE_FOR, "rate_limit", ctx);
+	THROW(!val.IsMap(), "Value is not a map", valctx);
+
+	falco_rate_limit limit;
+	rule_loader::reader::decode_val(val, "rate", limit.rate, valctx);
+	THROW(limit.rate < 0, "Rate limit rate must be a non-negative number", valctx);
+
+	// by default up to one second worth of alerts can go out at once
+	limit.max_burst = std::max(1.0, limit.rate);
+	rule_loader::reader::decode_optional_val(val, "max_burst", limit.max_burst, valctx);
+	THROW(limit.max_burst < 1, "Rate limit max_burst must be at least 1", valctx);
+
+	out = limit;
+}
+
+// Decodes a duration such as "10s" or "5m" into nanoseconds
+static uint64_t decode_window(const YAML::Node& item, const char *key, const rule_loader::context& ctx)
+{
+	std::string window;
+	rule_loader::reader::decode_val(item, key, window, ctx);
+	rule_loader::context valctx(item[key], rule_loader::context::VALUE_FOR, key, ctx);
+	uint64_t window_ms = falco::utils::parse_prometheus_interval(window);
+	THROW(window_ms == 0, std::string("Invalid duration for '") + key + "'", valctx);
+	return window_ms * 1000000;
+}
+
+static void decode_by(const YAML::Node& item, std::vector<std::string>& out, const rule_loader::context& ctx)
+{
+	std::function<void(std::string)> inserter = [&out] (std::string value) {
+		out.push_back(value);
+	};
+	decode_seq(item, "by", inserter, ctx, true);
+}
+
+static void decode_threshold(const YAML::Node& item, std::optional<falco_rule_threshold>& out,
+		       const rule_loader::context& ctx)
+{
+	const YAML::Node& val = item["threshold"];
+	if(!val.IsDefined())
+	{
+		return;
+	}
+
+	rule_loader::context valctx(val, rule_loader::context::VALUE_FOR, "threshold", ctx);
+	THROW(!val.IsMap(), "Value is not a map", valctx);
+
+	falco_rule_threshold threshold;
+	rule_loader::reader::decode_val(val, "count", threshold.count, valctx);
+	THROW(threshold.count == 0, "Threshold count must be at least 1", valctx);
+	threshold.window_ns = decode_window(val, "window", valctx);
+	decode_by(val, threshold.by, valctx);
+	out = threshold;
+}
+
+static void decode_sequence(const YAML::Node& item, std::optional<falco_rule_sequence>& out,
+		       const rule_loader::context& ctx)
+{
+	const YAML::Node& val = item["sequence"];
+	if(!val.IsDefined())
+	{
+		return;
+	}
+
+	rule_loader::context valctx(val, rule_loader::context::VALUE_FOR, "sequence", ctx);
+	THROW(!val.IsMap(), "Value is not a map", valctx);
+
+	falco_rule_sequence sequence;
+	rule_loader::reader::decode_val(val, "after", sequence.after, valctx);
+	THROW(sequence.after.empty(), "Sequence after must be the name of a rule", valctx);
+	sequence.window_ns = decode_window(val, "within", valctx);
+	decode_by(val, sequence.by, valctx);
+	out = sequence;
+}
+
 static void decode_overrides(const YAML::Node& item,
 				std::set<std::string>& overridable_append,
 				std::set<std::string>& overridable_replace,
@@ -578,7 +663,7 @@ void rule_loader::reader::read_item(
 		std::set<std::string> override_append, override_replace;
 		std::set<std::string> overridable_append {"condition", "output", "desc", "tags", "exceptions"};
 		std::set<std::string> overridable_replace {
-			"condition", "output", "desc", "priority", "tags", "exceptions", "enabled", "warn_evttypes", "skip-if-unknown-filter"};
+			"condition", "output", "desc", "priority", "tags", "exceptions", "enabled", "warn_evttypes", "skip-if-unknown-filter", "rate_limit", "threshold", "sequence"};
 		decode_overrides(item, overridable_append, overridable_replace, override_append, override_replace, ctx);
 		bool has_overrides_append = !override_append.empty();
 		bool has_overrides_replace = !override_replace.empty();
@@ -693,6 +778,21 @@ void rule_loader::reader::read_item(
 					decode_val(item, "skip-if-unknown-filter", v.skip_if_unknown_filter, ctx);
 				}
 
+				if (check_update_expected(expected_keys, override_replace, "replace", "rate_limit", ctx))
+				{
+					decode_rate_limit(item, v.rate_limit, ctx);
+				}
+
+				if (check_update_expected(expected_keys, override_replace, "replace", "threshold", ctx))
+				{
+					decode_threshold(item, v.threshold, ctx);
+				}
+
+				if (check_update_expected(expected_keys, override_replace, "replace", "sequence", ctx))
+				{
+					decode_sequence(item, v.sequence, ctx);
+				}
+
 				collector.selective_replace(cfg, v);
 			}
 
@@ -770,6 +870,11 @@ void rule_loader::reader::read_item(
 				decode_optional_val(item, "enabled", v.enabled, ctx);
 				decode_optional_val(item, "warn_evttypes", v.warn_evttypes, ctx);
 				decode_optional_val(item, "skip-if-unknown-filter", v.skip_if_unknown_filter, ctx);
+				decode_rate_limit(item, v.rate_limit, ctx);
+				decode_threshold(item, v.threshold, ctx);
+				decode_sequence(item, v.sequence, ctx);
+				THROW(v.threshold.has_value() && v.sequence.has_value(),
+				       "A rule can't have both a threshold and a sequence", ctx);
 				decode_tags(item, v.tags, ctx);
 				read_rule_exceptions(cfg, item, v.exceptions, ctx, false);
 				collector.define(cfg, v);
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string>
+#include <vector>
+
+#include "rule_loader_streaming_reader.h"
+
+#define THROW(cond, err, ctx)    { if ((cond)) { throw rule_loader::rule_load_exception(falco::load_result::LOAD_ERR_YAML_VALIDATE, (err), (ctx)); } }
+
+static inline bool is_line_end(const std::string& content, size_t i, size_t eol)
+{
+	return i >= eol || content[i] == '\r';
+}
+
+static inline bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// note: a superset of the actual anchors and aliases is fine, as
+// the content is then just read with the default reader
+static bool has_anchors_or_aliases(const std::string& content)
+{
+	for (size_t i = content.find_first_of("&*"); i != std::string::npos; i = content.find_first_of("&*", i + 1))
+	{
+		bool starts_token = i == 0
+			|| is_space(content[i - 1])
+			|| content[i - 1] == '['
+			|| content[i - 1] == '{'
+			|| content[i - 1] == ',';
+		bool has_name = i + 1 < content.size()
+			&& !is_space(content[i + 1])
+			&& content[i + 1] != content[i];
+		if (starts_token && has_name)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline bool is_item_start(const std::string& content, size_t i, size_t eol)
+{
+	return content[i] == '-' && (is_line_end(content, i + 1, eol) || content[i + 1] == ' ');
+}
+
+static inline bool is_document_marker(const std::string& content, size_t i, size_t eol)
+{
+	return (content.compare(i, 3, "---") == 0 || content.compare(i, 3, "...") == 0)
+		&& is_line_end(content, i + 3, eol);
+}
+
+bool rule_loader::streaming_reader::split_items(const std::string& content, std::vector<item_range>& items)
+{
+	items.clear();
+	if (content.compare(0, 3, "\xEF\xBB\xBF") == 0 || has_anchors_or_aliases(content))
+	{
+		return false;
+	}
+
+	int line = 0;
+	int item_indent = -1;
+	bool open = false;
+	size_t pos = 0;
+	while (pos < content.size())
+	{
+		size_t eol = content.find('\n', pos);
+		if (eol == std::string::npos)
+		{
+			eol = content.size();
+		}
+
+		size_t i = pos;
+		while (i < eol && content[i] == ' ')
+		{
+			i++;
+		}
+		int indent = (int) (i - pos);
+
+		// blank lines and comments belong to the current item, if any
+		if (!is_line_end(content, i, eol) && content[i] != '#')
+		{
+			if (indent == 0 && is_document_marker(content, i, eol))
+			{
+				// a new document can use a different indentation
+				if (open)
+				{
+					items.back().end = pos;
+					open = false;
+				}
+				item_indent = -1;
+			}
+			else if (indent == 0 && content[i] == '%')
+			{
+				return false;
+			}
+			else if (item_indent < 0 || indent == item_indent)
+			{
+				if (!is_item_start(content, i, eol))
+				{
+					return false;
+				}
+				if (open)
+				{
+					items.back().end = pos;
+				}
+				items.push_back({pos, content.size(), line});
+				item_indent = indent;
+				open = true;
+			}
+			else if (indent < item_indent)
+			{
+				return false;
+			}
+		}
+
+		pos = eol + 1;
+		line++;
+	}
+	return true;
+}
+
+bool rule_loader::streaming_reader::read(rule_loader::configuration& cfg, collector& collector)
+{
+	std::vector<item_range> ranges;
+	if (!split_items(cfg.content, ranges))
+	{
+		return reader::read(cfg, collector);
+	}
+
+	rule_loader::context ctx(cfg.name);
+	for (const auto& range : ranges)
+	{
+		rule_loader::context::position offset;
+		offset.pos = (int) range.begin;
+		offset.line = range.line;
+		rule_loader::context ictx(cfg.name, offset);
+
+		YAML::Node doc;
+		try
+		{
+			doc = YAML::Load(cfg.content.substr(range.begin, range.end - range.begin));
+		}
+		catch (YAML::ParserException& e)
+		{
+			rule_loader::context ectx(e.mark, ictx);
+			cfg.res->add_error(falco::load_result::LOAD_ERR_YAML_PARSE, e.what(), ectx);
+			return false;
+		}
+		catch (std::exception& e)
+		{
+			cfg.res->add_error(falco::load_result::LOAD_ERR_YAML_PARSE, e.what(), ctx);
+			return false;
+		}
+		catch (...)
+		{
+			cfg.res->add_error(falco::load_result::LOAD_ERR_YAML_PARSE, "unknown YAML parsing error", ctx);
+			return false;
+		}
+
+		try
+		{
+			THROW(!doc.IsSequence(),
+			       "Rules content is not yaml array of objects",
+			       ctx);
+
+			for (auto it = doc.begin(); it != doc.end(); it++)
+			{
+				if (!it->IsNull())
+				{
+					read_item(cfg, collector, *it, ictx);
+				}
+			}
+		}
+		catch (rule_loader::rule_load_exception &e)
+		{
+			cfg.res->add_error(e.ec, e.msg, e.ctx);
+			return false;
+		}
+		catch (YAML::ParserException& e)
+		{
+			rule_loader::context ectx(e.mark, ictx);
+			cfg.res->add_error(falco::load_result::LOAD_ERR_YAML_VALIDATE, e.what(), ectx);
+			return false;
+		}
+		catch (std::exception& e)
+		{
+			cfg.res->add_error(falco::load_result::LOAD_ERR_VALIDATE, e.what(), ctx);
+			return false;
+		}
+		catch (...)
+		{
+			cfg.res->add_error(falco::load_result::LOAD_ERR_VALIDATE, "unknown validation error", ctx);
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "rule_loader_reader.h"
+
+#include <string>
+#include <vector>
+
+namespace rule_loader
+{
+
+/*!
+	\brief Reader of the contents of a ruleset that, instead of loading
+	the whole YAML content at once, parses and collects its top-level
+	items one at a time. As such, only the YAML nodes of a single item
+	are in memory at any given time, and definitions are stored in the
+	collector as soon as they are read. The contexts of errors and
+	warnings point to the same positions of the rules content as with
+	the default reader.
+
+	Since items are parsed one by one, an error in a YAML item is
+	reported only after having collected all the definitions before it,
+	and not before reading any definition. The content is split into items
+	with a lightweight scan of its lines, which requires it to be made of
+	block sequences of items. Any content that can't be safely split
+	(e.g. flow sequences, anchors and aliases, YAML directives, or any
+	other top-level structure) is read with the default reader.
+*/
+class streaming_reader : public reader
+{
+public:
+	streaming_reader() = default;
+	virtual ~streaming_reader() = default;
+	streaming_reader(streaming_reader&&) = default;
+	streaming_reader& operator = (streaming_reader&&) = default;
+	streaming_reader(const streaming_reader&) = default;
+	streaming_reader& operator = (const streaming_reader&) = default;
+
+	bool read(configuration& cfg, collector& loader) override;
+
+	/*!
+		\brief A part of the rules content containing a single
+		top-level item, starting at the beginning of a line
+	*/
+	struct item_range
+	{
+		size_t begin;
+		size_t end;
+		int line;
+	};
+
+	/*!
+		\brief Splits the rules content into its top-level items.
+		Returns false if the content can't be safely split.
+	*/
+	static bool split_items(const std::string& content, std::vector<item_range>& items);
+};
+
+}; // namespace rule_loader
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "rule_state.h"
+
+using namespace falco;
+
+// only the thread of the source updates the counters
+static inline void increment(std::atomic<uint64_t>& v)
+{
+	v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+rule_state::rule_state(uint64_t max_memory): m_max_memory(max_memory)
+{
+}
+
+size_t rule_state::entry_memory(const entry& e)
+{
+	// the entry and its key, its list node, and its node in the index
+	return sizeof(entry) + e.key.capacity() + 2 * sizeof(void*)
+		+ sizeof(std::string_view) + 3 * sizeof(void*);
+}
+
+rule_state::entry& rule_state::touch(const std::string& key, bool& created)
+{
+	auto it = m_index.find(key);
+	created = it == m_index.end();
+	if(!created)
+	{
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return m_lru.front();
+	}
+
+	m_lru.emplace_front();
+	m_lru.front().key = key;
+	m_index.emplace(m_lru.front().key, m_lru.begin());
+	m_memory += entry_memory(m_lru.front());
+
+	// the new entry is never evicted, even if it doesn't fit alone
+	while(m_memory > m_max_memory && m_lru.size() > 1)
+	{
+		erase(m_index.find(m_lru.back().key));
+		increment(m_num_evicted);
+	}
+	m_num_keys.store(m_lru.size(), std::memory_order_relaxed);
+	m_memory_bytes.store(m_memory, std::memory_order_relaxed);
+	return m_lru.front();
+}
+
+void rule_state::erase(std::unordered_map<std::string_view, std::list<entry>::iterator>::iterator it)
+{
+	auto e = it->second;
+	m_memory -= entry_memory(*e);
+	m_index.erase(it);
+	m_lru.erase(e);
+	m_num_keys.store(m_lru.size(), std::memory_order_relaxed);
+	m_memory_bytes.store(m_memory, std::memory_order_relaxed);
+}
+
+bool rule_state::add_threshold(const std::string& key, uint64_t ts, uint64_t window_ns, uint64_t count)
+{
+	bool created = false;
+	auto& e = touch(key, created);
+	uint64_t window = ts / window_ns;
+	if(created || window > e.window + 1)
+	{
+		e.prev_count = 0;
+		e.count = 0;
+		e.window = window;
+	}
+	else if(window == e.window + 1)
+	{
+		e.prev_count = e.count;
+		e.count = 0;
+		e.window = window;
+	}
+	e.count++;
+
+	// a time going backwards counts as the start of the current window
+	uint64_t elapsed = window == e.window ? ts % window_ns : 0;
+	double estimated = e.count + (double) e.prev_count * (window_ns - elapsed) / window_ns;
+	if(estimated >= count)
+	{
+		e.prev_count = 0;
+		e.count = 0;
+		increment(m_threshold_alerts);
+		return true;
+	}
+	increment(m_threshold_suppressed);
+	return false;
+}
+
+void rule_state::start_sequence(const std::string& key, uint64_t ts)
+{
+	bool created = false;
+	touch(key, created).window = ts;
+	increment(m_sequence_starts);
+}
+
+bool rule_state::complete_sequence(const std::string& key, uint64_t ts, uint64_t window_ns)
+{
+	auto it = m_index.find(key);
+	if(it == m_index.end())
+	{
+		increment(m_sequence_unmatched);
+		return false;
+	}
+	uint64_t start = it->second->window;
+	erase(it);
+	if(ts > start && ts - start > window_ns)
+	{
+		increment(m_sequence_unmatched);
+		return false;
+	}
+	increment(m_sequence_alerts);
+	return true;
+}
+
+void rule_state::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["keys"] += m_num_keys.load(std::memory_order_relaxed);
+	metrics["memory_bytes"] += m_memory_bytes.load(std::memory_order_relaxed);
+	metrics["evicted"] += m_num_evicted.load(std::memory_order_relaxed);
+	metrics["threshold_alerts"] += m_threshold_alerts.load(std::memory_order_relaxed);
+	metrics["threshold_suppressed"] += m_threshold_suppressed.load(std::memory_order_relaxed);
+	metrics["sequence_starts"] += m_sequence_starts.load(std::memory_order_relaxed);
+	metrics["sequence_alerts"] += m_sequence_alerts.load(std::memory_order_relaxed);
+	metrics["sequence_unmatched"] += m_sequence_unmatched.load(std::memory_order_relaxed);
+}
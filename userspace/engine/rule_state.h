@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace falco
+{
+
+/*!
+	\brief The state of the threshold and sequence rules of an event
+	source, by key, which is made of a rule and the values of some fields
+	of its events. Each key holds either the counters of a sliding window
+	or the time at which the first step of a sequence happened. The keys
+	used least recently are evicted once the state takes more than its
+	memory budget, so an idle key can be forgotten before its window is
+	over under pressure. As the rules of a source are only evaluated by
+	a single thread, this is not thread-safe, except for get_metrics().
+	The times are in nanoseconds and are the ones of the events.
+*/
+class rule_state
+{
+public:
+	explicit rule_state(uint64_t max_memory);
+
+	rule_state(const rule_state&) = delete;
+	rule_state& operator = (const rule_state&) = delete;
+
+	/*!
+		\brief Counts a match of a threshold rule for the given key, and
+		returns true when the matches over the window ending at ts reach
+		count, in which case the counter starts over. The window slides
+		by estimating the matches of the previous window that are still
+		in it, as if they were evenly spread.
+	*/
+	bool add_threshold(const std::string& key, uint64_t ts, uint64_t window_ns, uint64_t count);
+
+	/*!
+		\brief Records that the first step of a sequence happened for the
+		given key at ts, replacing any previous one
+	*/
+	void start_sequence(const std::string& key, uint64_t ts);
+
+	/*!
+		\brief Returns true if the first step of a sequence happened for
+		the given key within window_ns before ts, consuming it
+	*/
+	bool complete_sequence(const std::string& key, uint64_t ts, uint64_t window_ns);
+
+	/*!
+		\brief Adds the metrics of the state to the given map, which are
+		summed with the ones already in it, so that the states of all the
+		sources can be reported together
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	struct entry
+	{
+		std::string key;
+		// for thresholds, the current window and the counts of it and
+		// of the previous one, and for sequences, when it started
+		uint64_t window = 0;
+		uint64_t prev_count = 0;
+		uint64_t count = 0;
+	};
+
+	// returns the entry of the key, created if needed, as the most
+	// recently used one
+	entry& touch(const std::string& key, bool& created);
+	void erase(std::unordered_map<std::string_view, std::list<entry>::iterator>::iterator it);
+	static size_t entry_memory(const entry& e);
+
+	uint64_t m_max_memory;
+	uint64_t m_memory = 0;
+	// the most recently used first, and the keys point into the entries
+	std::list<entry> m_lru;
+	std::unordered_map<std::string_view, std::list<entry>::iterator> m_index;
+
+	// updated by the thread of the source and read by any other
+	std::atomic<uint64_t> m_num_keys{0};
+	std::atomic<uint64_t> m_memory_bytes{0};
+	std::atomic<uint64_t> m_num_evicted{0};
+	std::atomic<uint64_t> m_threshold_alerts{0};
+	std::atomic<uint64_t> m_threshold_suppressed{0};
+	std::atomic<uint64_t> m_sequence_starts{0};
+	std::atomic<uint64_t> m_sequence_alerts{0};
+	std::atomic<uint64_t> m_sequence_unmatched{0};
+};
+
+} // namespace falco
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "rules_arena.h"
+
+#ifdef FALCO_RULES_ARENA
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#endif
+
+namespace falco::rules_arena
+{
+
+#ifdef FALCO_RULES_ARENA
+
+// the chunks have the size of a huge page and are all carved from a
+// single range of addresses reserved at the first use, so that telling
+// whether a pointer comes from an arena is a single comparison. Only the
+// pages actually used count as memory used. The larger allocations come
+// from the heap as usual, and so do the ones not fitting in the range.
+static constexpr size_t chunk_size = 2 * 1024 * 1024;
+static constexpr uint32_t max_chunks = 2048;
+static constexpr size_t max_alloc = chunk_size / 16;
+static constexpr size_t alignment = alignof(std::max_align_t);
+static constexpr uint32_t no_chunk = UINT32_MAX;
+
+// the references to each chunk, one for each object allocated from it
+// that is still alive and one for the arena allocating from it, if any
+static std::atomic<uint64_t> s_refs[max_chunks];
+
+// the range and the chunks not in use, which can't be kept in containers
+// as they are used while allocating
+static std::mutex s_mtx;
+static std::atomic<uint8_t*> s_base{nullptr};
+static bool s_reserve_failed = false;
+static uint32_t s_num_used = 0;
+static uint32_t s_free[max_chunks];
+static uint32_t s_num_free = 0;
+
+static std::atomic<bool> s_hugepages{false};
+static std::atomic<uint64_t> s_num_chunks{0};
+static std::atomic<uint64_t> s_num_released{0};
+static thread_local arena* s_current = nullptr;
+
+static inline uint8_t* chunk_ptr(uint32_t idx)
+{
+	return s_base.load(std::memory_order_acquire) + (size_t) idx * chunk_size;
+}
+
+static inline bool find_chunk(const void* p, uint32_t& idx)
+{
+	auto base = (uintptr_t) s_base.load(std::memory_order_acquire);
+	auto addr = (uintptr_t) p;
+	if(base == 0 || addr < base || addr >= base + (uintptr_t) max_chunks * chunk_size)
+	{
+		return false;
+	}
+	idx = (addr - base) / chunk_size;
+	return true;
+}
+
+static uint32_t acquire_chunk()
+{
+	std::lock_guard<std::mutex> lock(s_mtx);
+	if(s_base.load(std::memory_order_relaxed) == nullptr)
+	{
+		if(s_reserve_failed)
+		{
+			return no_chunk;
+		}
+
+		// one more chunk to align the range on the size of the chunks
+		size_t len = (size_t) (max_chunks + 1) * chunk_size;
+		void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(p == MAP_FAILED)
+		{
+			s_reserve_failed = true;
+			return no_chunk;
+		}
+		auto base = ((uintptr_t) p + chunk_size - 1) & ~(uintptr_t) (chunk_size - 1);
+		s_base.store((uint8_t*) base, std::memory_order_release);
+	}
+
+	uint32_t idx = no_chunk;
+	if(s_num_free > 0)
+	{
+		idx = s_free[--s_num_free];
+	}
+	else if(s_num_used < max_chunks)
+	{
+		idx = s_num_used++;
+	}
+	else
+	{
+		return no_chunk;
+	}
+
+	if(s_hugepages.load(std::memory_order_relaxed))
+	{
+		// only a hint, the chunk is used the same way otherwise
+		madvise(chunk_ptr(idx), chunk_size, MADV_HUGEPAGE);
+	}
+	s_refs[idx].store(1, std::memory_order_relaxed);
+	s_num_chunks.fetch_add(1, std::memory_order_relaxed);
+	return idx;
+}
+
+static void release_chunk(uint32_t idx)
+{
+	// the pages go back to the system and the chunk stays reserved
+	madvise(chunk_ptr(idx), chunk_size, MADV_DONTNEED);
+
+	std::lock_guard<std::mutex> lock(s_mtx);
+	s_free[s_num_free++] = idx;
+	s_num_chunks.fetch_sub(1, std::memory_order_relaxed);
+	s_num_released.fetch_add(1, std::memory_order_relaxed);
+}
+
+static inline void unref_chunk(uint32_t idx)
+{
+	if(s_refs[idx].fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		release_chunk(idx);
+	}
+}
+
+class arena
+{
+public:
+	arena() = default;
+
+	~arena()
+	{
+		if(m_chunk != no_chunk)
+		{
+			unref_chunk(m_chunk);
+		}
+	}
+
+	arena(const arena&) = delete;
+	arena& operator = (const arena&) = delete;
+
+	// returns nullptr if no chunk is available
+	void* allocate(size_t n)
+	{
+		n = n == 0 ? alignment : (n + alignment - 1) & ~(alignment - 1);
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if(m_chunk == no_chunk || m_offset + n > chunk_size)
+		{
+			if(m_chunk != no_chunk)
+			{
+				unref_chunk(m_chunk);
+			}
+			m_chunk = acquire_chunk();
+			m_offset = 0;
+			if(m_chunk == no_chunk)
+			{
+				return nullptr;
+			}
+		}
+		s_refs[m_chunk].fetch_add(1, std::memory_order_relaxed);
+		void* p = chunk_ptr(m_chunk) + m_offset;
+		m_offset += n;
+		return p;
+	}
+
+private:
+	std::mutex m_mtx;
+	uint32_t m_chunk = no_chunk;
+	size_t m_offset = 0;
+};
+
+std::shared_ptr<arena> create()
+{
+	return std::make_shared<arena>();
+}
+
+arena* current()
+{
+	return s_current;
+}
+
+void set_current(arena* a)
+{
+	s_current = a;
+}
+
+void set_hugepages(bool enabled)
+{
+	s_hugepages.store(enabled, std::memory_order_relaxed);
+}
+
+void get_metrics(std::map<std::string, uint64_t>& metrics)
+{
+	uint64_t chunks = s_num_chunks.load(std::memory_order_relaxed);
+	metrics["chunks"] = chunks;
+	metrics["bytes"] = chunks * chunk_size;
+	metrics["released_chunks"] = s_num_released.load(std::memory_order_relaxed);
+}
+
+#else
+
+std::shared_ptr<arena> create()
+{
+	return nullptr;
+}
+
+arena* current()
+{
+	return nullptr;
+}
+
+void set_hugepages(bool)
+{
+}
+
+void get_metrics(std::map<std::string, uint64_t>& metrics)
+{
+	metrics["chunks"] = 0;
+	metrics["bytes"] = 0;
+	metrics["released_chunks"] = 0;
+}
+
+#endif
+
+} // namespace falco::rules_arena
+
+#ifdef FALCO_RULES_ARENA
+
+static inline void* arena_alloc(std::size_t n)
+{
+	auto a = falco::rules_arena::current();
+	if(a != nullptr && n <= falco::rules_arena::max_alloc)
+	{
+		void* p = a->allocate(n);
+		if(p != nullptr)
+		{
+			return p;
+		}
+	}
+	return std::malloc(n == 0 ? 1 : n);
+}
+
+void* operator new(std::size_t n)
+{
+	void* p = arena_alloc(n);
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t n)
+{
+	return operator new(n);
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+	return arena_alloc(n);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept
+{
+	return arena_alloc(n);
+}
+
+void operator delete(void* p) noexcept
+{
+	uint32_t idx = 0;
+	if(falco::rules_arena::find_chunk(p, idx))
+	{
+		falco::rules_arena::unref_chunk(idx);
+		return;
+	}
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+#endif
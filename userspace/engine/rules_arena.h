@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+// Allocates the rules loaded by the engine, i.e. their compiled filters
+// and the structures of the rulesets, from arenas of contiguous chunks
+// of memory, in the builds with the FALCO_RULES_ARENA option, which
+// replace the global operator new and delete. The allocations of a
+// thread go to the arena of the innermost scope open in it, if any.
+// Each chunk is given back to the system as a whole once all the
+// objects allocated from it are deleted, e.g. once the rulesets of a
+// load are replaced by the ones of the next load, so that reloading the
+// rules doesn't fragment the heap. In the other builds, scopes cost
+// nothing and all the allocations come from the heap.
+namespace falco::rules_arena
+{
+
+/*!
+	\brief Returns whether the rules are allocated from arenas in this build
+*/
+constexpr bool enabled()
+{
+#ifdef FALCO_RULES_ARENA
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*!
+	\brief The chunks from which the allocations of a load are carved.
+	An arena can be used by several threads at once, and can be destroyed
+	before the objects allocated from it, whose chunks are kept until
+	they are all deleted.
+*/
+class arena;
+
+/*!
+	\brief Returns a new arena, or nullptr in the builds without arenas
+*/
+std::shared_ptr<arena> create();
+
+/*!
+	\brief Returns the arena of the innermost scope open in the current
+	thread, if any, e.g. to open a scope on the same arena from the
+	threads spawned by the current one
+*/
+arena* current();
+
+#ifdef FALCO_RULES_ARENA
+void set_current(arena* a);
+#endif
+
+/*!
+	\brief Allocates from the given arena in the current thread until it's
+	destroyed, or from the heap if the arena is nullptr
+*/
+class scope
+{
+public:
+#ifdef FALCO_RULES_ARENA
+	explicit scope(arena* a): m_prev(current())
+	{
+		set_current(a);
+	}
+
+	~scope()
+	{
+		set_current(m_prev);
+	}
+#else
+	explicit scope(arena*) {}
+#endif
+
+	scope(const scope&) = delete;
+	scope& operator = (const scope&) = delete;
+
+#ifdef FALCO_RULES_ARENA
+private:
+	arena* m_prev;
+#endif
+};
+
+/*!
+	\brief Sets whether the chunks are backed by transparent huge pages
+	when possible, which applies to the chunks allocated from then on
+*/
+void set_hugepages(bool enabled);
+
+/*!
+	\brief Adds the number of chunks in use and of chunks given back to
+	the system since Falco started to the given map, as chunks and
+	released_chunks, along with the size of the chunks in use as bytes
+*/
+void get_metrics(std::map<std::string, uint64_t>& metrics);
+
+} // namespace falco::rules_arena
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+
+#include "sharded_counters.h"
+
+using namespace falco;
+
+size_t sharded_counters::next_shard_index()
+{
+	static std::atomic<size_t> s_next{0};
+	return s_next.fetch_add(1, std::memory_order_relaxed) % num_shards;
+}
+
+void sharded_counters::resize(size_t size)
+{
+	size_t needed = (size + counters_per_line - 1) / counters_per_line;
+	if (needed > m_lines_per_shard)
+	{
+		// the capacity at least doubles, so that growing the counters
+		// one at a time, as when loading rules, copies them a few times
+		size_t lines_per_shard = std::max(needed, 2 * m_lines_per_shard);
+		std::unique_ptr<line[]> lines(new line[num_shards * lines_per_shard]);
+		for (size_t i = 0; i < num_shards * lines_per_shard; i++)
+		{
+			for (auto& c : lines[i].counters)
+			{
+				c.store(0, std::memory_order_relaxed);
+			}
+		}
+		for (size_t s = 0; s < num_shards; s++)
+		{
+			for (size_t i = 0; i < m_size; i++)
+			{
+				auto v = m_lines[s * m_lines_per_shard + i / counters_per_line].counters[i % counters_per_line].load(std::memory_order_relaxed);
+				lines[s * lines_per_shard + i / counters_per_line].counters[i % counters_per_line].store(v, std::memory_order_relaxed);
+			}
+		}
+		m_lines = std::move(lines);
+		m_lines_per_shard = lines_per_shard;
+	}
+	else
+	{
+		// the counters dropped by shrinking must start from zero if they
+		// are added back later
+		for (size_t s = 0; s < num_shards; s++)
+		{
+			for (size_t i = size; i < m_size; i++)
+			{
+				m_lines[s * m_lines_per_shard + i / counters_per_line].counters[i % counters_per_line].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+	m_size = size;
+}
+
+void sharded_counters::clear()
+{
+	m_lines.reset();
+	m_lines_per_shard = 0;
+	m_size = 0;
+}
+
+uint64_t sharded_counters::get(size_t i) const
+{
+	uint64_t res = 0;
+	for (size_t s = 0; s < num_shards; s++)
+	{
+		res += m_lines[s * m_lines_per_shard + i / counters_per_line].counters[i % counters_per_line].load(std::memory_order_relaxed);
+	}
+	return res;
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace falco
+{
+
+/*!
+	\brief An array of counters that many threads can increment at once
+	without contending on the same cache lines. Each counter has one copy
+	per shard, and each thread increments the copies of the shard it is
+	assigned to when it first uses any sharded_counters. The shards are
+	cache line aligned and padded, so two threads in different shards never
+	write to the same cache line. Reading a counter sums its copies, which
+	makes reads more expensive than increments. Incrementing and reading
+	are thread-safe, while resizing and clearing are not.
+*/
+class sharded_counters
+{
+public:
+	static constexpr size_t num_shards = 8;
+
+	sharded_counters() = default;
+	explicit sharded_counters(size_t size)
+	{
+		resize(size);
+	}
+
+	sharded_counters(const sharded_counters&) = delete;
+	sharded_counters& operator = (const sharded_counters&) = delete;
+
+	inline size_t size() const
+	{
+		return m_size;
+	}
+
+	inline bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	/*!
+		\brief Changes the number of counters, keeping the values of the
+		ones that exist in both sizes. The new counters start from zero.
+	*/
+	void resize(size_t size);
+
+	/*!
+		\brief Removes all the counters
+	*/
+	void clear();
+
+	/*!
+		\brief Adds v to the i-th counter, which must exist
+	*/
+	inline void add(size_t i, uint64_t v = 1)
+	{
+		auto& l = m_lines[shard_index() * m_lines_per_shard + i / counters_per_line];
+		l.counters[i % counters_per_line].fetch_add(v, std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the value of the i-th counter, which must exist
+	*/
+	uint64_t get(size_t i) const;
+
+	inline uint64_t operator[](size_t i) const
+	{
+		return get(i);
+	}
+
+	/*!
+		\brief Returns the shard of the calling thread
+	*/
+	static inline size_t shard_index()
+	{
+		static thread_local size_t s_index = next_shard_index();
+		return s_index;
+	}
+
+private:
+	static constexpr size_t cache_line_size = 64;
+	static constexpr size_t counters_per_line = cache_line_size / sizeof(uint64_t);
+
+	struct alignas(cache_line_size) line
+	{
+		std::atomic<uint64_t> counters[counters_per_line];
+	};
+
+	static size_t next_shard_index();
+
+	size_t m_size = 0;
+	size_t m_lines_per_shard = 0;
+	std::unique_ptr<line[]> m_lines;
+};
+
+} // namespace falco
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "shared_filter_predicates.h"
+#include "filter_flattener.h"
+#include "filter_or_merger.h"
+
+using namespace libsinsp::filter;
+
+shared_filter_predicates::shared_filter_predicates(std::shared_ptr<sinsp_filter_factory> factory):
+	m_factory(factory)
+{
+}
+
+void shared_filter_predicates::conjuncts(
+	const ast::expr* condition,
+	std::vector<const ast::expr*>& out)
+{
+	auto and_expr = dynamic_cast<const ast::and_expr*>(condition);
+	if(!and_expr)
+	{
+		out.push_back(condition);
+		return;
+	}
+
+	for(const auto& c : and_expr->children)
+	{
+		conjuncts(c.get(), out);
+	}
+}
+
+size_t shared_filter_predicates::add(const ast::expr* predicate)
+{
+	auto key = ast::as_string(predicate);
+	auto it = m_indexes.find(key);
+	if(it != m_indexes.end())
+	{
+		return it->second;
+	}
+
+	std::shared_ptr<ast::expr> optimized = ast::clone(predicate);
+	filter_flattener().run(optimized);
+	filter_or_merger().run(optimized);
+	sinsp_filter_compiler compiler(m_factory, optimized.get());
+	std::shared_ptr<sinsp_filter> filter = compiler.compile();
+
+	size_t idx = m_filters.size();
+	m_filters.push_back(filter);
+	m_generations.push_back(0);
+	m_results.push_back(0);
+	m_indexes[key] = idx;
+	return idx;
+}
+
+void shared_filter_predicates::clear()
+{
+	m_indexes.clear();
+	m_filters.clear();
+	m_generations.clear();
+	m_results.clear();
+	m_evt = nullptr;
+}
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/filter.h>
+#include <libsinsp/filter/ast.h>
+#include <libsinsp/event.h>
+
+#include "memory_usage.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+	\brief A set of filter predicates shared between the conditions of
+	multiple rules. Each rule condition is decomposed in the conjunction of
+	its top-level "and" operands, and identical operands are compiled only
+	once. The result of each predicate is memoized for the event being
+	processed, so that each distinct predicate is evaluated at most once
+	per event regardless of how many rules use it.
+	This class is not thread-safe.
+*/
+class shared_filter_predicates
+{
+public:
+	explicit shared_filter_predicates(std::shared_ptr<sinsp_filter_factory> factory);
+	virtual ~shared_filter_predicates() = default;
+	shared_filter_predicates(shared_filter_predicates&&) = default;
+	shared_filter_predicates& operator = (shared_filter_predicates&&) = default;
+	shared_filter_predicates(const shared_filter_predicates&) = delete;
+	shared_filter_predicates& operator = (const shared_filter_predicates&) = delete;
+
+	/*!
+		\brief Appends to out the top-level "and" operands of the given
+		condition, or the condition itself if it is not an "and" expression.
+		Nested "and" expressions are flattened.
+	*/
+	static void conjuncts(
+		const libsinsp::filter::ast::expr* condition,
+		std::vector<const libsinsp::filter::ast::expr*>& out);
+
+	/*!
+		\brief Compiles the given predicate, unless an identical one has
+		already been added, and returns its index.
+		Throws a sinsp_exception if the predicate can't be compiled.
+	*/
+	size_t add(const libsinsp::filter::ast::expr* predicate);
+
+	/*!
+		\brief Returns the number of distinct predicates added
+	*/
+	inline size_t size() const
+	{
+		return m_filters.size();
+	}
+
+	/*!
+		\brief Returns an estimate of the memory used to index and memoize
+		the predicates, not counting the memory of their compiled filters
+	*/
+	inline size_t memory_usage() const
+	{
+		return falco::utils::memory::of(m_indexes)
+			+ falco::utils::memory::of(m_filters)
+			+ falco::utils::memory::of(m_generations)
+			+ falco::utils::memory::of(m_results);
+	}
+
+	/*!
+		\brief Erases all the predicates
+	*/
+	void clear();
+
+	/*!
+		\brief Returns true if all the predicates with the given
+		indexes match the event. The predicates are evaluated in order,
+		stopping at the first one that does not match.
+	*/
+	inline bool run(sinsp_evt* evt, const std::vector<size_t>& predicates)
+	{
+		// the event number alone doesn't tell events apart, as the one
+		// of an event can be reused by another one with the same number
+		if(evt != m_evt || evt->get_num() != m_evtnum)
+		{
+			m_evt = evt;
+			m_evtnum = evt->get_num();
+			m_generation++;
+		}
+		for(auto i : predicates)
+		{
+			if(m_generations[i] != m_generation)
+			{
+				m_generations[i] = m_generation;
+				m_results[i] = m_filters[i]->run(evt);
+			}
+			if(!m_results[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	std::shared_ptr<sinsp_filter_factory> m_factory;
+	std::unordered_map<std::string, size_t> m_indexes;
+	std::vector<std::shared_ptr<sinsp_filter>> m_filters;
+
+	// The last event passed to run(), and its number, which identify
+	// the event being processed, along with a generation incremented
+	// each time it changes
+	const sinsp_evt* m_evt = nullptr;
+	uint64_t m_evtnum = 0;
+	uint64_t m_generation = 0;
+
+	// The generation of which the result of each predicate is memoized,
+	// and the memoized results
+	std::vector<uint64_t> m_generations;
+	std::vector<uint8_t> m_results;
+};
@@ -15,11 +15,17 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include "stats_manager.h"
 #include "falco_common.h"
 
 stats_manager::stats_manager()
-	: m_total(0)
+	: m_totals(num_totals),
+	  m_profiling_enabled(false),
+	  m_profiling_sampling_period(1)
 {
 }
 
@@ -30,9 +36,118 @@ stats_manager::~stats_manager()
 
 void stats_manager::clear()
 {
-	m_total = 0;
+	m_totals.clear();
+	m_totals.resize(num_totals);
 	m_by_rule_id.clear();
 	m_by_priority.clear();
+	m_profile_by_rule_id.clear();
+	m_rate_limited_by_rule_id.clear();
+	m_exception_hits_by_rule_id.clear();
+}
+
+void stats_manager::set_rule_profiling(bool enabled, uint32_t sampling_period)
+{
+	m_profiling_enabled = enabled;
+	m_profiling_sampling_period = sampling_period > 0 ? sampling_period : 1;
+}
+
+void stats_manager::on_rule_evaluation_sampled(size_t rule_id, uint64_t time_ns,
+	uint16_t evt_type, uint64_t evt_ts)
+{
+	if (rule_id >= m_profile_by_rule_id.size())
+	{
+		return;
+	}
+
+	size_t bucket = 0;
+	while (bucket < rule_profile::num_time_buckets - 1
+		&& (uint64_t(1) << bucket) <= time_ns)
+	{
+		bucket++;
+	}
+
+	auto& p = *m_profile_by_rule_id[rule_id];
+	p.sampled_evaluations.fetch_add(1, std::memory_order_relaxed);
+	p.sampled_time_ns.fetch_add(time_ns, std::memory_order_relaxed);
+	p.time_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	if (time_ns > p.m_slowest_threshold_ns.load(std::memory_order_relaxed))
+	{
+		p.add_slow_evaluation({time_ns, evt_type, evt_ts});
+	}
+}
+
+void stats_manager::rule_profile::add_slow_evaluation(const slow_evaluation& e)
+{
+	std::lock_guard<std::mutex> lock(m_slowest_mtx);
+
+	// replace the fastest of the kept evaluations, empty slots first
+	auto fastest = std::min_element(m_slowest.begin(), m_slowest.end(),
+		[](const slow_evaluation& a, const slow_evaluation& b) { return a.time_ns < b.time_ns; });
+	if (e.time_ns <= fastest->time_ns)
+	{
+		return;
+	}
+	*fastest = e;
+
+	uint64_t threshold = UINT64_MAX;
+	uint64_t max = 0;
+	for (const auto& s : m_slowest)
+	{
+		threshold = std::min(threshold, s.time_ns);
+		max = std::max(max, s.time_ns);
+	}
+	m_slowest_threshold_ns.store(threshold, std::memory_order_relaxed);
+	m_max_time_ns.store(max, std::memory_order_relaxed);
+}
+
+std::vector<stats_manager::rule_profile::slow_evaluation> stats_manager::rule_profile::slowest() const
+{
+	std::vector<slow_evaluation> res;
+	{
+		std::lock_guard<std::mutex> lock(m_slowest_mtx);
+		for (const auto& s : m_slowest)
+		{
+			if (s.time_ns > 0)
+			{
+				res.push_back(s);
+			}
+		}
+	}
+	std::sort(res.begin(), res.end(),
+		[](const slow_evaluation& a, const slow_evaluation& b) { return a.time_ns > b.time_ns; });
+	return res;
+}
+
+uint64_t stats_manager::rule_profile::estimated_time_ns() const
+{
+	auto samples = sampled_evaluations.load(std::memory_order_relaxed);
+	if (samples == 0)
+	{
+		return 0;
+	}
+	auto avg = (double) sampled_time_ns.load(std::memory_order_relaxed) / (double) samples;
+	return (uint64_t) (avg * (double) evaluations.load(std::memory_order_relaxed));
+}
+
+uint64_t stats_manager::rule_profile::time_percentile_ns(double percentile) const
+{
+	auto samples = sampled_evaluations.load(std::memory_order_relaxed);
+	if (samples == 0)
+	{
+		return 0;
+	}
+
+	uint64_t threshold = (uint64_t) std::ceil((percentile / 100.0) * (double) samples);
+	uint64_t count = 0;
+	for (size_t i = 0; i < num_time_buckets; i++)
+	{
+		count += time_buckets[i].load(std::memory_order_relaxed);
+		if (count >= threshold && count > 0)
+		{
+			return uint64_t(1) << i;
+		}
+	}
+	return uint64_t(1) << (num_time_buckets - 1);
 }
 
 void stats_manager::format(
@@ -40,11 +155,11 @@ void stats_manager::format(
 	std::string& out) const
 {
 	std::string fmt;
-	out = "Events detected: " + to_string(m_total) + "\n";
+	out = "Events detected: " + std::to_string(get_total()) + "\n";
 	out += "Rule counts by severity:\n";
 	for (size_t i = 0; i < m_by_priority.size(); i++)
 	{
-		auto val = m_by_priority[i]->load();
+		auto val = m_by_priority[i];
 		if (val > 0)
 		{
 			falco_common::format_priority(
@@ -56,34 +171,168 @@ void stats_manager::format(
 	out += "Triggered rules by rule name:\n";
 	for (size_t i = 0; i < m_by_rule_id.size(); i++)
 	{
-		auto val = m_by_rule_id[i]->load();
+		auto val = m_by_rule_id[i];
 		if (val > 0)
 		{
 			out += "   " + rules.at(i)->name + ": " + std::to_string(val) + "\n";
 		}
 	}
+	if (get_rate_limited_total() > 0)
+	{
+		out += "Alerts suppressed by rate limits: " + std::to_string(get_rate_limited_total()) + "\n";
+		for (size_t i = 0; i < m_rate_limited_by_rule_id.size(); i++)
+		{
+			auto val = m_rate_limited_by_rule_id[i];
+			if (val > 0)
+			{
+				out += "   " + rules.at(i)->name + ": " + std::to_string(val) + "\n";
+			}
+		}
+	}
+	if (get_exception_hits_total() > 0)
+	{
+		out += "Events excluded by rule exceptions: " + std::to_string(get_exception_hits_total()) + "\n";
+		for (size_t i = 0; i < m_exception_hits_by_rule_id.size(); i++)
+		{
+			auto val = m_exception_hits_by_rule_id[i];
+			if (val > 0)
+			{
+				out += "   " + rules.at(i)->name + ": " + std::to_string(val) + "\n";
+			}
+		}
+	}
+	if (m_profiling_enabled)
+	{
+		out += "Rule evaluation profile by rule name (evaluations, matches, estimated time, p99 time):\n";
+		for (size_t i = 0; i < m_profile_by_rule_id.size(); i++)
+		{
+			const auto& p = *m_profile_by_rule_id[i];
+			auto evals = p.evaluations.load();
+			if (evals > 0)
+			{
+				out += "   " + rules.at(i)->name + ": "
+					+ std::to_string(evals) + ", "
+					+ std::to_string(p.matches.load()) + ", "
+					+ std::to_string(p.estimated_time_ns()) + "ns, "
+					+ std::to_string(p.time_percentile_ns(99)) + "ns\n";
+			}
+		}
+	}
+}
+
+void stats_manager::format_profile(
+	const indexed_vector<falco_rule>& rules,
+	nlohmann::json& out) const
+{
+	out = nlohmann::json::array();
+	if (!m_profiling_enabled)
+	{
+		return;
+	}
+
+	std::vector<std::pair<size_t, uint64_t>> evaluated;
+	uint64_t total_time_ns = 0;
+	for (size_t i = 0; i < m_profile_by_rule_id.size() && i < rules.size(); i++)
+	{
+		if (m_profile_by_rule_id[i]->evaluations.load() > 0)
+		{
+			auto time_ns = m_profile_by_rule_id[i]->estimated_time_ns();
+			evaluated.emplace_back(i, time_ns);
+			total_time_ns += time_ns;
+		}
+	}
+	std::stable_sort(evaluated.begin(), evaluated.end(),
+		[](const auto& a, const auto& b) { return a.second > b.second; });
+
+	for (const auto& e : evaluated)
+	{
+		const auto& p = *m_profile_by_rule_id[e.first];
+		const auto* rule = rules.at(e.first);
+		auto evals = p.evaluations.load();
+		nlohmann::json entry;
+		entry["name"] = rule->name;
+		entry["source"] = rule->source;
+		entry["evaluations"] = evals;
+		entry["matches"] = p.matches.load();
+		entry["time_ns"] = e.second;
+		entry["avg_time_ns"] = e.second / evals;
+		entry["time_p50_ns"] = p.time_percentile_ns(50);
+		entry["time_p99_ns"] = p.time_percentile_ns(99);
+		entry["time_max_ns"] = p.max_time_ns();
+		entry["time_perc"] = total_time_ns > 0 ? 100.0 * e.second / total_time_ns : 0.0;
+		out.push_back(std::move(entry));
+	}
+}
+
+void stats_manager::format_slowest(
+	const indexed_vector<falco_rule>& rules,
+	size_t max,
+	nlohmann::json& out) const
+{
+	out = nlohmann::json::array();
+	if (!m_profiling_enabled)
+	{
+		return;
+	}
+
+	std::vector<std::pair<size_t, rule_profile::slow_evaluation>> slowest;
+	for (size_t i = 0; i < m_profile_by_rule_id.size() && i < rules.size(); i++)
+	{
+		for (const auto& e : m_profile_by_rule_id[i]->slowest())
+		{
+			slowest.emplace_back(i, e);
+		}
+	}
+	std::stable_sort(slowest.begin(), slowest.end(),
+		[](const auto& a, const auto& b) { return a.second.time_ns > b.second.time_ns; });
+	if (max > 0 && slowest.size() > max)
+	{
+		slowest.resize(max);
+	}
+
+	for (const auto& e : slowest)
+	{
+		const auto* rule = rules.at(e.first);
+		nlohmann::json entry;
+		entry["name"] = rule->name;
+		entry["source"] = rule->source;
+		entry["time_ns"] = e.second.time_ns;
+		entry["evt_type"] = e.second.evt_type;
+		entry["evt_ts"] = e.second.evt_ts;
+		out.push_back(std::move(entry));
+	}
 }
 
 void stats_manager::on_rule_loaded(const falco_rule& rule)
 {
-	while (m_by_rule_id.size() <= rule.id)
+	if (m_by_rule_id.size() <= rule.id)
+	{
+		m_by_rule_id.resize(rule.id + 1);
+	}
+	while (m_profile_by_rule_id.size() <= rule.id)
+	{
+		m_profile_by_rule_id.emplace_back(std::make_unique<rule_profile>());
+	}
+	if (m_rate_limited_by_rule_id.size() <= rule.id)
+	{
+		m_rate_limited_by_rule_id.resize(rule.id + 1);
+	}
+	if (m_exception_hits_by_rule_id.size() <= rule.id)
 	{
-		m_by_rule_id.emplace_back(std::make_unique<std::atomic<uint64_t>>(0));
+		m_exception_hits_by_rule_id.resize(rule.id + 1);
 	}
-	while (m_by_priority.size() <= (size_t) rule.priority)
+	if (m_by_priority.size() <= (size_t) rule.priority)
 	{
-		m_by_priority.emplace_back(std::make_unique<std::atomic<uint64_t>>(0));
+		m_by_priority.resize((size_t) rule.priority + 1);
 	}
 }
 
-void stats_manager::on_event(const falco_rule& rule)
+void stats_manager::on_rate_limited(const falco_rule& rule)
 {
-	if (m_by_rule_id.size() <= rule.id
-		|| m_by_priority.size() <= (size_t) rule.priority)
+	if (m_rate_limited_by_rule_id.size() <= rule.id)
 	{
-		throw falco_exception("rule id or priority out of bounds");
+		throw falco_exception("rule id out of bounds");
 	}
-	m_total.fetch_add(1, std::memory_order_relaxed);
-	m_by_rule_id[rule.id]->fetch_add(1, std::memory_order_relaxed);
-	m_by_priority[(size_t) rule.priority]->fetch_add(1, std::memory_order_relaxed);
+	m_totals.add(total_rate_limited);
+	m_rate_limited_by_rule_id.add(rule.id);
 }
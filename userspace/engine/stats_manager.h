@@ -17,22 +17,101 @@ limitations under the License.
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <string>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
 #include "falco_rule.h"
 #include "indexed_vector.h"
+#include "sharded_counters.h"
 
 /*!
 	\brief Manager for the internal statistics of the rule engine.
 	The on_event() is thread-safe and non-blocking, and it can be used
-	concurrently across many callers in parallel.
+	concurrently across many callers in parallel. The match counters are
+	sharded, so that callers on different threads do not contend on them.
 	All the other methods are not thread safe.
 */
 class stats_manager
 {
 public:
+	/*!
+		\brief Evaluation cost statistics of a given rule, collected
+		only when rule profiling is enabled. Evaluations and matches are
+		counted exactly, whereas evaluation times are measured only on
+		a sample of the evaluations to keep the overhead low.
+	*/
+	struct rule_profile
+	{
+		// Number of buckets of the evaluation time histogram. The i-th
+		// bucket counts the samples that took less than 2^i nanoseconds
+		// and at least 2^(i-1) nanoseconds.
+		static constexpr size_t num_time_buckets = 32;
+
+		std::atomic<uint64_t> evaluations{0};
+		std::atomic<uint64_t> matches{0};
+		std::atomic<uint64_t> sampled_evaluations{0};
+		std::atomic<uint64_t> sampled_time_ns{0};
+		std::array<std::atomic<uint64_t>, num_time_buckets> time_buckets{};
+
+		/*!
+			\brief One of the slowest sampled evaluations of a rule
+		*/
+		struct slow_evaluation
+		{
+			uint64_t time_ns = 0;
+			uint16_t evt_type = 0;
+			uint64_t evt_ts = 0;
+		};
+
+		// Number of the slowest sampled evaluations kept for each rule
+		static constexpr size_t num_slowest = 4;
+
+		/*!
+			\brief Returns the slowest sampled evaluations, slowest
+			first. This method is thread-safe.
+		*/
+		std::vector<slow_evaluation> slowest() const;
+
+		/*!
+			\brief Returns the time of the slowest sampled evaluation,
+			in nanoseconds.
+		*/
+		inline uint64_t max_time_ns() const
+		{
+			return m_max_time_ns.load(std::memory_order_relaxed);
+		}
+
+		/*!
+			\brief Returns the total evaluation time in nanoseconds,
+			extrapolated from the sampled evaluations.
+		*/
+		uint64_t estimated_time_ns() const;
+
+		/*!
+			\brief Returns an upper bound of the given percentile (in
+			the [0, 100] range) of the sampled evaluation times,
+			in nanoseconds.
+		*/
+		uint64_t time_percentile_ns(double percentile) const;
+
+	private:
+		friend class stats_manager;
+
+		void add_slow_evaluation(const slow_evaluation& e);
+
+		// the evaluations faster than the fastest of the kept ones are
+		// discarded without taking the lock, which happens for all the
+		// evaluations but the first few and the outliers
+		std::atomic<uint64_t> m_slowest_threshold_ns{0};
+		std::atomic<uint64_t> m_max_time_ns{0};
+		mutable std::mutex m_slowest_mtx;
+		std::array<slow_evaluation, num_slowest> m_slowest{};
+	};
+
 	stats_manager();
 	virtual ~stats_manager();
 
@@ -50,11 +129,84 @@ public:
 
 	/*!
 		\brief Callback for when a given rule matches an event.
-		This method is thread-safe.
+		This method is thread-safe. The rule must have been passed to
+		on_rule_loaded() first, which is not checked.
+	*/
+	inline void on_event(const falco_rule& rule)
+	{
+		m_totals.add(total_matches);
+		m_by_rule_id.add(rule.id);
+		m_by_priority.add((size_t) rule.priority);
+	}
+
+	/*!
+		\brief Callback for when the alert of a given rule matching an
+		event has been suppressed by the rate limit of the rule. The
+		match is still accounted by on_event(). This method is thread-safe.
 		\throws falco_exception if rule has not been passed to
 		on_rule_loaded() first
 	*/
-	virtual void on_event(const falco_rule& rule);
+	virtual void on_rate_limited(const falco_rule& rule);
+
+	/*!
+		\brief Callback for when an event matching the base condition of
+		a given rule has been excluded by one of its exceptions. This
+		method is thread-safe, and does nothing if the rule has not been
+		passed to on_rule_loaded() first.
+	*/
+	inline void on_exception_hit(const falco_rule& rule)
+	{
+		if (rule.id < m_exception_hits_by_rule_id.size())
+		{
+			m_totals.add(total_exception_hits);
+			m_exception_hits_by_rule_id.add(rule.id);
+		}
+	}
+
+	/*!
+		\brief Enables or disables the collection of the per-rule
+		evaluation cost statistics. When enabled, the evaluation time
+		is measured once every sampling_period evaluations.
+		The setting survives clear().
+	*/
+	virtual void set_rule_profiling(bool enabled, uint32_t sampling_period);
+
+	inline bool is_rule_profiling_enabled() const
+	{
+		return m_profiling_enabled;
+	}
+
+	inline uint32_t get_rule_profiling_sampling_period() const
+	{
+		return m_profiling_sampling_period;
+	}
+
+	/*!
+		\brief Callback for when a given rule has been evaluated against
+		an event. This method is thread-safe, and does nothing if the rule
+		has not been passed to on_rule_loaded() first.
+	*/
+	inline void on_rule_evaluated(size_t rule_id, bool matched)
+	{
+		if (rule_id < m_profile_by_rule_id.size())
+		{
+			auto& p = *m_profile_by_rule_id[rule_id];
+			p.evaluations.fetch_add(1, std::memory_order_relaxed);
+			if (matched)
+			{
+				p.matches.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/*!
+		\brief Callback for when the evaluation time of a given rule
+		has been sampled, on an event of the given type and timestamp.
+		This method is thread-safe, and does nothing if the rule has not
+		been passed to on_rule_loaded() first.
+	*/
+	void on_rule_evaluation_sampled(size_t rule_id, uint64_t time_ns,
+		uint16_t evt_type = 0, uint64_t evt_ts = 0);
 
 	/*!
 		\brief Formats the internal statistics into the out string.
@@ -63,25 +215,89 @@ public:
 		const indexed_vector<falco_rule>& rules,
 		std::string& out) const;
 
+	/*!
+		\brief Fills out with a JSON array of the evaluation profiles of
+		the rules evaluated at least once, sorted by decreasing estimated
+		evaluation time. Each entry has the name and the source of the
+		rule, its evaluations and matches, its estimated total and average
+		evaluation time, its p50 and p99 evaluation times, and the share
+		of the estimated evaluation time of all the rules it accounts
+		for. The array is empty if rule profiling is disabled.
+	*/
+	virtual void format_profile(
+		const indexed_vector<falco_rule>& rules,
+		nlohmann::json& out) const;
+
+	/*!
+		\brief Fills out with a JSON array of the slowest sampled
+		evaluations of all the rules, slowest first, up to max entries
+		if max is not 0. Each entry has the name and the source of the
+		rule, the evaluation time, and the type and the timestamp of the
+		evaluated event. The array is empty if rule profiling is disabled.
+	*/
+	virtual void format_slowest(
+		const indexed_vector<falco_rule>& rules,
+		size_t max,
+		nlohmann::json& out) const;
+
 	// Getter functions
-	inline const std::atomic<uint64_t>& get_total() const
+	inline uint64_t get_total() const
 	{
-		return m_total;
+		return m_totals.get(total_matches);
 	}
 
-	inline const std::vector<std::unique_ptr<std::atomic<uint64_t>>>& get_by_priority() const
+	inline const falco::sharded_counters& get_by_priority() const
 	{
 		return m_by_priority;
 	}
 
-	inline const std::vector<std::unique_ptr<std::atomic<uint64_t>>>& get_by_rule_id() const
+	inline const falco::sharded_counters& get_by_rule_id() const
 	{
 		return m_by_rule_id;
 	}
 
+	inline const std::vector<std::unique_ptr<rule_profile>>& get_profile_by_rule_id() const
+	{
+		return m_profile_by_rule_id;
+	}
+
+	inline uint64_t get_rate_limited_total() const
+	{
+		return m_totals.get(total_rate_limited);
+	}
+
+	inline const falco::sharded_counters& get_rate_limited_by_rule_id() const
+	{
+		return m_rate_limited_by_rule_id;
+	}
+
+	inline uint64_t get_exception_hits_total() const
+	{
+		return m_totals.get(total_exception_hits);
+	}
+
+	inline const falco::sharded_counters& get_exception_hits_by_rule_id() const
+	{
+		return m_exception_hits_by_rule_id;
+	}
+
 
 private:
-	std::atomic<uint64_t> m_total;
-	std::vector<std::unique_ptr<std::atomic<uint64_t>>> m_by_priority;
-	std::vector<std::unique_ptr<std::atomic<uint64_t>>> m_by_rule_id;
+	// the indexes of the totals in m_totals
+	enum total_index : size_t
+	{
+		total_matches = 0,
+		total_rate_limited,
+		total_exception_hits,
+		num_totals
+	};
+
+	falco::sharded_counters m_totals;
+	falco::sharded_counters m_by_priority;
+	falco::sharded_counters m_by_rule_id;
+	std::vector<std::unique_ptr<rule_profile>> m_profile_by_rule_id;
+	falco::sharded_counters m_rate_limited_by_rule_id;
+	falco::sharded_counters m_exception_hits_by_rule_id;
+	bool m_profiling_enabled;
+	uint32_t m_profiling_sampling_period;
 };
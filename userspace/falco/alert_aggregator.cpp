@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "alert_aggregator.h"
+#include "thread_affinity.h"
+
+#include <algorithm>
+
+using namespace falco::outputs;
+
+alert_aggregator::alert_aggregator(std::chrono::milliseconds window, size_t max_groups, std::function<void(group&)> emit)
+	: m_window(window),
+	  m_max_groups(max_groups),
+	  m_emit(emit)
+{
+	m_thread = std::thread(&alert_aggregator::worker, this);
+}
+
+alert_aggregator::~alert_aggregator()
+{
+	stop();
+}
+
+bool alert_aggregator::suppress(const std::string& key, uint64_t ts)
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	auto it = m_groups.find(key);
+	if(it == m_groups.end())
+	{
+		return false;
+	}
+
+	// the window is over, so this alert opens a new group and the
+	// summary of the expired one is left to the worker
+	auto& g = it->second;
+	if(std::chrono::steady_clock::now() >= g.deadline)
+	{
+		if(g.count > 0)
+		{
+			m_expired.push_back(std::move(g));
+			m_cv.notify_one();
+		}
+		m_groups.erase(it);
+		return false;
+	}
+
+	if(g.count++ == 0)
+	{
+		g.first_ts = ts;
+	}
+	g.last_ts = ts;
+	m_num_suppressed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void alert_aggregator::open(const std::string& key, group&& g)
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	if(m_groups.size() >= m_max_groups)
+	{
+		return;
+	}
+	g.count = 0;
+	g.deadline = std::chrono::steady_clock::now() + m_window;
+	m_groups[key] = std::move(g);
+}
+
+void alert_aggregator::stop()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(m_stop)
+		{
+			return;
+		}
+		m_stop = true;
+	}
+	m_cv.notify_one();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	// the worker is gone, so nothing else touches the groups anymore
+	for(auto& g : m_expired)
+	{
+		m_emit(g);
+	}
+	m_expired.clear();
+	for(auto& g : m_groups)
+	{
+		if(g.second.count > 0)
+		{
+			m_emit(g.second);
+		}
+	}
+	m_groups.clear();
+}
+
+void alert_aggregator::worker()
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	// groups expire with a delay of at most one tick
+	auto tick = std::min<std::chrono::milliseconds>(m_window, std::chrono::seconds(1));
+	std::vector<group> expired;
+
+	std::unique_lock<std::mutex> lk(m_mtx);
+	while(!m_stop)
+	{
+		m_cv.wait_for(lk, tick, [this] { return m_stop || !m_expired.empty(); });
+		if(m_stop)
+		{
+			break;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		for(auto it = m_groups.begin(); it != m_groups.end(); )
+		{
+			if(now < it->second.deadline)
+			{
+				++it;
+				continue;
+			}
+			if(it->second.count > 0)
+			{
+				m_expired.push_back(std::move(it->second));
+			}
+			it = m_groups.erase(it);
+		}
+
+		// summaries are emitted without holding the lock, so that the
+		// alerts are not blocked meanwhile
+		expired.swap(m_expired);
+		lk.unlock();
+		for(auto& g : expired)
+		{
+			m_emit(g);
+		}
+		expired.clear();
+		lk.lock();
+	}
+}
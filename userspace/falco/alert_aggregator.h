@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "falco_common.h"
+#include "field_values.h"
+#include "interned.h"
+
+namespace falco
+{
+namespace outputs
+{
+
+//
+// The configuration of the aggregation of similar alerts
+//
+struct aggregation_config
+{
+	bool enabled = false;
+	uint64_t window_ms = 10000;
+	std::vector<std::string> keys;
+	size_t max_groups = 10000;
+};
+
+/*!
+	\brief Groups the alerts with the same key (e.g. the rule and some of
+	its field values) over a time window. The first alert of a group is
+	emitted as usual and opens the group, the following ones are suppressed
+	until the window expires, and then one summary of the suppressed
+	alerts is emitted, if any. Summaries are emitted from an internal
+	thread, or by stop() for the groups that are still open.
+*/
+class alert_aggregator
+{
+public:
+	struct group
+	{
+		std::size_t rule_id = 0;
+		falco_common::priority_type priority = falco_common::PRIORITY_DEBUG;
+		falco::interned_string rule;
+		falco::interned_string source;
+		falco::interned_tags tags;
+
+		// the output fields of the alert that opened the group
+		falco::field_values fields;
+
+		// the number and timestamps of the suppressed alerts
+		uint64_t count = 0;
+		uint64_t first_ts = 0;
+		uint64_t last_ts = 0;
+
+		std::chrono::steady_clock::time_point deadline;
+	};
+
+	alert_aggregator(std::chrono::milliseconds window, size_t max_groups, std::function<void(group&)> emit);
+	virtual ~alert_aggregator();
+
+	alert_aggregator(alert_aggregator&&) = delete;
+	alert_aggregator& operator = (alert_aggregator&&) = delete;
+	alert_aggregator(const alert_aggregator&) = delete;
+	alert_aggregator& operator = (const alert_aggregator&) = delete;
+
+	/*!
+		\brief Returns true if an alert with the given key and timestamp
+		is suppressed, in which case it's accounted to its group. Otherwise,
+		the alert must be emitted and open() should be called for it.
+	*/
+	bool suppress(const std::string& key, uint64_t ts);
+
+	/*!
+		\brief Opens the group of an alert that has not been suppressed.
+		This has no effect when the maximum number of groups is reached.
+	*/
+	void open(const std::string& key, group&& g);
+
+	/*!
+		\brief Stops the internal thread and emits the summaries of the
+		groups that are still open
+	*/
+	void stop();
+
+	/*!
+		\brief Returns the number of alerts suppressed so far
+	*/
+	inline uint64_t num_suppressed() const
+	{
+		return m_num_suppressed.load(std::memory_order_relaxed);
+	}
+
+private:
+	void worker();
+
+	std::chrono::milliseconds m_window;
+	size_t m_max_groups;
+	std::function<void(group&)> m_emit;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	std::unordered_map<std::string, group> m_groups;
+	std::vector<group> m_expired;
+	std::atomic<uint64_t> m_num_suppressed = 0;
+	std::thread m_thread;
+};
+
+} // namespace outputs
+} // namespace falco
@@ -30,6 +30,7 @@ falco::app::run_result configure_syscall_buffer_num(const falco::app::state& s);
 falco::app::run_result create_requested_paths(falco::app::state& s);
 falco::app::run_result create_signal_handlers(falco::app::state& s);
 falco::app::run_result pidfile(const falco::app::state& s);
+falco::app::run_result hot_reload(falco::app::state& s);
 falco::app::run_result init_falco_engine(falco::app::state& s);
 falco::app::run_result init_inspectors(falco::app::state& s);
 falco::app::run_result init_outputs(falco::app::state& s);
@@ -45,6 +46,7 @@ falco::app::run_result print_kernel_version(const falco::app::state& s);
 falco::app::run_result print_page_size(const falco::app::state& s);
 falco::app::run_result print_plugin_info(const falco::app::state& s);
 falco::app::run_result print_support(falco::app::state& s);
+falco::app::run_result print_syscall_cost_report(falco::app::state& s);
 falco::app::run_result print_syscall_events(falco::app::state& s);
 falco::app::run_result print_version(falco::app::state& s);
 falco::app::run_result process_events(falco::app::state& s);
@@ -23,7 +23,7 @@ using namespace falco::app::actions;
 
 falco::app::run_result falco::app::actions::close_inspectors(falco::app::state& s)
 {
-	falco_logger::log(falco_logger::level::DEBUG, "closing inspectors");
+	FALCO_LOG(falco_logger::level::DEBUG, "closing inspectors");
 
 	if (s.offline_inspector != nullptr)
 	{
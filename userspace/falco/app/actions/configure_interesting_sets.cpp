@@ -61,15 +61,19 @@ static void check_for_rules_unsupported_events(falco::app::state& s, const libsi
 	std::cerr << "If syscalls in rules include high volume syscalls (-> activate via `-A` flag), else syscalls may have been removed via base_syscalls option or might be associated with syscalls undefined on your architecture (https://marcin.juszkiewicz.com.pl/download/tables/syscalls.html)" << std::endl;
 }
 
-static void select_event_set(falco::app::state& s, const libsinsp::events::set<ppm_sc_code>& rules_sc_set)
+libsinsp::events::set<ppm_sc_code> falco::app::actions::select_sc_set(
+		const falco::app::state& s,
+		const libsinsp::events::set<ppm_sc_code>& rules_sc_set)
 {
 	/* PPM syscall codes (sc) can be viewed as condensed libsinsp lookup table
 	 * to map a system call name to it's actual system syscall id (as defined
 	 * by the Linux kernel). Hence here we don't need syscall enter and exit distinction. */
-	auto rules_names = libsinsp::events::sc_set_to_event_names(rules_sc_set);
-	if (!rules_sc_set.empty())
+	// note: the names of the syscalls are only needed by the debug logs
+	bool debug = falco_logger::is_enabled(falco_logger::level::DEBUG);
+	if (!rules_sc_set.empty() && debug)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, "(" + std::to_string(rules_names.size())
+		auto rules_names = libsinsp::events::sc_set_to_event_names(rules_sc_set);
+		FALCO_LOG(falco_logger::level::DEBUG, "(" + std::to_string(rules_names.size())
 			+ ") syscalls in rules: " + concat_set_in_order(rules_names) + "\n");
 	}
 
@@ -100,22 +104,22 @@ static void select_event_set(falco::app::state& s, const libsinsp::events::set<p
 
 		// we re-transform from sc_set to names to make
 		// sure that bad user inputs are ignored
-		falco_logger::log(falco_logger::level::DEBUG, "+(" + std::to_string(user_positive_sc_set_names.size())
+		FALCO_LOG(falco_logger::level::DEBUG, "+(" + std::to_string(user_positive_sc_set_names.size())
 			+ ") syscalls added (base_syscalls override): "
 			+ concat_set_in_order(user_positive_sc_set_names) + "\n");
 	}
 	auto invalid_positive_sc_set_names = unordered_set_difference(user_positive_names, user_positive_sc_set_names);
 	if (!invalid_positive_sc_set_names.empty())
 	{
-		falco_logger::log(falco_logger::level::WARNING, "Invalid (positive) syscall names: warning (base_syscalls override): "
+		FALCO_LOG(falco_logger::level::WARNING, "Invalid (positive) syscall names: warning (base_syscalls override): "
 			+ concat_set_in_order(invalid_positive_sc_set_names));
 	}
 
 	// selected events are the union of the rules events set and the
 	// base events set (either the default or the user-defined one)
-	s.selected_sc_set = rules_sc_set.merge(base_sc_set);
+	auto selected_sc_set = rules_sc_set.merge(base_sc_set);
 
-	/* REPLACE DEFAULT STATE, nothing else. Need to override s.selected_sc_set and have a separate logic block. */
+	/* REPLACE DEFAULT STATE, nothing else. Need to override selected_sc_set and have a separate logic block. */
 	if (s.config->m_base_syscalls_repair && user_positive_sc_set.empty())
 	{
 		/* If `base_syscalls.repair` is specified, but `base_syscalls.custom_set` is empty we are replacing
@@ -125,36 +129,36 @@ static void select_event_set(falco::app::state& s, const libsinsp::events::set<p
 		 * on the current rules configuration. */
 
 		// returned set already has rules_sc_set merged
-		s.selected_sc_set = libsinsp::events::sinsp_repair_state_sc_set(rules_sc_set);
+		selected_sc_set = libsinsp::events::sinsp_repair_state_sc_set(rules_sc_set);
 	}
 
 	auto user_negative_sc_set_names = libsinsp::events::sc_set_to_event_names(user_negative_sc_set);
 	if (!user_negative_sc_set.empty())
 	{
 		/* Remove negative base_syscalls events. */
-		s.selected_sc_set = s.selected_sc_set.diff(user_negative_sc_set);
+		selected_sc_set = selected_sc_set.diff(user_negative_sc_set);
 
 		// we re-transform from sc_set to names to make
 		// sure that bad user inputs are ignored
-		falco_logger::log(falco_logger::level::DEBUG, "-(" + std::to_string(user_negative_sc_set_names.size())
+		FALCO_LOG(falco_logger::level::DEBUG, "-(" + std::to_string(user_negative_sc_set_names.size())
 			+ ") syscalls removed (base_syscalls override): "
 			+ concat_set_in_order(user_negative_sc_set_names) + "\n");
 	}
 	auto invalid_negative_sc_set_names = unordered_set_difference(user_negative_names, user_negative_sc_set_names);
 	if (!invalid_negative_sc_set_names.empty())
 	{
-		falco_logger::log(falco_logger::level::WARNING, "Invalid (negative) syscall names: warning (base_syscalls override): "
+		FALCO_LOG(falco_logger::level::WARNING, "Invalid (negative) syscall names: warning (base_syscalls override): "
 			+ concat_set_in_order(invalid_negative_sc_set_names));
 	}
 
 	/* Derive the diff between the additional syscalls added via libsinsp state
 	enforcement and the syscalls from each Falco rule. We avoid printing
 	this in case the user specified a custom set of base syscalls */
-	auto non_rules_sc_set = s.selected_sc_set.diff(rules_sc_set);
-	if (!non_rules_sc_set.empty() && user_positive_sc_set.empty())
+	auto non_rules_sc_set = selected_sc_set.diff(rules_sc_set);
+	if (!non_rules_sc_set.empty() && user_positive_sc_set.empty() && debug)
 	{
 		auto non_rules_sc_set_names = libsinsp::events::sc_set_to_event_names(non_rules_sc_set);
-		falco_logger::log(falco_logger::level::DEBUG, "+(" + std::to_string(non_rules_sc_set_names.size())
+		FALCO_LOG(falco_logger::level::DEBUG, "+(" + std::to_string(non_rules_sc_set_names.size())
 			+ ") syscalls (Falco's state engine set of syscalls): "
 			+ concat_set_in_order(non_rules_sc_set_names) + "\n");
 	}
@@ -167,12 +171,12 @@ static void select_event_set(falco::app::state& s, const libsinsp::events::set<p
 	if(!s.options.all_events)
 	{
 		auto ignored_sc_set = falco::app::ignored_sc_set();
-		auto erased_sc_set = s.selected_sc_set.intersect(ignored_sc_set);
-		s.selected_sc_set = s.selected_sc_set.diff(ignored_sc_set);
-		if (!erased_sc_set.empty())
+		auto erased_sc_set = selected_sc_set.intersect(ignored_sc_set);
+		selected_sc_set = selected_sc_set.diff(ignored_sc_set);
+		if (!erased_sc_set.empty() && debug)
 		{
 			auto erased_sc_set_names = libsinsp::events::sc_set_to_event_names(erased_sc_set);
-			falco_logger::log(falco_logger::level::DEBUG, "-(" + std::to_string(erased_sc_set_names.size())
+			FALCO_LOG(falco_logger::level::DEBUG, "-(" + std::to_string(erased_sc_set_names.size())
 				+ ") ignored syscalls (-> activate via `-A` flag): "
 				+ concat_set_in_order(erased_sc_set_names) + "\n");
 		}
@@ -186,13 +190,13 @@ static void select_event_set(falco::app::state& s, const libsinsp::events::set<p
 		 * This approach is an alternative to the default `sinsp_state_sc_set()` state enforcement
 		 * and only activates additional syscalls Falco needs beyond the syscalls defined in the
 		 * Falco rules that are absolutely necessary based on the current rules configuration. */
-		auto selected_sc_set = s.selected_sc_set;
-		s.selected_sc_set = libsinsp::events::sinsp_repair_state_sc_set(s.selected_sc_set);
-		auto repaired_sc_set = s.selected_sc_set.diff(selected_sc_set);
+		auto unrepaired_sc_set = selected_sc_set;
+		selected_sc_set = libsinsp::events::sinsp_repair_state_sc_set(selected_sc_set);
+		auto repaired_sc_set = selected_sc_set.diff(unrepaired_sc_set);
 		if (!repaired_sc_set.empty())
 		{
 			auto repaired_sc_set_names = libsinsp::events::sc_set_to_event_names(repaired_sc_set);
-			falco_logger::log(falco_logger::level::INFO, "+(" + std::to_string(repaired_sc_set_names.size())
+			FALCO_LOG(falco_logger::level::INFO, "+(" + std::to_string(repaired_sc_set_names.size())
 				+ ") repaired syscalls: " + concat_set_in_order(repaired_sc_set_names) + "\n");
 		}
 	}
@@ -202,15 +206,88 @@ static void select_event_set(falco::app::state& s, const libsinsp::events::set<p
 	 * -> sched_process_exit trace point activation (procexit event)
 	 * is necessary for continuous state engine cleanup,
 	 * else memory would grow rapidly and linearly over time. */
-	s.selected_sc_set.insert(ppm_sc_code::PPM_SC_SCHED_PROCESS_EXIT);
+	selected_sc_set.insert(ppm_sc_code::PPM_SC_SCHED_PROCESS_EXIT);
 
-	if (!s.selected_sc_set.empty())
+	if (!selected_sc_set.empty() && debug)
 	{
-		auto selected_sc_set_names = libsinsp::events::sc_set_to_event_names(s.selected_sc_set);
-		falco_logger::log(falco_logger::level::DEBUG, "(" + std::to_string(selected_sc_set_names.size())
+		auto selected_sc_set_names = libsinsp::events::sc_set_to_event_names(selected_sc_set);
+		FALCO_LOG(falco_logger::level::DEBUG, "(" + std::to_string(selected_sc_set_names.size())
 			+ ") syscalls selected in total (final set): "
 			+ concat_set_in_order(selected_sc_set_names) + "\n");
 	}
+
+	return selected_sc_set;
+}
+
+static void configure_kernel_prefilter(falco::app::state& s)
+{
+	s.kernel_prefilter_enabled = false;
+	s.kernel_prefilter_drop_failed = false;
+	auto src_info = s.source_infos.at(falco_common::syscall_source);
+	if (!s.config->m_base_syscalls_kernel_prefilter || src_info == nullptr || src_info->inspector == nullptr
+		|| !(s.is_kmod() || s.is_ebpf() || s.is_modern_ebpf()))
+	{
+		return;
+	}
+
+	// failed syscall exit events dropped on purpose are never restored
+	if (s.is_driver_drop_failed_exit_enabled())
+	{
+		return;
+	}
+
+	s.kernel_prefilter_enabled = true;
+	auto prefilter = s.engine->kernel_prefilter_for_ruleset(falco_common::syscall_source);
+	if (!prefilter.drop_failed_exit)
+	{
+		FALCO_LOG(falco_logger::level::DEBUG, "(" + std::to_string(prefilter.unfiltered_rules.size())
+			+ ") enabled rules also match failed syscalls (base_syscalls.kernel_prefilter): "
+			+ concat_set_in_order(std::unordered_set<std::string>(prefilter.unfiltered_rules.begin(), prefilter.unfiltered_rules.end())) + "\n");
+		return;
+	}
+
+	// note: the rules keep evaluating the syscall result, so they match
+	// the same events if the driver doesn't support this
+	try
+	{
+		src_info->inspector->set_dropfailed(true);
+		s.kernel_prefilter_drop_failed = true;
+		FALCO_LOG(falco_logger::level::INFO, "All enabled rules require successful syscalls, failed syscall exit events are dropped in the kernel driver\n");
+	}
+	catch (const std::exception& e)
+	{
+		FALCO_LOG(falco_logger::level::WARNING, "Could not drop failed syscall exit events in the kernel driver, filtering them in userspace: " + std::string(e.what()) + "\n");
+	}
+}
+
+static void create_syscall_cost(falco::app::state& s)
+{
+	auto src_info = s.source_infos.at(falco_common::syscall_source);
+	if (src_info == nullptr)
+	{
+		return;
+	}
+
+	src_info->syscall_cost.reset();
+	if (!s.config->m_metrics_enabled || !s.config->m_metrics_syscall_cost_enabled)
+	{
+		return;
+	}
+
+	// note: the events of the syscalls shared through the generic event
+	// types are attributed to all the rules needing any of them
+	std::vector<falco::syscall_cost::rule_evt_types> rules;
+	for (const auto& r : s.engine->sc_codes_by_rule_for_ruleset(falco_common::syscall_source))
+	{
+		falco::syscall_cost::rule_evt_types rule;
+		rule.rule = r.first;
+		for (const auto& e : libsinsp::events::sc_set_to_event_set(r.second.intersect(s.selected_sc_set)))
+		{
+			rule.evt_types.push_back((uint16_t)e);
+		}
+		rules.emplace_back(std::move(rule));
+	}
+	src_info->syscall_cost = std::make_shared<falco::syscall_cost>(rules, PPM_EVENT_MAX);
 }
 
 falco::app::run_result falco::app::actions::configure_interesting_sets(falco::app::state& s)
@@ -222,6 +299,7 @@ falco::app::run_result falco::app::actions::configure_interesting_sets(falco::ap
 	}
 
 	s.selected_sc_set.clear();
+	s.pending_sc_set_ready = false;
 
 	/* note: the set of events is the richest source of truth about
 	 * the events generable by an inspector, because they also carry information
@@ -232,8 +310,10 @@ falco::app::run_result falco::app::actions::configure_interesting_sets(falco::ap
 	 * inspector to instruct the kernel drivers on which kernel event should
 	 * be collected at runtime. */
 	auto rules_sc_set = s.engine->sc_codes_for_ruleset(falco_common::syscall_source);
-	select_event_set(s, rules_sc_set);
+	s.selected_sc_set = select_sc_set(s, rules_sc_set);
 	check_for_rules_unsupported_events(s, rules_sc_set);
+	create_syscall_cost(s);
+	configure_kernel_prefilter(s);
 
 #endif
 	return run_result::ok();
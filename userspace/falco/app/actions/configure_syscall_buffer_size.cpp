@@ -25,6 +25,10 @@ using namespace falco::app::actions;
 #define MAX_INDEX 10
 #define DEFAULT_BYTE_SIZE 1 << 23
 
+// the autosizer of the previous run of this process, whose recommendation
+// can be applied when Falco restarts
+static std::shared_ptr<falco::buffer_autosizer> s_last_autosizer;
+
 falco::app::run_result falco::app::actions::configure_syscall_buffer_size(falco::app::state& s)
 {
 #ifdef __linux__
@@ -39,6 +43,20 @@ falco::app::run_result falco::app::actions::configure_syscall_buffer_size(falco:
 		return run_result::fatal("The 'buf_size_preset' value must be between '" + std::to_string(MIN_INDEX) + "' and '" + std::to_string(MAX_INDEX) + "'\n");
 	}
 
+	const auto& autosize = s.config->m_buf_size_autosize;
+	if (autosize.m_enabled)
+	{
+		if (autosize.m_apply_on_restart && s_last_autosizer && s_last_autosizer->recommended_preset() > index)
+		{
+			auto recommended = std::min<int16_t>(s_last_autosizer->recommended_preset(), MAX_INDEX);
+			FALCO_LOG(falco_logger::level::INFO, "Applying the recommended 'buf_size_preset' " + std::to_string(recommended) + " instead of " + std::to_string(index) + "\n");
+			index = recommended;
+		}
+		s_last_autosizer = std::make_shared<falco::buffer_autosizer>(index, autosize.m_max_preset,
+			autosize.m_drop_rate, autosize.m_drop_intervals);
+		s.source_infos.at(falco_common::syscall_source)->buffer_autosizer = s_last_autosizer;
+	}
+
 	/* Sizes from `1 MB` to `512 MB`. The index `0` is reserved, users cannot use it! */
 	std::vector<uint32_t> vect{0, 1 << 20, 1 << 21, 1 << 22, DEFAULT_BYTE_SIZE, 1 << 24, 1 << 25, 1 << 26, 1 << 27, 1 << 28, 1 << 29};
 
@@ -49,7 +67,7 @@ falco::app::run_result falco::app::actions::configure_syscall_buffer_size(falco:
 	if(page_size <= 0)
 	{
 		s.syscall_buffer_bytes_size = DEFAULT_BYTE_SIZE;
-		falco_logger::log(falco_logger::level::WARNING, "Unable to get the system page size through 'getpagesize()'. Try to use the default syscall buffer dimension: " + std::to_string(DEFAULT_BYTE_SIZE) + " bytes\n");
+		FALCO_LOG(falco_logger::level::WARNING, "Unable to get the system page size through 'getpagesize()'. Try to use the default syscall buffer dimension: " + std::to_string(DEFAULT_BYTE_SIZE) + " bytes\n");
 		return run_result::ok();
 	}
 
@@ -66,7 +84,7 @@ falco::app::run_result falco::app::actions::configure_syscall_buffer_size(falco:
 	}
 
 	s.syscall_buffer_bytes_size = chosen_size;
-	falco_logger::log(falco_logger::level::INFO, "The chosen syscall buffer dimension is: " + std::to_string(chosen_size) + " bytes (" +  std::to_string(chosen_size / (uint64_t)(1024 * 1024)) + " MBs)\n");
+	FALCO_LOG(falco_logger::level::INFO, "The chosen syscall buffer dimension is: " + std::to_string(chosen_size) + " bytes (" +  std::to_string(chosen_size / (uint64_t)(1024 * 1024)) + " MBs)\n");
 	
 #endif // __linux__
 	return run_result::ok();
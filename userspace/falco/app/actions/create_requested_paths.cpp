@@ -29,38 +29,43 @@ falco::app::run_result falco::app::actions::create_requested_paths(falco::app::s
 {
 	if(s.is_gvisor())
 	{
-		// This is bad: parsing gvisor config to get endpoint
-		// to be able to auto-create the path to the file for the user.
-		std::ifstream reader(s.config->m_gvisor.m_config);
-		if (reader.fail())
+		std::vector<std::string> configs = {s.config->m_gvisor.m_config};
+		configs.insert(configs.end(), s.config->m_gvisor.m_shards.begin(), s.config->m_gvisor.m_shards.end());
+		for (const auto& config : configs)
 		{
-			return run_result::fatal(s.config->m_gvisor.m_config + ": cannot open file");
-		}
+			// This is bad: parsing gvisor config to get endpoint
+			// to be able to auto-create the path to the file for the user.
+			std::ifstream reader(config);
+			if (reader.fail())
+			{
+				return run_result::fatal(config + ": cannot open file");
+			}
 
-		nlohmann::json parsed_json;
-		std::string gvisor_socket;
-		try
-		{
-			parsed_json = nlohmann::json::parse(reader);
-		}
-		catch (const std::exception &e)
-		{
-			return run_result::fatal(s.config->m_gvisor.m_config + ": cannot parse JSON: " + e.what());
-		}
+			nlohmann::json parsed_json;
+			std::string gvisor_socket;
+			try
+			{
+				parsed_json = nlohmann::json::parse(reader);
+			}
+			catch (const std::exception &e)
+			{
+				return run_result::fatal(config + ": cannot parse JSON: " + e.what());
+			}
 
-		try
-		{
-			gvisor_socket = parsed_json["trace_session"]["sinks"][0]["config"]["endpoint"];
-		}
-		catch (const std::exception &e)
-		{
-			return run_result::fatal(s.config->m_gvisor.m_config + ": failed to fetch config.endpoint: " + e.what());
-		}
+			try
+			{
+				gvisor_socket = parsed_json["trace_session"]["sinks"][0]["config"]["endpoint"];
+			}
+			catch (const std::exception &e)
+			{
+				return run_result::fatal(config + ": failed to fetch config.endpoint: " + e.what());
+			}
 
-		int ret = create_dir(gvisor_socket);
-		if (ret != 0)
-		{
-			return run_result::fatal(gvisor_socket + ": " + strerror(errno));
+			int ret = create_dir(gvisor_socket);
+			if (ret != 0)
+			{
+				return run_result::fatal(gvisor_socket + ": " + strerror(errno));
+			}
 		}
 	}
 
@@ -79,6 +84,16 @@ falco::app::run_result falco::app::actions::create_requested_paths(falco::app::s
 		}
 	}
 
+	if (s.config->m_flight_recorder.m_enabled && !s.is_capture_mode())
+	{
+		// note: the trailing slash makes the path a directory
+		int ret = create_dir(s.config->m_flight_recorder.m_path + "/");
+		if (ret != 0)
+		{
+			return run_result::fatal(s.config->m_flight_recorder.m_path + ": " + strerror(errno));
+		}
+	}
+
 	// TODO: eventually other files written by Falco whose destination is
 	// customizable by users, must be handled here.
 	return run_result::ok();
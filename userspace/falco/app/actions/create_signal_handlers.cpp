@@ -18,6 +18,7 @@ limitations under the License.
 #include <functional>
 
 #include "actions.h"
+#include "helpers.h"
 #include "../app.h"
 #include "../signals.h"
 
@@ -40,6 +41,11 @@ static void reopen_outputs_signal_handler(int signal)
 	falco::app::g_reopen_outputs_signal.trigger();
 }
 
+static void profile_signal_handler(int signal)
+{
+	falco::app::g_profile_signal.trigger();
+}
+
 static void restart_signal_handler(int signal)
 {
 	if (s_restarter != nullptr)
@@ -69,40 +75,22 @@ bool create_handler(int sig, void (*func)(int), run_result &ret)
 	return ret.success;
 }
 
-falco::app::run_result falco::app::actions::create_signal_handlers(falco::app::state& s)
+falco::app::run_result falco::app::actions::start_restart_handler(falco::app::state& s)
 {
 	auto ret = run_result::ok();
 
 #ifdef __linux__
-	if (s.options.dry_run)
-	{
-		falco_logger::log(falco_logger::level::DEBUG, "Skipping signal handlers creation in dry-run\n");
-		return run_result::ok();
-	}
-
-	falco::app::g_terminate_signal.reset();
-	falco::app::g_restart_signal.reset();
-	falco::app::g_reopen_outputs_signal.reset();
-
-	if (!g_terminate_signal.is_lock_free()
-		|| !g_restart_signal.is_lock_free()
-		|| !g_reopen_outputs_signal.is_lock_free())
-	{
-		falco_logger::log(falco_logger::level::WARNING, "Bundled atomics implementation is not lock-free, signal handlers may be unstable\n");
-	}
-
-	if(! create_handler(SIGINT, ::terminate_signal_handler, ret) ||
-	   ! create_handler(SIGTERM, ::terminate_signal_handler, ret) ||
-	   ! create_handler(SIGUSR1, ::reopen_outputs_signal_handler, ret) ||
-	   ! create_handler(SIGHUP, ::restart_signal_handler, ret))
-	{
-		return ret;
-	}
-
 	falco::app::restart_handler::watch_list_t files_to_watch;
 	falco::app::restart_handler::watch_list_t dirs_to_watch;
+	falco::app::restart_handler::watch_sums_t sums_to_watch;
 	if (s.config->m_watch_config_files)
 	{
+		sums_to_watch.insert(
+			s.config->m_loaded_configs_filenames_sha256sum.begin(),
+			s.config->m_loaded_configs_filenames_sha256sum.end());
+		sums_to_watch.insert(
+			s.config->m_loaded_rules_filenames_sha256sum.begin(),
+			s.config->m_loaded_rules_filenames_sha256sum.end());
 		files_to_watch.insert(
 			files_to_watch.end(),
 			s.config->m_loaded_configs_filenames.begin(),
@@ -127,6 +115,7 @@ falco::app::run_result falco::app::actions::create_signal_handlers(falco::app::s
 		std::string err;
 		falco::app::state tmp_state(s.cmdline, s.options);
 		tmp_state.options.dry_run = true;
+		tmp_state.validating_restart = true;
 		try
 		{
 			success = falco::app::run(tmp_state, tmp, err);
@@ -150,9 +139,8 @@ falco::app::run_result falco::app::actions::create_signal_handlers(falco::app::s
 		}
 
 		return success;
-	}, files_to_watch, dirs_to_watch);
+	}, files_to_watch, dirs_to_watch, sums_to_watch);
 
-	ret = run_result::ok();
 	ret.success = s.restarter->start(ret.errstr);
 	ret.proceed = ret.success;
 	if (ret.success)
@@ -164,12 +152,63 @@ falco::app::run_result falco::app::actions::create_signal_handlers(falco::app::s
 	return ret;
 }
 
+falco::app::run_result falco::app::actions::create_signal_handlers(falco::app::state& s)
+{
+	auto ret = run_result::ok();
+
+#ifdef __linux__
+	if (s.options.dry_run)
+	{
+		FALCO_LOG(falco_logger::level::DEBUG, "Skipping signal handlers creation in dry-run\n");
+		return run_result::ok();
+	}
+
+	falco::app::g_terminate_signal.reset();
+	falco::app::g_restart_signal.reset();
+	falco::app::g_reopen_outputs_signal.reset();
+	falco::app::g_profile_signal.reset();
+
+	if (!g_terminate_signal.is_lock_free()
+		|| !g_restart_signal.is_lock_free()
+		|| !g_reopen_outputs_signal.is_lock_free()
+		|| !g_profile_signal.is_lock_free())
+	{
+		FALCO_LOG(falco_logger::level::WARNING, "Bundled atomics implementation is not lock-free, signal handlers may be unstable\n");
+	}
+
+	if(! create_handler(SIGINT, ::terminate_signal_handler, ret) ||
+	   ! create_handler(SIGTERM, ::terminate_signal_handler, ret) ||
+	   ! create_handler(SIGUSR1, ::reopen_outputs_signal_handler, ret) ||
+	   ! create_handler(SIGHUP, ::restart_signal_handler, ret))
+	{
+		return ret;
+	}
+
+	// SIGUSR2 keeps terminating Falco unless the profiler is enabled
+	if (s.config->m_profiler.m_enabled)
+	{
+		s.profiler = std::make_shared<falco::profiler>(
+			s.config->m_profiler.m_frequency_hz,
+			std::chrono::seconds(s.config->m_profiler.m_duration_sec),
+			s.config->m_profiler.m_output_dir);
+		if (! create_handler(SIGUSR2, ::profile_signal_handler, ret))
+		{
+			return ret;
+		}
+	}
+
+	return start_restart_handler(s);
+#endif
+
+	return ret;
+}
+
 falco::app::run_result falco::app::actions::unregister_signal_handlers(falco::app::state& s)
 {
 #ifdef __linux__
 	if (s.options.dry_run)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, "Skipping unregistering signal handlers in dry-run\n");
+		FALCO_LOG(falco_logger::level::DEBUG, "Skipping unregistering signal handlers in dry-run\n");
 		return run_result::ok();
 	}
 
@@ -183,10 +222,17 @@ falco::app::run_result falco::app::actions::unregister_signal_handlers(falco::ap
 	if(! create_handler(SIGINT, SIG_DFL, ret) ||
 	   ! create_handler(SIGTERM, SIG_DFL, ret) ||
 	   ! create_handler(SIGUSR1, SIG_DFL, ret) ||
-	   ! create_handler(SIGHUP, SIG_DFL, ret))
+	   ! create_handler(SIGHUP, SIG_DFL, ret) ||
+	   (s.profiler != nullptr && ! create_handler(SIGUSR2, SIG_DFL, ret)))
 	{
 		return ret;
 	}
+	// the webserver may be waiting for a session, which must not delay
+	// stopping it
+	if (s.profiler != nullptr)
+	{
+		s.profiler->stop();
+	}
 #endif // __linux__
 
 	return run_result::ok();
@@ -22,6 +22,8 @@ limitations under the License.
 
 #include <nlohmann/json.hpp>
 
+#include <chrono>
+
 namespace falco {
 namespace app {
 namespace actions {
@@ -30,14 +32,64 @@ bool check_rules_plugin_requirements(falco::app::state& s, std::string& err);
 void print_enabled_event_sources(falco::app::state& s);
 void activate_interesting_kernel_tracepoints(falco::app::state& s, std::unique_ptr<sinsp>& inspector);
 void check_for_ignored_events(falco::app::state& s);
+libsinsp::events::set<ppm_sc_code> select_sc_set(
+		const falco::app::state& s,
+		const libsinsp::events::set<ppm_sc_code>& rules_sc_set);
 void format_plugin_info(std::shared_ptr<sinsp_plugin> p, std::ostream& os);
 void format_described_rules_as_text(const nlohmann::json& v, std::ostream& os);
+void format_rules_memory_report_as_text(const nlohmann::json& v, std::ostream& os);
+void format_rules_cost_report_as_text(const nlohmann::json& v, std::ostream& os);
+void format_syscall_cost_report_as_text(const nlohmann::json& v, std::ostream& os);
+
+void configure_falco_engine(const falco::app::state& s, falco_engine& engine);
+void apply_rules_selection(const falco::app::state& s, falco_engine& engine, bool log);
+// Returns whether a rule is enabled once apply_rules_selection is applied,
+// given its name, tags, and whether it's defined as enabled
+bool is_rule_selected(const falco::app::state& s, const std::string& name,
+		const std::set<std::string>& tags, bool enabled);
+bool list_capture_files(const falco::app::state& s, std::vector<std::string>& files, std::string& err);
+// Writes the rules of the engine of Falco for the engines of the workers,
+// which must happen before its loading state is released
+std::string write_worker_rules(const falco::app::state& s);
+// Creates the engine of a worker, for an inspector of its own, with the
+// rules written by write_worker_rules and the settings of the engine of Falco
+std::shared_ptr<falco_engine> create_worker_engine(
+    const falco::app::state& s,
+    sinsp* inspector,
+    filter_check_list& filterchecks,
+    const std::string& rules);
+
+void init_syscall_inspector(const falco::app::state& s, std::shared_ptr<sinsp> inspector);
 
-falco::app::run_result open_offline_inspector(falco::app::state& s);
+// A plugin to init in the inspector of an event source
+struct plugin_init
+{
+	sinsp* inspector;
+	std::string source;
+	std::shared_ptr<sinsp_plugin> plugin;
+	const falco_configuration::plugin_config* config;
+	std::chrono::steady_clock::duration duration{};
+};
+// Inits the given plugins, recording the duration of each. The plugins of
+// an inspector are inited in the given order by a single thread, while the
+// different inspectors init theirs concurrently. Returns false with the
+// error of the first inspector failing to init one of its plugins.
+bool init_plugins(std::vector<plugin_init>& inits, std::string& err);
+falco::app::run_result open_offline_inspector(falco::app::state& s, const std::string& capture_file);
+falco::app::run_result process_capture_files(
+    falco::app::state& s,
+    const std::vector<std::string>& capture_files,
+    const std::string& rules);
+falco::app::run_result process_gvisor_shard(
+    falco::app::state& s,
+    size_t shard,
+    const std::string& rules,
+    const std::atomic<bool>& stop);
 falco::app::run_result open_live_inspector(
     falco::app::state& s,
     std::shared_ptr<sinsp> inspector,
     const std::string& source);
+falco::app::run_result start_restart_handler(falco::app::state& s);
 
 template<class InputIterator>
 void read_files(InputIterator begin, InputIterator end,
@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "helpers.h"
+#include "../signals.h"
+#include "../../capture_files.h"
+#include "../../falco_outputs.h"
+#include "../../thread_affinity.h"
+#include "formats.h"
+
+#include <libsinsp/plugin_manager.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+using namespace falco::app;
+using namespace falco::app::actions;
+
+// the number of alerts held to be merged across the capture files
+static constexpr size_t s_merge_window = 65536;
+
+// The outcome of the processing of a capture file by a worker
+struct capture_file_result
+{
+	run_result res = run_result::ok();
+	uint64_t num_evts = 0;
+};
+
+// Sends the alerts of the capture files to the outputs in timestamp order,
+// as they are produced by the workers. The latest alerts are held in a
+// heap of bounded size, so that the memory doesn't grow with the replay,
+// and the oldest one is sent each time the heap is full. The alerts of a
+// file are in timestamp order, and so are the ones sent unless an alert
+// is older than all the ones held when produced, which is counted.
+class alert_merger
+{
+public:
+	alert_merger(falco_outputs& outputs, size_t window): m_outputs(outputs), m_window(window)
+	{
+	}
+
+	void push(falco::outputs::message&& alert, size_t file)
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_heap.push_back({std::move(alert), file, m_seq++});
+		std::push_heap(m_heap.begin(), m_heap.end(), later);
+		if(m_heap.size() > m_window)
+		{
+			send_oldest();
+		}
+	}
+
+	void flush()
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		while(!m_heap.empty())
+		{
+			send_oldest();
+		}
+	}
+
+	uint64_t num_alerts() const { return m_num_alerts; }
+	uint64_t num_out_of_order() const { return m_num_out_of_order; }
+
+private:
+	struct entry
+	{
+		falco::outputs::message alert;
+		size_t file;
+		uint64_t seq;
+	};
+
+	// the heap keeps the oldest alert on top, and the alerts with the
+	// same timestamp in the order of their files, then of production
+	static bool later(const entry& a, const entry& b)
+	{
+		if(a.alert.ts != b.alert.ts)
+		{
+			return a.alert.ts > b.alert.ts;
+		}
+		if(a.file != b.file)
+		{
+			return a.file > b.file;
+		}
+		return a.seq > b.seq;
+	}
+
+	void send_oldest()
+	{
+		std::pop_heap(m_heap.begin(), m_heap.end(), later);
+		auto& e = m_heap.back();
+		if(m_num_alerts > 0 && e.alert.ts < m_last_ts)
+		{
+			m_num_out_of_order++;
+		}
+		m_last_ts = std::max(m_last_ts, e.alert.ts);
+		m_num_alerts++;
+		m_outputs.handle_alert(e.alert);
+		m_heap.pop_back();
+	}
+
+	falco_outputs& m_outputs;
+	const size_t m_window;
+	std::mutex m_mtx;
+	std::vector<entry> m_heap;
+	uint64_t m_seq = 0;
+	uint64_t m_last_ts = 0;
+	uint64_t m_num_alerts = 0;
+	uint64_t m_num_out_of_order = 0;
+};
+
+// Evaluates the rules over all the events of a capture file, with an
+// inspector and an engine of its own, and hands its alerts formatted to
+// the merger as they come
+static void process_capture_file(
+		const falco::app::state& s,
+		const std::string& capture_file,
+		size_t file,
+		const std::string& rules,
+		alert_merger& merger,
+		capture_file_result& r)
+{
+	try
+	{
+		auto inspector = std::make_shared<sinsp>();
+		inspector->set_buffer_format(s.options.event_buffer_format);
+		inspector->set_hostname_and_port_resolution_mode(false);
+		sinsp_filter_check_list filterchecks;
+		auto engine = create_worker_engine(s, inspector.get(), filterchecks, rules);
+		falco_formats formats(engine, s.config->m_json_include_output_property, s.config->m_json_include_tags_property);
+		const auto& hostname = s.outputs->hostname();
+
+		inspector->open_savefile(capture_file);
+		inspector->start_capture();
+		auto source = engine->get_source_handle(0);
+		std::vector<falco_engine::rule_match> matches;
+		sinsp_evt* ev = nullptr;
+		while(true)
+		{
+			int32_t rc = inspector->next(&ev);
+			if(rc == SCAP_EOF)
+			{
+				break;
+			}
+			else if(rc == SCAP_TIMEOUT || rc == SCAP_FILTERED_EVENT)
+			{
+				continue;
+			}
+			else if(rc != SCAP_SUCCESS)
+			{
+				throw falco_exception(inspector->getlasterr());
+			}
+
+			// the signal is handled once all the workers stopped
+			if(++r.num_evts % 1024 == 0 && falco::app::g_terminate_signal.triggered())
+			{
+				break;
+			}
+
+			if(!engine->process_event(source, ev, s.config->m_rule_matching, matches))
+			{
+				continue;
+			}
+			for(const auto& m : matches)
+			{
+				const auto& rule = *m.rule;
+				falco::outputs::message alert;
+				alert.ts = ev->get_ts();
+				alert.priority = rule.priority;
+				alert.rule = rule.name;
+				alert.source = rule.source;
+				alert.tags = rule.tags;
+				auto formatter = engine->get_rule_formatter(rule.id);
+				formats.format_event(alert.msg, ev, rule.name, rule.source,
+					falco_common::format_priority(rule.priority), *formatter, rule.tags, hostname);
+				alert.fields = engine->get_rule_field_values(ev, rule.id);
+				merger.push(std::move(alert), file);
+			}
+		}
+		inspector->stop_capture();
+		inspector->close();
+	}
+	catch(const std::exception& e)
+	{
+		r.res = run_result::fatal("Could not replay the capture file " + capture_file + ": " + e.what());
+	}
+}
+
+bool falco::app::actions::list_capture_files(const falco::app::state& s, std::vector<std::string>& files, std::string& err)
+{
+	std::vector<std::string> paths;
+	if(!s.config->m_replay.m_capture_file.empty())
+	{
+		paths.push_back(s.config->m_replay.m_capture_file);
+	}
+	paths.insert(paths.end(), s.config->m_replay.m_capture_files.begin(), s.config->m_replay.m_capture_files.end());
+	if(!falco::capture_files::list(paths, files, err))
+	{
+		return false;
+	}
+	if(files.empty())
+	{
+		err = "No capture file to replay";
+		return false;
+	}
+	return true;
+}
+
+falco::app::run_result falco::app::actions::process_capture_files(
+		falco::app::state& s,
+		const std::vector<std::string>& capture_files,
+		const std::string& rules)
+{
+	// the plugins can't be registered again in the inspectors of the workers
+	if(!s.offline_inspector->get_plugin_manager()->plugins().empty())
+	{
+		return run_result::fatal("Replaying more than one capture file is not supported when plugins are loaded");
+	}
+
+	size_t num_workers = s.config->m_replay.m_workers;
+	if(num_workers == 0)
+	{
+		num_workers = std::thread::hardware_concurrency();
+	}
+	num_workers = std::clamp<size_t>(num_workers, 1, capture_files.size());
+	FALCO_LOG(falco_logger::level::INFO, "Replaying events from " + std::to_string(capture_files.size())
+		+ " capture files with " + std::to_string(num_workers) + " workers\n");
+
+	// the files are taken by the workers in order, one at a time
+	std::vector<capture_file_result> results(capture_files.size());
+	alert_merger merger(*s.outputs, s_merge_window);
+	std::atomic<size_t> next{0};
+	auto wall_start = std::chrono::steady_clock::now();
+	double cpu_start = ((double)clock()) / CLOCKS_PER_SEC;
+	std::vector<std::thread> workers;
+	for(size_t w = 0; w < num_workers; w++)
+	{
+		workers.emplace_back([&s, &capture_files, &rules, &merger, &results, &next]()
+		{
+			falco::thread_affinity::apply(falco::thread_affinity::EVENT_SOURCES);
+			for(size_t i = next++; i < capture_files.size(); i = next++)
+			{
+				if(falco::app::g_terminate_signal.triggered())
+				{
+					break;
+				}
+				process_capture_file(s, capture_files[i], i, rules, merger, results[i]);
+			}
+		});
+	}
+	for(auto& w : workers)
+	{
+		w.join();
+	}
+	if(falco::app::g_terminate_signal.triggered())
+	{
+		falco::app::g_terminate_signal.handle([&](){
+			FALCO_LOG(falco_logger::level::INFO, "SIGINT received, exiting...\n");
+		});
+	}
+
+	merger.flush();
+	auto res = run_result::ok();
+	uint64_t num_evts = 0;
+	for(const auto& r : results)
+	{
+		res = run_result::merge(res, r.res);
+		num_evts += r.num_evts;
+	}
+	if(merger.num_out_of_order() > 0)
+	{
+		FALCO_LOG(falco_logger::level::WARNING, std::to_string(merger.num_out_of_order())
+			+ " alerts were sent out of timestamp order, as the capture files overlap by more than "
+			+ std::to_string(s_merge_window) + " alerts\n");
+	}
+
+	std::chrono::duration<double> wall_duration = std::chrono::steady_clock::now() - wall_start;
+	double cpu_duration = ((double)clock()) / CLOCKS_PER_SEC - cpu_start;
+	double wait_duration = s.outputs->get_backpressure_wait_ns()["queue"] / 1e9;
+	char stats[320];
+	snprintf(stats, sizeof(stats), "Replayed %zu capture files with %zu workers: %" PRIu64 " events, %" PRIu64 " alerts, "
+		"elapsed time %.3lf s (%.2lf eps), CPU time %.3lf s, waiting for the outputs %.3lf s\n",
+		capture_files.size(), num_workers, num_evts, merger.num_alerts(),
+		wall_duration.count(), num_evts / std::max(wall_duration.count(), 1e-9), cpu_duration, wait_duration);
+	FALCO_LOG(falco_logger::level::INFO, stats);
+	return res;
+}
@@ -48,7 +48,7 @@ void falco::app::actions::print_enabled_event_sources(falco::app::state& s)
 		str += str.empty() ? "" : ", ";
 		str += src;
 	}
-	falco_logger::log(falco_logger::level::INFO, "Loaded event sources: " + str);
+	FALCO_LOG(falco_logger::level::INFO, "Loaded event sources: " + str);
 
 	/* Print all enabled sources. */
 	str.clear();
@@ -57,7 +57,7 @@ void falco::app::actions::print_enabled_event_sources(falco::app::state& s)
 		str += str.empty() ? "" : ", ";
 		str += src;
 	}
-	falco_logger::log(falco_logger::level::INFO, "Enabled event sources: " + str);
+	FALCO_LOG(falco_logger::level::INFO, "Enabled event sources: " + str);
 
 	// print some warnings to the user
 	for (const auto& src : s.enabled_sources)
@@ -78,7 +78,7 @@ void falco::app::actions::print_enabled_event_sources(falco::app::state& s)
 				{
 					if (src != falco_common::syscall_source || s.is_nodriver())
 					{
-						falco_logger::log(falco_logger::level::WARNING, "Enabled event source '"
+						FALCO_LOG(falco_logger::level::WARNING, "Enabled event source '"
 							+ src + "' can be opened with multiple loaded plugins, will use only '"
 							+ first_plugin->name() + "'");
 					}
@@ -87,7 +87,7 @@ void falco::app::actions::print_enabled_event_sources(falco::app::state& s)
 		}
 		if (!first_plugin && s.is_nodriver())
 		{
-			falco_logger::log(falco_logger::level::WARNING, "Enabled event source '"
+			FALCO_LOG(falco_logger::level::WARNING, "Enabled event source '"
 				+ src + "' will be opened with no driver, no event will be produced");
 		}
 	}
@@ -146,3 +146,103 @@ void falco::app::actions::format_described_rules_as_text(const nlohmann::json& v
 		format_two_columns(os, r["info"]["name"], str);
 	}
 }
+
+void falco::app::actions::format_rules_memory_report_as_text(const nlohmann::json& v, std::ostream& os)
+{
+	format_two_columns(os, "Component", "Value (bytes, or number of items)");
+	format_two_columns(os,  "---------", "---------------------------------");
+	for(auto it = v.begin(); it != v.end(); ++it)
+	{
+		if(!it.value().is_object())
+		{
+			format_two_columns(os, it.key(), it.value().dump());
+			continue;
+		}
+		for(auto sub = it.value().begin(); sub != it.value().end(); ++sub)
+		{
+			format_two_columns(os, it.key() + "." + sub.key(), sub.value().dump());
+		}
+	}
+}
+
+static std::string join_names(const nlohmann::json& names)
+{
+	std::string res;
+	for(const auto& n : names)
+	{
+		res += (res.empty() ? "" : ", ") + n.get<std::string>();
+	}
+	return res;
+}
+
+void falco::app::actions::format_rules_cost_report_as_text(const nlohmann::json& v, std::ostream& os)
+{
+	format_two_columns(os, "Rule", "Estimated cost (in plain field comparisons)");
+	format_two_columns(os, "----", "-------------------------------------------");
+	for(const auto& r : v["rules"])
+	{
+		std::string str = r["cost"].dump() + ": " + r["predicates"].dump() + " predicates";
+		if(r.contains("event_types"))
+		{
+			str += ", " + r["event_types"].dump() + " event types";
+		}
+		if(r["list_values"].get<uint64_t>() > 0)
+		{
+			str += ", " + r["list_values"].dump() + " list values (largest list: " + r["largest_list"].dump() + ")";
+		}
+		if(!r["expensive_operators"].empty())
+		{
+			str += ", operators: " + join_names(r["expensive_operators"]);
+		}
+		if(!r["expensive_fields"].empty())
+		{
+			str += ", fields: " + join_names(r["expensive_fields"]);
+		}
+		if(!r["transformers"].empty())
+		{
+			str += ", transformers: " + join_names(r["transformers"]);
+		}
+		for(const auto& reason : r["hot_reasons"])
+		{
+			str += "; LIKELY HOT, " + reason.get<std::string>();
+		}
+		format_two_columns(os, r["name"], falco::utils::wrap_text(str, 51, 110));
+	}
+	os << std::endl << v["num_hot_rules"].dump() << " of " << v["num_rules"].dump() << " rules likely to be hot" << std::endl;
+}
+
+void falco::app::actions::format_syscall_cost_report_as_text(const nlohmann::json& v, std::ostream& os)
+{
+	os << "Selected syscalls: " << v["selected_syscalls"].dump()
+		<< ", of which needed by the state engine only: " << v["state_only_syscalls"].size() << std::endl;
+	if(!v["state_only_syscalls"].empty())
+	{
+		os << falco::utils::wrap_text(join_names(v["state_only_syscalls"]), 0, 110) << std::endl;
+	}
+	os << std::endl;
+
+	format_two_columns(os, "Rule", "Syscalls (exclusive: not needed by other rules nor the state engine)");
+	format_two_columns(os, "----", "--------------------------------------------------------------------");
+	for(const auto& r : v["rules"])
+	{
+		std::string str = std::to_string(r["syscalls"].size()) + " (" + std::to_string(r["exclusive_syscalls"].size()) + ")";
+		if(!r["exclusive_syscalls"].empty())
+		{
+			str += ": " + join_names(r["exclusive_syscalls"]);
+		}
+		if(!r["not_selected_syscalls"].empty())
+		{
+			str += ", not selected: " + join_names(r["not_selected_syscalls"]);
+		}
+		format_two_columns(os, r["name"], falco::utils::wrap_text(str, 51, 110));
+	}
+	os << std::endl;
+
+	format_two_columns(os, "Syscall", "Rules");
+	format_two_columns(os, "-------", "-----");
+	for(auto it = v["syscalls"].begin(); it != v["syscalls"].end(); ++it)
+	{
+		auto str = join_names(it.value());
+		format_two_columns(os, it.key(), falco::utils::wrap_text(str.empty() ? "(state engine only)" : str, 51, 110));
+	}
+}
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "helpers.h"
+#include "../signals.h"
+#include "../../falco_outputs.h"
+#include "formats.h"
+
+#include <libsinsp/plugin_manager.h>
+
+using namespace falco::app;
+using namespace falco::app::actions;
+
+// The signals and the stop request are only checked once every this many
+// events, or when the inspector returns no event
+static constexpr uint32_t s_stop_checks_interval = 1024;
+
+// Returns the id of the sandbox of the event, through a filtercheck of the
+// engine of the shard, or an empty string if there is none
+static std::string extract_sandbox_id(sinsp_filter_check* chk, sinsp_evt* ev, std::vector<extract_value_t>& values)
+{
+	if(chk == nullptr || !chk->extract(ev, values, false) || values.empty())
+	{
+		return "";
+	}
+	return std::string((const char*) values[0].ptr);
+}
+
+falco::app::run_result falco::app::actions::process_gvisor_shard(
+		falco::app::state& s,
+		size_t shard,
+		const std::string& rules,
+		const std::atomic<bool>& stop)
+{
+	// the plugins can't be registered again in the inspectors of the shards
+	if(!s.offline_inspector->get_plugin_manager()->plugins().empty())
+	{
+		return run_result::fatal("gVisor shards are not supported when plugins are loaded");
+	}
+
+	const auto& config = s.config->m_gvisor.m_shards.at(shard - 1);
+	auto sandboxes = s.source_infos.at(falco_common::syscall_source)->gvisor_shards.at(shard);
+	try
+	{
+		auto inspector = std::make_shared<sinsp>();
+		init_syscall_inspector(s, inspector);
+		if(s.config->m_falco_libs_thread_table_size > 0)
+		{
+			inspector->m_thread_manager->set_max_thread_table_size(s.config->m_falco_libs_thread_table_size);
+		}
+		sinsp_filter_check_list filterchecks;
+		auto engine = create_worker_engine(s, inspector.get(), filterchecks, rules);
+		falco_formats formats(engine, s.config->m_json_include_output_property, s.config->m_json_include_tags_property);
+		const auto& hostname = s.outputs->hostname();
+
+		std::unique_ptr<sinsp_filter_check> sandbox_check = engine->filter_factory_for_source(0)->new_filtercheck("container.id");
+		if(sandbox_check != nullptr && sandbox_check->parse_field_name("container.id", true, false) <= 0)
+		{
+			sandbox_check = nullptr;
+		}
+		std::vector<extract_value_t> sandbox_values;
+
+		FALCO_LOG(falco_logger::level::INFO, "Opening gVisor shard " + std::to_string(shard) + ". Configuration path: " + config);
+		inspector->open_gvisor(config, s.config->m_gvisor.m_root);
+		inspector->start_capture();
+		auto source = engine->get_source_handle(0);
+		std::vector<falco_engine::rule_match> matches;
+		sinsp_evt* ev = nullptr;
+		uint32_t evts_since_stop_checks = 0;
+		while(true)
+		{
+			int32_t rc = inspector->next(&ev);
+			if(rc != SCAP_SUCCESS || ++evts_since_stop_checks >= s_stop_checks_interval)
+			{
+				evts_since_stop_checks = 0;
+				if(stop.load(std::memory_order_relaxed) || falco::app::g_terminate_signal.triggered()
+					|| falco::app::g_restart_signal.triggered())
+				{
+					break;
+				}
+			}
+			if(rc == SCAP_TIMEOUT || rc == SCAP_FILTERED_EVENT)
+			{
+				continue;
+			}
+			else if(rc != SCAP_SUCCESS)
+			{
+				throw falco_exception(inspector->getlasterr());
+			}
+
+			auto tinfo = ev->get_thread_info();
+			sandboxes->count(ev->get_tid(), tinfo != nullptr ? tinfo->m_clone_ts : 0, [&]()
+			{
+				return extract_sandbox_id(sandbox_check.get(), ev, sandbox_values);
+			});
+
+			if(!engine->process_event(source, ev, s.config->m_rule_matching, matches))
+			{
+				continue;
+			}
+
+			// the alerts are formatted by the engine of the shard, as the
+			// one of the outputs only knows the events of its inspector
+			for(const auto& m : matches)
+			{
+				const auto& rule = *m.rule;
+				falco::outputs::message alert;
+				alert.ts = ev->get_ts();
+				alert.priority = rule.priority;
+				alert.rule = rule.name;
+				alert.source = rule.source;
+				alert.tags = rule.tags;
+				auto formatter = engine->get_rule_formatter(rule.id);
+				formats.format_event(alert.msg, ev, rule.name, rule.source,
+					falco_common::format_priority(rule.priority), *formatter, rule.tags, hostname);
+				alert.fields = engine->get_rule_field_values(ev, rule.id);
+				s.outputs->handle_alert(alert);
+			}
+		}
+		inspector->stop_capture();
+		inspector->close();
+	}
+	catch(const std::exception& e)
+	{
+		return run_result::fatal("Error in gVisor shard " + std::to_string(shard) + ": " + e.what());
+	}
+	return run_result::ok();
+}
@@ -27,17 +27,17 @@ limitations under the License.
 using namespace falco::app;
 using namespace falco::app::actions;
 
-falco::app::run_result falco::app::actions::open_offline_inspector(falco::app::state& s)
+falco::app::run_result falco::app::actions::open_offline_inspector(falco::app::state& s, const std::string& capture_file)
 {
 	try
 	{
-		s.offline_inspector->open_savefile(s.config->m_replay.m_capture_file);
-		falco_logger::log(falco_logger::level::INFO, "Replaying events from the capture file: " + s.config->m_replay.m_capture_file + "\n");
+		s.offline_inspector->open_savefile(capture_file);
+		FALCO_LOG(falco_logger::level::INFO, "Replaying events from the capture file: " + capture_file + "\n");
 		return run_result::ok();
 	}
 	catch (sinsp_exception &e)
 	{
-		return run_result::fatal("Could not open trace filename " + s.config->m_replay.m_capture_file + " for reading: " + e.what());
+		return run_result::fatal("Could not open trace filename " + capture_file + " for reading: " + e.what());
 	}
 }
 
@@ -48,7 +48,16 @@ falco::app::run_result falco::app::actions::open_live_inspector(
 {
 	try
 	{
-		if(s.config->m_falco_libs_thread_table_size > 0)
+		auto thread_table = s.source_infos.at(source)->thread_table;
+		if (thread_table != nullptr)
+		{
+			uint32_t size = thread_table->start(falco::thread_table_sizer::host_threads());
+			if (size > 0)
+			{
+				inspector->m_thread_manager->set_max_thread_table_size(size);
+			}
+		}
+		else if(s.config->m_falco_libs_thread_table_size > 0)
 		{
 			// Default value is set in libs as part of the sinsp_thread_manager setup
 			inspector->m_thread_manager->set_max_thread_table_size(s.config->m_falco_libs_thread_table_size);
@@ -64,7 +73,7 @@ falco::app::run_result falco::app::actions::open_live_inspector(
 				if (p->caps() & CAP_SOURCING && p->id() != 0 && p->event_source() == source)
 				{
 					auto cfg = s.plugin_configs.at(p->name());
-					falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with plugin '" + cfg->m_name + "'");
+					FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with plugin '" + cfg->m_name + "'");
 					inspector->open_plugin(cfg->m_name, cfg->m_open_params);
 					return run_result::ok();
 				}
@@ -82,44 +91,44 @@ falco::app::run_result falco::app::actions::open_live_inspector(
 				if (p->caps() & CAP_SOURCING && p->id() == 0)
 				{
 					auto cfg = s.plugin_configs.at(p->name());
-					falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with plugin '" + cfg->m_name + "'");
+					FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with plugin '" + cfg->m_name + "'");
 					inspector->open_plugin(cfg->m_name, cfg->m_open_params);
 					return run_result::ok();
 				}
 			}
-			falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with no driver\n");
+			FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with no driver\n");
 			inspector->open_nodriver();
 		}
 		else if(s.is_gvisor()) /* gvisor engine. */
 		{
-			falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with gVisor. Configuration path: " + s.config->m_gvisor.m_config);
+			FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with gVisor. Configuration path: " + s.config->m_gvisor.m_config);
 			inspector->open_gvisor(s.config->m_gvisor.m_config, s.config->m_gvisor.m_root);
 		}
 		else if(s.is_modern_ebpf()) /* modern BPF engine. */
 		{
-			falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with modern BPF probe.");
-			falco_logger::log(falco_logger::level::INFO, "One ring buffer every '" + std::to_string(s.config->m_modern_ebpf.m_cpus_for_each_buffer) +  "' CPUs.");
+			FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with modern BPF probe.");
+			FALCO_LOG(falco_logger::level::INFO, "One ring buffer every '" + std::to_string(s.config->m_modern_ebpf.m_cpus_for_each_buffer) +  "' CPUs.");
 			inspector->open_modern_bpf(s.syscall_buffer_bytes_size, s.config->m_modern_ebpf.m_cpus_for_each_buffer, true, s.selected_sc_set);
 		}
 		else if(s.is_ebpf()) /* BPF engine. */
 		{
-			falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with BPF probe. BPF probe path: " + s.config->m_ebpf.m_probe_path);
+			FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with BPF probe. BPF probe path: " + s.config->m_ebpf.m_probe_path);
 			inspector->open_bpf(s.config->m_ebpf.m_probe_path.c_str(), s.syscall_buffer_bytes_size, s.selected_sc_set);
 		}
 		else /* Kernel module (default). */
 		{
 			try
 			{
-				falco_logger::log(falco_logger::level::INFO, "Opening '" + source + "' source with Kernel module");
+				FALCO_LOG(falco_logger::level::INFO, "Opening '" + source + "' source with Kernel module");
 				inspector->open_kmod(s.syscall_buffer_bytes_size, s.selected_sc_set);
 			}
 			catch(sinsp_exception &e)
 			{
 				// Try to insert the Falco kernel module
-				falco_logger::log(falco_logger::level::INFO, "Trying to inject the Kernel module and opening the capture again...");
+				FALCO_LOG(falco_logger::level::INFO, "Trying to inject the Kernel module and opening the capture again...");
 				if(system("modprobe " DRIVER_NAME " > /dev/null 2> /dev/null"))
 				{
-					falco_logger::log(falco_logger::level::ERR, "Unable to load the driver\n");
+					FALCO_LOG(falco_logger::level::ERR, "Unable to load the driver\n");
 				}
 				inspector->open_kmod(s.syscall_buffer_bytes_size, s.selected_sc_set);
 			}
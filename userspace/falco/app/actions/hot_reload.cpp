@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "actions.h"
+#include "helpers.h"
+#include "../signals.h"
+
+#include <chrono>
+#include <functional>
+#include <list>
+
+using namespace falco::app;
+using namespace falco::app::actions;
+
+// Reloads the configuration, the rules and the outputs after a restart,
+// keeping the inspectors open so that their thread tables are preserved and
+// the events captured meanwhile are processed afterwards. If the restart
+// changes any other setting, this exits so that the whole app is restarted.
+falco::app::run_result falco::app::actions::hot_reload(falco::app::state& s)
+{
+	if (!s.is_hot_reload_enabled())
+	{
+		return run_result::exit();
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto prev_config = s.config;
+	s.config = std::make_shared<falco_configuration>();
+	auto res = load_config(s);
+	if (!res.success)
+	{
+		s.config = prev_config;
+		return res;
+	}
+
+	if (!prev_config->is_hot_reloadable_to(*s.config))
+	{
+		FALCO_LOG(falco_logger::level::INFO, "The configuration changes require reopening the inspectors, restarting...\n");
+		return run_result::exit();
+	}
+
+	// the restart handler reads the outputs, and its watcher is done anyways
+	if (s.restarter != nullptr)
+	{
+		s.restarter->stop();
+	}
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
+	// the rules service waits for the new engine, as its callback reads it
+	std::unique_lock<std::mutex> grpc_lock;
+	if (s.config->m_grpc_enabled && s.config->m_grpc_rules_api)
+	{
+		grpc_lock = s.grpc_server.lock_rules_engine();
+	}
+#endif
+
+	s.engine = std::make_shared<falco_engine>();
+	std::list<std::function<falco::app::run_result(falco::app::state&)>> reload_steps = {
+		init_falco_engine,
+		load_rules_files,
+		init_outputs,
+	};
+	for (const auto& func : reload_steps)
+	{
+		res = run_result::merge(res, func(s));
+		if (!res.proceed)
+		{
+			return res;
+		}
+	}
+
+	// the driver keeps collecting the previous syscalls until the syscall
+	// source thread applies the new ones, which requires live updates
+	auto prev_sc_set = s.selected_sc_set;
+	bool prev_drop_failed = s.kernel_prefilter_drop_failed;
+	res = configure_interesting_sets(s);
+	if (!res.success)
+	{
+		return res;
+	}
+	bool live_update = s.config->m_base_syscalls_live_update
+		&& (s.is_kmod() || s.is_ebpf() || s.is_modern_ebpf());
+	if (s.selected_sc_set != prev_sc_set && !live_update)
+	{
+		FALCO_LOG(falco_logger::level::INFO, "The rules changes require collecting other syscalls, restarting...\n");
+		return run_result::exit();
+	}
+	{
+		std::lock_guard<std::mutex> lk(s.pending_sc_set_mtx);
+		s.pending_sc_set = s.selected_sc_set;
+		// note: configure_interesting_sets only enables the kernel prefilter
+		s.pending_kernel_drop_failed = s.kernel_prefilter_drop_failed;
+		s.kernel_prefilter_drop_failed = s.kernel_prefilter_drop_failed || prev_drop_failed;
+		s.selected_sc_set = prev_sc_set;
+		s.pending_sc_set_ready = true;
+	}
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
+	if (grpc_lock.owns_lock())
+	{
+		s.grpc_server.set_rules_engine(s.engine);
+		grpc_lock.unlock();
+	}
+#endif
+
+	res = start_restart_handler(s);
+	if (!res.success)
+	{
+		return res;
+	}
+
+	falco::app::g_restart_signal.reset();
+	s.restart = false;
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	FALCO_LOG(falco_logger::level::INFO, "Reloaded the configuration, the rules and the outputs in "
+		+ std::to_string(elapsed.count()) + " (ms), keeping the inspectors open\n");
+	return run_result::ok();
+}
@@ -16,12 +16,23 @@ limitations under the License.
 */
 
 #include "actions.h"
+#include "helpers.h"
+#include "../../falco_outputs.h"
+#include "rules_arena.h"
 #include <libsinsp/plugin_manager.h>
 
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
 using namespace falco::app;
 using namespace falco::app::actions;
 
-void configure_output_format(falco::app::state& s)
+// The key of the rules handed over to the engines of the workers, which
+// only need to be written with the same engine settings
+static const std::string s_worker_rules_key = "workers";
+
+static void configure_output_format(const falco::app::state& s, falco_engine& engine)
 {
 	// See https://falco.org/docs/rules/style-guide/
 	const std::string container_info = "container_id=%container.id container_image=%container.image.repository container_image_tag=%container.image.tag container_name=%container.name";
@@ -59,7 +70,7 @@ void configure_output_format(falco::app::state& s)
 
 	if(!output_format.empty())
 	{
-		s.engine->set_extra(output_format, replace_container_info);
+		engine.set_extra(output_format, replace_container_info);
 	}
 }
 
@@ -78,6 +89,12 @@ void add_source_to_engine(falco::app::state& s, const std::string& src)
 	}
 
 	src_info->engine_idx = s.engine->add_source(src, filter_factory, formatter_factory);
+
+	// the threads compiling the rules each use their own filter factory
+	s.engine->set_filter_factory_creator(src_info->engine_idx, [inspector, &filterchecks]()
+	{
+		return std::make_shared<sinsp_filter_factory>(inspector, filterchecks);
+	});
 }
 
 falco::app::run_result falco::app::actions::init_falco_engine(falco::app::state& s)
@@ -122,8 +139,95 @@ falco::app::run_result falco::app::actions::init_falco_engine(falco::app::state&
 		}
 	}
 
-	configure_output_format(s);
-	s.engine->set_min_priority(s.config->m_min_priority);
-
+	configure_falco_engine(s, *s.engine);
 	return run_result::ok();
 }
+
+void falco::app::actions::configure_falco_engine(const falco::app::state& s, falco_engine& engine)
+{
+	configure_output_format(s, engine);
+	engine.set_min_priority(s.config->m_min_priority);
+	// the rules disabled by the selection are only compiled if enabled
+	// later on, e.g. through the API
+	engine.set_rule_enabled_hint([&s](const std::string& name, const std::set<std::string>& tags, bool enabled)
+	{
+		return is_rule_selected(s, name, tags, enabled);
+	});
+	// the adaptive rule ordering and the replay report rely on rule profiling
+	bool adaptive_ordering = s.config->m_rule_matching == falco_common::rule_matching::FIRST
+		&& s.config->m_rule_matching_adaptive_ordering_enabled;
+	bool replay_report = s.is_capture_mode() && s.config->m_replay.m_report;
+	engine.set_rule_profiling(
+		(s.config->m_metrics_enabled && s.config->m_metrics_rules_profiling_enabled) || adaptive_ordering || replay_report,
+		s.config->m_metrics_rules_profiling_sampling_period);
+
+	for(const auto& l : s.config->m_rule_rate_limits)
+	{
+		if(l.m_has_priority)
+		{
+			engine.set_rate_limit(l.m_priority, l.m_limit);
+		}
+		else
+		{
+			engine.set_rate_limit(l.m_rule, l.m_limit);
+		}
+	}
+	engine.set_rule_state_max_memory(s.config->m_rule_state_max_memory);
+
+	size_t compile_threads = s.config->m_rules_compile_threads;
+	if (compile_threads == 0)
+	{
+		compile_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	engine.get_rule_compiler()->set_compile_threads(compile_threads);
+
+	// the warnings are the point of validating the rules
+	bool fast_load = s.config->m_rules_fast_load && s.options.validate_rules_filenames.empty();
+	engine.get_rule_compiler()->set_warnings_enabled(!fast_load);
+
+	// the arenas are shared by all the engines of the process
+	falco::rules_arena::set_hugepages(s.config->m_rules_arena_hugepages);
+}
+
+std::string falco::app::actions::write_worker_rules(const falco::app::state& s)
+{
+	std::ostringstream os;
+	s.engine->write_rules_cache(os, s_worker_rules_key);
+	return os.str();
+}
+
+std::shared_ptr<falco_engine> falco::app::actions::create_worker_engine(
+		const falco::app::state& s,
+		sinsp* inspector,
+		filter_check_list& filterchecks,
+		const std::string& rules)
+{
+	auto engine = std::make_shared<falco_engine>();
+	auto filter_factory = std::make_shared<sinsp_filter_factory>(inspector, filterchecks);
+	auto formatter_factory = std::make_shared<sinsp_evt_formatter_factory>(inspector, filterchecks);
+	if(s.config->m_json_output)
+	{
+		formatter_factory->set_output_format(sinsp_evt_formatter::OF_JSON);
+	}
+	auto source_idx = engine->add_source(falco_common::syscall_source, filter_factory, formatter_factory);
+	engine->set_filter_factory_creator(source_idx, [inspector, &filterchecks]()
+	{
+		return std::make_shared<sinsp_filter_factory>(inspector, filterchecks);
+	});
+	configure_falco_engine(s, *engine);
+
+	bool time_format_iso_8601 = s.config->m_time_format_iso_8601;
+	engine->set_rule_output_format([time_format_iso_8601](const falco_rule& r)
+	{
+		return falco_outputs::alert_format(r.output, r.priority, time_format_iso_8601);
+	});
+
+	std::istringstream is(rules);
+	if(!engine->load_rules_cache(is, s_worker_rules_key))
+	{
+		throw falco_exception("could not load the rules in the worker engine");
+	}
+	apply_rules_selection(s, *engine, false);
+	engine->complete_rule_loading();
+	return engine;
+}
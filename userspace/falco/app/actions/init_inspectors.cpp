@@ -17,7 +17,12 @@ limitations under the License.
 
 #include "actions.h"
 #include "helpers.h"
+#include "../../plugin_field_batch.h"
 
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
 #include <unordered_set>
 
 #include <libsinsp/plugin_manager.h>
@@ -25,7 +30,7 @@ limitations under the License.
 using namespace falco::app;
 using namespace falco::app::actions;
 
-static void init_syscall_inspector(falco::app::state& s, std::shared_ptr<sinsp> inspector)
+void falco::app::actions::init_syscall_inspector(const falco::app::state& s, std::shared_ptr<sinsp> inspector)
 {
 	inspector->set_buffer_format(s.options.event_buffer_format);
 
@@ -51,7 +56,7 @@ static void init_syscall_inspector(falco::app::state& s, std::shared_ptr<sinsp>
 
 	if (s.is_driver_drop_failed_exit_enabled())
 	{
-		falco_logger::log(falco_logger::level::INFO, "Failed syscall exit events are dropped in the kernel driver\n");
+		FALCO_LOG(falco_logger::level::INFO, "Failed syscall exit events are dropped in the kernel driver\n");
 		inspector->set_dropfailed(true);
 	}
 
@@ -97,12 +102,68 @@ static bool populate_filterchecks(
 		}
 
 		// add plugin filterchecks to the event source
-		filterchecks.add_filter_check(sinsp_plugin::new_filtercheck(plugin));
+		filterchecks.add_filter_check(falco::batched_plugin_filtercheck::create(plugin));
 		used_plugins.insert(plugin->name());
 	}
 	return true;
 }
 
+// Inits the plugins of an inspector in order, as a plugin can rely on the
+// state tables of the ones inited before it. A library is never inited by
+// two threads at once, as the plugins are not required to support it.
+static bool init_inspector_plugins(std::vector<plugin_init*>& inits, std::map<std::string, std::mutex>& library_mtxs, std::string& err)
+{
+	for (auto i : inits)
+	{
+		std::lock_guard<std::mutex> lk(library_mtxs.at(i->config->m_library_path));
+		auto start = std::chrono::steady_clock::now();
+		if (!i->plugin->init(i->config->m_init_config, err))
+		{
+			return false;
+		}
+		i->duration = std::chrono::steady_clock::now() - start;
+	}
+	return true;
+}
+
+bool falco::app::actions::init_plugins(std::vector<plugin_init>& inits, std::string& err)
+{
+	// the plugins are grouped by inspector, in the order they are queued
+	std::vector<std::vector<plugin_init*>> groups;
+	std::map<const sinsp*, size_t> group_idxs;
+	std::map<std::string, std::mutex> library_mtxs;
+	for (auto& i : inits)
+	{
+		auto it = group_idxs.emplace(i.inspector, groups.size()).first;
+		if (it->second == groups.size())
+		{
+			groups.emplace_back();
+		}
+		groups[it->second].push_back(&i);
+		library_mtxs[i.config->m_library_path];
+	}
+
+	// each inspector inits its plugins in its own thread, as an inspector
+	// is not thread-safe
+	std::vector<std::string> errs(groups.size());
+	std::vector<std::future<bool>> inited(groups.size());
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		inited[g] = std::async(std::launch::async, init_inspector_plugins,
+			std::ref(groups[g]), std::ref(library_mtxs), std::ref(errs[g]));
+	}
+	bool res = true;
+	for (size_t g = 0; g < groups.size(); g++)
+	{
+		if (!inited[g].get() && res)
+		{
+			err = errs[g];
+			res = false;
+		}
+	}
+	return res;
+}
+
 falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s)
 {
 	std::string err;
@@ -114,6 +175,9 @@ falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s
 
 	}
 
+	// the plugins are registered first, as the inspectors are not
+	// thread-safe, and then inited for all the inspectors at once
+	std::vector<plugin_init> inits;
 	for (const auto &src : s.loaded_sources)
 	{
 		auto src_info = s.source_infos.at(src);
@@ -130,7 +194,8 @@ falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s
 								      "",
 								      "",
 								      "",
-								      s.config->m_metrics_flags & METRICS_V2_STATE_COUNTERS);
+								      (s.config->m_metrics_flags & METRICS_V2_STATE_COUNTERS)
+								      || s.config->m_falco_libs_thread_table_autosize.m_enabled);
 		}
 
 		// do extra preparation for the syscall source
@@ -139,7 +204,7 @@ falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s
 			init_syscall_inspector(s, src_info->inspector);
 		}
 
-		// load and init all plugins compatible with this event source
+		// load all plugins compatible with this event source
 		// (if in capture mode, all plugins will be inited on the same inspector)
 		for (const auto& p : all_plugins)
 		{
@@ -170,7 +235,7 @@ falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s
 				}
 			}
 
-			// init the plugin, if we registered it into an inspector
+			// queue the plugin for init, if we registered it into an inspector
 			// (in capture mode, this is true for every plugin)
 			if (plugin)
 			{
@@ -178,10 +243,7 @@ falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s
 				// inspector if we're in capture mode
 				if (!s.is_capture_mode() || used_plugins.find(p->name()) == used_plugins.end())
 				{
-					if (!plugin->init(config->m_init_config, err))
-					{
-						return run_result::fatal(err);
-					}
+					inits.push_back({src_info->inspector.get(), src, plugin, config});
 				}
 				if (is_input)
 				{
@@ -191,6 +253,24 @@ falco::app::run_result falco::app::actions::init_inspectors(falco::app::state& s
 				used_plugins.insert(plugin->name());
 			}
 		}
+	}
+
+	// in capture mode, all the plugins share the offline inspector and are
+	// inited serially in config order
+	if (!init_plugins(inits, err))
+	{
+		return run_result::fatal(err);
+	}
+	for (const auto& i : inits)
+	{
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(i.duration).count();
+		FALCO_LOG(falco_logger::level::INFO, "Plugin '" + i.plugin->name() + "' initialized for source '"
+			+ i.source + "' in " + std::to_string(ms) + " (ms)\n");
+	}
+
+	for (const auto &src : s.loaded_sources)
+	{
+		auto src_info = s.source_infos.at(src);
 
 		// populate filtercheck list for this inspector
 		if (!populate_filterchecks(
@@ -23,6 +23,9 @@ limitations under the License.
 #endif
 
 #include "actions.h"
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+#include "../../otlp_exporter.h"
+#endif
 
 using namespace falco::app;
 using namespace falco::app::actions;
@@ -41,7 +44,7 @@ falco::app::run_result falco::app::actions::init_outputs(falco::app::state& s)
 	if(env_hostname || (env_hostname = getenv("FALCO_GRPC_HOSTNAME")))
 	{
 		hostname = env_hostname;
-		falco_logger::log(falco_logger::level::INFO, "Hostname value has been overridden via environment variable to: " + hostname + "\n");
+		FALCO_LOG(falco_logger::level::INFO, "Hostname value has been overridden via environment variable to: " + hostname + "\n");
 	}
 	else
 	{
@@ -56,10 +59,31 @@ falco::app::run_result falco::app::actions::init_outputs(falco::app::state& s)
 
 	if (s.options.dry_run)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, "Skipping outputs initialization in dry-run\n");
+		FALCO_LOG(falco_logger::level::DEBUG, "Skipping outputs initialization in dry-run\n");
 		return run_result::ok();
 	}
 
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	if (s.config->m_otlp.m_enabled)
+	{
+		std::string err;
+		auto otlp = std::make_shared<falco::otlp_exporter>();
+		if (!otlp->init(s.config->m_otlp, hostname, err))
+		{
+			return run_result::fatal("Could not initialize the OTLP exporter: " + err);
+		}
+		s.otlp = otlp;
+		FALCO_LOG(falco_logger::level::INFO, "OTLP exporter enabled, endpoint: " + s.config->m_otlp.m_endpoint
+			+ ", metrics: " + (otlp->metrics_enabled() ? "true" : "false")
+			+ ", traces sampling ratio: " + std::to_string(s.config->m_otlp.m_traces_sampling_ratio) + "\n");
+	}
+#endif
+
+	if (s.config->m_recent_alerts.enabled && s.recent_alerts == nullptr)
+	{
+		s.recent_alerts = std::make_shared<falco::outputs::recent_alerts>(s.config->m_recent_alerts.max_memory);
+	}
+
 	s.outputs = std::make_shared<falco_outputs>(
 		s.engine,
 		s.config->m_outputs,
@@ -69,8 +93,22 @@ falco::app::run_result falco::app::actions::init_outputs(falco::app::state& s)
 		s.config->m_output_timeout,
 		s.config->m_buffered_outputs,
 		s.config->m_outputs_queue_capacity,
+		s.config->m_outputs_queue_priority_reserve,
+		s.config->m_outputs_queue_max_bytes,
+		s.config->m_outputs_queue_spill,
+		s.config->m_outputs_queue_drain,
+		s.config->m_outputs_queue_deferred_formatting,
+		s.config->m_outputs_aggregation,
 		s.config->m_time_format_iso_8601,
-		hostname);
+		hostname,
+		s.otlp,
+		s.recent_alerts);
+
+	// the alerts of a replay don't depend on the speed of the outputs
+	if (s.is_capture_mode())
+	{
+		s.outputs->set_lossless(s.config->m_replay.m_lossless);
+	}
 
 	return run_result::ok();
 }
@@ -53,22 +53,29 @@ falco::app::run_result falco::app::actions::load_config(const falco::app::state&
 
 	// log after config init because config determines where logs go
 	falco_logger::set_time_format_iso_8601(s.config->m_time_format_iso_8601);
-	falco_logger::log(falco_logger::level::INFO, "Falco version: " + std::string(FALCO_VERSION) + " (" + std::string(FALCO_TARGET_ARCH) + ")\n");
+	falco_logger::start_async(s.config->m_log_queue_capacity);
+	FALCO_LOG(falco_logger::level::INFO, "Falco version: " + std::string(FALCO_VERSION) + " (" + std::string(FALCO_TARGET_ARCH) + ")\n");
 	if (!s.cmdline.empty())
 	{
-		falco_logger::log(falco_logger::level::DEBUG, "CLI args: " + s.cmdline);
+		FALCO_LOG(falco_logger::level::DEBUG, "CLI args: " + s.cmdline);
 	}
 	if (!s.options.conf_filename.empty())
 	{
-		falco_logger::log(falco_logger::level::INFO, "Falco initialized with configuration files:\n");
+		FALCO_LOG(falco_logger::level::INFO, "Falco initialized with configuration files:\n");
 		for (const auto& path : loaded_conf_files)
 		{
-			falco_logger::log(falco_logger::level::INFO, std::string("   ") + path + "\n");
+			FALCO_LOG(falco_logger::level::INFO, std::string("   ") + path + "\n");
 		}
 	}
 
 	s.config->m_buffered_outputs = !s.options.unbuffered_outputs;
 
+	// the threads spawned from now on pin themselves to the CPUs of their class
+	for (int i = 0; i < falco::thread_affinity::NUM_CLASSES; i++)
+	{
+		falco::thread_affinity::set((falco::thread_affinity::thread_class) i, s.config->m_thread_affinity[i]);
+	}
+
 	return apply_deprecated_options(s);
 }
 
@@ -21,6 +21,149 @@ limitations under the License.
 using namespace falco::app;
 using namespace falco::app::actions;
 
+static std::shared_ptr<falco::idle_backoff> create_idle_backoff(const falco::app::state& s, const std::string& source)
+{
+	if (!s.config->m_idle_backoff_enabled)
+	{
+		return nullptr;
+	}
+
+	auto c = s.config->m_idle_backoff;
+	for (const auto& sc : s.config->m_idle_backoff_sources)
+	{
+		if (sc.m_source == source)
+		{
+			c = sc;
+		}
+	}
+	return std::make_shared<falco::idle_backoff>(c.m_spin_timeouts, c.m_yield_timeouts, std::chrono::microseconds(c.m_max_sleep_us));
+}
+
+static std::shared_ptr<falco::flight_recorder> create_flight_recorder(const falco::app::state& s, const std::string& source)
+{
+	const auto& c = s.config->m_flight_recorder;
+	if (!c.m_enabled || s.is_capture_mode() || (!c.m_sources.empty() && c.m_sources.count(source) == 0))
+	{
+		return nullptr;
+	}
+
+	falco::flight_recorder::config rc;
+	rc.m_max_memory = c.m_max_memory;
+	rc.m_before_ms = c.m_before_ms;
+	rc.m_after_ms = c.m_after_ms;
+	rc.m_min_priority = c.m_min_priority;
+	rc.m_tags = c.m_tags;
+	rc.m_path = c.m_path;
+	return std::make_shared<falco::flight_recorder>(source, rc);
+}
+
+static std::shared_ptr<falco::event_types> create_event_types(const falco::app::state& s)
+{
+	if (!s.config->m_metrics_enabled || !s.config->m_metrics_event_types_enabled || s.is_capture_mode())
+	{
+		return nullptr;
+	}
+
+	std::vector<std::string> names(PPM_EVENT_MAX);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		auto info = libsinsp::events::info((ppm_event_code) i);
+		if (info != nullptr && info->name != nullptr)
+		{
+			names[i] = info->name;
+		}
+	}
+	return std::make_shared<falco::event_types>(names);
+}
+
+// the number of seconds over which the trends of the kernel drops are kept
+static constexpr size_t s_drop_trends_window = 60;
+
+static std::shared_ptr<falco::load_shedder> create_load_shedder(const falco::app::state& s)
+{
+	const auto& c = s.config->m_load_shedding;
+	if (!c.m_enabled || c.m_classes.empty())
+	{
+		return nullptr;
+	}
+
+	// events that belong to more than one class are shed with the first one
+	std::vector<uint8_t> class_by_evt_type(PPM_EVENT_MAX, 0);
+	for (size_t i = 0; i < c.m_classes.size(); i++)
+	{
+		std::unordered_set<std::string> names(c.m_classes[i].begin(), c.m_classes[i].end());
+		for (const auto& name : names)
+		{
+			if (libsinsp::events::event_names_to_sc_set({name}).empty())
+			{
+				FALCO_LOG(falco_logger::level::WARNING, "Unknown event '" + name + "' in load_shedding.classes, ignoring it\n");
+			}
+		}
+		auto codes = libsinsp::events::sc_set_to_event_set(libsinsp::events::event_names_to_sc_set(names));
+		for (const auto& code : codes)
+		{
+			if (code < class_by_evt_type.size() && class_by_evt_type[code] == 0)
+			{
+				class_by_evt_type[code] = i + 1;
+			}
+		}
+	}
+	return std::make_shared<falco::load_shedder>(std::move(class_by_evt_type),
+		c.m_raise_drop_rate, c.m_lower_drop_rate, c.m_lower_after_intervals);
+}
+
+static std::shared_ptr<falco::container_budgets> create_container_budgets(const falco::app::state& s)
+{
+	const auto& c = s.config->m_container_budgets;
+	if (s.is_capture_mode() || !c.m_enabled || (c.m_max_evts_rate == 0 && c.m_max_alerts_rate == 0))
+	{
+		return nullptr;
+	}
+
+	falco::container_budgets::config bc;
+	bc.m_max_evts_rate = c.m_max_evts_rate;
+	bc.m_max_alerts_rate = c.m_max_alerts_rate;
+	bc.m_sampling_ratio = c.m_sampling_ratio;
+	bc.m_keep_priority = c.m_keep_priority;
+	bc.m_max_containers = c.m_max_containers;
+	bc.m_sampled_evt_types.assign(PPM_EVENT_MAX, false);
+	std::unordered_set<std::string> names(c.m_sampled_events.begin(), c.m_sampled_events.end());
+	for (const auto& name : names)
+	{
+		if (libsinsp::events::event_names_to_sc_set({name}).empty())
+		{
+			FALCO_LOG(falco_logger::level::WARNING, "Unknown event '" + name + "' in container_budgets.sampled_events, ignoring it\n");
+		}
+	}
+	auto codes = libsinsp::events::sc_set_to_event_set(libsinsp::events::event_names_to_sc_set(names));
+	for (const auto& code : codes)
+	{
+		if (code < bc.m_sampled_evt_types.size())
+		{
+			bc.m_sampled_evt_types[code] = true;
+		}
+	}
+	return std::make_shared<falco::container_budgets>(std::move(bc));
+}
+
+static std::shared_ptr<falco::thread_table_sizer> create_thread_table_sizer(const falco::app::state& s)
+{
+	if (s.is_capture_mode())
+	{
+		return nullptr;
+	}
+
+	const auto& c = s.config->m_falco_libs_thread_table_autosize;
+	falco::thread_table_sizer::config sc;
+	sc.m_size = s.config->m_falco_libs_thread_table_size;
+	sc.m_autosize = c.m_enabled;
+	sc.m_min_size = c.m_min_size;
+	sc.m_max_size = (uint32_t) std::min<uint64_t>(c.m_max_memory / c.m_thread_bytes, UINT32_MAX);
+	sc.m_headroom = c.m_headroom;
+	sc.m_interval = std::chrono::seconds(c.m_interval_s);
+	return std::make_shared<falco::thread_table_sizer>(sc);
+}
+
 falco::app::run_result falco::app::actions::load_plugins(falco::app::state& s)
 {
 #if defined(MUSL_OPTIMIZED) or defined(__EMSCRIPTEN__)
@@ -33,6 +176,28 @@ falco::app::run_result falco::app::actions::load_plugins(falco::app::state& s)
 	// By default, the set includes the 'syscall' event source
 	state::source_info syscall_src_info;
 	syscall_src_info.filterchecks = std::make_shared<sinsp_filter_check_list>();
+	syscall_src_info.idle_backoff = create_idle_backoff(s, falco_common::syscall_source);
+	syscall_src_info.load_shedder = create_load_shedder(s);
+	syscall_src_info.container_budgets = create_container_budgets(s);
+	syscall_src_info.event_types = create_event_types(s);
+	syscall_src_info.thread_table = create_thread_table_sizer(s);
+	if (!s.is_capture_mode())
+	{
+		syscall_src_info.fast_path = std::make_shared<falco::event_fast_path>(falco_common::syscall_source);
+	}
+	syscall_src_info.flight_recorder = create_flight_recorder(s, falco_common::syscall_source);
+	if (s.is_gvisor() && !s.is_capture_mode())
+	{
+		for (size_t i = 0; i <= s.config->m_gvisor.m_shards.size(); i++)
+		{
+			syscall_src_info.gvisor_shards.push_back(std::make_shared<falco::gvisor_sandboxes>(i, s.config->m_gvisor.m_max_sandboxes));
+		}
+	}
+	if (s.config->m_metrics_enabled && (s.config->m_metrics_flags & METRICS_V2_KERNEL_COUNTERS))
+	{
+		syscall_src_info.drop_trends = std::make_shared<falco::drop_trends>(
+			syscall_evt_drop_mgr::drop_categories(), s_drop_trends_window);
+	}
 	s.source_infos.clear();
 	s.source_infos.insert(syscall_src_info, falco_common::syscall_source);
 	s.loaded_sources = { falco_common::syscall_source };
@@ -49,7 +214,7 @@ falco::app::run_result falco::app::actions::load_plugins(falco::app::state& s)
 	// Load all the configured plugins
 	for(auto &p : s.config->m_plugins)
 	{
-		falco_logger::log(falco_logger::level::INFO, "Loading plugin '" + p.m_name + "' from file " + p.m_library_path + "\n");
+		FALCO_LOG(falco_logger::level::INFO, "Loading plugin '" + p.m_name + "' from file " + p.m_library_path + "\n");
 		auto plugin = s.offline_inspector->register_plugin(p.m_library_path);
 		s.plugin_configs.insert(p, plugin->name());
 		if(plugin->caps() & CAP_SOURCING && plugin->id() != 0)
@@ -57,6 +222,9 @@ falco::app::run_result falco::app::actions::load_plugins(falco::app::state& s)
 			state::source_info src_info;
 			src_info.filterchecks = std::make_shared<filter_check_list>();
 			auto sname = plugin->event_source();
+			src_info.idle_backoff = create_idle_backoff(s, sname);
+			src_info.event_types = create_event_types(s);
+			src_info.flight_recorder = create_flight_recorder(s, sname);
 			s.source_infos.insert(src_info, sname);
 			// note: this avoids duplicate values
 			if (std::find(s.loaded_sources.begin(), s.loaded_sources.end(), sname) == s.loaded_sources.end())
@@ -21,15 +21,105 @@ limitations under the License.
 
 #include <libsinsp/plugin_manager.h>
 
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
 #include <unordered_set>
 
 using namespace falco::app;
 using namespace falco::app::actions;
 
-falco::app::run_result falco::app::actions::load_rules_files(falco::app::state& s)
+static std::string plugins_key(const falco::app::state& s)
+{
+	std::string key;
+	for(const auto& p : s.offline_inspector->get_plugin_manager()->plugins())
+	{
+		key += "|plugin=" + p->name() + ":" + p->plugin_version().as_string();
+	}
+	return key;
+}
+
+// The rules cache can be reused only if it was written for the same rules
+// files contents and the same loaded plugins
+static std::string rules_cache_key(const falco::app::state& s)
+{
+	std::string key;
+	for(const auto& filename : s.config->m_loaded_rules_filenames)
+	{
+		key += "|file=" + filename + ":" + falco::file_sha256sums::value(s.config->m_loaded_rules_filenames_sha256sum.at(filename));
+	}
+	return key + plugins_key(s);
+}
+
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+// A rules bundle is loaded instead of the rules files, which are not read,
+// so it can be reused only if it was written for the same loaded plugins
+static std::string rules_bundle_key(const falco::app::state& s)
+{
+	return "|bundle" + plugins_key(s);
+}
+
+// A rules bundle is the rules cache of the engine, after a header with the
+// version of the format and the SHA-256 sum of the cache
+static const std::string s_rules_bundle_header = "falco-rules-bundle/1 sha256=";
+
+static void write_rules_bundle(const falco::app::state& s, const std::string& path)
+{
+	std::ostringstream cache;
+	s.engine->write_rules_cache(cache, rules_bundle_key(s));
+	std::ofstream os(path);
+	if(!os.good())
+	{
+		throw falco_exception("can't open file for writing");
+	}
+	os << s_rules_bundle_header << falco::file_sha256sums::of_contents(cache.str()).get() << "\n" << cache.str();
+	if(!os.good())
+	{
+		throw falco_exception("can't write file");
+	}
+}
+
+static bool load_rules_bundle(falco::app::state& s, const std::string& path, std::string& err)
 {
-	std::string all_rules;
+	std::ifstream is(path);
+	if(!is.good())
+	{
+		err = "can't open file";
+		return false;
+	}
+	std::string header;
+	std::getline(is, header);
+	std::string cache((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+	if(header.rfind(s_rules_bundle_header, 0) != 0)
+	{
+		err = "unsupported format";
+		return false;
+	}
+	if(header.substr(s_rules_bundle_header.size()) != falco::file_sha256sums::of_contents(cache).get())
+	{
+		err = "checksum mismatch";
+		return false;
+	}
+	std::istringstream cis(cache);
+	if(!s.engine->load_rules_cache(cis, rules_bundle_key(s)))
+	{
+		err = "compiled for other engine settings or plugin versions";
+		return false;
+	}
+	return true;
+}
+#endif
 
+// The rules loaded by the dry run validating a restart, handed over to the
+// restarted app as a rules cache kept in memory, so that the rules files are
+// not parsed and expanded twice for the same change
+static std::mutex s_validated_rules_mtx;
+static std::string s_validated_rules_key;
+static std::string s_validated_rules;
+
+static falco::app::run_result load_rules_from_files(falco::app::state& s)
+{
 	if (!s.options.rules_filenames.empty())
 	{
 		s.config->m_rules_filenames = s.options.rules_filenames;
@@ -40,10 +130,10 @@ falco::app::run_result falco::app::actions::load_rules_files(falco::app::state&
 		return run_result::fatal("You must specify at least one rules file/directory via -r or a rules_file entry in falco.yaml");
 	}
 
-	falco_logger::log(falco_logger::level::DEBUG, "Configured rules filenames:\n");
+	FALCO_LOG(falco_logger::level::DEBUG, "Configured rules filenames:\n");
 	for (const auto& path : s.config->m_rules_filenames)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, std::string("   ") + path + "\n");
+		FALCO_LOG(falco_logger::level::DEBUG, std::string("   ") + path + "\n");
 	}
 
 	for (const auto &path : s.config->m_rules_filenames)
@@ -65,10 +155,73 @@ falco::app::run_result falco::app::actions::load_rules_files(falco::app::state&
 		return run_result::fatal(e.what());
 	}
 
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	// note: the files are hashed from the contents just read, which are
+	// the ones loaded, instead of being read again
+	auto content = rules_contents.begin();
+	for(const auto &filename : s.config->m_loaded_rules_filenames)
+	{
+		s.config->m_loaded_rules_filenames_sha256sum.insert({filename, falco::file_sha256sums::of_contents(*content++)});
+	}
+
+	// the rules restored from the cache can't be described, as
+	// their original definitions are not read
+	bool describe = s.options.describe_all_rules || !s.options.describe_rule.empty();
+	// the bundles are compiled from the rules files only
+	bool compile = !s.options.compile_rules_filename.empty();
+	bool use_cache = s.config->m_rules_cache_enabled && !describe && !compile;
+	bool use_validated = !describe && !compile;
+#else
+	bool use_cache = false;
+	bool use_validated = false;
+#endif
+
+	bool cache_hit = false;
+	std::string cache_key;
+	if(use_cache || use_validated)
+	{
+		cache_key = rules_cache_key(s);
+	}
+
+	if(use_validated && !s.options.dry_run)
+	{
+		std::string validated;
+		{
+			std::lock_guard<std::mutex> lk(s_validated_rules_mtx);
+			if(s_validated_rules_key == cache_key)
+			{
+				validated = std::move(s_validated_rules);
+			}
+			s_validated_rules_key.clear();
+			s_validated_rules.clear();
+		}
+		std::istringstream is(validated);
+		if(!validated.empty() && s.engine->load_rules_cache(is, cache_key))
+		{
+			FALCO_LOG(falco_logger::level::INFO, "Loaded the rules validated before restarting\n");
+			cache_hit = true;
+		}
+	}
+
+	if(use_cache && !cache_hit)
+	{
+		std::ifstream is(s.config->m_rules_cache_path);
+		if(is.good() && s.engine->load_rules_cache(is, cache_key))
+		{
+			FALCO_LOG(falco_logger::level::INFO, "Loaded rules from cache " + s.config->m_rules_cache_path + "\n");
+			cache_hit = true;
+		}
+	}
+
 	std::string err = "";
 	for(auto &filename : s.config->m_loaded_rules_filenames)
 	{
-		falco_logger::log(falco_logger::level::INFO, "Loading rules from file " + filename + "\n");
+		if(cache_hit)
+		{
+			break;
+		}
+
+		FALCO_LOG(falco_logger::level::INFO, "Loading rules from file " + filename + "\n");
 		std::unique_ptr<falco::load_result> res;
 
 		res = s.engine->load_rules(rc.at(filename), filename);
@@ -82,11 +235,8 @@ falco::app::run_result falco::app::actions::load_rules_files(falco::app::state&
 
 		if(res->has_warnings())
 		{
-			falco_logger::log(falco_logger::level::WARNING,res->as_string(true, rc) + "\n");
+			FALCO_LOG(falco_logger::level::WARNING,res->as_string(true, rc) + "\n");
 		}
-#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
-		s.config->m_loaded_rules_filenames_sha256sum.insert({filename, falco::utils::calculate_file_sha256sum(filename)});
-#endif
 	}
 
 	// note: we have an egg-and-chicken problem here. We would like to check
@@ -131,37 +281,194 @@ falco::app::run_result falco::app::actions::load_rules_files(falco::app::state&
 		return run_result::fatal(err);
 	}
 
+	if(use_validated && s.validating_restart)
+	{
+		// failing to hand the rules over only makes the restart slower
+		std::ostringstream os;
+		try
+		{
+			s.engine->write_rules_cache(os, cache_key);
+			std::lock_guard<std::mutex> lk(s_validated_rules_mtx);
+			s_validated_rules_key = cache_key;
+			s_validated_rules = os.str();
+		}
+		catch(const std::exception& e)
+		{
+			FALCO_LOG(falco_logger::level::DEBUG, "Can't hand the validated rules over to the restart: " + std::string(e.what()) + "\n");
+		}
+	}
+
+	if(use_cache && !cache_hit)
+	{
+		// failing to write the cache only makes the next startup slower
+		std::ofstream os(s.config->m_rules_cache_path);
+		try
+		{
+			if(!os.good())
+			{
+				throw falco_exception("can't open file for writing");
+			}
+			s.engine->write_rules_cache(os, cache_key);
+		}
+		catch(const std::exception& e)
+		{
+			FALCO_LOG(falco_logger::level::WARNING, "Can't write rules cache " + s.config->m_rules_cache_path + ": " + e.what() + "\n");
+		}
+	}
+
+	return run_result::ok();
+}
+
+falco::app::run_result falco::app::actions::load_rules_files(falco::app::state& s)
+{
+	// a rules bundle replaces the rules files, which are loaded instead
+	// if it can't be loaded, e.g. as it comes from another Falco version
+	bool bundle_hit = false;
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	bool describe = s.options.describe_all_rules || !s.options.describe_rule.empty();
+	const auto& bundle_path = s.config->m_rules_bundle_path;
+	if(!bundle_path.empty() && !describe && s.options.compile_rules_filename.empty())
+	{
+		std::string err;
+		bundle_hit = load_rules_bundle(s, bundle_path, err);
+		if(bundle_hit)
+		{
+			FALCO_LOG(falco_logger::level::INFO, "Loaded rules from bundle " + bundle_path + "\n");
+		}
+		else
+		{
+			FALCO_LOG(falco_logger::level::WARNING, "Can't load rules bundle " + bundle_path + " (" + err + "), loading the rules files instead\n");
+		}
+	}
+#endif
+
+	if(bundle_hit)
+	{
+		std::string err;
+		if (!check_rules_plugin_requirements(s, err))
+		{
+			return run_result::fatal(err);
+		}
+	}
+	else
+	{
+		auto res = load_rules_from_files(s);
+		if(!res.proceed)
+		{
+			return res;
+		}
+	}
+
+	// printout of `--compile-rules` option, before the rules are
+	// selected, as the bundle is meant to be loaded with any selection
+	if (!s.options.compile_rules_filename.empty())
+	{
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+		try
+		{
+			write_rules_bundle(s, s.options.compile_rules_filename);
+		}
+		catch(const std::exception& e)
+		{
+			return run_result::fatal("Can't write rules bundle " + s.options.compile_rules_filename + ": " + e.what());
+		}
+		FALCO_LOG(falco_logger::level::INFO, "Rules bundle written to " + s.options.compile_rules_filename + "\n");
+		return run_result::exit();
+#else
+		return run_result::fatal("Compiling rules bundles is not supported by this Falco build");
+#endif
+	}
+
 	if((!s.options.disabled_rule_substrings.empty() || !s.options.disabled_rule_tags.empty() || !s.options.enabled_rule_tags.empty()) &&
 		!s.config->m_rules_selection.empty())
 	{
 		return run_result::fatal("Specifying -D, -t, -T command line options together with \"rules:\" configuration or -o \"rules...\" is not supported.");
 	}
 
+	apply_rules_selection(s, *s.engine, true);
+
+	// printout of `-L` option
+	if (s.options.describe_all_rules || !s.options.describe_rule.empty())
+	{
+		std::string* rptr = !s.options.describe_rule.empty() ? &(s.options.describe_rule) : nullptr;
+		const auto& plugins = s.offline_inspector->get_plugin_manager()->plugins();
+		if (!s.config->m_json_output)
+		{
+			format_described_rules_as_text(s.engine->describe_rule(rptr, plugins), std::cout);
+		}
+		else
+		{
+			// streamed, as the whole description of large rulesets
+			// takes a lot of memory
+			s.engine->describe_rule(std::cout, rptr, plugins);
+			std::cout << std::endl;
+		}
+
+		return run_result::exit();
+	}
+
+	// printout of `--rules-memory-report` option, reflecting the
+	// state held by the engine once done loading rules
+	if (s.options.print_rules_memory_report)
+	{
+		s.engine->complete_rule_loading();
+		if (s.config->m_rules_release_loading_state)
+		{
+			s.engine->release_rule_loading_state();
+		}
+
+		auto out = s.engine->rules_memory_report();
+		if (!s.config->m_json_output)
+		{
+			format_rules_memory_report_as_text(out, std::cout);
+		}
+		else
+		{
+			std::cout << out.dump() << std::endl;
+		}
+
+		return run_result::exit();
+	}
+
+	return run_result::ok();
+}
+
+void falco::app::actions::apply_rules_selection(const falco::app::state& s, falco_engine& engine, bool log)
+{
 	for (const auto& substring : s.options.disabled_rule_substrings)
 	{
-		falco_logger::log(falco_logger::level::INFO, "Disabling rules matching substring: " + substring + "\n");
-		s.engine->enable_rule(substring, false);
+		if (log)
+		{
+			FALCO_LOG(falco_logger::level::INFO, "Disabling rules matching substring: " + substring + "\n");
+		}
+		engine.enable_rule(substring, false);
 	}
 
 	if(!s.options.disabled_rule_tags.empty())
 	{
 		for(const auto &tag : s.options.disabled_rule_tags)
 		{
-			falco_logger::log(falco_logger::level::INFO, "Disabling rules with tag: " + tag + "\n");
+			if (log)
+			{
+				FALCO_LOG(falco_logger::level::INFO, "Disabling rules with tag: " + tag + "\n");
+			}
 		}
-		s.engine->enable_rule_by_tag(s.options.disabled_rule_tags, false);
+		engine.enable_rule_by_tag(s.options.disabled_rule_tags, false);
 	}
 
 	if(!s.options.enabled_rule_tags.empty())
 	{
 		// Since we only want to enable specific
 		// rules, first disable all rules.
-		s.engine->enable_rule(all_rules, false);
+		engine.enable_rule("", false);
 		for(const auto &tag : s.options.enabled_rule_tags)
 		{
-			falco_logger::log(falco_logger::level::INFO, "Enabling rules with tag: " + tag + "\n");
+			if (log)
+			{
+				FALCO_LOG(falco_logger::level::INFO, "Enabling rules with tag: " + tag + "\n");
+			}
 		}
-		s.engine->enable_rule_by_tag(s.options.enabled_rule_tags, true);
+		engine.enable_rule_by_tag(s.options.enabled_rule_tags, true);
 	}
 
 	for(const auto& sel : s.config->m_rules_selection)
@@ -170,39 +477,67 @@ falco::app::run_result falco::app::actions::load_rules_files(falco::app::state&
 
 		if(sel.m_rule != "")
 		{
-			falco_logger::log(falco_logger::level::INFO,
-				(enable ? "Enabling" : "Disabling") + std::string(" rules with name: ") + sel.m_rule + "\n");
+			if (log)
+			{
+				FALCO_LOG(falco_logger::level::INFO,
+					(enable ? "Enabling" : "Disabling") + std::string(" rules with name: ") + sel.m_rule + "\n");
+			}
 
-			s.engine->enable_rule_wildcard(sel.m_rule, enable);
+			engine.enable_rule_wildcard(sel.m_rule, enable);
 		}
 
 		if(sel.m_tag != "")
 		{
-			falco_logger::log(falco_logger::level::INFO,
-				(enable ? "Enabling" : "Disabling") + std::string(" rules with tag: ") + sel.m_tag + "\n");
+			if (log)
+			{
+				FALCO_LOG(falco_logger::level::INFO,
+					(enable ? "Enabling" : "Disabling") + std::string(" rules with tag: ") + sel.m_tag + "\n");
+			}
 
-			s.engine->enable_rule_by_tag(std::set<std::string>{sel.m_tag}, enable); // TODO wildcard support
+			engine.enable_rule_by_tag(std::set<std::string>{sel.m_tag}, enable); // TODO wildcard support
 		}
 	}
+}
 
-	// printout of `-L` option
-	if (s.options.describe_all_rules || !s.options.describe_rule.empty())
+bool falco::app::actions::is_rule_selected(const falco::app::state& s, const std::string& name,
+		const std::set<std::string>& tags, bool enabled)
+{
+	// this follows the steps of apply_rules_selection
+	auto has_any_tag = [&tags](const std::set<std::string>& selected)
 	{
-		std::string* rptr = !s.options.describe_rule.empty() ? &(s.options.describe_rule) : nullptr;
-		const auto& plugins = s.offline_inspector->get_plugin_manager()->plugins();
-		auto out = s.engine->describe_rule(rptr, plugins);
+		return std::any_of(selected.begin(), selected.end(),
+			[&tags](const std::string& t) { return tags.count(t) > 0; });
+	};
 
-		if (!s.config->m_json_output)
-		{
-			format_described_rules_as_text(out, std::cout);
-		}
-		else
+	for (const auto& substring : s.options.disabled_rule_substrings)
+	{
+		if(name.find(substring) != std::string::npos)
 		{
-			std::cout << out.dump() << std::endl;
+			enabled = false;
 		}
+	}
 
-		return run_result::exit();
+	if(has_any_tag(s.options.disabled_rule_tags))
+	{
+		enabled = false;
 	}
 
-	return run_result::ok();
+	if(!s.options.enabled_rule_tags.empty())
+	{
+		enabled = has_any_tag(s.options.enabled_rule_tags);
+	}
+
+	for(const auto& sel : s.config->m_rules_selection)
+	{
+		bool enable = sel.m_op == falco_configuration::rule_selection_operation::enable;
+		if(sel.m_rule != "" && falco::utils::matches_wildcard(sel.m_rule, name))
+		{
+			enabled = enable;
+		}
+		if(sel.m_tag != "" && tags.count(sel.m_tag) > 0)
+		{
+			enabled = enable;
+		}
+	}
+	return enabled;
 }
@@ -28,7 +28,7 @@ falco::app::run_result falco::app::actions::pidfile(const falco::app::state& sta
 {
 	if (state.options.dry_run)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, "Skipping pidfile creation in dry-run\n");
+		FALCO_LOG(falco_logger::level::DEBUG, "Skipping pidfile creation in dry-run\n");
 		return run_result::ok();
 	}
 
@@ -41,7 +41,7 @@ falco::app::run_result falco::app::actions::pidfile(const falco::app::state& sta
 
 		if (!stream.good())
 		{
-			falco_logger::log(falco_logger::level::ERR, "Could not write pid to pidfile " + state.options.pidfilename + ". Exiting.\n");
+			FALCO_LOG(falco_logger::level::ERR, "Could not write pid to pidfile " + state.options.pidfilename + ". Exiting.\n");
 			exit(-1);
 		}
 		stream << self_pid;
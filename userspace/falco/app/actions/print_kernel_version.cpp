@@ -35,14 +35,14 @@ falco::app::run_result falco::app::actions::print_kernel_version(const falco::ap
 		if(!input_file.is_open())
 		{
 			// We don't want to fail, we just need to log something
-			falco_logger::log(falco_logger::level::INFO, "Cannot read under '/proc/version' (err_message: '" + std::string(strerror(errno)) + "', err_code: " + std::to_string(errno) + "). No info provided, go on.");
+			FALCO_LOG(falco_logger::level::INFO, "Cannot read under '/proc/version' (err_message: '" + std::string(strerror(errno)) + "', err_code: " + std::to_string(errno) + "). No info provided, go on.");
 			return run_result::ok();
 		}
 
 		std::stringstream buffer;
 		buffer << input_file.rdbuf();
 		std::string contents(buffer.str());
-		falco_logger::log(falco_logger::level::INFO, "System info: " + contents);
+		FALCO_LOG(falco_logger::level::INFO, "System info: " + contents);
 	}
 #endif
 	return run_result::ok();
@@ -42,7 +42,7 @@ falco::app::run_result falco::app::actions::print_page_size(const falco::app::st
 		}
 		else
 		{
-			falco_logger::log(falco_logger::level::INFO, "Your system page size is: " + std::to_string(page_size) + " bytes\n");
+			FALCO_LOG(falco_logger::level::INFO, "Your system page size is: " + std::to_string(page_size) + " bytes\n");
 		}
 		return run_result::exit();
 	}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "actions.h"
+#include "helpers.h"
+#include "../app.h"
+
+#include <algorithm>
+
+using namespace falco::app;
+using namespace falco::app::actions;
+
+static nlohmann::json sc_set_to_json(const libsinsp::events::set<ppm_sc_code>& sc_set)
+{
+	auto names = libsinsp::events::sc_set_to_event_names(sc_set);
+	return std::set<std::string>(names.begin(), names.end());
+}
+
+falco::app::run_result falco::app::actions::print_syscall_cost_report(falco::app::state& s)
+{
+	if(!s.options.print_syscall_cost_report)
+	{
+		return run_result::ok();
+	}
+
+	// the syscalls that would be selected without any rule are needed by
+	// the state engine anyway, so no rule is accountable for them
+	auto rules_sc = s.engine->sc_codes_by_rule_for_ruleset(falco_common::syscall_source);
+	auto base_sc_set = select_sc_set(s, {}).intersect(s.selected_sc_set);
+
+	std::map<ppm_sc_code, std::vector<std::string>> rules_by_sc;
+	for(const auto& r : rules_sc)
+	{
+		for(const auto& sc : r.second.intersect(s.selected_sc_set))
+		{
+			rules_by_sc[sc].push_back(r.first);
+		}
+	}
+
+	std::vector<nlohmann::json> rules;
+	for(const auto& r : rules_sc)
+	{
+		auto sc_set = r.second.intersect(s.selected_sc_set);
+		libsinsp::events::set<ppm_sc_code> exclusive_sc_set;
+		for(const auto& sc : sc_set)
+		{
+			if(rules_by_sc[sc].size() == 1 && !base_sc_set.contains(sc))
+			{
+				exclusive_sc_set.insert(sc);
+			}
+		}
+		nlohmann::json rule;
+		rule["name"] = r.first;
+		rule["syscalls"] = sc_set_to_json(sc_set);
+		rule["exclusive_syscalls"] = sc_set_to_json(exclusive_sc_set);
+		rule["not_selected_syscalls"] = sc_set_to_json(r.second.diff(s.selected_sc_set));
+		rules.emplace_back(std::move(rule));
+	}
+
+	// the rules pulling in the most syscalls nothing else needs come first
+	std::stable_sort(rules.begin(), rules.end(), [](const nlohmann::json& a, const nlohmann::json& b)
+	{
+		if(a["exclusive_syscalls"].size() != b["exclusive_syscalls"].size())
+		{
+			return a["exclusive_syscalls"].size() > b["exclusive_syscalls"].size();
+		}
+		return a["syscalls"].size() > b["syscalls"].size();
+	});
+
+	nlohmann::json syscalls = nlohmann::json::object();
+	libsinsp::events::set<ppm_sc_code> state_sc_set;
+	for(const auto& sc : s.selected_sc_set)
+	{
+		auto it = rules_by_sc.find(sc);
+		if(it == rules_by_sc.end())
+		{
+			state_sc_set.insert(sc);
+		}
+		for(const auto& name : libsinsp::events::sc_set_to_event_names({sc}))
+		{
+			syscalls[name] = it != rules_by_sc.end() ? it->second : std::vector<std::string>{};
+		}
+	}
+
+	nlohmann::json out;
+	out["selected_syscalls"] = s.selected_sc_set.size();
+	out["state_only_syscalls"] = sc_set_to_json(state_sc_set);
+	out["rules"] = rules;
+	out["syscalls"] = std::move(syscalls);
+	if(!s.config->m_json_output)
+	{
+		format_syscall_cost_report_as_text(out, std::cout);
+	}
+	else
+	{
+		std::cout << out.dump() << std::endl;
+	}
+
+	return run_result::exit();
+}
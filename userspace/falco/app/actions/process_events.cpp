@@ -21,7 +21,14 @@ limitations under the License.
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <unordered_map>
 
 #include "falco_utils.h"
@@ -33,13 +40,46 @@ limitations under the License.
 #include "../../falco_semaphore.h"
 #include "../../stats_writer.h"
 #include "../../falco_outputs.h"
+#include "../../event_batch.h"
 #include "../../event_drops.h"
+#include "../../thread_affinity.h"
+#include "../../source_monitor.h"
 
 #include <libsinsp/plugin_manager.h>
+#include <libsinsp/dumper.h>
 
 using namespace falco::app;
 using namespace falco::app::actions;
 
+// Writes the events of the flight recorder of a source to a capture file,
+// which is opened on the thread of the source because the dumper writes
+// the state of the inspector in it first. The events are then written by
+// the thread of the recorder, which only needs their raw data.
+class flight_recorder_sink : public falco::flight_recorder::sink
+{
+public:
+	flight_recorder_sink(const std::shared_ptr<sinsp>& inspector, const std::string& path)
+		: m_evt(inspector.get())
+	{
+		m_dumper.open(inspector.get(), path, true);
+	}
+
+	~flight_recorder_sink() override
+	{
+		m_dumper.close();
+	}
+
+	void write(const uint8_t* evt, uint32_t, uint16_t cpuid) override
+	{
+		m_evt.init(const_cast<uint8_t*>(evt), cpuid);
+		m_dumper.dump(&m_evt);
+	}
+
+private:
+	sinsp_evt m_evt;
+	sinsp_dumper m_dumper;
+};
+
 class source_sync_context
 {
 public:
@@ -108,6 +148,251 @@ struct live_context
 	std::unique_ptr<source_sync_context> sync;
 };
 
+// Periodically recomputes the adaptive ordering of the rules in a
+// background thread, so that no event processing thread pays for it
+class rule_ordering_updater
+{
+public:
+	rule_ordering_updater(std::shared_ptr<falco_engine> engine, uint64_t interval_ms)
+		: m_stop(false), m_engine(engine)
+	{
+		m_thread = std::thread([this, interval_ms]()
+		{
+			falco::thread_affinity::apply(falco::thread_affinity::STATS);
+			std::unique_lock<std::mutex> lock(m_mtx);
+			while (!m_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this](){ return m_stop; }))
+			{
+				m_engine->update_rule_ordering();
+			}
+		});
+	}
+
+	~rule_ordering_updater()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_one();
+		m_thread.join();
+	}
+
+private:
+	bool m_stop;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::thread m_thread;
+	std::shared_ptr<falco_engine> m_engine;
+};
+
+// The signals and the stats ticker are only checked once every this many
+// events, or when the inspector returns no event, to keep the fixed
+// per-event costs of the processing loop low
+static constexpr uint32_t s_periodic_checks_interval = 64;
+
+// The state of the event processing loop of a source that is kept across
+// the calls to do_inspect, which is invoked once per slice of events when
+// the source shares its threads with other ones
+struct inspect_context
+{
+	explicit inspect_context(const std::shared_ptr<stats_writer>& statsw)
+		: stats_collector(statsw) { }
+
+	// set once the capture has been started
+	bool started = false;
+	// set when do_inspect returns before the end of the capture
+	bool yielded = false;
+	// how long to wait before resuming the loop, when the source was idle
+	std::chrono::microseconds idle_delay{0};
+	stats_writer::collector stats_collector;
+	uint64_t duration_start = 0;
+	uint32_t evts_since_periodic_checks = 0;
+	// reused across events to avoid allocating on every rule match
+	std::vector<falco_engine::rule_match> rule_matches;
+	// the alerts of the rules matched so far, and the stages timed in
+	// capture mode, for the replay report
+	uint64_t num_alerts = 0;
+	falco::event_stages replay_stages;
+	// the events of a plugin source waiting to be evaluated together,
+	// kept across the slices to reuse their buffers
+	std::unique_ptr<falco::event_batch> batch;
+	// extracts the container of the threads for the container budgets
+	// and the gVisor sandboxes, created with the first event needing it
+	std::unique_ptr<sinsp_filter_check> container_id_check;
+	bool container_id_check_created = false;
+	std::vector<extract_value_t> container_id_values;
+	// reused across windows for the summaries of the aggregated alerts
+	std::vector<falco::container_budgets::summary> container_summaries;
+};
+
+// The syscalls that the throttle drop action can stop collecting, i.e. the
+// configured ones that are collected and aren't needed to keep the state
+static libsinsp::events::set<ppm_sc_code> get_throttle_sc_set(const falco::app::state& s)
+{
+	const auto& names = s.config->m_syscall_evt_drop_throttle.m_syscalls;
+	auto sc_set = libsinsp::events::event_names_to_sc_set(std::unordered_set<std::string>(names.begin(), names.end()))
+		.intersect(s.selected_sc_set);
+	auto state_sc_set = sc_set.intersect(libsinsp::events::sinsp_state_sc_set());
+	if (!state_sc_set.empty())
+	{
+		FALCO_LOG(falco_logger::level::WARNING, "These syscalls are needed to keep the state and will never be throttled: "
+			+ concat_set_in_order(libsinsp::events::sc_set_to_event_names(state_sc_set)) + "\n");
+	}
+	return sc_set.diff(libsinsp::events::sinsp_state_sc_set());
+}
+
+// Emits one message for the alerts that each throttled container had
+// aggregated in the windows that ended
+static void emit_container_summaries(falco::app::state& s, falco::container_budgets& budgets, std::vector<falco::container_budgets::summary>& summaries)
+{
+	summaries.clear();
+	budgets.take_summaries(summaries);
+	std::string rule = "Falco internal: container alerts aggregated";
+	for (const auto& sum : summaries)
+	{
+		std::string msg = rule + ". Container " + sum.container_id + " exceeded its alert budget, "
+			+ std::to_string(sum.count) + " alerts were aggregated.";
+		nlohmann::json fields;
+		fields["container.id"] = sum.container_id;
+		fields["count"] = sum.count;
+		fields["first_ts"] = sum.first_ts;
+		fields["last_ts"] = sum.last_ts;
+		fields["rules"] = sum.rules;
+		s.outputs->handle_msg(sum.last_ts, sum.priority, msg, rule, fields);
+	}
+}
+
+// Returns the id of the container of the event, through a filtercheck of
+// the source, or an empty string if there is none
+static std::string extract_container_id(falco::app::state& s, inspect_context& ctx, size_t source_engine_idx, sinsp_evt* ev)
+{
+	if (!ctx.container_id_check_created)
+	{
+		ctx.container_id_check_created = true;
+		auto chk = s.engine->filter_factory_for_source(source_engine_idx)->new_filtercheck("container.id");
+		if (chk == nullptr || chk->parse_field_name("container.id", true, false) <= 0)
+		{
+			FALCO_LOG(falco_logger::level::WARNING, "The container.id field is not available, the events can't be attributed to their containers\n");
+			return "";
+		}
+		ctx.container_id_check = std::move(chk);
+	}
+	if (ctx.container_id_check == nullptr
+		|| !ctx.container_id_check->extract(ev, ctx.container_id_values, false)
+		|| ctx.container_id_values.empty())
+	{
+		return "";
+	}
+	return std::string((const char*) ctx.container_id_values[0].ptr);
+}
+
+// Measures the thread table of the inspector and resizes it if needed,
+// which must happen in the thread of the inspector
+static void update_thread_table(const std::shared_ptr<sinsp>& inspector, falco::thread_table_sizer& thread_table)
+{
+	falco::thread_table_sizer::counters c;
+	c.threads = inspector->m_thread_manager->get_thread_count();
+	// note: the counters are only kept if the inspector has its metrics enabled
+	auto stats = inspector->get_sinsp_stats_v2();
+	if (stats != nullptr)
+	{
+		c.full_drops = stats->m_n_drops_full_threadtable;
+		c.failed_lookups = stats->m_n_failed_thread_lookups;
+		c.removed = stats->m_n_removed_threads;
+	}
+	uint32_t size = thread_table.update(std::chrono::steady_clock::now(), c);
+	if (size > 0)
+	{
+		FALCO_LOG(falco_logger::level::INFO, "Resizing the thread table to " + std::to_string(size)
+			+ " threads, with " + std::to_string(c.threads) + " threads in it\n");
+		inspector->m_thread_manager->set_max_thread_table_size(size);
+	}
+}
+
+// Applies the set of syscalls and the kernel prefilter recomputed after
+// the enabled rules changed, which must happen in the thread of the inspector
+static void apply_pending_rules_change(falco::app::state& s, const std::shared_ptr<sinsp>& inspector, syscall_evt_drop_mgr& sdropmgr)
+{
+	// a hot reload can also change the thread table size, which keeps the
+	// threads already in the table instead of scanning /proc again
+	auto thread_table = s.source_infos.at(falco_common::syscall_source)->thread_table;
+	uint32_t thread_table_size = thread_table != nullptr
+		? thread_table->start(falco::thread_table_sizer::host_threads())
+		: s.config->m_falco_libs_thread_table_size;
+	if (thread_table_size > 0)
+	{
+		inspector->m_thread_manager->set_max_thread_table_size(thread_table_size);
+	}
+
+	libsinsp::events::set<ppm_sc_code> sc_set;
+	bool drop_failed = false;
+	{
+		std::lock_guard<std::mutex> lk(s.pending_sc_set_mtx);
+		sc_set = std::move(s.pending_sc_set);
+		s.pending_sc_set = {};
+		drop_failed = s.pending_kernel_drop_failed;
+		s.pending_sc_set_ready = false;
+	}
+
+	if (s.kernel_prefilter_enabled && drop_failed != s.kernel_prefilter_drop_failed)
+	{
+		try
+		{
+			inspector->set_dropfailed(drop_failed);
+			s.kernel_prefilter_drop_failed = drop_failed;
+			FALCO_LOG(falco_logger::level::INFO, std::string("Enabled rules changed, failed syscall exit events are ")
+				+ (drop_failed ? "now" : "no longer") + " dropped in the kernel driver\n");
+		}
+		catch (const std::exception& e)
+		{
+			FALCO_LOG(falco_logger::level::ERR, "Could not change the kernel prefilter after the enabled rules changed: " + std::string(e.what()) + "\n");
+		}
+	}
+
+	if (!s.config->m_base_syscalls_live_update)
+	{
+		return;
+	}
+
+	// the throttled syscalls are collected again before changing the
+	// set, and the throttle then only covers the ones still collected
+	bool throttle = s.config->m_syscall_evt_drop_actions.count(syscall_evt_drop_action::THROTTLE) > 0;
+	if (throttle)
+	{
+		sdropmgr.set_throttle({}, 0, 0);
+	}
+
+	auto added_sc_set = sc_set.diff(s.selected_sc_set);
+	auto removed_sc_set = s.selected_sc_set.diff(sc_set);
+	try
+	{
+		for (const auto& sc : added_sc_set)
+		{
+			inspector->mark_ppm_sc_of_interest(sc, true);
+		}
+		for (const auto& sc : removed_sc_set)
+		{
+			inspector->mark_ppm_sc_of_interest(sc, false);
+		}
+		s.selected_sc_set = sc_set;
+		FALCO_LOG(falco_logger::level::INFO, "Enabled rules changed, collecting "
+			+ std::to_string(added_sc_set.size()) + " more and "
+			+ std::to_string(removed_sc_set.size()) + " fewer syscalls, "
+			+ std::to_string(s.selected_sc_set.size()) + " in total\n");
+	}
+	catch (const std::exception& e)
+	{
+		FALCO_LOG(falco_logger::level::ERR, "Could not change the collected syscalls after the enabled rules changed: " + std::string(e.what()) + "\n");
+	}
+
+	if (throttle)
+	{
+		sdropmgr.set_throttle(get_throttle_sc_set(s),
+				s.config->m_syscall_evt_drop_throttle.m_after_intervals,
+				s.config->m_syscall_evt_drop_throttle.m_restore_after_intervals);
+	}
+}
+
 //
 // Event processing loop
 //
@@ -115,19 +400,59 @@ static falco::app::run_result do_inspect(
 		falco::app::state& s,
 		std::shared_ptr<sinsp> inspector,
 		const std::string& source, // an empty source represents capture mode
-		std::shared_ptr<stats_writer> statsw,
+		inspect_context& ctx,
 		syscall_evt_drop_mgr &sdropmgr,
 		bool check_drops_and_timeouts,
 		uint64_t duration_to_tot_ns,
-		uint64_t &num_evts)
+		uint64_t &num_evts,
+		uint64_t max_evts = 0)
 {
 	int32_t rc = 0;
 	sinsp_evt* ev = NULL;
-	stats_writer::collector stats_collector(statsw);
-	uint64_t duration_start = 0;
-	uint32_t timeouts_since_last_success_or_msg = 0;
 	const bool is_capture_mode = source.empty();
 	size_t source_engine_idx = 0;
+	// the engine source of source_engine_idx, resolved once per source
+	falco_engine::source_handle source_handle;
+	size_t source_handle_idx = SIZE_MAX;
+	uint64_t slice_evts = 0;
+	// when set, a sample of the events is timed in each stage
+	falco::event_stages* stages = nullptr;
+	// when set, the loop waits after the source had no event to return
+	falco::idle_backoff* backoff = nullptr;
+	// when set, some events skip the rules while the kernel drops events
+	falco::load_shedder* shedder = nullptr;
+	// when set, a larger syscall buffer is recommended on drops
+	falco::buffer_autosizer* autosizer = nullptr;
+	// when set, the recent kernel drops of each category are kept
+	falco::drop_trends* trends = nullptr;
+	// when set, the events are attributed to the rules needing them
+	falco::syscall_cost* cost = nullptr;
+	// when set, the events and their time in the engine are broken down
+	// by event type
+	falco::event_types* types = nullptr;
+	// when set, the progress of the loop is published for the source monitor
+	falco::source_monitor::heartbeat* heartbeat = nullptr;
+	// when set, the next processed event is reported for the readiness
+	falco::startup_report* startup = nullptr;
+	// when set, the recent events are kept and dumped around some alerts
+	falco::flight_recorder* recorder = nullptr;
+	// when set, the events no enabled rule needs skip the rules
+	falco::event_fast_path* fast_path = nullptr;
+	// when set, the thread table is measured and possibly resized
+	falco::thread_table_sizer* thread_table = nullptr;
+	// when set, the events and alerts of noisy containers are throttled
+	falco::container_budgets* budgets = nullptr;
+	falco::container_budgets::entry* budget_container = nullptr;
+	// when set, the events of each gVisor sandbox are counted, in the
+	// first of the shards
+	const std::vector<std::shared_ptr<falco::gvisor_sandboxes>>* shards = nullptr;
+	falco::gvisor_sandboxes* sandboxes = nullptr;
+	bool timed = false;
+	falco::event_stages::durations stage_times{};
+	std::chrono::steady_clock::time_point stage_start;
+	bool type_timed = false;
+	std::chrono::steady_clock::time_point type_start;
+	bool periodic_checks = false;
 
 	// note(jasondellaluce): The "syscall" event source will always be loaded
 	// by default in an inspector, and at index 0. As such, in live mode we would
@@ -136,44 +461,197 @@ static falco::app::run_result do_inspect(
 	// the only other source loaded in its relative live inspector.
 	size_t expected_live_evt_src_idx = source == falco_common::syscall_source ? 0 : 1;
 
+	if (is_capture_mode && s.config->m_replay.m_report)
+	{
+		stages = &ctx.replay_stages;
+	}
 	if (!is_capture_mode)
 	{
 		// note: in live mode, each inspector gets assigned a distinct event
 		// source that does not change for the whole capture.
 		source_engine_idx = s.source_infos.at(source)->engine_idx;
+		if (s.config->m_metrics_event_stages_enabled)
+		{
+			stages = s.source_infos.at(source)->stages.get();
+		}
+		backoff = s.source_infos.at(source)->idle_backoff.get();
+		types = s.source_infos.at(source)->event_types.get();
+		heartbeat = s.source_infos.at(source)->heartbeat.get();
+		recorder = s.source_infos.at(source)->flight_recorder.get();
+		fast_path = s.source_infos.at(source)->fast_path.get();
+		thread_table = s.source_infos.at(source)->thread_table.get();
+		budgets = s.source_infos.at(source)->container_budgets.get();
+		if (!s.source_infos.at(source)->gvisor_shards.empty())
+		{
+			shards = &s.source_infos.at(source)->gvisor_shards;
+			sandboxes = shards->front().get();
+		}
+		if (!s.startup->ready())
+		{
+			startup = s.startup.get();
+		}
+		if (check_drops_and_timeouts)
+		{
+			shedder = s.source_infos.at(source)->load_shedder.get();
+			autosizer = s.source_infos.at(source)->buffer_autosizer.get();
+			trends = s.source_infos.at(source)->drop_trends.get();
+			cost = s.source_infos.at(source)->syscall_cost.get();
+		}
 	}
 
-	// reset event counter
-	num_evts = 0;
-
-	// init drop manager if we are inspecting syscalls
-	if (check_drops_and_timeouts)
+	ctx.yielded = false;
+	ctx.idle_delay = std::chrono::microseconds(0);
+	// note: sources may share threads, so this is set at each resume
+	if (s.profiler != nullptr)
 	{
-		sdropmgr.init(inspector,
-				s.outputs, // drop manager has its own rate limiting logic
-				s.config->m_syscall_evt_drop_actions,
-				s.config->m_syscall_evt_drop_threshold,
-				s.config->m_syscall_evt_drop_rate,
-				s.config->m_syscall_evt_drop_max_burst,
-				s.config->m_syscall_evt_simulate_drops);
+		falco::profiler::set_thread_label("source:" + (is_capture_mode ? std::string("capture") : source));
 	}
+	if (!ctx.started)
+	{
+		ctx.started = true;
 
-	//
-	// Start capture
-	//
-	inspector->start_capture();
+		// reset event counter
+		num_evts = 0;
+
+		// init drop manager if we are inspecting syscalls
+		if (check_drops_and_timeouts)
+		{
+			sdropmgr.init(inspector,
+					s.outputs, // drop manager has its own rate limiting logic
+					s.config->m_syscall_evt_drop_actions,
+					s.config->m_syscall_evt_drop_threshold,
+					s.config->m_syscall_evt_drop_rate,
+					s.config->m_syscall_evt_drop_max_burst,
+					s.config->m_syscall_evt_simulate_drops,
+					shedder,
+					autosizer,
+					trends);
+			if (!is_capture_mode && s.config->m_syscall_evt_drop_actions.count(syscall_evt_drop_action::THROTTLE))
+			{
+				sdropmgr.set_throttle(get_throttle_sc_set(s),
+						s.config->m_syscall_evt_drop_throttle.m_after_intervals,
+						s.config->m_syscall_evt_drop_throttle.m_restore_after_intervals);
+			}
+		}
+
+		//
+		// Start capture
+		//
+		inspector->start_capture();
+	}
+
+	// passes the alerts of the matched rules to the outputs
+	auto handle_matches = [&]()
+	{
+		for(const auto& m : ctx.rule_matches)
+		{
+			// the alerts of a container over its budget are summarized
+			if (budgets == nullptr
+				|| !budgets->aggregate(budget_container, m.rule->priority, m.rule->name, m.evt->get_ts()))
+			{
+				s.outputs->handle_event(m.evt, *m.rule);
+			}
+			if (recorder != nullptr && recorder->triggers(m.rule->priority, m.rule->tags)) [[unlikely]]
+			{
+				std::string err;
+				bool started = recorder->trigger(m.evt->get_ts(), m.rule->name, [&inspector](const std::string& path)
+				{
+					return std::make_unique<flight_recorder_sink>(inspector, path);
+				}, err);
+				if (!started && !err.empty())
+				{
+					FALCO_LOG(falco_logger::level::ERR, "Flight recorder could not dump the events of rule '" + m.rule->name + "': " + err + "\n");
+				}
+			}
+		}
+		ctx.num_alerts += ctx.rule_matches.size();
+	};
+
+	// in live mode, the events of plugin sources are copied and evaluated
+	// by batches, which amortizes the evaluation of the rules over them
+	size_t batch_size = !is_capture_mode && source != falco_common::syscall_source
+		? s.config->m_plugin_event_batch_size : 0;
+	if (batch_size == 0)
+	{
+		ctx.batch = nullptr;
+	}
+	else if (ctx.batch == nullptr || ctx.batch->capacity() != batch_size)
+	{
+		ctx.batch = std::make_unique<falco::event_batch>(inspector.get(), batch_size);
+	}
+	falco::event_batch* batch = ctx.batch.get();
+	std::vector<falco::event_stages::durations> batch_stage_times;
+	std::vector<uint16_t> batch_timed_types;
+	auto flush_batch = [&]()
+	{
+		if (batch == nullptr || batch->empty())
+		{
+			return;
+		}
+		auto start = std::chrono::steady_clock::now();
+		bool matched = s.engine->process_events(source_engine_idx, batch->events(), batch->size(),
+			s.config->m_rule_matching, ctx.rule_matches);
+		auto rules_end = std::chrono::steady_clock::now();
+		if (matched)
+		{
+			handle_matches();
+		}
+		if (!batch_stage_times.empty()) [[unlikely]]
+		{
+			// each timed event is accounted its share of the batch
+			auto outputs_end = std::chrono::steady_clock::now();
+			for (auto& t : batch_stage_times)
+			{
+				t[falco::event_stages::RULES] = (rules_end - start) / batch->size();
+				t[falco::event_stages::OUTPUTS] = (outputs_end - rules_end) / batch->size();
+				stages->record(t);
+			}
+			batch_stage_times.clear();
+		}
+		if (!batch_timed_types.empty()) [[unlikely]]
+		{
+			for (auto t : batch_timed_types)
+			{
+				types->record(t, (rules_end - start) / batch->size());
+			}
+			batch_timed_types.clear();
+		}
+		batch->clear();
+	};
 
 	//
 	// Loop through the events
 	//
 	while(1)
 	{
+		timed = stages != nullptr && stages->sample();
+		if (timed) [[unlikely]]
+		{
+			stage_times = {};
+			stage_start = std::chrono::steady_clock::now();
+		}
 		rc = inspector->next(&ev);
+		if (timed) [[unlikely]]
+		{
+			stage_times[falco::event_stages::READ] = std::chrono::steady_clock::now() - stage_start;
+		}
 
-		if (falco::app::g_reopen_outputs_signal.triggered())
+		// note: a signal is handled at most s_periodic_checks_interval
+		// events late, which is negligible at any rate at which this matters
+		periodic_checks = rc != SCAP_SUCCESS || ++ctx.evts_since_periodic_checks >= s_periodic_checks_interval;
+		if (periodic_checks)
+		{
+			ctx.evts_since_periodic_checks = 0;
+			if (heartbeat != nullptr)
+			{
+				heartbeat->beat(num_evts, rc == SCAP_SUCCESS ? ev->get_ts() : 0);
+			}
+		}
+
+		if (periodic_checks && falco::app::g_reopen_outputs_signal.triggered())
 		{
 			falco::app::g_reopen_outputs_signal.handle([&s](){
-				falco_logger::log(falco_logger::level::INFO, "SIGUSR1 received, reopening outputs...\n");
+				FALCO_LOG(falco_logger::level::INFO, "SIGUSR1 received, reopening outputs...\n");
 				if(s.outputs != nullptr)
 				{
 					s.outputs->reopen_outputs();
@@ -182,17 +660,45 @@ static falco::app::run_result do_inspect(
 			});
 		}
 
-		if(falco::app::g_terminate_signal.triggered())
+		if (periodic_checks && falco::app::g_profile_signal.triggered())
+		{
+			falco::app::g_profile_signal.handle([&s](){
+				FALCO_LOG(falco_logger::level::INFO, "SIGUSR2 received, starting a profiling session...\n");
+				std::string err;
+				if(s.profiler != nullptr && !s.profiler->start(err))
+				{
+					FALCO_LOG(falco_logger::level::WARNING, "Could not start the profiling session: " + err + "\n");
+				}
+				falco::app::g_profile_signal.reset();
+			});
+		}
+
+		if (periodic_checks && !is_capture_mode && check_drops_and_timeouts && s.pending_sc_set_ready)
+		{
+			apply_pending_rules_change(s, inspector, sdropmgr);
+		}
+
+		if (periodic_checks && thread_table != nullptr)
+		{
+			update_thread_table(inspector, *thread_table);
+		}
+
+		if (periodic_checks && budgets != nullptr && budgets->has_summaries())
+		{
+			emit_container_summaries(s, *budgets, ctx.container_summaries);
+		}
+
+		if(periodic_checks && falco::app::g_terminate_signal.triggered())
 		{
 			falco::app::g_terminate_signal.handle([&](){
-				falco_logger::log(falco_logger::level::INFO, "SIGINT received, exiting...\n");
+				FALCO_LOG(falco_logger::level::INFO, "SIGINT received, exiting...\n");
 			});
 			break;
 		}
-		else if(falco::app::g_restart_signal.triggered())
+		else if(periodic_checks && falco::app::g_restart_signal.triggered())
 		{
 			falco::app::g_restart_signal.handle([&s](){
-				falco_logger::log(falco_logger::level::INFO, "SIGHUP received, restarting...\n");
+				FALCO_LOG(falco_logger::level::INFO, "SIGHUP received, restarting...\n");
 				s.restart.store(true);
 			});
 			break;
@@ -201,26 +707,39 @@ static falco::app::run_result do_inspect(
 		{
 			if(ev == nullptr) [[unlikely]]
 			{
-				timeouts_since_last_success_or_msg++;
-				if(timeouts_since_last_success_or_msg > s.config->m_syscall_evt_timeout_max_consecutives
-					&& check_drops_and_timeouts)
+				// an idle source doesn't hold the alerts of its last events
+				flush_batch();
+				if (recorder != nullptr)
 				{
-					std::string rule = "Falco internal: timeouts notification";
-					std::string msg = rule + ". " + std::to_string(s.config->m_syscall_evt_timeout_max_consecutives) + " consecutive timeouts without event.";
-					std::string last_event_time_str = "none";
-					if(duration_start > 0)
+					// completes the dump of an alert once its window
+					// passed, even if the source stays idle
+					recorder->flush(std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::system_clock::now().time_since_epoch()).count());
+				}
+				if (backoff != nullptr)
+				{
+					if (max_evts > 0)
 					{
-						sinsp_utils::ts_to_string(duration_start, &last_event_time_str, false, true);
+						// when running in slices, the caller does the sleeping
+						std::chrono::microseconds sleep{0};
+						if (backoff->on_timeout(sleep) == falco::idle_backoff::action::SLEEP)
+						{
+							ctx.idle_delay = sleep;
+						}
+					}
+					else
+					{
+						backoff->wait();
 					}
-					nlohmann::json fields;
-					fields["last_event_time"] = last_event_time_str;
-					auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-					s.outputs->handle_msg(now, falco_common::PRIORITY_DEBUG, msg, rule, fields);
-					// Reset the timeouts counter, Falco alerted
-					timeouts_since_last_success_or_msg = 0;
 				}
 			}
 
+			// when running in slices, an idle source lets the others run
+			if (max_evts > 0)
+			{
+				ctx.yielded = true;
+				break;
+			}
 			continue;
 		}
 		else if(rc == SCAP_FILTERED_EVENT)
@@ -261,7 +780,10 @@ static falco::app::run_result do_inspect(
 			}
 
 			// for capture mode, the source name can change at every event
-			stats_collector.collect(inspector, inspector->event_sources()[source_engine_idx], num_evts);
+			if (periodic_checks)
+			{
+				ctx.stats_collector.collect(inspector, inspector->event_sources()[source_engine_idx], num_evts);
+			}
 		}
 		else
 		{
@@ -280,81 +802,430 @@ static falco::app::run_result do_inspect(
 			}
 
 			// for live mode, the source name is constant
-			stats_collector.collect(inspector, source, num_evts);
+			if (timed) [[unlikely]]
+			{
+				stage_start = std::chrono::steady_clock::now();
+			}
+			if (periodic_checks)
+			{
+				ctx.stats_collector.collect(inspector, source, num_evts, stages, backoff, shedder, autosizer, trends, cost, heartbeat, types, recorder, fast_path, thread_table, budgets, shards);
+			}
+			if (timed) [[unlikely]]
+			{
+				stage_times[falco::event_stages::STATS] = std::chrono::steady_clock::now() - stage_start;
+			}
 		}
 
-		// Reset the timeouts counter, Falco successfully got an event to process
-		timeouts_since_last_success_or_msg = 0;
-		if(duration_start == 0)
+		if (backoff != nullptr)
+		{
+			backoff->on_event();
+		}
+		if (recorder != nullptr)
+		{
+			auto pevt = ev->get_scap_evt();
+			recorder->record(ev->get_ts(), ev->get_cpuid(), reinterpret_cast<const uint8_t*>(pevt), pevt->len);
+		}
+		if (cost != nullptr)
+		{
+			cost->count(ev->get_type());
+		}
+		if (sandboxes != nullptr)
+		{
+			auto tinfo = ev->get_thread_info();
+			sandboxes->count(ev->get_tid(), tinfo != nullptr ? tinfo->m_clone_ts : 0, [&]()
+			{
+				return extract_container_id(s, ctx, source_engine_idx, ev);
+			});
+		}
+		if (types != nullptr)
+		{
+			types->count(ev->get_type());
+			type_timed = types->sample();
+		}
+		if(ctx.duration_start == 0)
 		{
-			duration_start = ev->get_ts();
+			ctx.duration_start = ev->get_ts();
 		}
 		else if(duration_to_tot_ns > 0)
 		{
-			if(ev->get_ts() - duration_start >= duration_to_tot_ns)
+			if(ev->get_ts() - ctx.duration_start >= duration_to_tot_ns)
 			{
 				break;
 			}
 		}
 
+		if (timed) [[unlikely]]
+		{
+			stage_start = std::chrono::steady_clock::now();
+		}
 		if(check_drops_and_timeouts && !sdropmgr.process_event(inspector, ev))
 		{
 			return run_result::fatal("Drop manager internal error");
 		}
+		if (timed) [[unlikely]]
+		{
+			stage_times[falco::event_stages::DROPS] = std::chrono::steady_clock::now() - stage_start;
+		}
 
-		// As the inspector has no filter at its level, all
-		// events are returned here. Pass them to the falco
-		// engine, which will match the event against the set
-		// of rules. If a match is found, pass the event to
-		// the outputs.
-		auto res = s.engine->process_event(source_engine_idx, ev, s.config->m_rule_matching);
-		if(res != nullptr)
+		// note: throttled events are still parsed by the inspector, so the
+		// state it keeps stays consistent
+		bool budget_skip = false;
+		if (budgets != nullptr)
+		{
+			auto tinfo = ev->get_thread_info();
+			budget_container = budgets->container(ev->get_tid(), tinfo != nullptr ? tinfo->m_clone_ts : 0, [&]()
+			{
+				return extract_container_id(s, ctx, source_engine_idx, ev);
+			});
+			budget_skip = budgets->sample(budget_container, ev->get_type(), ev->get_ts());
+		}
+
+		if (fast_path != nullptr)
+		{
+			// the rules can be enabled and disabled while running
+			fast_path->refresh(*s.engine);
+		}
+
+		// the events no enabled rule needs, such as most of the ones
+		// only collected to keep the state of the inspector, and the ones
+		// sampled out of the containers over their budget, end here
+		if (budget_skip || (fast_path != nullptr && fast_path->skips(ev->get_type())))
+		{
+			if (timed) [[unlikely]]
+			{
+				stages->record(stage_times);
+			}
+		}
+		// the events of a batch are evaluated once it's full, and the
+		// rules and outputs stages of their timed ones, as well as the
+		// rules time of their sampled types, are measured then
+		else if (batch != nullptr)
+		{
+			if (timed) [[unlikely]]
+			{
+				batch_stage_times.push_back(stage_times);
+			}
+			if (type_timed) [[unlikely]]
+			{
+				batch_timed_types.push_back(ev->get_type());
+			}
+			if (batch->add(ev))
+			{
+				flush_batch();
+			}
+		}
+		else
 		{
-			for(auto& rule_res : *res)
+			// As the inspector has no filter at its level, all
+			// events are returned here. Pass them to the falco
+			// engine, which will match the event against the set
+			// of rules. If a match is found, pass the event to
+			// the outputs.
+			if (timed) [[unlikely]]
+			{
+				stage_start = std::chrono::steady_clock::now();
+			}
+			if (type_timed) [[unlikely]]
 			{
-				s.outputs->handle_event(rule_res.evt, rule_res.rule, rule_res.source, rule_res.priority_num, rule_res.format, rule_res.tags);
+				type_start = std::chrono::steady_clock::now();
 			}
+			// note: shed events are still parsed by the inspector, so the
+			// state it keeps stays consistent
+			if (source_handle_idx != source_engine_idx) [[unlikely]]
+			{
+				source_handle = s.engine->get_source_handle(source_engine_idx);
+				source_handle_idx = source_engine_idx;
+			}
+			bool matched = (shedder == nullptr || !shedder->should_shed(ev->get_type()))
+				&& s.engine->process_event(source_handle, ev, s.config->m_rule_matching, ctx.rule_matches);
+			if (type_timed) [[unlikely]]
+			{
+				types->record(ev->get_type(), std::chrono::steady_clock::now() - type_start);
+			}
+			if (timed) [[unlikely]]
+			{
+				auto now = std::chrono::steady_clock::now();
+				stage_times[falco::event_stages::RULES] = now - stage_start;
+				stage_start = now;
+			}
+			if(matched)
+			{
+				handle_matches();
+			}
+			if (timed) [[unlikely]]
+			{
+				stage_times[falco::event_stages::OUTPUTS] = std::chrono::steady_clock::now() - stage_start;
+				stages->record(stage_times);
+			}
+		}
+
+		if (startup != nullptr) [[unlikely]]
+		{
+			startup->event_processed();
+			startup = nullptr;
 		}
 
 		num_evts++;
+		if (max_evts > 0 && ++slice_evts >= max_evts)
+		{
+			ctx.yielded = true;
+			break;
+		}
 	}
 
+	// no event is left behind when the loop stops or yields
+	flush_batch();
 	return run_result::ok();
 }
 
-static void process_inspector_events(
-		falco::app::state& s,
-		std::shared_ptr<sinsp> inspector,
-		std::shared_ptr<stats_writer> statsw,
-		const std::string& source, // an empty source represents capture mode
-		source_sync_context* sync,
-		run_result* res) noexcept
+// Creates the monitor that notifies when the syscall source stopped
+// receiving events, and gives a heartbeat to each enabled source for it and
+// for the stall metrics. Event sources other than the syscall one can
+// legitimately stay idle for long, so their stalls are only measured
+static std::unique_ptr<falco::source_monitor> create_source_monitor(falco::app::state& s)
 {
-	run_result result;
+	auto max_stall = std::chrono::milliseconds(s.config->m_syscall_evt_timeout_max_stall_ms);
+	auto interval = std::clamp(max_stall / 10, std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+	auto outputs = s.outputs;
+	auto monitor = std::make_unique<falco::source_monitor>(interval, max_stall,
+		[outputs, max_stall](const std::string& source, std::chrono::milliseconds stall, const falco::source_monitor::heartbeat& hb)
+		{
+			std::string rule = "Falco internal: timeouts notification";
+			std::string msg = rule + ". No event from source '" + source + "' for more than " + std::to_string(max_stall.count()) + " ms.";
+			std::string last_event_time_str = "none";
+			if(hb.last_evt_ts() > 0)
+			{
+				sinsp_utils::ts_to_string(hb.last_evt_ts(), &last_event_time_str, false, true);
+			}
+			nlohmann::json fields;
+			fields["last_event_time"] = last_event_time_str;
+			fields["source"] = source;
+			fields["stall_ms"] = stall.count();
+			auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			outputs->handle_msg(now, falco_common::PRIORITY_DEBUG, msg, rule, fields);
+		});
+	for (const auto& source : s.enabled_sources)
+	{
+		auto src_info = s.source_infos.at(source);
+		src_info->heartbeat = std::make_shared<falco::source_monitor::heartbeat>();
+		monitor->add(source, src_info->heartbeat, source == falco_common::syscall_source && !s.is_gvisor());
+	}
+	return monitor;
+}
 
-	try
+// Prints the throughput of a capture file replay, the time spent in each
+// stage of the processing loop, the detection latencies of the outputs, the
+// peak memory usage and the evaluation profile of each rule, most expensive
+// first. The JSON report is meant to be compared across versions and rules.
+static void print_replay_report(const falco::app::state& s, const inspect_context& ctx,
+	uint64_t num_evts, double duration_sec, double cpu_sec)
+{
+	nlohmann::json report;
+	report["falco_version"] = FALCO_VERSION;
+	report["capture_file"] = s.config->m_replay.m_capture_file;
+	report["outputs"] = nlohmann::json::array();
+	for (const auto& o : s.config->m_outputs)
 	{
-		double duration;
-		scap_stats cstats;
-		uint64_t num_evts = 0;
-		syscall_evt_drop_mgr sdropmgr;
-		bool is_capture_mode = source.empty();
-		bool check_drops_timeouts = is_capture_mode
-			|| (source == falco_common::syscall_source && !s.is_gvisor());
+		report["outputs"].push_back(o.name);
+	}
+	report["events"] = num_evts;
+	report["alerts"] = ctx.num_alerts;
+	report["duration_sec"] = duration_sec;
+	report["cpu_time_sec"] = cpu_sec;
+	report["evts_per_sec"] = duration_sec > 0 ? num_evts / duration_sec : 0.0;
+	report["alerts_per_sec"] = duration_sec > 0 ? ctx.num_alerts / duration_sec : 0.0;
+
+	uint64_t stages_ns = 0;
+	for (int i = 0; i < falco::event_stages::NUM_STAGES; i++)
+	{
+		stages_ns += ctx.replay_stages.time_ns(falco::event_stages::stage(i));
+	}
+	report["stages"] = nlohmann::json::object();
+	for (int i = 0; i < falco::event_stages::NUM_STAGES; i++)
+	{
+		auto st = falco::event_stages::stage(i);
+		auto ns = ctx.replay_stages.time_ns(st);
+		report["stages"][falco::event_stages::name(st)] = {
+			{"time_ns", ns},
+			{"time_perc", stages_ns > 0 ? 100.0 * ns / stages_ns : 0.0}};
+	}
 
-		duration = ((double)clock()) / CLOCKS_PER_SEC;
+	report["detection_latency_us"] = nlohmann::json::object();
+	if (s.outputs != nullptr)
+	{
+		for (const auto& l : s.outputs->get_outputs_detection_latencies())
+		{
+			report["detection_latency_us"][l.first] = {
+				{"count", l.second->count()},
+				{"p50", l.second->percentile_us(50)},
+				{"p90", l.second->percentile_us(90)},
+				{"p99", l.second->percentile_us(99)},
+				{"max", l.second->max_us()}};
+		}
+	}
 
-		result = do_inspect(s, inspector, source, statsw, sdropmgr, check_drops_timeouts,
-						uint64_t(s.options.duration_to_tot*ONE_SECOND_IN_NS),
-						num_evts);
+	// the time the events waited for the outputs to keep up, and the time
+	// the queue waited for each of them, when the alerts are not dropped
+	report["outputs_wait_ns"] = nlohmann::json::object();
+	if (s.outputs != nullptr)
+	{
+		for (const auto& w : s.outputs->get_backpressure_wait_ns())
+		{
+			report["outputs_wait_ns"][w.first] = w.second;
+		}
+	}
 
-		duration = ((double)clock()) / CLOCKS_PER_SEC - duration;
+	uint64_t peak_rss_kb = 0;
+#ifdef __linux__
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		peak_rss_kb = usage.ru_maxrss;
+	}
+#endif
+	report["peak_rss_kb"] = peak_rss_kb;
+	report["rules"] = s.engine->rules_profile_report();
+	if (s.config->m_json_output)
+	{
+		fprintf(stdout, "%s\n", report.dump().c_str());
+		return;
+	}
 
-		inspector->get_capture_stats(&cstats);
+	fprintf(stdout, "Replay report:\n   Events: %" PRIu64 ", alerts: %" PRIu64 ", elapsed time: %.3lfs, CPU time: %.3lfs, %.2lf eps, %.2lf alerts/s, peak RSS: %" PRIu64 "KB\n",
+		num_evts, ctx.num_alerts, duration_sec, cpu_sec, report["evts_per_sec"].get<double>(),
+		report["alerts_per_sec"].get<double>(), peak_rss_kb);
+	fprintf(stdout, "Processing time by stage (time, share):\n");
+	for (const auto& st : report["stages"].items())
+	{
+		fprintf(stdout, "   %s: %" PRIu64 "ns, %.1lf%%\n", st.key().c_str(),
+			st.value()["time_ns"].get<uint64_t>(), st.value()["time_perc"].get<double>());
+	}
+	fprintf(stdout, "Detection latency by output (alerts, p50, p90, p99, max):\n");
+	for (const auto& l : report["detection_latency_us"].items())
+	{
+		fprintf(stdout, "   %s: %" PRIu64 ", %" PRIu64 "us, %" PRIu64 "us, %" PRIu64 "us, %" PRIu64 "us\n", l.key().c_str(),
+			l.value()["count"].get<uint64_t>(), l.value()["p50"].get<uint64_t>(), l.value()["p90"].get<uint64_t>(),
+			l.value()["p99"].get<uint64_t>(), l.value()["max"].get<uint64_t>());
+	}
+	fprintf(stdout, "Time waiting for room in the outputs queue and in the queue of each output:\n");
+	for (const auto& w : report["outputs_wait_ns"].items())
+	{
+		fprintf(stdout, "   %s: %" PRIu64 "ns\n", w.key().c_str(), w.value().get<uint64_t>());
+	}
+	fprintf(stdout, "Rule evaluation profile by estimated time (evaluations, matches, time, share, avg, p50, p99):\n");
+	for (const auto& r : report["rules"])
+	{
+		fprintf(stdout, "   %s (%s): %" PRIu64 ", %" PRIu64 ", %" PRIu64 "ns, %.1lf%%, %" PRIu64 "ns, %" PRIu64 "ns, %" PRIu64 "ns\n",
+			r["name"].get<std::string>().c_str(),
+			r["source"].get<std::string>().c_str(),
+			r["evaluations"].get<uint64_t>(),
+			r["matches"].get<uint64_t>(),
+			r["time_ns"].get<uint64_t>(),
+			r["time_perc"].get<double>(),
+			r["avg_time_ns"].get<uint64_t>(),
+			r["time_p50_ns"].get<uint64_t>(),
+			r["time_p99_ns"].get<uint64_t>());
+	}
+}
 
-		if(s.options.verbose)
+// Runs the event processing loop of a source, either in one go or in
+// slices of events when the source shares its threads with other ones
+class inspector_events_processor
+{
+public:
+	inspector_events_processor(
+			falco::app::state& s,
+			std::shared_ptr<sinsp> inspector,
+			std::shared_ptr<stats_writer> statsw,
+			const std::string& source, // an empty source represents capture mode
+			source_sync_context* sync,
+			run_result* res)
+		: m_state(s), m_inspector(inspector), m_source(source),
+		  m_sync(sync), m_res(res), m_ctx(statsw),
+		  m_check_drops_timeouts(source.empty()
+			|| (source == falco_common::syscall_source && !s.is_gvisor())) { }
+
+	// Processes the events of the source, at most max_evts of them if not
+	// zero, and returns true once its processing loop is over, in which
+	// case finish() must be invoked. At most one thread at a time can
+	// invoke this
+	bool run(uint64_t max_evts = 0) noexcept
+	{
+		try
 		{
-			if (source == falco_common::syscall_source)
+			if (!m_ctx.started)
+			{
+				m_cpu_start = ((double)clock()) / CLOCKS_PER_SEC;
+				m_wall_start = std::chrono::steady_clock::now();
+			}
+			m_result = do_inspect(m_state, m_inspector, m_source, m_ctx, m_sdropmgr, m_check_drops_timeouts,
+							uint64_t(m_state.options.duration_to_tot*ONE_SECOND_IN_NS),
+							m_num_evts, max_evts);
+			return !m_ctx.yielded;
+		}
+		catch(const std::exception& e)
+		{
+			m_result = run_result::fatal(e.what());
+			m_failed = true;
+			return true;
+		}
+	}
+
+	// Reports the stats of the processing loop, unless it failed with an
+	// exception, and then its result
+	void finish() noexcept
+	{
+		try
+		{
+			if (!m_failed)
+			{
+				report();
+			}
+		}
+		catch(const std::exception& e)
+		{
+			m_result = run_result::fatal(e.what());
+		}
+
+		if (m_sync)
+		{
+			try {
+				m_sync->finish();
+			}
+			catch(const std::exception& e)
+			{
+				m_result = run_result::merge(m_result, run_result::fatal(e.what()));
+			}
+		}
+
+		*m_res = m_result;
+	}
+
+	inline const std::string& source() const
+	{
+		return m_source;
+	}
+
+	// How long to wait before resuming the processing loop after run()
+	// returned false, which is only non-zero when the source was idle
+	inline std::chrono::microseconds idle_delay() const
+	{
+		return m_ctx.idle_delay;
+	}
+
+private:
+	void report()
+	{
+		double duration = ((double)clock()) / CLOCKS_PER_SEC - m_cpu_start;
+		std::chrono::duration<double> wall_duration = std::chrono::steady_clock::now() - m_wall_start;
+		bool is_capture_mode = m_source.empty();
+		scap_stats cstats;
+
+		m_inspector->get_capture_stats(&cstats);
+
+		if(m_state.options.verbose)
+		{
+			if (m_source == falco_common::syscall_source)
 			{
 				fprintf(stderr, "Driver Events:%" PRIu64 "\nDriver Drops:%" PRIu64 "\n",
 				cstats.n_evts,
@@ -362,35 +1233,154 @@ static void process_inspector_events(
 			}
 
 			fprintf(stderr, "%sElapsed time: %.3lf, Captured Events: %" PRIu64 ", %.2lf eps\n",
-				(is_capture_mode ? "" : ("("+source+") ").c_str()),
+				(is_capture_mode ? "" : ("("+m_source+") ").c_str()),
 				duration,
-				num_evts,
-				num_evts / duration);
+				m_num_evts,
+				m_num_evts / duration);
+		}
+
+		if (m_check_drops_timeouts)
+		{
+			m_sdropmgr.print_stats();
 		}
 
-		if (check_drops_timeouts)
+		if (is_capture_mode && m_state.config->m_replay.m_report)
 		{
-			sdropmgr.print_stats();
+			print_replay_report(m_state, m_ctx, m_num_evts, wall_duration.count(), duration);
 		}
 	}
-	catch(const std::exception& e)
+
+	falco::app::state& m_state;
+	std::shared_ptr<sinsp> m_inspector;
+	std::string m_source;
+	source_sync_context* m_sync;
+	run_result* m_res;
+	run_result m_result;
+	inspect_context m_ctx;
+	syscall_evt_drop_mgr m_sdropmgr;
+	bool m_check_drops_timeouts;
+	bool m_failed = false;
+	uint64_t m_num_evts = 0;
+	double m_cpu_start = 0;
+	std::chrono::steady_clock::time_point m_wall_start;
+};
+
+static void process_inspector_events(
+		falco::app::state& s,
+		std::shared_ptr<sinsp> inspector,
+		std::shared_ptr<stats_writer> statsw,
+		const std::string& source, // an empty source represents capture mode
+		source_sync_context* sync,
+		run_result* res) noexcept
+{
+	inspector_events_processor p(s, inspector, statsw, source, sync, res);
+	p.run();
+	p.finish();
+}
+
+// Runs the event processing loops of several sources on a shared pool of
+// threads, so that many low-volume sources don't need a thread each. A
+// source is processed by one thread at a time, in slices of at most
+// s_slice_evts events that end early when it has no event to return,
+// and it's put back at the end of a shared queue after each slice, so that
+// any idle thread can take it over. An idle source is only taken again
+// once its backoff, if any, has elapsed.
+class shared_sources_executor
+{
+public:
+	explicit shared_sources_executor(size_t num_threads)
 	{
-		result = run_result::fatal(e.what());
+		for (size_t i = 0; i < num_threads; i++)
+		{
+			m_threads.emplace_back([this]() { worker(); });
+		}
 	}
 
-	if (sync)
+	// note: all the added sources must be finished when this is invoked
+	~shared_sources_executor()
 	{
-		try {
-			sync->finish();
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
 		}
-		catch(const std::exception& e)
+		m_cv.notify_all();
+		for (auto& t : m_threads)
 		{
-			result = run_result::merge(result, run_result::fatal(e.what()));
+			t.join();
 		}
 	}
 
-	*res = result;
-}
+	// Schedules the processing of a source, which is run until its
+	// processing loop is over and then finished by the pool
+	void add(std::unique_ptr<inspector_events_processor> p)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_ready.push_back({std::move(p), std::chrono::steady_clock::now()});
+		}
+		m_cv.notify_one();
+	}
+
+private:
+	static constexpr uint64_t s_slice_evts = 1024;
+
+	struct entry
+	{
+		std::unique_ptr<inspector_events_processor> processor;
+		std::chrono::steady_clock::time_point not_before;
+	};
+
+	void worker()
+	{
+		falco::thread_affinity::apply(falco::thread_affinity::EVENT_SOURCES);
+		std::unique_lock<std::mutex> lock(m_mtx);
+		while (!m_stop)
+		{
+			// take the first source that can be resumed, or wait for the
+			// earliest one
+			auto now = std::chrono::steady_clock::now();
+			auto next = std::find_if(m_ready.begin(), m_ready.end(),
+				[&now](const entry& e) { return e.not_before <= now; });
+			if (next == m_ready.end())
+			{
+				if (m_ready.empty())
+				{
+					m_cv.wait(lock);
+				}
+				else
+				{
+					auto earliest = std::min_element(m_ready.begin(), m_ready.end(),
+						[](const entry& a, const entry& b) { return a.not_before < b.not_before; })->not_before;
+					m_cv.wait_until(lock, earliest);
+				}
+				continue;
+			}
+			auto p = std::move(next->processor);
+			m_ready.erase(next);
+			lock.unlock();
+
+			bool finished = p->run(s_slice_evts);
+			if (finished)
+			{
+				p->finish();
+				p.reset();
+			}
+
+			lock.lock();
+			if (!finished)
+			{
+				auto not_before = std::chrono::steady_clock::now() + p->idle_delay();
+				m_ready.push_back({std::move(p), not_before});
+			}
+		}
+	}
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::deque<entry> m_ready;
+	bool m_stop = false;
+	std::vector<std::thread> m_threads;
+};
 
 static falco::app::run_result init_stats_writer(
 		const std::shared_ptr<const stats_writer>& sw,
@@ -402,10 +1392,11 @@ static falco::app::run_result init_stats_writer(
 		return  falco::app::run_result::ok();
 	}
 
-	/* Enforce minimum bound of 100ms. */
-	if(config->m_metrics_interval < 100)
+	/* Enforce minimum bound of 100ms, or 10ms with the ticker thread. */
+	uint64_t min_interval = config->m_metrics_ticker_thread ? 10 : 100;
+	if(config->m_metrics_interval < min_interval)
 	{
-		return falco::app::run_result::fatal("Metrics interval must have a minimum value of 100ms and reflect a Prometheus compliant time duration format: https://prometheus.io/docs/prometheus/latest/querying/basics/#time-durations. ");
+		return falco::app::run_result::fatal("Metrics interval must have a minimum value of " + std::to_string(min_interval) + "ms and reflect a Prometheus compliant time duration format: https://prometheus.io/docs/prometheus/latest/querying/basics/#time-durations. ");
 	}
 
 	if(std::all_of(config->m_metrics_interval_str.begin(), config->m_metrics_interval_str.end(), ::isdigit))
@@ -418,14 +1409,18 @@ static falco::app::run_result init_stats_writer(
 		return falco::app::run_result::fatal("Metrics are enabled with no output configured. Please enable at least one output channel ('metrics.output_rule', 'metrics.output_file' or 'webserver.prometheus_metrics_enabled')");
 	}
 
-	falco_logger::log(falco_logger::level::INFO, "Setting metrics interval to " + config->m_metrics_interval_str + ", equivalent to " + std::to_string(config->m_metrics_interval) + " (ms)\n");
+	FALCO_LOG(falco_logger::level::INFO, "Setting metrics interval to " + config->m_metrics_interval_str + ", equivalent to " + std::to_string(config->m_metrics_interval) + " (ms)\n");
+	if (sw->ticker_interval() != config->m_metrics_interval)
+	{
+		FALCO_LOG(falco_logger::level::INFO, "Refreshing the Prometheus metrics every " + std::to_string(sw->ticker_interval()) + " (ms)\n");
+	}
 
 	auto res = falco::app::run_result::ok();
 	if (is_dry_run)
 	{
 		return res;
 	}
-	res.success = stats_writer::init_ticker(config->m_metrics_interval, res.errstr);
+	res.success = stats_writer::init_ticker(sw->ticker_interval(), res.errstr, config->m_metrics_ticker_thread);
 	res.proceed = res.success;
 	return res;
 }
@@ -435,13 +1430,57 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 	// Notify engine that we finished loading and enabling all rules
 	s.engine->complete_rule_loading();
 
+	// the workers replaying more than one capture file, and the additional
+	// gVisor shards, load the rules of the engine, which must be written
+	// before releasing its loading state
+	std::vector<std::string> capture_files;
+	std::string worker_rules;
+	if (s.is_capture_mode() && !s.options.dry_run)
+	{
+		std::string err;
+		if (!list_capture_files(s, capture_files, err))
+		{
+			return run_result::fatal(err);
+		}
+		try
+		{
+			if (capture_files.size() > 1)
+			{
+				worker_rules = write_worker_rules(s);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			return run_result::fatal("Could not hand over the rules to the capture file workers: " + std::string(e.what()));
+		}
+	}
+	else if (s.is_gvisor() && !s.config->m_gvisor.m_shards.empty() && !s.options.dry_run)
+	{
+		try
+		{
+			worker_rules = write_worker_rules(s);
+		}
+		catch (const std::exception& e)
+		{
+			return run_result::fatal("Could not hand over the rules to the gVisor shards: " + std::string(e.what()));
+		}
+	}
+	if (s.config->m_rules_release_loading_state)
+	{
+		s.engine->release_rule_loading_state();
+	}
+
 	// Initialize stats writer
-	auto statsw = std::make_shared<stats_writer>(s.outputs, s.config, s.engine);
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
+	auto statsw = std::make_shared<stats_writer>(s.outputs, s.config, s.engine, s.otlp, s.startup, s.prometheus_metrics);
+#else
+	auto statsw = std::make_shared<stats_writer>(s.outputs, s.config, s.engine, s.otlp, s.startup);
+#endif
 	auto res = init_stats_writer(statsw, s.config, s.options.dry_run);
 
 	if (s.options.dry_run)
 	{
-		falco_logger::log(falco_logger::level::DEBUG, "Skipping event processing in dry-run\n");
+		FALCO_LOG(falco_logger::level::DEBUG, "Skipping event processing in dry-run\n");
 		return res;
 	}
 
@@ -450,18 +1489,34 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 		return res;
 	}
 
+	std::unique_ptr<rule_ordering_updater> ordering_updater;
+	if (s.config->m_rule_matching == falco_common::rule_matching::FIRST
+		&& s.config->m_rule_matching_adaptive_ordering_enabled)
+	{
+		FALCO_LOG(falco_logger::level::DEBUG, "Enabling adaptive rule ordering\n");
+		ordering_updater = std::make_unique<rule_ordering_updater>(
+			s.engine, s.config->m_rule_matching_adaptive_ordering_interval);
+	}
+
 	// Start processing events
 	bool termination_forced = false;
 	if(s.is_capture_mode())
 	{
-		res = open_offline_inspector(s);
-		if (!res.success)
+		if (capture_files.size() > 1)
 		{
-			return res;
+			res = process_capture_files(s, capture_files, worker_rules);
 		}
+		else
+		{
+			res = open_offline_inspector(s, capture_files.front());
+			if (!res.success)
+			{
+				return res;
+			}
 
-		process_inspector_events(s, s.offline_inspector, statsw, "", nullptr, &res);
-		s.offline_inspector->close();
+			process_inspector_events(s, s.offline_inspector, statsw, "", nullptr, &res);
+			s.offline_inspector->close();
+		}
 
 		// Honor -M also when using a trace file.
 		// Since inspection stops as soon as all events have been consumed
@@ -486,6 +1541,44 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 		falco::semaphore termination_sem(s.enabled_sources.size());
 		std::vector<live_context> ctxs;
 		ctxs.reserve(s.enabled_sources.size());
+
+		// plugin sources can share a pool of threads instead of having one each
+		std::unique_ptr<shared_sources_executor> plugin_sources_executor;
+		size_t num_plugin_sources = std::count_if(s.enabled_sources.begin(), s.enabled_sources.end(),
+			[](const std::string& src) { return src != falco_common::syscall_source; });
+		if (s.enabled_sources.size() > 1 && num_plugin_sources > 0 && s.config->m_plugin_sources_threads > 0)
+		{
+			size_t num_threads = std::min<size_t>(s.config->m_plugin_sources_threads, num_plugin_sources);
+			FALCO_LOG(falco_logger::level::DEBUG, "Processing " + std::to_string(num_plugin_sources)
+				+ " plugin event sources on " + std::to_string(num_threads) + " shared threads\n");
+			plugin_sources_executor = std::make_unique<shared_sources_executor>(num_threads);
+		}
+
+		// note: started before the sources, as with a single source the
+		// processing loop runs on this thread
+		auto monitor = create_source_monitor(s);
+		monitor->start();
+
+		// the additional gVisor shards run alongside the sources until all
+		// of them stopped, and an error in a shard stops Falco as one in a
+		// source does
+		std::atomic<bool> gvisor_shards_stop{false};
+		std::vector<run_result> gvisor_shards_res(s.is_gvisor() ? s.config->m_gvisor.m_shards.size() : 0);
+		std::vector<std::thread> gvisor_shards;
+		for (size_t i = 0; i < gvisor_shards_res.size(); i++)
+		{
+			gvisor_shards.emplace_back([&s, &worker_rules, &gvisor_shards_stop, &gvisor_shards_res, i]()
+			{
+				falco::thread_affinity::apply(falco::thread_affinity::EVENT_SOURCES);
+				gvisor_shards_res[i] = process_gvisor_shard(s, i + 1, worker_rules, gvisor_shards_stop);
+				if (!gvisor_shards_res[i].success)
+				{
+					FALCO_LOG(falco_logger::level::ERR, gvisor_shards_res[i].errstr + "\n");
+					falco::app::g_terminate_signal.trigger();
+				}
+			});
+		}
+		s.startup->expect_sources(s.enabled_sources.size());
 		for (const auto& source : s.enabled_sources)
 		{
 			auto& ctx = ctxs.emplace_back();
@@ -495,28 +1588,45 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 
 			try
 			{
-				falco_logger::log(falco_logger::level::DEBUG, "Opening event source '" + source + "'\n");
+				FALCO_LOG(falco_logger::level::DEBUG, "Opening event source '" + source + "'\n");
 				termination_sem.acquire();
-				res = open_live_inspector(s, src_info->inspector, source);
-				if (!res.success)
+				// note: after a hot reload, the inspectors are still open
+				if (!src_info->opened)
 				{
-					// note: we don't return here because we need to reach
-					// the thread termination loop below to make sure all
-					// already-spawned threads get terminated gracefully
-					ctx.sync->finish();
-					break;
+					auto open_start = std::chrono::steady_clock::now();
+					res = open_live_inspector(s, src_info->inspector, source);
+					if (!res.success)
+					{
+						// note: we don't return here because we need to reach
+						// the thread termination loop below to make sure all
+						// already-spawned threads get terminated gracefully
+						ctx.sync->finish();
+						break;
+					}
+					src_info->opened = true;
+					auto open_duration = std::chrono::steady_clock::now() - open_start;
+					s.startup->source_opened(source, open_duration);
+					FALCO_LOG(falco_logger::level::DEBUG, "Opened event source '" + source + "' in "
+						+ std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(open_duration).count()) + " (ms)\n");
 				}
 
 				if (s.enabled_sources.size() == 1)
 				{
 					// optimization: with only one source we don't spawn additional threads
+					falco::thread_affinity::scoped affinity(falco::thread_affinity::EVENT_SOURCES);
 					process_inspector_events(s, src_info->inspector, statsw, source, ctx.sync.get(), &ctx.res);
 				}
+				else if (plugin_sources_executor && source != falco_common::syscall_source)
+				{
+					plugin_sources_executor->add(std::make_unique<inspector_events_processor>(
+						s, src_info->inspector, statsw, source, ctx.sync.get(), &ctx.res));
+				}
 				else
 				{
 					auto res_ptr = &ctx.res;
 					auto sync_ptr = ctx.sync.get();
 					ctx.thread = std::make_unique<std::thread>([&s, src_info, &statsw, source, sync_ptr, res_ptr]() {
+						falco::thread_affinity::apply(falco::thread_affinity::EVENT_SOURCES);
 						process_inspector_events(s, src_info->inspector, statsw, source, sync_ptr, res_ptr);
 					});
 				}
@@ -541,7 +1651,7 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 		{
 			if (!res.success && !termination_forced)
 			{
-				falco_logger::log(falco_logger::level::INFO, "An error occurred in an event source, forcing termination...\n");
+				FALCO_LOG(falco_logger::level::INFO, "An error occurred in an event source, forcing termination...\n");
 				falco::app::g_terminate_signal.trigger();
 				falco::app::g_terminate_signal.handle([&](){});
 				termination_forced = true;
@@ -572,8 +1682,14 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 						ctx.thread->join();
 					}
 
-					falco_logger::log(falco_logger::level::DEBUG, "Stopping capture for event source '" + ctx.source + "'\n");
-					s.source_infos.at(ctx.source)->inspector->stop_capture();
+					// a hot reload resumes processing the events captured
+					// meanwhile, if the restart allows it
+					if (!s.restart || !s.is_hot_reload_enabled())
+					{
+						FALCO_LOG(falco_logger::level::DEBUG, "Stopping capture for event source '" + ctx.source + "'\n");
+						s.source_infos.at(ctx.source)->inspector->stop_capture();
+						s.source_infos.at(ctx.source)->opened = false;
+					}
 
 					res = run_result::merge(res, ctx.res);
 					ctx.sync->join();
@@ -581,8 +1697,17 @@ falco::app::run_result falco::app::actions::process_events(falco::app::state& s)
 				}
 			}
 		}
+		monitor->stop();
+
+		gvisor_shards_stop = true;
+		for (size_t i = 0; i < gvisor_shards.size(); i++)
+		{
+			gvisor_shards[i].join();
+			res = run_result::merge(res, gvisor_shards_res[i]);
+		}
 	}
 
+	ordering_updater.reset();
 	s.engine->print_stats();
 
 	return res;
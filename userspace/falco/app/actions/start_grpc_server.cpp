@@ -16,6 +16,7 @@ limitations under the License.
 */
 
 #include "actions.h"
+#include "helpers.h"
 
 #if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
 #include "grpc_server.h"
@@ -32,21 +33,49 @@ falco::app::run_result falco::app::actions::start_grpc_server(falco::app::state&
 	{
 		if (s.options.dry_run)
 		{
-			falco_logger::log(falco_logger::level::DEBUG, "Skipping starting gRPC server in dry-run\n");
+			FALCO_LOG(falco_logger::level::DEBUG, "Skipping starting gRPC server in dry-run\n");
 			return run_result::ok();
 		}
 
-		falco_logger::log(falco_logger::level::INFO, "gRPC server threadiness equals to " + std::to_string(s.config->m_grpc_threadiness) + "\n");
-		// TODO(fntlnz,leodido): when we want to spawn multiple threads we need to have a queue per thread, or implement
-		// different queuing mechanisms, round robin, fanout? What we want to achieve?
+		FALCO_LOG(falco_logger::level::INFO, "gRPC server threadiness equals to " + std::to_string(s.config->m_grpc_threadiness) + "\n");
 		s.grpc_server.init(
 			s.config->m_grpc_bind_address,
 			s.config->m_grpc_threadiness,
 			s.config->m_grpc_private_key,
 			s.config->m_grpc_cert_chain,
 			s.config->m_grpc_root_certs,
-			s.config->m_log_level
+			s.config->m_log_level,
+			s.config->m_grpc_contexts_per_thread,
+			s.config->m_grpc_cpus
 			);
+		if(s.config->m_grpc_rules_api)
+		{
+			s.grpc_server.set_rules_engine(s.engine);
+
+			// the syscalls collected by the kernel drivers and their
+			// prefilter follow the enabled rules, applied by the syscall
+			// source thread
+			bool live_update = s.config->m_base_syscalls_live_update
+				&& (s.is_kmod() || s.is_ebpf() || s.is_modern_ebpf());
+			if(live_update || s.kernel_prefilter_enabled)
+			{
+				s.grpc_server.set_rules_changed_callback([&s, live_update]
+				{
+					libsinsp::events::set<ppm_sc_code> sc_set;
+					if(live_update)
+					{
+						auto rules_sc_set = s.engine->sc_codes_for_ruleset(falco_common::syscall_source);
+						sc_set = select_sc_set(s, rules_sc_set);
+					}
+					bool drop_failed = s.kernel_prefilter_enabled
+						&& s.engine->kernel_prefilter_for_ruleset(falco_common::syscall_source).drop_failed_exit;
+					std::lock_guard<std::mutex> lk(s.pending_sc_set_mtx);
+					s.pending_sc_set = std::move(sc_set);
+					s.pending_kernel_drop_failed = drop_failed;
+					s.pending_sc_set_ready = true;
+				});
+			}
+		}
 		s.grpc_server_thread = std::thread([&s] {
 			s.grpc_server.run();
 		});
@@ -62,7 +91,7 @@ falco::app::run_result falco::app::actions::stop_grpc_server(falco::app::state&
 	{
 		if (s.options.dry_run)
 		{
-			falco_logger::log(falco_logger::level::DEBUG, "Skipping stopping gRPC server in dry-run\n");
+			FALCO_LOG(falco_logger::level::DEBUG, "Skipping stopping gRPC server in dry-run\n");
 			return run_result::ok();
 		}
 
@@ -31,13 +31,13 @@ falco::app::run_result falco::app::actions::start_webserver(falco::app::state& s
 	{
 		if (state.options.dry_run)
 		{
-			falco_logger::log(falco_logger::level::DEBUG, "Skipping starting webserver in dry-run\n");
+			FALCO_LOG(falco_logger::level::DEBUG, "Skipping starting webserver in dry-run\n");
 			return run_result::ok();
 		}
 
 		falco_configuration::webserver_config webserver_config = state.config->m_webserver_config;
 		std::string ssl_option = (webserver_config.m_ssl_enabled ? " (SSL)" : "");
-		falco_logger::log(falco_logger::level::INFO, "Starting health webserver with threadiness "
+		FALCO_LOG(falco_logger::level::INFO, "Starting health webserver with threadiness "
 			+ std::to_string(webserver_config.m_threadiness)
 			+ ", listening on "
 			+ webserver_config.m_listen_address
@@ -45,6 +45,10 @@ falco::app::run_result falco::app::actions::start_webserver(falco::app::state& s
 			+ std::to_string(webserver_config.m_listen_port)
 			+ ssl_option + "\n");
 
+		if (state.config->m_metrics_enabled && webserver_config.m_prometheus_metrics_enabled)
+		{
+			state.prometheus_metrics = std::make_shared<falco_metrics>(state);
+		}
 		state.webserver.start(
 			state,
 			webserver_config);
@@ -60,11 +64,12 @@ falco::app::run_result falco::app::actions::stop_webserver(falco::app::state& st
 	{
 		if (state.options.dry_run)
 		{
-			falco_logger::log(falco_logger::level::DEBUG, "Skipping stopping webserver in dry-run\n");
+			FALCO_LOG(falco_logger::level::DEBUG, "Skipping stopping webserver in dry-run\n");
 			return run_result::ok();
 		}
 
 		state.webserver.stop();
+		state.prometheus_metrics = nullptr;
 	}
 #endif
 	return run_result::ok();
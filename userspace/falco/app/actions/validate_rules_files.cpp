@@ -68,10 +68,10 @@ falco::app::run_result falco::app::actions::validate_rules_files(falco::app::sta
 		// printed when verbose is true.
 		std::string summary;
 
-		falco_logger::log(falco_logger::level::INFO, "Validating rules file(s):\n");
+		FALCO_LOG(falco_logger::level::INFO, "Validating rules file(s):\n");
 		for(const auto& file : s.options.validate_rules_filenames)
 		{
-			falco_logger::log(falco_logger::level::INFO, "   " + file + "\n");
+			FALCO_LOG(falco_logger::level::INFO, "   " + file + "\n");
 		}
 
 		// The json output encompasses all files so the
@@ -114,7 +114,7 @@ falco::app::run_result falco::app::actions::validate_rules_files(falco::app::sta
 				// file was ok with warnings, without actually
 				// printing the warnings.
 				summary += filename + ": Ok, with warnings";
-				falco_logger::log(falco_logger::level::WARNING, res->as_string(true, rc) + "\n");
+				FALCO_LOG(falco_logger::level::WARNING, res->as_string(true, rc) + "\n");
 			}
 		}
 
@@ -127,6 +127,13 @@ falco::app::run_result falco::app::actions::validate_rules_files(falco::app::sta
 			describe_res = s.engine->describe_rule(rptr, plugins);
 		}
 
+		// printout of `--rules-cost-report` option
+		nlohmann::json cost_res;
+		if (successful && s.options.print_rules_cost_report)
+		{
+			cost_res = s.engine->rules_cost_report();
+		}
+
 		if(s.config->m_json_output)
 		{
 			nlohmann::json res;
@@ -135,6 +142,10 @@ falco::app::run_result falco::app::actions::validate_rules_files(falco::app::sta
 			{
 				res["falco_describe_results"] = std::move(describe_res);
 			}
+			if (!cost_res.empty())
+			{
+				res["falco_cost_results"] = std::move(cost_res);
+			}
 			std::cout << res.dump() << std::endl;
 		}
 		else
@@ -145,6 +156,11 @@ falco::app::run_result falco::app::actions::validate_rules_files(falco::app::sta
 				std::cout << std::endl;
 				format_described_rules_as_text(describe_res, std::cout);
 			}
+			if (!cost_res.empty())
+			{
+				std::cout << std::endl;
+				format_rules_cost_report_as_text(cost_res, std::cout);
+			}
 		}
 
 		if(successful)
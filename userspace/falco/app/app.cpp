@@ -20,9 +20,17 @@ limitations under the License.
 #include "signals.h"
 #include "actions/actions.h"
 
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <map>
+#include <set>
+#include <vector>
+
 falco::atomic_signal_handler falco::app::g_terminate_signal;
 falco::atomic_signal_handler falco::app::g_restart_signal;
 falco::atomic_signal_handler falco::app::g_reopen_outputs_signal;
+falco::atomic_signal_handler falco::app::g_profile_signal;
 
 using app_action = std::function<falco::app::run_result(falco::app::state&)>;
 
@@ -53,42 +61,151 @@ bool falco::app::run(int argc, char** argv, bool& restart, std::string& errstr)
 	return falco::app::run(s, restart, errstr);
 }
 
+// A step of the app startup, run in order with the other ones unless it
+// runs in background. A background step starts in its own thread as soon as
+// the steps it depends on are done, so that it overlaps with the following
+// ones. Any step depending on a background step waits for it before running.
+struct app_step
+{
+	std::string name;
+	app_action func;
+	std::vector<std::string> deps = {};
+	bool background = false;
+};
+
+// Runs the startup steps, running the background ones in background only if
+// concurrent is set, and reports how long each step took, both in the logs
+// and in the startup report of the state
+static falco::app::run_result run_startup_steps(falco::app::state& s, const std::vector<app_step>& steps, bool concurrent)
+{
+	typedef std::chrono::steady_clock clock;
+	typedef std::pair<falco::app::run_result, clock::duration> timed_result;
+	auto run_timed = [&s](const app_step& step)
+	{
+		auto start = clock::now();
+		auto res = step.func(s);
+		return timed_result(res, clock::now() - start);
+	};
+
+	auto start = clock::now();
+	auto res = falco::app::run_result::ok();
+	std::set<std::string> done;
+	std::map<std::string, std::future<timed_result>> running;
+	std::vector<std::pair<std::string, clock::duration>> timings;
+	auto finish = [&](const std::string& name, const timed_result& r)
+	{
+		res = falco::app::run_result::merge(res, r.first);
+		timings.emplace_back(name, r.second);
+		s.startup->add_step(name, r.second);
+		done.insert(name);
+	};
+	auto wait = [&](const std::string& name)
+	{
+		auto it = running.find(name);
+		if(it != running.end())
+		{
+			finish(name, it->second.get());
+			running.erase(it);
+		}
+	};
+
+	for(const auto& step : steps)
+	{
+		for(const auto& bg : steps)
+		{
+			if(concurrent && bg.background && !done.count(bg.name) && !running.count(bg.name)
+				&& std::all_of(bg.deps.begin(), bg.deps.end(), [&done](const std::string& d) { return done.count(d) > 0; }))
+			{
+				running.emplace(bg.name, std::async(std::launch::async, run_timed, std::cref(bg)));
+			}
+		}
+		if(running.count(step.name) || done.count(step.name))
+		{
+			continue;
+		}
+
+		for(const auto& dep : step.deps)
+		{
+			wait(dep);
+		}
+		if(res.proceed)
+		{
+			finish(step.name, run_timed(step));
+		}
+		if(!res.proceed)
+		{
+			break;
+		}
+	}
+
+	// the steps exiting early still let the background ones finish
+	while(!running.empty())
+	{
+		wait(running.begin()->first);
+	}
+
+	if(res.proceed && !s.options.dry_run)
+	{
+		std::sort(timings.begin(), timings.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+		std::string slowest;
+		for(size_t i = 0; i < timings.size(); i++)
+		{
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timings[i].second).count();
+			FALCO_LOG(falco_logger::level::DEBUG, "Startup step " + timings[i].first + " took " + std::to_string(ms) + " (ms)\n");
+			if(i < 3 && ms > 0)
+			{
+				slowest += (slowest.empty() ? "" : ", ") + timings[i].first + " " + std::to_string(ms) + " (ms)";
+			}
+		}
+		auto elapsed = clock::now() - start;
+		s.startup->set_started(elapsed);
+		auto total = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+		FALCO_LOG(falco_logger::level::INFO, "Started in " + std::to_string(total) + " (ms)"
+			+ (slowest.empty() ? "" : ", slowest steps: " + slowest) + "\n");
+	}
+	return res;
+}
+
 bool falco::app::run(falco::app::state& s, bool& restart, std::string& errstr)
 {
 	// The order here is the order in which the methods will be
 	// called. Before changing the order, ensure that all
 	// dependencies are honored (e.g. don't process events before
-	// loading plugins, opening inspector, etc.).
-	std::list<app_action> run_steps = {
-		falco::app::actions::load_config,
-		falco::app::actions::print_help,
-		falco::app::actions::print_kernel_version,
-		falco::app::actions::print_version,
-		falco::app::actions::print_page_size,
-		falco::app::actions::print_generated_gvisor_config,
-		falco::app::actions::print_ignored_events,
-		falco::app::actions::print_syscall_events,
-		falco::app::actions::require_config_file,
-		falco::app::actions::print_plugin_info,
-		falco::app::actions::list_plugins,
-		falco::app::actions::load_plugins,
-		falco::app::actions::init_inspectors,
-		falco::app::actions::init_falco_engine,
-		falco::app::actions::list_fields,
-		falco::app::actions::select_event_sources,
-		falco::app::actions::validate_rules_files,
-		falco::app::actions::load_rules_files,
-		falco::app::actions::print_support,
-		falco::app::actions::init_outputs,
-		falco::app::actions::create_signal_handlers,
-		falco::app::actions::create_requested_paths,
-		falco::app::actions::pidfile,
-		falco::app::actions::configure_interesting_sets,
-		falco::app::actions::configure_syscall_buffer_size,
-		falco::app::actions::configure_syscall_buffer_num,
-		falco::app::actions::start_grpc_server,
-		falco::app::actions::start_webserver,
-		falco::app::actions::process_events,
+	// loading plugins, opening inspector, etc.). The background steps
+	// start as soon as their dependencies are done instead, and the steps
+	// depending on them wait for them.
+	std::vector<app_step> startup_steps = {
+		{"load_config", falco::app::actions::load_config},
+		{"print_help", falco::app::actions::print_help},
+		{"print_kernel_version", falco::app::actions::print_kernel_version},
+		{"print_version", falco::app::actions::print_version},
+		{"print_page_size", falco::app::actions::print_page_size},
+		{"print_generated_gvisor_config", falco::app::actions::print_generated_gvisor_config},
+		{"print_ignored_events", falco::app::actions::print_ignored_events},
+		{"print_syscall_events", falco::app::actions::print_syscall_events},
+		{"require_config_file", falco::app::actions::require_config_file},
+		{"print_plugin_info", falco::app::actions::print_plugin_info},
+		{"list_plugins", falco::app::actions::list_plugins},
+		{"load_plugins", falco::app::actions::load_plugins},
+		{"init_inspectors", falco::app::actions::init_inspectors},
+		{"init_falco_engine", falco::app::actions::init_falco_engine},
+		{"list_fields", falco::app::actions::list_fields},
+		{"select_event_sources", falco::app::actions::select_event_sources},
+		{"validate_rules_files", falco::app::actions::validate_rules_files},
+		{"load_rules_files", falco::app::actions::load_rules_files},
+		{"print_support", falco::app::actions::print_support},
+		// note: the outputs only need the config, and the engine to
+		// set the format of the rule outputs before they are completed
+		{"init_outputs", falco::app::actions::init_outputs, {"list_plugins"}, true},
+		{"create_signal_handlers", falco::app::actions::create_signal_handlers, {"init_outputs"}},
+		{"create_requested_paths", falco::app::actions::create_requested_paths},
+		{"pidfile", falco::app::actions::pidfile},
+		{"configure_interesting_sets", falco::app::actions::configure_interesting_sets},
+		{"print_syscall_cost_report", falco::app::actions::print_syscall_cost_report},
+		{"configure_syscall_buffer_size", falco::app::actions::configure_syscall_buffer_size},
+		{"configure_syscall_buffer_num", falco::app::actions::configure_syscall_buffer_num},
+		{"start_grpc_server", falco::app::actions::start_grpc_server},
+		{"start_webserver", falco::app::actions::start_webserver, {"init_outputs"}},
 	};
 
 	std::list<app_action> teardown_steps = {
@@ -98,13 +215,37 @@ bool falco::app::run(falco::app::state& s, bool& restart, std::string& errstr)
 		falco::app::actions::close_inspectors,
 	};
 
-	falco::app::run_result res = falco::app::run_result::ok();
-	for (const auto &func : run_steps)
+	// the options printing information and exiting along the way need the
+	// steps to run in order, as the background ones would start for nothing
+	bool concurrent = !s.options.list_fields
+		&& s.options.validate_rules_filenames.empty()
+		&& !s.options.describe_all_rules
+		&& s.options.describe_rule.empty()
+		&& !s.options.print_rules_memory_report
+		&& s.options.compile_rules_filename.empty()
+		&& !s.options.print_support
+		&& !s.options.print_syscall_cost_report;
+	falco::app::run_result res = run_startup_steps(s, startup_steps, concurrent);
+	if(res.proceed)
 	{
-		res = falco::app::run_result::merge(res, func(s));
-		if(!res.proceed)
+		res = falco::app::run_result::merge(res, falco::app::actions::process_events(s));
+	}
+
+	// restarts that allow it keep the inspectors open and only reload the
+	// configuration, the rules and the outputs before processing events again
+	std::list<app_action> hot_reload_steps = {
+		falco::app::actions::hot_reload,
+		falco::app::actions::process_events,
+	};
+	while(res.proceed && s.restart)
+	{
+		for (const auto &func : hot_reload_steps)
 		{
-			break;
+			res = falco::app::run_result::merge(res, func(s));
+			if(!res.proceed)
+			{
+				break;
+			}
 		}
 	}
 
@@ -98,7 +98,7 @@ bool options::parse(int argc, char **argv, std::string &errstr)
 	// Convert the vectors of enabled/disabled tags into sets to match falco engine API
 	if(m_cmdline_parsed.count("T") > 0)
 	{
-		falco_logger::log(falco_logger::level::WARNING, "The -T option is deprecated and will be removed in Falco 0.39.0. Use -o rules[].disable.tag=<tag> instead.");
+		FALCO_LOG(falco_logger::level::WARNING, "The -T option is deprecated and will be removed in Falco 0.39.0. Use -o rules[].disable.tag=<tag> instead.");
 		for(auto &tag : m_cmdline_parsed["T"].as<std::vector<std::string>>())
 		{
 			disabled_rule_tags.insert(tag);
@@ -107,7 +107,7 @@ bool options::parse(int argc, char **argv, std::string &errstr)
 
 	if(m_cmdline_parsed.count("t") > 0)
 	{
-		falco_logger::log(falco_logger::level::WARNING, "The -t option is deprecated and will be removed in Falco 0.39.0. Use -o rules[].disable.rule=* -o rules[].enable.tag=<tag> instead.");
+		FALCO_LOG(falco_logger::level::WARNING, "The -t option is deprecated and will be removed in Falco 0.39.0. Use -o rules[].disable.rule=* -o rules[].enable.tag=<tag> instead.");
 		for(auto &tag : m_cmdline_parsed["t"].as<std::vector<std::string>>())
 		{
 			enabled_rule_tags.insert(tag);
@@ -116,7 +116,7 @@ bool options::parse(int argc, char **argv, std::string &errstr)
 
 	if(disabled_rule_substrings.size() > 0)
 	{
-		falco_logger::log(falco_logger::level::WARNING, "The -D option is deprecated and will be removed in Falco 0.39.0. Use -o rules[].disable.rule=<wildcard-pattern> instead.");
+		FALCO_LOG(falco_logger::level::WARNING, "The -D option is deprecated and will be removed in Falco 0.39.0. Use -o rules[].disable.rule=<wildcard-pattern> instead.");
 	}
 
 	// Some combinations of arguments are not allowed.
@@ -156,6 +156,7 @@ void options::define(cxxopts::Options& opts)
 #endif
 		("disable-source",                "Turn off a specific <event_source>. By default, all loaded sources get enabled. Available sources are 'syscall' plus all sources defined by loaded plugins supporting the event sourcing capability. This option can be passed multiple times, but turning off all event sources simultaneously is not permitted. This option can not be mixed with --enable-source. This option has no effect when reproducing events from a capture file.", cxxopts::value(disable_sources), "<event_source>")
 		("dry-run",                       "Run Falco without processing events. It can help check that the configuration and rules do not have any errors.", cxxopts::value(dry_run)->default_value("false"))
+		("compile-rules",                 "Load the rules files, write them compiled in a rules bundle at <path>, and exit. The bundle can then be loaded instead of the rules files by Falco instances of the same version and with the same plugins, see rules_bundle in falco.yaml.", cxxopts::value(compile_rules_filename), "<path>")
 		("D",                             "DEPRECATED: use -o rules[].disable.rule=<wildcard-pattern> instead. Turn off any rules with names having the substring <substring>. This option can be passed multiple times. It cannot be mixed with -t.", cxxopts::value(disabled_rule_substrings), "<substring>")
 		("enable-source",                 "Enable a specific <event_source>. By default, all loaded sources get enabled. Available sources are 'syscall' plus all sources defined by loaded plugins supporting the event sourcing capability. This option can be passed multiple times. When using this option, only the event sources specified by it will be enabled. This option can not be mixed with --disable-source. This option has no effect when reproducing events from a capture file.", cxxopts::value(enable_sources), "<event_source>")
 #ifdef HAS_GVISOR
@@ -175,7 +176,10 @@ void options::define(cxxopts::Options& opts)
 		("p,print",                       "Print (or replace) additional information in the rule's output.\nUse -pc or -pcontainer to append container details to syscall events.\nUse -pk or -pkubernetes to add both container and Kubernetes details to syscall events.\nIf using gVisor, choose -pcg or -pkg variants (or -pcontainer-gvisor and -pkubernetes-gvisor, respectively).\nIf a syscall rule's output contains %container.info, it will be replaced with the corresponding details. Otherwise, these details will be directly appended to the rule's output.\nAlternatively, use -p <output_format> for a custom format. In this case, the given <output_format> will be appended to the rule's output without any replacement to all events, including plugin events.", cxxopts::value(print_additional), "<output_format>")
 		("P,pidfile",                     "Write PID to specified <pid_file> path. By default, no PID file is created.", cxxopts::value(pidfilename)->default_value(""), "<pid_file>")
 		("r",                             "Rules file or directory to be loaded. This option can be passed multiple times. Falco defaults to the values in the configuration file when this option is not specified.", cxxopts::value<std::vector<std::string>>(), "<rules_file>")
+		("rules-cost-report",             "Print an estimate of the evaluation cost of each rule when used in conjunction with the -V option, once the rules files are valid: the predicates of its condition once macros, lists and exceptions are expanded, the values of its lists, its expensive operators (e.g. glob, regex) and fields (e.g. proc.aname), and the number of event types it is evaluated on. The rules likely to be hot are flagged and listed first. If json_output is set to true, the report is included in the JSON output. It has no effect when used with other options.", cxxopts::value(print_rules_cost_report)->default_value("false"))
+		("rules-memory-report",           "Load the rules, print an estimate of the memory used by the rules loader, the compiled rules, their filters, and the ruleset of each event source, and exit. If json_output is set to true, the report is printed in JSON format.", cxxopts::value(print_rules_memory_report)->default_value("false"))
 		("S,snaplen",                     "Collect only the first <len> bytes of each I/O buffer for 'syscall' events. By default, the first 80 bytes are collected by the driver and sent to the user space for processing. Use this option with caution since it can have a strong performance impact.", cxxopts::value(snaplen)->default_value("0"), "<len>")
+		("syscall-cost-report",           "Load the rules, print the syscalls selected for the enabled rules of the 'syscall' source along with the rules needing each of them, the syscalls that each rule alone pulls in, and exit. Syscalls needed by the state engine are never attributed to a rule. See metrics.syscall_cost_enabled to measure the events of each rule at runtime. If json_output is set to true, the report is printed in JSON format.", cxxopts::value(print_syscall_cost_report)->default_value("false"))
 		("support",                       "Print support information, including version, rules files used, loaded configuration, etc., and exit. The output is in JSON format.", cxxopts::value(print_support)->default_value("false"))
 		("T",                             "DEPRECATED: use -o rules[].disable.tag=<tag> instead. Turn off any rules with a tag=<tag>. This option can be passed multiple times. This option can not be mixed with -t.", cxxopts::value<std::vector<std::string>>(), "<tag>")
 		("t",                             "DEPRECATED: use -o rules[].disable.rule=* -o rules[].enable.tag=<tag> instead. Only enable those rules with a tag=<tag>. This option can be passed multiple times. This option can not be mixed with -T/-D.", cxxopts::value<std::vector<std::string>>(), "<tag>")
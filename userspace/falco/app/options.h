@@ -65,6 +65,10 @@ public:
 	std::string pidfilename;
 	// Rules list as passed by the user, via cmdline option '-r'
 	std::list<std::string> rules_filenames;
+	bool print_rules_memory_report = false;
+	std::string compile_rules_filename;
+	bool print_rules_cost_report = false;
+	bool print_syscall_cost_report = false;
 	uint64_t snaplen = 0;
 	bool print_support = false;
 	std::set<std::string> disabled_rule_tags;
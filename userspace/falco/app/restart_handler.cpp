@@ -18,6 +18,11 @@ limitations under the License.
 #include "restart_handler.h"
 #include "signals.h"
 #include "logger.h"
+#include "thread_affinity.h"
+#include "falco_utils.h"
+
+#include <algorithm>
+#include <filesystem>
 
 #include <string.h>
 #include <fcntl.h>
@@ -66,7 +71,8 @@ bool falco::app::restart_handler::start(std::string& err)
             err = "could not watch file: " + f;
             return false;
         }
-        falco_logger::log(falco_logger::level::DEBUG, "Watching file '" + f +"'\n");
+        m_file_watches[wd] = f;
+        FALCO_LOG(falco_logger::level::DEBUG, "Watching file '" + f +"'\n");
     }
 
     for (const auto &f : m_watched_dirs)
@@ -77,7 +83,8 @@ bool falco::app::restart_handler::start(std::string& err)
             err = "could not watch directory: " + f;
             return false;
         }
-        falco_logger::log(falco_logger::level::DEBUG, "Watching directory '" + f +"'\n");
+        m_dir_listings[f] = list_dir(f);
+        FALCO_LOG(falco_logger::level::DEBUG, "Watching directory '" + f +"'\n");
     }
 
     // launch the watcher thread
@@ -99,12 +106,13 @@ void falco::app::restart_handler::stop()
 
 void falco::app::restart_handler::watcher_loop() noexcept
 {
+    falco::thread_affinity::apply(falco::thread_affinity::WATCHERS);
 #ifdef __linux__
     if (fcntl(m_inotify_fd, F_SETOWN, gettid()) < 0)
     {
         // an error occurred, we can't recover
         // todo(jasondellaluce): should we terminate the process?
-        falco_logger::log(falco_logger::level::ERR, "Failed owning inotify handler, shutting down watcher...");
+        FALCO_LOG(falco_logger::level::ERR, "Failed owning inotify handler, shutting down watcher...");
         return;
     }
 
@@ -129,7 +137,7 @@ void falco::app::restart_handler::watcher_loop() noexcept
         {
             // an error occurred, we can't recover
             // todo(jasondellaluce): should we terminate the process?
-            falco_logger::log(falco_logger::level::ERR, "Failed select with inotify handler, shutting down watcher...");
+            FALCO_LOG(falco_logger::level::ERR, "Failed select with inotify handler, shutting down watcher...");
             return;
         }
         
@@ -167,17 +175,9 @@ void falco::app::restart_handler::watcher_loop() noexcept
             continue;
         }
 
-        // at this point, we either received a new inotify event or a forced
-        // restart. If this happened during a dry run (even if the dry run
-        // was successful), or during a timeout wait since the last successful
-        // dry run before a restart, we dismiss the restart attempt and
-        // perform an additional dry-run for safety purposes (the new inotify
-        // events may be related to bad config/rules files changes).
-        should_restart = false;
-        should_check = false;
-
         // if there's date on the inotify fd, consume it
         // (even if there is a forced request too)
+        bool changed = forced;
         if (rv > 0)
         {
             // note: if available data is less than buffer size, this should
@@ -189,7 +189,7 @@ void falco::app::restart_handler::watcher_loop() noexcept
             {
                 // an error occurred, we can't recover
                 // todo(jasondellaluce): should we terminate the process?
-                falco_logger::log(falco_logger::level::ERR, "Failed read with inotify handler, shutting down watcher...");
+                FALCO_LOG(falco_logger::level::ERR, "Failed read with inotify handler, shutting down watcher...");
                 return;
             }
             // this is an odd case, but if we got here with
@@ -206,8 +206,30 @@ void falco::app::restart_handler::watcher_loop() noexcept
                     continue;
                 }
             }
+            else
+            {
+                rewatch_files(buf, n);
+                changed = changed || contents_changed();
+            }
+        }
+
+        // the files were touched or rewritten as they are, as config
+        // management tools often do, which doesn't require a restart
+        if (!changed)
+        {
+            FALCO_LOG(falco_logger::level::DEBUG, "The contents of the watched files didn't change, skipping the restart check\n");
+            continue;
         }
 
+        // at this point, we either received a change or a forced restart.
+        // If this happened during a dry run (even if the dry run
+        // was successful), or during a timeout wait since the last successful
+        // dry run before a restart, we dismiss the restart attempt and
+        // perform an additional dry-run for safety purposes (the new inotify
+        // events may be related to bad config/rules files changes).
+        should_restart = false;
+        should_check = false;
+
         // we consumed the new inotify events or we received a forced
         // restart request, so we'll perform a dry run after the
         // next timeout.
@@ -215,3 +237,65 @@ void falco::app::restart_handler::watcher_loop() noexcept
     }
 #endif
 }
+
+void falco::app::restart_handler::rewatch_files(const uint8_t* buf, size_t len)
+{
+#ifdef __linux__
+    // replacing a file by renaming another one over it removes the watch
+    // of the replaced one, so its path is watched again
+    for (size_t off = 0; off < len;)
+    {
+        auto ev = reinterpret_cast<const struct inotify_event*>(buf + off);
+        off += sizeof(struct inotify_event) + ev->len;
+        auto it = m_file_watches.find(ev->wd);
+        if (!(ev->mask & IN_IGNORED) || it == m_file_watches.end())
+        {
+            continue;
+        }
+        auto path = it->second;
+        m_file_watches.erase(it);
+        auto wd = inotify_add_watch(m_inotify_fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+        if (wd >= 0)
+        {
+            m_file_watches[wd] = path;
+        }
+    }
+#endif
+}
+
+bool falco::app::restart_handler::contents_changed() const
+{
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+    for (const auto& f : m_watched_files)
+    {
+        auto it = m_watched_sums.find(f);
+        if (it == m_watched_sums.end()
+            || it->second.get() != falco::utils::calculate_file_sha256sum(f))
+        {
+            return true;
+        }
+    }
+    for (const auto& d : m_dir_listings)
+    {
+        if (list_dir(d.first) != d.second)
+        {
+            return true;
+        }
+    }
+    return false;
+#else
+    return true;
+#endif
+}
+
+std::vector<std::string> falco::app::restart_handler::list_dir(const std::string& path)
+{
+    std::vector<std::string> res;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec))
+    {
+        res.push_back(entry.path().filename().string());
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
@@ -17,11 +17,15 @@ limitations under the License.
 
 #pragma once
 
+#include <cstdint>
 #include <thread>
 #include <atomic>
 #include <vector>
 #include <string>
 #include <functional>
+#include <unordered_map>
+
+#include "file_sha256sums.h"
 
 namespace falco
 {
@@ -46,16 +50,26 @@ public:
      */
     using watch_list_t = std::vector<std::string>;
 
+    /**
+     * @brief The SHA-256 sums of the contents of the watched files as they
+     * were loaded. The changes of the files with a known sum only trigger a
+     * restart if their contents differ, so that touching or rewriting them
+     * as they are doesn't.
+     */
+    using watch_sums_t = std::unordered_map<std::string, falco::file_sha256sums::sum>;
+
     explicit restart_handler(
         on_check_t on_check,
         const watch_list_t& watch_files = {},
-        const watch_list_t& watch_dirs = {})
+        const watch_list_t& watch_dirs = {},
+        const watch_sums_t& watch_sums = {})
             : m_inotify_fd(-1),
               m_stop(false),
               m_forced(false),
               m_on_check(on_check),
               m_watched_dirs(watch_dirs),
-              m_watched_files(watch_files) { }
+              m_watched_files(watch_files),
+              m_watched_sums(watch_sums) { }
     virtual ~restart_handler();
 
     bool start(std::string& err);
@@ -64,6 +78,9 @@ public:
 
 private:
     void watcher_loop() noexcept;
+    void rewatch_files(const uint8_t* buf, size_t len);
+    bool contents_changed() const;
+    static std::vector<std::string> list_dir(const std::string& path);
 
     int m_inotify_fd;
     std::thread m_watcher;
@@ -72,6 +89,9 @@ private:
     on_check_t m_on_check;
     watch_list_t m_watched_dirs;
     watch_list_t m_watched_files;
+    watch_sums_t m_watched_sums;
+    std::unordered_map<int, std::string> m_file_watches;
+    std::unordered_map<std::string, std::vector<std::string>> m_dir_listings;
 };
 
 }; // namespace app
@@ -25,6 +25,7 @@ namespace app {
 extern atomic_signal_handler g_terminate_signal;
 extern atomic_signal_handler g_restart_signal;
 extern atomic_signal_handler g_reopen_outputs_signal;
+extern atomic_signal_handler g_profile_signal;
 
 }; // namespace app
 }; // namespace falco
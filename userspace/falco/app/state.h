@@ -22,7 +22,22 @@ limitations under the License.
 #include "options.h"
 #include "restart_handler.h"
 #include "../configuration.h"
+#include "../event_stages.h"
+#include "../event_types.h"
+#include "../event_fast_path.h"
+#include "../buffer_autosizer.h"
+#include "../container_budgets.h"
+#include "../drop_trends.h"
+#include "../idle_backoff.h"
+#include "../flight_recorder.h"
+#include "../gvisor_sandboxes.h"
+#include "../load_shedder.h"
 #include "../stats_writer.h"
+#include "../syscall_cost.h"
+#include "../thread_table_sizer.h"
+#include "../source_monitor.h"
+#include "../startup_report.h"
+#include "../profiler.h"
 #if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
 #include "../grpc_server.h"
 #include "../webserver.h"
@@ -33,6 +48,7 @@ limitations under the License.
 #include <string>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <unordered_set>
 
 namespace falco {
@@ -48,7 +64,9 @@ struct state
     // Holds the info mapped for each loaded event source
     struct source_info
     {
-        source_info() : filterchecks(std::make_shared<filter_check_list>()) {}
+        source_info() :
+            filterchecks(std::make_shared<filter_check_list>()),
+            stages(std::make_shared<falco::event_stages>()) {}
 
         // The index of the given event source in the state's falco_engine,
         // as returned by falco_engine::add_source
@@ -61,12 +79,59 @@ struct state
         // source is a plugin one, the assigned inspector must have that
         // plugin registered in its plugin manager
         std::shared_ptr<sinsp> inspector;
+        // Whether the inspector is open and capturing, which is kept so
+        // across hot reloads, only set in live mode
+        bool opened = false;
+        // The time spent by the processing loop of the source in each
+        // stage, only recorded in live mode if metrics.event_stages_enabled
+        std::shared_ptr<falco::event_stages> stages;
+        // How the processing loop of the source waits when it has no
+        // event to process, only set if idle_backoff.enabled
+        std::shared_ptr<falco::idle_backoff> idle_backoff;
+        // Which events of the source skip the rules when the kernel drops
+        // events, only set for the syscall source if load_shedding.enabled
+        std::shared_ptr<falco::load_shedder> load_shedder;
+        // The event and alert budgets of the containers, only set for the
+        // syscall source in live mode if container_budgets.enabled
+        std::shared_ptr<falco::container_budgets> container_budgets;
+        // Which syscall buffer size is recommended given the events dropped
+        // by the kernel, only set for the syscall source if
+        // syscall_buf_size_autosize.enabled
+        std::shared_ptr<falco::buffer_autosizer> buffer_autosizer;
+        // The recent events dropped by the kernel in each category, only set
+        // for the syscall source if metrics with kernel event counters are
+        // enabled
+        std::shared_ptr<falco::drop_trends> drop_trends;
+        // The events of the source attributed to the rules needing them,
+        // only set for the syscall source if metrics.syscall_cost_enabled
+        std::shared_ptr<falco::syscall_cost> syscall_cost;
+        // The events of the source and the time spent on them by the
+        // engine by event type, only set in live mode if
+        // metrics.event_types_enabled
+        std::shared_ptr<falco::event_types> event_types;
+        // Which events of the source skip the rules as no enabled rule
+        // needs their type, only set for the syscall source in live mode
+        std::shared_ptr<falco::event_fast_path> fast_path;
+        // The size and the metrics of the thread table of the inspector,
+        // only set for the syscall source in live mode
+        std::shared_ptr<falco::thread_table_sizer> thread_table;
+        // The progress of the processing loop of the source, watched for
+        // stalls by a monitor thread, only set in live mode
+        std::shared_ptr<falco::source_monitor::heartbeat> heartbeat;
+        // The recent events of the source, dumped to a capture file around
+        // some alerts, only set in live mode if flight_recorder.enabled
+        std::shared_ptr<falco::flight_recorder> flight_recorder;
+        // The events of each gVisor sandbox by shard, starting with the
+        // one of this inspector, only set for the syscall source in live
+        // mode with gVisor
+        std::vector<std::shared_ptr<falco::gvisor_sandboxes>> gvisor_shards;
     };
 
     state():
         config(std::make_shared<falco_configuration>()),
         engine(std::make_shared<falco_engine>()),
-        offline_inspector(std::make_shared<sinsp>())
+        offline_inspector(std::make_shared<sinsp>()),
+        startup(std::make_shared<falco::startup_report>())
     {
     }
 
@@ -79,10 +144,18 @@ struct state
     std::string cmdline;
     falco::app::options options;
     std::atomic<bool> restart = false;
+    // Whether this is the dry run validating a restart, whose loaded rules
+    // are then handed over to the restarted app
+    bool validating_restart = false;
 
 
     std::shared_ptr<falco_configuration> config;
     std::shared_ptr<falco_outputs> outputs;
+    // exports the metrics and the traces of the alerts with OTLP, if enabled
+    std::shared_ptr<falco::otlp_exporter> otlp;
+    // the recent alerts served by the webserver, if enabled, which are
+    // kept when the outputs are reloaded
+    std::shared_ptr<falco::outputs::recent_alerts> recent_alerts;
     std::shared_ptr<falco_engine> engine;
 
     // The set of loaded event sources (by default, the syscall event
@@ -110,17 +183,40 @@ struct state
     // Set of syscalls we want the driver to capture
     libsinsp::events::set<ppm_sc_code> selected_sc_set;
 
+    // Whether base_syscalls.kernel_prefilter applies to the driver in
+    // use, and whether failed syscall exit events are currently dropped
+    // in the kernel because all the enabled rules require a success.
+    bool kernel_prefilter_enabled = false;
+    bool kernel_prefilter_drop_failed = false;
+
+    // Set of syscalls and kernel prefilter recomputed after the enabled
+    // rules changed at runtime, waiting to be applied by the syscall source
+    // thread. The flag lets that thread check for a change without locking.
+    std::mutex pending_sc_set_mtx;
+    std::atomic<bool> pending_sc_set_ready = false;
+    libsinsp::events::set<ppm_sc_code> pending_sc_set;
+    bool pending_kernel_drop_failed = false;
+
     // Dimension of the syscall buffer in bytes.
     uint64_t syscall_buffer_bytes_size = DEFAULT_DRIVER_BUFFER_BYTES_DIM;
 
+    // Where the startup time went, and whether the first events have
+    // been processed, served by the webserver
+    std::shared_ptr<falco::startup_report> startup;
+
     // Helper responsible for watching of handling hot application restarts
     std::shared_ptr<restart_handler> restarter;
 
+    // Runs the sessions of the sampling profiler, if enabled
+    std::shared_ptr<falco::profiler> profiler;
+
 #if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
     falco::grpc::server grpc_server;
     std::thread grpc_server_thread;
 
     falco_webserver webserver;
+    // the metrics served by the webserver, published by the stats writer
+    std::shared_ptr<falco_metrics> prometheus_metrics;
 #endif
 
     inline bool is_capture_mode() const
@@ -128,6 +224,13 @@ struct state
         return config->m_engine_mode == engine_kind_t::REPLAY;
     }
 
+    // Whether a restart keeps the inspectors open when the configuration
+    // changes allow it, see falco::app::actions::hot_reload
+    inline bool is_hot_reload_enabled() const
+    {
+        return config->m_hot_reload_keep_inspectors && !is_capture_mode() && !options.dry_run;
+    }
+
     inline bool is_gvisor() const
     {
         return config->m_engine_mode == engine_kind_t::GVISOR;
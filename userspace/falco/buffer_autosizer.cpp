@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "buffer_autosizer.h"
+
+#include <algorithm>
+
+falco::buffer_autosizer::buffer_autosizer(int16_t preset, int16_t max_preset, double drop_rate, uint32_t drop_intervals)
+	: m_preset(preset),
+	  m_max_preset(std::max(preset, max_preset)),
+	  m_drop_rate(drop_rate),
+	  m_drop_intervals_per_step(std::max<uint32_t>(drop_intervals, 1)),
+	  m_recommended_preset(preset)
+{
+}
+
+bool falco::buffer_autosizer::update(uint64_t n_evts, uint64_t n_drops)
+{
+	// note: the number of events includes the dropped ones
+	if(n_drops == 0 || n_evts == 0 || (double)n_drops / n_evts <= m_drop_rate)
+	{
+		return false;
+	}
+
+	m_drop_intervals.fetch_add(1, std::memory_order_relaxed);
+	auto recommended = m_recommended_preset.load(std::memory_order_relaxed);
+	if(recommended >= m_max_preset || ++m_drop_intervals_since_step < m_drop_intervals_per_step)
+	{
+		return false;
+	}
+	m_drop_intervals_since_step = 0;
+	m_recommended_preset.store(recommended + 1, std::memory_order_relaxed);
+	return true;
+}
+
+uint64_t falco::buffer_autosizer::preset_bytes(int16_t preset)
+{
+	// preset 1 is 1 MB, and each one doubles the previous
+	return preset > 0 ? uint64_t(1) << (19 + preset) : 0;
+}
+
+void falco::buffer_autosizer::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["buf_size.preset"] = m_preset;
+	metrics["buf_size.recommended_preset"] = recommended_preset();
+	metrics["buf_size.drop_intervals"] = drop_intervals();
+}
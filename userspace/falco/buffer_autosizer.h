@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace falco
+{
+
+/*!
+	\brief Recommends a larger syscall buffer size preset when the kernel
+	keeps dropping events. The drop rate is given once per interval, and
+	every drop_intervals intervals in which it is above drop_rate, which
+	don't need to be consecutive since drops usually come in bursts, the
+	recommended preset grows by one, up to max_preset. The buffers can't
+	be resized while open, so the recommendation is meant to be logged and
+	applied the next time they are opened. The recommendation is updated
+	by the thread of the syscall source, and can be read from any thread.
+*/
+class buffer_autosizer
+{
+public:
+	buffer_autosizer(int16_t preset, int16_t max_preset, double drop_rate, uint32_t drop_intervals);
+
+	/*!
+		\brief Accounts the number of events and drops of the last
+		interval. Returns true if the recommended preset grew.
+	*/
+	bool update(uint64_t n_evts, uint64_t n_drops);
+
+	inline int16_t preset() const
+	{
+		return m_preset;
+	}
+
+	inline int16_t recommended_preset() const
+	{
+		return m_recommended_preset.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t drop_intervals() const
+	{
+		return m_drop_intervals.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the size in bytes of the buffer of each CPU for
+		the given preset
+	*/
+	static uint64_t preset_bytes(int16_t preset);
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	int16_t m_preset;
+	int16_t m_max_preset;
+	double m_drop_rate;
+	uint32_t m_drop_intervals_per_step;
+
+	// only used by the thread of the source
+	uint32_t m_drop_intervals_since_step = 0;
+
+	std::atomic<int16_t> m_recommended_preset;
+	std::atomic<uint64_t> m_drop_intervals{0};
+};
+
+} // namespace falco
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "capture_files.h"
+
+#include <algorithm>
+#include <filesystem>
+
+bool falco::capture_files::list(const std::vector<std::string>& paths, std::vector<std::string>& files, std::string& err)
+{
+	for(const auto& path : paths)
+	{
+		std::error_code ec;
+		if(!std::filesystem::is_directory(path, ec))
+		{
+			if(!std::filesystem::exists(path, ec))
+			{
+				err = "Capture file " + path + " does not exist";
+				return false;
+			}
+			files.push_back(path);
+			continue;
+		}
+
+		std::vector<std::string> dir_files;
+		for(std::filesystem::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec))
+		{
+			if(it->path().extension() == extension && it->is_regular_file(ec))
+			{
+				dir_files.push_back(it->path().string());
+			}
+		}
+		if(ec)
+		{
+			err = "Could not list the capture files of directory " + path + ": " + ec.message();
+			return false;
+		}
+		std::sort(dir_files.begin(), dir_files.end());
+		files.insert(files.end(), dir_files.begin(), dir_files.end());
+	}
+	return true;
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief The capture files replayed by a run, as configured with
+	engine.replay.capture_file and engine.replay.capture_files
+*/
+namespace capture_files
+{
+
+// the extension of the capture files listed in directories
+constexpr const char* extension = ".scap";
+
+/*!
+	\brief Appends to files the capture files at the given paths, in order.
+	A path is either a capture file or a directory, whose regular files
+	with the capture file extension are listed sorted by name, without
+	descending into its subdirectories. Returns false and sets err if a
+	path doesn't exist or can't be listed.
+*/
+bool list(const std::vector<std::string>& paths, std::vector<std::string>& files, std::string& err);
+
+} // namespace capture_files
+} // namespace falco
@@ -48,33 +48,60 @@ static re2::RE2 ip_address_re("((^\\s*((([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|
 #define DEFAULT_DROP_FAILED_EXIT false
 
 falco_configuration::falco_configuration():
+	m_rules_compile_threads(1),
+	m_rules_fast_load(false),
+	m_rule_state_max_memory(16 * 1024 * 1024),
+	m_rules_cache_enabled(false),
+	m_rules_release_loading_state(false),
+	m_rules_arena_hugepages(false),
 	m_json_output(false),
 	m_json_include_output_property(true),
 	m_json_include_tags_property(true),
 	m_rule_matching(falco_common::rule_matching::FIRST),
+	m_rule_matching_adaptive_ordering_enabled(false),
+	m_rule_matching_adaptive_ordering_interval(30000),
 	m_watch_config_files(true),
+	m_hot_reload_keep_inspectors(true),
 	m_buffered_outputs(false),
 	m_outputs_queue_capacity(DEFAULT_OUTPUTS_QUEUE_CAPACITY_UNBOUNDED_MAX_LONG_VALUE),
+	m_outputs_queue_priority_reserve(25),
+	m_outputs_queue_max_bytes(0),
+	m_outputs_queue_deferred_formatting(false),
 	m_time_format_iso_8601(false),
 	m_output_timeout(2000),
 	m_grpc_enabled(false),
 	m_grpc_threadiness(0),
+	m_grpc_contexts_per_thread(10),
+	m_grpc_rules_api(false),
 	m_webserver_enabled(false),
 	m_syscall_evt_drop_threshold(.1),
 	m_syscall_evt_drop_rate(.03333),
 	m_syscall_evt_drop_max_burst(1),
 	m_syscall_evt_simulate_drops(false),
 	m_syscall_evt_timeout_max_consecutives(1000),
+	m_syscall_evt_timeout_max_stall_ms(10000),
 	m_falco_libs_thread_table_size(DEFAULT_FALCO_LIBS_THREAD_TABLE_SIZE),
 	m_base_syscalls_repair(false),
+	m_base_syscalls_live_update(false),
+	m_base_syscalls_kernel_prefilter(false),
 	m_metrics_enabled(false),
 	m_metrics_interval_str("5000"),
 	m_metrics_interval(5000),
+	m_metrics_ticker_thread(false),
 	m_metrics_stats_rule_enabled(false),
 	m_metrics_output_file(""),
 	m_metrics_flags(0),
 	m_metrics_convert_memory_to_mb(true),
-	m_metrics_include_empty_values(false)
+	m_metrics_include_empty_values(false),
+	m_metrics_rules_profiling_enabled(false),
+	m_metrics_rules_profiling_sampling_period(128),
+	m_metrics_event_stages_enabled(true),
+	m_metrics_syscall_cost_enabled(false),
+	m_metrics_event_types_enabled(false),
+	m_metrics_rules_series_max(0),
+	m_plugin_sources_threads(0),
+	m_plugin_event_batch_size(64),
+	m_idle_backoff_enabled(false)
 {
 }
 
@@ -108,6 +135,58 @@ std::string falco_configuration::dump()
 	return config.dump();
 }
 
+// The settings only read when loading the rules and creating the outputs,
+// besides the ones of the logs that are applied when loading the config and
+// the thread table size that the syscall source thread applies afterwards
+static const std::set<std::string> s_hot_reloadable_keys = {
+	"config_files",
+	"watch_config_files",
+	"hot_reload_keep_inspectors",
+	"rules_file",
+	"rules_files",
+	"rules",
+	"rules_compile_threads",
+	"rules_fast_load",
+	"rules_cache",
+	"rules_bundle",
+	"rules_release_loading_state",
+	"rules_arena_hugepages",
+	"time_format_iso_8601",
+	"priority",
+	"json_output",
+	"json_include_output_property",
+	"json_include_tags_property",
+	"buffered_outputs",
+	"rule_matching",
+	"rule_matching_adaptive_ordering",
+	"rule_rate_limits",
+	"rule_state",
+	"outputs_queue",
+	"outputs_aggregation",
+	"stdout_output",
+	"syslog_output",
+	"file_output",
+	"http_output",
+	"kafka_output",
+	"program_output",
+	"shm_output",
+	"unix_socket_output",
+	"grpc_output",
+	"output_timeout",
+	"log_stderr",
+	"log_syslog",
+	"log_level",
+	"log_queue_capacity",
+	"log_repeated_rate_limit",
+	"libs_logger",
+	"falco_libs",
+};
+
+bool falco_configuration::is_hot_reloadable_to(const falco_configuration& next) const
+{
+	return config.dump_without(s_hot_reloadable_keys) == next.config.dump_without(s_hot_reloadable_keys);
+}
+
 void falco_configuration::merge_config_files(const std::string& config_name, std::vector<std::string>& loaded_config_files)
 {
 	// Load configs files to be included and merge them into current config
@@ -164,7 +243,7 @@ void falco_configuration::merge_config_files(const std::string& config_name, std
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
 	for(auto &filename : m_loaded_configs_filenames)
 	{
-		m_loaded_configs_filenames_sha256sum.insert({filename, falco::utils::calculate_file_sha256sum(filename)});
+		m_loaded_configs_filenames_sha256sum.insert({filename, falco::file_sha256sums::of_file(filename)});
 	}
 #endif
 }
@@ -179,6 +258,8 @@ void falco_configuration::init_logger()
 		"[libs]: ");
 	falco_logger::log_stderr = config.get_scalar<bool>("log_stderr", false);
 	falco_logger::log_syslog = config.get_scalar<bool>("log_syslog", true);
+	falco_logger::set_repeated_rate_limit(config.get_scalar<uint32_t>("log_repeated_rate_limit", 10));
+	m_log_queue_capacity = config.get_scalar<uint32_t>("log_queue_capacity", 4096);
 }
 
 void falco_configuration::load_engine_config(const std::string& config_name)
@@ -231,10 +312,15 @@ void falco_configuration::load_engine_config(const std::string& config_name)
 		break;
 	case engine_kind_t::REPLAY:
 		m_replay.m_capture_file = config.get_scalar<std::string>("engine.replay.capture_file", "");
-		if (m_replay.m_capture_file.empty())
+		m_replay.m_capture_files.clear();
+		config.get_sequence<std::vector<std::string>>(m_replay.m_capture_files, "engine.replay.capture_files");
+		if (m_replay.m_capture_file.empty() && m_replay.m_capture_files.empty())
 		{
 			throw std::logic_error("Error reading config file (" + config_name + "): engine.kind is 'replay' but no engine.replay.capture_file specified.");
 		}
+		m_replay.m_workers = config.get_scalar<uint32_t>("engine.replay.workers", 1);
+		m_replay.m_report = config.get_scalar<bool>("engine.replay.report", false);
+		m_replay.m_lossless = config.get_scalar<bool>("engine.replay.lossless", true);
 		break;
 	case engine_kind_t::GVISOR:
 		m_gvisor.m_config = config.get_scalar<std::string>("engine.gvisor.config", "");
@@ -243,11 +329,37 @@ void falco_configuration::load_engine_config(const std::string& config_name)
 			throw std::logic_error("Error reading config file (" + config_name + "): engine.kind is 'gvisor' but no engine.gvisor.config specified.");
 		}
 		m_gvisor.m_root = config.get_scalar<std::string>("engine.gvisor.root", "");
+		m_gvisor.m_shards.clear();
+		config.get_sequence<std::vector<std::string>>(m_gvisor.m_shards, "engine.gvisor.shards");
+		for (const auto& shard : m_gvisor.m_shards)
+		{
+			if (shard.empty() || shard == m_gvisor.m_config
+				|| std::count(m_gvisor.m_shards.begin(), m_gvisor.m_shards.end(), shard) > 1)
+			{
+				throw std::logic_error("Error reading config file (" + config_name + "): engine.gvisor.shards must be distinct configuration files, other than engine.gvisor.config");
+			}
+		}
+		m_gvisor.m_max_sandboxes = config.get_scalar<uint32_t>("engine.gvisor.max_sandboxes", 1024);
 		break;
 	case engine_kind_t::NODRIVER:
 	default:
 		break;
 	}
+
+	buf_size_autosize_config default_autosize;
+	m_buf_size_autosize.m_enabled = config.get_scalar<bool>("syscall_buf_size_autosize.enabled", false);
+	m_buf_size_autosize.m_drop_rate = config.get_scalar<double>("syscall_buf_size_autosize.drop_rate", default_autosize.m_drop_rate);
+	m_buf_size_autosize.m_drop_intervals = config.get_scalar<uint32_t>("syscall_buf_size_autosize.drop_intervals", default_autosize.m_drop_intervals);
+	m_buf_size_autosize.m_max_preset = config.get_scalar<int16_t>("syscall_buf_size_autosize.max_preset", default_autosize.m_max_preset);
+	m_buf_size_autosize.m_apply_on_restart = config.get_scalar<bool>("syscall_buf_size_autosize.apply_on_restart", false);
+	if(m_buf_size_autosize.m_max_preset < 1 || m_buf_size_autosize.m_max_preset > 10)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): syscall_buf_size_autosize.max_preset must be between 1 and 10");
+	}
+	if(m_buf_size_autosize.m_drop_intervals == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): syscall_buf_size_autosize.drop_intervals must be greater than 0");
+	}
 }
 
 void falco_configuration::load_yaml(const std::string& config_name)
@@ -289,6 +401,20 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		}
 	}
 
+	m_rules_compile_threads = config.get_scalar<uint32_t>("rules_compile_threads", 1);
+	m_rules_fast_load = config.get_scalar<bool>("rules_fast_load", false);
+
+	m_rules_cache_enabled = config.get_scalar<bool>("rules_cache.enabled", false);
+	m_rules_cache_path = config.get_scalar<std::string>("rules_cache.path", "/var/cache/falco/rules_cache.json");
+	m_rules_bundle_path = config.get_scalar<std::string>("rules_bundle.path", "");
+	if (m_rules_cache_enabled && m_rules_cache_path.empty())
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): rules_cache.path must not be empty");
+	}
+
+	m_rules_release_loading_state = config.get_scalar<bool>("rules_release_loading_state", false);
+	m_rules_arena_hugepages = config.get_scalar<bool>("rules_arena_hugepages", false);
+
 	m_json_output = config.get_scalar<bool>("json_output", false);
 	m_json_include_output_property = config.get_scalar<bool>("json_include_output_property", true);
 	m_json_include_tags_property = config.get_scalar<bool>("json_include_tags_property", true);
@@ -309,11 +435,22 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		keep_alive = config.get_scalar<std::string>("file_output.keep_alive", "");
 		file_output.options["keep_alive"] = keep_alive;
 
+		file_output.options["buffer_size"] = std::to_string(config.get_scalar<uint64_t>("file_output.buffer_size", 0));
+		file_output.options["flush_interval_ms"] = std::to_string(config.get_scalar<uint64_t>("file_output.flush_interval_ms", 1000));
+		file_output.options["fsync"] = config.get_scalar<bool>("file_output.fsync", false) ? "true" : "false";
+		file_output.options["rotate_max_size"] = std::to_string(config.get_scalar<uint64_t>("file_output.rotate.max_size", 0));
+		file_output.options["rotate_interval"] = config.get_scalar<std::string>("file_output.rotate.interval", "");
+		file_output.options["rotate_max_files"] = std::to_string(config.get_scalar<uint32_t>("file_output.rotate.max_files", 5));
+		file_output.options["encoding"] = config.get_scalar<std::string>("file_output.encoding", "text");
+		file_output.options["compression"] = config.get_scalar<std::string>("file_output.compression", "none");
+		file_output.options["compression_level"] = std::to_string(config.get_scalar<uint32_t>("file_output.compression_level", 6));
+
 		m_outputs.push_back(file_output);
 	}
 
 	falco::outputs::config stdout_output;
 	stdout_output.name = "stdout";
+	stdout_output.options["buffer_size"] = std::to_string(config.get_scalar<uint64_t>("stdout_output.buffer_size", 64 * 1024));
 	if(config.get_scalar<bool>("stdout_output.enabled", false))
 	{
 		m_outputs.push_back(stdout_output);
@@ -321,6 +458,9 @@ void falco_configuration::load_yaml(const std::string& config_name)
 
 	falco::outputs::config syslog_output;
 	syslog_output.name = "syslog";
+	syslog_output.options["mode"] = config.get_scalar<std::string>("syslog_output.mode", "syscall");
+	syslog_output.options["address"] = config.get_scalar<std::string>("syslog_output.address", "unix:///dev/log");
+	syslog_output.options["buffer_size"] = std::to_string(config.get_scalar<uint64_t>("syslog_output.buffer_size", 4 * 1024 * 1024));
 	if(config.get_scalar<bool>("syslog_output.enabled", false))
 	{
 		m_outputs.push_back(syslog_output);
@@ -341,9 +481,48 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		keep_alive = config.get_scalar<std::string>("program_output.keep_alive", "");
 		program_output.options["keep_alive"] = keep_alive;
 
+		program_output.options["buffer_size"] = std::to_string(config.get_scalar<uint64_t>("program_output.buffer_size", 1024 * 1024));
+		program_output.options["full_buffer_policy"] = config.get_scalar<std::string>("program_output.full_buffer_policy", "block");
+		program_output.options["encoding"] = config.get_scalar<std::string>("program_output.encoding", "text");
+
 		m_outputs.push_back(program_output);
 	}
 
+	falco::outputs::config shm_output;
+	shm_output.name = "shm";
+	if(config.get_scalar<bool>("shm_output.enabled", false))
+	{
+		shm_output.options["path"] = config.get_scalar<std::string>("shm_output.path", "/dev/shm/falco_alerts");
+		if(shm_output.options["path"].empty())
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): shm output enabled but no path in configuration block");
+		}
+		shm_output.options["capacity"] = std::to_string(config.get_scalar<uint64_t>("shm_output.capacity", 16 * 1024 * 1024));
+		shm_output.options["mode"] = config.get_scalar<std::string>("shm_output.mode", "0640");
+		shm_output.options["encoding"] = config.get_scalar<std::string>("shm_output.encoding", "text");
+
+		m_outputs.push_back(shm_output);
+	}
+
+	falco::outputs::config unix_socket_output;
+	unix_socket_output.name = "unix_socket";
+	if(config.get_scalar<bool>("unix_socket_output.enabled", false))
+	{
+		unix_socket_output.options["path"] = config.get_scalar<std::string>("unix_socket_output.path", "/run/falco/alerts.sock");
+		if(unix_socket_output.options["path"].empty())
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): unix_socket output enabled but no path in configuration block");
+		}
+		unix_socket_output.options["socket_type"] = config.get_scalar<std::string>("unix_socket_output.socket_type", "stream");
+		unix_socket_output.options["framing"] = config.get_scalar<std::string>("unix_socket_output.framing", "newline");
+		unix_socket_output.options["encoding"] = config.get_scalar<std::string>("unix_socket_output.encoding", "text");
+		unix_socket_output.options["buffer_size"] = std::to_string(config.get_scalar<uint64_t>("unix_socket_output.buffer_size", 1024 * 1024));
+		unix_socket_output.options["full_buffer_policy"] = config.get_scalar<std::string>("unix_socket_output.full_buffer_policy", "block");
+		unix_socket_output.options["reconnect_backoff_ms"] = std::to_string(config.get_scalar<uint64_t>("unix_socket_output.reconnect_backoff_ms", 1000));
+
+		m_outputs.push_back(unix_socket_output);
+	}
+
 	falco::outputs::config http_output;
 	http_output.name = "http";
 	if(config.get_scalar<bool>("http_output.enabled", false))
@@ -351,11 +530,28 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		std::string url;
 		url = config.get_scalar<std::string>("http_output.url", "");
 
-		if(url == std::string(""))
+		// further endpoints the alerts are spread over
+		std::vector<std::string> urls;
+		config.get_sequence<std::vector<std::string>>(urls, "http_output.urls");
+		std::string joined_urls;
+		for(const auto& u : urls)
+		{
+			if(u.find(',') != std::string::npos)
+			{
+				throw std::logic_error("Error reading config file (" + config_name + "): http_output.urls can't contain commas");
+			}
+			if(!u.empty())
+			{
+				joined_urls += (joined_urls.empty() ? "" : ",") + u;
+			}
+		}
+
+		if(url == std::string("") && joined_urls.empty())
 		{
 			throw std::logic_error("Error reading config file (" + config_name + "): http output enabled but no url in configuration block");
 		}
 		http_output.options["url"] = url;
+		http_output.options["urls"] = joined_urls;
 
 		std::string user_agent;
 		user_agent = config.get_scalar<std::string>("http_output.user_agent","falcosecurity/falco");
@@ -401,9 +597,51 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		keep_alive = config.get_scalar<bool>("http_output.keep_alive", false);
 		http_output.options["keep_alive"] = keep_alive? std::string("true") : std::string("false");
 
+		http_output.options["batch_max_alerts"] = std::to_string(config.get_scalar<uint64_t>("http_output.batch.max_alerts", 1));
+		http_output.options["batch_max_bytes"] = std::to_string(config.get_scalar<uint64_t>("http_output.batch.max_bytes", 1024 * 1024));
+		http_output.options["batch_linger_ms"] = std::to_string(config.get_scalar<uint64_t>("http_output.batch.linger_ms", 0));
+		http_output.options["batch_compression"] = config.get_scalar<std::string>("http_output.batch.compression", "none");
+		http_output.options["max_in_flight"] = std::to_string(config.get_scalar<uint64_t>("http_output.max_in_flight", 1));
+		http_output.options["max_retries"] = std::to_string(config.get_scalar<uint64_t>("http_output.max_retries", 0));
+		http_output.options["retry_backoff_ms"] = std::to_string(config.get_scalar<uint64_t>("http_output.retry_backoff_ms", 100));
+		http_output.options["encoding"] = config.get_scalar<std::string>("http_output.encoding", "text");
+		http_output.options["http2"] = config.get_scalar<bool>("http_output.http2", false) ? std::string("true") : std::string("false");
+		http_output.options["max_connections"] = std::to_string(config.get_scalar<uint64_t>("http_output.max_connections", 0));
+		http_output.options["unhealthy_after_failures"] = std::to_string(config.get_scalar<uint64_t>("http_output.unhealthy_after_failures", 3));
+		http_output.options["unhealthy_interval_ms"] = std::to_string(config.get_scalar<uint64_t>("http_output.unhealthy_interval_ms", 5000));
+
 		m_outputs.push_back(http_output);
 	}
 
+	falco::outputs::config kafka_output;
+	kafka_output.name = "kafka";
+	if(config.get_scalar<bool>("kafka_output.enabled", false))
+	{
+		kafka_output.options["brokers"] = config.get_scalar<std::string>("kafka_output.brokers", "");
+		if(kafka_output.options["brokers"].empty())
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): kafka output enabled but no brokers in configuration block");
+		}
+		kafka_output.options["topic"] = config.get_scalar<std::string>("kafka_output.topic", "");
+		if(kafka_output.options["topic"].empty())
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): kafka output enabled but no topic in configuration block");
+		}
+		kafka_output.options["client_id"] = config.get_scalar<std::string>("kafka_output.client_id", "falco");
+		kafka_output.options["acks"] = config.get_scalar<std::string>("kafka_output.acks", "all");
+		kafka_output.options["batch_max_alerts"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.batch.max_alerts", 1000));
+		kafka_output.options["batch_max_bytes"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.batch.max_bytes", 1024 * 1024));
+		kafka_output.options["batch_linger_ms"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.batch.linger_ms", 5));
+		kafka_output.options["compression"] = config.get_scalar<std::string>("kafka_output.batch.compression", "none");
+		kafka_output.options["max_in_flight"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.max_in_flight", 5));
+		kafka_output.options["request_timeout_ms"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.request_timeout_ms", 30000));
+		kafka_output.options["max_retries"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.max_retries", 3));
+		kafka_output.options["retry_backoff_ms"] = std::to_string(config.get_scalar<uint64_t>("kafka_output.retry_backoff_ms", 100));
+		kafka_output.options["encoding"] = config.get_scalar<std::string>("kafka_output.encoding", "text");
+
+		m_outputs.push_back(kafka_output);
+	}
+
 	m_grpc_enabled = config.get_scalar<bool>("grpc.enabled", false);
 	m_grpc_bind_address = config.get_scalar<std::string>("grpc.bind_address", "0.0.0.0:5060");
 	m_grpc_threadiness = config.get_scalar<uint32_t>("grpc.threadiness", 0);
@@ -412,6 +650,18 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		m_grpc_threadiness = falco::utils::hardware_concurrency();
 	}
 	// todo > else limit threadiness to avoid oversubscription?
+	m_grpc_contexts_per_thread = config.get_scalar<uint32_t>("grpc.contexts_per_thread", 10);
+	if(m_grpc_contexts_per_thread == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): grpc.contexts_per_thread must be greater than 0");
+	}
+	m_grpc_cpus.clear();
+	std::string grpc_cpus = config.get_scalar<std::string>("grpc.cpus", "");
+	if(!grpc_cpus.empty() && !falco::utils::parse_cpu_list(grpc_cpus, m_grpc_cpus))
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): invalid grpc.cpus list '" + grpc_cpus + "'");
+	}
+	m_grpc_rules_api = config.get_scalar<bool>("grpc.rules_api", false);
 	m_grpc_private_key = config.get_scalar<std::string>("grpc.private_key", "/etc/falco/certs/server.key");
 	m_grpc_cert_chain = config.get_scalar<std::string>("grpc.cert_chain", "/etc/falco/certs/server.crt");
 	m_grpc_root_certs = config.get_scalar<std::string>("grpc.root_certs", "/etc/falco/certs/ca.crt");
@@ -421,9 +671,28 @@ void falco_configuration::load_yaml(const std::string& config_name)
 	// gRPC output is enabled only if gRPC server is enabled too
 	if(config.get_scalar<bool>("grpc_output.enabled", true) && m_grpc_enabled)
 	{
+		grpc_output.options["max_lag"] = std::to_string(config.get_scalar<uint64_t>("grpc_output.max_lag", 10000));
+		grpc_output.options["overflow_policy"] = config.get_scalar<std::string>("grpc_output.overflow_policy", "drop_oldest");
 		m_outputs.push_back(grpc_output);
 	}
 
+	// the alerts delivered to each output, e.g. file_output.route, and
+	// what's kept of them
+	for(auto& o : m_outputs)
+	{
+		std::string key = o.name + "_output.route";
+		std::string min_priority = config.get_scalar<std::string>(key + ".min_priority", "debug");
+		if(!falco_common::parse_priority(min_priority, o.route.min_priority))
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): unknown " + key + ".min_priority \"" + min_priority + "\"");
+		}
+		config.get_sequence(o.route.sources, key + ".sources");
+		config.get_sequence(o.route.tags, key + ".tags");
+		config.get_sequence(o.route.exclude_tags, key + ".exclude_tags");
+		config.get_sequence(o.route.rules, key + ".rules");
+		config.get_sequence(o.projection, o.name + "_output.projection");
+	}
+
 	m_output_timeout = config.get_scalar<uint32_t>("output_timeout", 2000);
 
 	std::string rule_matching = config.get_scalar<std::string>("rule_matching", "first");
@@ -432,6 +701,14 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		throw std::logic_error("Unknown rule matching strategy \"" + rule_matching + "\"--must be one of first, all");
 	}
 
+	m_rule_matching_adaptive_ordering_enabled = config.get_scalar<bool>("rule_matching_adaptive_ordering.enabled", false);
+	m_rule_matching_adaptive_ordering_interval = falco::utils::parse_prometheus_interval(
+		config.get_scalar<std::string>("rule_matching_adaptive_ordering.interval", "30s"));
+	if (m_rule_matching_adaptive_ordering_enabled && m_rule_matching_adaptive_ordering_interval == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): invalid rule_matching_adaptive_ordering.interval");
+	}
+
 	std::string priority = config.get_scalar<std::string>("priority", "debug");
 	if (!falco_common::parse_priority(priority, m_min_priority))
 	{
@@ -445,6 +722,48 @@ void falco_configuration::load_yaml(const std::string& config_name)
 	{
 		m_outputs_queue_capacity = DEFAULT_OUTPUTS_QUEUE_CAPACITY_UNBOUNDED_MAX_LONG_VALUE;
 	}
+	m_outputs_queue_priority_reserve = config.get_scalar<uint32_t>("outputs_queue.priority_reserve", 25);
+	if (m_outputs_queue_priority_reserve > 100)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): outputs_queue.priority_reserve must be a percentage between 0 and 100");
+	}
+	// 0 means no budget, the queue being only bounded by its capacity
+	m_outputs_queue_max_bytes = config.get_scalar<uint64_t>("outputs_queue.max_bytes", 0);
+	m_outputs_queue_deferred_formatting = config.get_scalar<bool>("outputs_queue.deferred_formatting", false);
+
+	m_outputs_queue_spill = {};
+	m_outputs_queue_spill.enabled = config.get_scalar<bool>("outputs_queue.spill.enabled", false);
+	m_outputs_queue_spill.path = config.get_scalar<std::string>("outputs_queue.spill.path", m_outputs_queue_spill.path);
+	m_outputs_queue_spill.max_size = config.get_scalar<uint64_t>("outputs_queue.spill.max_size", m_outputs_queue_spill.max_size);
+	m_outputs_queue_spill.segment_size = config.get_scalar<uint64_t>("outputs_queue.spill.segment_size", m_outputs_queue_spill.segment_size);
+	if (m_outputs_queue_spill.enabled && m_outputs_queue_spill.path.empty())
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): outputs_queue.spill.path must not be empty");
+	}
+	if (m_outputs_queue_spill.segment_size < 4096 || m_outputs_queue_spill.segment_size > 1024 * 1024 * 1024
+		|| m_outputs_queue_spill.max_size < m_outputs_queue_spill.segment_size)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): outputs_queue.spill.segment_size must be between 4KiB and 1GiB, and not greater than outputs_queue.spill.max_size");
+	}
+
+	m_outputs_queue_drain = {};
+	m_outputs_queue_drain.timeout_ms = config.get_scalar<uint64_t>("outputs_queue.drain.timeout_ms", m_outputs_queue_drain.timeout_ms);
+	m_outputs_queue_drain.max_alerts = config.get_scalar<uint64_t>("outputs_queue.drain.max_alerts", m_outputs_queue_drain.max_alerts);
+
+	m_outputs_aggregation = {};
+	m_outputs_aggregation.enabled = config.get_scalar<bool>("outputs_aggregation.enabled", false);
+	m_outputs_aggregation.window_ms = falco::utils::parse_prometheus_interval(
+		config.get_scalar<std::string>("outputs_aggregation.window", "10s"));
+	if (m_outputs_aggregation.enabled && m_outputs_aggregation.window_ms == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): invalid outputs_aggregation.window");
+	}
+	config.get_sequence<std::vector<std::string>>(m_outputs_aggregation.keys, "outputs_aggregation.keys");
+	m_outputs_aggregation.max_groups = config.get_scalar<size_t>("outputs_aggregation.max_groups", 10000);
+
+	m_recent_alerts = {};
+	m_recent_alerts.enabled = config.get_scalar<bool>("recent_alerts.enabled", false);
+	m_recent_alerts.max_memory = config.get_scalar<uint64_t>("recent_alerts.max_memory", m_recent_alerts.max_memory);
 
 	m_time_format_iso_8601 = config.get_scalar<bool>("time_format_iso_8601", false);
 
@@ -458,6 +777,13 @@ void falco_configuration::load_yaml(const std::string& config_name)
 	}
 
 	m_webserver_config.m_k8s_healthz_endpoint = config.get_scalar<std::string>("webserver.k8s_healthz_endpoint", "/healthz");
+	m_webserver_config.m_k8s_readyz_endpoint = config.get_scalar<std::string>("webserver.k8s_readyz_endpoint", "/readyz");
+	m_webserver_config.m_probes_listen_port = config.get_scalar<uint32_t>("webserver.probes_listen_port", 0);
+	if(m_webserver_config.m_probes_listen_port > UINT16_MAX
+		|| (m_webserver_config.m_probes_listen_port != 0 && m_webserver_config.m_probes_listen_port == m_webserver_config.m_listen_port))
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): webserver.probes_listen_port must be a valid port other than webserver.listen_port");
+	}
 	m_webserver_config.m_ssl_enabled = config.get_scalar<bool>("webserver.ssl_enabled", false);
 	m_webserver_config.m_ssl_certificate = config.get_scalar<std::string>("webserver.ssl_certificate", "/etc/falco/falco.pem");
 	if(m_webserver_config.m_threadiness == 0)
@@ -465,6 +791,7 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		m_webserver_config.m_threadiness = falco::utils::hardware_concurrency();
 	}
 	m_webserver_config.m_prometheus_metrics_enabled = config.get_scalar<bool>("webserver.prometheus_metrics_enabled", false);
+	m_webserver_config.m_prometheus_metrics_cache_ms = config.get_scalar<uint32_t>("webserver.prometheus_metrics_cache_ms", 1000);
 
 	std::list<std::string> syscall_event_drop_acts;
 	config.get_sequence(syscall_event_drop_acts, "syscall_event_drops.actions");
@@ -496,9 +823,13 @@ void falco_configuration::load_yaml(const std::string& config_name)
 		{
 			m_syscall_evt_drop_actions.insert(syscall_evt_drop_action::EXIT);
 		}
+		else if(act == "throttle")
+		{
+			m_syscall_evt_drop_actions.insert(syscall_evt_drop_action::THROTTLE);
+		}
 		else
 		{
-			throw std::logic_error("Error reading config file (" + config_name + "): available actions for syscall event drops are \"ignore\", \"log\", \"alert\", and \"exit\"");
+			throw std::logic_error("Error reading config file (" + config_name + "): available actions for syscall event drops are \"ignore\", \"log\", \"alert\", \"exit\", and \"throttle\"");
 		}
 	}
 
@@ -516,23 +847,75 @@ void falco_configuration::load_yaml(const std::string& config_name)
 	m_syscall_evt_drop_max_burst = config.get_scalar<double>("syscall_event_drops.max_burst", 1);
 	m_syscall_evt_simulate_drops = config.get_scalar<bool>("syscall_event_drops.simulate_drops", false);
 
+	m_syscall_evt_drop_throttle.m_syscalls.clear();
+	config.get_sequence<std::vector<std::string>>(m_syscall_evt_drop_throttle.m_syscalls, "syscall_event_drops.throttle.syscalls");
+	m_syscall_evt_drop_throttle.m_after_intervals = config.get_scalar<uint32_t>("syscall_event_drops.throttle.after_intervals", 3);
+	m_syscall_evt_drop_throttle.m_restore_after_intervals = config.get_scalar<uint32_t>("syscall_event_drops.throttle.restore_after_intervals", 30);
+	if(m_syscall_evt_drop_throttle.m_after_intervals == 0 || m_syscall_evt_drop_throttle.m_restore_after_intervals == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): syscall_event_drops.throttle intervals must be greater than 0");
+	}
+	if(m_syscall_evt_drop_actions.count(syscall_evt_drop_action::THROTTLE) && m_syscall_evt_drop_throttle.m_syscalls.empty())
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): syscall event drop action \"throttle\" requires syscall_event_drops.throttle.syscalls");
+	}
+
 	m_syscall_evt_timeout_max_consecutives = config.get_scalar<uint32_t>("syscall_event_timeouts.max_consecutives", 1000);
 	if(m_syscall_evt_timeout_max_consecutives == 0)
 	{
 		throw std::logic_error("Error reading config file(" + config_name + "): the maximum consecutive timeouts without an event must be an unsigned integer > 0");
 	}
+	m_syscall_evt_timeout_max_stall_ms = config.get_scalar<uint64_t>("syscall_event_timeouts.max_stall_ms", 10000);
+	if(m_syscall_evt_timeout_max_stall_ms == 0)
+	{
+		throw std::logic_error("Error reading config file(" + config_name + "): the maximum time without an event must be an unsigned integer > 0");
+	}
 
 	m_falco_libs_thread_table_size = config.get_scalar<std::uint32_t>("falco_libs.thread_table_size", DEFAULT_FALCO_LIBS_THREAD_TABLE_SIZE);
+	thread_table_autosize_config default_thread_table_autosize;
+	auto& autosize = m_falco_libs_thread_table_autosize;
+	autosize.m_enabled = config.get_scalar<bool>("falco_libs.thread_table_autosize.enabled", false);
+	autosize.m_min_size = config.get_scalar<uint32_t>("falco_libs.thread_table_autosize.min_size", default_thread_table_autosize.m_min_size);
+	autosize.m_max_memory = config.get_scalar<uint64_t>("falco_libs.thread_table_autosize.max_memory_mb", default_thread_table_autosize.m_max_memory / (1024 * 1024)) * 1024 * 1024;
+	autosize.m_thread_bytes = config.get_scalar<uint64_t>("falco_libs.thread_table_autosize.thread_bytes", default_thread_table_autosize.m_thread_bytes);
+	autosize.m_headroom = config.get_scalar<double>("falco_libs.thread_table_autosize.headroom", default_thread_table_autosize.m_headroom);
+	autosize.m_interval_s = config.get_scalar<uint64_t>("falco_libs.thread_table_autosize.interval_s", default_thread_table_autosize.m_interval_s);
+	if(autosize.m_min_size == 0 || autosize.m_thread_bytes == 0 || autosize.m_interval_s == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): falco_libs.thread_table_autosize.min_size, thread_bytes and interval_s must be greater than 0");
+	}
+	if(autosize.m_headroom < 1)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): falco_libs.thread_table_autosize.headroom must be at least 1");
+	}
 
 	m_base_syscalls_custom_set.clear();
 	config.get_sequence<std::unordered_set<std::string>>(m_base_syscalls_custom_set, std::string("base_syscalls.custom_set"));
 	m_base_syscalls_repair = config.get_scalar<bool>("base_syscalls.repair", false);
+	m_base_syscalls_live_update = config.get_scalar<bool>("base_syscalls.live_update", false);
+	m_base_syscalls_kernel_prefilter = config.get_scalar<bool>("base_syscalls.kernel_prefilter", false);
 
 	m_metrics_enabled = config.get_scalar<bool>("metrics.enabled", false);
 	m_metrics_interval_str = config.get_scalar<std::string>("metrics.interval", "5000");
 	m_metrics_interval = falco::utils::parse_prometheus_interval(m_metrics_interval_str);
+	auto ticker = config.get_scalar<std::string>("metrics.ticker", "signal");
+	if (ticker != "signal" && ticker != "thread")
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): metrics.ticker must be either 'signal' or 'thread'");
+	}
+	m_metrics_ticker_thread = ticker == "thread";
 	m_metrics_stats_rule_enabled = config.get_scalar<bool>("metrics.output_rule", false);
 	m_metrics_output_file = config.get_scalar<std::string>("metrics.output_file", "");
+	m_metrics_output_file_options = {};
+	m_metrics_output_file_options.m_buffer_size = config.get_scalar<uint64_t>("metrics.output_file_options.buffer_size", 64 * 1024);
+	m_metrics_output_file_options.m_flush_interval_ms = config.get_scalar<uint32_t>("metrics.output_file_options.flush_interval_ms", 1000);
+	m_metrics_output_file_options.m_rotate_max_size = config.get_scalar<uint64_t>("metrics.output_file_options.rotate.max_size", 0);
+	m_metrics_output_file_options.m_rotate_max_files = config.get_scalar<uint32_t>("metrics.output_file_options.rotate.max_files", 5);
+	m_metrics_output_file_options.m_max_backlog_bytes = config.get_scalar<uint64_t>("metrics.output_file_options.max_backlog_bytes", 4 * 1024 * 1024);
+	if (m_metrics_output_file_options.m_max_backlog_bytes == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): metrics.output_file_options.max_backlog_bytes must be greater than 0");
+	}
 
 	m_metrics_flags = 0;
 	if (config.get_scalar<bool>("metrics.rules_counters_enabled", true))
@@ -562,9 +945,69 @@ void falco_configuration::load_yaml(const std::string& config_name)
 
 	m_metrics_convert_memory_to_mb = config.get_scalar<bool>("metrics.convert_memory_to_mb", true);
 	m_metrics_include_empty_values = config.get_scalar<bool>("metrics.include_empty_values", false);
+	m_metrics_rules_profiling_enabled = config.get_scalar<bool>("metrics.rules_profiling_enabled", false);
+	m_metrics_rules_profiling_sampling_period = config.get_scalar<uint32_t>("metrics.rules_profiling_sampling_period", 128);
+	if (m_metrics_rules_profiling_sampling_period == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): metrics.rules_profiling_sampling_period must be greater than 0");
+	}
+	m_metrics_event_stages_enabled = config.get_scalar<bool>("metrics.event_stages_enabled", true);
+	m_metrics_syscall_cost_enabled = config.get_scalar<bool>("metrics.syscall_cost_enabled", false);
+	m_metrics_event_types_enabled = config.get_scalar<bool>("metrics.event_types_enabled", false);
+	m_metrics_rules_series_max = config.get_scalar<uint32_t>("metrics.rules_series_max", 0);
+	m_metrics_rules_series_allowlist.clear();
+	config.get_sequence<std::unordered_set<std::string>>(m_metrics_rules_series_allowlist, "metrics.rules_series_allowlist");
+
+	m_otlp = otlp_config();
+	m_otlp.m_enabled = config.get_scalar<bool>("otlp_exporter.enabled", false);
+	m_otlp.m_endpoint = config.get_scalar<std::string>("otlp_exporter.endpoint", m_otlp.m_endpoint);
+	config.get_sequence<std::vector<std::string>>(m_otlp.m_headers, "otlp_exporter.headers");
+	m_otlp.m_timeout_ms = config.get_scalar<uint32_t>("otlp_exporter.timeout_ms", m_otlp.m_timeout_ms);
+	m_otlp.m_max_queued_requests = config.get_scalar<uint32_t>("otlp_exporter.max_queued_requests", m_otlp.m_max_queued_requests);
+	m_otlp.m_service_name = config.get_scalar<std::string>("otlp_exporter.service_name", m_otlp.m_service_name);
+	m_otlp.m_metrics_enabled = config.get_scalar<bool>("otlp_exporter.metrics_enabled", m_otlp.m_metrics_enabled);
+	m_otlp.m_traces_sampling_ratio = config.get_scalar<double>("otlp_exporter.traces_sampling_ratio", m_otlp.m_traces_sampling_ratio);
+	if (m_otlp.m_enabled && m_otlp.m_endpoint.empty())
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): otlp_exporter enabled but no endpoint in configuration block");
+	}
+	if (m_otlp.m_traces_sampling_ratio < 0 || m_otlp.m_traces_sampling_ratio > 1)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): otlp_exporter.traces_sampling_ratio must be between 0 and 1");
+	}
+	for (const auto& h : m_otlp.m_headers)
+	{
+		if (h.find(':') == std::string::npos)
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): otlp_exporter.headers must be in the 'Name: value' form");
+		}
+	}
+
+	m_profiler = profiler_config();
+	m_profiler.m_enabled = config.get_scalar<bool>("profiler.enabled", false);
+	m_profiler.m_frequency_hz = config.get_scalar<uint32_t>("profiler.frequency_hz", m_profiler.m_frequency_hz);
+	m_profiler.m_duration_sec = config.get_scalar<uint32_t>("profiler.duration_sec", m_profiler.m_duration_sec);
+	m_profiler.m_output_dir = config.get_scalar<std::string>("profiler.output_dir", m_profiler.m_output_dir);
+	if (m_profiler.m_frequency_hz == 0 || m_profiler.m_frequency_hz > 1000)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): profiler.frequency_hz must be between 1 and 1000");
+	}
+	if (m_profiler.m_duration_sec == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): profiler.duration_sec must be greater than 0");
+	}
 
 	config.get_sequence<std::vector<rule_selection_config>>(m_rules_selection, "rules");
 
+	m_rule_rate_limits.clear();
+	config.get_sequence<std::vector<rate_limit_config>>(m_rule_rate_limits, "rule_rate_limits");
+
+	m_rule_state_max_memory = config.get_scalar<uint64_t>("rule_state.max_memory", 16 * 1024 * 1024);
+	if (m_rule_state_max_memory == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): rule_state.max_memory must be greater than 0");
+	}
+
 	std::vector<std::string> load_plugins;
 
 	bool load_plugins_node_defined = config.is_defined("load_plugins");
@@ -614,8 +1057,113 @@ void falco_configuration::load_yaml(const std::string& config_name)
 			}
 		}
 	}
+	m_plugin_sources_threads = config.get_scalar<uint32_t>("plugin_sources_threads", 0);
+	m_plugin_event_batch_size = config.get_scalar<uint32_t>("plugin_event_batch_size", 64);
+
+	idle_backoff_config default_idle_backoff;
+	m_idle_backoff_enabled = config.get_scalar<bool>("idle_backoff.enabled", false);
+	m_idle_backoff.m_spin_timeouts = config.get_scalar<uint32_t>("idle_backoff.spin_timeouts", default_idle_backoff.m_spin_timeouts);
+	m_idle_backoff.m_yield_timeouts = config.get_scalar<uint32_t>("idle_backoff.yield_timeouts", default_idle_backoff.m_yield_timeouts);
+	m_idle_backoff.m_max_sleep_us = config.get_scalar<uint64_t>("idle_backoff.max_sleep_us", default_idle_backoff.m_max_sleep_us);
+	// the settings of each source default to the ones of all sources
+	m_idle_backoff_sources.clear();
+	for(size_t i = 0; config.is_defined("idle_backoff.sources[" + std::to_string(i) + "]"); i++)
+	{
+		auto key = "idle_backoff.sources[" + std::to_string(i) + "].";
+		auto& c = m_idle_backoff_sources.emplace_back(m_idle_backoff);
+		c.m_source = config.get_scalar<std::string>(key + "source", "");
+		if(c.m_source.empty())
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): idle_backoff.sources entries must have a source");
+		}
+		c.m_spin_timeouts = config.get_scalar<uint32_t>(key + "spin_timeouts", m_idle_backoff.m_spin_timeouts);
+		c.m_yield_timeouts = config.get_scalar<uint32_t>(key + "yield_timeouts", m_idle_backoff.m_yield_timeouts);
+		c.m_max_sleep_us = config.get_scalar<uint64_t>(key + "max_sleep_us", m_idle_backoff.m_max_sleep_us);
+	}
+
+	flight_recorder_config default_flight_recorder;
+	m_flight_recorder.m_enabled = config.get_scalar<bool>("flight_recorder.enabled", false);
+	m_flight_recorder.m_sources.clear();
+	config.get_sequence<std::set<std::string>>(m_flight_recorder.m_sources, "flight_recorder.sources");
+	m_flight_recorder.m_max_memory = config.get_scalar<uint64_t>("flight_recorder.max_memory", default_flight_recorder.m_max_memory);
+	m_flight_recorder.m_before_ms = config.get_scalar<uint64_t>("flight_recorder.before_ms", default_flight_recorder.m_before_ms);
+	m_flight_recorder.m_after_ms = config.get_scalar<uint64_t>("flight_recorder.after_ms", default_flight_recorder.m_after_ms);
+	std::string flight_recorder_priority = config.get_scalar<std::string>("flight_recorder.min_priority", "critical");
+	if(!falco_common::parse_priority(flight_recorder_priority, m_flight_recorder.m_min_priority))
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): unknown flight_recorder.min_priority \"" + flight_recorder_priority + "\"");
+	}
+	m_flight_recorder.m_tags.clear();
+	config.get_sequence<std::set<std::string>>(m_flight_recorder.m_tags, "flight_recorder.tags");
+	m_flight_recorder.m_path = config.get_scalar<std::string>("flight_recorder.path", default_flight_recorder.m_path);
+	if(m_flight_recorder.m_enabled && m_flight_recorder.m_path.empty())
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): flight_recorder.path must not be empty");
+	}
+
+	load_shedding_config default_load_shedding;
+	m_load_shedding.m_enabled = config.get_scalar<bool>("load_shedding.enabled", false);
+	m_load_shedding.m_raise_drop_rate = config.get_scalar<double>("load_shedding.raise_drop_rate", default_load_shedding.m_raise_drop_rate);
+	m_load_shedding.m_lower_drop_rate = config.get_scalar<double>("load_shedding.lower_drop_rate", default_load_shedding.m_lower_drop_rate);
+	m_load_shedding.m_lower_after_intervals = config.get_scalar<uint32_t>("load_shedding.lower_after_intervals", default_load_shedding.m_lower_after_intervals);
+	if(m_load_shedding.m_lower_drop_rate < 0 || m_load_shedding.m_lower_drop_rate > m_load_shedding.m_raise_drop_rate || m_load_shedding.m_raise_drop_rate > 1)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): load_shedding drop rates must satisfy 0 <= lower_drop_rate <= raise_drop_rate <= 1");
+	}
+	m_load_shedding.m_classes.clear();
+	for(size_t i = 0; config.is_defined("load_shedding.classes[" + std::to_string(i) + "]"); i++)
+	{
+		auto& events = m_load_shedding.m_classes.emplace_back();
+		config.get_sequence<std::vector<std::string>>(events, "load_shedding.classes[" + std::to_string(i) + "].events");
+		if(events.empty())
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): load_shedding.classes entries must have events");
+		}
+	}
+	if(m_load_shedding.m_classes.size() > UINT8_MAX)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): too many load_shedding.classes");
+	}
+
+	container_budgets_config default_container_budgets;
+	m_container_budgets.m_enabled = config.get_scalar<bool>("container_budgets.enabled", false);
+	m_container_budgets.m_max_evts_rate = config.get_scalar<uint64_t>("container_budgets.max_evts_rate", default_container_budgets.m_max_evts_rate);
+	m_container_budgets.m_max_alerts_rate = config.get_scalar<uint64_t>("container_budgets.max_alerts_rate", default_container_budgets.m_max_alerts_rate);
+	m_container_budgets.m_sampling_ratio = config.get_scalar<uint32_t>("container_budgets.sampling_ratio", default_container_budgets.m_sampling_ratio);
+	if(m_container_budgets.m_sampling_ratio == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): container_budgets.sampling_ratio must be greater than 0");
+	}
+	m_container_budgets.m_sampled_events = default_container_budgets.m_sampled_events;
+	if(config.is_defined("container_budgets.sampled_events"))
+	{
+		m_container_budgets.m_sampled_events.clear();
+		config.get_sequence<std::vector<std::string>>(m_container_budgets.m_sampled_events, "container_budgets.sampled_events");
+	}
+	std::string container_budgets_priority = config.get_scalar<std::string>("container_budgets.keep_priority", "critical");
+	if(!falco_common::parse_priority(container_budgets_priority, m_container_budgets.m_keep_priority))
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): unknown container_budgets.keep_priority \"" + container_budgets_priority + "\"");
+	}
+	m_container_budgets.m_max_containers = config.get_scalar<uint64_t>("container_budgets.max_containers", default_container_budgets.m_max_containers);
+	if(m_container_budgets.m_max_containers == 0)
+	{
+		throw std::logic_error("Error reading config file (" + config_name + "): container_budgets.max_containers must be greater than 0");
+	}
 
 	m_watch_config_files = config.get_scalar<bool>("watch_config_files", true);
+	m_hot_reload_keep_inspectors = config.get_scalar<bool>("hot_reload_keep_inspectors", true);
+
+	for(int i = 0; i < falco::thread_affinity::NUM_CLASSES; i++)
+	{
+		auto key = std::string("thread_affinity.") + falco::thread_affinity::name((falco::thread_affinity::thread_class) i);
+		auto list = config.get_scalar<std::string>(key, "");
+		m_thread_affinity[i].clear();
+		if(!list.empty() && !falco::utils::parse_cpu_list(list, m_thread_affinity[i]))
+		{
+			throw std::logic_error("Error reading config file (" + config_name + "): invalid " + key + " list '" + list + "'");
+		}
+	}
 }
 
 void falco_configuration::read_rules_file_directory(const std::string &path, std::list<std::string> &rules_filenames, std::list<std::string> &rules_folders)
@@ -25,7 +25,9 @@ limitations under the License.
 #include <unistd.h>
 #endif
 #include <yaml-cpp/yaml.h>
+#include <array>
 #include <string>
+#include <algorithm>
 #include <vector>
 #include <list>
 #include <set>
@@ -36,6 +38,8 @@ limitations under the License.
 #include "yaml_helper.h"
 #include "event_drops.h"
 #include "falco_outputs.h"
+#include "thread_affinity.h"
+#include "file_sha256sums.h"
 
 enum class engine_kind_t : uint8_t
 {
@@ -76,11 +80,22 @@ public:
 
 	struct replay_config {
 		std::string m_capture_file;
+		// more capture files or directories of capture files, processed
+		// concurrently by m_workers workers (0 for one per CPU)
+		std::vector<std::string> m_capture_files;
+		uint32_t m_workers = 1;
+		bool m_report = false;
+		// alerts wait for the outputs instead of being dropped
+		bool m_lossless = true;
 	};
 
 	struct gvisor_config {
 		std::string m_config;
 		std::string m_root;
+		// the configuration files of the additional shards, each with
+		// an inspector and a ruleset of its own
+		std::vector<std::string> m_shards;
+		uint32_t m_max_sandboxes = 1024;
 	};
 
 	struct webserver_config {
@@ -88,9 +103,13 @@ public:
 		uint32_t m_listen_port = 8765;
 		std::string m_listen_address = "0.0.0.0";
 		std::string m_k8s_healthz_endpoint = "/healthz";
+		std::string m_k8s_readyz_endpoint = "/readyz";
+		// the port of the probes served apart from the webserver, if not 0
+		uint32_t m_probes_listen_port = 0;
 		bool m_ssl_enabled = false;
 		std::string m_ssl_certificate;
 		bool m_prometheus_metrics_enabled = false;
+		uint32_t m_prometheus_metrics_cache_ms = 1000;
 	};
 
 	enum class rule_selection_operation {
@@ -104,6 +123,118 @@ public:
 		std::string m_rule;
 	};
 
+	// The rate limit of the alerts of a rule by name, or of all the
+	// rules with a given priority
+	struct rate_limit_config {
+		std::string m_rule;
+		bool m_has_priority = false;
+		falco_common::priority_type m_priority = falco_common::PRIORITY_DEBUG;
+		falco_rate_limit m_limit;
+	};
+
+	// How the event processing loop of a source waits after having had
+	// no event to process, for all sources or for a given one
+	struct idle_backoff_config {
+		std::string m_source;
+		uint32_t m_spin_timeouts = 16;
+		uint32_t m_yield_timeouts = 16;
+		uint64_t m_max_sleep_us = 1000;
+	};
+
+	// Which alerts dump the events around them to a capture file, and how
+	// many events are kept for that, for all sources or for the given ones
+	struct flight_recorder_config {
+		bool m_enabled = false;
+		std::set<std::string> m_sources;
+		uint64_t m_max_memory = 64 * 1024 * 1024;
+		uint64_t m_before_ms = 10000;
+		uint64_t m_after_ms = 5000;
+		falco_common::priority_type m_min_priority = falco_common::PRIORITY_CRITICAL;
+		std::set<std::string> m_tags;
+		std::string m_path = "/var/lib/falco/flight_recorder";
+	};
+
+	struct syscall_evt_drop_throttle_config {
+		// the names of the syscalls that aren't collected while throttled
+		std::vector<std::string> m_syscalls;
+		uint32_t m_after_intervals = 3;
+		uint32_t m_restore_after_intervals = 30;
+	};
+
+	struct buf_size_autosize_config {
+		bool m_enabled = false;
+		double m_drop_rate = 0.001;
+		uint32_t m_drop_intervals = 10;
+		int16_t m_max_preset = 8;
+		bool m_apply_on_restart = false;
+	};
+
+	// How the thread table of the syscall inspector is sized from the
+	// threads of the host and resized at runtime, within a memory budget
+	struct thread_table_autosize_config {
+		bool m_enabled = false;
+		uint32_t m_min_size = 4096;
+		uint64_t m_max_memory = 1024 * 1024 * 1024;
+		// the estimated memory held by each thread in the table
+		uint64_t m_thread_bytes = 4096;
+		double m_headroom = 4;
+		uint64_t m_interval_s = 30;
+	};
+
+	struct load_shedding_config {
+		bool m_enabled = false;
+		double m_raise_drop_rate = 0.01;
+		double m_lower_drop_rate = 0.001;
+		uint32_t m_lower_after_intervals = 5;
+		// the names of the events of each class, in the order in which
+		// the classes are shed
+		std::vector<std::vector<std::string>> m_classes;
+	};
+
+	// The event and alert budgets of each container, over which its
+	// events are sampled and its alerts aggregated
+	struct container_budgets_config {
+		bool m_enabled = false;
+		uint64_t m_max_evts_rate = 0;
+		uint64_t m_max_alerts_rate = 0;
+		uint32_t m_sampling_ratio = 10;
+		std::vector<std::string> m_sampled_events = {"read", "write", "readv", "writev", "pread", "pwrite", "recvfrom", "sendto", "recvmsg", "sendmsg"};
+		falco_common::priority_type m_keep_priority = falco_common::PRIORITY_CRITICAL;
+		uint64_t m_max_containers = 4096;
+	};
+
+	// The export of the metrics and of the timings of a sample of the
+	// alerts to an OpenTelemetry collector, with OTLP over HTTP
+	struct otlp_config {
+		bool m_enabled = false;
+		std::string m_endpoint = "http://localhost:4318";
+		// as "Name: value"
+		std::vector<std::string> m_headers;
+		uint32_t m_timeout_ms = 5000;
+		uint32_t m_max_queued_requests = 64;
+		std::string m_service_name = "falco";
+		bool m_metrics_enabled = true;
+		double m_traces_sampling_ratio = 0;
+	};
+
+	// How the metrics snapshots are written to metrics.output_file
+	struct metrics_file_config {
+		uint64_t m_buffer_size = 64 * 1024;
+		uint32_t m_flush_interval_ms = 1000;
+		uint64_t m_rotate_max_size = 0;
+		uint32_t m_rotate_max_files = 5;
+		uint64_t m_max_backlog_bytes = 4 * 1024 * 1024;
+	};
+
+	// The sessions of the sampling profiler, started with SIGUSR2 or with
+	// the /profile endpoint of the webserver
+	struct profiler_config {
+		bool m_enabled = false;
+		uint32_t m_frequency_hz = 99;
+		uint32_t m_duration_sec = 30;
+		std::string m_output_dir = "/tmp";
+	};
+
 	falco_configuration();
 	virtual ~falco_configuration() = default;
 
@@ -112,12 +243,19 @@ public:
 
 	std::string dump();
 
+	/*!
+		\brief Returns true if the given configuration only differs from
+		this one in the settings of the rules, of the outputs and of the
+		logs, which a restart can apply without reopening the inspectors.
+	*/
+	bool is_hot_reloadable_to(const falco_configuration& next) const;
+
 	static void read_rules_file_directory(const std::string& path, std::list<std::string>& rules_filenames, std::list<std::string> &rules_folders);
 
 	// Config list as passed by the user. Filenames.
 	std::list<std::string> m_loaded_configs_filenames;
 	// Map with filenames and their sha256 of the loaded configs files
-	std::unordered_map<std::string, std::string> m_loaded_configs_filenames_sha256sum;
+	std::unordered_map<std::string, falco::file_sha256sums::sum> m_loaded_configs_filenames_sha256sum;
 	// Config list as passed by the user. Folders.
 	std::list<std::string> m_loaded_configs_folders;
 
@@ -126,29 +264,64 @@ public:
 	// Actually loaded rules, with folders inspected
 	std::list<std::string> m_loaded_rules_filenames;
 	// Map with filenames and their sha256 of the loaded rules files
-	std::unordered_map<std::string, std::string> m_loaded_rules_filenames_sha256sum;
+	std::unordered_map<std::string, falco::file_sha256sums::sum> m_loaded_rules_filenames_sha256sum;
 	// List of loaded rule folders
 	std::list<std::string> m_loaded_rules_folders;
 	// Rule selection options passed by the user
 	std::vector<rule_selection_config> m_rules_selection;
+	// Rate limits of the rule alerts
+	std::vector<rate_limit_config> m_rule_rate_limits;
+	// Memory budget of the state of the threshold and sequence rules
+	uint64_t m_rule_state_max_memory;
+	// Number of threads compiling rules, 0 meaning one per CPU
+	uint32_t m_rules_compile_threads;
+	// Skip looking for warnings when loading the rules
+	bool m_rules_fast_load;
+	// Persistent cache of the compiled rules
+	bool m_rules_cache_enabled;
+	std::string m_rules_cache_path;
+	// Precompiled rules loaded instead of the rules files, if any
+	std::string m_rules_bundle_path;
+	// Drop the state of the rules loader once done loading rules
+	bool m_rules_release_loading_state;
+	// Back the arenas of the rules with huge pages, see rules_arena.h
+	bool m_rules_arena_hugepages;
 
 	bool m_json_output;
 	bool m_json_include_output_property;
 	bool m_json_include_tags_property;
 	std::string m_log_level;
+	// Capacity of the queue of the logs written in background, 0 to
+	// write them at once
+	uint32_t m_log_queue_capacity;
 	std::vector<falco::outputs::config> m_outputs;
 
 	falco_common::priority_type m_min_priority;
 	falco_common::rule_matching m_rule_matching;
+	bool m_rule_matching_adaptive_ordering_enabled;
+	uint64_t m_rule_matching_adaptive_ordering_interval;
 
 	bool m_watch_config_files;
+	// Keep the inspectors open on restarts that only change the rules,
+	// the outputs or the logs
+	bool m_hot_reload_keep_inspectors;
 	bool m_buffered_outputs;
 	size_t m_outputs_queue_capacity;
+	uint32_t m_outputs_queue_priority_reserve;
+	uint64_t m_outputs_queue_max_bytes;
+	falco::outputs::spill_config m_outputs_queue_spill;
+	falco::outputs::drain_config m_outputs_queue_drain;
+	bool m_outputs_queue_deferred_formatting;
+	falco::outputs::aggregation_config m_outputs_aggregation;
+	falco::outputs::recent_alerts_config m_recent_alerts;
 	bool m_time_format_iso_8601;
 	uint32_t m_output_timeout;
 
 	bool m_grpc_enabled;
 	uint32_t m_grpc_threadiness;
+	uint32_t m_grpc_contexts_per_thread;
+	std::vector<uint32_t> m_grpc_cpus;
+	bool m_grpc_rules_api;
 	std::string m_grpc_bind_address;
 	std::string m_grpc_private_key;
 	std::string m_grpc_cert_chain;
@@ -161,27 +334,53 @@ public:
 	double m_syscall_evt_drop_threshold;
 	double m_syscall_evt_drop_rate;
 	double m_syscall_evt_drop_max_burst;
+	syscall_evt_drop_throttle_config m_syscall_evt_drop_throttle;
 	// Only used for testing
 	bool m_syscall_evt_simulate_drops;
 
 	uint32_t m_syscall_evt_timeout_max_consecutives;
+	uint64_t m_syscall_evt_timeout_max_stall_ms;
 
 	uint32_t m_falco_libs_thread_table_size;
+	thread_table_autosize_config m_falco_libs_thread_table_autosize;
 
 	// User supplied base_syscalls, overrides any Falco state engine enforcement.
 	std::unordered_set<std::string> m_base_syscalls_custom_set;
 	bool m_base_syscalls_repair;
+	bool m_base_syscalls_live_update;
+	bool m_base_syscalls_kernel_prefilter;
 
 	// metrics configs
 	bool m_metrics_enabled;
 	std::string m_metrics_interval_str;
 	uint64_t m_metrics_interval;
+	// whether the metrics ticker is a thread rather than a timer signal
+	bool m_metrics_ticker_thread;
 	bool m_metrics_stats_rule_enabled;
 	std::string m_metrics_output_file;
+	metrics_file_config m_metrics_output_file_options;
 	uint32_t m_metrics_flags;
 	bool m_metrics_convert_memory_to_mb;
 	bool m_metrics_include_empty_values;
+	bool m_metrics_rules_profiling_enabled;
+	uint32_t m_metrics_rules_profiling_sampling_period;
+	bool m_metrics_event_stages_enabled;
+	bool m_metrics_syscall_cost_enabled;
+	bool m_metrics_event_types_enabled;
+	uint32_t m_metrics_rules_series_max;
+	std::unordered_set<std::string> m_metrics_rules_series_allowlist;
+	otlp_config m_otlp;
+	profiler_config m_profiler;
 	std::vector<plugin_config> m_plugins;
+	uint32_t m_plugin_sources_threads;
+	uint32_t m_plugin_event_batch_size;
+	bool m_idle_backoff_enabled;
+	idle_backoff_config m_idle_backoff;
+	std::vector<idle_backoff_config> m_idle_backoff_sources;
+	std::array<std::vector<uint32_t>, falco::thread_affinity::NUM_CLASSES> m_thread_affinity;
+	load_shedding_config m_load_shedding;
+	container_budgets_config m_container_budgets;
+	flight_recorder_config m_flight_recorder;
 
 	// Falco engine
 	engine_kind_t m_engine_mode = engine_kind_t::KMOD;
@@ -189,6 +388,7 @@ public:
 	ebpf_config m_ebpf = {};
 	modern_ebpf_config m_modern_ebpf = {};
 	replay_config m_replay = {};
+	buf_size_autosize_config m_buf_size_autosize = {};
 	gvisor_config m_gvisor = {};
 
 	// Needed by tests
@@ -295,6 +495,55 @@ namespace YAML {
 		}
 	};
 
+	template<>
+	struct convert<falco_configuration::rate_limit_config> {
+		static Node encode(const falco_configuration::rate_limit_config & rhs) {
+			Node node;
+			if(rhs.m_has_priority)
+			{
+				node["priority"] = falco_common::format_priority(rhs.m_priority);
+			}
+			else
+			{
+				node["rule"] = rhs.m_rule;
+			}
+			node["rate"] = rhs.m_limit.rate;
+			node["max_burst"] = rhs.m_limit.max_burst;
+			return node;
+		}
+
+		static bool decode(const Node& node, falco_configuration::rate_limit_config & rhs) {
+			if(!node.IsMap() || !node["rate"])
+			{
+				return false;
+			}
+
+			// exactly one of rule and priority
+			if(node["rule"].IsDefined() == node["priority"].IsDefined())
+			{
+				return false;
+			}
+			if(node["rule"])
+			{
+				rhs.m_rule = node["rule"].as<std::string>();
+			}
+			else
+			{
+				rhs.m_has_priority = true;
+				if(!falco_common::parse_priority(node["priority"].as<std::string>(), rhs.m_priority))
+				{
+					return false;
+				}
+			}
+
+			rhs.m_limit.rate = node["rate"].as<double>();
+			rhs.m_limit.max_burst = node["max_burst"]
+				? node["max_burst"].as<double>()
+				: std::max(1.0, rhs.m_limit.rate);
+			return rhs.m_limit.rate >= 0 && rhs.m_limit.max_burst >= 1;
+		}
+	};
+
 	template<>
 	struct convert<falco_configuration::plugin_config> {
 
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "container_budgets.h"
+
+#include <algorithm>
+
+using namespace falco;
+
+// only the thread of the source updates the counters
+static inline void add(std::atomic<uint64_t>& v, uint64_t n)
+{
+	v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+container_budgets::container_budgets(config c): m_config(std::move(c))
+{
+	m_config.m_sampling_ratio = std::max<uint32_t>(m_config.m_sampling_ratio, 1);
+}
+
+container_budgets::entry* container_budgets::track(const std::string& id)
+{
+	if(id.empty() || id == "host")
+	{
+		return nullptr;
+	}
+	auto it = m_containers.find(id);
+	if(it != m_containers.end())
+	{
+		return &it->second;
+	}
+	if(m_containers.size() >= m_config.m_max_containers)
+	{
+		return nullptr;
+	}
+	auto& e = m_containers[id];
+	e.id = id;
+	e.aggregated.container_id = id;
+	m_num_containers.store(m_containers.size(), std::memory_order_relaxed);
+	return &e;
+}
+
+bool container_budgets::aggregate(entry* c, falco_common::priority_type priority, const std::string& rule, uint64_t ts)
+{
+	if(c == nullptr)
+	{
+		return false;
+	}
+	c->alerts++;
+	// the lower the value, the more severe the priority
+	if(m_config.m_max_alerts_rate == 0
+		|| !(c->alerts_over || c->alerts > m_config.m_max_alerts_rate)
+		|| priority <= m_config.m_keep_priority)
+	{
+		return false;
+	}
+
+	auto& s = c->aggregated;
+	if(s.count == 0)
+	{
+		s.first_ts = ts;
+		s.priority = priority;
+	}
+	s.count++;
+	s.last_ts = ts;
+	s.priority = std::min(s.priority, priority);
+	s.rules[rule]++;
+	c->throttled++;
+	add(m_aggregated_alerts, 1);
+	return true;
+}
+
+// Closes the window of every container, keeping the summaries of their
+// aggregated alerts, and forgets the containers that had no event in it
+// once there are too many of them
+void container_budgets::roll(uint64_t window)
+{
+	m_window = window;
+	bool prune = m_containers.size() >= m_config.m_max_containers / 2;
+	bool erased = false;
+	uint64_t num_throttled = 0;
+	std::map<std::string, uint64_t> throttled;
+	for(auto it = m_containers.begin(); it != m_containers.end(); )
+	{
+		auto& e = it->second;
+		if(e.aggregated.count > 0)
+		{
+			if(m_summaries.size() >= s_max_summaries)
+			{
+				m_summaries.pop_front();
+				add(m_dropped_summaries, 1);
+			}
+			m_summaries.push_back(std::move(e.aggregated));
+			e.aggregated = summary();
+			e.aggregated.container_id = e.id;
+		}
+		if(e.throttled > 0)
+		{
+			num_throttled++;
+			throttled[e.id] = e.throttled;
+		}
+
+		if(prune && e.evts == 0)
+		{
+			it = m_containers.erase(it);
+			erased = true;
+			continue;
+		}
+		e.evts_over = m_config.m_max_evts_rate > 0 && e.evts > m_config.m_max_evts_rate;
+		e.alerts_over = m_config.m_max_alerts_rate > 0 && e.alerts > m_config.m_max_alerts_rate;
+		e.evts = 0;
+		e.alerts = 0;
+		e.throttled = 0;
+		++it;
+	}
+
+	// the threads can refer to the containers that were forgotten
+	if(erased)
+	{
+		m_threads.clear();
+	}
+	m_num_containers.store(m_containers.size(), std::memory_order_relaxed);
+	m_num_throttled.store(num_throttled, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lk(m_throttled_mtx);
+	m_throttled = std::move(throttled);
+}
+
+void container_budgets::take_summaries(std::vector<summary>& out)
+{
+	while(!m_summaries.empty())
+	{
+		out.push_back(std::move(m_summaries.front()));
+		m_summaries.pop_front();
+	}
+}
+
+void container_budgets::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["container_budgets.containers"] = m_num_containers.load(std::memory_order_relaxed);
+	metrics["container_budgets.throttled_containers"] = m_num_throttled.load(std::memory_order_relaxed);
+	metrics["container_budgets.skipped_evts"] = m_skipped_evts.load(std::memory_order_relaxed);
+	metrics["container_budgets.aggregated_alerts"] = m_aggregated_alerts.load(std::memory_order_relaxed);
+	metrics["container_budgets.dropped_summaries"] = m_dropped_summaries.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lk(m_throttled_mtx);
+	for(const auto& t : m_throttled)
+	{
+		metrics["container_budgets.throttled." + t.first] = t.second;
+	}
+}
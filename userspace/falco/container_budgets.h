@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "falco_common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief Keeps a single noisy container from starving the detection on
+	the rest of the node. The events and the alerts of each container are
+	counted over windows of one second of event time, and a container
+	exceeding its event budget in a window, or in the previous one, has
+	only one event out of sampling_ratio of the sampled event types
+	evaluated by the rules, while one exceeding its alert budget has its
+	alerts below keep_priority aggregated, into one summary per window.
+	The events of the host, and of the containers that don't fit in the
+	tracked ones, are never throttled. The events keep being parsed by
+	the inspector, so that its state is unaffected. The containers are
+	only counted by the thread of the source, and the metrics can be read
+	from any thread.
+*/
+class container_budgets
+{
+public:
+	struct config
+	{
+		// the events and alerts per second of a container, 0 for no budget
+		uint64_t m_max_evts_rate = 0;
+		uint64_t m_max_alerts_rate = 0;
+		uint32_t m_sampling_ratio = 10;
+		// by event type, whether the events of the type are sampled
+		std::vector<bool> m_sampled_evt_types;
+		falco_common::priority_type m_keep_priority = falco_common::PRIORITY_CRITICAL;
+		size_t m_max_containers = 4096;
+	};
+
+	/*!
+		\brief The alerts of a container aggregated over a window
+	*/
+	struct summary
+	{
+		std::string container_id;
+		uint64_t count = 0;
+		uint64_t first_ts = 0;
+		uint64_t last_ts = 0;
+		// the most severe priority of the alerts
+		falco_common::priority_type priority = falco_common::PRIORITY_DEBUG;
+		// the alerts of each rule
+		std::map<std::string, uint64_t> rules;
+	};
+
+	struct entry
+	{
+		std::string id;
+		// the counts of the current window
+		uint64_t evts = 0;
+		uint64_t alerts = 0;
+		// whether the budgets were exceeded in the previous window
+		bool evts_over = false;
+		bool alerts_over = false;
+		uint32_t sample_counter = 0;
+		// the events and alerts throttled in the current window
+		uint64_t throttled = 0;
+		summary aggregated;
+	};
+
+	explicit container_budgets(config c);
+
+	/*!
+		\brief Returns the container of the thread with the given tid and
+		clone timestamp, or nullptr if it's not tracked. The container id
+		is only obtained with extract() for the threads not seen before,
+		and an empty id or "host" are not containers.
+	*/
+	template<typename F>
+	inline entry* container(int64_t tid, uint64_t clone_ts, F&& extract)
+	{
+		auto it = m_threads.find(tid);
+		if(it != m_threads.end() && it->second.clone_ts == clone_ts) [[likely]]
+		{
+			return it->second.e;
+		}
+		if(m_threads.size() >= s_max_threads)
+		{
+			m_threads.clear();
+		}
+		auto e = track(extract());
+		m_threads[tid] = {clone_ts, e};
+		return e;
+	}
+
+	/*!
+		\brief Accounts an event of the given container, or of the host if
+		nullptr, with the given type and timestamp, and returns true if it
+		must skip the rules
+	*/
+	inline bool sample(entry* c, uint16_t evt_type, uint64_t ts)
+	{
+		uint64_t window = ts / s_window_ns;
+		if(window != m_window) [[unlikely]]
+		{
+			roll(window);
+		}
+		if(c == nullptr)
+		{
+			return false;
+		}
+		c->evts++;
+		if(m_config.m_max_evts_rate == 0
+			|| !(c->evts_over || c->evts > m_config.m_max_evts_rate)
+			|| evt_type >= m_config.m_sampled_evt_types.size()
+			|| !m_config.m_sampled_evt_types[evt_type])
+		{
+			return false;
+		}
+		if(c->sample_counter++ % m_config.m_sampling_ratio == 0)
+		{
+			return false;
+		}
+		c->throttled++;
+		m_skipped_evts.store(m_skipped_evts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/*!
+		\brief Accounts an alert of the given container, or of the host if
+		nullptr, and returns true if it's aggregated rather than emitted
+	*/
+	bool aggregate(entry* c, falco_common::priority_type priority, const std::string& rule, uint64_t ts);
+
+	/*!
+		\brief Moves the summaries of the windows that ended to out
+	*/
+	void take_summaries(std::vector<summary>& out);
+
+	inline bool has_summaries() const
+	{
+		return !m_summaries.empty();
+	}
+
+	/*!
+		\brief Adds to the given map the number of tracked and throttled
+		containers, the events that skipped the rules and the alerts that
+		were aggregated, as container_budgets.*, along with the events and
+		alerts throttled in the last window of each throttled container,
+		as container_budgets.throttled.<container id>
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	struct thread
+	{
+		uint64_t clone_ts = 0;
+		entry* e = nullptr;
+	};
+
+	static constexpr uint64_t s_window_ns = 1000000000;
+	static constexpr size_t s_max_threads = 65536;
+	static constexpr size_t s_max_summaries = 1024;
+
+	entry* track(const std::string& id);
+	void roll(uint64_t window);
+
+	config m_config;
+	uint64_t m_window = 0;
+	std::unordered_map<std::string, entry> m_containers;
+	std::unordered_map<int64_t, thread> m_threads;
+	std::deque<summary> m_summaries;
+
+	std::atomic<uint64_t> m_num_containers{0};
+	std::atomic<uint64_t> m_num_throttled{0};
+	std::atomic<uint64_t> m_skipped_evts{0};
+	std::atomic<uint64_t> m_aggregated_alerts{0};
+	std::atomic<uint64_t> m_dropped_summaries{0};
+	// the containers throttled in the last window, by id
+	mutable std::mutex m_throttled_mtx;
+	std::map<std::string, uint64_t> m_throttled;
+};
+
+} // namespace falco
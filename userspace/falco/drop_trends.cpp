@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "drop_trends.h"
+
+#include <algorithm>
+
+falco::drop_trends::drop_trends(std::vector<std::string> categories, size_t window)
+	: m_categories(std::move(categories)),
+	  m_window(std::max<size_t>(window, 1)),
+	  m_deltas(m_categories.size() * m_window, 0)
+{
+}
+
+void falco::drop_trends::record(const std::vector<uint64_t>& deltas)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	auto row = m_deltas.begin() + m_next * m_categories.size();
+	for(size_t i = 0; i < m_categories.size(); i++)
+	{
+		row[i] = i < deltas.size() ? deltas[i] : 0;
+	}
+	m_next = (m_next + 1) % m_window;
+	m_recorded = std::min(m_recorded + 1, m_window);
+}
+
+std::vector<falco::drop_trends::rates> falco::drop_trends::get_rates() const
+{
+	std::vector<rates> res(m_categories.size());
+	std::lock_guard<std::mutex> lock(m_mtx);
+	size_t last = (m_next + m_window - 1) % m_window;
+	for(size_t i = 0; i < m_categories.size(); i++)
+	{
+		auto& r = res[i];
+		r.category = m_categories[i];
+		if(m_recorded == 0)
+		{
+			continue;
+		}
+		r.last = m_deltas[last * m_categories.size() + i];
+		for(size_t j = 0; j < m_recorded; j++)
+		{
+			auto v = m_deltas[j * m_categories.size() + i];
+			r.max = std::max(r.max, v);
+			r.total += v;
+		}
+	}
+	return res;
+}
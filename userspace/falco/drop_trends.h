@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief Keeps the number of events dropped by the kernel in each
+	category for each of the last intervals, so that the drops can be
+	reported continuously as rates and trends instead of only when a drop
+	action fires. The deltas are recorded by the thread of the syscall
+	source once per interval, and the rates can be read from any thread.
+*/
+class drop_trends
+{
+public:
+	struct rates
+	{
+		std::string category;
+		// the drops in the last interval
+		uint64_t last = 0;
+		// the most drops in one interval of the window
+		uint64_t max = 0;
+		// the drops in all the intervals of the window
+		uint64_t total = 0;
+	};
+
+	/*!
+		\brief Creates the trends of the given categories over a window
+		of the given number of intervals
+	*/
+	drop_trends(std::vector<std::string> categories, size_t window);
+
+	/*!
+		\brief Records the drops of the last interval, one value for
+		each category, in the order in which they were given
+	*/
+	void record(const std::vector<uint64_t>& deltas);
+
+	std::vector<rates> get_rates() const;
+
+	inline size_t window() const
+	{
+		return m_window;
+	}
+
+private:
+	std::vector<std::string> m_categories;
+	size_t m_window;
+
+	mutable std::mutex m_mtx;
+	// m_window rows of one value per category, used as a ring
+	std::vector<uint64_t> m_deltas;
+	size_t m_next = 0;
+	size_t m_recorded = 0;
+};
+
+} // namespace falco
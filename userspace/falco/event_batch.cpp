@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "event_batch.h"
+
+using namespace falco;
+
+event_batch::event_batch(sinsp* inspector, size_t capacity): m_slots(capacity)
+{
+	for(auto& s : m_slots)
+	{
+		s.evt = std::make_unique<sinsp_evt>(inspector);
+	}
+	m_evts.reserve(capacity);
+}
+
+bool event_batch::add(sinsp_evt* evt)
+{
+	auto& s = m_slots[m_evts.size()];
+	auto pevt = evt->get_scap_evt();
+	auto data = reinterpret_cast<const uint8_t*>(pevt);
+	s.data.assign(data, data + pevt->len);
+
+	// the copy keeps the number and the source of the original, which
+	// the engine and the plugin fields rely on
+	s.evt->init(s.data.data(), evt->get_cpuid());
+	s.evt->set_num(evt->get_num());
+	s.evt->set_source_idx(evt->get_source_idx());
+	s.evt->set_source_name(evt->get_source_name());
+	m_evts.push_back(s.evt.get());
+	return m_evts.size() == m_slots.size();
+}
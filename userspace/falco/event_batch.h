@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/sinsp.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief A batch of events of a plugin source, copied from the ones
+	returned by an inspector, so that they stay valid while the inspector
+	moves on to the next ones and can be evaluated together. Only the
+	events themselves are copied, which is all the state plugin events
+	have, so this is not meant for syscall events. The buffers of the
+	events are reused from one batch to the next.
+*/
+class event_batch
+{
+public:
+	event_batch(sinsp* inspector, size_t capacity);
+
+	event_batch(const event_batch&) = delete;
+	event_batch& operator = (const event_batch&) = delete;
+
+	/*!
+		\brief Copies the given event at the end of the batch, and returns
+		true if the batch is full afterwards
+	*/
+	bool add(sinsp_evt* evt);
+
+	inline sinsp_evt* const* events() const
+	{
+		return m_evts.data();
+	}
+
+	inline size_t size() const
+	{
+		return m_evts.size();
+	}
+
+	inline bool empty() const
+	{
+		return m_evts.empty();
+	}
+
+	inline size_t capacity() const
+	{
+		return m_slots.size();
+	}
+
+	/*!
+		\brief Empties the batch, keeping the buffers of the events
+	*/
+	inline void clear()
+	{
+		m_evts.clear();
+	}
+
+private:
+	struct slot
+	{
+		std::vector<uint8_t> data;
+		std::unique_ptr<sinsp_evt> evt;
+	};
+
+	std::vector<slot> m_slots;
+	std::vector<sinsp_evt*> m_evts;
+};
+
+} // namespace falco
@@ -18,6 +18,8 @@ limitations under the License.
 #include "event_drops.h"
 #include "falco_common.h"
 
+#include <algorithm>
+
 syscall_evt_drop_mgr::syscall_evt_drop_mgr():
 	m_num_syscall_evt_drops(0),
 	m_num_actions(0),
@@ -25,7 +27,15 @@ syscall_evt_drop_mgr::syscall_evt_drop_mgr():
 	m_outputs(NULL),
 	m_next_check_ts(0),
 	m_simulate_drops(false),
-	m_threshold(0)
+	m_threshold(0),
+	m_shedder(nullptr),
+	m_autosizer(nullptr),
+	m_trends(nullptr),
+	m_throttle_after_intervals(0),
+	m_throttle_restore_after_intervals(0),
+	m_throttle_intervals(0),
+	m_throttled(false),
+	m_num_throttles(0)
 {
 }
 
@@ -39,7 +49,10 @@ void syscall_evt_drop_mgr::init(std::shared_ptr<sinsp> inspector,
 				double threshold,
 				double rate,
 				double max_tokens,
-				bool simulate_drops)
+				bool simulate_drops,
+				falco::load_shedder* shedder,
+				falco::buffer_autosizer* autosizer,
+				falco::drop_trends* trends)
 {
 	m_inspector = inspector;
 	m_outputs = outputs;
@@ -54,6 +67,52 @@ void syscall_evt_drop_mgr::init(std::shared_ptr<sinsp> inspector,
 	{
 		m_threshold = 0;
 	}
+	m_shedder = shedder;
+	m_autosizer = autosizer;
+	m_trends = trends;
+}
+
+const std::vector<std::string>& syscall_evt_drop_mgr::drop_categories()
+{
+	// note: these are the drop counters of scap_stats without the n_drops_
+	// prefix, in the order in which process_event() records them
+	static const std::vector<std::string> categories = {
+		"total",
+		"buffer_total",
+		"buffer_clone_fork_enter",
+		"buffer_clone_fork_exit",
+		"buffer_execve_enter",
+		"buffer_execve_exit",
+		"buffer_connect_enter",
+		"buffer_connect_exit",
+		"buffer_open_enter",
+		"buffer_open_exit",
+		"buffer_dir_file_enter",
+		"buffer_dir_file_exit",
+		"buffer_other_interest_enter",
+		"buffer_other_interest_exit",
+		"buffer_close_exit",
+		"buffer_proc_exit",
+		"scratch_map",
+		"page_faults",
+		"bug",
+	};
+	return categories;
+}
+
+void syscall_evt_drop_mgr::set_throttle(const libsinsp::events::set<ppm_sc_code>& sc_set,
+				uint32_t after_intervals,
+				uint32_t restore_after_intervals)
+{
+	if(m_throttled)
+	{
+		set_throttled(false);
+	}
+	m_throttle_sc_set = sc_set;
+	m_throttle_after_intervals = std::max<uint32_t>(after_intervals, 1);
+	m_throttle_restore_after_intervals = std::max<uint32_t>(restore_after_intervals, 1);
+	m_throttle_intervals = 0;
+	m_throttled = false;
 }
 
 bool syscall_evt_drop_mgr::process_event(std::shared_ptr<sinsp> inspector, sinsp_evt *evt)
@@ -99,10 +158,55 @@ bool syscall_evt_drop_mgr::process_event(std::shared_ptr<sinsp> inspector, sinsp
 
 		if(m_simulate_drops)
 		{
-			falco_logger::log(falco_logger::level::INFO, "Simulating syscall event drop");
+			FALCO_LOG(falco_logger::level::INFO, "Simulating syscall event drop");
 			delta.n_drops++;
 		}
 
+		if(m_trends != nullptr)
+		{
+			m_trends->record({
+				delta.n_drops,
+				delta.n_drops_buffer,
+				delta.n_drops_buffer_clone_fork_enter,
+				delta.n_drops_buffer_clone_fork_exit,
+				delta.n_drops_buffer_execve_enter,
+				delta.n_drops_buffer_execve_exit,
+				delta.n_drops_buffer_connect_enter,
+				delta.n_drops_buffer_connect_exit,
+				delta.n_drops_buffer_open_enter,
+				delta.n_drops_buffer_open_exit,
+				delta.n_drops_buffer_dir_file_enter,
+				delta.n_drops_buffer_dir_file_exit,
+				delta.n_drops_buffer_other_interest_enter,
+				delta.n_drops_buffer_other_interest_exit,
+				delta.n_drops_buffer_close_exit,
+				delta.n_drops_buffer_proc_exit,
+				delta.n_drops_scratch_map,
+				delta.n_drops_pf,
+				delta.n_drops_bug,
+			});
+		}
+
+		if(m_autosizer != nullptr && m_autosizer->update(delta.n_evts, delta.n_drops))
+		{
+			auto preset = m_autosizer->recommended_preset();
+			FALCO_LOG(falco_logger::level::INFO, "Syscall events dropped in " + std::to_string(m_autosizer->drop_intervals())
+				+ " intervals with 'buf_size_preset' " + std::to_string(m_autosizer->preset())
+				+ ", recommending 'buf_size_preset' " + std::to_string(preset)
+				+ " (" + std::to_string(falco::buffer_autosizer::preset_bytes(preset) >> 20) + " MB per buffer)\n");
+		}
+
+		if(m_shedder != nullptr && m_shedder->update(delta.n_evts, delta.n_drops))
+		{
+			FALCO_LOG(falco_logger::level::INFO, "Load shedding level changed to " + std::to_string(m_shedder->level())
+				+ " of " + std::to_string(m_shedder->max_level()) + "\n");
+		}
+
+		if(!m_throttle_sc_set.empty())
+		{
+			update_throttle(delta.n_drops > 0 && (double)delta.n_drops / delta.n_evts > m_threshold);
+		}
+
 		if(delta.n_drops > 0)
 		{
 			double ratio = delta.n_drops;
@@ -124,7 +228,7 @@ bool syscall_evt_drop_mgr::process_event(std::shared_ptr<sinsp> inspector, sinsp
 				}
 				else
 				{
-					falco_logger::log(falco_logger::level::DEBUG, "Syscall event drop but token bucket depleted, skipping actions");
+					FALCO_LOG(falco_logger::level::DEBUG, "Syscall event drop but token bucket depleted, skipping actions");
 				}
 			}
 		}
@@ -133,11 +237,66 @@ bool syscall_evt_drop_mgr::process_event(std::shared_ptr<sinsp> inspector, sinsp
 	return true;
 }
 
+void syscall_evt_drop_mgr::update_throttle(bool dropping)
+{
+	// count the consecutive intervals with drops when not throttled, and
+	// the ones without when throttled
+	if(dropping != m_throttled)
+	{
+		m_throttle_intervals = 0;
+		return;
+	}
+
+	m_throttle_intervals++;
+	if(!m_throttled && m_throttle_intervals >= m_throttle_after_intervals)
+	{
+		set_throttled(true);
+	}
+	else if(m_throttled && m_throttle_intervals >= m_throttle_restore_after_intervals)
+	{
+		set_throttled(false);
+	}
+}
+
+void syscall_evt_drop_mgr::set_throttled(bool throttled)
+{
+	m_throttle_intervals = 0;
+	try
+	{
+		for(const auto& sc : m_throttle_sc_set)
+		{
+			m_inspector->mark_ppm_sc_of_interest(sc, !throttled);
+		}
+	}
+	catch(const std::exception& e)
+	{
+		FALCO_LOG(falco_logger::level::ERR, "Could not change the collected syscalls, disabling the throttle action: " + std::string(e.what()) + "\n");
+		m_throttle_sc_set.clear();
+		return;
+	}
+
+	m_throttled = throttled;
+	if(throttled)
+	{
+		m_num_throttles++;
+		FALCO_LOG(falco_logger::level::WARNING, "Sustained syscall event drops, throttling " + std::to_string(m_throttle_sc_set.size()) + " syscalls: "
+			+ concat_set_in_order(libsinsp::events::sc_set_to_event_names(m_throttle_sc_set)) + "\n");
+	}
+	else
+	{
+		FALCO_LOG(falco_logger::level::INFO, "Syscall event drops subsided, collecting the throttled syscalls again\n");
+	}
+}
+
 void syscall_evt_drop_mgr::print_stats()
 {
 	fprintf(stderr, "Syscall event drop monitoring:\n");
 	fprintf(stderr, "   - event drop detected: %lu occurrences\n", m_num_syscall_evt_drops);
 	fprintf(stderr, "   - num times actions taken: %lu\n", m_num_actions);
+	if(!m_throttle_sc_set.empty())
+	{
+		fprintf(stderr, "   - num times syscalls throttled: %lu\n", m_num_throttles);
+	}
 }
 
 bool syscall_evt_drop_mgr::perform_actions(uint64_t now, const scap_stats &delta, bool bpf_enabled)
@@ -153,7 +312,7 @@ bool syscall_evt_drop_mgr::perform_actions(uint64_t now, const scap_stats &delta
 			return true;
 
 		case syscall_evt_drop_action::LOG:
-			falco_logger::log(falco_logger::level::DEBUG, std::move(msg));
+			FALCO_LOG(falco_logger::level::DEBUG, std::move(msg));
 			return true;
 
 		case syscall_evt_drop_action::ALERT:
@@ -194,13 +353,18 @@ bool syscall_evt_drop_mgr::perform_actions(uint64_t now, const scap_stats &delta
 			m_outputs->handle_msg(now, falco_common::PRIORITY_DEBUG, msg, rule, output_fields);
 			return true;
 		}
+		case syscall_evt_drop_action::THROTTLE:
+			// note: throttling follows the drops of each interval
+			// and is not subject to the token bucket
+			break;
+
 		case syscall_evt_drop_action::EXIT:
-			falco_logger::log(falco_logger::level::CRIT, std::move(msg));
-			falco_logger::log(falco_logger::level::CRIT, "Exiting.");
+			FALCO_LOG(falco_logger::level::CRIT, std::move(msg));
+			FALCO_LOG(falco_logger::level::CRIT, "Exiting.");
 			return false;
 
 		default:
-			falco_logger::log(falco_logger::level::ERR, "Ignoring unknown action " + std::to_string(int(act)));
+			FALCO_LOG(falco_logger::level::ERR, "Ignoring unknown action " + std::to_string(int(act)));
 			return true;
 		}
 	}
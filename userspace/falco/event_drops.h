@@ -20,10 +20,13 @@ limitations under the License.
 #include <unordered_set>
 
 #include <libsinsp/sinsp.h>
-#include <libsinsp/token_bucket.h>
 
 #include "logger.h"
 #include "falco_outputs.h"
+#include "buffer_autosizer.h"
+#include "drop_trends.h"
+#include "load_shedder.h"
+#include "rate_limiting.h"
 
 // The possible actions that this class can take upon
 // detecting a syscall event drop.
@@ -32,7 +35,8 @@ enum class syscall_evt_drop_action : uint8_t
 	DISREGARD = 0,
 	LOG,
 	ALERT,
-	EXIT
+	EXIT,
+	THROTTLE
 };
 
 using syscall_evt_drop_actions = std::unordered_set<syscall_evt_drop_action>;
@@ -49,11 +53,28 @@ public:
 		  double threshold,
 		  double rate,
 		  double max_tokens,
-		  bool simulate_drops);
+		  bool simulate_drops,
+		  falco::load_shedder* shedder = nullptr,
+		  falco::buffer_autosizer* autosizer = nullptr,
+		  falco::drop_trends* trends = nullptr);
+
+	// The categories of drops recorded in the trends, in order.
+	static const std::vector<std::string>& drop_categories();
+
+	// Sets the syscalls that the THROTTLE action stops collecting
+	// after the given number of consecutive intervals with drops, and
+	// collects again after the given number of consecutive intervals
+	// without drops. The syscalls being throttled, if any, are
+	// collected again first.
+	void set_throttle(const libsinsp::events::set<ppm_sc_code>& sc_set,
+			  uint32_t after_intervals,
+			  uint32_t restore_after_intervals);
 
 	// Call this for every event. The class will take care of
 	// periodically measuring the scap stats, looking for syscall
-	// event drops, and performing any actions.
+	// event drops, performing any actions, and updating the level
+	// of the load shedder, the recommendation of the buffer autosizer
+	// and the drop trends, if any.
 	//
 	// Returns whether event processing should continue or stop (with an error).
 	bool process_event(std::shared_ptr<sinsp> inspector, sinsp_evt *evt);
@@ -64,14 +85,28 @@ protected:
 	// Perform all configured actions.
 	bool perform_actions(uint64_t now, const scap_stats &delta, bool bpf_enabled);
 
+	// Engages or releases the throttling depending on whether there were
+	// drops in the last interval.
+	void update_throttle(bool dropping);
+	void set_throttled(bool throttled);
+
 	uint64_t m_num_syscall_evt_drops;
 	uint64_t m_num_actions;
 	std::shared_ptr<sinsp> m_inspector;
 	std::shared_ptr<falco_outputs> m_outputs;
 	syscall_evt_drop_actions m_actions;
-	token_bucket m_bucket;
+	falco::token_bucket m_bucket;
 	uint64_t m_next_check_ts;
 	scap_stats m_last_stats;
 	bool m_simulate_drops;
 	double m_threshold;
+	falco::load_shedder* m_shedder;
+	falco::buffer_autosizer* m_autosizer;
+	falco::drop_trends* m_trends;
+	libsinsp::events::set<ppm_sc_code> m_throttle_sc_set;
+	uint32_t m_throttle_after_intervals;
+	uint32_t m_throttle_restore_after_intervals;
+	uint32_t m_throttle_intervals;
+	bool m_throttled;
+	uint64_t m_num_throttles;
 };
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "event_fast_path.h"
+
+using namespace falco;
+
+event_fast_path::event_fast_path(const std::string& source): m_source(source)
+{
+}
+
+void event_fast_path::update(falco_engine& engine, uint64_t generation)
+{
+	m_evt_codes = engine.event_codes_for_ruleset(m_source);
+	m_generation = generation;
+}
+
+void event_fast_path::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["fast_path_evts"] = m_skipped_evts.load(std::memory_order_relaxed);
+}
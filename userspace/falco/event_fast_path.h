@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "falco_engine.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace falco
+{
+
+/*!
+	\brief Lets the events of the types that no enabled rule of a source
+	needs skip the rule engine and the outputs. Such events, as most of
+	the ones only collected to keep the state of the inspector in sync,
+	are still parsed by the inspector and accounted everywhere else. The
+	event types needed by the rules are kept as a bitmap, computed again
+	whenever the rules of the engine change. The bitmap is used by the
+	thread of the source, and the metrics can be read from any thread.
+*/
+class event_fast_path
+{
+public:
+	explicit event_fast_path(const std::string& source);
+
+	/*!
+		\brief Computes the event types needed by the enabled rules of the
+		source again if the rules of the engine changed since the last call
+	*/
+	inline void refresh(falco_engine& engine)
+	{
+		uint64_t generation = engine.rules_generation();
+		if(generation != m_generation) [[unlikely]]
+		{
+			update(engine, generation);
+		}
+	}
+
+	/*!
+		\brief Returns true if no enabled rule needs the events of the
+		given type, and accounts them
+	*/
+	inline bool skips(uint16_t evt_type)
+	{
+		if(m_evt_codes.contains((ppm_event_code) evt_type))
+		{
+			return false;
+		}
+		m_skipped_evts.store(m_skipped_evts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/*!
+		\brief Adds to the given map the number of events that skipped
+		the rules, as fast_path_evts
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	void update(falco_engine& engine, uint64_t generation);
+
+	std::string m_source;
+	// the generation of the rules m_evt_codes was computed for, see
+	// falco_engine::rules_generation()
+	uint64_t m_generation = UINT64_MAX;
+	libsinsp::events::set<ppm_event_code> m_evt_codes;
+
+	std::atomic<uint64_t> m_skipped_evts{0};
+};
+
+} // namespace falco
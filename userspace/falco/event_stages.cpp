@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "event_stages.h"
+
+const char* falco::event_stages::name(stage s)
+{
+	switch(s)
+	{
+	case READ:
+		return "read";
+	case STATS:
+		return "stats";
+	case DROPS:
+		return "drops";
+	case RULES:
+		return "rules";
+	case OUTPUTS:
+		return "outputs";
+	default:
+		return "unknown";
+	}
+}
+
+void falco::event_stages::record(const durations& d)
+{
+	for(size_t i = 0; i < NUM_STAGES; i++)
+	{
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d[i]).count();
+		m_time_ns[i].fetch_add(ns > 0 ? ns : 0, std::memory_order_relaxed);
+	}
+	m_num_timed.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t falco::event_stages::max_evts_rate(stage s) const
+{
+	uint64_t ns = m_time_ns[s].load(std::memory_order_relaxed);
+	uint64_t n = num_timed();
+	if(n == 0)
+	{
+		return 0;
+	}
+	if(ns == 0)
+	{
+		// too fast to be measured
+		return UINT64_MAX;
+	}
+	return (uint64_t) ((double) n * 1e9 / ns);
+}
+
+void falco::event_stages::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	for(size_t i = 0; i < NUM_STAGES; i++)
+	{
+		auto s = (stage) i;
+		metrics[std::string(name(s)) + ".time_ns"] = time_ns(s);
+		metrics[std::string(name(s)) + ".max_evts_rate_sec"] = max_evts_rate(s);
+	}
+}
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace falco
+{
+
+/*!
+	\brief The time spent by the event processing loop of a source in each
+	of its stages, which are reading the next event from the inspector
+	(which parses it and updates the state), collecting the stats to be
+	written, checking for kernel drops, evaluating the rules on it, and
+	handling the alerts of the matching ones. To keep the overhead low,
+	the stages are only timed on one event every sampling_period, and the
+	total times are extrapolated from the timed events. The stages are
+	recorded by the thread of the source and can be read from any thread.
+*/
+class event_stages
+{
+public:
+	enum stage
+	{
+		READ = 0,
+		STATS,
+		DROPS,
+		RULES,
+		OUTPUTS,
+		NUM_STAGES
+	};
+
+	static constexpr uint32_t sampling_period = 256;
+
+	using durations = std::array<std::chrono::steady_clock::duration, NUM_STAGES>;
+
+	static const char* name(stage s);
+
+	/*!
+		\brief Returns true if the event being processed is to be timed,
+		which is the case once every sampling_period events. This is only
+		invoked by the thread of the source.
+	*/
+	inline bool sample()
+	{
+		if(++m_countdown < sampling_period)
+		{
+			return false;
+		}
+		m_countdown = 0;
+		return true;
+	}
+
+	void record(const durations& d);
+
+	inline uint64_t num_timed() const
+	{
+		return m_num_timed.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the estimated time spent in the given stage in
+		nanoseconds, extrapolated from the timed events
+	*/
+	inline uint64_t time_ns(stage s) const
+	{
+		return m_time_ns[s].load(std::memory_order_relaxed) * sampling_period;
+	}
+
+	/*!
+		\brief Returns the number of events per second the given stage
+		can process on its own, i.e. the throughput of the processing
+		loop if the other stages took no time, or 0 if no event was timed
+	*/
+	uint64_t max_evts_rate(stage s) const;
+
+	/*!
+		\brief Adds to the given map the estimated time and the maximum
+		throughput of each stage, as <stage>.time_ns and
+		<stage>.max_evts_rate_sec
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	uint32_t m_countdown = 0;
+	std::atomic<uint64_t> m_num_timed{0};
+	std::array<std::atomic<uint64_t>, NUM_STAGES> m_time_ns{};
+};
+
+} // namespace falco
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "event_types.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+falco::event_types::event_types(const std::vector<std::string>& names):
+	m_num_evt_types(names.size()),
+	m_name_idx(names.size(), UINT32_MAX),
+	m_counts(new std::atomic<uint64_t>[names.size()]()),
+	m_timed(new std::atomic<uint64_t>[names.size()]()),
+	m_timed_ns(new std::atomic<uint64_t>[names.size()]())
+{
+	std::unordered_map<std::string, uint32_t> idx;
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		if(names[i].empty())
+		{
+			continue;
+		}
+		auto it = idx.emplace(names[i], (uint32_t) m_names.size()).first;
+		if(it->second == m_names.size())
+		{
+			m_names.push_back(names[i]);
+		}
+		m_name_idx[i] = it->second;
+	}
+}
+
+void falco::event_types::record(uint16_t evt_type, std::chrono::steady_clock::duration rules_time)
+{
+	if(evt_type >= m_num_evt_types)
+	{
+		return;
+	}
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(rules_time).count();
+	m_timed[evt_type].fetch_add(1, std::memory_order_relaxed);
+	m_timed_ns[evt_type].fetch_add(ns > 0 ? ns : 0, std::memory_order_relaxed);
+}
+
+std::vector<falco::event_types::type_stats> falco::event_types::get_stats(size_t max) const
+{
+	std::vector<type_stats> stats(m_names.size());
+	for(size_t i = 0; i < m_names.size(); i++)
+	{
+		stats[i].name = m_names[i];
+	}
+	for(size_t t = 0; t < m_num_evt_types; t++)
+	{
+		if(m_name_idx[t] == UINT32_MAX)
+		{
+			continue;
+		}
+		auto& s = stats[m_name_idx[t]];
+		uint64_t events = m_counts[t].load(std::memory_order_relaxed);
+		uint64_t timed = m_timed[t].load(std::memory_order_relaxed);
+		s.events += events;
+		if(timed > 0)
+		{
+			// the average time of the timed events of the type, applied
+			// to all of them
+			s.rules_time_ns += (uint64_t) ((double) m_timed_ns[t].load(std::memory_order_relaxed) / timed * events);
+		}
+	}
+
+	stats.erase(std::remove_if(stats.begin(), stats.end(),
+		[](const type_stats& s) { return s.events == 0; }), stats.end());
+	std::stable_sort(stats.begin(), stats.end(),
+		[](const type_stats& a, const type_stats& b) { return a.events > b.events; });
+	if(max > 0 && stats.size() > max)
+	{
+		stats.resize(max);
+	}
+	return stats;
+}
+
+void falco::event_types::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	for(const auto& s : get_stats())
+	{
+		metrics[s.name + ".num_evts"] = s.events;
+		metrics[s.name + ".rules_time_ns"] = s.rules_time_ns;
+	}
+}
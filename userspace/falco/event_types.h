@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief The events processed by the loop of a source and the time the
+	engine spent on them, broken down by event type, so that the types
+	flooding a source, e.g. read and write, can be told apart from the
+	ones costing the most to the rules. The event types sharing a name,
+	e.g. the enter and exit events of a syscall, are reported together.
+	Every event is counted, while the engine is only timed on one event
+	every sampling_period, and the time spent on each type is extrapolated
+	from its timed events. The events are recorded by the thread of the
+	source and can be read from any thread.
+*/
+class event_types
+{
+public:
+	static constexpr uint32_t sampling_period = 64;
+
+	struct type_stats
+	{
+		std::string name;
+		uint64_t events = 0;
+		// the estimated time spent by the engine on the events
+		uint64_t rules_time_ns = 0;
+	};
+
+	/*!
+		\brief Creates the counters of the event types whose names are
+		given, indexed by type, where the types with an empty name are not
+		counted
+	*/
+	explicit event_types(const std::vector<std::string>& names);
+
+	inline void count(uint16_t evt_type)
+	{
+		if(evt_type < m_num_evt_types) [[likely]]
+		{
+			auto& c = m_counts[evt_type];
+			c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	}
+
+	/*!
+		\brief Returns true if the engine is to be timed on the event
+		being processed, which is the case once every sampling_period
+		events. This is only invoked by the thread of the source.
+	*/
+	inline bool sample()
+	{
+		if(++m_countdown < sampling_period)
+		{
+			return false;
+		}
+		m_countdown = 0;
+		return true;
+	}
+
+	void record(uint16_t evt_type, std::chrono::steady_clock::duration rules_time);
+
+	/*!
+		\brief Returns the event types with at least one event, by
+		decreasing number of events, up to max of them unless it's 0
+	*/
+	std::vector<type_stats> get_stats(size_t max = 0) const;
+
+	/*!
+		\brief Adds to the given map the events of each event type and the
+		time spent on them, as <name>.num_evts and <name>.rules_time_ns
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	size_t m_num_evt_types;
+	// the index of the name of each type in m_names
+	std::vector<uint32_t> m_name_idx;
+	std::vector<std::string> m_names;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_timed;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_timed_ns;
+	uint32_t m_countdown = 0;
+};
+
+} // namespace falco
@@ -25,6 +25,9 @@ limitations under the License.
 
 static void display_fatal_err(const std::string &&msg)
 {
+	// the fatal error comes after the logs still queued
+	falco_logger::stop_async();
+
 	/**
 	 * If stderr logging is not enabled, also log to stderr.
 	 */
@@ -47,6 +50,7 @@ int falco_run(int argc, char **argv, bool &restart)
 	{
 		if (!falco::app::run(argc, argv, restart, errstr))
 		{
+			falco_logger::stop_async();
 			fprintf(stderr, "Error: %s\n", errstr.c_str());
 			return EXIT_FAILURE;
 		}
@@ -75,6 +79,7 @@ int main(int argc, char **argv)
 	while((rc = falco_run(argc, argv, restart)) == EXIT_SUCCESS && restart)
 	{
 	}
+	falco_logger::stop_async();
 
 	return rc;
 }
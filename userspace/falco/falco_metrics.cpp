@@ -18,17 +18,30 @@ limitations under the License.
 #include "falco_metrics.h"
 
 #include "falco_utils.h"
+#include "logger.h"
 
 #include "app/state.h"
 
 #include <libsinsp/sinsp.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include <zlib.h>
+
 namespace fs = std::filesystem;
 
 /*!
 	\class falco_metrics
 	\brief This class is used to convert the metrics provided by the application
 	and falco libs into a string to be return by the metrics endpoint.
+	The metrics are rendered by the stats writer worker, with the libs
+	metrics captured on the thread of each inspector, and published as an
+	immutable snapshot that the webserver threads serve as-is, so that
+	scrapes never touch the state of the inspectors nor wait for a
+	rendering. The series that do not change while Falco runs are rendered
+	once.
 */
 
 /*!
@@ -40,193 +53,1042 @@ namespace fs = std::filesystem;
 */
 const std::string falco_metrics::content_type = "text/plain; version=0.0.4";
 
+/*!
+	\brief Returns the type of an outputs metric, which is a counter except
+	for the maxima, the latency percentiles, the depths and capacities, the
+	alerts pending in a spill buffer, and the subscribers of an output and
+	their lag
+*/
+static metrics_v2_metric_type output_metric_type(const std::string& name)
+{
+	auto ends_with = [&](const std::string& suffix)
+	{
+		return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+	if (ends_with("_max") || ends_with("_us_p50") || ends_with("_us_p90") || ends_with("_us_p99") || ends_with("_depth") || ends_with("_capacity") || ends_with("_bytes") || name == "spill_pending" || name == "subscribers" || name == "subscriber_lag" || name == "endpoint_healthy")
+	{
+		return METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT;
+	}
+	return METRIC_VALUE_METRIC_TYPE_MONOTONIC;
+}
+
 
 /*!
-	\brief this method takes an application \c state and returns a textual representation of
-	its configured metrics.
+	\brief Renders the end-to-end detection latencies of the outputs, from the
+	events to their alerts being output, as a Prometheus histogram with one
+	series per output, e.g.
+	outputs_detection_latency_seconds_bucket{output="http",le="0.001024"}
+*/
+static void render_detection_latencies(const falco_outputs& outputs, std::string& prometheus_text)
+{
+	using falco::outputs::latency_histogram;
+	static const std::string name = "falcosecurity_falco_outputs_detection_latency_seconds";
+	auto latencies = outputs.get_outputs_detection_latencies();
+	if (latencies.empty())
+	{
+		return;
+	}
+
+	prometheus_text += "# HELP " + name + " https://falco.org/docs/metrics/\n";
+	prometheus_text += "# TYPE " + name + " histogram\n";
+	char le[32];
+	for (const auto& item : latencies)
+	{
+		const auto& h = *item.second;
+		std::string labels = "output=\"" + item.first + "\"";
+		uint64_t count = 0;
+		// the last bucket has no upper bound, and only counts in +Inf
+		for (size_t i = 0; i < latency_histogram::num_buckets - 1; i++)
+		{
+			count += h.bucket(i);
+			snprintf(le, sizeof(le), "%g", (double)(uint64_t(1) << i) / 1e6);
+			prometheus_text += name + "_bucket{" + labels + ",le=\"" + le + "\"} " + std::to_string(count) + "\n";
+		}
+		count += h.bucket(latency_histogram::num_buckets - 1);
+		prometheus_text += name + "_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(count) + "\n";
+		snprintf(le, sizeof(le), "%g", (double)h.total_us() / 1e6);
+		prometheus_text += name + "_sum{" + labels + "} " + le + "\n";
+		prometheus_text += name + "_count{" + labels + "} " + std::to_string(count) + "\n";
+	}
+}
+
+falco_metrics::falco_metrics(const falco::app::state& state):
+	m_state(state)
+{
+}
+/*!
+	\brief Returns the labels of the series of a rule
+*/
+static std::map<std::string, std::string> rule_labels(const falco_rule& rule)
+{
+	return {
+		{"rule_name", rule.name},
+		{"priority", std::to_string(rule.priority)},
+		{"source", rule.source},
+		{"tags", concat_set_in_order(rule.tags.get())}
+	};
+}
+
+/*!
+	\brief Returns which rules, by rule id, are exported given the value that
+	ranks them: the ones with a non-zero value that are either allowlisted in
+	metrics.rules_series_allowlist or among the metrics.rules_series_max ones
+	with the highest values, or all of them if there is no maximum
+*/
+static std::vector<bool> select_rules(const std::vector<uint64_t>& values, const falco::app::state& state)
+{
+	std::vector<bool> res(values.size(), false);
+	const auto& rules = state.engine->get_rules();
+	const auto& allowlist = state.config->m_metrics_rules_series_allowlist;
+	size_t max = state.config->m_metrics_rules_series_max;
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		if (values[i] == 0)
+		{
+			continue;
+		}
+		if (max == 0 || (!allowlist.empty() && allowlist.count(rules.at(i)->name) > 0))
+		{
+			res[i] = true;
+			continue;
+		}
+		candidates.push_back(i);
+	}
+
+	if (candidates.size() > max)
+	{
+		std::nth_element(candidates.begin(), candidates.begin() + max, candidates.end(),
+			[&values](size_t a, size_t b)
+			{
+				return values[a] != values[b] ? values[a] > values[b] : a < b;
+			});
+		candidates.resize(max);
+	}
+	for (auto i : candidates)
+	{
+		res[i] = true;
+	}
+	return res;
+}
+
+// Compresses the text with gzip into out, or leaves out empty on failure
+static void gzip_compress(const std::string& text, std::string& out)
+{
+	z_stream zs = {};
+	// 16 adds the gzip header and trailer to the deflate stream
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return;
+	}
+	out.resize(deflateBound(&zs, text.size()));
+	zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+	zs.avail_in = text.size();
+	zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+	zs.avail_out = out.size();
+	int res = deflate(&zs, Z_FINISH);
+	deflateEnd(&zs);
+	out.resize(res == Z_STREAM_END ? zs.total_out : 0);
+}
+
+/*!
+	\brief this method renders a textual representation of the configured
+	metrics of the application \c state, with the given libs metrics of an
+	inspector and the last ones of the others, and publishes it for the
+	metrics endpoint.
+
+	The current implementation renders a Prometheus exposition formatted string.
+*/
+void falco_metrics::update(const std::shared_ptr<sinsp>& inspector, std::vector<metrics_v2>&& libs_metrics)
+{
+	// the same inspector serves all the sources in capture mode
+	auto it = std::find_if(m_inspectors.begin(), m_inspectors.end(),
+		[&inspector](const auto& m) { return m->inspector == inspector; });
+	if (it == m_inspectors.end())
+	{
+		auto m = std::make_unique<inspector_metrics>();
+		m->inspector = inspector;
+		m->wrapper_collector = std::make_unique<libs::metrics::libs_metrics_collector>(inspector.get(), 0);
+		m_inspectors.emplace_back(std::move(m));
+		it = m_inspectors.end() - 1;
+	}
+	(*it)->libs_metrics = std::move(libs_metrics);
+
+	auto res = std::make_shared<snapshot>();
+	std::string& text = res->text;
+	for (auto& m: m_inspectors)
+	{
+		// the agent and machine infos are only available once the
+		// inspector is open, which might happen after the first sample
+		if (!m->static_complete)
+		{
+			m->static_text.clear();
+			m->static_complete = render_static(*m, m->static_text);
+		}
+		text += m->static_text;
+		render_dynamic(*m, text);
+	}
+	if (m_state.outputs)
+	{
+		render_detection_latencies(*m_state.outputs, text);
+	}
+
+	// Libs metrics categories
+	//
+	// resource_utilization_enabled
+	// state_counters_enabled
+	// kernel_event_counters_enabled
+	// libbpf_stats_enabled
+	for (auto& m: m_inspectors)
+	{
+		for (auto metric: m->libs_metrics)
+		{
+			m_converter.convert_metric_to_unit_convention(metric);
+			std::string namespace_name = "scap";
+
+			if (metric.flags & METRICS_V2_RESOURCE_UTILIZATION || metric.flags & METRICS_V2_KERNEL_COUNTERS)
+			{
+				namespace_name = "falco";
+			}
+
+			if (metric.flags & METRICS_V2_PLUGINS)
+			{
+				namespace_name = "plugins";
+			}
+
+			text += m_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", namespace_name);
+		}
+	}
 
-	The current implementation returns a Prometheus exposition formatted string.
+	// small bodies are not worth compressing
+	if (text.size() >= 1024)
+	{
+		gzip_compress(text, res->gzip);
+	}
+	std::atomic_store(&m_snapshot, std::shared_ptr<const snapshot>(std::move(res)));
+}
+
+/*!
+	\brief Renders the series of an inspector that do not change while Falco
+	runs, and returns false if some of them are not available yet.
 */
-std::string falco_metrics::to_text(const falco::app::state& state)
+bool falco_metrics::render_static(const inspector_metrics& m, std::string& prometheus_text)
 {
 	static const char* all_driver_engines[] = {
 		BPF_ENGINE, KMOD_ENGINE, MODERN_BPF_ENGINE,
 		SOURCE_PLUGIN_ENGINE, NODRIVER_ENGINE, GVISOR_ENGINE };
 
-	std::vector<std::shared_ptr<sinsp>> inspectors;
-	std::vector<libs::metrics::libs_metrics_collector> metrics_collectors;
+	const auto& inspector = m.inspector;
+	auto& libs_metrics_collector = *m.wrapper_collector;
+	auto& prometheus_metrics_converter = m_converter;
 
-	for (const auto& source: state.enabled_sources)
+	// Falco wrapper metrics
+	//
+	for (size_t i = 0; i < sizeof(all_driver_engines) / sizeof(const char*); i++)
 	{
-		auto source_info = state.source_infos.at(source);
-		auto source_inspector = source_info->inspector;
-		inspectors.emplace_back(source_inspector);
-		metrics_collectors.emplace_back(libs::metrics::libs_metrics_collector(source_inspector.get(), state.config->m_metrics_flags));
+		if (inspector->check_current_engine(all_driver_engines[i]))
+		{
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("engine_name", "falcosecurity", "scap", {{"engine_name", all_driver_engines[i]}});
+			break;
+		}
 	}
-	libs::metrics::prometheus_metrics_converter prometheus_metrics_converter;
-	std::string prometheus_text;
 
-	for (auto inspector: inspectors)
+	const scap_agent_info* agent_info = inspector->get_agent_info();
+	const scap_machine_info* machine_info = inspector->get_machine_info();
+	prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("version", "falcosecurity", "falco", {{"version", FALCO_VERSION}});
+
+	// Not all scap engines report agent and machine infos.
+	if (agent_info)
 	{
-		// Falco wrapper metrics
-		//
-		for (size_t i = 0; i < sizeof(all_driver_engines) / sizeof(const char*); i++)
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("kernel_release", "falcosecurity", "falco", {{"kernel_release", agent_info->uname_r}});
+	}
+	if (machine_info)
+	{
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("hostname", "falcosecurity", "evt", {{"hostname", machine_info->hostname}});
+	}
+
+	// the sums of the files still being computed are rendered again later
+	bool sums_complete = true;
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	// Distinguish between config and rules files using labels, following Prometheus best practices: https://prometheus.io/docs/practices/naming/#labels
+	for (const auto& item : m_state.config.get()->m_loaded_rules_filenames_sha256sum)
+	{
+		fs::path fs_path = item.first;
+		auto sum = falco::file_sha256sums::value(item.second);
+		sums_complete = sums_complete && sum != falco::file_sha256sums::pending;
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("falco_sha256_rules_files", "falcosecurity", "falco", {{"file_name", fs_path.filename().stem()}, {"sha256", sum}});
+	}
+
+	for (const auto& item : m_state.config.get()->m_loaded_configs_filenames_sha256sum)
+	{
+		fs::path fs_path = item.first;
+		auto sum = falco::file_sha256sums::value(item.second);
+		sums_complete = sums_complete && sum != falco::file_sha256sums::pending;
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("falco_sha256_config_files", "falcosecurity", "falco", {{"file_name", fs_path.filename().stem()}, {"sha256", sum}});
+	}
+#endif
+
+	for (const std::string& source: inspector->event_sources())
+	{
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("evt_source", "falcosecurity", "falco", {{"evt_source", source}});
+	}
+
+	std::vector<metrics_v2> static_wrapper_metrics;
+	if (agent_info)
+	{
+		static_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("start_ts",
+										METRICS_V2_MISC,
+										METRIC_VALUE_TYPE_U64,
+										METRIC_VALUE_UNIT_TIME_TIMESTAMP_NS,
+										METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+										agent_info->start_ts_epoch));
+	}
+	if (machine_info)
+	{
+		static_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("host_boot_ts",
+										METRICS_V2_MISC,
+										METRIC_VALUE_TYPE_U64,
+										METRIC_VALUE_UNIT_TIME_TIMESTAMP_NS,
+										METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+										machine_info->boot_ts_epoch));
+		static_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("host_num_cpus",
+										METRICS_V2_MISC,
+										METRIC_VALUE_TYPE_U32,
+										METRIC_VALUE_UNIT_COUNT,
+										METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+										machine_info->num_cpus));
+	}
+	for (auto& metric: static_wrapper_metrics)
+	{
+		prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco");
+	}
+
+	return agent_info != nullptr && machine_info != nullptr && sums_complete;
+}
+
+/*!
+	\brief Renders the series of an inspector whose values change while
+	Falco runs, i.e. the counters and the gauges of the application.
+*/
+void falco_metrics::render_dynamic(const inspector_metrics& m, std::string& prometheus_text)
+{
+	const falco::app::state& state = m_state;
+	const auto& inspector = m.inspector;
+	auto& libs_metrics_collector = *m.wrapper_collector;
+	auto& prometheus_metrics_converter = m_converter;
+	const scap_agent_info* agent_info = inspector->get_agent_info();
+
+	std::vector<metrics_v2> additional_wrapper_metrics;
+	additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("outputs_queue_num_drops",
+											METRICS_V2_MISC,
+											METRIC_VALUE_TYPE_U64,
+											METRIC_VALUE_UNIT_COUNT,
+											METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+											state.outputs->get_outputs_queue_num_drops()));
+	for (const auto& item : state.outputs->get_outputs_queue_num_drops_by_priority())
+	{
+		auto metric = libs_metrics_collector.new_metric("outputs_queue_num_drops_by_priority",
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+		prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+		const std::map<std::string, std::string>& const_labels = {
+			{"priority", item.first}
+		};
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+	}
+	additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("outputs_aggregation_num_suppressed",
+											METRICS_V2_MISC,
+											METRIC_VALUE_TYPE_U64,
+											METRIC_VALUE_UNIT_COUNT,
+											METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+											state.outputs->get_outputs_aggregation_num_suppressed()));
+	additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("logs_num_dropped",
+											METRICS_V2_MISC,
+											METRIC_VALUE_TYPE_U64,
+											METRIC_VALUE_UNIT_COUNT,
+											METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+											falco_logger::get_num_dropped()));
+	additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("logs_num_suppressed",
+											METRICS_V2_MISC,
+											METRIC_VALUE_TYPE_U64,
+											METRIC_VALUE_UNIT_COUNT,
+											METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+											falco_logger::get_num_suppressed()));
+	std::map<std::string, uint64_t> rule_state_metrics;
+	state.engine->get_rule_state_metrics(rule_state_metrics);
+	for (const auto& item : rule_state_metrics)
+	{
+		additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric(("rule_state_" + item.first).c_str(),
+											METRICS_V2_MISC,
+											METRIC_VALUE_TYPE_U64,
+											METRIC_VALUE_UNIT_COUNT,
+											item.first == "keys" || item.first == "memory_bytes"
+												? METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT
+												: METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+											item.second));
+	}
+	for (const auto& item : state.outputs->get_outputs_queue_metrics())
+	{
+		additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric(("outputs_queue_" + item.first).c_str(),
+											METRICS_V2_MISC,
+											METRIC_VALUE_TYPE_U64,
+											METRIC_VALUE_UNIT_COUNT,
+											output_metric_type(item.first),
+											item.second));
+	}
+	// Distinguish between outputs using labels, e.g. "http.batches" becomes
+	// outputs_batches{output="http"}, and between the clients of an
+	// output, e.g. "grpc.subscriber_lag.1" becomes
+	// outputs_subscriber_lag{output="grpc",client="1"}
+	for (const auto& item : state.outputs->get_outputs_metrics())
+	{
+		auto dot = item.first.find('.');
+		if (dot == std::string::npos)
+		{
+			continue;
+		}
+		auto name = item.first.substr(dot + 1);
+		std::map<std::string, std::string> const_labels = {
+			{"output", item.first.substr(0, dot)}
+		};
+		auto client_dot = name.find('.');
+		if (client_dot != std::string::npos)
 		{
-			if (inspector->check_current_engine(all_driver_engines[i]))
+			const_labels["client"] = name.substr(client_dot + 1);
+			name = name.substr(0, client_dot);
+		}
+		auto metric = libs_metrics_collector.new_metric(("outputs_" + name).c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								output_metric_type(name),
+								item.second);
+		prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+	}
+
+	// The stages of the processing loops of the sources of this
+	// inspector, e.g. evt_stage_time_ns{source="syscall",stage="rules"}
+	if (state.config->m_metrics_event_stages_enabled)
+	{
+		for (const auto& source : state.enabled_sources)
+		{
+			auto source_info = state.source_infos.at(source);
+			if (source_info->inspector != inspector)
+			{
+				continue;
+			}
+			for (size_t i = 0; i < falco::event_stages::NUM_STAGES; i++)
 			{
-				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("engine_name", "falcosecurity", "scap", {{"engine_name", all_driver_engines[i]}});
-				break;
+				auto stage = (falco::event_stages::stage) i;
+				const std::map<std::string, std::string> const_labels = {
+					{"source", source},
+					{"stage", falco::event_stages::name(stage)}
+				};
+				std::vector<metrics_v2> stage_metrics;
+				stage_metrics.emplace_back(libs_metrics_collector.new_metric("evt_stage_time_ns",
+										METRICS_V2_MISC,
+										METRIC_VALUE_TYPE_U64,
+										METRIC_VALUE_UNIT_TIME_NS_COUNT,
+										METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+										source_info->stages->time_ns(stage)));
+				stage_metrics.emplace_back(libs_metrics_collector.new_metric("evt_stage_max_evts_rate_sec",
+										METRICS_V2_MISC,
+										METRIC_VALUE_TYPE_U64,
+										METRIC_VALUE_UNIT_COUNT,
+										METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+										source_info->stages->max_evts_rate(stage)));
+				for (auto& metric: stage_metrics)
+				{
+					prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+					prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+				}
 			}
 		}
+	}
 
+	// How the processing loops of the sources of this inspector waited
+	// while idle, e.g. idle_sleep_time_ns{source="k8saudit"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->idle_backoff)
+		{
+			continue;
+		}
+		const std::map<std::string, std::string> const_labels = {
+			{"source", source}
+		};
+		std::map<std::string, uint64_t> idle_metrics;
+		source_info->idle_backoff->get_metrics(idle_metrics);
+		for (const auto& item : idle_metrics)
+		{
+			// e.g. "idle.sleeps" becomes idle_sleeps
+			auto name = "idle_" + item.first.substr(item.first.find('.') + 1);
+			bool is_time = name == "idle_sleep_time_ns";
+			auto metric = libs_metrics_collector.new_metric(name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								is_time ? METRIC_VALUE_UNIT_TIME_NS_COUNT : METRIC_VALUE_UNIT_COUNT,
+								METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+		}
+	}
 
-		const scap_agent_info* agent_info = inspector->get_agent_info();
-		const scap_machine_info* machine_info = inspector->get_machine_info();
-		libs::metrics::libs_metrics_collector libs_metrics_collector(inspector.get(), 0);
-		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("version", "falcosecurity", "falco", {{"version", FALCO_VERSION}});
-
-		// Not all scap engines report agent and machine infos.
-		if (agent_info)
+	// The thread tables of the sources of this inspector, e.g.
+	// thread_table_failed_lookups_total{source="syscall"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->thread_table)
 		{
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("kernel_release", "falcosecurity", "falco", {{"kernel_release", agent_info->uname_r}});
+			continue;
 		}
-		if (machine_info)
+		const std::map<std::string, std::string> const_labels = {
+			{"source", source}
+		};
+		std::map<std::string, uint64_t> thread_table_metrics;
+		source_info->thread_table->get_metrics(thread_table_metrics);
+		for (const auto& item : thread_table_metrics)
 		{
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("hostname", "falcosecurity", "evt", {{"hostname", machine_info->hostname}});
+			// e.g. "thread_table.resizes" becomes thread_table_resizes
+			auto name = "thread_table_" + item.first.substr(item.first.find('.') + 1);
+			bool is_gauge = name == "thread_table_threads" || name == "thread_table_max_threads";
+			auto metric = libs_metrics_collector.new_metric(name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								is_gauge ? METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT : METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
 		}
+	}
 
-#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
-		// Distinguish between config and rules files using labels, following Prometheus best practices: https://prometheus.io/docs/practices/naming/#labels
-		for (const auto& item : state.config.get()->m_loaded_rules_filenames_sha256sum)
+	// The budgets of the containers of the sources of this inspector, e.g.
+	// container_budgets_skipped_evts_total{source="syscall"}, with the
+	// events and alerts throttled in the last window by each throttled
+	// container as container_budgets_throttled{container_id="..."}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->container_budgets)
 		{
-			fs::path fs_path = item.first;
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("falco_sha256_rules_files", "falcosecurity", "falco", {{"file_name", fs_path.filename().stem()}, {"sha256", item.second}});
+			continue;
 		}
+		std::map<std::string, uint64_t> budgets_metrics;
+		source_info->container_budgets->get_metrics(budgets_metrics);
+		const std::string throttled_prefix = "container_budgets.throttled.";
+		for (const auto& item : budgets_metrics)
+		{
+			std::map<std::string, std::string> const_labels = {
+				{"source", source}
+			};
+			// e.g. "container_budgets.skipped_evts" becomes container_budgets_skipped_evts
+			std::string name;
+			if (item.first.compare(0, throttled_prefix.size(), throttled_prefix) == 0)
+			{
+				name = "container_budgets_throttled";
+				const_labels["container_id"] = item.first.substr(throttled_prefix.size());
+			}
+			else
+			{
+				name = "container_budgets_" + item.first.substr(item.first.find('.') + 1);
+			}
+			bool is_gauge = name == "container_budgets_containers"
+				|| name == "container_budgets_throttled_containers"
+				|| name == "container_budgets_throttled";
+			auto metric = libs_metrics_collector.new_metric(name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								is_gauge ? METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT : METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+		}
+	}
 
-		for (const auto& item : state.config.get()->m_loaded_configs_filenames_sha256sum)
+	// The events of the gVisor shards and sandboxes of the sources of this
+	// inspector, e.g. gvisor_shard_evts_total{shard="1"} and
+	// gvisor_sandbox_evts_total{sandbox_id="..."}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || source_info->gvisor_shards.empty())
 		{
-			fs::path fs_path = item.first;
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("falco_sha256_config_files", "falcosecurity", "falco", {{"file_name", fs_path.filename().stem()}, {"sha256", item.second}});
+			continue;
 		}
-#endif
+		std::map<std::string, uint64_t> gvisor_metrics;
+		for (const auto& shard : source_info->gvisor_shards)
+		{
+			shard->get_metrics(gvisor_metrics);
+		}
+		const std::string shard_prefix = "gvisor.shard_evts.";
+		const std::string sandbox_prefix = "gvisor.sandbox_evts.";
+		for (const auto& item : gvisor_metrics)
+		{
+			std::map<std::string, std::string> const_labels = {
+				{"source", source}
+			};
+			// e.g. "gvisor.untracked_evts" becomes gvisor_untracked_evts
+			std::string name;
+			if (item.first.compare(0, shard_prefix.size(), shard_prefix) == 0)
+			{
+				name = "gvisor_shard_evts";
+				const_labels["shard"] = item.first.substr(shard_prefix.size());
+			}
+			else if (item.first.compare(0, sandbox_prefix.size(), sandbox_prefix) == 0)
+			{
+				name = "gvisor_sandbox_evts";
+				const_labels["sandbox_id"] = item.first.substr(sandbox_prefix.size());
+			}
+			else
+			{
+				name = "gvisor_" + item.first.substr(item.first.find('.') + 1);
+			}
+			bool is_gauge = name == "gvisor_sandboxes";
+			auto metric = libs_metrics_collector.new_metric(name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								is_gauge ? METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT : METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+		}
+	}
 
-		for (const std::string& source: inspector->event_sources())
+	// The events of the sources of this inspector that skipped the rules
+	// as no enabled rule needs them, e.g. fast_path_evts_total{source="syscall"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->fast_path)
 		{
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus("evt_source", "falcosecurity", "falco", {{"evt_source", source}});
+			continue;
 		}
-		std::vector<metrics_v2> additional_wrapper_metrics;
+		const std::map<std::string, std::string> const_labels = {
+			{"source", source}
+		};
+		std::map<std::string, uint64_t> fast_path_metrics;
+		source_info->fast_path->get_metrics(fast_path_metrics);
+		for (const auto& item : fast_path_metrics)
+		{
+			auto metric = libs_metrics_collector.new_metric(item.first.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+		}
+	}
 
-		if (agent_info)
+	// The memory and the dumps of the flight recorders of the sources of
+	// this inspector, e.g. flight_recorder_written_bytes{source="syscall"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->flight_recorder)
 		{
-			additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("start_ts",
-												  METRICS_V2_MISC,
-												  METRIC_VALUE_TYPE_U64,
-												  METRIC_VALUE_UNIT_TIME_TIMESTAMP_NS,
-												  METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
-												  agent_info->start_ts_epoch));
+			continue;
 		}
-		if (machine_info)
+		const std::map<std::string, std::string> const_labels = {
+			{"source", source}
+		};
+		std::map<std::string, uint64_t> recorder_metrics;
+		source_info->flight_recorder->get_metrics(recorder_metrics);
+		for (const auto& item : recorder_metrics)
 		{
-			additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("host_boot_ts",
-												  METRICS_V2_MISC,
-												  METRIC_VALUE_TYPE_U64,
-												  METRIC_VALUE_UNIT_TIME_TIMESTAMP_NS,
-												  METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
-												  machine_info->boot_ts_epoch));
-			additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("host_num_cpus",
-												  METRICS_V2_MISC,
-												  METRIC_VALUE_TYPE_U32,
-												  METRIC_VALUE_UNIT_COUNT,
-												  METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
-												  machine_info->num_cpus));
+			// e.g. "flight_recorder.dumps" becomes flight_recorder_dumps
+			auto name = "flight_recorder_" + item.first.substr(item.first.find('.') + 1);
+			bool is_gauge = name == "flight_recorder_ring_bytes" || name == "flight_recorder_ring_events"
+				|| name == "flight_recorder_pending_bytes";
+			bool is_memory = name == "flight_recorder_ring_bytes" || name == "flight_recorder_pending_bytes";
+			bool is_time = name == "flight_recorder_write_time_ns";
+			auto metric = libs_metrics_collector.new_metric(name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								is_memory ? METRIC_VALUE_UNIT_MEMORY_BYTES : is_time ? METRIC_VALUE_UNIT_TIME_NS_COUNT : METRIC_VALUE_UNIT_COUNT,
+								is_gauge ? METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT : METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
 		}
-		additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("outputs_queue_num_drops",
-												METRICS_V2_MISC,
-												METRIC_VALUE_TYPE_U64,
-												METRIC_VALUE_UNIT_COUNT,
-												METRIC_VALUE_METRIC_TYPE_MONOTONIC,
-												state.outputs->get_outputs_queue_num_drops()));
+	}
 
-		if (agent_info)
+	// How long the sources of this inspector have been without events,
+	// e.g. stall_current_ms{source="syscall"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->heartbeat)
 		{
-			auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-			additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("duration_sec",
-												  METRICS_V2_MISC,
-												  METRIC_VALUE_TYPE_U64,
-												  METRIC_VALUE_UNIT_TIME_S_COUNT,
-												  METRIC_VALUE_METRIC_TYPE_MONOTONIC,
-												  (uint64_t)((now - agent_info->start_ts_epoch) / ONE_SECOND_IN_NS)));
+			continue;
 		}
+		const std::map<std::string, std::string> const_labels = {
+			{"source", source}
+		};
+		std::map<std::string, uint64_t> stall_metrics;
+		source_info->heartbeat->get_metrics(stall_metrics);
+		for (const auto& item : stall_metrics)
+		{
+			// e.g. "stall.max_ms" becomes stall_max_ms
+			auto name = "stall_" + item.first.substr(item.first.find('.') + 1);
+			bool is_counter = name == "stall_stalls";
+			auto metric = libs_metrics_collector.new_metric(is_counter ? "stalls" : name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								is_counter ? METRIC_VALUE_METRIC_TYPE_MONOTONIC : METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+								item.second);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+		}
+	}
 
-		for (auto metric: additional_wrapper_metrics)
+	// How Falco reacts to the events dropped by the kernel, i.e. which
+	// events skipped the rules and which syscall buffer size is
+	// recommended, e.g. shed_events{source="syscall"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || (!source_info->load_shedder && !source_info->buffer_autosizer))
 		{
+			continue;
+		}
+		const std::map<std::string, std::string> const_labels = {
+			{"source", source}
+		};
+		std::map<std::string, uint64_t> drop_metrics;
+		if (source_info->load_shedder)
+		{
+			source_info->load_shedder->get_metrics(drop_metrics);
+		}
+		if (source_info->buffer_autosizer)
+		{
+			source_info->buffer_autosizer->get_metrics(drop_metrics);
+		}
+		for (const auto& item : drop_metrics)
+		{
+			// e.g. "shed.events" becomes shed_events
+			auto name = item.first;
+			std::replace(name.begin(), name.end(), '.', '_');
+			bool is_counter = name == "shed_events" || name == "shed_level_changes" || name == "buf_size_drop_intervals";
+			auto metric = libs_metrics_collector.new_metric(name.c_str(),
+								METRICS_V2_MISC,
+								METRIC_VALUE_TYPE_U64,
+								METRIC_VALUE_UNIT_COUNT,
+								is_counter ? METRIC_VALUE_METRIC_TYPE_MONOTONIC : METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+								item.second);
 			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco");
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
 		}
+	}
 
-		// Falco metrics categories
-		//
-		// rules_counters_enabled
-		if(state.config->m_metrics_flags & METRICS_V2_RULE_COUNTERS)
+	// The recent kernel drops of each category, over the last second
+	// and the trends window, e.g. kernel_drops_max_sec{category="scratch_map"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->drop_trends)
+		{
+			continue;
+		}
+		for (const auto& r : source_info->drop_trends->get_rates())
 		{
-			const stats_manager& rule_stats_manager = state.engine->get_rule_stats_manager();
-			const indexed_vector<falco_rule>& rules = state.engine->get_rules();
-			const std::vector<std::unique_ptr<std::atomic<uint64_t>>>& rules_by_id = rule_stats_manager.get_by_rule_id();
-			// Distinguish between rules counters using labels, following Prometheus best practices: https://prometheus.io/docs/practices/naming/#labels
-			for (size_t i = 0; i < rules_by_id.size(); i++)
+			const std::map<std::string, std::string> const_labels = {
+				{"source", source},
+				{"category", r.category}
+			};
+			const std::pair<const char*, uint64_t> values[] = {
+				{"kernel_drops_last_sec", r.last},
+				{"kernel_drops_max_sec", r.max},
+				{"kernel_drops_window_total", r.total},
+			};
+			for (const auto& v : values)
 			{
-				auto rule = rules.at(i);
-				auto count = rules_by_id[i]->load();
-				if (count > 0)
-				{
-					auto metric = libs_metrics_collector.new_metric("rules_counters",
-											METRICS_V2_RULE_COUNTERS,
-											METRIC_VALUE_TYPE_U64,
-											METRIC_VALUE_UNIT_COUNT,
-											METRIC_VALUE_METRIC_TYPE_MONOTONIC,
-											rules_by_id[i]->load());
-					prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
-					const std::map<std::string, std::string>& const_labels = {
-						{"rule_name", rule->name},
-						{"priority", std::to_string(rule->priority)},
-						{"source", rule->source},
-						{"tags", concat_set_in_order(rule->tags)}
-					};
-					prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
-				}
+				auto metric = libs_metrics_collector.new_metric(v.first,
+									METRICS_V2_MISC,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+									v.second);
+				prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
 			}
 		}
 	}
 
-	// Libs metrics categories
-	//
-	// resource_utilization_enabled
-	// state_counters_enabled
-	// kernel_event_counters_enabled
-	// libbpf_stats_enabled
-	for (auto metrics_collector: metrics_collectors)
+	// The collected events attributed to the rules needing them, e.g.
+	// syscall_cost_exclusive_events{rule_name="Read sensitive file untrusted"},
+	// and the ones collected for the state engine only
+	for (const auto& source : state.enabled_sources)
 	{
-		metrics_collector.snapshot();
-		auto metrics_snapshot = metrics_collector.get_metrics();
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->syscall_cost)
+		{
+			continue;
+		}
+		const std::map<std::string, std::string> source_labels = {
+			{"source", source}
+		};
+		auto metric = libs_metrics_collector.new_metric("syscall_cost_state_events",
+							METRICS_V2_MISC,
+							METRIC_VALUE_TYPE_U64,
+							METRIC_VALUE_UNIT_COUNT,
+							METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+							source_info->syscall_cost->state_events());
+		prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", source_labels);
+		for (const auto& c : source_info->syscall_cost->get_costs())
+		{
+			if (c.events == 0)
+			{
+				continue;
+			}
+			const std::map<std::string, std::string> const_labels = {
+				{"rule_name", c.rule},
+				{"source", source}
+			};
+			const std::pair<const char*, uint64_t> values[] = {
+				{"syscall_cost_events", c.events},
+				{"syscall_cost_attributed_events", c.attributed_events},
+				{"syscall_cost_exclusive_events", c.exclusive_events},
+			};
+			for (const auto& v : values)
+			{
+				auto metric = libs_metrics_collector.new_metric(v.first,
+									METRICS_V2_MISC,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									v.second);
+				prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+			}
+		}
+	}
 
-		for (auto& metric: metrics_snapshot)
+	// The events of the sources of this inspector and the time spent on
+	// them by the engine, by event type, e.g.
+	// evt_type_rules_time_ns{source="syscall",evt_type="read"}
+	for (const auto& source : state.enabled_sources)
+	{
+		auto source_info = state.source_infos.at(source);
+		if (source_info->inspector != inspector || !source_info->event_types)
 		{
-			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
-			std::string namespace_name = "scap";
-			
-			if (metric.flags & METRICS_V2_RESOURCE_UTILIZATION || metric.flags & METRICS_V2_KERNEL_COUNTERS)
+			continue;
+		}
+		for (const auto& t : source_info->event_types->get_stats())
+		{
+			const std::map<std::string, std::string> const_labels = {
+				{"source", source},
+				{"evt_type", t.name}
+			};
+			std::vector<metrics_v2> type_metrics;
+			type_metrics.emplace_back(libs_metrics_collector.new_metric("evt_type_events",
+									METRICS_V2_MISC,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									t.events));
+			type_metrics.emplace_back(libs_metrics_collector.new_metric("evt_type_rules_time_ns",
+									METRICS_V2_MISC,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_TIME_NS_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									t.rules_time_ns));
+			for (auto& metric : type_metrics)
 			{
-				namespace_name = "falco";
+				prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
 			}
+		}
+	}
 
-			if (metric.flags & METRICS_V2_PLUGINS)
+	if (agent_info)
+	{
+		auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		additional_wrapper_metrics.emplace_back(libs_metrics_collector.new_metric("duration_sec",
+											  METRICS_V2_MISC,
+											  METRIC_VALUE_TYPE_U64,
+											  METRIC_VALUE_UNIT_TIME_S_COUNT,
+											  METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+											  (uint64_t)((now - agent_info->start_ts_epoch) / ONE_SECOND_IN_NS)));
+	}
+
+	for (auto metric: additional_wrapper_metrics)
+	{
+		prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+		prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco");
+	}
+
+	// Falco metrics categories
+	//
+	// rules_counters_enabled
+	if(state.config->m_metrics_flags & METRICS_V2_RULE_COUNTERS)
+	{
+		const stats_manager& rule_stats_manager = state.engine->get_rule_stats_manager();
+		const indexed_vector<falco_rule>& rules = state.engine->get_rules();
+		const auto& rules_by_id = rule_stats_manager.get_by_rule_id();
+		std::vector<uint64_t> counts(rules_by_id.size());
+		for (size_t i = 0; i < rules_by_id.size(); i++)
+		{
+			counts[i] = rules_by_id[i];
+		}
+		std::vector<bool> exported = select_rules(counts, state);
+		uint64_t omitted = 0;
+		// Distinguish between rules counters using labels, following Prometheus best practices: https://prometheus.io/docs/practices/naming/#labels
+		for (size_t i = 0; i < counts.size(); i++)
+		{
+			if (!exported[i])
 			{
-				namespace_name = "plugins";
+				omitted += counts[i];
+				continue;
 			}
+			auto metric = libs_metrics_collector.new_metric("rules_counters",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									counts[i]);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", rule_labels(*rules.at(i)));
+		}
+		if (omitted > 0)
+		{
+			auto metric = libs_metrics_collector.new_metric("rules_counters_omitted",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									omitted);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco");
+		}
+
+		// the rate limited rules follow the selection of the matching ones
+		const auto& rate_limited_by_id = rule_stats_manager.get_rate_limited_by_rule_id();
+		for (size_t i = 0; i < rate_limited_by_id.size() && i < exported.size(); i++)
+		{
+			auto count = rate_limited_by_id[i];
+			if (count > 0 && exported[i])
+			{
+				auto metric = libs_metrics_collector.new_metric("rules_rate_limited",
+										METRICS_V2_RULE_COUNTERS,
+										METRIC_VALUE_TYPE_U64,
+										METRIC_VALUE_UNIT_COUNT,
+										METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+										count);
+				prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", rule_labels(*rules.at(i)));
+			}
+		}
 
-			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", namespace_name);
+		// and so do the rules whose exceptions excluded events
+		const auto& exception_hits_by_id = rule_stats_manager.get_exception_hits_by_rule_id();
+		for (size_t i = 0; i < exception_hits_by_id.size() && i < exported.size(); i++)
+		{
+			auto count = exception_hits_by_id[i];
+			if (count > 0 && exported[i])
+			{
+				auto metric = libs_metrics_collector.new_metric("rules_exception_hits",
+										METRICS_V2_RULE_COUNTERS,
+										METRIC_VALUE_TYPE_U64,
+										METRIC_VALUE_UNIT_COUNT,
+										METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+										count);
+				prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", rule_labels(*rules.at(i)));
+			}
 		}
+	}
 
+	// rules_profiling_enabled
+	const stats_manager& rule_stats_manager = state.engine->get_rule_stats_manager();
+	if(state.config->m_metrics_rules_profiling_enabled && rule_stats_manager.is_rule_profiling_enabled())
+	{
+		const indexed_vector<falco_rule>& rules = state.engine->get_rules();
+		const auto& profiles = rule_stats_manager.get_profile_by_rule_id();
+		std::vector<uint64_t> times(profiles.size());
+		for (size_t i = 0; i < profiles.size(); i++)
+		{
+			// rules evaluated at least once always rank above the others
+			times[i] = profiles[i]->evaluations.load() > 0 ? profiles[i]->estimated_time_ns() + 1 : 0;
+		}
+		std::vector<bool> exported = select_rules(times, state);
+		uint64_t omitted = 0;
+		for (size_t i = 0; i < profiles.size(); i++)
+		{
+			const auto& profile = *profiles[i];
+			auto evaluations = profile.evaluations.load();
+			if (evaluations == 0)
+			{
+				continue;
+			}
+			if (!exported[i])
+			{
+				omitted += evaluations;
+				continue;
+			}
+			const auto const_labels = rule_labels(*rules.at(i));
+			std::vector<metrics_v2> profile_metrics;
+			profile_metrics.emplace_back(libs_metrics_collector.new_metric("rules_evaluations",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									evaluations));
+			profile_metrics.emplace_back(libs_metrics_collector.new_metric("rules_evaluation_matches",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									profile.matches.load()));
+			profile_metrics.emplace_back(libs_metrics_collector.new_metric("rules_evaluation_time_ns",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_TIME_NS_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									profile.estimated_time_ns()));
+			profile_metrics.emplace_back(libs_metrics_collector.new_metric("rules_evaluation_time_p99_ns",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_TIME_NS,
+									METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+									profile.time_percentile_ns(99)));
+			profile_metrics.emplace_back(libs_metrics_collector.new_metric("rules_evaluation_time_max_ns",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_TIME_NS,
+									METRIC_VALUE_METRIC_TYPE_NON_MONOTONIC_CURRENT,
+									profile.max_time_ns()));
+			for (auto& metric: profile_metrics)
+			{
+				prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+				prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco", const_labels);
+			}
+		}
+		if (omitted > 0)
+		{
+			auto metric = libs_metrics_collector.new_metric("rules_evaluations_omitted",
+									METRICS_V2_RULE_COUNTERS,
+									METRIC_VALUE_TYPE_U64,
+									METRIC_VALUE_UNIT_COUNT,
+									METRIC_VALUE_METRIC_TYPE_MONOTONIC,
+									omitted);
+			prometheus_metrics_converter.convert_metric_to_unit_convention(metric);
+			prometheus_text += prometheus_metrics_converter.convert_metric_to_text_prometheus(metric, "falcosecurity", "falco");
+		}
 	}
-	return prometheus_text;
 }
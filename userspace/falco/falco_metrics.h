@@ -20,6 +20,11 @@ limitations under the License.
 
 #include <libsinsp/sinsp.h>
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace falco::app {
 	struct state;
 }
@@ -28,5 +33,56 @@ class falco_metrics
 {
 public:
 	static const std::string content_type;
-	static std::string to_text(const falco::app::state& state);
+
+	/*!
+		\brief A rendering of the metrics, along with its gzip compressed
+		form when the text is large enough for compressing it to pay off
+	*/
+	struct snapshot
+	{
+		std::string text;
+		std::string gzip;
+	};
+
+	explicit falco_metrics(const falco::app::state& state);
+	falco_metrics(const falco_metrics&) = delete;
+	falco_metrics& operator = (const falco_metrics&) = delete;
+
+	/*!
+		\brief Renders the metrics with the given libs metrics of an
+		inspector, as captured on its thread, and the last ones of the
+		other inspectors, and publishes the result. The inspector is only
+		used for its agent and machine infos, which don't change once it's
+		open. This is invoked by the stats writer worker, and is not
+		thread-safe.
+	*/
+	void update(const std::shared_ptr<sinsp>& inspector, std::vector<metrics_v2>&& libs_metrics);
+
+	/*!
+		\brief Returns the last published snapshot of the metrics, or
+		nullptr if none was published yet. This function is thread-safe
+		and never waits for a rendering.
+	*/
+	inline std::shared_ptr<const snapshot> get() const
+	{
+		return std::atomic_load(&m_snapshot);
+	}
+
+private:
+	struct inspector_metrics
+	{
+		std::shared_ptr<sinsp> inspector;
+		std::unique_ptr<libs::metrics::libs_metrics_collector> wrapper_collector;
+		std::vector<metrics_v2> libs_metrics;
+		std::string static_text;
+		bool static_complete = false;
+	};
+
+	bool render_static(const inspector_metrics& m, std::string& prometheus_text);
+	void render_dynamic(const inspector_metrics& m, std::string& prometheus_text);
+
+	const falco::app::state& m_state;
+	libs::metrics::prometheus_metrics_converter m_converter;
+	std::vector<std::unique_ptr<inspector_metrics>> m_inspectors;
+	std::shared_ptr<const snapshot> m_snapshot;
 };
@@ -19,26 +19,67 @@ limitations under the License.
 #include <google/protobuf/util/time_util.h>
 #endif
 
+#include <algorithm>
+
 #include "falco_outputs.h"
+#include "alloc_tracker.h"
 #include "config_falco.h"
 
 #include "formats.h"
+#include "falco_utils.h"
+#include "outputs_encoding.h"
+#include "memory_usage.h"
 #include "logger.h"
+#include "thread_affinity.h"
 #include "watchdog.h"
 
 #include "outputs_file.h"
 #include "outputs_stdout.h"
 #if !defined(_WIN32)
 #include "outputs_program.h"
+#include "outputs_shm.h"
 #include "outputs_syslog.h"
+#include "outputs_unix_socket.h"
 #endif
 #if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
 #include "outputs_http.h"
 #include "outputs_grpc.h"
+#include "outputs_kafka.h"
+#endif
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+#include "otlp_exporter.h"
 #endif
 
 static const char* s_internal_source = "internal";
 
+static inline uint64_t epoch_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// The time between an event and a later point, in microseconds, where the
+// time of the event can be ahead of the clock by a little, as it's taken
+// by the kernel or by a plugin
+static inline uint64_t latency_us(uint64_t evt_ts, uint64_t now)
+{
+	return now > evt_ts ? (now - evt_ts) / 1000 : 0;
+}
+
+#ifndef __EMSCRIPTEN__
+// The reserved capacity grows linearly from none for emergency alerts to
+// the whole reserve for debug ones
+static void queue_limits(std::array<std::ptrdiff_t, falco_common::PRIORITY_DEBUG + 1>& limits, size_t capacity, uint32_t priority_reserve)
+{
+	double reserve = (double) capacity * std::min<uint32_t>(priority_reserve, 100) / 100;
+	for(size_t p = 0; p < limits.size(); p++)
+	{
+		auto reserved = (size_t) (reserve * p / falco_common::PRIORITY_DEBUG);
+		limits[p] = (std::ptrdiff_t) std::max<size_t>(capacity - std::min(reserved, capacity), 1);
+	}
+}
+#endif
+
 falco_outputs::falco_outputs(
 	std::shared_ptr<falco_engine> engine,
 	const std::vector<falco::outputs::config>& outputs,
@@ -48,33 +89,141 @@ falco_outputs::falco_outputs(
 	uint32_t timeout,
 	bool buffered,
 	size_t outputs_queue_capacity,
+	uint32_t outputs_queue_priority_reserve,
+	uint64_t outputs_queue_max_bytes,
+	const falco::outputs::spill_config& spill,
+	const falco::outputs::drain_config& drain,
+	bool deferred_formatting,
+	const falco::outputs::aggregation_config& aggregation,
 	bool time_format_iso_8601,
-	const std::string& hostname)
-	: m_formats(std::make_unique<falco_formats>(engine, json_include_output_property, json_include_tags_property)),
+	const std::string& hostname,
+	const std::shared_ptr<falco::otlp_exporter>& otlp,
+	const std::shared_ptr<falco::outputs::recent_alerts>& recent_alerts)
+	: m_engine(engine),
+	  m_formats(std::make_unique<falco_formats>(engine, json_include_output_property, json_include_tags_property)),
 	  m_buffered(buffered),
+	  m_deferred_formatting(deferred_formatting),
 	  m_json_output(json_output),
 	  m_time_format_iso_8601(time_format_iso_8601),
 	  m_timeout(std::chrono::milliseconds(timeout)),
-	  m_hostname(hostname)
+	  m_drain(drain),
+	  m_hostname(hostname),
+	  m_otlp(otlp),
+	  m_recent_alerts(recent_alerts),
+	  m_aggregation_keys(aggregation.keys)
 {
+	// only capture the time format, as the engine outlives this object
+	engine->set_rule_output_format([time_format_iso_8601](const falco_rule& r)
+	{
+		return alert_format(r.output, r.priority, time_format_iso_8601);
+	});
+
 	for(const auto& output : outputs)
 	{
 		add_output(output);
 	}
+	if(m_recent_alerts)
+	{
+		falco::outputs::config oc;
+		oc.name = "recent_alerts";
+		add_output(oc);
+	}
+	m_fields_needed = m_deferred_formatting || aggregation.enabled;
+	for(const auto& o : m_outputs)
+	{
+		m_fields_needed = m_fields_needed || o->output->uses_fields() || !o->projection.empty();
+	}
+
+	// enough messages for bursts of alerts, more are allocated on demand
+	for(size_t i = 0; i < std::min<size_t>(outputs_queue_capacity, 256); i++)
+	{
+		m_pool_storage.push_back(std::make_unique<ctrl_msg>());
+		m_pool.push_back(m_pool_storage.back().get());
+	}
 
 #ifndef __EMSCRIPTEN__
 	m_queue.set_capacity(outputs_queue_capacity);
+	queue_limits(m_queue_limits, outputs_queue_capacity, outputs_queue_priority_reserve);
+	m_max_bytes = outputs_queue_max_bytes;
+	if(m_max_bytes > 0)
+	{
+		queue_limits(m_bytes_limits, std::min<uint64_t>(m_max_bytes, PTRDIFF_MAX), outputs_queue_priority_reserve);
+	}
+	for(auto& o : m_outputs)
+	{
+		o->backlog_capacity = o->output->backlog_capacity();
+		queue_limits(o->backlog_limits, o->backlog_capacity, outputs_queue_priority_reserve);
+	}
+
+#if !defined(_WIN32)
+	if(spill.enabled)
+	{
+		for(auto& o : m_outputs)
+		{
+			o->spill = std::make_unique<falco::outputs::spill_buffer>(
+				spill.path + "/" + o->output->get_name(), spill.max_size, spill.segment_size);
+		}
+	}
+#endif
+
+	std::vector<std::string> names;
+	for(size_t i = 0; i < m_outputs.size(); i++)
+	{
+		m_outputs[i]->watchdog_slot = i;
+		names.push_back(m_outputs[i]->output->get_name());
+	}
+	m_outputs_watchdog.start([](const std::string& name) -> void {
+		FALCO_LOG(falco_logger::level::CRIT, "\"" + name + "\" output timeout, the output channel is blocked\n");
+	}, std::move(names));
+
+	for(auto& o : m_outputs)
+	{
+		o->queue.set_capacity(outputs_queue_capacity);
+		o->thread = std::thread(&falco_outputs::output_worker_loop, this, o.get());
+	}
 	m_worker_thread = std::thread(&falco_outputs::worker, this);
+
+	if(aggregation.enabled)
+	{
+		m_aggregator = std::make_unique<falco::outputs::alert_aggregator>(
+			std::chrono::milliseconds(aggregation.window_ms), aggregation.max_groups,
+			[this](falco::outputs::alert_aggregator::group& g) { emit_summary(g); });
+	}
 #endif
 }
 
 falco_outputs::~falco_outputs()
 {
 #ifndef __EMSCRIPTEN__
+	// the summaries of the open groups go out before the outputs stop
+	if(m_aggregator)
+	{
+		m_aggregator->stop();
+	}
 	this->stop_worker();
 #endif
 }
 
+static std::mutex s_registered_outputs_mtx;
+static std::unordered_map<std::string, falco_outputs::output_factory> s_registered_outputs;
+
+void falco_outputs::register_output(const std::string& name, output_factory factory)
+{
+	std::lock_guard<std::mutex> lk(s_registered_outputs_mtx);
+	s_registered_outputs[name] = std::move(factory);
+}
+
+static std::unique_ptr<falco::outputs::abstract_output> registered_output(const std::string& name)
+{
+	std::lock_guard<std::mutex> lk(s_registered_outputs_mtx);
+	auto it = s_registered_outputs.find(name);
+	if(it == s_registered_outputs.end())
+	{
+		return nullptr;
+	}
+	return it->second();
+}
+
 // This function is called only at initialization-time by the constructor
 void falco_outputs::add_output(const falco::outputs::config &oc)
 {
@@ -84,6 +233,10 @@ void falco_outputs::add_output(const falco::outputs::config &oc)
 	{
 		oo = std::make_unique<falco::outputs::output_file>();
 	}
+	else if(oc.name == "recent_alerts" && m_recent_alerts)
+	{
+		oo = std::make_unique<falco::outputs::output_recent_alerts>(m_recent_alerts);
+	}
 #ifndef _WIN32
 	else if(oc.name == "program")
 	{
@@ -99,6 +252,14 @@ void falco_outputs::add_output(const falco::outputs::config &oc)
 	{
 		oo = std::make_unique<falco::outputs::output_syslog>();
 	}
+	else if(oc.name == "shm")
+	{
+		oo = std::make_unique<falco::outputs::output_shm>();
+	}
+	else if(oc.name == "unix_socket")
+	{
+		oo = std::make_unique<falco::outputs::output_unix_socket>();
+	}
 #endif
 #if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(MINIMAL_BUILD)
 	else if(oc.name == "http")
@@ -109,34 +270,50 @@ void falco_outputs::add_output(const falco::outputs::config &oc)
 	{
 		oo = std::make_unique<falco::outputs::output_grpc>();
 	}
+	else if(oc.name == "kafka")
+	{
+		oo = std::make_unique<falco::outputs::output_kafka>();
+	}
 #endif
 	else
 	{
-		throw falco_exception("Output not supported: " + oc.name);
+		oo = registered_output(oc.name);
+		if(!oo)
+		{
+			throw falco_exception("Output not supported: " + oc.name);
+		}
 	}
 
 	std::string init_err;
 	if (oo->init(oc, m_buffered, m_hostname, m_json_output, init_err))
 	{
-		m_outputs.push_back(std::move(oo));
+		auto w = std::make_unique<output_worker>();
+		w->output = std::move(oo);
+		w->route = oc.route;
+		w->routes_all = oc.route.accepts_all();
+		// projections only apply to the alerts with a structure
+		if(!oc.projection.empty() && (m_json_output || w->output->uses_fields()))
+		{
+			w->projection = oc.projection;
+			w->projected_json = !w->output->uses_fields();
+		}
+		else if(!oc.projection.empty())
+		{
+			FALCO_LOG(falco_logger::level::WARNING, oc.name + ": the projection is ignored, as the output writes text alerts\n");
+		}
+		m_outputs.push_back(std::move(w));
 	}
 	else
 	{
-		falco_logger::log(falco_logger::level::ERR, "Failed to init output: " + init_err);
+		FALCO_LOG(falco_logger::level::ERR, "Failed to init output: " + init_err);
 	}
 }
 
-void falco_outputs::handle_event(sinsp_evt *evt, const std::string &rule, const std::string &source,
-				 falco_common::priority_type priority, const std::string &format, std::set<std::string> &tags)
+std::string falco_outputs::alert_format(const std::string &format, falco_common::priority_type priority,
+					bool time_format_iso_8601)
 {
-	falco_outputs::ctrl_msg cmsg = {};
-	cmsg.ts = evt->get_ts();
-	cmsg.priority = priority;
-	cmsg.source = source;
-	cmsg.rule = rule;
-
 	std::string sformat;
-	if(m_time_format_iso_8601)
+	if(time_format_iso_8601)
 	{
 		sformat = "*%evt.time.iso8601: ";
 	}
@@ -155,14 +332,237 @@ void falco_outputs::handle_event(sinsp_evt *evt, const std::string &rule, const
 	{
 		sformat += " " + format;
 	}
+	return sformat;
+}
 
-	cmsg.msg = m_formats->format_event(
-		evt, rule, source, falco_common::format_priority(priority), sformat, tags, m_hostname
-	);
-	cmsg.fields = m_formats->get_field_values(evt, source, sformat);
-	cmsg.tags.insert(tags.begin(), tags.end());
+void falco_outputs::handle_event(sinsp_evt *evt, const falco::interned_string &rule, const falco::interned_string &source,
+				 falco_common::priority_type priority, const std::string &format, const falco::interned_tags &tags)
+{
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::OUTPUTS);
+	std::string sformat = alert_format(format, priority, m_time_format_iso_8601);
+
+	auto cmsg = acquire_msg();
+	try
+	{
+		cmsg->msg = m_formats->format_event(
+			evt, rule, source, falco_common::format_priority(priority), sformat, tags, m_hostname
+		);
+		if(m_fields_needed)
+		{
+			falco::assign_field_values(cmsg->fields, m_formats->get_field_values(evt, source, sformat));
+		}
+		else
+		{
+			cmsg->fields.clear();
+		}
+	}
+	catch(...)
+	{
+		release_msg(cmsg);
+		throw;
+	}
+	cmsg->ts = evt->get_ts();
+	cmsg->priority = priority;
+	cmsg->source = source;
+	cmsg->rule = rule;
+	cmsg->tags = tags;
+	matched(cmsg, evt);
+	trace_match(cmsg, evt);
+
+	cmsg->type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+	this->push(cmsg);
+}
+
+void falco_outputs::handle_event(sinsp_evt *evt, const falco_rule &rule)
+{
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::OUTPUTS);
+	auto formatter = m_engine->get_rule_formatter(rule.id);
+	if(!formatter)
+	{
+		handle_event(evt, rule.name, rule.source, rule.priority, rule.output, rule.tags);
+		return;
+	}
+
+	// the key is only needed until the group is opened, and alerts of
+	// a given source are always handled by the same thread
+	thread_local std::string key;
+	bool aggregated = m_aggregator && aggregation_key(key, evt, rule);
+	if(aggregated && m_aggregator->suppress(key, evt->get_ts()))
+	{
+		return;
+	}
+
+	auto cmsg = acquire_msg();
+	try
+	{
+		if(m_fields_needed)
+		{
+			cmsg->fields = m_engine->get_rule_field_values(evt, rule.id);
+		}
+		else
+		{
+			cmsg->fields.clear();
+		}
+
+#ifndef __EMSCRIPTEN__
+		if(m_deferred_formatting)
+		{
+			// the extracted fields are all the worker needs
+			cmsg->deferred = true;
+			cmsg->rule_id = rule.id;
+		}
+		else
+#endif
+		{
+			m_formats->format_event(
+				cmsg->msg, evt, rule.name, rule.source, falco_common::format_priority(rule.priority),
+				*formatter, rule.tags, m_hostname
+			);
+		}
+	}
+	catch(...)
+	{
+		release_msg(cmsg);
+		throw;
+	}
+	cmsg->ts = evt->get_ts();
+	cmsg->priority = rule.priority;
+	cmsg->source = rule.source;
+	cmsg->rule = rule.name;
+	cmsg->tags = rule.tags;
+	matched(cmsg, evt);
+	trace_match(cmsg, evt);
 
-	cmsg.type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+	if(aggregated)
+	{
+		falco::outputs::alert_aggregator::group g;
+		g.rule_id = rule.id;
+		g.priority = rule.priority;
+		g.rule = rule.name;
+		g.source = rule.source;
+		g.tags = rule.tags;
+		g.fields = cmsg->fields;
+		m_aggregator->open(key, std::move(g));
+	}
+
+	cmsg->type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+	this->push(cmsg);
+}
+
+void falco_outputs::handle_alert(const falco::outputs::message& alert)
+{
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::OUTPUTS);
+	auto cmsg = acquire_msg();
+	cmsg->ts = alert.ts;
+	cmsg->priority = alert.priority;
+	cmsg->msg = alert.msg;
+	cmsg->rule = alert.rule;
+	cmsg->source = alert.source;
+	cmsg->fields = alert.fields;
+	cmsg->tags = alert.tags;
+	cmsg->deferred = false;
+	cmsg->matched_ts = epoch_ns();
+	cmsg->type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+	this->push(cmsg);
+}
+
+const std::string& falco_outputs::aggregation_key_format(const std::string& source)
+{
+	std::lock_guard<std::mutex> lk(m_aggregation_mtx);
+	auto it = m_aggregation_key_formats.find(source);
+	if(it != m_aggregation_key_formats.end())
+	{
+		return it->second;
+	}
+
+	// only the keys supported by the source are used, so that some
+	// keys (e.g. container.id) can be specific to some sources
+	std::string format;
+	for(const auto& k : m_aggregation_keys)
+	{
+		try
+		{
+			m_engine->get_formatter(source, "%" + k);
+		}
+		catch(const std::exception &)
+		{
+			FALCO_LOG(falco_logger::level::DEBUG, "Alerts aggregation key " + k + " not supported by source " + source + "\n");
+			continue;
+		}
+		format += format.empty() ? "%" : " %";
+		format += k;
+	}
+	return m_aggregation_key_formats[source] = format;
+}
+
+bool falco_outputs::aggregation_key(std::string& key, sinsp_evt *evt, const falco_rule &rule)
+{
+	key.clear();
+	key += std::to_string(rule.id);
+
+	const auto& format = aggregation_key_format(rule.source);
+	if(format.empty())
+	{
+		return true;
+	}
+
+	try
+	{
+		for(const auto& v : m_engine->get_field_values(evt, rule.source, format))
+		{
+			key += '\0';
+			key += v.second;
+		}
+	}
+	catch(const std::exception &)
+	{
+		// not aggregated, rather than aggregated with the wrong alerts
+		return false;
+	}
+	return true;
+}
+
+void falco_outputs::emit_summary(falco::outputs::alert_aggregator::group& g)
+{
+	static const falco::interned_string s_count = "falco.aggregated.count";
+	static const falco::interned_string s_first_ts = "falco.aggregated.first_ts";
+	static const falco::interned_string s_last_ts = "falco.aggregated.last_ts";
+	static const std::string s_summary_format =
+		" (%falco.aggregated.count similar alerts suppressed"
+		" between %falco.aggregated.first_ts and %falco.aggregated.last_ts)";
+
+	auto cmsg = acquire_msg();
+	try
+	{
+		cmsg->fields = g.fields;
+		falco::field_value v;
+		v.type = falco::field_value::FV_UINT;
+		v.u = g.count;
+		cmsg->fields.emplace_back(s_count, v);
+		v.u = g.first_ts;
+		cmsg->fields.emplace_back(s_first_ts, v);
+		v.u = g.last_ts;
+		cmsg->fields.emplace_back(s_last_ts, v);
+
+		m_formats->format_fields(
+			cmsg->msg, g.last_ts, g.rule, g.source, falco_common::format_priority(g.priority),
+			m_engine->get_rule_output_format(g.rule_id) + s_summary_format,
+			cmsg->fields, g.tags, m_hostname, m_json_output
+		);
+	}
+	catch(const std::exception &e)
+	{
+		release_msg(cmsg);
+		FALCO_LOG(falco_logger::level::ERR, "Failed to format alerts summary for rule \"" + g.rule + "\": " + std::string(e.what()) + "\n");
+		return;
+	}
+	cmsg->ts = g.last_ts;
+	cmsg->priority = g.priority;
+	cmsg->source = g.source;
+	cmsg->rule = g.rule;
+	cmsg->tags = g.tags;
+
+	cmsg->type = ctrl_msg_type::CTRL_MSG_OUTPUT;
 	this->push(cmsg);
 }
 
@@ -176,66 +576,69 @@ void falco_outputs::handle_msg(uint64_t ts,
 	{
 		throw falco_exception("falco_outputs: output fields must be key-value maps");
 	}
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::OUTPUTS);
 
-	falco_outputs::ctrl_msg cmsg = {};
-	cmsg.ts = ts;
-	cmsg.priority = priority;
-	cmsg.source = s_internal_source;
-	cmsg.rule = rule;
-	cmsg.fields = output_fields;
+	auto cmsg = acquire_msg();
+	cmsg->ts = ts;
+	cmsg->priority = priority;
+	cmsg->source = s_internal_source;
+	cmsg->rule = rule;
 
-	if(m_json_output)
+	try
 	{
-		nlohmann::json jmsg;
+		falco::assign_field_values(cmsg->fields, output_fields);
 
-		// Convert the time-as-nanoseconds to a more json-friendly ISO8601.
-		time_t evttime = ts / 1000000000;
-		char time_sec[20]; // sizeof "YYYY-MM-DDTHH:MM:SS"
-		char time_ns[12];  // sizeof ".sssssssssZ"
-		std::string iso8601evttime;
+		if(m_json_output)
+		{
+			nlohmann::json jmsg;
 
-		strftime(time_sec, sizeof(time_sec), "%FT%T", gmtime(&evttime));
-		snprintf(time_ns, sizeof(time_ns), ".%09luZ", ts % 1000000000);
-		iso8601evttime = time_sec;
-		iso8601evttime += time_ns;
+			// Convert the time-as-nanoseconds to a more json-friendly ISO8601.
+			std::string iso8601evttime;
+			falco::utils::append_iso8601_utc(iso8601evttime, ts);
 
-		jmsg["output"] = msg;
-		jmsg["priority"] = falco_common::format_priority(priority);
-		jmsg["rule"] = rule;
-		jmsg["time"] = iso8601evttime;
-		jmsg["output_fields"] = output_fields;
-		jmsg["hostname"] = m_hostname;
-		jmsg["source"] = s_internal_source;
+			jmsg["output"] = msg;
+			jmsg["priority"] = falco_common::format_priority(priority);
+			jmsg["rule"] = rule;
+			jmsg["time"] = iso8601evttime;
+			jmsg["output_fields"] = output_fields;
+			jmsg["hostname"] = m_hostname;
+			jmsg["source"] = s_internal_source;
 
-		cmsg.msg = jmsg.dump();
-	}
-	else
-	{
-		std::string timestr;
-		bool first = true;
-
-		sinsp_utils::ts_to_string(ts, &timestr, false, true);
-		cmsg.msg = timestr + ": " + falco_common::format_priority(priority) + " " + msg + " (";
-		for(auto &pair : output_fields.items())
+			cmsg->msg = jmsg.dump();
+		}
+		else
 		{
-			if(first)
-			{
-				first = false;
-			}
-			else
-			{
-				cmsg.msg += " ";
-			}
-			if (!pair.value().is_primitive())
+			std::string timestr;
+			bool first = true;
+
+			sinsp_utils::ts_to_string(ts, &timestr, false, true);
+			cmsg->msg = timestr + ": " + falco_common::format_priority(priority) + " " + msg + " (";
+			for(auto &pair : output_fields.items())
 			{
-				throw falco_exception("falco_outputs: output fields must be key-value maps");
+				if(first)
+				{
+					first = false;
+				}
+				else
+				{
+					cmsg->msg += " ";
+				}
+				if (!pair.value().is_primitive())
+				{
+					throw falco_exception("falco_outputs: output fields must be key-value maps");
+				}
+				cmsg->msg += pair.key() + "=" + pair.value().dump();
 			}
-			cmsg.msg += pair.key() + "=" + pair.value().dump();
+			cmsg->msg += ")";
 		}
-		cmsg.msg += ")";
+	}
+	catch(...)
+	{
+		release_msg(cmsg);
+		throw;
 	}
 
-	cmsg.type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+	cmsg->type = ctrl_msg_type::CTRL_MSG_OUTPUT;
 	this->push(cmsg);
 }
 
@@ -249,48 +652,316 @@ void falco_outputs::reopen_outputs()
 	this->push_ctrl(falco_outputs::ctrl_msg_type::CTRL_MSG_REOPEN);
 }
 
-void falco_outputs::stop_worker()
+falco_outputs::ctrl_msg* falco_outputs::acquire_msg()
+{
+	std::lock_guard<std::mutex> lk(m_pool_mtx);
+	if(m_pool.empty())
+	{
+		m_pool_storage.push_back(std::make_unique<ctrl_msg>());
+		return m_pool_storage.back().get();
+	}
+	auto cmsg = m_pool.back();
+	m_pool.pop_back();
+	return cmsg;
+}
+
+void falco_outputs::release_msg(ctrl_msg* cmsg)
+{
+	// keep the buffers of the output and of the fields, which are
+	// overwritten by the next alerts, and reset everything else
+	cmsg->msg.clear();
+	cmsg->encoded.clear();
+	cmsg->type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+	cmsg->deferred = false;
+	cmsg->rule_id = 0;
+	cmsg->matched_ts = 0;
+	cmsg->traced = false;
+	if(cmsg->queued_bytes > 0)
+	{
+		m_queued_bytes.fetch_sub(cmsg->queued_bytes, std::memory_order_relaxed);
+		cmsg->queued_bytes = 0;
+	}
+
+	// the buffers only grow while the message is in use, and are
+	// accounted for once it's back in the pool
+	size_t bytes = falco::utils::memory::of(cmsg->msg)
+		+ cmsg->fields.capacity() * sizeof(falco::field_values::value_type)
+		+ cmsg->encoded.memory_usage();
+	for(const auto& f : cmsg->fields)
+	{
+		bytes += falco::utils::memory::of(f.second.str);
+	}
+	if(bytes != cmsg->buffers_memory_bytes)
+	{
+		m_pool_buffers_memory_bytes.fetch_add(bytes - cmsg->buffers_memory_bytes, std::memory_order_relaxed);
+		cmsg->buffers_memory_bytes = bytes;
+	}
+
+	std::lock_guard<std::mutex> lk(m_pool_mtx);
+	m_pool.push_back(cmsg);
+}
+
+void falco_outputs::drain_queues()
 {
-	watchdog<void *> wd;
-	wd.start([&](void *) -> void {
-		falco_logger::log(falco_logger::level::NOTICE, "output channels still blocked, discarding all remaining notifications\n");
 #ifndef __EMSCRIPTEN__
-		m_queue.clear();
+	ctrl_msg* cmsg;
+	while(m_queue.try_pop(cmsg))
+	{
+		spill_on_drain(*cmsg, nullptr);
+		release_msg(cmsg);
+	}
+	for(const auto& o : m_outputs)
+	{
+		while(o->queue.try_pop(cmsg))
+		{
+			spill_on_drain(*cmsg, o.get());
+			if(--cmsg->refs == 0)
+			{
+				release_msg(cmsg);
+			}
+		}
+	}
+#endif
+}
+
+void falco_outputs::spill_on_drain(ctrl_msg& cmsg, output_worker* w)
+{
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+	// the alerts that would be discarded are kept for the next run by
+	// the outputs having a spill buffer
+	if(cmsg.type != ctrl_msg_type::CTRL_MSG_OUTPUT)
+	{
+		return;
+	}
+	for(const auto& o : m_outputs)
+	{
+		if(w && w != o.get())
+		{
+			continue;
+		}
+		if(!o->spill)
+		{
+			o->num_shutdown_lost++;
+			continue;
+		}
+		if(cmsg.deferred)
+		{
+			try
+			{
+				format_deferred(cmsg);
+			}
+			catch(const std::exception&)
+			{
+				o->num_shutdown_lost++;
+				continue;
+			}
+		}
+		o->spill->spill(cmsg);
+	}
+#else
+	if(cmsg.type == ctrl_msg_type::CTRL_MSG_OUTPUT)
+	{
+		for(const auto& o : m_outputs)
+		{
+			if(!w || w == o.get())
+			{
+				o->num_shutdown_lost++;
+			}
+		}
+	}
 #endif
+}
+
+inline bool falco_outputs::drain_expired(output_worker* w) const
+{
+	if(!m_draining.load(std::memory_order_acquire) || m_lossless.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+	if(w && m_drain.max_alerts > 0 && w->num_drained >= m_drain.max_alerts)
+	{
+		return true;
+	}
+	return std::chrono::steady_clock::now() >= m_drain_deadline;
+}
+
+// The alerts lost when stopping the outputs, accumulated over the restarts
+// of Falco, which create the outputs anew
+static std::atomic<uint64_t> s_num_shutdown_lost = 0;
+
+void falco_outputs::stop_worker()
+{
+	// each output delivers its queued alerts in its own thread, and the
+	// ones left once the drain expires are spilled or discarded by the
+	// output itself. The watchdog only steps in for the outputs that are
+	// still blocked after the output timeout on top of that.
+	m_drain_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_drain.timeout_ms);
+	m_draining.store(true, std::memory_order_release);
+
+	watchdog<void *> wd;
+	wd.start([&](void * const&) -> void {
+		FALCO_LOG(falco_logger::level::NOTICE, "output channels still blocked, discarding all remaining notifications\n");
+		drain_queues();
 		this->push_ctrl(falco_outputs::ctrl_msg_type::CTRL_MSG_STOP);
 	});
-	wd.set_timeout(m_timeout, nullptr);
+	if(!m_lossless.load(std::memory_order_relaxed))
+	{
+		wd.set_timeout(std::chrono::milliseconds(m_drain.timeout_ms) + m_timeout);
+	}
 
 	this->push_ctrl(falco_outputs::ctrl_msg_type::CTRL_MSG_STOP);
 	if(m_worker_thread.joinable())
 	{
 		m_worker_thread.join();
 	}
+	for(const auto& o : m_outputs)
+	{
+		if(o->thread.joinable())
+		{
+			o->thread.join();
+		}
+	}
+	wd.cancel_timeout();
+	m_outputs_watchdog.stop();
+
+	for(const auto& o : m_outputs)
+	{
+		auto lost = o->num_shutdown_lost.load();
+		if(lost > 0)
+		{
+			s_num_shutdown_lost += lost;
+			FALCO_LOG(falco_logger::level::NOTICE, o->output->get_name() + ": " + std::to_string(lost) + " queued alerts could not be delivered before stopping\n");
+		}
+	}
 }
 
 inline void falco_outputs::push_ctrl(ctrl_msg_type cmt)
 {
-	falco_outputs::ctrl_msg cmsg = {};
-	cmsg.type = cmt;
+	auto cmsg = acquire_msg();
+	cmsg->type = cmt;
 	this->push(cmsg);
 }
 
-inline void falco_outputs::push(const ctrl_msg& cmsg)
+static inline void update_max(std::atomic<uint64_t>& max, uint64_t value)
 {
+	auto cur = max.load(std::memory_order_relaxed);
+	while(value > cur && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+	{
+	}
+}
+
 #ifndef __EMSCRIPTEN__
-	if (!m_queue.try_push(cmsg))
+inline bool falco_outputs::admits(output_worker& o, const ctrl_msg& cmsg) const
+{
+	if(!admits(o.queue, cmsg))
+	{
+		return false;
+	}
+	if(o.backlog_capacity == 0 || cmsg.type != ctrl_msg_type::CTRL_MSG_OUTPUT
+		|| (size_t) cmsg.priority >= o.backlog_limits.size())
+	{
+		return true;
+	}
+
+	// the alerts waiting in the queue will join the backlog of the
+	// output, e.g. the ones not read yet by its slowest client
+	auto pending = std::max<std::ptrdiff_t>(o.queue.size(), 0) + o.output->backlog();
+	if((std::ptrdiff_t) pending < o.backlog_limits[cmsg.priority])
+	{
+		return true;
+	}
+	o.num_backlog_shed++;
+	return false;
+}
+
+inline bool falco_outputs::admits(const falco_outputs_cbq& q, const ctrl_msg& cmsg) const
+{
+	// control messages are never shed, and the size of the queue is only
+	// a hint under concurrency, which is enough to pick what to drop
+	return cmsg.type != ctrl_msg_type::CTRL_MSG_OUTPUT
+		|| (size_t) cmsg.priority >= m_queue_limits.size()
+		|| q.size() < m_queue_limits[cmsg.priority];
+}
+
+// The bytes held by an alert, given by its contents rather than by the
+// capacity of its buffers, which are recycled from larger alerts
+static inline size_t alert_bytes(const falco::outputs::message& m)
+{
+	size_t bytes = m.msg.size() + m.fields.size() * sizeof(falco::field_values::value_type);
+	for(const auto& f : m.fields)
+	{
+		bytes += f.second.str.size();
+	}
+	return bytes;
+}
+
+inline bool falco_outputs::charge(ctrl_msg& cmsg, bool limited)
+{
+	if(cmsg.type != ctrl_msg_type::CTRL_MSG_OUTPUT)
+	{
+		return true;
+	}
+	// note: the total can briefly exceed the budget under concurrency,
+	// by at most one alert per thread queueing them
+	size_t bytes = sizeof(ctrl_msg) + alert_bytes(cmsg);
+	auto total = m_queued_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	if(limited && m_max_bytes > 0 && (size_t) cmsg.priority < m_bytes_limits.size()
+		&& total > (uint64_t) m_bytes_limits[cmsg.priority])
+	{
+		m_queued_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+		return false;
+	}
+	cmsg.queued_bytes = bytes;
+	update_max(m_queued_bytes_max, total);
+	return true;
+}
+#endif
+
+static inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void falco_outputs::push(ctrl_msg* cmsg)
+{
+#ifndef __EMSCRIPTEN__
+	auto now = std::chrono::steady_clock::now();
+	cmsg->queued = now;
+	if (m_lossless.load(std::memory_order_relaxed))
+	{
+		// the message can be released by the outputs once queued
+		charge(*cmsg, false);
+		if (!m_queue.try_push(cmsg))
+		{
+			m_queue.push(cmsg);
+			m_backpressure_wait_ns.fetch_add(elapsed_ns(now), std::memory_order_relaxed);
+		}
+		update_max(m_queue_depth_max, std::max<std::ptrdiff_t>(m_queue.size(), 0));
+	}
+	else if (admits(m_queue, *cmsg) && charge(*cmsg) && m_queue.try_push(cmsg))
+	{
+		update_max(m_queue_depth_max, std::max<std::ptrdiff_t>(m_queue.size(), 0));
+	}
+	else
 	{
 		if(m_outputs_queue_num_drops.load() == 0)
 		{
-			falco_logger::log(falco_logger::level::ERR, "Outputs queue out of memory. Drop event and continue on ...");
+			FALCO_LOG(falco_logger::level::ERR, "Outputs queue out of memory. Drop event and continue on ...");
 		}
 		m_outputs_queue_num_drops++;
+		if(cmsg->type == ctrl_msg_type::CTRL_MSG_OUTPUT && (size_t) cmsg->priority < m_outputs_queue_num_drops_by_priority.size())
+		{
+			m_outputs_queue_num_drops_by_priority[cmsg->priority]++;
+		}
+		release_msg(cmsg);
 	}
 #else
 	for (const auto& o : m_outputs)
 	{
-		process_msg(o.get(), cmsg);
+		process_msg(o.get(), *cmsg);
+		o->output->idle();
 	}
+	release_msg(cmsg);
 #endif
 }
 
@@ -299,42 +970,290 @@ inline void falco_outputs::push(const ctrl_msg& cmsg)
 // we still need to improve the error reporting since some inner functions can throw exceptions.
 void falco_outputs::worker() noexcept
 {
-	watchdog<std::string> wd;
-	wd.start([&](const std::string& payload) -> void {
-		falco_logger::log(falco_logger::level::CRIT, "\"" + payload + "\" output timeout, all output channels are blocked\n");
-	});
-
-	auto timeout = m_timeout;
-
-	falco_outputs::ctrl_msg cmsg;
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::OUTPUTS);
+	ctrl_msg* cmsg = nullptr;
+	ctrl_msg_type type;
 	do
 	{
 		// Block until a message becomes available.
 #ifndef __EMSCRIPTEN__
 		m_queue.pop(cmsg);
 #endif
+		type = cmsg->type;
+		if(type == ctrl_msg_type::CTRL_MSG_OUTPUT)
+		{
+			m_queue_latency.record(std::chrono::steady_clock::now() - cmsg->queued);
+			if(drain_expired(nullptr))
+			{
+				spill_on_drain(*cmsg, nullptr);
+				release_msg(cmsg);
+				continue;
+			}
+		}
 
-		for(const auto& o : m_outputs)
+		if(cmsg->deferred)
 		{
-			wd.set_timeout(timeout, o->get_name());
 			try
 			{
-				process_msg(o.get(), cmsg);
+				format_deferred(*cmsg);
 			}
 			catch(const std::exception &e)
 			{
-				falco_logger::log(falco_logger::level::ERR, o->get_name() + ": " + std::string(e.what()) + "\n");
+				FALCO_LOG(falco_logger::level::ERR, "Failed to format alert for rule \"" + cmsg->rule + "\": " + std::string(e.what()) + "\n");
+				release_msg(cmsg);
+				continue;
+			}
+
+			// the alert was admitted before being formatted, and the
+			// output now counts towards the budget as well
+			cmsg->queued_bytes += cmsg->msg.size();
+			update_max(m_queued_bytes_max, m_queued_bytes.fetch_add(cmsg->msg.size(), std::memory_order_relaxed) + cmsg->msg.size());
+		}
+
+		dispatch(cmsg);
+	} while(type != ctrl_msg_type::CTRL_MSG_STOP);
+}
+
+void falco_outputs::dispatch(ctrl_msg* cmsg)
+{
+#ifndef __EMSCRIPTEN__
+	// one reference for each output, plus one held while dispatching so
+	// that the message isn't recycled before reaching all the outputs
+	cmsg->refs = m_outputs.size() + 1;
+	cmsg->queued = std::chrono::steady_clock::now();
+	for(const auto& o : m_outputs)
+	{
+		// control messages must reach every output, whereas alerts
+		// are dropped for the outputs that can't keep up
+		if(cmsg->type != ctrl_msg_type::CTRL_MSG_OUTPUT)
+		{
+			o->queue.push(cmsg);
+		}
+		else if(!o->routes_all && !o->route.accepts(cmsg->priority, cmsg->source, cmsg->tags, cmsg->rule))
+		{
+			o->num_unrouted++;
+			cmsg->refs--;
+		}
+		else if(m_lossless.load(std::memory_order_relaxed))
+		{
+			if(!o->queue.try_push(cmsg))
+			{
+				auto start = std::chrono::steady_clock::now();
+				o->queue.push(cmsg);
+				o->backpressure_wait_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+			}
+			update_max(o->queue_depth_max, std::max<std::ptrdiff_t>(o->queue.size(), 0));
+		}
+#if !defined(_WIN32)
+		else if(o->spill)
+		{
+			// the alerts that don't fit in the queue are spilled to disk
+			// instead, and dropped only when the spill buffer is full
+			auto res = o->spill->push(*cmsg, [&] { return admits(*o, *cmsg) && o->queue.try_push(cmsg); });
+			if(res == falco::outputs::spill_buffer::QUEUED)
+			{
+				update_max(o->queue_depth_max, std::max<std::ptrdiff_t>(o->queue.size(), 0));
+			}
+			else
+			{
+				cmsg->refs--;
+			}
+			if(res == falco::outputs::spill_buffer::DROPPED)
+			{
+				if(o->num_drops.load() == 0)
+				{
+					FALCO_LOG(falco_logger::level::ERR, o->output->get_name() + ": output spill buffer full. Drop event and continue on ...");
+				}
+				o->num_drops++;
+			}
+		}
+#endif
+		else if(admits(*o, *cmsg) && o->queue.try_push(cmsg))
+		{
+			update_max(o->queue_depth_max, std::max<std::ptrdiff_t>(o->queue.size(), 0));
+		}
+		else
+		{
+			if(o->num_drops.load() == 0)
+			{
+				FALCO_LOG(falco_logger::level::ERR, o->output->get_name() + ": output queue out of memory. Drop event and continue on ...");
 			}
+			o->num_drops++;
+			cmsg->refs--;
 		}
-		wd.cancel_timeout();
-	} while(cmsg.type != ctrl_msg_type::CTRL_MSG_STOP);
+	}
+	if(--cmsg->refs == 0)
+	{
+		release_msg(cmsg);
+	}
+#endif
 }
 
-inline void falco_outputs::process_msg(falco::outputs::abstract_output* o, const ctrl_msg& cmsg)
+void falco_outputs::output_worker_loop(output_worker* w) noexcept
 {
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::OUTPUTS);
+	auto timeout = m_timeout;
+	auto process = [&](const ctrl_msg& m)
+	{
+		m_outputs_watchdog.set_timeout(timeout, w->watchdog_slot);
+		auto start = std::chrono::steady_clock::now();
+		try
+		{
+			process_msg(w, m);
+			if(m.type == ctrl_msg_type::CTRL_MSG_OUTPUT)
+			{
+				w->output_latency.record(std::chrono::steady_clock::now() - start);
+				if(m.matched_ts != 0)
+				{
+					w->detection_latency.record(latency_us(m.ts, epoch_ns()));
+				}
+				if(m.traced)
+				{
+					trace_delivery(m, w->output->get_name());
+				}
+			}
+			if(!w->has_pending())
+			{
+				w->output->idle();
+			}
+		}
+		catch(const std::exception &e)
+		{
+			w->num_errors++;
+			FALCO_LOG(falco_logger::level::ERR, w->output->get_name() + ": " + std::string(e.what()) + "\n");
+		}
+		m_outputs_watchdog.cancel_timeout(w->watchdog_slot);
+	};
+
+	ctrl_msg* cmsg = nullptr;
+	ctrl_msg_type type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+	ctrl_msg spilled;
+#endif
+	do
+	{
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+		// the spilled alerts are newer than the queued messages, so they
+		// are only delivered while the queue is empty
+		if(w->spill && !w->queue.try_pop(cmsg))
+		{
+			// what's spilled stays on disk while draining
+			if(!m_draining.load(std::memory_order_acquire) && w->spill->pop(spilled))
+			{
+				process(spilled);
+				continue;
+			}
+			w->queue.pop(cmsg);
+		}
+		else if(!w->spill)
+#endif
+		{
+			// Block until a message becomes available.
+#ifndef __EMSCRIPTEN__
+			w->queue.pop(cmsg);
+#endif
+		}
+		type = cmsg->type;
+		if(type == ctrl_msg_type::CTRL_MSG_OUTPUT)
+		{
+			w->queue_latency.record(std::chrono::steady_clock::now() - cmsg->queued);
+		}
+
+		if(type == ctrl_msg_type::CTRL_MSG_OUTPUT && drain_expired(w))
+		{
+			spill_on_drain(*cmsg, w);
+		}
+		else
+		{
+			if(type == ctrl_msg_type::CTRL_MSG_OUTPUT && m_draining.load(std::memory_order_relaxed))
+			{
+				w->num_drained++;
+			}
+			process(*cmsg);
+		}
+
+		if(--cmsg->refs == 0)
+		{
+			release_msg(cmsg);
+		}
+	} while(type != ctrl_msg_type::CTRL_MSG_STOP);
+}
+
+inline void falco_outputs::matched(ctrl_msg* cmsg, sinsp_evt *evt)
+{
+	cmsg->matched_ts = epoch_ns();
+	m_event_latency.record(latency_us(evt->get_ts(), cmsg->matched_ts));
+}
+
+// The sampled alerts are traced from the time of their event to the rule
+// match, i.e. to when they are queued, and then to their delivery to each
+// output, which is a child span of the match
+inline void falco_outputs::trace_match(ctrl_msg* cmsg, sinsp_evt *evt)
+{
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	if(!m_otlp || !m_otlp->sample_alert(cmsg->trace_id, cmsg->match_span_id))
+	{
+		return;
+	}
+	cmsg->traced = true;
+
+	falco::otlp_exporter::span s;
+	s.trace = cmsg->trace_id;
+	s.span_id = cmsg->match_span_id;
+	s.name = "falco.rule_match";
+	s.start_ts = evt->get_ts();
+	s.end_ts = cmsg->matched_ts;
+	s.attributes = {
+		{"falco.rule", cmsg->rule},
+		{"falco.priority", falco_common::format_priority(cmsg->priority)},
+		{"falco.source", cmsg->source},
+		{"falco.evt_type", evt->get_name()},
+	};
+	m_otlp->export_span(std::move(s));
+#endif
+}
+
+void falco_outputs::trace_delivery(const ctrl_msg& cmsg, const std::string& output)
+{
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	falco::otlp_exporter::span s;
+	s.trace = cmsg.trace_id;
+	s.span_id = m_otlp->new_span_id();
+	s.parent_span_id = cmsg.match_span_id;
+	s.name = "falco.output";
+	s.start_ts = cmsg.matched_ts;
+	s.end_ts = epoch_ns();
+	s.attributes = {
+		{"falco.rule", cmsg.rule},
+		{"falco.output", output},
+	};
+	m_otlp->export_span(std::move(s));
+#endif
+}
+
+void falco_outputs::format_deferred(ctrl_msg& cmsg) const
+{
+	m_formats->format_fields(
+		cmsg.msg, cmsg.ts, cmsg.rule, cmsg.source, falco_common::format_priority(cmsg.priority),
+		m_engine->get_rule_output_format(cmsg.rule_id), cmsg.fields, cmsg.tags, m_hostname, m_json_output
+	);
+	cmsg.deferred = false;
+}
+
+inline void falco_outputs::process_msg(output_worker* w, const ctrl_msg& cmsg)
+{
+	auto o = w->output.get();
 	switch(cmsg.type)
 	{
 		case ctrl_msg_type::CTRL_MSG_OUTPUT:
+			if(!w->projection.empty())
+			{
+				falco::outputs::project(cmsg, w->projection, w->projected_json, m_hostname, w->projected);
+				o->output(&w->projected);
+				break;
+			}
 			o->output(&cmsg);
 			break;
 		case ctrl_msg_type::CTRL_MSG_CLEANUP:
@@ -345,7 +1264,7 @@ inline void falco_outputs::process_msg(falco::outputs::abstract_output* o, const
 			o->reopen();
 			break;
 		default:
-			falco_logger::log(falco_logger::level::DEBUG, "Outputs worker received an unknown message type\n");
+			FALCO_LOG(falco_logger::level::DEBUG, "Outputs worker received an unknown message type\n");
 	}
 }
 
@@ -353,3 +1272,110 @@ uint64_t falco_outputs::get_outputs_queue_num_drops()
 {
 	return m_outputs_queue_num_drops.load();
 }
+
+std::map<std::string, uint64_t> falco_outputs::get_output_queues_num_drops()
+{
+	std::map<std::string, uint64_t> res;
+	for(const auto& o : m_outputs)
+	{
+		res[o->output->get_name()] += o->num_drops.load();
+	}
+	return res;
+}
+
+std::map<std::string, uint64_t> falco_outputs::get_outputs_queue_num_drops_by_priority()
+{
+	std::map<std::string, uint64_t> res;
+	for(size_t p = 0; p < m_outputs_queue_num_drops_by_priority.size(); p++)
+	{
+		res[falco_common::format_priority((falco_common::priority_type) p)] = m_outputs_queue_num_drops_by_priority[p].load();
+	}
+	return res;
+}
+
+void falco_outputs::set_lossless(bool enabled)
+{
+	m_lossless.store(enabled, std::memory_order_relaxed);
+}
+
+std::map<std::string, uint64_t> falco_outputs::get_backpressure_wait_ns() const
+{
+	std::map<std::string, uint64_t> res;
+	res["queue"] = m_backpressure_wait_ns.load(std::memory_order_relaxed);
+	for(const auto& o : m_outputs)
+	{
+		res[o->output->get_name()] += o->backpressure_wait_ns.load(std::memory_order_relaxed);
+	}
+	return res;
+}
+
+uint64_t falco_outputs::get_outputs_aggregation_num_suppressed()
+{
+	return m_aggregator ? m_aggregator->num_suppressed() : 0;
+}
+
+std::map<std::string, uint64_t> falco_outputs::get_outputs_metrics()
+{
+	std::map<std::string, uint64_t> res;
+	for(const auto& o : m_outputs)
+	{
+		std::map<std::string, uint64_t> metrics;
+		o->output->get_metrics(metrics);
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+		if(o->spill)
+		{
+			metrics["spill_pending"] = o->spill->num_pending();
+			metrics["spill_spilled"] = o->spill->num_spilled();
+			metrics["spill_drops"] = o->spill->num_drops();
+		}
+#endif
+		o->queue_latency.get_metrics("queue_latency", metrics);
+		o->output_latency.get_metrics("output_latency", metrics);
+		o->detection_latency.get_metrics("detection_latency", metrics);
+		metrics["errors"] = o->num_errors.load();
+		metrics["queue_depth_max"] = o->queue_depth_max.load();
+		if(o->backlog_capacity > 0)
+		{
+			metrics["backlog_depth"] = o->output->backlog();
+			metrics["backlog_shed"] = o->num_backlog_shed.load();
+		}
+		if(!o->routes_all)
+		{
+			metrics["unrouted"] = o->num_unrouted.load();
+		}
+		for(const auto& m : metrics)
+		{
+			res[o->output->get_name() + "." + m.first] = m.second;
+		}
+	}
+	return res;
+}
+
+std::map<std::string, const falco::outputs::latency_histogram*> falco_outputs::get_outputs_detection_latencies() const
+{
+	std::map<std::string, const falco::outputs::latency_histogram*> res;
+	for(const auto& o : m_outputs)
+	{
+		res[o->output->get_name()] = &o->detection_latency;
+	}
+	return res;
+}
+
+std::map<std::string, uint64_t> falco_outputs::get_outputs_queue_metrics()
+{
+	std::map<std::string, uint64_t> res;
+	m_queue_latency.get_metrics("latency", res);
+	m_event_latency.get_metrics("event_latency", res);
+	res["depth_max"] = m_queue_depth_max.load();
+	res["shutdown_lost"] = s_num_shutdown_lost.load();
+	res["queued_bytes"] = m_queued_bytes.load(std::memory_order_relaxed);
+	res["queued_bytes_max"] = m_queued_bytes_max.load(std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lk(m_pool_mtx);
+		res["memory_bytes"] = m_pool_storage.size() * sizeof(ctrl_msg)
+			+ m_pool_storage.capacity() * sizeof(std::unique_ptr<ctrl_msg>)
+			+ m_pool.capacity() * sizeof(ctrl_msg*)
+			+ m_pool_buffers_memory_bytes.load(std::memory_order_relaxed);
+	}
+	return res;
+}
@@ -17,17 +17,34 @@ limitations under the License.
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "alert_aggregator.h"
 #include "falco_common.h"
 #include "falco_engine.h"
+#include "latency_histogram.h"
 #include "outputs.h"
+#include "outputs_spill.h"
+#include "recent_alerts.h"
 #include "formats.h"
+#include "watchdog.h"
 #ifndef __EMSCRIPTEN__
 #include "tbb/concurrent_queue.h"
 #endif
 
+namespace falco
+{
+class otlp_exporter;
+}
+
 /*!
 	\brief This class acts as the primary interface between a program and the
 	falco output engine. The falco rules engine is implemented by a
@@ -49,17 +66,62 @@ public:
 		uint32_t timeout,
 		bool buffered,
 		size_t outputs_queue_capacity,
+		uint32_t outputs_queue_priority_reserve,
+		uint64_t outputs_queue_max_bytes,
+		const falco::outputs::spill_config& spill,
+		const falco::outputs::drain_config& drain,
+		bool deferred_formatting,
+		const falco::outputs::aggregation_config& aggregation,
 		bool time_format_iso_8601,
-		const std::string& hostname);
+		const std::string& hostname,
+		const std::shared_ptr<falco::otlp_exporter>& otlp = nullptr,
+		const std::shared_ptr<falco::outputs::recent_alerts>& recent_alerts = nullptr);
 
 	virtual ~falco_outputs();
 
+	typedef std::function<std::unique_ptr<falco::outputs::abstract_output>()> output_factory;
+
+	/*!
+		\brief Makes the outputs with the given name, which is not one of
+		the built-in outputs, available to the instances created afterwards,
+		e.g. to benchmark the outputs pipeline with fake outputs. Registering
+		a name again replaces its factory.
+	*/
+	static void register_output(const std::string& name, output_factory factory);
+
 	/*!
 		\brief Format then send the event to all configured outputs (`evt`
 		is an event that has matched some rule).
 	*/
-	void handle_event(sinsp_evt *evt, const std::string &rule, const std::string &source,
-			  falco_common::priority_type priority, const std::string &format, std::set<std::string> &tags);
+	void handle_event(sinsp_evt *evt, const falco::interned_string &rule, const falco::interned_string &source,
+			  falco_common::priority_type priority, const std::string &format, const falco::interned_tags &tags);
+
+	/*!
+		\brief Same as above, but uses the formatter compiled by the engine
+		for the rule when available, instead of looking it up by format.
+	*/
+	void handle_event(sinsp_evt *evt, const falco_rule &rule);
+
+	/*!
+		\brief Sends an alert already formatted from its event, e.g. by
+		an engine other than the one of the outputs, to all outputs
+	*/
+	void handle_alert(const falco::outputs::message& alert);
+
+	/*!
+		\brief Returns the hostname reported in the alerts
+	*/
+	inline const std::string& hostname() const
+	{
+		return m_hostname;
+	}
+
+	/*!
+		\brief Returns the format of the alerts for the given rule output,
+		which is prefixed with the event time and the rule priority.
+	*/
+	static std::string alert_format(const std::string &format, falco_common::priority_type priority,
+					bool time_format_iso_8601);
 
 	/*!
 		\brief Format then send a generic message to all outputs.
@@ -84,22 +146,90 @@ public:
 	*/
 	void reopen_outputs();
 
+	/*!
+		\brief When enabled, no alert is ever dropped: the threads sending
+		them wait for room in the outputs queue instead, the queue waits
+		for room in the queue of each output, ignoring the limits by
+		priority and the spill buffers, and the outputs deliver all their
+		queued alerts when stopping, however long it takes. This is meant
+		for capture file replays, whose alerts must not depend on the speed
+		of the outputs. To be set before sending any alert.
+	*/
+	void set_lossless(bool enabled);
+
+	/*!
+		\brief Return the nanoseconds spent waiting for room in the outputs
+		queue by the threads sending alerts ("queue"), and in the queue of
+		each output (by output name), which only happens when lossless
+	*/
+	std::map<std::string, uint64_t> get_backpressure_wait_ns() const;
+
 	/*!
 		\brief Return the number of events currently dropped due to failed push
 		attempts into the outputs queue
 	*/
 	uint64_t get_outputs_queue_num_drops();
 
+	/*!
+		\brief Return the number of events currently dropped due to failed push
+		attempts into the queue of each output, by output name
+	*/
+	std::map<std::string, uint64_t> get_output_queues_num_drops();
+
+	/*!
+		\brief Return the number of alerts currently dropped due to failed
+		push attempts into the outputs queue, by priority name
+	*/
+	std::map<std::string, uint64_t> get_outputs_queue_num_drops_by_priority();
+
+	/*!
+		\brief Return the number of alerts suppressed by the aggregation
+		of similar alerts, which are accounted for in the summaries
+	*/
+	uint64_t get_outputs_aggregation_num_suppressed();
+
+	/*!
+		\brief Return the output-specific metrics of all the outputs, by
+		output and metric name (e.g. "http.batches")
+	*/
+	std::map<std::string, uint64_t> get_outputs_metrics();
+
+	/*!
+		\brief Return the metrics of the outputs queue, which are how long
+		alerts wait in it (e.g. "latency_us_p99"), how long it took from
+		their events until they entered it (e.g. "event_latency_us_p99"),
+		its maximum depth, the alerts lost when stopping the outputs
+		since Falco started, an estimate of the memory held by the
+		recycled messages and their buffers ("memory_bytes"), and the
+		bytes of the alerts queued now and at most ("queued_bytes" and
+		"queued_bytes_max")
+	*/
+	std::map<std::string, uint64_t> get_outputs_queue_metrics();
+
+	/*!
+		\brief Return, by output name, the histograms of how long it took
+		from the events until their alerts were output, i.e. the end-to-end
+		detection latencies
+	*/
+	std::map<std::string, const falco::outputs::latency_histogram*> get_outputs_detection_latencies() const;
+
 private:
+	std::shared_ptr<const falco_engine> m_engine;
 	std::unique_ptr<falco_formats> m_formats;
 
-	std::vector<std::unique_ptr<falco::outputs::abstract_output>> m_outputs;
-
 	bool m_buffered;
+	bool m_deferred_formatting;
+	// whether the field values of the alerts are used at all, by an
+	// output, the deferred formatting or the aggregation
+	bool m_fields_needed = true;
 	bool m_json_output;
 	bool m_time_format_iso_8601;
 	std::chrono::milliseconds m_timeout;
+	falco::outputs::drain_config m_drain;
 	std::string m_hostname;
+	std::shared_ptr<falco::otlp_exporter> m_otlp;
+	// all the alerts are added to it by an output of its own, if set
+	std::shared_ptr<falco::outputs::recent_alerts> m_recent_alerts;
 
 	enum ctrl_msg_type
 	{
@@ -111,20 +241,188 @@ private:
 
 	struct ctrl_msg : falco::outputs::message
 	{
-		ctrl_msg_type type;
+		ctrl_msg_type type = ctrl_msg_type::CTRL_MSG_OUTPUT;
+
+		// when set, msg is empty and gets formatted by the worker
+		// from the extracted fields, for the rule with the given id
+		bool deferred = false;
+		std::size_t rule_id = 0;
+
+		// the number of outputs that still have to process the message
+		std::atomic<uint32_t> refs{0};
+
+		// when the message was last queued, to measure how long it waits
+		std::chrono::steady_clock::time_point queued;
+
+		// when the rule matched and the alert was queued, in ns since the
+		// epoch, or 0 for the messages that are not alerts of an event
+		uint64_t matched_ts = 0;
+
+		// for the alerts sampled for tracing, their trace and the span of
+		// the rule match
+		bool traced = false;
+		std::array<uint64_t, 2> trace_id{};
+		uint64_t match_span_id = 0;
+
+		// the bytes allocated for the buffers of the message, as of the
+		// last time it was recycled
+		size_t buffers_memory_bytes = 0;
+
+		// the bytes of the alert counted against the budget of the queues
+		// until the message is recycled
+		size_t queued_bytes = 0;
 	};
 
 #ifndef __EMSCRIPTEN__
-	typedef tbb::concurrent_bounded_queue<ctrl_msg> falco_outputs_cbq;
+	typedef tbb::concurrent_bounded_queue<ctrl_msg*> falco_outputs_cbq;
+#endif
+
+	// Each output consumes messages from its own queue in its own
+	// thread, so that a slow output can't delay the other ones. The
+	// messages are shared between the queues of all the outputs.
+	struct output_worker
+	{
+		std::unique_ptr<falco::outputs::abstract_output> output;
+#ifndef __EMSCRIPTEN__
+		falco_outputs_cbq queue;
+#endif
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+		std::unique_ptr<falco::outputs::spill_buffer> spill;
+#endif
+		std::atomic<uint64_t> num_drops = 0;
+		std::thread thread;
+		// the slot of the output in the watchdog of the outputs
+		size_t watchdog_slot = 0;
+
+		// the alerts delivered to the output, and the ones it didn't
+		// receive because of that
+		falco::outputs::route route;
+		bool routes_all = true;
+		std::atomic<uint64_t> num_unrouted = 0;
+
+		// when set, the alerts are projected into the message before
+		// being written by the output (see falco::outputs::project())
+		std::set<std::string> projection;
+		bool projected_json = false;
+		falco::outputs::message projected;
+
+		// how long alerts wait in the queue and take to be output, how
+		// long it took from their event until they were output, how
+		// many outputs failed, and the longest the queue has been
+		falco::outputs::latency_histogram queue_latency;
+		falco::outputs::latency_histogram output_latency;
+		falco::outputs::latency_histogram detection_latency;
+		std::atomic<uint64_t> num_errors = 0;
+		std::atomic<uint64_t> queue_depth_max = 0;
+
+		// when the output keeps a backlog of its own, the alerts it holds
+		// count against limits by priority derived from its capacity, as
+		// the ones of the queue are, and the alerts not queued because of
+		// them, which are dropped or spilled
+		size_t backlog_capacity = 0;
+		std::array<std::ptrdiff_t, falco_common::PRIORITY_DEBUG + 1> backlog_limits{};
+		std::atomic<uint64_t> num_backlog_shed = 0;
+
+		// the alerts delivered since the outputs started draining, only
+		// used by the thread of the output, and the ones that couldn't be
+		// delivered nor spilled in time
+		uint64_t num_drained = 0;
+		std::atomic<uint64_t> num_shutdown_lost = 0;
+
+		// the time spent waiting for room in the queue when lossless
+		std::atomic<uint64_t> backpressure_wait_ns = 0;
+
+		// whether more messages are waiting to be handled by the output
+		inline bool has_pending() const
+		{
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+			if(spill && spill->num_pending() > 0)
+			{
+				return true;
+			}
+#endif
+#ifndef __EMSCRIPTEN__
+			return !queue.empty();
+#else
+			return false;
+#endif
+		}
+	};
+
+	std::vector<std::unique_ptr<output_worker>> m_outputs;
+	// reports the outputs blocked for longer than the timeout, with a
+	// slot for each of them
+	watchdog<std::string> m_outputs_watchdog;
+
+#ifndef __EMSCRIPTEN__
 	falco_outputs_cbq m_queue;
+
+	// Alerts can only fill a queue up to the limit of their priority,
+	// and the capacity left is reserved for the more severe ones, so
+	// that overload sheds the least severe alerts first
+	std::array<std::ptrdiff_t, falco_common::PRIORITY_DEBUG + 1> m_queue_limits{};
+	inline bool admits(const falco_outputs_cbq& q, const ctrl_msg& cmsg) const;
+	inline bool admits(output_worker& o, const ctrl_msg& cmsg) const;
+
+	// The alerts queued, in the outputs queue or in the queue of any
+	// output, are also limited by their total bytes, with the same
+	// reserve by priority, when a budget is set
+	uint64_t m_max_bytes = 0;
+	std::array<std::ptrdiff_t, falco_common::PRIORITY_DEBUG + 1> m_bytes_limits{};
+	inline bool charge(ctrl_msg& cmsg, bool limited = true);
 #endif
 
+	// when set, alerts wait for room in the queues instead of being dropped
+	std::atomic<bool> m_lossless = false;
+	std::atomic<uint64_t> m_backpressure_wait_ns = 0;
+
+	std::atomic<uint64_t> m_queued_bytes = 0;
+	std::atomic<uint64_t> m_queued_bytes_max = 0;
+	falco::outputs::latency_histogram m_queue_latency;
+	std::atomic<uint64_t> m_queue_depth_max = 0;
+	// how long it took from the events until their alerts were queued
+	falco::outputs::latency_histogram m_event_latency;
+
+	// Messages are recycled once all the outputs are done with them, so
+	// that their buffers are reused and alerts don't allocate them anew
+	std::mutex m_pool_mtx;
+	std::vector<ctrl_msg*> m_pool;
+	std::vector<std::unique_ptr<ctrl_msg>> m_pool_storage;
+	std::atomic<uint64_t> m_pool_buffers_memory_bytes = 0;
+	ctrl_msg* acquire_msg();
+	void release_msg(ctrl_msg* cmsg);
+
 	std::atomic<uint64_t> m_outputs_queue_num_drops = 0;
+	std::array<std::atomic<uint64_t>, falco_common::PRIORITY_DEBUG + 1> m_outputs_queue_num_drops_by_priority{};
 	std::thread m_worker_thread;
-	inline void push(const ctrl_msg& cmsg);
+	inline void push(ctrl_msg* cmsg);
 	inline void push_ctrl(ctrl_msg_type cmt);
 	void worker() noexcept;
+	void output_worker_loop(output_worker* w) noexcept;
+	void dispatch(ctrl_msg* cmsg);
+	void drain_queues();
+	void spill_on_drain(ctrl_msg& cmsg, output_worker* w);
+
+	// Once the outputs are stopping, the queued alerts are delivered until
+	// the deadline, or until each output delivered the maximum allowed
+	std::atomic<bool> m_draining = false;
+	std::chrono::steady_clock::time_point m_drain_deadline;
+	inline bool drain_expired(output_worker* w) const;
 	void stop_worker();
 	void add_output(const falco::outputs::config& oc);
-	inline void process_msg(falco::outputs::abstract_output* o, const ctrl_msg& cmsg);
+	void format_deferred(ctrl_msg& cmsg) const;
+
+	// Similar alerts are grouped by the rule and the values of the
+	// configured key fields, which are looked up once per source
+	std::vector<std::string> m_aggregation_keys;
+	std::mutex m_aggregation_mtx;
+	std::unordered_map<std::string, std::string> m_aggregation_key_formats;
+	std::unique_ptr<falco::outputs::alert_aggregator> m_aggregator;
+	const std::string& aggregation_key_format(const std::string& source);
+	bool aggregation_key(std::string& key, sinsp_evt *evt, const falco_rule &rule);
+	void emit_summary(falco::outputs::alert_aggregator::group& g);
+	inline void process_msg(output_worker* w, const ctrl_msg& cmsg);
+	inline void matched(ctrl_msg* cmsg, sinsp_evt *evt);
+	inline void trace_match(ctrl_msg* cmsg, sinsp_evt *evt);
+	void trace_delivery(const ctrl_msg& cmsg, const std::string& output);
 };
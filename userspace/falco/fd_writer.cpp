@@ -0,0 +1,301 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "fd_writer.h"
+#include "falco_common.h"
+#include "outputs_encoding.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <zlib.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+static const auto s_stall_threshold = std::chrono::milliseconds(10);
+
+falco::outputs::fd_writer::fd_writer(size_t capacity)
+	: m_capacity(capacity)
+{
+	m_buf.reserve(m_capacity);
+}
+
+falco::outputs::fd_writer::~fd_writer()
+{
+	if(m_zs)
+	{
+		deflateEnd(m_zs.get());
+	}
+}
+
+void falco::outputs::fd_writer::set_capacity(size_t capacity)
+{
+	m_capacity = capacity;
+	m_buf.reserve(m_capacity);
+}
+
+bool falco::outputs::fd_writer::enable_gzip(int level)
+{
+	if(m_zs || level < 0 || level > 9)
+	{
+		return false;
+	}
+	auto zs = std::make_unique<z_stream>();
+	// 16 adds the gzip header and trailer to the deflate stream
+	if(deflateInit2(zs.get(), level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+	m_zs = std::move(zs);
+	return true;
+}
+
+void falco::outputs::fd_writer::write_line(const std::string& line)
+{
+	if(m_zs)
+	{
+		m_buf.append(line);
+		m_buf.push_back('\n');
+		if(m_buf.size() >= m_capacity)
+		{
+			deflate_buffer(Z_NO_FLUSH);
+		}
+		return;
+	}
+	if(m_buf.size() + line.size() < m_capacity)
+	{
+		m_buf.append(line);
+		m_buf.push_back('\n');
+		return;
+	}
+	write_all(nullptr, 0, &line, true);
+}
+
+void falco::outputs::fd_writer::write_delimited(const std::string& data)
+{
+	std::string prefix;
+	append_length_prefix(prefix, data.size());
+	if(m_zs)
+	{
+		m_buf.append(prefix);
+		m_buf.append(data);
+		if(m_buf.size() >= m_capacity)
+		{
+			deflate_buffer(Z_NO_FLUSH);
+		}
+		return;
+	}
+	if(m_buf.size() + prefix.size() + data.size() < m_capacity)
+	{
+		m_buf.append(prefix);
+		m_buf.append(data);
+		return;
+	}
+	write_all(prefix.data(), prefix.size(), &data, false);
+}
+
+void falco::outputs::fd_writer::flush()
+{
+	if(m_zs)
+	{
+		if(!m_buf.empty() || m_zpending)
+		{
+			deflate_buffer(Z_SYNC_FLUSH);
+		}
+		return;
+	}
+	if(!m_buf.empty())
+	{
+		write_all(nullptr, 0, nullptr, false);
+	}
+}
+
+void falco::outputs::fd_writer::finish()
+{
+	if(!m_zs)
+	{
+		flush();
+		return;
+	}
+	if(!m_buf.empty() || m_zstarted)
+	{
+		// the compressor starts a new member even when the write fails
+		try
+		{
+			deflate_buffer(Z_FINISH);
+		}
+		catch(...)
+		{
+			deflateReset(m_zs.get());
+			throw;
+		}
+		deflateReset(m_zs.get());
+	}
+}
+
+// Compresses the buffer, and writes the compressed data with the buffer
+// swapped with it, so that both keep their capacity
+void falco::outputs::fd_writer::deflate_buffer(int flush)
+{
+	m_bytes_uncompressed.fetch_add(m_buf.size(), std::memory_order_relaxed);
+	m_zs->next_in = (Bytef*) m_buf.data();
+	m_zs->avail_in = m_buf.size();
+	m_zbuf.clear();
+	do
+	{
+		size_t offset = m_zbuf.size();
+		size_t chunk = std::max<size_t>(deflateBound(m_zs.get(), m_zs->avail_in), 4096);
+		m_zbuf.resize(offset + chunk);
+		m_zs->next_out = (Bytef*) &m_zbuf[offset];
+		m_zs->avail_out = chunk;
+		deflate(m_zs.get(), flush);
+		m_zbuf.resize(offset + chunk - m_zs->avail_out);
+	}
+	while(m_zs->avail_out == 0);
+	m_buf.clear();
+	m_zstarted = flush != Z_FINISH;
+	m_zpending = flush == Z_NO_FLUSH;
+
+	if(m_zbuf.empty())
+	{
+		return;
+	}
+	m_buf.swap(m_zbuf);
+	try
+	{
+		write_all(nullptr, 0, nullptr, false);
+	}
+	catch(...)
+	{
+		m_buf.swap(m_zbuf);
+		throw;
+	}
+	m_buf.swap(m_zbuf);
+}
+
+void falco::outputs::fd_writer::write_all(const char* prefix, size_t prefix_len, const std::string* data, bool newline)
+{
+	static const char s_newline = '\n';
+
+	// the buffer is discarded even when the write fails, so that a
+	// broken file descriptor doesn't make it grow indefinitely
+	auto start = std::chrono::steady_clock::now();
+	int err = 0;
+#ifdef _WIN32
+	const char* parts[4] = {m_buf.data(), prefix, data ? data->data() : nullptr, &s_newline};
+	size_t lens[4] = {m_buf.size(), prefix_len, data ? data->size() : 0, newline ? 1u : 0u};
+	for(int i = 0; i < 4 && err == 0; i++)
+	{
+		while(lens[i] > 0)
+		{
+			int n = _write(m_fd, parts[i], (unsigned int) lens[i]);
+			m_writes.fetch_add(1, std::memory_order_relaxed);
+			if(n < 0)
+			{
+				err = errno;
+				break;
+			}
+			m_bytes_written.fetch_add(n, std::memory_order_relaxed);
+			parts[i] += n;
+			lens[i] -= n;
+		}
+	}
+#else
+	struct iovec iov[4] = {
+		{(void*) m_buf.data(), m_buf.size()},
+		{(void*) prefix, prefix_len},
+		{data ? (void*) data->data() : nullptr, data ? data->size() : 0},
+		{(void*) &s_newline, newline ? 1u : 0u},
+	};
+	struct iovec* cur = iov;
+	int left = 4;
+	while(left > 0)
+	{
+		if(cur->iov_len == 0)
+		{
+			cur++;
+			left--;
+			continue;
+		}
+
+		ssize_t n = writev(m_fd, cur, left);
+		m_writes.fetch_add(1, std::memory_order_relaxed);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				// the descriptor can be non-blocking, e.g. when it's
+				// inherited from a container runtime
+				struct pollfd pfd = {m_fd, POLLOUT, 0};
+				poll(&pfd, 1, -1);
+				continue;
+			}
+			err = errno;
+			break;
+		}
+
+		m_bytes_written.fetch_add(n, std::memory_order_relaxed);
+		size_t written = n;
+		while(left > 0 && written >= cur->iov_len)
+		{
+			written -= cur->iov_len;
+			cur++;
+			left--;
+		}
+		if(left > 0)
+		{
+			cur->iov_base = (char*) cur->iov_base + written;
+			cur->iov_len -= written;
+		}
+	}
+#endif
+	m_buf.clear();
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	if(elapsed >= s_stall_threshold)
+	{
+		m_write_stalls.fetch_add(1, std::memory_order_relaxed);
+		m_write_stall_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), std::memory_order_relaxed);
+	}
+
+	if(err != 0)
+	{
+		throw falco_exception(std::string("write failed: ") + std::strerror(err));
+	}
+}
+
+void falco::outputs::fd_writer::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["bytes_written"] = m_bytes_written.load(std::memory_order_relaxed);
+	metrics["writes"] = m_writes.load(std::memory_order_relaxed);
+	metrics["write_stalls"] = m_write_stalls.load(std::memory_order_relaxed);
+	metrics["write_stall_us"] = m_write_stall_us.load(std::memory_order_relaxed);
+	if(compressed())
+	{
+		metrics["bytes_uncompressed"] = m_bytes_uncompressed.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+struct z_stream_s;
+
+namespace falco
+{
+namespace outputs
+{
+
+/*!
+	\brief Writes lines, or length-delimited records, to a file descriptor,
+	bypassing stdio and iostream. They are collected in a buffer of the
+	given capacity and written when it's full or when flushed, and one that
+	doesn't fit is written along with the buffer in a single writev()
+	without being copied, which is also how they are written when the
+	capacity is 0. With gzip compression, the data is instead compressed
+	as a stream once the buffer is full, and what has been compressed so
+	far is written on flush. This class is not thread-safe, except for
+	reading the metrics.
+*/
+class fd_writer
+{
+public:
+	explicit fd_writer(size_t capacity = 0);
+	virtual ~fd_writer();
+
+	fd_writer(fd_writer&&) = delete;
+	fd_writer& operator = (fd_writer&&) = delete;
+	fd_writer(const fd_writer&) = delete;
+	fd_writer& operator = (const fd_writer&) = delete;
+
+	/*!
+		\brief Sets the file descriptor to write to, which is not owned. The
+		buffered data, if any, is written to the new one.
+	*/
+	inline void set_fd(int fd)
+	{
+		m_fd = fd;
+	}
+
+	inline int fd() const
+	{
+		return m_fd;
+	}
+
+	void set_capacity(size_t capacity);
+
+	/*!
+		\brief Compresses the data written from now on as gzip members with
+		the given zlib level, from 0 to 9. Each flush ends with a zlib
+		sync flush, so that the data written so far can be decompressed
+		while more is being appended, and finish() ends the member, which
+		is needed before switching to a new file descriptor. Returns false
+		if the compressor can't be initialized.
+	*/
+	bool enable_gzip(int level);
+
+	inline bool compressed() const
+	{
+		return m_zs != nullptr;
+	}
+
+	inline size_t buffered() const
+	{
+		return m_buf.size();
+	}
+
+	/*!
+		\brief Returns the bytes written to the file descriptors so far,
+		which are the compressed ones with gzip compression
+	*/
+	inline uint64_t bytes_written() const
+	{
+		return m_bytes_written.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Appends line and a newline
+		\throws falco_exception if writing fails, in which case the buffered
+		data is discarded
+	*/
+	void write_line(const std::string& line);
+
+	/*!
+		\brief Appends data prefixed by its length as a varint, which is
+		how protobuf messages are delimited in a stream
+		\throws falco_exception if writing fails, in which case the buffered
+		data is discarded
+	*/
+	void write_delimited(const std::string& data);
+
+	/*!
+		\brief Writes the buffered data, if any
+		\throws falco_exception if writing fails, in which case the buffered
+		data is discarded
+	*/
+	void flush();
+
+	/*!
+		\brief Writes the buffered data, if any, and ends the gzip member
+		being written, if any, so that the file is a complete gzip file.
+		The next data written starts a new member, and gzip files made of
+		several members decompress as their concatenation.
+		\throws falco_exception if writing fails, in which case the buffered
+		data is discarded
+	*/
+	void finish();
+
+	/*!
+		\brief Adds the metrics of the writes to the given map, which are
+		the bytes written, the number of write syscalls, and the number
+		and the total time of the writes that stalled for more than 10ms
+		(e.g. because of a full pipe or a slow disk), along with the bytes
+		given to the compressor with gzip compression. This can be invoked
+		from any thread.
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	void write_all(const char* prefix, size_t prefix_len, const std::string* data, bool newline);
+	void deflate_buffer(int flush);
+
+	int m_fd = -1;
+	size_t m_capacity;
+	std::string m_buf;
+
+	// with gzip compression, the output of the compressor and whether
+	// the current member has data not flushed yet or not finished yet
+	std::unique_ptr<z_stream_s> m_zs;
+	std::string m_zbuf;
+	bool m_zpending = false;
+	bool m_zstarted = false;
+	std::atomic<uint64_t> m_bytes_uncompressed = 0;
+
+	std::atomic<uint64_t> m_bytes_written = 0;
+	std::atomic<uint64_t> m_writes = 0;
+	std::atomic<uint64_t> m_write_stalls = 0;
+	std::atomic<uint64_t> m_write_stall_us = 0;
+};
+
+} // namespace outputs
+} // namespace falco
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "file_sha256sums.h"
+#include "falco_utils.h"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+namespace
+{
+
+struct cached_sum
+{
+	dev_t dev = 0;
+	ino_t ino = 0;
+	off_t size = 0;
+	struct timespec mtime = {};
+	falco::file_sha256sums::sum sum;
+};
+
+std::mutex s_mtx;
+std::unordered_map<std::string, cached_sum> s_cache;
+
+falco::file_sha256sums::sum ready(std::string value)
+{
+	std::promise<std::string> p;
+	p.set_value(std::move(value));
+	return p.get_future().share();
+}
+
+} // namespace
+
+falco::file_sha256sums::sum falco::file_sha256sums::of_file(const std::string& filename)
+{
+	struct stat st;
+	if(stat(filename.c_str(), &st) != 0)
+	{
+		return ready("");
+	}
+
+	std::lock_guard<std::mutex> lock(s_mtx);
+	auto& c = s_cache[filename];
+	if(c.sum.valid() && c.dev == st.st_dev && c.ino == st.st_ino && c.size == st.st_size
+		&& c.mtime.tv_sec == st.st_mtim.tv_sec && c.mtime.tv_nsec == st.st_mtim.tv_nsec)
+	{
+		return c.sum;
+	}
+	c.dev = st.st_dev;
+	c.ino = st.st_ino;
+	c.size = st.st_size;
+	c.mtime = st.st_mtim;
+	c.sum = std::async(std::launch::async, falco::utils::calculate_file_sha256sum, filename).share();
+	return c.sum;
+}
+
+falco::file_sha256sums::sum falco::file_sha256sums::of_contents(const std::string& contents)
+{
+	return ready(falco::utils::calculate_sha256sum(contents));
+}
+
+std::string falco::file_sha256sums::value(const sum& s)
+{
+	if(!s.valid() || s.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		return pending;
+	}
+	return s.get();
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <future>
+#include <string>
+
+namespace falco
+{
+
+/*!
+	\brief The SHA-256 sums of the loaded config and rules files, reported
+	in the metrics. Reading and hashing the files is kept off the startup:
+	the sums of the files are computed in background and cached along with
+	the identity, the size and the modification time of each file, so that
+	the files that did not change since a previous load, as on restarts, are
+	not hashed again. The files already read for loading them are hashed
+	from their contents instead. This is thread-safe.
+*/
+namespace file_sha256sums
+{
+
+typedef std::shared_future<std::string> sum;
+
+// the value of the sums still being computed
+constexpr const char* pending = "pending";
+
+/*!
+	\brief Returns the sum of a file, which is computed in background
+	unless the file did not change since its sum was last computed. The sum
+	of a file that can't be read is empty.
+*/
+sum of_file(const std::string& filename);
+
+/*!
+	\brief Returns the sum of the given contents of a file, computed at once
+*/
+sum of_contents(const std::string& contents);
+
+/*!
+	\brief Returns the value of a sum, or pending if it's still being
+	computed
+*/
+std::string value(const sum& s);
+
+} // namespace file_sha256sums
+} // namespace falco
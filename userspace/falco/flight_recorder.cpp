@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "flight_recorder.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+
+// The header of each event in the chunks and in the dumps, whose events
+// are aligned on 8 bytes
+struct record_header
+{
+	uint64_t ts;
+	uint32_t len;
+	uint16_t cpuid;
+	uint16_t reserved;
+};
+
+inline uint64_t record_size(uint32_t len)
+{
+	return (sizeof(record_header) + len + 7) & ~uint64_t(7);
+}
+
+// Calls the given function with the header and the data of each event in
+// a buffer
+template<typename F>
+void for_each_record(const uint8_t* buf, uint64_t size, F f)
+{
+	uint64_t off = 0;
+	while(off < size)
+	{
+		record_header h;
+		memcpy(&h, buf + off, sizeof(h));
+		f(h, buf + off + sizeof(h));
+		off += record_size(h.len);
+	}
+}
+
+} // namespace
+
+falco::flight_recorder::flight_recorder(const std::string& source, const config& c)
+	: m_source(source), m_config(c)
+{
+	// the chunks are small enough for the oldest events to be evicted
+	// a few at a time, and large enough for any event
+	m_chunk_size = std::clamp<uint64_t>(m_config.m_max_memory / 16, 64 * 1024, 1024 * 1024);
+	m_chunks.resize(std::max<uint64_t>(2, m_config.m_max_memory / m_chunk_size));
+	m_writer = std::thread(&flight_recorder::run, this);
+}
+
+falco::flight_recorder::~flight_recorder()
+{
+	// the events collected so far are still written
+	if(m_collecting)
+	{
+		complete();
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_cv.notify_one();
+	m_writer.join();
+}
+
+bool falco::flight_recorder::triggers(falco_common::priority_type priority, const std::set<std::string>& tags) const
+{
+	if(priority <= m_config.m_min_priority)
+	{
+		return true;
+	}
+	for(const auto& t : tags)
+	{
+		if(m_config.m_tags.count(t) > 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void falco::flight_recorder::record(uint64_t ts, uint16_t cpuid, const uint8_t* evt, uint32_t len)
+{
+	auto size = record_size(len);
+	if(size > m_chunk_size) [[unlikely]]
+	{
+		return;
+	}
+
+	auto* c = &m_chunks[m_current];
+	if(c->data == nullptr || c->used + size > m_chunk_size) [[unlikely]]
+	{
+		if(c->data != nullptr)
+		{
+			m_current = (m_current + 1) % m_chunks.size();
+			c = &m_chunks[m_current];
+		}
+		if(c->data == nullptr)
+		{
+			c->data.reset(new uint8_t[m_chunk_size]);
+			m_ring_bytes.store(m_ring_bytes.load(std::memory_order_relaxed) + m_chunk_size, std::memory_order_relaxed);
+		}
+		else
+		{
+			m_ring_events.store(m_ring_events.load(std::memory_order_relaxed) - c->num_events, std::memory_order_relaxed);
+		}
+		c->used = 0;
+		c->num_events = 0;
+	}
+
+	record_header h{ts, len, cpuid, 0};
+	memcpy(c->data.get() + c->used, &h, sizeof(h));
+	memcpy(c->data.get() + c->used + sizeof(h), evt, len);
+	c->used += size;
+	c->num_events++;
+	c->last_ts = ts;
+	m_ring_events.store(m_ring_events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	if(m_collecting) [[unlikely]]
+	{
+		if(ts > m_collecting->until)
+		{
+			complete();
+		}
+		else
+		{
+			append(*m_collecting, ts, cpuid, evt, len);
+		}
+	}
+}
+
+void falco::flight_recorder::flush(uint64_t now)
+{
+	if(m_collecting && now > m_collecting->until)
+	{
+		complete();
+	}
+}
+
+bool falco::flight_recorder::trigger(uint64_t ts, const std::string& rule, const open_func& open, std::string& err)
+{
+	if(m_collecting)
+	{
+		m_dumps_coalesced.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	if(m_pending_bytes.load(std::memory_order_relaxed) >= m_config.m_max_memory)
+	{
+		m_dumps_skipped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	auto d = std::make_unique<dump>();
+	d->path = m_config.m_path + "/falco_" + m_source + "_" + std::to_string(ts) + ".scap";
+	d->rule = rule;
+	d->until = ts + m_config.m_after_ms * 1000000;
+	try
+	{
+		d->out = open(d->path);
+	}
+	catch(const std::exception& e)
+	{
+		err = d->path + ": " + e.what();
+	}
+	if(d->out == nullptr)
+	{
+		if(err.empty())
+		{
+			err = d->path + ": cannot open the file";
+		}
+		m_dumps_failed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// the events of the window before, from the oldest chunk
+	uint64_t before_ns = m_config.m_before_ms * 1000000;
+	uint64_t from = ts > before_ns ? ts - before_ns : 0;
+	for(size_t i = 1; i <= m_chunks.size(); i++)
+	{
+		const auto& c = m_chunks[(m_current + i) % m_chunks.size()];
+		if(c.data == nullptr || c.num_events == 0 || c.last_ts < from)
+		{
+			continue;
+		}
+		for_each_record(c.data.get(), c.used, [&](const record_header& h, const uint8_t* evt)
+		{
+			if(h.ts >= from && h.ts <= ts)
+			{
+				append(*d, h.ts, h.cpuid, evt, h.len);
+			}
+		});
+	}
+
+	m_collecting = std::move(d);
+	if(m_config.m_after_ms == 0)
+	{
+		complete();
+	}
+	return true;
+}
+
+void falco::flight_recorder::append(dump& d, uint64_t ts, uint16_t cpuid, const uint8_t* evt, uint32_t len)
+{
+	auto size = record_size(len);
+	if(d.truncated || m_pending_bytes.load(std::memory_order_relaxed) + size > m_config.m_max_memory)
+	{
+		d.truncated = true;
+		return;
+	}
+	auto off = d.events.size();
+	d.events.resize(off + size);
+	record_header h{ts, len, cpuid, 0};
+	memcpy(d.events.data() + off, &h, sizeof(h));
+	memcpy(d.events.data() + off + sizeof(h), evt, len);
+	d.num_events++;
+	m_pending_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void falco::flight_recorder::complete()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_queue.push_back(std::move(m_collecting));
+	}
+	m_cv.notify_one();
+}
+
+void falco::flight_recorder::run()
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	std::unique_lock<std::mutex> lock(m_mtx);
+	while(true)
+	{
+		m_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+		if(m_queue.empty())
+		{
+			return;
+		}
+		auto d = std::move(m_queue.front());
+		m_queue.pop_front();
+		lock.unlock();
+		write(*d);
+		m_pending_bytes.fetch_sub(d->events.size(), std::memory_order_relaxed);
+		d.reset();
+		lock.lock();
+	}
+}
+
+void falco::flight_recorder::write(dump& d)
+{
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		for_each_record(d.events.data(), d.events.size(), [&](const record_header& h, const uint8_t* evt)
+		{
+			d.out->write(evt, h.len, h.cpuid);
+		});
+		// closes the file
+		d.out.reset();
+	}
+	catch(const std::exception& e)
+	{
+		m_dumps_failed.fetch_add(1, std::memory_order_relaxed);
+		FALCO_LOG(falco_logger::level::ERR, "Flight recorder could not write " + d.path + ": " + e.what() + "\n");
+		return;
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+	m_dumps.fetch_add(1, std::memory_order_relaxed);
+	m_written_events.fetch_add(d.num_events, std::memory_order_relaxed);
+	m_written_bytes.fetch_add(d.events.size(), std::memory_order_relaxed);
+	m_write_time_ns.fetch_add(elapsed.count(), std::memory_order_relaxed);
+	FALCO_LOG(falco_logger::level::INFO, "Flight recorder wrote " + std::to_string(d.num_events) + " events of source "
+		+ m_source + " to " + d.path + " for rule '" + d.rule + "'" + (d.truncated ? " (truncated to its memory)" : "") + "\n");
+}
+
+void falco::flight_recorder::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["flight_recorder.ring_bytes"] = m_ring_bytes.load(std::memory_order_relaxed);
+	metrics["flight_recorder.ring_events"] = m_ring_events.load(std::memory_order_relaxed);
+	metrics["flight_recorder.pending_bytes"] = m_pending_bytes.load(std::memory_order_relaxed);
+	metrics["flight_recorder.dumps"] = m_dumps.load(std::memory_order_relaxed);
+	metrics["flight_recorder.dumps_coalesced"] = m_dumps_coalesced.load(std::memory_order_relaxed);
+	metrics["flight_recorder.dumps_skipped"] = m_dumps_skipped.load(std::memory_order_relaxed);
+	metrics["flight_recorder.dumps_failed"] = m_dumps_failed.load(std::memory_order_relaxed);
+	metrics["flight_recorder.written_events"] = m_written_events.load(std::memory_order_relaxed);
+	metrics["flight_recorder.written_bytes"] = m_written_bytes.load(std::memory_order_relaxed);
+	metrics["flight_recorder.write_time_ns"] = m_write_time_ns.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "falco_common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief Keeps the most recent raw events of a source in a ring bounded in
+	memory and, when an alert triggers it, writes the events of the window
+	before the alert and of the window after it to a capture file. The
+	events are recorded and the dumps triggered by the thread of the
+	source, which only copies the events, while the files are written by a
+	thread of the recorder. The ring is made of fixed-size chunks allocated
+	on first use, and the oldest events are evicted a chunk at a time. A
+	single dump is collected at a time, and the alerts triggering while it
+	is are coalesced into it. The metrics can be read from any thread.
+*/
+class flight_recorder
+{
+public:
+	/*!
+		\brief Writes the events of a dump to its file, which is opened
+		by the thread of the source, and closed when destroyed
+	*/
+	class sink
+	{
+	public:
+		virtual ~sink() = default;
+		virtual void write(const uint8_t* evt, uint32_t len, uint16_t cpuid) = 0;
+	};
+
+	using open_func = std::function<std::unique_ptr<sink>(const std::string& path)>;
+
+	struct config
+	{
+		// the memory of the ring, which also bounds the memory of the
+		// dumps not written yet
+		uint64_t m_max_memory = 64 * 1024 * 1024;
+		uint64_t m_before_ms = 10000;
+		uint64_t m_after_ms = 5000;
+		// the alerts with at least this priority, or with any of the
+		// tags, trigger a dump
+		falco_common::priority_type m_min_priority = falco_common::PRIORITY_CRITICAL;
+		std::set<std::string> m_tags;
+		// the directory of the capture files
+		std::string m_path = "/var/lib/falco/flight_recorder";
+	};
+
+	flight_recorder(const std::string& source, const config& c);
+	~flight_recorder();
+
+	flight_recorder(const flight_recorder&) = delete;
+	flight_recorder& operator = (const flight_recorder&) = delete;
+
+	/*!
+		\brief Returns true if the alerts of a rule with the given
+		priority and tags trigger a dump
+	*/
+	bool triggers(falco_common::priority_type priority, const std::set<std::string>& tags) const;
+
+	/*!
+		\brief Copies an event in the ring, and in the dump being
+		collected if any. Events larger than a chunk are not recorded.
+	*/
+	void record(uint64_t ts, uint16_t cpuid, const uint8_t* evt, uint32_t len);
+
+	/*!
+		\brief Completes the dump being collected, if any, once the time
+		of the source, e.g. the current one while it's idle, is past its
+		window
+	*/
+	void flush(uint64_t now);
+
+	/*!
+		\brief Starts a dump of the events around the given time, opening
+		its file with the given function. Returns true if a dump started,
+		and false if the alert was coalesced into the dump being collected,
+		if the dumps not written yet already take all their memory, or
+		along with an error if the file could not be opened.
+	*/
+	bool trigger(uint64_t ts, const std::string& rule, const open_func& open, std::string& err);
+
+	/*!
+		\brief Adds to the given map the memory of the ring and of the
+		dumps not written yet, the events in the ring, the dumps written,
+		coalesced, skipped because of the memory or failed, and the events
+		and bytes written along with the time spent writing them, as
+		flight_recorder.*
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+	inline uint64_t chunk_size() const
+	{
+		return m_chunk_size;
+	}
+
+private:
+	struct chunk
+	{
+		std::unique_ptr<uint8_t[]> data;
+		uint64_t used = 0;
+		uint64_t num_events = 0;
+		uint64_t last_ts = 0;
+	};
+
+	struct dump
+	{
+		std::string path;
+		std::string rule;
+		std::unique_ptr<sink> out;
+		std::vector<uint8_t> events;
+		uint64_t num_events = 0;
+		uint64_t until = 0;
+		bool truncated = false;
+	};
+
+	void append(dump& d, uint64_t ts, uint16_t cpuid, const uint8_t* evt, uint32_t len);
+	void complete();
+	void run();
+	void write(dump& d);
+
+	std::string m_source;
+	config m_config;
+	uint64_t m_chunk_size;
+
+	// only used by the thread of the source
+	std::vector<chunk> m_chunks;
+	size_t m_current = 0;
+	std::unique_ptr<dump> m_collecting;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::deque<std::unique_ptr<dump>> m_queue;
+	bool m_stop = false;
+	std::thread m_writer;
+
+	std::atomic<uint64_t> m_ring_bytes{0};
+	std::atomic<uint64_t> m_ring_events{0};
+	std::atomic<uint64_t> m_pending_bytes{0};
+	std::atomic<uint64_t> m_dumps{0};
+	std::atomic<uint64_t> m_dumps_coalesced{0};
+	std::atomic<uint64_t> m_dumps_skipped{0};
+	std::atomic<uint64_t> m_dumps_failed{0};
+	std::atomic<uint64_t> m_written_events{0};
+	std::atomic<uint64_t> m_written_bytes{0};
+	std::atomic<uint64_t> m_write_time_ns{0};
+};
+
+} // namespace falco
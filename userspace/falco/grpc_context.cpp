@@ -47,7 +47,7 @@ falco::grpc::context::context(::grpc::ServerContext* ctx):
 	m_prefix = meta.str();
 }
 
-void falco::grpc::context::context::get_metadata(std::string key, std::string& val)
+void falco::grpc::context::context::get_metadata(std::string key, std::string& val) const
 {
 	const std::multimap<::grpc::string_ref, ::grpc::string_ref>& client_metadata = m_ctx->client_metadata();
 	auto it = client_metadata.find(key);
@@ -56,3 +56,8 @@ void falco::grpc::context::context::get_metadata(std::string key, std::string& v
 		val.assign(it->second.data(), it->second.size());
 	}
 }
+
+void falco::grpc::context::set_trailing_metadata(const std::string& key, const std::string& val) const
+{
+	m_ctx->AddTrailingMetadata(key, val);
+}
@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 
+#include <chrono>
 #include <string>
 
 #ifdef GRPC_INCLUDE_IS_GRPCPP
@@ -25,6 +26,8 @@ limitations under the License.
 #include <grpc++/grpc++.h>
 #endif
 
+#include "grpc_queue.h"
+
 namespace falco
 {
 namespace grpc
@@ -32,6 +35,8 @@ namespace grpc
 
 const std::string meta_session = "session_id";
 const std::string meta_request = "request_id";
+// trailing metadata set when a subscription missed some alerts
+const std::string meta_lossy = "lossy";
 
 class context
 {
@@ -39,7 +44,8 @@ public:
 	explicit context(::grpc::ServerContext* ctx);
 	virtual ~context() = default;
 
-	void get_metadata(std::string key, std::string& val);
+	void get_metadata(std::string key, std::string& val) const;
+	void set_trailing_metadata(const std::string& key, const std::string& val) const;
 
 private:
 	::grpc::ServerContext* m_ctx = nullptr;
@@ -63,6 +69,7 @@ public:
 	mutable void* m_stream = nullptr; // todo(fntlnz, leodido) > useful in the future
 	mutable bool m_has_more = false;
 	mutable bool m_is_running = true;
+	mutable cursor m_cursor;
 };
 
 class bidi_context : public stream_context
@@ -71,6 +78,10 @@ public:
 	explicit bidi_context(::grpc::ServerContext* ctx):
 		stream_context(ctx){};
 	virtual ~bidi_context() = default;
+
+	// set while a partial batch waits for more alerts until the deadline
+	mutable bool m_lingering = false;
+	mutable std::chrono::steady_clock::time_point m_linger_deadline;
 };
 
 } // namespace grpc
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "grpc_queue.h"
+
+#include <algorithm>
+
+// the positions of the sessions are evicted starting from the stalest
+// ones, so that clients setting random ids can't make them grow forever
+static const size_t s_max_sessions = 1024;
+
+static void update_max(std::atomic<uint64_t>& max, uint64_t val)
+{
+	uint64_t cur = max.load(std::memory_order_relaxed);
+	while(val > cur && !max.compare_exchange_weak(cur, val, std::memory_order_relaxed))
+	{
+	}
+}
+
+bool falco::grpc::queue::parse_overflow_policy(const std::string& v, overflow_policy& out)
+{
+	if(v == "drop_oldest")
+	{
+		out = overflow_policy::DROP_OLDEST;
+		return true;
+	}
+	if(v == "drop_newest")
+	{
+		out = overflow_policy::DROP_NEWEST;
+		return true;
+	}
+	return false;
+}
+
+template<typename T, typename V>
+static bool contains(const T& values, const V& v)
+{
+	return std::find(values.begin(), values.end(), v) != values.end();
+}
+
+bool falco::grpc::matches(const outputs::filter& f, const outputs::response& res)
+{
+	// a lower value is a more severe priority
+	if(f.has_priority() && res.priority() > f.priority())
+	{
+		return false;
+	}
+	if(!f.sources().empty() && !contains(f.sources(), res.source()))
+	{
+		return false;
+	}
+	if(!f.rules().empty() && !contains(f.rules(), res.rule()))
+	{
+		return false;
+	}
+	if(!f.tags().empty())
+	{
+		bool found = false;
+		for(const auto& tag : res.tags())
+		{
+			if(contains(f.tags(), tag))
+			{
+				found = true;
+				break;
+			}
+		}
+		if(!found)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+falco::grpc::queue::queue(size_t capacity, overflow_policy policy)
+	: m_policy(policy)
+{
+	m_ring.resize(std::max<size_t>(capacity, 1));
+}
+
+void falco::grpc::queue::set_capacity(size_t capacity)
+{
+	capacity = std::max<size_t>(capacity, 1);
+	std::unique_lock<std::shared_mutex> lk(m_mtx);
+	if(capacity == m_ring.size())
+	{
+		return;
+	}
+	m_ring.clear();
+	m_ring.resize(capacity);
+	m_ring_bytes = 0;
+	m_head = m_tail;
+}
+
+void falco::grpc::queue::set_overflow_policy(overflow_policy policy)
+{
+	std::unique_lock<std::shared_mutex> lk(m_mtx);
+	m_policy = policy;
+}
+
+size_t falco::grpc::queue::capacity() const
+{
+	std::shared_lock<std::shared_mutex> lk(m_mtx);
+	return m_ring.size();
+}
+
+uint64_t falco::grpc::queue::unread() const
+{
+	bool subscribed = false;
+	uint64_t low = UINT64_MAX;
+	for(const auto& s : m_subscribers)
+	{
+		if(auto pos = s.pos.lock())
+		{
+			subscribed = true;
+			low = std::min(low, pos->load(std::memory_order_relaxed));
+		}
+	}
+	if(!subscribed)
+	{
+		low = m_horizon.load(std::memory_order_relaxed);
+	}
+	return std::max(low, oldest());
+}
+
+uint64_t falco::grpc::queue::max_lag() const
+{
+	std::shared_lock<std::shared_mutex> lk(m_mtx);
+	uint64_t lag = 0;
+	uint64_t first = oldest();
+	for(const auto& s : m_subscribers)
+	{
+		if(auto pos = s.pos.lock())
+		{
+			lag = std::max(lag, m_tail - std::max(pos->load(std::memory_order_relaxed), first));
+		}
+	}
+	return lag;
+}
+
+void falco::grpc::queue::push(const outputs::response& res)
+{
+	std::unique_lock<std::shared_mutex> lk(m_mtx);
+	if(m_tail - unread() >= m_ring.size())
+	{
+		m_num_drops.fetch_add(1, std::memory_order_relaxed);
+		if(m_policy == overflow_policy::DROP_NEWEST)
+		{
+			return;
+		}
+	}
+	auto& slot = m_ring[m_tail % m_ring.size()];
+	m_ring_bytes -= slot.ByteSizeLong();
+	slot = res;
+	m_ring_bytes += slot.ByteSizeLong();
+	m_tail++;
+	lk.unlock();
+
+	notify_all();
+}
+
+bool falco::grpc::queue::wait(const cursor& c, waiter* w)
+{
+	// the waiters lock is taken first, so that an alert pushed after the
+	// check below notifies w
+	std::lock_guard<std::mutex> wlk(m_waiters_mtx);
+	{
+		std::shared_lock<std::shared_mutex> lk(m_mtx);
+		if(c.next < m_tail)
+		{
+			return false;
+		}
+	}
+	m_waiters.push_back(w);
+	return true;
+}
+
+void falco::grpc::queue::cancel_wait(waiter* w)
+{
+	std::lock_guard<std::mutex> lk(m_waiters_mtx);
+	m_waiters.erase(std::remove(m_waiters.begin(), m_waiters.end(), w), m_waiters.end());
+}
+
+void falco::grpc::queue::notify_all()
+{
+	std::lock_guard<std::mutex> lk(m_waiters_mtx);
+	for(auto w : m_waiters)
+	{
+		w->notify();
+	}
+	m_waiters.clear();
+}
+
+void falco::grpc::queue::subscribe(cursor& c, const std::string& session)
+{
+	c = cursor();
+	c.subscribed = true;
+	c.session = session;
+
+	bool resumed = false;
+	if(!session.empty())
+	{
+		std::lock_guard<std::mutex> lk(m_sessions_mtx);
+		auto it = m_sessions.find(session);
+		if(it != m_sessions.end())
+		{
+			// the alerts pushed out of the ring in the meantime are
+			// accounted as lost by the next try_pop()
+			c.next = it->second;
+			resumed = true;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> lk(m_mtx);
+	if(!resumed)
+	{
+		c.next = std::max(m_horizon.load(std::memory_order_relaxed), oldest());
+	}
+	c.pos = std::make_shared<std::atomic<uint64_t>>(c.next);
+	c.client = session.empty() ? std::to_string(++m_num_subscriptions) : session;
+
+	// the cursors can be destroyed without unsubscribing, e.g. when the
+	// server stops, so the expired ones are removed here
+	m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+		[](const auto& s) { return s.pos.expired(); }), m_subscribers.end());
+	m_subscribers.push_back({c.pos, c.client});
+}
+
+void falco::grpc::queue::unsubscribe(cursor& c)
+{
+	if(!c.subscribed)
+	{
+		return;
+	}
+	c.subscribed = false;
+	c.pos.reset();
+
+	if(c.session.empty())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lk(m_sessions_mtx);
+	m_sessions[c.session] = c.next;
+	if(m_sessions.size() > s_max_sessions)
+	{
+		auto stalest = std::min_element(m_sessions.begin(), m_sessions.end(),
+			[](const auto& a, const auto& b) { return a.second < b.second; });
+		m_sessions.erase(stalest);
+	}
+}
+
+bool falco::grpc::queue::try_pop(cursor& c, outputs::response& res, const outputs::filter* f)
+{
+	if(!c.subscribed)
+	{
+		subscribe(c);
+	}
+
+	std::shared_lock<std::shared_mutex> lk(m_mtx);
+	uint64_t first = oldest();
+	if(c.next < first)
+	{
+		if(!c.lossy)
+		{
+			c.lossy = true;
+			m_num_lossy.fetch_add(1, std::memory_order_relaxed);
+		}
+		c.lost += first - c.next;
+		m_num_lost.fetch_add(first - c.next, std::memory_order_relaxed);
+		c.next = first;
+	}
+
+	while(c.next < m_tail)
+	{
+		const auto& cur = m_ring[c.next % m_ring.size()];
+		c.next++;
+		if(f == nullptr || matches(*f, cur))
+		{
+			res = cur;
+			c.pos->store(c.next, std::memory_order_relaxed);
+			update_max(m_horizon, c.next);
+			return true;
+		}
+	}
+
+	c.pos->store(c.next, std::memory_order_relaxed);
+	update_max(m_horizon, c.next);
+	return false;
+}
+
+void falco::grpc::queue::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	{
+		std::shared_lock<std::shared_mutex> lk(m_mtx);
+		metrics["queue_depth"] = m_tail - unread();
+		metrics["queue_capacity"] = m_ring.size();
+		metrics["queue_memory_bytes"] = m_ring.capacity() * sizeof(outputs::response) + m_ring_bytes;
+
+		uint64_t first = oldest();
+		uint64_t subscribers = 0;
+		uint64_t lag_max = 0;
+		for(const auto& s : m_subscribers)
+		{
+			if(auto pos = s.pos.lock())
+			{
+				// the streams of a session share the entry of the slowest
+				uint64_t lag = m_tail - std::max(pos->load(std::memory_order_relaxed), first);
+				auto& client_lag = metrics["subscriber_lag." + s.client];
+				client_lag = std::max(client_lag, lag);
+				lag_max = std::max(lag_max, lag);
+				subscribers++;
+			}
+		}
+		metrics["subscribers"] = subscribers;
+		metrics["subscriber_lag_max"] = lag_max;
+	}
+	metrics["queue_drops"] = m_num_drops.load(std::memory_order_relaxed);
+	metrics["subscriptions_lossy"] = m_num_lossy.load(std::memory_order_relaxed);
+	metrics["alerts_lost"] = m_num_lost.load(std::memory_order_relaxed);
+}
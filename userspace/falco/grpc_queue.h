@@ -18,39 +18,207 @@ limitations under the License.
 #pragma once
 
 #include "outputs.pb.h"
-#include "tbb/concurrent_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
 
 namespace falco
 {
 namespace grpc
 {
-typedef tbb::concurrent_queue<outputs::response> response_cq;
 
+/*!
+	\brief Returns true if the given alert matches the subscription filter
+*/
+bool matches(const outputs::filter& f, const outputs::response& res);
+
+/*!
+	\brief The read position of a subscription in the queue, which is owned
+	by the context of its stream and isn't thread-safe
+*/
+struct cursor
+{
+	bool subscribed = false;
+	// set once the subscription fell behind by more than the capacity
+	// of the queue and missed some alerts
+	bool lossy = false;
+	uint64_t next = 0;
+	uint64_t lost = 0;
+	std::string session;
+	// the name of the subscriber in the metrics, which is its session
+	// id, if any, or a sequence number
+	std::string client;
+	// the position shared with the queue while subscribed, to know
+	// which alerts weren't read yet
+	std::shared_ptr<std::atomic<uint64_t>> pos;
+};
+
+/*!
+	\brief Something waiting for new alerts in the queue, e.g. the context
+	of a stream with nothing else to send
+*/
+class waiter
+{
+public:
+	virtual ~waiter() = default;
+
+	/*!
+		\brief Invoked once, by the thread pushing an alert (or stopping
+		the server), after the waiter was registered with wait(). This
+		must not block nor call back into the queue.
+	*/
+	virtual void notify() = 0;
+};
+
+/*!
+	\brief The alerts of the gRPC output, kept in a ring buffer shared by
+	all the subscriptions. Each one reads them in order at its own cursor,
+	so that every subscriber receives all the alerts, unless it falls
+	behind by more than the capacity of the ring: in that case, its cursor
+	jumps to the oldest alert still retained and the subscription is
+	marked as lossy. Alternatively, with the drop newest policy, the
+	alerts pushed while the slowest subscription (or the next one, when
+	none is connected) is a whole ring behind are dropped instead.
+
+	A new subscription starts from the furthest alert read by any other,
+	so that a single client polling with get() resumes where it left off
+	and the first one receives the alerts retained before it connected.
+	The clients setting a session id keep their position across calls.
+*/
 class queue
 {
 public:
+	enum class overflow_policy
+	{
+		DROP_OLDEST,
+		DROP_NEWEST
+	};
+
+	static bool parse_overflow_policy(const std::string& v, overflow_policy& out);
+
+	explicit queue(size_t capacity = 10000, overflow_policy policy = overflow_policy::DROP_OLDEST);
+
 	static queue& get()
 	{
 		static queue instance;
 		return instance;
 	}
 
-	bool try_pop(outputs::response& res)
-	{
-		return m_queue.try_pop(res);
-	}
+	/*!
+		\brief Sets the number of alerts retained, which is the maximum
+		lag of a subscription before it loses some of them. The retained
+		alerts are discarded if it changes.
+	*/
+	void set_capacity(size_t capacity);
 
-	void push(outputs::response& res)
-	{
-		m_queue.push(res);
-	}
+	void set_overflow_policy(overflow_policy policy);
+
+	size_t capacity() const;
+
+	/*!
+		\brief Returns the number of alerts not read yet by the slowest
+		subscription, which is 0 when none is connected
+	*/
+	uint64_t max_lag() const;
+
+	void push(const outputs::response& res);
+
+	/*!
+		\brief Starts reading at the position of the given session if
+		known, or from the furthest alert read by any subscription
+	*/
+	void subscribe(cursor& c, const std::string& session = "");
+
+	/*!
+		\brief Stops reading, remembering the position of the session of
+		the cursor, if any
+	*/
+	void unsubscribe(cursor& c);
+
+	/*!
+		\brief Copies to res the next alert of the cursor (subscribing
+		it if needed) and returns true, or returns false if there's none.
+		With a filter, the alerts not matching it are skipped without
+		being copied.
+	*/
+	bool try_pop(cursor& c, outputs::response& res, const outputs::filter* f = nullptr);
+
+	/*!
+		\brief Registers w to be notified when the next alert is pushed,
+		unless the cursor has alerts to read already, in which case it
+		returns false
+	*/
+	bool wait(const cursor& c, waiter* w);
+
+	/*!
+		\brief Unregisters w, which is not notified once this returns
+	*/
+	void cancel_wait(waiter* w);
+
+	/*!
+		\brief Notifies all the registered waiters, e.g. when stopping
+	*/
+	void notify_all();
+
+	/*!
+		\brief Adds to the given map the number of alerts retained and not
+		read yet by all the subscriptions, the capacity, the number of
+		alerts dropped or overwritten before being read, the number of
+		subscriptions that were marked as lossy and the number of alerts
+		they lost, along with the number of subscriptions and their lag,
+		as the maximum and by client (e.g. "subscriber_lag.<client>"),
+		and an estimate of the memory held by the retained alerts
+		("queue_memory_bytes")
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
 
 private:
-	queue()
+	inline uint64_t oldest() const
 	{
+		uint64_t first = m_tail > m_ring.size() ? m_tail - m_ring.size() : 0;
+		return first > m_head ? first : m_head;
 	}
 
-	response_cq m_queue;
+	// the position of the oldest alert not read by all the subscriptions
+	uint64_t unread() const;
+
+	// the ring is written by push() under an exclusive lock and read by
+	// the subscriptions under a shared one
+	mutable std::shared_mutex m_mtx;
+	std::vector<outputs::response> m_ring;
+	uint64_t m_head = 0;
+	uint64_t m_tail = 0;
+	// the encoded sizes of the retained alerts, which approximate the
+	// memory held by their fields beyond the ring itself
+	uint64_t m_ring_bytes = 0;
+	std::atomic<uint64_t> m_horizon{0};
+	overflow_policy m_policy;
+
+	struct subscriber
+	{
+		std::weak_ptr<std::atomic<uint64_t>> pos;
+		std::string client;
+	};
+	std::vector<subscriber> m_subscribers;
+	uint64_t m_num_subscriptions = 0;
+
+	// the waiters are notified while holding its mutex, so that
+	// cancel_wait() can guarantee that they aren't anymore
+	std::mutex m_waiters_mtx;
+	std::vector<waiter*> m_waiters;
+
+	std::mutex m_sessions_mtx;
+	std::map<std::string, uint64_t> m_sessions;
+
+	std::atomic<uint64_t> m_num_drops{0};
+	std::atomic<uint64_t> m_num_lossy{0};
+	std::atomic<uint64_t> m_num_lost{0};
 
 	// We can use the better technique of deleting the methods we don't want.
 public:
@@ -33,7 +33,7 @@ void request_stream_context<outputs::service, outputs::request, outputs::respons
 	m_res_writer = std::make_unique<::grpc::ServerAsyncWriter<outputs::response>>(srvctx);
 	m_stream_ctx.reset();
 	m_req.Clear();
-	auto cq = srv->m_completion_queue.get();
+	auto cq = m_cq;
 	// todo(leodido) > log "calling m_request_func: tag=this, state=m_state"
 	(srv->m_output_svc.*m_request_func)(srvctx, &m_req, m_res_writer.get(), cq, cq, this);
 }
@@ -104,25 +104,41 @@ void request_stream_context<outputs::service, outputs::request, outputs::respons
 	start(srv);
 }
 
+// Returns the asynchronous service serving the unary RPCs of Service
+template<class Service>
+static typename Service::AsyncService& async_service(server* srv);
+
+template<>
+version::service::AsyncService& async_service<version::service>(server* srv)
+{
+	return srv->m_version_svc;
+}
+
 template<>
-void request_context<version::service, version::request, version::response>::start(server* srv)
+rules::service::AsyncService& async_service<rules::service>(server* srv)
+{
+	return srv->m_rules_svc;
+}
+
+template<class Service, class Request, class Response>
+void request_context<Service, Request, Response>::start(server* srv)
 {
 	m_state = request_context_base::REQUEST;
 	m_srv_ctx = std::make_unique<::grpc::ServerContext>();
 	auto srvctx = m_srv_ctx.get();
-	m_res_writer = std::make_unique<::grpc::ServerAsyncResponseWriter<version::response>>(srvctx);
+	m_res_writer = std::make_unique<::grpc::ServerAsyncResponseWriter<Response>>(srvctx);
 	m_req.Clear();
-	auto cq = srv->m_completion_queue.get();
+	auto cq = m_cq;
 	// Request to start processing given requests.
 	// Using "this" - ie., the memory address of this context - as the tag that uniquely identifies the request.
 	// In this way, different contexts can serve different requests concurrently.
-	(srv->m_version_svc.*m_request_func)(srvctx, &m_req, m_res_writer.get(), cq, cq, this);
+	(async_service<Service>(srv).*m_request_func)(srvctx, &m_req, m_res_writer.get(), cq, cq, this);
 }
 
-template<>
-void request_context<version::service, version::request, version::response>::process(server* srv)
+template<class Service, class Request, class Response>
+void request_context<Service, Request, Response>::process(server* srv)
 {
-	version::response res;
+	Response res;
 	(srv->*m_process_func)(context(m_srv_ctx.get()), m_req, res);
 
 	// Notify the gRPC runtime that this processing is done
@@ -131,8 +147,8 @@ void request_context<version::service, version::request, version::response>::pro
 	m_res_writer->Finish(res, ::grpc::Status::OK, this);
 }
 
-template<>
-void request_context<version::service, version::request, version::response>::end(server* srv, bool error)
+template<class Service, class Request, class Response>
+void request_context<Service, Request, Response>::end(server* srv, bool error)
 {
 	// todo(leodido) > handle processing errors here
 
@@ -140,77 +156,204 @@ void request_context<version::service, version::request, version::response>::end
 	start(srv);
 }
 
-template<>
-void request_bidi_context<outputs::service, outputs::request, outputs::response>::start(server* srv)
+template class request_context<version::service, version::request, version::response>;
+template class request_context<rules::service, rules::enable_request, rules::enable_response>;
+template class request_context<rules::service, rules::stats_request, rules::stats_response>;
+
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::start(server* srv)
 {
 	m_state = request_context_base::REQUEST;
 	m_srv_ctx = std::make_unique<::grpc::ServerContext>();
 	auto srvctx = m_srv_ctx.get();
-	m_reader_writer = std::make_unique<::grpc::ServerAsyncReaderWriter<outputs::response, outputs::request>>(srvctx);
+	m_reader_writer = std::make_unique<::grpc::ServerAsyncReaderWriter<Response, Request>>(srvctx);
+	m_bidi_ctx.reset();
 	m_req.Clear();
-	auto cq = srv->m_completion_queue.get();
+	m_next_req.Clear();
+	m_res.Clear();
+	m_reading = false;
+	m_read_done = false;
+	m_waiting = false;
+	m_busy = false;
+	m_ended = false;
+	auto cq = m_cq;
 	// Request to start processing given requests.
 	// Using "this" - ie., the memory address of this context - as the tag that uniquely identifies the request.
 	// In this way, different contexts can serve different requests concurrently.
 	(srv->m_output_svc.*m_request_func)(srvctx, m_reader_writer.get(), cq, cq, this);
-};
+}
 
-template<>
-void request_bidi_context<outputs::service, outputs::request, outputs::response>::process(server* srv)
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::process(server* srv)
 {
+	std::lock_guard<std::mutex> lk(m_mtx);
 	switch(m_state)
 	{
 	case request_context_base::REQUEST:
 		m_bidi_ctx = std::make_unique<bidi_context>(m_srv_ctx.get());
 		m_bidi_ctx->m_status = bidi_context::STREAMING;
 		m_state = request_context_base::WRITE;
-		m_reader_writer->Read(&m_req, this);
+		// Streaming starts once the first request is read
+		m_reading = true;
+		m_reader_writer->Read(&m_next_req, &m_reader);
 		return;
 	case request_context_base::WRITE:
-		// Processing
-		{
-			outputs::response res;
-			(srv->*m_process_func)(*m_bidi_ctx, m_req, res); // sub()
-
-			if(!m_bidi_ctx->m_is_running)
-			{
-				m_state = request_context_base::FINISH;
-				m_reader_writer->Finish(::grpc::Status::OK, this);
-				return;
-			}
-
-			if(m_bidi_ctx->m_has_more)
-			{
-				m_state = request_context_base::WRITE;
-				m_reader_writer->Write(res, this);
-				return;
-			}
-
-			m_state = request_context_base::WRITE;
-			m_reader_writer->Read(&m_req, this);
-		}
-
+		// Completion of Write() or of the alarm
+		wake(srv);
 		return;
 	default:
 		return;
 	}
-};
+}
 
-template<>
-void request_bidi_context<outputs::service, outputs::request, outputs::response>::end(server* srv, bool error)
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::end(server* srv, bool error)
 {
-	if(m_bidi_ctx)
+	std::lock_guard<std::mutex> lk(m_mtx);
+
+	// Cancelling the alarm completes it with an error, which is how the
+	// stream is woken up
+	if(m_state == request_context_base::WRITE && m_waiting)
+	{
+		wake(srv);
+		return;
+	}
+
+	if(!m_ended)
 	{
-		m_bidi_ctx->m_status = error ? bidi_context::ERROR : bidi_context::SUCCESS;
+		m_ended = true;
+		m_busy = false;
+		if(m_bidi_ctx)
+		{
+			m_bidi_ctx->m_status = error ? bidi_context::ERROR : bidi_context::SUCCESS;
 
-		// Complete the processing
-		outputs::response res;
-		(srv->*m_process_func)(*m_bidi_ctx, m_req, res); // sub()
+			// Complete the processing
+			(srv->*m_process_func)(*m_bidi_ctx, m_req, m_res);
+		}
+	}
+
+	// The context can't be reused until the pending read completes, which
+	// is then done by read_done()
+	if(m_reading)
+	{
+		m_srv_ctx->TryCancel();
+		return;
 	}
 
 	// Ask to start processing requests
 	start(srv);
-};
+}
+
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::notify()
+{
+	m_alarm.Cancel();
+}
+
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::read_done(server* srv, bool ok)
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	m_reading = false;
+
+	if(m_ended)
+	{
+		start(srv);
+		return;
+	}
+
+	if(ok && m_state != request_context_base::FINISH)
+	{
+		// Each request replaces the previous one, e.g. with a new filter
+		m_req.Swap(&m_next_req);
+		m_reading = true;
+		m_reader_writer->Read(&m_next_req, &m_reader);
+	}
+	else if(!ok)
+	{
+		// The client is done writing, or the stream is broken
+		m_read_done = true;
+	}
+
+	if(m_waiting)
+	{
+		m_alarm.Cancel();
+	}
+	else if(!m_busy)
+	{
+		stream(srv);
+	}
+}
+
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::wake(server* srv)
+{
+	if(m_waiting)
+	{
+		// Once this returns, the queue won't cancel the alarm anymore
+		queue::get().cancel_wait(this);
+		m_waiting = false;
+	}
+	m_busy = false;
+	stream(srv);
+}
+
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::stream(server* srv)
+{
+	if(m_read_done)
+	{
+		finish();
+		return;
+	}
+
+	// Processing
+	(srv->*m_process_func)(*m_bidi_ctx, m_req, m_res); // sub() or sub_batch()
+
+	if(!m_bidi_ctx->m_is_running)
+	{
+		finish();
+		return;
+	}
+
+	m_busy = true;
+	if(m_bidi_ctx->m_has_more)
+	{
+		// The response is serialized by Write(), so it can be reused
+		m_reader_writer->Write(m_res, this);
+		m_res.Clear();
+		return;
+	}
+
+	// Wait for new alerts, or for a partial batch to linger
+	m_waiting = true;
+	if(m_bidi_ctx->m_lingering)
+	{
+		auto wait = m_bidi_ctx->m_linger_deadline - std::chrono::steady_clock::now();
+		m_alarm.Set(m_cq, std::chrono::system_clock::now() + wait, this);
+	}
+	else
+	{
+		// The periodic wake up is a safety net for the notifications
+		// racing with the server stopping, which is otherwise immediate
+		m_alarm.Set(m_cq, std::chrono::system_clock::now() + std::chrono::seconds(1), this);
+	}
+	if(!queue::get().wait(m_bidi_ctx->m_cursor, this))
+	{
+		m_alarm.Cancel();
+	}
+}
+
+template<class Service, class Request, class Response>
+void request_bidi_context<Service, Request, Response>::finish()
+{
+	m_state = request_context_base::FINISH;
+	m_busy = true;
+	m_reader_writer->Finish(::grpc::Status::OK, this);
+}
+
+template class request_bidi_context<outputs::service, outputs::request, outputs::response>;
+template class request_bidi_context<outputs::service, outputs::request, outputs::batch>;
 
 } // namespace grpc
 } // namespace falco
@@ -21,6 +21,14 @@ limitations under the License.
 
 #include "grpc_server.h"
 
+#ifdef GRPC_INCLUDE_IS_GRPCPP
+#include <grpcpp/alarm.h>
+#else
+#include <grpc++/alarm.h>
+#endif
+
+#include <mutex>
+
 namespace falco
 {
 namespace grpc
@@ -34,6 +42,8 @@ public:
 	virtual ~request_context_base() = default;
 
 	std::unique_ptr<::grpc::ServerContext> m_srv_ctx;
+	// the completion queue, and thus the thread, serving the context
+	::grpc::ServerCompletionQueue* m_cq = nullptr;
 	enum : char
 	{
 		UNKNOWN = 0,
@@ -100,13 +110,22 @@ private:
 	Request m_req;
 };
 
+// The responsibility of `request_bidi_context` template class is to handle
+// bidirectional streams, whose requests are read while the responses are
+// written. When there's nothing else to write, it waits on an alarm that is
+// cancelled by the queue when new alerts are pushed, or by a new request,
+// without keeping the completion queue busy. The responses can also be
+// batches, which are filled across the calls of the processing function
+// and written once it says so, or after waiting on the alarm for it to
+// linger.
 template<class Service, class Request, class Response>
-class request_bidi_context : public request_context_base
+class request_bidi_context : public request_context_base, public waiter
 {
 public:
 	request_bidi_context():
 		m_process_func(nullptr),
-		m_request_func(nullptr){};
+		m_request_func(nullptr),
+		m_reader(this){};
 	~request_bidi_context() = default;
 
 	// Pointer to function that does actual processing
@@ -118,11 +137,47 @@ public:
 	void start(server* srv) override;
 	void process(server* srv) override;
 	void end(server* srv, bool error) override;
+	void notify() override;
 
 private:
+	// The tag of the reads, which complete independently of the writes
+	class reader : public request_context_base
+	{
+	public:
+		explicit reader(request_bidi_context* ctx):
+			m_ctx(ctx)
+		{
+			m_state = request_context_base::WRITE;
+		}
+
+		void start(server* srv) override {}
+		void process(server* srv) override { m_ctx->read_done(srv, true); }
+		void end(server* srv, bool error) override { m_ctx->read_done(srv, false); }
+
+	private:
+		request_bidi_context* m_ctx;
+	};
+
+	void read_done(server* srv, bool ok);
+	// These are invoked holding m_mtx, when no write, alarm or finish is
+	// pending
+	void wake(server* srv);
+	void stream(server* srv);
+	void finish();
+
+	std::mutex m_mtx;
 	std::unique_ptr<::grpc::ServerAsyncReaderWriter<Response, Request>> m_reader_writer;
 	std::unique_ptr<bidi_context> m_bidi_ctx;
+	reader m_reader;
+	::grpc::Alarm m_alarm;
 	Request m_req;
+	Request m_next_req;
+	Response m_res;
+	bool m_reading = false; // a read is pending
+	bool m_read_done = false; // the client is done writing
+	bool m_waiting = false; // the alarm is pending
+	bool m_busy = false; // a write, the alarm or the finish is pending
+	bool m_ended = false; // the stream ended, the read may be pending still
 };
 
 } // namespace grpc
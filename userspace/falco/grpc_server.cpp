@@ -25,36 +25,47 @@ limitations under the License.
 #include "falco_engine.h"
 #include "falco_engine_version.h"
 #include "logger.h"
+#include "thread_affinity.h"
 #include "grpc_server.h"
 #include "grpc_queue.h"
 #include "grpc_request_context.h"
 #include "falco_utils.h"
 
-#define REGISTER_STREAM(req, res, svc, rpc, impl, num)                          \
-	std::vector<request_stream_context<svc, req, res>> rpc##_contexts(num); \
-	for(request_stream_context<svc, req, res> & c : rpc##_contexts)         \
-	{                                                                       \
-		c.m_process_func = &server::impl;                               \
-		c.m_request_func = &svc::AsyncService::Request##rpc;            \
-		c.start(this);                                                  \
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#define REGISTER_STREAM(req, res, svc, rpc, impl, num)                                                       \
+	std::vector<request_stream_context<svc, req, res>> rpc##_contexts(num * m_completion_queues.size()); \
+	for(size_t i = 0; i < rpc##_contexts.size(); i++)                                                    \
+	{                                                                                                    \
+		request_stream_context<svc, req, res>& c = rpc##_contexts[i];                                \
+		c.m_cq = m_completion_queues[i % m_completion_queues.size()].get();                          \
+		c.m_process_func = &server::impl;                                                            \
+		c.m_request_func = &svc::AsyncService::Request##rpc;                                         \
+		c.start(this);                                                                               \
 	}
 
-#define REGISTER_UNARY(req, res, svc, rpc, impl, num)                    \
-	std::vector<request_context<svc, req, res>> rpc##_contexts(num); \
-	for(request_context<svc, req, res> & c : rpc##_contexts)         \
-	{                                                                \
-		c.m_process_func = &server::impl;                        \
-		c.m_request_func = &svc::AsyncService::Request##rpc;     \
-		c.start(this);                                           \
+#define REGISTER_UNARY(req, res, svc, rpc, impl, num)                                                 \
+	std::vector<request_context<svc, req, res>> rpc##_contexts(num * m_completion_queues.size()); \
+	for(size_t i = 0; i < rpc##_contexts.size(); i++)                                             \
+	{                                                                                             \
+		request_context<svc, req, res>& c = rpc##_contexts[i];                                \
+		c.m_cq = m_completion_queues[i % m_completion_queues.size()].get();                   \
+		c.m_process_func = &server::impl;                                                     \
+		c.m_request_func = &svc::AsyncService::Request##rpc;                                  \
+		c.start(this);                                                                        \
 	}
 
-#define REGISTER_BIDI(req, res, svc, rpc, impl, num)                          \
-	std::vector<request_bidi_context<svc, req, res>> rpc##_contexts(num); \
-	for(request_bidi_context<svc, req, res> & c : rpc##_contexts)         \
-	{                                                                     \
-		c.m_process_func = &server::impl;                             \
-		c.m_request_func = &svc::AsyncService::Request##rpc;          \
-		c.start(this);                                                \
+#define REGISTER_BIDI(req, res, svc, rpc, impl, num)                                                       \
+	std::vector<request_bidi_context<svc, req, res>> rpc##_contexts(num * m_completion_queues.size()); \
+	for(size_t i = 0; i < rpc##_contexts.size(); i++)                                                  \
+	{                                                                                                  \
+		request_bidi_context<svc, req, res>& c = rpc##_contexts[i];                                \
+		c.m_cq = m_completion_queues[i % m_completion_queues.size()].get();                        \
+		c.m_process_func = &server::impl;                                                          \
+		c.m_request_func = &svc::AsyncService::Request##rpc;                                       \
+		c.start(this);                                                                             \
 	}
 
 static void gpr_log_dispatcher_func(gpr_log_func_args* args)
@@ -79,11 +90,41 @@ static void gpr_log_dispatcher_func(gpr_log_func_args* args)
 	falco_logger::log(priority, std::move(copy));
 }
 
+void falco::grpc::server::pin_thread()
+{
+	std::string err;
+	if(!falco::thread_affinity::pin_current(m_cpus, err))
+	{
+		falco_logger::log(falco_logger::level::WARNING, "Could not set the CPU affinity of a gRPC thread: " + err + "\n");
+	}
+}
+
+void falco::grpc::server::set_rules_engine(const std::shared_ptr<falco_engine>& engine)
+{
+	m_engine = engine;
+}
+
+std::unique_lock<std::mutex> falco::grpc::server::lock_rules_engine()
+{
+	return std::unique_lock<std::mutex>(m_engine_mtx);
+}
+
+void falco::grpc::server::set_rules_changed_callback(std::function<void()> cb)
+{
+	m_rules_changed = std::move(cb);
+}
+
 void falco::grpc::server::thread_process(int thread_index)
 {
+	if(!m_cpus.empty())
+	{
+		pin_thread();
+	}
+
+	auto& cq = m_completion_queues[thread_index];
 	void* tag = nullptr;
 	bool event_read_success = false;
-	while(m_completion_queue->Next(&tag, &event_read_success))
+	while(cq->Next(&tag, &event_read_success))
 	{
 		if(tag == nullptr)
 		{
@@ -137,10 +178,14 @@ void falco::grpc::server::init(
 	const std::string& private_key,
 	const std::string& cert_chain,
 	const std::string& root_certs,
-	const std::string& log_level)
+	const std::string& log_level,
+	int contexts_per_thread,
+	const std::vector<uint32_t>& cpus)
 {
 	m_server_addr = server_addr;
 	m_threadiness = threadiness;
+	m_contexts_per_thread = contexts_per_thread;
+	m_cpus = cpus;
 	m_private_key = private_key;
 	m_cert_chain = cert_chain;
 	m_root_certs = root_certs;
@@ -198,8 +243,16 @@ void falco::grpc::server::run()
 {
 	m_server_builder.RegisterService(&m_output_svc);
 	m_server_builder.RegisterService(&m_version_svc);
+	if(m_engine)
+	{
+		m_server_builder.RegisterService(&m_rules_svc);
+	}
 
-	m_completion_queue = m_server_builder.AddCompletionQueue();
+	m_completion_queues.clear();
+	for(int i = 0; i < m_threadiness; i++)
+	{
+		m_completion_queues.push_back(m_server_builder.AddCompletionQueue());
+	}
 	m_server = m_server_builder.BuildAndStart();
 	if(m_server == nullptr)
 	{
@@ -208,15 +261,21 @@ void falco::grpc::server::run()
 	}
 	falco_logger::log(falco_logger::level::INFO, "Starting gRPC server at " + m_server_addr + "\n");
 
-	// The number of contexts is multiple of the number of threads
+	// Each completion queue, served by its own thread, has the same number of contexts
 	// This defines the number of simultaneous completion queue requests of the same type (service::AsyncService::Request##RPC)
 	// For this approach to be sufficient server::IMPL have to be fast
-	int context_num = m_threadiness * 10;
+	int context_num = m_contexts_per_thread;
 	// todo(leodido) > take a look at thread_stress_test.cc into grpc repository
 
 	REGISTER_UNARY(version::request, version::response, version::service, version, version, context_num)
 	REGISTER_STREAM(outputs::request, outputs::response, outputs::service, get, get, context_num)
 	REGISTER_BIDI(outputs::request, outputs::response, outputs::service, sub, sub, context_num)
+	REGISTER_BIDI(outputs::request, outputs::batch, outputs::service, sub_batch, sub_batch, context_num)
+
+	// the rules change rarely, so a single context per thread is enough
+	int rules_context_num = m_engine ? 1 : 0;
+	REGISTER_UNARY(rules::enable_request, rules::enable_response, rules::service, enable, enable, rules_context_num)
+	REGISTER_UNARY(rules::stats_request, rules::stats_response, rules::service, stats, stats, rules_context_num)
 
 	m_threads.resize(m_threadiness);
 	int thread_idx = 0;
@@ -234,7 +293,10 @@ void falco::grpc::server::run()
 void falco::grpc::server::stop()
 {
 	falco_logger::log(falco_logger::level::INFO, "Shutting down gRPC server. Waiting until external connections are closed by clients\n");
-	m_completion_queue->Shutdown();
+	for(auto& cq : m_completion_queues)
+	{
+		cq->Shutdown();
+	}
 
 	falco_logger::log(falco_logger::level::INFO, "Waiting for the gRPC threads to complete\n");
 	for(std::thread& t : m_threads)
@@ -250,8 +312,11 @@ void falco::grpc::server::stop()
 	// Ignore remaining events
 	void* ignore_tag = nullptr;
 	bool ignore_ok = false;
-	while(m_completion_queue->Next(&ignore_tag, &ignore_ok))
+	for(auto& cq : m_completion_queues)
 	{
+		while(cq->Next(&ignore_tag, &ignore_ok))
+		{
+		}
 	}
 
 	falco_logger::log(falco_logger::level::INFO, "Shutting down gRPC server complete\n");
@@ -266,11 +331,39 @@ bool falco::grpc::server::is_running()
 	return true;
 }
 
+static const int s_default_batch_max_alerts = 100;
+static const uint32_t s_max_batch_max_alerts = 10000;
+
+// Reads the next alert matching the filter of the request at the cursor of
+// the stream, which subscribes to the queue the first time, and warns when
+// the stream starts losing alerts
+static bool next_alert(const falco::grpc::stream_context& ctx, const falco::outputs::request& req, falco::outputs::response& res)
+{
+	auto& q = falco::grpc::queue::get();
+	if(!ctx.m_cursor.subscribed)
+	{
+		std::string session;
+		ctx.get_metadata(falco::grpc::meta_session, session);
+		q.subscribe(ctx.m_cursor, session);
+	}
+
+	bool lossy = ctx.m_cursor.lossy;
+	bool has_more = q.try_pop(ctx.m_cursor, res, req.has_filter() ? &req.filter() : nullptr);
+	if(!lossy && ctx.m_cursor.lossy)
+	{
+		ctx.set_trailing_metadata(falco::grpc::meta_lossy, "true");
+		falco_logger::log(falco_logger::level::WARNING,
+			"A gRPC output subscriber fell behind and lost " + std::to_string(ctx.m_cursor.lost) + " alerts\n");
+	}
+	return has_more;
+}
+
 void falco::grpc::server::get(const stream_context& ctx, const outputs::request& req, outputs::response& res)
 {
 	if(ctx.m_status == stream_context::SUCCESS || ctx.m_status == stream_context::ERROR)
 	{
 		// todo(leodido) > log "status=ctx->m_status, stream=ctx->m_stream"
+		queue::get().unsubscribe(ctx.m_cursor);
 		ctx.m_stream = nullptr;
 		return;
 	}
@@ -281,13 +374,14 @@ void falco::grpc::server::get(const stream_context& ctx, const outputs::request&
 	// m_status == stream_context::STREAMING?
 	// todo(leodido) > set m_stream
 
-	ctx.m_has_more = queue::get().try_pop(res);
+	ctx.m_has_more = next_alert(ctx, req, res);
 }
 
 void falco::grpc::server::sub(const bidi_context& ctx, const outputs::request& req, outputs::response& res)
 {
 	if(ctx.m_status == stream_context::SUCCESS || ctx.m_status == stream_context::ERROR)
 	{
+		queue::get().unsubscribe(ctx.m_cursor);
 		ctx.m_stream = nullptr;
 		return;
 	}
@@ -298,7 +392,56 @@ void falco::grpc::server::sub(const bidi_context& ctx, const outputs::request& r
 	// m_status == stream_context::STREAMING?
 	// todo(leodido) > set m_stream
 
-	ctx.m_has_more = queue::get().try_pop(res);
+	ctx.m_has_more = next_alert(ctx, req, res);
+}
+
+void falco::grpc::server::sub_batch(const bidi_context& ctx, const outputs::request& req, outputs::batch& res)
+{
+	if(ctx.m_status == stream_context::SUCCESS || ctx.m_status == stream_context::ERROR)
+	{
+		queue::get().unsubscribe(ctx.m_cursor);
+		ctx.m_stream = nullptr;
+		return;
+	}
+
+	ctx.m_is_running = is_running();
+
+	int max_alerts = s_default_batch_max_alerts;
+	if(req.batch_max_alerts() > 0)
+	{
+		max_alerts = std::min<uint32_t>(req.batch_max_alerts(), s_max_batch_max_alerts);
+	}
+
+	// the batch is kept across the calls while lingering
+	outputs::response alert;
+	while(res.responses_size() < max_alerts && next_alert(ctx, req, alert))
+	{
+		res.add_responses()->Swap(&alert);
+	}
+
+	// with no alerts, wait for the next request of the client as sub() does
+	ctx.m_has_more = res.responses_size() > 0;
+	if(!ctx.m_has_more)
+	{
+		ctx.m_lingering = false;
+		return;
+	}
+
+	if(res.responses_size() < max_alerts && req.batch_linger_ms() > 0)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if(!ctx.m_lingering)
+		{
+			ctx.m_lingering = true;
+			ctx.m_linger_deadline = now + std::chrono::milliseconds(req.batch_linger_ms());
+		}
+		if(now < ctx.m_linger_deadline)
+		{
+			ctx.m_has_more = false;
+			return;
+		}
+	}
+	ctx.m_lingering = false;
 }
 
 void falco::grpc::server::version(const context& ctx, const version::request&, version::response& res)
@@ -324,8 +467,79 @@ void falco::grpc::server::version(const context& ctx, const version::request&, v
 	res.set_patch(FALCO_VERSION_PATCH);
 }
 
+void falco::grpc::server::enable(const context& ctx, const rules::enable_request& req, rules::enable_response& res)
+{
+	std::lock_guard<std::mutex> lk(m_engine_mtx);
+	for(const auto& rule : req.rules())
+	{
+		m_engine->enable_rule_wildcard(rule, req.enabled());
+	}
+	if(req.tags_size() > 0)
+	{
+		std::set<std::string> tags(req.tags().begin(), req.tags().end());
+		m_engine->enable_rule_by_tag(tags, req.enabled());
+	}
+	res.set_enabled_rules(m_engine->num_rules_for_ruleset());
+
+	falco_logger::log(falco_logger::level::INFO,
+		std::string(req.enabled() ? "Enabled" : "Disabled") + " rules through gRPC ("
+		+ std::to_string(req.rules_size()) + " names, " + std::to_string(req.tags_size()) + " tags), "
+		+ std::to_string(res.enabled_rules()) + " rules are now enabled\n");
+
+	if(m_rules_changed)
+	{
+		m_rules_changed();
+	}
+}
+
+void falco::grpc::server::stats(const context& ctx, const rules::stats_request& req, rules::stats_response& res)
+{
+	std::lock_guard<std::mutex> lk(m_engine_mtx);
+	res.set_enabled_rules(m_engine->num_rules_for_ruleset());
+
+	// the counters are thread-safe and sized when loading the rules, so they
+	// can be read while the events are processed
+	const auto& sm = m_engine->get_rule_stats_manager();
+	const auto& matches = sm.get_by_rule_id();
+	const auto& rate_limited = sm.get_rate_limited_by_rule_id();
+	const auto& profiles = sm.get_profile_by_rule_id();
+	res.set_matches_total(sm.get_total());
+	for(const auto& rule : m_engine->get_rules())
+	{
+		if(req.rules_size() > 0 && std::none_of(req.rules().begin(), req.rules().end(),
+			[&rule](const std::string& p) { return falco::utils::matches_wildcard(p, rule.name); }))
+		{
+			continue;
+		}
+
+		auto& r = *res.add_rules();
+		r.set_name(rule.name);
+		r.set_source(rule.source);
+		r.set_priority(falco::schema::priority(rule.priority));
+		for(const auto& tag : *rule.tags)
+		{
+			r.add_tags(tag);
+		}
+		if(rule.id < matches.size())
+		{
+			r.set_matches(matches[rule.id]);
+		}
+		if(rule.id < rate_limited.size())
+		{
+			r.set_rate_limited(rate_limited[rule.id]);
+		}
+		if(sm.is_rule_profiling_enabled() && rule.id < profiles.size())
+		{
+			r.set_evaluations(profiles[rule.id]->evaluations.load());
+			r.set_evaluation_time_ns(profiles[rule.id]->estimated_time_ns());
+		}
+	}
+}
+
 void falco::grpc::server::shutdown()
 {
 	m_stop = true;
+	// wake up the streams waiting for new alerts, so that they finish
+	queue::get().notify_all();
 	m_server->Shutdown();
 }
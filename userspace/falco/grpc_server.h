@@ -20,11 +20,18 @@ limitations under the License.
 #include <thread>
 #include <string>
 #include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "outputs.grpc.pb.h"
 #include "version.grpc.pb.h"
+#include "rules.grpc.pb.h"
 #include "grpc_context.h"
 
+class falco_engine;
+
 namespace falco
 {
 namespace grpc
@@ -42,8 +49,29 @@ public:
 		const std::string& private_key,
 		const std::string& cert_chain,
 		const std::string& root_certs,
-		const std::string& log_level
+		const std::string& log_level,
+		int contexts_per_thread = 10,
+		const std::vector<uint32_t>& cpus = {}
 	);
+	/*!
+		\brief Serves the rules service, which enables and disables the
+		rules of the given engine while it processes events. This must be
+		invoked before run(), and the service is not served otherwise.
+		While serving, the engine can be replaced by invoking this again
+		while holding the lock returned by lock_rules_engine().
+	*/
+	void set_rules_engine(const std::shared_ptr<falco_engine>& engine);
+	/*!
+		\brief Blocks the requests of the rules service, and the callback
+		of their changes, until the returned lock is released
+	*/
+	std::unique_lock<std::mutex> lock_rules_engine();
+	/*!
+		\brief Sets a callback invoked after each change of the enabled
+		rules through the rules service, while no other change can happen.
+		This must be invoked before run().
+	*/
+	void set_rules_changed_callback(std::function<void()> cb);
 	void thread_process(int thread_index);
 	void run();
 	void stop();
@@ -51,12 +79,16 @@ public:
 
 	outputs::service::AsyncService m_output_svc;
 	version::service::AsyncService m_version_svc;
+	rules::service::AsyncService m_rules_svc;
 
-	std::unique_ptr<::grpc::ServerCompletionQueue> m_completion_queue;
+	// one for each thread, so that they don't contend on a single one
+	std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> m_completion_queues;
 
 private:
 	std::string m_server_addr;
 	int m_threadiness = 1;
+	int m_contexts_per_thread = 10;
+	std::vector<uint32_t> m_cpus;
 	std::string m_private_key;
 	std::string m_cert_chain;
 	std::string m_root_certs;
@@ -67,14 +99,26 @@ private:
 	void init_unix_server_builder();
 
 	bool is_running();
+	void pin_thread();
 
 	// Outputs
 	void get(const stream_context& ctx, const outputs::request& req, outputs::response& res);
 	void sub(const bidi_context& ctx, const outputs::request& req, outputs::response& res);
+	void sub_batch(const bidi_context& ctx, const outputs::request& req, outputs::batch& res);
 
 	// Version
 	void version(const context& ctx, const version::request& req, version::response& res);
 
+	// Rules
+	void enable(const context& ctx, const rules::enable_request& req, rules::enable_response& res);
+	void stats(const context& ctx, const rules::stats_request& req, rules::stats_response& res);
+
+	// the engine only supports changing the rules from a single thread
+	// at a time, while the other threads process the events
+	std::shared_ptr<falco_engine> m_engine;
+	std::mutex m_engine_mtx;
+	std::function<void()> m_rules_changed;
+
 	std::unique_ptr<::grpc::Server> m_server;
 
 	std::atomic<bool> m_stop{false};
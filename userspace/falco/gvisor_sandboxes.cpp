@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gvisor_sandboxes.h"
+
+using namespace falco;
+
+gvisor_sandboxes::gvisor_sandboxes(size_t shard, size_t max_sandboxes):
+	m_shard(shard),
+	m_max_sandboxes(max_sandboxes)
+{
+}
+
+std::atomic<uint64_t>* gvisor_sandboxes::sandbox(const std::string& id)
+{
+	// the events of the threads outside of the sandboxes, if any, are
+	// not attributed to one
+	if(id.empty() || id == "host")
+	{
+		return &m_untracked_evts;
+	}
+	std::lock_guard<std::mutex> lk(m_mtx);
+	auto it = m_sandboxes.find(id);
+	if(it != m_sandboxes.end())
+	{
+		return &it->second;
+	}
+	if(m_sandboxes.size() >= m_max_sandboxes)
+	{
+		return &m_untracked_evts;
+	}
+	return &m_sandboxes[id];
+}
+
+void gvisor_sandboxes::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["gvisor.shard_evts." + std::to_string(m_shard)] = m_num_evts.load(std::memory_order_relaxed);
+	metrics["gvisor.untracked_evts"] += m_untracked_evts.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lk(m_mtx);
+	metrics["gvisor.sandboxes"] += m_sandboxes.size();
+	for(const auto& s : m_sandboxes)
+	{
+		metrics["gvisor.sandbox_evts." + s.first] = s.second.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace falco
+{
+
+/*!
+	\brief Counts the events of each gVisor sandbox received by one shard,
+	i.e. by one of the inspectors the sandboxes send their events to. The
+	sandbox of a thread is only obtained once, and the sandboxes beyond
+	max_sandboxes are counted together. The events are only counted by the
+	thread of the shard, and the metrics can be read from any thread.
+*/
+class gvisor_sandboxes
+{
+public:
+	gvisor_sandboxes(size_t shard, size_t max_sandboxes);
+
+	gvisor_sandboxes(const gvisor_sandboxes&) = delete;
+	gvisor_sandboxes& operator = (const gvisor_sandboxes&) = delete;
+
+	/*!
+		\brief Counts an event of the thread with the given tid and clone
+		timestamp. The sandbox id is only obtained with extract() for the
+		threads not seen before.
+	*/
+	template<typename F>
+	inline void count(int64_t tid, uint64_t clone_ts, F&& extract)
+	{
+		auto it = m_threads.find(tid);
+		if(it == m_threads.end() || it->second.clone_ts != clone_ts) [[unlikely]]
+		{
+			if(m_threads.size() >= s_max_threads)
+			{
+				m_threads.clear();
+			}
+			it = m_threads.insert_or_assign(tid, thread{clone_ts, sandbox(extract())}).first;
+		}
+		increment(*it->second.evts);
+		increment(m_num_evts);
+	}
+
+	/*!
+		\brief Adds to the given map the events of the shard, as
+		gvisor.shard_evts.<shard>, and of each of its sandboxes, as
+		gvisor.sandbox_evts.<sandbox id>, along with the number of sandboxes
+		and the events of the ones not tracked, summed over the shards
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	struct thread
+	{
+		uint64_t clone_ts = 0;
+		std::atomic<uint64_t>* evts = nullptr;
+	};
+
+	static constexpr size_t s_max_threads = 65536;
+
+	// only the thread of the shard updates the counters
+	static inline void increment(std::atomic<uint64_t>& v)
+	{
+		v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64_t>* sandbox(const std::string& id);
+
+	size_t m_shard;
+	size_t m_max_sandboxes;
+	std::unordered_map<int64_t, thread> m_threads;
+	std::atomic<uint64_t> m_num_evts{0};
+	std::atomic<uint64_t> m_untracked_evts{0};
+	// the sandboxes are never removed, so that the threads can refer to
+	// their counters, and are only added under the mutex
+	mutable std::mutex m_mtx;
+	std::unordered_map<std::string, std::atomic<uint64_t>> m_sandboxes;
+};
+
+} // namespace falco
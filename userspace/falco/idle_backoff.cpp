@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "idle_backoff.h"
+
+#include <algorithm>
+#include <thread>
+
+falco::idle_backoff::idle_backoff(uint32_t spin_timeouts, uint32_t yield_timeouts, std::chrono::microseconds max_sleep)
+	: m_spin_timeouts(spin_timeouts), m_yield_timeouts(yield_timeouts), m_max_sleep(max_sleep)
+{
+}
+
+falco::idle_backoff::action falco::idle_backoff::on_timeout(std::chrono::microseconds& sleep)
+{
+	m_timeouts.fetch_add(1, std::memory_order_relaxed);
+	auto n = m_consecutive_timeouts++;
+	if(n < m_spin_timeouts)
+	{
+		return action::SPIN;
+	}
+	n -= m_spin_timeouts;
+	if(n < m_yield_timeouts || m_max_sleep.count() <= 0)
+	{
+		m_yields.fetch_add(1, std::memory_order_relaxed);
+		return action::YIELD;
+	}
+	n -= m_yield_timeouts;
+
+	// note: the doubling stops at 2^30us, far beyond any sensible max_sleep
+	sleep = std::min(m_max_sleep, std::chrono::microseconds(uint64_t(1) << std::min<uint64_t>(n, 30)));
+	m_sleeps.fetch_add(1, std::memory_order_relaxed);
+	m_sleep_time_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(sleep).count(), std::memory_order_relaxed);
+	return action::SLEEP;
+}
+
+void falco::idle_backoff::wait()
+{
+	std::chrono::microseconds sleep{0};
+	switch(on_timeout(sleep))
+	{
+	case action::SPIN:
+		break;
+	case action::YIELD:
+		std::this_thread::yield();
+		break;
+	case action::SLEEP:
+		std::this_thread::sleep_for(sleep);
+		break;
+	}
+}
+
+void falco::idle_backoff::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["idle.timeouts"] = m_timeouts.load(std::memory_order_relaxed);
+	metrics["idle.yields"] = m_yields.load(std::memory_order_relaxed);
+	metrics["idle.sleeps"] = m_sleeps.load(std::memory_order_relaxed);
+	metrics["idle.sleep_time_ns"] = m_sleep_time_ns.load(std::memory_order_relaxed);
+}
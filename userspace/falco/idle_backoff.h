@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace falco
+{
+
+/*!
+	\brief Decides how the event processing loop of a source waits after
+	the source had no event to return, so that polling an idle source
+	doesn't keep a CPU busy. The source is polled again right away after
+	the first spin_timeouts consecutive timeouts, after yielding the CPU
+	for the next yield_timeouts ones, and then after sleeping for a time
+	that doubles at every timeout, from 1us up to max_sleep. Any event
+	starts the sequence over. The waits are decided by the thread of the
+	source, and the metrics can be read from any thread.
+*/
+class idle_backoff
+{
+public:
+	enum class action
+	{
+		SPIN,
+		YIELD,
+		SLEEP
+	};
+
+	idle_backoff(uint32_t spin_timeouts, uint32_t yield_timeouts, std::chrono::microseconds max_sleep);
+
+	/*!
+		\brief Accounts a timeout of the source and returns how to wait
+		before polling it again, along with the time to sleep for, which
+		is only set for action::SLEEP
+	*/
+	action on_timeout(std::chrono::microseconds& sleep);
+
+	/*!
+		\brief Accounts a timeout of the source and waits accordingly on
+		the current thread
+	*/
+	void wait();
+
+	inline void on_event()
+	{
+		m_consecutive_timeouts = 0;
+	}
+
+	/*!
+		\brief Adds to the given map the number of timeouts, the number
+		of times the CPU was yielded or the thread slept after one of them,
+		and the total sleep time in nanoseconds, as idle.timeouts,
+		idle.yields, idle.sleeps and idle.sleep_time_ns
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	uint32_t m_spin_timeouts;
+	uint32_t m_yield_timeouts;
+	std::chrono::microseconds m_max_sleep;
+	uint64_t m_consecutive_timeouts = 0;
+
+	std::atomic<uint64_t> m_timeouts{0};
+	std::atomic<uint64_t> m_yields{0};
+	std::atomic<uint64_t> m_sleeps{0};
+	std::atomic<uint64_t> m_sleep_time_ns{0};
+};
+
+} // namespace falco
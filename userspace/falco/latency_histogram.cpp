@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "latency_histogram.h"
+
+#include <cmath>
+
+void falco::outputs::latency_histogram::record(uint64_t us)
+{
+	size_t bucket = 0;
+	while(bucket < num_buckets - 1 && (uint64_t(1) << bucket) <= us)
+	{
+		bucket++;
+	}
+
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_total_us.fetch_add(us, std::memory_order_relaxed);
+	m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	auto max = m_max_us.load(std::memory_order_relaxed);
+	while(us > max && !m_max_us.compare_exchange_weak(max, us, std::memory_order_relaxed))
+	{
+	}
+}
+
+uint64_t falco::outputs::latency_histogram::percentile_us(double percentile) const
+{
+	// the buckets are summed rather than relying on m_count, which can
+	// be ahead of them while samples are being recorded
+	uint64_t samples = 0;
+	std::array<uint64_t, num_buckets> buckets;
+	for(size_t i = 0; i < num_buckets; i++)
+	{
+		buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+		samples += buckets[i];
+	}
+	if(samples == 0)
+	{
+		return 0;
+	}
+
+	uint64_t threshold = (uint64_t) std::ceil((percentile / 100.0) * (double) samples);
+	uint64_t count = 0;
+	for(size_t i = 0; i < num_buckets; i++)
+	{
+		count += buckets[i];
+		if(count >= threshold && count > 0)
+		{
+			return uint64_t(1) << i;
+		}
+	}
+	return uint64_t(1) << (num_buckets - 1);
+}
+
+void falco::outputs::latency_histogram::get_metrics(const std::string& prefix, std::map<std::string, uint64_t>& metrics) const
+{
+	metrics[prefix + "_count"] = count();
+	metrics[prefix + "_us_total"] = total_us();
+	metrics[prefix + "_us_max"] = max_us();
+	metrics[prefix + "_us_p50"] = percentile_us(50);
+	metrics[prefix + "_us_p90"] = percentile_us(90);
+	metrics[prefix + "_us_p99"] = percentile_us(99);
+}
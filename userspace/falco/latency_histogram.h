@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace falco
+{
+namespace outputs
+{
+
+/*!
+	\brief A histogram of latencies in microseconds, whose i-th bucket
+	counts the samples that took less than 2^i microseconds and at least
+	2^(i-1) microseconds. Samples can be recorded and read concurrently
+	from any thread without locking.
+*/
+class latency_histogram
+{
+public:
+	static constexpr size_t num_buckets = 32;
+
+	void record(uint64_t us);
+
+	inline void record(std::chrono::steady_clock::duration d)
+	{
+		record(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+	}
+
+	inline uint64_t count() const
+	{
+		return m_count.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t total_us() const
+	{
+		return m_total_us.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t max_us() const
+	{
+		return m_max_us.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the number of samples in the i-th bucket, i.e. the
+		ones below 2^i microseconds and, except for the first bucket, at
+		least 2^(i-1). The last bucket also holds all the larger samples.
+	*/
+	inline uint64_t bucket(size_t i) const
+	{
+		return m_buckets[i].load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns an upper bound of the given percentile (in the
+		[0, 100] range) of the samples, in microseconds, or 0 if there
+		are no samples
+	*/
+	uint64_t percentile_us(double percentile) const;
+
+	/*!
+		\brief Adds the number of samples, their total and maximum, and
+		the 50th, 90th and 99th percentiles to the given map, as
+		<prefix>_count, <prefix>_us_total, <prefix>_us_max and
+		<prefix>_us_p50 and so on
+	*/
+	void get_metrics(const std::string& prefix, std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	std::atomic<uint64_t> m_count{0};
+	std::atomic<uint64_t> m_total_us{0};
+	std::atomic<uint64_t> m_max_us{0};
+	std::array<std::atomic<uint64_t>, num_buckets> m_buckets{};
+};
+
+} // namespace outputs
+} // namespace falco
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "load_shedder.h"
+
+#include <algorithm>
+
+falco::load_shedder::load_shedder(std::vector<uint8_t> class_by_evt_type, double raise_drop_rate, double lower_drop_rate, uint32_t lower_after_intervals)
+	: m_class_by_evt_type(std::move(class_by_evt_type)),
+	  m_raise_drop_rate(raise_drop_rate),
+	  m_lower_drop_rate(lower_drop_rate),
+	  m_lower_after_intervals(std::max<uint32_t>(lower_after_intervals, 1))
+{
+	for(auto c : m_class_by_evt_type)
+	{
+		m_max_level = std::max(m_max_level, c);
+	}
+}
+
+bool falco::load_shedder::update(uint64_t n_evts, uint64_t n_drops)
+{
+	// note: the number of events includes the dropped ones
+	double rate = n_evts > 0 ? (double)n_drops / n_evts : 0;
+	auto prev = m_level;
+	if(rate > m_raise_drop_rate)
+	{
+		m_calm_intervals = 0;
+		if(m_level < m_max_level)
+		{
+			m_level++;
+		}
+	}
+	else if(rate < m_lower_drop_rate)
+	{
+		if(m_level > 0 && ++m_calm_intervals >= m_lower_after_intervals)
+		{
+			m_calm_intervals = 0;
+			m_level--;
+		}
+	}
+	else
+	{
+		// shedding at this level is enough to keep up
+		m_calm_intervals = 0;
+	}
+
+	if(m_level == prev)
+	{
+		return false;
+	}
+	m_published_level.store(m_level, std::memory_order_relaxed);
+	m_level_changes.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void falco::load_shedder::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["shed.level"] = m_published_level.load(std::memory_order_relaxed);
+	metrics["shed.events"] = m_shed_evts.load(std::memory_order_relaxed);
+	metrics["shed.level_changes"] = m_level_changes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief Sheds the events of configurable classes before they reach the
+	rule engine when the kernel drops events, so that the detection
+	coverage degrades predictably instead of at random. Each event type
+	belongs to at most one class, and the classes are shed in order: at
+	level N the events of the first N classes skip the evaluation of the
+	rules, while the others are evaluated as usual. The level is raised
+	by one for every interval in which the drop rate is above raise_drop_rate,
+	and lowered by one after lower_after_intervals consecutive intervals
+	in which it is below lower_drop_rate. The events are still parsed by
+	the inspector, so that its state is unaffected. The level is decided
+	and applied by the thread of the source, and the metrics can be read
+	from any thread.
+*/
+class load_shedder
+{
+public:
+	/*!
+		\brief Creates a shedder for the given classes, where
+		class_by_evt_type[t] is the 1-based class of the events of type t,
+		or 0 for the ones that are never shed
+	*/
+	load_shedder(std::vector<uint8_t> class_by_evt_type, double raise_drop_rate, double lower_drop_rate, uint32_t lower_after_intervals);
+
+	/*!
+		\brief Returns true if the events of the given type must skip the
+		evaluation of the rules at the current level, and accounts them
+	*/
+	inline bool should_shed(uint16_t evt_type)
+	{
+		if(m_level == 0) [[likely]]
+		{
+			return false;
+		}
+		if(evt_type >= m_class_by_evt_type.size()
+			|| m_class_by_evt_type[evt_type] == 0
+			|| m_class_by_evt_type[evt_type] > m_level)
+		{
+			return false;
+		}
+		m_shed_evts.store(m_shed_evts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/*!
+		\brief Updates the level with the number of events and drops of
+		the last interval. Returns true if the level changed.
+	*/
+	bool update(uint64_t n_evts, uint64_t n_drops);
+
+	inline uint8_t level() const
+	{
+		return m_level;
+	}
+
+	inline uint8_t max_level() const
+	{
+		return m_max_level;
+	}
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	std::vector<uint8_t> m_class_by_evt_type;
+	double m_raise_drop_rate;
+	double m_lower_drop_rate;
+	uint32_t m_lower_after_intervals;
+	uint8_t m_max_level = 0;
+
+	// only used by the thread of the source
+	uint8_t m_level = 0;
+	uint32_t m_calm_intervals = 0;
+
+	std::atomic<uint8_t> m_published_level{0};
+	std::atomic<uint64_t> m_shed_evts{0};
+	std::atomic<uint64_t> m_level_changes{0};
+};
+
+} // namespace falco
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "metrics_file.h"
+#include "falco_common.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace falco;
+
+metrics_file::metrics_file(const std::string& filename, const config& c):
+	m_filename(filename),
+	m_config(c),
+	m_writer(c.m_buffer_size)
+{
+	// the file is opened right away, so that a wrong path is reported
+	// at startup
+	open_file();
+	m_thread = std::thread(&metrics_file::writer, this);
+}
+
+metrics_file::~metrics_file()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void metrics_file::write(std::string line)
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_backlog_bytes += line.size();
+		m_backlog.push_back(std::move(line));
+		while(m_backlog_bytes > m_config.m_max_backlog_bytes && m_backlog.size() > 1)
+		{
+			m_backlog_bytes -= m_backlog.front().size();
+			m_backlog.pop_front();
+			m_dropped_lines.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	m_cv.notify_one();
+}
+
+void metrics_file::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	m_writer.get_metrics(metrics);
+	metrics["dropped_lines"] = m_dropped_lines.load(std::memory_order_relaxed);
+	metrics["write_errors"] = m_write_errors.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lk(m_mtx);
+	metrics["backlog_bytes"] = m_backlog_bytes;
+}
+
+void metrics_file::open_file()
+{
+	if(m_fd >= 0)
+	{
+		return;
+	}
+#ifdef _WIN32
+	m_fd = _open(m_filename.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	m_fd = open(m_filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+#endif
+	if(m_fd < 0)
+	{
+		throw falco_exception("failed to open metrics file " + m_filename + ": " + std::strerror(errno));
+	}
+	m_writer.set_fd(m_fd);
+
+	struct stat st;
+	m_file_size = fstat(m_fd, &st) == 0 ? st.st_size : 0;
+}
+
+void metrics_file::close_file()
+{
+	if(m_fd < 0)
+	{
+		return;
+	}
+#ifdef _WIN32
+	_close(m_fd);
+#else
+	close(m_fd);
+#endif
+	m_fd = -1;
+	m_writer.set_fd(-1);
+}
+
+void metrics_file::rotate()
+{
+	close_file();
+
+	// as for the file output, <filename> becomes <filename>.1, and so on
+	if(m_config.m_rotate_max_files == 0)
+	{
+		std::remove(m_filename.c_str());
+	}
+	else
+	{
+		std::remove((m_filename + "." + std::to_string(m_config.m_rotate_max_files)).c_str());
+		for(uint32_t i = m_config.m_rotate_max_files - 1; i > 0; i--)
+		{
+			std::rename((m_filename + "." + std::to_string(i)).c_str(),
+				    (m_filename + "." + std::to_string(i + 1)).c_str());
+		}
+		if(std::rename(m_filename.c_str(), (m_filename + ".1").c_str()) != 0)
+		{
+			falco_logger::log(falco_logger::level::ERR, "failed to rotate metrics file " + m_filename + ": " + std::strerror(errno) + "\n");
+		}
+	}
+
+	open_file();
+}
+
+void metrics_file::writer() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::STATS);
+	std::deque<std::string> lines;
+	bool flush_each = m_config.m_flush_interval.count() == 0;
+	auto next_flush = clock::now() + m_config.m_flush_interval;
+	bool stop = false;
+	while(!stop)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mtx);
+			auto ready = [this]{ return m_stop || !m_backlog.empty(); };
+			if(flush_each)
+			{
+				m_cv.wait(lk, ready);
+			}
+			else
+			{
+				m_cv.wait_until(lk, next_flush, ready);
+			}
+			lines.swap(m_backlog);
+			m_backlog_bytes = 0;
+			stop = m_stop;
+		}
+
+		// the lock is not held while writing, so that the stats worker
+		// never waits for the disk
+		bool flush = flush_each || stop || clock::now() >= next_flush;
+		try
+		{
+			if(!lines.empty())
+			{
+				open_file();
+			}
+			for(const auto& line : lines)
+			{
+				m_writer.write_line(line);
+				m_file_size += line.size() + 1;
+			}
+			if(flush || (m_config.m_rotate_max_size > 0 && m_file_size >= m_config.m_rotate_max_size))
+			{
+				m_writer.flush();
+			}
+			if(m_config.m_rotate_max_size > 0 && m_file_size >= m_config.m_rotate_max_size)
+			{
+				rotate();
+			}
+		}
+		catch(const std::exception& e)
+		{
+			// the lines that couldn't be written are lost, and the file
+			// is opened again for the next ones
+			m_write_errors.fetch_add(1, std::memory_order_relaxed);
+			falco_logger::log(falco_logger::level::ERR, "metrics file: " + std::string(e.what()) + "\n");
+			close_file();
+		}
+		lines.clear();
+		if(flush)
+		{
+			next_flush = clock::now() + m_config.m_flush_interval;
+		}
+	}
+	close_file();
+}
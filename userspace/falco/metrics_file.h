@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "fd_writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace falco
+{
+
+/*!
+	\brief Appends the metrics snapshots to a file, one per line, from a
+	dedicated thread, so that a slow disk never blocks the stats worker.
+	The lines wait in a backlog bounded by its size, which drops the oldest
+	ones when full, and are then collected in a buffer written when full
+	and at the flush interval. The file can be rotated by size. Write
+	errors are logged and counted, and the file is reopened for the next
+	lines. This class is thread-safe.
+*/
+class metrics_file
+{
+public:
+	struct config
+	{
+		uint64_t m_buffer_size = 64 * 1024;
+		std::chrono::milliseconds m_flush_interval{1000};
+		// 0 not to rotate the file
+		uint64_t m_rotate_max_size = 0;
+		uint32_t m_rotate_max_files = 5;
+		uint64_t m_max_backlog_bytes = 4 * 1024 * 1024;
+	};
+
+	/*!
+		\throws falco_exception if the file can't be opened
+	*/
+	metrics_file(const std::string& filename, const config& c);
+	~metrics_file();
+
+	metrics_file(const metrics_file&) = delete;
+	metrics_file& operator = (const metrics_file&) = delete;
+
+	/*!
+		\brief Queues a line, to which a newline is appended, dropping the
+		oldest queued lines if the backlog would exceed its maximum size
+	*/
+	void write(std::string line);
+
+	/*!
+		\brief Adds the metrics of the file to the given map, as the
+		number of lines dropped from the backlog, the bytes in the
+		backlog, the number of write errors, and the ones of fd_writer
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	// all of these are only called by the writer thread
+	void open_file();
+	void close_file();
+	void rotate();
+	void writer() noexcept;
+
+	std::string m_filename;
+	config m_config;
+	int m_fd = -1;
+	uint64_t m_file_size = 0;
+	outputs::fd_writer m_writer;
+
+	mutable std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::deque<std::string> m_backlog;
+	uint64_t m_backlog_bytes = 0;
+	bool m_stop = false;
+	std::thread m_thread;
+
+	std::atomic<uint64_t> m_dropped_lines{0};
+	std::atomic<uint64_t> m_write_errors{0};
+};
+
+} // namespace falco
@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include "otlp_exporter.h"
+#include "config_falco.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
+using namespace falco;
+
+#define CHECK_RES(fn) res = res == CURLE_OK ? fn : res
+
+// The spans are sent at least once per second, or as soon as there are
+// enough of them for a request, and dropped beyond a few requests' worth
+static constexpr std::chrono::milliseconds s_spans_interval{1000};
+static constexpr size_t s_spans_per_request = 512;
+static constexpr size_t s_max_spans = 4 * s_spans_per_request;
+
+static const char* s_metrics_path = "/v1/metrics";
+static const char* s_traces_path = "/v1/traces";
+
+// OTLP/JSON span kind INTERNAL
+static constexpr int s_span_kind_internal = 1;
+
+static size_t noop_write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+	return size * nmemb;
+}
+
+static nlohmann::json attribute(const std::string& key, const std::string& value)
+{
+	return {{"key", key}, {"value", {{"stringValue", value}}}};
+}
+
+// OTLP/JSON encodes the identifiers of traces and spans in hexadecimal
+static std::string to_hex(uint64_t v)
+{
+	char buf[17];
+	snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) v);
+	return buf;
+}
+
+static nlohmann::json scope()
+{
+	return {{"name", "falco"}, {"version", FALCO_VERSION}};
+}
+
+otlp_exporter::~otlp_exporter()
+{
+	stop();
+	curl_easy_cleanup(m_curl);
+	curl_slist_free_all(m_headers);
+}
+
+bool otlp_exporter::init(const falco_configuration::otlp_config& config, const std::string& hostname, std::string& err)
+{
+	m_config = config;
+	while(!m_config.m_endpoint.empty() && m_config.m_endpoint.back() == '/')
+	{
+		m_config.m_endpoint.pop_back();
+	}
+
+	m_resource = {{"attributes", nlohmann::json::array({
+		attribute("service.name", m_config.m_service_name),
+		attribute("service.version", FALCO_VERSION),
+		attribute("host.name", hostname)
+	})}};
+
+	m_curl = curl_easy_init();
+	if(!m_curl)
+	{
+		err = "libcurl failed to initialize the handle";
+		return false;
+	}
+	m_headers = curl_slist_append(m_headers, "Content-Type: application/json");
+	for(const auto& h : m_config.m_headers)
+	{
+		m_headers = curl_slist_append(m_headers, h.c_str());
+	}
+
+	CURLcode res = CURLE_OK;
+	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_headers));
+	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_USERAGENT, "falcosecurity/falco"));
+	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_TIMEOUT_MS, (long) m_config.m_timeout_ms));
+	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_NOSIGNAL, 1L));
+	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, noop_write_callback));
+	if(res != CURLE_OK)
+	{
+		err = "libcurl error: " + std::string(curl_easy_strerror(res));
+		return false;
+	}
+
+	m_rng.seed(std::random_device{}());
+	m_thread = std::thread(&otlp_exporter::sender, this);
+	return true;
+}
+
+void otlp_exporter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_stop = true;
+	}
+	m_cv.notify_one();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void otlp_exporter::export_metrics(uint64_t ts, const std::string& source, const nlohmann::json& output_fields)
+{
+	enqueue({s_metrics_path, metrics_request(m_resource, ts, source, output_fields)});
+}
+
+bool otlp_exporter::sample_alert(trace_id& trace, uint64_t& span_id)
+{
+	double ratio = m_config.m_traces_sampling_ratio;
+	if(ratio <= 0)
+	{
+		return false;
+	}
+	if(ratio < 1)
+	{
+		// the sampled alerts are evenly spaced, one every 1/ratio
+		uint64_t n = m_num_alerts.fetch_add(1, std::memory_order_relaxed);
+		if(uint64_t(double(n + 1) * ratio) == uint64_t(double(n) * ratio))
+		{
+			return false;
+		}
+	}
+
+	std::lock_guard<std::mutex> lk(m_rng_mtx);
+	do
+	{
+		trace = {m_rng(), m_rng()};
+	}
+	while(trace[0] == 0 && trace[1] == 0);
+	do
+	{
+		span_id = m_rng();
+	}
+	while(span_id == 0);
+	return true;
+}
+
+uint64_t otlp_exporter::new_span_id()
+{
+	std::lock_guard<std::mutex> lk(m_rng_mtx);
+	uint64_t res;
+	do
+	{
+		res = m_rng();
+	}
+	while(res == 0);
+	return res;
+}
+
+void otlp_exporter::export_span(span&& s)
+{
+	bool flush = false;
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(m_spans.size() >= s_max_spans)
+		{
+			m_num_dropped_spans.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_spans.push_back(std::move(s));
+		flush = m_spans.size() == s_spans_per_request;
+	}
+	if(flush)
+	{
+		m_cv.notify_one();
+	}
+}
+
+void otlp_exporter::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["requests"] = m_num_requests.load(std::memory_order_relaxed);
+	metrics["failed_requests"] = m_num_failed_requests.load(std::memory_order_relaxed);
+	metrics["dropped_requests"] = m_num_dropped_requests.load(std::memory_order_relaxed);
+	metrics["spans"] = m_num_spans.load(std::memory_order_relaxed);
+	metrics["dropped_spans"] = m_num_dropped_spans.load(std::memory_order_relaxed);
+}
+
+std::string otlp_exporter::traces_request(const nlohmann::json& resource, const std::vector<span>& spans)
+{
+	nlohmann::json jspans = nlohmann::json::array();
+	for(const auto& s : spans)
+	{
+		nlohmann::json attrs = nlohmann::json::array();
+		for(const auto& a : s.attributes)
+		{
+			attrs.push_back(attribute(a.first, a.second));
+		}
+		nlohmann::json js = {
+			{"traceId", to_hex(s.trace[0]) + to_hex(s.trace[1])},
+			{"spanId", to_hex(s.span_id)},
+			{"name", s.name},
+			{"kind", s_span_kind_internal},
+			{"startTimeUnixNano", std::to_string(s.start_ts)},
+			{"endTimeUnixNano", std::to_string(s.end_ts)},
+			{"attributes", std::move(attrs)}
+		};
+		if(s.parent_span_id != 0)
+		{
+			js["parentSpanId"] = to_hex(s.parent_span_id);
+		}
+		jspans.push_back(std::move(js));
+	}
+
+	nlohmann::json req;
+	req["resourceSpans"] = nlohmann::json::array({{
+		{"resource", resource},
+		{"scopeSpans", nlohmann::json::array({{{"scope", scope()}, {"spans", std::move(jspans)}}})}
+	}});
+	return req.dump();
+}
+
+std::string otlp_exporter::metrics_request(const nlohmann::json& resource, uint64_t ts, const std::string& source, const nlohmann::json& output_fields)
+{
+	auto ts_str = std::to_string(ts);
+	auto attrs = nlohmann::json::array({attribute("source", source)});
+	nlohmann::json metrics = nlohmann::json::array();
+	for(const auto& item : output_fields.items())
+	{
+		const auto& v = item.value();
+		nlohmann::json point = {{"timeUnixNano", ts_str}, {"attributes", attrs}};
+		// OTLP integers are signed 64 bit
+		if(v.is_number_unsigned() && v.get<uint64_t>() <= (uint64_t) INT64_MAX)
+		{
+			point["asInt"] = std::to_string(v.get<uint64_t>());
+		}
+		else if(v.is_number_integer() && !v.is_number_unsigned())
+		{
+			point["asInt"] = std::to_string(v.get<int64_t>());
+		}
+		else if(v.is_number() && std::isfinite(v.get<double>()))
+		{
+			point["asDouble"] = v.get<double>();
+		}
+		else
+		{
+			// the strings of the snapshot, e.g. the versions, are not metrics
+			continue;
+		}
+		metrics.push_back({
+			{"name", item.key()},
+			{"gauge", {{"dataPoints", nlohmann::json::array({std::move(point)})}}}
+		});
+	}
+
+	nlohmann::json req;
+	req["resourceMetrics"] = nlohmann::json::array({{
+		{"resource", resource},
+		{"scopeMetrics", nlohmann::json::array({{{"scope", scope()}, {"metrics", std::move(metrics)}}})}
+	}});
+	return req.dump();
+}
+
+void otlp_exporter::enqueue(request&& r)
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(m_stop || m_requests.size() >= m_config.m_max_queued_requests)
+		{
+			m_num_dropped_requests.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_requests.push_back(std::move(r));
+	}
+	m_cv.notify_one();
+}
+
+void otlp_exporter::flush_spans(std::unique_lock<std::mutex>& lk)
+{
+	while(!m_spans.empty())
+	{
+		std::vector<span> spans;
+		if(m_spans.size() > s_spans_per_request)
+		{
+			spans.assign(std::make_move_iterator(m_spans.begin()), std::make_move_iterator(m_spans.begin() + s_spans_per_request));
+			m_spans.erase(m_spans.begin(), m_spans.begin() + s_spans_per_request);
+		}
+		else
+		{
+			spans.swap(m_spans);
+		}
+		lk.unlock();
+		auto n = spans.size();
+		auto body = traces_request(m_resource, spans);
+		lk.lock();
+		if(m_requests.size() >= m_config.m_max_queued_requests)
+		{
+			m_num_dropped_requests.fetch_add(1, std::memory_order_relaxed);
+			m_num_dropped_spans.fetch_add(n, std::memory_order_relaxed);
+			continue;
+		}
+		m_num_spans.fetch_add(n, std::memory_order_relaxed);
+		m_requests.push_back({s_traces_path, std::move(body)});
+	}
+}
+
+void otlp_exporter::send(const request& r)
+{
+	auto url = m_config.m_endpoint + r.path;
+	curl_easy_setopt(m_curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(r.body.size()));
+	curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, r.body.data());
+	CURLcode res = curl_easy_perform(m_curl);
+
+	long code = 0;
+	curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &code);
+	if(res == CURLE_OK && code < 400)
+	{
+		m_num_requests.fetch_add(1, std::memory_order_relaxed);
+		m_failing = false;
+		return;
+	}
+
+	m_num_failed_requests.fetch_add(1, std::memory_order_relaxed);
+	if(!m_failing)
+	{
+		m_failing = true;
+		std::string reason = res != CURLE_OK
+			? "libcurl failed to perform call: " + std::string(curl_easy_strerror(res))
+			: "server replied with status code " + std::to_string(code);
+		falco_logger::log(falco_logger::level::ERR, "otlp exporter: " + reason + "\n");
+	}
+}
+
+void otlp_exporter::sender() noexcept
+{
+	thread_affinity::apply(thread_affinity::STATS);
+	auto next_spans = std::chrono::steady_clock::now() + s_spans_interval;
+	std::chrono::steady_clock::time_point deadline;
+	std::unique_lock<std::mutex> lk(m_mtx);
+	while(true)
+	{
+		m_cv.wait_until(lk, next_spans, [this]
+		{
+			return m_stop || !m_requests.empty() || m_spans.size() >= s_spans_per_request;
+		});
+
+		auto now = std::chrono::steady_clock::now();
+		if(m_stop || now >= next_spans || m_spans.size() >= s_spans_per_request)
+		{
+			flush_spans(lk);
+			next_spans = now + s_spans_interval;
+		}
+		if(m_stop && deadline == std::chrono::steady_clock::time_point())
+		{
+			deadline = now + std::chrono::milliseconds(m_config.m_timeout_ms);
+		}
+
+		while(!m_requests.empty())
+		{
+			if(m_stop && std::chrono::steady_clock::now() >= deadline)
+			{
+				m_num_dropped_requests.fetch_add(m_requests.size(), std::memory_order_relaxed);
+				m_requests.clear();
+				break;
+			}
+			auto r = std::move(m_requests.front());
+			m_requests.pop_front();
+			lk.unlock();
+			send(r);
+			lk.lock();
+		}
+
+		if(m_stop)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+#include "configuration.h"
+
+namespace falco
+{
+
+/*!
+	\brief Exports the metrics snapshots of Falco and the timings of a
+	sample of its alerts to an OpenTelemetry collector, with OTLP over HTTP
+	and its JSON encoding. The metrics are sent as gauges to the
+	/v1/metrics path of the endpoint, and the timings as spans to its
+	/v1/traces path. The callers only build the requests, which are sent
+	one at a time by a dedicated thread: when the collector can't keep up
+	and the maximum number of requests are waiting, the new ones are
+	dropped and counted, so that exporting never blocks the callers.
+	This class is thread-safe.
+*/
+class otlp_exporter
+{
+public:
+	typedef std::array<uint64_t, 2> trace_id;
+
+	/*!
+		\brief A finished span of a trace, with times in nanoseconds since
+		the epoch. A parent_span_id of zero marks the root of the trace.
+	*/
+	struct span
+	{
+		trace_id trace = {};
+		uint64_t span_id = 0;
+		uint64_t parent_span_id = 0;
+		std::string name;
+		uint64_t start_ts = 0;
+		uint64_t end_ts = 0;
+		std::vector<std::pair<std::string, std::string>> attributes;
+	};
+
+	otlp_exporter() = default;
+	~otlp_exporter();
+
+	otlp_exporter(const otlp_exporter&) = delete;
+	otlp_exporter& operator = (const otlp_exporter&) = delete;
+
+	/*!
+		\brief Starts exporting to the configured endpoint, on behalf of
+		the given host. Returns false and sets err on failure.
+	*/
+	bool init(const falco_configuration::otlp_config& config, const std::string& hostname, std::string& err);
+
+	/*!
+		\brief Sends the spans not sent yet and the queued requests, for
+		at most the configured timeout, and stops the sending thread
+	*/
+	void stop();
+
+	inline bool metrics_enabled() const
+	{
+		return m_config.m_metrics_enabled;
+	}
+
+	inline bool traces_enabled() const
+	{
+		return m_config.m_traces_sampling_ratio > 0;
+	}
+
+	/*!
+		\brief Exports the numeric output fields of a metrics snapshot of
+		the given event source, taken at time ts, as gauges
+	*/
+	void export_metrics(uint64_t ts, const std::string& source, const nlohmann::json& output_fields);
+
+	/*!
+		\brief Returns true if the next alert is part of the sample to
+		trace, in which case a new trace and root span are assigned to it
+	*/
+	bool sample_alert(trace_id& trace, uint64_t& span_id);
+
+	/*!
+		\brief Returns a new span identifier, never zero
+	*/
+	uint64_t new_span_id();
+
+	/*!
+		\brief Exports a finished span, which is sent along with the
+		other ones of the same second
+	*/
+	void export_span(span&& s);
+
+	/*!
+		\brief Returns the number of requests and spans sent, failed and
+		dropped since the exporter started
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+	/*!
+		\brief Returns the body of the request exporting the given spans,
+		as resource spans of the given resource attributes
+	*/
+	static std::string traces_request(const nlohmann::json& resource, const std::vector<span>& spans);
+
+	/*!
+		\brief Returns the body of the request exporting the numeric output
+		fields of a metrics snapshot as gauges, with the event source as
+		attribute of their data points, as resource metrics of the given
+		resource attributes
+	*/
+	static std::string metrics_request(const nlohmann::json& resource, uint64_t ts, const std::string& source, const nlohmann::json& output_fields);
+
+private:
+	struct request
+	{
+		std::string path;
+		std::string body;
+	};
+
+	void sender() noexcept;
+	void enqueue(request&& r);
+	void send(const request& r);
+	void flush_spans(std::unique_lock<std::mutex>& lk);
+
+	falco_configuration::otlp_config m_config;
+	nlohmann::json m_resource;
+	CURL* m_curl = nullptr;
+	curl_slist* m_headers = nullptr;
+	// only used by the sending thread, to log failures once in a row
+	bool m_failing = false;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::deque<request> m_requests;
+	std::vector<span> m_spans;
+	bool m_stop = false;
+	std::thread m_thread;
+
+	std::mutex m_rng_mtx;
+	std::mt19937_64 m_rng;
+	std::atomic<uint64_t> m_num_alerts{0};
+
+	std::atomic<uint64_t> m_num_requests{0};
+	std::atomic<uint64_t> m_num_failed_requests{0};
+	std::atomic<uint64_t> m_num_dropped_requests{0};
+	std::atomic<uint64_t> m_num_spans{0};
+	std::atomic<uint64_t> m_num_dropped_spans{0};
+};
+
+} // namespace falco
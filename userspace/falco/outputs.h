@@ -17,11 +17,19 @@ limitations under the License.
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <string>
 #include <map>
+#include <mutex>
+#include <set>
+#include <vector>
 
 #include "falco_common.h"
-#include <nlohmann/json.hpp>
+#include "falco_utils.h"
+#include "field_values.h"
+#include "interned.h"
 
 namespace falco
 {
@@ -32,10 +40,135 @@ namespace outputs
 // The way to refer to an output (file, syslog, stdout, etc.)
 // An output has a name and set of options.
 //
+//
+// Which alerts are delivered to an output, by default all of them. An
+// alert is delivered if it's at least as severe as min_priority, and if
+// it matches each of the other criteria that are set: its source is one
+// of sources, it has one of tags and none of exclude_tags, and its rule
+// matches one of the rules patterns, which can contain '*' wildcards.
+//
+struct route
+{
+	falco_common::priority_type min_priority = falco_common::PRIORITY_DEBUG;
+	std::set<std::string> sources;
+	std::set<std::string> tags;
+	std::set<std::string> exclude_tags;
+	std::vector<std::string> rules;
+
+	inline bool accepts_all() const
+	{
+		return min_priority == falco_common::PRIORITY_DEBUG && sources.empty()
+			&& tags.empty() && exclude_tags.empty() && rules.empty();
+	}
+
+	inline bool accepts(falco_common::priority_type priority, const std::string& source,
+		const std::set<std::string>& alert_tags, const std::string& rule) const
+	{
+		// the cheapest criteria go first
+		if(priority > min_priority)
+		{
+			return false;
+		}
+		if(!sources.empty() && sources.count(source) == 0)
+		{
+			return false;
+		}
+		if(!tags.empty() && !std::any_of(alert_tags.begin(), alert_tags.end(),
+			[this](const std::string& t) { return tags.count(t) > 0; }))
+		{
+			return false;
+		}
+		if(!exclude_tags.empty() && std::any_of(alert_tags.begin(), alert_tags.end(),
+			[this](const std::string& t) { return exclude_tags.count(t) > 0; }))
+		{
+			return false;
+		}
+		return rules.empty() || std::any_of(rules.begin(), rules.end(),
+			[&rule](const std::string& p) { return falco::utils::matches_wildcard(p, rule); });
+	}
+};
+
 struct config
 {
 	std::string name;
 	std::map<std::string, std::string> options;
+	falco::outputs::route route;
+	// when not empty, the only output fields (and "output" and "tags"
+	// properties) of the JSON and protobuf alerts written by the output
+	std::set<std::string> projection;
+};
+
+//
+// How the queued alerts are drained when the outputs are stopped (e.g.
+// at shutdown or when reloading the configuration)
+//
+struct drain_config
+{
+	// the maximum time spent delivering them, after which the remaining
+	// ones are spilled to disk, if possible, or discarded
+	uint64_t timeout_ms = 5000;
+	// the maximum number each output delivers, or 0 for no limit
+	uint64_t max_alerts = 0;
+};
+
+//
+// The encodings of the alerts written by the outputs
+//
+enum class encoding
+{
+	// the alert as formatted by Falco, as text or as JSON
+	TEXT = 0,
+	// the alert as a falco.outputs.response protobuf message (see
+	// outputs.proto), the same that's streamed by the gRPC output
+	PROTOBUF = 1,
+};
+
+struct message;
+
+//
+// The encoded forms of a message, each of which is computed at most once,
+// by the first output that needs it, and shared by all the others, which
+// can run in different threads. Copies start empty.
+//
+class encoded_message
+{
+public:
+	encoded_message() = default;
+	encoded_message(const encoded_message&) { }
+	encoded_message& operator = (const encoded_message&)
+	{
+		clear();
+		return *this;
+	}
+
+	//
+	// Returns msg in the given encoding, encoding it if that's not done
+	// yet (see outputs_encoding.h)
+	//
+	const std::string& get(encoding e, const message& msg, const std::string& hostname) const;
+
+	//
+	// Forgets the encoded forms, keeping their buffers. This must be
+	// called whenever the message changes.
+	//
+	inline void clear()
+	{
+		m_ready.store(0, std::memory_order_relaxed);
+	}
+
+	//
+	// Returns the bytes allocated for the encoded forms. This must not
+	// be called while other threads may be encoding the message.
+	//
+	inline size_t memory_usage() const
+	{
+		return m_data[0].capacity() + m_data[1].capacity();
+	}
+
+private:
+	mutable std::mutex m_mtx;
+	mutable std::atomic<uint32_t> m_ready{0};
+	mutable std::array<std::string, 2> m_data;
 };
 
 //
@@ -48,10 +181,12 @@ struct message
 	uint64_t ts;
 	falco_common::priority_type priority;
 	std::string msg;
-	std::string rule;
-	std::string source;
-	nlohmann::json fields;
-	std::set<std::string> tags;
+	falco::interned_string rule;
+	falco::interned_string source;
+	falco::field_values fields;
+	falco::interned_tags tags;
+
+	encoded_message encoded;
 };
 
 //
@@ -90,6 +225,29 @@ public:
 	// Possibly flush the output.
 	virtual void cleanup() {}
 
+	// Invoked when no more messages are queued for the output, e.g. to
+	// write the ones collected so far when they are written in batches.
+	virtual void idle() {}
+
+	// Add the output-specific metrics to the given map, by metric name.
+	// This can be invoked from any thread while the output is running.
+	virtual void get_metrics(std::map<std::string, uint64_t>& metrics) const {}
+
+	// Return the maximum number of alerts that the output can accept
+	// without having delivered them yet, e.g. because they wait for its
+	// clients in a queue of its own, or 0 if it doesn't keep any.
+	virtual size_t backlog_capacity() const { return 0; }
+
+	// Return the number of alerts accepted but not delivered yet. They
+	// count against the queue of the output when admitting alerts, so
+	// that an output falling behind sheds the least severe ones first.
+	// This can be invoked from any thread while the output is running.
+	virtual size_t backlog() const { return 0; }
+
+	// Return whether the output reads the field values of the alerts,
+	// which are otherwise not extracted. This is invoked after init().
+	virtual bool uses_fields() const { return false; }
+
 protected:
 	config m_oc;
 	bool m_buffered;
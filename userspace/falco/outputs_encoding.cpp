@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "outputs_encoding.h"
+
+// the field numbers of falco.outputs.response and
+// google.protobuf.Timestamp, see outputs.proto
+enum response_field : uint32_t
+{
+	RESPONSE_TIME = 1,
+	RESPONSE_PRIORITY = 2,
+	RESPONSE_SOURCE_DEPRECATED = 3,
+	RESPONSE_RULE = 4,
+	RESPONSE_OUTPUT = 5,
+	RESPONSE_OUTPUT_FIELDS = 6,
+	RESPONSE_HOSTNAME = 7,
+	RESPONSE_TAGS = 8,
+	RESPONSE_SOURCE = 9,
+	TIMESTAMP_SECONDS = 1,
+	TIMESTAMP_NANOS = 2,
+	MAP_KEY = 1,
+	MAP_VALUE = 2,
+};
+
+// the values of falco.schema.source, see schema.proto
+enum schema_source : uint64_t
+{
+	SOURCE_SYSCALL = 0,
+	SOURCE_K8S_AUDIT = 1,
+	SOURCE_INTERNAL = 2,
+	SOURCE_PLUGIN = 3,
+};
+
+static const uint32_t s_wire_varint = 0;
+static const uint32_t s_wire_len = 2;
+
+static inline void put_varint(std::string& out, uint64_t v)
+{
+	while(v >= 0x80)
+	{
+		out.push_back((char) (v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((char) v);
+}
+
+static inline size_t varint_size(uint64_t v)
+{
+	size_t n = 1;
+	while(v >= 0x80)
+	{
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static inline void put_tag(std::string& out, uint32_t field, uint32_t wire_type)
+{
+	put_varint(out, (field << 3) | wire_type);
+}
+
+// proto3 omits the fields having the default value
+static inline void put_varint_field(std::string& out, uint32_t field, uint64_t v)
+{
+	if(v != 0)
+	{
+		put_tag(out, field, s_wire_varint);
+		put_varint(out, v);
+	}
+}
+
+static inline void put_string_field(std::string& out, uint32_t field, const std::string& s)
+{
+	if(!s.empty())
+	{
+		put_tag(out, field, s_wire_len);
+		put_varint(out, s.size());
+		out.append(s);
+	}
+}
+
+bool falco::outputs::parse_encoding(const std::string& name, encoding& out)
+{
+	if(name.empty() || name == "text")
+	{
+		out = encoding::TEXT;
+		return true;
+	}
+	if(name == "protobuf")
+	{
+		out = encoding::PROTOBUF;
+		return true;
+	}
+	return false;
+}
+
+const std::string& falco::outputs::encoded_message::get(encoding e, const message& msg, const std::string& hostname) const
+{
+	if(e == encoding::TEXT)
+	{
+		return msg.msg;
+	}
+
+	// the encoded forms never change once ready, so the lock is only
+	// taken by the first outputs asking for each of them
+	uint32_t bit = 1u << (uint32_t) e;
+	auto& data = m_data[(size_t) e];
+	if((m_ready.load(std::memory_order_acquire) & bit) == 0)
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if((m_ready.load(std::memory_order_relaxed) & bit) == 0)
+		{
+			encode_protobuf(msg, hostname, data);
+			m_ready.fetch_or(bit, std::memory_order_release);
+		}
+	}
+	return data;
+}
+
+void falco::outputs::encode_json(const message& msg, const std::string& hostname, bool include_output, bool include_tags, std::string& out)
+{
+	// the keys are sorted, as in the alerts formatted by Falco
+	out.clear();
+	out += "{\"hostname\":";
+	falco::utils::append_json_string(out, hostname);
+	if(include_output)
+	{
+		out += ",\"output\":";
+		falco::utils::append_json_string(out, msg.msg);
+	}
+	out += ",\"priority\":";
+	falco::utils::append_json_string(out, falco_common::format_priority(msg.priority));
+	out += ",\"rule\":";
+	falco::utils::append_json_string(out, msg.rule);
+	out += ",\"source\":";
+	falco::utils::append_json_string(out, msg.source);
+	if(include_tags)
+	{
+		out += ",\"tags\":[";
+		bool first = true;
+		for(const auto& tag : *msg.tags)
+		{
+			if(!first)
+			{
+				out += ',';
+			}
+			first = false;
+			falco::utils::append_json_string(out, tag);
+		}
+		out += ']';
+	}
+	out += ",\"time\":\"";
+	falco::utils::append_iso8601_utc(out, msg.ts);
+	out += "\", \"output_fields\": ";
+	falco::append_json(out, msg.fields);
+	out += '}';
+}
+
+void falco::outputs::project(const message& msg, const std::set<std::string>& projection, bool json,
+	const std::string& hostname, message& out)
+{
+	bool keep_output = projection.count("output") > 0;
+	bool keep_tags = projection.count("tags") > 0;
+
+	out.ts = msg.ts;
+	out.priority = msg.priority;
+	out.rule = msg.rule;
+	out.source = msg.source;
+	out.tags = keep_tags ? msg.tags : falco::interned_tags();
+	out.fields.clear();
+	for(const auto& f : msg.fields)
+	{
+		if(projection.count(f.first) > 0)
+		{
+			out.fields.push_back(f);
+		}
+	}
+	out.encoded.clear();
+
+	// the line of JSON alerts is only rendered as part of them, so
+	// projected JSON alerts never have it
+	out.msg.clear();
+	if(json)
+	{
+		encode_json(out, hostname, false, keep_tags, out.msg);
+	}
+	else if(keep_output)
+	{
+		out.msg = msg.msg;
+	}
+}
+
+void falco::outputs::append_length_prefix(std::string& out, size_t len)
+{
+	put_varint(out, len);
+}
+
+void falco::outputs::encode_protobuf(const message& msg, const std::string& hostname, std::string& out)
+{
+	out.clear();
+
+	uint64_t secs = msg.ts / 1000000000;
+	uint64_t nanos = msg.ts % 1000000000;
+	if(msg.ts != 0)
+	{
+		put_tag(out, RESPONSE_TIME, s_wire_len);
+		put_varint(out, (secs ? 1 + varint_size(secs) : 0) + (nanos ? 1 + varint_size(nanos) : 0));
+		put_varint_field(out, TIMESTAMP_SECONDS, secs);
+		put_varint_field(out, TIMESTAMP_NANOS, nanos);
+	}
+
+	// the priorities have the same values in falco_common and schema.proto
+	put_varint_field(out, RESPONSE_PRIORITY, (uint64_t) msg.priority);
+
+	// the names are matched as the enum aliases of schema.proto, and
+	// unknown ones are expected to come from plugins
+	const std::string& source = msg.source;
+	uint64_t source_deprecated = SOURCE_PLUGIN;
+	if(source == "syscall" || source == "SYSCALL" || source == "Syscall")
+	{
+		source_deprecated = SOURCE_SYSCALL;
+	}
+	else if(source == "k8s_audit" || source == "K8S_AUDIT" || source == "K8s_audit" || source == "K8S_audit")
+	{
+		source_deprecated = SOURCE_K8S_AUDIT;
+	}
+	else if(source == "internal" || source == "INTERNAL" || source == "Internal")
+	{
+		source_deprecated = SOURCE_INTERNAL;
+	}
+	put_varint_field(out, RESPONSE_SOURCE_DEPRECATED, source_deprecated);
+
+	put_string_field(out, RESPONSE_RULE, msg.rule);
+	put_string_field(out, RESPONSE_OUTPUT, msg.msg);
+
+	// map entries are messages with the key and the value, which are
+	// always written as the protobuf library does
+	std::string value;
+	for(const auto& f : msg.fields)
+	{
+		const std::string& key = f.first;
+		value.clear();
+		f.second.append_text(value);
+		put_tag(out, RESPONSE_OUTPUT_FIELDS, s_wire_len);
+		put_varint(out, 1 + varint_size(key.size()) + key.size() + 1 + varint_size(value.size()) + value.size());
+		put_tag(out, MAP_KEY, s_wire_len);
+		put_varint(out, key.size());
+		out.append(key);
+		put_tag(out, MAP_VALUE, s_wire_len);
+		put_varint(out, value.size());
+		out.append(value);
+	}
+
+	put_string_field(out, RESPONSE_HOSTNAME, hostname);
+	for(const auto& tag : *msg.tags)
+	{
+		put_tag(out, RESPONSE_TAGS, s_wire_len);
+		put_varint(out, tag.size());
+		out.append(tag);
+	}
+	put_string_field(out, RESPONSE_SOURCE, source);
+}
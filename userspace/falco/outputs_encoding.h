@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "outputs.h"
+
+#include <set>
+#include <string>
+
+namespace falco
+{
+namespace outputs
+{
+
+/*!
+	\brief Parses the encoding option of an output, which defaults to
+	text when empty. Returns false if the name is unknown.
+*/
+bool parse_encoding(const std::string& name, encoding& out);
+
+/*!
+	\brief Encodes msg as a falco.outputs.response protobuf message into
+	out, replacing its content
+*/
+void encode_protobuf(const message& msg, const std::string& hostname, std::string& out);
+
+/*!
+	\brief Encodes msg as a JSON alert into out, replacing its content, with
+	the same keys as the ones formatted by Falco. The output line and the
+	tags are only included when include_output and include_tags are set.
+*/
+void encode_json(const message& msg, const std::string& hostname, bool include_output, bool include_tags, std::string& out);
+
+/*!
+	\brief Copies msg into out keeping only the output fields in the given
+	projection, as well as the tags and the output line only when the
+	projection has "tags" and "output". The time, priority, rule and source
+	are always kept. When json is set, the line of out is the JSON alert of
+	what's kept, which never has the output line of msg, as that is only
+	rendered as part of its own JSON alert. Otherwise, out is meant to be
+	encoded as protobuf.
+*/
+void project(const message& msg, const std::set<std::string>& projection, bool json,
+	const std::string& hostname, message& out);
+
+/*!
+	\brief Appends the length of a record as a varint to out, which is how
+	protobuf messages are delimited in a stream
+*/
+void append_length_prefix(std::string& out, size_t len);
+
+/*!
+	\brief Returns the size of the length prefix of a record of len bytes
+*/
+inline size_t length_prefix_size(size_t len)
+{
+	size_t n = 1;
+	while(len >= 0x80)
+	{
+		len >>= 7;
+		n++;
+	}
+	return n;
+}
+
+} // namespace outputs
+} // namespace falco
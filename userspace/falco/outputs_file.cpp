@@ -16,46 +16,352 @@ limitations under the License.
 */
 
 #include "outputs_file.h"
-#include <iostream>
-#include <fstream>
+#include "falco_utils.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static uint64_t get_uint_option(const falco::outputs::config& oc, const std::string& name, uint64_t def)
+{
+	auto it = oc.options.find(name);
+	if(it == oc.options.end() || it->second.empty())
+	{
+		return def;
+	}
+	return std::stoull(it->second);
+}
+
+falco::outputs::output_file::~output_file()
+{
+	if(m_flusher.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		m_flusher.join();
+	}
+
+	std::lock_guard<std::mutex> lk(m_mtx);
+	try
+	{
+		close_file();
+	}
+	catch(const std::exception& e)
+	{
+		falco_logger::log(falco_logger::level::ERR, std::string(e.what()) + "\n");
+	}
+}
+
+bool falco::outputs::output_file::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
+		return false;
+	}
+
+	uint64_t buffer_size = 0;
+	uint64_t compression_level = 6;
+	try
+	{
+		buffer_size = get_uint_option(m_oc, "buffer_size", 0);
+		compression_level = get_uint_option(m_oc, "compression_level", 6);
+		m_flush_interval = std::chrono::milliseconds(get_uint_option(m_oc, "flush_interval_ms", 0));
+		m_rotate_max_size = get_uint_option(m_oc, "rotate_max_size", 0);
+		m_rotate_max_files = get_uint_option(m_oc, "rotate_max_files", 5);
+	}
+	catch(const std::exception& e)
+	{
+		err = "file output: invalid option value: " + std::string(e.what());
+		return false;
+	}
+
+	const auto& interval = m_oc.options["rotate_interval"];
+	m_rotate_interval = std::chrono::milliseconds(falco::utils::parse_prometheus_interval(interval));
+	if(!interval.empty() && m_rotate_interval.count() == 0)
+	{
+		err = "file output: invalid rotation interval '" + interval + "'";
+		return false;
+	}
+
+	if(!parse_encoding(m_oc.options["encoding"], m_encoding))
+	{
+		err = "file output: invalid encoding '" + m_oc.options["encoding"] + "'";
+		return false;
+	}
+
+	m_fsync = m_oc.options["fsync"] == "true";
+
+	const auto& compression = m_oc.options["compression"];
+	if(compression == "gzip")
+	{
+		if(compression_level > 9 || !m_writer.enable_gzip(compression_level))
+		{
+			err = "file output: invalid gzip compression level " + std::to_string(compression_level);
+			return false;
+		}
+	}
+	else if(!compression.empty() && compression != "none")
+	{
+		err = "file output: unsupported compression '" + compression + "'";
+		return false;
+	}
+
+	// an explicitly sized buffer needs the file to be kept open, buffered
+	// outputs that keep the file open use a default-sized one, and in any
+	// other case the alerts are written once no more are queued. The
+	// compressed stream is only flushed at the flush interval, as doing it
+	// for each write would defeat the compression.
+	bool compressed = m_writer.compressed();
+	m_keep_open = buffer_size > 0 || compressed || m_oc.options["keep_alive"] == "true";
+	m_write_on_idle = buffer_size == 0 && !compressed && !(m_buffered && m_keep_open);
+	m_writer.set_capacity(buffer_size > 0 ? buffer_size : (m_write_on_idle || compressed ? 64 * 1024 : BUFSIZ));
+
+	if((buffer_size > 0 || compressed) && m_flush_interval.count() > 0)
+	{
+		m_flusher = std::thread(&output_file::flusher, this);
+	}
+	return true;
+}
 
 void falco::outputs::output_file::open_file()
 {
-	if(!m_buffered)
+	if(m_fd >= 0)
+	{
+		return;
+	}
+
+	const auto& filename = m_oc.options["filename"];
+#ifdef _WIN32
+	m_fd = _open(filename.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	m_fd = open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+#endif
+	if(m_fd < 0)
+	{
+		throw falco_exception("failed to open output file " + filename + ": " + std::strerror(errno));
+	}
+	m_writer.set_fd(m_fd);
+
+	struct stat st;
+	m_file_size = fstat(m_fd, &st) == 0 ? st.st_size : 0;
+	m_written_mark = m_writer.bytes_written();
+	m_opened_at = clock::now();
+}
+
+void falco::outputs::output_file::close_file()
+{
+	if(m_fd < 0)
+	{
+		return;
+	}
+
+	// the file is closed even when the buffer can't be written, and the
+	// compressed stream is ended so that the file is a complete gzip file
+	std::exception_ptr err;
+	try
+	{
+		flush_buffer(true);
+	}
+	catch(...)
+	{
+		err = std::current_exception();
+	}
+#ifdef _WIN32
+	_close(m_fd);
+#else
+	close(m_fd);
+#endif
+	m_fd = -1;
+	m_writer.set_fd(-1);
+	if(err)
+	{
+		std::rethrow_exception(err);
+	}
+}
+
+void falco::outputs::output_file::flush_buffer(bool finish)
+{
+	// the compressor can hold data even when the buffer is empty
+	if((m_writer.buffered() == 0 && !m_writer.compressed()) || m_fd < 0)
+	{
+		return;
+	}
+
+	try
+	{
+		if(finish)
+		{
+			m_writer.finish();
+		}
+		else
+		{
+			m_writer.flush();
+		}
+	}
+	catch(const falco_exception& e)
+	{
+		throw falco_exception("failed to write to output file " + m_oc.options["filename"] + ": " + e.what());
+	}
+	sync_file();
+}
+
+void falco::outputs::output_file::sync_file()
+{
+	if(m_fsync)
 	{
-		m_outfile.rdbuf()->pubsetbuf(0, 0);
+#ifdef _WIN32
+		_commit(m_fd);
+#else
+		fsync(m_fd);
+#endif
 	}
-	if(!m_outfile.is_open())
+}
+
+void falco::outputs::output_file::rotate_if_needed()
+{
+	if(m_fd < 0)
+	{
+		return;
+	}
+	if(m_writer.compressed())
+	{
+		// the size of the file is the one of the compressed data
+		m_file_size += m_writer.bytes_written() - m_written_mark;
+		m_written_mark = m_writer.bytes_written();
+	}
+	if((m_rotate_max_size > 0 && m_file_size >= m_rotate_max_size)
+	   || (m_rotate_interval.count() > 0 && clock::now() >= m_opened_at + m_rotate_interval))
+	{
+		rotate();
+	}
+}
+
+void falco::outputs::output_file::rotate()
+{
+	close_file();
+
+	// <filename> becomes <filename>.1, <filename>.1 becomes <filename>.2,
+	// and so on, until <filename>.<max_files> which is removed
+	const auto& filename = m_oc.options["filename"];
+	if(m_rotate_max_files == 0)
+	{
+		std::remove(filename.c_str());
+	}
+	else
 	{
-		m_outfile.open(m_oc.options["filename"], std::fstream::app);
-		if (m_outfile.fail())
+		std::remove((filename + "." + std::to_string(m_rotate_max_files)).c_str());
+		for(uint32_t i = m_rotate_max_files - 1; i > 0; i--)
+		{
+			std::rename((filename + "." + std::to_string(i)).c_str(),
+				    (filename + "." + std::to_string(i + 1)).c_str());
+		}
+		if(std::rename(filename.c_str(), (filename + ".1").c_str()) != 0)
 		{
-			throw falco_exception("failed to open output file " + m_oc.options["filename"]);
+			falco_logger::log(falco_logger::level::ERR, "failed to rotate output file " + filename + ": " + std::strerror(errno) + "\n");
 		}
 	}
+
+	open_file();
 }
 
 void falco::outputs::output_file::output(const message *msg)
 {
+	std::lock_guard<std::mutex> lk(m_mtx);
 	open_file();
-	m_outfile << msg->msg + "\n";
 
-	if(m_oc.options["keep_alive"] != "true")
+	try
+	{
+		if(m_encoding == encoding::PROTOBUF)
+		{
+			const auto& data = msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname);
+			m_writer.write_delimited(data);
+			if(!m_writer.compressed())
+			{
+				m_file_size += length_prefix_size(data.size()) + data.size();
+			}
+		}
+		else
+		{
+			m_writer.write_line(msg->msg);
+			if(!m_writer.compressed())
+			{
+				m_file_size += msg->msg.size() + 1;
+			}
+		}
+	}
+	catch(const falco_exception& e)
+	{
+		throw falco_exception("failed to write to output file " + m_oc.options["filename"] + ": " + e.what());
+	}
+
+	// the buffer has just been written when it's empty
+	if(m_writer.buffered() == 0)
 	{
-		cleanup();
+		sync_file();
+		rotate_if_needed();
 	}
 }
 
-void falco::outputs::output_file::cleanup()
+void falco::outputs::output_file::idle()
+{
+	if(!m_write_on_idle)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lk(m_mtx);
+	flush_buffer();
+	rotate_if_needed();
+	if(!m_keep_open)
+	{
+		close_file();
+	}
+}
+
+void falco::outputs::output_file::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	m_writer.get_metrics(metrics);
+}
+
+void falco::outputs::output_file::flusher() noexcept
 {
-	if(m_outfile.is_open())
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	std::unique_lock<std::mutex> lk(m_mtx);
+	while(!m_cv.wait_for(lk, m_flush_interval, [this]{ return m_stop; }))
 	{
-		m_outfile.close();
+		try
+		{
+			flush_buffer();
+			rotate_if_needed();
+		}
+		catch(const std::exception& e)
+		{
+			falco_logger::log(falco_logger::level::ERR, "file: " + std::string(e.what()) + "\n");
+		}
 	}
 }
 
+void falco::outputs::output_file::cleanup()
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	close_file();
+}
+
 void falco::outputs::output_file::reopen()
 {
-	cleanup();
+	std::lock_guard<std::mutex> lk(m_mtx);
+	close_file();
 	open_file();
 }
@@ -18,26 +18,85 @@ limitations under the License.
 #pragma once
 
 #include "outputs.h"
-#include <iostream>
-#include <fstream>
+#include "outputs_encoding.h"
+#include "fd_writer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace falco
 {
 namespace outputs
 {
 
+/*!
+	\brief Appends alerts to a file, one per line, or as length-delimited
+	protobuf messages with the protobuf encoding. Alerts can be collected
+	in a userspace buffer that is written when full and at a regular
+	interval, optionally followed by an fsync, and the file can be
+	rotated by size and age. Otherwise, the alerts handled while more are
+	queued are written together. With gzip compression, the file is kept
+	open and the alerts are compressed as a stream, which is flushed at
+	the flush interval so that the file can be read while being written.
+*/
 class output_file : public abstract_output
 {
+public:
+	~output_file();
+
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+
 	void output(const message *msg) override;
 
 	void cleanup() override;
 
 	void reopen() override;
 
+	void idle() override;
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	bool uses_fields() const override
+	{
+		return m_encoding == encoding::PROTOBUF;
+	}
+
 private:
+	using clock = std::chrono::steady_clock;
+
+	// all of these must be called with m_mtx held
 	void open_file();
+	void close_file();
+	void flush_buffer(bool finish = false);
+	void sync_file();
+	void rotate_if_needed();
+	void rotate();
+
+	void flusher() noexcept;
+
+	bool m_keep_open = false;
+	bool m_write_on_idle = false;
+	bool m_fsync = false;
+	std::chrono::milliseconds m_flush_interval{0};
+	uint64_t m_rotate_max_size = 0;
+	std::chrono::milliseconds m_rotate_interval{0};
+	uint32_t m_rotate_max_files = 5;
+	encoding m_encoding = encoding::TEXT;
+
+	std::mutex m_mtx;
+	int m_fd = -1;
+	fd_writer m_writer;
+	uint64_t m_file_size = 0;
+	// with compression, the bytes written by m_writer when the file size
+	// was last updated
+	uint64_t m_written_mark = 0;
+	clock::time_point m_opened_at;
 
-	std::ofstream m_outfile;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	std::thread m_flusher;
 };
 
 } // namespace outputs
@@ -15,92 +15,71 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-#include <google/protobuf/util/time_util.h>
 #include "outputs_grpc.h"
 #include "grpc_queue.h"
 #include "falco_common.h"
-#include "formats.h"
 
-#if __has_attribute(deprecated)
-#define DISABLE_WARNING_PUSH                        _Pragma("GCC diagnostic push")
-#define DISABLE_WARNING_POP                         _Pragma("GCC diagnostic pop")
-#define DISABLE_WARNING_DEPRECATED_DECLARATIONS     _Pragma("GCC diagnostic ignored \"-Wdeprecated-declarations\"")
-#elif defined(_MSC_VER)
-#define DISABLE_WARNING_PUSH                        __pragma(warning(push))
-#define DISABLE_WARNING_POP                         __pragma(warning(pop)) 
-#define DISABLE_WARNING_DEPRECATED_DECLARATIONS     __pragma(warning(disable: 4996))
-#else
-#define DISABLE_WARNING_PUSH
-#define DISABLE_WARNING_POP
-#define DISABLE_WARNING_DEPRECATED_DECLARATIONS
-#endif
-
-void falco::outputs::output_grpc::output(const message *msg)
+bool falco::outputs::output_grpc::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
 {
-	falco::outputs::response grpc_res;
-
-	// time
-	auto timestamp = grpc_res.mutable_time();
-	*timestamp = google::protobuf::util::TimeUtil::NanosecondsToTimestamp(msg->ts);
-
-	// rule
-	auto r = grpc_res.mutable_rule();
-	*r = msg->rule;
-
-	// source_deprecated (maintained for backward compatibility)
-	// Setting this as reserved would cause old clients to receive the
-	// 0-index enum element, which is the SYSCALL source in our case.
-	// This can be misleading for clients with an old version of the
-	// protobuf, so for now we deprecate the field and add a new PLUGIN
-	// enum entry instead. 
-	// todo(jasondellaluce): remove source_deprecated and reserve its number
-	falco::schema::source s = falco::schema::source::SYSCALL;
-	if(!falco::schema::source_Parse(msg->source, &s))
+	if(!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err))
 	{
-		// unknown source names are expected to come from plugins
-		s = falco::schema::source::PLUGIN;
+		return false;
 	}
-	DISABLE_WARNING_PUSH
-	DISABLE_WARNING_DEPRECATED_DECLARATIONS
-	grpc_res.set_source_deprecated(s);
-	DISABLE_WARNING_POP
 
-	// priority
-	falco::schema::priority p = falco::schema::priority::EMERGENCY;
-	if(!falco::schema::priority_Parse(falco_common::format_priority(msg->priority), &p))
+	const auto& policy = m_oc.options["overflow_policy"];
+	if(!policy.empty())
 	{
-		throw falco_exception("Unknown priority passed to output_grpc::output()");
+		falco::grpc::queue::overflow_policy p;
+		if(!falco::grpc::queue::parse_overflow_policy(policy, p))
+		{
+			err = "grpc output: invalid overflow policy '" + policy + "', must be 'drop_oldest' or 'drop_newest'";
+			return false;
+		}
+		falco::grpc::queue::get().set_overflow_policy(p);
 	}
-	grpc_res.set_priority(p);
-
-	// output
-	auto output = grpc_res.mutable_output();
-	*output = msg->msg;
 
-	// output fields
-	auto &fields = *grpc_res.mutable_output_fields();
-	for(const auto &kv : msg->fields.items())
+	const auto& max_lag = m_oc.options["max_lag"];
+	if(!max_lag.empty())
 	{
-		if (!kv.value().is_primitive())
+		try
+		{
+			falco::grpc::queue::get().set_capacity(std::stoull(max_lag));
+		}
+		catch(const std::exception& e)
 		{
-			throw falco_exception("output_grpc: output fields must be key-value maps");
+			err = "grpc output: invalid max lag: " + std::string(e.what());
+			return false;
 		}
-		fields[kv.key()] = (kv.value().is_string())
-			? kv.value().get<std::string>()
-			: kv.value().dump();
+	}
+	return true;
+}
+
+void falco::outputs::output_grpc::output(const message *msg)
+{
+	// the response is parsed from the protobuf encoding of the alert,
+	// which is shared with the other outputs using the same encoding
+	falco::outputs::response grpc_res;
+	if(!grpc_res.ParseFromString(msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname)))
+	{
+		throw falco_exception("Failed to decode alert in output_grpc::output()");
 	}
 
-	// hostname
-	auto host = grpc_res.mutable_hostname();
-	*host = m_hostname;
+	falco::grpc::queue::get().push(grpc_res);
+}
 
-	// tags
-	auto tags = grpc_res.mutable_tags();
-	*tags = {msg->tags.begin(), msg->tags.end()};
+void falco::outputs::output_grpc::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	falco::grpc::queue::get().get_metrics(metrics);
+}
 
-	// source
-	auto source = grpc_res.mutable_source();
-	*source = msg->source;
+size_t falco::outputs::output_grpc::backlog_capacity() const
+{
+	return falco::grpc::queue::get().capacity();
+}
 
-	falco::grpc::queue::get().push(grpc_res);
+size_t falco::outputs::output_grpc::backlog() const
+{
+	// the alerts not read yet by the slowest subscriber, since nobody
+	// is behind when no client is subscribed
+	return falco::grpc::queue::get().max_lag();
 }
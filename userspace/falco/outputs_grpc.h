@@ -24,9 +24,19 @@ namespace falco
 namespace outputs
 {
 
+/*!
+	\brief Pushes the alerts to the queue of the gRPC server, which retains
+	up to max_lag of them for the subscribers to read at their own pace,
+	dropping the oldest or the newest ones according to overflow_policy
+*/
 class output_grpc : public abstract_output
 {
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
 	void output(const message *msg) override;
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+	size_t backlog_capacity() const override;
+	size_t backlog() const override;
+	bool uses_fields() const override { return true; }
 };
 
 } // namespace outputs
@@ -17,6 +17,12 @@ limitations under the License.
 
 #include "outputs_http.h"
 #include "logger.h"
+#include "thread_affinity.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <sstream>
 
 #define CHECK_RES(fn) res = res == CURLE_OK ? fn : res
 
@@ -26,14 +32,134 @@ static size_t noop_write_callback(void *contents, size_t size, size_t nmemb, voi
 	return size * nmemb;
 }
 
+static uint64_t get_uint_option(const falco::outputs::config& oc, const std::string& name, uint64_t def)
+{
+	auto it = oc.options.find(name);
+	if(it == oc.options.end() || it->second.empty())
+	{
+		return def;
+	}
+	size_t pos = 0;
+	uint64_t res = std::stoull(it->second, &pos);
+	if(pos != it->second.size())
+	{
+		throw std::invalid_argument("invalid value '" + it->second + "' for option '" + name + "'");
+	}
+	return res;
+}
+
+// If the URL is quoted the quotes should be removed to satisfy libcurl expected format
+static std::string unquote_url(const std::string& url)
+{
+	if (!url.empty() && (
+		(url.front() == '\"' && url.back() == '\"') ||
+		(url.front() == '\'' && url.back() == '\'')
+	))
+	{
+		return libsinsp::filter::unescape_str(url);
+	}
+	return url;
+}
+
+// Compresses the body with gzip, replacing its content
+static bool gzip_compress(std::string& body)
+{
+	z_stream zs = {};
+	// 16 adds the gzip header and trailer to the deflate stream
+	if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	std::string out;
+	out.resize(deflateBound(&zs, body.size()));
+	zs.next_in = reinterpret_cast<Bytef*>(&body[0]);
+	zs.avail_in = body.size();
+	zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+	zs.avail_out = out.size();
+	int res = deflate(&zs, Z_FINISH);
+	deflateEnd(&zs);
+	if(res != Z_STREAM_END)
+	{
+		return false;
+	}
+	out.resize(zs.total_out);
+	body.swap(out);
+	return true;
+}
+
+falco::outputs::output_http::~output_http()
+{
+	if(m_sender.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		curl_multi_wakeup(m_multi);
+		m_sender.join();
+	}
+
+	for(auto& t : m_transfers)
+	{
+		curl_easy_cleanup(t.curl);
+	}
+	if(m_multi)
+	{
+		curl_multi_cleanup(m_multi);
+	}
+	curl_easy_cleanup(m_curl);
+	if(m_share)
+	{
+		curl_share_cleanup(m_share);
+	}
+	curl_slist_free_all(m_http_headers);
+}
+
 bool falco::outputs::output_http::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
 {
 	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
 		return false;
 	}
 
-	m_curl = nullptr;
-	m_http_headers = nullptr;
+	uint64_t max_connections = 0;
+	try
+	{
+		max_connections = get_uint_option(m_oc, "max_connections", 0);
+		m_batch_max_alerts = std::max<uint64_t>(1, get_uint_option(m_oc, "batch_max_alerts", 1));
+		m_batch_max_bytes = std::max<uint64_t>(1, get_uint_option(m_oc, "batch_max_bytes", 1024 * 1024));
+		m_batch_linger = std::chrono::milliseconds(get_uint_option(m_oc, "batch_linger_ms", 0));
+		m_max_in_flight = std::max<uint64_t>(1, get_uint_option(m_oc, "max_in_flight", 1));
+		m_max_retries = get_uint_option(m_oc, "max_retries", 0);
+		m_retry_backoff = std::chrono::milliseconds(get_uint_option(m_oc, "retry_backoff_ms", 100));
+		m_unhealthy_after_failures = std::max<uint64_t>(1, get_uint_option(m_oc, "unhealthy_after_failures", 3));
+		m_unhealthy_interval = std::chrono::milliseconds(get_uint_option(m_oc, "unhealthy_interval_ms", 5000));
+	}
+	catch(const std::exception& e)
+	{
+		err = "http output: " + std::string(e.what());
+		return false;
+	}
+	m_max_queued = 4 * m_max_in_flight;
+
+	const auto& compression = m_oc.options["batch_compression"];
+	if(compression == "gzip")
+	{
+		m_gzip = true;
+	}
+	else if(!compression.empty() && compression != "none")
+	{
+		err = "http output: unsupported batch compression '" + compression + "'";
+		return false;
+	}
+
+	if(!parse_encoding(m_oc.options["encoding"], m_encoding))
+	{
+		err = "http output: invalid encoding '" + m_oc.options["encoding"] + "'";
+		return false;
+	}
+
 	CURLcode res = CURLE_FAILED_INIT;
 
 	m_curl = curl_easy_init();
@@ -42,29 +168,56 @@ bool falco::outputs::output_http::init(const config& oc, bool buffered, const st
 		falco_logger::log(falco_logger::level::ERR, "libcurl failed to initialize the handle: " + std::string(curl_easy_strerror(res)));
 		return false;
 	}
-	if(m_json_output)
+	if(m_encoding == encoding::PROTOBUF)
+	{
+		// batches carry length-delimited messages, whereas a single
+		// alert is sent as a plain message
+		m_http_headers = curl_slist_append(m_http_headers, "Content-Type: application/x-protobuf");
+	}
+	else if(m_json_output)
 	{
-		m_http_headers = curl_slist_append(m_http_headers, "Content-Type: application/json");
+		// batches carry one alert per line
+		m_http_headers = curl_slist_append(m_http_headers, m_batch_max_alerts > 1
+			? "Content-Type: application/x-ndjson"
+			: "Content-Type: application/json");
 	}
 	else
 	{
 		m_http_headers = curl_slist_append(m_http_headers, "Content-Type: text/plain");
 	}
+	if(m_gzip)
+	{
+		m_http_headers = curl_slist_append(m_http_headers, "Content-Encoding: gzip");
+	}
 	res = curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_http_headers);
-	
-	// if the URL is quoted the quotes should be removed to satisfy libcurl expected format
-	std::string unquotedUrl = m_oc.options["url"];
-	if (!unquotedUrl.empty() && (
-		(unquotedUrl.front() == '\"' && unquotedUrl.back() == '\"') ||
-		(unquotedUrl.front() == '\'' && unquotedUrl.back() == '\'')
-	))
+
+	// the URL of each request is the one of the endpoint it is sent to
+	std::vector<std::string> urls;
+	if(!m_oc.options["url"].empty())
+	{
+		urls.push_back(m_oc.options["url"]);
+	}
+	std::stringstream ss(m_oc.options["urls"]);
+	std::string url;
+	while(std::getline(ss, url, ','))
+	{
+		if(!url.empty())
+		{
+			urls.push_back(url);
+		}
+	}
+	if(urls.empty())
 	{
-		unquotedUrl = libsinsp::filter::unescape_str(unquotedUrl);
+		err = "http output: no url";
+		return false;
+	}
+	for(const auto& u : urls)
+	{
+		m_endpoints.push_back(std::make_unique<endpoint>());
+		m_endpoints.back()->url = unquote_url(u);
 	}
-	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_URL, unquotedUrl.c_str()));
 
 	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_USERAGENT, m_oc.options["user_agent"].c_str()));
-	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, -1L));
 
 	if(m_oc.options["insecure"] == std::string("true"))
 	{
@@ -107,28 +260,430 @@ bool falco::outputs::output_http::init(const config& oc, bool buffered, const st
 		CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPALIVE, 1L));
 	}
 
+	bool http2 = m_oc.options["http2"] == std::string("true");
+	if(http2)
+	{
+		// HTTP/2 is negotiated over TLS, falling back to HTTP/1.1, and the
+		// requests wait for a connection to multiplex over instead of
+		// opening new ones
+		CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS));
+		CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_PIPEWAIT, 1L));
+	}
+
+	// the TLS sessions and the DNS lookups are shared by all the transfers,
+	// so that new connections resume the TLS sessions of the previous ones.
+	// The transfers are all made by the sender thread, so no lock is needed.
+	m_share = curl_share_init();
+	if(!m_share)
+	{
+		err = "libcurl failed to initialize the share handle";
+		return false;
+	}
+	curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	CHECK_RES(curl_easy_setopt(m_curl, CURLOPT_SHARE, m_share));
+
 	if(res != CURLE_OK)
 	{
 		err = "libcurl error: " + std::string(curl_easy_strerror(res));
 		return false;
 	}
+
+	// the connections are kept by the multi handle and reused by all
+	// the transfers, which are copies of the handle configured above
+	m_multi = curl_multi_init();
+	if(!m_multi)
+	{
+		err = "libcurl failed to initialize the multi handle";
+		return false;
+	}
+	if(http2)
+	{
+		curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	}
+	if(max_connections > 0)
+	{
+		curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) max_connections);
+	}
+	m_transfers.resize(m_max_in_flight);
+	for(auto& t : m_transfers)
+	{
+		t.curl = curl_easy_duphandle(m_curl);
+		if(!t.curl)
+		{
+			err = "libcurl failed to initialize the handle";
+			return false;
+		}
+		curl_easy_setopt(t.curl, CURLOPT_PRIVATE, &t);
+		curl_easy_setopt(t.curl, CURLOPT_SHARE, m_share);
+	}
+
+	m_sender = std::thread(&output_http::sender, this);
 	return true;
 }
 
 void falco::outputs::output_http::output(const message *msg)
 {
-	CURLcode res = curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, msg->msg.c_str());
-	CHECK_RES(curl_easy_perform(m_curl));
+	{
+		std::unique_lock<std::mutex> lk(m_mtx);
+
+		// wait for the sender to catch up, so that a slow endpoint
+		// slows down the outputs queue instead of growing memory
+		m_cv.wait(lk, [this]{ return m_ready.size() < m_max_queued; });
+
+		if(m_batch.num_alerts == 0)
+		{
+			m_batch.created = clock::now();
+		}
+		if(m_encoding == encoding::PROTOBUF)
+		{
+			const auto& data = msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname);
+			if(m_batch_max_alerts > 1)
+			{
+				append_length_prefix(m_batch.body, data.size());
+			}
+			m_batch.body += data;
+		}
+		else
+		{
+			if(m_batch.num_alerts > 0)
+			{
+				m_batch.body += '\n';
+			}
+			m_batch.body += msg->msg;
+		}
+		m_batch.num_alerts++;
+
+		if(m_batch.num_alerts >= m_batch_max_alerts || m_batch.body.size() >= m_batch_max_bytes)
+		{
+			m_ready.push_back(std::move(m_batch));
+			m_batch = batch();
+		}
+	}
+	m_cv.notify_all();
+	curl_multi_wakeup(m_multi);
+}
+
+void falco::outputs::output_http::cleanup()
+{
+	// send everything that's pending before returning
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(!m_sender.joinable())
+	{
+		return;
+	}
+	m_flush = true;
+	m_cv.notify_all();
+	curl_multi_wakeup(m_multi);
+	m_cv.wait(lk, [this]{ return !m_flush; });
+}
+
+void falco::outputs::output_http::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["batches"] = m_num_batches.load();
+	metrics["alerts"] = m_num_alerts.load();
+	metrics["bytes"] = m_num_bytes.load();
+	metrics["failures"] = m_num_failures.load();
+	metrics["retries"] = m_num_retries.load();
+	metrics["alerts_dropped"] = m_num_alerts_dropped.load();
+	metrics["latency_us_total"] = m_latency_us_total.load();
+	metrics["latency_us_max"] = m_latency_us_max.load();
+
+	// by endpoint index, in the order of the configuration
+	for(size_t i = 0; i < m_endpoints.size(); i++)
+	{
+		const auto& e = *m_endpoints[i];
+		auto idx = "." + std::to_string(i);
+		metrics["endpoint_requests" + idx] = e.num_requests.load();
+		metrics["endpoint_failures" + idx] = e.num_failures.load();
+		metrics["endpoint_latency_us_total" + idx] = e.latency_us_total.load();
+		metrics["endpoint_latency_us_max" + idx] = e.latency_us_max.load();
+		metrics["endpoint_healthy" + idx] = e.healthy.load() ? 1 : 0;
+	}
+}
+
+// Whether an endpoint other than the given one can take requests now
+bool falco::outputs::output_http::has_healthy_endpoint(size_t avoid, clock::time_point now) const
+{
+	for(size_t i = 0; i < m_endpoints.size(); i++)
+	{
+		if(i != avoid && m_endpoints[i]->down_until <= now)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// The endpoints take the requests in turn, skipping the ones marked down
+// and, when possible, the one given. When all of them are down, the one
+// coming back the soonest is tried anyway, so that alerts keep flowing.
+size_t falco::outputs::output_http::pick_endpoint(size_t avoid, clock::time_point now)
+{
+	size_t n = m_endpoints.size();
+	size_t fallback = SIZE_MAX;
+	for(size_t i = 0; i < n; i++)
+	{
+		size_t idx = (m_next_endpoint + i) % n;
+		const auto& e = *m_endpoints[idx];
+		if(e.down_until <= now && (idx != avoid || n == 1))
+		{
+			m_next_endpoint = idx + 1;
+			return idx;
+		}
+		if(fallback == SIZE_MAX || e.down_until < m_endpoints[fallback]->down_until)
+		{
+			fallback = idx;
+		}
+	}
+	m_next_endpoint = fallback + 1;
+	return fallback;
+}
+
+// Must be called with m_mtx held. Retries are preferred once their backoff
+// has elapsed, then full batches, then the batch being filled once it has
+// lingered enough, so that batches grow while all transfers are busy.
+bool falco::outputs::output_http::take_batch(batch& b, clock::time_point now)
+{
+	auto retry = std::find_if(m_retries.begin(), m_retries.end(),
+		[&](const batch& r){ return m_stop || r.not_before <= now; });
+	if(retry != m_retries.end())
+	{
+		b = std::move(*retry);
+		m_retries.erase(retry);
+		return true;
+	}
+	if(!m_ready.empty())
+	{
+		b = std::move(m_ready.front());
+		m_ready.pop_front();
+		return true;
+	}
+	if(m_batch.num_alerts > 0 && (m_flush || m_stop || now >= m_batch.created + m_batch_linger))
+	{
+		b = std::move(m_batch);
+		m_batch = batch();
+		return true;
+	}
+	return false;
+}
+
+// Must be called with m_mtx held
+falco::outputs::output_http::clock::time_point falco::outputs::output_http::next_deadline() const
+{
+	auto res = clock::time_point::max();
+	if(m_batch.num_alerts > 0)
+	{
+		res = m_batch.created + m_batch_linger;
+	}
+	for(const auto& r : m_retries)
+	{
+		res = std::min(res, r.not_before);
+	}
+	return res;
+}
+
+bool falco::outputs::output_http::start_transfer(transfer& t)
+{
+	if(m_gzip && !t.b.compressed)
+	{
+		if(!gzip_compress(t.b.body))
+		{
+			falco_logger::log(falco_logger::level::ERR, "http output: failed to compress batch, dropping " + std::to_string(t.b.num_alerts) + " alerts");
+			m_num_alerts_dropped += t.b.num_alerts;
+			return false;
+		}
+		t.b.compressed = true;
+	}
+
+	t.start = clock::now();
+	t.b.endpoint = pick_endpoint(t.b.endpoint, t.start);
+	m_endpoints[t.b.endpoint]->num_requests++;
+	curl_easy_setopt(t.curl, CURLOPT_URL, m_endpoints[t.b.endpoint]->url.c_str());
+	curl_easy_setopt(t.curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(t.b.body.size()));
+	curl_easy_setopt(t.curl, CURLOPT_POSTFIELDS, t.b.body.data());
+	curl_multi_add_handle(m_multi, t.curl);
+	m_in_flight++;
+	return true;
+}
+
+void falco::outputs::output_http::complete_transfer(transfer& t, CURLcode res)
+{
+	auto now = clock::now();
+	uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(now - t.start).count();
+	m_latency_us_total += latency;
+	if(latency > m_latency_us_max.load())
+	{
+		m_latency_us_max = latency;
+	}
+	auto& e = *m_endpoints[t.b.endpoint];
+	e.latency_us_total += latency;
+	if(latency > e.latency_us_max.load())
+	{
+		e.latency_us_max = latency;
+	}
+
+	long code = 0;
+	curl_easy_getinfo(t.curl, CURLINFO_RESPONSE_CODE, &code);
+	if(res == CURLE_OK && code < 400)
+	{
+		m_num_batches++;
+		m_num_alerts += t.b.num_alerts;
+		m_num_bytes += t.b.body.size();
+		if(!e.healthy)
+		{
+			falco_logger::log(falco_logger::level::INFO, "http output: endpoint " + e.url + " is back up");
+		}
+		e.consecutive_failures = 0;
+		e.healthy = true;
+		return;
+	}
+
+	m_num_failures++;
+	e.num_failures++;
 	if(res != CURLE_OK)
 	{
 		falco_logger::log(falco_logger::level::ERR, "libcurl failed to perform call: " + std::string(curl_easy_strerror(res)));
 	}
+	else
+	{
+		falco_logger::log(falco_logger::level::ERR, "http output: server replied with status code " + std::to_string(code));
+	}
+
+	// client errors other than throttling won't go away by retrying
+	bool retriable = res != CURLE_OK || code == 429 || code >= 500;
+
+	// an endpoint failing too many times in a row, or failing again
+	// once back, is left alone for a while
+	if(retriable && ++e.consecutive_failures >= m_unhealthy_after_failures)
+	{
+		if(e.healthy)
+		{
+			falco_logger::log(falco_logger::level::WARNING, "http output: endpoint " + e.url + " is down after "
+				+ std::to_string(e.consecutive_failures) + " failures in a row");
+		}
+		e.down_until = now + m_unhealthy_interval;
+		e.healthy = false;
+	}
+
+	if(retriable && t.b.attempts < m_max_retries && !m_stop)
+	{
+		// the batch goes to another endpoint right away if there is one
+		t.b.not_before = has_healthy_endpoint(t.b.endpoint, now)
+			? now
+			: now + m_retry_backoff * (1 << std::min<uint32_t>(t.b.attempts, 10));
+		t.b.attempts++;
+		m_num_retries++;
+		m_retries.push_back(std::move(t.b));
+	}
+	else
+	{
+		m_num_alerts_dropped += t.b.num_alerts;
+	}
 }
 
-void falco::outputs::output_http::cleanup()
+void falco::outputs::output_http::complete_transfers()
 {
-	curl_easy_cleanup(m_curl);
-	m_curl = nullptr;
-	curl_slist_free_all(m_http_headers);
-	m_http_headers = nullptr;
+	int running = 0;
+	curl_multi_perform(m_multi, &running);
+
+	CURLMsg *m;
+	int left = 0;
+	while((m = curl_multi_info_read(m_multi, &left)))
+	{
+		if(m->msg != CURLMSG_DONE)
+		{
+			continue;
+		}
+		CURL *curl = m->easy_handle;
+		CURLcode res = m->data.result;
+		transfer *t = nullptr;
+		curl_easy_getinfo(curl, CURLINFO_PRIVATE, reinterpret_cast<char**>(&t));
+		curl_multi_remove_handle(m_multi, curl);
+		complete_transfer(*t, res);
+		t->b = batch();
+		t->busy = false;
+		m_in_flight--;
+	}
+}
+
+void falco::outputs::output_http::sender() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	std::vector<transfer*> to_start;
+	for(;;)
+	{
+		to_start.clear();
+		{
+			std::unique_lock<std::mutex> lk(m_mtx);
+			auto now = clock::now();
+			for(auto& t : m_transfers)
+			{
+				if(!t.busy)
+				{
+					if(!take_batch(t.b, now))
+					{
+						break;
+					}
+					t.busy = true;
+					to_start.push_back(&t);
+				}
+			}
+
+			if(!to_start.empty())
+			{
+				// there's room for more alerts now
+				m_cv.notify_all();
+			}
+			else if(m_in_flight == 0)
+			{
+				if(m_retries.empty() && m_ready.empty() && m_batch.num_alerts == 0)
+				{
+					// everything has been sent
+					m_flush = false;
+					m_cv.notify_all();
+					if(m_stop)
+					{
+						break;
+					}
+					m_cv.wait(lk);
+				}
+				else
+				{
+					// waiting for the batch to linger or for a retry
+					auto deadline = next_deadline();
+					if(deadline == clock::time_point::max())
+					{
+						m_cv.wait(lk);
+					}
+					else
+					{
+						m_cv.wait_until(lk, deadline);
+					}
+				}
+				continue;
+			}
+		}
+
+		for(auto* t : to_start)
+		{
+			if(!start_transfer(*t))
+			{
+				t->b = batch();
+				t->busy = false;
+			}
+		}
+
+		complete_transfers();
+		if(m_in_flight > 0)
+		{
+			// woken up early by new alerts
+			int timeout_ms = 100;
+			if(m_batch_linger.count() > 0)
+			{
+				timeout_ms = std::min<int>(timeout_ms, m_batch_linger.count());
+			}
+			curl_multi_poll(m_multi, nullptr, 0, timeout_ms, nullptr);
+		}
+	}
 }
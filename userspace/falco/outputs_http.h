@@ -18,21 +18,143 @@ limitations under the License.
 #pragma once
 
 #include "outputs.h"
+#include "outputs_encoding.h"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace falco
 {
 namespace outputs
 {
 
+/*!
+	\brief Sends alerts to one or more HTTP endpoints. Alerts are grouped in
+	batches (one alert per line, or length-delimited protobuf messages with
+	the protobuf encoding) that are sent by a dedicated thread, with up to a
+	configurable number of requests in flight at the same time over the
+	connections kept by a curl multi handle, which share their TLS sessions
+	and can be multiplexed with HTTP/2. The batches are spread over the
+	endpoints in turn, skipping the ones that failed too many times in a
+	row for a while, and a failed batch is retried on another endpoint
+	right away when there is one. With the default settings, each alert is
+	sent in its own request, one request at a time.
+*/
 class output_http : public abstract_output
 {
+public:
+	~output_http();
+
 	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
 	void output(const message *msg) override;
 	void cleanup() override;
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	bool uses_fields() const override
+	{
+		return m_encoding == encoding::PROTOBUF;
+	}
 
 private:
-	CURL *m_curl;
-	struct curl_slist *m_http_headers;
+	using clock = std::chrono::steady_clock;
+
+	struct batch
+	{
+		std::string body;
+		bool compressed = false;
+		uint64_t num_alerts = 0;
+		uint32_t attempts = 0;
+		clock::time_point created;
+		clock::time_point not_before;
+		// the endpoint of the last attempt, if any
+		size_t endpoint = SIZE_MAX;
+	};
+
+	struct transfer
+	{
+		CURL *curl = nullptr;
+		bool busy = false;
+		batch b;
+		clock::time_point start;
+	};
+
+	struct endpoint
+	{
+		std::string url;
+		// only used by the sender thread
+		uint32_t consecutive_failures = 0;
+		clock::time_point down_until;
+
+		std::atomic<uint64_t> num_requests{0};
+		std::atomic<uint64_t> num_failures{0};
+		std::atomic<uint64_t> latency_us_total{0};
+		std::atomic<uint64_t> latency_us_max{0};
+		std::atomic<bool> healthy{true};
+	};
+
+	void sender() noexcept;
+	bool take_batch(batch& b, clock::time_point now);
+	clock::time_point next_deadline() const;
+	bool start_transfer(transfer& t);
+	void complete_transfer(transfer& t, CURLcode res);
+	void complete_transfers();
+	size_t pick_endpoint(size_t avoid, clock::time_point now);
+	bool has_healthy_endpoint(size_t avoid, clock::time_point now) const;
+
+	// settings
+	uint64_t m_batch_max_alerts = 1;
+	uint64_t m_batch_max_bytes = 1024 * 1024;
+	std::chrono::milliseconds m_batch_linger{0};
+	bool m_gzip = false;
+	encoding m_encoding = encoding::TEXT;
+	size_t m_max_in_flight = 1;
+	size_t m_max_queued = 4;
+	uint32_t m_max_retries = 0;
+	std::chrono::milliseconds m_retry_backoff{100};
+	uint32_t m_unhealthy_after_failures = 3;
+	std::chrono::milliseconds m_unhealthy_interval{5000};
+
+	CURL *m_curl = nullptr;
+	CURLM *m_multi = nullptr;
+	CURLSH *m_share = nullptr;
+	struct curl_slist *m_http_headers = nullptr;
+
+	std::vector<std::unique_ptr<endpoint>> m_endpoints;
+	// only used by the sender thread
+	size_t m_next_endpoint = 0;
+
+	// only used by the sender thread
+	std::vector<transfer> m_transfers;
+	std::deque<batch> m_retries;
+	size_t m_in_flight = 0;
+
+	// the batch being filled and the full ones waiting to be sent,
+	// shared with the sender thread and guarded by m_mtx
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	batch m_batch;
+	std::deque<batch> m_ready;
+	bool m_flush = false;
+	std::atomic<bool> m_stop{false};
+	std::thread m_sender;
+
+	std::atomic<uint64_t> m_num_batches{0};
+	std::atomic<uint64_t> m_num_alerts{0};
+	std::atomic<uint64_t> m_num_bytes{0};
+	std::atomic<uint64_t> m_num_failures{0};
+	std::atomic<uint64_t> m_num_retries{0};
+	std::atomic<uint64_t> m_num_alerts_dropped{0};
+	std::atomic<uint64_t> m_latency_us_total{0};
+	std::atomic<uint64_t> m_latency_us_max{0};
 };
 
 } // namespace outputs
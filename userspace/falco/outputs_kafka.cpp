@@ -0,0 +1,1313 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "outputs_kafka.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// the API keys and versions of the requests, see
+// https://kafka.apache.org/protocol#protocol_api_keys
+static const int16_t s_api_produce = 0;
+static const int16_t s_api_produce_version = 3;
+static const int16_t s_api_metadata = 3;
+static const int16_t s_api_metadata_version = 4;
+
+// the time to wait for a connection to a broker to be established
+static const std::chrono::seconds s_connect_timeout(5);
+// the minimum time between two refreshes of the metadata
+static const std::chrono::seconds s_metadata_backoff(1);
+// responses bigger than this are considered corrupted
+static const uint32_t s_max_response_size = 64 * 1024 * 1024;
+// partition indexes beyond this are considered corrupted
+static const int32_t s_max_partitions = 100000;
+
+namespace
+{
+
+void put_i8(std::string& out, int8_t v)
+{
+	out.push_back((char) v);
+}
+
+void put_i16(std::string& out, int16_t v)
+{
+	uint16_t u = v;
+	out.push_back((char) (u >> 8));
+	out.push_back((char) u);
+}
+
+void put_i32(std::string& out, int32_t v)
+{
+	uint32_t u = v;
+	for(int shift = 24; shift >= 0; shift -= 8)
+	{
+		out.push_back((char) (u >> shift));
+	}
+}
+
+void put_i64(std::string& out, int64_t v)
+{
+	uint64_t u = v;
+	for(int shift = 56; shift >= 0; shift -= 8)
+	{
+		out.push_back((char) (u >> shift));
+	}
+}
+
+void set_i32(std::string& out, size_t pos, int32_t v)
+{
+	uint32_t u = v;
+	for(int i = 0; i < 4; i++)
+	{
+		out[pos + i] = (char) (u >> (24 - 8 * i));
+	}
+}
+
+void put_string(std::string& out, const std::string& s)
+{
+	put_i16(out, (int16_t) s.size());
+	out.append(s);
+}
+
+// zig-zag encoded variable-length integers, as in protobuf
+uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+void put_varlong(std::string& out, int64_t v)
+{
+	uint64_t u = zigzag(v);
+	while(u >= 0x80)
+	{
+		out.push_back((char) (u | 0x80));
+		u >>= 7;
+	}
+	out.push_back((char) u);
+}
+
+size_t varlong_size(int64_t v)
+{
+	uint64_t u = zigzag(v);
+	size_t n = 1;
+	while(u >= 0x80)
+	{
+		u >>= 7;
+		n++;
+	}
+	return n;
+}
+
+uint32_t get_u32(const char* data)
+{
+	const auto* p = reinterpret_cast<const unsigned char*>(data);
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// Reads the big-endian fields of a response, and remembers whether it
+// ran past the end so that the caller can check it once at the end
+class reader
+{
+public:
+	reader(const char* data, size_t len): m_data(data), m_len(len) {}
+
+	bool ok() const
+	{
+		return m_ok;
+	}
+
+	int8_t i8()
+	{
+		return (int8_t) get(1);
+	}
+
+	int16_t i16()
+	{
+		return (int16_t) get(2);
+	}
+
+	int32_t i32()
+	{
+		return (int32_t) get(4);
+	}
+
+	int64_t i64()
+	{
+		return (int64_t) get(8);
+	}
+
+	std::string string()
+	{
+		int16_t len = i16();
+		if(len < 0 || !has(len))
+		{
+			return "";
+		}
+		std::string res(m_data + m_pos, len);
+		m_pos += len;
+		return res;
+	}
+
+	void skip_string()
+	{
+		int16_t len = i16();
+		if(len > 0 && has(len))
+		{
+			m_pos += len;
+		}
+	}
+
+	void skip_i32_array()
+	{
+		int32_t len = i32();
+		if(len > 0 && has((size_t) len * 4))
+		{
+			m_pos += (size_t) len * 4;
+		}
+	}
+
+private:
+	bool has(size_t n)
+	{
+		if(!m_ok || m_len - m_pos < n)
+		{
+			m_ok = false;
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t get(size_t n)
+	{
+		if(!has(n))
+		{
+			return 0;
+		}
+		uint64_t v = 0;
+		for(size_t i = 0; i < n; i++)
+		{
+			v = (v << 8) | (unsigned char) m_data[m_pos++];
+		}
+		return v;
+	}
+
+	const char* m_data;
+	size_t m_len;
+	size_t m_pos = 0;
+	bool m_ok = true;
+};
+
+uint64_t get_uint_option(const falco::outputs::config& oc, const std::string& name, uint64_t def)
+{
+	auto it = oc.options.find(name);
+	if(it == oc.options.end() || it->second.empty())
+	{
+		return def;
+	}
+	size_t pos = 0;
+	uint64_t res = std::stoull(it->second, &pos);
+	if(pos != it->second.size())
+	{
+		throw std::invalid_argument("invalid value '" + it->second + "' for option '" + name + "'");
+	}
+	return res;
+}
+
+bool gzip_compress(const std::string& in, std::string& out)
+{
+	z_stream zs = {};
+	// 16 adds the gzip header and trailer to the deflate stream
+	if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	out.resize(deflateBound(&zs, in.size()));
+	zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+	zs.avail_in = in.size();
+	zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+	zs.avail_out = out.size();
+	int res = deflate(&zs, Z_FINISH);
+	deflateEnd(&zs);
+	if(res != Z_STREAM_END)
+	{
+		return false;
+	}
+	out.resize(zs.total_out);
+	return true;
+}
+
+std::string error_name(int16_t code)
+{
+	switch(code)
+	{
+	case -1: return "UNKNOWN_SERVER_ERROR";
+	case 2: return "CORRUPT_MESSAGE";
+	case 3: return "UNKNOWN_TOPIC_OR_PARTITION";
+	case 5: return "LEADER_NOT_AVAILABLE";
+	case 6: return "NOT_LEADER_OR_FOLLOWER";
+	case 7: return "REQUEST_TIMED_OUT";
+	case 10: return "MESSAGE_TOO_LARGE";
+	case 13: return "NETWORK_EXCEPTION";
+	case 19: return "NOT_ENOUGH_REPLICAS";
+	case 20: return "NOT_ENOUGH_REPLICAS_AFTER_APPEND";
+	case 29: return "TOPIC_AUTHORIZATION_FAILED";
+	case 56: return "KAFKA_STORAGE_ERROR";
+	case 87: return "INVALID_RECORD";
+	default: return "error code " + std::to_string(code);
+	}
+}
+
+bool is_retriable(int16_t code)
+{
+	switch(code)
+	{
+	case 3: case 5: case 6: case 7: case 13: case 19: case 20: case 56:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Waits for the events on fd until the deadline, returning false on timeout
+bool wait_fd(int fd, short events, std::chrono::steady_clock::time_point deadline)
+{
+	struct pollfd pfd = {fd, events, 0};
+	while(true)
+	{
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(left <= 0)
+		{
+			errno = ETIMEDOUT;
+			return false;
+		}
+		int rc = poll(&pfd, 1, (int) std::min<int64_t>(left, INT_MAX));
+		if(rc > 0)
+		{
+			return true;
+		}
+		if(rc < 0 && errno != EINTR)
+		{
+			return false;
+		}
+	}
+}
+
+// Returns a connected non-blocking socket, or -1 on failure
+int connect_tcp(const std::string& host, const std::string& port, std::string& err)
+{
+	struct addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* res = nullptr;
+	int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+	if(rc != 0)
+	{
+		err = gai_strerror(rc);
+		return -1;
+	}
+
+	int fd = -1;
+	for(auto* ai = res; ai != nullptr; ai = ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+		if(fd < 0)
+		{
+			err = strerror(errno);
+			continue;
+		}
+
+		int soerr = 0;
+		socklen_t soerr_len = sizeof(soerr);
+		if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0
+		   || (errno == EINPROGRESS
+		       && wait_fd(fd, POLLOUT, std::chrono::steady_clock::now() + s_connect_timeout)
+		       && getsockopt(fd, SOL_SOCKET, SO_ERROR, &soerr, &soerr_len) == 0
+		       && soerr == 0))
+		{
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			break;
+		}
+		err = strerror(soerr != 0 ? soerr : errno);
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	return fd;
+}
+
+// Sends the request and reads its response, excluding the size
+bool exchange(int fd, const std::string& req, std::string& resp, std::chrono::steady_clock::time_point deadline, std::string& err)
+{
+	size_t off = 0;
+	while(off < req.size())
+	{
+		ssize_t n = send(fd, req.data() + off, req.size() - off, MSG_NOSIGNAL);
+		if(n >= 0)
+		{
+			off += n;
+		}
+		else if((errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) || !wait_fd(fd, POLLOUT, deadline))
+		{
+			err = strerror(errno);
+			return false;
+		}
+	}
+
+	std::string in;
+	char buf[16 * 1024];
+	while(in.size() < 4 || in.size() - 4 < get_u32(in.data()))
+	{
+		if(in.size() >= 4 && get_u32(in.data()) > s_max_response_size)
+		{
+			err = "invalid response size";
+			return false;
+		}
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if(n > 0)
+		{
+			in.append(buf, n);
+		}
+		else if(n == 0)
+		{
+			err = "connection closed by the broker";
+			return false;
+		}
+		else if((errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) || !wait_fd(fd, POLLIN, deadline))
+		{
+			err = strerror(errno);
+			return false;
+		}
+	}
+	resp = in.substr(4, get_u32(in.data()));
+	return true;
+}
+
+} // namespace
+
+static const std::array<uint32_t, 256> s_crc32c_table = []
+{
+	std::array<uint32_t, 256> table{};
+	for(uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t c = i;
+		for(int k = 0; k < 8; k++)
+		{
+			c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+		}
+		table[i] = c;
+	}
+	return table;
+}();
+
+uint32_t falco::outputs::kafka::crc32c(const char* data, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+	for(size_t i = 0; i < len; i++)
+	{
+		crc = s_crc32c_table[(crc ^ (unsigned char) data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xffffffff;
+}
+
+void falco::outputs::kafka::append_record(std::string& out, int64_t timestamp_delta, int32_t offset_delta, const std::string& value)
+{
+	// attributes, timestamp and offset deltas, null key, value, no headers
+	size_t len = 1 + varlong_size(timestamp_delta) + varlong_size(offset_delta)
+		+ varlong_size(-1) + varlong_size(value.size()) + value.size() + varlong_size(0);
+	put_varlong(out, len);
+	put_i8(out, 0);
+	put_varlong(out, timestamp_delta);
+	put_varlong(out, offset_delta);
+	put_varlong(out, -1);
+	put_varlong(out, value.size());
+	out.append(value);
+	put_varlong(out, 0);
+}
+
+bool falco::outputs::kafka::append_record_batch(std::string& out, const std::string& records, int32_t num_records,
+						int64_t base_timestamp, int64_t max_timestamp, bool gzip)
+{
+	std::string compressed;
+	if(gzip && !gzip_compress(records, compressed))
+	{
+		return false;
+	}
+
+	put_i64(out, 0); // base offset, assigned by the broker
+	size_t len_pos = out.size();
+	put_i32(out, 0);
+	put_i32(out, -1); // partition leader epoch
+	put_i8(out, 2); // magic
+	size_t crc_pos = out.size();
+	put_i32(out, 0);
+	put_i16(out, gzip ? 1 : 0); // attributes, with the compression codec
+	put_i32(out, num_records - 1); // last offset delta
+	put_i64(out, base_timestamp);
+	put_i64(out, max_timestamp);
+	put_i64(out, -1); // producer id, for idempotent producers only
+	put_i16(out, -1); // producer epoch
+	put_i32(out, -1); // base sequence
+	put_i32(out, num_records);
+	out.append(gzip ? compressed : records);
+
+	set_i32(out, len_pos, (int32_t) (out.size() - len_pos - 4));
+	set_i32(out, crc_pos, (int32_t) crc32c(out.data() + crc_pos + 4, out.size() - crc_pos - 4));
+	return true;
+}
+
+falco::outputs::output_kafka::~output_kafka()
+{
+	if(m_sender.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		wakeup();
+		m_sender.join();
+	}
+
+	for(auto& it : m_brokers)
+	{
+		if(it.second.fd >= 0)
+		{
+			close(it.second.fd);
+		}
+	}
+	for(int fd : m_wake)
+	{
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
+
+bool falco::outputs::output_kafka::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
+		return false;
+	}
+
+	try
+	{
+		m_batch_max_alerts = std::max<uint64_t>(1, get_uint_option(m_oc, "batch_max_alerts", 1000));
+		m_batch_max_bytes = std::max<uint64_t>(1, get_uint_option(m_oc, "batch_max_bytes", 1024 * 1024));
+		m_batch_linger = std::chrono::milliseconds(get_uint_option(m_oc, "batch_linger_ms", 5));
+		m_max_in_flight = std::max<uint64_t>(1, get_uint_option(m_oc, "max_in_flight", 5));
+		m_max_retries = get_uint_option(m_oc, "max_retries", 3);
+		m_retry_backoff = std::chrono::milliseconds(get_uint_option(m_oc, "retry_backoff_ms", 100));
+		m_request_timeout = std::chrono::milliseconds(std::max<uint64_t>(1, get_uint_option(m_oc, "request_timeout_ms", 30000)));
+	}
+	catch(const std::exception& e)
+	{
+		err = "kafka output: " + std::string(e.what());
+		return false;
+	}
+	m_max_queued = 4 * m_max_in_flight;
+
+	// a comma-separated list of host:port, with IPv6 hosts in brackets
+	const auto& brokers = m_oc.options["brokers"];
+	size_t start = 0;
+	while(start <= brokers.size())
+	{
+		size_t end = brokers.find(',', start);
+		if(end == std::string::npos)
+		{
+			end = brokers.size();
+		}
+		std::string b = brokers.substr(start, end - start);
+		b.erase(0, b.find_first_not_of(" \t"));
+		b.erase(b.find_last_not_of(" \t") + 1);
+		start = end + 1;
+		if(b.empty())
+		{
+			continue;
+		}
+
+		std::string host = b, port = "9092";
+		size_t colon = b.rfind(':');
+		if(colon != std::string::npos && b.find(']', colon) == std::string::npos)
+		{
+			host = b.substr(0, colon);
+			port = b.substr(colon + 1);
+		}
+		if(host.size() >= 2 && host.front() == '[' && host.back() == ']')
+		{
+			host = host.substr(1, host.size() - 2);
+		}
+		m_bootstrap.emplace_back(host, port);
+	}
+	if(m_bootstrap.empty())
+	{
+		err = "kafka output: no brokers configured";
+		return false;
+	}
+
+	m_topic = m_oc.options["topic"];
+	if(m_topic.empty())
+	{
+		err = "kafka output: no topic configured";
+		return false;
+	}
+	if(!m_oc.options["client_id"].empty())
+	{
+		m_client_id = m_oc.options["client_id"];
+	}
+
+	const auto& acks = m_oc.options["acks"];
+	if(acks.empty() || acks == "all" || acks == "-1")
+	{
+		m_acks = -1;
+	}
+	else if(acks == "0" || acks == "1")
+	{
+		m_acks = acks == "1" ? 1 : 0;
+	}
+	else
+	{
+		err = "kafka output: invalid acks '" + acks + "', must be 'all', '1', or '0'";
+		return false;
+	}
+
+	const auto& compression = m_oc.options["compression"];
+	if(compression == "gzip")
+	{
+		m_gzip = true;
+	}
+	else if(!compression.empty() && compression != "none")
+	{
+		err = "kafka output: unsupported compression '" + compression + "'";
+		return false;
+	}
+
+	if(!parse_encoding(m_oc.options["encoding"], m_encoding))
+	{
+		err = "kafka output: invalid encoding '" + m_oc.options["encoding"] + "'";
+		return false;
+	}
+
+	if(pipe2(m_wake, O_NONBLOCK | O_CLOEXEC) != 0)
+	{
+		err = "kafka output: can't create pipe: " + std::string(strerror(errno));
+		return false;
+	}
+
+	m_sender = std::thread(&output_kafka::sender, this);
+	return true;
+}
+
+void falco::outputs::output_kafka::output(const message *msg)
+{
+	bool wake;
+	{
+		std::unique_lock<std::mutex> lk(m_mtx);
+
+		// wait for the sender to catch up, so that slow brokers slow
+		// down the outputs queue instead of growing memory
+		m_cv.wait(lk, [this]{ return m_ready.size() < m_max_queued; });
+
+		int64_t ts = msg->ts / 1000000;
+		if(m_batch.num_records == 0)
+		{
+			m_batch.created = clock::now();
+			m_batch.base_timestamp = ts;
+			m_batch.max_timestamp = ts;
+		}
+		const auto& value = m_encoding == encoding::PROTOBUF ? msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname) : msg->msg;
+		kafka::append_record(m_batch.records, ts - m_batch.base_timestamp, m_batch.num_records, value);
+		m_batch.max_timestamp = std::max(m_batch.max_timestamp, ts);
+		m_batch.num_records++;
+
+		// the sender needs to know about new batches, to wait for them
+		// to linger, and about full ones
+		wake = m_batch.num_records == 1;
+		if((uint64_t) m_batch.num_records >= m_batch_max_alerts || m_batch.records.size() >= m_batch_max_bytes)
+		{
+			m_ready.push_back(std::move(m_batch));
+			m_batch = batch();
+			wake = true;
+		}
+	}
+	if(wake)
+	{
+		m_cv.notify_all();
+		wakeup();
+	}
+}
+
+void falco::outputs::output_kafka::cleanup()
+{
+	// send everything that's pending before returning
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(!m_sender.joinable())
+	{
+		return;
+	}
+	m_flush = true;
+	m_cv.notify_all();
+	wakeup();
+	m_cv.wait(lk, [this]{ return !m_flush; });
+}
+
+void falco::outputs::output_kafka::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["batches"] = m_num_batches.load();
+	metrics["alerts"] = m_num_alerts.load();
+	metrics["bytes"] = m_num_bytes.load();
+	metrics["failures"] = m_num_failures.load();
+	metrics["retries"] = m_num_retries.load();
+	metrics["alerts_dropped"] = m_num_alerts_dropped.load();
+	metrics["metadata_refreshes"] = m_num_metadata_refreshes.load();
+	metrics["latency_us_total"] = m_latency_us_total.load();
+	metrics["latency_us_max"] = m_latency_us_max.load();
+}
+
+void falco::outputs::output_kafka::wakeup()
+{
+	if(m_wake[1] >= 0)
+	{
+		// a full pipe already wakes the sender up
+		char c = 0;
+		ssize_t rc = write(m_wake[1], &c, 1);
+		(void) rc;
+	}
+}
+
+int32_t falco::outputs::output_kafka::next_correlation_id()
+{
+	int32_t id = m_next_correlation_id;
+	m_next_correlation_id = id == INT32_MAX ? 0 : id + 1;
+	return id;
+}
+
+void falco::outputs::output_kafka::encode_header(std::string& out, int16_t api_key, int16_t api_version, int32_t correlation_id) const
+{
+	put_i16(out, api_key);
+	put_i16(out, api_version);
+	put_i32(out, correlation_id);
+	put_string(out, m_client_id);
+}
+
+bool falco::outputs::output_kafka::refresh_metadata()
+{
+	m_metadata_refreshed = clock::now();
+	m_num_metadata_refreshes++;
+
+	// the brokers known from the previous metadata are tried first
+	std::vector<std::pair<std::string, std::string>> candidates;
+	for(const auto& it : m_brokers)
+	{
+		candidates.emplace_back(it.second.host, it.second.port);
+	}
+	candidates.insert(candidates.end(), m_bootstrap.begin(), m_bootstrap.end());
+
+	std::string err;
+	for(const auto& c : candidates)
+	{
+		if(fetch_metadata(c.first, c.second, err))
+		{
+			m_metadata_stale = false;
+			return true;
+		}
+		err = c.first + ":" + c.second + ": " + err;
+	}
+	falco_logger::log(falco_logger::level::ERR, "kafka output: can't fetch the metadata of topic '" + m_topic + "' from " + err + "\n");
+	return false;
+}
+
+bool falco::outputs::output_kafka::fetch_metadata(const std::string& host, const std::string& port, std::string& err)
+{
+	int fd = connect_tcp(host, port, err);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	std::string req;
+	put_i32(req, 0);
+	encode_header(req, s_api_metadata, s_api_metadata_version, next_correlation_id());
+	put_i32(req, 1);
+	put_string(req, m_topic);
+	put_i8(req, 0); // don't create the topic
+	set_i32(req, 0, (int32_t) (req.size() - 4));
+
+	std::string resp;
+	bool ok = exchange(fd, req, resp, clock::now() + m_request_timeout, err);
+	close(fd);
+	if(!ok)
+	{
+		return false;
+	}
+
+	reader rd(resp.data(), resp.size());
+	rd.i32(); // correlation id
+	rd.i32(); // throttle time
+	std::map<int32_t, std::pair<std::string, std::string>> nodes;
+	int32_t num_brokers = rd.i32();
+	for(int32_t i = 0; i < num_brokers && rd.ok(); i++)
+	{
+		int32_t id = rd.i32();
+		std::string node_host = rd.string();
+		int32_t node_port = rd.i32();
+		rd.skip_string(); // rack
+		nodes[id] = {node_host, std::to_string(node_port)};
+	}
+	rd.skip_string(); // cluster id
+	rd.i32(); // controller id
+
+	std::vector<int32_t> leaders;
+	int16_t topic_error = 0;
+	bool found = false;
+	int32_t num_topics = rd.i32();
+	for(int32_t i = 0; i < num_topics && rd.ok(); i++)
+	{
+		int16_t error = rd.i16();
+		bool match = rd.string() == m_topic;
+		rd.i8(); // is internal
+		int32_t num_partitions = rd.i32();
+		for(int32_t j = 0; j < num_partitions && rd.ok(); j++)
+		{
+			rd.i16(); // partition error
+			int32_t index = rd.i32();
+			int32_t leader = rd.i32();
+			rd.skip_i32_array(); // replicas
+			rd.skip_i32_array(); // in-sync replicas
+			if(match && index >= 0 && index < s_max_partitions)
+			{
+				if((size_t) index >= leaders.size())
+				{
+					leaders.resize(index + 1, -1);
+				}
+				leaders[index] = leader;
+			}
+		}
+		if(match)
+		{
+			topic_error = error;
+			found = true;
+		}
+	}
+	if(!rd.ok())
+	{
+		err = "invalid metadata response";
+		return false;
+	}
+	if(!found || topic_error != 0)
+	{
+		err = found ? error_name(topic_error) : "topic not found";
+		return false;
+	}
+
+	// the connections to the brokers that moved or left are dropped, and
+	// their requests retried with the new leaders
+	for(auto it = m_brokers.begin(); it != m_brokers.end();)
+	{
+		auto n = nodes.find(it->first);
+		if(n == nodes.end() || n->second.first != it->second.host || n->second.second != it->second.port)
+		{
+			fail_broker(it->second, "the broker left the cluster");
+			it = m_brokers.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	for(const auto& n : nodes)
+	{
+		auto& br = m_brokers[n.first];
+		br.host = n.second.first;
+		br.port = n.second.second;
+	}
+	m_leaders = std::move(leaders);
+	return true;
+}
+
+void falco::outputs::output_kafka::dispatch(batch& b)
+{
+	auto now = clock::now();
+	if(m_metadata_stale && now >= m_metadata_refreshed + s_metadata_backoff)
+	{
+		refresh_metadata();
+	}
+
+	// the batches go to the partitions in turn, skipping the ones
+	// without a leader
+	broker* br = nullptr;
+	int32_t partition = -1;
+	for(size_t i = 0; i < m_leaders.size() && br == nullptr; i++)
+	{
+		m_next_partition = (m_next_partition + 1) % m_leaders.size();
+		auto it = m_brokers.find(m_leaders[m_next_partition]);
+		if(it != m_brokers.end())
+		{
+			br = &it->second;
+			partition = (int32_t) m_next_partition;
+		}
+	}
+	if(br == nullptr)
+	{
+		falco_logger::log(falco_logger::level::ERR, "kafka output: no leader available for topic '" + m_topic + "'\n");
+		m_metadata_stale = true;
+		fail_batch(b, true);
+		return;
+	}
+
+	if(br->fd >= 0 && br->in_flight.empty())
+	{
+		// brokers close idle connections, which is noticed here rather
+		// than after sending the request
+		struct pollfd pfd = {br->fd, POLLIN, 0};
+		if(poll(&pfd, 1, 0) > 0)
+		{
+			fail_broker(*br, "connection closed");
+		}
+	}
+	if(br->fd < 0)
+	{
+		std::string err;
+		br->fd = connect_tcp(br->host, br->port, err);
+		if(br->fd < 0)
+		{
+			falco_logger::log(falco_logger::level::ERR, "kafka output: can't connect to broker " + br->host + ":" + br->port + ": " + err + "\n");
+			m_metadata_stale = true;
+			fail_batch(b, true);
+			return;
+		}
+	}
+
+	request r;
+	r.correlation_id = next_correlation_id();
+	size_t start = br->out.size();
+	put_i32(br->out, 0);
+	encode_header(br->out, s_api_produce, s_api_produce_version, r.correlation_id);
+	put_i16(br->out, -1); // no transactional id
+	put_i16(br->out, m_acks);
+	put_i32(br->out, (int32_t) m_request_timeout.count());
+	put_i32(br->out, 1);
+	put_string(br->out, m_topic);
+	put_i32(br->out, 1);
+	put_i32(br->out, partition);
+	size_t records_pos = br->out.size();
+	put_i32(br->out, 0);
+	if(!kafka::append_record_batch(br->out, b.records, b.num_records, b.base_timestamp, b.max_timestamp, m_gzip))
+	{
+		falco_logger::log(falco_logger::level::ERR, "kafka output: failed to compress batch, dropping " + std::to_string(b.num_records) + " alerts\n");
+		br->out.resize(start);
+		m_num_alerts_dropped += b.num_records;
+		return;
+	}
+	set_i32(br->out, records_pos, (int32_t) (br->out.size() - records_pos - 4));
+	set_i32(br->out, start, (int32_t) (br->out.size() - start - 4));
+
+	r.bytes = br->out.size() - start;
+	br->queued += r.bytes;
+	r.end = br->queued;
+	r.sent = now;
+	r.b = std::move(b);
+	br->in_flight.push_back(std::move(r));
+	m_in_flight++;
+	flush_broker(*br);
+}
+
+void falco::outputs::output_kafka::fail_batch(batch& b, bool retriable)
+{
+	m_num_failures++;
+	if(retriable && b.attempts < m_max_retries && !m_stop)
+	{
+		b.not_before = clock::now() + m_retry_backoff * (1 << std::min<uint32_t>(b.attempts, 10));
+		b.attempts++;
+		m_num_retries++;
+		m_retries.push_back(std::move(b));
+	}
+	else
+	{
+		m_num_alerts_dropped += b.num_records;
+	}
+}
+
+void falco::outputs::output_kafka::fail_broker(broker& br, const std::string& reason)
+{
+	if(!br.in_flight.empty())
+	{
+		falco_logger::log(falco_logger::level::ERR, "kafka output: broker " + br.host + ":" + br.port + ": " + reason
+			+ ", retrying " + std::to_string(br.in_flight.size()) + " requests\n");
+	}
+
+	if(br.fd >= 0)
+	{
+		close(br.fd);
+		br.fd = -1;
+	}
+	br.out.clear();
+	br.out_off = 0;
+	br.queued = 0;
+	br.written = 0;
+	br.in.clear();
+	m_metadata_stale = true;
+
+	auto requests = std::move(br.in_flight);
+	br.in_flight.clear();
+	m_in_flight -= requests.size();
+	for(auto& r : requests)
+	{
+		fail_batch(r.b, true);
+	}
+}
+
+void falco::outputs::output_kafka::complete(request& r)
+{
+	uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - r.sent).count();
+	m_latency_us_total += latency;
+	if(latency > m_latency_us_max.load())
+	{
+		m_latency_us_max = latency;
+	}
+	m_num_batches++;
+	m_num_alerts += r.b.num_records;
+	m_num_bytes += r.bytes;
+}
+
+void falco::outputs::output_kafka::flush_broker(broker& br)
+{
+	while(br.out_off < br.out.size())
+	{
+		ssize_t n = send(br.fd, br.out.data() + br.out_off, br.out.size() - br.out_off, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			fail_broker(br, "send failed: " + std::string(strerror(errno)));
+			return;
+		}
+		br.out_off += n;
+		br.written += n;
+	}
+	if(br.out_off == br.out.size())
+	{
+		br.out.clear();
+		br.out_off = 0;
+	}
+
+	// without acknowledgements, requests are done once written
+	if(m_acks == 0)
+	{
+		while(!br.in_flight.empty() && br.in_flight.front().end <= br.written)
+		{
+			complete(br.in_flight.front());
+			br.in_flight.pop_front();
+			m_in_flight--;
+		}
+	}
+}
+
+void falco::outputs::output_kafka::read_broker(broker& br)
+{
+	char buf[64 * 1024];
+	while(true)
+	{
+		ssize_t n = recv(br.fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if(n > 0)
+		{
+			br.in.append(buf, n);
+			continue;
+		}
+		if(n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		fail_broker(br, n == 0 ? "connection closed" : "receive failed: " + std::string(strerror(errno)));
+		return;
+	}
+
+	size_t off = 0;
+	while(br.in.size() - off >= 4)
+	{
+		uint32_t len = get_u32(br.in.data() + off);
+		if(len > s_max_response_size)
+		{
+			fail_broker(br, "invalid response size");
+			return;
+		}
+		if(br.in.size() - off - 4 < len)
+		{
+			break;
+		}
+		if(!handle_response(br, br.in.data() + off + 4, len))
+		{
+			fail_broker(br, "invalid response");
+			return;
+		}
+		off += 4 + len;
+	}
+	br.in.erase(0, off);
+}
+
+bool falco::outputs::output_kafka::handle_response(broker& br, const char* data, size_t len)
+{
+	// the responses come in the same order as the requests
+	reader rd(data, len);
+	int32_t correlation_id = rd.i32();
+	if(br.in_flight.empty() || br.in_flight.front().correlation_id != correlation_id)
+	{
+		return false;
+	}
+
+	int16_t error = 0;
+	bool found = false;
+	int32_t num_topics = rd.i32();
+	for(int32_t i = 0; i < num_topics && rd.ok(); i++)
+	{
+		rd.skip_string(); // topic
+		int32_t num_partitions = rd.i32();
+		for(int32_t j = 0; j < num_partitions && rd.ok(); j++)
+		{
+			rd.i32(); // partition
+			error = rd.i16();
+			found = true;
+			rd.i64(); // base offset
+			rd.i64(); // log append time
+		}
+	}
+	rd.i32(); // throttle time
+	if(!rd.ok() || !found)
+	{
+		return false;
+	}
+
+	auto r = std::move(br.in_flight.front());
+	br.in_flight.pop_front();
+	m_in_flight--;
+	if(error == 0)
+	{
+		complete(r);
+		return true;
+	}
+
+	bool retriable = is_retriable(error);
+	falco_logger::log(falco_logger::level::ERR, "kafka output: broker " + br.host + ":" + br.port + " rejected a batch of "
+		+ std::to_string(r.b.num_records) + " alerts: " + error_name(error)
+		+ (retriable && r.b.attempts < m_max_retries ? ", retrying\n" : "\n"));
+	if(error == 3 || error == 5 || error == 6)
+	{
+		// the leaders have changed
+		m_metadata_stale = true;
+	}
+	fail_batch(r.b, retriable);
+	return true;
+}
+
+void falco::outputs::output_kafka::poll_brokers(int timeout_ms)
+{
+	std::vector<struct pollfd> fds;
+	std::vector<broker*> polled;
+	fds.push_back({m_wake[0], POLLIN, 0});
+	for(auto& it : m_brokers)
+	{
+		auto& br = it.second;
+		if(br.fd >= 0)
+		{
+			short events = POLLIN;
+			if(br.out_off < br.out.size())
+			{
+				events |= POLLOUT;
+			}
+			fds.push_back({br.fd, events, 0});
+			polled.push_back(&br);
+		}
+	}
+
+	if(poll(fds.data(), fds.size(), timeout_ms) > 0)
+	{
+		if(fds[0].revents & POLLIN)
+		{
+			char buf[256];
+			while(read(m_wake[0], buf, sizeof(buf)) > 0)
+			{
+			}
+		}
+		for(size_t i = 0; i < polled.size(); i++)
+		{
+			auto revents = fds[i + 1].revents;
+			auto& br = *polled[i];
+			if(revents & POLLOUT)
+			{
+				flush_broker(br);
+			}
+			if(br.fd >= 0 && (revents & (POLLIN | POLLERR | POLLHUP)))
+			{
+				read_broker(br);
+			}
+		}
+	}
+
+	// the connections are dropped when the responses don't come in time
+	auto now = clock::now();
+	for(auto& it : m_brokers)
+	{
+		auto& br = it.second;
+		if(!br.in_flight.empty() && now - br.in_flight.front().sent > m_request_timeout)
+		{
+			fail_broker(br, "request timed out");
+		}
+	}
+}
+
+// Must be called with m_mtx held. Retries are preferred once their backoff
+// has elapsed, then full batches, then the batch being filled once it has
+// lingered enough, so that batches grow while all requests are in flight.
+bool falco::outputs::output_kafka::take_batch(batch& b, clock::time_point now)
+{
+	auto retry = std::find_if(m_retries.begin(), m_retries.end(),
+		[&](const batch& r){ return m_stop || r.not_before <= now; });
+	if(retry != m_retries.end())
+	{
+		b = std::move(*retry);
+		m_retries.erase(retry);
+		return true;
+	}
+	if(!m_ready.empty())
+	{
+		b = std::move(m_ready.front());
+		m_ready.pop_front();
+		return true;
+	}
+	if(m_batch.num_records > 0 && (m_flush || m_stop || now >= m_batch.created + m_batch_linger))
+	{
+		b = std::move(m_batch);
+		m_batch = batch();
+		return true;
+	}
+	return false;
+}
+
+// Must be called with m_mtx held
+falco::outputs::output_kafka::clock::time_point falco::outputs::output_kafka::next_deadline() const
+{
+	auto res = clock::time_point::max();
+	if(m_batch.num_records > 0)
+	{
+		res = m_batch.created + m_batch_linger;
+	}
+	for(const auto& r : m_retries)
+	{
+		res = std::min(res, r.not_before);
+	}
+	return res;
+}
+
+void falco::outputs::output_kafka::sender() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	std::vector<batch> to_send;
+	while(true)
+	{
+		to_send.clear();
+		{
+			std::unique_lock<std::mutex> lk(m_mtx);
+			auto now = clock::now();
+			while(m_in_flight + to_send.size() < m_max_in_flight)
+			{
+				batch b;
+				if(!take_batch(b, now))
+				{
+					break;
+				}
+				to_send.push_back(std::move(b));
+			}
+
+			if(!to_send.empty())
+			{
+				// there's room for more alerts now
+				m_cv.notify_all();
+			}
+			else if(m_in_flight == 0)
+			{
+				if(m_retries.empty() && m_ready.empty() && m_batch.num_records == 0)
+				{
+					// everything has been sent
+					m_flush = false;
+					m_cv.notify_all();
+					if(m_stop)
+					{
+						break;
+					}
+					m_cv.wait(lk);
+				}
+				else
+				{
+					// waiting for the batch to linger or for a retry
+					auto deadline = next_deadline();
+					if(deadline == clock::time_point::max())
+					{
+						m_cv.wait(lk);
+					}
+					else
+					{
+						m_cv.wait_until(lk, deadline);
+					}
+				}
+				continue;
+			}
+		}
+
+		for(auto& b : to_send)
+		{
+			dispatch(b);
+		}
+
+		if(m_in_flight > 0)
+		{
+			// woken up early by new alerts
+			int timeout_ms = 100;
+			if(m_batch_linger.count() > 0)
+			{
+				timeout_ms = std::min<int>(timeout_ms, m_batch_linger.count());
+			}
+			poll_brokers(timeout_ms);
+		}
+	}
+}
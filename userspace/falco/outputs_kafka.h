@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "outputs.h"
+#include "outputs_encoding.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace falco
+{
+namespace outputs
+{
+
+namespace kafka
+{
+
+/*!
+	\brief Returns the CRC-32C (Castagnoli) checksum of the given data,
+	which is the one used by record batches
+*/
+uint32_t crc32c(const char* data, size_t len);
+
+/*!
+	\brief Appends a record with the given value and no key nor headers
+	to out, which is the records section of a batch
+*/
+void append_record(std::string& out, int64_t timestamp_delta, int32_t offset_delta, const std::string& value);
+
+/*!
+	\brief Appends to out a record batch (magic 2) made of the given
+	records section, optionally compressed with gzip. Returns false if the
+	compression fails.
+*/
+bool append_record_batch(std::string& out, const std::string& records, int32_t num_records,
+			 int64_t base_timestamp, int64_t max_timestamp, bool gzip);
+
+} // namespace kafka
+
+/*!
+	\brief Produces alerts to a Kafka topic, speaking the Kafka protocol
+	directly. The value of each record is the alert as formatted, or a
+	protobuf message with the protobuf encoding. Alerts are grouped in record batches, optionally compressed,
+	that a dedicated thread sends to the leaders of the topic partitions
+	in a round-robin fashion. Up to a configurable number of produce
+	requests are in flight at the same time, their acknowledgements are
+	received asynchronously, and failed batches are retried after a
+	backoff, refreshing the metadata of the topic when the leaders change.
+*/
+class output_kafka : public abstract_output
+{
+public:
+	~output_kafka();
+
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+	void output(const message *msg) override;
+	void cleanup() override;
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	bool uses_fields() const override
+	{
+		return m_encoding == encoding::PROTOBUF;
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct batch
+	{
+		std::string records;
+		int32_t num_records = 0;
+		int64_t base_timestamp = 0;
+		int64_t max_timestamp = 0;
+		uint32_t attempts = 0;
+		clock::time_point created;
+		clock::time_point not_before;
+	};
+
+	struct request
+	{
+		int32_t correlation_id = 0;
+		// the position of the end of the request in the stream written
+		// to the broker, for the requests that aren't acknowledged
+		uint64_t end = 0;
+		size_t bytes = 0;
+		batch b;
+		clock::time_point sent;
+	};
+
+	struct broker
+	{
+		std::string host;
+		std::string port;
+		int fd = -1;
+		std::string out;
+		size_t out_off = 0;
+		uint64_t queued = 0;
+		uint64_t written = 0;
+		std::string in;
+		std::deque<request> in_flight;
+	};
+
+	// only called by the sender thread
+	bool refresh_metadata();
+	bool fetch_metadata(const std::string& host, const std::string& port, std::string& err);
+	void dispatch(batch& b);
+	void fail_batch(batch& b, bool retriable);
+	void fail_broker(broker& br, const std::string& reason);
+	void complete(request& r);
+	void flush_broker(broker& br);
+	void read_broker(broker& br);
+	bool handle_response(broker& br, const char* data, size_t len);
+	void poll_brokers(int timeout_ms);
+	void encode_header(std::string& out, int16_t api_key, int16_t api_version, int32_t correlation_id) const;
+	int32_t next_correlation_id();
+
+	void sender() noexcept;
+	bool take_batch(batch& b, clock::time_point now);
+	clock::time_point next_deadline() const;
+	void wakeup();
+
+	// settings
+	std::vector<std::pair<std::string, std::string>> m_bootstrap;
+	std::string m_topic;
+	std::string m_client_id = "falco";
+	int16_t m_acks = -1;
+	bool m_gzip = false;
+	encoding m_encoding = encoding::TEXT;
+	uint64_t m_batch_max_alerts = 1000;
+	uint64_t m_batch_max_bytes = 1024 * 1024;
+	std::chrono::milliseconds m_batch_linger{5};
+	size_t m_max_in_flight = 5;
+	size_t m_max_queued = 20;
+	uint32_t m_max_retries = 3;
+	std::chrono::milliseconds m_retry_backoff{100};
+	std::chrono::milliseconds m_request_timeout{30000};
+
+	// only used by the sender thread
+	std::map<int32_t, broker> m_brokers;
+	std::vector<int32_t> m_leaders;
+	size_t m_next_partition = 0;
+	bool m_metadata_stale = true;
+	clock::time_point m_metadata_refreshed;
+	int32_t m_next_correlation_id = 0;
+	std::deque<batch> m_retries;
+	size_t m_in_flight = 0;
+	int m_wake[2] = {-1, -1};
+
+	// the batch being filled and the full ones waiting to be sent,
+	// shared with the sender thread and guarded by m_mtx
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	batch m_batch;
+	std::deque<batch> m_ready;
+	bool m_flush = false;
+	std::atomic<bool> m_stop{false};
+	std::thread m_sender;
+
+	std::atomic<uint64_t> m_num_batches{0};
+	std::atomic<uint64_t> m_num_alerts{0};
+	std::atomic<uint64_t> m_num_bytes{0};
+	std::atomic<uint64_t> m_num_failures{0};
+	std::atomic<uint64_t> m_num_retries{0};
+	std::atomic<uint64_t> m_num_alerts_dropped{0};
+	std::atomic<uint64_t> m_num_metadata_refreshes{0};
+	std::atomic<uint64_t> m_latency_us_total{0};
+	std::atomic<uint64_t> m_latency_us_max{0};
+};
+
+} // namespace outputs
+} // namespace falco
@@ -16,7 +16,94 @@ limitations under the License.
 */
 
 #include "outputs_program.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+extern char **environ;
+
+// the time to wait before starting the program again after it exits
+static const std::chrono::seconds s_restart_backoff(1);
+
+// the time cleanup() waits for the pending alerts to be written
+static const std::chrono::seconds s_cleanup_timeout(5);
+
+falco::outputs::output_program::~output_program()
+{
+	if(m_writer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		m_writer.join();
+	}
+	if(m_pfile != nullptr)
+	{
+		pclose(m_pfile);
+	}
+}
+
+bool falco::outputs::output_program::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
+		return false;
+	}
+
+	if(!parse_encoding(m_oc.options["encoding"], m_encoding))
+	{
+		err = "program output: invalid encoding '" + m_oc.options["encoding"] + "'";
+		return false;
+	}
+
+	m_keep_alive = m_oc.options["keep_alive"] == "true";
+	if(!m_keep_alive)
+	{
+		return true;
+	}
+
+	const auto& policy = m_oc.options["full_buffer_policy"];
+	if(policy == "drop")
+	{
+		m_drop_when_full = true;
+	}
+	else if(!policy.empty() && policy != "block")
+	{
+		err = "program output: unsupported full buffer policy '" + policy + "'";
+		return false;
+	}
+
+	size_t buffer_size = 1024 * 1024;
+	const auto& size = m_oc.options["buffer_size"];
+	if(!size.empty())
+	{
+		try
+		{
+			buffer_size = std::stoull(size);
+		}
+		catch(const std::exception& e)
+		{
+			err = "program output: invalid buffer size '" + size + "'";
+			return false;
+		}
+	}
+	m_ring.resize(std::max<size_t>(buffer_size, 1));
+
+	m_writer = std::thread(&output_program::writer, this);
+	return true;
+}
 
 void falco::outputs::output_program::open_pfile()
 {
@@ -33,27 +120,296 @@ void falco::outputs::output_program::open_pfile()
 
 void falco::outputs::output_program::output(const message *msg)
 {
-	open_pfile();
-
-	fprintf(m_pfile, "%s\n", msg->msg.c_str());
+	// the record is the line followed by a newline, or the protobuf
+	// message preceded by its length
+	const std::string* data = &msg->msg;
+	m_record.clear();
+	if(m_encoding == encoding::PROTOBUF)
+	{
+		data = &msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname);
+		append_length_prefix(m_record, data->size());
+	}
 
-	if(m_oc.options["keep_alive"] != "true")
+	if(!m_keep_alive)
 	{
+		open_pfile();
+		fwrite(m_record.data(), 1, m_record.size(), m_pfile);
+		fwrite(data->data(), 1, data->size(), m_pfile);
+		if(m_encoding == encoding::TEXT)
+		{
+			fputc('\n', m_pfile);
+		}
 		cleanup();
+		return;
 	}
+
+	size_t len = m_record.size() + data->size() + (m_encoding == encoding::TEXT ? 1 : 0);
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(len > m_ring.size() || (m_drop_when_full && m_ring.size() - m_size < len))
+	{
+		m_alerts_dropped++;
+		m_bytes_dropped += len;
+		return;
+	}
+	m_cv.wait(lk, [&]{ return m_ring.size() - m_size >= len; });
+
+	append(m_record.data(), m_record.size());
+	append(data->data(), data->size());
+	if(m_encoding == encoding::TEXT)
+	{
+		append("\n", 1);
+	}
+	m_records.push_back(len);
+
+	lk.unlock();
+	m_cv.notify_all();
+}
+
+// Copies data at the tail of the ring, wrapping around
+void falco::outputs::output_program::append(const char* data, size_t len)
+{
+	size_t tail = (m_head + m_size) % m_ring.size();
+	size_t first = std::min(len, m_ring.size() - tail);
+	memcpy(&m_ring[tail], data, first);
+	memcpy(&m_ring[0], data + first, len - first);
+	m_size += len;
 }
 
 void falco::outputs::output_program::cleanup()
 {
-	if(m_pfile != nullptr)
+	if(!m_keep_alive)
 	{
-		pclose(m_pfile);
-		m_pfile = nullptr;
+		if(m_pfile != nullptr)
+		{
+			pclose(m_pfile);
+			m_pfile = nullptr;
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(!m_cv.wait_for(lk, s_cleanup_timeout, [this]{ return m_size == 0; }))
+	{
+		falco_logger::log(falco_logger::level::ERR, "program output: timed out while writing pending alerts\n");
 	}
 }
 
 void falco::outputs::output_program::reopen()
 {
-	cleanup();
-	open_pfile();
+	if(!m_keep_alive)
+	{
+		cleanup();
+		open_pfile();
+		return;
+	}
+
+	// the writer thread restarts the program
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_reopen = true;
+	}
+	m_cv.notify_all();
+}
+
+void falco::outputs::output_program::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	if(m_keep_alive)
+	{
+		metrics["bytes_written"] = m_bytes_written.load();
+		metrics["bytes_dropped"] = m_bytes_dropped.load();
+		metrics["alerts_dropped"] = m_alerts_dropped.load();
+		metrics["restarts"] = m_restarts.load();
+	}
+}
+
+bool falco::outputs::output_program::spawn()
+{
+	m_last_spawn = std::chrono::steady_clock::now();
+
+	int fds[2];
+	if(pipe(fds) != 0)
+	{
+		falco_logger::log(falco_logger::level::ERR, "program output: failed to create pipe: " + std::string(strerror(errno)) + "\n");
+		return false;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+#ifdef F_SETNOSIGPIPE
+	fcntl(fds[1], F_SETNOSIGPIPE, 1);
+#endif
+
+	posix_spawn_file_actions_t fa;
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_adddup2(&fa, fds[0], STDIN_FILENO);
+
+	std::string program = m_oc.options["program"];
+	char sh[] = "/bin/sh";
+	char c[] = "-c";
+	char *argv[] = {sh, c, &program[0], nullptr};
+	pid_t pid;
+	int res = posix_spawn(&pid, sh, &fa, nullptr, argv, environ);
+	posix_spawn_file_actions_destroy(&fa);
+	close(fds[0]);
+
+	if(res != 0)
+	{
+		close(fds[1]);
+		falco_logger::log(falco_logger::level::ERR, "program output: failed to start program: " + std::string(strerror(res)) + "\n");
+		return false;
+	}
+
+	m_fd = fds[1];
+	m_pid = pid;
+	return true;
+}
+
+// Closes the pipe to the child, which exits once it reads the pending
+// input, and returns its pid
+pid_t falco::outputs::output_program::close_child()
+{
+	if(m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+	pid_t pid = m_pid;
+	m_pid = -1;
+	return pid;
+}
+
+// The child can take a while to exit, during which the alerts keep being
+// added to the ring
+void falco::outputs::output_program::reap_child(pid_t pid, std::unique_lock<std::mutex>& lk)
+{
+	if(pid <= 0)
+	{
+		return;
+	}
+	lk.unlock();
+	waitpid(pid, nullptr, 0);
+	lk.lock();
+}
+
+// After the program exits in the middle of a record, the rest of the
+// record is discarded so that the next instance only receives whole ones
+void falco::outputs::output_program::drop_partial_record()
+{
+	if(m_front_written == 0 || m_records.empty())
+	{
+		return;
+	}
+	size_t rest = m_records.front() - m_front_written;
+	m_head = (m_head + rest) % m_ring.size();
+	m_size -= rest;
+	m_bytes_dropped += rest;
+	m_records.pop_front();
+	m_front_written = 0;
+}
+
+void falco::outputs::output_program::writer() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+#ifndef F_SETNOSIGPIPE
+	// writing to a program that exited raises SIGPIPE, which is kept
+	// pending for this thread instead of terminating the process
+	sigset_t sigpipe;
+	sigemptyset(&sigpipe);
+	sigaddset(&sigpipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+#endif
+
+	std::unique_lock<std::mutex> lk(m_mtx);
+	for(;;)
+	{
+		if(m_reopen)
+		{
+			m_reopen = false;
+			reap_child(close_child(), lk);
+			continue;
+		}
+
+		if(m_stop && m_size > 0)
+		{
+			// cleanup() already waited for the program to catch up
+			m_bytes_dropped += m_size;
+			m_size = 0;
+			m_records.clear();
+			m_front_written = 0;
+		}
+
+		if(m_size == 0)
+		{
+			if(m_stop)
+			{
+				break;
+			}
+			m_cv.notify_all();
+			m_cv.wait(lk);
+			continue;
+		}
+
+		if(m_fd < 0)
+		{
+			auto next_spawn = m_last_spawn + s_restart_backoff;
+			if(std::chrono::steady_clock::now() < next_spawn)
+			{
+				if(m_cv.wait_until(lk, next_spawn, [this]{ return m_stop; }))
+				{
+					break;
+				}
+				continue;
+			}
+			if(!spawn())
+			{
+				continue;
+			}
+			drop_partial_record();
+			continue;
+		}
+
+		// the producer only appends after the pending bytes, so they
+		// can be written without holding the lock
+		int fd = m_fd;
+		char *data = &m_ring[m_head];
+		size_t chunk = std::min(m_size, m_ring.size() - m_head);
+		lk.unlock();
+		ssize_t n = write(fd, data, chunk);
+		int err = errno;
+		if(n < 0 && err == EAGAIN)
+		{
+			struct pollfd pfd = {fd, POLLOUT, 0};
+			poll(&pfd, 1, 100);
+		}
+		lk.lock();
+
+		if(n > 0)
+		{
+			m_head = (m_head + n) % m_ring.size();
+			m_size -= n;
+			m_front_written += n;
+			while(!m_records.empty() && m_front_written >= m_records.front())
+			{
+				m_front_written -= m_records.front();
+				m_records.pop_front();
+			}
+			m_bytes_written += n;
+			m_cv.notify_all();
+		}
+		else if(n < 0 && err != EAGAIN && err != EINTR)
+		{
+#ifndef F_SETNOSIGPIPE
+			if(err == EPIPE)
+			{
+				struct timespec zero = {0, 0};
+				sigtimedwait(&sigpipe, nullptr, &zero);
+			}
+#endif
+			falco_logger::log(falco_logger::level::ERR, "program output: program exited, restarting it: " + std::string(strerror(err)) + "\n");
+			m_restarts++;
+			reap_child(close_child(), lk);
+		}
+	}
+
+	reap_child(close_child(), lk);
 }
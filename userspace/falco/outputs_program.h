@@ -18,24 +18,92 @@ limitations under the License.
 #pragma once
 
 #include "outputs.h"
+#include "outputs_encoding.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
 
 namespace falco
 {
 namespace outputs
 {
 
+/*!
+	\brief Writes alerts to the standard input of a program, one per line,
+	or as length-delimited protobuf messages with the protobuf encoding.
+	Unless keep_alive is set, the program is started again for each alert.
+	With keep_alive, a long-lived child is fed through a non-blocking pipe
+	by a dedicated thread, from a ring buffer that either blocks or drops
+	alerts when full, and the child is restarted when it exits.
+*/
 class output_program : public abstract_output
 {
+public:
+	~output_program();
+
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+
 	void output(const message *msg) override;
 
 	void cleanup() override;
 
 	void reopen() override;
 
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	bool uses_fields() const override
+	{
+		return m_encoding == encoding::PROTOBUF;
+	}
+
 private:
 	void open_pfile();
 
-	FILE *m_pfile;
+	// all of these must be called with m_mtx held
+	bool spawn();
+	pid_t close_child();
+	void append(const char* data, size_t len);
+	void drop_partial_record();
+
+	// waits for the child returned by close_child() to exit, with the
+	// lock of the writer thread released meanwhile
+	static void reap_child(pid_t pid, std::unique_lock<std::mutex>& lk);
+
+	void writer() noexcept;
+
+	FILE *m_pfile = nullptr;
+
+	bool m_keep_alive = false;
+	bool m_drop_when_full = false;
+	encoding m_encoding = encoding::TEXT;
+	std::string m_record;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::vector<char> m_ring;
+	size_t m_head = 0;
+	size_t m_size = 0;
+	// the lengths of the records in the ring, the first of which has
+	// m_front_written bytes already written
+	std::deque<size_t> m_records;
+	size_t m_front_written = 0;
+	bool m_reopen = false;
+	bool m_stop = false;
+	int m_fd = -1;
+	pid_t m_pid = -1;
+	std::chrono::steady_clock::time_point m_last_spawn;
+	std::thread m_writer;
+
+	std::atomic<uint64_t> m_bytes_written{0};
+	std::atomic<uint64_t> m_bytes_dropped{0};
+	std::atomic<uint64_t> m_alerts_dropped{0};
+	std::atomic<uint64_t> m_restarts{0};
 };
 
 } // namespace outputs
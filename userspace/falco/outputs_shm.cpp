@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "outputs_shm.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+falco::outputs::shm_ring::reader::~reader()
+{
+	close();
+}
+
+bool falco::outputs::shm_ring::reader::open(const std::string& path, std::string& err)
+{
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		err = "cannot open " + path + ": " + std::strerror(errno);
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (uint64_t) st.st_size < header_size)
+	{
+		err = path + " is not a Falco shm ring";
+		::close(fd);
+		return false;
+	}
+	void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED)
+	{
+		err = "cannot map " + path + ": " + std::strerror(errno);
+		return false;
+	}
+	m_hdr = static_cast<const header*>(p);
+	m_data = static_cast<const uint8_t*>(p) + header_size;
+	m_map_size = st.st_size;
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(memcmp(m_hdr->magic, magic, sizeof(magic)) != 0 || m_hdr->version != version
+		|| m_hdr->capacity + header_size != m_map_size)
+	{
+		err = path + " is not a Falco shm ring, or not a supported version of it";
+		close();
+		return false;
+	}
+	m_pos = m_hdr->tail.load(std::memory_order_acquire);
+	return true;
+}
+
+void falco::outputs::shm_ring::reader::close()
+{
+	if(m_hdr != nullptr)
+	{
+		munmap(const_cast<header*>(m_hdr), m_map_size);
+		m_hdr = nullptr;
+		m_data = nullptr;
+	}
+}
+
+falco::outputs::shm_ring::reader::result falco::outputs::shm_ring::reader::next(std::string& out, uint64_t& seq)
+{
+	auto capacity = m_hdr->capacity;
+	while(true)
+	{
+		// note: closed is loaded first, so that no alert is missed
+		bool closed = m_hdr->closed.load(std::memory_order_acquire) != 0;
+		uint64_t tail = m_hdr->tail.load(std::memory_order_acquire);
+		if(tail == m_pos)
+		{
+			return closed ? result::CLOSED : result::EMPTY;
+		}
+		if(tail - m_pos > capacity)
+		{
+			m_pos = tail;
+			return result::LAPPED;
+		}
+
+		uint64_t off = m_pos & (capacity - 1);
+		record_header rh;
+		memcpy(&rh, m_data + off, sizeof(rh));
+		// a length overwritten while copying is caught below
+		bool valid = off + record_size(rh.length) <= capacity;
+		if(valid && rh.type == RECORD_ALERT)
+		{
+			out.assign(reinterpret_cast<const char*>(m_data + off + sizeof(rh)), rh.length);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(!valid || m_hdr->tail_intent.load(std::memory_order_relaxed) - m_pos > capacity)
+		{
+			m_pos = m_hdr->tail.load(std::memory_order_acquire);
+			return result::LAPPED;
+		}
+
+		m_pos += record_size(rh.length);
+		if(rh.type == RECORD_ALERT)
+		{
+			seq = rh.seq;
+			return result::ALERT;
+		}
+	}
+}
+
+falco::outputs::output_shm::~output_shm()
+{
+	if(m_hdr != nullptr)
+	{
+		m_hdr->closed.store(1, std::memory_order_release);
+		munmap(m_hdr, m_map_size);
+	}
+}
+
+bool falco::outputs::output_shm::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if(!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err))
+	{
+		return false;
+	}
+
+	if(!parse_encoding(m_oc.options["encoding"], m_encoding))
+	{
+		err = "shm output: invalid encoding '" + m_oc.options["encoding"] + "'";
+		return false;
+	}
+
+	uint64_t size = 0;
+	mode_t mode = 0;
+	try
+	{
+		size = std::stoull(m_oc.options["capacity"]);
+		mode = std::stoul(m_oc.options["mode"], nullptr, 8);
+	}
+	catch(const std::exception& e)
+	{
+		err = "shm output: invalid option value: " + std::string(e.what());
+		return false;
+	}
+	// a power of 2, so that positions are mapped to offsets with a mask
+	m_capacity = 64 * 1024;
+	while(m_capacity < size)
+	{
+		m_capacity <<= 1;
+	}
+
+	// the file of a previous run may still be mapped by readers, which
+	// keep reading it until they see it closed
+	const auto& path = m_oc.options["path"];
+	if(unlink(path.c_str()) != 0 && errno != ENOENT)
+	{
+		err = "shm output: cannot remove " + path + ": " + std::strerror(errno);
+		return false;
+	}
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+	if(fd < 0)
+	{
+		err = "shm output: cannot create " + path + ": " + std::strerror(errno);
+		return false;
+	}
+	// note: the umask may have restricted the mode
+	fchmod(fd, mode);
+	m_map_size = shm_ring::header_size + m_capacity;
+	if(ftruncate(fd, m_map_size) != 0)
+	{
+		err = "shm output: cannot size " + path + ": " + std::strerror(errno);
+		close(fd);
+		return false;
+	}
+	void* p = mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED)
+	{
+		err = "shm output: cannot map " + path + ": " + std::strerror(errno);
+		return false;
+	}
+
+	m_data = static_cast<uint8_t*>(p) + shm_ring::header_size;
+	m_hdr = new (p) shm_ring::header();
+	m_hdr->version = shm_ring::version;
+	m_hdr->encoding = m_encoding == encoding::PROTOBUF ? 1 : 0;
+	m_hdr->capacity = m_capacity;
+	m_hdr->created_ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(m_hdr->magic, shm_ring::magic, sizeof(shm_ring::magic));
+	return true;
+}
+
+void falco::outputs::output_shm::output(const message *msg)
+{
+	if(m_encoding == encoding::PROTOBUF)
+	{
+		write(msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname));
+	}
+	else
+	{
+		write(msg->msg);
+	}
+}
+
+void falco::outputs::output_shm::write(const std::string& data)
+{
+	auto size = shm_ring::record_size(data.size());
+	if(size > m_capacity)
+	{
+		m_hdr->dropped.store(m_hdr->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	// the record and the padding before it, if any, are published at once
+	uint64_t off = m_tail & (m_capacity - 1);
+	uint64_t padding = off + size > m_capacity ? m_capacity - off : 0;
+	uint64_t new_tail = m_tail + padding + size;
+	m_hdr->tail_intent.store(new_tail, std::memory_order_relaxed);
+	// the intent is visible before any of the data it covers is overwritten
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if(padding > 0)
+	{
+		shm_ring::record_header rh{uint32_t(padding - sizeof(rh)), shm_ring::RECORD_PADDING, 0};
+		memcpy(m_data + off, &rh, sizeof(rh));
+		m_hdr->wraps.store(m_hdr->wraps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		off = 0;
+	}
+	shm_ring::record_header rh{uint32_t(data.size()), shm_ring::RECORD_ALERT, ++m_seq};
+	memcpy(m_data + off, &rh, sizeof(rh));
+	memcpy(m_data + off + sizeof(rh), data.data(), data.size());
+
+	m_hdr->last_seq.store(m_seq, std::memory_order_relaxed);
+	m_hdr->tail.store(new_tail, std::memory_order_release);
+	m_tail = new_tail;
+	m_num_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+}
+
+void falco::outputs::output_shm::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	if(m_hdr == nullptr)
+	{
+		return;
+	}
+	metrics["alerts"] = m_hdr->last_seq.load(std::memory_order_relaxed);
+	metrics["bytes"] = m_num_bytes.load(std::memory_order_relaxed);
+	metrics["alerts_dropped"] = m_hdr->dropped.load(std::memory_order_relaxed);
+	metrics["wraps"] = m_hdr->wraps.load(std::memory_order_relaxed);
+	metrics["capacity"] = m_capacity;
+}
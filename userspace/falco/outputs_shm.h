@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "outputs.h"
+#include "outputs_encoding.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace falco
+{
+namespace outputs
+{
+
+//
+// The layout of the ring file of the shm output, which local processes map
+// read-only to receive the alerts without any syscall. The file starts with
+// a header of shm_ring::header_size bytes, followed by the data area of
+// `capacity` bytes, a power of 2. All the integers are in the byte order of
+// the host.
+//
+// The alerts are written by a single producer, Falco, as records that are
+// aligned on 16 bytes in the data area, each being a record_header followed
+// by `length` bytes of payload. A record never wraps around the end of the
+// data area: when one doesn't fit, the rest of the area is filled with a
+// padding record. Positions are byte offsets that only grow, and the offset
+// of a position in the data area is `position & (capacity - 1)`.
+//
+// Readers don't slow down the producer, which overwrites the oldest records
+// when the data area is full, and each reader keeps its own position. To
+// read the record at a position, a reader:
+//   1. loads `tail` with acquire semantics: no record is there yet if it's
+//      equal to the position, and the reader lapped if it's more than
+//      `capacity` ahead of the position;
+//   2. copies the record header and the payload;
+//   3. loads `tail_intent` after an acquire fence: if it's more than
+//      `capacity` ahead of the position, the producer may have overwritten
+//      the record while it was being copied, and the reader lapped;
+//   4. moves to the next position, `position + align16(16 + length)`, and
+//      skips padding records.
+// A reader that lapped starts over from `tail`, and can count the alerts
+// it lost from the gap between the sequence numbers of the records it read.
+// The producer sets `closed` before it stops writing to the file, e.g. when
+// Falco reloads its configuration, after which the file is recreated and
+// must be opened again.
+//
+namespace shm_ring
+{
+
+constexpr char magic[8] = {'F', 'A', 'L', 'C', 'O', 'S', 'H', 'M'};
+constexpr uint32_t version = 1;
+constexpr uint64_t header_size = 4096;
+constexpr uint64_t record_alignment = 16;
+
+enum record_type : uint32_t
+{
+	RECORD_ALERT = 1,
+	RECORD_PADDING = 2,
+};
+
+struct record_header
+{
+	// the bytes of the payload
+	uint32_t length;
+	uint32_t type;
+	// the sequence number of the alert, starting from 1, or 0 for padding
+	uint64_t seq;
+};
+
+struct header
+{
+	// written once, before `magic`, which is written last
+	char magic[8];
+	uint32_t version;
+	// 0 for text alerts, formatted by Falco as text or JSON, 1 for
+	// falco.outputs.response protobuf messages (see outputs.proto)
+	uint32_t encoding;
+	uint64_t capacity;
+	// the time at which the file was created, in nanoseconds since epoch
+	uint64_t created_ts;
+	uint8_t reserved0[32];
+
+	// written by the producer, on a cache line of their own
+	alignas(64) std::atomic<uint64_t> tail_intent;
+	std::atomic<uint64_t> tail;
+	// the sequence number of the last alert written
+	std::atomic<uint64_t> last_seq;
+	// the alerts dropped because they are larger than the data area
+	std::atomic<uint64_t> dropped;
+	// the times the producer wrapped around the data area
+	std::atomic<uint64_t> wraps;
+	std::atomic<uint32_t> closed;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shm ring needs lock-free 64-bit atomics");
+static_assert(sizeof(record_header) == record_alignment, "the record headers must be 16 bytes");
+static_assert(sizeof(header) <= header_size, "the shm ring header is too large");
+
+inline uint64_t record_size(uint64_t length)
+{
+	return (sizeof(record_header) + length + record_alignment - 1) & ~(record_alignment - 1);
+}
+
+/*!
+	\brief A reader of a ring file as described above, mostly useful as a
+	reference for the readers in other languages
+*/
+class reader
+{
+public:
+	~reader();
+
+	/*!
+		\brief Maps the given ring file, positioning the reader at its
+		newest alert. Returns false along with an error if that fails.
+	*/
+	bool open(const std::string& path, std::string& err);
+
+	void close();
+
+	enum class result
+	{
+		ALERT,
+		EMPTY,
+		LAPPED,
+		CLOSED,
+	};
+
+	/*!
+		\brief Reads the next alert into out, along with its sequence
+		number. Returns EMPTY when there is none yet, LAPPED when the
+		producer overwrote the next alerts, in which case the reader
+		moved to the newest one, and CLOSED when the producer is gone.
+	*/
+	result next(std::string& out, uint64_t& seq);
+
+	inline const header* hdr() const
+	{
+		return m_hdr;
+	}
+
+private:
+	const header* m_hdr = nullptr;
+	const uint8_t* m_data = nullptr;
+	size_t m_map_size = 0;
+	uint64_t m_pos = 0;
+};
+
+} // namespace shm_ring
+
+/*!
+	\brief Publishes the alerts in a memory-mapped ring file, as described
+	in shm_ring, for local consumers that read them without syscalls. The
+	file is created again, with a new inode, each time the output starts.
+*/
+class output_shm : public abstract_output
+{
+public:
+	~output_shm();
+
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+
+	void output(const message *msg) override;
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	bool uses_fields() const override
+	{
+		return m_encoding == encoding::PROTOBUF;
+	}
+
+private:
+	void write(const std::string& data);
+
+	encoding m_encoding = encoding::TEXT;
+	shm_ring::header* m_hdr = nullptr;
+	uint8_t* m_data = nullptr;
+	size_t m_map_size = 0;
+	uint64_t m_capacity = 0;
+	// only used by the producer, and mirrored in the header
+	uint64_t m_tail = 0;
+	uint64_t m_seq = 0;
+
+	std::atomic<uint64_t> m_num_bytes{0};
+};
+
+} // namespace outputs
+} // namespace falco
@@ -0,0 +1,513 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "outputs_spill.h"
+#include "falco_common.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace falco::outputs;
+
+static constexpr uint32_t s_segment_magic = 0x4c505346; // "FSPL"
+static constexpr uint32_t s_segment_version = 1;
+static const char* s_segment_ext = ".spill";
+
+// Stored at the beginning of each segment, and updated in place as
+// messages are appended and read
+struct segment_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t write_off;
+	uint64_t read_off;
+	uint64_t records;
+	uint64_t records_read;
+};
+
+struct record_header
+{
+	uint32_t len;
+	uint32_t hash;
+};
+
+// FNV-1a, only meant to detect the records that were not entirely
+// written, e.g. because the host crashed
+static uint32_t record_hash(const char* data, size_t len)
+{
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < len; i++)
+	{
+		h ^= (uint8_t) data[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline segment_header* header_of(char* base)
+{
+	return reinterpret_cast<segment_header*>(base);
+}
+
+template<typename T>
+static inline void put_num(std::string& out, T v)
+{
+	out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static inline void put_str(std::string& out, const std::string& s)
+{
+	put_num<uint32_t>(out, s.size());
+	out.append(s);
+}
+
+namespace
+{
+struct reader
+{
+	const char* data;
+	size_t len;
+	size_t pos = 0;
+
+	template<typename T>
+	bool num(T& v)
+	{
+		if(len - pos < sizeof(T))
+		{
+			return false;
+		}
+		memcpy(&v, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	bool str(std::string& s)
+	{
+		uint32_t n;
+		if(!num(n) || len - pos < n)
+		{
+			return false;
+		}
+		s.assign(data + pos, n);
+		pos += n;
+		return true;
+	}
+};
+} // namespace
+
+void falco::outputs::serialize_message(const message& msg, std::string& out)
+{
+	out.clear();
+	put_num<uint64_t>(out, msg.ts);
+	put_num<uint8_t>(out, msg.priority);
+	put_str(out, msg.msg);
+	put_str(out, msg.rule);
+	put_str(out, msg.source);
+	put_num<uint32_t>(out, msg.tags->size());
+	for(const auto& t : *msg.tags)
+	{
+		put_str(out, t);
+	}
+	put_num<uint32_t>(out, msg.fields.size());
+	for(const auto& f : msg.fields)
+	{
+		put_str(out, f.first);
+		put_num<uint8_t>(out, f.second.type);
+		if(f.second.type == falco::field_value::FV_STRING)
+		{
+			put_str(out, f.second.str);
+		}
+		else
+		{
+			put_num<uint64_t>(out, f.second.u);
+		}
+	}
+}
+
+bool falco::outputs::deserialize_message(const char* data, size_t len, message& msg)
+{
+	reader r{data, len};
+	uint8_t priority;
+	std::string s;
+	msg.encoded.clear();
+	if(!r.num(msg.ts) || !r.num(priority) || priority > falco_common::PRIORITY_DEBUG
+		|| !r.str(msg.msg))
+	{
+		return false;
+	}
+	msg.priority = (falco_common::priority_type) priority;
+
+	if(!r.str(s))
+	{
+		return false;
+	}
+	msg.rule = s;
+	if(!r.str(s))
+	{
+		return false;
+	}
+	msg.source = s;
+
+	uint32_t n;
+	if(!r.num(n))
+	{
+		return false;
+	}
+	std::set<std::string> tags;
+	for(uint32_t i = 0; i < n; i++)
+	{
+		if(!r.str(s))
+		{
+			return false;
+		}
+		tags.insert(s);
+	}
+	msg.tags = tags;
+
+	if(!r.num(n))
+	{
+		return false;
+	}
+	msg.fields.resize(n);
+	for(auto& f : msg.fields)
+	{
+		uint8_t type;
+		if(!r.str(s) || !r.num(type) || type > falco::field_value::FV_NULL)
+		{
+			return false;
+		}
+		if(f.first != s)
+		{
+			f.first = s;
+		}
+		f.second.type = (falco::field_value::value_type) type;
+		f.second.str.clear();
+		if(type == falco::field_value::FV_STRING ? !r.str(f.second.str) : !r.num(f.second.u))
+		{
+			return false;
+		}
+	}
+	return r.pos == len;
+}
+
+spill_buffer::spill_buffer(const std::string& dir, uint64_t max_size, uint64_t segment_size)
+	: m_dir(dir),
+	  m_max_size(max_size),
+	  m_segment_size(std::min(segment_size, max_size))
+{
+	if(m_segment_size <= sizeof(segment_header) + sizeof(record_header))
+	{
+		throw falco_exception("spill segment size is too small");
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_dir, ec);
+	if(ec)
+	{
+		throw falco_exception("can't create spill directory " + m_dir + ": " + ec.message());
+	}
+
+	std::vector<uint64_t> seqs;
+	for(const auto& e : std::filesystem::directory_iterator(m_dir, ec))
+	{
+		const auto& p = e.path();
+		auto stem = p.stem().string();
+		if(p.extension() == s_segment_ext && !stem.empty()
+			&& std::all_of(stem.begin(), stem.end(), [](unsigned char c) { return isdigit(c); }))
+		{
+			seqs.push_back(std::stoull(stem));
+		}
+	}
+	if(ec)
+	{
+		throw falco_exception("can't read spill directory " + m_dir + ": " + ec.message());
+	}
+	std::sort(seqs.begin(), seqs.end());
+
+	// pick up the segments left by previous runs, and discard the ones
+	// that have been read entirely or that are not valid
+	for(auto seq : seqs)
+	{
+		m_next_seq = seq + 1;
+		auto path = segment_path(seq);
+		segment_header h;
+		struct stat st;
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		bool valid = fd >= 0
+			&& fstat(fd, &st) == 0
+			&& pread(fd, &h, sizeof(h), 0) == sizeof(h)
+			&& h.magic == s_segment_magic
+			&& h.version == s_segment_version
+			&& h.read_off >= sizeof(h)
+			&& h.read_off <= h.write_off
+			&& h.write_off <= (uint64_t) st.st_size
+			&& h.records_read <= h.records;
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+		if(!valid || h.records_read == h.records)
+		{
+			if(!valid)
+			{
+				falco_logger::log(falco_logger::level::WARNING, "Discarding invalid spill segment " + path + "\n");
+			}
+			unlink(path.c_str());
+			continue;
+		}
+
+		segment s;
+		s.seq = seq;
+		s.size = st.st_size;
+		s.pending = h.records - h.records_read;
+		m_num_pending += s.pending;
+		m_total_size += s.size;
+		m_segments.push_back(s);
+	}
+
+	if(!m_segments.empty())
+	{
+		falco_logger::log(falco_logger::level::INFO, "Found " + std::to_string(m_num_pending.load()) + " spilled alerts in " + m_dir + "\n");
+		if(!map_segment(m_segments.front()) || !map_segment(m_segments.back()))
+		{
+			throw falco_exception("can't map spill segments in " + m_dir + ": " + strerror(errno));
+		}
+	}
+}
+
+spill_buffer::~spill_buffer()
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	for(auto& s : m_segments)
+	{
+		unmap_segment(s);
+	}
+}
+
+std::string spill_buffer::segment_path(uint64_t seq) const
+{
+	// zero-padded, so that the segments sort by name
+	auto name = std::to_string(seq);
+	name.insert(0, 20 - std::min<size_t>(name.size(), 20), '0');
+	return m_dir + "/" + name + s_segment_ext;
+}
+
+bool spill_buffer::map_segment(segment& s)
+{
+	if(s.base)
+	{
+		return true;
+	}
+
+	auto path = segment_path(s.seq);
+	s.fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if(s.fd < 0)
+	{
+		return false;
+	}
+	void* base = mmap(nullptr, s.size, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, 0);
+	if(base == MAP_FAILED)
+	{
+		close(s.fd);
+		s.fd = -1;
+		return false;
+	}
+	s.base = (char*) base;
+	return true;
+}
+
+void spill_buffer::unmap_segment(segment& s)
+{
+	if(!s.base)
+	{
+		return;
+	}
+
+	auto h = header_of(s.base);
+	s.pending = h->records - h->records_read;
+	msync(s.base, s.size, MS_ASYNC);
+	munmap(s.base, s.size);
+	close(s.fd);
+	s.base = nullptr;
+	s.fd = -1;
+}
+
+bool spill_buffer::add_segment()
+{
+	if(m_total_size + m_segment_size > m_max_size)
+	{
+		return false;
+	}
+
+	segment s;
+	s.seq = m_next_seq;
+	s.size = m_segment_size;
+	auto path = segment_path(s.seq);
+	s.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if(s.fd < 0)
+	{
+		falco_logger::log(falco_logger::level::ERR, "Can't create spill segment " + path + ": " + strerror(errno) + "\n");
+		return false;
+	}
+
+	// the space is allocated upfront, as writing to a mapping that can't
+	// be backed by the filesystem kills the process with SIGBUS
+#ifdef __linux__
+	int err = posix_fallocate(s.fd, 0, s.size);
+#else
+	int err = ftruncate(s.fd, s.size) == 0 ? 0 : errno;
+#endif
+	void* base = err == 0 ? mmap(nullptr, s.size, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, 0) : MAP_FAILED;
+	if(base == MAP_FAILED)
+	{
+		falco_logger::log(falco_logger::level::ERR, "Can't allocate spill segment " + path + ": " + strerror(err ? err : errno) + "\n");
+		close(s.fd);
+		unlink(path.c_str());
+		return false;
+	}
+	s.base = (char*) base;
+
+	auto h = header_of(s.base);
+	h->magic = s_segment_magic;
+	h->version = s_segment_version;
+	h->write_off = sizeof(segment_header);
+	h->read_off = sizeof(segment_header);
+	h->records = 0;
+	h->records_read = 0;
+
+	// only the segments being read and written stay mapped
+	if(m_segments.size() > 1)
+	{
+		unmap_segment(m_segments.back());
+	}
+	m_segments.push_back(s);
+	m_total_size += s.size;
+	m_next_seq++;
+	return true;
+}
+
+bool spill_buffer::append(const message& msg)
+{
+	serialize_message(msg, m_buf);
+	uint64_t len = sizeof(record_header) + m_buf.size();
+	if(m_segments.empty()
+		|| header_of(m_segments.back().base)->write_off + len > m_segments.back().size)
+	{
+		if(len > m_segment_size - sizeof(segment_header) || !add_segment())
+		{
+			m_num_drops++;
+			return false;
+		}
+	}
+
+	auto& s = m_segments.back();
+	auto h = header_of(s.base);
+	record_header r{(uint32_t) m_buf.size(), record_hash(m_buf.data(), m_buf.size())};
+	memcpy(s.base + h->write_off, &r, sizeof(r));
+	memcpy(s.base + h->write_off + sizeof(r), m_buf.data(), m_buf.size());
+	h->write_off += len;
+	h->records++;
+	m_num_pending++;
+	m_num_spilled++;
+	return true;
+}
+
+spill_buffer::push_result spill_buffer::spill(const message& msg)
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	return append(msg) ? SPILLED : DROPPED;
+}
+
+void spill_buffer::remove_front()
+{
+	auto& s = m_segments.front();
+	unmap_segment(s);
+	unlink(segment_path(s.seq).c_str());
+	m_total_size -= s.size;
+	m_segments.pop_front();
+
+	// the segments that can't be mapped anymore are lost
+	while(!m_segments.empty() && !map_segment(m_segments.front()))
+	{
+		auto& f = m_segments.front();
+		falco_logger::log(falco_logger::level::ERR, "Can't map spill segment " + segment_path(f.seq) + ": " + strerror(errno) + "\n");
+		m_num_drops += f.pending;
+		m_num_pending -= f.pending;
+		unlink(segment_path(f.seq).c_str());
+		m_total_size -= f.size;
+		m_segments.pop_front();
+	}
+}
+
+bool spill_buffer::pop(message& msg)
+{
+	std::lock_guard<std::mutex> lk(m_mtx);
+	while(!m_segments.empty())
+	{
+		auto& s = m_segments.front();
+		auto h = header_of(s.base);
+		if(h->records_read < h->records)
+		{
+			record_header r;
+			bool ok = h->read_off + sizeof(r) <= h->write_off;
+			if(ok)
+			{
+				memcpy(&r, s.base + h->read_off, sizeof(r));
+				const char* data = s.base + h->read_off + sizeof(r);
+				ok = h->read_off + sizeof(r) + r.len <= h->write_off
+					&& record_hash(data, r.len) == r.hash
+					&& deserialize_message(data, r.len, msg);
+			}
+			if(ok)
+			{
+				h->read_off += sizeof(r) + r.len;
+				h->records_read++;
+				m_num_pending--;
+				return true;
+			}
+
+			// nothing after a corrupted record can be trusted
+			auto lost = h->records - h->records_read;
+			falco_logger::log(falco_logger::level::ERR, "Discarding " + std::to_string(lost) + " corrupted alerts from spill segment " + segment_path(s.seq) + "\n");
+			m_num_drops += lost;
+			m_num_pending -= lost;
+			h->records_read = h->records;
+		}
+
+		// the last segment is the one being written, so it's reused
+		// from the beginning instead of being replaced
+		if(m_segments.size() == 1)
+		{
+			h->write_off = sizeof(segment_header);
+			h->read_off = sizeof(segment_header);
+			h->records = 0;
+			h->records_read = 0;
+			return false;
+		}
+		remove_front();
+	}
+	return false;
+}
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "outputs.h"
+
+namespace falco
+{
+namespace outputs
+{
+
+//
+// The configuration of the disk-backed overflow of the output queues
+//
+struct spill_config
+{
+	bool enabled = false;
+	std::string path = "/var/lib/falco/outputs_spill";
+	uint64_t max_size = 256 * 1024 * 1024;
+	uint64_t segment_size = 16 * 1024 * 1024;
+};
+
+/*!
+	\brief Serializes msg into out, replacing its content
+*/
+void serialize_message(const message& msg, std::string& out);
+
+/*!
+	\brief Deserializes the message at data into msg, which is
+	overwritten. Returns false if the data is malformed.
+*/
+bool deserialize_message(const char* data, size_t len, message& msg);
+
+/*!
+	\brief A first-in first-out buffer of alerts stored on disk, which
+	is the overflow of the in-memory queue of an output. The alerts are
+	appended to fixed-size segment files in a directory, which are
+	memory-mapped, and each segment keeps track of how much of it has been
+	read so that the buffer survives restarts. Segments are removed once
+	read entirely, and at most the segments being written and read are
+	mapped at any time. This class is thread-safe, and meant to be used by
+	one producer and one consumer.
+*/
+class spill_buffer
+{
+public:
+	enum push_result
+	{
+		QUEUED = 0,
+		SPILLED = 1,
+		DROPPED = 2,
+	};
+
+	/*!
+		\brief Opens the buffer in the given directory, which is created
+		if needed, and picks up the alerts spilled by previous runs
+		\throws falco_exception if the directory can't be used
+	*/
+	spill_buffer(const std::string& dir, uint64_t max_size, uint64_t segment_size);
+	virtual ~spill_buffer();
+
+	spill_buffer(spill_buffer&&) = delete;
+	spill_buffer& operator = (spill_buffer&&) = delete;
+	spill_buffer(const spill_buffer&) = delete;
+	spill_buffer& operator = (const spill_buffer&) = delete;
+
+	/*!
+		\brief Invokes try_queue to push the message to the in-memory
+		queue if nothing is spilled, and spills the message if that's not
+		the case or if try_queue returns false. This keeps the alerts in
+		order, and pop() returning false guarantees that the following
+		messages go through the in-memory queue until it's full again.
+	*/
+	template<typename F>
+	push_result push(const message& msg, F try_queue)
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(m_num_pending == 0 && try_queue())
+		{
+			return QUEUED;
+		}
+		return append(msg) ? SPILLED : DROPPED;
+	}
+
+	/*!
+		\brief Spills the message, regardless of the in-memory queue
+	*/
+	push_result spill(const message& msg);
+
+	/*!
+		\brief Pops the oldest spilled message into msg, and returns
+		false if there is none
+	*/
+	bool pop(message& msg);
+
+	/*!
+		\brief Returns the number of spilled messages not read yet
+	*/
+	inline uint64_t num_pending() const
+	{
+		return m_num_pending.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the number of messages spilled so far
+	*/
+	inline uint64_t num_spilled() const
+	{
+		return m_num_spilled.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the number of messages dropped because the buffer
+		was full, or because they were corrupted on disk
+	*/
+	inline uint64_t num_drops() const
+	{
+		return m_num_drops.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct segment
+	{
+		uint64_t seq = 0;
+		uint64_t size = 0;
+		int fd = -1;
+		char* base = nullptr;
+
+		// the messages not read yet, as of when it was last unmapped
+		uint64_t pending = 0;
+	};
+
+	bool append(const message& msg);
+	bool add_segment();
+	bool map_segment(segment& s);
+	void unmap_segment(segment& s);
+	void remove_front();
+	std::string segment_path(uint64_t seq) const;
+
+	std::string m_dir;
+	uint64_t m_max_size;
+	uint64_t m_segment_size;
+
+	std::mutex m_mtx;
+	std::deque<segment> m_segments;
+	uint64_t m_total_size = 0;
+	uint64_t m_next_seq = 0;
+	std::string m_buf;
+
+	std::atomic<uint64_t> m_num_pending = 0;
+	std::atomic<uint64_t> m_num_spilled = 0;
+	std::atomic<uint64_t> m_num_drops = 0;
+};
+
+} // namespace outputs
+} // namespace falco
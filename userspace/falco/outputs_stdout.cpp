@@ -16,24 +16,65 @@ limitations under the License.
 */
 
 #include "outputs_stdout.h"
+
+#include <cstdio>
 #include <iostream>
 
+bool falco::outputs::output_stdout::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
+		return false;
+	}
+
+	size_t buffer_size = 64 * 1024;
+	auto it = m_oc.options.find("buffer_size");
+	if(it != m_oc.options.end() && !it->second.empty())
+	{
+		try
+		{
+			buffer_size = std::stoull(it->second);
+		}
+		catch(const std::exception& e)
+		{
+			err = "stdout output: invalid buffer size: " + std::string(e.what());
+			return false;
+		}
+	}
+
+	// alerts are written straight to the file descriptor, so whatever
+	// has been written through the standard streams so far goes first
+	std::cout.flush();
+	std::fflush(stdout);
+#ifdef _WIN32
+	m_writer.set_fd(_fileno(stdout));
+#else
+	m_writer.set_fd(fileno(stdout));
+#endif
+	m_writer.set_capacity(buffer_size);
+	return true;
+}
+
 void falco::outputs::output_stdout::output(const message *msg)
 {
-	//
-	// By default, the stdout stream is fully buffered or line buffered
-	// (if the stream can be determined to refer to an interactive device, e.g. in a TTY).
-	// Just enable automatic flushing when unbuffered output is desired.
-	// Note that it is set every time since other writings to the stdout can disable it.
-	//
+	m_writer.write_line(msg->msg);
+}
+
+void falco::outputs::output_stdout::cleanup()
+{
+	m_writer.flush();
+}
+
+void falco::outputs::output_stdout::idle()
+{
+	// by default, alerts are written as soon as there are no more queued,
+	// whereas buffered outputs wait for the buffer to be full
 	if(!m_buffered)
 	{
-		std::cout << std::unitbuf;
+		m_writer.flush();
 	}
-	std::cout << msg->msg + "\n";
 }
 
-void falco::outputs::output_stdout::cleanup()
+void falco::outputs::output_stdout::get_metrics(std::map<std::string, uint64_t>& metrics) const
 {
-	std::cout.flush();
+	m_writer.get_metrics(metrics);
 }
@@ -18,17 +18,33 @@ limitations under the License.
 #pragma once
 
 #include "outputs.h"
+#include "fd_writer.h"
 
 namespace falco
 {
 namespace outputs
 {
 
+/*!
+	\brief Writes alerts to the standard output, one per line. The alerts
+	handled while more are queued are written together, and when outputs
+	are buffered they are only written once the buffer is full.
+*/
 class output_stdout : public abstract_output
 {
+public:
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+
 	void output(const message *msg) override;
 
 	void cleanup() override;
+
+	void idle() override;
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+private:
+	fd_writer m_writer;
 };
 
 } // namespace outputs
@@ -16,10 +16,533 @@ limitations under the License.
 */
 
 #include "outputs_syslog.h"
+#include "logger.h"
+#include "thread_affinity.h"
+#include "falco_utils.h"
+
 #include <syslog.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// the time to wait before connecting again after a failure
+static const std::chrono::seconds s_reconnect_backoff(1);
+// the time cleanup() waits for the queued alerts to be sent
+static const std::chrono::seconds s_cleanup_timeout(5);
+// the maximum number of alerts sent with a single system call
+static const size_t s_max_batch = 64;
+
+#ifdef MSG_NOSIGNAL
+static const int s_send_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#else
+static const int s_send_flags = MSG_DONTWAIT;
+#endif
+
+falco::outputs::output_syslog::~output_syslog()
+{
+	if(m_sender.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		m_sender.join();
+	}
+	close_socket();
+}
+
+bool falco::outputs::output_syslog::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
+		return false;
+	}
+
+	const auto& mode = m_oc.options["mode"];
+	if(mode.empty() || mode == "syscall")
+	{
+		return true;
+	}
+	if(mode != "socket")
+	{
+		err = "syslog output: invalid mode '" + mode + "', must be 'syscall' or 'socket'";
+		return false;
+	}
+#ifdef __EMSCRIPTEN__
+	err = "syslog output: socket mode is not supported on this platform";
+	return false;
+#else
+	m_socket_mode = true;
+
+	m_max_queued_bytes = 4 * 1024 * 1024;
+	const auto& buffer_size = m_oc.options["buffer_size"];
+	if(!buffer_size.empty())
+	{
+		try
+		{
+			m_max_queued_bytes = std::stoull(buffer_size);
+		}
+		catch(const std::exception& e)
+		{
+			err = "syslog output: invalid buffer size: " + std::string(e.what());
+			return false;
+		}
+	}
+
+	const auto& address = m_oc.options["address"];
+	if(!parse_address(address.empty() ? "unix:///dev/log" : address, err))
+	{
+		err = "syslog output: " + err;
+		return false;
+	}
+
+	m_pid = getpid();
+	m_sender = std::thread(&output_syslog::sender, this);
+	return true;
+#endif
+}
+
+bool falco::outputs::output_syslog::parse_address(const std::string& address, std::string& err)
+{
+	std::string scheme, rest;
+	auto pos = address.find("://");
+	if(pos != std::string::npos)
+	{
+		scheme = address.substr(0, pos);
+		rest = address.substr(pos + 3);
+	}
+	else if(!address.empty() && address[0] == '/')
+	{
+		scheme = "unix";
+		rest = address;
+	}
+	else
+	{
+		err = "invalid address '" + address + "', must be unix://<path>, udp://<host>:<port>, or tcp://<host>:<port>";
+		return false;
+	}
+
+	if(scheme == "unix")
+	{
+		struct sockaddr_un sun = {};
+		if(rest.empty() || rest.size() >= sizeof(sun.sun_path))
+		{
+			err = "invalid socket path '" + rest + "'";
+			return false;
+		}
+		sun.sun_family = AF_UNIX;
+		memcpy(sun.sun_path, rest.c_str(), rest.size() + 1);
+		memcpy(&m_addr, &sun, sizeof(sun));
+		m_addrlen = sizeof(sun);
+		m_family = AF_UNIX;
+		m_socktype = SOCK_DGRAM;
+		return true;
+	}
+
+	if(scheme != "udp" && scheme != "tcp")
+	{
+		err = "unsupported address scheme '" + scheme + "', must be unix, udp, or tcp";
+		return false;
+	}
+
+	// IPv6 addresses are enclosed in brackets, e.g. udp://[::1]:514
+	std::string host, port;
+	pos = rest.rfind(':');
+	if(pos == std::string::npos || pos + 1 == rest.size())
+	{
+		err = "missing port in address '" + address + "'";
+		return false;
+	}
+	host = rest.substr(0, pos);
+	port = rest.substr(pos + 1);
+	if(host.size() >= 2 && host.front() == '[' && host.back() == ']')
+	{
+		host = host.substr(1, host.size() - 2);
+	}
+
+	struct addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = scheme == "tcp" ? SOCK_STREAM : SOCK_DGRAM;
+	struct addrinfo* res = nullptr;
+	int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+	if(rc != 0 || res == nullptr)
+	{
+		err = "can't resolve address '" + address + "': " + gai_strerror(rc);
+		return false;
+	}
+	memcpy(&m_addr, res->ai_addr, res->ai_addrlen);
+	m_addrlen = res->ai_addrlen;
+	m_family = res->ai_family;
+	m_socktype = res->ai_socktype;
+	freeaddrinfo(res);
+	return true;
+}
+
+void falco::outputs::output_syslog::format_rfc5424(std::string& out, const message& msg, const std::string& hostname,
+						  int pid, bool octet_counting)
+{
+	// PRI, VERSION, TIMESTAMP in UTC with microseconds
+	out.clear();
+	out += '<';
+	out += std::to_string(LOG_USER | (int) msg.priority);
+	out += ">1 ";
+	falco::utils::append_iso8601_utc(out, msg.ts, 6);
+	out += ' ';
+	// HOSTNAME, APP-NAME, PROCID, no MSGID and no STRUCTURED-DATA
+	out.append(hostname.empty() ? "-" : hostname);
+	out.append(" falco ");
+	out.append(std::to_string(pid));
+	out.append(" - - ");
+	out.append(msg.msg);
+
+	if(octet_counting)
+	{
+		out.insert(0, std::to_string(out.size()) + " ");
+	}
+}
 
 void falco::outputs::output_syslog::output(const message *msg)
 {
-	// Syslog output should not have any trailing newline
-	::syslog(msg->priority, "%s", msg->msg.c_str());
+	if(!m_socket_mode)
+	{
+		// Syslog output should not have any trailing newline
+		::syslog(msg->priority, "%s", msg->msg.c_str());
+		return;
+	}
+
+	// the frame buffers are recycled, and formatted outside of the lock
+	entry e;
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(!m_free.empty())
+		{
+			e.frame = std::move(m_free.back());
+			m_free.pop_back();
+		}
+	}
+	format_rfc5424(e.frame, *msg, m_hostname, m_pid, m_socktype == SOCK_STREAM);
+	e.queued_at = clock::now();
+
+	bool notify;
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		if(m_queued_bytes + e.frame.size() > m_max_queued_bytes)
+		{
+			m_alerts_dropped.fetch_add(1, std::memory_order_relaxed);
+			m_free.push_back(std::move(e.frame));
+			return;
+		}
+		m_queued_bytes += e.frame.size();
+		m_queue.push_back(std::move(e));
+		notify = !m_sending;
+	}
+	if(notify)
+	{
+		m_cv.notify_all();
+	}
+}
+
+void falco::outputs::output_syslog::cleanup()
+{
+	if(!m_socket_mode)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(!m_cv.wait_for(lk, s_cleanup_timeout, [this] { return m_queue.empty() && !m_sending; }))
+	{
+		falco_logger::log(falco_logger::level::ERR, "syslog output: timed out while sending pending alerts\n");
+	}
+}
+
+void falco::outputs::output_syslog::reopen()
+{
+	if(!m_socket_mode)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_reopen = true;
+	}
+	m_cv.notify_all();
+}
+
+void falco::outputs::output_syslog::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	if(!m_socket_mode)
+	{
+		return;
+	}
+
+	metrics["sent"] = m_sent.load(std::memory_order_relaxed);
+	metrics["batches"] = m_batches.load(std::memory_order_relaxed);
+	metrics["alerts_dropped"] = m_alerts_dropped.load(std::memory_order_relaxed);
+	metrics["send_errors"] = m_send_errors.load(std::memory_order_relaxed);
+	metrics["reconnects"] = m_reconnects.load(std::memory_order_relaxed);
+	metrics["latency_us_total"] = m_latency_us_total.load(std::memory_order_relaxed);
+}
+
+bool falco::outputs::output_syslog::connect_socket()
+{
+	m_sock = socket(m_family, m_socktype, 0);
+	if(m_sock < 0)
+	{
+		return false;
+	}
+	fcntl(m_sock, F_SETFD, FD_CLOEXEC);
+	fcntl(m_sock, F_SETFL, fcntl(m_sock, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+	int one = 1;
+	setsockopt(m_sock, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+	if(connect(m_sock, (struct sockaddr*) &m_addr, m_addrlen) != 0)
+	{
+		if(errno != EINPROGRESS)
+		{
+			return false;
+		}
+
+		// a stream connection completes once the socket is writable
+		int soerr = 0;
+		socklen_t soerr_len = sizeof(soerr);
+		if(!wait_writable()
+		   || getsockopt(m_sock, SOL_SOCKET, SO_ERROR, &soerr, &soerr_len) != 0
+		   || soerr != 0)
+		{
+			errno = soerr != 0 ? soerr : errno;
+			return false;
+		}
+	}
+
+	m_partial = 0;
+	return true;
+}
+
+void falco::outputs::output_syslog::close_socket()
+{
+	if(m_sock >= 0)
+	{
+		close(m_sock);
+		m_sock = -1;
+	}
+}
+
+bool falco::outputs::output_syslog::wait_writable()
+{
+	// the timeout is short, so that stopping is never delayed for long
+	struct pollfd pfd = {m_sock, POLLOUT, 0};
+	while(!m_stop)
+	{
+		int rc = poll(&pfd, 1, 100);
+		if(rc > 0)
+		{
+			return (pfd.revents & POLLOUT) != 0;
+		}
+		if(rc < 0 && errno != EINTR)
+		{
+			return false;
+		}
+	}
+	errno = ECANCELED;
+	return false;
+}
+
+size_t falco::outputs::output_syslog::send_datagrams(std::vector<entry>& batch, size_t from)
+{
+	size_t n = std::min(batch.size() - from, s_max_batch);
+#ifdef __linux__
+	struct iovec iov[s_max_batch];
+	struct mmsghdr msgs[s_max_batch];
+	for(size_t i = 0; i < n; i++)
+	{
+		iov[i].iov_base = (void*) batch[from + i].frame.data();
+		iov[i].iov_len = batch[from + i].frame.size();
+		msgs[i] = {};
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	int rc = sendmmsg(m_sock, msgs, n, s_send_flags);
+	return rc > 0 ? rc : 0;
+#else
+	ssize_t rc = send(m_sock, batch[from].frame.data(), batch[from].frame.size(), s_send_flags);
+	return rc >= 0 ? 1 : 0;
+#endif
+}
+
+size_t falco::outputs::output_syslog::send_stream(std::vector<entry>& batch, size_t from)
+{
+	size_t n = std::min(batch.size() - from, std::min(s_max_batch, (size_t) IOV_MAX));
+	struct iovec iov[s_max_batch];
+	for(size_t i = 0; i < n; i++)
+	{
+		iov[i].iov_base = (void*) batch[from + i].frame.data();
+		iov[i].iov_len = batch[from + i].frame.size();
+	}
+	iov[0].iov_base = (char*) iov[0].iov_base + m_partial;
+	iov[0].iov_len -= m_partial;
+
+	struct msghdr mh = {};
+	mh.msg_iov = iov;
+	mh.msg_iovlen = n;
+	ssize_t rc = sendmsg(m_sock, &mh, s_send_flags);
+	if(rc < 0)
+	{
+		return 0;
+	}
+
+	size_t written = rc;
+	size_t sent = 0;
+	while(sent < n && written >= iov[sent].iov_len)
+	{
+		written -= iov[sent].iov_len;
+		sent++;
+	}
+	m_partial = sent == 0 ? m_partial + written : written;
+	if(sent == 0)
+	{
+		// nothing was sent entirely, e.g. because the socket buffer
+		// is full, so let the caller wait for it to be writable
+		errno = EAGAIN;
+	}
+	return sent;
+}
+
+void falco::outputs::output_syslog::sender() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+	std::vector<entry> batch;
+	size_t next = 0;
+	bool failing = false;
+	bool connected = false;
+
+	std::unique_lock<std::mutex> lk(m_mtx);
+	while(true)
+	{
+		if(m_reopen)
+		{
+			m_reopen = false;
+			close_socket();
+			m_next_connect = clock::time_point();
+		}
+
+		if(next == batch.size())
+		{
+			// the alerts of a batch count as queued until they are done
+			for(auto& e : batch)
+			{
+				m_queued_bytes -= e.frame.size();
+				m_free.push_back(std::move(e.frame));
+			}
+			batch.clear();
+			next = 0;
+
+			if(m_queue.empty())
+			{
+				m_sending = false;
+				m_cv.notify_all();
+				if(m_stop)
+				{
+					break;
+				}
+				m_cv.wait(lk, [this] { return m_stop || m_reopen || !m_queue.empty(); });
+				continue;
+			}
+
+			m_sending = true;
+			while(!m_queue.empty())
+			{
+				batch.push_back(std::move(m_queue.front()));
+				m_queue.pop_front();
+			}
+		}
+
+		if(m_stop)
+		{
+			// whatever is left when stopping is dropped, since
+			// cleanup() has already waited for it to be sent
+			m_alerts_dropped.fetch_add(batch.size() - next + m_queue.size(), std::memory_order_relaxed);
+			break;
+		}
+
+		if(m_sock < 0 && clock::now() < m_next_connect)
+		{
+			m_cv.wait_until(lk, m_next_connect, [this] { return m_stop || m_reopen; });
+			continue;
+		}
+
+		lk.unlock();
+		if(m_sock < 0)
+		{
+			if(connect_socket())
+			{
+				if(connected)
+				{
+					m_reconnects.fetch_add(1, std::memory_order_relaxed);
+				}
+				connected = true;
+			}
+			else
+			{
+				if(!failing)
+				{
+					falco_logger::log(falco_logger::level::ERR, "syslog output: can't connect: " + std::string(strerror(errno)) + "\n");
+					failing = true;
+				}
+				m_send_errors.fetch_add(1, std::memory_order_relaxed);
+				close_socket();
+				m_next_connect = clock::now() + s_reconnect_backoff;
+				lk.lock();
+				continue;
+			}
+		}
+
+		size_t sent = m_socktype == SOCK_STREAM ? send_stream(batch, next) : send_datagrams(batch, next);
+		if(sent > 0)
+		{
+			auto now = clock::now();
+			uint64_t latency_us = 0;
+			for(size_t i = next; i < next + sent; i++)
+			{
+				latency_us += std::chrono::duration_cast<std::chrono::microseconds>(now - batch[i].queued_at).count();
+			}
+			m_latency_us_total.fetch_add(latency_us, std::memory_order_relaxed);
+			m_sent.fetch_add(sent, std::memory_order_relaxed);
+			m_batches.fetch_add(1, std::memory_order_relaxed);
+			next += sent;
+			failing = false;
+		}
+		else if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+		{
+			wait_writable();
+		}
+		else if(errno == EMSGSIZE)
+		{
+			// the alert can't fit in a datagram, so it's dropped
+			m_alerts_dropped.fetch_add(1, std::memory_order_relaxed);
+			next++;
+		}
+		else if(errno != EINTR)
+		{
+			if(!failing)
+			{
+				falco_logger::log(falco_logger::level::ERR, "syslog output: send failed: " + std::string(strerror(errno)) + "\n");
+				failing = true;
+			}
+			m_send_errors.fetch_add(1, std::memory_order_relaxed);
+			close_socket();
+			m_next_connect = clock::now() + s_reconnect_backoff;
+		}
+		lk.lock();
+	}
 }
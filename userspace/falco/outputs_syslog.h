@@ -19,14 +19,101 @@ limitations under the License.
 
 #include "outputs.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
 namespace falco
 {
 namespace outputs
 {
 
+/*!
+	\brief Sends alerts to syslog. By default, alerts are sent with
+	syslog(3) by the output thread. In socket mode, alerts are framed as
+	RFC 5424 messages and queued, and a dedicated thread sends them in
+	batches through a non-blocking datagram or stream socket, reconnecting
+	when needed. Alerts are dropped when the queue is full, so that a slow
+	syslog daemon never blocks the output thread.
+*/
 class output_syslog : public abstract_output
 {
+public:
+	~output_syslog();
+
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+
 	void output(const message *msg) override;
+
+	void cleanup() override;
+
+	void reopen() override;
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	/*!
+		\brief Formats msg as an RFC 5424 syslog message into out, prefixed
+		by its length when octet_counting is set, as required by the
+		stream transports (RFC 6587)
+	*/
+	static void format_rfc5424(std::string& out, const message& msg, const std::string& hostname,
+				  int pid, bool octet_counting);
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct entry
+	{
+		std::string frame;
+		clock::time_point queued_at;
+	};
+
+	bool parse_address(const std::string& address, std::string& err);
+
+	// these are only called by the sender thread
+	bool connect_socket();
+	void close_socket();
+	bool wait_writable();
+	size_t send_datagrams(std::vector<entry>& batch, size_t from);
+	size_t send_stream(std::vector<entry>& batch, size_t from);
+
+	void sender() noexcept;
+
+	bool m_socket_mode = false;
+	int m_family = AF_UNSPEC;
+	int m_socktype = SOCK_DGRAM;
+	struct sockaddr_storage m_addr = {};
+	socklen_t m_addrlen = 0;
+	int m_sock = -1;
+	int m_pid = 0;
+	clock::time_point m_next_connect;
+
+	// the bytes of a partially sent stream frame, which is sent again
+	// entirely on a new connection
+	size_t m_partial = 0;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::deque<entry> m_queue;
+	std::vector<std::string> m_free;
+	size_t m_queued_bytes = 0;
+	size_t m_max_queued_bytes = 0;
+	bool m_sending = false;
+	bool m_reopen = false;
+	std::atomic<bool> m_stop{false};
+	std::thread m_sender;
+
+	std::atomic<uint64_t> m_sent{0};
+	std::atomic<uint64_t> m_batches{0};
+	std::atomic<uint64_t> m_alerts_dropped{0};
+	std::atomic<uint64_t> m_send_errors{0};
+	std::atomic<uint64_t> m_reconnects{0};
+	std::atomic<uint64_t> m_latency_us_total{0};
 };
 
 } // namespace outputs
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "outputs_unix_socket.h"
+#include "falco_utils.h"
+#include "logger.h"
+#include "thread_affinity.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// the time cleanup() waits for the pending alerts to be written
+static const std::chrono::seconds s_cleanup_timeout(5);
+
+falco::outputs::output_unix_socket::~output_unix_socket()
+{
+	if(m_writer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		m_writer.join();
+	}
+}
+
+bool falco::outputs::output_unix_socket::init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err)
+{
+	if (!falco::outputs::abstract_output::init(oc, buffered, hostname, json_output, err)) {
+		return false;
+	}
+
+	if(!parse_encoding(m_oc.options["encoding"], m_encoding))
+	{
+		err = "unix_socket output: invalid encoding '" + m_oc.options["encoding"] + "'";
+		return false;
+	}
+
+	m_path = m_oc.options["path"];
+	if(falco::utils::network::is_unix_scheme(m_path))
+	{
+		m_path = m_path.substr(falco::utils::network::UNIX_SCHEME.length());
+	}
+	if(m_path.empty() || m_path.size() >= sizeof(sockaddr_un::sun_path))
+	{
+		err = "unix_socket output: invalid socket path '" + m_path + "'";
+		return false;
+	}
+
+	const auto& type = m_oc.options["socket_type"];
+	if(type == "seqpacket")
+	{
+		m_seqpacket = true;
+	}
+	else if(!type.empty() && type != "stream")
+	{
+		err = "unix_socket output: unsupported socket type '" + type + "'";
+		return false;
+	}
+
+	// protobuf messages can't be delimited by newlines, and seqpacket
+	// messages need no delimiter
+	const auto& framing = m_oc.options["framing"];
+	if(framing == "length_prefixed")
+	{
+		m_length_prefixed = true;
+	}
+	else if(!framing.empty() && framing != "newline")
+	{
+		err = "unix_socket output: unsupported framing '" + framing + "'";
+		return false;
+	}
+	m_length_prefixed = !m_seqpacket && (m_length_prefixed || m_encoding == encoding::PROTOBUF);
+
+	const auto& policy = m_oc.options["full_buffer_policy"];
+	if(policy == "drop")
+	{
+		m_drop_when_full = true;
+	}
+	else if(!policy.empty() && policy != "block")
+	{
+		err = "unix_socket output: unsupported full buffer policy '" + policy + "'";
+		return false;
+	}
+
+	size_t buffer_size = 1024 * 1024;
+	try
+	{
+		if(!m_oc.options["buffer_size"].empty())
+		{
+			buffer_size = std::stoull(m_oc.options["buffer_size"]);
+		}
+		if(!m_oc.options["reconnect_backoff_ms"].empty())
+		{
+			m_reconnect_backoff = std::chrono::milliseconds(std::stoull(m_oc.options["reconnect_backoff_ms"]));
+		}
+	}
+	catch(const std::exception& e)
+	{
+		err = "unix_socket output: invalid option value: " + std::string(e.what());
+		return false;
+	}
+	m_ring.resize(std::max<size_t>(buffer_size, 1));
+
+	m_writer = std::thread(&output_unix_socket::writer, this);
+	return true;
+}
+
+void falco::outputs::output_unix_socket::output(const message *msg)
+{
+	const std::string* data = &msg->msg;
+	if(m_encoding == encoding::PROTOBUF)
+	{
+		data = &msg->encoded.get(encoding::PROTOBUF, *msg, m_hostname);
+	}
+	m_record.clear();
+	if(m_length_prefixed)
+	{
+		append_length_prefix(m_record, data->size());
+	}
+	bool newline = !m_seqpacket && !m_length_prefixed;
+
+	size_t len = m_record.size() + data->size() + (newline ? 1 : 0);
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(len > m_ring.size() || (m_drop_when_full && m_ring.size() - m_size < len))
+	{
+		m_alerts_dropped++;
+		m_bytes_dropped += len;
+		return;
+	}
+	m_cv.wait(lk, [&]{ return m_ring.size() - m_size >= len; });
+
+	append(m_record.data(), m_record.size());
+	append(data->data(), data->size());
+	if(newline)
+	{
+		append("\n", 1);
+	}
+	m_records.push_back(len);
+
+	lk.unlock();
+	m_cv.notify_all();
+}
+
+// Copies data at the tail of the ring, wrapping around
+void falco::outputs::output_unix_socket::append(const char* data, size_t len)
+{
+	size_t tail = (m_head + m_size) % m_ring.size();
+	size_t first = std::min(len, m_ring.size() - tail);
+	memcpy(&m_ring[tail], data, first);
+	memcpy(&m_ring[0], data + first, len - first);
+	m_size += len;
+}
+
+// Removes the first n bytes of the ring, which were written or dropped
+void falco::outputs::output_unix_socket::consume(size_t n)
+{
+	m_head = (m_head + n) % m_ring.size();
+	m_size -= n;
+	m_front_written += n;
+	while(!m_records.empty() && m_front_written >= m_records.front())
+	{
+		m_front_written -= m_records.front();
+		m_records.pop_front();
+	}
+	m_cv.notify_all();
+}
+
+void falco::outputs::output_unix_socket::cleanup()
+{
+	std::unique_lock<std::mutex> lk(m_mtx);
+	if(!m_cv.wait_for(lk, s_cleanup_timeout, [this]{ return m_size == 0; }))
+	{
+		falco_logger::log(falco_logger::level::ERR, "unix_socket output: timed out while writing pending alerts\n");
+	}
+}
+
+void falco::outputs::output_unix_socket::reopen()
+{
+	// the writer thread connects again
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_reconnect = true;
+	}
+	m_cv.notify_all();
+}
+
+void falco::outputs::output_unix_socket::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["bytes_written"] = m_bytes_written.load();
+	metrics["bytes_dropped"] = m_bytes_dropped.load();
+	metrics["alerts_dropped"] = m_alerts_dropped.load();
+	metrics["connects"] = m_connects.load();
+	metrics["disconnects"] = m_disconnects.load();
+}
+
+bool falco::outputs::output_unix_socket::connect_socket()
+{
+	m_last_connect = std::chrono::steady_clock::now();
+
+	int fd = socket(AF_UNIX, m_seqpacket ? SOCK_SEQPACKET : SOCK_STREAM, 0);
+	if(fd < 0)
+	{
+		falco_logger::log(falco_logger::level::ERR, "unix_socket output: failed to create socket: " + std::string(strerror(errno)) + "\n");
+		return false;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, m_path.c_str(), m_path.size() + 1);
+	if(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+	{
+		if(!m_connect_failing)
+		{
+			falco_logger::log(falco_logger::level::ERR, "unix_socket output: failed to connect to " + m_path + ", retrying: " + std::string(strerror(errno)) + "\n");
+			m_connect_failing = true;
+		}
+		close(fd);
+		return false;
+	}
+
+	if(m_connect_failing)
+	{
+		falco_logger::log(falco_logger::level::INFO, "unix_socket output: connected to " + m_path + "\n");
+		m_connect_failing = false;
+	}
+	m_fd = fd;
+	m_connects++;
+	return true;
+}
+
+void falco::outputs::output_unix_socket::close_socket()
+{
+	if(m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+// After the connection is lost in the middle of a record, the rest of the
+// record is discarded so that the listener only receives whole ones
+void falco::outputs::output_unix_socket::drop_partial_record()
+{
+	if(m_front_written == 0 || m_records.empty())
+	{
+		return;
+	}
+	size_t rest = m_records.front() - m_front_written;
+	m_bytes_dropped += rest;
+	consume(rest);
+}
+
+void falco::outputs::output_unix_socket::writer() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::OUTPUTS);
+
+	std::unique_lock<std::mutex> lk(m_mtx);
+	for(;;)
+	{
+		if(m_reconnect)
+		{
+			close_socket();
+			m_reconnect = false;
+		}
+
+		if(m_stop && m_size > 0)
+		{
+			// cleanup() already waited for the listener to catch up
+			m_bytes_dropped += m_size;
+			m_size = 0;
+			m_records.clear();
+			m_front_written = 0;
+		}
+
+		if(m_size == 0)
+		{
+			if(m_stop)
+			{
+				break;
+			}
+			m_cv.notify_all();
+			m_cv.wait(lk);
+			continue;
+		}
+
+		if(m_fd < 0)
+		{
+			auto next_connect = m_last_connect + m_reconnect_backoff;
+			if(std::chrono::steady_clock::now() < next_connect)
+			{
+				if(m_cv.wait_until(lk, next_connect, [this]{ return m_stop; }))
+				{
+					break;
+				}
+				continue;
+			}
+			if(connect_socket())
+			{
+				drop_partial_record();
+			}
+			continue;
+		}
+
+		// the producer only appends after the pending bytes, so they can
+		// be written without holding the lock. Each seqpacket message is
+		// a whole record, which may wrap around the ring.
+		struct iovec iov[2];
+		size_t niov = 1;
+		size_t len = m_seqpacket ? m_records.front() : m_size;
+		size_t first = std::min(len, m_ring.size() - m_head);
+		iov[0] = {&m_ring[m_head], first};
+		if(m_seqpacket && first < len)
+		{
+			iov[1] = {&m_ring[0], len - first};
+			niov = 2;
+		}
+		struct msghdr mh = {};
+		mh.msg_iov = iov;
+		mh.msg_iovlen = niov;
+		int fd = m_fd;
+		lk.unlock();
+		ssize_t n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+		int err = errno;
+		if(n < 0 && (err == EAGAIN || err == EWOULDBLOCK))
+		{
+			struct pollfd pfd = {fd, POLLOUT, 0};
+			poll(&pfd, 1, 100);
+		}
+		lk.lock();
+
+		if(n > 0)
+		{
+			consume(n);
+			m_bytes_written += n;
+		}
+		else if(n < 0 && m_seqpacket && err == EMSGSIZE)
+		{
+			// larger than what the socket accepts in a message
+			m_alerts_dropped++;
+			m_bytes_dropped += len;
+			consume(len);
+		}
+		else if(n < 0 && err != EAGAIN && err != EWOULDBLOCK && err != EINTR)
+		{
+			falco_logger::log(falco_logger::level::ERR, "unix_socket output: connection to " + m_path + " lost, reconnecting: " + std::string(strerror(err)) + "\n");
+			close_socket();
+			m_disconnects++;
+		}
+	}
+
+	close_socket();
+}
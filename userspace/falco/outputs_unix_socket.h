@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "outputs.h"
+#include "outputs_encoding.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace falco
+{
+namespace outputs
+{
+
+/*!
+	\brief Writes alerts to a Unix domain socket that a local process
+	listens on, over a persistent connection. With a stream socket, the
+	alerts are delimited by a newline or preceded by their length as a
+	varint, which is how protobuf alerts always are, and with a seqpacket
+	socket each alert is a message of its own. The alerts are collected
+	in a ring buffer that either blocks or drops alerts when full, and are
+	written by a dedicated thread with a non-blocking socket, connecting
+	again after the listener went away.
+*/
+class output_unix_socket : public abstract_output
+{
+public:
+	~output_unix_socket();
+
+	bool init(const config& oc, bool buffered, const std::string& hostname, bool json_output, std::string &err) override;
+
+	void output(const message *msg) override;
+
+	void cleanup() override;
+
+	void reopen() override;
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override;
+
+	bool uses_fields() const override
+	{
+		return m_encoding == encoding::PROTOBUF;
+	}
+
+private:
+	// all of these must be called with m_mtx held
+	bool connect_socket();
+	void close_socket();
+	void append(const char* data, size_t len);
+	void consume(size_t n);
+	void drop_partial_record();
+
+	void writer() noexcept;
+
+	std::string m_path;
+	bool m_seqpacket = false;
+	bool m_length_prefixed = false;
+	bool m_drop_when_full = false;
+	std::chrono::milliseconds m_reconnect_backoff{1000};
+	encoding m_encoding = encoding::TEXT;
+	std::string m_record;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	std::vector<char> m_ring;
+	size_t m_head = 0;
+	size_t m_size = 0;
+	// the lengths of the records in the ring, the first of which has
+	// m_front_written bytes already written
+	std::deque<size_t> m_records;
+	size_t m_front_written = 0;
+	bool m_reconnect = false;
+	bool m_stop = false;
+	int m_fd = -1;
+	// whether the last attempt to connect failed, which is only logged
+	// for the first one
+	bool m_connect_failing = false;
+	std::chrono::steady_clock::time_point m_last_connect;
+	std::thread m_writer;
+
+	std::atomic<uint64_t> m_bytes_written{0};
+	std::atomic<uint64_t> m_bytes_dropped{0};
+	std::atomic<uint64_t> m_alerts_dropped{0};
+	std::atomic<uint64_t> m_connects{0};
+	std::atomic<uint64_t> m_disconnects{0};
+};
+
+} // namespace outputs
+} // namespace falco
@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "plugin_field_batch.h"
+
+#include <libsinsp/utils.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace falco;
+
+// the types of the values that plugins can extract and that are copied
+// by the batch, while the fields of other types are extracted as usual
+static bool is_supported_type(uint32_t type)
+{
+	switch(type)
+	{
+	case PT_CHARBUF:
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+	case PT_BOOL:
+	case PT_IPADDR:
+	case PT_IPNET:
+	case PT_BYTEBUF:
+		return true;
+	default:
+		return false;
+	}
+}
+
+plugin_field_batch::plugin_field_batch(std::shared_ptr<sinsp_plugin> plugin): m_plugin(plugin)
+{
+}
+
+size_t plugin_field_batch::add(const filtercheck_field_info& info, uint32_t field_id,
+	const std::string& arg_key, uint64_t arg_index, bool arg_present, bool for_filtering)
+{
+	if(!is_supported_type(info.m_type))
+	{
+		return SIZE_MAX;
+	}
+
+	std::lock_guard<std::mutex> lk(m_fields_mtx);
+	for(size_t i = 0; i < m_fields.size(); i++)
+	{
+		auto& f = m_fields[i];
+		if(f.id == field_id && f.arg_present == arg_present
+			&& f.arg_key == arg_key && f.arg_index == arg_index)
+		{
+			f.filtering = f.filtering || for_filtering;
+			return i;
+		}
+	}
+
+	field f;
+	f.name = info.m_name;
+	f.arg_key = arg_key;
+	f.arg_index = arg_index;
+	f.arg_present = arg_present;
+	f.id = field_id;
+	f.type = info.m_type;
+	f.list = (info.m_flags & EPF_IS_LIST) != 0;
+	f.filtering = for_filtering;
+	m_fields.push_back(std::move(f));
+	return m_fields.size() - 1;
+}
+
+bool plugin_field_batch::compatible(sinsp_evt* evt)
+{
+	auto idx = evt->get_source_idx();
+	if(idx == sinsp_no_event_source_idx)
+	{
+		return false;
+	}
+	if(idx >= m_compatible_sources.size())
+	{
+		m_compatible_sources.resize(idx + 1, -1);
+	}
+	if(m_compatible_sources[idx] < 0)
+	{
+		auto name = evt->get_source_name();
+		m_compatible_sources[idx] = name != nullptr
+			&& sinsp_plugin::is_source_compatible(m_plugin->extract_event_sources(), name);
+	}
+	return m_compatible_sources[idx] > 0
+		&& m_plugin->extract_event_codes().contains((ppm_event_code) evt->get_type());
+}
+
+void plugin_field_batch::prepare(const field& f, ss_plugin_extract_field& e) const
+{
+	memset(&e, 0, sizeof(e));
+	e.field_id = f.id;
+	e.field = f.name.c_str();
+	e.arg_key = f.arg_present && !f.arg_key.empty() ? f.arg_key.c_str() : nullptr;
+	e.arg_index = f.arg_index;
+	e.arg_present = f.arg_present;
+	e.ftype = f.type;
+	e.flist = f.list;
+}
+
+void plugin_field_batch::store(field& f, const ss_plugin_extract_field& e)
+{
+	f.present = e.res_len > 0;
+	f.data.clear();
+	f.values.clear();
+	for(uint64_t i = 0; i < e.res_len; i++)
+	{
+		const uint8_t* ptr = nullptr;
+		uint32_t len = 0;
+		switch(f.type)
+		{
+		case PT_CHARBUF:
+			ptr = (const uint8_t*) e.res.str[i];
+			len = strlen(e.res.str[i]) + 1;
+			break;
+		case PT_UINT64:
+		case PT_RELTIME:
+		case PT_ABSTIME:
+			ptr = (const uint8_t*) &e.res.u64[i];
+			len = sizeof(uint64_t);
+			break;
+		case PT_BOOL:
+			ptr = (const uint8_t*) &e.res.boolean[i];
+			len = sizeof(ss_plugin_bool);
+			break;
+		default:
+			ptr = (const uint8_t*) e.res.buf[i].ptr;
+			len = e.res.buf[i].len;
+			break;
+		}
+
+		// each value is aligned as the numbers are read in place
+		size_t offset = (f.data.size() + alignof(uint64_t) - 1) & ~(alignof(uint64_t) - 1);
+		f.data.resize(offset + len);
+		memcpy(f.data.data() + offset, ptr, len);
+		f.values.emplace_back(offset, len);
+	}
+}
+
+bool plugin_field_batch::extract_batch(sinsp_evt* evt)
+{
+	// the fields no filter needed for a while, such as the ones of the
+	// rules disabled since, leave the batch
+	if(++m_num_batches % unused_batches == 0)
+	{
+		std::erase_if(m_batched, [this](size_t i)
+		{
+			auto& f = m_fields[i];
+			f.batched = m_num_batches - f.used_batch < unused_batches;
+			return !f.batched;
+		});
+	}
+	if(m_batched.empty())
+	{
+		return false;
+	}
+
+	m_extract.resize(m_batched.size());
+	for(size_t i = 0; i < m_batched.size(); i++)
+	{
+		prepare(m_fields[m_batched[i]], m_extract[i]);
+	}
+	if(!m_plugin->extract_fields(evt, m_extract.size(), m_extract.data()))
+	{
+		return false;
+	}
+	for(size_t i = 0; i < m_batched.size(); i++)
+	{
+		auto& f = m_fields[m_batched[i]];
+		store(f, m_extract[i]);
+		f.evtnum = evt->get_num();
+	}
+	return true;
+}
+
+bool plugin_field_batch::get(sinsp_evt* evt, size_t idx, std::vector<extract_value_t>& values)
+{
+	auto& f = m_fields[idx];
+	uint64_t num = evt->get_num();
+	if(f.evtnum != num)
+	{
+		if(!compatible(evt))
+		{
+			f.evtnum = num;
+			f.present = false;
+			return false;
+		}
+
+		// the batch is extracted once per event, and a field is extracted
+		// on its own if it is not part of it or if the batch failed
+		if(f.batched && m_batch_evtnum != num)
+		{
+			m_batch_evtnum = num;
+			extract_batch(evt);
+		}
+		if(f.evtnum != num)
+		{
+			f.evtnum = num;
+			f.present = false;
+			ss_plugin_extract_field e;
+			prepare(f, e);
+			if(m_plugin->extract_fields(evt, 1, &e))
+			{
+				store(f, e);
+			}
+
+			// a filtering field joins the batch once a filter needs it
+			if(f.filtering && !f.batched)
+			{
+				f.batched = true;
+				m_batched.push_back(idx);
+			}
+		}
+	}
+	f.used_batch = m_num_batches;
+
+	if(!f.present)
+	{
+		return false;
+	}
+	values.clear();
+	for(const auto& v : f.values)
+	{
+		extract_value_t res;
+		res.ptr = f.data.data() + v.first;
+		res.len = v.second;
+		values.push_back(res);
+	}
+	return true;
+}
+
+batched_plugin_filtercheck::batched_plugin_filtercheck(std::shared_ptr<sinsp_plugin> plugin, std::shared_ptr<plugin_field_batch> batch):
+	sinsp_filter_check_plugin(plugin),
+	m_batch(batch)
+{
+}
+
+batched_plugin_filtercheck::batched_plugin_filtercheck(const batched_plugin_filtercheck& c):
+	sinsp_filter_check_plugin(c),
+	m_batch(c.m_batch)
+{
+}
+
+std::unique_ptr<sinsp_filter_check> batched_plugin_filtercheck::allocate_new()
+{
+	return std::make_unique<batched_plugin_filtercheck>(*this);
+}
+
+std::unique_ptr<sinsp_filter_check> batched_plugin_filtercheck::create(std::shared_ptr<sinsp_plugin> plugin)
+{
+	return std::make_unique<batched_plugin_filtercheck>(plugin, std::make_shared<plugin_field_batch>(plugin));
+}
+
+int32_t batched_plugin_filtercheck::parse_field_name(std::string_view str, bool alloc_state, bool needed_for_filtering)
+{
+	int32_t res = sinsp_filter_check_plugin::parse_field_name(str, alloc_state, needed_for_filtering);
+	if(res <= 0 || m_field == nullptr)
+	{
+		return res;
+	}
+
+	// the argument of the field, if any, is between brackets after its name
+	size_t name_len = strlen(m_field->m_name);
+	auto arg = str.substr(0, res).substr(std::min<size_t>(name_len, res));
+	bool arg_present = arg.size() >= 2 && arg.front() == '[' && arg.back() == ']';
+	std::string arg_key;
+	uint64_t arg_index = 0;
+	if(arg_present)
+	{
+		arg = arg.substr(1, arg.size() - 2);
+		if(m_field->m_flags & EPF_ARG_INDEX)
+		{
+			try
+			{
+				arg_index = std::stoull(std::string(arg));
+			}
+			catch(const std::exception&)
+			{
+				// left to the usual extraction, which reports it
+				return res;
+			}
+		}
+		else
+		{
+			arg_key = arg;
+		}
+	}
+	m_batch_idx = m_batch->add(*m_field, m_field_id, arg_key, arg_index, arg_present, needed_for_filtering);
+	return res;
+}
+
+bool batched_plugin_filtercheck::extract_nocache(sinsp_evt* evt, std::vector<extract_value_t>& values, bool sanitize_strings)
+{
+	if(m_batch_idx == SIZE_MAX)
+	{
+		return sinsp_filter_check_plugin::extract_nocache(evt, values, sanitize_strings);
+	}
+	if(!m_batch->get(evt, m_batch_idx, values))
+	{
+		return false;
+	}
+
+	// the values in the batch are kept as extracted, as other
+	// filterchecks may need them unsanitized
+	if(sanitize_strings && m_field->m_type == PT_CHARBUF)
+	{
+		m_sanitized.resize(values.size());
+		for(size_t i = 0; i < values.size(); i++)
+		{
+			m_sanitized[i].assign((const char*) values[i].ptr);
+			sanitize_string(m_sanitized[i]);
+		}
+		for(size_t i = 0; i < values.size(); i++)
+		{
+			values[i].ptr = (uint8_t*) m_sanitized[i].c_str();
+			values[i].len = m_sanitized[i].size() + 1;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <libsinsp/sinsp.h>
+#include <libsinsp/plugin.h>
+#include <libsinsp/plugin_filtercheck.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief The values of the fields of a plugin for the event being
+	evaluated. The fields used by the rule conditions are registered as
+	the rules are compiled, and join the batch the first time a filter
+	evaluates them, so that the fields of the disabled rules are never
+	extracted. The first field of the batch needed for an event extracts
+	all of them with a single call into the plugin, instead of one call
+	per field and per rule, and the fields no filter needed for a while
+	leave it. The values are kept until the next event, so that the rules
+	sharing a field and the outputs of the matching rules find them
+	already extracted. The other fields, such as the ones only used in
+	outputs, are extracted on their own the first time they are needed
+	for an event, and kept as well. Apart from registering fields, which
+	happens when the rules are compiled by several threads, this class
+	is not thread-safe, as the rules of a source are only evaluated by a
+	single thread.
+*/
+class plugin_field_batch
+{
+public:
+	explicit plugin_field_batch(std::shared_ptr<sinsp_plugin> plugin);
+
+	plugin_field_batch(const plugin_field_batch&) = delete;
+	plugin_field_batch& operator = (const plugin_field_batch&) = delete;
+
+	/*!
+		\brief Registers a field along with its argument, if not already
+		registered, and returns its index. The fields registered for
+		filtering are the ones that can join the batch.
+	*/
+	size_t add(const filtercheck_field_info& info, uint32_t field_id,
+		const std::string& arg_key, uint64_t arg_index, bool arg_present,
+		bool for_filtering);
+
+	/*!
+		\brief Sets values to the values of the field with the given index
+		for the event, and returns false if the field has no value for it.
+		The values point into the batch and are valid until the next event.
+	*/
+	bool get(sinsp_evt* evt, size_t idx, std::vector<extract_value_t>& values);
+
+	/*!
+		\brief The number of batches extracted since a field was last
+		needed, after which it leaves the batch
+	*/
+	static constexpr uint64_t unused_batches = 1024;
+
+private:
+	struct field
+	{
+		std::string name;
+		std::string arg_key;
+		uint64_t arg_index = 0;
+		bool arg_present = false;
+		uint32_t id = 0;
+		uint32_t type = 0;
+		bool list = false;
+		bool filtering = false;
+		bool batched = false;
+
+		// the number of batches extracted when the field was last needed
+		uint64_t used_batch = 0;
+
+		// the values extracted for the event with number evtnum, which
+		// are copied as the plugin reuses its buffers at each call
+		uint64_t evtnum = UINT64_MAX;
+		bool present = false;
+		std::vector<uint8_t> data;
+		std::vector<std::pair<size_t, uint32_t>> values;
+	};
+
+	bool compatible(sinsp_evt* evt);
+	void prepare(const field& f, ss_plugin_extract_field& e) const;
+	static void store(field& f, const ss_plugin_extract_field& e);
+	bool extract_batch(sinsp_evt* evt);
+
+	std::shared_ptr<sinsp_plugin> m_plugin;
+	std::mutex m_fields_mtx;
+	std::vector<field> m_fields;
+	std::vector<size_t> m_batched;
+	std::vector<ss_plugin_extract_field> m_extract;
+
+	// the number of the last event the batch was extracted for, and the
+	// number of batches extracted so far
+	uint64_t m_batch_evtnum = UINT64_MAX;
+	uint64_t m_num_batches = 0;
+
+	// whether the plugin extracts fields from the events of each source,
+	// by source index, with -1 for the sources not checked yet
+	std::vector<int8_t> m_compatible_sources;
+};
+
+/*!
+	\brief A filtercheck for the fields of a plugin that takes their values
+	from a batch shared with all the other filterchecks of the same plugin
+	for the same event source, see plugin_field_batch
+*/
+class batched_plugin_filtercheck : public sinsp_filter_check_plugin
+{
+public:
+	batched_plugin_filtercheck(std::shared_ptr<sinsp_plugin> plugin, std::shared_ptr<plugin_field_batch> batch);
+	batched_plugin_filtercheck(const batched_plugin_filtercheck& c);
+	virtual ~batched_plugin_filtercheck() = default;
+
+	std::unique_ptr<sinsp_filter_check> allocate_new() override;
+	int32_t parse_field_name(std::string_view str, bool alloc_state, bool needed_for_filtering) override;
+
+	/*!
+		\brief Returns the filtercheck to add to the filtercheck list of
+		an event source for the given plugin, with its own batch
+	*/
+	static std::unique_ptr<sinsp_filter_check> create(std::shared_ptr<sinsp_plugin> plugin);
+
+protected:
+	bool extract_nocache(sinsp_evt* evt, std::vector<extract_value_t>& values, bool sanitize_strings = true) override;
+
+private:
+	std::shared_ptr<plugin_field_batch> m_batch;
+	size_t m_batch_idx = SIZE_MAX;
+	std::vector<std::string> m_sanitized;
+};
+
+} // namespace falco
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "probe_server.h"
+#include "falco_common.h"
+#include "thread_affinity.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+
+using namespace falco;
+
+// the time a client has to send its request
+static constexpr std::chrono::milliseconds s_request_timeout(500);
+
+// the largest request read, whose headers are read but ignored
+static constexpr size_t s_max_request_size = 4096;
+
+static std::string render(const char* status, const char* content_type, const std::string& body)
+{
+	return std::string("HTTP/1.1 ") + status + "\r\n"
+		+ "Content-Type: " + content_type + "\r\n"
+		+ "Content-Length: " + std::to_string(body.size()) + "\r\n"
+		+ "Connection: close\r\n\r\n"
+		+ body;
+}
+
+probe_server::probe_server(const std::string& healthz_path, const std::string& readyz_path,
+		std::function<bool()> ready):
+	m_healthz_path(healthz_path),
+	m_readyz_path(readyz_path),
+	m_ready(ready),
+	m_ok(render("200 OK", "application/json", "{\"status\": \"ok\"}")),
+	m_starting(render("503 Service Unavailable", "application/json", "{\"status\": \"starting\"}")),
+	m_not_found(render("404 Not Found", "text/plain", "not found\n")),
+	m_bad_request(render("400 Bad Request", "text/plain", "bad request\n"))
+{
+}
+
+probe_server::~probe_server()
+{
+	stop();
+}
+
+void probe_server::start(const std::string& address, uint16_t port)
+{
+	if(m_thread.joinable())
+	{
+		throw falco_exception("probe server: already started");
+	}
+
+	sockaddr_storage addr = {};
+	socklen_t addr_len = 0;
+	auto addr4 = (sockaddr_in*) &addr;
+	auto addr6 = (sockaddr_in6*) &addr;
+	if(inet_pton(AF_INET, address.c_str(), &addr4->sin_addr) == 1)
+	{
+		addr4->sin_family = AF_INET;
+		addr4->sin_port = htons(port);
+		addr_len = sizeof(sockaddr_in);
+	}
+	else if(inet_pton(AF_INET6, address.c_str(), &addr6->sin6_addr) == 1)
+	{
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_port = htons(port);
+		addr_len = sizeof(sockaddr_in6);
+	}
+	else
+	{
+		throw falco_exception("probe server: invalid listen address '" + address + "'");
+	}
+
+	auto fail = [this, &address, port](const char* what)
+	{
+		std::string err = std::string("probe server: ") + what + " " + address + ":"
+			+ std::to_string(port) + ": " + strerror(errno);
+		stop();
+		throw falco_exception(err);
+	};
+
+	m_listen_fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(m_listen_fd < 0)
+	{
+		fail("can't create a socket for");
+	}
+	int one = 1;
+	setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if(bind(m_listen_fd, (sockaddr*) &addr, addr_len) != 0 || listen(m_listen_fd, SOMAXCONN) != 0)
+	{
+		fail("can't listen on");
+	}
+	addr_len = sizeof(addr);
+	if(getsockname(m_listen_fd, (sockaddr*) &addr, &addr_len) != 0)
+	{
+		fail("can't get the port of");
+	}
+	m_port = ntohs(addr.ss_family == AF_INET ? addr4->sin_port : addr6->sin6_port);
+
+	m_stop_fd = eventfd(0, EFD_CLOEXEC);
+	if(m_stop_fd < 0)
+	{
+		fail("can't create an eventfd for");
+	}
+	m_thread = std::thread(&probe_server::serve, this);
+}
+
+void probe_server::stop()
+{
+	if(m_thread.joinable())
+	{
+		uint64_t one = 1;
+		while(write(m_stop_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+		m_thread.join();
+	}
+	if(m_listen_fd >= 0)
+	{
+		close(m_listen_fd);
+		m_listen_fd = -1;
+	}
+	if(m_stop_fd >= 0)
+	{
+		close(m_stop_fd);
+		m_stop_fd = -1;
+	}
+}
+
+void probe_server::serve()
+{
+	falco::thread_affinity::apply(falco::thread_affinity::WEBSERVER);
+
+	pollfd fds[2] = {{m_listen_fd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}};
+	while(true)
+	{
+		if(poll(fds, 2, -1) < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return;
+		}
+		if(fds[1].revents != 0)
+		{
+			return;
+		}
+		if(fds[0].revents & POLLIN)
+		{
+			int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+			if(fd >= 0)
+			{
+				handle(fd);
+				close(fd);
+			}
+		}
+	}
+}
+
+void probe_server::handle(int fd)
+{
+	// the headers are read up to their end before responding, as closing
+	// a connection with data not read resets it and loses the response
+	char buf[s_max_request_size];
+	size_t len = 0;
+	bool complete = false;
+	auto deadline = std::chrono::steady_clock::now() + s_request_timeout;
+	while(!complete && len < sizeof(buf))
+	{
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		pollfd pfd = {fd, POLLIN, 0};
+		if(left <= 0 || poll(&pfd, 1, left) <= 0)
+		{
+			return;
+		}
+		ssize_t n = recv(fd, buf + len, sizeof(buf) - len, MSG_DONTWAIT);
+		if(n < 0 && (errno == EINTR || errno == EAGAIN))
+		{
+			continue;
+		}
+		if(n <= 0)
+		{
+			return;
+		}
+		len += n;
+		complete = std::string_view(buf, len).find("\r\n\r\n") != std::string_view::npos;
+	}
+
+	auto res = complete ? respond(std::string_view(buf, len)) : std::string_view(m_bad_request);
+	size_t sent = 0;
+	while(sent < res.size())
+	{
+		ssize_t n = send(fd, res.data() + sent, res.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(n <= 0)
+		{
+			// the responses fit in the buffer of any new socket
+			return;
+		}
+		sent += n;
+	}
+	shutdown(fd, SHUT_WR);
+}
+
+std::string_view probe_server::respond(std::string_view request) const
+{
+	auto line = request.substr(0, request.find("\r\n"));
+	constexpr std::string_view method = "GET ";
+	if(line.substr(0, method.size()) != method)
+	{
+		return m_bad_request;
+	}
+	line.remove_prefix(method.size());
+	auto path = line.substr(0, line.find(' '));
+	path = path.substr(0, path.find('?'));
+	if(path == m_healthz_path)
+	{
+		return m_ok;
+	}
+	if(path == m_readyz_path)
+	{
+		return m_ready() ? m_ok : m_starting;
+	}
+	return m_not_found;
+}
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace falco
+{
+
+/*!
+	\brief Answers the liveness and readiness probes on a listening socket
+	of its own, apart from the webserver, so that the probes are answered
+	in time even when all the threads of the webserver are busy, e.g. with
+	many concurrent metrics scrapers or a profiling session. A single
+	thread serves the connections one at a time, each with a single
+	request and over plain HTTP, with responses rendered once at startup,
+	so that no memory is allocated after start(). The connections not
+	sending their request in time are dropped, so that a client can't
+	hold the probes for long.
+*/
+class probe_server
+{
+public:
+	/*!
+		\brief Creates a server answering 200 to the given liveness path,
+		and 200 or 503 to the given readiness path depending on whether
+		ready returns true, which is called from the thread of the server
+	*/
+	probe_server(const std::string& healthz_path, const std::string& readyz_path,
+		std::function<bool()> ready);
+
+	/*!
+		\brief Stops the server, if running
+	*/
+	~probe_server();
+
+	probe_server(const probe_server&) = delete;
+	probe_server& operator = (const probe_server&) = delete;
+
+	/*!
+		\brief Starts listening on the given IPv4 or IPv6 address and port,
+		where port 0 picks any free port, and serving the probes in
+		background. Throws a falco_exception if the address can't be
+		listened on.
+	*/
+	void start(const std::string& address, uint16_t port);
+
+	/*!
+		\brief Stops serving the probes and closes the listening socket
+	*/
+	void stop();
+
+	/*!
+		\brief Returns the port listened on, once started
+	*/
+	uint16_t port() const { return m_port; }
+
+private:
+	void serve();
+	void handle(int fd);
+	std::string_view respond(std::string_view request) const;
+
+	const std::string m_healthz_path;
+	const std::string m_readyz_path;
+	const std::function<bool()> m_ready;
+
+	// the complete HTTP responses, headers included
+	std::string m_ok;
+	std::string m_starting;
+	std::string m_not_found;
+	std::string m_bad_request;
+
+	int m_listen_fd = -1;
+	// written to wake up the server when stopping
+	int m_stop_fd = -1;
+	uint16_t m_port = 0;
+	std::thread m_thread;
+};
+
+} // namespace falco
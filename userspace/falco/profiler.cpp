@@ -0,0 +1,338 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "profiler.h"
+#include "logger.h"
+#include "current_rule.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+namespace
+{
+
+constexpr size_t s_label_size = 32;
+
+thread_local char t_label[s_label_size] = {};
+
+// a session running for the whole process, which is tied to the signal
+// handler and so can't be owned by a profiler
+std::atomic<bool> s_busy{false};
+
+#ifdef __linux__
+
+constexpr size_t s_max_frames = 48;
+constexpr size_t s_max_samples = 1 << 16;
+// the frames of the signal handler and of the signal trampoline, on top
+// of the interrupted one
+constexpr int s_skipped_frames = 2;
+
+struct sample
+{
+	void* frames[s_max_frames];
+	int depth;
+	const char* rule;
+	char thread[s_label_size];
+};
+
+std::atomic<bool> s_recording{false};
+std::atomic<int> s_in_handler{0};
+std::atomic<size_t> s_next{0};
+std::atomic<uint64_t> s_lost{0};
+sample* s_samples = nullptr;
+size_t s_capacity = 0;
+
+// note: backtrace() is not async-signal-safe on paper, but it only walks
+// the unwinding tables once the unwinder is loaded, which is done before
+// the session starts
+void on_sigprof(int, siginfo_t*, void*)
+{
+	int saved_errno = errno;
+	s_in_handler.fetch_add(1);
+	if(s_recording.load())
+	{
+		size_t i = s_next.fetch_add(1, std::memory_order_relaxed);
+		if(i < s_capacity)
+		{
+			auto& smp = s_samples[i];
+			smp.depth = backtrace(smp.frames, s_max_frames);
+			smp.rule = falco::current_rule::get();
+			memcpy(smp.thread, t_label, s_label_size);
+		}
+		else
+		{
+			s_lost.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	s_in_handler.fetch_sub(1);
+	errno = saved_errno;
+}
+
+// folded stacks use ';' as frame separator and '\n' as stack separator
+std::string sanitize(std::string s)
+{
+	std::replace(s.begin(), s.end(), ';', ':');
+	std::replace(s.begin(), s.end(), '\n', ' ');
+	return s;
+}
+
+std::string hex(uintptr_t v)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "0x%lx", (unsigned long) v);
+	return buf;
+}
+
+// The demangled function of an address, or its module and its offset in
+// it for the functions without a dynamic symbol, which addr2line can
+// resolve afterwards
+std::string symbolize(void* addr)
+{
+	Dl_info info;
+	if(dladdr(addr, &info) == 0 || info.dli_fname == nullptr)
+	{
+		return hex((uintptr_t) addr);
+	}
+	if(info.dli_sname == nullptr)
+	{
+		const char* module = strrchr(info.dli_fname, '/');
+		module = module == nullptr ? info.dli_fname : module + 1;
+		return std::string(module) + "+" + hex((uintptr_t) addr - (uintptr_t) info.dli_fbase);
+	}
+	int status = 0;
+	char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+	std::string res = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+	free(demangled);
+	return sanitize(res);
+}
+
+std::string fold(const sample* samples, size_t num_samples)
+{
+	std::unordered_map<void*, std::string> symbols;
+	std::map<std::string, uint64_t> stacks;
+	for(size_t i = 0; i < num_samples; i++)
+	{
+		const auto& s = samples[i];
+		std::string thread(s.thread, strnlen(s.thread, s_label_size));
+		std::string stack = thread.empty() ? "other" : sanitize(thread);
+		if(s.rule != nullptr)
+		{
+			stack += ";rule:" + sanitize(s.rule);
+		}
+		for(int f = s.depth - 1; f >= s_skipped_frames; f--)
+		{
+			auto it = symbols.find(s.frames[f]);
+			if(it == symbols.end())
+			{
+				it = symbols.emplace(s.frames[f], symbolize(s.frames[f])).first;
+			}
+			stack += ";" + it->second;
+		}
+		stacks[stack]++;
+	}
+
+	std::string res;
+	for(const auto& s : stacks)
+	{
+		res += s.first + " " + std::to_string(s.second) + "\n";
+	}
+	return res;
+}
+
+#endif // __linux__
+
+} // namespace
+
+falco::profiler::profiler(uint32_t frequency_hz, std::chrono::seconds duration, const std::string& output_dir):
+	m_frequency_hz(frequency_hz),
+	m_duration(duration),
+	m_output_dir(output_dir)
+{
+}
+
+falco::profiler::~profiler()
+{
+	stop();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+bool falco::profiler::start(std::string& err)
+{
+	if(s_busy.load() || m_background.exchange(true))
+	{
+		err = "a profiling session is already running";
+		return false;
+	}
+
+	// the previous background session, if any, is over
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	m_thread = std::thread([this]()
+	{
+		std::string folded;
+		std::string err;
+		if(record(m_duration, folded, err))
+		{
+			write(folded);
+		}
+		else
+		{
+			falco_logger::log(falco_logger::level::ERR, "Could not run the profiling session: " + err + "\n");
+		}
+		m_background.store(false);
+	});
+	return true;
+}
+
+void falco::profiler::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+}
+
+bool falco::profiler::run(std::chrono::seconds duration, std::string& folded, std::string& err)
+{
+	return record(duration, folded, err);
+}
+
+void falco::profiler::set_thread_label(const std::string& label)
+{
+	// note: the last character is never written, and so always terminates
+	// the label
+	strncpy(t_label, label.c_str(), s_label_size - 1);
+}
+
+bool falco::profiler::record(std::chrono::seconds duration, std::string& folded, std::string& err)
+{
+#ifdef __linux__
+	if(s_busy.exchange(true))
+	{
+		err = "a profiling session is already running";
+		return false;
+	}
+
+	// room for the samples of all the CPUs being busy for the whole session
+	size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<sample> samples(std::min<size_t>(s_max_samples, m_frequency_hz * duration.count() * cpus));
+	s_samples = samples.data();
+	s_capacity = samples.size();
+	s_next.store(0);
+	s_lost.store(0);
+
+	// the first backtrace() loads the unwinder, which must not happen in
+	// the signal handler
+	void* warmup[1];
+	backtrace(warmup, 1);
+
+	struct sigaction sa = {};
+	sa.sa_sigaction = on_sigprof;
+	sa.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if(sigaction(SIGPROF, &sa, nullptr) != 0)
+	{
+		err = std::string("could not handle SIGPROF: ") + strerror(errno);
+		s_busy.store(false);
+		return false;
+	}
+
+	// the timer counts the CPU time of all the threads of the process, and
+	// the thread running when it expires is usually the one getting the
+	// signal, so that the busiest threads get the most samples
+	struct itimerval timer = {};
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = std::max<long>(1, 1000000 / m_frequency_hz);
+	timer.it_value = timer.it_interval;
+	falco::current_rule::set_tracking(true);
+	s_recording.store(true);
+	bool started = setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+	if(!started)
+	{
+		err = std::string("could not start the profiling timer: ") + strerror(errno);
+	}
+	else
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_cv.wait_until(lock, start + duration, [this]() { return m_stop; });
+	}
+
+	struct itimerval off = {};
+	setitimer(ITIMER_PROF, &off, nullptr);
+	s_recording.store(false);
+	while(s_in_handler.load() > 0)
+	{
+		std::this_thread::yield();
+	}
+	falco::current_rule::set_tracking(false);
+	// a signal still pending is then ignored instead of terminating Falco
+	signal(SIGPROF, SIG_IGN);
+
+	if(started)
+	{
+		size_t num_samples = std::min(s_next.load(), s_capacity);
+		folded = fold(samples.data(), num_samples);
+		falco_logger::log(falco_logger::level::INFO, "Profiling session over with "
+			+ std::to_string(num_samples) + " samples, "
+			+ std::to_string(s_lost.load()) + " lost\n");
+	}
+	s_samples = nullptr;
+	s_capacity = 0;
+	s_busy.store(false);
+	return started;
+#else
+	err = "profiling is not supported on this platform";
+	return false;
+#endif
+}
+
+void falco::profiler::write(const std::string& folded)
+{
+	auto now = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	auto path = m_output_dir + "/falco-profile-" + std::to_string(now) + ".folded";
+	std::ofstream f(path);
+	f << folded;
+	f.close();
+	if(!f)
+	{
+		falco_logger::log(falco_logger::level::ERR, "Could not write the profiling session to " + path + "\n");
+		return;
+	}
+	falco_logger::log(falco_logger::level::INFO, "Profiling session written to " + path + "\n");
+}
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace falco
+{
+
+/*!
+	\brief Samples the stacks of Falco's threads on demand, to find out
+	where the CPU time goes in a running instance. During a session, the
+	process gets a SIGPROF every 1/frequency_hz seconds of CPU time
+	consumed by any of its threads, and the thread that got it records its
+	stack, its label, and the rule it was evaluating, if any. Once the
+	session is over, the samples are symbolized and aggregated as folded
+	stacks, i.e. one "thread;rule;frame;...;frame count" line per distinct
+	stack, from the outermost frame, which flamegraph.pl, speedscope, and
+	pprof (with -raw) can render. Only one session can run at a time in the
+	process. Sessions are only supported on Linux.
+*/
+class profiler
+{
+public:
+	/*!
+		\brief Creates a profiler running sessions at the given sampling
+		frequency, whose background sessions last for the given duration
+		and write their stacks in output_dir
+	*/
+	profiler(uint32_t frequency_hz, std::chrono::seconds duration, const std::string& output_dir);
+
+	/*!
+		\brief Interrupts the running session, if any, and waits for it
+	*/
+	~profiler();
+
+	profiler(const profiler&) = delete;
+	profiler& operator = (const profiler&) = delete;
+
+	/*!
+		\brief Starts a session in the background, whose stacks are written
+		in a falco-profile-<timestamp>.folded file of the output directory.
+		Returns false along with an error if a session is already running.
+	*/
+	bool start(std::string& err);
+
+	/*!
+		\brief Runs a session of the given duration on the current thread,
+		returning its folded stacks, or false along with an error if a
+		session is already running or it could not be started
+	*/
+	bool run(std::chrono::seconds duration, std::string& folded, std::string& err);
+
+	/*!
+		\brief Sets the label with which the samples of the current thread
+		are annotated, e.g. its class or its event source, of which only the
+		first 31 characters are kept
+	*/
+	static void set_thread_label(const std::string& label);
+
+	/*!
+		\brief Interrupts the running session, if any, whose stacks are
+		then the ones sampled so far, and makes the later ones end as soon
+		as they start
+	*/
+	void stop();
+
+private:
+	bool record(std::chrono::seconds duration, std::string& folded, std::string& err);
+	void write(const std::string& folded);
+
+	uint32_t m_frequency_hz;
+	std::chrono::seconds m_duration;
+	std::string m_output_dir;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	// whether the session started by start() is running
+	std::atomic<bool> m_background{false};
+	std::thread m_thread;
+};
+
+} // namespace falco
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "recent_alerts.h"
+
+#include <algorithm>
+
+using namespace falco::outputs;
+
+// Removes the oldest id of the given key from an index
+static void pop_oldest(std::unordered_map<std::string, std::deque<uint64_t>>& index, const std::string& key)
+{
+	auto it = index.find(key);
+	if(it == index.end())
+	{
+		return;
+	}
+	it->second.pop_front();
+	if(it->second.empty())
+	{
+		index.erase(it);
+	}
+}
+
+recent_alerts::recent_alerts(uint64_t max_memory): m_max_memory(max_memory)
+{
+}
+
+void recent_alerts::add(const message& msg)
+{
+	entry e;
+	e.a.ts = msg.ts;
+	e.a.priority = std::min(msg.priority, falco_common::PRIORITY_DEBUG);
+	e.a.rule = msg.rule;
+	e.a.source = msg.source;
+	e.a.tags = msg.tags;
+	e.a.output = msg.msg;
+	for(const auto& f : msg.fields)
+	{
+		if(f.first == "container.id")
+		{
+			f.second.append_text(e.a.container_id);
+			break;
+		}
+	}
+	// the entry, its strings, and its ids in the indexes
+	e.memory = sizeof(entry) + e.a.output.capacity() + e.a.container_id.capacity() + 3 * sizeof(uint64_t);
+
+	std::lock_guard<std::mutex> lk(m_mtx);
+	e.sort_ts = m_entries.empty() ? e.a.ts : std::max(e.a.ts, m_entries.back().sort_ts);
+	uint64_t id = m_next_id++;
+	m_by_rule[e.a.rule].push_back(id);
+	m_by_priority[e.a.priority].push_back(id);
+	if(!e.a.container_id.empty())
+	{
+		m_by_container[e.a.container_id].push_back(id);
+	}
+	m_memory += e.memory;
+	m_entries.push_back(std::move(e));
+	evict();
+}
+
+void recent_alerts::evict()
+{
+	while(m_memory > m_max_memory && !m_entries.empty())
+	{
+		const auto& e = m_entries.front();
+		pop_oldest(m_by_rule, e.a.rule);
+		m_by_priority[e.a.priority].pop_front();
+		if(!e.a.container_id.empty())
+		{
+			pop_oldest(m_by_container, e.a.container_id);
+		}
+		m_memory -= e.memory;
+		m_entries.pop_front();
+		m_first_id++;
+		m_num_evicted.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+// note: an alert that came out of order is only found by the queries
+// whose window includes the time of the alerts that came before it
+void recent_alerts::id_range(uint64_t since, uint64_t until, uint64_t& lo, uint64_t& hi) const
+{
+	auto first = std::partition_point(m_entries.begin(), m_entries.end(),
+		[since](const entry& e) { return e.sort_ts < since; });
+	auto last = std::partition_point(first, m_entries.end(),
+		[until](const entry& e) { return e.sort_ts <= until; });
+	lo = m_first_id + (first - m_entries.begin());
+	hi = m_first_id + (last - m_entries.begin());
+}
+
+bool recent_alerts::find(const query& q, std::vector<alert>& out) const
+{
+	out.clear();
+	std::lock_guard<std::mutex> lk(m_mtx);
+	uint64_t lo = 0;
+	uint64_t hi = 0;
+	id_range(q.since, q.until, lo, hi);
+
+	// collects the matching alerts, newest first, until one more than
+	// the limit is found
+	bool more = false;
+	auto visit = [&](uint64_t id)
+	{
+		const auto& a = get(id).a;
+		if(a.priority > q.min_priority || a.ts < q.since || a.ts > q.until
+			|| (!q.rule.empty() && a.rule != q.rule)
+			|| (!q.container_id.empty() && a.container_id != q.container_id))
+		{
+			return true;
+		}
+		if(out.size() == q.limit)
+		{
+			more = true;
+			return false;
+		}
+		out.push_back(a);
+		return true;
+	};
+
+	// the smallest index of the query, if any
+	const id_list* ids = nullptr;
+	auto narrow = [&ids](const std::unordered_map<std::string, id_list>& index, const std::string& key)
+	{
+		auto it = index.find(key);
+		if(it == index.end())
+		{
+			return false;
+		}
+		if(ids == nullptr || it->second.size() < ids->size())
+		{
+			ids = &it->second;
+		}
+		return true;
+	};
+	if((!q.rule.empty() && !narrow(m_by_rule, q.rule))
+		|| (!q.container_id.empty() && !narrow(m_by_container, q.container_id)))
+	{
+		return false;
+	}
+
+	if(ids != nullptr)
+	{
+		auto end = std::lower_bound(ids->begin(), ids->end(), hi);
+		auto begin = std::lower_bound(ids->begin(), end, lo);
+		for(auto it = end; it != begin && visit(*--it);)
+		{
+		}
+		return more;
+	}
+
+	if(q.min_priority < falco_common::PRIORITY_DEBUG)
+	{
+		// merges the ids of the priorities, newest first
+		std::vector<std::pair<id_list::const_iterator, id_list::const_iterator>> ranges;
+		for(int p = 0; p <= q.min_priority; p++)
+		{
+			const auto& l = m_by_priority[p];
+			auto end = std::lower_bound(l.begin(), l.end(), hi);
+			auto begin = std::lower_bound(l.begin(), end, lo);
+			if(begin != end)
+			{
+				ranges.emplace_back(begin, end);
+			}
+		}
+		while(!ranges.empty())
+		{
+			size_t newest = 0;
+			for(size_t i = 1; i < ranges.size(); i++)
+			{
+				if(*std::prev(ranges[i].second) > *std::prev(ranges[newest].second))
+				{
+					newest = i;
+				}
+			}
+			uint64_t id = *--ranges[newest].second;
+			if(ranges[newest].second == ranges[newest].first)
+			{
+				ranges.erase(ranges.begin() + newest);
+			}
+			if(!visit(id))
+			{
+				break;
+			}
+		}
+		return more;
+	}
+
+	for(uint64_t id = hi; id > lo && visit(--id);)
+	{
+	}
+	return more;
+}
+
+void recent_alerts::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		metrics["alerts"] = m_entries.size();
+		metrics["memory_bytes"] = m_memory;
+	}
+	metrics["evicted"] = m_num_evicted.load(std::memory_order_relaxed);
+}
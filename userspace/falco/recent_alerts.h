@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "falco_common.h"
+#include "interned.h"
+#include "outputs.h"
+
+namespace falco
+{
+namespace outputs
+{
+
+//
+// The configuration of the store of the recent alerts
+//
+struct recent_alerts_config
+{
+	bool enabled = false;
+	uint64_t max_memory = 16 * 1024 * 1024;
+};
+
+/*!
+	\brief Keeps the most recent alerts in memory, within a budget, and
+	finds them by rule, minimum priority, container id and time without
+	scanning the others. The alerts are numbered in the order they are
+	added, and each index holds the numbers of its alerts in that order,
+	so that the oldest alerts are evicted from the front of the store and
+	of their indexes alike. All the methods are thread-safe.
+*/
+class recent_alerts
+{
+public:
+	struct alert
+	{
+		uint64_t ts = 0;
+		falco_common::priority_type priority = falco_common::PRIORITY_DEBUG;
+		falco::interned_string rule;
+		falco::interned_string source;
+		falco::interned_tags tags;
+		std::string container_id;
+		std::string output;
+	};
+
+	struct query
+	{
+		// the alerts of the rule, if set
+		std::string rule;
+		// the alerts at least as severe
+		falco_common::priority_type min_priority = falco_common::PRIORITY_DEBUG;
+		// the alerts of the container, if set
+		std::string container_id;
+		// the alerts between these times, in ns since epoch, both included
+		uint64_t since = 0;
+		uint64_t until = std::numeric_limits<uint64_t>::max();
+		// the maximum number of alerts returned
+		size_t limit = 100;
+	};
+
+	explicit recent_alerts(uint64_t max_memory);
+
+	recent_alerts(recent_alerts&&) = delete;
+	recent_alerts& operator = (recent_alerts&&) = delete;
+	recent_alerts(const recent_alerts&) = delete;
+	recent_alerts& operator = (const recent_alerts&) = delete;
+
+	/*!
+		\brief Adds an alert, evicting the oldest ones that no longer
+		fit in the memory budget. The container id is taken from the
+		container.id field of the alert, if any.
+	*/
+	void add(const message& msg);
+
+	/*!
+		\brief Fills out with the alerts matching the query, newest
+		first, and returns true if more alerts than the limit matched
+	*/
+	bool find(const query& q, std::vector<alert>& out) const;
+
+	/*!
+		\brief Adds the metrics of the store to the given map, which are
+		the alerts and the memory it holds, and the alerts evicted
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	struct entry
+	{
+		alert a;
+		// the time by which the entries are sorted, which never goes
+		// back even when alerts of different sources come out of order
+		uint64_t sort_ts = 0;
+		size_t memory = 0;
+	};
+
+	typedef std::deque<uint64_t> id_list;
+
+	void evict();
+	// the ids of the entries between the given times, as [lo, hi)
+	void id_range(uint64_t since, uint64_t until, uint64_t& lo, uint64_t& hi) const;
+	inline const entry& get(uint64_t id) const
+	{
+		return m_entries[id - m_first_id];
+	}
+
+	uint64_t m_max_memory;
+
+	mutable std::mutex m_mtx;
+	std::deque<entry> m_entries;
+	// the id of the first entry, and of the next one added
+	uint64_t m_first_id = 0;
+	uint64_t m_next_id = 0;
+	uint64_t m_memory = 0;
+	std::unordered_map<std::string, id_list> m_by_rule;
+	std::unordered_map<std::string, id_list> m_by_container;
+	std::array<id_list, falco_common::PRIORITY_DEBUG + 1> m_by_priority;
+
+	std::atomic<uint64_t> m_num_evicted{0};
+};
+
+/*!
+	\brief The output that adds all the alerts to a recent_alerts store
+*/
+class output_recent_alerts : public abstract_output
+{
+public:
+	explicit output_recent_alerts(std::shared_ptr<recent_alerts> store): m_store(std::move(store)) { }
+
+	void output(const message *msg) override
+	{
+		m_store->add(*msg);
+	}
+
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const override
+	{
+		m_store->get_metrics(metrics);
+	}
+
+	// the container ids come from the fields
+	bool uses_fields() const override
+	{
+		return true;
+	}
+
+private:
+	std::shared_ptr<recent_alerts> m_store;
+};
+
+} // namespace outputs
+} // namespace falco
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "source_monitor.h"
+#include "thread_affinity.h"
+
+void falco::source_monitor::heartbeat::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["stall.current_ms"] = m_stall_ms.load(std::memory_order_relaxed);
+	metrics["stall.max_ms"] = m_max_stall_ms.load(std::memory_order_relaxed);
+	metrics["stall.stalls"] = m_stalls.load(std::memory_order_relaxed);
+}
+
+falco::source_monitor::source_monitor(std::chrono::milliseconds interval, std::chrono::milliseconds max_stall, stall_callback_t on_stall)
+	: m_interval(interval), m_max_stall(max_stall), m_on_stall(std::move(on_stall))
+{
+}
+
+falco::source_monitor::~source_monitor()
+{
+	stop();
+}
+
+void falco::source_monitor::add(const std::string& source, const std::shared_ptr<heartbeat>& hb, bool notify)
+{
+	auto& e = m_entries.emplace_back();
+	e.source = source;
+	e.hb = hb;
+	e.notify = notify;
+}
+
+void falco::source_monitor::start()
+{
+	m_stop = false;
+	m_thread = std::thread(&source_monitor::run, this);
+}
+
+void falco::source_monitor::stop()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_mtx);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void falco::source_monitor::check(std::chrono::steady_clock::time_point now)
+{
+	for(auto& e : m_entries)
+	{
+		if(!e.hb->m_beating.load(std::memory_order_relaxed))
+		{
+			continue;
+		}
+		auto evts = e.hb->m_evts.load(std::memory_order_relaxed);
+		if(!e.started || evts != e.seen_evts)
+		{
+			e.started = true;
+			e.notified = false;
+			e.seen_evts = evts;
+			e.last_progress = now;
+			e.hb->m_stall_ms.store(0, std::memory_order_relaxed);
+			continue;
+		}
+
+		auto stall = std::chrono::duration_cast<std::chrono::milliseconds>(now - e.last_progress);
+		uint64_t stall_ms = stall.count();
+		e.hb->m_stall_ms.store(stall_ms, std::memory_order_relaxed);
+		if(stall_ms > e.hb->m_max_stall_ms.load(std::memory_order_relaxed))
+		{
+			e.hb->m_max_stall_ms.store(stall_ms, std::memory_order_relaxed);
+		}
+		if(stall > m_max_stall && !e.notified)
+		{
+			e.notified = true;
+			e.hb->m_stalls.fetch_add(1, std::memory_order_relaxed);
+			if(e.notify && m_on_stall)
+			{
+				m_on_stall(e.source, stall, *e.hb);
+			}
+		}
+	}
+}
+
+void falco::source_monitor::run() noexcept
+{
+	falco::thread_affinity::apply(falco::thread_affinity::WATCHERS);
+	std::unique_lock<std::mutex> lk(m_mtx);
+	while(!m_stop)
+	{
+		m_cv.wait_for(lk, m_interval, [this] { return m_stop; });
+		if(m_stop)
+		{
+			break;
+		}
+		lk.unlock();
+		try
+		{
+			check(std::chrono::steady_clock::now());
+		}
+		catch(...)
+		{
+			// a failed notification must not stop the monitoring
+		}
+		lk.lock();
+	}
+}
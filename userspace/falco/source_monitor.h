@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief Detects the event sources that stopped producing events without
+	reading the clock in their event processing loops. Each loop updates
+	the heartbeat of its source with the number of events processed so
+	far, which it only does along with its other periodic checks, and a
+	monitor thread wakes up at a fixed interval to see which heartbeats
+	didn't move. A source whose heartbeat didn't move for longer than
+	max_stall is notified once, until it produces events again. A source
+	is only monitored once its loop published its first heartbeat, so that
+	the time it takes to open it doesn't count as a stall.
+*/
+class source_monitor
+{
+public:
+	/*!
+		\brief The progress of the event processing loop of a source. It
+		is written by the thread of the source, and read by the monitor
+		and the metrics from any thread.
+	*/
+	class heartbeat
+	{
+	public:
+		/*!
+			\brief Publishes the number of events processed so far, and the
+			timestamp of the last of them if non-zero
+		*/
+		inline void beat(uint64_t num_evts, uint64_t last_evt_ts)
+		{
+			m_evts.store(num_evts, std::memory_order_relaxed);
+			m_beating.store(true, std::memory_order_relaxed);
+			if(last_evt_ts != 0)
+			{
+				m_last_evt_ts.store(last_evt_ts, std::memory_order_relaxed);
+			}
+		}
+
+		inline uint64_t last_evt_ts() const
+		{
+			return m_last_evt_ts.load(std::memory_order_relaxed);
+		}
+
+		/*!
+			\brief Adds to the given map how long the source has been
+			stalled for, the longest it has ever been, in milliseconds, and
+			how many times it stalled for longer than max_stall, as stall.current_ms,
+			stall.max_ms and stall.stalls
+		*/
+		void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+	private:
+		friend class source_monitor;
+
+		std::atomic<bool> m_beating{false};
+		std::atomic<uint64_t> m_evts{0};
+		std::atomic<uint64_t> m_last_evt_ts{0};
+
+		// written by the monitor
+		std::atomic<uint64_t> m_stall_ms{0};
+		std::atomic<uint64_t> m_max_stall_ms{0};
+		std::atomic<uint64_t> m_stalls{0};
+	};
+
+	/*!
+		\brief Invoked by the monitor thread when a source stalled for
+		longer than max_stall, with the name of the source, the time it has
+		been stalled for and the heartbeat of the source
+	*/
+	using stall_callback_t = std::function<void(const std::string& source, std::chrono::milliseconds stall, const heartbeat& hb)>;
+
+	source_monitor(std::chrono::milliseconds interval, std::chrono::milliseconds max_stall, stall_callback_t on_stall);
+	~source_monitor();
+
+	/*!
+		\brief Monitors the given heartbeat of a source, and notifies its
+		stalls only if notify is set. Must be invoked before start()
+	*/
+	void add(const std::string& source, const std::shared_ptr<heartbeat>& hb, bool notify);
+
+	void start();
+	void stop();
+
+	/*!
+		\brief Updates the stall of each source given the current time and
+		notifies the ones that stalled for too long. This is what the
+		monitor thread does at every interval
+	*/
+	void check(std::chrono::steady_clock::time_point now);
+
+private:
+	struct entry
+	{
+		std::string source;
+		std::shared_ptr<heartbeat> hb;
+		bool notify = false;
+		bool started = false;
+		bool notified = false;
+		uint64_t seen_evts = 0;
+		std::chrono::steady_clock::time_point last_progress;
+	};
+
+	void run() noexcept;
+
+	std::chrono::milliseconds m_interval;
+	std::chrono::milliseconds m_max_stall;
+	stall_callback_t m_on_stall;
+	std::vector<entry> m_entries;
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	std::thread m_thread;
+};
+
+} // namespace falco
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "startup_report.h"
+
+void falco::startup_report::add_step(const std::string& name, clock::duration d)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_steps.emplace_back(name, d);
+}
+
+void falco::startup_report::set_started(clock::duration total)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_started = total;
+}
+
+void falco::startup_report::expect_sources(size_t num_sources)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_expected_sources = num_sources;
+	check_ready();
+}
+
+void falco::startup_report::source_opened(const std::string& source, clock::duration d)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_sources.emplace_back(source, d);
+	check_ready();
+}
+
+void falco::startup_report::event_processed()
+{
+	if(ready())
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if(!m_first_event.has_value())
+	{
+		m_first_event = clock::now() - m_start;
+	}
+	check_ready();
+}
+
+void falco::startup_report::check_ready()
+{
+	if(!m_ready.load(std::memory_order_relaxed)
+		&& m_first_event.has_value()
+		&& m_expected_sources.has_value()
+		&& m_sources.size() >= m_expected_sources.value())
+	{
+		m_ready_at = clock::now() - m_start;
+		m_ready.store(true, std::memory_order_release);
+	}
+}
+
+nlohmann::json falco::startup_report::as_json() const
+{
+	nlohmann::json res;
+	std::lock_guard<std::mutex> lock(m_mtx);
+	res["ready"] = ready();
+	res["steps"] = nlohmann::json::array();
+	for(const auto& s : m_steps)
+	{
+		res["steps"].push_back({{"name", s.first}, {"duration_ms", to_ms(s.second)}});
+	}
+	if(m_started.has_value())
+	{
+		res["startup_ms"] = to_ms(m_started.value());
+	}
+	res["sources"] = nlohmann::json::array();
+	for(const auto& s : m_sources)
+	{
+		res["sources"].push_back({{"name", s.first}, {"open_ms", to_ms(s.second)}});
+	}
+	if(m_first_event.has_value())
+	{
+		res["first_event_ms"] = to_ms(m_first_event.value());
+	}
+	if(m_ready_at.has_value())
+	{
+		res["ready_ms"] = to_ms(m_ready_at.value());
+	}
+	return res;
+}
+
+void falco::startup_report::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	for(const auto& s : m_steps)
+	{
+		metrics["startup_step_ms." + s.first] = to_ms(s.second);
+	}
+	if(m_started.has_value())
+	{
+		metrics["startup_ms"] = to_ms(m_started.value());
+	}
+	for(const auto& s : m_sources)
+	{
+		metrics["startup_source_open_ms." + s.first] = to_ms(s.second);
+	}
+	if(m_first_event.has_value())
+	{
+		metrics["startup_first_event_ms"] = to_ms(m_first_event.value());
+	}
+	if(m_ready_at.has_value())
+	{
+		metrics["startup_ready_ms"] = to_ms(m_ready_at.value());
+	}
+}
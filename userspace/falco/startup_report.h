@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace falco
+{
+
+/*!
+	\brief Keeps where the startup time of Falco went: how long each step
+	of the app took, how long opening each event source took, and when the
+	first event was processed. Falco is ready once all the enabled event
+	sources are open and at least one event has been processed. The times
+	are relative to the creation of the report, which is created along with
+	the app state. This class is thread-safe.
+*/
+class startup_report
+{
+public:
+	typedef std::chrono::steady_clock clock;
+
+	startup_report() : m_start(clock::now())
+	{
+	}
+
+	startup_report(const startup_report&) = delete;
+	startup_report& operator = (const startup_report&) = delete;
+
+	/*!
+		\brief Records how long a startup step took, in the order in
+		which the steps finished
+	*/
+	void add_step(const std::string& name, clock::duration d);
+
+	/*!
+		\brief Records that all the startup steps are done, and how long
+		they took in total
+	*/
+	void set_started(clock::duration total);
+
+	/*!
+		\brief Sets the number of event sources to open before being ready
+	*/
+	void expect_sources(size_t num_sources);
+
+	/*!
+		\brief Records how long opening an event source took
+	*/
+	void source_opened(const std::string& source, clock::duration d);
+
+	/*!
+		\brief Records that an event has been processed, which only
+		matters until Falco is ready
+	*/
+	void event_processed();
+
+	inline bool ready() const
+	{
+		return m_ready.load(std::memory_order_acquire);
+	}
+
+	/*!
+		\brief Returns the report as a JSON object, with all the times in
+		milliseconds. The times not known yet are left out.
+	*/
+	nlohmann::json as_json() const;
+
+	/*!
+		\brief Returns the times known so far in milliseconds, keyed by
+		the names of their metrics
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	void check_ready();
+
+	static inline uint64_t to_ms(clock::duration d)
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+	}
+
+	const clock::time_point m_start;
+
+	mutable std::mutex m_mtx;
+	std::vector<std::pair<std::string, clock::duration>> m_steps;
+	std::optional<clock::duration> m_started;
+	std::vector<std::pair<std::string, clock::duration>> m_sources;
+	std::optional<size_t> m_expected_sources;
+	std::optional<clock::duration> m_first_event;
+	std::optional<clock::duration> m_ready_at;
+	std::atomic<bool> m_ready{false};
+};
+
+} // namespace falco
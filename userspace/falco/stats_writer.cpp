@@ -20,17 +20,30 @@ limitations under the License.
 #endif
 #include <ctime>
 #include <csignal>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <nlohmann/json.hpp>
 
 #include "falco_common.h"
 #include "stats_writer.h"
+#include "alloc_tracker.h"
+#include "rules_arena.h"
 #include "logger.h"
+#include "thread_affinity.h"
 #include "config_falco.h"
 #include "falco_utils.h"
+#include "memory_usage.h"
 #include <libscap/strl.h>
 #include <libscap/scap_vtable.h>
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+#include "falco_metrics.h"
+#include "otlp_exporter.h"
+#endif
 
 namespace fs = std::filesystem;
 
@@ -56,14 +69,14 @@ static void timer_handler(int signum)
 }
 
 #if defined(_WIN32)
-bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
+static bool init_signal_ticker(uint32_t interval_msec, std::string &err)
 {
 	return true;
 }
 #endif
 
 #if defined(__APPLE__)
-bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
+static bool init_signal_ticker(uint32_t interval_msec, std::string &err)
 {
 	struct sigaction handler = {};
 
@@ -86,7 +99,7 @@ bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
 #endif
 
 #if defined(EMSCRIPTEN)
-bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
+static bool init_signal_ticker(uint32_t interval_msec, std::string &err)
 {
 	struct itimerspec timer = {};
 	struct sigaction handler = {};
@@ -114,7 +127,7 @@ bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
 #endif
 
 #if defined(__linux__)
-bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
+static bool init_signal_ticker(uint32_t interval_msec, std::string &err)
 {
 	struct itimerspec timer = {};
 	struct sigaction handler = {};
@@ -164,6 +177,86 @@ bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err)
 }
 #endif
 
+#ifndef __EMSCRIPTEN__
+// Increments the ticker from a dedicated thread instead of a signal handler,
+// at deadlines of the monotonic clock so that the ticks don't drift, which
+// allows shorter intervals and leaves the signals alone
+class ticker_thread
+{
+public:
+	~ticker_thread()
+	{
+		stop();
+	}
+
+	void start(uint32_t interval_msec)
+	{
+		stop();
+		m_stop = false;
+		m_thread = std::thread(&ticker_thread::run, this, std::chrono::milliseconds(interval_msec));
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_one();
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+private:
+	void run(std::chrono::milliseconds interval)
+	{
+		falco::thread_affinity::apply(falco::thread_affinity::STATS);
+		auto next = std::chrono::steady_clock::now() + interval;
+		std::unique_lock<std::mutex> lk(m_mtx);
+		while (!m_cv.wait_until(lk, next, [this] { return m_stop; }))
+		{
+			s_timer.fetch_add(1, std::memory_order_relaxed);
+			next += interval;
+			// after the process was suspended, the missed ticks are skipped
+			auto now = std::chrono::steady_clock::now();
+			if (next < now)
+			{
+				next = now + interval;
+			}
+		}
+	}
+
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	std::thread m_thread;
+};
+
+static ticker_thread s_ticker_thread;
+#endif
+
+bool stats_writer::init_ticker(uint32_t interval_msec, std::string &err, bool use_thread)
+{
+#ifndef __EMSCRIPTEN__
+	s_ticker_thread.stop();
+	if (use_thread)
+	{
+#ifdef __linux__
+		if (s_timerid_exists)
+		{
+			timer_delete(s_timerid);
+			s_timerid_exists = false;
+		}
+#endif
+		s_ticker_thread.start(interval_msec);
+		return true;
+	}
+#endif
+	return init_signal_ticker(interval_msec, err);
+}
+
 stats_writer::ticker_t stats_writer::get_ticker()
 {
 	return s_timer.load(std::memory_order_relaxed);
@@ -172,8 +265,11 @@ stats_writer::ticker_t stats_writer::get_ticker()
 stats_writer::stats_writer(
 		const std::shared_ptr<falco_outputs>& outputs,
 		const std::shared_ptr<const falco_configuration>& config,
-		const std::shared_ptr<const falco_engine>& engine)
-	: m_config(config), m_engine(engine)
+		const std::shared_ptr<const falco_engine>& engine,
+		const std::shared_ptr<falco::otlp_exporter>& otlp,
+		const std::shared_ptr<const falco::startup_report>& startup,
+		const std::shared_ptr<falco_metrics>& prometheus)
+	: m_ticker_interval_ms(config->m_metrics_interval), m_startup(startup), m_config(config), m_engine(engine)
 {
 	if (config->m_metrics_enabled)
 	{
@@ -184,8 +280,14 @@ stats_writer::stats_writer(
 
 		if (!config->m_metrics_output_file.empty())
 		{
-			m_file_output.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-			m_file_output.open(config->m_metrics_output_file, std::ios_base::app);
+			const auto& opts = config->m_metrics_output_file_options;
+			falco::metrics_file::config c;
+			c.m_buffer_size = opts.m_buffer_size;
+			c.m_flush_interval = std::chrono::milliseconds(opts.m_flush_interval_ms);
+			c.m_rotate_max_size = opts.m_rotate_max_size;
+			c.m_rotate_max_files = opts.m_rotate_max_files;
+			c.m_max_backlog_bytes = opts.m_max_backlog_bytes;
+			m_file_output = std::make_unique<falco::metrics_file>(config->m_metrics_output_file, c);
 			m_initialized = true;
 		}
 
@@ -193,10 +295,37 @@ stats_writer::stats_writer(
 		{
 			m_initialized = true;
 		}
+
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+		if (otlp && otlp->metrics_enabled())
+		{
+			m_otlp = otlp;
+			m_initialized = true;
+		}
+#endif
+		m_has_outputs = m_initialized;
+
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+		if (prometheus)
+		{
+			m_prometheus = prometheus;
+			m_initialized = true;
+			uint64_t min_interval = config->m_metrics_ticker_thread ? 10 : 100;
+			uint64_t refresh = std::max<uint64_t>(config->m_webserver_config.m_prometheus_metrics_cache_ms, min_interval);
+			m_ticker_interval_ms = std::min(m_ticker_interval_ms, refresh);
+		}
+#endif
 	}
 
 	if (m_initialized)
 	{
+		if (engine)
+		{
+			m_rules_memory_bytes = engine->rules_memory_report()["total"].get<uint64_t>();
+		}
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+		m_output_rule_metrics_converter = std::make_unique<libs::metrics::output_rule_metrics_converter>();
+#endif
 #ifndef __EMSCRIPTEN__
 		// Adopt capacity for completeness, even if it's likely not relevant
 		m_queue.set_capacity(config->m_outputs_queue_capacity);
@@ -212,10 +341,8 @@ stats_writer::~stats_writer()
 #ifndef __EMSCRIPTEN__
 		stop_worker();
 #endif
-		if (!m_config->m_metrics_output_file.empty())
-		{
-			m_file_output.close();
-		}
+		// the pending snapshots are written as the file is closed
+		m_file_output.reset();
 		// delete timerID and reset timer
 #ifdef __linux__
 		if (s_timerid_exists)
@@ -223,6 +350,9 @@ stats_writer::~stats_writer()
 			timer_delete(s_timerid);
 			s_timerid_exists = false;
 		}
+#endif
+#ifndef __EMSCRIPTEN__
+		s_ticker_thread.stop();
 #endif
 	}
 }
@@ -231,29 +361,37 @@ void stats_writer::stop_worker()
 {
 	stats_writer::msg msg;
 	msg.stop = true;
-	push(msg);
+	#ifndef __EMSCRIPTEN__
+	// the worker is still popping, so this only waits for it to make room
+	m_queue.push(std::move(msg));
+	#endif
 	if(m_worker.joinable())
 	{
 		m_worker.join();
 	}
 }
 
-inline void stats_writer::push(const stats_writer::msg& m)
+inline bool stats_writer::try_push(const stats_writer::msg& m)
 {
 	#ifndef __EMSCRIPTEN__
 	if (!m_queue.try_push(m))
 	{
-		fprintf(stderr, "Fatal error: Stats queue reached maximum capacity. Exiting.\n");
-		exit(EXIT_FAILURE);
+		return false;
 	}
+	m_queue_memory_bytes.fetch_add(m.memory_bytes, std::memory_order_relaxed);
+	return true;
+	#else
+	return true;
 	#endif
 }
 
 void stats_writer::worker() noexcept
 {
+	falco::thread_affinity::apply(falco::thread_affinity::STATS);
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::STATS);
 	stats_writer::msg m;
 	bool use_outputs = m_config->m_metrics_stats_rule_enabled;
-	bool use_file = !m_config->m_metrics_output_file.empty();
+	bool use_file = m_file_output != nullptr;
 	auto tick = stats_writer::get_ticker();
 	auto last_tick = tick;
 	auto first_tick = tick;
@@ -263,44 +401,101 @@ void stats_writer::worker() noexcept
 		// blocks until a message becomes availables
 		#ifndef __EMSCRIPTEN__
 		m_queue.pop(m);
+		m_queue_memory_bytes.fetch_sub(m.memory_bytes, std::memory_order_relaxed);
 		#endif
 		if (m.stop)
 		{
 			return;
 		}
 
-		// this helps waiting for the first tick
-		tick = stats_writer::get_ticker();
-		if (first_tick != tick)
+		try
 		{
-			if (last_tick != tick)
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+			if (m_prometheus)
 			{
-				m_total_samples++;
+				// the libs metrics of the sample are converted in place
+				// below, so Prometheus gets a copy
+				m_prometheus->update(m.inspector, std::vector<metrics_v2>(m.libs_metrics));
+			}
+#endif
+			// when the ticker runs at the refresh interval of Prometheus,
+			// the other outputs only get the first sample of each source
+			// and the ones at least a metrics interval apart, give or take
+			// half a tick
+			auto& state = m_source_states[m.source];
+			uint64_t interval_ns = m_config->m_metrics_interval * 1000000;
+			uint64_t half_tick_ns = m_ticker_interval_ms * 1000000 / 2;
+			if (!m_has_outputs || (state.last_ts != 0 && m.ts + half_tick_ns < state.last_ts + interval_ns))
+			{
+				m = stats_writer::msg();
+				continue;
 			}
-			last_tick = tick;
 
-			try
+			// this helps waiting for the first tick
+			tick = stats_writer::get_ticker();
+			bool write = first_tick != tick;
+			if (write)
 			{
-				if (use_outputs)
+				if (last_tick != tick)
 				{
-					std::string rule = "Falco internal: metrics snapshot";
-					std::string msg = "Falco metrics snapshot";
-					m_outputs->handle_msg(m.ts, falco_common::PRIORITY_INFORMATIONAL, msg, rule, m.output_fields);
+					m_total_samples++;
 				}
+				last_tick = tick;
+			}
 
-				if (use_file)
+			// the fields are built even for the samples that are not
+			// written, so that the rates of the next one are correct
+			double stats_snapshot_time_delta_sec = 0;
+			if (state.last_ts != 0)
+			{
+				stats_snapshot_time_delta_sec = (m.ts - state.last_ts) / (double)ONE_SECOND_IN_NS;
+			}
+			state.last_ts = m.ts;
+			nlohmann::json output_fields;
+			get_metrics_output_fields_wrapper(output_fields, m, state, stats_snapshot_time_delta_sec);
+			get_metrics_output_fields_additional(output_fields, m, state, stats_snapshot_time_delta_sec);
+
+			// the startup times only appear in the first written snapshot
+			if (write && m_startup)
+			{
+				std::map<std::string, uint64_t> startup_metrics;
+				m_startup->get_metrics(startup_metrics);
+				for (const auto& item : startup_metrics)
 				{
-					nlohmann::json jmsg;
-					jmsg["sample"] = m_total_samples;
-					jmsg["output_fields"] = m.output_fields;
-					m_file_output << jmsg.dump() << std::endl;
+					output_fields["falco." + item.first] = item.second;
 				}
+				m_startup = nullptr;
+			}
+
+			if (write && use_outputs)
+			{
+				std::string rule = "Falco internal: metrics snapshot";
+				std::string msg = "Falco metrics snapshot";
+				m_outputs->handle_msg(m.ts, falco_common::PRIORITY_INFORMATIONAL, msg, rule, output_fields);
+			}
+
+			if (write && use_file)
+			{
+				nlohmann::json jmsg;
+				jmsg["sample"] = m_total_samples;
+				jmsg["output_fields"] = output_fields;
+				m_file_output->write(jmsg.dump());
 			}
-			catch(const std::exception &e)
+
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+			if (write && m_otlp)
 			{
-				falco_logger::log(falco_logger::level::ERR, "stats_writer (worker): " + std::string(e.what()) + "\n");
+				m_otlp->export_metrics(m.ts, m.source, output_fields);
 			}
+#endif
+		}
+		catch(const std::exception &e)
+		{
+			falco_logger::log(falco_logger::level::ERR, "stats_writer (worker): " + std::string(e.what()) + "\n");
 		}
+
+		// do not hold the inspector while waiting for the next sample
+		m = stats_writer::msg();
 	}
 }
 
@@ -309,15 +504,21 @@ stats_writer::collector::collector(const std::shared_ptr<stats_writer>& writer)
 {
 }
 
-void stats_writer::collector::get_metrics_output_fields_wrapper(
+void stats_writer::get_metrics_output_fields_wrapper(
 		nlohmann::json& output_fields,
-		const std::shared_ptr<sinsp>& inspector,
-		const std::string& src, uint64_t num_evts,
-		uint64_t now, double stats_snapshot_time_delta_sec)
+		const stats_writer::msg& m,
+		source_state& state,
+		double stats_snapshot_time_delta_sec)
 {
 	static const char* all_driver_engines[] = {
 		BPF_ENGINE, KMOD_ENGINE, MODERN_BPF_ENGINE,
 		SOURCE_PLUGIN_ENGINE, NODRIVER_ENGINE, GVISOR_ENGINE };
+	// the agent and machine infos and the engine of the inspector do
+	// not change once it is open, so they can be read from this thread
+	const auto& inspector = m.inspector;
+	const std::string& src = m.source;
+	uint64_t num_evts = m.num_evts;
+	uint64_t now = m.ts;
 	const scap_agent_info* agent_info = inspector->get_agent_info();
 	const scap_machine_info* machine_info = inspector->get_machine_info();
 
@@ -339,23 +540,104 @@ void stats_writer::collector::get_metrics_output_fields_wrapper(
 		output_fields["falco.host_boot_ts"] = machine_info->boot_ts_epoch;
 		output_fields["falco.host_num_cpus"] = machine_info->num_cpus;
 	}
-	output_fields["falco.outputs_queue_num_drops"] = m_writer->m_outputs->get_outputs_queue_num_drops();
+	output_fields["falco.stats_num_dropped_samples"] = m_num_dropped_samples.load(std::memory_order_relaxed);
+	output_fields["falco.stats_queue_memory_bytes"] = m_queue_memory_bytes.load(std::memory_order_relaxed);
+	if (m_file_output)
+	{
+		std::map<std::string, uint64_t> file_metrics;
+		m_file_output->get_metrics(file_metrics);
+		for (const auto& item : file_metrics)
+		{
+			output_fields["falco.stats_file." + item.first] = item.second;
+		}
+	}
+	output_fields["falco.rules_memory_bytes"] = m_rules_memory_bytes;
+	output_fields["falco.formatters_memory_bytes"] = m.formatters_memory_bytes;
+	output_fields["falco.outputs_queue_num_drops"] = m_outputs->get_outputs_queue_num_drops();
+	for (const auto& item : m_outputs->get_output_queues_num_drops())
+	{
+		output_fields["falco.outputs_queue_num_drops." + item.first] = item.second;
+	}
+	for (const auto& item : m_outputs->get_outputs_queue_num_drops_by_priority())
+	{
+		output_fields["falco.outputs_queue_num_drops_by_priority." + item.first] = item.second;
+	}
+	output_fields["falco.outputs_aggregation_num_suppressed"] = m_outputs->get_outputs_aggregation_num_suppressed();
+	output_fields["falco.logs_num_dropped"] = falco_logger::get_num_dropped();
+	output_fields["falco.logs_num_suppressed"] = falco_logger::get_num_suppressed();
+	std::map<std::string, uint64_t> rule_state_metrics;
+	m_engine->get_rule_state_metrics(rule_state_metrics);
+	for (const auto& item : rule_state_metrics)
+	{
+		output_fields["falco.rule_state." + item.first] = item.second;
+	}
+	for (const auto& item : m_outputs->get_outputs_queue_metrics())
+	{
+		output_fields["falco.outputs_queue." + item.first] = item.second;
+	}
+	for (const auto& item : m_outputs->get_outputs_metrics())
+	{
+		output_fields["falco.outputs." + item.first] = item.second;
+	}
+	if (falco::alloc_tracker::enabled())
+	{
+		// e.g. falco.alloc.engine.num, falco.alloc.engine.per_evt and
+		// falco.alloc.outputs.per_alert, across all the event sources
+		uint64_t num_alerts = m_engine->get_rule_stats_manager().get_total();
+		for (int i = 0; i < falco::alloc_tracker::NUM_SUBSYSTEMS; i++)
+		{
+			auto s = falco::alloc_tracker::subsystem(i);
+			auto prefix = std::string("falco.alloc.") + falco::alloc_tracker::name(s);
+			uint64_t num = falco::alloc_tracker::num_allocs(s);
+			output_fields[prefix + ".num"] = num;
+			output_fields[prefix + ".bytes"] = falco::alloc_tracker::allocated_bytes(s);
+			if (num_evts > 0)
+			{
+				output_fields[prefix + ".per_evt"] = std::round((double)num / num_evts * 100.0) / 100.0;
+			}
+			if (num_alerts > 0)
+			{
+				output_fields[prefix + ".per_alert"] = std::round((double)num / num_alerts * 100.0) / 100.0;
+			}
+		}
+	}
+	if (falco::rules_arena::enabled())
+	{
+		// e.g. falco.rules_arena.chunks
+		std::map<std::string, uint64_t> arena_metrics;
+		falco::rules_arena::get_metrics(arena_metrics);
+		for (const auto& item : arena_metrics)
+		{
+			output_fields["falco.rules_arena." + item.first] = item.second;
+		}
+	}
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+	if (m_otlp)
+	{
+		std::map<std::string, uint64_t> otlp_metrics;
+		m_otlp->get_metrics(otlp_metrics);
+		for (const auto& item : otlp_metrics)
+		{
+			output_fields["falco.otlp." + item.first] = item.second;
+		}
+	}
+#endif
 
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
-	for (const auto& item : m_writer->m_config->m_loaded_rules_filenames_sha256sum)
+	for (const auto& item : m_config->m_loaded_rules_filenames_sha256sum)
 	{
 		fs::path fs_path = item.first;
 		std::string metric_name_file_sha256 = fs_path.filename().stem();
 		metric_name_file_sha256 = "falco.sha256_rules_file." + falco::utils::sanitize_metric_name(metric_name_file_sha256);
-		output_fields[metric_name_file_sha256] = item.second;
+		output_fields[metric_name_file_sha256] = falco::file_sha256sums::value(item.second);
 	}
 
-	for (const auto& item : m_writer->m_config->m_loaded_configs_filenames_sha256sum)
+	for (const auto& item : m_config->m_loaded_configs_filenames_sha256sum)
 	{
 		fs::path fs_path = item.first;
 		std::string metric_name_file_sha256 = fs_path.filename().stem();
 		metric_name_file_sha256 = "falco.sha256_config_file." + falco::utils::sanitize_metric_name(metric_name_file_sha256);
-		output_fields[metric_name_file_sha256] = item.second;
+		output_fields[metric_name_file_sha256] = falco::file_sha256sums::value(item.second);
 	}
 #endif
 	output_fields["evt.source"] = src;
@@ -369,33 +651,188 @@ void stats_writer::collector::get_metrics_output_fields_wrapper(
 	}
 
 	/* Falco userspace event counters. Always enabled. */
-	if (m_last_num_evts != 0 && stats_snapshot_time_delta_sec > 0)
+	if (state.last_num_evts != 0 && stats_snapshot_time_delta_sec > 0)
 	{
 		/* Successfully processed userspace event rate. */
-		output_fields["falco.evts_rate_sec"] = std::round((double)((num_evts - m_last_num_evts) / (double)stats_snapshot_time_delta_sec) * 10.0) / 10.0; // round to 1 decimal
+		output_fields["falco.evts_rate_sec"] = std::round((double)((num_evts - state.last_num_evts) / (double)stats_snapshot_time_delta_sec) * 10.0) / 10.0; // round to 1 decimal
 	}
 	output_fields["falco.num_evts"] = num_evts;
-	output_fields["falco.num_evts_prev"] = m_last_num_evts;
-	m_last_num_evts = num_evts;
+	output_fields["falco.num_evts_prev"] = state.last_num_evts;
+	state.last_num_evts = num_evts;
+
+	if (m.stages)
+	{
+		std::map<std::string, uint64_t> stage_metrics;
+		m.stages->get_metrics(stage_metrics);
+		for (const auto& item : stage_metrics)
+		{
+			output_fields["falco.evt_stage." + item.first] = item.second;
+		}
+	}
+
+	if (m.idle)
+	{
+		std::map<std::string, uint64_t> idle_metrics;
+		m.idle->get_metrics(idle_metrics);
+		for (const auto& item : idle_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.heartbeat)
+	{
+		std::map<std::string, uint64_t> stall_metrics;
+		m.heartbeat->get_metrics(stall_metrics);
+		for (const auto& item : stall_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.recorder)
+	{
+		std::map<std::string, uint64_t> recorder_metrics;
+		m.recorder->get_metrics(recorder_metrics);
+		for (const auto& item : recorder_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.fast_path)
+	{
+		std::map<std::string, uint64_t> fast_path_metrics;
+		m.fast_path->get_metrics(fast_path_metrics);
+		for (const auto& item : fast_path_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.thread_table)
+	{
+		std::map<std::string, uint64_t> thread_table_metrics;
+		m.thread_table->get_metrics(thread_table_metrics);
+		for (const auto& item : thread_table_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.budgets)
+	{
+		std::map<std::string, uint64_t> budgets_metrics;
+		m.budgets->get_metrics(budgets_metrics);
+		for (const auto& item : budgets_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.gvisor_shards)
+	{
+		std::map<std::string, uint64_t> gvisor_metrics;
+		for (const auto& shard : *m.gvisor_shards)
+		{
+			shard->get_metrics(gvisor_metrics);
+		}
+		for (const auto& item : gvisor_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.shedder)
+	{
+		std::map<std::string, uint64_t> shed_metrics;
+		m.shedder->get_metrics(shed_metrics);
+		for (const auto& item : shed_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.autosizer)
+	{
+		std::map<std::string, uint64_t> buf_size_metrics;
+		m.autosizer->get_metrics(buf_size_metrics);
+		for (const auto& item : buf_size_metrics)
+		{
+			output_fields["falco." + item.first] = item.second;
+		}
+	}
+
+	if (m.trends)
+	{
+		// e.g. falco.kernel_drops.buffer_execve_exit.last_sec
+		for (const auto& r : m.trends->get_rates())
+		{
+			if (r.total == 0 && !m_config->m_metrics_include_empty_values)
+			{
+				continue;
+			}
+			auto prefix = "falco.kernel_drops." + r.category;
+			output_fields[prefix + ".last_sec"] = r.last;
+			output_fields[prefix + ".max_sec"] = r.max;
+			output_fields[prefix + ".window_total"] = r.total;
+		}
+	}
+
+	if (m.cost)
+	{
+		// e.g. falco.syscall_cost.Terminal_shell_in_container.exclusive_events
+		output_fields["falco.syscall_cost.state_events"] = m.cost->state_events();
+		for (const auto& c : m.cost->get_costs())
+		{
+			if (c.events == 0 && !m_config->m_metrics_include_empty_values)
+			{
+				continue;
+			}
+			auto prefix = "falco.syscall_cost." + falco::utils::sanitize_metric_name(c.rule);
+			output_fields[prefix + ".events"] = c.events;
+			output_fields[prefix + ".attributed_events"] = c.attributed_events;
+			output_fields[prefix + ".exclusive_events"] = c.exclusive_events;
+		}
+	}
+
+	if (m.types)
+	{
+		// e.g. falco.evt_type.read.evts_rate_sec
+		for (const auto& t : m.types->get_stats())
+		{
+			auto prefix = "falco.evt_type." + falco::utils::sanitize_metric_name(t.name);
+			auto& last = state.last_evt_type_evts[t.name];
+			if (stats_snapshot_time_delta_sec > 0)
+			{
+				output_fields[prefix + ".evts_rate_sec"] = std::round((double)(t.events - last) / stats_snapshot_time_delta_sec * 10.0) / 10.0; // round to 1 decimal
+			}
+			output_fields[prefix + ".num_evts"] = t.events;
+			output_fields[prefix + ".rules_time_ns"] = t.rules_time_ns;
+			last = t.events;
+		}
+	}
 }
 
-void stats_writer::collector::get_metrics_output_fields_additional(
+void stats_writer::get_metrics_output_fields_additional(
 		nlohmann::json& output_fields,
+		stats_writer::msg& m,
+		source_state& state,
 		double stats_snapshot_time_delta_sec)
 {
 	// Falco metrics categories
 	//
 	// rules_counters_enabled
-	if(m_writer->m_config->m_metrics_flags & METRICS_V2_RULE_COUNTERS)
+	if(m_config->m_metrics_flags & METRICS_V2_RULE_COUNTERS)
 	{
-		const stats_manager& rule_stats_manager = m_writer->m_engine->get_rule_stats_manager();
-		const indexed_vector<falco_rule>& rules = m_writer->m_engine->get_rules();
-		output_fields["falco.rules.matches_total"] = rule_stats_manager.get_total().load();
-		const std::vector<std::unique_ptr<std::atomic<uint64_t>>>& rules_by_id = rule_stats_manager.get_by_rule_id();
+		const stats_manager& rule_stats_manager = m_engine->get_rule_stats_manager();
+		const indexed_vector<falco_rule>& rules = m_engine->get_rules();
+		output_fields["falco.rules.matches_total"] = rule_stats_manager.get_total();
+		const auto& rules_by_id = rule_stats_manager.get_by_rule_id();
 		for (size_t i = 0; i < rules_by_id.size(); i++)
 		{
-			auto rule_count = rules_by_id[i]->load();
-			if (rule_count == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+			auto rule_count = rules_by_id[i];
+			if (rule_count == 0 && !m_config->m_metrics_include_empty_values)
 			{
 				continue;
 			}
@@ -403,10 +840,59 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 			std::string rules_metric_name = "falco.rules." + falco::utils::sanitize_metric_name(rule->name);
 			output_fields[rules_metric_name] = rule_count;
 		}
+		output_fields["falco.rules.rate_limited_total"] = rule_stats_manager.get_rate_limited_total();
+		const auto& rate_limited_by_id = rule_stats_manager.get_rate_limited_by_rule_id();
+		for (size_t i = 0; i < rate_limited_by_id.size(); i++)
+		{
+			auto count = rate_limited_by_id[i];
+			if (count == 0 && !m_config->m_metrics_include_empty_values)
+			{
+				continue;
+			}
+			auto rule = rules.at(i);
+			output_fields["falco.rules_rate_limited." + falco::utils::sanitize_metric_name(rule->name)] = count;
+		}
+		output_fields["falco.rules.exception_hits_total"] = rule_stats_manager.get_exception_hits_total();
+		const auto& exception_hits_by_id = rule_stats_manager.get_exception_hits_by_rule_id();
+		for (size_t i = 0; i < exception_hits_by_id.size(); i++)
+		{
+			auto count = exception_hits_by_id[i];
+			if (count == 0 && !m_config->m_metrics_include_empty_values)
+			{
+				continue;
+			}
+			auto rule = rules.at(i);
+			output_fields["falco.rules_exception_hits." + falco::utils::sanitize_metric_name(rule->name)] = count;
+		}
+	}
+
+	// rules_profiling_enabled
+	const stats_manager& rule_stats_manager = m_engine->get_rule_stats_manager();
+	if(m_config->m_metrics_rules_profiling_enabled && rule_stats_manager.is_rule_profiling_enabled())
+	{
+		const indexed_vector<falco_rule>& rules = m_engine->get_rules();
+		const auto& profiles = rule_stats_manager.get_profile_by_rule_id();
+		for (size_t i = 0; i < profiles.size(); i++)
+		{
+			const auto& profile = *profiles[i];
+			auto evaluations = profile.evaluations.load();
+			if (evaluations == 0 && !m_config->m_metrics_include_empty_values)
+			{
+				continue;
+			}
+			auto rule = rules.at(i);
+			std::string prefix = "falco.rules_profile." + falco::utils::sanitize_metric_name(rule->name);
+			output_fields[prefix + ".evaluations"] = evaluations;
+			output_fields[prefix + ".matches"] = profile.matches.load();
+			output_fields[prefix + ".time_ns"] = profile.estimated_time_ns();
+			output_fields[prefix + ".time_p50_ns"] = profile.time_percentile_ns(50);
+			output_fields[prefix + ".time_p99_ns"] = profile.time_percentile_ns(99);
+			output_fields[prefix + ".time_max_ns"] = profile.max_time_ns();
+		}
 	}
 
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
-	if (m_writer->m_libs_metrics_collector && m_writer->m_output_rule_metrics_converter)
+	if (m_output_rule_metrics_converter)
 	{
 		// Libs metrics categories
 		//
@@ -415,9 +901,8 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 		// kernel_event_counters_enabled
 		// libbpf_stats_enabled
 
-		// Refresh / New snapshot
-		m_writer->m_libs_metrics_collector->snapshot();
-		auto metrics_snapshot = m_writer->m_libs_metrics_collector->get_metrics();
+		// The snapshot taken by the collector
+		auto& metrics_snapshot = m.libs_metrics;
 		// Cache n_evts and n_drops to derive n_drops_perc.
 		uint64_t n_evts = 0;
 		uint64_t n_drops = 0;
@@ -431,9 +916,9 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 			{
 				break;
 			}
-			if (m_writer->m_config->m_metrics_convert_memory_to_mb)
+			if (m_config->m_metrics_convert_memory_to_mb)
 			{
-				m_writer->m_output_rule_metrics_converter->convert_metric_to_unit_convention(metric);
+				m_output_rule_metrics_converter->convert_metric_to_unit_convention(metric);
 			}
 			char metric_name[METRIC_NAME_MAX] = "falco.";
 			if((metric.flags & METRICS_V2_LIBBPF_STATS) || (metric.flags & METRICS_V2_KERNEL_COUNTERS) )
@@ -449,14 +934,14 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 			switch (metric.type)
 			{
 			case METRIC_VALUE_TYPE_U32:
-				if (metric.value.u32 == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.u32 == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
 				output_fields[metric_name] = metric.value.u32;
 				break;
 			case METRIC_VALUE_TYPE_S32:
-				if (metric.value.s32 == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.s32 == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
@@ -468,8 +953,8 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 					n_evts = metric.value.u64;
 					// Always send high level n_evts related fields, even if zero and configs are set to exclude empty values.
 					output_fields[metric_name] = n_evts;
-					output_fields["scap.n_evts_prev"] = m_last_n_evts;
-					n_evts_delta = n_evts - m_last_n_evts;
+					output_fields["scap.n_evts_prev"] = state.last_n_evts;
+					n_evts_delta = n_evts - state.last_n_evts;
 					if (n_evts_delta != 0 && stats_snapshot_time_delta_sec > 0)
 					{
 						output_fields["scap.evts_rate_sec"] = std::round((double)(n_evts_delta / stats_snapshot_time_delta_sec) * 10.0) / 10.0; // round to 1 decimal
@@ -478,15 +963,15 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 					{
 						output_fields["scap.evts_rate_sec"] = (double)(0);
 					}
-					m_last_n_evts = n_evts;
+					state.last_n_evts = n_evts;
 				}
 				else if (strncmp(metric.name, "n_drops", 8) == 0)
 				{
 					n_drops = metric.value.u64;
 					// Always send high level n_drops related fields, even if zero and configs are set to exclude empty values.
 					output_fields[metric_name] = n_drops;
-					output_fields["scap.n_drops_prev"] = m_last_n_drops;
-					n_drops_delta = n_drops - m_last_n_drops;
+					output_fields["scap.n_drops_prev"] = state.last_n_drops;
+					n_drops_delta = n_drops - state.last_n_drops;
 					if (n_drops_delta != 0 && stats_snapshot_time_delta_sec > 0)
 					{
 						output_fields["scap.evts_drop_rate_sec"] = std::round((double)(n_drops_delta / stats_snapshot_time_delta_sec) * 10.0) / 10.0; // round to 1 decimal
@@ -495,37 +980,37 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 					{
 						output_fields["scap.evts_drop_rate_sec"] = (double)(0);
 					}
-					m_last_n_drops = n_drops;
+					state.last_n_drops = n_drops;
 				}
-				if (metric.value.u64 == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.u64 == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
 				output_fields[metric_name] = metric.value.u64;
 				break;
 			case METRIC_VALUE_TYPE_S64:
-				if (metric.value.s64 == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.s64 == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
 				output_fields[metric_name] = metric.value.s64;
 				break;
 			case METRIC_VALUE_TYPE_D:
-				if (metric.value.d == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.d == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
 				output_fields[metric_name] = metric.value.d;
 				break;
 			case METRIC_VALUE_TYPE_F:
-				if (metric.value.f == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.f == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
 				output_fields[metric_name] = metric.value.f;
 				break;
 			case METRIC_VALUE_TYPE_I:
-				if (metric.value.i == 0 && !m_writer->m_config->m_metrics_include_empty_values)
+				if (metric.value.i == 0 && !m_config->m_metrics_include_empty_values)
 				{
 					break;
 				}
@@ -549,12 +1034,20 @@ void stats_writer::collector::get_metrics_output_fields_additional(
 #endif
 }
 
-void stats_writer::collector::collect(const std::shared_ptr<sinsp>& inspector, const std::string &src, uint64_t num_evts)
+void stats_writer::collector::collect(const std::shared_ptr<sinsp>& inspector, const std::string &src, uint64_t num_evts,
+	const falco::event_stages* stages, const falco::idle_backoff* idle,
+	const falco::load_shedder* shedder, const falco::buffer_autosizer* autosizer,
+	const falco::drop_trends* trends, const falco::syscall_cost* cost,
+	const falco::source_monitor::heartbeat* heartbeat, const falco::event_types* types,
+	const falco::flight_recorder* recorder, const falco::event_fast_path* fast_path,
+	const falco::thread_table_sizer* thread_table, const falco::container_budgets* budgets,
+	const std::vector<std::shared_ptr<falco::gvisor_sandboxes>>* gvisor_shards)
 {
+	falco::alloc_tracker::scope alloc_scope(falco::alloc_tracker::STATS);
 	if (m_writer->has_output())
 	{
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
-		if(!m_writer->m_libs_metrics_collector)
+		if(!m_libs_metrics_collector)
 		{
 			uint32_t flags = m_writer->m_config->m_metrics_flags;
 			// Note: ENGINE_FLAG_BPF_STATS_ENABLED check has been moved to libs, that is, when libbpf stats is not enabled
@@ -569,12 +1062,7 @@ void stats_writer::collector::collect(const std::shared_ptr<sinsp>& inspector, c
 				flags &= ~(METRICS_V2_KERNEL_COUNTERS | METRICS_V2_STATE_COUNTERS | METRICS_V2_LIBBPF_STATS);
 
 			}
-			m_writer->m_libs_metrics_collector = std::make_unique<libs::metrics::libs_metrics_collector>(inspector.get(), flags);
-		}
-
-		if(!m_writer->m_output_rule_metrics_converter)
-		{
-			m_writer->m_output_rule_metrics_converter = std::make_unique<libs::metrics::output_rule_metrics_converter>();
+			m_libs_metrics_collector = std::make_unique<libs::metrics::libs_metrics_collector>(inspector.get(), flags);
 		}
 #endif
 		/* Collect stats / metrics once per ticker period. */
@@ -582,27 +1070,54 @@ void stats_writer::collector::collect(const std::shared_ptr<sinsp>& inspector, c
 		if (tick != m_last_tick)
 		{
 			m_last_tick = tick;
-			auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+
+			/* Capture the raw values, everything else is up to the worker.
+			 * A sample still waiting for room in the queue is replaced. */
+			if (m_pending)
+			{
+				m_writer->m_num_dropped_samples.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				m_pending = std::make_unique<stats_writer::msg>();
+			}
+			stats_writer::msg& msg = *m_pending;
+			msg.ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
 				std::chrono::system_clock::now().time_since_epoch()).count();
-			uint64_t stats_snapshot_time_delta = 0;
-			if (m_last_now != 0)
+			msg.source = src;
+			msg.num_evts = num_evts;
+			msg.inspector = inspector;
+			msg.stages = stages;
+			msg.idle = idle;
+			msg.shedder = shedder;
+			msg.autosizer = autosizer;
+			msg.trends = trends;
+			msg.cost = cost;
+			msg.heartbeat = heartbeat;
+			msg.types = types;
+			msg.recorder = recorder;
+			msg.fast_path = fast_path;
+			msg.thread_table = thread_table;
+			msg.budgets = budgets;
+			msg.gvisor_shards = gvisor_shards;
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+			// the libs metrics read the state of the inspector, which is
+			// only safe on its thread
+			m_libs_metrics_collector->snapshot();
+			msg.libs_metrics = m_libs_metrics_collector->get_metrics();
+#endif
+			if (m_writer->m_engine)
 			{
-				stats_snapshot_time_delta = now - m_last_now;
+				msg.formatters_memory_bytes = m_writer->m_engine->formatters_memory_usage(src);
 			}
-			m_last_now = now;
-			double stats_snapshot_time_delta_sec = (stats_snapshot_time_delta / (double)ONE_SECOND_IN_NS);
-
-			/* Get respective metrics output_fields. */
-			nlohmann::json output_fields;
-			get_metrics_output_fields_wrapper(output_fields, inspector, src, num_evts, now, stats_snapshot_time_delta_sec);
-			get_metrics_output_fields_additional(output_fields, stats_snapshot_time_delta_sec);
+			msg.memory_bytes = sizeof(msg) + falco::utils::memory::of(msg.source)
+				+ msg.libs_metrics.capacity() * sizeof(metrics_v2);
+		}
 
-			/* Send message in the queue */
-			stats_writer::msg msg;
-			msg.ts = now;
-			msg.source = src;
-			msg.output_fields = std::move(output_fields);
-			m_writer->push(msg);
+		/* Send message in the queue, or retry later if it is full. */
+		if (m_pending && m_writer->try_push(*m_pending))
+		{
+			m_pending.reset();
 		}
 	}
 }
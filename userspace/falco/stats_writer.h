@@ -17,9 +17,11 @@ limitations under the License.
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <libsinsp/sinsp.h>
 
@@ -28,6 +30,23 @@ limitations under the License.
 #endif
 #include "falco_outputs.h"
 #include "configuration.h"
+#include "event_stages.h"
+#include "event_types.h"
+#include "buffer_autosizer.h"
+#include "drop_trends.h"
+#include "idle_backoff.h"
+#include "flight_recorder.h"
+#include "event_fast_path.h"
+#include "thread_table_sizer.h"
+#include "container_budgets.h"
+#include "gvisor_sandboxes.h"
+#include "load_shedder.h"
+#include "syscall_cost.h"
+#include "source_monitor.h"
+#include "startup_report.h"
+#include "metrics_file.h"
+
+class falco_metrics;
 
 /*!
 	\brief Writes stats samples collected from inspectors into a given output.
@@ -37,6 +56,9 @@ limitations under the License.
 */
 class stats_writer
 {
+private:
+	struct msg;
+
 public:
 	/*!
 		\brief Value of a ticker that dictates when stats are collected
@@ -46,7 +68,14 @@ public:
 	/*!
 		\brief Collects stats samples from an inspector and uses a writer
 		to print them in a given output. Stats are collected periodically every
-		time the value of stats_writer::get_ticker() changes.
+		time the value of stats_writer::get_ticker() changes. Only the values
+		that must be read on the thread of the inspector are captured here,
+		while naming them, converting their units, deriving the rates and
+		building the output fields is left to the worker of the writer.
+		When the worker falls behind and the queue of the writer is full,
+		the collector keeps the latest sample of its source and pushes it
+		as soon as there is room, so that the event thread never blocks or
+		fails because of the stats.
 		This class is not thread-safe.
 	*/
 	class collector
@@ -59,27 +88,37 @@ public:
 
 		/*!
 			\brief Collects one stats sample from an inspector
-			and for the given event source name
+			and for the given event source name, along with the time
+			spent in each stage of its processing loop, how it waited
+			while the source was idle, which of its events skipped the
+			rules, which syscall buffer size is recommended, the recent
+			kernel drops of each category, the events attributed to
+			each rule, how long the source has been stalled for, its
+			events by event type, its flight recorder, which of its
+			events skipped the rules as no rule needs them, its
+			thread table, the budgets of its containers, and the events
+			of its gVisor sandboxes by shard, if given.
+			All of them must outlive the writer.
 		*/
-		void collect(const std::shared_ptr<sinsp>& inspector, const std::string& src, uint64_t num_evts);
+		void collect(const std::shared_ptr<sinsp>& inspector, const std::string& src, uint64_t num_evts,
+			const falco::event_stages* stages = nullptr, const falco::idle_backoff* idle = nullptr,
+			const falco::load_shedder* shedder = nullptr, const falco::buffer_autosizer* autosizer = nullptr,
+			const falco::drop_trends* trends = nullptr, const falco::syscall_cost* cost = nullptr,
+			const falco::source_monitor::heartbeat* heartbeat = nullptr,
+			const falco::event_types* types = nullptr,
+			const falco::flight_recorder* recorder = nullptr,
+			const falco::event_fast_path* fast_path = nullptr,
+			const falco::thread_table_sizer* thread_table = nullptr,
+			const falco::container_budgets* budgets = nullptr,
+			const std::vector<std::shared_ptr<falco::gvisor_sandboxes>>* gvisor_shards = nullptr);
 
 	private:
-		/*!
-			\brief Collect snapshot metrics wrapper fields as internal rule formatted output fields.
-		*/
-		void get_metrics_output_fields_wrapper(nlohmann::json& output_fields, const std::shared_ptr<sinsp>& inspector, const std::string& src, uint64_t num_evts, uint64_t now, double stats_snapshot_time_delta_sec);
-
-		/*!
-			\brief Collect the configurable snapshot metrics as internal rule formatted output fields.
-		*/
-		void get_metrics_output_fields_additional(nlohmann::json& output_fields, double stats_snapshot_time_delta_sec);
-
 		std::shared_ptr<stats_writer> m_writer;
 		stats_writer::ticker_t m_last_tick = 0;
-		uint64_t m_last_now = 0;
-		uint64_t m_last_n_evts = 0;
-		uint64_t m_last_n_drops = 0;
-		uint64_t m_last_num_evts = 0;
+		std::unique_ptr<stats_writer::msg> m_pending;
+#if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
+		std::unique_ptr<libs::metrics::libs_metrics_collector> m_libs_metrics_collector;
+#endif
 	};
 
 	stats_writer(const stats_writer&) = delete;
@@ -93,11 +132,18 @@ public:
 	~stats_writer();
 
 	/*!
-		\brief Initializes a writer.
+		\brief Initializes a writer, which also exports the metrics to
+		the given OTLP exporter, if any and if its metrics are enabled,
+		and publishes them for the Prometheus endpoint, if given. The
+		first written snapshot also has the times of the given startup
+		report, if any.
 	*/
 	stats_writer(const std::shared_ptr<falco_outputs>& outputs,
 		const std::shared_ptr<const falco_configuration>& config,
-		const std::shared_ptr<const falco_engine>& engine);
+		const std::shared_ptr<const falco_engine>& engine,
+		const std::shared_ptr<falco::otlp_exporter>& otlp = nullptr,
+		const std::shared_ptr<const falco::startup_report>& startup = nullptr,
+		const std::shared_ptr<falco_metrics>& prometheus = nullptr);
 
 	/*!
 		\brief Returns true if the writer is configured with a valid output.
@@ -107,13 +153,24 @@ public:
 		return m_initialized;
 	}
 
+	/*!
+		\brief Returns the interval of the ticker in milliseconds, which is
+		the metrics interval, or the refresh interval of the Prometheus
+		metrics if shorter. In that case, the samples in between the ones
+		due for the other outputs are only published for Prometheus.
+	*/
+	inline uint64_t ticker_interval() const
+	{
+		return m_ticker_interval_ms;
+	}
+
 	/*!
 		\brief Initializes the ticker with a given interval period defined
 		in milliseconds. Subsequent calls to init_ticker will dismiss the
 		previously-initialized ticker. Internally, this uses a timer
-		signal handler.
+		signal handler, or a dedicated thread if use_thread is true.
 	*/
-	static bool init_ticker(uint32_t interval_msec, std::string &err);
+	static bool init_ticker(uint32_t interval_msec, std::string &err, bool use_thread = false);
 
 	/*!
 		\brief Returns the current value of the ticker.
@@ -122,6 +179,7 @@ public:
 	inline static ticker_t get_ticker();
 
 private:
+	// The raw values of a sample, as captured by a collector
 	struct msg
 	{
 		msg() {}
@@ -133,25 +191,82 @@ private:
 		bool stop = false;
 		uint64_t ts = 0;
 		std::string source;
-		nlohmann::json output_fields;
+		uint64_t num_evts = 0;
+		std::shared_ptr<sinsp> inspector;
+		const falco::event_stages* stages = nullptr;
+		const falco::idle_backoff* idle = nullptr;
+		const falco::load_shedder* shedder = nullptr;
+		const falco::buffer_autosizer* autosizer = nullptr;
+		const falco::drop_trends* trends = nullptr;
+		const falco::syscall_cost* cost = nullptr;
+		const falco::source_monitor::heartbeat* heartbeat = nullptr;
+		const falco::event_types* types = nullptr;
+		const falco::flight_recorder* recorder = nullptr;
+		const falco::event_fast_path* fast_path = nullptr;
+		const falco::thread_table_sizer* thread_table = nullptr;
+		const falco::container_budgets* budgets = nullptr;
+		const std::vector<std::shared_ptr<falco::gvisor_sandboxes>>* gvisor_shards = nullptr;
+		std::vector<metrics_v2> libs_metrics;
+		// the memory held by the alert formatters of the source, which
+		// can only be measured on its thread
+		uint64_t formatters_memory_bytes = 0;
+		// the memory held by the sample while it's queued
+		uint64_t memory_bytes = 0;
+	};
+
+	// The values of the previous sample of a source, used to derive the
+	// rates of the next one. Only used by the worker.
+	struct source_state
+	{
+		uint64_t last_ts = 0;
+		uint64_t last_num_evts = 0;
+		uint64_t last_n_evts = 0;
+		uint64_t last_n_drops = 0;
+		// the events of each event type, by name
+		std::unordered_map<std::string, uint64_t> last_evt_type_evts;
 	};
 
 	void worker() noexcept;
 	void stop_worker();
-	inline void push(const stats_writer::msg& m);
+	inline bool try_push(const stats_writer::msg& m);
+
+	/*!
+		\brief Collect snapshot metrics wrapper fields as internal rule formatted output fields.
+	*/
+	void get_metrics_output_fields_wrapper(nlohmann::json& output_fields, const stats_writer::msg& m, source_state& state, double stats_snapshot_time_delta_sec);
+
+	/*!
+		\brief Collect the configurable snapshot metrics as internal rule formatted output fields.
+	*/
+	void get_metrics_output_fields_additional(nlohmann::json& output_fields, stats_writer::msg& m, source_state& state, double stats_snapshot_time_delta_sec);
 
 	bool m_initialized = false;
+	// whether there's any output besides the Prometheus endpoint
+	bool m_has_outputs = false;
+	uint64_t m_ticker_interval_ms = 0;
 	uint64_t m_total_samples = 0;
+	// the samples replaced by a newer one of the same source before
+	// there was room in the queue for them
+	std::atomic<uint64_t> m_num_dropped_samples{0};
+	std::atomic<uint64_t> m_queue_memory_bytes{0};
+	// the rules don't change while the writer is in use, so their memory
+	// is measured once
+	uint64_t m_rules_memory_bytes = 0;
 	std::thread m_worker;
-	std::ofstream m_file_output;
+	std::unique_ptr<falco::metrics_file> m_file_output;
 #ifndef __EMSCRIPTEN__
 	tbb::concurrent_bounded_queue<stats_writer::msg> m_queue;
 #endif
+	std::unordered_map<std::string, source_state> m_source_states;
 #if defined(__linux__) and !defined(MINIMAL_BUILD) and !defined(__EMSCRIPTEN__)
-	std::unique_ptr<libs::metrics::libs_metrics_collector> m_libs_metrics_collector;
 	std::unique_ptr<libs::metrics::output_rule_metrics_converter> m_output_rule_metrics_converter;
 #endif
 	std::shared_ptr<falco_outputs> m_outputs;
+	std::shared_ptr<falco::otlp_exporter> m_otlp;
+	std::shared_ptr<falco_metrics> m_prometheus;
+	// only used by the worker, which clears it once the startup times
+	// are written
+	std::shared_ptr<const falco::startup_report> m_startup;
 	std::shared_ptr<const falco_configuration> m_config;
 	std::shared_ptr<const falco_engine> m_engine;
 	// note: in this way, only collectors can push into the queue
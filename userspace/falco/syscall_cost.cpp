@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "syscall_cost.h"
+
+#include <algorithm>
+
+falco::syscall_cost::syscall_cost(const std::vector<rule_evt_types>& rules, size_t num_evt_types)
+	: m_num_evt_types(num_evt_types),
+	  m_num_rules_by_evt_type(num_evt_types, 0),
+	  m_counts(new std::atomic<uint64_t>[num_evt_types])
+{
+	for(size_t i = 0; i < num_evt_types; i++)
+	{
+		m_counts[i].store(0, std::memory_order_relaxed);
+	}
+
+	m_rules.reserve(rules.size());
+	for(const auto& r : rules)
+	{
+		rule_info info;
+		info.rule = r.rule;
+		for(auto t : r.evt_types)
+		{
+			if(t < num_evt_types)
+			{
+				info.evt_types.push_back(t);
+			}
+		}
+		std::sort(info.evt_types.begin(), info.evt_types.end());
+		info.evt_types.erase(std::unique(info.evt_types.begin(), info.evt_types.end()), info.evt_types.end());
+		for(auto t : info.evt_types)
+		{
+			m_num_rules_by_evt_type[t]++;
+		}
+		m_rules.emplace_back(std::move(info));
+	}
+}
+
+std::vector<falco::syscall_cost::rule_cost> falco::syscall_cost::get_costs() const
+{
+	std::vector<rule_cost> res;
+	res.reserve(m_rules.size());
+	for(const auto& r : m_rules)
+	{
+		rule_cost c;
+		c.rule = r.rule;
+		c.evt_types = r.evt_types.size();
+		double attributed = 0;
+		for(auto t : r.evt_types)
+		{
+			auto n = m_counts[t].load(std::memory_order_relaxed);
+			c.events += n;
+			attributed += (double)n / m_num_rules_by_evt_type[t];
+			if(m_num_rules_by_evt_type[t] == 1)
+			{
+				c.exclusive_events += n;
+			}
+		}
+		c.attributed_events = (uint64_t)(attributed + 0.5);
+		res.emplace_back(std::move(c));
+	}
+	return res;
+}
+
+uint64_t falco::syscall_cost::state_events() const
+{
+	uint64_t res = 0;
+	for(size_t t = 0; t < m_num_evt_types; t++)
+	{
+		if(m_num_rules_by_evt_type[t] == 0)
+		{
+			res += m_counts[t].load(std::memory_order_relaxed);
+		}
+	}
+	return res;
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief Attributes the events collected by the syscall source to the
+	rules requiring their event types, so that the kernel overhead of each
+	rule can be weighed against its value. Every event type is needed by
+	zero or more rules: the events of a type count towards the events of
+	all the rules needing it, are split evenly among them in the attributed
+	events, and count towards the exclusive events of a rule if no other
+	rule needs them, i.e. they would not be collected without it unless the
+	state engine needs them. The events of types needed by no rule are
+	collected for the state engine only. The events are counted by the
+	thread of the source, and the costs can be read from any thread.
+*/
+class syscall_cost
+{
+public:
+	struct rule_evt_types
+	{
+		std::string rule;
+		std::vector<uint16_t> evt_types;
+	};
+
+	struct rule_cost
+	{
+		std::string rule;
+		// the number of event types needed by the rule
+		uint64_t evt_types = 0;
+		// the events of the types needed by the rule
+		uint64_t events = 0;
+		// the events split evenly among the rules needing them
+		uint64_t attributed_events = 0;
+		// the events of the types needed by the rule only
+		uint64_t exclusive_events = 0;
+	};
+
+	/*!
+		\brief Creates the costs of the given rules, with the event types
+		ranging from 0 to num_evt_types - 1
+	*/
+	syscall_cost(const std::vector<rule_evt_types>& rules, size_t num_evt_types);
+
+	/*!
+		\brief Accounts an event of the given type
+	*/
+	inline void count(uint16_t evt_type)
+	{
+		if(evt_type < m_num_evt_types) [[likely]]
+		{
+			auto& c = m_counts[evt_type];
+			c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	}
+
+	std::vector<rule_cost> get_costs() const;
+
+	/*!
+		\brief Returns the events of the types needed by no rule
+	*/
+	uint64_t state_events() const;
+
+private:
+	struct rule_info
+	{
+		std::string rule;
+		std::vector<uint16_t> evt_types;
+	};
+
+	size_t m_num_evt_types;
+	std::vector<rule_info> m_rules;
+	std::vector<uint32_t> m_num_rules_by_evt_type;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+};
+
+} // namespace falco
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "thread_affinity.h"
+#include "profiler.h"
+#include "logger.h"
+
+#include <array>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static std::array<std::vector<uint32_t>, falco::thread_affinity::NUM_CLASSES> s_cpus;
+
+const char* falco::thread_affinity::name(thread_class c)
+{
+	switch(c)
+	{
+	case EVENT_SOURCES:
+		return "event_sources";
+	case OUTPUTS:
+		return "outputs";
+	case STATS:
+		return "stats";
+	case WEBSERVER:
+		return "webserver";
+	case WATCHERS:
+		return "watchers";
+	default:
+		return "unknown";
+	}
+}
+
+void falco::thread_affinity::set(thread_class c, const std::vector<uint32_t>& cpus)
+{
+	s_cpus[c] = cpus;
+}
+
+const std::vector<uint32_t>& falco::thread_affinity::get(thread_class c)
+{
+	return s_cpus[c];
+}
+
+bool falco::thread_affinity::pin_current(const std::vector<uint32_t>& cpus, std::string& err)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(auto cpu : cpus)
+	{
+		if(cpu < CPU_SETSIZE)
+		{
+			CPU_SET(cpu, &set);
+		}
+	}
+	int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if(res != 0)
+	{
+		err = strerror(res);
+		return false;
+	}
+	return true;
+#else
+	err = "not supported on this platform";
+	return false;
+#endif
+}
+
+void falco::thread_affinity::apply(thread_class c)
+{
+	// every thread of Falco applies its class when it starts
+	falco::profiler::set_thread_label(name(c));
+	if(s_cpus[c].empty())
+	{
+		return;
+	}
+
+	std::string err;
+	if(!pin_current(s_cpus[c], err))
+	{
+		falco_logger::log(falco_logger::level::WARNING, "Could not set the CPU affinity of a thread of class '" + std::string(name(c)) + "': " + err + "\n");
+	}
+}
+
+falco::thread_affinity::scoped::scoped(thread_class c)
+{
+	if(s_cpus[c].empty())
+	{
+		return;
+	}
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+	{
+		for(uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if(CPU_ISSET(cpu, &set))
+			{
+				m_previous.push_back(cpu);
+			}
+		}
+	}
+#endif
+	apply(c);
+	m_applied = true;
+}
+
+falco::thread_affinity::scoped::~scoped()
+{
+	std::string err;
+	if(m_applied && !m_previous.empty() && !pin_current(m_previous, err))
+	{
+		falco_logger::log(falco_logger::level::WARNING, "Could not restore the CPU affinity of a thread: " + err + "\n");
+	}
+}
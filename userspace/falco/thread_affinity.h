@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief The CPUs on which each class of Falco's threads runs, as set in
+	the configuration. Each thread applies the affinity of its class when
+	it starts, and the threads it spawns inherit it, so the affinities must
+	be set before any of them is spawned. The memory that a thread touches
+	first is allocated on its NUMA node by the kernel, so pinning a class
+	to the CPUs of a node also keeps most of its memory there.
+*/
+namespace thread_affinity
+{
+
+enum thread_class
+{
+	EVENT_SOURCES = 0,
+	OUTPUTS,
+	STATS,
+	WEBSERVER,
+	WATCHERS,
+	NUM_CLASSES
+};
+
+const char* name(thread_class c);
+
+/*!
+	\brief Sets the CPUs of the given class of threads, or none to leave
+	them unplaced. This is not thread-safe.
+*/
+void set(thread_class c, const std::vector<uint32_t>& cpus);
+
+const std::vector<uint32_t>& get(thread_class c);
+
+/*!
+	\brief Pins the current thread to the given CPUs, returning false
+	along with an error if that fails or is not supported
+*/
+bool pin_current(const std::vector<uint32_t>& cpus, std::string& err);
+
+/*!
+	\brief Pins the current thread to the CPUs of the given class, if any,
+	logging a warning if that fails
+*/
+void apply(thread_class c);
+
+/*!
+	\brief Pins the current thread to the CPUs of the given class, if any,
+	for the lifetime of the object, and then restores its previous
+	affinity. This is useful for the work of a class that runs on a thread
+	that is not its own, e.g. the main one.
+*/
+class scoped
+{
+public:
+	explicit scoped(thread_class c);
+	~scoped();
+
+	scoped(const scoped&) = delete;
+	scoped& operator = (const scoped&) = delete;
+
+private:
+	bool m_applied = false;
+	std::vector<uint32_t> m_previous;
+};
+
+} // namespace thread_affinity
+} // namespace falco
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "thread_table_sizer.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace falco;
+
+thread_table_sizer::thread_table_sizer(const config& c): m_config(c)
+{
+	m_config.m_min_size = std::max<uint32_t>(m_config.m_min_size, 1);
+	m_config.m_max_size = std::max(m_config.m_max_size, m_config.m_min_size);
+	m_config.m_headroom = std::max(m_config.m_headroom, 1.0);
+}
+
+uint32_t thread_table_sizer::clamp(uint64_t size) const
+{
+	return (uint32_t) std::clamp<uint64_t>(size, m_config.m_min_size, m_config.m_max_size);
+}
+
+uint32_t thread_table_sizer::start(uint64_t host_threads)
+{
+	uint32_t size = m_config.m_autosize
+		? clamp((uint64_t) (host_threads * m_config.m_headroom))
+		: m_config.m_size;
+	m_size.store(size, std::memory_order_relaxed);
+	m_next_check = std::chrono::steady_clock::time_point{};
+	return size;
+}
+
+uint32_t thread_table_sizer::update(std::chrono::steady_clock::time_point now, const counters& c)
+{
+	m_threads.store(c.threads, std::memory_order_relaxed);
+	m_full_drops.store(c.full_drops, std::memory_order_relaxed);
+	m_failed_lookups.store(c.failed_lookups, std::memory_order_relaxed);
+	m_removed.store(c.removed, std::memory_order_relaxed);
+	if(!m_config.m_autosize)
+	{
+		return 0;
+	}
+
+	// the first interval starts with the first update
+	if(m_next_check == std::chrono::steady_clock::time_point{})
+	{
+		m_next_check = now + m_config.m_interval;
+		m_last_full_drops = c.full_drops;
+		return 0;
+	}
+	if(now < m_next_check)
+	{
+		return 0;
+	}
+	m_next_check = now + m_config.m_interval;
+	bool full = c.full_drops > m_last_full_drops;
+	m_last_full_drops = c.full_drops;
+
+	uint64_t current = size();
+	uint64_t target = current;
+	if(full || c.threads * 10 >= current * 9)
+	{
+		target = std::max<uint64_t>(current * 2, c.threads * m_config.m_headroom);
+	}
+	else if(c.threads * m_config.m_headroom * 2 < current)
+	{
+		target = c.threads * m_config.m_headroom;
+	}
+	target = clamp(target);
+	if(target == current)
+	{
+		return 0;
+	}
+	m_size.store((uint32_t) target, std::memory_order_relaxed);
+	m_resizes.fetch_add(1, std::memory_order_relaxed);
+	return (uint32_t) target;
+}
+
+uint64_t thread_table_sizer::host_threads()
+{
+	// the fourth field is the number of runnable and of existing threads,
+	// e.g. "0.20 0.18 0.12 1/80 11206"
+	std::ifstream f("/proc/loadavg");
+	std::string load1, load5, load15, field;
+	if(!(f >> load1 >> load5 >> load15 >> field))
+	{
+		return 0;
+	}
+	auto slash = field.find('/');
+	if(slash == std::string::npos)
+	{
+		return 0;
+	}
+	try
+	{
+		return std::stoull(field.substr(slash + 1));
+	}
+	catch(const std::exception&)
+	{
+		return 0;
+	}
+}
+
+void thread_table_sizer::get_metrics(std::map<std::string, uint64_t>& metrics) const
+{
+	metrics["thread_table.max_threads"] = size();
+	metrics["thread_table.threads"] = m_threads.load(std::memory_order_relaxed);
+	metrics["thread_table.full_drops"] = m_full_drops.load(std::memory_order_relaxed);
+	metrics["thread_table.failed_lookups"] = m_failed_lookups.load(std::memory_order_relaxed);
+	metrics["thread_table.removed"] = m_removed.load(std::memory_order_relaxed);
+	metrics["thread_table.resizes"] = m_resizes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace falco
+{
+
+/*!
+	\brief Decides the maximum size of the thread table of the syscall
+	inspector and keeps its metrics. With a fixed size, the size is the
+	configured one. Otherwise, the table starts with headroom times the
+	number of threads of the host, and is checked again once per interval:
+	it doubles when it was full or almost full, and shrinks down to
+	headroom times its threads when it is mostly empty. The size always
+	stays between min_size and max_size, the latter being derived from a
+	memory budget. Shrinking the table doesn't remove any thread, it only
+	stops adding new ones until enough of them exit. The size is decided
+	by the thread of the source, and the metrics can be read from any
+	thread.
+*/
+class thread_table_sizer
+{
+public:
+	struct config
+	{
+		// the fixed size, used if autosize is false
+		uint32_t m_size = 0;
+		bool m_autosize = false;
+		uint32_t m_min_size = 0;
+		uint32_t m_max_size = 0;
+		double m_headroom = 1;
+		std::chrono::seconds m_interval{0};
+	};
+
+	// The counters of the thread table, as kept by the inspector
+	struct counters
+	{
+		uint64_t threads = 0;
+		// the threads not added as the table was full
+		uint64_t full_drops = 0;
+		// the lookups of threads not found in the table
+		uint64_t failed_lookups = 0;
+		// the threads removed from the table after having exited
+		uint64_t removed = 0;
+	};
+
+	explicit thread_table_sizer(const config& c);
+
+	/*!
+		\brief Returns the size of the table when the inspector is opened,
+		given the number of threads of the host, and sets it as the
+		current size
+	*/
+	uint32_t start(uint64_t host_threads);
+
+	/*!
+		\brief Accounts the counters of the table, and returns the new size
+		of the table if it must be resized, or 0
+	*/
+	uint32_t update(std::chrono::steady_clock::time_point now, const counters& c);
+
+	inline uint32_t size() const
+	{
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+	/*!
+		\brief Returns the number of threads of the host, as counted by
+		the kernel, or 0 if it can't be read
+	*/
+	static uint64_t host_threads();
+
+	/*!
+		\brief Adds to the given map the size of the table, its threads, and
+		the counters of its full drops, failed lookups, removed threads and
+		resizes, as thread_table.max_threads, thread_table.threads,
+		thread_table.full_drops, thread_table.failed_lookups,
+		thread_table.removed and thread_table.resizes
+	*/
+	void get_metrics(std::map<std::string, uint64_t>& metrics) const;
+
+private:
+	uint32_t clamp(uint64_t size) const;
+
+	config m_config;
+
+	// only used by the thread of the source
+	std::chrono::steady_clock::time_point m_next_check;
+	uint64_t m_last_full_drops = 0;
+
+	std::atomic<uint32_t> m_size{0};
+	std::atomic<uint64_t> m_threads{0};
+	std::atomic<uint64_t> m_full_drops{0};
+	std::atomic<uint64_t> m_failed_lookups{0};
+	std::atomic<uint64_t> m_removed{0};
+	std::atomic<uint64_t> m_resizes{0};
+};
+
+} // namespace falco
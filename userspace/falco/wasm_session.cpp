@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "wasm_session.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdio>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+using namespace falco;
+
+wasm_session::wasm_session(const std::string& capture_path):
+	m_capture_path(capture_path),
+	m_inspector(std::make_unique<sinsp>())
+{
+	m_inspector->set_hostname_and_port_resolution_mode(false);
+	m_source = m_engine.add_source(falco_common::syscall_source,
+		std::make_shared<sinsp_filter_factory>(m_inspector.get(), m_filterchecks),
+		std::make_shared<sinsp_evt_formatter_factory>(m_inspector.get(), m_filterchecks));
+}
+
+wasm_session::~wasm_session()
+{
+	std::remove(m_capture_path.c_str());
+}
+
+bool wasm_session::load_rules(const std::string& content, const std::string& name, std::string& err)
+{
+	std::string warnings;
+	return m_engine.load_rules(content, name, err, warnings);
+}
+
+bool wasm_session::evaluate(const uint8_t* buf, size_t len, std::string& out, std::string& err)
+{
+	FILE* f = fopen(m_capture_path.c_str(), "wb");
+	if(f == nullptr || fwrite(buf, 1, len, f) != len || fclose(f) != 0)
+	{
+		err = "could not write the capture to " + m_capture_path;
+		return false;
+	}
+
+	auto matches = nlohmann::json::array();
+	try
+	{
+		m_inspector->open_savefile(m_capture_path);
+		m_inspector->start_capture();
+		sinsp_evt* ev = nullptr;
+		uint64_t event = 0;
+		while(true)
+		{
+			int32_t rc = m_inspector->next(&ev);
+			if(rc == SCAP_EOF)
+			{
+				break;
+			}
+			else if(rc == SCAP_TIMEOUT || rc == SCAP_FILTERED_EVENT)
+			{
+				continue;
+			}
+			else if(rc != SCAP_SUCCESS)
+			{
+				throw sinsp_exception(m_inspector->getlasterr());
+			}
+
+			m_matches.clear();
+			if(m_engine.evaluate(m_source, &ev, 1, m_matches) > 0)
+			{
+				for(const auto& m : m_matches)
+				{
+					std::string priority;
+					falco_common::format_priority(m.priority, priority);
+					matches.push_back({
+						{"event", event},
+						{"ts", ev->get_ts()},
+						{"rule", m.rule},
+						{"source", m.source},
+						{"priority", priority},
+						{"tags", m.tags},
+						{"output", m.output}});
+				}
+			}
+			event++;
+		}
+		m_inspector->stop_capture();
+		m_inspector->close();
+	}
+	catch(const std::exception& e)
+	{
+		m_inspector->close();
+		err = "could not read the capture: " + std::string(e.what());
+		return false;
+	}
+	out = matches.dump();
+	return true;
+}
+
+#ifdef __EMSCRIPTEN__
+// The entry points exported to JavaScript. The strings they return are
+// owned by the module and stay valid until the next call.
+
+static std::unique_ptr<wasm_session> s_session;
+static std::string s_result;
+static std::string s_last_error;
+
+static wasm_session& session()
+{
+	if(s_session == nullptr)
+	{
+		s_session = std::make_unique<wasm_session>("/tmp/falco_wasm_capture.scap");
+	}
+	return *s_session;
+}
+
+extern "C"
+{
+
+// Loads the rules of the given YAML content, of the given length, and
+// returns 0, or -1 with the error available from falco_wasm_last_error
+EMSCRIPTEN_KEEPALIVE int falco_wasm_load_rules(const char* content, size_t len, const char* name)
+{
+	s_last_error.clear();
+	return session().load_rules(std::string(content, len), name, s_last_error) ? 0 : -1;
+}
+
+// Evaluates the capture in the given buffer and returns its matches as
+// a JSON array, or NULL with the error available from falco_wasm_last_error
+EMSCRIPTEN_KEEPALIVE const char* falco_wasm_evaluate(const uint8_t* buf, size_t len)
+{
+	s_last_error.clear();
+	if(!session().evaluate(buf, len, s_result, s_last_error))
+	{
+		return nullptr;
+	}
+	return s_result.c_str();
+}
+
+EMSCRIPTEN_KEEPALIVE const char* falco_wasm_last_error()
+{
+	return s_last_error.c_str();
+}
+
+// Forgets the rules loaded so far, along with the state of the inspector
+EMSCRIPTEN_KEEPALIVE void falco_wasm_reset()
+{
+	s_session.reset();
+	s_result.clear();
+	s_last_error.clear();
+}
+
+}
+#endif
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+Copyright (C) 2024 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "embedded_engine.h"
+
+#include <libsinsp/sinsp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace falco
+{
+
+/*!
+	\brief The rules and the inspector behind the batch entry points of the
+	WebAssembly build, which evaluate all the events of a capture held in
+	memory with a single call and return all of their matches at once,
+	instead of crossing the boundary between JavaScript and WebAssembly
+	once per event. The syscall events are evaluated one at a time, as
+	each of them must be evaluated along with the state of the inspector
+	it was read with.
+*/
+class wasm_session
+{
+public:
+	/*!
+		\brief Uses the given path to hand the captures over to the
+		inspector, which only reads them from files
+	*/
+	explicit wasm_session(const std::string& capture_path);
+	~wasm_session();
+
+	wasm_session(const wasm_session&) = delete;
+	wasm_session& operator = (const wasm_session&) = delete;
+
+	/*!
+		\brief Loads the rules of the given YAML content on top of the ones
+		already loaded, and returns false with err set if they can't be
+	*/
+	bool load_rules(const std::string& content, const std::string& name, std::string& err);
+
+	/*!
+		\brief Evaluates all the events of the capture in the given buffer,
+		in the .scap format, and sets out to a JSON array of the matches,
+		each with the index of its event in the capture, its timestamp, and
+		the rule, source, priority, tags and output of the match. Returns
+		false with err set if the capture can't be read.
+	*/
+	bool evaluate(const uint8_t* buf, size_t len, std::string& out, std::string& err);
+
+private:
+	std::string m_capture_path;
+	std::unique_ptr<sinsp> m_inspector;
+	sinsp_filter_check_list m_filterchecks;
+	embedded_engine m_engine;
+	size_t m_source = 0;
+	// reused across events
+	std::vector<embedded_engine::match> m_matches;
+};
+
+} // namespace falco
@@ -15,83 +15,139 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#pragma once
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <thread>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
-#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+// Invokes a callback when a timeout expires, from a thread of its own.
+// The timeouts of multiple slots are tracked by the same thread, each
+// with a payload that is passed to the callback and that is set once
+// when starting. Setting and canceling a timeout only store a deadline
+// in the preallocated slot, so they don't allocate nor take locks on the
+// hot path. The thread sleeps until the earliest deadline, and is only
+// woken up early when a timeout is set while it has nothing to wait for.
 template<typename _T>
 class watchdog
 {
 public:
-	watchdog():
-		m_timeout(nullptr),
-		m_is_running(false)
-	{
-	}
+	watchdog() = default;
 
 	~watchdog()
 	{
 		stop();
 	}
 
-	void start(std::function<void(_T)> cb,
-		   std::chrono::milliseconds resolution = std::chrono::milliseconds(100))
+	watchdog(const watchdog&) = delete;
+	watchdog& operator = (const watchdog&) = delete;
+
+	void start(std::function<void(const _T&)> cb, std::vector<_T> payloads = {_T{}})
 	{
 		stop();
-		m_is_running.store(true, std::memory_order_release);
-		m_thread = std::thread([this, cb, resolution]() {
-			const auto no_deadline = time_point{};
-			timeout_data curr;
-			while(m_is_running.load(std::memory_order_acquire))
-			{
-				auto t = m_timeout.exchange(nullptr, std::memory_order_release);
-				if(t)
-				{
-					curr = *t;
-					delete t;
-				}
-				if(curr.deadline != no_deadline && curr.deadline < std::chrono::steady_clock::now())
-				{
-					cb(curr.payload);
-					curr.deadline = no_deadline;
-				}
-				std::this_thread::sleep_for(resolution);
-			}
-		});
+		m_payloads = std::move(payloads);
+		m_deadlines = std::make_unique<std::atomic<int64_t>[]>(m_payloads.size());
+		for(size_t i = 0; i < m_payloads.size(); i++)
+		{
+			m_deadlines[i].store(no_deadline);
+		}
+		m_next_wakeup.store(no_deadline);
+		m_is_running = true;
+		m_thread = std::thread([this, cb]() { run(cb); });
 	}
 
 	void stop()
 	{
-		if(m_is_running.load(std::memory_order_acquire))
 		{
-			m_is_running.store(false, std::memory_order_release);
-			if(m_thread.joinable())
+			std::lock_guard<std::mutex> lk(m_mtx);
+			if(!m_is_running)
 			{
-				m_thread.join();
+				return;
 			}
-			delete m_timeout.exchange(nullptr, std::memory_order_release);
+			m_is_running = false;
+		}
+		m_cv.notify_one();
+		if(m_thread.joinable())
+		{
+			m_thread.join();
 		}
 	}
 
-	inline void set_timeout(std::chrono::milliseconds timeout, _T payload) noexcept
+	inline void set_timeout(std::chrono::milliseconds timeout, size_t slot = 0) noexcept
 	{
-		delete m_timeout.exchange(new timeout_data{std::chrono::steady_clock::now() + timeout, payload}, std::memory_order_release);
+		auto deadline = now_ns() + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+		m_deadlines[slot].store(deadline);
+		// the thread sleeps until a later deadline, or waits for one
+		if(deadline < m_next_wakeup.load())
+		{
+			std::lock_guard<std::mutex> lk(m_mtx);
+			m_cv.notify_one();
+		}
 	}
 
-	inline void cancel_timeout() noexcept
+	inline void cancel_timeout(size_t slot = 0) noexcept
 	{
-		delete m_timeout.exchange(new timeout_data, std::memory_order_release);
+		// the thread finds out once it wakes up for the previous deadline
+		m_deadlines[slot].store(no_deadline);
 	}
 
 private:
-	typedef std::chrono::time_point<std::chrono::steady_clock> time_point;
-	struct timeout_data
+	static constexpr int64_t no_deadline = INT64_MAX;
+
+	static inline int64_t now_ns()
 	{
-		time_point deadline;
-		_T payload;
-	};
-	std::atomic<timeout_data *> m_timeout;
-	std::atomic<bool> m_is_running;
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void run(const std::function<void(const _T&)>& cb)
+	{
+		std::unique_lock<std::mutex> lk(m_mtx);
+		while(m_is_running)
+		{
+			// publishing that the thread is about to scan the deadlines
+			// before doing it makes set_timeout() wake it up if it
+			// misses a new deadline
+			m_next_wakeup.store(no_deadline);
+			auto now = now_ns();
+			auto next = no_deadline;
+			for(size_t i = 0; i < m_payloads.size(); i++)
+			{
+				auto deadline = m_deadlines[i].load();
+				// a timeout fires once, unless it's set again meanwhile
+				if(deadline <= now && m_deadlines[i].compare_exchange_strong(deadline, no_deadline))
+				{
+					lk.unlock();
+					cb(m_payloads[i]);
+					lk.lock();
+					now = now_ns();
+					continue;
+				}
+				next = std::min(next, deadline);
+			}
+
+			if(next == no_deadline)
+			{
+				m_cv.wait(lk);
+				continue;
+			}
+			m_next_wakeup.store(next);
+			m_cv.wait_for(lk, std::chrono::nanoseconds(next - now));
+		}
+	}
+
+	std::vector<_T> m_payloads;
+	std::unique_ptr<std::atomic<int64_t>[]> m_deadlines;
+	std::atomic<int64_t> m_next_wakeup{no_deadline};
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_is_running = false;
 	std::thread m_thread;
 };
@@ -18,10 +18,16 @@ limitations under the License.
 #include "webserver.h"
 #include "falco_utils.h"
 #include "falco_metrics.h"
+#include "thread_affinity.h"
 #include "app/state.h"
 #include "versions_info.h"
 #include <atomic>
 
+static constexpr uint32_t s_max_profile_duration_sec = 600;
+static constexpr size_t s_default_event_types_top = 20;
+static constexpr size_t s_default_slow_rules_top = 20;
+static constexpr size_t s_max_alerts_limit = 10000;
+
 falco_webserver::~falco_webserver()
 {
     stop();
@@ -65,13 +71,270 @@ void falco_webserver::start(
             res.set_content(versions_json_str, "application/json");
         });
 
-    if (state.config->m_metrics_enabled && webserver_config.m_prometheus_metrics_enabled)
+    // setup startup endpoint, rendering the report at each request as
+    // the times of the event sources come after the webserver started
+    auto startup = state.startup;
+    m_server->Get("/startup",
+        [startup](const httplib::Request &, httplib::Response &res) {
+            res.set_content(startup->as_json().dump(), "application/json");
+        });
+
+    // setup readiness endpoint, which only succeeds once all the event
+    // sources are open and the first events have been processed
+    m_server->Get(webserver_config.m_k8s_readyz_endpoint,
+        [startup](const httplib::Request &, httplib::Response &res) {
+            if (!startup->ready())
+            {
+                res.status = 503;
+                res.set_content("{\"status\": \"starting\"}", "application/json");
+                return;
+            }
+            res.set_content("{\"status\": \"ok\"}", "application/json");
+        });
+
+    // the metrics are served from the last snapshot published by the
+    // stats writer, so that scrapes never touch the inspectors
+    if (state.prometheus_metrics)
     {
+        m_metrics = state.prometheus_metrics;
         m_server->Get("/metrics",
-            [&state](const httplib::Request &, httplib::Response &res) {
-                res.set_content(falco_metrics::to_text(state), falco_metrics::content_type);
+            [this](const httplib::Request &req, httplib::Response &res) {
+                auto snapshot = m_metrics->get();
+                if (snapshot == nullptr)
+                {
+                    res.status = 503;
+                    res.set_content("metrics not collected yet\n", "text/plain");
+                    return;
+                }
+                res.set_header("Vary", "Accept-Encoding");
+                bool gzip = !snapshot->gzip.empty()
+                    && req.get_header_value("Accept-Encoding").find("gzip") != std::string::npos;
+                if (gzip)
+                {
+                    res.set_header("Content-Encoding", "gzip");
+                }
+                // the body is written from the snapshot, which is kept
+                // alive until the response is sent
+                size_t size = gzip ? snapshot->gzip.size() : snapshot->text.size();
+                res.set_content_provider(size, falco_metrics::content_type,
+                    [snapshot, gzip](size_t offset, size_t length, httplib::DataSink &sink) {
+                        const std::string& body = gzip ? snapshot->gzip : snapshot->text;
+                        return sink.write(body.data() + offset, length);
+                    });
             });
     }
+
+    // the events of each source by event type, most frequent first, along
+    // with their share of the events and of the time spent in the engine
+    std::map<std::string, std::shared_ptr<const falco::event_types>> event_types;
+    for (const auto& source : state.enabled_sources)
+    {
+        auto source_info = state.source_infos.at(source);
+        if (source_info != nullptr && source_info->event_types)
+        {
+            event_types[source] = source_info->event_types;
+        }
+    }
+    if (!event_types.empty())
+    {
+        m_server->Get("/debug/event_types",
+            [event_types](const httplib::Request &req, httplib::Response &res) {
+                size_t top = s_default_event_types_top;
+                if (req.has_param("top"))
+                {
+                    try
+                    {
+                        top = std::stoul(req.get_param_value("top"));
+                    }
+                    catch (const std::exception&)
+                    {
+                        res.status = 400;
+                        res.set_content("invalid top\n", "text/plain");
+                        return;
+                    }
+                }
+                auto source = req.get_param_value("source");
+                if (!source.empty() && event_types.count(source) == 0)
+                {
+                    res.status = 404;
+                    res.set_content("unknown source\n", "text/plain");
+                    return;
+                }
+                nlohmann::json out = nlohmann::json::object();
+                for (const auto& item : event_types)
+                {
+                    if (!source.empty() && item.first != source)
+                    {
+                        continue;
+                    }
+                    // the shares are of all the events, not only the top ones
+                    uint64_t total_events = 0;
+                    uint64_t total_time_ns = 0;
+                    auto stats = item.second->get_stats();
+                    for (const auto& t : stats)
+                    {
+                        total_events += t.events;
+                        total_time_ns += t.rules_time_ns;
+                    }
+                    if (top > 0 && stats.size() > top)
+                    {
+                        stats.resize(top);
+                    }
+                    auto types = nlohmann::json::array();
+                    for (const auto& t : stats)
+                    {
+                        types.push_back({
+                            {"evt_type", t.name},
+                            {"events", t.events},
+                            {"events_pct", 100.0 * t.events / total_events},
+                            {"rules_time_ns", t.rules_time_ns},
+                            {"rules_time_pct", total_time_ns > 0 ? 100.0 * t.rules_time_ns / total_time_ns : 0.0},
+                            {"rules_ns_per_evt", t.rules_time_ns / t.events},
+                        });
+                    }
+                    out[item.first] = types;
+                }
+                res.set_content(out.dump(), "application/json");
+            });
+    }
+
+    // the slowest sampled rule evaluations, slowest first, to find the
+    // rules causing latency spikes
+    if (state.engine->get_rule_stats_manager().is_rule_profiling_enabled())
+    {
+        auto engine = state.engine;
+        m_server->Get("/debug/slow_rules",
+            [engine](const httplib::Request &req, httplib::Response &res) {
+                size_t top = s_default_slow_rules_top;
+                if (req.has_param("top"))
+                {
+                    try
+                    {
+                        top = std::stoul(req.get_param_value("top"));
+                    }
+                    catch (const std::exception&)
+                    {
+                        res.status = 400;
+                        res.set_content("invalid top\n", "text/plain");
+                        return;
+                    }
+                }
+                res.set_content(engine->rules_slowest_evaluations_report(top).dump(), "application/json");
+            });
+    }
+
+    // the recent alerts matching the query, newest first, where the time
+    // window is either `last` (e.g. "10m") or `since` and `until`, in ns
+    if (state.recent_alerts)
+    {
+        auto recent_alerts = state.recent_alerts;
+        m_server->Get("/alerts",
+            [recent_alerts](const httplib::Request &req, httplib::Response &res) {
+                falco::outputs::recent_alerts::query q;
+                q.rule = req.get_param_value("rule");
+                q.container_id = req.get_param_value("container_id");
+                std::string err;
+                try
+                {
+                    if (req.has_param("priority")
+                        && !falco_common::parse_priority(req.get_param_value("priority"), q.min_priority))
+                    {
+                        err = "invalid priority";
+                    }
+                    if (req.has_param("limit"))
+                    {
+                        q.limit = std::min<size_t>(std::stoul(req.get_param_value("limit")), s_max_alerts_limit);
+                    }
+                    if (req.has_param("since"))
+                    {
+                        q.since = std::stoull(req.get_param_value("since"));
+                    }
+                    if (req.has_param("until"))
+                    {
+                        q.until = std::stoull(req.get_param_value("until"));
+                    }
+                    if (req.has_param("last"))
+                    {
+                        auto last_ms = falco::utils::parse_prometheus_interval(req.get_param_value("last"));
+                        if (last_ms == 0)
+                        {
+                            err = "invalid last";
+                        }
+                        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count();
+                        q.since = now - std::min<uint64_t>(last_ms * 1000000, now);
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    err = "invalid number";
+                }
+                if (!err.empty())
+                {
+                    res.status = 400;
+                    res.set_content(err + "\n", "text/plain");
+                    return;
+                }
+
+                std::vector<falco::outputs::recent_alerts::alert> alerts;
+                bool truncated = recent_alerts->find(q, alerts);
+                auto out = nlohmann::json::array();
+                for (const auto& a : alerts)
+                {
+                    out.push_back({
+                        {"time", a.ts},
+                        {"priority", falco_common::format_priority(a.priority)},
+                        {"rule", a.rule},
+                        {"source", a.source},
+                        {"container_id", a.container_id},
+                        {"tags", a.tags.get()},
+                        {"output", a.output},
+                    });
+                }
+                nlohmann::json body = {{"alerts", out}, {"truncated", truncated}};
+                res.set_content(body.dump(), "application/json");
+            });
+    }
+
+    // the profiling sessions run on the thread of the request, which gets
+    // the folded stacks once the session is over
+    if (state.profiler)
+    {
+        auto profiler = state.profiler;
+        auto default_duration = state.config->m_profiler.m_duration_sec;
+        m_server->Get("/profile",
+            [profiler, default_duration](const httplib::Request &req, httplib::Response &res) {
+                unsigned long duration = default_duration;
+                if (req.has_param("seconds"))
+                {
+                    try
+                    {
+                        duration = std::stoul(req.get_param_value("seconds"));
+                    }
+                    catch (const std::exception&)
+                    {
+                        duration = 0;
+                    }
+                    if (duration == 0 || duration > s_max_profile_duration_sec)
+                    {
+                        res.status = 400;
+                        res.set_content("seconds must be between 1 and "
+                            + std::to_string(s_max_profile_duration_sec) + "\n", "text/plain");
+                        return;
+                    }
+                }
+                std::string folded;
+                std::string err;
+                if (!profiler->run(std::chrono::seconds(duration), folded, err))
+                {
+                    res.status = 409;
+                    res.set_content(err + "\n", "text/plain");
+                    return;
+                }
+                res.set_content(folded, "text/plain");
+            });
+    }
+
     // run server in a separate thread
     if (!m_server->is_valid())
     {
@@ -79,10 +342,23 @@ void falco_webserver::start(
         throw falco_exception("invalid webserver configuration");
     }
 
+    // the probes are also answered on a port of their own, if any,
+    // which the slow requests of the webserver can't delay
+    if (webserver_config.m_probes_listen_port != 0)
+    {
+        m_probes = std::make_unique<falco::probe_server>(
+            webserver_config.m_k8s_healthz_endpoint,
+            webserver_config.m_k8s_readyz_endpoint,
+            [startup] { return startup->ready(); });
+        m_probes->start(webserver_config.m_listen_address, webserver_config.m_probes_listen_port);
+    }
+
     std::atomic<bool> failed;
     failed.store(false, std::memory_order_release);
     m_server_thread = std::thread([this, webserver_config, &failed]
     {
+        // the threads of the server are spawned by this one and inherit its affinity
+        falco::thread_affinity::apply(falco::thread_affinity::WEBSERVER);
         try
         {
             this->m_server->listen(webserver_config.m_listen_address, webserver_config.m_listen_port);
@@ -122,7 +398,13 @@ void falco_webserver::stop()
         {
             m_server_thread.join();
         }
+        if (m_probes != nullptr)
+        {
+            m_probes->stop();
+            m_probes = nullptr;
+        }
         m_server = nullptr;
+        m_metrics = nullptr;
         m_running = false;
     }
 }
@@ -17,6 +17,8 @@ limitations under the License.
 #pragma once
 
 #include "configuration.h"
+#include "falco_metrics.h"
+#include "probe_server.h"
 
 #include <libsinsp/sinsp.h>
 
@@ -46,5 +48,6 @@ public:
 private:
 	bool m_running = false;
 	std::unique_ptr<httplib::Server> m_server = nullptr;
+	std::shared_ptr<const falco_metrics> m_metrics = nullptr;
 	std::thread m_server_thread;
 };
@@ -32,6 +32,9 @@ limitations under the License.
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
 
 #include "config_falco.h"
 
@@ -182,16 +185,61 @@ public:
 		return emitter.c_str() + 1; // drop initial '[' char
 	}
 
+	/**
+	* Dump the document without the given top-level keys.
+	*/
+	std::string dump_without(const std::set<std::string>& keys) const
+	{
+		YAML::Node root = YAML::Clone(m_root);
+		if(root.IsMap())
+		{
+			for(const auto& key : keys)
+			{
+				root.remove(key);
+			}
+		}
+		return YAML::Dump(root);
+	}
+
 private:
 	YAML::Node m_root;
 
 	YAML::Node load_from_file_int(const std::string& path)
 	{
-		auto root = YAML::LoadFile(path);
+		auto root = parse_file(path);
 		pre_process_env_vars(root);
 		return root;
 	}
 
+	/*
+	 * Returns a copy of the parsed document of the given file.
+	 * The last document parsed from each file is kept, along with
+	 * the contents it was parsed from, so that reloading the config
+	 * (at every restart and hot reload dry run) only reads the files
+	 * and parses the ones that changed. The environment variables are
+	 * resolved afterwards, since they can change in the meantime.
+	 */
+	static YAML::Node parse_file(const std::string& path)
+	{
+		std::ifstream f(path, std::ios::binary);
+		if(!f.is_open())
+		{
+			throw YAML::BadFile(path);
+		}
+		std::string contents((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+		static std::mutex s_mtx;
+		static std::unordered_map<std::string, std::pair<std::string, YAML::Node>> s_parsed;
+		std::lock_guard<std::mutex> lk(s_mtx);
+		auto it = s_parsed.find(path);
+		if(it == s_parsed.end() || it->second.first != contents)
+		{
+			auto doc = YAML::Load(contents);
+			it = s_parsed.insert_or_assign(path, std::make_pair(std::move(contents), doc)).first;
+		}
+		return YAML::Clone(it->second.second);
+	}
+
 	/*
 	 * When loading a yaml file,
 	 * we immediately pre process all scalar values through a visitor private API,